@@ -41,6 +41,8 @@
 #include "drm.h"
 #include "drmtest.h"
 #include "i915/gem_create.h"
+#include "igt_device.h"
+#include "igt_device_scan.h"
 #include "intel_io.h"
 #include "intel_reg.h"
 #include "igt_stats.h"
@@ -73,6 +75,8 @@ static uint32_t __gem_context_create_local(int fd)
 	return create.ctx_id;
 }
 
+static enum igt_fork_placement placement;
+
 static int loop(unsigned ring,
 		int reps,
 		enum mode mode,
@@ -89,6 +93,13 @@ static int loop(unsigned ring,
 	fd = fds[0] = drm_open_driver(DRIVER_INTEL);
 	fds[1] = drm_open_driver(DRIVER_INTEL);
 
+	if (placement != IGT_FORK_PLACEMENT_NONE) {
+		char pci_slot[NAME_MAX];
+
+		igt_device_get_pci_slot_name(fd, pci_slot);
+		igt_fork_set_placement(placement, igt_device_get_numa_node(pci_slot));
+	}
+
 	memset(&obj, 0, sizeof(obj));
 	obj.handle = batch(fd);
 	igt_assert(gem_open(fds[1], gem_flink(fds[0], obj.handle)) == obj.handle);
@@ -190,7 +201,7 @@ int main(int argc, char **argv)
 	int ncpus = 1;
 	int c;
 
-	while ((c = getopt (argc, argv, "e:r:b:sf")) != -1) {
+	while ((c = getopt (argc, argv, "e:r:b:sfP:")) != -1) {
 		switch (c) {
 		case 'e':
 			if (strcmp(optarg, "rcs") == 0)
@@ -218,6 +229,11 @@ int main(int argc, char **argv)
 				abort();
 			break;
 
+		case 'P':
+			if (!igt_fork_placement_from_string(optarg, &placement))
+				abort();
+			break;
+
 		case 'f':
 			ncpus = sysconf(_SC_NPROCESSORS_ONLN);
 			break;
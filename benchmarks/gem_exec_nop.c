@@ -41,6 +41,8 @@
 #include "drm.h"
 #include "drmtest.h"
 #include "i915/gem_create.h"
+#include "igt_device.h"
+#include "igt_device_scan.h"
 #include "igt_stats.h"
 #include "intel_io.h"
 #include "intel_reg.h"
@@ -66,6 +68,8 @@ static uint32_t batch(int fd)
 	return handle;
 }
 
+static enum igt_fork_placement placement;
+
 static int loop(unsigned ring, int reps, int ncpus, unsigned flags)
 {
 	struct drm_i915_gem_execbuffer2 execbuf;
@@ -81,6 +85,13 @@ static int loop(unsigned ring, int reps, int ncpus, unsigned flags)
 
 	fd = drm_open_driver(DRIVER_INTEL);
 
+	if (placement != IGT_FORK_PLACEMENT_NONE) {
+		char pci_slot[NAME_MAX];
+
+		igt_device_get_pci_slot_name(fd, pci_slot);
+		igt_fork_set_placement(placement, igt_device_get_numa_node(pci_slot));
+	}
+
 	memset(obj, 0, sizeof(obj));
 	obj[0].handle = gem_create(fd, 4096);
 	if (flags & WRITE)
@@ -186,7 +197,7 @@ int main(int argc, char **argv)
 	int ncpus = 1;
 	int c;
 
-	while ((c = getopt (argc, argv, "e:r:sf")) != -1) {
+	while ((c = getopt (argc, argv, "e:r:sfP:")) != -1) {
 		switch (c) {
 		case 'e':
 			if (strcmp(optarg, "rcs") == 0)
@@ -209,6 +220,11 @@ int main(int argc, char **argv)
 				reps = 1;
 			break;
 
+		case 'P':
+			if (!igt_fork_placement_from_string(optarg, &placement))
+				abort();
+			break;
+
 		case 'f':
 			ncpus = sysconf(_SC_NPROCESSORS_ONLN);
 			break;
@@ -38,66 +38,102 @@
 #include <sys/time.h>
 #include <time.h>
 #include <assert.h>
+#include <pthread.h>
 
 #include "drm.h"
 #include "drmtest.h"
 #include "i915/gem_create.h"
 #include "igt_stats.h"
+#include "igt_syncobj.h"
 #include "intel_io.h"
 #include "ioctl_wrappers.h"
+#include "xe/xe_ioctl.h"
+#include "xe/xe_query.h"
 
-enum {
-	ADD_BO = 0,
-	DEL_BO,
-	ADD_CTX,
-	DEL_CTX,
-	EXEC,
-	WAIT,
+#include "gem_exec_trace.h"
+
+#define NUM_RINGS (I915_EXEC_RING_MASK + 1)
+#define NO_QUEUE (~0u)
+#define NOP_ADDR 0x100000
+
+/*
+ * The trace is indexed before replaying: every buffer object is given an id,
+ * reusing the ids of deleted objects of the same size, and every context a
+ * slot, which are written back into the (private) trace mapping. The objects,
+ * contexts and queues are then all created up front, and the execs and waits
+ * of each context are handed to one of the replay threads.
+ */
+struct replay_op {
+	uint8_t *cmd;
+	uint32_t queue;
+};
+
+struct replay_queue {
+	uint32_t ctx;
+	uint32_t ring;
+	uint32_t id;
+	uint32_t syncobj;
+};
+
+struct replay_thread {
+	struct replay *replay;
+	pthread_t thread;
+	struct replay_op *ops;
+	unsigned int num_ops;
+	unsigned int max_ops;
+	uint32_t prng;
+};
+
+struct replay {
+	int fd;
+	bool xe;
+	long nop;
+	long range;
+
+	/* Object ids index these, id 0 is the nop batch */
+	uint32_t *objects;
+	uint64_t *sizes;
+	uint32_t *last_queue;
+	uint32_t *next_free;
+	unsigned int num_objects;
+	unsigned int max_objects;
+
+	uint32_t *ctx;
+	unsigned int num_ctx;
+
+	struct replay_queue *queues;
+	unsigned int num_queues;
+
+	unsigned int max_exec_objects;
+
+	uint32_t vm;
+	uint64_t batch_addr;
+
+	struct replay_thread *threads;
+	unsigned int num_threads;
+	pthread_barrier_t barrier;
 };
 
-struct trace_add_bo {
-	uint32_t handle;
+struct free_list {
 	uint64_t size;
-} __attribute__((packed));
-
-struct trace_del_bo {
-	uint32_t handle;
-} __attribute__((packed));
-
-struct trace_add_ctx {
-	uint32_t handle;
-} __attribute__((packed));
-
-struct trace_del_ctx {
-	uint32_t handle;
-} __attribute__((packed));
-
-struct trace_exec {
-	uint32_t object_count;
-	uint64_t flags;
-	uint32_t context;
-}__attribute__((packed));
-
-struct trace_exec_object {
-	uint32_t handle;
-	uint32_t relocation_count;
-	uint64_t alignment;
-	uint64_t offset;
-	uint64_t flags;
-	uint64_t rsvd1;
-	uint64_t rsvd2;
-}__attribute__((packed));
-
-struct trace_wait {
-	uint32_t handle;
-} __attribute__((packed));
-
-static uint32_t hars_petruska_f54_1_random(void)
-{
-	static uint32_t state = 0x12345678;
+	uint32_t head;
+};
 
+struct trace_index {
+	uint32_t *handles;
+	unsigned int num_handles;
+	uint32_t *ctx;
+	unsigned int num_ctx;
+	uint32_t *queues;
+	unsigned int num_queue_slots;
+	struct free_list *free;
+	unsigned int num_free;
+};
+
+static uint32_t hars_petruska_f54_1_random(uint32_t *state)
+{
 #define rol(x,k) ((x << k) | (x >> (32-k)))
-	return state = (state ^ rol (state, 5) ^ rol (state, 24)) + 0x37798849;
+	return *state = (*state ^ rol (*state, 5) ^ rol (*state, 24)) + 0x37798849;
 #undef rol
 }
 
@@ -113,209 +149,643 @@ static uint32_t __gem_context_create_local(int fd)
 	return arg.ctx_id;
 }
 
-static double replay(const char *filename, long nop, long range)
+static void *grow(void *array, unsigned int *count, unsigned int idx,
+		  size_t elem, unsigned int align)
 {
-	struct timespec t_start, t_end;
-	struct drm_i915_gem_execbuffer2 eb = {};
-	const struct trace_version {
-		uint32_t magic;
-		uint32_t version;
-	} *tv;
-	const uint32_t bbe = 0xa << 23;
-	struct drm_i915_gem_exec_object2 *exec_objects = NULL;
-	uint32_t *bo, *ctx;
-	int num_bo, num_ctx;
-	int max_objects = 0;
-	struct stat st;
-	uint8_t *ptr, *end;
-	int fd;
+	unsigned int new_count;
 
-	fd = open(filename, O_RDONLY);
-	if (fd < 0)
-		return -1;
+	if (idx < *count)
+		return array;
 
-	if (fstat(fd, &st) < 0) {
-		close(fd);
-		return -1;
-	}
+	new_count = ALIGN(idx + 1, align);
+	array = realloc(array, new_count * elem);
+	igt_assert(array);
+	memset((char *)array + *count * elem, 0, (new_count - *count) * elem);
+	*count = new_count;
 
-	ptr = mmap(0, st.st_size, PROT_WRITE, MAP_PRIVATE, fd, 0);
-	close(fd);
+	return array;
+}
 
-	if (ptr == MAP_FAILED)
-		return -1;
+static uint32_t new_object(struct replay *r, struct trace_index *idx,
+			   uint64_t size)
+{
+	unsigned int count;
+	uint32_t id;
 
-	madvise(ptr, st.st_size, MADV_SEQUENTIAL);
-	end = ptr + st.st_size;
+	for (unsigned int i = 0; i < idx->num_free; i++) {
+		struct free_list *fl = &idx->free[i];
 
-	tv = (struct trace_version *)ptr;
-	if (tv->magic != 0xdeadbeef) {
-		fprintf(stderr, "%s: invalid magic\n", filename);
-		return -1;
+		if (fl->size == size && fl->head) {
+			id = fl->head;
+			fl->head = r->next_free[id];
+			return id;
+		}
 	}
-	if (tv->version != 1) {
-		fprintf(stderr, "%s: unhandled version %d\n",
-			filename, tv->version);
-		return -1;
+
+	id = r->num_objects++;
+
+	count = r->max_objects;
+	r->sizes = grow(r->sizes, &count, id, sizeof(*r->sizes), 4096);
+	count = r->max_objects;
+	r->last_queue = grow(r->last_queue, &count, id,
+			     sizeof(*r->last_queue), 4096);
+	count = r->max_objects;
+	r->next_free = grow(r->next_free, &count, id,
+			    sizeof(*r->next_free), 4096);
+	r->max_objects = count;
+
+	r->sizes[id] = size;
+	r->last_queue[id] = NO_QUEUE;
+
+	return id;
+}
+
+static void free_object(struct replay *r, struct trace_index *idx, uint32_t id)
+{
+	unsigned int i;
+
+	for (i = 0; i < idx->num_free; i++)
+		if (idx->free[i].size == r->sizes[id])
+			break;
+
+	if (i == idx->num_free) {
+		idx->free = realloc(idx->free, ++idx->num_free * sizeof(*idx->free));
+		igt_assert(idx->free);
+		idx->free[i].size = r->sizes[id];
+		idx->free[i].head = 0;
 	}
-	ptr = (void *)(tv + 1);
 
-	ctx = calloc(1024, sizeof(*ctx));
-	num_ctx = 1024;
+	r->next_free[id] = idx->free[i].head;
+	idx->free[i].head = id;
+}
 
-	bo = calloc(4096, sizeof(*bo));
-	num_bo = 4096;
+static uint32_t lookup_queue(struct replay *r, struct trace_index *idx,
+			     uint32_t ctx, uint32_t ring)
+{
+	unsigned int slot = ctx * NUM_RINGS + ring;
+	struct replay_queue *q;
+
+	idx->queues = grow(idx->queues, &idx->num_queue_slots, slot,
+			   sizeof(*idx->queues), 1024);
+	if (idx->queues[slot])
+		return idx->queues[slot] - 1;
+
+	r->queues = realloc(r->queues, (r->num_queues + 1) * sizeof(*r->queues));
+	igt_assert(r->queues);
+	q = &r->queues[r->num_queues];
+	memset(q, 0, sizeof(*q));
+	q->ctx = ctx;
+	q->ring = ring;
+
+	idx->queues[slot] = ++r->num_queues;
+	return r->num_queues - 1;
+}
 
-	fd = drm_open_driver(DRIVER_INTEL);
-	if (nop > 0) {
-		bo[0] = gem_create(fd, nop + range);
-		gem_write(fd, bo[0], nop + range - sizeof(bbe),
-			  &bbe, sizeof(bbe));
-		range *= 2;
-		range -= 64;
-	} else {
-		bo[0] = gem_create(fd, 4096);
-		gem_write(fd, bo[0], 0, &bbe, sizeof(bbe));
+static void add_op(struct replay *r, unsigned int thread,
+		   uint8_t *cmd, uint32_t queue)
+{
+	struct replay_thread *th = &r->threads[thread];
+
+	if (th->num_ops == th->max_ops) {
+		th->max_ops = th->max_ops ? 2 * th->max_ops : 1024;
+		th->ops = realloc(th->ops, th->max_ops * sizeof(*th->ops));
+		igt_assert(th->ops);
 	}
 
-	clock_gettime(CLOCK_MONOTONIC, &t_start);
-	do switch (*ptr++) {
-	case ADD_BO:
-		{
-			struct trace_add_bo *t = (void *)ptr;
-			ptr = (void *)(t + 1);
+	th->ops[th->num_ops].cmd = cmd;
+	th->ops[th->num_ops].queue = queue;
+	th->num_ops++;
+}
 
-			if (t->handle >= num_bo) {
-				int new_bo = ALIGN(t->handle, 4096);
-				bo = realloc(bo, sizeof(*bo)*new_bo);
-				memset(bo + num_bo, 0, sizeof(*bo)*(new_bo - num_bo));
-				num_bo = new_bo;
+static int index_trace(struct replay *r, uint8_t *ptr, uint8_t *end)
+{
+	struct trace_index idx = {};
+	int ret = -1;
+
+	/* Id 0 is the nop batch, slot 0 the default context */
+	new_object(r, &idx, 0);
+	r->num_ctx = 1;
+
+	while (ptr < end) {
+		uint8_t *cmd = ptr;
+
+		switch (*ptr++) {
+		case ADD_BO:
+			{
+				struct trace_add_bo *t = (void *)ptr;
+				ptr = (void *)(t + 1);
+
+				idx.handles = grow(idx.handles, &idx.num_handles,
+						   t->handle, sizeof(*idx.handles),
+						   4096);
+				idx.handles[t->handle] = new_object(r, &idx, t->size);
+				break;
+			}
+		case DEL_BO:
+			{
+				struct trace_del_bo *t = (void *)ptr;
+				ptr = (void *)(t + 1);
+
+				assert(t->handle && t->handle < idx.num_handles &&
+				       idx.handles[t->handle]);
+				free_object(r, &idx, idx.handles[t->handle]);
+				idx.handles[t->handle] = 0;
+				break;
+			}
+		case ADD_CTX:
+			{
+				struct trace_add_ctx *t = (void *)ptr;
+				ptr = (void *)(t + 1);
+
+				idx.ctx = grow(idx.ctx, &idx.num_ctx, t->handle,
+					       sizeof(*idx.ctx), 1024);
+				idx.ctx[t->handle] = r->num_ctx++;
+				break;
+			}
+		case DEL_CTX:
+			{
+				struct trace_del_ctx *t = (void *)ptr;
+				ptr = (void *)(t + 1);
+
+				assert(t->handle < idx.num_ctx && idx.ctx[t->handle]);
+				idx.ctx[t->handle] = 0;
+				break;
 			}
+		case EXEC:
+			{
+				struct trace_exec *t = (void *)ptr;
+				uint32_t queue;
+
+				ptr = (void *)(t + 1);
+
+				t->context = t->context < idx.num_ctx ?
+					     idx.ctx[t->context] : 0;
+				queue = lookup_queue(r, &idx, t->context,
+						     t->flags & I915_EXEC_RING_MASK);
+
+				for (uint32_t i = 0; i < t->object_count; i++) {
+					struct trace_exec_object *to = (void *)ptr;
+					struct trace_exec_relocation *relocs;
+
+					ptr = (void *)(to + 1);
+
+					if (to->handle >= idx.num_handles ||
+					    !idx.handles[to->handle]) {
+						fprintf(stderr, "Unknown handle: %u\n",
+							to->handle);
+						goto out;
+					}
+					to->handle = idx.handles[to->handle];
+					r->last_queue[to->handle] = queue;
+
+					relocs = (void *)ptr;
+					if (!(t->flags & I915_EXEC_HANDLE_LUT)) {
+						for (uint32_t j = 0; j < to->relocation_count; j++) {
+							uint32_t h = relocs[j].target_handle;
+
+							relocs[j].target_handle =
+								h < idx.num_handles ? idx.handles[h] : 0;
+						}
+					}
+
+					ptr += sizeof(*relocs) * to->relocation_count;
+				}
 
-			bo[t->handle] = gem_create(fd, t->size);
+				r->max_exec_objects = max(r->max_exec_objects,
+							  t->object_count + 1);
+				add_op(r, t->context % r->num_threads, cmd, queue);
+				break;
+			}
+		case WAIT:
+			{
+				struct trace_wait *t = (void *)ptr;
+				uint32_t queue;
+
+				ptr = (void *)(t + 1);
+
+				assert(t->handle && t->handle < idx.num_handles &&
+				       idx.handles[t->handle]);
+				t->handle = idx.handles[t->handle];
+
+				/* Wait from the thread which last used the object */
+				queue = r->last_queue[t->handle];
+				add_op(r, queue != NO_QUEUE ?
+				       r->queues[queue].ctx % r->num_threads : 0,
+				       cmd, queue);
+				break;
+			}
+		case TIMING:
+			ptr += sizeof(struct trace_timing);
 			break;
-		}
-	case DEL_BO:
-		{
-			struct trace_del_bo *t = (void *)ptr;
-			ptr = (void *)(t + 1);
 
-			assert(t->handle && t->handle < num_bo && bo[t->handle]);
-			gem_close(fd, bo[t->handle]);
-			bo[t->handle] = 0;
-			break;
+		default:
+			fprintf(stderr, "Unknown cmd: %x\n", *cmd);
+			goto out;
 		}
-	case ADD_CTX:
-		{
-			struct trace_add_ctx *t = (void *)ptr;
-			ptr = (void *)(t + 1);
+	}
 
-			if (t->handle >= num_ctx) {
-				int new_ctx = ALIGN(t->handle, 1024);
-				ctx = realloc(ctx, sizeof(*ctx)*new_ctx);
-				memset(ctx + num_ctx, 0, sizeof(*ctx)*(new_ctx - num_ctx));
-				num_ctx = new_ctx;
-			}
+	ret = 0;
+out:
+	free(idx.handles);
+	free(idx.ctx);
+	free(idx.queues);
+	free(idx.free);
+	return ret;
+}
 
-			ctx[t->handle] = __gem_context_create_local(fd);
-			break;
-		}
-	case DEL_CTX:
-		{
-			struct trace_del_ctx *t = (void *)ptr;
-			ptr = (void *)(t + 1);
+static const struct drm_xe_engine_class_instance *
+xe_ring_engine(int fd, unsigned int ring)
+{
+	static const uint16_t classes[] = {
+		[I915_EXEC_DEFAULT] = DRM_XE_ENGINE_CLASS_RENDER,
+		[I915_EXEC_RENDER] = DRM_XE_ENGINE_CLASS_RENDER,
+		[I915_EXEC_BSD] = DRM_XE_ENGINE_CLASS_VIDEO_DECODE,
+		[I915_EXEC_BLT] = DRM_XE_ENGINE_CLASS_COPY,
+		[I915_EXEC_VEBOX] = DRM_XE_ENGINE_CLASS_VIDEO_ENHANCE,
+	};
+	struct drm_xe_engine *engine = NULL;
+
+	/* Rings from engine maps can't be told apart, so they run on render */
+	engine = xe_find_engine_by_class(fd, ring < ARRAY_SIZE(classes) ?
+					 classes[ring] :
+					 DRM_XE_ENGINE_CLASS_RENDER);
+	if (!engine)
+		engine = xe_engine(fd, 0);
+
+	return &engine->instance;
+}
 
-			assert(t->handle < num_ctx && ctx[t->handle]);
-			gem_context_destroy(fd, ctx[t->handle]);
-			ctx[t->handle] = 0;
-			break;
-		}
-	case EXEC:
-		{
-			struct trace_exec *t = (void *)ptr;
-			ptr = (void *)(t + 1);
+static uint32_t xe_create_batch(int fd, uint32_t vm, unsigned long size,
+				unsigned long bbe_offset, uint64_t addr)
+{
+	const uint32_t bbe = 0xa << 23;
+	uint32_t bo;
+	void *map;
 
-			eb.buffer_count = t->object_count;
-			eb.flags = t->flags;
-			eb.rsvd1 = ctx[t->context];
+	size = ALIGN(size, xe_get_default_alignment(fd));
+	bo = xe_bo_create(fd, vm, size, vram_if_possible(fd, 0),
+			  DRM_XE_GEM_CREATE_FLAG_NEEDS_VISIBLE_VRAM);
+	map = xe_bo_map(fd, bo, size);
+	memcpy(map + bbe_offset, &bbe, sizeof(bbe));
+	munmap(map, size);
 
-			if (eb.buffer_count >= max_objects) {
-				free(exec_objects);
+	xe_vm_bind_sync(fd, vm, bo, 0, addr, size);
 
-				max_objects = ALIGN(eb.buffer_count + 1, 4096);
+	return bo;
+}
 
-				exec_objects = malloc(max_objects*sizeof(*exec_objects));
-				eb.buffers_ptr = (uintptr_t)exec_objects;
-			}
+static void setup_i915(struct replay *r)
+{
+	const uint32_t bbe = 0xa << 23;
+
+	if (r->nop > 0) {
+		r->objects[0] = gem_create(r->fd, r->nop + r->range);
+		gem_write(r->fd, r->objects[0], r->nop + r->range - sizeof(bbe),
+			  &bbe, sizeof(bbe));
+	} else {
+		r->objects[0] = gem_create(r->fd, 4096);
+		gem_write(r->fd, r->objects[0], 0, &bbe, sizeof(bbe));
+	}
+
+	for (unsigned int id = 1; id < r->num_objects; id++)
+		r->objects[id] = gem_create(r->fd, r->sizes[id]);
 
-			for (uint32_t i = 0; i < eb.buffer_count; i++) {
+	for (unsigned int i = 1; i < r->num_ctx; i++)
+		r->ctx[i] = __gem_context_create_local(r->fd);
+
+	/* The kernel reads the relocations straight from the trace */
+	for (unsigned int n = 0; n < r->num_threads; n++) {
+		struct replay_thread *th = &r->threads[n];
+
+		for (unsigned int i = 0; i < th->num_ops; i++) {
+			uint8_t *ptr = th->ops[i].cmd;
+			struct trace_exec *t = (void *)(ptr + 1);
+
+			if (*ptr != EXEC || t->flags & I915_EXEC_HANDLE_LUT)
+				continue;
+
+			ptr = (void *)(t + 1);
+			for (uint32_t j = 0; j < t->object_count; j++) {
 				struct trace_exec_object *to = (void *)ptr;
-				ptr = (void *)(to + 1);
-
-				exec_objects[i].handle = bo[to->handle];
-				exec_objects[i].alignment = to->alignment;
-				exec_objects[i].offset = to->offset;
-				exec_objects[i].flags = to->flags;
-				exec_objects[i].rsvd1 = to->rsvd1;
-				exec_objects[i].rsvd2 = to->rsvd2;
-
-				exec_objects[i].relocation_count = to->relocation_count;
-				exec_objects[i].relocs_ptr = (uintptr_t)ptr;
-
-				if (!(eb.flags & I915_EXEC_HANDLE_LUT)) {
-					struct drm_i915_gem_relocation_entry *relocs =
-						(struct drm_i915_gem_relocation_entry *)ptr;
-					for (uint32_t j = 0; j < to->relocation_count; j++)
-						relocs[j].target_handle = bo[relocs[j].target_handle];
-				}
+				struct trace_exec_relocation *relocs = (void *)(to + 1);
+
+				for (uint32_t k = 0; k < to->relocation_count; k++)
+					relocs[k].target_handle =
+						r->objects[relocs[k].target_handle];
 
-				ptr += sizeof(struct drm_i915_gem_relocation_entry) * to->relocation_count;
+				ptr = (void *)(relocs + to->relocation_count);
 			}
+		}
+	}
+}
 
-			((struct drm_i915_gem_exec_object2 *)
-			 memset(&exec_objects[eb.buffer_count++], 0,
-				sizeof(*exec_objects)))->handle = bo[0];
+static void setup_xe(struct replay *r)
+{
+	uint32_t alignment = xe_get_default_alignment(r->fd);
+	uint64_t addr = NOP_ADDR;
 
-			if (nop > 0) {
-				eb.batch_start_offset = hars_petruska_f54_1_random();
-				eb.batch_start_offset =
-					((uint64_t)eb.batch_start_offset * range) >> 32;
-				eb.batch_start_offset = ALIGN(eb.batch_start_offset, 64);
-			}
-			gem_execbuf(fd, &eb);
+	r->vm = xe_vm_create(r->fd, 0, 0);
+
+	r->batch_addr = addr;
+	if (r->nop > 0) {
+		r->objects[0] = xe_create_batch(r->fd, r->vm, r->nop + r->range,
+						r->nop + r->range - sizeof(uint32_t),
+						addr);
+		addr += ALIGN(r->nop + r->range, alignment);
+	} else {
+		r->objects[0] = xe_create_batch(r->fd, r->vm, 4096, 0, addr);
+		addr += ALIGN(4096, alignment);
+	}
+
+	/* Bind every object at its own address for the whole replay */
+	for (unsigned int id = 1; id < r->num_objects; id++) {
+		uint64_t size = ALIGN(max_t(uint64_t, r->sizes[id], 1), alignment);
+
+		r->objects[id] = xe_bo_create(r->fd, r->vm, size,
+					      vram_if_possible(r->fd, 0), 0);
+		xe_vm_bind_sync(r->fd, r->vm, r->objects[id], 0, addr, size);
+		addr += size;
+	}
+
+	for (unsigned int i = 0; i < r->num_queues; i++) {
+		struct replay_queue *q = &r->queues[i];
+
+		q->id = xe_exec_queue_create(r->fd, r->vm,
+					     (void *)xe_ring_engine(r->fd, q->ring),
+					     0);
+		q->syncobj = syncobj_create(r->fd, 0);
+	}
+}
+
+static uint32_t batch_offset(struct replay *r, uint32_t *prng)
+{
+	uint32_t offset;
+
+	if (r->nop <= 0)
+		return 0;
+
+	offset = hars_petruska_f54_1_random(prng);
+	offset = ((uint64_t)offset * r->range) >> 32;
+	return ALIGN(offset, 64);
+}
+
+static uint8_t *exec_i915(struct replay *r, struct replay_thread *th,
+			  struct drm_i915_gem_execbuffer2 *eb, uint8_t *ptr)
+{
+	struct drm_i915_gem_exec_object2 *exec_objects =
+		from_user_pointer(eb->buffers_ptr);
+	struct trace_exec *t = (void *)ptr;
+
+	ptr = (void *)(t + 1);
+
+	eb->buffer_count = t->object_count;
+	eb->flags = t->flags;
+	eb->rsvd1 = r->ctx[t->context];
+
+	for (uint32_t i = 0; i < eb->buffer_count; i++) {
+		struct trace_exec_object *to = (void *)ptr;
+		ptr = (void *)(to + 1);
+
+		exec_objects[i].handle = r->objects[to->handle];
+		exec_objects[i].alignment = to->alignment;
+		exec_objects[i].offset = to->offset;
+		exec_objects[i].flags = to->flags;
+		exec_objects[i].rsvd1 = to->rsvd1;
+		exec_objects[i].rsvd2 = to->rsvd2;
+
+		exec_objects[i].relocation_count = to->relocation_count;
+		exec_objects[i].relocs_ptr = (uintptr_t)ptr;
+
+		ptr += sizeof(struct drm_i915_gem_relocation_entry) * to->relocation_count;
+	}
+
+	((struct drm_i915_gem_exec_object2 *)
+	 memset(&exec_objects[eb->buffer_count++], 0,
+		sizeof(*exec_objects)))->handle = r->objects[0];
+
+	eb->batch_start_offset = batch_offset(r, &th->prng);
+	gem_execbuf(r->fd, eb);
+
+	return ptr;
+}
+
+static void exec_xe(struct replay *r, struct replay_thread *th,
+		    struct replay_queue *q)
+{
+	struct drm_xe_sync sync = {
+		.type = DRM_XE_SYNC_TYPE_SYNCOBJ,
+		.flags = DRM_XE_SYNC_FLAG_SIGNAL,
+		.handle = q->syncobj,
+	};
+	struct drm_xe_exec exec = {
+		.exec_queue_id = q->id,
+		.num_syncs = 1,
+		.syncs = to_user_pointer(&sync),
+		.address = r->batch_addr + batch_offset(r, &th->prng),
+		.num_batch_buffer = 1,
+	};
+
+	/* Everything is bound to the VM, only the batch is submitted */
+	xe_exec(r->fd, &exec);
+}
+
+static void *replay_thread(void *arg)
+{
+	struct replay_thread *th = arg;
+	struct replay *r = th->replay;
+	struct drm_i915_gem_execbuffer2 eb = {};
+
+	eb.buffers_ptr = to_user_pointer(calloc(r->max_exec_objects,
+				sizeof(struct drm_i915_gem_exec_object2)));
+	igt_assert(eb.buffers_ptr);
+
+	pthread_barrier_wait(&r->barrier);
+
+	for (unsigned int i = 0; i < th->num_ops; i++) {
+		const struct replay_op *op = &th->ops[i];
+		uint8_t *ptr = op->cmd;
+
+		switch (*ptr++) {
+		case EXEC:
+			if (r->xe)
+				exec_xe(r, th, &r->queues[op->queue]);
+			else
+				exec_i915(r, th, &eb, ptr);
 			break;
+
+		case WAIT:
+			{
+				struct trace_wait *t = (void *)ptr;
+
+				if (!r->xe)
+					gem_wait(r->fd, r->objects[t->handle], NULL);
+				else if (op->queue != NO_QUEUE)
+					syncobj_wait(r->fd,
+						     &r->queues[op->queue].syncobj,
+						     1, INT64_MAX, 0, NULL);
+				break;
+			}
 		}
+	}
 
-	case WAIT:
-		{
-			struct trace_wait *t = (void *)ptr;
-			ptr = (void *)(t + 1);
+	free(from_user_pointer(eb.buffers_ptr));
+	return NULL;
+}
 
-			assert(t->handle && t->handle < num_bo && bo[t->handle]);
-			gem_wait(fd, bo[t->handle], NULL);
-			break;
+static void replay_free(struct replay *r)
+{
+	for (unsigned int n = 0; n < r->num_threads; n++)
+		free(r->threads[n].ops);
+	free(r->threads);
+	free(r->queues);
+	free(r->ctx);
+	free(r->objects);
+	free(r->sizes);
+	free(r->last_queue);
+	free(r->next_free);
+	free(r);
+}
+
+static double replay(const char *filename, long nop, long range,
+		     unsigned int num_threads)
+{
+	struct timespec t_start, t_end;
+	const struct trace_version *tv;
+	uint8_t *decoded = NULL;
+	struct replay *r;
+	struct stat st;
+	uint8_t *ptr, *end;
+	size_t len;
+	int fd;
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		return -1;
+
+	if (fstat(fd, &st) < 0) {
+		close(fd);
+		return -1;
+	}
+
+	ptr = mmap(0, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (ptr == MAP_FAILED)
+		return -1;
+
+	madvise(ptr, st.st_size, MADV_SEQUENTIAL);
+	end = ptr + st.st_size;
+
+	tv = (struct trace_version *)ptr;
+	if (tv->magic != TRACE_MAGIC) {
+		fprintf(stderr, "%s: invalid magic\n", filename);
+		return -1;
+	}
+	if (tv->version != 1 && tv->version != 2) {
+		fprintf(stderr, "%s: unhandled version %d\n",
+			filename, tv->version);
+		return -1;
+	}
+	ptr = (void *)(tv + 1);
+
+	if (tv->version == 2) {
+		decoded = trace_decode(ptr, end, &len);
+		if (!decoded) {
+			fprintf(stderr, "%s: malformed trace\n", filename);
+			return -1;
 		}
+		ptr = decoded;
+		end = ptr + len;
+	}
 
-	default:
-		fprintf(stderr, "Unknown cmd: %x\n", *ptr);
+	r = calloc(1, sizeof(*r));
+	r->nop = nop;
+	r->range = range;
+	r->num_threads = num_threads;
+	r->threads = calloc(num_threads, sizeof(*r->threads));
+
+	if (index_trace(r, ptr, end)) {
+		replay_free(r);
 		return -1;
-	} while (ptr < end);
+	}
+
+	r->fd = drm_open_driver(DRIVER_INTEL | DRIVER_XE);
+	r->xe = is_xe_device(r->fd);
+	if (r->nop > 0) {
+		r->range *= 2;
+		r->range -= 64;
+	}
+
+	r->objects = calloc(r->num_objects, sizeof(*r->objects));
+	r->ctx = calloc(r->num_ctx, sizeof(*r->ctx));
+	if (r->xe)
+		setup_xe(r);
+	else
+		setup_i915(r);
+
+	pthread_barrier_init(&r->barrier, NULL, num_threads + 1);
+	for (unsigned int n = 0; n < num_threads; n++) {
+		r->threads[n].replay = r;
+		r->threads[n].prng = 0x12345678 + n;
+		pthread_create(&r->threads[n].thread, NULL,
+			       replay_thread, &r->threads[n]);
+	}
+
+	pthread_barrier_wait(&r->barrier);
+	clock_gettime(CLOCK_MONOTONIC, &t_start);
+	for (unsigned int n = 0; n < num_threads; n++)
+		pthread_join(r->threads[n].thread, NULL);
 	clock_gettime(CLOCK_MONOTONIC, &t_end);
 
+	close(r->fd);
+	munmap((void *)tv, st.st_size);
+	free(decoded);
+	replay_free(r);
+
 	return elapsed(&t_start, &t_end);
 }
 
-static long calibrate_nop(int usecs)
+static double time_nop(int fd, unsigned long size)
 {
 	const uint32_t bbe = 0xa << 23;
-	int fd = drm_open_driver(DRIVER_INTEL);
-	struct drm_i915_gem_exec_object2 obj = {};
-	struct drm_i915_gem_execbuffer2 eb = { .buffer_count = 1, .buffers_ptr = (uintptr_t)&obj};
-	unsigned long size, last_size;
+	struct timespec t_start, t_end;
 
-	size = 256*1024;
-	do {
-		struct timespec t_start, t_end;
+	if (is_xe_device(fd)) {
+		uint32_t vm = xe_vm_create(fd, 0, 0);
+		uint32_t bo = xe_create_batch(fd, vm, size, size - sizeof(bbe),
+					      NOP_ADDR);
+		uint32_t queue = xe_exec_queue_create(fd, vm,
+						      &xe_engine(fd, 0)->instance,
+						      0);
+		struct drm_xe_sync sync = {
+			.type = DRM_XE_SYNC_TYPE_SYNCOBJ,
+			.flags = DRM_XE_SYNC_FLAG_SIGNAL,
+			.handle = syncobj_create(fd, 0),
+		};
+		struct drm_xe_exec exec = {
+			.exec_queue_id = queue,
+			.num_syncs = 1,
+			.syncs = to_user_pointer(&sync),
+			.address = NOP_ADDR,
+			.num_batch_buffer = 1,
+		};
+
+		xe_exec(fd, &exec);
+		syncobj_wait(fd, &sync.handle, 1, INT64_MAX, 0, NULL);
+
+		clock_gettime(CLOCK_MONOTONIC, &t_start);
+		for (int loop = 0; loop < 9; loop++)
+			xe_exec(fd, &exec);
+		syncobj_wait(fd, &sync.handle, 1, INT64_MAX, 0, NULL);
+		clock_gettime(CLOCK_MONOTONIC, &t_end);
+
+		syncobj_destroy(fd, sync.handle);
+		xe_exec_queue_destroy(fd, queue);
+		gem_close(fd, bo);
+		xe_vm_destroy(fd, vm);
+	} else {
+		struct drm_i915_gem_exec_object2 obj = {};
+		struct drm_i915_gem_execbuffer2 eb = { .buffer_count = 1, .buffers_ptr = (uintptr_t)&obj};
 
 		obj.handle = gem_create(fd, size);
 		gem_write(fd, obj.handle, size - sizeof(bbe), &bbe, sizeof(bbe));
@@ -329,9 +799,20 @@ static long calibrate_nop(int usecs)
 		clock_gettime(CLOCK_MONOTONIC, &t_end);
 
 		gem_close(fd, obj.handle);
+	}
+
+	return elapsed(&t_start, &t_end);
+}
 
+static long calibrate_nop(int usecs)
+{
+	int fd = drm_open_driver(DRIVER_INTEL | DRIVER_XE);
+	unsigned long size, last_size;
+
+	size = 256*1024;
+	do {
 		last_size = size;
-		size = 9e-3*usecs / elapsed(&t_start, &t_end) * size;
+		size = 9e-3*usecs / time_nop(fd, size) * size;
 		size = ALIGN(size, 4096);
 	} while (size != last_size);
 
@@ -341,31 +822,18 @@ static long calibrate_nop(int usecs)
 
 static int measure_nop(long nop)
 {
-	const uint32_t bbe = 0xa << 23;
-	int fd = drm_open_driver(DRIVER_INTEL);
-	struct drm_i915_gem_exec_object2 obj = {};
-	struct drm_i915_gem_execbuffer2 eb = { .buffer_count = 1, .buffers_ptr = (uintptr_t)&obj};
-	struct timespec t_start, t_end;
+	int fd = drm_open_driver(DRIVER_INTEL | DRIVER_XE);
+	double t;
 
-	obj.handle = gem_create(fd, nop);
-	gem_write(fd, obj.handle, nop - sizeof(bbe), &bbe, sizeof(bbe));
-	gem_execbuf(fd, &eb);
-	gem_sync(fd, obj.handle);
-
-	clock_gettime(CLOCK_MONOTONIC, &t_start);
-	for (int loop = 0; loop < 9; loop++)
-		gem_execbuf(fd, &eb);
-	gem_sync(fd, obj.handle);
-	clock_gettime(CLOCK_MONOTONIC, &t_end);
-
-	gem_close(fd, obj.handle);
+	t = time_nop(fd, nop);
 
 	close(fd);
-	return 1e3*elapsed(&t_start, &t_end) / 9;
+	return 1e3*t / 9;
 }
 
 int main(int argc, char **argv)
 {
+	unsigned int threads = 1;
 	int delay = 1000;
 	double *results;
 	long nop = 0;
@@ -375,7 +843,7 @@ int main(int argc, char **argv)
 	results = mmap(NULL, ALIGN(argc*sizeof(double), 4096),
 		       PROT_WRITE, MAP_SHARED | MAP_ANON, -1, 0);
 
-	while ((c = getopt(argc, argv, "d:n:r:")) != -1) {
+	while ((c = getopt(argc, argv, "d:n:r:t:")) != -1) {
 		switch (c) {
 		case 'd':
 			delay = atoi(optarg);
@@ -390,6 +858,9 @@ int main(int argc, char **argv)
 			if (range > 0)
 				range = ALIGN(range, 4096);
 			break;
+		case 't':
+			threads = max(atoi(optarg), 1);
+			break;
 		default:
 			break;
 		}
@@ -407,7 +878,7 @@ int main(int argc, char **argv)
 	}
 
 	igt_fork(child, argc-optind)
-		results[child] = replay(argv[child + optind], nop, range);
+		results[child] = replay(argv[child + optind], nop, range, threads);
 	igt_waitchildren();
 
 	for (i = 0; i < argc - optind; i++) {
@@ -0,0 +1,347 @@
+/* SPDX-License-Identifier: MIT */
+/*
+ * Copyright © 2025 Intel Corporation
+ */
+
+#ifndef GEM_EXEC_TRACE_H
+#define GEM_EXEC_TRACE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * The trace format written by the gem_exec_tracer LD_PRELOAD library.
+ *
+ * A trace starts with a struct trace_version. In version 1 the records
+ * follow, each a command byte and its packed struct below, an exec being
+ * followed by its objects and each object by its relocations.
+ *
+ * Version 2 is made of chunks, each written from the buffer of a single
+ * thread of the application:
+ *
+ *   varint thread, varint first timestamp (ns), varint length, records
+ *
+ * A record is a command byte, the time since the previous record of the
+ * chunk as a varint and then all the fields of the command, each as a
+ * varint (LEB128). An exec record has the exec number first, then the
+ * fields of struct trace_exec and of every object and relocation. A timing
+ * record has the exec number and the time from the submission to the
+ * record, taken on completion. A batch hash record has the exec number and
+ * the FNV-1a hash of the batch.
+ *
+ * The readers only understand version 1: trace_decode() turns version 2
+ * back into it, interleaving the threads in timestamp order.
+ */
+
+#define TRACE_MAGIC 0xdeadbeef
+
+enum {
+	ADD_BO = 0,
+	DEL_BO,
+	ADD_CTX,
+	DEL_CTX,
+	EXEC,
+	WAIT,
+	TIMING,
+	BATCH_HASH,
+};
+
+struct trace_version {
+	uint32_t magic;
+	uint32_t version;
+};
+
+struct trace_add_bo {
+	uint32_t handle;
+	uint64_t size;
+} __attribute__((packed));
+
+struct trace_del_bo {
+	uint32_t handle;
+} __attribute__((packed));
+
+struct trace_add_ctx {
+	uint32_t handle;
+} __attribute__((packed));
+
+struct trace_del_ctx {
+	uint32_t handle;
+} __attribute__((packed));
+
+struct trace_exec {
+	uint32_t object_count;
+	uint64_t flags;
+	uint32_t context;
+} __attribute__((packed));
+
+struct trace_exec_object {
+	uint32_t handle;
+	uint32_t relocation_count;
+	uint64_t alignment;
+	uint64_t offset;
+	uint64_t flags;
+	uint64_t rsvd1;
+	uint64_t rsvd2;
+} __attribute__((packed));
+
+struct trace_exec_relocation {
+	uint32_t target_handle;
+	uint32_t delta;
+	uint64_t offset;
+	uint64_t presumed_offset;
+	uint32_t read_domains;
+	uint32_t write_domain;
+} __attribute__((packed));
+
+struct trace_wait {
+	uint32_t handle;
+} __attribute__((packed));
+
+struct trace_timing {
+	uint32_t exec;
+	uint64_t submit_ns;
+	uint64_t complete_ns;
+} __attribute__((packed));
+
+struct trace_decoder {
+	const uint8_t *ptr, *end;
+	int error;
+
+	uint8_t *out;
+	size_t len, size;
+
+	struct trace_record {
+		uint64_t ts;
+		size_t seq;
+		size_t off;
+		uint32_t len;
+		uint32_t exec;
+	} *records;
+	size_t num_records, max_records;
+};
+
+static inline uint64_t trace_get(struct trace_decoder *d)
+{
+	uint64_t v = 0;
+
+	for (unsigned int shift = 0; shift < 64; shift += 7) {
+		uint8_t b;
+
+		if (d->ptr == d->end)
+			break;
+
+		b = *d->ptr++;
+		v |= (uint64_t)(b & 0x7f) << shift;
+		if (!(b & 0x80))
+			return v;
+	}
+
+	d->error = 1;
+	return 0;
+}
+
+static inline void trace_put(struct trace_decoder *d, uint64_t v, size_t bytes)
+{
+	if (d->len + bytes > d->size) {
+		d->size = 2 * d->size + bytes + 4096;
+		d->out = realloc(d->out, d->size);
+		if (!d->out)
+			abort();
+	}
+
+	/* The traces are only read on the little endian hosts writing them */
+	memcpy(d->out + d->len, &v, bytes);
+	d->len += bytes;
+}
+
+static inline void trace_copy(struct trace_decoder *d, size_t bytes)
+{
+	trace_put(d, trace_get(d), bytes);
+}
+
+static inline int trace_cmp_record(const void *A, const void *B)
+{
+	const struct trace_record *a = A, *b = B;
+
+	if (a->ts != b->ts)
+		return a->ts < b->ts ? -1 : 1;
+
+	return a->seq < b->seq ? -1 : a->seq > b->seq;
+}
+
+/* Decodes a record of the chunk into the version 1 stream, indexing it */
+static inline void
+trace_decode_record(struct trace_decoder *d, uint64_t *ts)
+{
+	struct trace_record *rec;
+	uint8_t cmd = *d->ptr++;
+	size_t start = d->len;
+	uint32_t exec = 0;
+
+	*ts += trace_get(d);
+
+	if (cmd != BATCH_HASH)
+		trace_put(d, cmd, 1);
+
+	switch (cmd) {
+	case ADD_BO:
+		trace_copy(d, 4);
+		trace_copy(d, 8);
+		break;
+	case DEL_BO:
+	case ADD_CTX:
+	case DEL_CTX:
+	case WAIT:
+		trace_copy(d, 4);
+		break;
+	case EXEC: {
+		uint64_t count;
+
+		exec = trace_get(d);
+		count = trace_get(d);
+		trace_put(d, count, 4);
+		trace_copy(d, 8);
+		trace_copy(d, 4);
+		for (uint64_t i = 0; i < count && !d->error; i++) {
+			uint64_t relocs;
+
+			trace_copy(d, 4);
+			relocs = trace_get(d);
+			trace_put(d, relocs, 4);
+			for (int n = 0; n < 5; n++)
+				trace_copy(d, 8);
+
+			for (uint64_t j = 0; j < relocs && !d->error; j++) {
+				trace_copy(d, 4);
+				trace_copy(d, 4);
+				trace_copy(d, 8);
+				trace_copy(d, 8);
+				trace_copy(d, 4);
+				trace_copy(d, 4);
+			}
+		}
+		break;
+	}
+	case TIMING: {
+		uint64_t latency;
+
+		exec = trace_get(d);
+		latency = trace_get(d);
+		trace_put(d, exec, 4);
+		trace_put(d, *ts - latency, 8);
+		trace_put(d, *ts, 8);
+		break;
+	}
+	case BATCH_HASH:
+		/* Not part of version 1 */
+		trace_get(d);
+		trace_get(d);
+		return;
+	default:
+		d->error = 1;
+		return;
+	}
+
+	if (d->num_records == d->max_records) {
+		d->max_records = d->max_records ? 2 * d->max_records : 4096;
+		d->records = realloc(d->records,
+				     d->max_records * sizeof(*d->records));
+		if (!d->records)
+			abort();
+	}
+
+	rec = &d->records[d->num_records];
+	rec->ts = *ts;
+	rec->seq = d->num_records++;
+	rec->off = start;
+	rec->len = d->len - start;
+	rec->exec = exec;
+}
+
+/*
+ * Decodes the chunks of a version 2 trace, from just after its version to
+ * @end, into a version 1 stream. The records of all the threads are sorted
+ * by their timestamps, keeping the order of each thread, and the execs are
+ * renumbered in that order for the timings to refer to them. Returns the
+ * stream, to be freed by the caller, and its length, or NULL if the trace
+ * is malformed.
+ */
+static inline uint8_t *
+trace_decode(const uint8_t *ptr, const uint8_t *end, size_t *len)
+{
+	struct trace_decoder d = { .ptr = ptr, .end = end };
+	uint32_t *execs = NULL;
+	uint32_t num_execs = 0, max_exec = 0;
+	uint8_t *out = NULL;
+	size_t out_len = 0;
+
+	while (d.ptr < d.end && !d.error) {
+		const uint8_t *chunk_end;
+		uint64_t ts, size;
+
+		trace_get(&d); /* thread */
+		ts = trace_get(&d);
+		size = trace_get(&d);
+
+		/* A chunk cut short by the application dying ends the trace */
+		if (d.error || size > d.end - d.ptr) {
+			d.error = 0;
+			break;
+		}
+
+		chunk_end = d.ptr + size;
+		d.end = chunk_end;
+		while (d.ptr < chunk_end && !d.error)
+			trace_decode_record(&d, &ts);
+		d.end = end;
+	}
+	if (d.error)
+		goto out;
+
+	qsort(d.records, d.num_records, sizeof(*d.records), trace_cmp_record);
+
+	for (size_t i = 0; i < d.num_records; i++) {
+		const struct trace_record *rec = &d.records[i];
+
+		if (d.out[rec->off] == EXEC && rec->exec >= max_exec)
+			max_exec = rec->exec + 1;
+	}
+
+	execs = malloc(max_exec * sizeof(*execs) + 1);
+	out = malloc(d.len + 1);
+	if (!execs || !out)
+		abort();
+	memset(execs, 0xff, max_exec * sizeof(*execs));
+
+	for (size_t i = 0; i < d.num_records; i++) {
+		const struct trace_record *rec = &d.records[i];
+
+		if (d.out[rec->off] == EXEC)
+			execs[rec->exec] = num_execs++;
+	}
+
+	for (size_t i = 0; i < d.num_records; i++) {
+		const struct trace_record *rec = &d.records[i];
+		uint8_t *dst = out + out_len;
+
+		/* Timings of execs missing from the trace are dropped */
+		if (d.out[rec->off] == TIMING &&
+		    (rec->exec >= max_exec || execs[rec->exec] == ~0u))
+			continue;
+
+		memcpy(dst, d.out + rec->off, rec->len);
+		if (*dst == TIMING)
+			memcpy(dst + 1, &execs[rec->exec], 4);
+		out_len += rec->len;
+	}
+
+	*len = out_len;
+out:
+	free(execs);
+	free(d.records);
+	free(d.out);
+	return out;
+}
+
+#endif /* GEM_EXEC_TRACE_H */
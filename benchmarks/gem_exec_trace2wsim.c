@@ -0,0 +1,593 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2024 Intel Corporation
+ */
+
+/*
+ * Converts a trace recorded with the gem_exec_tracer LD_PRELOAD library into
+ * a gem_wsim workload descriptor, so that a real application can be replayed
+ * with many clients and scaled batch durations.
+ *
+ * Every execbuf becomes a batch on the engine it was submitted to, in a
+ * context numbered in order of first use. The buffer objects it used become
+ * the objects of working set 1, referenced as read or write dependencies so
+ * that gem_wsim recreates the implicit synchronisation between the batches.
+ * Waiting on a buffer becomes a sync on the last batch which used it.
+ *
+ * Batch durations are taken from the submission and completion times added to
+ * the trace when it was recorded with GEM_EXEC_TRACER_TIMING set, less the
+ * time each batch spent queued behind the previous one on its engine. Traces
+ * without timing use a fixed duration.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "drm.h"
+#include "i915_drm.h"
+
+#include "gem_exec_trace.h"
+
+#ifndef ARRAY_SIZE
+#define ARRAY_SIZE(arr) (sizeof(arr) / sizeof(arr[0]))
+#endif
+
+static const char *engines[] = { "RCS", "BCS", "VCS", "VCS1", "VCS2", "VECS" };
+
+struct bo {
+	uint64_t size;
+	int object;		/* index in the working set, -1 if unused */
+	int last_step;		/* last batch using the bo, -1 if none */
+	int synced_step;	/* last batch waited upon through the bo */
+	unsigned int written;	/* exec which last wrote the bo */
+	uint64_t ready_ns;	/* completion of the last write */
+};
+
+struct dep {
+	int object;
+	bool write;
+};
+
+static struct {
+	unsigned int first;
+	unsigned int count;
+	unsigned int duration_us;
+} opt = {
+	.count = ~0u,
+	.duration_us = 1000,
+};
+
+static struct {
+	uint64_t submit_ns;
+	uint64_t complete_ns;
+} *timings;
+static unsigned int num_timings;
+
+static struct bo *bos;
+static unsigned int num_bos;
+
+static uint64_t *objects; /* sizes of the working set objects */
+static unsigned int num_objects;
+
+static uint32_t *contexts;
+static unsigned int num_contexts;
+
+static int engine_index(uint64_t flags)
+{
+	switch (flags & I915_EXEC_RING_MASK) {
+	case I915_EXEC_DEFAULT:
+	case I915_EXEC_RENDER:
+		return 0;
+	case I915_EXEC_BLT:
+		return 1;
+	case I915_EXEC_BSD:
+		switch (flags & I915_EXEC_BSD_MASK) {
+		case I915_EXEC_BSD_RING1:
+			return 3;
+		case I915_EXEC_BSD_RING2:
+			return 4;
+		default:
+			return 2;
+		}
+	case I915_EXEC_VEBOX:
+		return 5;
+	default:
+		return -1;
+	}
+}
+
+static struct bo *lookup_bo(uint32_t handle)
+{
+	if (handle >= num_bos) {
+		unsigned int n = (handle + 4096) & ~4095;
+
+		bos = realloc(bos, n * sizeof(*bos));
+		if (!bos)
+			abort();
+
+		for (; num_bos < n; num_bos++)
+			bos[num_bos] = (struct bo){
+				.object = -1,
+				.last_step = -1,
+				.synced_step = -1,
+				.written = ~0u,
+			};
+	}
+
+	return &bos[handle];
+}
+
+static unsigned int context_index(uint32_t handle)
+{
+	unsigned int i;
+
+	for (i = 0; i < num_contexts; i++) {
+		if (contexts[i] == handle)
+			return i + 1;
+	}
+
+	contexts = realloc(contexts, (num_contexts + 1) * sizeof(*contexts));
+	if (!contexts)
+		abort();
+	contexts[num_contexts++] = handle;
+
+	return num_contexts;
+}
+
+static int object_index(struct bo *bo)
+{
+	if (bo->object < 0) {
+		objects = realloc(objects, (num_objects + 1) * sizeof(*objects));
+		if (!objects)
+			abort();
+
+		/* Objects not created under the tracer have an unknown size */
+		objects[num_objects] = bo->size ?: 4096;
+		bo->object = num_objects++;
+	}
+
+	return bo->object;
+}
+
+static int cmp_dep(const void *A, const void *B)
+{
+	const struct dep *a = A, *b = B;
+
+	return a->object - b->object;
+}
+
+static void write_deps(FILE *out, struct dep *deps, unsigned int count)
+{
+	unsigned int i, j;
+
+	qsort(deps, count, sizeof(*deps), cmp_dep);
+
+	for (i = 0; i < count; i = j) {
+		for (j = i + 1; j < count; j++) {
+			if (deps[j].object != deps[j - 1].object + 1 ||
+			    deps[j].write != deps[i].write)
+				break;
+		}
+
+		fprintf(out, "%s%c1-%d", i ? "/" : "",
+			deps[i].write ? 'w' : 'r', deps[i].object);
+		if (j - i > 1)
+			fprintf(out, "-%d", deps[j - 1].object);
+	}
+}
+
+static void write_working_set(FILE *out)
+{
+	unsigned int i, j;
+
+	fprintf(out, "w.1.");
+	for (i = 0; i < num_objects; i = j) {
+		for (j = i + 1; j < num_objects; j++) {
+			if (objects[j] != objects[i])
+				break;
+		}
+
+		fprintf(out, "%s", i ? "/" : "");
+		if (j - i > 1)
+			fprintf(out, "%un", j - i);
+		fprintf(out, "%" PRIu64, objects[i]);
+	}
+	fprintf(out, "\n");
+}
+
+static uint8_t *skip_exec(uint8_t *ptr)
+{
+	const struct trace_exec *t = (void *)ptr;
+
+	ptr = (void *)(t + 1);
+	for (uint32_t i = 0; i < t->object_count; i++) {
+		const struct trace_exec_object *to = (void *)ptr;
+
+		ptr = (void *)(to + 1);
+		ptr += sizeof(struct trace_exec_relocation) *
+		       to->relocation_count;
+	}
+
+	return ptr;
+}
+
+static int load_timings(uint8_t *ptr, uint8_t *end)
+{
+	do switch (*ptr++) {
+	case ADD_BO:
+		ptr += sizeof(struct trace_add_bo);
+		break;
+	case DEL_BO:
+		ptr += sizeof(struct trace_del_bo);
+		break;
+	case ADD_CTX:
+		ptr += sizeof(struct trace_add_ctx);
+		break;
+	case DEL_CTX:
+		ptr += sizeof(struct trace_del_ctx);
+		break;
+	case EXEC:
+		ptr = skip_exec(ptr);
+		break;
+	case WAIT:
+		ptr += sizeof(struct trace_wait);
+		break;
+	case TIMING:
+		{
+			struct trace_timing *t = (void *)ptr;
+			ptr = (void *)(t + 1);
+
+			if (t->exec >= num_timings) {
+				unsigned int n = (t->exec + 4096) & ~4095;
+
+				timings = realloc(timings, n * sizeof(*timings));
+				if (!timings)
+					abort();
+				memset(timings + num_timings, 0,
+				       (n - num_timings) * sizeof(*timings));
+				num_timings = n;
+			}
+
+			timings[t->exec].submit_ns = t->submit_ns;
+			timings[t->exec].complete_ns = t->complete_ns;
+			break;
+		}
+	default:
+		fprintf(stderr, "Unknown cmd: %x\n", *--ptr);
+		return -1;
+	} while (ptr < end);
+
+	return 0;
+}
+
+/*
+ * Only the time after the previous batch on the engine and the batches it
+ * depends upon completed is spent executing.
+ */
+static unsigned int
+batch_duration(unsigned int exec, uint64_t ready_ns, uint64_t *engine_idle)
+{
+	uint64_t start, end;
+
+	if (exec >= num_timings || !timings[exec].complete_ns)
+		return opt.duration_us;
+
+	start = timings[exec].submit_ns;
+	if (ready_ns > start)
+		start = ready_ns;
+	if (*engine_idle > start)
+		start = *engine_idle;
+	end = timings[exec].complete_ns;
+	if (end > *engine_idle)
+		*engine_idle = end;
+
+	return end > start + 1000 ? (end - start) / 1000 : 1;
+}
+
+struct converter {
+	FILE *steps;
+	unsigned int exec;
+	unsigned int step;
+	unsigned int skipped;
+	uint64_t engine_idle[ARRAY_SIZE(engines)];
+	struct dep *deps;
+	const struct trace_exec_object **objs;
+	unsigned int max_objs;
+};
+
+static uint8_t *convert_exec(struct converter *c, uint8_t *ptr)
+{
+	const struct trace_exec *t = (void *)ptr;
+	int engine = engine_index(t->flags);
+	unsigned int exec = c->exec++;
+	uint64_t ready_ns = 0;
+	unsigned int duration;
+	bool in_range;
+
+	if (t->object_count > c->max_objs) {
+		c->max_objs = t->object_count;
+		c->deps = realloc(c->deps, c->max_objs * sizeof(*c->deps));
+		c->objs = realloc(c->objs, c->max_objs * sizeof(*c->objs));
+		if (!c->deps || !c->objs)
+			abort();
+	}
+
+	ptr = (void *)(t + 1);
+	for (uint32_t i = 0; i < t->object_count; i++) {
+		const struct trace_exec_object *to = (void *)ptr;
+
+		c->objs[i] = to;
+		ptr = (void *)(to + 1);
+		ptr += sizeof(struct trace_exec_relocation) *
+		       to->relocation_count;
+	}
+
+	/* Objects written through relocations */
+	for (uint32_t i = 0; i < t->object_count; i++) {
+		const struct trace_exec_relocation *r = (void *)(c->objs[i] + 1);
+
+		for (uint32_t j = 0; j < c->objs[i]->relocation_count; j++) {
+			uint32_t handle = r[j].target_handle;
+
+			if (!r[j].write_domain)
+				continue;
+
+			if (t->flags & I915_EXEC_HANDLE_LUT) {
+				if (handle >= t->object_count)
+					continue;
+				handle = c->objs[handle]->handle;
+			}
+
+			lookup_bo(handle)->written = exec;
+		}
+	}
+
+	for (uint32_t i = 0; i < t->object_count; i++) {
+		struct bo *bo = lookup_bo(c->objs[i]->handle);
+
+		if (c->objs[i]->flags & EXEC_OBJECT_WRITE)
+			bo->written = exec;
+		if (bo->ready_ns > ready_ns)
+			ready_ns = bo->ready_ns;
+	}
+
+	if (engine < 0) {
+		c->skipped++;
+		return ptr;
+	}
+
+	duration = batch_duration(exec, ready_ns, &c->engine_idle[engine]);
+	in_range = exec >= opt.first && exec - opt.first < opt.count;
+
+	for (uint32_t i = 0; i < t->object_count; i++) {
+		struct bo *bo = lookup_bo(c->objs[i]->handle);
+
+		if (bo->written == exec && exec < num_timings)
+			bo->ready_ns = timings[exec].complete_ns;
+
+		if (!in_range)
+			continue;
+
+		c->deps[i].object = object_index(bo);
+		c->deps[i].write = bo->written == exec;
+		bo->last_step = c->step;
+	}
+
+	if (in_range) {
+		fprintf(c->steps, "%u.%s.%u.", context_index(t->context),
+			engines[engine], duration);
+		write_deps(c->steps, c->deps, t->object_count);
+		fprintf(c->steps, ".0\n");
+		c->step++;
+	}
+
+	return ptr;
+}
+
+static int
+convert(uint8_t *ptr, uint8_t *end, FILE *steps, unsigned int *num_steps)
+{
+	struct converter c = {
+		.steps = steps,
+		.step = 1, /* step 0 is the working set */
+	};
+	int ret = 0;
+
+	do switch (*ptr++) {
+	case ADD_BO:
+		{
+			struct trace_add_bo *t = (void *)ptr;
+			ptr = (void *)(t + 1);
+
+			*lookup_bo(t->handle) = (struct bo){
+				.size = t->size,
+				.object = -1,
+				.last_step = -1,
+				.synced_step = -1,
+				.written = ~0u,
+			};
+			break;
+		}
+	case DEL_BO:
+		{
+			struct trace_del_bo *t = (void *)ptr;
+			ptr = (void *)(t + 1);
+
+			*lookup_bo(t->handle) = (struct bo){
+				.object = -1,
+				.last_step = -1,
+				.synced_step = -1,
+				.written = ~0u,
+			};
+			break;
+		}
+	case ADD_CTX:
+		ptr += sizeof(struct trace_add_ctx);
+		break;
+	case DEL_CTX:
+		ptr += sizeof(struct trace_del_ctx);
+		break;
+	case EXEC:
+		ptr = convert_exec(&c, ptr);
+		break;
+	case WAIT:
+		{
+			struct trace_wait *t = (void *)ptr;
+			struct bo *bo = lookup_bo(t->handle);
+			ptr = (void *)(t + 1);
+
+			if (bo->last_step < 0 || bo->last_step == bo->synced_step)
+				break;
+
+			fprintf(steps, "s.-%u\n", c.step - bo->last_step);
+			bo->synced_step = bo->last_step;
+			c.step++;
+			break;
+		}
+	case TIMING:
+		ptr += sizeof(struct trace_timing);
+		break;
+	default:
+		fprintf(stderr, "Unknown cmd: %x\n", *--ptr);
+		ret = -1;
+		break;
+	} while (!ret && ptr < end);
+
+	if (c.skipped)
+		fprintf(stderr,
+			"Skipped %u batches submitted to unknown engines\n",
+			c.skipped);
+
+	free(c.objs);
+	free(c.deps);
+	*num_steps = c.step;
+	return ret;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"Usage: %s [-s <first>] [-n <count>] [-d <us>] [-o <file>] <trace>\n"
+		"\n"
+		"  -s <first>  First execbuf of the trace to convert.\n"
+		"  -n <count>  Number of execbufs to convert.\n"
+		"  -d <us>     Batch duration when the trace has no timing.\n"
+		"  -o <file>   Write the workload to the file instead of stdout.\n",
+		name);
+}
+
+int main(int argc, char **argv)
+{
+	const struct trace_version *tv;
+	const char *output = NULL;
+	unsigned int num_steps = 0;
+	char *buf = NULL;
+	size_t len = 0, trace_len;
+	uint8_t *ptr, *end;
+	struct stat st;
+	FILE *steps, *out;
+	int fd, c;
+
+	while ((c = getopt(argc, argv, "s:n:d:o:h")) != -1) {
+		switch (c) {
+		case 's':
+			opt.first = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			opt.count = strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			opt.duration_us = strtoul(optarg, NULL, 0) ?: 1;
+			break;
+		case 'o':
+			output = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return c == 'h' ? 0 : 1;
+		}
+	}
+
+	if (optind + 1 != argc) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	fd = open(argv[optind], O_RDONLY);
+	if (fd < 0 || fstat(fd, &st) < 0) {
+		fprintf(stderr, "%s: %s\n", argv[optind], strerror(errno));
+		return 1;
+	}
+
+	ptr = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (ptr == MAP_FAILED) {
+		fprintf(stderr, "%s: %s\n", argv[optind], strerror(errno));
+		return 1;
+	}
+	end = ptr + st.st_size;
+
+	tv = (void *)ptr;
+	if (st.st_size < sizeof(*tv) || tv->magic != TRACE_MAGIC) {
+		fprintf(stderr, "%s: invalid magic\n", argv[optind]);
+		return 1;
+	}
+	if (tv->version != 1 && tv->version != 2) {
+		fprintf(stderr, "%s: unhandled version %d\n",
+			argv[optind], tv->version);
+		return 1;
+	}
+	ptr = (void *)(tv + 1);
+
+	if (tv->version == 2) {
+		ptr = trace_decode(ptr, end, &trace_len);
+		if (!ptr) {
+			fprintf(stderr, "%s: malformed trace\n", argv[optind]);
+			return 1;
+		}
+		end = ptr + trace_len;
+	}
+
+	if (ptr < end && load_timings(ptr, end))
+		return 1;
+
+	steps = open_memstream(&buf, &len);
+	if (!steps)
+		return 1;
+
+	if (ptr < end && convert(ptr, end, steps, &num_steps))
+		return 1;
+	fclose(steps);
+
+	if (!num_objects) {
+		fprintf(stderr, "%s: no execbuf to convert\n", argv[optind]);
+		return 1;
+	}
+
+	out = output ? fopen(output, "w") : stdout;
+	if (!out) {
+		fprintf(stderr, "%s: %s\n", output, strerror(errno));
+		return 1;
+	}
+
+	fprintf(out, "# Converted from %s: %u steps, %u contexts, %u objects",
+		argv[optind], num_steps, num_contexts, num_objects);
+	fprintf(out, "%s\n", num_timings ? "" : ", no timing");
+	write_working_set(out);
+	fwrite(buf, 1, len, out);
+
+	if (out != stdout)
+		fclose(out);
+	free(buf);
+
+	return 0;
+}
@@ -37,10 +37,13 @@
 #include <dlfcn.h>
 #include <i915_drm.h>
 #include <pthread.h>
+#include <time.h>
 
 #include "intel_aub.h"
 #include "intel_chipset.h"
 
+#include "gem_exec_trace.h"
+
 #ifdef __FreeBSD__
 #include "igt_freebsd.h"
 #endif
@@ -52,78 +55,88 @@ static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
 
 struct trace {
 	int fd;
-	FILE *file;
+	int out;
+	uint32_t num_exec;
 	struct trace *next;
 } *traces;
 
-#define DRM_MAJOR 226
+/*
+ * Bumped whenever a trace is added or removed, invalidating the trace each
+ * thread last looked up.
+ */
+static unsigned int traces_gen;
 
-enum {
-	ADD_BO = 0,
-	DEL_BO,
-	ADD_CTX,
-	DEL_CTX,
-	EXEC,
-	WAIT,
+static __thread struct {
+	int fd;
+	unsigned int gen;
+	struct trace *trace;
+} last_trace = { .fd = -1 };
+
+/*
+ * The records are encoded into chunks of a per thread buffer, without
+ * taking any lock shared with the other threads, and a background thread
+ * appends the chunks to the trace files every FLUSH_INTERVAL_US. The
+ * threads are merged back in timestamp order when the trace is read.
+ */
+#define CHUNK_SIZE (256 << 10)
+#define FLUSH_INTERVAL_US 10000
+#define VARINT_MAX 10
+
+struct chunk {
+	struct trace *trace;
+	uint32_t tid;
+	uint64_t base_ns, last_ns;
+	size_t len, size;
+	struct chunk *next;
+	uint8_t data[];
 };
 
-static struct trace_verion {
-	uint32_t magic;
-	uint32_t version;
-} version = {
-	.magic = 0xdeadbeef,
-	.version = 1
+struct thread_buf {
+	pthread_mutex_t mutex;
+	struct chunk *chunk;
+	uint32_t tid;
+	struct thread_buf *next;
 };
 
-struct trace_add_bo {
-	uint8_t cmd;
-	uint32_t handle;
-	uint64_t size;
-} __attribute__((packed));
-struct trace_del_bo {
-	uint8_t cmd;
-	uint32_t handle;
-}__attribute__((packed));
+/* Lock order: buf_mutex, then a thread_buf mutex, then queue_mutex */
+static pthread_mutex_t flush_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t buf_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct thread_buf *buffers;
+static struct chunk *queued, **queued_tail = &queued;
+static pthread_key_t buf_key;
+static __thread struct thread_buf *self;
+static uint32_t next_tid;
+static bool writer_started;
 
-struct trace_add_ctx {
-	uint8_t cmd;
-	uint32_t handle;
-} __attribute__((packed));
-struct trace_del_ctx {
-	uint8_t cmd;
+/*
+ * With GEM_EXEC_TRACER_TIMING set in the environment, the batch of every
+ * execbuf is polled for completion from a separate thread and the submission
+ * and completion times are added to the trace.
+ */
+static struct pending_exec {
+	int fd;
 	uint32_t handle;
-}__attribute__((packed));
+	uint32_t exec;
+	uint64_t submit_ns;
+} *pending;
+static unsigned int num_pending, max_pending;
+static bool timing;
 
-struct trace_exec {
-	uint8_t cmd;
-	uint32_t object_count;
-	uint64_t flags;
-	uint32_t context;
-}__attribute__((packed));
+/*
+ * With GEM_EXEC_TRACER_HASH set, the batch of every execbuf is read back
+ * and its hash added to the trace, to tell which submissions ran the same
+ * commands.
+ */
+#define HASH_MAX (64 << 10)
+static bool hashing;
 
-struct trace_exec_object {
-	uint32_t handle;
-	uint32_t relocation_count;
-	uint64_t alignment;
-	uint64_t offset;
-	uint64_t flags;
-	uint64_t rsvd1;
-	uint64_t rsvd2;
-}__attribute__((packed));
-
-struct trace_exec_relocation {
-	uint32_t target_handle;
-	uint32_t delta;
-	uint64_t offset;
-	uint64_t presumed_offset;
-	uint32_t read_domains;
-	uint32_t write_domain;
-}__attribute__((packed));
-
-struct trace_wait {
-	uint8_t cmd;
-	uint32_t handle;
-} __attribute__((packed));
+#define DRM_MAJOR 226
+
+static const struct trace_version version = {
+	.magic = TRACE_MAGIC,
+	.version = 2
+};
 
 static void __attribute__ ((format(__printf__, 2, 3)))
 fail_if(int cond, const char *format, ...)
@@ -140,86 +153,445 @@ fail_if(int cond, const char *format, ...)
 	abort();
 }
 
-static void
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static uint8_t *put(uint8_t *p, uint64_t v)
+{
+	while (v >= 0x80) {
+		*p++ = v | 0x80;
+		v >>= 7;
+	}
+	*p++ = v;
+
+	return p;
+}
+
+static void write_all(int fd, const void *data, size_t len)
+{
+	while (len) {
+		ssize_t ret = write(fd, data, len);
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "failed to write the trace: %m\n");
+			return;
+		}
+
+		data = (const uint8_t *)data + ret;
+		len -= ret;
+	}
+}
+
+static void write_chunk(const struct chunk *c)
+{
+	uint8_t hdr[3 * VARINT_MAX], *p = hdr;
+
+	p = put(p, c->tid);
+	p = put(p, c->base_ns);
+	p = put(p, c->len);
+
+	write_all(c->trace->out, hdr, p - hdr);
+	write_all(c->trace->out, c->data, c->len);
+}
+
+/* Called with the thread_buf mutex held */
+static void queue_chunk(struct chunk *c)
+{
+	pthread_mutex_lock(&queue_mutex);
+	*queued_tail = c;
+	queued_tail = &c->next;
+	pthread_mutex_unlock(&queue_mutex);
+}
+
+/*
+ * Writes out all the chunks recorded so far. The full chunks of a thread
+ * were queued before its current one, so each thread stays in order.
+ */
+static void flush(void)
+{
+	struct chunk *list = NULL, **tail = &list, *c;
+	struct thread_buf *tb;
+
+	pthread_mutex_lock(&flush_mutex);
+
+	pthread_mutex_lock(&buf_mutex);
+	for (tb = buffers; tb; tb = tb->next) {
+		pthread_mutex_lock(&tb->mutex);
+
+		pthread_mutex_lock(&queue_mutex);
+		if (queued) {
+			*tail = queued;
+			tail = queued_tail;
+			queued = NULL;
+			queued_tail = &queued;
+		}
+		pthread_mutex_unlock(&queue_mutex);
+
+		if (tb->chunk && tb->chunk->len) {
+			*tail = tb->chunk;
+			tail = &tb->chunk->next;
+			tb->chunk = NULL;
+		}
+
+		pthread_mutex_unlock(&tb->mutex);
+	}
+	pthread_mutex_lock(&queue_mutex);
+	if (queued) {
+		*tail = queued;
+		tail = queued_tail;
+		queued = NULL;
+		queued_tail = &queued;
+	}
+	pthread_mutex_unlock(&queue_mutex);
+	pthread_mutex_unlock(&buf_mutex);
+
+	while ((c = list)) {
+		list = c->next;
+		write_chunk(c);
+		free(c);
+	}
+
+	pthread_mutex_unlock(&flush_mutex);
+}
+
+static void *
+writer_thread(void *arg)
+{
+	for (;;) {
+		usleep(FLUSH_INTERVAL_US);
+		flush();
+	}
+
+	return NULL;
+}
+
+/* Hands the last chunk of an exiting thread over to the writer */
+static void thread_buf_fini(void *arg)
+{
+	struct thread_buf *tb = arg, **p;
+
+	pthread_mutex_lock(&buf_mutex);
+	for (p = &buffers; *p; p = &(*p)->next) {
+		if (*p == tb) {
+			*p = tb->next;
+			break;
+		}
+	}
+
+	pthread_mutex_lock(&tb->mutex);
+	if (tb->chunk && tb->chunk->len)
+		queue_chunk(tb->chunk);
+	else
+		free(tb->chunk);
+	pthread_mutex_unlock(&tb->mutex);
+	pthread_mutex_unlock(&buf_mutex);
+
+	pthread_mutex_destroy(&tb->mutex);
+	free(tb);
+}
+
+static struct thread_buf *thread_buf(void)
+{
+	struct thread_buf *tb = self;
+
+	if (tb)
+		return tb;
+
+	tb = calloc(1, sizeof(*tb));
+	fail_if(!tb, "failed to allocate the trace buffer\n");
+
+	pthread_mutex_init(&tb->mutex, NULL);
+	tb->tid = __atomic_fetch_add(&next_tid, 1, __ATOMIC_RELAXED);
+
+	pthread_mutex_lock(&buf_mutex);
+	tb->next = buffers;
+	buffers = tb;
+	pthread_mutex_unlock(&buf_mutex);
+
+	pthread_setspecific(buf_key, tb);
+	self = tb;
+
+	return tb;
+}
+
+/*
+ * Starts a record of at most @fields varints, taken at @ts, in the buffer of
+ * the thread. The fields are written at the returned pointer and the record
+ * is completed by record_end().
+ */
+static uint8_t *
+record_begin(struct trace *trace, uint8_t cmd, uint64_t ts, size_t fields)
+{
+	struct thread_buf *tb = thread_buf();
+	size_t need = 1 + (fields + 1) * VARINT_MAX;
+	struct chunk *c;
+	uint8_t *p;
+
+	pthread_mutex_lock(&tb->mutex);
+
+	c = tb->chunk;
+	if (c && (c->trace != trace || c->len + need > c->size)) {
+		queue_chunk(c);
+		c = NULL;
+	}
+
+	if (!c) {
+		size_t size = need > CHUNK_SIZE ? need : CHUNK_SIZE;
+
+		c = malloc(sizeof(*c) + size);
+		fail_if(!c, "failed to allocate a trace chunk\n");
+
+		c->trace = trace;
+		c->tid = tb->tid;
+		c->len = 0;
+		c->size = size;
+		c->next = NULL;
+		tb->chunk = c;
+	}
+
+	if (!c->len)
+		c->base_ns = c->last_ns = ts;
+
+	p = c->data + c->len;
+	*p++ = cmd;
+	p = put(p, ts - c->last_ns);
+	c->last_ns = ts;
+
+	return p;
+}
+
+static void record_end(uint8_t *p)
+{
+	struct thread_buf *tb = self;
+
+	tb->chunk->len = p - tb->chunk->data;
+	pthread_mutex_unlock(&tb->mutex);
+}
+
+static uint32_t
 trace_exec(struct trace *trace,
 	   const struct drm_i915_gem_execbuffer2 *execbuffer2)
 {
 #define to_ptr(T, x) ((T *)(uintptr_t)(x))
 	const struct drm_i915_gem_exec_object2 *exec_objects =
 		to_ptr(typeof(*exec_objects), execbuffer2->buffers_ptr);
+	size_t fields = 4;
+	uint32_t exec;
+	uint8_t *p;
 
 	fail_if(execbuffer2->flags & (I915_EXEC_FENCE_IN | I915_EXEC_FENCE_OUT),
 		"fences not supported yet\n");
 
-	flockfile(trace->file);
-	{
-		struct trace_exec t = {
-			EXEC,
-			execbuffer2->buffer_count,
-			execbuffer2->flags,
-			execbuffer2->rsvd1,
-		};
-		fwrite(&t, sizeof(t), 1, trace->file);
-	}
+	for (uint32_t i = 0; i < execbuffer2->buffer_count; i++)
+		fields += 7 + 6 * exec_objects[i].relocation_count;
+
+	exec = __atomic_fetch_add(&trace->num_exec, 1, __ATOMIC_RELAXED);
+
+	p = record_begin(trace, EXEC, now_ns(), fields);
+	p = put(p, exec);
+	p = put(p, execbuffer2->buffer_count);
+	p = put(p, execbuffer2->flags);
+	p = put(p, execbuffer2->rsvd1);
 
 	for (uint32_t i = 0; i < execbuffer2->buffer_count; i++) {
 		const struct drm_i915_gem_exec_object2 *obj = &exec_objects[i];
 		const struct drm_i915_gem_relocation_entry *relocs =
 			to_ptr(typeof(*relocs), obj->relocs_ptr);
-		{
-			struct trace_exec_object t = {
-				obj->handle,
-				obj->relocation_count,
-				obj->alignment,
-				obj->offset,
-				obj->flags,
-				obj->rsvd1,
-				obj->rsvd2
-			};
-			fwrite(&t, sizeof(t), 1, trace->file);
+
+		p = put(p, obj->handle);
+		p = put(p, obj->relocation_count);
+		p = put(p, obj->alignment);
+		p = put(p, obj->offset);
+		p = put(p, obj->flags);
+		p = put(p, obj->rsvd1);
+		p = put(p, obj->rsvd2);
+
+		for (uint32_t j = 0; j < obj->relocation_count; j++) {
+			p = put(p, relocs[j].target_handle);
+			p = put(p, relocs[j].delta);
+			p = put(p, relocs[j].offset);
+			p = put(p, relocs[j].presumed_offset);
+			p = put(p, relocs[j].read_domains);
+			p = put(p, relocs[j].write_domain);
 		}
-		fwrite(relocs, sizeof(*relocs), obj->relocation_count,
-		       trace->file);
 	}
 
-	fflush(trace->file);
-	funlockfile(trace->file);
+	record_end(p);
 #undef to_ptr
+
+	return exec;
+}
+
+static uint32_t
+batch_handle(const struct drm_i915_gem_execbuffer2 *execbuffer2)
+{
+	const struct drm_i915_gem_exec_object2 *exec_objects =
+		(void *)(uintptr_t)execbuffer2->buffers_ptr;
+
+	if (execbuffer2->flags & I915_EXEC_BATCH_FIRST)
+		return exec_objects[0].handle;
+
+	return exec_objects[execbuffer2->buffer_count - 1].handle;
+}
+
+/*
+ * Hashes the batch with FNV-1a, reading it page by page up to batch_len or,
+ * without one, up to HASH_MAX or the end of the object. Batches which can't
+ * be read, such as userptr ones, are not hashed.
+ */
+static void
+trace_batch_hash(struct trace *trace, int fd, uint32_t exec,
+		 const struct drm_i915_gem_execbuffer2 *execbuffer2)
+{
+	uint64_t hash = 0xcbf29ce484222325ull;
+	uint64_t len = execbuffer2->batch_len ?: HASH_MAX;
+	uint64_t offset = execbuffer2->batch_start_offset;
+	uint8_t data[4096];
+	uint8_t *p;
+	bool read = false;
+
+	while (len) {
+		struct drm_i915_gem_pread pread = {
+			.handle = batch_handle(execbuffer2),
+			.offset = offset,
+			.size = len < sizeof(data) ? len : sizeof(data),
+			.data_ptr = (uintptr_t)data,
+		};
+
+		if (libc_ioctl(fd, DRM_IOCTL_I915_GEM_PREAD, &pread))
+			break;
+
+		for (uint64_t i = 0; i < pread.size; i++) {
+			hash ^= data[i];
+			hash *= 0x100000001b3ull;
+		}
+
+		offset += pread.size;
+		len -= pread.size;
+		read = true;
+	}
+
+	if (!read)
+		return;
+
+	p = record_begin(trace, BATCH_HASH, now_ns(), 2);
+	p = put(p, exec);
+	p = put(p, hash);
+	record_end(p);
+}
+
+/* Called with the mutex held */
+static void
+add_pending(int fd, uint32_t handle, uint32_t exec, uint64_t submit_ns)
+{
+	if (num_pending == max_pending) {
+		max_pending = max_pending ? 2 * max_pending : 64;
+		pending = realloc(pending, max_pending * sizeof(*pending));
+		fail_if(!pending, "failed to track pending execbuf\n");
+	}
+
+	pending[num_pending++] = (struct pending_exec){
+		fd, handle, exec, submit_ns
+	};
+}
+
+static void
+trace_timing(struct trace *trace, uint32_t exec, uint64_t submit_ns)
+{
+	uint64_t complete_ns = now_ns();
+	uint8_t *p;
+
+	p = record_begin(trace, TIMING, complete_ns, 2);
+	p = put(p, exec);
+	p = put(p, complete_ns - submit_ns);
+	record_end(p);
+}
+
+static void *
+timing_thread(void *arg)
+{
+	for (;;) {
+		pthread_mutex_lock(&mutex);
+		for (unsigned int i = 0; i < num_pending; ) {
+			struct pending_exec *p = &pending[i];
+			struct drm_i915_gem_busy busy = { .handle = p->handle };
+			struct trace *t;
+			int ret;
+
+			ret = libc_ioctl(p->fd, DRM_IOCTL_I915_GEM_BUSY, &busy);
+			if (!ret && busy.busy) {
+				i++;
+				continue;
+			}
+
+			/* A batch closed before completion yields no timing */
+			for (t = traces; !ret && t; t = t->next) {
+				if (t->fd == p->fd) {
+					trace_timing(t, p->exec, p->submit_ns);
+					break;
+				}
+			}
+
+			*p = pending[--num_pending];
+		}
+		pthread_mutex_unlock(&mutex);
+
+		usleep(10);
+	}
+
+	return NULL;
+}
+
+static void
+trace_handle(struct trace *trace, uint8_t cmd, uint32_t handle)
+{
+	uint8_t *p;
+
+	p = record_begin(trace, cmd, now_ns(), 1);
+	p = put(p, handle);
+	record_end(p);
 }
 
 static void
 trace_wait(struct trace *trace, uint32_t handle)
 {
-	struct trace_wait t = { WAIT, handle };
-	fwrite(&t, sizeof(t), 1, trace->file);
+	trace_handle(trace, WAIT, handle);
 }
 
 static void
 trace_add(struct trace *trace, uint32_t handle, uint64_t size)
 {
-	struct trace_add_bo t = { ADD_BO, handle, size };
-	fwrite(&t, sizeof(t), 1, trace->file);
+	uint8_t *p;
+
+	p = record_begin(trace, ADD_BO, now_ns(), 2);
+	p = put(p, handle);
+	p = put(p, size);
+	record_end(p);
 }
 
 static void
 trace_del(struct trace *trace, uint32_t handle)
 {
-	struct trace_del_bo t = { DEL_BO, handle };
-	fwrite(&t, sizeof(t), 1, trace->file);
+	trace_handle(trace, DEL_BO, handle);
 }
 
 static void
 trace_add_context(struct trace *trace, uint32_t handle)
 {
-	struct trace_add_ctx t = { ADD_CTX, handle };
-	fwrite(&t, sizeof(t), 1, trace->file);
+	trace_handle(trace, ADD_CTX, handle);
 }
 
 static void
 trace_del_context(struct trace *trace, uint32_t handle)
 {
-	struct trace_del_ctx t = { DEL_CTX, handle };
-	fwrite(&t, sizeof(t), 1, trace->file);
+	trace_handle(trace, DEL_CTX, handle);
 }
 
 int
@@ -231,13 +603,25 @@ close(int fd)
 	for (p = &traces; (t = *p); p = &t->next) {
 		if (t->fd == fd) {
 			*p = t->next;
-			fclose(t->file);
-			free(t);
+			__atomic_add_fetch(&traces_gen, 1, __ATOMIC_RELEASE);
 			break;
 		}
 	}
+	for (unsigned int i = 0; i < num_pending; ) {
+		if (pending[i].fd == fd)
+			pending[i] = pending[--num_pending];
+		else
+			i++;
+	}
 	pthread_mutex_unlock(&mutex);
 
+	/* No chunk may refer to the trace once it's freed */
+	if (t) {
+		flush();
+		libc_close(t->out);
+		free(t);
+	}
+
 	return libc_close(fd);
 }
 
@@ -270,24 +654,14 @@ static int is_i915(int fd)
 	return strcmp(name, "i915") == 0;
 }
 
-int
-#ifdef __GLIBC__
-ioctl(int fd, unsigned long request, ...)
-#else
-ioctl(int fd, int request, ...)
-#endif
+/* Returns the trace of an i915 fd, starting it on first use */
+static struct trace *find_trace(int fd)
 {
+	unsigned int gen = __atomic_load_n(&traces_gen, __ATOMIC_ACQUIRE);
 	struct trace *t, **p;
-	va_list args;
-	void *argp;
-	int ret;
 
-	va_start(args, request);
-	argp = va_arg(args, void *);
-	va_end(args);
-
-	if (_IOC_TYPE(request) != DRM_IOCTL_BASE)
-		goto untraced;
+	if (last_trace.fd == fd && last_trace.gen == gen)
+		return last_trace.trace;
 
 	pthread_mutex_lock(&mutex);
 	for (p = &traces; (t = *p); p = &t->next) {
@@ -305,35 +679,73 @@ ioctl(int fd, int request, ...)
 
 		if (!is_i915(fd)) {
 			pthread_mutex_unlock(&mutex);
-			goto untraced;
+			return NULL;
 		}
 
-		t = malloc(sizeof(*t));
-		if (!t) {
-			pthread_mutex_unlock(&mutex);
-			return -ENOMEM;
-		}
+		t = calloc(1, sizeof(*t));
+		fail_if(!t, "failed to allocate the trace\n");
 
 		sprintf(filename, "/tmp/trace-%d.%d", getpid(), fd);
-		t->file = fopen(filename, "w+");
+		t->out = open(filename, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+			      0666);
+		fail_if(t->out < 0, "failed to create %s\n", filename);
+		write_all(t->out, &version, sizeof(version));
 		t->fd = fd;
 
-		if (!fwrite(&version, sizeof(version), 1, t->file)) {
-			pthread_mutex_unlock(&mutex);
-			fclose(t->file);
-			free(t);
-			return -ENOMEM;
-		}
-
 		t->next = traces;
 		traces = t;
+		__atomic_add_fetch(&traces_gen, 1, __ATOMIC_RELEASE);
+
+		if (!writer_started) {
+			pthread_t thread;
+
+			fail_if(pthread_create(&thread, NULL, writer_thread, NULL),
+				"failed to start the writer thread\n");
+			pthread_detach(thread);
+			writer_started = true;
+		}
 	}
+
+	last_trace.fd = fd;
+	last_trace.gen = traces_gen;
+	last_trace.trace = t;
 	pthread_mutex_unlock(&mutex);
 
+	return t;
+}
+
+int
+#ifdef __GLIBC__
+ioctl(int fd, unsigned long request, ...)
+#else
+ioctl(int fd, int request, ...)
+#endif
+{
+	struct trace *t;
+	uint64_t submit_ns = 0;
+	uint32_t exec = 0;
+	va_list args;
+	void *argp;
+	int ret;
+
+	va_start(args, request);
+	argp = va_arg(args, void *);
+	va_end(args);
+
+	if (_IOC_TYPE(request) != DRM_IOCTL_BASE)
+		goto untraced;
+
+	t = find_trace(fd);
+	if (!t)
+		goto untraced;
+
 	switch (request) {
 	case DRM_IOCTL_I915_GEM_EXECBUFFER2:
 	case DRM_IOCTL_I915_GEM_EXECBUFFER2_WR:
-		trace_exec(t, argp);
+		exec = trace_exec(t, argp);
+		if (hashing)
+			trace_batch_hash(t, fd, exec, argp);
+		submit_ns = now_ns();
 		break;
 
 	case DRM_IOCTL_GEM_CLOSE: {
@@ -366,12 +778,27 @@ ioctl(int fd, int request, ...)
 		return ret;
 
 	switch (request) {
+	case DRM_IOCTL_I915_GEM_EXECBUFFER2:
+	case DRM_IOCTL_I915_GEM_EXECBUFFER2_WR:
+		if (timing) {
+			pthread_mutex_lock(&mutex);
+			add_pending(fd, batch_handle(argp), exec, submit_ns);
+			pthread_mutex_unlock(&mutex);
+		}
+		break;
+
 	case DRM_IOCTL_I915_GEM_CREATE: {
 		struct drm_i915_gem_create *create = argp;
 		trace_add(t, create->handle, create->size);
 		break;
 	}
 
+	case DRM_IOCTL_I915_GEM_CREATE_EXT: {
+		struct drm_i915_gem_create_ext *create = argp;
+		trace_add(t, create->handle, create->size);
+		break;
+	}
+
 	case DRM_IOCTL_I915_GEM_USERPTR: {
 		struct drm_i915_gem_userptr *userptr = argp;
 		trace_add(t, userptr->handle, userptr->user_size);
@@ -403,6 +830,12 @@ ioctl(int fd, int request, ...)
 		trace_add_context(t, create->ctx_id);
 		break;
 	}
+
+	case DRM_IOCTL_I915_GEM_CONTEXT_CREATE_EXT: {
+		struct drm_i915_gem_context_create_ext *create = argp;
+		trace_add_context(t, create->ctx_id);
+		break;
+	}
 	}
 
 	return 0;
@@ -418,4 +851,23 @@ init(void)
 	libc_ioctl = dlsym(RTLD_NEXT, "ioctl");
 	fail_if(libc_close == NULL || libc_ioctl == NULL,
 		"failed to get libc ioctl or close\n");
+
+	fail_if(pthread_key_create(&buf_key, thread_buf_fini),
+		"failed to create the trace buffer key\n");
+	hashing = getenv("GEM_EXEC_TRACER_HASH");
+
+	if (getenv("GEM_EXEC_TRACER_TIMING")) {
+		pthread_t thread;
+
+		timing = true;
+		fail_if(pthread_create(&thread, NULL, timing_thread, NULL),
+			"failed to start the timing thread\n");
+		pthread_detach(thread);
+	}
+}
+
+static void __attribute__ ((destructor))
+fini(void)
+{
+	flush();
 }
@@ -45,15 +45,24 @@
 #include "drm.h"
 #include "i915/gem_create.h"
 #include "igt.h"
+#include "igt_bench.h"
 #include "igt_device.h"
+#include "xe/xe_ioctl.h"
+#include "xe/xe_query.h"
+#include "xe/xe_spin.h"
 
 #define CONTEXT		0x1
 #define REALTIME	0x2
 #define CMDPARSER	0x4
 #define FENCE_OUT	0x8
+#define HISTOGRAM	0x10
+
+/* Significant bits kept in the latency histograms */
+#define PRECISION	7
 
 static int done;
 static int fd;
+static bool is_xe;
 static volatile uint32_t *timestamp_reg;
 static struct intel_mmio_data mmio_data;
 
@@ -106,10 +115,24 @@ struct consumer {
 
 	int go;
 
-	struct igt_mean latency;
+	igt_stats_t latency;
 	struct producer *producer;
 };
 
+/*
+ * On xe everything a producer submits lives in a single object: the latency
+ * batch stores RING_TIMESTAMP and signals the user fence the consumers wait
+ * upon.
+ */
+struct xe_latency {
+	uint32_t nop[2];
+	uint32_t batch[14];
+	uint64_t fence;
+	uint32_t timestamp;
+	uint32_t pad[13];
+	struct xe_spin spin;
+};
+
 struct producer {
 	pthread_t thread;
 	uint32_t ctx;
@@ -127,13 +150,27 @@ struct producer {
 		struct drm_i915_gem_execbuffer2 execbuf;
 	} latency_dispatch;
 
+	struct {
+		uint32_t exec_queue;
+		uint32_t bo;
+		uint64_t addr;
+		struct xe_latency *map;
+		uint64_t seqno;
+		uint32_t spin_ticks;
+
+		/* Correlation of the engine timestamp to CLOCK_MONOTONIC */
+		uint64_t cpu_ns;
+		uint32_t cycles;
+		uint32_t frequency;
+	} xe;
+
 	pthread_mutex_t lock;
 	pthread_cond_t p_cond, c_cond;
 	uint32_t *last_timestamp;
 	int wait;
 	int complete;
 	int done;
-	struct igt_mean latency, dispatch;
+	igt_stats_t latency, dispatch;
 
 	int nop;
 	int nconsumers;
@@ -150,7 +187,6 @@ struct producer {
 #define RCS_TIMESTAMP (0x2000 + 0x358)
 #define BCS_TIMESTAMP (0x22000 + 0x358)
 #define CYCLES_TO_NS(x) (80.*(x))
-#define CYCLES_TO_US(x) (CYCLES_TO_NS(x)/1000.)
 
 static uint32_t create_workload(int gen, int factor)
 {
@@ -303,19 +339,167 @@ static void setup_nop(struct producer *p, uint32_t batch, unsigned flags)
 	eb->rsvd1 = p->ctx;
 }
 
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void xe_calibrate(struct producer *p,
+			 struct drm_xe_engine_class_instance *eci)
+{
+	struct drm_xe_query_engine_cycles cycles = {
+		.eci = *eci,
+		.clockid = CLOCK_MONOTONIC,
+	};
+	struct drm_xe_device_query query = {
+		.query = DRM_XE_DEVICE_QUERY_ENGINE_CYCLES,
+		.size = sizeof(cycles),
+		.data = to_user_pointer(&cycles),
+	};
+
+	do_ioctl(fd, DRM_IOCTL_XE_DEVICE_QUERY, &query);
+	p->xe.cpu_ns = cycles.cpu_timestamp + cycles.cpu_delta / 2;
+	p->xe.cycles = cycles.engine_cycles;
+	p->xe.frequency = drm_xe_get_gt(xe_device_get(fd),
+					eci->gt_id)->reference_clock;
+}
+
+static void setup_xe(struct producer *p, uint32_t vm, uint32_t exec_queue,
+		     struct drm_xe_engine_class_instance *eci, int n,
+		     int workload)
+{
+	uint64_t size = xe_bb_size(fd, sizeof(*p->xe.map));
+	uint64_t ts;
+	uint32_t *cs;
+
+	p->xe.exec_queue = exec_queue;
+	p->xe.addr = (uint64_t)(n + 1) << 24;
+	p->xe.bo = xe_bo_create(fd, vm, size, system_memory(fd), 0);
+	p->xe.map = xe_bo_map(fd, p->xe.bo, size);
+	xe_vm_bind_sync(fd, vm, p->xe.bo, 0, p->xe.addr, size);
+
+	p->xe.map->nop[0] = MI_BATCH_BUFFER_END;
+
+	ts = p->xe.addr + offsetof(struct xe_latency, timestamp);
+	cs = p->xe.map->batch;
+	*cs++ = MI_STORE_REGISTER_MEM_GEN8 | MI_CS_MMIO_DST;
+	*cs++ = 0x358; /* RING_TIMESTAMP */
+	*cs++ = ts;
+	*cs++ = ts >> 32;
+	*cs++ = MI_BATCH_BUFFER_END;
+
+	/* The equivalent of the blits is spinning for as many microseconds */
+	if (workload)
+		p->xe.spin_ticks = xe_spin_nsec_to_ticks(fd, eci->gt_id,
+							 workload * 1000);
+
+	xe_calibrate(p, eci);
+}
+
+static void xe_submit(struct producer *p, size_t offset, bool fence)
+{
+	struct drm_xe_sync sync = {
+		.type = DRM_XE_SYNC_TYPE_USER_FENCE,
+		.flags = DRM_XE_SYNC_FLAG_SIGNAL,
+		.addr = p->xe.addr + offsetof(struct xe_latency, fence),
+		.timeline_value = p->xe.seqno,
+	};
+	struct drm_xe_exec exec = {
+		.exec_queue_id = p->xe.exec_queue,
+		.num_batch_buffer = 1,
+		.address = p->xe.addr + offset,
+		.num_syncs = fence,
+		.syncs = to_user_pointer(&sync),
+	};
+
+	xe_exec(fd, &exec);
+}
+
+static void submit_workload(struct producer *p)
+{
+	if (!is_xe) {
+		gem_execbuf(fd, &p->workload_dispatch.execbuf);
+		return;
+	}
+
+	if (!p->xe.spin_ticks)
+		return;
+
+	/* The previous spinner is idle, the latency batch ran after it */
+	xe_spin_init_opts(&p->xe.map->spin,
+			  .addr = p->xe.addr + offsetof(struct xe_latency, spin),
+			  .ctx_ticks = p->xe.spin_ticks);
+	xe_submit(p, offsetof(struct xe_latency, spin), false);
+}
+
+static void submit_nop(struct producer *p)
+{
+	if (is_xe)
+		xe_submit(p, offsetof(struct xe_latency, nop), false);
+	else
+		gem_execbuf(fd, &p->nop_dispatch.execbuf);
+}
+
+static void submit_latency(struct producer *p)
+{
+	if (is_xe) {
+		p->xe.seqno++;
+		xe_submit(p, offsetof(struct xe_latency, batch), true);
+	} else if (p->latency_dispatch.execbuf.flags & I915_EXEC_FENCE_OUT) {
+		gem_execbuf_wr(fd, &p->latency_dispatch.execbuf);
+	} else {
+		gem_execbuf(fd, &p->latency_dispatch.execbuf);
+	}
+}
+
+/* Engine timestamps on i915, nanoseconds on xe */
+static uint64_t producer_now(struct producer *p)
+{
+	return is_xe ? now_ns() : read_timestamp();
+}
+
+static uint64_t producer_timestamp(struct producer *p)
+{
+	uint32_t ts;
+
+	if (!is_xe)
+		return *p->last_timestamp;
+
+	ts = READ_ONCE(p->xe.map->timestamp);
+	return p->xe.cpu_ns +
+	       (uint32_t)(ts - p->xe.cycles) * 1000000000ull / p->xe.frequency;
+}
+
+static uint64_t elapsed_ns(uint64_t from, uint64_t to)
+{
+	if (!is_xe)
+		return CYCLES_TO_NS((uint32_t)(to - from));
+
+	/* The clocks are only correlated that well */
+	return to > from ? to - from : 0;
+}
+
 static void fence_wait(int fence)
 {
 	struct pollfd pfd = { .fd = fence, .events = POLLIN };
 	poll(&pfd, 1, -1);
 }
 
-static void measure_latency(struct producer *p, struct igt_mean *mean)
+static void measure_latency(struct producer *p, igt_stats_t *stats)
 {
-	if (!(p->latency_dispatch.execbuf.flags & I915_EXEC_FENCE_OUT))
+	if (is_xe)
+		xe_wait_ufence(fd, &p->xe.map->fence, p->xe.seqno, 0,
+			       INT64_MAX);
+	else if (!(p->latency_dispatch.execbuf.flags & I915_EXEC_FENCE_OUT))
 		gem_sync(fd, p->latency_dispatch.exec[0].handle);
 	else
 		fence_wait(p->latency_dispatch.execbuf.rsvd2 >> 32);
-	igt_mean_add(mean, read_timestamp() - *p->last_timestamp);
+	igt_stats_push(stats, elapsed_ns(producer_timestamp(p),
+					 producer_now(p)));
 }
 
 static void *producer(void *arg)
@@ -324,7 +508,7 @@ static void *producer(void *arg)
 	int n;
 
 	while (!done) {
-		uint32_t start = read_timestamp();
+		uint64_t start = producer_now(p);
 		int batches;
 
 		/* Control the amount of work we do, similar to submitting
@@ -332,7 +516,7 @@ static void *producer(void *arg)
 		 * GPU with a small amount of real work - so there is a small
 		 * period between execution and interrupts.
 		 */
-		gem_execbuf(fd, &p->workload_dispatch.execbuf);
+		submit_workload(p);
 
 		/* Submitting a set of empty batches has a two fold effect:
 		 * - increases contention on execbuffer, i.e. measure dispatch
@@ -342,15 +526,12 @@ static void *producer(void *arg)
 		 */
 		batches = p->nop;
 		while (batches--)
-			gem_execbuf(fd, &p->nop_dispatch.execbuf);
+			submit_nop(p);
 
 		/* Finally, execute a batch that just reads the current
 		 * TIMESTAMP so we can measure the latency.
 		 */
-		if (p->latency_dispatch.execbuf.flags & I915_EXEC_FENCE_OUT)
-			gem_execbuf_wr(fd, &p->latency_dispatch.execbuf);
-		else
-			gem_execbuf(fd, &p->latency_dispatch.execbuf);
+		submit_latency(p);
 
 		/* Wake all the associated clients to wait upon our batch */
 		p->wait = p->nconsumers;
@@ -363,7 +544,8 @@ static void *producer(void *arg)
 		 * (including the nop delays).
 		 */
 		measure_latency(p, &p->latency);
-		igt_mean_add(&p->dispatch, *p->last_timestamp - start);
+		igt_stats_push(&p->dispatch,
+			       elapsed_ns(start, producer_timestamp(p)));
 
 		/* Tidy up all the extra threads before we submit again. */
 		pthread_mutex_lock(&p->lock);
@@ -373,7 +555,8 @@ static void *producer(void *arg)
 
 		p->complete++;
 
-		if (p->latency_dispatch.execbuf.flags & I915_EXEC_FENCE_OUT)
+		if (!is_xe &&
+		    p->latency_dispatch.execbuf.flags & I915_EXEC_FENCE_OUT)
 			close(p->latency_dispatch.execbuf.rsvd2 >> 32);
 	}
 
@@ -428,30 +611,85 @@ static double cpu_time(const struct rusage *r)
 		(r->ru_utime.tv_usec + r->ru_stime.tv_usec);
 }
 
-static int run(int seconds,
-	       int nproducers,
-	       int nconsumers,
-	       int nop,
-	       int workload,
-	       unsigned flags)
+static void print_distribution(const char *name, igt_stats_t *stats)
 {
+	printf("%-9s %9u %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f\n",
+	       name, stats->n_values,
+	       igt_stats_get_percentile(stats, 0) / 1e3,
+	       igt_stats_get_percentile(stats, 50) / 1e3,
+	       igt_stats_get_percentile(stats, 90) / 1e3,
+	       igt_stats_get_percentile(stats, 99) / 1e3,
+	       igt_stats_get_percentile(stats, 99.9) / 1e3,
+	       igt_stats_get_percentile(stats, 100) / 1e3);
+}
+
+static void record_distribution(struct igt_bench *bench, const char *name,
+				igt_stats_t *stats, const char *config)
+{
+	char label[256];
+
+	snprintf(label, sizeof(label), "%s,%s", name, config);
+	igt_bench_record_distribution(bench, label, "ns", stats);
+}
+
+struct options {
+	struct igt_bench bench;
+	int producers;
+	int consumers;
+	int nop;
+	int workload;
+	int engine;
+	unsigned flags;
+};
+
+static int run(struct options *o)
+{
+	const double seconds = o->bench.opts.duration;
+	int nproducers = o->producers;
+	int nconsumers = o->consumers;
+	unsigned flags = o->flags;
+	struct timespec delay = {
+		.tv_sec = seconds,
+		.tv_nsec = (seconds - (time_t)seconds) * 1e9,
+	};
+	struct drm_xe_engine_class_instance *hwe;
 	pthread_attr_t attr;
 	struct producer *p;
 	igt_stats_t platency, latency, dispatch;
+	igt_stats_t all_platency, all_latency, all_dispatch;
 	struct rusage rused;
-	uint32_t nop_batch;
-	uint32_t workload_batch;
-	uint32_t scratch;
-	int gen, n, m;
+	uint32_t nop_batch = 0;
+	uint32_t workload_batch = 0;
+	uint32_t scratch = 0;
+	uint32_t vm = 0;
+	int nengines = 1;
+	char config[128];
+	int gen = 0, n, m;
 	int complete;
 	int nrun;
 
 #if 0
 	printf("producers=%d, consumers=%d, nop=%d, workload=%d, flags=%x\n",
-	       nproducers, nconsumers, nop, workload, flags);
+	       nproducers, nconsumers, o->nop, o->workload, flags);
 #endif
 
-	fd = drm_open_driver(DRIVER_INTEL);
+	done = false;
+	fd = drm_open_driver(DRIVER_INTEL | DRIVER_XE);
+	is_xe = is_xe_device(fd);
+	igt_bench_set_device(&o->bench, fd);
+
+	if (is_xe) {
+		nengines = 0;
+		xe_for_each_engine(fd, hwe)
+			if (hwe->engine_class == o->engine)
+				nengines++;
+		if (!nengines)
+			return IGT_EXIT_SKIP;
+
+		vm = xe_vm_create(fd, 0, 0);
+		goto setup;
+	}
+
 	gen = intel_gen(intel_get_drm_devid(fd));
 	if (gen < 6)
 		return IGT_EXIT_SKIP; /* Needs BCS timestamp */
@@ -474,30 +712,55 @@ static int run(int seconds,
 
 	scratch = gem_create(fd, 4*WIDTH*HEIGHT);
 	nop_batch = create_nop();
-	workload_batch = create_workload(gen, workload);
+	workload_batch = create_workload(gen, o->workload);
+
+setup:
+	/* On xe there are that many producers for each engine of the class */
+	p = calloc(nproducers * nengines, sizeof(*p));
+	if (is_xe) {
+		n = 0;
+		xe_for_each_engine(fd, hwe) {
+			uint32_t exec_queue = 0;
+
+			if (hwe->engine_class != o->engine)
+				continue;
+
+			for (m = 0; m < nproducers; m++, n++) {
+				if (!exec_queue || flags & CONTEXT)
+					exec_queue = xe_exec_queue_create(fd, vm,
+									  hwe, 0);
+				setup_xe(&p[n], vm, exec_queue, hwe, n,
+					 o->workload);
+			}
+		}
+		nproducers *= nengines;
+	} else {
+		for (n = 0; n < nproducers; n++) {
+			if (flags & CONTEXT)
+				p[n].ctx = gem_context_create(fd);
+
+			setup_nop(&p[n], nop_batch, flags);
+			setup_workload(&p[n], gen, scratch, workload_batch,
+				       o->workload, flags);
+			setup_latency(&p[n], gen, flags);
+		}
+	}
 
-	p = calloc(nproducers, sizeof(*p));
 	for (n = 0; n < nproducers; n++) {
-		if (flags & CONTEXT)
-			p[n].ctx = gem_context_create(fd);
-
-		setup_nop(&p[n], nop_batch, flags);
-		setup_workload(&p[n], gen, scratch, workload_batch, workload, flags);
-		setup_latency(&p[n], gen, flags);
-
 		pthread_mutex_init(&p[n].lock, NULL);
 		pthread_cond_init(&p[n].p_cond, NULL);
 		pthread_cond_init(&p[n].c_cond, NULL);
 
-		igt_mean_init(&p[n].latency);
-		igt_mean_init(&p[n].dispatch);
+		igt_stats_init_histogram(&p[n].latency, PRECISION);
+		igt_stats_init_histogram(&p[n].dispatch, PRECISION);
 		p[n].wait = nconsumers;
-		p[n].nop = nop;
+		p[n].nop = o->nop;
 		p[n].nconsumers = nconsumers;
 		p[n].consumers = calloc(nconsumers, sizeof(struct consumer));
 		for (m = 0; m < nconsumers; m++) {
 			p[n].consumers[m].producer = &p[n];
-			igt_mean_init(&p[n].consumers[m].latency);
+			igt_stats_init_histogram(&p[n].consumers[m].latency,
+						 PRECISION);
 			pthread_create(&p[n].consumers[m].thread, NULL,
 				       consumer, &p[n].consumers[m]);
 		}
@@ -521,13 +784,16 @@ static int run(int seconds,
 	for (n = 0; n < nproducers; n++)
 		pthread_create(&p[n].thread, &attr, producer, &p[n]);
 
-	sleep(seconds);
+	nanosleep(&delay, NULL);
 	done = true;
 
 	nrun = complete = 0;
 	igt_stats_init_with_size(&dispatch, nproducers);
 	igt_stats_init_with_size(&platency, nproducers);
 	igt_stats_init_with_size(&latency, nconsumers*nproducers);
+	igt_stats_init_histogram(&all_dispatch, PRECISION);
+	igt_stats_init_histogram(&all_platency, PRECISION);
+	igt_stats_init_histogram(&all_latency, PRECISION);
 	for (n = 0; n < nproducers; n++) {
 		pthread_join(p[n].thread, NULL);
 
@@ -536,37 +802,46 @@ static int run(int seconds,
 
 		nrun++;
 		complete += p[n].complete;
-		igt_stats_push_float(&latency, p[n].latency.mean);
-		igt_stats_push_float(&platency, p[n].latency.mean);
-		igt_stats_push_float(&dispatch, p[n].dispatch.mean);
+		igt_stats_push_float(&latency, igt_stats_get_mean(&p[n].latency));
+		igt_stats_push_float(&platency, igt_stats_get_mean(&p[n].latency));
+		igt_stats_push_float(&dispatch, igt_stats_get_mean(&p[n].dispatch));
+		igt_stats_merge(&all_latency, &p[n].latency);
+		igt_stats_merge(&all_platency, &p[n].latency);
+		igt_stats_merge(&all_dispatch, &p[n].dispatch);
 
 		for (m = 0; m < nconsumers; m++) {
-			pthread_join(p[n].consumers[m].thread, NULL);
-			igt_stats_push_float(&latency,
-					     p[n].consumers[m].latency.mean);
+			struct consumer *c = &p[n].consumers[m];
+
+			pthread_join(c->thread, NULL);
+			if (c->latency.n_values)
+				igt_stats_push_float(&latency,
+						     igt_stats_get_mean(&c->latency));
+			igt_stats_merge(&all_latency, &c->latency);
 		}
 	}
 
 	getrusage(RUSAGE_SELF, &rused);
-	intel_register_access_fini(&mmio_data);
+	if (!is_xe)
+		intel_register_access_fini(&mmio_data);
 
+	/* The estimates are of the mean of each thread, in microseconds */
 	switch ((flags >> 8) & 0xf) {
 	default:
 		printf("%d/%d: %7.3fus %7.3fus %7.3fus %7.3fus\n",
 		       complete, nrun,
-		       CYCLES_TO_US(l_estimate(&dispatch)),
-		       CYCLES_TO_US(l_estimate(&latency)),
-		       CYCLES_TO_US(l_estimate(&platency)),
+		       l_estimate(&dispatch) / 1e3,
+		       l_estimate(&latency) / 1e3,
+		       l_estimate(&platency) / 1e3,
 		       cpu_time(&rused) / complete);
 		break;
 	case 1:
-		printf("%f\n", CYCLES_TO_US(l_estimate(&dispatch)));
+		printf("%f\n", l_estimate(&dispatch) / 1e3);
 		break;
 	case 2:
-		printf("%f\n", CYCLES_TO_US(l_estimate(&latency)));
+		printf("%f\n", l_estimate(&latency) / 1e3);
 		break;
 	case 3:
-		printf("%f\n", CYCLES_TO_US(l_estimate(&platency)));
+		printf("%f\n", l_estimate(&platency) / 1e3);
 		break;
 	case 4:
 		printf("%f\n", cpu_time(&rused) / complete);
@@ -576,91 +851,176 @@ static int run(int seconds,
 		break;
 	}
 
+	if (flags & HISTOGRAM) {
+		printf("%-9s %9s %9s %9s %9s %9s %9s %9s\n",
+		       "(us)", "count", "min", "p50", "p90", "p99", "p99.9",
+		       "max");
+		print_distribution("dispatch", &all_dispatch);
+		print_distribution("latency", &all_latency);
+		print_distribution("platency", &all_platency);
+	}
+
+	snprintf(config, sizeof(config),
+		 "producers=%d,consumers=%d,nop=%d,workload=%d,flags=%x",
+		 nproducers, nconsumers, o->nop, o->workload, flags & 0xff);
+	record_distribution(&o->bench, "dispatch", &all_dispatch, config);
+	record_distribution(&o->bench, "latency", &all_latency, config);
+	record_distribution(&o->bench, "platency", &all_platency, config);
+
+	igt_stats_fini(&all_dispatch);
+	igt_stats_fini(&all_platency);
+	igt_stats_fini(&all_latency);
+	igt_stats_fini(&dispatch);
+	igt_stats_fini(&platency);
+	igt_stats_fini(&latency);
+	for (n = 0; n < nproducers; n++) {
+		for (m = 0; m < nconsumers; m++)
+			igt_stats_fini(&p[n].consumers[m].latency);
+		igt_stats_fini(&p[n].latency);
+		igt_stats_fini(&p[n].dispatch);
+		free(p[n].consumers);
+		if (is_xe)
+			munmap(p[n].xe.map, xe_bb_size(fd, sizeof(*p[n].xe.map)));
+	}
+	free(p);
+	drm_close_driver(fd);
+
 	return 0;
 }
 
-int main(int argc, char **argv)
+static int opt_handler(int opt, int opt_index, void *data)
 {
-	int time = 10;
-	int producers = 1;
-	int consumers = 0;
-	int nop = 0;
-	int workload = 0;
-	unsigned flags = 0;
-	int c;
-
-	while ((c = getopt(argc, argv, "Cp:c:n:w:t:f:sRF")) != -1) {
-		switch (c) {
-		case 'p':
-			/* How many threads generate work? */
-			producers = atoi(optarg);
-			if (producers < 1)
-				producers = 1;
-			break;
-
-		case 'c':
-			/* How many threads wait upon each piece of work? */
-			consumers = atoi(optarg);
-			if (consumers < 0)
-				consumers = 0;
-			break;
-
-		case 'n':
-			/* Extra dispatch contention + interrupts */
-			nop = atoi(optarg);
-			if (nop < 0)
-				nop = 0;
-			break;
-
-		case 'w':
-			/* Control the amount of real work done */
-			workload = atoi(optarg);
-			if (workload < 0)
-				workload = 0;
-			if (workload > 100)
-				workload = 100;
-			break;
-
-		case 't':
-			/* How long to run the benchmark for (seconds) */
-			time = atoi(optarg);
-			if (time < 0)
-				time = INT_MAX;
-			break;
-
-		case 'f':
-			/* Select an output field */
-			flags |= atoi(optarg) << 8;
-			break;
-
-		case 's':
-			/* Assign each producer to its own context, adding
-			 * context switching into the mix (e.g. execlists
-			 * can amalgamate requests from one context, so
-			 * having each producer submit in different contexts
-			 * should force more execlist interrupts).
-			 */
-			flags |= CONTEXT;
-			break;
-
-		case 'R':
-			/* Run the producers at RealTime priority */
-			flags |= REALTIME;
-			break;
-
-		case 'C':
-			/* Don't hide from the command parser (gen7) */
-			flags |= CMDPARSER;
-			break;
-
-		case 'F':
-			flags |= FENCE_OUT;
-			break;
-
-		default:
-			break;
-		}
+	struct options *o = data;
+	int class;
+
+	switch (opt) {
+	case 'p':
+		/* How many threads generate work? */
+		o->producers = atoi(optarg);
+		if (o->producers < 1)
+			o->producers = 1;
+		break;
+
+	case 'c':
+		/* How many threads wait upon each piece of work? */
+		o->consumers = atoi(optarg);
+		if (o->consumers < 0)
+			o->consumers = 0;
+		break;
+
+	case 'n':
+		/* Extra dispatch contention + interrupts */
+		o->nop = atoi(optarg);
+		if (o->nop < 0)
+			o->nop = 0;
+		break;
+
+	case 'w':
+		/* Control the amount of real work done */
+		o->workload = atoi(optarg);
+		if (o->workload < 0)
+			o->workload = 0;
+		if (o->workload > 100)
+			o->workload = 100;
+		break;
+
+	case 't':
+		/* How long to run the benchmark for (seconds) */
+		o->bench.opts.duration = atoi(optarg);
+		if (o->bench.opts.duration < 0)
+			o->bench.opts.duration = INT_MAX;
+		break;
+
+	case 'f':
+		/* Select an output field */
+		o->flags |= atoi(optarg) << 8;
+		break;
+
+	case 's':
+		/* Assign each producer to its own context, adding
+		 * context switching into the mix (e.g. execlists
+		 * can amalgamate requests from one context, so
+		 * having each producer submit in different contexts
+		 * should force more execlist interrupts).
+		 */
+		o->flags |= CONTEXT;
+		break;
+
+	case 'R':
+		/* Run the producers at RealTime priority */
+		o->flags |= REALTIME;
+		break;
+
+	case 'C':
+		/* Don't hide from the command parser (gen7) */
+		o->flags |= CMDPARSER;
+		break;
+
+	case 'F':
+		o->flags |= FENCE_OUT;
+		break;
+
+	case 'H':
+		/* Print the distributions over all threads */
+		o->flags |= HISTOGRAM;
+		break;
+
+	case 'e':
+		/* Engine class the producers submit to on xe */
+		for (class = 0; class <= DRM_XE_ENGINE_CLASS_COMPUTE; class++)
+			if (!strcmp(optarg, xe_engine_class_short_string(class)))
+				break;
+		if (class > DRM_XE_ENGINE_CLASS_COMPUTE)
+			return IGT_OPT_HANDLER_ERROR;
+		o->engine = class;
+		break;
+
+	default:
+		return IGT_OPT_HANDLER_ERROR;
 	}
 
-	return run(time, producers, consumers, nop, workload, flags);
+	return IGT_OPT_HANDLER_SUCCESS;
+}
+
+static const char help_str[] =
+	"  -p <n>            Producer threads, for each engine on xe (default 1).\n"
+	"  -c <n>            Consumer threads waiting on each producer (default 0).\n"
+	"  -n <n>            Nop batches submitted before each measurement.\n"
+	"  -w <n>            Workload before each measurement, in blits, or in\n"
+	"                    microseconds of spinning on xe (0 to 100).\n"
+	"  -t <s>            Seconds to run for, as --duration (default 10).\n"
+	"  -f <field>        Only print one field: 1 dispatch, 2 latency,\n"
+	"                    3 producer latency, 4 CPU time, 5 completions.\n"
+	"  -s                A context, or exec queue, for each producer.\n"
+	"  -R                Run the producers at realtime priority.\n"
+	"  -C                Don't hide from the command parser (gen7).\n"
+	"  -F                Wait on an output fence instead of the batch.\n"
+	"  -e <class>        Engine class on xe: rcs, bcs, vcs, vecs or ccs\n"
+	"                    (default bcs).\n"
+	"  -H                Also print the distributions over all threads.\n"
+	"Dispatch is the time from starting to submit to the measuring batch\n"
+	"running, latency from it running to the threads waiting on it waking\n"
+	"up. The distributions are recorded in the --json output too.\n";
+
+int main(int argc, char **argv)
+{
+	struct options o = {
+		.producers = 1,
+		.engine = DRM_XE_ENGINE_CLASS_COPY,
+	};
+	int ret = 0;
+
+	igt_bench_init(&o.bench, "gem_latency");
+	o.bench.opts.duration = 10;
+	o.bench.opts.warmup = 0;
+	o.bench.opts.reps = 1;
+	igt_bench_parse_opts(&o.bench, argc, argv, "Cp:c:n:w:t:f:sRFHe:",
+			     help_str, opt_handler, &o);
+
+	for (unsigned int rep = 0; !ret && rep < o.bench.opts.reps; rep++)
+		ret = run(&o);
+
+	igt_bench_fini(&o.bench);
+
+	return ret;
 }
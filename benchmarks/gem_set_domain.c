@@ -35,86 +35,91 @@
 #include <errno.h>
 #include <sys/stat.h>
 #include <sys/ioctl.h>
-#include <sys/time.h>
-#include <time.h>
 
 #include "drm.h"
 #include "drmtest.h"
 #include "i915/gem_create.h"
 #include "igt_aux.h"
+#include "igt_bench.h"
 #include "ioctl_wrappers.h"
 
-static double elapsed(const struct timespec *start,
-		      const struct timespec *end)
+struct set_domain {
+	struct igt_bench bench;
+	int fd;
+	uint32_t handle;
+	uint32_t cpu_write;
+	uint32_t gtt_write;
+	int size;
+};
+
+static void set_domain(void *data, unsigned int thread, unsigned long count)
 {
-	return (end->tv_sec - start->tv_sec) + 1e-9*(end->tv_nsec - start->tv_nsec);
+	const struct set_domain *d = data;
+
+	while (count--) {
+		gem_set_domain(d->fd, d->handle,
+			       I915_GEM_DOMAIN_GTT, d->gtt_write);
+		gem_set_domain(d->fd, d->handle,
+			       I915_GEM_DOMAIN_CPU, d->cpu_write);
+	}
 }
 
-int main(int argc, char **argv)
+static int opt_handler(int opt, int opt_index, void *data)
 {
-	int fd = drm_open_driver(DRIVER_INTEL);
-	uint32_t cpu_write = 0;
-	uint32_t gtt_write = 0;
-	int reps = 13;
-	int size = 1024*1024;
-	uint32_t handle;
-	int c, n;
-
-	while ((c = getopt (argc, argv, "c:g:r:s:")) != -1) {
-		switch (c) {
-		case 'c':
-			cpu_write = *optarg == 'w' ? I915_GEM_DOMAIN_CPU : 0;
-			break;
-		case 'g':
-			gtt_write = *optarg == 'w' ? I915_GEM_DOMAIN_GTT : 0;
-			break;
-
-		case 'r':
-			reps = atoi(optarg);
-			if (reps < 1)
-				reps = 1;
-			break;
-
-		case 's':
-			size = atoi(optarg);
-			if (size < 4096)
-				size = 4096;
-			break;
-
-		default:
-			break;
-		}
-	}
+	struct set_domain *d = data;
 
-	fprintf(stderr, "size=%d, cpu=%d, gtt=%d\n", size, cpu_write, gtt_write);
-
-	handle = gem_create(fd, size);
-	gem_set_caching(fd, handle, I915_CACHING_NONE);
-
-	for (n = 0; n < reps; n++) {
-		struct timespec start, end;
-		uint64_t count = 0;
-
-		gem_set_domain(fd, handle,
-				I915_GEM_DOMAIN_CPU,
-				cpu_write);
-
-		clock_gettime(CLOCK_MONOTONIC, &start);
-		do {
-			for (c = 0; c < 1000; c++) {
-				gem_set_domain(fd, handle,
-						I915_GEM_DOMAIN_GTT,
-						gtt_write);
-				gem_set_domain(fd, handle,
-						I915_GEM_DOMAIN_CPU,
-						cpu_write);
-			}
-			count += c;
-			clock_gettime(CLOCK_MONOTONIC, &end);
-		} while (end.tv_sec - start.tv_sec < 2);
-
-		printf("%f\n", count / elapsed(&start, &end));
+	switch (opt) {
+	case 'c':
+		d->cpu_write = *optarg == 'w' ? I915_GEM_DOMAIN_CPU : 0;
+		break;
+	case 'g':
+		d->gtt_write = *optarg == 'w' ? I915_GEM_DOMAIN_GTT : 0;
+		break;
+	case 'r':
+		d->bench.opts.reps = max(atoi(optarg), 1);
+		break;
+	case 's':
+		d->size = max(atoi(optarg), 4096);
+		break;
+	default:
+		return IGT_OPT_HANDLER_ERROR;
 	}
 
+	return IGT_OPT_HANDLER_SUCCESS;
+}
+
+static const char help_str[] =
+	"  -c <r|w>          Read or write access from the CPU domain.\n"
+	"  -g <r|w>          Read or write access from the GTT domain.\n"
+	"  -r <n>            Number of repetitions, like --reps.\n"
+	"  -s <size>         Object size, 1MiB by default.\n";
+
+int main(int argc, char **argv)
+{
+	struct set_domain d = { .size = 1024*1024 };
+	struct igt_bench_result result;
+
+	igt_bench_init(&d.bench, "gem_set_domain");
+	d.bench.opts.reps = 13;
+	igt_bench_parse_opts(&d.bench, argc, argv, "c:g:r:s:", help_str,
+			     opt_handler, &d);
+
+	d.fd = drm_open_driver(DRIVER_INTEL);
+	igt_bench_set_device(&d.bench, d.fd);
+
+	fprintf(stderr, "size=%d, cpu=%d, gtt=%d\n",
+		d.size, d.cpu_write, d.gtt_write);
+
+	d.handle = gem_create(d.fd, d.size);
+	gem_set_caching(d.fd, d.handle, I915_CACHING_NONE);
+	gem_set_domain(d.fd, d.handle, I915_GEM_DOMAIN_CPU, d.cpu_write);
+
+	igt_bench_run(&d.bench, "set-domain", set_domain, &d, &result);
+	for (int n = 0; n < result.samples.n_values; n++)
+		printf("%f\n", result.samples.values_f[n]);
+	igt_bench_result_fini(&result);
+
+	igt_bench_fini(&d.bench);
+
 	return 0;
 }
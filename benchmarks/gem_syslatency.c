@@ -49,6 +49,10 @@
 #include "i915/gem_create.h"
 #include "i915/gem_ring.h"
 #include "igt_aux.h"
+#include "igt_syncobj.h"
+#include "xe/xe_ioctl.h"
+#include "xe/xe_query.h"
+#include "xe/xe_spin.h"
 
 #ifdef __FreeBSD__
 #include "igt_freebsd.h"
@@ -56,19 +60,39 @@
 
 static volatile int done;
 
+#define LOAD_RENDER	(1 << 0)
+#define LOAD_COPY	(1 << 1)
+#define LOAD_COMPUTE	(1 << 2)
+#define LOAD_VIDEO	(1 << 3)
+#define LOAD_EVICT	(1 << 4)
+#define LOAD_ENGINES	(LOAD_RENDER | LOAD_COPY | LOAD_COMPUTE | LOAD_VIDEO)
+
+static const char * const load_names[] = {
+	"render", "copy", "compute", "video", "evict", NULL
+};
+
 struct gem_busyspin {
 	pthread_t thread;
 	unsigned long sz;
 	unsigned long count;
+	unsigned int load;
 	bool leak;
 	bool interrupts;
 };
 
+#define MAX_OVERFLOW_CYCLES 32
+
 struct sys_wait {
 	pthread_t thread;
 	struct igt_mean mean;
+	unsigned long *hist;
+	unsigned long overflows;
+	unsigned long overflow_cycles[MAX_OVERFLOW_CYCLES];
 };
 
+/* Histogram size in microseconds, 0 to only print the summary */
+static unsigned int hist_us;
+
 static void force_low_latency(void)
 {
 	int32_t target = 0;
@@ -81,6 +105,18 @@ static void force_low_latency(void)
 
 #define ENGINE_FLAGS  (I915_EXEC_RING_MASK | I915_EXEC_BSD_MASK)
 
+static unsigned int ring_load(const struct intel_execution_ring *e)
+{
+	switch (e->exec_id) {
+	case I915_EXEC_RENDER:
+		return LOAD_RENDER;
+	case I915_EXEC_BLT:
+		return LOAD_COPY;
+	default:
+		return LOAD_VIDEO;
+	}
+}
+
 static void *gem_busyspin(void *arg)
 {
 	const uint32_t bbe = MI_BATCH_BUFFER_END;
@@ -97,7 +133,8 @@ static void *gem_busyspin(void *arg)
 
 	nengine = 0;
 	for_each_physical_ring(e, fd)
-		engines[nengine++] = eb_ring(e);
+		if (ring_load(e) & bs->load)
+			engines[nengine++] = eb_ring(e);
 
 	memset(obj, 0, sizeof(obj));
 	obj[0].handle = gem_create(fd, 4096);
@@ -144,11 +181,123 @@ static void *gem_busyspin(void *arg)
 	return NULL;
 }
 
+#define XE_SPIN_ADDR 0x1a0000
+
+static unsigned int engine_load(const struct drm_xe_engine_class_instance *hwe)
+{
+	switch (hwe->engine_class) {
+	case DRM_XE_ENGINE_CLASS_RENDER:
+		return LOAD_RENDER;
+	case DRM_XE_ENGINE_CLASS_COPY:
+		return LOAD_COPY;
+	case DRM_XE_ENGINE_CLASS_COMPUTE:
+		return LOAD_COMPUTE;
+	default:
+		return LOAD_VIDEO;
+	}
+}
+
+static void *xe_busyspin(void *arg)
+{
+	struct gem_busyspin *bs = arg;
+	struct drm_xe_engine_class_instance *hwe;
+	struct drm_xe_sync sync = {
+		.type = DRM_XE_SYNC_TYPE_SYNCOBJ,
+		.flags = DRM_XE_SYNC_FLAG_SIGNAL,
+	};
+	struct drm_xe_exec exec = {
+		.num_batch_buffer = 1,
+		.num_syncs = 1,
+		.syncs = to_user_pointer(&sync),
+	};
+	uint32_t exec_queues[64], syncobjs[64];
+	unsigned int nengine = 0;
+	uint64_t slot;
+	uint32_t vm, bo;
+	void *map;
+	int fd;
+
+	fd = drm_open_driver(DRIVER_XE);
+	vm = xe_vm_create(fd, 0, 0);
+	slot = xe_bb_size(fd, sizeof(struct xe_spin));
+
+	xe_for_each_engine(fd, hwe)
+		if (engine_load(hwe) & bs->load && nengine < ARRAY_SIZE(exec_queues))
+			exec_queues[nengine++] = xe_exec_queue_create(fd, vm, hwe, 0);
+	if (!nengine)
+		goto out;
+
+	/* One spinner per engine, each times itself against its own start */
+	bo = xe_bo_create(fd, vm, nengine * slot, vram_if_possible(fd, 0),
+			  DRM_XE_GEM_CREATE_FLAG_NEEDS_VISIBLE_VRAM);
+	map = xe_bo_map(fd, bo, nengine * slot);
+	xe_vm_bind_sync(fd, vm, bo, 0, XE_SPIN_ADDR, nengine * slot);
+
+	nengine = 0;
+	xe_for_each_engine(fd, hwe) {
+		void *spin = map + nengine * slot;
+
+		if (!(engine_load(hwe) & bs->load) ||
+		    nengine == ARRAY_SIZE(exec_queues))
+			continue;
+
+		if (bs->sz)
+			xe_spin_init_opts(spin, .addr = XE_SPIN_ADDR + nengine * slot,
+					  .preempt = true,
+					  .ctx_ticks = xe_spin_nsec_to_ticks(fd, hwe->gt_id,
+									     bs->sz));
+		else
+			*(uint32_t *)spin = MI_BATCH_BUFFER_END;
+
+		syncobjs[nengine++] = syncobj_create(fd, 0);
+	}
+
+	while (!done) {
+		for (int n = 0; n < nengine; n++) {
+			exec.exec_queue_id = exec_queues[n];
+			exec.address = XE_SPIN_ADDR + n * slot;
+			sync.handle = syncobjs[n];
+			xe_exec(fd, &exec);
+		}
+		syncobj_wait(fd, syncobjs, nengine, INT64_MAX,
+			     DRM_SYNCOBJ_WAIT_FLAGS_WAIT_ALL, NULL);
+		bs->count += nengine;
+	}
+
+	for (int n = 0; n < nengine; n++)
+		syncobj_destroy(fd, syncobjs[n]);
+	munmap(map, nengine * slot);
+	gem_close(fd, bo);
+out:
+	for (int n = 0; n < nengine; n++)
+		xe_exec_queue_destroy(fd, exec_queues[n]);
+	xe_vm_destroy(fd, vm);
+	drm_close_driver(fd);
+	return NULL;
+}
+
 static double elapsed(const struct timespec *a, const struct timespec *b)
 {
 	return 1e9*(b->tv_sec - a->tv_sec) + (b->tv_nsec - a ->tv_nsec);
 }
 
+static void record_latency(struct sys_wait *w, double ns)
+{
+	unsigned long us = ns / 1000;
+
+	igt_mean_add(&w->mean, ns);
+	if (!w->hist)
+		return;
+
+	if (us < hist_us) {
+		w->hist[us]++;
+	} else {
+		if (w->overflows < MAX_OVERFLOW_CYCLES)
+			w->overflow_cycles[w->overflows] = w->mean.count;
+		w->overflows++;
+	}
+}
+
 static void *sys_wait(void *arg)
 {
 	struct sys_wait *w = arg;
@@ -184,7 +333,7 @@ static void *sys_wait(void *arg)
 
 		sigwait(&mask, &sigs);
 		clock_gettime(CLOCK_MONOTONIC, &now);
-		igt_mean_add(&w->mean, elapsed(&its.it_value, &now));
+		record_latency(w, elapsed(&its.it_value, &now));
 	}
 
 	sigprocmask(SIG_UNBLOCK, &mask, NULL);
@@ -215,8 +364,55 @@ static void *sys_thp_alloc(void *arg)
 		munmap(ptr, sz);
 
 		clock_gettime(CLOCK_MONOTONIC, &now);
-		igt_mean_add(&w->mean, elapsed(&start, &now));
+		record_latency(w, elapsed(&start, &now));
+	}
+
+	return NULL;
+}
+
+static void *xe_evict(void *arg)
+{
+	struct gem_busyspin *bs = arg;
+	const uint64_t sz = 16 << 20;
+	uint64_t region, total, flags = 0;
+	unsigned int nbo, n = 0;
+	uint32_t *handles;
+	int fd;
+
+	fd = drm_open_driver(DRIVER_XE);
+	region = vram_if_possible(fd, 0);
+
+	/* Cycle through more than fits so each new object evicts an old one */
+	if (xe_has_vram(fd)) {
+		total = xe_visible_vram_size(fd, 0) / 2 * 3;
+		flags = DRM_XE_GEM_CREATE_FLAG_NEEDS_VISIBLE_VRAM;
+	} else {
+		total = (igt_get_avail_ram_mb() << 20) / 2;
 	}
+	nbo = max_t(uint64_t, total / sz, 1);
+	handles = calloc(nbo, sizeof(*handles));
+
+	while (!done) {
+		volatile uint8_t *ptr;
+
+		if (handles[n])
+			gem_close(fd, handles[n]);
+
+		handles[n] = xe_bo_create(fd, 0, sz, region, flags);
+		ptr = xe_bo_map(fd, handles[n], sz);
+		for (size_t page = 0; page < sz; page += PAGE_SIZE)
+			ptr[page] = 0;
+		munmap((void *)ptr, sz);
+
+		n = (n + 1) % nbo;
+		bs->count++;
+	}
+
+	for (n = 0; n < nbo; n++)
+		if (handles[n])
+			gem_close(fd, handles[n]);
+	free(handles);
+	drm_close_driver(fd);
 
 	return NULL;
 }
@@ -296,6 +492,75 @@ static void *background_fs(void *path)
 	return NULL;
 }
 
+static unsigned int parse_load(const char *list)
+{
+	unsigned int load = 0;
+	char *str, *name, *save;
+
+	str = strdup(list);
+	for (name = strtok_r(str, ",", &save); name;
+	     name = strtok_r(NULL, ",", &save)) {
+		int n;
+
+		for (n = 0; load_names[n]; n++)
+			if (!strcmp(name, load_names[n]))
+				break;
+
+		if (!load_names[n]) {
+			fprintf(stderr, "Unknown load '%s'\n", name);
+			exit(1);
+		}
+		load |= 1 << n;
+	}
+	free(str);
+
+	return load;
+}
+
+/* Same layout as cyclictest -h, so the usual plotting scripts apply */
+static void print_histogram(FILE *f, const struct sys_wait *wait, int ncpus)
+{
+	int n;
+
+	fprintf(f, "# Histogram\n");
+	for (unsigned int us = 0; us < hist_us; us++) {
+		fprintf(f, "%06u ", us);
+		for (n = 0; n < ncpus; n++)
+			fprintf(f, "%06lu%s", wait[n].hist[us],
+				n < ncpus - 1 ? "\t" : "");
+		fprintf(f, "\n");
+	}
+
+	fprintf(f, "# Total:");
+	for (n = 0; n < ncpus; n++)
+		fprintf(f, " %09lu", wait[n].mean.count);
+	fprintf(f, "\n# Min Latencies:");
+	for (n = 0; n < ncpus; n++)
+		fprintf(f, " %05lu", wait[n].mean.count ?
+			(unsigned long)(wait[n].mean.min / 1000) : 0);
+	fprintf(f, "\n# Avg Latencies:");
+	for (n = 0; n < ncpus; n++)
+		fprintf(f, " %05lu", (unsigned long)(wait[n].mean.mean / 1000));
+	fprintf(f, "\n# Max Latencies:");
+	for (n = 0; n < ncpus; n++)
+		fprintf(f, " %05lu", (unsigned long)(wait[n].mean.max / 1000));
+	fprintf(f, "\n# Histogram Overflows:");
+	for (n = 0; n < ncpus; n++)
+		fprintf(f, " %05lu", wait[n].overflows);
+	fprintf(f, "\n# Histogram Overflow at cycle number:\n");
+	for (n = 0; n < ncpus; n++) {
+		unsigned long shown = min_t(unsigned long, wait[n].overflows,
+					    MAX_OVERFLOW_CYCLES);
+
+		fprintf(f, "# Thread %d:", n);
+		for (unsigned long i = 0; i < shown; i++)
+			fprintf(f, " %05lu", wait[n].overflow_cycles[i]);
+		if (wait[n].overflows > shown)
+			fprintf(f, " # %05lu others", wait[n].overflows - shown);
+		fprintf(f, "\n");
+	}
+}
+
 static unsigned long calibrate_nop(unsigned int target_us,
 				   unsigned int tolerance_pct)
 {
@@ -342,23 +607,26 @@ static unsigned long calibrate_nop(unsigned int target_us,
 
 int main(int argc, char **argv)
 {
-	struct gem_busyspin *busy;
+	struct gem_busyspin *busy, evict = {};
 	struct sys_wait *wait;
 	void *sys_fn = sys_wait;
+	void *busy_fn = gem_busyspin;
 	pthread_attr_t attr;
 	pthread_t bg_fs = 0;
+	const char *hist_file = NULL;
+	unsigned int load = LOAD_ENGINES;
+	bool is_xe;
 	int ncpus = sysconf(_SC_NPROCESSORS_ONLN);
 	igt_stats_t cycles, mean, max;
 	double min;
 	int time = 10;
 	int field = -1;
 	int enable_gem_sysbusy = 1;
-	bool leak = false;
 	bool interrupts = false;
 	long batch = 0;
-	int n, c;
+	int n, c, fd;
 
-	while ((c = getopt(argc, argv, "r:t:f:bmni1")) != -1) {
+	while ((c = getopt(argc, argv, "r:t:f:h:H:l:bmni1")) != -1) {
 		switch (c) {
 		case '1':
 			ncpus = 1;
@@ -390,7 +658,19 @@ int main(int argc, char **argv)
 			break;
 		case 'm':
 			sys_fn = sys_thp_alloc;
-			leak = true;
+			load |= LOAD_EVICT;
+			break;
+		case 'l':
+			/* Engine classes to load and/or eviction */
+			load = parse_load(optarg);
+			break;
+		case 'h':
+			/* Histogram of the latencies, in microsecond buckets */
+			hist_us = atoi(optarg);
+			break;
+		case 'H':
+			/* Write the histogram there instead of stdout */
+			hist_file = optarg;
 			break;
 		default:
 			break;
@@ -401,29 +681,45 @@ int main(int argc, char **argv)
 	force_low_latency();
 	min = min_measurement_error();
 
-	if (batch > 0)
+	fd = drm_open_driver(DRIVER_INTEL | DRIVER_XE);
+	is_xe = is_xe_device(fd);
+	drm_close_driver(fd);
+
+	if (is_xe) {
+		/* xe spins for the batch duration instead of calibrating nops */
+		batch = labs(batch) * 1000;
+		busy_fn = xe_busyspin;
+	} else if (batch > 0) {
 		batch = calibrate_nop(batch, 2);
-	else
+	} else {
 		batch = -batch;
+	}
 
 	busy = calloc(ncpus, sizeof(*busy));
 	pthread_attr_init(&attr);
-	if (enable_gem_sysbusy) {
+	if (enable_gem_sysbusy && load & LOAD_ENGINES) {
 		for (n = 0; n < ncpus; n++) {
 			bind_cpu(&attr, n);
 			busy[n].sz = batch;
-			busy[n].leak = leak;
+			busy[n].load = load;
+			busy[n].leak = !is_xe && load & LOAD_EVICT;
 			busy[n].interrupts = interrupts;
 			pthread_create(&busy[n].thread, &attr,
-				       gem_busyspin, &busy[n]);
+				       busy_fn, &busy[n]);
 		}
 	}
+	if (enable_gem_sysbusy && is_xe && load & LOAD_EVICT) {
+		pthread_attr_init(&attr);
+		pthread_create(&evict.thread, &attr, xe_evict, &evict);
+	}
 
 	wait = calloc(ncpus, sizeof(*wait));
 	pthread_attr_init(&attr);
 	rtprio(&attr, 99);
 	for (n = 0; n < ncpus; n++) {
 		igt_mean_init(&wait[n].mean);
+		if (hist_us)
+			wait[n].hist = calloc(hist_us, sizeof(*wait[n].hist));
 		bind_cpu(&attr, n);
 		pthread_create(&wait[n].thread, &attr, sys_fn, &wait[n]);
 	}
@@ -432,12 +728,14 @@ int main(int argc, char **argv)
 	done = 1;
 
 	igt_stats_init_with_size(&cycles, ncpus);
-	if (enable_gem_sysbusy) {
+	if (enable_gem_sysbusy && load & LOAD_ENGINES) {
 		for (n = 0; n < ncpus; n++) {
 			pthread_join(busy[n].thread, NULL);
 			igt_stats_push(&cycles, busy[n].count);
 		}
 	}
+	if (evict.thread)
+		pthread_join(evict.thread, NULL);
 
 	igt_stats_init_with_size(&mean, ncpus);
 	igt_stats_init_with_size(&max, ncpus);
@@ -451,6 +749,19 @@ int main(int argc, char **argv)
 		pthread_join(bg_fs, NULL);
 	}
 
+	if (hist_us) {
+		FILE *f = hist_file ? fopen(hist_file, "w") : stdout;
+
+		if (f) {
+			print_histogram(f, wait, ncpus);
+			if (f != stdout)
+				fclose(f);
+		} else {
+			fprintf(stderr, "Unable to write the histogram to %s: %s\n",
+				hist_file, strerror(errno));
+		}
+	}
+
 	switch (field) {
 	default:
 		printf("gem_syslatency: cycles=%.0f, latency mean=%.3fus max=%.0fus\n",
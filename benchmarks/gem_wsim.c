@@ -148,11 +148,57 @@ struct deps {
 	for (int __i = 0; __i < __deps.nr && \
 	     (__dep = &__deps.list[__i]); ++__i)
 
+enum arrival_process {
+	ARRIVAL_CLOSED_LOOP = 0,
+	ARRIVAL_FIXED,
+	ARRIVAL_POISSON,
+};
+
+struct arrival {
+	enum arrival_process process;
+	double rate; /* frames per second */
+	unsigned int deadline_us;
+};
+
+/*
+ * Log-linear histogram of frame latencies in microseconds, with
+ * 1 << LATENCY_SUB_BITS buckets per power of two.
+ */
+#define LATENCY_SUB_BITS	4
+#define LATENCY_BUCKETS		((32 - LATENCY_SUB_BITS + 1) << LATENCY_SUB_BITS)
+
+struct latency_histogram {
+	unsigned long count;
+	unsigned long missed;
+	uint64_t sum;
+	uint32_t max;
+	unsigned long buckets[LATENCY_BUCKETS];
+};
+
+/*
+ * Per batch step distributions built from the CS timestamps each batch
+ * stores at its start and end: time from submission until the batch started
+ * executing, its run time on the engine and time from submission to its
+ * completion.
+ */
+struct step_timing {
+	struct latency_histogram queue;
+	struct latency_histogram run;
+	struct latency_histogram completion;
+};
+
+struct busy_interval {
+	uint64_t start_ns;
+	uint64_t end_ns;
+	unsigned int step;
+};
+
 struct w_arg {
 	char *filename;
 	char *desc;
 	int prio;
 	bool sseu;
+	struct arrival arrival;
 };
 
 #define INVALID_ID ((uint16_t)-2)
@@ -222,8 +268,10 @@ struct w_step {
 		struct {
 			struct drm_i915_gem_execbuffer2 eb;
 			struct drm_i915_gem_exec_object2 *obj;
-			struct drm_i915_gem_relocation_entry reloc[3];
+			struct drm_i915_gem_relocation_entry reloc[5];
 			uint32_t *bb_duration;
+			uint32_t *timestamps; /* start, end */
+			uint64_t submit_ns;
 		} i915;
 		struct {
 			struct drm_xe_exec exec;
@@ -233,6 +281,7 @@ struct w_step {
 				uint64_t exec_sync;
 			} *data;
 			struct drm_xe_sync *syncs;
+			struct drm_xe_sync *ufence;
 		} xe;
 	};
 	unsigned long bb_size;
@@ -286,6 +335,14 @@ struct workload {
 	uint32_t bb_prng;
 	uint32_t bo_prng;
 
+	struct arrival arrival;
+	uint32_t arrival_prng;
+	struct latency_histogram *latency;
+
+	struct step_timing *timing;
+	struct busy_interval *busy;
+	unsigned int nr_busy, max_busy;
+
 	unsigned int nr_ctxs;
 	struct ctx *ctx_list;
 
@@ -319,6 +376,7 @@ static unsigned int master_prng;
 static int verbose = 1;
 static int fd;
 static bool is_xe;
+static uint64_t epoch_ns;
 static struct drm_i915_gem_context_param_sseu device_sseu = {
 	.slice_mask = -1 /* Force read on first use. */
 };
@@ -327,10 +385,17 @@ static struct drm_i915_gem_context_param_sseu device_sseu = {
 #define FLAG_DEPSYNC		(1<<2)
 #define FLAG_SSEU		(1<<3)
 #define FLAG_VERIFY_COMPLETION	(1 << 4)
+#define FLAG_TIMESTAMPS		(1 << 5)
+#define FLAG_XE_UFENCE		(1 << 6)
 
 static void w_step_sync(struct w_step *w)
 {
-	if (is_xe)
+	if (is_xe && w->xe.ufence) {
+		/* Completed batches are spotted without entering the kernel */
+		if (READ_ONCE(w->xe.data->exec_sync) != w->xe.ufence->timeline_value)
+			xe_wait_ufence(fd, &w->xe.data->exec_sync,
+				       w->xe.ufence->timeline_value, 0, INT64_MAX);
+	} else if (is_xe)
 		igt_assert(syncobj_wait(fd, &w->xe.syncs[0].handle, 1, INT64_MAX, 0, NULL));
 	else
 		gem_sync(fd, w->i915.obj[0].handle);
@@ -1343,6 +1408,7 @@ add_step:
 	wrk->steps = steps;
 	wrk->prio = arg->prio;
 	wrk->sseu = arg->sseu;
+	wrk->arrival = arg->arrival;
 	wrk->max_working_set_id = -1;
 	wrk->working_sets = NULL;
 	wrk->bo_prng = (flags & FLAG_SYNCEDCLIENTS) ? master_prng : rand();
@@ -1443,6 +1509,7 @@ clone_workload(struct workload *_wrk)
 
 	wrk->prio = _wrk->prio;
 	wrk->sseu = _wrk->sseu;
+	wrk->arrival = _wrk->arrival;
 	wrk->nr_steps = _wrk->nr_steps;
 	wrk->steps = calloc(wrk->nr_steps, sizeof(struct w_step));
 	igt_assert(wrk->steps);
@@ -1540,6 +1607,8 @@ static unsigned int create_bb(struct w_step *w, int self)
 	const uint32_t base = mmio_base(fd, &w->engine, gen);
 #define CS_GPR(x) (base + 0x600 + 8 * (x))
 #define TIMESTAMP (base + 0x3a8)
+#define RING_TIMESTAMP (base + 0x358)
+	const bool timestamps = w->wrk->flags & FLAG_TIMESTAMPS;
 	const int use_64b = gen >= 8;
 	enum { START_TS, NOW_TS };
 	uint32_t *cs, *jmp;
@@ -1561,6 +1630,20 @@ static unsigned int create_bb(struct w_step *w, int self)
 					       PROT_READ | PROT_WRITE);
 	}
 
+	/* CS timestamps of the batch start and end follow the delta */
+	w->i915.timestamps = cs + 4008 / sizeof(*cs);
+	if (timestamps) {
+		*cs++ = MI_STORE_REGISTER_MEM_CMD | (1 + use_64b) | MI_CS_MMIO_DST;
+		*cs++ = RING_TIMESTAMP;
+		w->i915.reloc[r].presumed_offset = w->i915.obj[self].offset;
+		w->i915.reloc[r].target_handle = self;
+		w->i915.reloc[r].offset = offset_in_page(cs);
+		w->i915.reloc[r].delta = 4008;
+		*cs++ = w->i915.reloc[r].presumed_offset + w->i915.reloc[r].delta;
+		*cs++ = 0;
+		r++;
+	}
+
 	/* Store initial 64b timestamp: start */
 	*cs++ = MI_LOAD_REGISTER_IMM(1) | MI_CS_MMIO_DST;
 	*cs++ = CS_GPR(START_TS) + 4;
@@ -1584,6 +1667,19 @@ static unsigned int create_bb(struct w_step *w, int self)
 	*cs++ = TIMESTAMP;
 	*cs++ = CS_GPR(NOW_TS);
 
+	/* The last pass before COND_BBE terminates leaves the end time */
+	if (timestamps) {
+		*cs++ = MI_STORE_REGISTER_MEM_CMD | (1 + use_64b) | MI_CS_MMIO_DST;
+		*cs++ = RING_TIMESTAMP;
+		w->i915.reloc[r].presumed_offset = w->i915.obj[self].offset;
+		w->i915.reloc[r].target_handle = self;
+		w->i915.reloc[r].offset = offset_in_page(cs);
+		w->i915.reloc[r].delta = 4012;
+		*cs++ = w->i915.reloc[r].presumed_offset + w->i915.reloc[r].delta;
+		*cs++ = 0;
+		r++;
+	}
+
 	/* delta = now - start; inverted to match COND_BBE */
 	*cs++ = MI_MATH(4);
 	*cs++ = MI_MATH_LOAD(MI_MATH_REG_SRCA, MI_MATH_REG(NOW_TS));
@@ -1781,6 +1877,18 @@ alloc_step_batch(struct workload *wrk, struct w_step *w)
 #endif
 }
 
+/*
+ * Batches submitted to the same exec queue execute in order, so only
+ * dependencies on other exec queues need to wait for a fence.
+ */
+static bool xe_implicit_dep(struct workload *wrk, struct w_step *w,
+			    int dep_idx)
+{
+	struct w_step *dep = &wrk->steps[dep_idx];
+
+	return dep->type == BATCH && xe_get_eq(wrk, dep) == xe_get_eq(wrk, w);
+}
+
 static void
 xe_alloc_step_batch(struct workload *wrk, struct w_step *w)
 {
@@ -1815,7 +1923,8 @@ xe_alloc_step_batch(struct workload *wrk, struct w_step *w)
 		igt_assert(dep_idx >= 0 && dep_idx < w->idx);
 		igt_assert(wrk->steps[dep_idx].type == BATCH);
 
-		w->xe.exec.num_syncs++;
+		if (!xe_implicit_dep(wrk, w, dep_idx))
+			w->xe.exec.num_syncs++;
 	}
 	for_each_dep(dep, w->fence_deps) {
 		int dep_idx = w->idx + dep->target;
@@ -1824,8 +1933,11 @@ xe_alloc_step_batch(struct workload *wrk, struct w_step *w)
 		igt_assert(wrk->steps[dep_idx].type == SW_FENCE ||
 			   wrk->steps[dep_idx].type == BATCH);
 
-		w->xe.exec.num_syncs++;
+		if (!xe_implicit_dep(wrk, w, dep_idx))
+			w->xe.exec.num_syncs++;
 	}
+	if (wrk->flags & FLAG_XE_UFENCE)
+		w->xe.exec.num_syncs++;
 	w->xe.syncs = calloc(w->xe.exec.num_syncs, sizeof(*w->xe.syncs));
 	/* fill syncs */
 	i = 0;
@@ -1837,6 +1949,9 @@ xe_alloc_step_batch(struct workload *wrk, struct w_step *w)
 	for_each_dep(dep, w->data_deps) {
 		int dep_idx = w->idx + dep->target;
 
+		if (xe_implicit_dep(wrk, w, dep_idx))
+			continue;
+
 		igt_assert(wrk->steps[dep_idx].xe.syncs && wrk->steps[dep_idx].xe.syncs[0].handle);
 		w->xe.syncs[i].handle = wrk->steps[dep_idx].xe.syncs[0].handle;
 		w->xe.syncs[i++].type = DRM_XE_SYNC_TYPE_SYNCOBJ;
@@ -1844,10 +1959,22 @@ xe_alloc_step_batch(struct workload *wrk, struct w_step *w)
 	for_each_dep(dep, w->fence_deps) {
 		int dep_idx = w->idx + dep->target;
 
+		if (xe_implicit_dep(wrk, w, dep_idx))
+			continue;
+
 		igt_assert(wrk->steps[dep_idx].xe.syncs && wrk->steps[dep_idx].xe.syncs[0].handle);
 		w->xe.syncs[i].handle = wrk->steps[dep_idx].xe.syncs[0].handle;
 		w->xe.syncs[i++].type = DRM_XE_SYNC_TYPE_SYNCOBJ;
 	}
+	/* out user fence, bumped on every submission */
+	if (wrk->flags & FLAG_XE_UFENCE) {
+		w->xe.ufence = &w->xe.syncs[i];
+		w->xe.syncs[i].type = DRM_XE_SYNC_TYPE_USER_FENCE;
+		w->xe.syncs[i].flags = DRM_XE_SYNC_FLAG_SIGNAL;
+		w->xe.syncs[i++].addr = w->xe.exec.address +
+					offsetof(typeof(*w->xe.data), exec_sync);
+	}
+	igt_assert_eq(i, w->xe.exec.num_syncs);
 	w->xe.exec.syncs = to_user_pointer(w->xe.syncs);
 }
 
@@ -2533,6 +2660,16 @@ static int prepare_workload(unsigned int id, struct workload *wrk)
 	wrk->id = id;
 	wrk->bb_prng = (wrk->flags & FLAG_SYNCEDCLIENTS) ? master_prng : rand();
 	wrk->bo_prng = (wrk->flags & FLAG_SYNCEDCLIENTS) ? master_prng : rand();
+	wrk->arrival_prng = (wrk->flags & FLAG_SYNCEDCLIENTS) ? master_prng : rand();
+
+	if (wrk->arrival.process != ARRIVAL_CLOSED_LOOP) {
+		wrk->latency = calloc(1, sizeof(*wrk->latency));
+		igt_assert(wrk->latency);
+	}
+	if (wrk->flags & FLAG_TIMESTAMPS) {
+		wrk->timing = calloc(wrk->nr_steps, sizeof(*wrk->timing));
+		igt_assert(wrk->timing);
+	}
 	wrk->run = true;
 
 	allocate_contexts(id, wrk);
@@ -2616,6 +2753,15 @@ static int elapsed_us(const struct timespec *start, const struct timespec *end)
 	return elapsed(start, end) * 1e6;
 }
 
+static uint64_t monotonic_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
 static void
 update_bb_start(struct workload *wrk, struct w_step *w)
 {
@@ -2664,6 +2810,8 @@ static void do_xe_exec(struct workload *wrk, struct w_step *w)
 				  .preempt = (w->preempt_us > 0),
 				  .ctx_ticks = w->duration.requested_ticks);
 	}
+	if (w->xe.ufence)
+		w->xe.ufence->timeline_value++;
 	xe_exec(fd, &w->xe.exec);
 }
 
@@ -2705,6 +2853,9 @@ do_eb(struct workload *wrk, struct w_step *w)
 		w->i915.eb.rsvd2 = wrk->steps[tgt].emit_fence;
 	}
 
+	if (wrk->timing)
+		w->i915.submit_ns = monotonic_ns();
+
 	if (w->i915.eb.flags & I915_EXEC_FENCE_OUT)
 		gem_execbuf_wr(fd, &w->i915.eb);
 	else
@@ -2741,6 +2892,165 @@ static void sync_deps(struct workload *wrk, struct w_step *w)
 	}
 }
 
+static unsigned int latency_bucket(uint32_t us)
+{
+	unsigned int msb;
+
+	if (us < (1 << LATENCY_SUB_BITS))
+		return us;
+
+	msb = 31 - __builtin_clz(us);
+
+	return ((msb - LATENCY_SUB_BITS + 1) << LATENCY_SUB_BITS) |
+	       ((us >> (msb - LATENCY_SUB_BITS)) & ((1 << LATENCY_SUB_BITS) - 1));
+}
+
+/* Largest latency falling into the bucket. */
+static uint32_t latency_bucket_max(unsigned int bucket)
+{
+	unsigned int exp = bucket >> LATENCY_SUB_BITS;
+	unsigned int sub = bucket & ((1 << LATENCY_SUB_BITS) - 1);
+
+	if (!exp)
+		return sub;
+
+	return (((uint64_t)((1 << LATENCY_SUB_BITS) | sub) + 1) << (exp - 1)) - 1;
+}
+
+static void histogram_add(struct latency_histogram *h, uint32_t us)
+{
+	h->buckets[latency_bucket(us)]++;
+	h->count++;
+	h->sum += us;
+	if (us > h->max)
+		h->max = us;
+}
+
+static void
+record_latency(struct workload *wrk, const struct timespec *arrival,
+	       const struct timespec *completion)
+{
+	struct latency_histogram *h = wrk->latency;
+	double us = elapsed(arrival, completion) * 1e6;
+	uint32_t latency = us < UINT32_MAX ? us : UINT32_MAX;
+
+	histogram_add(h, latency);
+	if (latency > wrk->arrival.deadline_us)
+		h->missed++;
+}
+
+static uint32_t
+latency_percentile(const struct latency_histogram *h, double percentile)
+{
+	unsigned long target = ceil(h->count * percentile / 100.0);
+	unsigned long count = 0;
+
+	for (unsigned int i = 0; i < LATENCY_BUCKETS; i++) {
+		count += h->buckets[i];
+		if (count >= target && count)
+			return min_t(uint32_t, latency_bucket_max(i), h->max);
+	}
+
+	return h->max;
+}
+
+static uint64_t ticks_to_ns(uint32_t ticks)
+{
+	static long f;
+
+	if (!f)
+		f = read_timestamp_frequency(fd);
+
+	return (uint64_t)ticks * NSEC_PER_SEC / f;
+}
+
+static uint32_t ns_to_us(int64_t ns)
+{
+	if (ns <= 0)
+		return 0;
+
+	return min_t(uint64_t, ns / 1000, UINT32_MAX);
+}
+
+/*
+ * Sample the render engine timestamp together with the CPU clock. All
+ * engines count from the same GT timestamp so this translates the low 32
+ * bits stored by any batch into CLOCK_MONOTONIC.
+ */
+static uint32_t gpu_timestamp(uint64_t *cpu_ns)
+{
+	struct drm_i915_reg_read rr = {
+		.offset = 0x2358 | I915_REG_READ_8B_WA,
+	};
+	uint64_t before;
+
+	before = monotonic_ns();
+	do_ioctl(fd, DRM_IOCTL_I915_REG_READ, &rr);
+	*cpu_ns = before + (monotonic_ns() - before) / 2;
+
+	return rr.val;
+}
+
+/*
+ * The batch object is reused by every iteration so the timestamps of the
+ * previous execution have to be collected before submitting it again,
+ * waiting for it to complete if necessary.
+ */
+static void collect_timestamps(struct workload *wrk, struct w_step *w)
+{
+	struct step_timing *t = &wrk->timing[w->idx];
+	uint64_t now_ns, start_ns, end_ns;
+	uint32_t now, start, end;
+
+	if (!w->i915.submit_ns)
+		return;
+
+	gem_sync(fd, w->bb_handle);
+
+	start = READ_ONCE(w->i915.timestamps[0]);
+	end = READ_ONCE(w->i915.timestamps[1]);
+	now = gpu_timestamp(&now_ns);
+
+	start_ns = now_ns - ticks_to_ns(now - start);
+	end_ns = now_ns - ticks_to_ns(now - end);
+
+	histogram_add(&t->queue, ns_to_us(start_ns - w->i915.submit_ns));
+	histogram_add(&t->run, ns_to_us(ticks_to_ns(end - start)));
+	histogram_add(&t->completion, ns_to_us(end_ns - w->i915.submit_ns));
+
+	if (wrk->nr_busy == wrk->max_busy) {
+		wrk->max_busy = wrk->max_busy ? 2 * wrk->max_busy : 1024;
+		wrk->busy = realloc(wrk->busy,
+				    wrk->max_busy * sizeof(*wrk->busy));
+		igt_assert(wrk->busy);
+	}
+	wrk->busy[wrk->nr_busy++] = (struct busy_interval) {
+		.start_ns = start_ns,
+		.end_ns = end_ns,
+		.step = w->idx,
+	};
+
+	w->i915.submit_ns = 0;
+}
+
+/*
+ * Open-loop frames arrive independently of the GPU progress, either at a
+ * fixed rate or with exponentially distributed inter-arrival times.
+ */
+static void next_arrival(struct workload *wrk, struct timespec *arrival)
+{
+	double interval = 1.0 / wrk->arrival.rate;
+	uint64_t ns;
+
+	if (wrk->arrival.process == ARRIVAL_POISSON)
+		interval *= -log((hars_petruska_f54_1_random(&wrk->arrival_prng) + 1.0) /
+				 4294967296.0);
+
+	ns = arrival->tv_nsec + (uint64_t)(interval * 1e9);
+	arrival->tv_sec += ns / NSEC_PER_SEC;
+	arrival->tv_nsec = ns % NSEC_PER_SEC;
+}
+
 static void *run_workload(void *data)
 {
 	struct workload *wrk = (struct workload *)data;
@@ -2750,13 +3060,26 @@ static void *run_workload(void *data)
 	int qd_throttle = -1;
 	int count, missed = 0;
 	unsigned long time_tot = 0, time_min = ULONG_MAX, time_max = 0;
+	struct timespec arrival;
+
+	igt_fork_apply_placement(wrk->id);
 
 	clock_gettime(CLOCK_MONOTONIC, &t_start);
+	arrival = t_start;
 
 	for (count = 0; wrk->run && (wrk->background || count < wrk->repeat);
 	     count++) {
 		unsigned int cur_seqno = wrk->sync_seqno;
 
+		/*
+		 * Frames which arrived while the previous one was still
+		 * running start right away and their latency includes the
+		 * time spent queued.
+		 */
+		if (wrk->latency)
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+					&arrival, NULL);
+
 		clock_gettime(CLOCK_MONOTONIC, &repeat_start);
 
 		for_each_w_step(w, wrk) {
@@ -2875,10 +3198,13 @@ static void *run_workload(void *data)
 			if (throttle > 0)
 				w_sync_to(wrk, w, w->idx - throttle);
 
-			if (is_xe)
+			if (is_xe) {
 				do_xe_exec(wrk, w);
-			else
+			} else {
+				if (wrk->timing)
+					collect_timestamps(wrk, w);
 				do_eb(wrk, w);
+			}
 
 			if (w->rq_link.next) {
 				igt_list_del(&w->rq_link);
@@ -2933,6 +3259,20 @@ static void *run_workload(void *data)
 			if (wrk->flags & FLAG_VERIFY_COMPLETION)
 				xe_w_step_sync_and_verify(w);
 		}
+
+		/* The frame is complete once all of its batches are. */
+		if (wrk->latency && wrk->run) {
+			struct timespec now;
+
+			for_each_w_step(w, wrk) {
+				if (w->type == BATCH)
+					w_step_sync(w);
+			}
+
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			record_latency(wrk, &arrival, &now);
+			next_arrival(wrk, &arrival);
+		}
 	}
 
 	for (int i = query_engines()->nr_engines; --i >= 0;) {
@@ -2943,6 +3283,13 @@ static void *run_workload(void *data)
 		w_step_sync(w);
 	}
 
+	if (wrk->timing) {
+		for_each_w_step(w, wrk) {
+			if (w->type == BATCH)
+				collect_timestamps(wrk, w);
+		}
+	}
+
 	if (is_xe) {
 		for_each_w_step(w, wrk) {
 			if (w->type == BATCH) {
@@ -2971,6 +3318,14 @@ static void *run_workload(void *data)
 		if (time_tot)
 			printf(" Time avg/min/max=%lu/%lu/%luus; %u missed.",
 			       time_tot / count, time_min, time_max, missed);
+		if (wrk->latency && wrk->latency->count)
+			printf(" Latency p50/p99/p99.9/max=%u/%u/%u/%uus; %lu/%lu over %uus deadline.",
+			       latency_percentile(wrk->latency, 50),
+			       latency_percentile(wrk->latency, 99),
+			       latency_percentile(wrk->latency, 99.9),
+			       wrk->latency->max,
+			       wrk->latency->missed, wrk->latency->count,
+			       wrk->arrival.deadline_us);
 		putchar('\n');
 	}
 
@@ -2979,6 +3334,9 @@ static void *run_workload(void *data)
 
 static void fini_workload(struct workload *wrk)
 {
+	free(wrk->latency);
+	free(wrk->timing);
+	free(wrk->busy);
 	free(wrk->steps);
 	free(wrk);
 }
@@ -3004,8 +3362,25 @@ static void print_help(void)
 "  -a <desc|path>    Append a workload to all other workloads.\n"
 "  -r <n>            How many times to emit the workload.\n"
 "  -c <n>            Fork N clients emitting the workload simultaneously.\n"
+"  -P <placement>    Pin clients to CPUs: none (default), compact, spread or\n"
+"                    numa-local to the GPU.\n"
 "  -s                Turn on small SSEU config for the next workload on the\n"
 "                    command line. Subsequent -s switches it off.\n"
+"  -A <arrivals>     Open-loop arrivals for the following workloads on the\n"
+"                    command line, as fixed:<fps>[:<deadline-us>] or\n"
+"                    poisson:<fps>[:<deadline-us>]. Each workload iteration is a\n"
+"                    frame arriving at the given rate, regardless of GPU\n"
+"                    progress. Frame latency percentiles and deadline misses\n"
+"                    are reported per client. The deadline defaults to the\n"
+"                    arrival period. Use 'closed' to switch back to closed\n"
+"                    loop.\n"
+"  -T <file>         Record CS timestamps at the start and end of every batch\n"
+"                    and write per step queue, run and completion latency\n"
+"                    distributions and engine occupancy timelines to the file\n"
+"                    as JSON. A batch waits for its previous execution before\n"
+"                    being submitted again. Only supported on i915.\n"
+"  -U                Track batch completion with user fences on xe, checking\n"
+"                    them from userspace before waiting in the kernel.\n"
 "  -S                Synchronize the sequence of random batch durations between\n"
 "                    clients.\n"
 "  -d                Sync between data dependencies in userspace.\n"
@@ -3063,15 +3438,44 @@ static char *load_workload_descriptor(char *filename)
 
 static struct w_arg *
 add_workload_arg(struct w_arg *w_args, unsigned int nr_args, char *w_arg,
-		 int prio, bool sseu)
+		 int prio, bool sseu, const struct arrival *arrival)
 {
 	w_args = realloc(w_args, sizeof(*w_args) * nr_args);
 	igt_assert(w_args);
-	w_args[nr_args - 1] = (struct w_arg) { w_arg, NULL, prio, sseu };
+	w_args[nr_args - 1] = (struct w_arg) { w_arg, NULL, prio, sseu, *arrival };
 
 	return w_args;
 }
 
+static int parse_arrival(struct arrival *arrival, const char *str)
+{
+	unsigned int deadline_us = 0;
+	char process[16];
+	double rate;
+	int n;
+
+	if (!strcmp(str, "closed")) {
+		memset(arrival, 0, sizeof(*arrival));
+		return 0;
+	}
+
+	n = sscanf(str, "%15[a-z]:%lf:%u", process, &rate, &deadline_us);
+	if (n < 2 || rate <= 0)
+		return -1;
+
+	if (!strcmp(process, "fixed"))
+		arrival->process = ARRIVAL_FIXED;
+	else if (!strcmp(process, "poisson"))
+		arrival->process = ARRIVAL_POISSON;
+	else
+		return -1;
+
+	arrival->rate = rate;
+	arrival->deadline_us = deadline_us ?: 1e6 / rate;
+
+	return 0;
+}
+
 static void list_engines(void)
 {
 	struct intel_engines *engines = query_engines();
@@ -3103,6 +3507,118 @@ static void list_engines(void)
 	}
 }
 
+static void engine_to_str(const intel_engine_t *engine, char *buf, size_t len)
+{
+	if (engine->engine_class == DEFAULT_ID)
+		snprintf(buf, len, "DEFAULT");
+	else if (engine->engine_instance == DEFAULT_ID)
+		snprintf(buf, len, "%s",
+			 intel_engine_class_string(engine->engine_class));
+	else
+		snprintf(buf, len, "%s%u",
+			 intel_engine_class_string(engine->engine_class),
+			 engine->engine_instance + 1);
+}
+
+static void write_histogram(FILE *f, const char *name,
+			    const struct latency_histogram *h)
+{
+	fprintf(f, "\"%s\": { \"mean\": %.1f, \"p50\": %u, \"p90\": %u, "
+		"\"p99\": %u, \"max\": %u }",
+		name, h->count ? (double)h->sum / h->count : 0.0,
+		latency_percentile(h, 50), latency_percentile(h, 90),
+		latency_percentile(h, 99), h->max);
+}
+
+/*
+ * Steps on a load balanced engine are reported under the engine class as
+ * the physical engine which executed them is not known.
+ */
+static void write_timestamps(FILE *f, struct workload **w, unsigned int clients)
+{
+	fprintf(f, "{\n  \"timestamp_frequency\": %d,\n  \"clients\": [",
+		read_timestamp_frequency(fd));
+
+	for (unsigned int i = 0; i < clients; i++) {
+		struct workload *wrk = w[i];
+		char (*names)[16];
+		bool first = true;
+		struct w_step *s;
+
+		names = calloc(wrk->nr_steps, sizeof(*names));
+		igt_assert(names);
+
+		fprintf(f, "%s\n    {\n      \"id\": %u,\n      \"steps\": [",
+			i ? "," : "", wrk->id);
+
+		for_each_w_step(s, wrk) {
+			struct step_timing *t = &wrk->timing[s->idx];
+
+			if (s->type != BATCH)
+				continue;
+
+			engine_to_str(&s->engine, names[s->idx], sizeof(*names));
+			if (!t->run.count)
+				continue;
+
+			fprintf(f, "%s\n        { \"step\": %u, \"engine\": \"%s\", "
+				"\"executions\": %lu,\n          ",
+				first ? "" : ",", s->idx, names[s->idx],
+				t->run.count);
+			write_histogram(f, "queue_us", &t->queue);
+			fprintf(f, ",\n          ");
+			write_histogram(f, "run_us", &t->run);
+			fprintf(f, ",\n          ");
+			write_histogram(f, "completion_us", &t->completion);
+			fprintf(f, " }");
+			first = false;
+		}
+
+		fprintf(f, "\n      ],\n      \"engines\": [");
+
+		first = true;
+		for_each_w_step(s, wrk) {
+			uint64_t busy_ns = 0;
+			bool seen = false;
+
+			if (s->type != BATCH)
+				continue;
+
+			for (unsigned int j = 0; j < s->idx; j++)
+				seen |= wrk->steps[j].type == BATCH &&
+					!strcmp(names[j], names[s->idx]);
+			if (seen)
+				continue;
+
+			fprintf(f, "%s\n        { \"engine\": \"%s\", \"timeline_us\": [",
+				first ? "" : ",", names[s->idx]);
+
+			seen = false;
+			for (unsigned int j = 0; j < wrk->nr_busy; j++) {
+				const struct busy_interval *b = &wrk->busy[j];
+
+				if (strcmp(names[b->step], names[s->idx]))
+					continue;
+
+				fprintf(f, "%s[%.1f, %.1f, %u]", seen ? ", " : "",
+					(int64_t)(b->start_ns - epoch_ns) / 1e3,
+					(int64_t)(b->end_ns - epoch_ns) / 1e3,
+					b->step);
+				busy_ns += b->end_ns - b->start_ns;
+				seen = true;
+			}
+
+			fprintf(f, "], \"busy_us\": %.1f }", busy_ns / 1e3);
+			first = false;
+		}
+
+		fprintf(f, "\n      ]\n    }");
+		free(names);
+	}
+
+	fprintf(f, "\n  ]\n}\n");
+}
+
 int main(int argc, char **argv)
 {
 	struct igt_device_card card = { };
@@ -3118,8 +3634,11 @@ int main(int argc, char **argv)
 	int master_workload = -1;
 	char *append_workload_arg = NULL;
 	struct w_arg *w_args = NULL;
+	struct arrival arrival = { };
+	FILE *timestamps_file = NULL;
 	int exitcode = EXIT_FAILURE;
 	char *device_arg = NULL;
+	enum igt_fork_placement placement = IGT_FORK_PLACEMENT_NONE;
 	double scale_time = 1.0f;
 	double scale_dur = 1.0f;
 	int prio = 0;
@@ -3130,7 +3649,7 @@ int main(int argc, char **argv)
 	master_prng = time(NULL);
 
 	while ((c = getopt(argc, argv,
-			   "LlhqvVsSdc:r:w:W:a:p:I:f:F:D:")) != -1) {
+			   "LlhqvVsSUdc:r:w:W:a:p:P:I:f:F:D:A:T:")) != -1) {
 		switch (c) {
 		case 'L':
 			list_devices_arg = true;
@@ -3150,7 +3669,25 @@ int main(int argc, char **argv)
 			/* Fall through */
 		case 'w':
 			w_args = add_workload_arg(w_args, ++nr_w_args, optarg,
-						  prio, flags & FLAG_SSEU);
+						  prio, flags & FLAG_SSEU,
+						  &arrival);
+			break;
+		case 'A':
+			if (parse_arrival(&arrival, optarg)) {
+				wsim_err("Invalid arrivals '%s'!\n", optarg);
+				goto err;
+			}
+			break;
+		case 'T':
+			if (timestamps_file)
+				fclose(timestamps_file);
+			timestamps_file = fopen(optarg, "w");
+			if (!timestamps_file) {
+				wsim_err("Failed to open '%s'! (%s)\n",
+					 optarg, strerror(errno));
+				goto err;
+			}
+			flags |= FLAG_TIMESTAMPS;
 			break;
 		case 'p':
 			prio = atoi(optarg);
@@ -3165,6 +3702,12 @@ int main(int argc, char **argv)
 		case 'c':
 			clients = strtol(optarg, NULL, 0);
 			break;
+		case 'P':
+			if (!igt_fork_placement_from_string(optarg, &placement)) {
+				wsim_err("Invalid placement '%s'!\n", optarg);
+				goto err;
+			}
+			break;
 
 		case 'r':
 			repeat = strtol(optarg, NULL, 0);
@@ -3181,6 +3724,9 @@ int main(int argc, char **argv)
 		case 'S':
 			flags |= FLAG_SYNCEDCLIENTS;
 			break;
+		case 'U':
+			flags |= FLAG_XE_UFENCE;
+			break;
 		case 's':
 			flags ^= FLAG_SSEU;
 			break;
@@ -3257,6 +3803,9 @@ int main(int argc, char **argv)
 	if (verbose > 1)
 		printf("Using device %s\n", drm_dev);
 
+	igt_fork_set_placement(placement,
+			       igt_device_get_numa_node(card.pci_slot_name));
+
 	is_xe = is_xe_device(fd);
 	if (is_xe)
 		xe_device_get(fd);
@@ -3266,6 +3815,16 @@ int main(int argc, char **argv)
 		goto out;
 	}
 
+	if (!is_xe && (flags & FLAG_XE_UFENCE)) {
+		wsim_err("User fences are only supported on xe!\n");
+		goto err;
+	}
+
+	if (is_xe && (flags & FLAG_TIMESTAMPS)) {
+		wsim_err("GPU timestamps are only supported on i915!\n");
+		goto err;
+	}
+
 	if (!nr_w_args) {
 		wsim_err("No workload descriptor(s)!\n");
 		goto err;
@@ -3338,7 +3897,8 @@ int main(int argc, char **argv)
 		w[i]->repeat = repeat;
 		w[i]->background = master_workload >= 0 && i != master_workload;
 		w[i]->print_stats = verbose > 1 ||
-				    (verbose > 0 && master_workload == i);
+				    (verbose > 0 && (master_workload == i ||
+						     w[i]->arrival.process));
 
 		if (prepare_workload(i, w[i])) {
 			wsim_err("Failed to prepare workload %u!\n", i);
@@ -3347,6 +3907,7 @@ int main(int argc, char **argv)
 	}
 
 	clock_gettime(CLOCK_MONOTONIC, &t_start);
+	epoch_ns = t_start.tv_sec * NSEC_PER_SEC + t_start.tv_nsec;
 
 	for (i = 0; i < clients; i++) {
 		ret = pthread_create(&w[i]->thread, NULL, run_workload, w[i]);
@@ -3375,6 +3936,9 @@ int main(int argc, char **argv)
 		printf("%.3fs elapsed (%.3f workloads/s)\n",
 		       t, clients * repeat / t);
 
+	if (timestamps_file)
+		write_timestamps(timestamps_file, w, clients);
+
 	for (i = 0; i < clients; i++)
 		fini_workload(w[i]);
 	free(w);
@@ -3385,6 +3949,8 @@ int main(int argc, char **argv)
 out:
 	exitcode = EXIT_SUCCESS;
 err:
+	if (timestamps_file)
+		fclose(timestamps_file);
 	if (is_xe)
 		xe_device_put(fd);
 
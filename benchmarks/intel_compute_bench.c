@@ -0,0 +1,256 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2025 Intel Corporation
+ */
+
+/*
+ * Measures the compute dispatch path with the square kernel of
+ * lib/intel_compute.c:
+ *
+ *  - latency of the smallest dispatch, a single thread group,
+ *  - dispatch rate with walkers in flight on one or more compute engines,
+ *  - throughput against the work size, that is the number of thread groups,
+ *  - latency of a short kernel preempting the long kernel, with threadgroup
+ *    and mid thread preemption.
+ */
+
+#include "igt.h"
+#include "igt_bench.h"
+#include "intel_compute.h"
+#include "xe/xe_ioctl.h"
+#include "xe/xe_query.h"
+
+#define MAX_ENGINES	8
+#define LATENCY_SAMPLES	256
+/* Lanes of a thread group, fixed by the kernels and the walker */
+#define GROUP_SIZE	1024
+
+struct compute {
+	struct igt_bench bench;
+
+	int fd;
+	struct drm_xe_engine_class_instance *engines[MAX_ENGINES];
+	struct intel_compute_env *envs[MAX_ENGINES];
+	unsigned int num_engines;
+	unsigned int engines_used;
+	unsigned int depth;
+	unsigned long next;
+	uint32_t work_size;
+
+	bool threadgroup;
+	igt_stats_t preempt;
+
+	uint32_t max_work_size;
+	unsigned int max_depth;
+};
+
+/* Cycles through the engines, then through the slots of each */
+static void dispatch(void *data, unsigned int thread, unsigned long count)
+{
+	struct compute *c = data;
+
+	while (count--) {
+		unsigned int engine = c->next % c->engines_used;
+		unsigned int slot = c->next / c->engines_used % c->depth;
+
+		intel_compute_env_dispatch(c->envs[engine], slot, c->work_size);
+		c->next++;
+	}
+
+	for (unsigned int n = 0; n < c->engines_used; n++)
+		intel_compute_env_sync(c->envs[n]);
+}
+
+static void preempt(void *data, unsigned int thread, unsigned long count)
+{
+	struct compute *c = data;
+	uint64_t ns;
+
+	while (count--) {
+		igt_assert(run_intel_compute_kernel_preempt_latency(c->fd,
+								    c->engines[0],
+								    c->threadgroup,
+								    EXECENV_PREF_VRAM_IF_POSSIBLE,
+								    &ns));
+		igt_stats_push_float(&c->preempt, ns * 1e-3);
+	}
+}
+
+static void latency(struct compute *c, double *median, double *p99)
+{
+	struct timespec start;
+	igt_stats_t stats;
+
+	igt_stats_init_with_size(&stats, LATENCY_SAMPLES);
+	for (int n = 0; n < LATENCY_SAMPLES; n++) {
+		igt_nsec_elapsed(&start);
+		dispatch(c, 0, 1);
+		igt_stats_push_float(&stats, igt_nsec_elapsed(&start) * 1e-3);
+	}
+
+	*median = igt_stats_get_median(&stats);
+	*p99 = igt_stats_get_percentile(&stats, 99);
+	igt_stats_fini(&stats);
+}
+
+static void run(struct compute *c, const char *mode)
+{
+	struct igt_bench_result result;
+	double median, p99;
+	char label[64];
+
+	snprintf(label, sizeof(label), "mode=%s,engines=%u,depth=%u,size=%u",
+		 mode, c->engines_used, c->depth, c->work_size);
+	c->next = 0;
+	igt_bench_run(&c->bench, label, dispatch, c, &result);
+
+	latency(c, &median, &p99);
+
+	printf("%-8s %7u %5u %8u %6u %14.0f %12.0f %9.1f %9.1f\n",
+	       mode, c->engines_used, c->depth, c->work_size,
+	       DIV_ROUND_UP(c->work_size, GROUP_SIZE), result.mean,
+	       result.ci95, median, p99);
+
+	igt_bench_result_fini(&result);
+}
+
+static void run_preempt(struct compute *c, bool threadgroup)
+{
+	struct igt_bench_result result;
+	char label[64];
+
+	if (!xe_kernel_preempt_check(c->fd, threadgroup ? PREEMPT_TGP :
+							  PREEMPT_WMTP)) {
+		igt_info("%s preemption not supported, skipping\n",
+			 threadgroup ? "threadgroup" : "mid thread");
+		return;
+	}
+
+	c->threadgroup = threadgroup;
+	igt_stats_init(&c->preempt);
+
+	snprintf(label, sizeof(label), "mode=preempt,type=%s",
+		 threadgroup ? "tgp" : "wmtp");
+	igt_bench_run(&c->bench, label, preempt, c, &result);
+
+	printf("%-8s %7s %5s %8s %6s %14.2f %12.2f %9.1f %9.1f\n",
+	       threadgroup ? "tgp" : "wmtp", "", "", "", "",
+	       result.mean, result.ci95,
+	       igt_stats_get_median(&c->preempt),
+	       igt_stats_get_percentile(&c->preempt, 99));
+
+	igt_stats_fini(&c->preempt);
+	igt_bench_result_fini(&result);
+}
+
+static int opt_handler(int opt, int opt_index, void *data)
+{
+	struct compute *c = data;
+
+	switch (opt) {
+	case 's':
+		c->max_work_size = max(atoi(optarg), GROUP_SIZE);
+		break;
+	case 'd':
+		c->max_depth = clamp(atoi(optarg), 1, 64);
+		break;
+	default:
+		return IGT_OPT_HANDLER_ERROR;
+	}
+
+	return IGT_OPT_HANDLER_SUCCESS;
+}
+
+static const char help_str[] =
+	"  -s <elements>     Largest work size of the size sweep, 1M by default.\n"
+	"  -d <depth>        Largest number of dispatches in flight per engine,\n"
+	"                    sweeps powers of two up to it, 16 by default.\n"
+	"Reports dispatches/s, or elements/s for the size sweep, and the p50/p99\n"
+	"latency of a single dispatch in us. The preemption rows report complete\n"
+	"preemption scenarios/s and the p50/p99 latency of the preempting kernel.\n";
+
+int main(int argc, char **argv)
+{
+	struct drm_xe_engine_class_instance *hwe;
+	struct user_execenv user = {
+		.skip_results_check = true,
+	};
+	struct compute c = {
+		.max_work_size = 1 << 20,
+		.max_depth = 16,
+	};
+
+	igt_bench_init(&c.bench, "intel_compute_bench");
+	c.bench.opts.duration = 1;
+	igt_bench_parse_opts(&c.bench, argc, argv, "s:d:", help_str,
+			     opt_handler, &c);
+	/* The environments can't be shared across processes */
+	c.bench.opts.threads = 1;
+
+	c.fd = drm_open_driver(DRIVER_XE);
+	igt_bench_set_device(&c.bench, c.fd);
+
+	xe_for_each_engine(c.fd, hwe)
+		if (hwe->engine_class == DRM_XE_ENGINE_CLASS_COMPUTE &&
+		    c.num_engines < MAX_ENGINES)
+			c.engines[c.num_engines++] = hwe;
+	igt_require(c.num_engines);
+
+	/* Only the first engine runs the size sweep */
+	for (unsigned int n = 0; n < c.num_engines; n++) {
+		user.array_size = n ? GROUP_SIZE : c.max_work_size;
+		c.envs[n] = intel_compute_env_create(c.fd, c.engines[n], &user,
+						     EXECENV_PREF_VRAM_IF_POSSIBLE,
+						     c.max_depth);
+		igt_require_f(c.envs[n],
+			      "Persistent compute environment not supported\n");
+	}
+
+	printf("%-8s %7s %5s %8s %6s %14s %12s %9s %9s\n",
+	       "mode", "engines", "depth", "size", "groups", "throughput",
+	       "ci95", "p50 (us)", "p99 (us)");
+
+	igt_bench_set_unit(&c.bench, "dispatches/s", 1);
+
+	/* A single thread group, waited on */
+	c.engines_used = 1;
+	c.depth = 1;
+	c.work_size = 1;
+	run(&c, "empty");
+
+	/* Walkers in flight, spread over more and more engines */
+	c.work_size = GROUP_SIZE;
+	for (c.engines_used = 1; ;
+	     c.engines_used = min(2 * c.engines_used, c.num_engines)) {
+		for (c.depth = 1; ; c.depth = min(2 * c.depth, c.max_depth)) {
+			run(&c, "inflight");
+			if (c.depth == c.max_depth)
+				break;
+		}
+		if (c.engines_used == c.num_engines)
+			break;
+	}
+
+	/* Growing grids of thread groups on a single engine */
+	c.engines_used = 1;
+	c.depth = c.max_depth;
+	for (c.work_size = GROUP_SIZE; ; c.work_size = min(4 * c.work_size,
+							   c.max_work_size)) {
+		igt_bench_set_unit(&c.bench, "elements/s", c.work_size);
+		run(&c, "size");
+		if (c.work_size == c.max_work_size)
+			break;
+	}
+
+	for (unsigned int n = 0; n < c.num_engines; n++)
+		intel_compute_env_destroy(c.envs[n]);
+
+	igt_bench_set_unit(&c.bench, "preemptions/s", 1);
+	run_preempt(&c, true);
+	run_preempt(&c, false);
+
+	igt_bench_fini(&c.bench);
+	drm_close_driver(c.fd);
+
+	return 0;
+}
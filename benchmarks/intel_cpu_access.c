@@ -0,0 +1,523 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2025 Intel Corporation
+ */
+
+/*
+ * Measures how fast the CPU writes and reads buffer objects through each of
+ * the ways to access them, for every memory region the CPU can reach, on i915
+ * and Xe:
+ *
+ *   prw      pwrite/pread (i915 only)
+ *   gtt      mmap through the mappable aperture (i915 only)
+ *   wb       write-back mmap, on Xe of an object with WB CPU caching
+ *   wc       write-combined mmap, on Xe of an object with WC CPU caching
+ *   uc       uncached mmap (i915 only)
+ *   fixed    mmap with the caching the kernel picks for the placement, the
+ *            only type of mmap on discrete (i915 only)
+ *   userptr  anonymous memory made into an object, or bound to a VM on Xe
+ *
+ * Reads through a mapping are timed both with plain loads and with streaming
+ * loads (MOVNTDQA, as igt_memcpy_from_wc() does), which are the fast way to
+ * read WC and UC memory, when the CPU has SSE4.1.
+ *
+ * Each combination is swept over the access sizes and over the number of
+ * processes accessing concurrently, each its own object. Reported are the
+ * aggregate bandwidth and the time each access takes, which is the latency
+ * for the small sizes.
+ */
+
+#include <sys/mman.h>
+
+#include "igt.h"
+#include "igt_bench.h"
+#include "igt_x86.h"
+#include "i915/intel_memory_region.h"
+#include "xe/xe_ioctl.h"
+#include "xe/xe_query.h"
+
+#define MAX_THREADS	64
+#define MAX_REGIONS	16
+
+enum method {
+	METHOD_PRW,
+	METHOD_GTT,
+	METHOD_WB,
+	METHOD_WC,
+	METHOD_UC,
+	METHOD_FIXED,
+	METHOD_USERPTR,
+	NUM_METHODS
+};
+
+static const char * const method_names[NUM_METHODS] = {
+	[METHOD_PRW] = "prw",
+	[METHOD_GTT] = "gtt",
+	[METHOD_WB] = "wb",
+	[METHOD_WC] = "wc",
+	[METHOD_UC] = "uc",
+	[METHOD_FIXED] = "fixed",
+	[METHOD_USERPTR] = "userptr",
+};
+
+enum access {
+	ACCESS_WRITE,
+	ACCESS_READ,
+	ACCESS_STREAM,
+	NUM_ACCESSES
+};
+
+static const char * const access_names[NUM_ACCESSES] = {
+	[ACCESS_WRITE] = "write",
+	[ACCESS_READ] = "read",
+	[ACCESS_STREAM] = "stream",
+};
+
+struct region {
+	char name[16];
+	bool system;
+	uint64_t avail;
+	uint32_t id; /* i915 region id or Xe placement */
+};
+
+struct slot {
+	uint32_t handle;
+	void *ptr; /* mapping of the object, or userptr memory */
+	void *buf; /* system memory copied to and from the object */
+};
+
+struct suite {
+	struct igt_bench bench;
+	int fd;
+	bool xe;
+	uint32_t vm;
+
+	struct region regions[MAX_REGIONS];
+	unsigned int num_regions;
+
+	/* The combination being measured */
+	enum method method;
+	enum access access;
+	uint64_t size;
+	struct slot slots[MAX_THREADS];
+	unsigned int num_slots;
+
+	unsigned int method_mask;
+	unsigned int access_mask;
+	uint64_t min_size;
+	uint64_t max_size;
+	unsigned int max_threads;
+};
+
+static void get_regions(struct suite *s)
+{
+	uint64_t ram = igt_get_avail_ram_mb() << 20;
+	uint32_t placement;
+
+	if (s->xe) {
+		xe_for_each_mem_region(s->fd, all_memory_regions(s->fd), placement) {
+			struct drm_xe_mem_region *mem = xe_mem_region(s->fd, placement);
+			struct region *r = &s->regions[s->num_regions];
+
+			if (s->num_regions == MAX_REGIONS)
+				break;
+
+			snprintf(r->name, sizeof(r->name), "%s",
+				 xe_region_name(placement));
+			r->id = placement;
+			r->system = mem->mem_class == DRM_XE_MEM_REGION_CLASS_SYSMEM;
+			r->avail = r->system ? ram :
+				   min(mem->cpu_visible_size,
+				       mem->total_size - min(mem->used, mem->total_size));
+			s->num_regions++;
+		}
+
+		return;
+	}
+
+	for_each_memory_region(m, s->fd) {
+		struct region *r = &s->regions[s->num_regions];
+
+		/* Stolen memory can't back objects */
+		if (s->num_regions == MAX_REGIONS ||
+		    (m->ci.memory_class != I915_MEMORY_CLASS_SYSTEM &&
+		     m->ci.memory_class != I915_MEMORY_CLASS_DEVICE))
+			continue;
+
+		snprintf(r->name, sizeof(r->name), "%s", m->name);
+		r->id = INTEL_MEMORY_REGION_ID(m->ci.memory_class,
+					       m->ci.memory_instance);
+		r->system = m->ci.memory_class == I915_MEMORY_CLASS_SYSTEM;
+		r->avail = r->system ? ram : m->cpu_size ?: m->size;
+		s->num_regions++;
+	}
+
+	/* Before the region query, everything is in system memory */
+	if (!s->num_regions) {
+		snprintf(s->regions[0].name, sizeof(s->regions[0].name), "smem0");
+		s->regions[0].id = REGION_SMEM;
+		s->regions[0].system = true;
+		s->regions[0].avail = ram;
+		s->num_regions = 1;
+	}
+}
+
+static void *map_i915(struct suite *s, uint32_t handle)
+{
+	static const uint64_t types[NUM_METHODS] = {
+		[METHOD_GTT] = I915_MMAP_OFFSET_GTT,
+		[METHOD_WB] = I915_MMAP_OFFSET_WB,
+		[METHOD_WC] = I915_MMAP_OFFSET_WC,
+		[METHOD_UC] = I915_MMAP_OFFSET_UC,
+		[METHOD_FIXED] = I915_MMAP_OFFSET_FIXED,
+	};
+	const int prot = PROT_READ | PROT_WRITE;
+
+	if (gem_has_mmap_offset(s->fd))
+		return __gem_mmap_offset(s->fd, handle, 0, s->size, prot,
+					 types[s->method]);
+
+	switch (s->method) {
+	case METHOD_GTT:
+		return __gem_mmap__gtt(s->fd, handle, s->size, prot);
+	case METHOD_WB:
+		return __gem_mmap__cpu(s->fd, handle, 0, s->size, prot);
+	case METHOD_WC:
+		return __gem_mmap__wc(s->fd, handle, 0, s->size, prot);
+	default:
+		return NULL;
+	}
+}
+
+static bool create_userptr(struct suite *s, const struct region *r,
+			   unsigned int idx, struct slot *sl)
+{
+	if (!r->system)
+		return false;
+
+	/* Shared, so that the object is the memory the children access */
+	sl->ptr = mmap(NULL, s->size, PROT_READ | PROT_WRITE,
+		       MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	igt_assert(sl->ptr != MAP_FAILED);
+	memset(sl->ptr, 0, s->size);
+
+	if (s->xe) {
+		xe_vm_bind_userptr_async(s->fd, s->vm, 0, to_user_pointer(sl->ptr),
+					 (uint64_t)(idx + 1) << 36, s->size,
+					 NULL, 0);
+		return true;
+	}
+
+	if (__gem_userptr(s->fd, sl->ptr, s->size, 0, 0, &sl->handle)) {
+		munmap(sl->ptr, s->size);
+		sl->ptr = NULL;
+		return false;
+	}
+
+	return true;
+}
+
+static bool create_object(struct suite *s, const struct region *r,
+			  struct slot *sl)
+{
+	uint64_t size = s->size;
+
+	if (s->xe) {
+		uint16_t caching;
+
+		if (s->method == METHOD_WB)
+			caching = DRM_XE_GEM_CPU_CACHING_WB;
+		else if (s->method == METHOD_WC)
+			caching = DRM_XE_GEM_CPU_CACHING_WC;
+		else
+			return false;
+
+		if (__xe_bo_create_caching(s->fd, 0, size, r->id,
+					   r->system ? 0 :
+					   DRM_XE_GEM_CREATE_FLAG_NEEDS_VISIBLE_VRAM,
+					   caching, &sl->handle))
+			return false;
+
+		sl->ptr = xe_bo_mmap_ext(s->fd, sl->handle, size,
+					 PROT_READ | PROT_WRITE);
+		return true;
+	}
+
+	if (__gem_create_with_cpu_access_in_memory_regions(s->fd, &sl->handle,
+							   &size, r->id))
+		return false;
+
+	/* pread/pwrite are gone with local memory */
+	if (s->method == METHOD_PRW)
+		return !__gem_write(s->fd, sl->handle, 0, sl->buf, s->size);
+
+	sl->ptr = map_i915(s, sl->handle);
+
+	return sl->ptr;
+}
+
+static void destroy_slots(struct suite *s)
+{
+	for (unsigned int i = 0; i < s->num_slots; i++) {
+		struct slot *sl = &s->slots[i];
+
+		if (sl->ptr)
+			munmap(sl->ptr, s->size);
+		if (sl->handle)
+			gem_close(s->fd, sl->handle);
+		free(sl->buf);
+		memset(sl, 0, sizeof(*sl));
+	}
+	s->num_slots = 0;
+
+	/* Also drops the userptr bindings */
+	if (s->vm) {
+		xe_vm_destroy(s->fd, s->vm);
+		s->vm = 0;
+	}
+}
+
+static bool create_slots(struct suite *s, const struct region *r,
+			 unsigned int count)
+{
+	if (s->xe && s->method == METHOD_USERPTR)
+		s->vm = xe_vm_create(s->fd, 0, 0);
+
+	for (unsigned int i = 0; i < count; i++) {
+		struct slot *sl = &s->slots[i];
+		bool ok;
+
+		sl->buf = aligned_alloc(4096, s->size);
+		igt_assert(sl->buf);
+		memset(sl->buf, 0x5a, s->size);
+		s->num_slots++;
+
+		if (s->method == METHOD_USERPTR)
+			ok = create_userptr(s, r, i, sl);
+		else
+			ok = create_object(s, r, sl);
+
+		if (!ok) {
+			destroy_slots(s);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void cpu_access(void *data, unsigned int thread, unsigned long count)
+{
+	const struct suite *s = data;
+	const struct slot *sl = &s->slots[thread];
+
+	while (count--) {
+		switch (s->access) {
+		case ACCESS_WRITE:
+			if (s->method == METHOD_PRW)
+				gem_write(s->fd, sl->handle, 0, sl->buf, s->size);
+			else
+				memcpy(sl->ptr, sl->buf, s->size);
+			break;
+		case ACCESS_READ:
+			if (s->method == METHOD_PRW)
+				gem_read(s->fd, sl->handle, 0, sl->buf, s->size);
+			else
+				memcpy(sl->buf, sl->ptr, s->size);
+			break;
+		case ACCESS_STREAM:
+			igt_memcpy_from_wc(sl->buf, sl->ptr, s->size);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+static bool fits(const struct suite *s, const struct region *r,
+		 unsigned int threads)
+{
+	uint64_t bytes = s->size * threads;
+	uint64_t ram = igt_get_avail_ram_mb() << 20;
+
+	/* Leave a quarter spare for everybody else */
+	if (r->system)
+		return 2 * bytes <= ram / 4 * 3;
+
+	return bytes <= r->avail / 4 * 3 && bytes <= ram / 4 * 3;
+}
+
+/* Returns false if the method can't access the region at all */
+static bool run(struct suite *s, const struct region *r, unsigned int threads)
+{
+	struct igt_bench_result result;
+	char label[128];
+	double us;
+
+	if (!fits(s, r, threads))
+		return true;
+
+	if (!create_slots(s, r, threads))
+		return false;
+
+	snprintf(label, sizeof(label),
+		 "region=%s,method=%s,access=%s,size=%" PRIu64 ",threads=%u",
+		 r->name, method_names[s->method], access_names[s->access],
+		 s->size, threads);
+
+	s->bench.opts.threads = threads;
+	igt_bench_set_unit(&s->bench, "GB/s", s->size / 1e9);
+	igt_bench_run(&s->bench, label, cpu_access, s, &result);
+
+	/* Each process does its share of the accesses */
+	us = result.mean ? threads * s->size / (result.mean * 1e3) : 0;
+	printf("%-7s %-7s %-6s %10" PRIu64 " %7u %9.3f %8.3f %10.2f\n",
+	       r->name, method_names[s->method], access_names[s->access],
+	       s->size, threads, result.mean, result.ci95, us);
+	fflush(stdout);
+
+	igt_bench_result_fini(&result);
+	destroy_slots(s);
+
+	return true;
+}
+
+static bool supports(const struct suite *s, enum method method,
+		     enum access access)
+{
+	if (access == ACCESS_STREAM &&
+	    (method == METHOD_PRW || !(igt_x86_features() & SSE4_1)))
+		return false;
+
+	if (s->xe)
+		return method == METHOD_WB || method == METHOD_WC ||
+		       method == METHOD_USERPTR;
+
+	return true;
+}
+
+static int parse_list(const char *list, const char * const *names,
+		      int count, unsigned int *mask)
+{
+	char *str, *name, *save;
+	int ret = 0;
+
+	*mask = 0;
+	str = strdup(list);
+	for (name = strtok_r(str, ",", &save); name;
+	     name = strtok_r(NULL, ",", &save)) {
+		int i;
+
+		for (i = 0; i < count; i++)
+			if (!strcmp(name, names[i]))
+				break;
+
+		if (i == count) {
+			fprintf(stderr, "Unknown name '%s'\n", name);
+			ret = -1;
+			break;
+		}
+		*mask |= 1u << i;
+	}
+	free(str);
+
+	return ret;
+}
+
+static int opt_handler(int opt, int opt_index, void *data)
+{
+	struct suite *s = data;
+
+	switch (opt) {
+	case 'M':
+		if (parse_list(optarg, method_names, NUM_METHODS,
+			       &s->method_mask))
+			return IGT_OPT_HANDLER_ERROR;
+		break;
+	case 'a':
+		if (parse_list(optarg, access_names, NUM_ACCESSES,
+			       &s->access_mask))
+			return IGT_OPT_HANDLER_ERROR;
+		break;
+	case 's':
+		s->min_size = max(strtoull(optarg, NULL, 0), 4096ull);
+		break;
+	case 'S':
+		s->max_size = strtoull(optarg, NULL, 0);
+		break;
+	case 'n':
+		s->max_threads = min(max(atoi(optarg), 1), MAX_THREADS);
+		break;
+	default:
+		return IGT_OPT_HANDLER_ERROR;
+	}
+
+	return IGT_OPT_HANDLER_SUCCESS;
+}
+
+static const char help_str[] =
+	"  -M <list>         Access methods to sweep:\n"
+	"                    prw,gtt,wb,wc,uc,fixed,userptr (default all).\n"
+	"  -a <list>         Accesses to sweep: write,read,stream (default all).\n"
+	"  -s <bytes>        Smallest access size (default 4KiB).\n"
+	"  -S <bytes>        Largest access size (default 64MiB).\n"
+	"  -n <n>            Sweep from one to n processes, doubling (default\n"
+	"                    the number of CPUs).\n";
+
+int main(int argc, char **argv)
+{
+	struct suite s = {
+		.method_mask = -1,
+		.access_mask = -1,
+		.min_size = SZ_4K,
+		.max_size = SZ_64M,
+		.max_threads = min_t(long, sysconf(_SC_NPROCESSORS_ONLN),
+				     MAX_THREADS),
+	};
+
+	igt_bench_init(&s.bench, "intel_cpu_access");
+	s.bench.opts.duration = 0.2;
+	s.bench.opts.warmup = 0.05;
+	s.bench.opts.reps = 3;
+	igt_bench_parse_opts(&s.bench, argc, argv, "M:a:s:S:n:", help_str,
+			     opt_handler, &s);
+
+	s.fd = drm_open_driver(DRIVER_INTEL | DRIVER_XE);
+	s.xe = is_xe_device(s.fd);
+	igt_bench_set_device(&s.bench, s.fd);
+	get_regions(&s);
+
+	printf("%-7s %-7s %-6s %10s %7s %9s %8s %10s\n",
+	       "region", "method", "access", "bytes", "threads", "GB/s",
+	       "ci95", "us/access");
+
+	for (unsigned int i = 0; i < s.num_regions; i++) {
+		const struct region *r = &s.regions[i];
+
+		for (s.method = 0; s.method < NUM_METHODS; s.method++) {
+			bool supported = true;
+
+			if (!(s.method_mask & (1u << s.method)))
+				continue;
+
+			for (s.access = 0; s.access < NUM_ACCESSES; s.access++) {
+				if (!(s.access_mask & (1u << s.access)) ||
+				    !supports(&s, s.method, s.access))
+					continue;
+
+				for (s.size = s.min_size;
+				     supported && s.size <= s.max_size;
+				     s.size <<= 1)
+					for (unsigned int n = 1;
+					     supported && n <= s.max_threads;
+					     n <<= 1)
+						supported = run(&s, r, n);
+			}
+		}
+	}
+
+	igt_bench_fini(&s.bench);
+	drm_close_driver(s.fd);
+
+	return 0;
+}
@@ -0,0 +1,207 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2025 Intel Corporation
+ */
+
+/*
+ * Measures how many contexts, or exec queues on Xe, can be created and
+ * destroyed per second, and how many more a #intel_ctx_pool hands out.
+ *
+ * Each workload creates and destroys the same kind of context in a loop:
+ *
+ *   ioctl     bare create ioctl without any extension
+ *   engines   intel_ctx_create() with all the physical engines
+ *   balance   intel_ctx_create() with a load balancer over the engines of
+ *             the class with the most of them, when there are several
+ *   vm        as engines, sharing a VM created upfront
+ *   pool      intel_ctx_pool_get()/put() of the engines configuration
+ *
+ * or, on Xe:
+ *
+ *   ioctl     xe_exec_queue_create()/destroy() on a shared VM
+ *   vm        as ioctl, also creating and destroying the VM
+ *   pool      intel_ctx_pool_get_xe()/put() of the ioctl exec queue
+ *
+ * The gap between ioctl and engines is the cost of setting up the engine
+ * map, mostly in the kernel, and the gap to pool the cost of the kernel object
+ * itself.
+ */
+
+#include "igt.h"
+#include "i915/gem_vm.h"
+#include "igt_bench.h"
+#include "intel_ctx.h"
+#include "xe/xe_ioctl.h"
+#include "xe/xe_query.h"
+
+struct ctx_bench {
+	struct igt_bench bench;
+	int fd;
+	intel_ctx_cfg_t cfg;
+	uint32_t vm;
+	struct drm_xe_engine_class_instance *eci;
+	struct intel_ctx_pool *pool;
+};
+
+static void i915_ioctl(void *data, unsigned int thread, unsigned long count)
+{
+	const struct ctx_bench *b = data;
+
+	while (count--)
+		gem_context_destroy(b->fd, gem_context_create(b->fd));
+}
+
+static void i915_cfg(void *data, unsigned int thread, unsigned long count)
+{
+	const struct ctx_bench *b = data;
+
+	while (count--)
+		intel_ctx_destroy(b->fd, intel_ctx_create(b->fd, &b->cfg));
+}
+
+static void i915_pool(void *data, unsigned int thread, unsigned long count)
+{
+	const struct ctx_bench *b = data;
+
+	while (count--)
+		intel_ctx_pool_put(b->pool, intel_ctx_pool_get(b->pool, &b->cfg));
+}
+
+static void xe_ioctl(void *data, unsigned int thread, unsigned long count)
+{
+	const struct ctx_bench *b = data;
+
+	while (count--)
+		xe_exec_queue_destroy(b->fd,
+				      xe_exec_queue_create(b->fd, b->vm, b->eci, 0));
+}
+
+static void xe_vm(void *data, unsigned int thread, unsigned long count)
+{
+	const struct ctx_bench *b = data;
+
+	while (count--) {
+		uint32_t vm = xe_vm_create(b->fd, 0, 0);
+
+		xe_exec_queue_destroy(b->fd,
+				      xe_exec_queue_create(b->fd, vm, b->eci, 0));
+		xe_vm_destroy(b->fd, vm);
+	}
+}
+
+static void xe_pool(void *data, unsigned int thread, unsigned long count)
+{
+	const struct ctx_bench *b = data;
+
+	while (count--)
+		intel_ctx_pool_put(b->pool,
+				   intel_ctx_pool_get_xe(b->pool, b->vm, b->eci));
+}
+
+static void run(struct ctx_bench *b, const char *label, igt_bench_fn fn)
+{
+	struct igt_bench_result result;
+
+	igt_bench_run(&b->bench, label, fn, b, &result);
+	printf("%-8s %12.0f %12.0f %10.2f\n", label, result.median,
+	       result.ci95, result.median ? 1e6 / result.median : 0);
+	igt_bench_result_fini(&result);
+}
+
+/* Load balancer over the engines of the class with the most of them */
+static bool balance_cfg(int fd, intel_ctx_cfg_t *cfg)
+{
+	const intel_ctx_cfg_t all = intel_ctx_cfg_all_physical(fd);
+	unsigned int count[I915_ENGINE_CLASS_COMPUTE + 1] = {};
+	unsigned int class, best = 0;
+
+	for (unsigned int i = 0; i < all.num_engines; i++)
+		if (all.engines[i].engine_class < ARRAY_SIZE(count))
+			count[all.engines[i].engine_class]++;
+	for (class = 1; class < ARRAY_SIZE(count); class++)
+		if (count[class] > count[best])
+			best = class;
+	if (count[best] < 2)
+		return false;
+
+	memset(cfg, 0, sizeof(*cfg));
+	cfg->load_balance = true;
+	for (unsigned int i = 0; i < all.num_engines; i++)
+		if (all.engines[i].engine_class == best)
+			cfg->engines[cfg->num_engines++] = all.engines[i];
+
+	return true;
+}
+
+static void run_i915(struct ctx_bench *b)
+{
+	intel_ctx_cfg_t cfg;
+
+	igt_require(gem_has_contexts(b->fd));
+
+	run(b, "ioctl", i915_ioctl);
+
+	b->cfg = intel_ctx_cfg_all_physical(b->fd);
+	run(b, "engines", i915_cfg);
+
+	if (balance_cfg(b->fd, &cfg)) {
+		intel_ctx_cfg_t engines = b->cfg;
+
+		b->cfg = cfg;
+		run(b, "balance", i915_cfg);
+		b->cfg = engines;
+	}
+
+	if (gem_has_vm(b->fd)) {
+		b->cfg.vm = gem_vm_create(b->fd);
+		run(b, "vm", i915_cfg);
+		gem_vm_destroy(b->fd, b->cfg.vm);
+		b->cfg.vm = 0;
+	}
+
+	b->pool = intel_ctx_pool_create(b->fd, 64);
+	run(b, "pool", i915_pool);
+	intel_ctx_pool_destroy(b->pool);
+}
+
+static void run_xe(struct ctx_bench *b)
+{
+	b->vm = xe_vm_create(b->fd, 0, 0);
+	b->eci = &xe_engine(b->fd, 0)->instance;
+
+	run(b, "ioctl", xe_ioctl);
+	run(b, "vm", xe_vm);
+
+	b->pool = intel_ctx_pool_create(b->fd, 64);
+	run(b, "pool", xe_pool);
+	intel_ctx_pool_destroy(b->pool);
+
+	xe_vm_destroy(b->fd, b->vm);
+}
+
+static const char help_str[] =
+	"Reports, for each way of creating a context, the median number of\n"
+	"contexts created and destroyed per second, its 95% confidence\n"
+	"interval and the median time for each in microseconds.\n";
+
+int main(int argc, char **argv)
+{
+	struct ctx_bench b = {};
+
+	igt_bench_init(&b.bench, "intel_ctx_create");
+	igt_bench_parse_opts(&b.bench, argc, argv, "", help_str, NULL, NULL);
+
+	b.fd = drm_open_driver(DRIVER_INTEL | DRIVER_XE);
+	igt_bench_set_device(&b.bench, b.fd);
+
+	printf("%-8s %12s %12s %10s\n", "mode", "ops/s", "ci95", "us/op");
+	if (is_xe_device(b.fd))
+		run_xe(&b);
+	else
+		run_i915(&b);
+
+	igt_bench_fini(&b.bench);
+	drm_close_driver(b.fd);
+
+	return 0;
+}
@@ -0,0 +1,505 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2025 Intel Corporation
+ */
+
+/*
+ * Measures what a hang on an engine costs, on i915 and xe, by hanging each
+ * engine a number of times:
+ *
+ *  - engine: a spinner which can't be preempted is left for the kernel to
+ *    detect, with the heartbeat and preemption timeout on i915 or the job
+ *    timeout and preemption timeout on xe shortened as set with -H and -P,
+ *    and to recover from with an engine reset. Meanwhile a spinner of
+ *    another context is queued on the same engine. Times when the kernel
+ *    logged the reset, when the fence of the hanging spinner signalled and
+ *    when the other spinner started running.
+ *  - gt: the whole GT is reset through debugfs while a spinner runs. Times
+ *    the reset and when a spinner of another context starts running after
+ *    it.
+ *
+ * All the times are in ms from when the hanging spinner started. The kernel
+ * log times are taken against a marker written to /dev/kmsg at that point.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "igt.h"
+#include "igt_stats.h"
+#include "igt_syncobj.h"
+#include "igt_sysfs.h"
+#include "sw_sync.h"
+#include "xe/xe_gt.h"
+#include "xe/xe_ioctl.h"
+#include "xe/xe_query.h"
+
+#define MARKER		"intel_hang_bench: hang start"
+#define TIMEOUT_MS	10000
+
+enum result {
+	DETECT,
+	RECOVER,
+	RESUME,
+	GT_RESET,
+	GT_RESUME,
+	NUM_RESULTS
+};
+
+static const char * const result_names[NUM_RESULTS] = {
+	[DETECT] = "detect (kernel)",
+	[RECOVER] = "recover",
+	[RESUME] = "resume",
+	[GT_RESET] = "gt reset",
+	[GT_RESUME] = "gt resume",
+};
+
+/*
+ * The first message of an engine reset: i915 names the engine it resets,
+ * with GuC submission it reports the reset done by the GuC, as does xe,
+ * which also reports the jobs timed out by the scheduler.
+ */
+static const char * const reset_messages[] = {
+	"Resetting ",
+	"Engine reset",
+	"engine reset",
+	"Timedout job",
+};
+
+struct engine {
+	char name[16];
+	const struct intel_execution_engine2 *e;
+	struct drm_xe_engine_class_instance *hwe;
+};
+
+struct hang {
+	int fd;
+	bool xe;
+	unsigned int cycles;
+	unsigned int heartbeat_ms, preempt_ms;
+	bool engine_reset, gt_reset;
+	const char *filter;
+	int kmsg;
+
+	intel_ctx_cfg_t cfg;
+	uint32_t vm;
+	uint64_t ahnd;
+
+	igt_stats_t stats[NUM_RESULTS];
+};
+
+/* Spinner of another context, which starts once the hang is cleared */
+struct victim {
+	struct hang *h;
+	struct engine *eng;
+	const intel_ctx_t *ctx;
+	uint64_t ahnd;
+	const struct timespec *start;
+
+	igt_spin_t *spin;
+	double resume_ms;
+};
+
+static double elapsed_ms(const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (now.tv_sec - start->tv_sec) * 1e3 +
+	       (now.tv_nsec - start->tv_nsec) * 1e-6;
+}
+
+/* Skips what's already in the log and marks where the hang starts */
+static void kmsg_mark(struct hang *h)
+{
+	lseek(h->kmsg, 0, SEEK_END);
+	igt_assert_eq(write(h->kmsg, MARKER, strlen(MARKER)), strlen(MARKER));
+}
+
+/* Times the first reset logged since the marker, relative to it */
+static void kmsg_collect(struct hang *h)
+{
+	unsigned long long usec, marker = 0;
+	bool marked = false;
+	char record[1024];
+	ssize_t len;
+
+	/* Each read returns a single record, "prio,seq,usec,flags;message" */
+	while ((len = read(h->kmsg, record, sizeof(record) - 1)) != 0) {
+		char *msg;
+
+		if (len < 0) {
+			if (errno == EPIPE)
+				continue;
+			break;
+		}
+		record[len] = '\0';
+
+		msg = strchr(record, ';');
+		if (!msg || sscanf(record, "%*u,%*u,%llu", &usec) != 1)
+			continue;
+		msg++;
+
+		if (!marked) {
+			if (!strncmp(msg, MARKER, strlen(MARKER))) {
+				marker = usec;
+				marked = true;
+			}
+			continue;
+		}
+
+		for (int i = 0; i < ARRAY_SIZE(reset_messages); i++) {
+			if (strstr(msg, reset_messages[i])) {
+				igt_stats_push_float(&h->stats[DETECT],
+						     (usec - marker) * 1e-3);
+				return;
+			}
+		}
+	}
+}
+
+static igt_spin_t *
+spin_start(struct hang *h, struct engine *eng, const intel_ctx_t *ctx,
+	   uint64_t ahnd, bool hang)
+{
+	unsigned int flags = hang ? IGT_SPIN_NO_PREEMPTION : 0;
+	igt_spin_t *spin;
+
+	/* The xe spinners are waited upon until they start */
+	if (h->xe)
+		return igt_spin_new(h->fd, .ahnd = h->ahnd, .hwe = eng->hwe,
+				    .vm = h->vm, .flags = flags);
+
+	spin = igt_spin_new(h->fd, .ahnd = ahnd, .ctx = ctx,
+			    .engine = eng->e->flags,
+			    .flags = flags | IGT_SPIN_POLL_RUN |
+				     IGT_SPIN_FENCE_OUT);
+	igt_spin_busywait_until_started(spin);
+
+	return spin;
+}
+
+static void spin_wait(struct hang *h, igt_spin_t *spin)
+{
+	struct timespec ts;
+
+	if (!h->xe) {
+		igt_assert_eq(sync_fence_wait(spin->out_fence, TIMEOUT_MS), 0);
+		return;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	igt_assert(syncobj_wait(h->fd, &spin->syncobj, 1,
+				ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec +
+				TIMEOUT_MS * 1000000ull, 0, NULL));
+}
+
+static void *victim_thread(void *arg)
+{
+	struct victim *v = arg;
+
+	v->spin = spin_start(v->h, v->eng, v->ctx, v->ahnd, false);
+	v->resume_ms = elapsed_ms(v->start);
+
+	return NULL;
+}
+
+static const intel_ctx_t *ctx_create(struct hang *h, uint64_t *ahnd)
+{
+	const intel_ctx_t *ctx;
+
+	if (h->xe) {
+		*ahnd = h->ahnd;
+		return NULL;
+	}
+
+	ctx = intel_ctx_create(h->fd, &h->cfg);
+	*ahnd = get_reloc_ahnd(h->fd, ctx->id);
+
+	return ctx;
+}
+
+static void ctx_destroy(struct hang *h, const intel_ctx_t *ctx, uint64_t ahnd)
+{
+	if (h->xe)
+		return;
+
+	put_ahnd(ahnd);
+	intel_ctx_destroy(h->fd, ctx);
+}
+
+/* Leaves the hang to the kernel, with another context waiting behind */
+static void cycle_engine(struct hang *h, struct engine *eng)
+{
+	struct victim v = { .h = h, .eng = eng };
+	const intel_ctx_t *ctx;
+	struct timespec start;
+	igt_hang_t allow;
+	pthread_t thread;
+	igt_spin_t *spin;
+	uint64_t ahnd;
+
+	ctx = ctx_create(h, &ahnd);
+	v.ctx = ctx_create(h, &v.ahnd);
+	allow = igt_allow_hang(h->fd, ctx ? ctx->id : 0,
+			       HANG_WANT_ENGINE_RESET);
+
+	spin = spin_start(h, eng, ctx, ahnd, true);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	kmsg_mark(h);
+
+	v.start = &start;
+	igt_assert_eq(pthread_create(&thread, NULL, victim_thread, &v), 0);
+
+	spin_wait(h, spin);
+	igt_stats_push_float(&h->stats[RECOVER], elapsed_ms(&start));
+
+	pthread_join(thread, NULL);
+	igt_stats_push_float(&h->stats[RESUME], v.resume_ms);
+	kmsg_collect(h);
+
+	igt_spin_free(h->fd, v.spin);
+	igt_spin_free(h->fd, spin);
+	igt_disallow_hang(h->fd, allow);
+	ctx_destroy(h, v.ctx, v.ahnd);
+	ctx_destroy(h, ctx, ahnd);
+}
+
+/* Resets the whole GT under a spinner */
+static void cycle_gt(struct hang *h, struct engine *eng)
+{
+	const intel_ctx_t *ctx, *other;
+	uint64_t ahnd, other_ahnd;
+	struct timespec start;
+	igt_spin_t *spin, *next;
+	igt_hang_t allow;
+
+	ctx = ctx_create(h, &ahnd);
+	other = ctx_create(h, &other_ahnd);
+	allow = igt_allow_hang(h->fd, ctx ? ctx->id : 0, 0);
+
+	spin = spin_start(h, eng, ctx, ahnd, false);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	if (h->xe)
+		xe_force_gt_reset_sync(h->fd, eng->hwe->gt_id);
+	else
+		igt_force_gpu_reset(h->fd);
+	igt_stats_push_float(&h->stats[GT_RESET], elapsed_ms(&start));
+
+	next = spin_start(h, eng, other, other_ahnd, false);
+	igt_stats_push_float(&h->stats[GT_RESUME], elapsed_ms(&start));
+
+	igt_spin_free(h->fd, next);
+	igt_spin_free(h->fd, spin);
+	igt_disallow_hang(h->fd, allow);
+	ctx_destroy(h, other, other_ahnd);
+	ctx_destroy(h, ctx, ahnd);
+}
+
+/* Shortens the hang detection of the engine, returning what to restore */
+static void
+configure(struct hang *h, struct engine *eng, struct gem_engine_properties *saved)
+{
+	int dir;
+
+	if (!h->xe) {
+		saved->engine = *eng->e;
+		saved->heartbeat_interval = h->heartbeat_ms;
+		saved->preempt_timeout = h->preempt_ms;
+		gem_engine_properties_configure(h->fd, saved);
+		return;
+	}
+
+	dir = xe_sysfs_engine_open(h->fd, eng->hwe->gt_id,
+				   eng->hwe->engine_class);
+	igt_assert_lte(0, dir);
+
+	saved->heartbeat_interval = igt_sysfs_get_u32(dir, "job_timeout_ms");
+	saved->preempt_timeout = igt_sysfs_get_u32(dir, "preempt_timeout_us");
+	igt_sysfs_set_u32(dir, "job_timeout_ms", h->heartbeat_ms);
+	igt_sysfs_set_u32(dir, "preempt_timeout_us", h->preempt_ms * 1000);
+	close(dir);
+}
+
+static void
+restore(struct hang *h, struct engine *eng, struct gem_engine_properties *saved)
+{
+	int dir;
+
+	if (!h->xe) {
+		gem_engine_properties_restore(h->fd, saved);
+		return;
+	}
+
+	dir = xe_sysfs_engine_open(h->fd, eng->hwe->gt_id,
+				   eng->hwe->engine_class);
+	igt_assert_lte(0, dir);
+
+	igt_sysfs_set_u32(dir, "job_timeout_ms", saved->heartbeat_interval);
+	igt_sysfs_set_u32(dir, "preempt_timeout_us", saved->preempt_timeout);
+	close(dir);
+}
+
+static void print_row(const char *name, igt_stats_t *stats)
+{
+	if (!stats->n_values)
+		return;
+
+	printf("  %-18s %6u %9.1f %9.1f %9.1f %9.1f %9.1f\n",
+	       name, stats->n_values,
+	       igt_stats_get_percentile(stats, 0),
+	       igt_stats_get_median(stats),
+	       igt_stats_get_percentile(stats, 90),
+	       igt_stats_get_percentile(stats, 99),
+	       igt_stats_get_percentile(stats, 100));
+}
+
+static void run(struct hang *h, struct engine *eng)
+{
+	struct gem_engine_properties saved = {};
+	unsigned int n;
+	int i;
+
+	if (h->filter && strcmp(h->filter, eng->name))
+		return;
+
+	for (i = 0; i < NUM_RESULTS; i++)
+		igt_stats_init_with_size(&h->stats[i], h->cycles);
+
+	if (h->engine_reset) {
+		configure(h, eng, &saved);
+		for (n = 0; n < h->cycles; n++)
+			cycle_engine(h, eng);
+		restore(h, eng, &saved);
+	}
+
+	if (h->gt_reset)
+		for (n = 0; n < h->cycles; n++)
+			cycle_gt(h, eng);
+
+	printf("%s\n", eng->name);
+	for (i = 0; i < NUM_RESULTS; i++) {
+		print_row(result_names[i], &h->stats[i]);
+		igt_stats_fini(&h->stats[i]);
+	}
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"Usage: %s [options]\n"
+		"  -n <cycles>     Number of hangs of each kind per engine, 10 by default\n"
+		"  -e <engine>     Only hang the engine, as named in the report\n"
+		"  -H <ms>         Heartbeat interval on i915, job timeout on xe, 100 by default\n"
+		"  -P <ms>         Preemption timeout, 50 by default\n"
+		"  -E              Only leave the hangs to the kernel, for engine resets\n"
+		"  -G              Only reset the whole GT\n"
+		"Reports the distribution, in ms after the hanging spinner started, of\n"
+		"when the kernel logged the engine reset, when the spinner's fence\n"
+		"signalled and when a spinner of another context started running on\n"
+		"the engine, and for the GT resets of how long they took and when a\n"
+		"spinner of another context started running afterwards.\n",
+		name);
+}
+
+int main(int argc, char **argv)
+{
+	struct hang h = {
+		.cycles = 10,
+		.heartbeat_ms = 100,
+		.preempt_ms = 50,
+		.engine_reset = true,
+		.gt_reset = true,
+	};
+	struct engine eng = {};
+	int c;
+
+	while ((c = getopt(argc, argv, "n:e:H:P:EGh")) != -1) {
+		switch (c) {
+		case 'n':
+			h.cycles = max(atoi(optarg), 1);
+			break;
+		case 'e':
+			h.filter = optarg;
+			break;
+		case 'H':
+			h.heartbeat_ms = max(atoi(optarg), 1);
+			break;
+		case 'P':
+			h.preempt_ms = max(atoi(optarg), 1);
+			break;
+		case 'E':
+			h.gt_reset = false;
+			break;
+		case 'G':
+			h.engine_reset = false;
+			break;
+		default:
+			usage(argv[0]);
+			return c == 'h' ? 0 : 1;
+		}
+	}
+
+	if (!h.engine_reset && !h.gt_reset) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	h.fd = drm_open_driver(DRIVER_INTEL | DRIVER_XE);
+	h.xe = is_xe_device(h.fd);
+
+	h.kmsg = open("/dev/kmsg", O_RDWR | O_NONBLOCK);
+	igt_require_f(h.kmsg >= 0, "Can't open /dev/kmsg\n");
+
+	printf("%-20s %6s %9s %9s %9s %9s %9s\n", "engine (ms)", "n",
+	       "min", "p50", "p90", "p99", "max");
+
+	if (h.xe) {
+		struct drm_xe_engine_class_instance *hwe;
+
+		h.vm = xe_vm_create(h.fd, 0, 0);
+		h.ahnd = intel_allocator_open(h.fd, h.vm, INTEL_ALLOCATOR_RELOC);
+
+		xe_for_each_engine(h.fd, hwe) {
+			snprintf(eng.name, sizeof(eng.name), "%s%u",
+				 xe_engine_class_short_string(hwe->engine_class),
+				 hwe->engine_instance);
+			eng.hwe = hwe;
+			run(&h, &eng);
+		}
+
+		put_ahnd(h.ahnd);
+		xe_vm_destroy(h.fd, h.vm);
+	} else {
+		const struct intel_execution_engine2 *e;
+		const intel_ctx_t *ctx;
+
+		h.cfg = intel_ctx_cfg_all_physical(h.fd);
+		ctx = intel_ctx_create(h.fd, &h.cfg);
+
+		for_each_ctx_engine(h.fd, ctx, e) {
+			if (!gem_class_can_store_dword(h.fd, e->class))
+				continue;
+
+			snprintf(eng.name, sizeof(eng.name), "%s", e->name);
+			eng.e = e;
+			run(&h, &eng);
+		}
+
+		intel_ctx_destroy(h.fd, ctx);
+	}
+
+	close(h.kmsg);
+	drm_close_driver(h.fd);
+
+	return 0;
+}
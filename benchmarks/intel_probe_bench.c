@@ -0,0 +1,292 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2025 Intel Corporation
+ */
+
+/*
+ * Measures how long i915 or xe take to get a device going, by cycling the
+ * device through unbind and bind, and the whole driver through unload and
+ * load, a number of times.
+ *
+ * Each phase is timed from userspace, around the sysfs write or the module
+ * load. The probe is also broken down with the kernel log timestamps: a
+ * marker is written to /dev/kmsg just before the bind or load, and the
+ * first messages of the firmware loads, of the GuC and HuC initialization
+ * and of the display and fbdev setup are timed against it.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "igt.h"
+#include "igt_device.h"
+#include "igt_kmod.h"
+#include "igt_stats.h"
+
+#define MARKER		"intel_probe_bench: probe start"
+
+enum phase {
+	UNBIND,
+	BIND,
+	UNLOAD,
+	LOAD,
+	NUM_PHASES
+};
+
+static const char * const phase_names[NUM_PHASES] = {
+	[UNBIND] = "unbind",
+	[BIND] = "bind",
+	[UNLOAD] = "unload",
+	[LOAD] = "load",
+};
+
+/*
+ * Messages marking the probe milestones, matched as substrings. The
+ * first message matching after the marker counts, so the firmware ones
+ * time when the first GT got its firmware.
+ */
+static const struct milestone {
+	const char *name;
+	const char *match;
+} milestones[] = {
+	{ "dmc-fw", "DMC firmware" },
+	{ "guc-fw", "GuC firmware" },
+	{ "huc-fw", "HuC firmware" },
+	{ "guc-submission", "GuC submission" },
+	{ "huc-auth", "HuC: authenticated" },
+	{ "initialized", "Initialized " },
+	{ "fbdev", "frame buffer device" },
+};
+
+#define NUM_MILESTONES ARRAY_SIZE(milestones)
+
+struct probe {
+	const char *driver;
+	char slot[NAME_MAX];
+	unsigned int cycles;
+	bool bind, reload;
+	int kmsg;
+
+	igt_stats_t phases[NUM_PHASES];
+	igt_stats_t kernel[NUM_PHASES][NUM_MILESTONES];
+};
+
+static double elapsed_ms(const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (now.tv_sec - start->tv_sec) * 1e3 +
+	       (now.tv_nsec - start->tv_nsec) * 1e-6;
+}
+
+/* Skips what's already in the log and marks where the probe starts */
+static void kmsg_mark(struct probe *p)
+{
+	lseek(p->kmsg, 0, SEEK_END);
+	igt_assert_eq(write(p->kmsg, MARKER, strlen(MARKER)), strlen(MARKER));
+}
+
+/* Times the milestones logged since the marker, relative to it */
+static void kmsg_collect(struct probe *p, enum phase phase)
+{
+	bool seen[NUM_MILESTONES] = {};
+	unsigned long long usec, marker = 0;
+	bool marked = false;
+	char record[1024];
+	ssize_t len;
+	int i;
+
+	/* Each read returns a single record, "prio,seq,usec,flags;message" */
+	while ((len = read(p->kmsg, record, sizeof(record) - 1)) != 0) {
+		char *msg;
+
+		if (len < 0) {
+			if (errno == EPIPE)
+				continue;
+			break;
+		}
+		record[len] = '\0';
+
+		msg = strchr(record, ';');
+		if (!msg || sscanf(record, "%*u,%*u,%llu", &usec) != 1)
+			continue;
+		msg++;
+
+		if (!marked) {
+			if (!strncmp(msg, MARKER, strlen(MARKER))) {
+				marker = usec;
+				marked = true;
+			}
+			continue;
+		}
+
+		for (i = 0; i < NUM_MILESTONES; i++) {
+			if (seen[i] || !strstr(msg, milestones[i].match))
+				continue;
+
+			seen[i] = true;
+			igt_stats_push_float(&p->kernel[phase][i],
+					     (usec - marker) * 1e-3);
+		}
+	}
+}
+
+static void cycle_bind(struct probe *p)
+{
+	struct timespec start;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	igt_assert_eq(igt_kmod_unbind(p->driver, p->slot), 0);
+	igt_stats_push_float(&p->phases[UNBIND], elapsed_ms(&start));
+
+	kmsg_mark(p);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	igt_assert(igt_kmod_bind(p->driver, p->slot) > 0);
+	igt_stats_push_float(&p->phases[BIND], elapsed_ms(&start));
+	kmsg_collect(p, BIND);
+}
+
+static void cycle_reload(struct probe *p)
+{
+	struct timespec start;
+	char *who = NULL;
+	int err;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	err = __igt_intel_driver_unload(&who, p->driver);
+	igt_assert_f(!err, "Could not unload %s\n", who ?: p->driver);
+	igt_stats_push_float(&p->phases[UNLOAD], elapsed_ms(&start));
+	free(who);
+
+	kmsg_mark(p);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	igt_assert_eq(igt_intel_driver_load(NULL, p->driver), 0);
+	igt_stats_push_float(&p->phases[LOAD], elapsed_ms(&start));
+	kmsg_collect(p, LOAD);
+}
+
+static void print_row(const char *name, igt_stats_t *stats)
+{
+	if (!stats->n_values)
+		return;
+
+	printf("  %-18s %6u %9.1f %9.1f %9.1f %9.1f %9.1f\n",
+	       name, stats->n_values,
+	       igt_stats_get_percentile(stats, 0),
+	       igt_stats_get_median(stats),
+	       igt_stats_get_percentile(stats, 90),
+	       igt_stats_get_percentile(stats, 99),
+	       igt_stats_get_percentile(stats, 100));
+}
+
+static void report(struct probe *p)
+{
+	int phase, i;
+
+	printf("%-20s %6s %9s %9s %9s %9s %9s\n", "phase (ms)", "n",
+	       "min", "p50", "p90", "p99", "max");
+
+	for (phase = 0; phase < NUM_PHASES; phase++) {
+		if (!p->phases[phase].n_values)
+			continue;
+
+		printf("%s\n", phase_names[phase]);
+		print_row("userspace", &p->phases[phase]);
+		for (i = 0; i < NUM_MILESTONES; i++)
+			print_row(milestones[i].name, &p->kernel[phase][i]);
+	}
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"Usage: %s [options]\n"
+		"  -d <driver>     i915 or xe, by default the driver of the first Intel GPU\n"
+		"  -n <cycles>     Number of cycles of each kind, 10 by default\n"
+		"  -b              Only cycle the device through unbind and bind\n"
+		"  -r              Only cycle the driver through unload and load\n"
+		"Reports the distribution of the time each phase took from userspace\n"
+		"and, for bind and load, of when the kernel logged each probe\n"
+		"milestone, in ms after the phase started.\n",
+		name);
+}
+
+int main(int argc, char **argv)
+{
+	struct probe p = {
+		.cycles = 10,
+		.bind = true,
+		.reload = true,
+	};
+	unsigned int n;
+	int fd, c, phase, i;
+
+	while ((c = getopt(argc, argv, "d:n:brh")) != -1) {
+		switch (c) {
+		case 'd':
+			p.driver = optarg;
+			break;
+		case 'n':
+			p.cycles = max(atoi(optarg), 1);
+			break;
+		case 'b':
+			p.reload = false;
+			break;
+		case 'r':
+			p.bind = false;
+			break;
+		default:
+			usage(argv[0]);
+			return c == 'h' ? 0 : 1;
+		}
+	}
+
+	if (!p.bind && !p.reload) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	fd = drm_open_driver(DRIVER_INTEL | DRIVER_XE);
+	igt_device_get_pci_slot_name(fd, p.slot);
+	if (!p.driver)
+		p.driver = is_xe_device(fd) ? "xe" : "i915";
+	drm_close_driver(fd);
+
+	p.kmsg = open("/dev/kmsg", O_RDWR | O_NONBLOCK);
+	igt_require_f(p.kmsg >= 0, "Can't open /dev/kmsg\n");
+
+	for (phase = 0; phase < NUM_PHASES; phase++) {
+		igt_stats_init_with_size(&p.phases[phase], p.cycles);
+		for (i = 0; i < NUM_MILESTONES; i++)
+			igt_stats_init_with_size(&p.kernel[phase][i], p.cycles);
+	}
+
+	printf("Probing %s on %s, %u cycles\n", p.driver, p.slot, p.cycles);
+
+	for (n = 0; n < p.cycles; n++) {
+		if (p.bind)
+			cycle_bind(&p);
+		if (p.reload)
+			cycle_reload(&p);
+	}
+
+	report(&p);
+
+	for (phase = 0; phase < NUM_PHASES; phase++) {
+		igt_stats_fini(&p.phases[phase]);
+		for (i = 0; i < NUM_MILESTONES; i++)
+			igt_stats_fini(&p.kernel[phase][i]);
+	}
+	close(p.kmsg);
+
+	return 0;
+}
@@ -0,0 +1,733 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2025 Intel Corporation
+ */
+
+/** @file kms_cursor.c
+ *
+ * Measures how fast cursor updates go through, how many of them end up on
+ * screen, and how long an update takes to get scanned out, on all the pipes
+ * that can be lit up at once.
+ *
+ * Cursor updates are done in one of three ways:
+ *  - legacy: moving the cursor with drmModeMoveCursor()
+ *  - atomic: nonblocking atomic commits of the cursor plane, which the kernel
+ *    only takes one at a time per pipe
+ *  - async: the same with DRM_MODE_PAGE_FLIP_ASYNC, when the kernel allows
+ *    async flips of the cursor plane
+ *
+ * For each of them, a rate phase first does as many updates as possible for
+ * a while and counts the frames whose CRC changed, which gives how many
+ * updates got coalesced into each frame. The atomic ones go through the flip
+ * engine there, cycling through cursor images rather than positions. A latency phase then does single updates at random points of
+ * the frame, once the CRC is stable, and times how long the first CRC showing
+ * the update takes to arrive.
+ */
+
+#include <getopt.h>
+#include <poll.h>
+
+#include "igt.h"
+#include "igt_rand.h"
+#include "igt_stats.h"
+
+#define NUM_CURSOR_FBS 3
+#define NUM_POSITIONS 61
+
+/* 1/128 relative error on the reported percentiles */
+#define HISTOGRAM_PRECISION 7
+
+enum mode {
+	MODE_LEGACY,
+	MODE_ATOMIC,
+	MODE_ASYNC,
+	NUM_MODES
+};
+
+static const char * const mode_names[NUM_MODES] = {
+	[MODE_LEGACY] = "legacy",
+	[MODE_ATOMIC] = "atomic",
+	[MODE_ASYNC] = "async",
+};
+
+static const double percentiles[] = { 50, 90, 99 };
+
+struct result {
+	unsigned long updates;
+	unsigned long rejected;
+	unsigned long frames;
+	unsigned long changes;
+	unsigned long lost;
+	double elapsed_s;
+	igt_stats_t latency;
+	igt_stats_t latency_frames;
+};
+
+enum probe_state {
+	PROBE_SETTLE,
+	PROBE_WAIT_ISSUE,
+	PROBE_WAIT_CHANGE,
+};
+
+struct pipe_data {
+	enum pipe pipe;
+	igt_output_t *output;
+	igt_plane_t *primary, *cursor;
+	struct igt_fb primary_fb;
+	struct igt_fb cursor_fbs[NUM_CURSOR_FBS];
+	uint64_t frame_time_ns;
+	igt_pipe_crc_t *crc;
+	struct igt_atomic_template *tmpl;
+	unsigned long position;
+
+	/* Latency probe */
+	enum probe_state state;
+	igt_crc_t last_crc;
+	unsigned int stable;
+	uint64_t issue_ns, submit_ns;
+	unsigned int frames;
+	unsigned int samples;
+
+	struct result results[NUM_MODES];
+};
+
+struct data {
+	int fd;
+	igt_display_t display;
+	struct pipe_data pipes[IGT_MAX_PIPES];
+	int n_pipes;
+	uint64_t cursor_width, cursor_height;
+	unsigned int ring_size;
+};
+
+static struct {
+	unsigned int duration_ms;
+	unsigned int samples;
+	const char *json;
+	bool modes[NUM_MODES];
+} opt = {
+	.duration_ms = 2000,
+	.samples = 100,
+	.modes = { true, true, true },
+};
+
+static uint64_t monotonic_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static int cursor_x(unsigned long position)
+{
+	return (position % NUM_POSITIONS) * 4;
+}
+
+static void flip_handler(int fd, unsigned int sequence, unsigned int tv_sec,
+			 unsigned int tv_usec, unsigned int crtc_id,
+			 void *user_data)
+{
+}
+
+/* The events of the atomic updates aren't used, only drained */
+static void drain_events(struct data *data)
+{
+	drmEventContext evctx = {
+		.version = 3,
+		.page_flip_handler2 = flip_handler,
+	};
+	struct pollfd pfd = {
+		.fd = data->fd,
+		.events = POLLIN,
+	};
+
+	while (poll(&pfd, 1, 0) == 1)
+		igt_assert_eq(drmHandleEvent(data->fd, &evctx), 0);
+}
+
+/*
+ * Does a single cursor update, moving the cursor for legacy and atomic
+ * updates and changing its image for async ones, which can't move planes.
+ * Returns false when the kernel is still busy with the previous one.
+ */
+static bool update_cursor(struct data *data, struct pipe_data *p,
+			  enum mode mode)
+{
+	uint32_t flags = DRM_MODE_ATOMIC_NONBLOCK | DRM_MODE_PAGE_FLIP_EVENT;
+	unsigned long position = p->position + 1;
+	int ret;
+
+	switch (mode) {
+	case MODE_LEGACY:
+		ret = drmModeMoveCursor(data->fd,
+					data->display.pipes[p->pipe].crtc_id,
+					cursor_x(position), 0);
+		break;
+	case MODE_ATOMIC:
+		igt_atomic_template_set_position(p->tmpl, p->cursor,
+						 cursor_x(position), 0);
+		ret = igt_atomic_template_try_commit(p->tmpl, flags, NULL);
+		break;
+	case MODE_ASYNC:
+		igt_atomic_template_set_fb(p->tmpl, p->cursor,
+					   &p->cursor_fbs[position % NUM_CURSOR_FBS]);
+		ret = igt_atomic_template_try_commit(p->tmpl,
+						     flags | DRM_MODE_PAGE_FLIP_ASYNC,
+						     NULL);
+		break;
+	default:
+		igt_assert(0);
+	}
+
+	if (ret == -EBUSY)
+		return false;
+
+	igt_assert_f(ret == 0, "%s cursor update on pipe %s failed: %s\n",
+		     mode_names[mode], kmstest_pipe_name(p->pipe),
+		     strerror(-ret));
+	p->position = position;
+
+	return true;
+}
+
+static bool async_supported(struct data *data)
+{
+	struct pipe_data *p = &data->pipes[0];
+
+	if (!data->display.is_atomic ||
+	    !igt_has_drm_cap(data->fd, DRM_CAP_ATOMIC_ASYNC_PAGE_FLIP))
+		return false;
+
+	igt_atomic_template_set_fb(p->tmpl, p->cursor, &p->cursor_fbs[1]);
+	return igt_atomic_template_try_commit(p->tmpl,
+					      DRM_MODE_ATOMIC_TEST_ONLY |
+					      DRM_MODE_PAGE_FLIP_ASYNC,
+					      NULL) == 0;
+}
+
+static void discard_crcs(struct pipe_data *p)
+{
+	igt_crc_t crcs[64];
+
+	while (igt_pipe_crc_capture_get(p->crc, crcs, NULL,
+					ARRAY_SIZE(crcs)) == ARRAY_SIZE(crcs))
+		;
+}
+
+/* Counts the frames captured since the start of the phase that changed */
+static void count_changes(struct pipe_data *p, struct result *r)
+{
+	igt_crc_t crcs[64];
+	bool has_last = false;
+	igt_crc_t last;
+	int n, i;
+
+	while ((n = igt_pipe_crc_capture_get(p->crc, crcs, NULL,
+					     ARRAY_SIZE(crcs)))) {
+		for (i = 0; i < n; i++) {
+			if (has_last && igt_find_crc_mismatch(&last, &crcs[i],
+							      NULL))
+				r->changes++;
+
+			last = crcs[i];
+			has_last = true;
+			r->frames++;
+		}
+	}
+}
+
+static void measure_rate(struct data *data, enum mode mode)
+{
+	uint64_t duration_ns = opt.duration_ms * 1000000ull;
+	struct timespec start = {};
+	int i;
+
+	for (i = 0; i < data->n_pipes; i++)
+		discard_crcs(&data->pipes[i]);
+
+	igt_nsec_elapsed(&start);
+
+	if (mode == MODE_LEGACY) {
+		/* Legacy cursor updates don't wait, round-robin over the pipes */
+		while (igt_nsec_elapsed(&start) < duration_ns) {
+			for (i = 0; i < data->n_pipes; i++) {
+				struct pipe_data *p = &data->pipes[i];
+
+				if (update_cursor(data, p, mode))
+					p->results[mode].updates++;
+				else
+					p->results[mode].rejected++;
+			}
+		}
+	} else {
+		struct igt_flip_engine *engine;
+		igt_flip_stats_t stats;
+
+		engine = igt_flip_engine_create(&data->display,
+						mode == MODE_ASYNC ?
+						DRM_MODE_PAGE_FLIP_ASYNC : 0);
+		for (i = 0; i < data->n_pipes; i++) {
+			struct pipe_data *p = &data->pipes[i];
+
+			igt_flip_engine_add_pipe(engine, p->pipe, p->cursor,
+						 p->cursor_fbs, NUM_CURSOR_FBS,
+						 NULL, NULL);
+		}
+
+		igt_flip_engine_run(engine, opt.duration_ms);
+
+		for (i = 0; i < data->n_pipes; i++) {
+			igt_flip_engine_get_stats(engine, data->pipes[i].pipe,
+						  &stats);
+			data->pipes[i].results[mode].updates = stats.flips;
+		}
+		igt_flip_engine_free(engine);
+	}
+
+	for (i = 0; i < data->n_pipes; i++) {
+		struct pipe_data *p = &data->pipes[i];
+
+		p->results[mode].elapsed_s = igt_nsec_elapsed(&start) / 1e9;
+		count_changes(p, &p->results[mode]);
+	}
+}
+
+static void probe_crc(struct pipe_data *p, struct result *r,
+		      const igt_crc_t *crc, uint64_t timestamp_ns)
+{
+	bool changed = igt_find_crc_mismatch(&p->last_crc, crc, NULL);
+
+	switch (p->state) {
+	case PROBE_SETTLE:
+		/* Wait for a couple of identical frames before the next probe */
+		p->stable = changed ? 0 : p->stable + 1;
+		if (p->stable >= 2) {
+			p->state = PROBE_WAIT_ISSUE;
+			p->issue_ns = monotonic_ns() +
+				hars_petruska_f54_1_random_unsafe() %
+				p->frame_time_ns;
+		}
+		break;
+	case PROBE_WAIT_ISSUE:
+		break;
+	case PROBE_WAIT_CHANGE:
+		/* CRCs of frames scanned out before the update don't count */
+		if (timestamp_ns < p->submit_ns)
+			break;
+
+		p->frames++;
+		if (!changed)
+			break;
+
+		igt_stats_push(&r->latency, timestamp_ns - p->submit_ns);
+		igt_stats_push(&r->latency_frames, p->frames);
+		p->samples++;
+		p->stable = 0;
+		p->state = PROBE_SETTLE;
+		break;
+	}
+
+	p->last_crc = *crc;
+}
+
+static void measure_latency(struct data *data, enum mode mode)
+{
+	uint64_t timeout_ns = NSEC_PER_SEC;
+	struct timespec start = {};
+	bool done;
+	int i, j;
+
+	for (i = 0; i < data->n_pipes; i++) {
+		struct pipe_data *p = &data->pipes[i];
+
+		/* A probe takes a handful of frames, leave plenty of room */
+		timeout_ns = max(timeout_ns,
+				 opt.samples * 16 * p->frame_time_ns + NSEC_PER_SEC);
+		discard_crcs(p);
+		p->state = PROBE_SETTLE;
+		p->stable = 0;
+		p->samples = 0;
+	}
+
+	igt_nsec_elapsed(&start);
+
+	/* One probe in flight per pipe, all the pipes at once */
+	do {
+		uint64_t now = monotonic_ns();
+
+		done = true;
+		for (i = 0; i < data->n_pipes; i++) {
+			struct pipe_data *p = &data->pipes[i];
+			struct result *r = &p->results[mode];
+			uint64_t timestamps[16];
+			igt_crc_t crcs[16];
+			int n;
+
+			n = igt_pipe_crc_capture_get(p->crc, crcs, timestamps,
+						     ARRAY_SIZE(crcs));
+			for (j = 0; j < n; j++)
+				probe_crc(p, r, &crcs[j], timestamps[j]);
+
+			if (p->state == PROBE_WAIT_ISSUE && now >= p->issue_ns) {
+				p->submit_ns = monotonic_ns();
+				if (update_cursor(data, p, mode)) {
+					p->frames = 0;
+					p->state = PROBE_WAIT_CHANGE;
+				}
+			} else if (p->state == PROBE_WAIT_CHANGE &&
+				   now - p->submit_ns > NSEC_PER_SEC) {
+				r->lost++;
+				p->stable = 0;
+				p->state = PROBE_SETTLE;
+			}
+
+			done &= p->samples >= opt.samples;
+		}
+
+		drain_events(data);
+		usleep(50);
+	} while (!done && igt_nsec_elapsed(&start) < timeout_ns);
+}
+
+static void setup_pipe(struct data *data, struct pipe_data *p)
+{
+	drmModeModeInfo *mode = igt_output_get_mode(p->output);
+	int i;
+
+	igt_create_color_fb(data->fd, mode->hdisplay, mode->vdisplay,
+			    DRM_FORMAT_XRGB8888, DRM_FORMAT_MOD_LINEAR,
+			    0, 0, 0, &p->primary_fb);
+	for (i = 0; i < NUM_CURSOR_FBS; i++)
+		igt_create_color_fb(data->fd, data->cursor_width,
+				    data->cursor_height, DRM_FORMAT_ARGB8888,
+				    DRM_FORMAT_MOD_LINEAR,
+				    i == 0, i == 1, i == 2, &p->cursor_fbs[i]);
+
+	p->primary = igt_output_get_plane_type(p->output,
+					       DRM_PLANE_TYPE_PRIMARY);
+	p->cursor = igt_output_get_plane_type(p->output,
+					      DRM_PLANE_TYPE_CURSOR);
+	igt_plane_set_fb(p->primary, &p->primary_fb);
+	igt_plane_set_fb(p->cursor, &p->cursor_fbs[0]);
+	igt_plane_set_position(p->cursor, 0, 0);
+	p->frame_time_ns = igt_kms_frame_time_from_vrefresh(mode->vrefresh);
+}
+
+static void release_pipe(struct data *data, struct pipe_data *p)
+{
+	int i;
+
+	igt_plane_set_fb(p->primary, NULL);
+	igt_plane_set_fb(p->cursor, NULL);
+	igt_output_set_pipe(p->output, PIPE_NONE);
+
+	igt_remove_fb(data->fd, &p->primary_fb);
+	for (i = 0; i < NUM_CURSOR_FBS; i++)
+		igt_remove_fb(data->fd, &p->cursor_fbs[i]);
+}
+
+static void setup_pipes(struct data *data)
+{
+	igt_display_t *display = &data->display;
+	unsigned int max_vrefresh = 0;
+	igt_output_t *output;
+	uint32_t used = 0;
+	enum pipe pipe;
+	int i, j;
+
+	igt_display_reset(display);
+
+	for_each_connected_output(display, output) {
+		for_each_pipe(display, pipe) {
+			struct pipe_data *p = &data->pipes[data->n_pipes];
+
+			if (used & BIT(pipe) ||
+			    display->pipes[pipe].plane_cursor < 0 ||
+			    !igt_pipe_connector_valid(pipe, output))
+				continue;
+
+			used |= BIT(pipe);
+			p->pipe = pipe;
+			p->output = output;
+			igt_output_set_pipe(output, pipe);
+			setup_pipe(data, p);
+			data->n_pipes++;
+			break;
+		}
+	}
+
+	/* Drop outputs until the configuration fits */
+	while (display->is_atomic && data->n_pipes &&
+	       igt_display_try_commit_atomic(display,
+					     DRM_MODE_ATOMIC_TEST_ONLY |
+					     DRM_MODE_ATOMIC_ALLOW_MODESET,
+					     NULL) != 0)
+		release_pipe(data, &data->pipes[--data->n_pipes]);
+	igt_require_f(data->n_pipes, "No output with a cursor could be lit up\n");
+
+	igt_display_commit2(display, display->is_atomic ?
+			    COMMIT_ATOMIC : COMMIT_LEGACY);
+
+	for (i = 0; i < data->n_pipes; i++) {
+		struct pipe_data *p = &data->pipes[i];
+		drmModeModeInfo *mode = igt_output_get_mode(p->output);
+
+		max_vrefresh = max(max_vrefresh, mode->vrefresh);
+
+		for (j = 0; j < NUM_MODES; j++) {
+			igt_stats_init_histogram(&p->results[j].latency,
+						 HISTOGRAM_PRECISION);
+			igt_stats_init(&p->results[j].latency_frames);
+		}
+
+		if (display->is_atomic)
+			p->tmpl = igt_atomic_template_capture(display);
+
+		igt_info("Pipe %s: %s, %dx%d@%d\n", kmstest_pipe_name(p->pipe),
+			 igt_output_name(p->output), mode->hdisplay,
+			 mode->vdisplay, mode->vrefresh);
+	}
+
+	/* Enough room for all the CRCs of a rate phase */
+	data->ring_size = (uint64_t)opt.duration_ms * max(max_vrefresh, 60u) /
+		1000 * 2 + 64;
+	for (i = 0; i < data->n_pipes; i++) {
+		struct pipe_data *p = &data->pipes[i];
+
+		p->crc = igt_pipe_crc_new(data->fd, p->pipe,
+					  IGT_PIPE_CRC_SOURCE_AUTO);
+		igt_pipe_crc_start_capture(p->crc, data->ring_size, true);
+	}
+}
+
+static void cleanup_pipes(struct data *data)
+{
+	int i, j;
+
+	for (i = 0; i < data->n_pipes; i++) {
+		struct pipe_data *p = &data->pipes[i];
+
+		igt_pipe_crc_stop(p->crc);
+		igt_pipe_crc_free(p->crc);
+		igt_atomic_template_free(p->tmpl);
+
+		for (j = 0; j < NUM_MODES; j++) {
+			igt_stats_fini(&p->results[j].latency);
+			igt_stats_fini(&p->results[j].latency_frames);
+		}
+
+		release_pipe(data, p);
+	}
+
+	igt_display_commit2(&data->display, data->display.is_atomic ?
+			    COMMIT_ATOMIC : COMMIT_LEGACY);
+}
+
+static double per_sec(const struct result *r, unsigned long count)
+{
+	return r->elapsed_s ? count / r->elapsed_s : 0;
+}
+
+static void report(struct data *data)
+{
+	int i, j, k;
+
+	for (i = 0; i < data->n_pipes; i++) {
+		struct pipe_data *p = &data->pipes[i];
+
+		igt_info("Pipe %s, frame time %.1f us:\n",
+			 kmstest_pipe_name(p->pipe), p->frame_time_ns / 1e3);
+
+		for (j = 0; j < NUM_MODES; j++) {
+			struct result *r = &p->results[j];
+			char line[256];
+			int len = 0;
+
+			if (!opt.modes[j])
+				continue;
+
+			igt_info("  %-6s %.0f updates/s, %.0f rejected/s, %.1f of %.1f frames/s changed, %.1f updates per change\n",
+				 mode_names[j], per_sec(r, r->updates),
+				 per_sec(r, r->rejected), per_sec(r, r->changes),
+				 per_sec(r, r->frames),
+				 r->changes ? (double)r->updates / r->changes : 0);
+
+			if (!r->latency.n_values)
+				continue;
+
+			for (k = 0; k < ARRAY_SIZE(percentiles); k++)
+				len += snprintf(line + len, sizeof(line) - len,
+						" p%g=%.1f", percentiles[k],
+						igt_stats_get_percentile(&r->latency,
+									 percentiles[k]) / 1e3);
+			igt_info("  %-6s latency n=%u min=%.1f%s max=%.1f us, median %.1f frames, %lu lost\n",
+				 "", r->latency.n_values,
+				 igt_stats_get_min(&r->latency) / 1e3, line,
+				 igt_stats_get_max(&r->latency) / 1e3,
+				 igt_stats_get_median(&r->latency_frames),
+				 r->lost);
+		}
+	}
+}
+
+static void write_json(struct data *data, const char *path)
+{
+	FILE *f = fopen(path, "w");
+	int i, j, k;
+
+	igt_assert_f(f, "Failed to open %s: %m\n", path);
+
+	fprintf(f, "{\n  \"duration_ms\": %u,\n  \"pipes\": [", opt.duration_ms);
+
+	for (i = 0; i < data->n_pipes; i++) {
+		struct pipe_data *p = &data->pipes[i];
+		bool first = true;
+
+		fprintf(f, "%s\n    {\n", i ? "," : "");
+		fprintf(f, "      \"pipe\": \"%s\",\n", kmstest_pipe_name(p->pipe));
+		fprintf(f, "      \"output\": \"%s\",\n", igt_output_name(p->output));
+		fprintf(f, "      \"frame_time_us\": %.3f,\n", p->frame_time_ns / 1e3);
+		fprintf(f, "      \"modes\": {");
+
+		for (j = 0; j < NUM_MODES; j++) {
+			struct result *r = &p->results[j];
+
+			if (!opt.modes[j])
+				continue;
+
+			fprintf(f, "%s\n        \"%s\": { \"updates_per_sec\": %.1f, "
+				"\"rejected_per_sec\": %.1f, \"frames_per_sec\": %.1f, "
+				"\"changes_per_sec\": %.1f, \"lost\": %lu",
+				first ? "" : ",", mode_names[j],
+				per_sec(r, r->updates), per_sec(r, r->rejected),
+				per_sec(r, r->frames), per_sec(r, r->changes),
+				r->lost);
+			if (r->latency.n_values) {
+				fprintf(f, ", \"samples\": %u, \"min_us\": %.3f",
+					r->latency.n_values,
+					igt_stats_get_min(&r->latency) / 1e3);
+				for (k = 0; k < ARRAY_SIZE(percentiles); k++)
+					fprintf(f, ", \"p%g_us\": %.3f",
+						percentiles[k],
+						igt_stats_get_percentile(&r->latency,
+									 percentiles[k]) / 1e3);
+				fprintf(f, ", \"max_us\": %.3f, \"median_frames\": %.1f",
+					igt_stats_get_max(&r->latency) / 1e3,
+					igt_stats_get_median(&r->latency_frames));
+			}
+			fprintf(f, " }");
+			first = false;
+		}
+
+		fprintf(f, "\n      }\n    }");
+	}
+
+	fprintf(f, "\n  ]\n}\n");
+	fclose(f);
+}
+
+static int opt_handler(int option, int option_index, void *input)
+{
+	char *modes, *mode, *saveptr;
+	int i;
+
+	switch (option) {
+	case 'd':
+		opt.duration_ms = strtoul(optarg, NULL, 0);
+		if (!opt.duration_ms)
+			return IGT_OPT_HANDLER_ERROR;
+		break;
+	case 'n':
+		opt.samples = strtoul(optarg, NULL, 0);
+		break;
+	case 'j':
+		opt.json = optarg;
+		break;
+	case 'm':
+		memset(opt.modes, 0, sizeof(opt.modes));
+
+		modes = strdup(optarg);
+		for (mode = strtok_r(modes, ",", &saveptr); mode;
+		     mode = strtok_r(NULL, ",", &saveptr)) {
+			for (i = 0; i < NUM_MODES; i++)
+				if (!strcmp(mode, mode_names[i]))
+					break;
+
+			if (i == NUM_MODES) {
+				free(modes);
+				return IGT_OPT_HANDLER_ERROR;
+			}
+			opt.modes[i] = true;
+		}
+		free(modes);
+		break;
+	default:
+		return IGT_OPT_HANDLER_ERROR;
+	}
+
+	return IGT_OPT_HANDLER_SUCCESS;
+}
+
+static const struct option long_opts[] = {
+	{ "duration", required_argument, NULL, 'd' },
+	{ "samples", required_argument, NULL, 'n' },
+	{ "json", required_argument, NULL, 'j' },
+	{ "modes", required_argument, NULL, 'm' },
+	{}
+};
+
+static const char help_str[] =
+	"  --duration, -d MS\tHow long to run each rate phase (default 2000)\n"
+	"  --samples, -n N\tLatency samples per pipe and mode (default 100)\n"
+	"  --json, -j FILE\tWrite the results to FILE as JSON\n"
+	"  --modes, -m LIST\tComma separated cursor updates to measure, out of\n"
+	"\t\t\tlegacy, atomic and async (default all)\n";
+
+igt_simple_main_args("d:n:j:m:", long_opts, help_str, opt_handler, NULL)
+{
+	struct data data = {};
+	enum mode mode;
+
+	data.fd = drm_open_driver_master(DRIVER_ANY);
+	kmstest_set_vt_graphics_mode();
+
+	igt_display_require(&data.display, data.fd);
+	igt_display_require_output(&data.display);
+	igt_require(data.display.has_cursor_plane);
+	igt_require_pipe_crc(data.fd);
+
+	if (drmGetCap(data.fd, DRM_CAP_CURSOR_WIDTH, &data.cursor_width))
+		data.cursor_width = 64;
+	if (drmGetCap(data.fd, DRM_CAP_CURSOR_HEIGHT, &data.cursor_height))
+		data.cursor_height = 64;
+
+	setup_pipes(&data);
+
+	if (!data.display.is_atomic) {
+		igt_info("Atomic not supported, only measuring legacy updates\n");
+		opt.modes[MODE_ATOMIC] = opt.modes[MODE_ASYNC] = false;
+	} else if (opt.modes[MODE_ASYNC] && !async_supported(&data)) {
+		igt_info("Async cursor updates not supported, skipping\n");
+		opt.modes[MODE_ASYNC] = false;
+	}
+
+	for (mode = 0; mode < NUM_MODES; mode++) {
+		if (!opt.modes[mode])
+			continue;
+
+		measure_rate(&data, mode);
+		measure_latency(&data, mode);
+		drain_events(&data);
+	}
+
+	report(&data);
+	if (opt.json)
+		write_json(&data, opt.json);
+
+	cleanup_pipes(&data);
+
+	igt_display_fini(&data.display);
+	drm_close_driver(data.fd);
+}
@@ -7,6 +7,7 @@
 
 #define FRAME_COUNT 100
 #define NUM_FBS 2
+#define LIFECYCLE_FBS 60
 
 struct rect_t {
 	int x, y;
@@ -104,6 +105,209 @@ static void set_crtc_size(struct data_t *data)
 	igt_assert_f(0, "CRTC size %dx%d not supported\n", crtc->width, crtc->height);
 }
 
+enum fill {
+	FILL_PATTERN,
+	FILL_PATTERN_CACHED,
+	FILL_COLOR_CPU,
+	FILL_COLOR_GPU,
+	NUM_FILLS
+};
+
+static const char * const fill_names[NUM_FILLS] = {
+	[FILL_PATTERN] = "pattern",
+	[FILL_PATTERN_CACHED] = "pattern-cached",
+	[FILL_COLOR_CPU] = "color-cpu",
+	[FILL_COLOR_GPU] = "color-gpu",
+};
+
+static const uint32_t lifecycle_formats[] = {
+	DRM_FORMAT_XRGB8888,
+	DRM_FORMAT_XRGB2101010,
+	DRM_FORMAT_XRGB16161616F,
+	DRM_FORMAT_NV12,
+};
+
+static const uint64_t lifecycle_modifiers[] = {
+	DRM_FORMAT_MOD_LINEAR,
+	I915_FORMAT_MOD_X_TILED,
+	I915_FORMAT_MOD_Y_TILED,
+	I915_FORMAT_MOD_4_TILED,
+};
+
+static const struct rect_t lifecycle_sizes[] = {
+	{ .width = 256, .height = 256 },
+	{ .width = 1920, .height = 1080 },
+	{ .width = 3840, .height = 2160 },
+};
+
+static struct {
+	bool enabled;
+	int fbs;
+} lifecycle = {
+	.fbs = LIFECYCLE_FBS,
+};
+
+static double elapsed_us(struct timespec *start)
+{
+	struct timespec now;
+
+	igt_assert_eq(igt_gettime(&now), 0);
+	return igt_time_elapsed(start, &now) * 1e6;
+}
+
+static void lifecycle_create(struct data_t *data, enum fill fill, int i,
+			     const struct rect_t *size, uint32_t format,
+			     uint64_t modifier, struct igt_fb *fb)
+{
+	if (fill == FILL_PATTERN || fill == FILL_PATTERN_CACHED)
+		igt_create_pattern_fb(data->fd, size->width, size->height,
+				      format, modifier, fb);
+	else
+		igt_create_color_fb(data->fd, size->width, size->height,
+				    format, modifier, i & 1, 0, !(i & 1), fb);
+}
+
+/*
+ * Allocate, scan out and release fbs the way a compositor allocating a new
+ * buffer per frame would: each new fb replaces the previous one on the
+ * plane, and the previous one is removed once it's no longer scanned out.
+ */
+static void lifecycle_run(struct data_t *data, igt_plane_t *plane,
+			  const struct rect_t *size, uint32_t format,
+			  uint64_t modifier, enum fill fill)
+{
+	struct igt_fb fbs[2] = {};
+	igt_stats_t create, scanout, rmfb;
+	struct timespec start, loop;
+	int cur = 0, n;
+	double total;
+
+	igt_fb_set_pattern_cache_size(fill == FILL_PATTERN_CACHED ? 256 << 20 : 0);
+	igt_fb_set_gpu_fill(fill == FILL_COLOR_GPU);
+
+	igt_stats_init_with_size(&create, lifecycle.fbs);
+	igt_stats_init_with_size(&scanout, lifecycle.fbs);
+	igt_stats_init_with_size(&rmfb, lifecycle.fbs);
+
+	igt_assert_eq(igt_gettime(&loop), 0);
+	for (n = 0; n < lifecycle.fbs; n++) {
+		struct igt_fb *fb = &fbs[cur], *prev = &fbs[!cur];
+
+		igt_assert_eq(igt_gettime(&start), 0);
+		lifecycle_create(data, fill, n, size, format, modifier, fb);
+		igt_stats_push_float(&create, elapsed_us(&start));
+
+		igt_assert_eq(igt_gettime(&start), 0);
+		igt_plane_set_fb(plane, fb);
+		if (igt_display_try_commit2(&data->display, COMMIT_ATOMIC)) {
+			igt_remove_fb(data->fd, fb);
+			break;
+		}
+		igt_stats_push_float(&scanout, elapsed_us(&start));
+
+		if (prev->fb_id) {
+			igt_assert_eq(igt_gettime(&start), 0);
+			igt_remove_fb(data->fd, prev);
+			igt_stats_push_float(&rmfb, elapsed_us(&start));
+		}
+
+		cur = !cur;
+	}
+	total = elapsed_us(&loop);
+
+	igt_plane_set_fb(plane, NULL);
+	igt_display_commit2(&data->display, COMMIT_ATOMIC);
+	igt_remove_fb(data->fd, &fbs[0]);
+	igt_remove_fb(data->fd, &fbs[1]);
+
+	if (n < lifecycle.fbs)
+		igt_info("%-10s %-24s %4dx%-4d %-14s commit failed\n",
+			 igt_format_str(format), igt_fb_modifier_name(modifier),
+			 size->width, size->height, fill_names[fill]);
+	else
+		igt_info("%-10s %-24s %4dx%-4d %-14s %8.1f fb/s"
+			 "  create %.0f/%.0fus  scanout %.0f/%.0fus  rmfb %.0f/%.0fus\n",
+			 igt_format_str(format), igt_fb_modifier_name(modifier),
+			 size->width, size->height, fill_names[fill],
+			 n / total * 1e6,
+			 igt_stats_get_median(&create),
+			 igt_stats_get_percentile(&create, 99),
+			 igt_stats_get_median(&scanout),
+			 igt_stats_get_percentile(&scanout, 99),
+			 igt_stats_get_median(&rmfb),
+			 igt_stats_get_percentile(&rmfb, 99));
+
+	igt_stats_fini(&create);
+	igt_stats_fini(&scanout);
+	igt_stats_fini(&rmfb);
+}
+
+static void lifecycle_sweep(struct data_t *data)
+{
+	igt_output_t *output = NULL;
+	drmModeModeInfo *mode;
+	igt_plane_t *plane;
+	enum pipe pipe;
+
+	for_each_pipe_with_valid_output(&data->display, pipe, output) {
+		igt_output_set_pipe(output, pipe);
+		break;
+	}
+	igt_require(output);
+
+	mode = igt_output_get_mode(output);
+	plane = igt_output_get_plane_type(output, DRM_PLANE_TYPE_PRIMARY);
+
+	igt_info("%-10s %-24s %9s %-14s %13s  median/p99 latencies\n",
+		 "format", "modifier", "size", "fill", "throughput");
+
+	for (int f = 0; f < ARRAY_SIZE(lifecycle_formats); f++)
+	for (int m = 0; m < ARRAY_SIZE(lifecycle_modifiers); m++) {
+		if (!igt_plane_has_format_mod(plane, lifecycle_formats[f],
+					      lifecycle_modifiers[m]))
+			continue;
+
+		for (int s = 0; s < ARRAY_SIZE(lifecycle_sizes); s++) {
+			const struct rect_t *size = &lifecycle_sizes[s];
+
+			if (size->width > mode->hdisplay ||
+			    size->height > mode->vdisplay)
+				continue;
+
+			for (enum fill fill = 0; fill < NUM_FILLS; fill++)
+				lifecycle_run(data, plane, size,
+					      lifecycle_formats[f],
+					      lifecycle_modifiers[m], fill);
+		}
+	}
+
+	igt_fb_set_pattern_cache_size(0);
+	igt_fb_set_gpu_fill(true);
+	igt_output_set_pipe(output, PIPE_NONE);
+	igt_display_commit2(&data->display, COMMIT_ATOMIC);
+}
+
+static int opt_handler(int opt, int opt_index, void *_data)
+{
+	switch (opt) {
+	case 'l':
+		lifecycle.enabled = true;
+		break;
+	case 'n':
+		lifecycle.fbs = max(atoi(optarg), 2);
+		break;
+	default:
+		return IGT_OPT_HANDLER_ERROR;
+	}
+
+	return IGT_OPT_HANDLER_SUCCESS;
+}
+
+static const char help_str[] =
+	"  -l\t\tMeasure the fb lifecycle instead: create, first scanout and\n"
+	"\t\tremoval of fbs across formats, modifiers, sizes and fill paths\n"
+	"  -n <fbs>\tNumber of fbs per lifecycle measurement (default 60)\n";
+
 static struct kms_t default_kms = {
 	.crtc = {
 		.width = 4096, .height = 2160,
@@ -139,7 +343,7 @@ static struct kms_t default_kms = {
 };
 
 
-igt_simple_main
+igt_simple_main_args("ln:", NULL, help_str, opt_handler, NULL)
 {
 	struct data_t data = {0};
 	enum pipe pipe = PIPE_NONE;
@@ -159,6 +363,13 @@ igt_simple_main
 
 	igt_display_reset(&data.display);
 
+	if (lifecycle.enabled) {
+		lifecycle_sweep(&data);
+		igt_display_fini(&data.display);
+		drm_close_driver(data.fd);
+		return;
+	}
+
 	data.wb_output = find_wb_output(&data);
 	igt_require(data.wb_output);
 
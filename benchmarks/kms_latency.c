@@ -0,0 +1,496 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2024 Intel Corporation
+ */
+
+/** @file kms_latency.c
+ *
+ * Measures the latency distributions of vblank events, page flips and async
+ * flips, on all the pipes that can be lit up at once.
+ *
+ * All latencies are taken against the CLOCK_MONOTONIC timestamps reported by
+ * the kernel:
+ *  - vblank-delivery: from the vblank timestamp to reading its event
+ *  - vblank-interval: between consecutive vblank timestamps, per vblank
+ *  - flip-completion: from queuing a flip to its vblank timestamp
+ *  - flip-delivery: from the flip timestamp to reading its event
+ *  - async-completion and async-delivery: the same for async flips
+ *
+ * The percentiles are printed per pipe, next to the frame time of the mode,
+ * and can also be written out as JSON with --json.
+ */
+
+#include <getopt.h>
+#include <poll.h>
+
+#include "igt.h"
+#include "igt_stats.h"
+
+#define NUM_FBS 2
+
+/* 1/128 relative error on the reported percentiles */
+#define HISTOGRAM_PRECISION 7
+
+enum metric {
+	VBLANK_DELIVERY,
+	VBLANK_INTERVAL,
+	FLIP_COMPLETION,
+	FLIP_DELIVERY,
+	ASYNC_COMPLETION,
+	ASYNC_DELIVERY,
+	NUM_METRICS
+};
+
+static const char * const metric_names[NUM_METRICS] = {
+	[VBLANK_DELIVERY] = "vblank-delivery",
+	[VBLANK_INTERVAL] = "vblank-interval",
+	[FLIP_COMPLETION] = "flip-completion",
+	[FLIP_DELIVERY] = "flip-delivery",
+	[ASYNC_COMPLETION] = "async-completion",
+	[ASYNC_DELIVERY] = "async-delivery",
+};
+
+static const double percentiles[] = { 50, 90, 99, 99.9 };
+
+struct pipe_data {
+	enum pipe pipe;
+	igt_output_t *output;
+	igt_plane_t *primary;
+	struct igt_fb fbs[NUM_FBS];
+	uint64_t frame_time_ns;
+
+	bool has_vblank;
+	unsigned int last_sequence;
+	uint64_t last_vblank_ns;
+	bool vblank_pending;
+
+	igt_stats_t stats[NUM_METRICS];
+};
+
+struct data {
+	int fd;
+	igt_display_t display;
+	struct pipe_data pipes[IGT_MAX_PIPES];
+	int n_pipes;
+};
+
+static struct {
+	unsigned int duration_ms;
+	const char *json;
+	bool vblank, flip, async;
+} opt = {
+	.duration_ms = 5000,
+	.vblank = true,
+	.flip = true,
+	.async = true,
+};
+
+static uint64_t monotonic_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static void push_latency(igt_stats_t *stats, uint64_t from, uint64_t to)
+{
+	/* Events read within the reported microsecond count as instant */
+	igt_stats_push(stats, to > from ? to - from : 0);
+}
+
+static void queue_vblank(struct data *data, struct pipe_data *p)
+{
+	drmVBlank vbl = {};
+
+	vbl.request.type = DRM_VBLANK_RELATIVE | DRM_VBLANK_EVENT |
+		kmstest_get_vbl_flag(data->display.pipes[p->pipe].crtc_offset);
+	vbl.request.sequence = 1;
+	vbl.request.signal = (unsigned long)p;
+
+	igt_assert_eq(drmWaitVBlank(data->fd, &vbl), 0);
+	p->vblank_pending = true;
+}
+
+static void vblank_handler(int fd, unsigned int sequence, unsigned int tv_sec,
+			   unsigned int tv_usec, void *user_data)
+{
+	uint64_t received_ns = monotonic_ns();
+	uint64_t timestamp_ns = tv_sec * NSEC_PER_SEC + tv_usec * 1000ull;
+	struct pipe_data *p = user_data;
+
+	push_latency(&p->stats[VBLANK_DELIVERY], timestamp_ns, received_ns);
+
+	if (p->has_vblank && sequence != p->last_sequence)
+		igt_stats_push(&p->stats[VBLANK_INTERVAL],
+			       (timestamp_ns - p->last_vblank_ns) /
+			       (sequence - p->last_sequence));
+
+	p->has_vblank = true;
+	p->last_sequence = sequence;
+	p->last_vblank_ns = timestamp_ns;
+	p->vblank_pending = false;
+}
+
+static void measure_vblanks(struct data *data)
+{
+	drmEventContext evctx = {
+		.version = 2,
+		.vblank_handler = vblank_handler,
+	};
+	struct pollfd pfd = {
+		.fd = data->fd,
+		.events = POLLIN,
+	};
+	uint64_t duration_ns = opt.duration_ms * 1000000ull;
+	struct timespec start = {};
+	bool pending;
+	int i;
+
+	igt_nsec_elapsed(&start);
+
+	/* One event in flight per pipe, all the pipes at once */
+	do {
+		bool queue = igt_nsec_elapsed(&start) < duration_ns;
+
+		pending = false;
+		for (i = 0; i < data->n_pipes; i++) {
+			struct pipe_data *p = &data->pipes[i];
+
+			if (!p->vblank_pending && queue)
+				queue_vblank(data, p);
+
+			pending |= p->vblank_pending;
+		}
+
+		if (!pending)
+			break;
+
+		igt_assert_f(poll(&pfd, 1, 1000) == 1,
+			     "Timed out waiting for vblank events\n");
+		igt_assert_eq(drmHandleEvent(pfd.fd, &evctx), 0);
+	} while (1);
+}
+
+struct flip_metrics {
+	struct pipe_data *pipe;
+	enum metric completion, delivery;
+};
+
+static void flip_done(struct igt_flip_engine *engine,
+		      const igt_flip_event_t *ev, void *user_data)
+{
+	struct flip_metrics *m = user_data;
+
+	push_latency(&m->pipe->stats[m->completion],
+		     ev->submit_ns, ev->timestamp_ns);
+	push_latency(&m->pipe->stats[m->delivery],
+		     ev->timestamp_ns, ev->received_ns);
+}
+
+static void measure_flips(struct data *data, uint32_t flags)
+{
+	struct flip_metrics metrics[IGT_MAX_PIPES];
+	struct igt_flip_engine *engine;
+	int i;
+
+	engine = igt_flip_engine_create(&data->display, flags);
+
+	for (i = 0; i < data->n_pipes; i++) {
+		struct pipe_data *p = &data->pipes[i];
+
+		metrics[i].pipe = p;
+		if (flags & DRM_MODE_PAGE_FLIP_ASYNC) {
+			metrics[i].completion = ASYNC_COMPLETION;
+			metrics[i].delivery = ASYNC_DELIVERY;
+		} else {
+			metrics[i].completion = FLIP_COMPLETION;
+			metrics[i].delivery = FLIP_DELIVERY;
+		}
+
+		igt_flip_engine_add_pipe(engine, p->pipe, p->primary,
+					 p->fbs, NUM_FBS, flip_done,
+					 &metrics[i]);
+	}
+
+	igt_flip_engine_run(engine, opt.duration_ms);
+	igt_flip_engine_free(engine);
+}
+
+static uint64_t fb_modifier(struct data *data)
+{
+	/* Async flips need tiled framebuffers on Intel */
+	if (is_intel_device(data->fd))
+		return I915_FORMAT_MOD_X_TILED;
+
+	return DRM_FORMAT_MOD_LINEAR;
+}
+
+static void setup_pipe(struct data *data, struct pipe_data *p)
+{
+	drmModeModeInfo *mode = igt_output_get_mode(p->output);
+	int i;
+
+	for (i = 0; i < NUM_FBS; i++)
+		igt_create_color_fb(data->fd, mode->hdisplay, mode->vdisplay,
+				    DRM_FORMAT_XRGB8888, fb_modifier(data),
+				    i, i, !i, &p->fbs[i]);
+
+	p->primary = igt_output_get_plane_type(p->output,
+					       DRM_PLANE_TYPE_PRIMARY);
+	igt_plane_set_fb(p->primary, &p->fbs[0]);
+	p->frame_time_ns = igt_kms_frame_time_from_vrefresh(mode->vrefresh);
+}
+
+static void release_pipe(struct data *data, struct pipe_data *p)
+{
+	int i;
+
+	igt_plane_set_fb(p->primary, NULL);
+	igt_output_set_pipe(p->output, PIPE_NONE);
+
+	for (i = 0; i < NUM_FBS; i++)
+		igt_remove_fb(data->fd, &p->fbs[i]);
+}
+
+static void setup_pipes(struct data *data)
+{
+	igt_display_t *display = &data->display;
+	igt_output_t *output;
+	uint32_t used = 0;
+	enum pipe pipe;
+	int i, j;
+
+	igt_display_reset(display);
+
+	for_each_connected_output(display, output) {
+		for_each_pipe(display, pipe) {
+			struct pipe_data *p = &data->pipes[data->n_pipes];
+
+			if (used & BIT(pipe) ||
+			    !igt_pipe_connector_valid(pipe, output))
+				continue;
+
+			used |= BIT(pipe);
+			p->pipe = pipe;
+			p->output = output;
+			igt_output_set_pipe(output, pipe);
+			setup_pipe(data, p);
+			data->n_pipes++;
+			break;
+		}
+	}
+
+	/* Drop outputs until the configuration fits */
+	while (display->is_atomic && data->n_pipes &&
+	       igt_display_try_commit_atomic(display,
+					     DRM_MODE_ATOMIC_TEST_ONLY |
+					     DRM_MODE_ATOMIC_ALLOW_MODESET,
+					     NULL) != 0)
+		release_pipe(data, &data->pipes[--data->n_pipes]);
+	igt_require_f(data->n_pipes, "No output could be lit up\n");
+
+	for (i = 0; i < data->n_pipes; i++) {
+		struct pipe_data *p = &data->pipes[i];
+		drmModeModeInfo *mode = igt_output_get_mode(p->output);
+
+		for (j = 0; j < NUM_METRICS; j++)
+			igt_stats_init_histogram(&p->stats[j],
+						 HISTOGRAM_PRECISION);
+
+		igt_info("Pipe %s: %s, %dx%d@%d\n", kmstest_pipe_name(p->pipe),
+			 igt_output_name(p->output), mode->hdisplay,
+			 mode->vdisplay, mode->vrefresh);
+	}
+
+	igt_display_commit2(display, display->is_atomic ?
+			    COMMIT_ATOMIC : COMMIT_LEGACY);
+}
+
+static void cleanup_pipes(struct data *data)
+{
+	int i, j;
+
+	for (i = 0; i < data->n_pipes; i++) {
+		for (j = 0; j < NUM_METRICS; j++)
+			igt_stats_fini(&data->pipes[i].stats[j]);
+
+		release_pipe(data, &data->pipes[i]);
+	}
+
+	igt_display_commit2(&data->display, data->display.is_atomic ?
+			    COMMIT_ATOMIC : COMMIT_LEGACY);
+}
+
+static void report(struct data *data)
+{
+	int i, j, k;
+
+	for (i = 0; i < data->n_pipes; i++) {
+		struct pipe_data *p = &data->pipes[i];
+
+		igt_info("Pipe %s, frame time %.1f us:\n",
+			 kmstest_pipe_name(p->pipe), p->frame_time_ns / 1e3);
+
+		for (j = 0; j < NUM_METRICS; j++) {
+			igt_stats_t *stats = &p->stats[j];
+			char line[256];
+			double p99;
+			int len;
+
+			if (!stats->n_values)
+				continue;
+
+			len = snprintf(line, sizeof(line), "n=%u min=%.1f",
+				       stats->n_values,
+				       igt_stats_get_min(stats) / 1e3);
+			for (k = 0; k < ARRAY_SIZE(percentiles); k++)
+				len += snprintf(line + len, sizeof(line) - len,
+						" p%g=%.1f", percentiles[k],
+						igt_stats_get_percentile(stats,
+									 percentiles[k]) / 1e3);
+
+			p99 = igt_stats_get_percentile(stats, 99);
+			igt_info("  %-16s %s max=%.1f us, p99 %.3f frames\n",
+				 metric_names[j], line,
+				 igt_stats_get_max(stats) / 1e3,
+				 p->frame_time_ns ? p99 / p->frame_time_ns : 0);
+		}
+	}
+}
+
+static void write_json(struct data *data, const char *path)
+{
+	FILE *f = fopen(path, "w");
+	int i, j, k;
+
+	igt_assert_f(f, "Failed to open %s: %m\n", path);
+
+	fprintf(f, "{\n  \"duration_ms\": %u,\n  \"pipes\": [", opt.duration_ms);
+
+	for (i = 0; i < data->n_pipes; i++) {
+		struct pipe_data *p = &data->pipes[i];
+		bool first = true;
+
+		fprintf(f, "%s\n    {\n", i ? "," : "");
+		fprintf(f, "      \"pipe\": \"%s\",\n", kmstest_pipe_name(p->pipe));
+		fprintf(f, "      \"output\": \"%s\",\n", igt_output_name(p->output));
+		fprintf(f, "      \"frame_time_us\": %.3f,\n", p->frame_time_ns / 1e3);
+		fprintf(f, "      \"metrics\": {");
+
+		for (j = 0; j < NUM_METRICS; j++) {
+			igt_stats_t *stats = &p->stats[j];
+
+			if (!stats->n_values)
+				continue;
+
+			fprintf(f, "%s\n        \"%s\": { \"samples\": %u, "
+				"\"mean_us\": %.3f, \"min_us\": %.3f",
+				first ? "" : ",", metric_names[j],
+				stats->n_values, igt_stats_get_mean(stats) / 1e3,
+				igt_stats_get_min(stats) / 1e3);
+			for (k = 0; k < ARRAY_SIZE(percentiles); k++)
+				fprintf(f, ", \"p%g_us\": %.3f", percentiles[k],
+					igt_stats_get_percentile(stats,
+								 percentiles[k]) / 1e3);
+			fprintf(f, ", \"max_us\": %.3f }",
+				igt_stats_get_max(stats) / 1e3);
+			first = false;
+		}
+
+		fprintf(f, "\n      }\n    }");
+	}
+
+	fprintf(f, "\n  ]\n}\n");
+	fclose(f);
+}
+
+static int opt_handler(int option, int option_index, void *input)
+{
+	char *tests, *test, *saveptr;
+
+	switch (option) {
+	case 'd':
+		opt.duration_ms = strtoul(optarg, NULL, 0);
+		if (!opt.duration_ms)
+			return IGT_OPT_HANDLER_ERROR;
+		break;
+	case 'j':
+		opt.json = optarg;
+		break;
+	case 't':
+		opt.vblank = opt.flip = opt.async = false;
+
+		tests = strdup(optarg);
+		for (test = strtok_r(tests, ",", &saveptr); test;
+		     test = strtok_r(NULL, ",", &saveptr)) {
+			if (!strcmp(test, "vblank"))
+				opt.vblank = true;
+			else if (!strcmp(test, "flip"))
+				opt.flip = true;
+			else if (!strcmp(test, "async"))
+				opt.async = true;
+			else {
+				free(tests);
+				return IGT_OPT_HANDLER_ERROR;
+			}
+		}
+		free(tests);
+		break;
+	default:
+		return IGT_OPT_HANDLER_ERROR;
+	}
+
+	return IGT_OPT_HANDLER_SUCCESS;
+}
+
+static const struct option long_opts[] = {
+	{ "duration", required_argument, NULL, 'd' },
+	{ "json", required_argument, NULL, 'j' },
+	{ "tests", required_argument, NULL, 't' },
+	{}
+};
+
+static const char help_str[] =
+	"  --duration, -d MS\tHow long to run each measurement (default 5000)\n"
+	"  --json, -j FILE\tWrite the results to FILE as JSON\n"
+	"  --tests, -t LIST\tComma separated measurements to run, out of\n"
+	"\t\t\tvblank, flip and async (default all)\n";
+
+igt_simple_main_args("d:j:t:", long_opts, help_str, opt_handler, NULL)
+{
+	struct data data = {};
+
+	data.fd = drm_open_driver_master(DRIVER_ANY);
+	kmstest_set_vt_graphics_mode();
+
+	igt_display_require(&data.display, data.fd);
+	igt_display_require_output(&data.display);
+
+	setup_pipes(&data);
+
+	if (opt.vblank)
+		measure_vblanks(&data);
+
+	if (opt.flip)
+		measure_flips(&data, 0);
+
+	if (opt.async) {
+		if (igt_has_drm_cap(data.fd, data.display.is_atomic ?
+				    DRM_CAP_ATOMIC_ASYNC_PAGE_FLIP :
+				    DRM_CAP_ASYNC_PAGE_FLIP))
+			measure_flips(&data, DRM_MODE_PAGE_FLIP_ASYNC);
+		else
+			igt_info("Async flips not supported, skipping\n");
+	}
+
+	report(&data);
+	if (opt.json)
+		write_json(&data, opt.json);
+
+	cleanup_pipes(&data);
+
+	igt_display_fini(&data.display);
+	drm_close_driver(data.fd);
+}
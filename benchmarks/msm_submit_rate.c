@@ -0,0 +1,149 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2025 Google, Inc.
+ */
+
+/*
+ * Measures the rate of msm cmdstream submits, with a ring of reusable
+ * cmdstream buffers keeping more and more submits in flight, and the
+ * latency of a single submit waited on.
+ *
+ * Each submit is a short cmdstream of NOPs, so the rate is bounded by the
+ * submit ioctl and the fence handling rather than by the GPU.
+ */
+
+#include "igt.h"
+#include "igt_bench.h"
+#include "igt_msm.h"
+
+#define LATENCY_SAMPLES	256
+#define CMD_SIZE	0x1000
+
+struct submit {
+	struct igt_bench bench;
+
+	struct msm_device *dev;
+	struct msm_pipe *pipe;
+	struct msm_cmd_ring *ring;
+	unsigned int nops;
+
+	unsigned int max_depth;
+};
+
+static void emit(struct submit *s)
+{
+	struct msm_cmd *cmd = igt_msm_cmd_ring_get(s->ring);
+
+	msm_cmd_pkt7(cmd, CP_NOP, s->nops);
+	for (unsigned int n = 0; n < s->nops; n++)
+		msm_cmd_emit(cmd, 0);
+
+	igt_msm_cmd_ring_submit(s->ring, cmd);
+}
+
+static void submit(void *data, unsigned int thread, unsigned long count)
+{
+	struct submit *s = data;
+
+	while (count--)
+		emit(s);
+	igt_msm_cmd_ring_wait(s->ring);
+}
+
+static void latency(struct submit *s, double *median, double *p99)
+{
+	struct timespec start;
+	igt_stats_t stats;
+
+	igt_stats_init_with_size(&stats, LATENCY_SAMPLES);
+	for (int n = 0; n < LATENCY_SAMPLES; n++) {
+		igt_nsec_elapsed(&start);
+		submit(s, 0, 1);
+		igt_stats_push_float(&stats, igt_nsec_elapsed(&start) * 1e-3);
+	}
+
+	*median = igt_stats_get_median(&stats);
+	*p99 = igt_stats_get_percentile(&stats, 99);
+	igt_stats_fini(&stats);
+}
+
+static void run(struct submit *s, unsigned int depth)
+{
+	struct igt_bench_result result;
+	double median, p99;
+	char label[64];
+
+	s->ring = igt_msm_cmd_ring_new(s->pipe, depth, CMD_SIZE);
+
+	snprintf(label, sizeof(label), "depth=%u,nops=%u", depth, s->nops);
+	igt_bench_run(&s->bench, label, submit, s, &result);
+
+	/* A single submit, waited on, is the latency at any depth */
+	latency(s, &median, &p99);
+
+	printf("%5u %6u %12.0f %10.0f %10.1f %10.1f\n",
+	       depth, s->nops, result.mean, result.ci95, median, p99);
+
+	igt_bench_result_fini(&result);
+	igt_msm_cmd_ring_free(s->ring);
+}
+
+static int opt_handler(int opt, int opt_index, void *data)
+{
+	struct submit *s = data;
+
+	switch (opt) {
+	case 'n':
+		/* The header and the NOPs have to fit in the cmdstream */
+		s->nops = clamp(atoi(optarg), 1, CMD_SIZE / 4 - 1);
+		break;
+	case 'd':
+		s->max_depth = clamp(atoi(optarg), 1, 256);
+		break;
+	default:
+		return IGT_OPT_HANDLER_ERROR;
+	}
+
+	return IGT_OPT_HANDLER_SUCCESS;
+}
+
+static const char help_str[] =
+	"  -n <nops>         NOP dwords in each cmdstream, 16 by default.\n"
+	"  -d <depth>        Largest number of submits in flight, sweeps\n"
+	"                    powers of two up to it, 64 by default.\n"
+	"Reports submits/s and the p50/p99 latency of a single submit in us.\n";
+
+int main(int argc, char **argv)
+{
+	struct submit s = {
+		.nops = 16,
+		.max_depth = 64,
+	};
+
+	igt_bench_init(&s.bench, "msm_submit_rate");
+	s.bench.opts.duration = 1;
+	igt_bench_parse_opts(&s.bench, argc, argv, "n:d:", help_str,
+			     opt_handler, &s);
+	/* The ring belongs to a single submitqueue, one process drives it */
+	s.bench.opts.threads = 1;
+
+	s.dev = igt_msm_dev_open();
+	s.pipe = igt_msm_pipe_open(s.dev, 0);
+	igt_bench_set_device(&s.bench, s.dev->fd);
+	igt_bench_set_unit(&s.bench, "submits/s", 1);
+
+	printf("%5s %6s %12s %10s %10s %10s\n",
+	       "depth", "nops", "submits/s", "ci95", "p50 (us)", "p99 (us)");
+
+	for (unsigned int depth = 1; ; depth = min(2 * depth, s.max_depth)) {
+		run(&s, depth);
+		if (depth == s.max_depth)
+			break;
+	}
+
+	igt_msm_pipe_close(s.pipe);
+	igt_msm_dev_close(s.dev);
+	igt_bench_fini(&s.bench);
+
+	return 0;
+}
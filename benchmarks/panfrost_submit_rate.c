@@ -0,0 +1,146 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2025 Collabora Ltd
+ */
+
+/*
+ * Measures the job submission rate on Mali with panfrost: building a new
+ * NULL job with its BO and syncobj for each submit and waiting on it, as
+ * the tests do, against a ring of reusable jobs from lib/igt_panfrost.c
+ * with more and more of them in flight. Also reports the latency from
+ * submitting a single job to its out syncobj signaling.
+ */
+
+#include "igt.h"
+#include "igt_bench.h"
+#include "igt_panfrost.h"
+#include "igt_syncobj.h"
+
+#define LATENCY_SAMPLES	256
+
+struct submit {
+	struct igt_bench bench;
+
+	int fd;
+	struct panfrost_job_ring *ring;
+
+	unsigned int max_depth;
+};
+
+static void fresh(void *data, unsigned int thread, unsigned long count)
+{
+	struct submit *s = data;
+
+	while (count--) {
+		struct panfrost_submit *submit = igt_panfrost_null_job(s->fd);
+
+		do_ioctl(s->fd, DRM_IOCTL_PANFROST_SUBMIT, submit->args);
+		igt_assert(syncobj_wait(s->fd, &submit->args->out_sync, 1,
+					INT64_MAX, 0, NULL));
+		syncobj_destroy(s->fd, submit->args->out_sync);
+		igt_panfrost_free_job(s->fd, submit);
+	}
+}
+
+static void ring(void *data, unsigned int thread, unsigned long count)
+{
+	struct submit *s = data;
+
+	while (count--)
+		igt_panfrost_job_ring_submit(s->ring);
+	igt_panfrost_job_ring_wait(s->ring);
+}
+
+static void latency(struct submit *s, igt_bench_fn fn,
+		    double *median, double *p99)
+{
+	struct timespec start;
+	igt_stats_t stats;
+
+	igt_stats_init_with_size(&stats, LATENCY_SAMPLES);
+	for (int n = 0; n < LATENCY_SAMPLES; n++) {
+		igt_nsec_elapsed(&start);
+		fn(s, 0, 1);
+		igt_stats_push_float(&stats, igt_nsec_elapsed(&start) * 1e-3);
+	}
+
+	*median = igt_stats_get_median(&stats);
+	*p99 = igt_stats_get_percentile(&stats, 99);
+	igt_stats_fini(&stats);
+}
+
+static void run(struct submit *s, const char *mode, unsigned int depth,
+		igt_bench_fn fn)
+{
+	struct igt_bench_result result;
+	double median, p99;
+	char label[64];
+
+	snprintf(label, sizeof(label), "mode=%s,depth=%u", mode, depth);
+	igt_bench_run(&s->bench, label, fn, s, &result);
+
+	/* A single job, waited on, is the latency at any depth */
+	latency(s, fn, &median, &p99);
+
+	printf("%-6s %5u %12.0f %10.0f %10.1f %10.1f\n",
+	       mode, depth, result.mean, result.ci95, median, p99);
+
+	igt_bench_result_fini(&result);
+}
+
+static int opt_handler(int opt, int opt_index, void *data)
+{
+	struct submit *s = data;
+
+	switch (opt) {
+	case 'd':
+		s->max_depth = clamp(atoi(optarg), 1, 64);
+		break;
+	default:
+		return IGT_OPT_HANDLER_ERROR;
+	}
+
+	return IGT_OPT_HANDLER_SUCCESS;
+}
+
+static const char help_str[] =
+	"  -d <depth>        Largest number of jobs in flight, sweeps powers\n"
+	"                    of two up to it, 16 by default.\n"
+	"Reports jobs/s and the p50/p99 submit to complete latency in us.\n";
+
+int main(int argc, char **argv)
+{
+	struct submit s = {
+		.max_depth = 16,
+	};
+
+	igt_bench_init(&s.bench, "panfrost_submit_rate");
+	s.bench.opts.duration = 1;
+	igt_bench_parse_opts(&s.bench, argc, argv, "d:", help_str,
+			     opt_handler, &s);
+	/* The ring belongs to this process */
+	s.bench.opts.threads = 1;
+
+	s.fd = drm_open_driver(DRIVER_PANFROST);
+	igt_bench_set_device(&s.bench, s.fd);
+	igt_bench_set_unit(&s.bench, "jobs/s", 1);
+
+	printf("%-6s %5s %12s %10s %10s %10s\n",
+	       "mode", "depth", "jobs/s", "ci95", "p50 (us)", "p99 (us)");
+
+	run(&s, "fresh", 1, fresh);
+
+	for (unsigned int depth = 1; ; depth = min(2 * depth, s.max_depth)) {
+		s.ring = igt_panfrost_job_ring_new(s.fd, depth, false);
+		run(&s, "ring", depth, ring);
+		igt_panfrost_job_ring_free(s.ring);
+
+		if (depth == s.max_depth)
+			break;
+	}
+
+	igt_bench_fini(&s.bench);
+	drm_close_driver(s.fd);
+
+	return 0;
+}
@@ -0,0 +1,626 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2025 Intel Corporation
+ */
+
+/*
+ * Measures transfers through dma-buf between two GPUs: one device exports a
+ * buffer, the other imports it and copies to or from it with its own copy
+ * engine, the blitter for i915 and xe and SDMA for amdgpu. Every ordered
+ * pair of the i915, xe and amdgpu devices found is measured, with the
+ * exported buffer in the exporter's VRAM and in system memory.
+ *
+ * Whether the importer reaches the exporter's VRAM peer to peer or the
+ * buffer is migrated to system memory on attachment is up to the kernel;
+ * the first copy, which pays for the attachment, is reported apart.
+ *
+ * Reports:
+ *  - read and write bandwidth of the importer against the transfer size,
+ *  - latency distribution of a 4KiB copy,
+ *  - cost of exporting and importing a sync_file through the dma-buf.
+ */
+
+#include <getopt.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "igt.h"
+#include "igt_device.h"
+#include "igt_stats.h"
+#include "dmabuf_sync_file.h"
+#include "intel_blt.h"
+#include "intel_mocs.h"
+#include "intel_pat.h"
+#include "i915/intel_memory_region.h"
+#include "xe/xe_ioctl.h"
+#include "xe/xe_query.h"
+#ifdef HAVE_LIBDRM_AMDGPU
+#include "lib/amdgpu/amd_memory.h"
+#include "lib/amdgpu/amd_command_submission.h"
+#include "lib/amdgpu/amd_ip_blocks.h"
+#endif
+
+#define MAX_GPUS	8
+#define MIN_SIZE	(64ull << 10)
+#define LATENCY_SIZE	4096
+/* Rows of the blits stay within their 16 bit coordinates up to 256MiB */
+#define BLT_PITCH	(16u << 10)
+#define MAX_SIZE	(256ull << 20)
+#define SDMA_CHUNK	(2ull << 20)
+/* Copy packets of a submission, the IB is limited to 1024 dwords */
+#define SDMA_CHUNKS	128
+
+#ifdef HAVE_LIBDRM_AMDGPU
+#define DRIVERS		(DRIVER_INTEL | DRIVER_XE | DRIVER_AMDGPU)
+#else
+#define DRIVERS		(DRIVER_INTEL | DRIVER_XE)
+#endif
+
+enum driver {
+	I915,
+	XE,
+	AMDGPU,
+};
+
+static const char * const driver_names[] = {
+	[I915] = "i915",
+	[XE] = "xe",
+	[AMDGPU] = "amdgpu",
+};
+
+struct gpu {
+	int fd;
+	enum driver driver;
+	char slot[NAME_MAX];
+	bool has_vram;
+	bool can_copy;
+
+	/* i915 and xe */
+	uint32_t sys_region, vram_region;
+	uint32_t vm, exec_queue;
+	intel_ctx_t *ctx;
+	uint64_t ahnd;
+	uint32_t bb;
+	uint64_t bb_size;
+
+#ifdef HAVE_LIBDRM_AMDGPU
+	amdgpu_device_handle dev;
+	const struct amdgpu_ip_block_version *sdma;
+	struct amdgpu_ring_context *ring;
+#endif
+};
+
+struct buf {
+	struct gpu *gpu;
+	uint64_t size;
+
+	/* i915 and xe */
+	uint32_t handle;
+	uint32_t region;
+
+#ifdef HAVE_LIBDRM_AMDGPU
+	amdgpu_bo_handle bo;
+	amdgpu_va_handle va_handle;
+	uint64_t va;
+#endif
+};
+
+struct latency {
+	unsigned int exporter, importer;
+	bool vram;
+	double first;
+	double copy_p50, copy_p99;
+	double export_p50, import_p50;
+	bool sync_file;
+};
+
+static struct gpu gpus[MAX_GPUS];
+static unsigned int num_gpus;
+static uint64_t max_size = 64ull << 20;
+static unsigned int iterations = 8;
+static unsigned int samples = 256;
+
+static struct latency latencies[MAX_GPUS * MAX_GPUS * 2];
+static unsigned int num_latencies;
+
+static double elapsed_us(struct timespec *start)
+{
+	return igt_nsec_elapsed(start) * 1e-3;
+}
+
+#ifdef HAVE_LIBDRM_AMDGPU
+static void amdgpu_init(struct gpu *gpu)
+{
+	static bool ip_blocks_set;
+	struct amdgpu_gpu_info gpu_info = {};
+	struct amdgpu_ring_context *ring;
+	uint32_t major, minor;
+
+	igt_assert_eq(amdgpu_device_initialize(gpu->fd, &major, &minor,
+					       &gpu->dev), 0);
+	gpu->has_vram = true;
+
+	/* The IP blocks are global state, only the first device gets them */
+	if (ip_blocks_set)
+		return;
+
+	igt_assert_eq(amdgpu_query_gpu_info(gpu->dev, &gpu_info), 0);
+	igt_assert_eq(setup_amdgpu_ip_blocks(major, minor, &gpu_info,
+					     gpu->dev), 0);
+	ip_blocks_set = true;
+
+	gpu->sdma = get_ip_block(gpu->dev, AMD_IP_DMA);
+	if (!gpu->sdma)
+		return;
+
+	ring = calloc(1, sizeof(*ring));
+	igt_assert(ring);
+	ring->pm4 = calloc(1024, sizeof(*ring->pm4));
+	igt_assert(ring->pm4);
+	ring->pm4_size = 1024;
+	ring->res_cnt = 2;
+	igt_assert_eq(amdgpu_query_hw_ip_info(gpu->dev, gpu->sdma->type, 0,
+					      &ring->hw_ip_info), 0);
+	igt_assert_eq(amdgpu_cs_ctx_create(gpu->dev, &ring->context_handle), 0);
+	ring->bo_pool = amdgpu_bo_pool_create(gpu->dev, 0);
+
+	gpu->ring = ring;
+	gpu->can_copy = true;
+}
+
+static void amdgpu_fini(struct gpu *gpu)
+{
+	if (gpu->ring) {
+		amdgpu_bo_pool_destroy(gpu->ring->bo_pool);
+		amdgpu_cs_ctx_free(gpu->ring->context_handle);
+		free(gpu->ring->pm4);
+		free(gpu->ring);
+	}
+	amdgpu_device_deinitialize(gpu->dev);
+}
+
+/* Splits the copy in packets of 2MiB, as many per submission as fit */
+static void amdgpu_copy(struct gpu *gpu, struct buf *dst, struct buf *src,
+			uint64_t size)
+{
+	struct amdgpu_ring_context *ring = gpu->ring;
+	uint32_t *pm4 = ring->pm4;
+	uint64_t offset = 0;
+
+	ring->resources[0] = src->bo;
+	ring->resources[1] = dst->bo;
+
+	while (offset < size) {
+		uint32_t total = 0, dw;
+
+		for (int n = 0; n < SDMA_CHUNKS && offset < size; n++) {
+			ring->pm4 = pm4 + total;
+			ring->bo_mc = src->va + offset;
+			ring->bo_mc2 = dst->va + offset;
+			ring->write_length = min_t(uint64_t, size - offset,
+						   SDMA_CHUNK);
+			gpu->sdma->funcs->copy_linear(gpu->sdma->funcs, ring, &dw);
+			total += dw;
+			offset += ring->write_length;
+		}
+
+		ring->pm4 = pm4;
+		ring->pm4_dw = total;
+		amdgpu_test_exec_cs_helper(gpu->dev, gpu->sdma->type, ring, 0);
+	}
+}
+#endif
+
+static void intel_copy(struct gpu *gpu, struct buf *dst, struct buf *src,
+		       uint64_t size)
+{
+	uint32_t pitch = min_t(uint64_t, size, BLT_PITCH);
+	uint8_t mocs = intel_get_uc_mocs_index(gpu->fd);
+	struct blt_copy_data blt = {};
+
+	blt_copy_init(gpu->fd, &blt);
+	blt.color_depth = CD_32bit;
+	blt_set_object(&blt.src, src->handle, src->size, src->region, mocs,
+		       DEFAULT_PAT_INDEX, T_LINEAR, COMPRESSION_DISABLED, 0);
+	blt_set_geom(&blt.src, pitch, 0, 0, pitch / 4, size / pitch, 0, 0);
+	blt_set_object(&blt.dst, dst->handle, dst->size, dst->region, mocs,
+		       DEFAULT_PAT_INDEX, T_LINEAR, COMPRESSION_DISABLED, 0);
+	blt_set_geom(&blt.dst, pitch, 0, 0, pitch / 4, size / pitch, 0, 0);
+	blt_set_batch(&blt.bb, gpu->bb, gpu->bb_size, gpu->sys_region);
+
+	/* The xe context waits for the copy, i915 has to sync on it */
+	blt_fast_copy(gpu->fd, gpu->ctx, NULL, gpu->ahnd, &blt);
+	if (gpu->driver == I915)
+		gem_sync(gpu->fd, dst->handle);
+}
+
+/* Copies synchronously with the copy engine of @gpu */
+static void copy(struct gpu *gpu, struct buf *dst, struct buf *src,
+		 uint64_t size)
+{
+#ifdef HAVE_LIBDRM_AMDGPU
+	if (gpu->driver == AMDGPU) {
+		amdgpu_copy(gpu, dst, src, size);
+		return;
+	}
+#endif
+	intel_copy(gpu, dst, src, size);
+}
+
+static void gpu_init(struct gpu *gpu, int fd)
+{
+	gpu->fd = fd;
+	igt_device_get_pci_slot_name(fd, gpu->slot);
+
+	if (is_xe_device(fd)) {
+		gpu->driver = XE;
+		gpu->sys_region = system_memory(fd);
+		gpu->has_vram = xe_has_vram(fd);
+		if (gpu->has_vram)
+			gpu->vram_region = vram_memory(fd, 0);
+
+		gpu->can_copy = blt_has_fast_copy(fd);
+		if (!gpu->can_copy)
+			return;
+
+		gpu->vm = xe_vm_create(fd, 0, 0);
+		gpu->exec_queue = xe_exec_queue_create_class(fd, gpu->vm,
+							     DRM_XE_ENGINE_CLASS_COPY);
+		gpu->ctx = intel_ctx_xe(fd, gpu->vm, gpu->exec_queue, 0, 0, 0);
+		gpu->ahnd = intel_allocator_open_full(fd, gpu->vm, 0, 0,
+						      INTEL_ALLOCATOR_SIMPLE,
+						      ALLOC_STRATEGY_LOW_TO_HIGH,
+						      0);
+		gpu->bb_size = xe_bb_size(fd, SZ_4K);
+		gpu->bb = xe_bo_create(fd, 0, gpu->bb_size, gpu->sys_region, 0);
+	} else if (is_i915_device(fd)) {
+		gpu->driver = I915;
+		gpu->sys_region = REGION_SMEM;
+		gpu->has_vram = gem_has_lmem(fd);
+		gpu->vram_region = REGION_LMEM(0);
+
+		gpu->can_copy = blt_has_fast_copy(fd);
+		if (!gpu->can_copy)
+			return;
+
+		gpu->ahnd = intel_allocator_open(fd, 0, INTEL_ALLOCATOR_SIMPLE);
+		gpu->bb_size = SZ_4K;
+		gpu->bb = gem_create_in_memory_regions(fd, gpu->bb_size,
+						       REGION_SMEM);
+	} else {
+		gpu->driver = AMDGPU;
+#ifdef HAVE_LIBDRM_AMDGPU
+		amdgpu_init(gpu);
+#endif
+	}
+}
+
+static void gpu_fini(struct gpu *gpu)
+{
+	if (gpu->driver == AMDGPU) {
+#ifdef HAVE_LIBDRM_AMDGPU
+		amdgpu_fini(gpu);
+#endif
+	} else if (gpu->can_copy) {
+		gem_close(gpu->fd, gpu->bb);
+		put_ahnd(gpu->ahnd);
+		if (gpu->driver == XE) {
+			free(gpu->ctx);
+			xe_exec_queue_destroy(gpu->fd, gpu->exec_queue);
+			xe_vm_destroy(gpu->fd, gpu->vm);
+		}
+	}
+
+	drm_close_driver(gpu->fd);
+}
+
+static struct buf *buf_create(struct gpu *gpu, uint64_t size, bool vram)
+{
+	struct buf *buf = calloc(1, sizeof(*buf));
+
+	igt_assert(buf);
+	buf->gpu = gpu;
+	buf->size = size;
+	buf->region = vram ? gpu->vram_region : gpu->sys_region;
+
+	/* Exported VRAM may have to move to system memory on attachment */
+	switch (gpu->driver) {
+	case I915:
+		if (vram)
+			buf->handle = gem_create_in_memory_regions(gpu->fd, size,
+								   REGION_LMEM(0),
+								   REGION_SMEM);
+		else
+			buf->handle = gem_create_in_memory_regions(gpu->fd, size,
+								   REGION_SMEM);
+		break;
+	case XE:
+		buf->handle = xe_bo_create(gpu->fd, 0, size,
+					   vram ? gpu->vram_region | gpu->sys_region :
+						  gpu->sys_region, 0);
+		break;
+	case AMDGPU:
+#ifdef HAVE_LIBDRM_AMDGPU
+		buf->bo = gpu_mem_alloc(gpu->dev, size, 4096,
+					vram ? AMDGPU_GEM_DOMAIN_VRAM :
+					       AMDGPU_GEM_DOMAIN_GTT,
+					vram ? AMDGPU_GEM_CREATE_CPU_ACCESS_REQUIRED : 0,
+					&buf->va, &buf->va_handle);
+#endif
+		break;
+	}
+
+	return buf;
+}
+
+static int buf_export(struct buf *buf)
+{
+#ifdef HAVE_LIBDRM_AMDGPU
+	if (buf->gpu->driver == AMDGPU) {
+		uint32_t dmabuf;
+
+		igt_assert_eq(amdgpu_bo_export(buf->bo,
+					       amdgpu_bo_handle_type_dma_buf_fd,
+					       &dmabuf), 0);
+		return dmabuf;
+	}
+#endif
+
+	return prime_handle_to_fd(buf->gpu->fd, buf->handle);
+}
+
+static struct buf *buf_import(struct gpu *gpu, int dmabuf, uint64_t size)
+{
+	struct buf *buf = calloc(1, sizeof(*buf));
+
+	igt_assert(buf);
+	buf->gpu = gpu;
+	buf->size = size;
+
+#ifdef HAVE_LIBDRM_AMDGPU
+	if (gpu->driver == AMDGPU) {
+		struct amdgpu_bo_import_result res = {};
+
+		igt_assert_eq(amdgpu_bo_import(gpu->dev,
+					       amdgpu_bo_handle_type_dma_buf_fd,
+					       dmabuf, &res), 0);
+		buf->bo = res.buf_handle;
+		igt_assert_eq(amdgpu_va_range_alloc(gpu->dev,
+						    amdgpu_gpu_va_range_general,
+						    size, 4096, 0, &buf->va,
+						    &buf->va_handle, 0), 0);
+		igt_assert_eq(amdgpu_bo_va_op(buf->bo, 0, size, buf->va, 0,
+					      AMDGPU_VA_OP_MAP), 0);
+		return buf;
+	}
+#endif
+
+	/* Foreign memory is treated as system memory by the blitter */
+	buf->handle = prime_fd_to_handle(gpu->fd, dmabuf);
+	buf->region = gpu->sys_region;
+
+	return buf;
+}
+
+static void buf_free(struct buf *buf)
+{
+	struct gpu *gpu = buf->gpu;
+
+	switch (gpu->driver) {
+	case XE:
+		/* Unbinds it from the VM of the copies */
+		put_offset(gpu->ahnd, buf->handle);
+		intel_allocator_bind(gpu->ahnd, 0, 0);
+		/* fallthrough */
+	case I915:
+		gem_close(gpu->fd, buf->handle);
+		break;
+	case AMDGPU:
+#ifdef HAVE_LIBDRM_AMDGPU
+		gpu_mem_free(buf->bo, buf->va_handle, buf->va, buf->size);
+#endif
+		break;
+	}
+
+	free(buf);
+}
+
+static double bandwidth(struct gpu *gpu, struct buf *dst, struct buf *src,
+			uint64_t size)
+{
+	struct timespec start = {};
+
+	igt_nsec_elapsed(&start);
+	for (unsigned int n = 0; n < iterations; n++)
+		copy(gpu, dst, src, size);
+
+	/* Bytes per ns are GB/s */
+	return (double)size * iterations / igt_nsec_elapsed(&start);
+}
+
+static void copy_latency(struct gpu *gpu, struct buf *dst, struct buf *src,
+			 struct latency *l)
+{
+	igt_stats_t stats;
+
+	igt_stats_init_with_size(&stats, samples);
+	for (unsigned int n = 0; n < samples; n++) {
+		struct timespec start = {};
+
+		igt_nsec_elapsed(&start);
+		copy(gpu, dst, src, LATENCY_SIZE);
+		igt_stats_push_float(&stats, elapsed_us(&start));
+	}
+
+	l->copy_p50 = igt_stats_get_median(&stats);
+	l->copy_p99 = igt_stats_get_percentile(&stats, 99);
+	igt_stats_fini(&stats);
+}
+
+/* The dma-buf is idle, this is the overhead of the ioctls themselves */
+static void sync_file_latency(int dmabuf, struct latency *l)
+{
+	igt_stats_t export, import;
+	int sync_file;
+
+	if (__dmabuf_export_sync_file(dmabuf, DMA_BUF_SYNC_RW, &sync_file))
+		return;
+	close(sync_file);
+
+	igt_stats_init_with_size(&export, samples);
+	igt_stats_init_with_size(&import, samples);
+	for (unsigned int n = 0; n < samples; n++) {
+		struct timespec start = {};
+
+		igt_nsec_elapsed(&start);
+		sync_file = dmabuf_export_sync_file(dmabuf, DMA_BUF_SYNC_RW);
+		igt_stats_push_float(&export, elapsed_us(&start));
+
+		memset(&start, 0, sizeof(start));
+		igt_nsec_elapsed(&start);
+		dmabuf_import_sync_file(dmabuf, DMA_BUF_SYNC_WRITE, sync_file);
+		igt_stats_push_float(&import, elapsed_us(&start));
+
+		close(sync_file);
+	}
+
+	l->sync_file = true;
+	l->export_p50 = igt_stats_get_median(&export);
+	l->import_p50 = igt_stats_get_median(&import);
+	igt_stats_fini(&export);
+	igt_stats_fini(&import);
+}
+
+static void run_pair(unsigned int exporter, unsigned int importer, bool vram)
+{
+	struct gpu *a = &gpus[exporter], *b = &gpus[importer];
+	struct latency *l = &latencies[num_latencies++];
+	struct buf *remote, *imported, *local;
+	struct timespec start = {};
+	int dmabuf;
+
+	remote = buf_create(a, max_size, vram);
+	dmabuf = buf_export(remote);
+	imported = buf_import(b, dmabuf, max_size);
+	local = buf_create(b, max_size, b->has_vram);
+
+	l->exporter = exporter;
+	l->importer = importer;
+	l->vram = vram;
+
+	/* The first copy attaches the buffer, and maybe migrates it */
+	igt_nsec_elapsed(&start);
+	copy(b, local, imported, LATENCY_SIZE);
+	l->first = elapsed_us(&start);
+
+	for (uint64_t size = MIN_SIZE; ; size = min(4 * size, max_size)) {
+		double read, write;
+
+		read = bandwidth(b, local, imported, size);
+		write = bandwidth(b, imported, local, size);
+		printf("%u->%u %-6s %10" PRIu64 " %10.2f %10.2f\n",
+		       exporter, importer, vram ? "vram" : "system",
+		       size >> 10, read, write);
+
+		if (size == max_size)
+			break;
+	}
+
+	copy_latency(b, local, imported, l);
+	sync_file_latency(dmabuf, l);
+
+	buf_free(local);
+	buf_free(imported);
+	close(dmabuf);
+	buf_free(remote);
+}
+
+static void report_latencies(void)
+{
+	printf("\n%-4s %-6s %10s %10s %10s %10s %10s\n", "pair", "memory",
+	       "first (us)", "p50 (us)", "p99 (us)", "export", "import");
+
+	for (unsigned int n = 0; n < num_latencies; n++) {
+		struct latency *l = &latencies[n];
+
+		printf("%u->%u %-6s %10.1f %10.1f %10.1f", l->exporter,
+		       l->importer, l->vram ? "vram" : "system", l->first,
+		       l->copy_p50, l->copy_p99);
+		if (l->sync_file)
+			printf(" %10.2f %10.2f\n", l->export_p50, l->import_p50);
+		else
+			printf(" %10s %10s\n", "-", "-");
+	}
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"Usage: %s [options]\n"
+		"  -s <MiB>        Largest transfer size, sweeps powers of four from\n"
+		"                  64KiB up to it, 64 by default, 256 at most\n"
+		"  -n <copies>     Copies timed per transfer size, 8 by default\n"
+		"  -l <samples>    Samples of the latency distributions, 256 by default\n"
+		"Reports the read and write bandwidth of the importer in GB/s, then\n"
+		"the time of the first copy, which attaches the buffer, the p50/p99\n"
+		"latency of a %uB copy and the p50 cost of exporting and importing a\n"
+		"sync_file through the dma-buf, in us.\n",
+		name, LATENCY_SIZE);
+}
+
+int main(int argc, char **argv)
+{
+	int fd, c;
+
+	while ((c = getopt(argc, argv, "s:n:l:h")) != -1) {
+		switch (c) {
+		case 's':
+			max_size = clamp(atoi(optarg), 1, 256) * (1ull << 20);
+			break;
+		case 'n':
+			iterations = max(atoi(optarg), 1);
+			break;
+		case 'l':
+			samples = max(atoi(optarg), 1);
+			break;
+		default:
+			usage(argv[0]);
+			return c == 'h' ? 0 : 1;
+		}
+	}
+	igt_assert(max_size <= MAX_SIZE);
+
+	while (num_gpus < MAX_GPUS &&
+	       (fd = __drm_open_driver_another(num_gpus, DRIVERS)) >= 0)
+		gpu_init(&gpus[num_gpus++], fd);
+	igt_require_f(num_gpus >= 2, "Needs two GPUs\n");
+
+	for (unsigned int n = 0; n < num_gpus; n++)
+		printf("gpu%u: %s %s%s%s\n", n, driver_names[gpus[n].driver],
+		       gpus[n].slot, gpus[n].has_vram ? ", vram" : "",
+		       gpus[n].can_copy ? "" : ", no copy engine");
+
+	printf("\n%-4s %-6s %10s %10s %10s\n", "pair", "memory", "size (KiB)",
+	       "read GB/s", "write GB/s");
+
+	for (unsigned int a = 0; a < num_gpus; a++) {
+		for (unsigned int b = 0; b < num_gpus; b++) {
+			if (a == b || !gpus[b].can_copy)
+				continue;
+
+			if (gpus[a].has_vram)
+				run_pair(a, b, true);
+			run_pair(a, b, false);
+		}
+	}
+
+	report_latencies();
+
+	for (unsigned int n = 0; n < num_gpus; n++)
+		gpu_fini(&gpus[n]);
+
+	return 0;
+}
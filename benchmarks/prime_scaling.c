@@ -0,0 +1,404 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2025 Intel Corporation
+ */
+
+/*
+ * Measures how PRIME export, import and close, and the dma-buf sync_file
+ * export and import paths, scale with the number of threads hammering them
+ * and the number of devices importing, reporting the throughput of each
+ * workload and the tail latency of every step.
+ *
+ * All threads share the exporting drm fd, as the clients of a compositor
+ * share its device, while every thread imports into its own drm fd on each
+ * importing device, as separate clients would.
+ */
+
+#include <fcntl.h>
+#include <math.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#include "igt.h"
+#include "igt_bench.h"
+#include "igt_multigpu.h"
+#include "dmabuf_sync_file.h"
+
+#define MAX_DEVICES	8
+
+#define HIST_SUB_BITS	3
+#define HIST_BUCKETS	(64 << HIST_SUB_BITS)
+
+enum stage {
+	STAGE_EXPORT,
+	STAGE_IMPORT,
+	STAGE_CLOSE,
+	STAGE_SYNC_EXPORT,
+	STAGE_SYNC_IMPORT,
+	NUM_STAGES
+};
+
+static const char * const stage_names[NUM_STAGES] = {
+	[STAGE_EXPORT] = "export",
+	[STAGE_IMPORT] = "import",
+	[STAGE_CLOSE] = "close",
+	[STAGE_SYNC_EXPORT] = "sync-export",
+	[STAGE_SYNC_IMPORT] = "sync-import",
+};
+
+static const struct {
+	const char *name;
+	unsigned int chipset;
+} drivers[] = {
+	{ "any", DRIVER_ANY },
+	{ "i915", DRIVER_INTEL },
+	{ "xe", DRIVER_XE },
+	{ "vgem", DRIVER_VGEM },
+	{ "amdgpu", DRIVER_AMDGPU },
+};
+
+struct prime {
+	struct igt_bench bench;
+
+	unsigned int exporter_chipset;
+	unsigned int importer_chipset;
+	unsigned int num_devices;
+	unsigned int num_objects;
+	unsigned int size;
+
+	int exporter;
+	int devices[MAX_DEVICES];
+	uint32_t *handles;
+	/* [thread][device], each thread imports through its own drm fds */
+	int *importers;
+	/* One dma-buf per thread for the sync_file workload */
+	int *dmabufs;
+
+	/* [thread][stage][bucket], shared with the forked threads */
+	uint64_t *hist;
+	size_t hist_size;
+};
+
+static unsigned int hist_bucket(uint64_t ns)
+{
+	unsigned int msb;
+
+	if (ns < 1 << HIST_SUB_BITS)
+		return ns;
+
+	/* Log2 buckets split in 1 << HIST_SUB_BITS linear steps */
+	msb = igt_fls(ns) - 1;
+	return (msb - HIST_SUB_BITS + 1) << HIST_SUB_BITS |
+	       ((ns >> (msb - HIST_SUB_BITS)) & ((1 << HIST_SUB_BITS) - 1));
+}
+
+static uint64_t hist_value(unsigned int bucket)
+{
+	unsigned int shift = bucket >> HIST_SUB_BITS;
+	uint64_t sub = bucket & ((1 << HIST_SUB_BITS) - 1);
+
+	if (!shift)
+		return sub;
+
+	return (sub | 1 << HIST_SUB_BITS) << (shift - 1);
+}
+
+static uint64_t *thread_hist(struct prime *p, unsigned int thread,
+			     enum stage stage)
+{
+	return p->hist + ((size_t)thread * NUM_STAGES + stage) * HIST_BUCKETS;
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static void record(struct prime *p, unsigned int thread, enum stage stage,
+		   uint64_t start)
+{
+	thread_hist(p, thread, stage)[hist_bucket(now_ns() - start)]++;
+}
+
+static void prime_cycle(void *data, unsigned int thread, unsigned long count)
+{
+	struct prime *p = data;
+	int *importers = p->importers + thread * p->num_devices;
+	uint32_t imported[MAX_DEVICES];
+	unsigned int obj = thread;
+
+	while (count--) {
+		uint64_t start;
+		int dmabuf;
+
+		obj = (obj + 1) % p->num_objects;
+
+		start = now_ns();
+		dmabuf = prime_handle_to_fd(p->exporter, p->handles[obj]);
+		record(p, thread, STAGE_EXPORT, start);
+
+		for (unsigned int n = 0; n < p->num_devices; n++) {
+			start = now_ns();
+			imported[n] = prime_fd_to_handle(importers[n], dmabuf);
+			record(p, thread, STAGE_IMPORT, start);
+		}
+
+		start = now_ns();
+		for (unsigned int n = 0; n < p->num_devices; n++)
+			gem_close(importers[n], imported[n]);
+		close(dmabuf);
+		record(p, thread, STAGE_CLOSE, start);
+	}
+}
+
+static void sync_file_cycle(void *data, unsigned int thread,
+			    unsigned long count)
+{
+	struct prime *p = data;
+	int dmabuf = p->dmabufs[thread];
+
+	while (count--) {
+		uint64_t start;
+		int sync_file;
+
+		start = now_ns();
+		sync_file = dmabuf_export_sync_file(dmabuf, DMA_BUF_SYNC_RW);
+		record(p, thread, STAGE_SYNC_EXPORT, start);
+
+		start = now_ns();
+		dmabuf_import_sync_file(dmabuf, DMA_BUF_SYNC_WRITE, sync_file);
+		record(p, thread, STAGE_SYNC_IMPORT, start);
+
+		close(sync_file);
+	}
+}
+
+static uint64_t percentile(const uint64_t *hist, uint64_t total, double pct)
+{
+	uint64_t target = ceil(total * pct / 100), sum = 0;
+
+	for (unsigned int b = 0; b < HIST_BUCKETS; b++) {
+		sum += hist[b];
+		if (sum >= target && sum)
+			return hist_value(b);
+	}
+
+	return 0;
+}
+
+static void report(struct prime *p, const char *workload, unsigned int threads,
+		   const struct igt_bench_result *result,
+		   enum stage first, enum stage last)
+{
+	printf("%-9s %7u %7u %12.0f %10.0f", workload, threads, p->num_devices,
+	       result->mean, result->ci95);
+
+	for (enum stage s = first; s <= last; s++) {
+		uint64_t hist[HIST_BUCKETS] = {}, total = 0;
+
+		for (unsigned int t = 0; t < threads; t++) {
+			const uint64_t *h = thread_hist(p, t, s);
+
+			for (unsigned int b = 0; b < HIST_BUCKETS; b++) {
+				hist[b] += h[b];
+				total += h[b];
+			}
+		}
+
+		printf("  %s p50/p99/p99.9 %.1f/%.1f/%.1fus", stage_names[s],
+		       percentile(hist, total, 50) / 1e3,
+		       percentile(hist, total, 99) / 1e3,
+		       percentile(hist, total, 99.9) / 1e3);
+	}
+	printf("\n");
+	fflush(stdout);
+}
+
+static void run(struct prime *p, const char *workload, igt_bench_fn fn,
+		unsigned int threads, enum stage first, enum stage last)
+{
+	struct igt_bench_result result;
+	char label[64];
+
+	snprintf(label, sizeof(label), "%s,threads=%u,devices=%u",
+		 workload, threads, p->num_devices);
+
+	/* The histograms cover the calibration and warmup too */
+	memset(p->hist, 0, p->hist_size);
+	p->bench.opts.threads = threads;
+	igt_bench_run(&p->bench, label, fn, p, &result);
+	report(p, workload, threads, &result, first, last);
+	igt_bench_result_fini(&result);
+}
+
+static int reopen(int fd)
+{
+	char path[32];
+	int ret;
+
+	/* A new open file, so a new drm client on the same device */
+	snprintf(path, sizeof(path), "/proc/self/fd/%d", fd);
+	ret = open(path, O_RDWR | O_CLOEXEC);
+	igt_assert_fd(ret);
+
+	return ret;
+}
+
+static int parse_driver(const char *name, unsigned int *chipset)
+{
+	for (int i = 0; i < ARRAY_SIZE(drivers); i++) {
+		if (!strcmp(name, drivers[i].name)) {
+			*chipset = drivers[i].chipset;
+			return 0;
+		}
+	}
+
+	fprintf(stderr, "Unknown driver '%s'\n", name);
+	return -1;
+}
+
+static int opt_handler(int opt, int opt_index, void *data)
+{
+	struct prime *p = data;
+
+	switch (opt) {
+	case 'e':
+		if (parse_driver(optarg, &p->exporter_chipset))
+			return IGT_OPT_HANDLER_ERROR;
+		break;
+	case 'i':
+		if (parse_driver(optarg, &p->importer_chipset))
+			return IGT_OPT_HANDLER_ERROR;
+		break;
+	case 'm':
+		p->num_devices = clamp(atoi(optarg), 1, MAX_DEVICES);
+		break;
+	case 'n':
+		p->num_objects = max(atoi(optarg), 1);
+		break;
+	case 's':
+		p->size = ALIGN(max(atoi(optarg), 1), 4096);
+		break;
+	default:
+		return IGT_OPT_HANDLER_ERROR;
+	}
+
+	return IGT_OPT_HANDLER_SUCCESS;
+}
+
+static const char help_str[] =
+	"  -e <driver>       Exporting driver: any,i915,xe,vgem,amdgpu (default any).\n"
+	"  -i <driver>       Importing driver (default the exporting one).\n"
+	"  -m <n>            Number of importing devices (default 1).\n"
+	"  -n <n>            Number of exported objects (default 64).\n"
+	"  -s <bytes>        Object size (default 4096).\n"
+	"\n"
+	"The thread count is scaled in powers of two up to --threads. Each\n"
+	"prime cycle exports an object, imports it into every device and closes\n"
+	"it all again; each sync_file cycle exports the fences of a dma-buf as\n"
+	"a sync_file and imports it back as a write fence.\n";
+
+int main(int argc, char **argv)
+{
+	struct prime p = {
+		.exporter_chipset = DRIVER_ANY,
+		.importer_chipset = 0,
+		.num_devices = 1,
+		.num_objects = 64,
+		.size = 4096,
+	};
+	unsigned int max_threads, threads;
+	int sync_file, available;
+	bool has_sync_file;
+
+	igt_bench_init(&p.bench, "prime_scaling");
+	p.bench.opts.duration = 1;
+	igt_bench_parse_opts(&p.bench, argc, argv, "e:i:m:n:s:", help_str,
+			     opt_handler, &p);
+	max_threads = p.bench.opts.threads;
+	if (!p.importer_chipset)
+		p.importer_chipset = p.exporter_chipset;
+
+	p.exporter = __drm_open_driver_another(0, p.exporter_chipset);
+	igt_require_f(p.exporter >= 0, "No exporting device\n");
+	igt_bench_set_device(&p.bench, p.exporter);
+
+	available = igt_multigpu_count_class(p.importer_chipset);
+	igt_require_f(available, "No importing device\n");
+	if (p.num_devices > available) {
+		igt_warn("Only %d importing devices, using those\n", available);
+		p.num_devices = available;
+	}
+
+	p.handles = calloc(p.num_objects, sizeof(*p.handles));
+	for (unsigned int n = 0; n < p.num_objects; n++) {
+		unsigned int stride;
+		uint64_t size;
+
+		p.handles[n] = kmstest_dumb_create(p.exporter, 1024,
+						   p.size / 4096, 32,
+						   &stride, &size);
+	}
+
+	for (unsigned int n = 0; n < p.num_devices; n++) {
+		p.devices[n] = __drm_open_driver_another(n, p.importer_chipset);
+		igt_assert_fd(p.devices[n]);
+	}
+
+	p.importers = calloc(max_threads * p.num_devices, sizeof(*p.importers));
+	p.dmabufs = calloc(max_threads, sizeof(*p.dmabufs));
+	for (unsigned int t = 0; t < max_threads; t++) {
+		for (unsigned int n = 0; n < p.num_devices; n++)
+			p.importers[t * p.num_devices + n] = reopen(p.devices[n]);
+
+		p.dmabufs[t] = prime_handle_to_fd(p.exporter,
+						  p.handles[t % p.num_objects]);
+	}
+
+	has_sync_file = !__dmabuf_export_sync_file(p.dmabufs[0],
+						   DMA_BUF_SYNC_RW, &sync_file);
+	if (has_sync_file)
+		close(sync_file);
+
+	p.hist_size = ALIGN((size_t)max_threads * NUM_STAGES * HIST_BUCKETS *
+			    sizeof(*p.hist), 4096);
+	p.hist = mmap(NULL, p.hist_size, PROT_READ | PROT_WRITE,
+		      MAP_SHARED | MAP_ANON, -1, 0);
+	igt_assert(p.hist != MAP_FAILED);
+
+	printf("%-9s %7s %7s %12s %10s  latencies\n",
+	       "workload", "threads", "devices", "ops/s", "ci95");
+
+	for (threads = 1; ; threads = min(2 * threads, max_threads)) {
+		run(&p, "prime", prime_cycle, threads,
+		    STAGE_EXPORT, STAGE_CLOSE);
+		if (has_sync_file)
+			run(&p, "sync_file", sync_file_cycle, threads,
+			    STAGE_SYNC_EXPORT, STAGE_SYNC_IMPORT);
+
+		if (threads == max_threads)
+			break;
+	}
+
+	igt_bench_fini(&p.bench);
+
+	munmap(p.hist, p.hist_size);
+	for (unsigned int t = 0; t < max_threads; t++) {
+		close(p.dmabufs[t]);
+		for (unsigned int n = 0; n < p.num_devices; n++)
+			close(p.importers[t * p.num_devices + n]);
+	}
+	for (unsigned int n = 0; n < p.num_devices; n++)
+		drm_close_driver(p.devices[n]);
+	for (unsigned int n = 0; n < p.num_objects; n++)
+		kmstest_dumb_destroy(p.exporter, p.handles[n]);
+	drm_close_driver(p.exporter);
+	free(p.dmabufs);
+	free(p.importers);
+	free(p.handles);
+
+	return 0;
+}
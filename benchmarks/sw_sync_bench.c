@@ -0,0 +1,474 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2025 Intel Corporation
+ */
+
+/*
+ * Measures how the dma-fence core scales with the number of fences, using
+ * sw_sync timelines so the fences are signaled from the CPU:
+ *
+ *  - fan-in: the cost of merging 2 to 4096 fences, each from its own
+ *    timeline, into a single sync_file, folding them one at a time into a
+ *    growing fence or pairwise as a balanced tree of merged fences,
+ *  - waiting on as many fences: the cost of a poll() over all of them while
+ *    they are pending, and the latency from signaling them to a waiter
+ *    seeing all of them signaled, polling them all or waiting on their
+ *    merged fence,
+ *  - fan-out: the latency from signaling a single fence to each of 1 to
+ *    256 waiter threads blocked on it waking up.
+ */
+
+#include <getopt.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/resource.h>
+
+#include "igt.h"
+#include "igt_stats.h"
+#include "sw_sync.h"
+
+#define MAX_FENCES	4096
+#define MAX_WAITERS	256
+
+struct sw_sync_bench {
+	unsigned int reps;
+	unsigned int max_fences;
+	unsigned int max_waiters;
+	unsigned int delay_us;
+
+	int timelines[MAX_FENCES];
+	uint32_t seqno[MAX_FENCES];
+
+	/* Fan-out and signal to ready rounds */
+	pthread_barrier_t start, end;
+	int fence;
+	int *fences;
+	unsigned int count;
+	uint64_t signal_ns;
+};
+
+struct waiter {
+	struct sw_sync_bench *b;
+	pthread_t thread;
+	igt_stats_t *stats;
+	bool merged;
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static double elapsed_us(uint64_t start)
+{
+	return (now_ns() - start) * 1e-3;
+}
+
+static void print_row(const char *name, unsigned int count, igt_stats_t *stats)
+{
+	printf("%-12s %6u %10.1f %10.1f %10.1f %10.1f\n", name, count,
+	       igt_stats_get_percentile(stats, 0),
+	       igt_stats_get_median(stats),
+	       igt_stats_get_percentile(stats, 99),
+	       igt_stats_get_percentile(stats, 100));
+}
+
+/*
+ * A pending fence on each of the first @count timelines, at the point the
+ * next signal_fences() of the same timelines moves them to.
+ */
+static void create_fences(struct sw_sync_bench *b, int *fences,
+			  unsigned int count)
+{
+	for (unsigned int n = 0; n < count; n++)
+		fences[n] = sw_sync_timeline_create_fence(b->timelines[n],
+							  ++b->seqno[n]);
+}
+
+static void signal_fences(struct sw_sync_bench *b, unsigned int count)
+{
+	for (unsigned int n = 0; n < count; n++)
+		sw_sync_timeline_inc(b->timelines[n], 1);
+}
+
+static void close_fences(int *fences, unsigned int count)
+{
+	for (unsigned int n = 0; n < count; n++)
+		close(fences[n]);
+}
+
+/* Folds the fences one at a time into the merged fence */
+static int merge_chain(const int *fences, unsigned int count)
+{
+	int merged = dup(fences[0]);
+
+	for (unsigned int n = 1; n < count; n++) {
+		int tmp = sync_fence_merge(merged, fences[n]);
+
+		close(merged);
+		merged = tmp;
+	}
+
+	return merged;
+}
+
+/* Merges the fences pairwise, then the merged pairs, up to a single one */
+static int merge_tree(const int *fences, unsigned int count)
+{
+	int *level = malloc(count * sizeof(*level));
+	bool owned = false;
+	int merged;
+
+	memcpy(level, fences, count * sizeof(*level));
+
+	while (count > 1) {
+		unsigned int n;
+
+		for (n = 0; n < count / 2; n++) {
+			merged = sync_fence_merge(level[2 * n], level[2 * n + 1]);
+			if (owned) {
+				close(level[2 * n]);
+				close(level[2 * n + 1]);
+			}
+			level[n] = merged;
+		}
+
+		if (count & 1) {
+			level[n] = owned ? level[count - 1] : dup(level[count - 1]);
+			n++;
+		}
+
+		count = n;
+		owned = true;
+	}
+
+	merged = owned ? level[0] : dup(level[0]);
+	free(level);
+
+	return merged;
+}
+
+static void fan_in(struct sw_sync_bench *b, unsigned int count)
+{
+	int fences[MAX_FENCES];
+	igt_stats_t chain, tree;
+
+	igt_stats_init_with_size(&chain, b->reps);
+	igt_stats_init_with_size(&tree, b->reps);
+
+	for (unsigned int rep = 0; rep < b->reps; rep++) {
+		uint64_t start;
+		int merged;
+
+		create_fences(b, fences, count);
+
+		start = now_ns();
+		merged = merge_chain(fences, count);
+		igt_stats_push_float(&chain, elapsed_us(start));
+		igt_assert_eq(sync_fence_count(merged), count);
+		close(merged);
+
+		start = now_ns();
+		merged = merge_tree(fences, count);
+		igt_stats_push_float(&tree, elapsed_us(start));
+		igt_assert_eq(sync_fence_count(merged), count);
+		close(merged);
+
+		signal_fences(b, count);
+		close_fences(fences, count);
+	}
+
+	print_row("merge-chain", count, &chain);
+	print_row("merge-tree", count, &tree);
+
+	igt_stats_fini(&tree);
+	igt_stats_fini(&chain);
+}
+
+/* Polls the fences until all of them are signaled */
+static void poll_all(int *fences, unsigned int count)
+{
+	struct pollfd *pfd = calloc(count, sizeof(*pfd));
+	unsigned int pending = count;
+
+	for (unsigned int n = 0; n < count; n++) {
+		pfd[n].fd = fences[n];
+		pfd[n].events = POLLIN;
+	}
+
+	while (pending) {
+		igt_assert_lt(0, poll(pfd, count, -1));
+
+		for (unsigned int n = 0; n < count; n++) {
+			if (!pfd[n].revents)
+				continue;
+
+			igt_assert(!(pfd[n].revents & (POLLERR | POLLNVAL)));
+			/* Negative fds are skipped by the next polls */
+			pfd[n].fd = -1;
+			pending--;
+		}
+	}
+
+	free(pfd);
+}
+
+static void *ready_thread(void *data)
+{
+	struct waiter *w = data;
+	struct sw_sync_bench *b = w->b;
+
+	pthread_barrier_wait(&b->start);
+
+	if (w->merged)
+		igt_assert_eq(sync_fence_wait(b->fence, -1), 0);
+	else
+		poll_all(b->fences, b->count);
+
+	igt_stats_push_float(w->stats,
+			     elapsed_us(__atomic_load_n(&b->signal_ns,
+							__ATOMIC_ACQUIRE)));
+
+	return NULL;
+}
+
+/* Signals all the fences with a waiter blocked on them */
+static void signal_to_ready(struct sw_sync_bench *b, int *fences,
+			    unsigned int count, bool merged,
+			    igt_stats_t *stats)
+{
+	struct waiter w = {
+		.b = b,
+		.stats = stats,
+		.merged = merged,
+	};
+
+	b->fences = fences;
+	b->count = count;
+	b->fence = merged ? merge_tree(fences, count) : -1;
+
+	pthread_barrier_init(&b->start, NULL, 2);
+	igt_assert_eq(pthread_create(&w.thread, NULL, ready_thread, &w), 0);
+	pthread_barrier_wait(&b->start);
+
+	/* Lets the waiter block before the signal */
+	usleep(b->delay_us);
+	__atomic_store_n(&b->signal_ns, now_ns(), __ATOMIC_RELEASE);
+	signal_fences(b, count);
+
+	pthread_join(w.thread, NULL);
+	pthread_barrier_destroy(&b->start);
+
+	if (merged)
+		close(b->fence);
+}
+
+static void wait_many(struct sw_sync_bench *b, unsigned int count)
+{
+	int fences[MAX_FENCES];
+	igt_stats_t scan, poll_ready, merged_ready;
+	struct pollfd *pfd = calloc(count, sizeof(*pfd));
+
+	igt_stats_init_with_size(&scan, b->reps);
+	igt_stats_init_with_size(&poll_ready, b->reps);
+	igt_stats_init_with_size(&merged_ready, b->reps);
+
+	for (unsigned int rep = 0; rep < b->reps; rep++) {
+		uint64_t start;
+
+		create_fences(b, fences, count);
+
+		/* Adds and removes a callback on each pending fence */
+		for (unsigned int n = 0; n < count; n++) {
+			pfd[n].fd = fences[n];
+			pfd[n].events = POLLIN;
+		}
+		start = now_ns();
+		igt_assert_eq(poll(pfd, count, 0), 0);
+		igt_stats_push_float(&scan, elapsed_us(start));
+
+		signal_to_ready(b, fences, count, false, &poll_ready);
+		close_fences(fences, count);
+
+		create_fences(b, fences, count);
+		signal_to_ready(b, fences, count, true, &merged_ready);
+		close_fences(fences, count);
+	}
+
+	print_row("poll-scan", count, &scan);
+	print_row("poll-ready", count, &poll_ready);
+	print_row("merged-ready", count, &merged_ready);
+
+	igt_stats_fini(&merged_ready);
+	igt_stats_fini(&poll_ready);
+	igt_stats_fini(&scan);
+	free(pfd);
+}
+
+static void *fan_out_thread(void *data)
+{
+	struct waiter *w = data;
+	struct sw_sync_bench *b = w->b;
+
+	for (unsigned int rep = 0; rep < b->reps; rep++) {
+		pthread_barrier_wait(&b->start);
+
+		igt_assert_eq(sync_fence_wait(b->fence, -1), 0);
+		igt_stats_push_float(w->stats,
+				     elapsed_us(__atomic_load_n(&b->signal_ns,
+								__ATOMIC_ACQUIRE)));
+
+		pthread_barrier_wait(&b->end);
+	}
+
+	return NULL;
+}
+
+static void fan_out(struct sw_sync_bench *b, unsigned int num_waiters)
+{
+	struct waiter *waiters = calloc(num_waiters, sizeof(*waiters));
+	igt_stats_t *stats = calloc(num_waiters, sizeof(*stats));
+	igt_stats_t all;
+
+	pthread_barrier_init(&b->start, NULL, num_waiters + 1);
+	pthread_barrier_init(&b->end, NULL, num_waiters + 1);
+
+	for (unsigned int n = 0; n < num_waiters; n++) {
+		igt_stats_init_with_size(&stats[n], b->reps);
+		waiters[n].b = b;
+		waiters[n].stats = &stats[n];
+		igt_assert_eq(pthread_create(&waiters[n].thread, NULL,
+					     fan_out_thread, &waiters[n]), 0);
+	}
+
+	for (unsigned int rep = 0; rep < b->reps; rep++) {
+		create_fences(b, &b->fence, 1);
+		pthread_barrier_wait(&b->start);
+
+		usleep(b->delay_us);
+		__atomic_store_n(&b->signal_ns, now_ns(), __ATOMIC_RELEASE);
+		signal_fences(b, 1);
+
+		pthread_barrier_wait(&b->end);
+		close(b->fence);
+	}
+
+	/* The waiters each push to their own stats, gather them once done */
+	igt_stats_init_with_size(&all, b->reps * num_waiters);
+	for (unsigned int n = 0; n < num_waiters; n++) {
+		pthread_join(waiters[n].thread, NULL);
+		for (unsigned int i = 0; i < stats[n].n_values; i++)
+			igt_stats_push_float(&all, stats[n].values_f[i]);
+		igt_stats_fini(&stats[n]);
+	}
+
+	print_row("fan-out", num_waiters, &all);
+
+	igt_stats_fini(&all);
+	pthread_barrier_destroy(&b->end);
+	pthread_barrier_destroy(&b->start);
+	free(stats);
+	free(waiters);
+}
+
+/* Each fence takes a timeline and a sync_file, leave room for those */
+static unsigned int max_open_fences(unsigned int count)
+{
+	struct rlimit rlim;
+
+	if (getrlimit(RLIMIT_NOFILE, &rlim) || rlim.rlim_cur == RLIM_INFINITY)
+		return count;
+
+	if (rlim.rlim_cur < rlim.rlim_max) {
+		rlim.rlim_cur = rlim.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &rlim);
+		getrlimit(RLIMIT_NOFILE, &rlim);
+	}
+
+	return min_t(uint64_t, count, (rlim.rlim_cur - 64) / 3);
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"Usage: %s [options]\n"
+		"  -r <reps>       Samples per row, 32 by default\n"
+		"  -n <fences>     Largest number of fences, 4096 by default\n"
+		"  -w <waiters>    Largest number of fan-out waiters, 256 by default\n"
+		"  -d <us>         Delay between the waiters starting and the\n"
+		"                  signal, so they are blocked by then, 100 by default\n"
+		"Reports the distribution of each measurement in us, for counts of\n"
+		"fences or waiters growing by powers of four.\n",
+		name);
+}
+
+int main(int argc, char **argv)
+{
+	struct sw_sync_bench b = {
+		.reps = 32,
+		.max_fences = MAX_FENCES,
+		.max_waiters = MAX_WAITERS,
+		.delay_us = 100,
+	};
+	unsigned int count;
+	int c;
+
+	while ((c = getopt(argc, argv, "r:n:w:d:h")) != -1) {
+		switch (c) {
+		case 'r':
+			b.reps = max(atoi(optarg), 1);
+			break;
+		case 'n':
+			b.max_fences = clamp(atoi(optarg), 2, MAX_FENCES);
+			break;
+		case 'w':
+			b.max_waiters = clamp(atoi(optarg), 1, MAX_WAITERS);
+			break;
+		case 'd':
+			b.delay_us = max(atoi(optarg), 0);
+			break;
+		default:
+			usage(argv[0]);
+			return c == 'h' ? 0 : 1;
+		}
+	}
+
+	igt_require_sw_sync();
+
+	/* The poll and the merges keep every fence open at once */
+	b.max_fences = max_open_fences(b.max_fences);
+	igt_require(b.max_fences >= 2);
+
+	for (unsigned int n = 0; n < b.max_fences; n++)
+		b.timelines[n] = sw_sync_timeline_create();
+
+	printf("%-12s %6s %10s %10s %10s %10s\n", "(us)", "count",
+	       "min", "p50", "p99", "max");
+
+	for (count = 2; ; count = min(4 * count, b.max_fences)) {
+		fan_in(&b, count);
+		if (count == b.max_fences)
+			break;
+	}
+
+	for (count = 1; ; count = min(4 * count, b.max_fences)) {
+		wait_many(&b, count);
+		if (count == b.max_fences)
+			break;
+	}
+
+	for (count = 1; ; count = min(4 * count, b.max_waiters)) {
+		fan_out(&b, count);
+		if (count == b.max_waiters)
+			break;
+	}
+
+	for (unsigned int n = 0; n < b.max_fences; n++)
+		close(b.timelines[n]);
+
+	return 0;
+}
@@ -0,0 +1,380 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2025 Intel Corporation
+ */
+
+/*
+ * Measures the CPU side of timeline syncobjs, as used by the Vulkan
+ * drivers for their timeline semaphores:
+ *
+ *  - signal to wake latency of waiter threads blocked in a timeline wait,
+ *    waiting for all or any of 1 to 1024 syncobjs,
+ *  - signal to wake latency of waiter threads blocked on an eventfd
+ *    registered with DRM_IOCTL_SYNCOBJ_EVENTFD,
+ *  - throughput of the transfers between timeline and binary syncobjs,
+ *    with a number of processes transferring concurrently.
+ *
+ * The syncobjs are signaled from the CPU, so the latencies are those of the
+ * wait queues and of the wake up, not of any fence from a GPU.
+ */
+
+#include <pthread.h>
+#include <sys/eventfd.h>
+
+#include "igt.h"
+#include "igt_bench.h"
+#include "igt_syncobj.h"
+
+#define MAX_SYNCOBJS	1024
+#define MAX_WAITERS	64
+#define MAX_THREADS	64
+
+enum mode {
+	WAIT_ALL,
+	WAIT_ANY,
+	EVENTFD,
+};
+
+static const char * const mode_names[] = {
+	[WAIT_ALL] = "wait-all",
+	[WAIT_ANY] = "wait-any",
+	[EVENTFD] = "eventfd",
+};
+
+struct syncobj_bench;
+
+struct waiter {
+	struct syncobj_bench *b;
+	pthread_t thread;
+	int eventfd;
+	double *samples;
+};
+
+struct syncobj_bench {
+	struct igt_bench bench;
+
+	int fd;
+	uint32_t handles[MAX_SYNCOBJS];
+	unsigned int count;
+	enum mode mode;
+
+	struct waiter waiters[MAX_WAITERS];
+	unsigned int num_waiters;
+	pthread_barrier_t start, end;
+	unsigned int round;
+	uint64_t point;
+	uint64_t signal_ns;
+
+	/* Per process timeline, binary and destination timeline syncobjs */
+	uint32_t transfer[MAX_THREADS][3];
+
+	unsigned int rounds;
+	unsigned int max_waiters;
+	unsigned int delay_us;
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static void wait_point(struct waiter *w, uint64_t point)
+{
+	struct syncobj_bench *b = w->b;
+	uint64_t points[MAX_SYNCOBJS];
+	uint64_t value;
+
+	switch (b->mode) {
+	case WAIT_ALL:
+	case WAIT_ANY:
+		for (unsigned int n = 0; n < b->count; n++)
+			points[n] = point;
+		igt_assert(syncobj_timeline_wait(b->fd, b->handles, points,
+						 b->count, INT64_MAX,
+						 DRM_SYNCOBJ_WAIT_FLAGS_WAIT_FOR_SUBMIT |
+						 (b->mode == WAIT_ALL ?
+						  DRM_SYNCOBJ_WAIT_FLAGS_WAIT_ALL : 0),
+						 NULL));
+		break;
+	case EVENTFD:
+		igt_assert_eq(read(w->eventfd, &value, sizeof(value)),
+			      sizeof(value));
+		break;
+	}
+}
+
+static void *waiter_thread(void *data)
+{
+	struct waiter *w = data;
+	struct syncobj_bench *b = w->b;
+
+	for (unsigned int round = 0; round < b->rounds; round++) {
+		uint64_t point;
+
+		pthread_barrier_wait(&b->start);
+		point = b->point;
+
+		if (b->mode == EVENTFD)
+			syncobj_eventfd(b->fd, b->handles[0], point, 0,
+					w->eventfd);
+
+		wait_point(w, point);
+		w->samples[round] = (now_ns() -
+				     __atomic_load_n(&b->signal_ns,
+						     __ATOMIC_ACQUIRE)) * 1e-3;
+
+		pthread_barrier_wait(&b->end);
+	}
+
+	return NULL;
+}
+
+/* Signals the syncobjs the waiters wait on, the last one for wait-any */
+static void signal_point(struct syncobj_bench *b, uint64_t point)
+{
+	uint64_t points[MAX_SYNCOBJS];
+	unsigned int first = 0;
+
+	if (b->mode == WAIT_ANY)
+		first = b->count - 1;
+
+	for (unsigned int n = first; n < b->count; n++)
+		points[n] = point;
+
+	__atomic_store_n(&b->signal_ns, now_ns(), __ATOMIC_RELEASE);
+	syncobj_timeline_signal(b->fd, b->handles + first, points + first,
+				b->count - first);
+}
+
+static void print_row(struct syncobj_bench *b, igt_stats_t *stats)
+{
+	printf("%-9s %5u %7u %9.1f %9.1f %9.1f %9.1f %9.1f\n",
+	       mode_names[b->mode], b->count, b->num_waiters,
+	       igt_stats_get_percentile(stats, 0),
+	       igt_stats_get_median(stats),
+	       igt_stats_get_percentile(stats, 99),
+	       igt_stats_get_percentile(stats, 99.9),
+	       igt_stats_get_percentile(stats, 100));
+}
+
+static void run_latency(struct syncobj_bench *b)
+{
+	igt_stats_t stats;
+
+	pthread_barrier_init(&b->start, NULL, b->num_waiters + 1);
+	pthread_barrier_init(&b->end, NULL, b->num_waiters + 1);
+
+	for (unsigned int n = 0; n < b->num_waiters; n++) {
+		struct waiter *w = &b->waiters[n];
+
+		w->b = b;
+		w->samples = calloc(b->rounds, sizeof(*w->samples));
+		if (b->mode == EVENTFD) {
+			w->eventfd = eventfd(0, EFD_CLOEXEC);
+			igt_assert_lte(0, w->eventfd);
+		}
+		igt_assert_eq(pthread_create(&w->thread, NULL, waiter_thread,
+					     w), 0);
+	}
+
+	for (unsigned int round = 0; round < b->rounds; round++) {
+		b->point++;
+		pthread_barrier_wait(&b->start);
+
+		/* Lets the waiters block before the signal */
+		usleep(b->delay_us);
+		signal_point(b, b->point);
+
+		pthread_barrier_wait(&b->end);
+	}
+
+	igt_stats_init_with_size(&stats, b->rounds * b->num_waiters);
+	for (unsigned int n = 0; n < b->num_waiters; n++) {
+		struct waiter *w = &b->waiters[n];
+
+		pthread_join(w->thread, NULL);
+		for (unsigned int round = 0; round < b->rounds; round++)
+			igt_stats_push_float(&stats, w->samples[round]);
+		free(w->samples);
+		if (b->mode == EVENTFD)
+			close(w->eventfd);
+	}
+
+	print_row(b, &stats);
+
+	igt_stats_fini(&stats);
+	pthread_barrier_destroy(&b->end);
+	pthread_barrier_destroy(&b->start);
+}
+
+/*
+ * Each operation signals a new point, moves its fence into a binary
+ * syncobj, back onto another timeline and over to the next point of that
+ * one, which is the chain a driver goes through when a binary and a
+ * timeline semaphore import each other's payload.
+ */
+static void transfer(void *data, unsigned int thread, unsigned long count)
+{
+	struct syncobj_bench *b = data;
+	uint32_t *h = b->transfer[thread];
+	uint64_t src, dst;
+
+	/* Children start over from the parent's copy, find where we are */
+	syncobj_timeline_query(b->fd, &h[0], &src, 1);
+	syncobj_timeline_query(b->fd, &h[2], &dst, 1);
+
+	while (count--) {
+		src++;
+		dst += 2;
+
+		syncobj_timeline_signal(b->fd, &h[0], &src, 1);
+		syncobj_timeline_to_binary(b->fd, h[1], h[0], src, 0);
+		syncobj_binary_to_timeline(b->fd, h[2], dst - 1, h[1]);
+		syncobj_timeline_to_timeline(b->fd, h[2], dst, h[2], dst - 1);
+	}
+}
+
+static void run_transfer(struct syncobj_bench *b)
+{
+	struct igt_bench_result result;
+	char label[64];
+
+	for (unsigned int n = 0; n < b->bench.opts.threads; n++)
+		for (unsigned int i = 0; i < 3; i++)
+			b->transfer[n][i] = syncobj_create(b->fd, 0);
+
+	snprintf(label, sizeof(label), "mode=transfer,threads=%u",
+		 b->bench.opts.threads);
+	igt_bench_run(&b->bench, label, transfer, b, &result);
+
+	printf("%-9s %7u %12.0f %10.0f %10.0f %10.0f\n",
+	       "transfer", b->bench.opts.threads, result.mean, result.ci95,
+	       result.min, result.max);
+
+	igt_bench_result_fini(&result);
+
+	for (unsigned int n = 0; n < b->bench.opts.threads; n++)
+		for (unsigned int i = 0; i < 3; i++)
+			syncobj_destroy(b->fd, b->transfer[n][i]);
+}
+
+static bool has_syncobj_timeline(int fd)
+{
+	uint64_t value;
+
+	return !drmGetCap(fd, DRM_CAP_SYNCOBJ_TIMELINE, &value) && value;
+}
+
+static bool has_syncobj_eventfd(int fd)
+{
+	uint32_t handle = syncobj_create(fd, 0);
+	int ev_fd = eventfd(0, EFD_CLOEXEC);
+	int ret;
+
+	ret = __syncobj_eventfd(fd, handle, 1, 0, ev_fd);
+
+	close(ev_fd);
+	syncobj_destroy(fd, handle);
+
+	return ret == 0;
+}
+
+static int opt_handler(int opt, int opt_index, void *data)
+{
+	struct syncobj_bench *b = data;
+
+	switch (opt) {
+	case 'r':
+		b->rounds = max(atoi(optarg), 1);
+		break;
+	case 'w':
+		b->max_waiters = clamp(atoi(optarg), 1, MAX_WAITERS);
+		break;
+	case 'd':
+		b->delay_us = max(atoi(optarg), 0);
+		break;
+	default:
+		return IGT_OPT_HANDLER_ERROR;
+	}
+
+	return IGT_OPT_HANDLER_SUCCESS;
+}
+
+static const char help_str[] =
+	"  -r <rounds>       Signals per latency row, 1000 by default.\n"
+	"  -w <waiters>      Largest number of waiter threads, sweeps powers\n"
+	"                    of two up to it, 8 by default.\n"
+	"  -d <us>           Delay between the waiters starting and the signal,\n"
+	"                    so they are blocked by then, 100 by default.\n"
+	"Reports the distribution of the signal to wake latency in us, over\n"
+	"all the waiters, and transfers/s with --threads processes each\n"
+	"running its own chain of transfers.\n";
+
+int main(int argc, char **argv)
+{
+	static const enum mode modes[] = { WAIT_ALL, WAIT_ANY, EVENTFD };
+	struct syncobj_bench b = {
+		.rounds = 1000,
+		.max_waiters = 8,
+		.delay_us = 100,
+	};
+	bool eventfd_supported;
+
+	igt_bench_init(&b.bench, "syncobj_bench");
+	b.bench.opts.duration = 1;
+	igt_bench_parse_opts(&b.bench, argc, argv, "r:w:d:", help_str,
+			     opt_handler, &b);
+	igt_require(b.bench.opts.threads <= MAX_THREADS);
+
+	b.fd = drm_open_driver(DRIVER_ANY);
+	igt_require(has_syncobj_timeline(b.fd));
+	igt_bench_set_device(&b.bench, b.fd);
+	eventfd_supported = has_syncobj_eventfd(b.fd);
+
+	for (unsigned int n = 0; n < MAX_SYNCOBJS; n++)
+		b.handles[n] = syncobj_create(b.fd, 0);
+
+	printf("%-9s %5s %7s %9s %9s %9s %9s %9s\n",
+	       "mode", "count", "waiters", "min (us)", "p50", "p99",
+	       "p99.9", "max");
+
+	for (int m = 0; m < ARRAY_SIZE(modes); m++) {
+		b.mode = modes[m];
+
+		if (b.mode == EVENTFD && !eventfd_supported) {
+			igt_info("syncobj eventfd not supported, skipping\n");
+			continue;
+		}
+
+		/* An eventfd is registered against a single syncobj */
+		for (b.count = 1; b.count <= MAX_SYNCOBJS; b.count *= 4) {
+			for (b.num_waiters = 1; ;
+			     b.num_waiters = min(2 * b.num_waiters,
+						 b.max_waiters)) {
+				run_latency(&b);
+				if (b.num_waiters == b.max_waiters)
+					break;
+			}
+
+			if (b.mode == EVENTFD)
+				break;
+		}
+	}
+
+	printf("\n%-9s %7s %12s %10s %10s %10s\n",
+	       "mode", "threads", "transfers/s", "ci95", "min", "max");
+	igt_bench_set_unit(&b.bench, "transfers/s", 3);
+	run_transfer(&b);
+
+	for (unsigned int n = 0; n < MAX_SYNCOBJS; n++)
+		syncobj_destroy(b.fd, b.handles[n]);
+
+	igt_bench_fini(&b.bench);
+	drm_close_driver(b.fd);
+
+	return 0;
+}
@@ -0,0 +1,197 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2025 Raspberry Pi Ltd
+ */
+
+/*
+ * Measures the job submission rate of the Broadcom GPUs, with the BOs of
+ * each job freshly allocated, as the tests do, or taken from the BO caches
+ * of lib/igt_v3d.c and lib/igt_vc4.c:
+ *
+ *  - v3d: the no-op bin/render job and the empty compute shader job,
+ *  - vc4: a render job clearing a BO.
+ *
+ * The BOs come from CMA on these devices, so their allocation is a good
+ * part of the cost of a job.
+ */
+
+#include "igt.h"
+#include "igt_bench.h"
+#include "igt_syncobj.h"
+#include "igt_v3d.h"
+#include "igt_vc4.h"
+
+#define CACHE_SIZE	(64 << 20)
+
+struct submit {
+	struct igt_bench bench;
+
+	int v3d;
+	uint32_t syncobj;
+	struct v3d_bo_cache *v3d_cache;
+
+	int vc4;
+	uint32_t vc4_sync;
+	struct vc4_bo_cache *vc4_cache;
+
+	bool cached;
+	size_t size;
+};
+
+static void v3d_cl(void *data, unsigned int thread, unsigned long count)
+{
+	struct submit *s = data;
+
+	while (count--) {
+		struct v3d_cl_job *job;
+
+		job = __igt_v3d_noop_job(s->v3d, s->cached ? s->v3d_cache : NULL);
+		job->submit->out_sync = s->syncobj;
+		do_ioctl(s->v3d, DRM_IOCTL_V3D_SUBMIT_CL, job->submit);
+		igt_v3d_free_cl_job(s->v3d, job);
+	}
+
+	igt_assert(syncobj_wait(s->v3d, &s->syncobj, 1, INT64_MAX, 0, NULL));
+}
+
+static void v3d_csd(void *data, unsigned int thread, unsigned long count)
+{
+	struct submit *s = data;
+
+	while (count--) {
+		struct v3d_csd_job *job;
+
+		job = __igt_v3d_empty_shader(s->v3d,
+					     s->cached ? s->v3d_cache : NULL);
+		job->submit->out_sync = s->syncobj;
+		do_ioctl(s->v3d, DRM_IOCTL_V3D_SUBMIT_CSD, job->submit);
+		igt_v3d_free_csd_job(s->v3d, job);
+	}
+
+	igt_assert(syncobj_wait(s->v3d, &s->syncobj, 1, INT64_MAX, 0, NULL));
+}
+
+static void vc4_clear(void *data, unsigned int thread, unsigned long count)
+{
+	struct submit *s = data;
+	struct drm_vc4_wait_bo wait = {
+		.handle = s->vc4_sync,
+		.timeout_ns = ~0ull,
+	};
+
+	while (count--) {
+		uint32_t handle;
+
+		if (s->cached)
+			handle = igt_vc4_bo_cache_alloc(s->vc4_cache, s->size);
+		else
+			handle = igt_vc4_create_bo(s->vc4, s->size);
+
+		igt_vc4_clear_bo(s->vc4, handle, s->size, 0xdeadbeef);
+
+		if (s->cached)
+			igt_vc4_bo_cache_free(s->vc4_cache, handle, s->size);
+		else
+			gem_close(s->vc4, handle);
+	}
+
+	/* The jobs run in order, the last one completes after all others */
+	igt_vc4_clear_bo(s->vc4, s->vc4_sync, VC4_GPU_PAGE_SIZE, 0);
+	do_ioctl(s->vc4, DRM_IOCTL_VC4_WAIT_BO, &wait);
+}
+
+static void run(struct submit *s, const char *driver, const char *job,
+		igt_bench_fn fn)
+{
+	struct igt_bench_result result;
+	char label[64];
+
+	for (int cached = 0; cached < 2; cached++) {
+		s->cached = cached;
+
+		snprintf(label, sizeof(label), "driver=%s,job=%s,bos=%s",
+			 driver, job, cached ? "cached" : "fresh");
+		igt_bench_run(&s->bench, label, fn, s, &result);
+
+		printf("%-6s %-6s %-7s %12.0f %10.0f\n", driver, job,
+		       cached ? "cached" : "fresh", result.mean, result.ci95);
+
+		igt_bench_result_fini(&result);
+	}
+}
+
+static int opt_handler(int opt, int opt_index, void *data)
+{
+	struct submit *s = data;
+
+	switch (opt) {
+	case 's':
+		s->size = ALIGN(max(atoi(optarg), 1), VC4_GPU_PAGE_SIZE);
+		break;
+	default:
+		return IGT_OPT_HANDLER_ERROR;
+	}
+
+	return IGT_OPT_HANDLER_SUCCESS;
+}
+
+static const char help_str[] =
+	"  -s <bytes>        Size of the BO each vc4 job clears, 256KiB by default.\n"
+	"Reports jobs/s with fresh BOs for each job and with BOs from the cache.\n";
+
+int main(int argc, char **argv)
+{
+	struct submit s = {
+		.size = 256 << 10,
+	};
+
+	igt_bench_init(&s.bench, "v3d_submit_rate");
+	s.bench.opts.duration = 1;
+	igt_bench_parse_opts(&s.bench, argc, argv, "s:", help_str,
+			     opt_handler, &s);
+	/* The caches belong to this process */
+	s.bench.opts.threads = 1;
+
+	s.v3d = __drm_open_driver(DRIVER_V3D);
+	s.vc4 = __drm_open_driver(DRIVER_VC4);
+	/* The vc4 driver of the v3d devices only does display */
+	if (s.vc4 >= 0 && igt_vc4_is_v3d(s.vc4)) {
+		drm_close_driver(s.vc4);
+		s.vc4 = -1;
+	}
+	igt_require_f(s.v3d >= 0 || s.vc4 >= 0, "No v3d or vc4 GPU\n");
+
+	igt_bench_set_device(&s.bench, s.v3d >= 0 ? s.v3d : s.vc4);
+	igt_bench_set_unit(&s.bench, "jobs/s", 1);
+
+	printf("%-6s %-6s %-7s %12s %10s\n", "driver", "job", "bos",
+	       "jobs/s", "ci95");
+
+	if (s.v3d >= 0) {
+		s.syncobj = syncobj_create(s.v3d, 0);
+		s.v3d_cache = igt_v3d_bo_cache_create(s.v3d, CACHE_SIZE);
+
+		run(&s, "v3d", "cl", v3d_cl);
+		if (igt_v3d_get_param(s.v3d, DRM_V3D_PARAM_SUPPORTS_CSD))
+			run(&s, "v3d", "csd", v3d_csd);
+
+		igt_v3d_bo_cache_destroy(s.v3d_cache);
+		syncobj_destroy(s.v3d, s.syncobj);
+		drm_close_driver(s.v3d);
+	}
+
+	if (s.vc4 >= 0) {
+		s.vc4_sync = igt_vc4_create_bo(s.vc4, VC4_GPU_PAGE_SIZE);
+		s.vc4_cache = igt_vc4_bo_cache_create(s.vc4, CACHE_SIZE);
+
+		run(&s, "vc4", "clear", vc4_clear);
+
+		igt_vc4_bo_cache_destroy(s.vc4_cache);
+		gem_close(s.vc4, s.vc4_sync);
+		drm_close_driver(s.vc4);
+	}
+
+	igt_bench_fini(&s.bench);
+
+	return 0;
+}
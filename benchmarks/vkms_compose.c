@@ -0,0 +1,273 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2025 Intel Corporation
+ */
+
+/*
+ * Measures how long VKMS takes to blend its planes, per number of planes and
+ * per format.
+ *
+ * VKMS composes on the CPU, from the work it queues on each vblank of its
+ * simulated CRTC, and signals the writeback job once the frame is written.
+ * The time from the vblank timestamp of the flip to the timestamp of the
+ * writeback out fence is therefore the composition time of the frame,
+ * independently of the refresh rate the commits themselves are bound to.
+ *
+ * The benchmark creates its own VKMS device from a topology, a single
+ * pipeline with a writeback connector and the requested number of overlays,
+ * and removes it at the end.
+ */
+
+#include "igt.h"
+#include "igt_device_scan.h"
+#include "igt_stats.h"
+#include "igt_vkms.h"
+#include "sw_sync.h"
+
+#define DEVICE_NAME "vkms-compose"
+#define MAX_OVERLAYS 16
+
+struct data_t {
+	int fd;
+	igt_display_t display;
+	igt_output_t *output;
+	drmModeModeInfo *mode;
+	igt_plane_t *planes[MAX_OVERLAYS + 1];
+	int num_planes;
+	struct igt_fb fbs[MAX_OVERLAYS + 1];
+	struct igt_fb wb_fb;
+};
+
+static const uint32_t formats[] = {
+	DRM_FORMAT_XRGB8888,
+	DRM_FORMAT_ARGB8888,
+	DRM_FORMAT_XRGB16161616,
+	DRM_FORMAT_ARGB16161616,
+	DRM_FORMAT_RGB565,
+	DRM_FORMAT_NV12,
+};
+
+static struct {
+	int overlays;
+	int frames;
+} opt = {
+	.overlays = 4,
+	.frames = 60,
+};
+
+static igt_output_t *find_wb_output(struct data_t *data)
+{
+	for (int i = 0; i < data->display.n_outputs; i++) {
+		igt_output_t *output = &data->display.outputs[i];
+
+		if (output->config.connector->connector_type ==
+		    DRM_MODE_CONNECTOR_WRITEBACK)
+			return output;
+	}
+
+	return NULL;
+}
+
+/*
+ * Stacks @count planes in @format, each inset a bit more than the one below
+ * so that all of them are blended. Returns the number of pixels read from the
+ * planes for each frame, 0 if a plane doesn't support @format.
+ */
+static uint64_t setup_planes(struct data_t *data, uint32_t format, int count)
+{
+	uint64_t pixels = 0;
+
+	for (int i = 0; i < count; i++) {
+		igt_plane_t *plane = data->planes[i];
+		int inset = i * 16;
+		int w = data->mode->hdisplay - 2 * inset;
+		int h = data->mode->vdisplay - 2 * inset;
+
+		if (!igt_plane_has_format_mod(plane, format,
+					      DRM_FORMAT_MOD_LINEAR) ||
+		    w <= 0 || h <= 0)
+			return 0;
+	}
+
+	for (int i = 0; i < count; i++) {
+		igt_plane_t *plane = data->planes[i];
+		int inset = i * 16;
+		int w = data->mode->hdisplay - 2 * inset;
+		int h = data->mode->vdisplay - 2 * inset;
+
+		igt_create_pattern_fb(data->fd, w, h, format,
+				      DRM_FORMAT_MOD_LINEAR, &data->fbs[i]);
+		igt_plane_set_fb(plane, &data->fbs[i]);
+		igt_plane_set_position(plane, inset, inset);
+		igt_plane_set_size(plane, w, h);
+		pixels += (uint64_t)w * h;
+	}
+
+	return pixels;
+}
+
+static void cleanup_planes(struct data_t *data, int count)
+{
+	for (int i = 0; i < count; i++) {
+		igt_plane_set_fb(data->planes[i], NULL);
+		igt_remove_fb(data->fd, &data->fbs[i]);
+	}
+}
+
+/* Commits a frame and returns its composition time in ns */
+static uint64_t compose_frame(struct data_t *data)
+{
+	struct drm_event_vblank ev;
+	uint64_t vblank_ns, done_ns;
+	int ret;
+
+	igt_output_set_writeback_fb(data->output, &data->wb_fb);
+	igt_display_commit_atomic(&data->display, DRM_MODE_PAGE_FLIP_EVENT,
+				  NULL);
+
+	igt_assert_eq(read(data->fd, &ev, sizeof(ev)), sizeof(ev));
+	vblank_ns = ev.tv_sec * NSEC_PER_SEC + ev.tv_usec * 1000ull;
+
+	igt_assert(data->output->writeback_out_fence_fd >= 0);
+	ret = sync_fence_wait(data->output->writeback_out_fence_fd, 1000);
+	igt_assert_f(ret == 0, "sync_fence_wait failed: %s\n", strerror(-ret));
+	done_ns = sync_fence_timestamp(data->output->writeback_out_fence_fd);
+	close(data->output->writeback_out_fence_fd);
+	data->output->writeback_out_fence_fd = -1;
+
+	return done_ns > vblank_ns ? done_ns - vblank_ns : 0;
+}
+
+static void run(struct data_t *data, uint32_t format, int count)
+{
+	uint64_t pixels, out_pixels;
+	igt_stats_t stats;
+	double median;
+
+	pixels = setup_planes(data, format, count);
+	if (!pixels) {
+		igt_info("%-10s %6d %10s\n", igt_format_str(format), count,
+			 "unsupported");
+		return;
+	}
+
+	igt_stats_init_with_size(&stats, opt.frames);
+
+	/* The first frame also pays for the pipeline setup */
+	compose_frame(data);
+	for (int n = 0; n < opt.frames; n++)
+		igt_stats_push(&stats, compose_frame(data));
+
+	out_pixels = (uint64_t)data->mode->hdisplay * data->mode->vdisplay;
+	median = igt_stats_get_median(&stats);
+	igt_info("%-10s %6d %10.2f %10.2f %10.2f %10.2f %10.1f\n",
+		 igt_format_str(format), count,
+		 median * 1e-6,
+		 igt_stats_get_percentile(&stats, 99) * 1e-6,
+		 median / pixels, median / out_pixels,
+		 median ? 1e9 / median : 0);
+
+	igt_stats_fini(&stats);
+	cleanup_planes(data, count);
+}
+
+static int opt_handler(int opt_char, int opt_index, void *_data)
+{
+	switch (opt_char) {
+	case 'p':
+		opt.overlays = clamp(atoi(optarg), 0, MAX_OVERLAYS);
+		break;
+	case 'n':
+		opt.frames = max(atoi(optarg), 1);
+		break;
+	default:
+		return IGT_OPT_HANDLER_ERROR;
+	}
+
+	return IGT_OPT_HANDLER_SUCCESS;
+}
+
+static const char help_str[] =
+	"  -p <overlays>\tMaximum number of overlays to blend (default 4)\n"
+	"  -n <frames>\tNumber of frames per measurement (default 60)\n"
+	"Reports, per format and number of planes, the median and p99\n"
+	"composition times, the median time per blended and per output pixel\n"
+	"and the frame rate the composition alone would sustain.\n";
+
+igt_simple_main_args("p:n:", NULL, help_str, opt_handler, NULL)
+{
+	igt_vkms_topology_t topo = {
+		.device_name = DEVICE_NAME,
+		.num_pipelines = 1,
+		.writeback = true,
+	};
+	struct data_t data = {};
+	struct igt_device_card card;
+	struct timespec start;
+	igt_vkms_t *dev;
+	enum pipe pipe;
+
+	igt_require_vkms_configfs();
+
+	topo.overlays_per_crtc = opt.overlays;
+	igt_assert_eq(igt_gettime(&start), 0);
+	dev = igt_vkms_device_create_from_topology(&topo);
+	igt_assert(dev);
+	igt_vkms_device_set_enabled(dev, true);
+	igt_info("Created the device with %d planes in %.2fms\n",
+		 opt.overlays + 1, igt_nsec_elapsed(&start) * 1e-6);
+
+	igt_devices_scan();
+	igt_assert_f(igt_device_find_card_by_sysname(DEVICE_NAME, &card),
+		     "Device '%s' not found\n", DEVICE_NAME);
+	data.fd = igt_open_card(&card);
+	igt_assert_fd(data.fd);
+	igt_require(!drmSetClientCap(data.fd, DRM_CLIENT_CAP_WRITEBACK_CONNECTORS,
+				     1));
+
+	igt_display_require(&data.display, data.fd);
+	igt_require(data.display.is_atomic);
+	igt_display_reset(&data.display);
+
+	data.output = find_wb_output(&data);
+	igt_require(data.output);
+
+	for_each_pipe(&data.display, pipe) {
+		igt_output_set_pipe(data.output, pipe);
+		break;
+	}
+	data.mode = igt_output_get_mode(data.output);
+
+	data.planes[data.num_planes++] =
+		igt_output_get_plane_type(data.output, DRM_PLANE_TYPE_PRIMARY);
+	for (int i = 0; i < opt.overlays; i++)
+		data.planes[data.num_planes++] =
+			igt_output_get_plane_type_index(data.output,
+							DRM_PLANE_TYPE_OVERLAY,
+							i);
+
+	igt_create_fb(data.fd, data.mode->hdisplay, data.mode->vdisplay,
+		      DRM_FORMAT_XRGB8888, DRM_FORMAT_MOD_LINEAR, &data.wb_fb);
+
+	igt_info("Composing %dx%d frames into XRGB8888\n",
+		 data.mode->hdisplay, data.mode->vdisplay);
+	igt_info("%-10s %6s %10s %10s %10s %10s %10s\n",
+		 "format", "planes", "p50(ms)", "p99(ms)", "ns/px in",
+		 "ns/px out", "max fps");
+
+	for (int f = 0; f < ARRAY_SIZE(formats); f++)
+		for (int count = 1; count <= data.num_planes; count++)
+			run(&data, formats[f], count);
+
+	igt_output_set_writeback_fb(data.output, NULL);
+	igt_output_set_pipe(data.output, PIPE_NONE);
+	igt_display_commit2(&data.display, COMMIT_ATOMIC);
+	igt_remove_fb(data.fd, &data.wb_fb);
+	igt_display_fini(&data.display);
+	close(data.fd);
+
+	igt_assert_eq(igt_gettime(&start), 0);
+	igt_vkms_device_destroy(dev);
+	igt_info("Destroyed the device in %.2fms\n",
+		 igt_nsec_elapsed(&start) * 1e-6);
+}
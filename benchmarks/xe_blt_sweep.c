@@ -0,0 +1,504 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2025 Intel Corporation
+ */
+
+/*
+ * Sweeps the copy bandwidth of the blitter over every combination of copy
+ * command, source and destination memory region, tiling, compression, size
+ * and number of copy engines copying concurrently, reporting GB/s.
+ *
+ * Each copy engine gets its own exec queue, source and destination objects
+ * and a batch chaining enough copies to keep it busy for a while, so running
+ * one process per engine measures how the copy engines scale when they share
+ * the memory bandwidth.
+ */
+
+#include "igt.h"
+#include "igt_bench.h"
+#include "igt_syncobj.h"
+#include "intel_blt.h"
+#include "intel_mocs.h"
+#include "xe/xe_ioctl.h"
+#include "xe/xe_query.h"
+
+#define MAX_LANES	16
+#define BATCH_BYTES	SZ_64M
+#define MAX_COPIES	64
+#define BB_SIZE		SZ_16K
+
+enum copy_type {
+	COPY_BLOCK,
+	COPY_FAST,
+	COPY_MEM,
+	NUM_COPIES
+};
+
+static const char * const copy_names[NUM_COPIES] = {
+	[COPY_BLOCK] = "block",
+	[COPY_FAST] = "fast",
+	[COPY_MEM] = "mem",
+};
+
+struct config {
+	enum copy_type copy;
+	uint32_t src_region;
+	uint32_t dst_region;
+	enum blt_tiling_type tiling;
+	bool compression;
+	uint32_t width;
+	uint32_t height;
+};
+
+struct lane {
+	uint32_t exec_queue;
+	uint32_t syncobj;
+	uint32_t bb;
+	uint64_t bb_offset;
+	struct blt_copy_object *src;
+	struct blt_copy_object *dst;
+};
+
+struct sweep {
+	struct igt_bench bench;
+	int fd;
+	uint32_t vm;
+	uint64_t ahnd;
+
+	struct drm_xe_engine_class_instance engines[MAX_LANES];
+	unsigned int num_engines;
+	struct lane lanes[MAX_LANES];
+	unsigned int num_lanes;
+
+	unsigned int copy_mask;
+	unsigned int tiling_mask;
+	const char *regions;
+	uint64_t min_size;
+	uint64_t max_size;
+	unsigned int concurrency;
+};
+
+static void surface_dims(uint64_t size, uint32_t *width, uint32_t *height)
+{
+	uint64_t pixels = size / 4;
+
+	/* Square-ish 32bpp surface, wider than tall for odd powers of two */
+	*width = 1u << (igt_fls(pixels) / 2);
+	*height = max_t(uint64_t, pixels / *width, 1);
+}
+
+static unsigned int batch_copies(const struct config *cfg)
+{
+	uint64_t bytes = (uint64_t)cfg->width * cfg->height * 4;
+
+	return min_t(uint64_t, max_t(uint64_t, BATCH_BYTES / bytes, 1), MAX_COPIES);
+}
+
+static uint64_t emit_copy(struct sweep *s, const struct config *cfg,
+			  struct lane *l, uint64_t bb_pos, bool emit_bbe)
+{
+	if (cfg->copy == COPY_MEM) {
+		struct blt_mem_copy_data mem;
+		uint32_t pitch = cfg->width * 4;
+
+		blt_mem_copy_init(s->fd, &mem, MODE_BYTE, TYPE_MATRIX);
+		blt_set_mem_object(&mem.src, l->src->handle, l->src->size,
+				   pitch, pitch, cfg->height, l->src->region,
+				   l->src->mocs_index, l->src->pat_index,
+				   COMPRESSION_DISABLED);
+		blt_set_mem_object(&mem.dst, l->dst->handle, l->dst->size,
+				   pitch, pitch, cfg->height, l->dst->region,
+				   l->dst->mocs_index, l->dst->pat_index,
+				   COMPRESSION_DISABLED);
+		blt_set_batch(&mem.bb, l->bb, BB_SIZE, system_memory(s->fd));
+
+		return emit_blt_mem_copy(s->fd, s->ahnd, &mem, bb_pos, emit_bbe);
+	} else {
+		struct blt_block_copy_data_ext ext = {}, *pext = NULL;
+		struct blt_copy_data blt;
+
+		blt_copy_init(s->fd, &blt);
+		blt.color_depth = CD_32bit;
+		blt_set_copy_object(&blt.src, l->src);
+		blt_set_copy_object(&blt.dst, l->dst);
+		blt_set_batch(&blt.bb, l->bb, BB_SIZE, system_memory(s->fd));
+
+		if (cfg->copy == COPY_FAST)
+			return emit_blt_fast_copy(s->fd, s->ahnd, &blt, bb_pos,
+						  emit_bbe);
+
+		if (blt_uses_extended_block_copy(s->fd)) {
+			blt_set_object_ext(&ext.src, 0, cfg->width, cfg->height,
+					   SURFACE_TYPE_2D);
+			blt_set_object_ext(&ext.dst, 0, cfg->width, cfg->height,
+					   SURFACE_TYPE_2D);
+			pext = &ext;
+		}
+
+		return emit_blt_block_copy(s->fd, s->ahnd, &blt, pext, bb_pos,
+					   emit_bbe);
+	}
+}
+
+static void setup_lanes(struct sweep *s, const struct config *cfg,
+			unsigned int num_lanes)
+{
+	enum blt_tiling_type tiling = cfg->copy == COPY_MEM ? T_LINEAR : cfg->tiling;
+	unsigned int copies = batch_copies(cfg);
+	uint8_t mocs = intel_get_uc_mocs_index(s->fd);
+	struct blt_copy_data blt;
+
+	s->vm = xe_vm_create(s->fd, 0, 0);
+	s->ahnd = intel_allocator_open(s->fd, s->vm, INTEL_ALLOCATOR_SIMPLE);
+	blt_copy_init(s->fd, &blt);
+
+	for (unsigned int i = 0; i < num_lanes; i++) {
+		struct lane *l = &s->lanes[i];
+		uint64_t bb_pos = 0;
+
+		l->exec_queue = xe_exec_queue_create(s->fd, s->vm,
+						     &s->engines[i], 0);
+		l->syncobj = syncobj_create(s->fd, 0);
+		l->bb = xe_bo_create(s->fd, 0, BB_SIZE, system_memory(s->fd), 0);
+		l->src = blt_create_object(&blt, cfg->src_region, cfg->width,
+					   cfg->height, 32, mocs, tiling,
+					   COMPRESSION_DISABLED,
+					   COMPRESSION_TYPE_3D, false);
+		l->dst = blt_create_object(&blt, cfg->dst_region, cfg->width,
+					   cfg->height, 32, mocs, tiling,
+					   cfg->compression ? COMPRESSION_ENABLED :
+							      COMPRESSION_DISABLED,
+					   COMPRESSION_TYPE_3D, false);
+
+		for (unsigned int n = 0; n < copies; n++)
+			bb_pos = emit_copy(s, cfg, l, bb_pos, n == copies - 1);
+
+		l->bb_offset = CANONICAL(get_offset(s->ahnd, l->bb, BB_SIZE, 0));
+	}
+	s->num_lanes = num_lanes;
+
+	intel_allocator_bind(s->ahnd, 0, 0);
+}
+
+static void teardown_lanes(struct sweep *s)
+{
+	for (unsigned int i = 0; i < s->num_lanes; i++) {
+		struct lane *l = &s->lanes[i];
+
+		blt_destroy_object(s->fd, l->src);
+		blt_destroy_object(s->fd, l->dst);
+		gem_close(s->fd, l->bb);
+		syncobj_destroy(s->fd, l->syncobj);
+		xe_exec_queue_destroy(s->fd, l->exec_queue);
+	}
+	s->num_lanes = 0;
+
+	put_ahnd(s->ahnd);
+	xe_vm_destroy(s->fd, s->vm);
+}
+
+static void run_copies(void *data, unsigned int thread, unsigned long count)
+{
+	struct sweep *s = data;
+	struct lane *l = &s->lanes[thread];
+	struct drm_xe_sync sync = {
+		.type = DRM_XE_SYNC_TYPE_SYNCOBJ,
+		.flags = DRM_XE_SYNC_FLAG_SIGNAL,
+		.handle = l->syncobj,
+	};
+	struct drm_xe_exec exec = {
+		.exec_queue_id = l->exec_queue,
+		.num_syncs = 1,
+		.syncs = to_user_pointer(&sync),
+		.address = l->bb_offset,
+		.num_batch_buffer = 1,
+	};
+
+	/* The queue is in order, so the last batch signals the lot */
+	while (count--)
+		xe_exec(s->fd, &exec);
+	igt_assert(syncobj_wait(s->fd, &l->syncobj, 1, INT64_MAX, 0, NULL));
+}
+
+static uint64_t region_avail(int fd, uint32_t region)
+{
+	struct drm_xe_mem_region *mem;
+
+	if (region == system_memory(fd))
+		return igt_get_avail_ram_mb() << 20;
+
+	mem = xe_mem_region(fd, region);
+	return mem->total_size - min(mem->used, mem->total_size);
+}
+
+static bool fits(int fd, const struct config *cfg, unsigned int num_lanes)
+{
+	uint64_t bytes = (uint64_t)cfg->width * cfg->height * 4 * num_lanes;
+
+	/* Leave a quarter spare for tiling alignment and everybody else */
+	if (cfg->src_region == cfg->dst_region)
+		return 2 * bytes <= region_avail(fd, cfg->src_region) / 4 * 3;
+
+	return bytes <= region_avail(fd, cfg->src_region) / 4 * 3 &&
+	       bytes <= region_avail(fd, cfg->dst_region) / 4 * 3;
+}
+
+static bool supports_tiling(int fd, enum copy_type copy,
+			    enum blt_tiling_type tiling)
+{
+	switch (copy) {
+	case COPY_BLOCK:
+		return blt_block_copy_supports_tiling(fd, tiling);
+	case COPY_FAST:
+		return blt_fast_copy_supports_tiling(fd, tiling);
+	case COPY_MEM:
+		return tiling == T_LINEAR;
+	default:
+		return false;
+	}
+}
+
+static bool supports_copy(int fd, enum copy_type copy)
+{
+	switch (copy) {
+	case COPY_BLOCK:
+		return blt_has_block_copy(fd);
+	case COPY_FAST:
+		return blt_has_fast_copy(fd);
+	case COPY_MEM:
+		return blt_has_mem_copy(fd);
+	default:
+		return false;
+	}
+}
+
+static uint64_t parse_regions(int fd, const char *list)
+{
+	uint64_t mask = 0;
+	char *str, *name, *save;
+	uint32_t region;
+
+	if (!list)
+		return all_memory_regions(fd);
+
+	str = strdup(list);
+	for (name = strtok_r(str, ",", &save); name;
+	     name = strtok_r(NULL, ",", &save)) {
+		bool found = false;
+
+		xe_for_each_mem_region(fd, all_memory_regions(fd), region) {
+			if (!strcmp(name, xe_region_name(region))) {
+				mask |= region;
+				found = true;
+			}
+		}
+		igt_assert_f(found, "Unknown memory region '%s'\n", name);
+	}
+	free(str);
+
+	return mask;
+}
+
+static int parse_list(const char *list, const char *(*name_of)(int),
+		      int count, unsigned int *mask)
+{
+	char *str, *name, *save;
+	int ret = 0;
+
+	*mask = 0;
+	str = strdup(list);
+	for (name = strtok_r(str, ",", &save); name;
+	     name = strtok_r(NULL, ",", &save)) {
+		int i;
+
+		for (i = 0; i < count; i++)
+			if (name_of(i) && !strcmp(name, name_of(i)))
+				break;
+
+		if (i == count) {
+			fprintf(stderr, "Unknown name '%s'\n", name);
+			ret = -1;
+			break;
+		}
+		*mask |= 1u << i;
+	}
+	free(str);
+
+	return ret;
+}
+
+static const char *copy_name(int copy)
+{
+	return copy_names[copy];
+}
+
+static const char *tiling_name(int tiling)
+{
+	/* Y-tiling variants are not worth sweeping */
+	if (tiling == T_YFMAJOR || tiling == T_YSMAJOR)
+		return NULL;
+
+	return blt_tiling_name(tiling);
+}
+
+static int opt_handler(int opt, int opt_index, void *data)
+{
+	struct sweep *s = data;
+
+	switch (opt) {
+	case 'c':
+		if (parse_list(optarg, copy_name, NUM_COPIES, &s->copy_mask))
+			return IGT_OPT_HANDLER_ERROR;
+		break;
+	case 'T':
+		if (parse_list(optarg, tiling_name, __BLT_MAX_TILING,
+			       &s->tiling_mask))
+			return IGT_OPT_HANDLER_ERROR;
+		break;
+	case 'm':
+		s->regions = optarg;
+		break;
+	case 's':
+		s->min_size = max(strtoull(optarg, NULL, 0), 4096ull);
+		break;
+	case 'S':
+		s->max_size = strtoull(optarg, NULL, 0);
+		break;
+	case 'e':
+		s->concurrency = atoi(optarg);
+		break;
+	default:
+		return IGT_OPT_HANDLER_ERROR;
+	}
+
+	return IGT_OPT_HANDLER_SUCCESS;
+}
+
+static const char help_str[] =
+	"  -c <list>         Copy commands to sweep: block,fast,mem (default all).\n"
+	"  -T <list>         Tilings to sweep: linear,xmajor,ymajor,tile4,tile64\n"
+	"                    (default all the copy command supports).\n"
+	"  -m <list>         Memory regions to sweep, e.g. system,vram0 (default all).\n"
+	"  -s <bytes>        Smallest copy size (default 4KiB).\n"
+	"  -S <bytes>        Largest copy size (default 1GiB).\n"
+	"  -e <n>            Copy on n engines concurrently, scales from one to all\n"
+	"                    copy engines if omitted.\n";
+
+static void run(struct sweep *s, struct config *cfg, unsigned int num_lanes)
+{
+	struct igt_bench_result result;
+	uint64_t bytes = (uint64_t)cfg->width * cfg->height * 4;
+	char label[128];
+
+	if (!fits(s->fd, cfg, num_lanes))
+		return;
+
+	snprintf(label, sizeof(label),
+		 "copy=%s,src=%s,dst=%s,tiling=%s,compression=%s,size=%" PRIu64 ",engines=%u",
+		 copy_names[cfg->copy], xe_region_name(cfg->src_region),
+		 xe_region_name(cfg->dst_region), blt_tiling_name(cfg->tiling),
+		 cfg->compression ? "on" : "off", bytes, num_lanes);
+
+	setup_lanes(s, cfg, num_lanes);
+
+	s->bench.opts.threads = num_lanes;
+	igt_bench_set_unit(&s->bench, "GB/s", batch_copies(cfg) * bytes / 1e9);
+	igt_bench_run(&s->bench, label, run_copies, s, &result);
+
+	printf("%-5s %-7s %-7s %-7s %-4s %10" PRIu64 " %7u %9.3f %8.3f\n",
+	       copy_names[cfg->copy], xe_region_name(cfg->src_region),
+	       xe_region_name(cfg->dst_region), blt_tiling_name(cfg->tiling),
+	       cfg->compression ? "on" : "off", bytes, num_lanes,
+	       result.mean, result.ci95);
+	fflush(stdout);
+
+	igt_bench_result_fini(&result);
+	teardown_lanes(s);
+}
+
+int main(int argc, char **argv)
+{
+	struct drm_xe_engine_class_instance *hwe;
+	struct sweep s = {
+		.copy_mask = -1,
+		.tiling_mask = -1,
+		.min_size = SZ_4K,
+		.max_size = SZ_1G,
+	};
+	uint32_t src_region, dst_region;
+	uint64_t regions;
+	bool has_ccs;
+
+	igt_bench_init(&s.bench, "xe_blt_sweep");
+	s.bench.opts.duration = 0.5;
+	s.bench.opts.warmup = 0.1;
+	s.bench.opts.reps = 3;
+	igt_bench_parse_opts(&s.bench, argc, argv, "c:T:m:s:S:e:", help_str,
+			     opt_handler, &s);
+
+	s.fd = drm_open_driver(DRIVER_XE);
+	igt_bench_set_device(&s.bench, s.fd);
+
+	xe_for_each_engine(s.fd, hwe) {
+		if (hwe->engine_class == DRM_XE_ENGINE_CLASS_COPY &&
+		    s.num_engines < MAX_LANES)
+			s.engines[s.num_engines++] = *hwe;
+	}
+	igt_require_f(s.num_engines, "No copy engines\n");
+	s.concurrency = min(s.concurrency, s.num_engines);
+
+	regions = parse_regions(s.fd, s.regions);
+	has_ccs = blt_block_copy_supports_compression(s.fd) &&
+		  blt_platform_has_flat_ccs_enabled(s.fd);
+
+	printf("%-5s %-7s %-7s %-7s %-4s %10s %7s %9s %8s\n",
+	       "copy", "src", "dst", "tiling", "ccs", "bytes", "engines",
+	       "GB/s", "ci95");
+
+	for (enum copy_type copy = 0; copy < NUM_COPIES; copy++) {
+		if (!(s.copy_mask & (1u << copy)) || !supports_copy(s.fd, copy))
+			continue;
+
+		xe_for_each_mem_region(s.fd, regions, src_region)
+		xe_for_each_mem_region(s.fd, regions, dst_region)
+		for (enum blt_tiling_type tiling = 0; tiling < __BLT_MAX_TILING; tiling++) {
+			if (!(s.tiling_mask & (1u << tiling)) || !tiling_name(tiling) ||
+			    !supports_tiling(s.fd, copy, tiling))
+				continue;
+
+			for (int compression = 0; compression <= 1; compression++) {
+				/* Flat CCS only compresses device memory on discrete */
+				if (compression &&
+				    (copy != COPY_BLOCK || !has_ccs ||
+				     (xe_has_vram(s.fd) &&
+				      dst_region == system_memory(s.fd))))
+					continue;
+
+				for (uint64_t size = s.min_size; size <= s.max_size; size <<= 1) {
+					struct config cfg = {
+						.copy = copy,
+						.src_region = src_region,
+						.dst_region = dst_region,
+						.tiling = tiling,
+						.compression = compression,
+					};
+
+					surface_dims(size, &cfg.width, &cfg.height);
+
+					if (s.concurrency) {
+						run(&s, &cfg, s.concurrency);
+						continue;
+					}
+
+					for (unsigned int n = 1; n <= s.num_engines; n++)
+						run(&s, &cfg, n);
+				}
+			}
+		}
+	}
+
+	igt_bench_fini(&s.bench);
+	close(s.fd);
+
+	return 0;
+}
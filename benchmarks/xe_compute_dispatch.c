@@ -0,0 +1,174 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2025 Intel Corporation
+ */
+
+/*
+ * Measures the latency and throughput of compute dispatches: one-shot
+ * through run_intel_compute_kernel(), which sets up and tears down the whole
+ * execution environment per dispatch, and through a persistent environment,
+ * waiting on every dispatch or keeping several in flight.
+ */
+
+#include "igt.h"
+#include "igt_bench.h"
+#include "intel_compute.h"
+#include "xe/xe_ioctl.h"
+#include "xe/xe_query.h"
+
+#define LATENCY_SAMPLES	256
+
+struct dispatch {
+	struct igt_bench bench;
+
+	int fd;
+	struct drm_xe_engine_class_instance *eci;
+	struct user_execenv user;
+	struct intel_compute_env *env;
+	unsigned int depth;
+	unsigned int next;
+
+	uint32_t work_size;
+	unsigned int max_depth;
+};
+
+static void oneshot(void *data, unsigned int thread, unsigned long count)
+{
+	struct dispatch *d = data;
+
+	while (count--)
+		igt_assert(xe_run_intel_compute_kernel_on_engine(d->fd, d->eci,
+								 &d->user,
+								 EXECENV_PREF_VRAM_IF_POSSIBLE));
+}
+
+static void persistent(void *data, unsigned int thread, unsigned long count)
+{
+	struct dispatch *d = data;
+
+	while (count--) {
+		intel_compute_env_dispatch(d->env, d->next, d->work_size);
+		d->next = (d->next + 1) % d->depth;
+	}
+	intel_compute_env_sync(d->env);
+}
+
+static void latency(struct dispatch *d, igt_bench_fn fn,
+		    double *median, double *p99)
+{
+	struct timespec start;
+	igt_stats_t stats;
+
+	igt_stats_init_with_size(&stats, LATENCY_SAMPLES);
+	for (int n = 0; n < LATENCY_SAMPLES; n++) {
+		igt_nsec_elapsed(&start);
+		fn(d, 0, 1);
+		igt_stats_push_float(&stats, igt_nsec_elapsed(&start) * 1e-3);
+	}
+
+	*median = igt_stats_get_median(&stats);
+	*p99 = igt_stats_get_percentile(&stats, 99);
+	igt_stats_fini(&stats);
+}
+
+static void run(struct dispatch *d, const char *mode, igt_bench_fn fn)
+{
+	struct igt_bench_result result;
+	double median, p99;
+	char label[64];
+
+	snprintf(label, sizeof(label), "mode=%s,depth=%u,size=%u",
+		 mode, d->depth, d->work_size);
+	igt_bench_run(&d->bench, label, fn, d, &result);
+
+	/* A single dispatch, waited on, is the latency at any depth */
+	latency(d, fn, &median, &p99);
+
+	printf("%-10s %5u %8u %12.0f %10.0f %10.1f %10.1f\n",
+	       mode, d->depth, d->work_size, result.mean, result.ci95,
+	       median, p99);
+
+	igt_bench_result_fini(&result);
+}
+
+static int opt_handler(int opt, int opt_index, void *data)
+{
+	struct dispatch *d = data;
+
+	switch (opt) {
+	case 's':
+		d->work_size = max(atoi(optarg), 1);
+		break;
+	case 'd':
+		d->max_depth = clamp(atoi(optarg), 1, 64);
+		break;
+	default:
+		return IGT_OPT_HANDLER_ERROR;
+	}
+
+	return IGT_OPT_HANDLER_SUCCESS;
+}
+
+static const char help_str[] =
+	"  -s <elements>     Work size of each dispatch, 1024 by default.\n"
+	"  -d <depth>        Largest number of dispatches in flight, sweeps\n"
+	"                    powers of two up to it, 16 by default.\n";
+
+int main(int argc, char **argv)
+{
+	struct drm_xe_engine_class_instance *hwe;
+	struct dispatch d = {
+		.work_size = 1024,
+		.max_depth = 16,
+	};
+
+	igt_bench_init(&d.bench, "xe_compute_dispatch");
+	d.bench.opts.duration = 1;
+	igt_bench_parse_opts(&d.bench, argc, argv, "s:d:", help_str,
+			     opt_handler, &d);
+	/* Dispatches share the environment, a single process drives it */
+	d.bench.opts.threads = 1;
+
+	d.fd = drm_open_driver(DRIVER_XE);
+	igt_bench_set_device(&d.bench, d.fd);
+	igt_bench_set_unit(&d.bench, "dispatches/s", 1);
+
+	/* Prefer a compute engine, fall back to render */
+	xe_for_each_engine(d.fd, hwe) {
+		if (hwe->engine_class == DRM_XE_ENGINE_CLASS_COMPUTE) {
+			d.eci = hwe;
+			break;
+		}
+		if (hwe->engine_class == DRM_XE_ENGINE_CLASS_RENDER && !d.eci)
+			d.eci = hwe;
+	}
+	igt_require(d.eci);
+
+	d.user.array_size = d.work_size;
+	d.user.skip_results_check = true;
+
+	printf("%-10s %5s %8s %12s %10s %10s %10s\n",
+	       "mode", "depth", "size", "dispatch/s", "ci95",
+	       "p50 (us)", "p99 (us)");
+
+	d.depth = 1;
+	run(&d, "oneshot", oneshot);
+
+	d.env = intel_compute_env_create(d.fd, d.eci, &d.user,
+					 EXECENV_PREF_VRAM_IF_POSSIBLE,
+					 d.max_depth);
+	igt_require_f(d.env, "Persistent compute environment not supported\n");
+
+	for (d.depth = 1; ; d.depth = min(2 * d.depth, d.max_depth)) {
+		d.next = 0;
+		run(&d, "persistent", persistent);
+		if (d.depth == d.max_depth)
+			break;
+	}
+
+	intel_compute_env_destroy(d.env);
+	igt_bench_fini(&d.bench);
+	drm_close_driver(d.fd);
+
+	return 0;
+}
@@ -4,17 +4,19 @@
  */
 
 #include "igt.h"
+#include "igt_bench.h"
 #include "igt_syncobj.h"
 #include "xe/xe_ioctl.h"
 #include "xe/xe_query.h"
 
 #define OBJECT_SIZE (1 << 23)
 
-static double elapsed(const struct timespec *start,
-		      const struct timespec *end)
-{
-	return (end->tv_sec - start->tv_sec) + 1e-9 * (end->tv_nsec - start->tv_nsec);
-}
+struct create {
+	struct igt_bench bench;
+	int fd;
+	int size;
+	bool busy;
+};
 
 static void test_exec(int fd, int busy, int size)
 {
@@ -64,93 +66,80 @@ static void test_exec(int fd, int busy, int size)
 	xe_vm_destroy(fd, vm);
 }
 
-int main(int argc, char **argv)
+static void create(void *data, unsigned int thread, unsigned long count)
 {
-	int fd = drm_open_driver(DRIVER_XE);
-	int size = 0;
-	int busy = 0;
-	int reps = 13;
-	int ncpus = 1;
-	int c, n, s;
-
-	while ((c = getopt(argc, argv, "s:b:r:f")) != -1) {
-		switch (c) {
-		case 's':
-			size = atoi(optarg);
-			break;
-
-		case 'r':
-			reps = atoi(optarg);
-			if (reps < 1)
-				reps = 1;
-			break;
-
-		case 'f':
-			ncpus = sysconf(_SC_NPROCESSORS_ONLN);
-			break;
-
-		case 'b':
-			busy = true;
-			break;
-
-		default:
-			break;
-		}
-	}
+	const struct create *c = data;
 
-	if (size == 0) {
-		for (s = 4096; s <=  OBJECT_SIZE; s <<= 1) {
-			igt_stats_t stats;
+	while (count--)
+		test_exec(c->fd, c->busy, c->size);
+}
 
-			igt_stats_init_with_size(&stats, reps);
-			for (n = 0; n < reps; n++) {
-				struct timespec start, end;
-				uint64_t count = 0;
+static int opt_handler(int opt, int opt_index, void *data)
+{
+	struct create *c = data;
+
+	switch (opt) {
+	case 's':
+		c->size = atoi(optarg);
+		break;
+	case 'r':
+		c->bench.opts.reps = max(atoi(optarg), 1);
+		break;
+	case 'f':
+		c->bench.opts.threads = sysconf(_SC_NPROCESSORS_ONLN);
+		break;
+	case 'b':
+		c->busy = true;
+		break;
+	default:
+		return IGT_OPT_HANDLER_ERROR;
+	}
 
-				clock_gettime(CLOCK_MONOTONIC, &start);
-				do {
-					for (c = 0; c < 1000; c++)
-						test_exec(fd, busy, s);
+	return IGT_OPT_HANDLER_SUCCESS;
+}
 
-					count += c;
-					clock_gettime(CLOCK_MONOTONIC, &end);
-				} while (end.tv_sec - start.tv_sec < 2);
+static const char help_str[] =
+	"  -s <size>         Object size, sweeps from 4KiB to 8MiB if omitted.\n"
+	"                    Prints the trimean of each size in the sweep, or\n"
+	"                    every repetition for a single size.\n"
+	"  -b <any>          Execute a batch in each object before closing it.\n"
+	"  -r <n>            Number of repetitions, like --reps.\n"
+	"  -f                Run one process per CPU, like --threads.\n";
 
-				igt_stats_push_float(&stats, count / elapsed(&start, &end));
-			}
-			printf("%f\n", igt_stats_get_trimean(&stats));
-			igt_stats_fini(&stats);
+int main(int argc, char **argv)
+{
+	struct igt_bench_result result;
+	struct create c = {};
+
+	igt_bench_init(&c.bench, "xe_create");
+	c.bench.opts.reps = 13;
+	igt_bench_parse_opts(&c.bench, argc, argv, "s:b:r:f", help_str,
+			     opt_handler, &c);
+
+	c.fd = drm_open_driver(DRIVER_XE);
+	igt_bench_set_device(&c.bench, c.fd);
+
+	if (c.size == 0) {
+		for (int s = 4096; s <= OBJECT_SIZE; s <<= 1) {
+			char label[32];
+
+			c.size = s;
+			snprintf(label, sizeof(label), "size=%d", s);
+			igt_bench_run(&c.bench, label, create, &c, &result);
+			printf("%f\n", result.trimean);
+			igt_bench_result_fini(&result);
 		}
 	} else {
-		double *shared;
-
-		shared = mmap(0, 4096, PROT_WRITE, MAP_SHARED | MAP_ANON, -1, 0);
-		for (n = 0; n < reps; n++) {
-			memset(shared, 0, 4096);
-
-			igt_fork(child, ncpus) {
-				struct timespec start, end;
-				uint64_t count = 0;
-
-				clock_gettime(CLOCK_MONOTONIC, &start);
-				do {
-					for (c = 0; c < 1000; c++)
-						test_exec(fd, busy, size);
-
-					count += c;
-					clock_gettime(CLOCK_MONOTONIC, &end);
-				} while (end.tv_sec - start.tv_sec < 2);
+		char label[32];
 
-				shared[child] = count / elapsed(&start, &end);
-			}
-			igt_waitchildren();
-
-			for (int child = 0; child < ncpus; child++)
-				shared[ncpus] += shared[child];
-
-			printf("%7.3f\n", shared[ncpus]);
-		}
+		snprintf(label, sizeof(label), "size=%d", c.size);
+		igt_bench_run(&c.bench, label, create, &c, &result);
+		for (int n = 0; n < result.samples.n_values; n++)
+			printf("%7.3f\n", result.samples.values_f[n]);
+		igt_bench_result_fini(&result);
 	}
 
+	igt_bench_fini(&c.bench);
+
 	return 0;
 }
@@ -0,0 +1,316 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2025 Intel Corporation
+ */
+
+/*
+ * Sweeps the throughput and latency of creating and destroying buffer
+ * objects over every memory region, size, combination of creation flags and
+ * number of processes creating concurrently.
+ *
+ * Each combination is timed for three workloads, so that the difference
+ * between them shows where the cost of an allocation goes:
+ *
+ *   create   create and close
+ *   fault    as create, also mmapping the object and writing its first byte,
+ *            which is when a deferred or lazily cleared backing store is paid
+ *   bind     as create, also binding the whole object to a VM and unbinding
+ *            it
+ *
+ * The flags swept are, for device memory only:
+ *
+ *   visible  DRM_XE_GEM_CREATE_FLAG_NEEDS_VISIBLE_VRAM
+ *   smem     system memory as a second placement
+ *
+ * and for every region:
+ *
+ *   defer    DRM_XE_GEM_CREATE_FLAG_DEFER_BACKING
+ *
+ * Device memory is only faulted in with the visible flag, as the rest of it
+ * may not be reachable by the CPU.
+ */
+
+#include <sys/mman.h>
+
+#include "igt.h"
+#include "igt_bench.h"
+#include "xe/xe_ioctl.h"
+#include "xe/xe_query.h"
+
+#define MAX_THREADS	64
+
+enum workload {
+	WORKLOAD_CREATE,
+	WORKLOAD_FAULT,
+	WORKLOAD_BIND,
+	NUM_WORKLOADS
+};
+
+static const char * const workload_names[NUM_WORKLOADS] = {
+	[WORKLOAD_CREATE] = "create",
+	[WORKLOAD_FAULT] = "fault",
+	[WORKLOAD_BIND] = "bind",
+};
+
+enum {
+	FLAG_VISIBLE = 1 << 0,
+	FLAG_SMEM = 1 << 1,
+	FLAG_DEFER = 1 << 2,
+	ALL_FLAGS = (1 << 3) - 1
+};
+
+struct sweep {
+	struct igt_bench bench;
+	int fd;
+	uint32_t vm;
+
+	/* The combination being measured */
+	enum workload workload;
+	uint32_t placement;
+	uint32_t create_flags;
+	uint64_t size;
+
+	unsigned int workload_mask;
+	uint64_t regions;
+	uint64_t min_size;
+	uint64_t max_size;
+	unsigned int max_threads;
+};
+
+static void create_bos(void *data, unsigned int thread, unsigned long count)
+{
+	const struct sweep *s = data;
+	/* Far enough apart for the largest objects */
+	uint64_t addr = (uint64_t)(thread + 1) << 36;
+
+	while (count--) {
+		uint32_t bo = xe_bo_create(s->fd, 0, s->size, s->placement,
+					   s->create_flags);
+
+		if (s->workload == WORKLOAD_FAULT) {
+			volatile uint8_t *ptr;
+
+			ptr = xe_bo_mmap_ext(s->fd, bo, s->size, PROT_WRITE);
+			*ptr = 0;
+			munmap((void *)ptr, s->size);
+		} else if (s->workload == WORKLOAD_BIND) {
+			xe_vm_bind_sync(s->fd, s->vm, bo, 0, addr, s->size);
+			xe_vm_unbind_sync(s->fd, s->vm, 0, addr, s->size);
+		}
+
+		gem_close(s->fd, bo);
+	}
+}
+
+static uint64_t region_avail(int fd, uint32_t region)
+{
+	struct drm_xe_mem_region *mem;
+
+	if (region == system_memory(fd))
+		return igt_get_avail_ram_mb() << 20;
+
+	mem = xe_mem_region(fd, region);
+	return mem->total_size - min(mem->used, mem->total_size);
+}
+
+static void flags_name(unsigned int flags, char *buf, size_t len)
+{
+	snprintf(buf, len, "%s%s%s%s",
+		 flags & FLAG_VISIBLE ? "visible," : "",
+		 flags & FLAG_SMEM ? "smem," : "",
+		 flags & FLAG_DEFER ? "defer," : "",
+		 flags ? "" : "none");
+	if (buf[strlen(buf) - 1] == ',')
+		buf[strlen(buf) - 1] = '\0';
+}
+
+static void run(struct sweep *s, uint32_t region, unsigned int flags,
+		unsigned int threads)
+{
+	struct igt_bench_result result;
+	char label[128], fname[32];
+
+	/* Leave a quarter spare for everybody else */
+	if (s->size * threads > region_avail(s->fd, region) / 4 * 3)
+		return;
+
+	s->placement = region;
+	s->create_flags = 0;
+	if (flags & FLAG_VISIBLE)
+		s->create_flags |= DRM_XE_GEM_CREATE_FLAG_NEEDS_VISIBLE_VRAM;
+	if (flags & FLAG_SMEM)
+		s->placement |= system_memory(s->fd);
+	if (flags & FLAG_DEFER)
+		s->create_flags |= DRM_XE_GEM_CREATE_FLAG_DEFER_BACKING;
+
+	flags_name(flags, fname, sizeof(fname));
+	snprintf(label, sizeof(label),
+		 "workload=%s,region=%s,flags=%s,size=%" PRIu64 ",threads=%u",
+		 workload_names[s->workload], xe_region_name(region), fname,
+		 s->size, threads);
+
+	s->bench.opts.threads = threads;
+	igt_bench_run(&s->bench, label, create_bos, s, &result);
+
+	/* Each process does its share of the objects */
+	printf("%-6s %-7s %-19s %11" PRIu64 " %7u %11.1f %9.1f %10.2f\n",
+	       workload_names[s->workload], xe_region_name(region), fname,
+	       s->size, threads, result.mean, result.ci95,
+	       result.mean ? threads * 1e6 / result.mean : 0);
+	fflush(stdout);
+
+	igt_bench_result_fini(&result);
+}
+
+static bool skip_flags(int fd, uint32_t region, unsigned int flags,
+		       enum workload workload)
+{
+	bool vram = region != system_memory(fd);
+
+	if (!vram && flags & (FLAG_VISIBLE | FLAG_SMEM))
+		return true;
+
+	return workload == WORKLOAD_FAULT && vram && !(flags & FLAG_VISIBLE);
+}
+
+static uint64_t parse_regions(int fd, const char *list)
+{
+	uint64_t mask = 0;
+	char *str, *name, *save;
+	uint32_t region;
+
+	str = strdup(list);
+	for (name = strtok_r(str, ",", &save); name;
+	     name = strtok_r(NULL, ",", &save)) {
+		bool found = false;
+
+		xe_for_each_mem_region(fd, all_memory_regions(fd), region) {
+			if (!strcmp(name, xe_region_name(region))) {
+				mask |= region;
+				found = true;
+			}
+		}
+		igt_assert_f(found, "Unknown memory region '%s'\n", name);
+	}
+	free(str);
+
+	return mask;
+}
+
+static int parse_workloads(const char *list, unsigned int *mask)
+{
+	char *str, *name, *save;
+	int ret = 0;
+
+	*mask = 0;
+	str = strdup(list);
+	for (name = strtok_r(str, ",", &save); name;
+	     name = strtok_r(NULL, ",", &save)) {
+		int i;
+
+		for (i = 0; i < NUM_WORKLOADS; i++)
+			if (!strcmp(name, workload_names[i]))
+				break;
+
+		if (i == NUM_WORKLOADS) {
+			fprintf(stderr, "Unknown workload '%s'\n", name);
+			ret = -1;
+			break;
+		}
+		*mask |= 1u << i;
+	}
+	free(str);
+
+	return ret;
+}
+
+static const char *region_list;
+
+static int opt_handler(int opt, int opt_index, void *data)
+{
+	struct sweep *s = data;
+
+	switch (opt) {
+	case 'w':
+		if (parse_workloads(optarg, &s->workload_mask))
+			return IGT_OPT_HANDLER_ERROR;
+		break;
+	case 'm':
+		region_list = optarg;
+		break;
+	case 's':
+		s->min_size = max(strtoull(optarg, NULL, 0), 4096ull);
+		break;
+	case 'S':
+		s->max_size = strtoull(optarg, NULL, 0);
+		break;
+	case 'n':
+		s->max_threads = min(max(atoi(optarg), 1), MAX_THREADS);
+		break;
+	default:
+		return IGT_OPT_HANDLER_ERROR;
+	}
+
+	return IGT_OPT_HANDLER_SUCCESS;
+}
+
+static const char help_str[] =
+	"  -w <list>         Workloads to sweep: create,fault,bind (default all).\n"
+	"  -m <list>         Memory regions to sweep, e.g. system,vram0 (default all).\n"
+	"  -s <bytes>        Smallest object size (default 4KiB).\n"
+	"  -S <bytes>        Largest object size (default 4GiB), sizes grow 4x.\n"
+	"  -n <n>            Sweep from one to n processes, doubling (default 64).\n";
+
+int main(int argc, char **argv)
+{
+	struct sweep s = {
+		.workload_mask = -1,
+		.min_size = SZ_4K,
+		.max_size = 4ull << 30,
+		.max_threads = MAX_THREADS,
+	};
+	uint64_t alignment;
+	uint32_t region;
+
+	igt_bench_init(&s.bench, "xe_create_sweep");
+	s.bench.opts.duration = 0.2;
+	s.bench.opts.warmup = 0.05;
+	s.bench.opts.reps = 3;
+	igt_bench_parse_opts(&s.bench, argc, argv, "w:m:s:S:n:", help_str,
+			     opt_handler, &s);
+
+	s.fd = drm_open_driver(DRIVER_XE);
+	igt_bench_set_device(&s.bench, s.fd);
+	s.regions = region_list ? parse_regions(s.fd, region_list) :
+				  all_memory_regions(s.fd);
+	s.vm = xe_vm_create(s.fd, 0, 0);
+	alignment = xe_get_default_alignment(s.fd);
+
+	printf("%-6s %-7s %-19s %11s %7s %11s %9s %10s\n",
+	       "work", "region", "flags", "bytes", "threads", "ops/s",
+	       "ci95", "us/op");
+
+	for (s.workload = 0; s.workload < NUM_WORKLOADS; s.workload++) {
+		if (!(s.workload_mask & (1u << s.workload)))
+			continue;
+
+		xe_for_each_mem_region(s.fd, s.regions, region)
+		for (unsigned int flags = 0; flags <= ALL_FLAGS; flags++) {
+			if (skip_flags(s.fd, region, flags, s.workload))
+				continue;
+
+			for (uint64_t size = s.min_size; size <= s.max_size; size <<= 2) {
+				s.size = ALIGN(size, alignment);
+
+				for (unsigned int n = 1; n <= s.max_threads; n <<= 1)
+					run(&s, region, flags, n);
+			}
+		}
+	}
+
+	xe_vm_destroy(s.fd, s.vm);
+	igt_bench_fini(&s.bench);
+	drm_close_driver(s.fd);
+
+	return 0;
+}
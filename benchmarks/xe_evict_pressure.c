@@ -0,0 +1,290 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2025 Intel Corporation
+ */
+
+/*
+ * Measures what over-subscribing VRAM costs: several clients, each with its
+ * own drm fd and VM full of VRAM objects, take turns submitting, so when
+ * their objects add up to more than the available VRAM every submission
+ * has to evict the objects of the others and bring its own back in.
+ *
+ * The sweep scales the total size of the objects against the available
+ * VRAM and reports the submission throughput, how long each submission
+ * took to execute, including its swap-in, and how many bytes had to be
+ * brought back into VRAM, read from the clients' fdinfo.
+ */
+
+#include "igt.h"
+#include "igt_bench.h"
+#include "igt_drm_fdinfo.h"
+#include "igt_syncobj.h"
+#include "xe/xe_ioctl.h"
+#include "xe/xe_query.h"
+
+#define BATCH_ADDR	0x100000
+#define OBJ_BASE	(1ull << 32)
+#define SAMPLES		256
+
+struct client {
+	int fd;
+	uint32_t vm;
+	uint32_t exec_queue;
+	uint32_t syncobj;
+	uint32_t batch;
+	uint32_t *bos;
+	unsigned int num_bos;
+	unsigned int vram_region;
+};
+
+struct evict {
+	struct igt_bench bench;
+
+	int fd;
+	uint64_t vram;
+	uint64_t bo_size;
+	unsigned int num_clients;
+	struct client *clients;
+	unsigned int next;
+
+	double ratio;
+};
+
+static void client_init(struct evict *e, struct client *c, uint64_t size)
+{
+	struct drm_client_fdinfo info = {};
+	uint64_t addr = OBJ_BASE;
+	uint32_t *map;
+
+	c->fd = drm_reopen_driver(e->fd);
+	c->vm = xe_vm_create(c->fd, 0, 0);
+	c->exec_queue = xe_exec_queue_create_class(c->fd, c->vm,
+						   DRM_XE_ENGINE_CLASS_COPY);
+	c->syncobj = syncobj_create(c->fd, 0);
+
+	c->batch = xe_bo_create(c->fd, c->vm, SZ_4K, system_memory(c->fd), 0);
+	map = xe_bo_map(c->fd, c->batch, SZ_4K);
+	*map = MI_BATCH_BUFFER_END;
+	munmap(map, SZ_4K);
+	xe_vm_bind_sync(c->fd, c->vm, c->batch, 0, BATCH_ADDR, SZ_4K);
+
+	/*
+	 * VM private objects are validated into VRAM on every submission
+	 * to the VM, so the batch doesn't need to touch them.
+	 */
+	c->num_bos = DIV_ROUND_UP(size, e->bo_size);
+	c->bos = calloc(c->num_bos, sizeof(*c->bos));
+	for (unsigned int n = 0; n < c->num_bos; n++) {
+		c->bos[n] = xe_bo_create(c->fd, c->vm, e->bo_size,
+					 vram_memory(c->fd, 0), 0);
+		xe_vm_bind_sync(c->fd, c->vm, c->bos[n], 0, addr, e->bo_size);
+		addr += e->bo_size;
+	}
+
+	igt_parse_drm_fdinfo(c->fd, &info, NULL, 0, NULL, 0);
+	for (c->vram_region = 0; c->vram_region < DRM_CLIENT_FDINFO_MAX_REGIONS;
+	     c->vram_region++)
+		if (!strcmp(info.region_names[c->vram_region], "vram0"))
+			break;
+}
+
+static void client_fini(struct client *c)
+{
+	for (unsigned int n = 0; n < c->num_bos; n++)
+		gem_close(c->fd, c->bos[n]);
+	free(c->bos);
+	gem_close(c->fd, c->batch);
+	syncobj_destroy(c->fd, c->syncobj);
+	xe_exec_queue_destroy(c->fd, c->exec_queue);
+	xe_vm_destroy(c->fd, c->vm);
+	drm_close_driver(c->fd);
+}
+
+/* Bytes of the client's objects currently outside VRAM */
+static uint64_t client_evicted(struct evict *e, struct client *c)
+{
+	struct drm_client_fdinfo info = {};
+
+	if (c->vram_region == DRM_CLIENT_FDINFO_MAX_REGIONS ||
+	    !igt_parse_drm_fdinfo(c->fd, &info, NULL, 0, NULL, 0))
+		return 0;
+
+	return (uint64_t)c->num_bos * e->bo_size -
+	       min(info.region_mem[c->vram_region].resident,
+		   (uint64_t)c->num_bos * e->bo_size);
+}
+
+static void client_exec(struct client *c)
+{
+	struct drm_xe_sync sync = {
+		.type = DRM_XE_SYNC_TYPE_SYNCOBJ,
+		.flags = DRM_XE_SYNC_FLAG_SIGNAL,
+		.handle = c->syncobj,
+	};
+
+	xe_exec_sync(c->fd, c->exec_queue, BATCH_ADDR, &sync, 1);
+	igt_assert(syncobj_wait(c->fd, &c->syncobj, 1, INT64_MAX, 0, NULL));
+	syncobj_reset(c->fd, &c->syncobj, 1);
+}
+
+static void exec(void *data, unsigned int thread, unsigned long count)
+{
+	struct evict *e = data;
+
+	while (count--) {
+		client_exec(&e->clients[e->next]);
+		e->next = (e->next + 1) % e->num_clients;
+	}
+}
+
+static void sample(struct evict *e, igt_stats_t *latency, igt_stats_t *stall,
+		   double *evicted_rate)
+{
+	uint64_t evicted = 0, busy = 0;
+	struct timespec start;
+
+	for (int n = 0; n < SAMPLES; n++) {
+		struct client *c = &e->clients[e->next];
+		uint64_t bytes = client_evicted(e, c);
+		uint64_t ns;
+
+		igt_nsec_elapsed(&start);
+		client_exec(c);
+		ns = igt_nsec_elapsed(&start);
+
+		igt_stats_push_float(latency, ns * 1e-3);
+		if (bytes)
+			igt_stats_push_float(stall, ns * 1e-3);
+
+		evicted += bytes;
+		busy += ns;
+		e->next = (e->next + 1) % e->num_clients;
+	}
+
+	/* What came back in had to be evicted from VRAM to make room */
+	*evicted_rate = busy ? evicted * 1e9 / busy : 0;
+}
+
+static void run(struct evict *e)
+{
+	uint64_t total = e->ratio * e->vram;
+	uint64_t per_client = total / e->num_clients;
+	struct igt_bench_result result;
+	igt_stats_t latency, stall;
+	double evicted_rate;
+	char label[64];
+
+	if (per_client > e->vram * 9 / 10) {
+		igt_info("ratio %.2f: a client's objects don't fit in VRAM, skipping\n",
+			 e->ratio);
+		return;
+	}
+	if (total >> 20 > igt_get_avail_ram_mb()) {
+		igt_info("ratio %.2f: not enough RAM to evict into, skipping\n",
+			 e->ratio);
+		return;
+	}
+
+	e->clients = calloc(e->num_clients, sizeof(*e->clients));
+	for (unsigned int n = 0; n < e->num_clients; n++)
+		client_init(e, &e->clients[n], per_client);
+	e->next = 0;
+
+	snprintf(label, sizeof(label), "ratio=%.2f,clients=%u,bo=%"PRIu64,
+		 e->ratio, e->num_clients, e->bo_size);
+	igt_bench_run(&e->bench, label, exec, e, &result);
+
+	igt_stats_init_with_size(&latency, SAMPLES);
+	igt_stats_init_with_size(&stall, SAMPLES);
+	sample(e, &latency, &stall, &evicted_rate);
+
+	printf("%5.2f %8.1f %10.1f %10.2f %9.0f %9.0f %9.0f %7u %9.0f\n",
+	       e->ratio, result.mean, result.ci95, evicted_rate / (1 << 30),
+	       igt_stats_get_percentile(&latency, 50),
+	       igt_stats_get_percentile(&latency, 99),
+	       igt_stats_get_percentile(&latency, 99.9),
+	       stall.n_values,
+	       stall.n_values ? igt_stats_get_percentile(&stall, 99) : 0);
+
+	igt_stats_fini(&stall);
+	igt_stats_fini(&latency);
+	igt_bench_result_fini(&result);
+
+	for (unsigned int n = 0; n < e->num_clients; n++)
+		client_fini(&e->clients[n]);
+	free(e->clients);
+}
+
+static int opt_handler(int opt, int opt_index, void *data)
+{
+	struct evict *e = data;
+
+	switch (opt) {
+	case 'r':
+		e->ratio = strtod(optarg, NULL);
+		if (e->ratio <= 0)
+			return IGT_OPT_HANDLER_ERROR;
+		break;
+	case 'c':
+		e->num_clients = max(atoi(optarg), 2);
+		break;
+	case 'b':
+		e->bo_size = ALIGN(max(strtoull(optarg, NULL, 0), 1ull), SZ_64K);
+		break;
+	default:
+		return IGT_OPT_HANDLER_ERROR;
+	}
+
+	return IGT_OPT_HANDLER_SUCCESS;
+}
+
+static const char help_str[] =
+	"  -r <ratio>        Size of all objects relative to the available\n"
+	"                    VRAM, sweeps 0.5 to 3 if omitted.\n"
+	"  -c <clients>      Clients taking turns, 4 by default.\n"
+	"  -b <size>         Object size, 64MiB by default.\n"
+	"Reports submissions/s, the bytes/s brought back into VRAM, the\n"
+	"p50/p99/p99.9 submission latency in us, and the number and p99\n"
+	"latency of the sampled submissions that had to swap in first.\n";
+
+int main(int argc, char **argv)
+{
+	static const double ratios[] = { 0.5, 0.9, 1.1, 1.5, 2, 3 };
+	struct evict e = {
+		.num_clients = 4,
+		.bo_size = 64 * SZ_1M,
+	};
+	double ratio;
+
+	igt_bench_init(&e.bench, "xe_evict_pressure");
+	e.bench.opts.duration = 1;
+	igt_bench_parse_opts(&e.bench, argc, argv, "r:c:b:", help_str,
+			     opt_handler, &e);
+	ratio = e.ratio;
+	/* The clients take turns, a single process drives them all */
+	e.bench.opts.threads = 1;
+
+	e.fd = drm_open_driver(DRIVER_XE);
+	igt_require(xe_has_vram(e.fd));
+	igt_bench_set_device(&e.bench, e.fd);
+	igt_bench_set_unit(&e.bench, "execs/s", 1);
+
+	e.vram = xe_available_vram_size(e.fd, 0);
+
+	printf("%5s %8s %10s %10s %9s %9s %9s %7s %9s\n",
+	       "ratio", "execs/s", "ci95", "swapGiB/s", "p50", "p99", "p99.9",
+	       "stalls", "stall p99");
+
+	for (int n = 0; n < ARRAY_SIZE(ratios); n++) {
+		if (ratio && n)
+			break;
+
+		e.ratio = ratio ?: ratios[n];
+		run(&e);
+	}
+
+	igt_bench_fini(&e.bench);
+	drm_close_driver(e.fd);
+
+	return 0;
+}
@@ -4,17 +4,21 @@
  */
 
 #include <stdio.h>
+#include "intel_gpu_commands.h"
 #include "intel_reg.h"
+#include "igt_device.h"
+#include "igt_device_scan.h"
 #include "ioctl_wrappers.h"
 #include "lib/igt_syncobj.h"
 
+#include "xe/xe_gt.h"
 #include "xe/xe_ioctl.h"
 #include "xe/xe_query.h"
 #include "xe/xe_util.h"
 #include "xe/xe_spin.h"
 
 #define MAX_N_EXEC_QUEUES        16
-enum mode { NOP, CREATE, SWITCH };
+enum mode { NOP, CREATE, SWITCH, SCALE };
 
 static double elapsed(const struct timespec *start,
 		      const struct timespec *end)
@@ -179,6 +183,8 @@ test_exec(int fd, struct drm_xe_engine_class_instance *eci,
 	}
 }
 
+static enum igt_fork_placement placement;
+
 static int loop(unsigned int ring,
 		int reps,
 		enum mode mode,
@@ -190,6 +196,13 @@ static int loop(unsigned int ring,
 	double *shared;
 
 	fd = drm_open_driver(DRIVER_XE);
+
+	if (placement != IGT_FORK_PLACEMENT_NONE) {
+		char pci_slot[NAME_MAX];
+
+		igt_device_get_pci_slot_name(fd, pci_slot);
+		igt_fork_set_placement(placement, igt_device_get_numa_node(pci_slot));
+	}
 	shared = mmap(0, 4096, PROT_WRITE, MAP_SHARED | MAP_ANON, -1, 0);
 
 	xe_for_each_engine(fd, hwe)
@@ -221,6 +234,7 @@ static int loop(unsigned int ring,
 				break;
 
 			case NOP:
+			case SCALE:
 				break;
 			}
 			count++;
@@ -240,16 +254,438 @@ static int loop(unsigned int ring,
 	return 0;
 }
 
+/*
+ * SCALE: N processes submitting to M exec queues spread over every engine
+ * class and GT, as plain, virtual (load balanced over the engines of a class)
+ * or parallel (one batch per engine of a class at once) exec queues.
+ *
+ * Each batch stores RING_TIMESTAMP when it starts. The timestamps are turned
+ * into CLOCK_MONOTONIC through the ENGINE_CYCLES query, done on one engine
+ * per GT, which gives the latency from just before the exec ioctl to the
+ * start of the batch.
+ */
+enum queue_kind { QUEUE_SINGLE, QUEUE_VIRTUAL, QUEUE_PARALLEL };
+
+#define MAX_SCALE_QUEUES	256
+#define SCALE_SLOTS		256
+#define SCALE_BATCH		64
+#define MAX_LATENCIES		(1 << 16)
+#define MAX_GT			8
+#define SCALE_ADDR		(1ull << 32)
+#define RING_TIMESTAMP		0x358
+
+struct scale_queue {
+	uint32_t id;
+	uint16_t gt;
+	uint16_t width;
+	char name[32];
+};
+
+struct scale_clock {
+	uint64_t cpu_ns;
+	uint32_t cycles;
+	uint32_t frequency;
+};
+
+struct scale_child {
+	uint64_t execs;
+	unsigned int num_latencies;
+	uint32_t latencies[MAX_LATENCIES]; /* ns */
+};
+
+struct scale {
+	int fd;
+	uint32_t vm;
+	uint32_t bo;
+	void *map;
+	struct scale_queue queues[MAX_SCALE_QUEUES];
+	unsigned int num_queues;
+	struct scale_clock clocks[MAX_GT];
+
+	/* Shared with the children */
+	uint64_t *queue_execs;
+	struct scale_child *children;
+};
+
+static uint64_t scale_batch_offset(unsigned int q, unsigned int slot)
+{
+	return ((uint64_t)q * SCALE_SLOTS + slot) * SCALE_BATCH;
+}
+
+static uint64_t scale_ts_offset(unsigned int q, unsigned int slot)
+{
+	return scale_batch_offset(MAX_SCALE_QUEUES, 0) + SCALE_BATCH +
+	       ((uint64_t)q * SCALE_SLOTS + slot) * sizeof(uint32_t);
+}
+
+/* The batch run by all but the first engine of parallel queues */
+static uint64_t scale_nop_offset(void)
+{
+	return scale_batch_offset(MAX_SCALE_QUEUES, 0);
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void scale_calibrate(struct scale *s)
+{
+	struct drm_xe_engine_class_instance *hwe;
+	bool done[MAX_GT] = {};
+
+	xe_for_each_engine(s->fd, hwe) {
+		struct drm_xe_query_engine_cycles cycles = {
+			.eci = *hwe,
+			.clockid = CLOCK_MONOTONIC,
+		};
+		struct drm_xe_device_query query = {
+			.query = DRM_XE_DEVICE_QUERY_ENGINE_CYCLES,
+			.size = sizeof(cycles),
+			.data = to_user_pointer(&cycles),
+		};
+		struct scale_clock *c = &s->clocks[hwe->gt_id];
+
+		if (hwe->gt_id >= MAX_GT || done[hwe->gt_id])
+			continue;
+
+		do_ioctl(s->fd, DRM_IOCTL_XE_DEVICE_QUERY, &query);
+		c->cpu_ns = cycles.cpu_timestamp + cycles.cpu_delta / 2;
+		c->cycles = cycles.engine_cycles;
+		c->frequency = drm_xe_get_gt(xe_device_get(s->fd),
+					     hwe->gt_id)->reference_clock;
+		done[hwe->gt_id] = true;
+	}
+}
+
+static void scale_add_queue(struct scale *s, uint16_t gt, uint16_t width,
+			    uint16_t num_placements,
+			    struct drm_xe_engine_class_instance *eci,
+			    const char *name)
+{
+	struct scale_queue *q = &s->queues[s->num_queues];
+
+	if (s->num_queues == MAX_SCALE_QUEUES || gt >= MAX_GT)
+		return;
+
+	if (__xe_exec_queue_create(s->fd, s->vm, width, num_placements, eci, 0,
+				   &q->id))
+		return;
+
+	q->gt = gt;
+	q->width = width;
+	snprintf(q->name, sizeof(q->name), "%s", name);
+	s->num_queues++;
+}
+
+/* Creates @count exec queues, or one per engine or class if 0 */
+static void scale_create_queues(struct scale *s, enum queue_kind kind,
+				unsigned int count)
+{
+	for (unsigned int round = 0; !round || s->num_queues < count; round++) {
+		unsigned int before = s->num_queues;
+		int gt;
+
+		if (kind == QUEUE_SINGLE) {
+			struct drm_xe_engine_class_instance *hwe;
+
+			xe_for_each_engine(s->fd, hwe) {
+				char name[32];
+
+				if (count && s->num_queues == count)
+					break;
+
+				snprintf(name, sizeof(name), "%s%u@gt%u",
+					 xe_engine_class_short_string(hwe->engine_class),
+					 hwe->engine_instance, hwe->gt_id);
+				scale_add_queue(s, hwe->gt_id, 1, 1, hwe, name);
+			}
+		} else {
+			xe_for_each_gt(s->fd, gt) {
+				for (int class = 0; class <= DRM_XE_ENGINE_CLASS_COMPUTE; class++) {
+					struct drm_xe_engine_class_instance eci[XE_MAX_ENGINE_INSTANCE];
+					char name[32];
+					int n;
+
+					if (count && s->num_queues == count)
+						break;
+
+					n = xe_gt_fill_engines_by_class(s->fd, gt, class, eci);
+					if (n < 2)
+						continue;
+
+					snprintf(name, sizeof(name), "%s%s%d@gt%d",
+						 xe_engine_class_short_string(class),
+						 kind == QUEUE_VIRTUAL ? "*" : "x", n, gt);
+					if (kind == QUEUE_VIRTUAL)
+						scale_add_queue(s, gt, 1, n, eci, name);
+					else
+						scale_add_queue(s, gt, n, 1, eci, name);
+				}
+			}
+		}
+
+		/* Nothing more can be created */
+		if (s->num_queues == before || !count)
+			break;
+	}
+}
+
+static void scale_setup(struct scale *s, enum queue_kind kind,
+			unsigned int count, unsigned int nchild)
+{
+	uint64_t size = scale_ts_offset(MAX_SCALE_QUEUES, 0);
+	uint32_t *nop;
+
+	s->vm = xe_vm_create(s->fd, 0, 0);
+	scale_create_queues(s, kind, count);
+	igt_require_f(s->num_queues, "No exec queue of this kind\n");
+
+	size = xe_bb_size(s->fd, size);
+	s->bo = xe_bo_create(s->fd, s->vm, size, system_memory(s->fd), 0);
+	s->map = xe_bo_map(s->fd, s->bo, size);
+
+	for (unsigned int q = 0; q < s->num_queues; q++) {
+		for (unsigned int slot = 0; slot < SCALE_SLOTS; slot++) {
+			uint32_t *cs = s->map + scale_batch_offset(q, slot);
+			uint64_t ts = SCALE_ADDR + scale_ts_offset(q, slot);
+
+			*cs++ = MI_STORE_REGISTER_MEM_GEN8 | MI_CS_MMIO_DST;
+			*cs++ = RING_TIMESTAMP;
+			*cs++ = ts;
+			*cs++ = ts >> 32;
+			*cs++ = MI_BATCH_BUFFER_END;
+		}
+	}
+	nop = s->map + scale_nop_offset();
+	*nop = MI_BATCH_BUFFER_END;
+
+	xe_vm_bind_sync(s->fd, s->vm, s->bo, 0, SCALE_ADDR, size);
+
+	s->queue_execs = mmap(0, sizeof(uint64_t) * MAX_SCALE_QUEUES,
+			      PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANON,
+			      -1, 0);
+	s->children = mmap(0, sizeof(*s->children) * nchild,
+			   PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANON,
+			   -1, 0);
+	igt_assert(s->queue_execs != MAP_FAILED && s->children != MAP_FAILED);
+}
+
+static void scale_exec(struct scale *s, unsigned int q, unsigned int slot,
+		       uint32_t syncobj)
+{
+	struct drm_xe_sync sync = {
+		.type = DRM_XE_SYNC_TYPE_SYNCOBJ,
+		.flags = DRM_XE_SYNC_FLAG_SIGNAL,
+		.handle = syncobj,
+	};
+	uint64_t addr[XE_MAX_ENGINE_INSTANCE];
+	struct drm_xe_exec exec = {
+		.exec_queue_id = s->queues[q].id,
+		.num_batch_buffer = s->queues[q].width,
+		.num_syncs = syncobj ? 1 : 0,
+		.syncs = to_user_pointer(&sync),
+	};
+
+	addr[0] = SCALE_ADDR + (slot < SCALE_SLOTS ?
+				scale_batch_offset(q, slot) : scale_nop_offset());
+	for (unsigned int i = 1; i < s->queues[q].width; i++)
+		addr[i] = SCALE_ADDR + scale_nop_offset();
+	exec.address = exec.num_batch_buffer > 1 ? to_user_pointer(addr) : addr[0];
+
+	xe_exec(s->fd, &exec);
+}
+
+/* Waits for the submissions to @q and records their latencies */
+static void scale_harvest(struct scale *s, struct scale_child *res,
+			  unsigned int q, uint32_t syncobj,
+			  const uint64_t *submitted, unsigned int first,
+			  unsigned int last)
+{
+	const struct scale_clock *c = &s->clocks[s->queues[q].gt];
+
+	igt_assert(syncobj_wait(s->fd, &syncobj, 1, INT64_MAX, 0, NULL));
+	syncobj_reset(s->fd, &syncobj, 1);
+
+	for (unsigned int slot = first; slot < last; slot++) {
+		uint32_t ts = *(volatile uint32_t *)(s->map + scale_ts_offset(q, slot));
+		uint64_t start = c->cpu_ns +
+				 (uint32_t)(ts - c->cycles) * 1000000000ull / c->frequency;
+
+		if (res->num_latencies < MAX_LATENCIES)
+			res->latencies[res->num_latencies++] =
+				start > submitted[slot] ?
+				min(start - submitted[slot], (uint64_t)UINT32_MAX) : 0;
+	}
+}
+
+static void scale_child(struct scale *s, unsigned int child,
+			unsigned int nchild, double duration)
+{
+	struct scale_child *res = &s->children[child];
+	unsigned int queues[MAX_SCALE_QUEUES], first[MAX_SCALE_QUEUES];
+	unsigned int next[MAX_SCALE_QUEUES], last[MAX_SCALE_QUEUES];
+	uint32_t syncobjs[MAX_SCALE_QUEUES];
+	uint64_t *submitted;
+	unsigned int count = 0;
+	uint64_t end;
+
+	/* The queues of this child, or its share of the slots of one queue */
+	if (s->num_queues >= nchild) {
+		for (unsigned int q = child; q < s->num_queues; q += nchild) {
+			first[count] = 0;
+			last[count] = SCALE_SLOTS;
+			queues[count++] = q;
+		}
+	} else {
+		unsigned int q = child % s->num_queues;
+		unsigned int sharers = (nchild - 1 - q) / s->num_queues + 1;
+		unsigned int k = child / s->num_queues;
+
+		first[count] = k * SCALE_SLOTS / sharers;
+		last[count] = (k + 1) * SCALE_SLOTS / sharers;
+		queues[count++] = q;
+	}
+
+	submitted = calloc(SCALE_SLOTS * MAX_SCALE_QUEUES, sizeof(*submitted));
+	igt_assert(submitted);
+	for (unsigned int i = 0; i < count; i++) {
+		syncobjs[i] = syncobj_create(s->fd, 0);
+		next[i] = first[i];
+	}
+
+	end = now_ns() + duration * 1e9;
+	while (now_ns() < end) {
+		for (unsigned int i = 0; i < count; i++) {
+			unsigned int q = queues[i], slot = next[i]++;
+			uint64_t *sub = submitted + q * SCALE_SLOTS;
+
+			sub[slot] = now_ns();
+			scale_exec(s, q, slot,
+				   next[i] == last[i] ? syncobjs[i] : 0);
+			__atomic_add_fetch(&s->queue_execs[q], 1, __ATOMIC_RELAXED);
+			res->execs++;
+
+			if (next[i] == last[i]) {
+				scale_harvest(s, res, q, syncobjs[i], sub,
+					      first[i], last[i]);
+				next[i] = first[i];
+			}
+		}
+	}
+
+	/* Flush the partial rounds with an extra nop */
+	for (unsigned int i = 0; i < count; i++) {
+		unsigned int q = queues[i];
+
+		if (next[i] != first[i]) {
+			scale_exec(s, q, SCALE_SLOTS, syncobjs[i]);
+			scale_harvest(s, res, q, syncobjs[i],
+				      submitted + q * SCALE_SLOTS,
+				      first[i], next[i]);
+		}
+		syncobj_destroy(s->fd, syncobjs[i]);
+	}
+	free(submitted);
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void scale_report(struct scale *s, unsigned int nchild,
+			 double duration)
+{
+	uint32_t *all;
+	uint64_t total = 0;
+	unsigned int n = 0;
+
+	for (unsigned int q = 0; q < s->num_queues; q++) {
+		printf("%-16s %12.0f exec/s\n", s->queues[q].name,
+		       s->queue_execs[q] / duration);
+		total += s->queue_execs[q];
+	}
+
+	all = malloc(sizeof(*all) * MAX_LATENCIES * nchild);
+	igt_assert(all);
+	for (unsigned int c = 0; c < nchild; c++) {
+		memcpy(all + n, s->children[c].latencies,
+		       sizeof(*all) * s->children[c].num_latencies);
+		n += s->children[c].num_latencies;
+	}
+	qsort(all, n, sizeof(*all), cmp_u32);
+
+	printf("%-16s %12.0f exec/s", "total", total / duration);
+	if (n)
+		printf(", submit to start p50 %.1fus, p90 %.1fus, p99 %.1fus, max %.1fus",
+		       all[n / 2] / 1e3, all[n * 9 / 10] / 1e3,
+		       all[n * 99 / 100] / 1e3, all[n - 1] / 1e3);
+	printf("\n");
+	fflush(stdout);
+
+	free(all);
+}
+
+static int scale(enum queue_kind kind, unsigned int count, int reps,
+		 int nchild)
+{
+	const double duration = 2.;
+	struct scale s = {};
+
+	s.fd = drm_open_driver(DRIVER_XE);
+
+	if (placement != IGT_FORK_PLACEMENT_NONE) {
+		char pci_slot[NAME_MAX];
+
+		igt_device_get_pci_slot_name(s.fd, pci_slot);
+		igt_fork_set_placement(placement, igt_device_get_numa_node(pci_slot));
+	}
+
+	scale_setup(&s, kind, count, nchild);
+	printf("%u exec queues, %d processes\n", s.num_queues, nchild);
+
+	while (reps--) {
+		sleep(1); /* wait for the hw to go back to sleep */
+
+		memset(s.queue_execs, 0, sizeof(uint64_t) * MAX_SCALE_QUEUES);
+		memset(s.children, 0, sizeof(*s.children) * nchild);
+		scale_calibrate(&s);
+
+		igt_fork(child, nchild)
+			scale_child(&s, child, nchild, duration);
+		igt_waitchildren();
+
+		scale_report(&s, nchild, duration);
+	}
+
+	for (unsigned int q = 0; q < s.num_queues; q++)
+		xe_exec_queue_destroy(s.fd, s.queues[q].id);
+	gem_close(s.fd, s.bo);
+	xe_vm_destroy(s.fd, s.vm);
+	drm_close_driver(s.fd);
+
+	return 0;
+}
+
 int main(int argc, char **argv)
 {
 	unsigned int ring = DRM_XE_ENGINE_CLASS_RENDER;
 	unsigned int flags = 0;
+	enum queue_kind kind = QUEUE_SINGLE;
+	unsigned int queues = 0;
 	enum mode mode = NOP;
 	int reps = 1;
 	int ncpus = 1;
 	int c;
 
-	while ((c = getopt(argc, argv, "e:r:b:f")) != -1) {
+	while ((c = getopt(argc, argv, "e:r:b:fP:n:q:k:")) != -1) {
 		switch (c) {
 		case 'e':
 			if (strcmp(optarg, "rcs") == 0)
@@ -273,10 +709,36 @@ int main(int argc, char **argv)
 				mode = SWITCH;
 			else if (strcmp(optarg, "nop") == 0)
 				mode = NOP;
+			else if (strcmp(optarg, "scale") == 0)
+				mode = SCALE;
+			else
+				abort();
+			break;
+
+		case 'k':
+			if (strcmp(optarg, "single") == 0)
+				kind = QUEUE_SINGLE;
+			else if (strcmp(optarg, "virtual") == 0)
+				kind = QUEUE_VIRTUAL;
+			else if (strcmp(optarg, "parallel") == 0)
+				kind = QUEUE_PARALLEL;
 			else
 				abort();
 			break;
 
+		case 'q':
+			queues = min(atoi(optarg), MAX_SCALE_QUEUES);
+			break;
+
+		case 'n':
+			ncpus = max(atoi(optarg), 1);
+			break;
+
+		case 'P':
+			if (!igt_fork_placement_from_string(optarg, &placement))
+				abort();
+			break;
+
 		case 'f':
 			ncpus = sysconf(_SC_NPROCESSORS_ONLN);
 			break;
@@ -292,5 +754,8 @@ int main(int argc, char **argv)
 		}
 	}
 
+	if (mode == SCALE)
+		return scale(kind, queues, reps, ncpus);
+
 	return loop(ring, reps, mode, ncpus, flags);
 }
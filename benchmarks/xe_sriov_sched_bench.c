@@ -0,0 +1,286 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2025 Intel Corporation
+ */
+
+/*
+ * Measures how fairly the engine time is shared between the PF and its VFs
+ * when all of them keep it busy at once.
+ *
+ * The PF and VFs are provisioned with an execution quantum and a preemption
+ * timeout in a single xe_sriov_config_apply(). Each function then runs a
+ * thread that submits preemptible spinners of a fixed GPU time to the first
+ * engine, one after another, until the end of the run.
+ *
+ * With the engine saturated, the GuC gives each function its quantum in
+ * turn. A function should therefore complete a share of all the jobs equal
+ * to its share of the sum of the quanta. The time a job spends off the
+ * engine, beyond its own GPU time, should be bounded by the quanta of the
+ * other functions. How far it goes past that bound is the time the switches
+ * between the functions took, preemptions included.
+ */
+
+#include <getopt.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "igt.h"
+#include "igt_sriov_device.h"
+#include "igt_stats.h"
+#include "igt_syncobj.h"
+#include "xe/xe_ioctl.h"
+#include "xe/xe_query.h"
+#include "xe/xe_spin.h"
+#include "xe/xe_sriov_provisioning.h"
+
+struct fn {
+	unsigned int vf_num;
+	int fd;
+	uint32_t vm, exec_queue;
+	struct xe_spin_array *spin;
+	uint32_t exec_quantum_ms;
+
+	pthread_t thread;
+	pthread_barrier_t *barrier;
+	uint64_t end_ns;
+
+	unsigned int jobs, early;
+	igt_stats_t delay;
+};
+
+static uint64_t job_ns = 2000000;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static void fn_init(struct fn *f, int fd, unsigned int vf_num)
+{
+	struct drm_xe_engine_class_instance *hwe = &xe_engine(fd, 0)->instance;
+
+	f->fd = fd;
+	f->vf_num = vf_num;
+	f->vm = xe_vm_create(fd, 0, 0);
+	f->exec_queue = xe_exec_queue_create(fd, f->vm, hwe, 0);
+	f->spin = xe_spin_array_create_opts(fd, f->vm, 1, 0,
+					    .addr = 0x1a0000,
+					    .preempt = true,
+					    .ctx_ticks = xe_spin_nsec_to_ticks(fd, hwe->gt_id,
+									       job_ns));
+	igt_stats_init(&f->delay);
+}
+
+static void fn_fini(struct fn *f)
+{
+	xe_spin_array_destroy(f->spin);
+	xe_exec_queue_destroy(f->fd, f->exec_queue);
+	xe_vm_destroy(f->fd, f->vm);
+	igt_stats_fini(&f->delay);
+	drm_close_driver(f->fd);
+}
+
+static void *fn_thread(void *data)
+{
+	struct fn *f = data;
+	struct xe_spin *spin = xe_spin_array_get(f->spin, 0);
+
+	pthread_barrier_wait(f->barrier);
+
+	while (now_ns() < f->end_ns) {
+		uint64_t submit = now_ns(), complete;
+
+		xe_spin_array_submit(f->spin, 0, f->exec_queue);
+		igt_assert(syncobj_wait(f->fd, f->spin->syncobjs, 1, INT64_MAX,
+					0, NULL));
+		complete = now_ns();
+
+		/* Spinners stopped by the preemption timeout end early */
+		if (f->spin->opts.ctx_ticks > ~spin->ticks_delta) {
+			f->early++;
+			continue;
+		}
+
+		f->jobs++;
+		igt_stats_push(&f->delay,
+			       complete - submit > job_ns ? complete - submit - job_ns : 0);
+	}
+
+	return NULL;
+}
+
+static void report(struct fn *fns, unsigned int count, double run_s)
+{
+	uint64_t sum_eq = 0, jobs = 0;
+	unsigned int i;
+
+	for (i = 0; i < count; i++) {
+		sum_eq += fns[i].exec_quantum_ms;
+		jobs += fns[i].jobs;
+	}
+
+	printf("%-5s %6s %8s %8s %8s %7s %9s %9s %9s %9s\n",
+	       "fn", "eq(ms)", "expected", "share", "ratio", "jobs",
+	       "p50(ms)", "p99(ms)", "max(ms)", "over(ms)");
+
+	for (i = 0; i < count; i++) {
+		struct fn *f = &fns[i];
+		double expected = (double)f->exec_quantum_ms / sum_eq;
+		double share = jobs ? (double)f->jobs / jobs : 0;
+		double bound = (sum_eq - f->exec_quantum_ms) * 1e-3;
+		char name[8];
+
+		if (f->vf_num)
+			snprintf(name, sizeof(name), "VF%u", f->vf_num);
+		else
+			strcpy(name, "PF");
+		if (!f->delay.n_values) {
+			printf("%-5s %6u %7.1f%% %8s\n", name, f->exec_quantum_ms,
+			       100 * expected, "-");
+			continue;
+		}
+
+		printf("%-5s %6u %7.1f%% %7.1f%% %8.2f %7u %9.2f %9.2f %9.2f %9.2f\n",
+		       name, f->exec_quantum_ms, 100 * expected, 100 * share,
+		       share / expected, f->jobs,
+		       igt_stats_get_median(&f->delay) * 1e-6,
+		       igt_stats_get_percentile(&f->delay, 99) * 1e-6,
+		       igt_stats_get_max(&f->delay) * 1e-6,
+		       max(igt_stats_get_max(&f->delay) * 1e-9 - bound, 0.) * 1e3);
+
+		if (f->early)
+			printf("      %u jobs ended early by the preemption timeout\n",
+			       f->early);
+	}
+
+	printf("%"PRIu64" jobs of %.1fms in %.1fs, %.1f%% engine busy\n",
+	       jobs, job_ns * 1e-6, run_s, 100 * jobs * job_ns * 1e-9 / run_s);
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"Usage: %s [options]\n"
+		"  -n <vfs>        Number of VFs to enable, all by default\n"
+		"  -q <ms>         Execution quantum, 16ms by default\n"
+		"  -p <us>         Preemption timeout, 10000us by default\n"
+		"  -W              Weight the quanta, function n getting (n %% 4 + 1) quanta\n"
+		"  -j <ms>         GPU time of each job, 2ms by default\n"
+		"  -t <s>          Duration of the run, 5s by default\n"
+		"Reports, for the PF and each VF, its expected and measured share of\n"
+		"the jobs completed and the time its jobs waited off the engine,\n"
+		"'over' being the longest wait beyond the quanta of the others.\n",
+		name);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int num_vfs = 0, exec_quantum_ms = 16, preempt_timeout_us = 10000;
+	unsigned int run_s = 5, count, i, gt;
+	struct xe_sriov_config *cfg;
+	pthread_barrier_t barrier;
+	bool weighted = false;
+	struct fn *fns;
+	uint64_t start, end_ns;
+	int pf, c;
+
+	while ((c = getopt(argc, argv, "n:q:p:Wj:t:h")) != -1) {
+		switch (c) {
+		case 'n':
+			num_vfs = atoi(optarg);
+			break;
+		case 'q':
+			exec_quantum_ms = max(atoi(optarg), 1);
+			break;
+		case 'p':
+			preempt_timeout_us = atoi(optarg);
+			break;
+		case 'W':
+			weighted = true;
+			break;
+		case 'j':
+			job_ns = max(atoi(optarg), 1) * 1000000ull;
+			break;
+		case 't':
+			run_s = max(atoi(optarg), 1);
+			break;
+		default:
+			usage(argv[0]);
+			return c == 'h' ? 0 : 1;
+		}
+	}
+
+	pf = drm_open_driver(DRIVER_XE);
+	igt_require(igt_sriov_is_pf(pf));
+	igt_require(igt_sriov_get_enabled_vfs(pf) == 0);
+	if (!num_vfs || num_vfs > igt_sriov_get_total_vfs(pf))
+		num_vfs = igt_sriov_get_total_vfs(pf);
+	count = num_vfs + 1;
+
+	fns = calloc(count, sizeof(*fns));
+	igt_assert(fns);
+
+	cfg = xe_sriov_config_create(pf, num_vfs);
+	for (i = 0; i < count; i++) {
+		fns[i].exec_quantum_ms = exec_quantum_ms * (weighted ? i % 4 + 1 : 1);
+		xe_for_each_gt(pf, gt) {
+			xe_sriov_config_set_exec_quantum_ms(cfg, i, gt,
+							    fns[i].exec_quantum_ms);
+			xe_sriov_config_set_preempt_timeout_us(cfg, i, gt,
+							       preempt_timeout_us);
+		}
+	}
+	cfg->probe = true;
+
+	start = now_ns();
+	xe_sriov_config_apply(pf, cfg);
+	printf("Provisioned and probed %u VFs in %.1fms\n", num_vfs,
+	       (now_ns() - start) * 1e-6);
+
+	fn_init(&fns[0], drm_reopen_driver(pf), 0);
+	for (i = 1; i < count; i++) {
+		int fd = igt_sriov_open_vf_drm_device(pf, i);
+
+		igt_assert_fd(fd);
+		fn_init(&fns[i], fd, i);
+	}
+
+	pthread_barrier_init(&barrier, NULL, count);
+	end_ns = now_ns() + (uint64_t)run_s * NSEC_PER_SEC;
+	for (i = 0; i < count; i++) {
+		fns[i].barrier = &barrier;
+		fns[i].end_ns = end_ns;
+		igt_assert_eq(pthread_create(&fns[i].thread, NULL, fn_thread,
+					     &fns[i]), 0);
+	}
+	for (i = 0; i < count; i++)
+		pthread_join(fns[i].thread, NULL);
+	pthread_barrier_destroy(&barrier);
+
+	report(fns, count, run_s);
+
+	for (i = 0; i < count; i++)
+		fn_fini(&fns[i]);
+	free(fns);
+
+	/* Back to the defaults, without cycling the VFs just for that */
+	xe_for_each_gt(pf, gt) {
+		xe_sriov_config_set_exec_quantum_ms(cfg, XE_SRIOV_CONFIG_ALL, gt, 0);
+		xe_sriov_config_set_preempt_timeout_us(cfg, XE_SRIOV_CONFIG_ALL, gt, 0);
+	}
+	cfg->probe = false;
+	xe_sriov_config_apply(pf, cfg);
+	xe_sriov_config_destroy(cfg);
+	xe_sriov_disable_vfs_restore_auto_provisioning(pf);
+
+	drm_close_driver(pf);
+
+	return 0;
+}
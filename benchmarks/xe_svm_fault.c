@@ -0,0 +1,446 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2025 Intel Corporation
+ */
+
+/*
+ * Measures how quickly xe services GPU page faults on malloc and mmap
+ * backed memory reached through the system allocator, i.e. a fault mode VM
+ * mirroring the whole CPU address space.
+ *
+ * Each pass drops the pages of a buffer and has the GPU store a dword every
+ * stride bytes across it, so every page touched faults. With migration, the
+ * buffer prefers VRAM, so the GPU faults migrate the pages to VRAM and the
+ * CPU then reads them back, faulting them back into system memory.
+ *
+ * The mmap backed buffers come from igt_hostmem_alloc(), on the NUMA node of
+ * the GPU, so the page size backing them is what was asked for rather than
+ * whatever the transparent huge page policy of the machine makes of it.
+ *
+ * The faulting threads share one VM, as the threads of an application do.
+ * They are pthreads rather than the harness' forked processes, since the VM
+ * mirrors the address space of the process that created it.
+ */
+
+#include <pthread.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#include "igt.h"
+#include "igt_bench.h"
+#include "igt_hostmem.h"
+#include "xe/xe_ioctl.h"
+#include "xe/xe_query.h"
+
+#define USER_FENCE_VALUE	0xdeadbeefdeadbeefull
+#define FAULT_TIMEOUT		(5LL * NSEC_PER_SEC)
+
+enum backing {
+	BACKING_MALLOC,
+	BACKING_MMAP,
+	NUM_BACKINGS
+};
+
+static const char * const backing_names[NUM_BACKINGS] = {
+	[BACKING_MALLOC] = "malloc",
+	[BACKING_MMAP] = "mmap",
+};
+
+struct config {
+	uint64_t size;
+	uint64_t stride;
+	enum igt_hostmem_page page;
+	enum backing backing;
+	bool migrate;
+	unsigned int threads;
+};
+
+struct lane {
+	struct svm *svm;
+	pthread_t thread;
+	uint32_t exec_queue;
+	struct igt_hostmem mem;
+	void *buf;
+	uint32_t *batch;
+	size_t batch_size;
+	uint64_t *fence;
+	unsigned long count;
+	igt_stats_t gpu;
+	igt_stats_t cpu;
+};
+
+struct svm {
+	struct igt_bench bench;
+
+	int fd;
+	uint32_t vm;
+	unsigned int num_engines;
+	struct config cfg;
+	struct lane *lanes;
+	int node;
+
+	/* Command line filters, 0 or -1 sweeps */
+	uint64_t size;
+	uint64_t stride;
+	int page;
+	int backing;
+	int migrate;
+};
+
+static uint64_t faults_per_pass(const struct config *cfg)
+{
+	uint64_t page_size = igt_hostmem_page_size(cfg->page);
+
+	if (cfg->stride >= page_size)
+		return cfg->size / cfg->stride;
+
+	return DIV_ROUND_UP(cfg->size, page_size);
+}
+
+static void *alloc_buf(struct svm *s, struct lane *l)
+{
+	const struct config *cfg = &s->cfg;
+	void *ptr;
+
+	if (cfg->backing == BACKING_MMAP) {
+		igt_hostmem_alloc(&l->mem, cfg->size, cfg->page, s->node, 0);
+		return l->mem.ptr;
+	}
+
+	ptr = aligned_alloc(igt_hostmem_page_size(cfg->page), cfg->size);
+	igt_assert(ptr);
+	madvise(ptr, cfg->size,
+		cfg->page == IGT_HOSTMEM_THP ? MADV_HUGEPAGE : MADV_NOHUGEPAGE);
+
+	return ptr;
+}
+
+static void free_buf(struct svm *s, struct lane *l)
+{
+	if (s->cfg.backing == BACKING_MMAP)
+		igt_hostmem_free(&l->mem);
+	else
+		free(l->buf);
+}
+
+static void lane_init(struct svm *s, struct lane *l, unsigned int idx)
+{
+	const struct config *cfg = &s->cfg;
+	uint64_t n_writes = cfg->size / cfg->stride;
+	uint64_t addr;
+	int b = 0;
+
+	l->svm = s;
+	l->exec_queue = xe_exec_queue_create(s->fd, s->vm,
+					     &xe_engine(s->fd, idx % s->num_engines)->instance,
+					     0);
+
+	l->buf = alloc_buf(s, l);
+	if (cfg->migrate)
+		xe_vm_madvise(s->fd, s->vm, to_user_pointer(l->buf), cfg->size,
+			      0, DRM_XE_MEM_RANGE_ATTR_PREFERRED_LOC,
+			      DRM_XE_PREFERRED_LOC_DEFAULT_DEVICE, 0);
+
+	/* The batch lives in system memory the GPU faults in once */
+	l->batch_size = ALIGN(n_writes * 16 + 4, SZ_4K);
+	l->batch = aligned_alloc(SZ_4K, l->batch_size);
+	igt_assert(l->batch);
+	for (addr = to_user_pointer(l->buf);
+	     addr < to_user_pointer(l->buf) + cfg->size;
+	     addr += cfg->stride) {
+		l->batch[b++] = MI_STORE_DWORD_IMM_GEN4;
+		l->batch[b++] = addr;
+		l->batch[b++] = addr >> 32;
+		l->batch[b++] = addr;
+	}
+	l->batch[b++] = MI_BATCH_BUFFER_END;
+
+	l->fence = mmap(NULL, SZ_4K, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	igt_assert(l->fence != MAP_FAILED);
+
+	igt_stats_init(&l->gpu);
+	igt_stats_init(&l->cpu);
+}
+
+static void lane_fini(struct svm *s, struct lane *l)
+{
+	igt_stats_fini(&l->gpu);
+	igt_stats_fini(&l->cpu);
+	munmap(l->fence, SZ_4K);
+	free(l->batch);
+	free_buf(s, l);
+	xe_exec_queue_destroy(s->fd, l->exec_queue);
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static void fault_pass(struct lane *l)
+{
+	const struct config *cfg = &l->svm->cfg;
+	struct drm_xe_sync sync = {
+		.type = DRM_XE_SYNC_TYPE_USER_FENCE,
+		.flags = DRM_XE_SYNC_FLAG_SIGNAL,
+		.addr = to_user_pointer(l->fence),
+		.timeline_value = USER_FENCE_VALUE,
+	};
+	struct drm_xe_exec exec = {
+		.exec_queue_id = l->exec_queue,
+		.num_batch_buffer = 1,
+		.address = to_user_pointer(l->batch),
+		.num_syncs = 1,
+		.syncs = to_user_pointer(&sync),
+	};
+	uint64_t faults = faults_per_pass(cfg);
+	volatile uint32_t *ptr;
+	uint64_t start;
+
+	/* Zap the pages, so the GPU faults them all in again */
+	madvise(l->buf, cfg->size, MADV_DONTNEED);
+	*l->fence = 0;
+
+	start = now_ns();
+	xe_exec(l->svm->fd, &exec);
+	xe_wait_ufence(l->svm->fd, l->fence, USER_FENCE_VALUE, l->exec_queue,
+		       FAULT_TIMEOUT);
+	igt_stats_push_float(&l->gpu, (now_ns() - start) * 1e-3 / faults);
+
+	if (!cfg->migrate)
+		return;
+
+	/* Fault the pages back from VRAM */
+	start = now_ns();
+	for (uint64_t offset = 0; offset < cfg->size; offset += cfg->stride) {
+		ptr = l->buf + offset;
+		igt_assert_eq_u32(*ptr, to_user_pointer(l->buf) + offset);
+	}
+	igt_stats_push_float(&l->cpu, (now_ns() - start) * 1e-3 / faults);
+}
+
+static void *lane_thread(void *data)
+{
+	struct lane *l = data;
+
+	for (unsigned long n = 0; n < l->count; n++)
+		fault_pass(l);
+
+	return NULL;
+}
+
+static void fault(void *data, unsigned int thread, unsigned long count)
+{
+	struct svm *s = data;
+
+	for (unsigned int t = 0; t < s->cfg.threads; t++) {
+		s->lanes[t].count = count;
+		pthread_create(&s->lanes[t].thread, NULL, lane_thread,
+			       &s->lanes[t]);
+	}
+
+	for (unsigned int t = 0; t < s->cfg.threads; t++)
+		pthread_join(s->lanes[t].thread, NULL);
+}
+
+static void merge_stats(igt_stats_t *out, struct lane *lanes,
+			unsigned int threads, bool cpu)
+{
+	igt_stats_init(out);
+	for (unsigned int t = 0; t < threads; t++) {
+		igt_stats_t *in = cpu ? &lanes[t].cpu : &lanes[t].gpu;
+
+		for (unsigned int n = 0; n < in->n_values; n++)
+			igt_stats_push_float(out, in->values_f[n]);
+	}
+}
+
+static void run(struct svm *s)
+{
+	const struct config *cfg = &s->cfg;
+	struct igt_bench_result result;
+	igt_stats_t gpu, cpu;
+	char label[128];
+
+	s->lanes = calloc(cfg->threads, sizeof(*s->lanes));
+	for (unsigned int t = 0; t < cfg->threads; t++)
+		lane_init(s, &s->lanes[t], t);
+
+	igt_bench_set_unit(&s->bench, "faults/s",
+			   cfg->threads * faults_per_pass(cfg));
+
+	snprintf(label, sizeof(label),
+		 "size=%"PRIu64",stride=%"PRIu64",page=%s"
+		 ",backing=%s,migrate=%d,threads=%u",
+		 cfg->size, cfg->stride, igt_hostmem_page_name(cfg->page),
+		 backing_names[cfg->backing], cfg->migrate, cfg->threads);
+	igt_bench_run(&s->bench, label, fault, s, &result);
+
+	merge_stats(&gpu, s->lanes, cfg->threads, false);
+	merge_stats(&cpu, s->lanes, cfg->threads, true);
+
+	printf("%10"PRIu64" %8"PRIu64" %-10s %-6s %7s %7u %12.0f %10.0f"
+	       "  gpu %.2f/%.2fus",
+	       cfg->size, cfg->stride, igt_hostmem_page_name(cfg->page),
+	       backing_names[cfg->backing], cfg->migrate ? "vram" : "-",
+	       cfg->threads, result.mean, result.ci95,
+	       igt_stats_get_median(&gpu),
+	       igt_stats_get_percentile(&gpu, 99));
+	if (cfg->migrate)
+		printf("  cpu %.2f/%.2fus",
+		       igt_stats_get_median(&cpu),
+		       igt_stats_get_percentile(&cpu, 99));
+	printf("\n");
+
+	igt_stats_fini(&gpu);
+	igt_stats_fini(&cpu);
+	igt_bench_result_fini(&result);
+
+	for (unsigned int t = 0; t < cfg->threads; t++)
+		lane_fini(s, &s->lanes[t]);
+	free(s->lanes);
+}
+
+static int opt_handler(int opt, int opt_index, void *data)
+{
+	struct svm *s = data;
+
+	switch (opt) {
+	case 's':
+		s->size = ALIGN(strtoull(optarg, NULL, 0), SZ_4K);
+		break;
+	case 'S':
+		s->stride = ALIGN(max(strtoull(optarg, NULL, 0), 4ull), 4);
+		break;
+	case 'p':
+		s->page = igt_hostmem_parse_page(optarg);
+		if (s->page < 0)
+			return IGT_OPT_HANDLER_ERROR;
+		break;
+	case 'b':
+		if (!strcmp(optarg, "malloc"))
+			s->backing = BACKING_MALLOC;
+		else if (!strcmp(optarg, "mmap"))
+			s->backing = BACKING_MMAP;
+		else
+			return IGT_OPT_HANDLER_ERROR;
+		break;
+	case 'm':
+		s->migrate = 1;
+		break;
+	case 'n':
+		s->migrate = 0;
+		break;
+	default:
+		return IGT_OPT_HANDLER_ERROR;
+	}
+
+	return IGT_OPT_HANDLER_SUCCESS;
+}
+
+static const char help_str[] =
+	"  -s <size>         Bytes accessed by each thread per pass, sweeps\n"
+	"                    2MiB and 32MiB if omitted.\n"
+	"  -S <stride>       Bytes between GPU stores, sweeps 4KiB, 64KiB\n"
+	"                    and 2MiB if omitted.\n"
+	"  -p <page>         Pages backing the buffers: 4k, thp, hugetlb-2m or\n"
+	"                    hugetlb-1g. Sweeps 4k, thp and, when enough are\n"
+	"                    reserved, hugetlb-2m if omitted. The hugetlbfs\n"
+	"                    pages imply mmap backing.\n"
+	"  -b <malloc|mmap>  How the buffers are allocated, sweeps both if\n"
+	"                    omitted.\n"
+	"  -m                Only migrate the pages to VRAM and back.\n"
+	"  -n                Only fault the pages in system memory.\n"
+	"Threads sweep in powers of two up to --threads, all faulting through\n"
+	"the same VM.\n";
+
+int main(int argc, char **argv)
+{
+	static const uint64_t sizes[] = { SZ_2M, 32 * SZ_1M };
+	static const uint64_t strides[] = { SZ_4K, SZ_64K, SZ_2M };
+	static const enum igt_hostmem_page pages[] = {
+		IGT_HOSTMEM_4K, IGT_HOSTMEM_THP, IGT_HOSTMEM_HUGETLB_2M
+	};
+	struct svm s = {
+		.page = -1,
+		.backing = -1,
+		.migrate = -1,
+	};
+	struct drm_xe_engine_class_instance *hwe;
+	unsigned int max_threads;
+	struct config *cfg = &s.cfg;
+
+	igt_bench_init(&s.bench, "xe_svm_fault");
+	s.bench.opts.duration = 1;
+	igt_bench_parse_opts(&s.bench, argc, argv, "s:S:p:b:mn", help_str,
+			     opt_handler, &s);
+	max_threads = s.bench.opts.threads;
+	s.bench.opts.threads = 1;
+
+	s.fd = drm_open_driver(DRIVER_XE);
+	igt_require(!xe_supports_faults(s.fd));
+	igt_bench_set_device(&s.bench, s.fd);
+	s.node = igt_hostmem_device_node(s.fd);
+
+	xe_for_each_engine(s.fd, hwe)
+		s.num_engines++;
+	if (s.migrate == 1)
+		igt_require(xe_has_vram(s.fd));
+
+	s.vm = xe_vm_create(s.fd, DRM_XE_VM_CREATE_FLAG_LR_MODE |
+			    DRM_XE_VM_CREATE_FLAG_FAULT_MODE, 0);
+	__xe_vm_bind_assert(s.fd, s.vm, 0, 0, 0, 0,
+			    1ull << xe_device_get(s.fd)->va_bits,
+			    DRM_XE_VM_BIND_OP_MAP,
+			    DRM_XE_VM_BIND_FLAG_CPU_ADDR_MIRROR,
+			    NULL, 0, 0, 0);
+
+	printf("%10s %8s %-10s %-6s %7s %7s %12s %10s  median/p99 per fault\n",
+	       "size", "stride", "page", "alloc", "migrate", "threads",
+	       "faults/s", "ci95");
+
+	for (int i = 0; i < ARRAY_SIZE(sizes); i++)
+	for (int j = 0; j < ARRAY_SIZE(strides); j++)
+	for (int k = 0; k < ARRAY_SIZE(pages); k++)
+	for (int b = 0; b < NUM_BACKINGS; b++)
+	for (int m = 0; m <= 1; m++) {
+		cfg->size = s.size ?: sizes[i];
+		cfg->stride = s.stride ?: strides[j];
+		cfg->page = s.page >= 0 ? s.page : pages[k];
+		cfg->backing = s.backing >= 0 ? s.backing : b;
+		cfg->migrate = s.migrate >= 0 ? s.migrate : m;
+
+		/* Run each configuration once when its values are fixed */
+		if ((s.size && i) || (s.stride && j) || (s.page >= 0 && k) ||
+		    (s.backing >= 0 && b) || (s.migrate >= 0 && m))
+			continue;
+		if (cfg->stride > cfg->size ||
+		    (cfg->page >= IGT_HOSTMEM_HUGETLB_2M &&
+		     cfg->backing != BACKING_MMAP))
+			continue;
+		/* Only sweep the hugetlbfs pages when some are reserved */
+		if (s.page < 0 && cfg->page >= IGT_HOSTMEM_HUGETLB_2M &&
+		    !igt_hostmem_has_page(cfg->page, max_threads * cfg->size))
+			continue;
+		if (cfg->migrate && !xe_has_vram(s.fd))
+			continue;
+
+		for (cfg->threads = 1; ;
+		     cfg->threads = min(2 * cfg->threads, max_threads)) {
+			run(&s);
+			if (cfg->threads == max_threads)
+				break;
+		}
+	}
+
+	igt_bench_fini(&s.bench);
+
+	xe_vm_destroy(s.fd, s.vm);
+	drm_close_driver(s.fd);
+
+	return 0;
+}
@@ -0,0 +1,386 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2025 Intel Corporation
+ */
+
+/*
+ * Measures the CPU cost of binding and unbinding memory in an xe VM, the
+ * main CPU-side overhead of Vulkan drivers on xe.
+ *
+ * Each operation binds a range of 4KiB pages of a BO or of userptr memory,
+ * in one ioctl per page or as arrays of binds, and unbinds them again. The
+ * sweep compares synchronous binds, waited on after every ioctl, with
+ * asynchronous ones, only waited on at the end of a batch, on the default
+ * and on a dedicated bind queue, and how the cost grows with the number of
+ * VMAs already in the VM. Userptr memory is backed by base pages unless
+ * another page size is asked for, and allocated on the GPU's NUMA node.
+ */
+
+#include "igt.h"
+#include "igt_bench.h"
+#include "igt_hostmem.h"
+#include "igt_syncobj.h"
+#include "intel_pat.h"
+#include "xe/xe_ioctl.h"
+#include "xe/xe_query.h"
+
+#define PAGE		SZ_4K
+#define TEST_BASE	(1ull << 32)
+#define VMA_BASE	(1ull << 40)
+#define MAX_OPS		4096
+#define LATENCY_SAMPLES	256
+
+enum obj {
+	OBJ_BO,
+	OBJ_USERPTR,
+	NUM_OBJS
+};
+
+static const char * const obj_names[NUM_OBJS] = {
+	[OBJ_BO] = "bo",
+	[OBJ_USERPTR] = "userptr",
+};
+
+struct lane {
+	uint32_t bo;
+	uint32_t queue;
+	uint32_t syncobj;
+	struct drm_xe_vm_bind_op *ops;
+};
+
+struct bind {
+	struct igt_bench bench;
+
+	int fd;
+	uint32_t vm;
+	struct igt_hostmem userptr;
+	uint32_t vma_bo;
+	unsigned int num_vmas;
+	struct lane *lanes;
+	unsigned int num_lanes;
+
+	/* Current configuration */
+	bool async;
+	bool bind_queue;
+	enum obj obj;
+	unsigned int num_ops;
+	bool unbind_all;
+
+	/* Command line filters, -1 or 0 sweeps */
+	int filter_async;
+	int filter_queue;
+	int filter_obj;
+	unsigned int filter_ops;
+	int filter_vmas;
+	enum igt_hostmem_page page;
+};
+
+static uint64_t lane_addr(unsigned int thread)
+{
+	return TEST_BASE + (uint64_t)thread * MAX_OPS * PAGE;
+}
+
+static void fill_ops(struct bind *b, unsigned int thread, uint32_t op)
+{
+	struct drm_xe_vm_bind_op *ops = b->lanes[thread].ops;
+	uint64_t addr = lane_addr(thread);
+
+	for (unsigned int i = 0; i < b->num_ops; i++) {
+		ops[i] = (struct drm_xe_vm_bind_op) {
+			.op = op,
+			.addr = addr + i * PAGE,
+			.range = PAGE,
+			.pat_index = intel_get_pat_idx_wb(b->fd),
+		};
+
+		if (op == DRM_XE_VM_BIND_OP_MAP) {
+			ops[i].obj = b->lanes[thread].bo;
+			ops[i].obj_offset = i * PAGE;
+		} else if (op == DRM_XE_VM_BIND_OP_MAP_USERPTR) {
+			ops[i].userptr = to_user_pointer(b->userptr.ptr) +
+					 i * PAGE;
+		}
+	}
+}
+
+static void submit(struct bind *b, struct lane *l, uint32_t op, bool wait)
+{
+	struct drm_xe_sync sync = {
+		.type = DRM_XE_SYNC_TYPE_SYNCOBJ,
+		.flags = DRM_XE_SYNC_FLAG_SIGNAL,
+		.handle = l->syncobj,
+	};
+	uint32_t queue = b->bind_queue ? l->queue : 0;
+
+	if (op == DRM_XE_VM_BIND_OP_UNMAP_ALL) {
+		xe_vm_unbind_all_async(b->fd, b->vm, queue, l->bo, &sync, 1);
+	} else if (b->num_ops == 1) {
+		struct drm_xe_vm_bind_op *o = &l->ops[0];
+
+		igt_assert_eq(___xe_vm_bind(b->fd, b->vm, queue, o->obj,
+					    op == DRM_XE_VM_BIND_OP_MAP_USERPTR ?
+					    o->userptr : o->obj_offset,
+					    o->addr, o->range, op, 0, &sync, 1,
+					    0, o->pat_index, 0, 0), 0);
+	} else {
+		xe_vm_bind_array(b->fd, b->vm, queue, l->ops, b->num_ops,
+				 &sync, 1);
+	}
+
+	if (wait) {
+		igt_assert(syncobj_wait(b->fd, &l->syncobj, 1, INT64_MAX, 0,
+					NULL));
+		syncobj_reset(b->fd, &l->syncobj, 1);
+	}
+}
+
+static void bind_unbind(struct bind *b, unsigned int thread, bool last)
+{
+	struct lane *l = &b->lanes[thread];
+	uint32_t map = b->obj == OBJ_BO ? DRM_XE_VM_BIND_OP_MAP :
+					  DRM_XE_VM_BIND_OP_MAP_USERPTR;
+
+	fill_ops(b, thread, map);
+	submit(b, l, map, !b->async);
+
+	if (b->unbind_all) {
+		submit(b, l, DRM_XE_VM_BIND_OP_UNMAP_ALL, !b->async || last);
+	} else {
+		fill_ops(b, thread, DRM_XE_VM_BIND_OP_UNMAP);
+		submit(b, l, DRM_XE_VM_BIND_OP_UNMAP, !b->async || last);
+	}
+}
+
+static void bind(void *data, unsigned int thread, unsigned long count)
+{
+	struct bind *b = data;
+
+	while (count--)
+		bind_unbind(b, thread, !count);
+}
+
+/* Spread the VMAs out, so neighbouring binds don't merge into one VMA */
+static void add_vmas(struct bind *b, unsigned int count)
+{
+	struct drm_xe_vm_bind_op *ops = b->lanes[0].ops;
+	struct drm_xe_sync sync = {
+		.type = DRM_XE_SYNC_TYPE_SYNCOBJ,
+		.flags = DRM_XE_SYNC_FLAG_SIGNAL,
+		.handle = b->lanes[0].syncobj,
+	};
+
+	while (b->num_vmas < count) {
+		unsigned int n = min_t(unsigned int, count - b->num_vmas, MAX_OPS);
+
+		for (unsigned int i = 0; i < n; i++)
+			ops[i] = (struct drm_xe_vm_bind_op) {
+				.op = DRM_XE_VM_BIND_OP_MAP,
+				.obj = b->vma_bo,
+				.addr = VMA_BASE + 2ull * PAGE * (b->num_vmas + i),
+				.range = PAGE,
+				.pat_index = intel_get_pat_idx_wb(b->fd),
+			};
+
+		if (n == 1)
+			xe_vm_bind_async(b->fd, b->vm, 0, b->vma_bo, 0,
+					 ops[0].addr, PAGE, &sync, 1);
+		else
+			xe_vm_bind_array(b->fd, b->vm, 0, ops, n, &sync, 1);
+		igt_assert(syncobj_wait(b->fd, &sync.handle, 1, INT64_MAX, 0,
+					NULL));
+		syncobj_reset(b->fd, &sync.handle, 1);
+
+		b->num_vmas += n;
+	}
+}
+
+static void latency(struct bind *b, double *median, double *p99)
+{
+	igt_stats_t stats;
+	struct timespec start;
+
+	igt_stats_init_with_size(&stats, LATENCY_SAMPLES);
+	for (int n = 0; n < LATENCY_SAMPLES; n++) {
+		igt_nsec_elapsed(&start);
+		bind_unbind(b, 0, true);
+		igt_stats_push_float(&stats, igt_nsec_elapsed(&start) * 1e-3);
+	}
+
+	*median = igt_stats_get_median(&stats);
+	*p99 = igt_stats_get_percentile(&stats, 99);
+	igt_stats_fini(&stats);
+}
+
+static void run(struct bind *b)
+{
+	struct igt_bench_result result;
+	double median, p99;
+	char label[128];
+
+	igt_bench_set_unit(&b->bench, "binds/s", b->num_ops);
+
+	snprintf(label, sizeof(label),
+		 "mode=%s,queue=%s,obj=%s,ops=%u,vmas=%u,unbind=%s",
+		 b->async ? "async" : "sync",
+		 b->bind_queue ? "bind" : "default",
+		 obj_names[b->obj], b->num_ops, b->num_vmas,
+		 b->unbind_all ? "all" : "range");
+	igt_bench_run(&b->bench, label, bind, b, &result);
+	latency(b, &median, &p99);
+
+	printf("%-5s %-7s %-7s %5u %7u %12.0f %10.0f %10.1f %10.1f\n",
+	       b->async ? "async" : "sync",
+	       b->bind_queue ? "bind" : "default",
+	       obj_names[b->obj], b->num_ops, b->num_vmas,
+	       result.mean, result.ci95, median, p99);
+
+	igt_bench_result_fini(&result);
+}
+
+static int opt_handler(int opt, int opt_index, void *data)
+{
+	struct bind *b = data;
+	int ret;
+
+	switch (opt) {
+	case 'a':
+		b->filter_async = 1;
+		break;
+	case 's':
+		b->filter_async = 0;
+		break;
+	case 'q':
+		if (!strcmp(optarg, "default"))
+			b->filter_queue = 0;
+		else if (!strcmp(optarg, "bind"))
+			b->filter_queue = 1;
+		else
+			return IGT_OPT_HANDLER_ERROR;
+		break;
+	case 'o':
+		if (!strcmp(optarg, "bo"))
+			b->filter_obj = OBJ_BO;
+		else if (!strcmp(optarg, "userptr"))
+			b->filter_obj = OBJ_USERPTR;
+		else
+			return IGT_OPT_HANDLER_ERROR;
+		break;
+	case 'n':
+		b->filter_ops = clamp(atoi(optarg), 1, MAX_OPS);
+		break;
+	case 'v':
+		b->filter_vmas = max(atoi(optarg), 0);
+		break;
+	case 'u':
+		b->unbind_all = true;
+		break;
+	case 'p':
+		ret = igt_hostmem_parse_page(optarg);
+		if (ret < 0)
+			return IGT_OPT_HANDLER_ERROR;
+		b->page = ret;
+		break;
+	default:
+		return IGT_OPT_HANDLER_ERROR;
+	}
+
+	return IGT_OPT_HANDLER_SUCCESS;
+}
+
+static const char help_str[] =
+	"  -a                Only asynchronous binds, waited on per batch.\n"
+	"  -s                Only synchronous binds, waited on per ioctl.\n"
+	"  -q <default|bind> Only bind on the VM's default queue or on a\n"
+	"                    dedicated bind queue per thread.\n"
+	"  -o <bo|userptr>   Only bind BO or userptr memory.\n"
+	"  -n <ops>          Binds per ioctl, sweeps 1 to 4096 if omitted.\n"
+	"  -v <vmas>         VMAs already in the VM, sweeps 0, 4096 and 65536\n"
+	"                    if omitted.\n"
+	"  -u                Unbind BOs with a single unmap-all of the BO\n"
+	"                    rather than the bound ranges. Each thread binds\n"
+	"                    its own BO.\n"
+	"  -p <page>         Pages backing userptr memory: 4k (default), thp,\n"
+	"                    hugetlb-2m or hugetlb-1g.\n"
+	"Reports the throughput of bind and unbind pairs, and the median and\n"
+	"p99 latency of binding and unbinding one batch of ops.\n";
+
+int main(int argc, char **argv)
+{
+	static const unsigned int num_ops[] = { 1, 4, 16, 64, 256, 1024, 4096 };
+	static const unsigned int num_vmas[] = { 0, 4096, 65536 };
+	struct bind b = {
+		.filter_async = -1,
+		.filter_queue = -1,
+		.filter_obj = -1,
+		.filter_vmas = -1,
+	};
+
+	igt_bench_init(&b.bench, "xe_vm_bind");
+	b.bench.opts.duration = 1;
+	igt_bench_parse_opts(&b.bench, argc, argv, "asq:o:n:v:up:", help_str,
+			     opt_handler, &b);
+
+	b.fd = drm_open_driver(DRIVER_XE);
+	igt_bench_set_device(&b.bench, b.fd);
+
+	b.vm = xe_vm_create(b.fd, 0, 0);
+	b.vma_bo = xe_bo_create(b.fd, 0, PAGE, system_memory(b.fd), 0);
+	igt_hostmem_alloc(&b.userptr, MAX_OPS * PAGE, b.page,
+			  igt_hostmem_device_node(b.fd), IGT_HOSTMEM_POPULATE);
+
+	b.num_lanes = b.bench.opts.threads;
+	b.lanes = calloc(b.num_lanes, sizeof(*b.lanes));
+	for (unsigned int t = 0; t < b.num_lanes; t++) {
+		b.lanes[t].bo = xe_bo_create(b.fd, 0, MAX_OPS * PAGE,
+					     system_memory(b.fd), 0);
+		b.lanes[t].queue = xe_bind_exec_queue_create(b.fd, b.vm, 0);
+		b.lanes[t].syncobj = syncobj_create(b.fd, 0);
+		b.lanes[t].ops = calloc(MAX_OPS, sizeof(*b.lanes[t].ops));
+	}
+
+	printf("%-5s %-7s %-7s %5s %7s %12s %10s %10s %10s\n",
+	       "mode", "queue", "obj", "ops", "vmas", "binds/s", "ci95",
+	       "p50 (us)", "p99 (us)");
+
+	/* VMAs are only ever added, so sweep them outermost */
+	for (int v = 0; v < ARRAY_SIZE(num_vmas); v++) {
+		if (b.filter_vmas >= 0 && v)
+			break;
+		add_vmas(&b, b.filter_vmas >= 0 ? b.filter_vmas : num_vmas[v]);
+
+		for (int o = 0; o < NUM_OBJS; o++)
+		for (int a = 0; a <= 1; a++)
+		for (int q = 0; q <= 1; q++)
+		for (int n = 0; n < ARRAY_SIZE(num_ops); n++) {
+			if ((b.filter_obj >= 0 && b.filter_obj != o) ||
+			    (b.filter_async >= 0 && b.filter_async != a) ||
+			    (b.filter_queue >= 0 && b.filter_queue != q) ||
+			    (b.filter_ops && n))
+				continue;
+			if (b.unbind_all && o != OBJ_BO)
+				continue;
+
+			b.obj = o;
+			b.async = a;
+			b.bind_queue = q;
+			b.num_ops = b.filter_ops ?: num_ops[n];
+			run(&b);
+		}
+	}
+
+	igt_bench_fini(&b.bench);
+
+	for (unsigned int t = 0; t < b.num_lanes; t++) {
+		free(b.lanes[t].ops);
+		syncobj_destroy(b.fd, b.lanes[t].syncobj);
+		xe_exec_queue_destroy(b.fd, b.lanes[t].queue);
+		gem_close(b.fd, b.lanes[t].bo);
+	}
+	free(b.lanes);
+	igt_hostmem_free(&b.userptr);
+	xe_vm_destroy(b.fd, b.vm);
+	gem_close(b.fd, b.vma_bo);
+	drm_close_driver(b.fd);
+
+	return 0;
+}
@@ -34,6 +34,8 @@ int amdgpu_test_exec_cs_helper(amdgpu_device_handle device, unsigned int ip_type
 	bool user_queue = ring_context->user_queue;
 	const struct amdgpu_ip_block_version *ip_block = NULL;
 	amdgpu_bo_handle *all_res;
+	struct amdgpu_bo_chunk ib_chunk;
+	bool pooled = ring_context->bo_pool && !user_queue && !expect_failure;
 
 	ip_block = get_ip_block(device, ip_type);
 	all_res = alloca(sizeof(ring_context->resources[0]) * (ring_context->res_cnt + 1));
@@ -50,12 +52,20 @@ int amdgpu_test_exec_cs_helper(amdgpu_device_handle device, unsigned int ip_type
 		/* prepare CS */
 		igt_assert(ring_context->pm4_dw <= 1024);
 		/* allocate IB */
-		r = amdgpu_bo_alloc_and_map_sync(device, 4096, 4096,
-						 AMDGPU_GEM_DOMAIN_GTT, 0, AMDGPU_VM_MTYPE_UC,
-						 &ib_result_handle, &ib_result_cpu,
-						 &ib_result_mc_address, &va_handle,
-						 ring_context->timeline_syncobj_handle,
-						 ++ring_context->point, user_queue);
+		if (pooled) {
+			r = amdgpu_bo_pool_alloc(ring_context->bo_pool, 4096, 4096,
+						 AMDGPU_GEM_DOMAIN_GTT, 0, &ib_chunk);
+			ib_result_handle = ib_chunk.bo;
+			ib_result_cpu = ib_chunk.cpu;
+			ib_result_mc_address = ib_chunk.mc_address;
+		} else {
+			r = amdgpu_bo_alloc_and_map_sync(device, 4096, 4096,
+							 AMDGPU_GEM_DOMAIN_GTT, 0, AMDGPU_VM_MTYPE_UC,
+							 &ib_result_handle, &ib_result_cpu,
+							 &ib_result_mc_address, &va_handle,
+							 ring_context->timeline_syncobj_handle,
+							 ++ring_context->point, user_queue);
+		}
 	}
 	igt_assert_eq(r, 0);
 
@@ -128,8 +138,11 @@ int amdgpu_test_exec_cs_helper(amdgpu_device_handle device, unsigned int ip_type
 				igt_assert_eq(r, 0);
 		}
 	}
-	amdgpu_bo_unmap_and_free(ib_result_handle, va_handle,
-				 ib_result_mc_address, 4096);
+	if (pooled)
+		amdgpu_bo_pool_free(ring_context->bo_pool, &ib_chunk, &fence_status);
+	else
+		amdgpu_bo_unmap_and_free(ib_result_handle, va_handle,
+					 ib_result_mc_address, 4096);
 	return r;
 }
 
@@ -379,6 +392,7 @@ void amdgpu_command_submission_write_linear_helper(amdgpu_device_handle device,
 	} else {
 		r = amdgpu_cs_ctx_create(device, &ring_context->context_handle);
 		igt_assert_eq(r, 0);
+		ring_context->bo_pool = amdgpu_bo_pool_create(device, 0);
 	}
 
 
@@ -459,6 +473,7 @@ void amdgpu_command_submission_write_linear_helper(amdgpu_device_handle device,
 	if (user_queue) {
 		ip_block->funcs->userq_destroy(device, ring_context, ip_block->type);
 	} else {
+		amdgpu_bo_pool_destroy(ring_context->bo_pool);
 		r = amdgpu_cs_ctx_free(ring_context->context_handle);
 		igt_assert_eq(r, 0);
 	}
@@ -504,6 +519,7 @@ void amdgpu_command_submission_const_fill_helper(amdgpu_device_handle device,
 	} else {
 		r = amdgpu_cs_ctx_create(device, &ring_context->context_handle);
 		igt_assert_eq(r, 0);
+		ring_context->bo_pool = amdgpu_bo_pool_create(device, 0);
 	}
 
 	for (ring_id = 0; (1 << ring_id) & available_rings; ring_id++) {
@@ -556,6 +572,7 @@ void amdgpu_command_submission_const_fill_helper(amdgpu_device_handle device,
 	if (user_queue) {
 		ip_block->funcs->userq_destroy(device, ring_context, ip_block->type);
 	} else {
+		amdgpu_bo_pool_destroy(ring_context->bo_pool);
 		r = amdgpu_cs_ctx_free(ring_context->context_handle);
 		igt_assert_eq(r, 0);
 	}
@@ -602,6 +619,7 @@ void amdgpu_command_submission_copy_linear_helper(amdgpu_device_handle device,
 	} else {
 		r = amdgpu_cs_ctx_create(device, &ring_context->context_handle);
 		igt_assert_eq(r, 0);
+		ring_context->bo_pool = amdgpu_bo_pool_create(device, 0);
 	}
 
 	for (ring_id = 0; (1 << ring_id) & available_rings; ring_id++) {
@@ -684,6 +702,7 @@ void amdgpu_command_submission_copy_linear_helper(amdgpu_device_handle device,
 	if (user_queue) {
 		ip_block->funcs->userq_destroy(device, ring_context, ip_block->type);
 	} else {
+		amdgpu_bo_pool_destroy(ring_context->bo_pool);
 		r = amdgpu_cs_ctx_free(ring_context->context_handle);
 		igt_assert_eq(r, 0);
 	}
@@ -834,3 +853,296 @@ amdgpu_command_ce_write_fence(amdgpu_device_handle dev,
 	free_cmd_base(base);
 }
 
+
+/*
+ * Pipelined submission: each CS request carries several copies of the
+ * ring context's PM4 as separate IBs, and up to @depth requests are kept
+ * in flight before waiting on the oldest one.
+ */
+
+#define PIPELINE_IB_SIZE 4096
+
+/**
+ * amdgpu_cs_pipeline_init
+ * @pipe: pipeline to set up
+ * @device: amdgpu device
+ * @ip_type: IP type to submit to
+ * @ring_context: ring, context and resources the IBs use
+ * @ibs_per_submit: IBs in each CS request
+ * @depth: CS requests kept in flight
+ *
+ * The resources of @ring_context are captured in the BO lists here, set
+ * them up before.
+ */
+void amdgpu_cs_pipeline_init(struct amdgpu_cs_pipeline *pipe,
+			     amdgpu_device_handle device, unsigned int ip_type,
+			     struct amdgpu_ring_context *ring_context,
+			     unsigned int ibs_per_submit, unsigned int depth)
+{
+	amdgpu_bo_handle *all_res;
+	unsigned int i;
+	int r;
+
+	igt_assert(!ring_context->user_queue);
+	igt_assert(ibs_per_submit && depth);
+
+	memset(pipe, 0, sizeof(*pipe));
+	pipe->device = device;
+	pipe->ip_type = ip_type;
+	pipe->ring_context = ring_context;
+	pipe->ibs_per_submit = ibs_per_submit;
+	pipe->depth = depth;
+
+	pipe->slots = calloc(depth, sizeof(*pipe->slots));
+	pipe->ib_info = calloc(ibs_per_submit, sizeof(*pipe->ib_info));
+	igt_assert(pipe->slots && pipe->ib_info);
+
+	all_res = alloca(sizeof(ring_context->resources[0]) * (ring_context->res_cnt + 1));
+	memcpy(all_res, ring_context->resources,
+	       sizeof(ring_context->resources[0]) * ring_context->res_cnt);
+
+	for (i = 0; i < depth; i++) {
+		struct amdgpu_cs_pipeline_slot *slot = &pipe->slots[i];
+
+		r = amdgpu_bo_alloc_and_map(device,
+					    PIPELINE_IB_SIZE * ibs_per_submit,
+					    4096, AMDGPU_GEM_DOMAIN_GTT, 0,
+					    &slot->ib, (void **)&slot->ib_cpu,
+					    &slot->ib_mc, &slot->va_handle);
+		igt_assert_eq(r, 0);
+
+		all_res[ring_context->res_cnt] = slot->ib;
+		r = amdgpu_bo_list_create(device, ring_context->res_cnt + 1,
+					  all_res, NULL, &slot->bo_list);
+		igt_assert_eq(r, 0);
+	}
+
+	igt_nsec_elapsed(&pipe->start);
+}
+
+static void amdgpu_cs_pipeline_fence(struct amdgpu_cs_pipeline *pipe,
+				     struct amdgpu_cs_pipeline_slot *slot,
+				     struct amdgpu_cs_fence *fence)
+{
+	memset(fence, 0, sizeof(*fence));
+	fence->context = pipe->ring_context->context_handle;
+	fence->ip_type = pipe->ip_type;
+	fence->ip_instance = 0;
+	fence->ring = pipe->ring_context->ring_id;
+	fence->fence = slot->seq_no;
+}
+
+/**
+ * amdgpu_cs_pipeline_submit
+ * @pipe: pipeline
+ * @bytes: bytes written by a single copy of the PM4
+ *
+ * Submits the ring context's current PM4 @ibs_per_submit times in a
+ * single CS request, first waiting for the request submitted @depth
+ * requests ago, whose IB buffer gets reused.
+ */
+void amdgpu_cs_pipeline_submit(struct amdgpu_cs_pipeline *pipe, uint64_t bytes)
+{
+	struct amdgpu_ring_context *ring_context = pipe->ring_context;
+	struct amdgpu_cs_pipeline_slot *slot = &pipe->slots[pipe->next];
+	struct amdgpu_cs_request ibs_request = {};
+	unsigned int i;
+	int r;
+
+	igt_assert(ring_context->pm4_dw * sizeof(uint32_t) <= PIPELINE_IB_SIZE);
+
+	if (slot->seq_no) {
+		struct amdgpu_cs_fence fence;
+		uint32_t expired;
+
+		amdgpu_cs_pipeline_fence(pipe, slot, &fence);
+		r = amdgpu_cs_query_fence_status(&fence, AMDGPU_TIMEOUT_INFINITE,
+						 0, &expired);
+		igt_assert_eq(r, 0);
+		slot->seq_no = 0;
+	}
+
+	for (i = 0; i < pipe->ibs_per_submit; i++) {
+		memcpy(slot->ib_cpu + i * PIPELINE_IB_SIZE / sizeof(uint32_t),
+		       ring_context->pm4,
+		       ring_context->pm4_dw * sizeof(*ring_context->pm4));
+
+		memset(&pipe->ib_info[i], 0, sizeof(pipe->ib_info[i]));
+		pipe->ib_info[i].ib_mc_address = slot->ib_mc + i * PIPELINE_IB_SIZE;
+		pipe->ib_info[i].size = ring_context->pm4_dw;
+	}
+
+	ibs_request.ip_type = pipe->ip_type;
+	ibs_request.ring = ring_context->ring_id;
+	ibs_request.number_of_ibs = pipe->ibs_per_submit;
+	ibs_request.ibs = pipe->ib_info;
+	ibs_request.resources = slot->bo_list;
+
+	r = amdgpu_cs_submit(ring_context->context_handle, 0, &ibs_request, 1);
+	igt_assert_eq(r, 0);
+
+	slot->seq_no = ibs_request.seq_no;
+	pipe->next = (pipe->next + 1) % pipe->depth;
+	pipe->submissions++;
+	pipe->bytes += bytes * pipe->ibs_per_submit;
+}
+
+/**
+ * amdgpu_cs_pipeline_sync
+ * @pipe: pipeline
+ *
+ * Waits for all requests in flight.
+ */
+void amdgpu_cs_pipeline_sync(struct amdgpu_cs_pipeline *pipe)
+{
+	struct amdgpu_cs_fence *fences;
+	unsigned int i, count = 0;
+	uint32_t expired;
+	int r;
+
+	fences = alloca(sizeof(*fences) * pipe->depth);
+	for (i = 0; i < pipe->depth; i++) {
+		if (!pipe->slots[i].seq_no)
+			continue;
+
+		amdgpu_cs_pipeline_fence(pipe, &pipe->slots[i], &fences[count++]);
+		pipe->slots[i].seq_no = 0;
+	}
+
+	if (!count)
+		return;
+
+	r = amdgpu_cs_wait_fences(fences, count, true, AMDGPU_TIMEOUT_INFINITE,
+				  &expired, NULL);
+	igt_assert_eq(r, 0);
+}
+
+/**
+ * amdgpu_cs_pipeline_report
+ * @pipe: pipeline
+ * @name: what the submissions did
+ *
+ * Logs the submissions/s and bytes/s achieved since the pipeline was set
+ * up, waiting for the requests in flight first.
+ */
+void amdgpu_cs_pipeline_report(struct amdgpu_cs_pipeline *pipe, const char *name)
+{
+	double elapsed;
+
+	amdgpu_cs_pipeline_sync(pipe);
+	elapsed = igt_nsec_elapsed(&pipe->start) * 1e-9;
+
+	igt_info("%s ip %u ring %d: %"PRIu64" submissions of %u IBs, depth %u: "
+		 "%.0f submissions/s, %.1f MiB/s\n",
+		 name, pipe->ip_type, pipe->ring_context->ring_id,
+		 pipe->submissions, pipe->ibs_per_submit, pipe->depth,
+		 pipe->submissions / elapsed,
+		 pipe->bytes / elapsed / (1024 * 1024));
+}
+
+/**
+ * amdgpu_cs_pipeline_fini
+ * @pipe: pipeline
+ *
+ * Waits for the requests in flight and frees the IBs.
+ */
+void amdgpu_cs_pipeline_fini(struct amdgpu_cs_pipeline *pipe)
+{
+	unsigned int i;
+	int r;
+
+	amdgpu_cs_pipeline_sync(pipe);
+
+	for (i = 0; i < pipe->depth; i++) {
+		struct amdgpu_cs_pipeline_slot *slot = &pipe->slots[i];
+
+		r = amdgpu_bo_list_destroy(slot->bo_list);
+		igt_assert_eq(r, 0);
+		amdgpu_bo_unmap_and_free(slot->ib, slot->va_handle, slot->ib_mc,
+					 PIPELINE_IB_SIZE * pipe->ibs_per_submit);
+	}
+
+	free(pipe->slots);
+	free(pipe->ib_info);
+}
+
+/**
+ * amdgpu_command_submission_pipelined_helper
+ * @device: amdgpu device
+ * @ip_block: IP block to test
+ * @ibs_per_submit: IBs in each CS request
+ * @depth: CS requests kept in flight per ring
+ * @count: CS requests per ring
+ *
+ * Runs write_linear on every ring of @ip_block with the submissions
+ * pipelined instead of waited on one by one, checks the result and logs
+ * the achieved throughput of each ring.
+ */
+void amdgpu_command_submission_pipelined_helper(amdgpu_device_handle device,
+						const struct amdgpu_ip_block_version *ip_block,
+						unsigned int ibs_per_submit,
+						unsigned int depth,
+						unsigned int count)
+{
+	const int write_length = 128;
+	const int pm4_dw = 256;
+	struct amdgpu_ring_context *ring_context;
+	struct amdgpu_cs_pipeline pipe;
+	uint32_t available_rings;
+	int r, ring_id;
+
+	ring_context = calloc(1, sizeof(*ring_context));
+	igt_assert(ring_context);
+	ring_context->write_length = write_length;
+	ring_context->pm4 = calloc(pm4_dw, sizeof(*ring_context->pm4));
+	ring_context->pm4_size = pm4_dw;
+	ring_context->res_cnt = 1;
+	igt_assert(ring_context->pm4);
+
+	r = amdgpu_query_hw_ip_info(device, ip_block->type, 0, &ring_context->hw_ip_info);
+	igt_assert_eq(r, 0);
+	available_rings = ring_context->hw_ip_info.available_rings;
+
+	r = amdgpu_cs_ctx_create(device, &ring_context->context_handle);
+	igt_assert_eq(r, 0);
+
+	for (ring_id = 0; (1 << ring_id) & available_rings; ring_id++) {
+		ring_context->ring_id = ring_id;
+
+		r = amdgpu_bo_alloc_and_map(device,
+					    ring_context->write_length * sizeof(uint32_t),
+					    4096, AMDGPU_GEM_DOMAIN_GTT, 0,
+					    &ring_context->bo,
+					    (void **)&ring_context->bo_cpu,
+					    &ring_context->bo_mc,
+					    &ring_context->va_handle);
+		igt_assert_eq(r, 0);
+
+		memset((void *)ring_context->bo_cpu, 0,
+		       ring_context->write_length * sizeof(uint32_t));
+		ring_context->resources[0] = ring_context->bo;
+
+		ip_block->funcs->write_linear(ip_block->funcs, ring_context,
+					      &ring_context->pm4_dw);
+
+		amdgpu_cs_pipeline_init(&pipe, device, ip_block->type, ring_context,
+					ibs_per_submit, depth);
+		for (unsigned int n = 0; n < count; n++)
+			amdgpu_cs_pipeline_submit(&pipe, ring_context->write_length *
+						  sizeof(uint32_t));
+		amdgpu_cs_pipeline_report(&pipe, "write-linear");
+		amdgpu_cs_pipeline_fini(&pipe);
+
+		r = ip_block->funcs->compare(ip_block->funcs, ring_context, 1);
+		igt_assert_eq(r, 0);
+
+		amdgpu_bo_unmap_and_free(ring_context->bo, ring_context->va_handle,
+					 ring_context->bo_mc,
+					 ring_context->write_length * sizeof(uint32_t));
+	}
+
+	r = amdgpu_cs_ctx_free(ring_context->context_handle);
+	igt_assert_eq(r, 0);
+	free(ring_context->pm4);
+	free(ring_context);
+}
@@ -49,4 +49,44 @@ void amdgpu_command_submission_copy_linear_helper(amdgpu_device_handle device,
 
 void  amdgpu_command_ce_write_fence(amdgpu_device_handle dev,
 					  amdgpu_context_handle ctx);
+
+struct amdgpu_cs_pipeline_slot {
+	amdgpu_bo_handle ib;
+	amdgpu_va_handle va_handle;
+	uint64_t ib_mc;
+	uint32_t *ib_cpu;
+	amdgpu_bo_list_handle bo_list;
+	uint64_t seq_no;	/* 0 when not in flight */
+};
+
+struct amdgpu_cs_pipeline {
+	amdgpu_device_handle device;
+	unsigned int ip_type;
+	struct amdgpu_ring_context *ring_context;
+
+	unsigned int ibs_per_submit;
+	unsigned int depth;
+	unsigned int next;
+	struct amdgpu_cs_pipeline_slot *slots;
+	struct amdgpu_cs_ib_info *ib_info;
+
+	uint64_t submissions;
+	uint64_t bytes;
+	struct timespec start;
+};
+
+void amdgpu_cs_pipeline_init(struct amdgpu_cs_pipeline *pipe,
+			     amdgpu_device_handle device, unsigned int ip_type,
+			     struct amdgpu_ring_context *ring_context,
+			     unsigned int ibs_per_submit, unsigned int depth);
+void amdgpu_cs_pipeline_submit(struct amdgpu_cs_pipeline *pipe, uint64_t bytes);
+void amdgpu_cs_pipeline_sync(struct amdgpu_cs_pipeline *pipe);
+void amdgpu_cs_pipeline_report(struct amdgpu_cs_pipeline *pipe, const char *name);
+void amdgpu_cs_pipeline_fini(struct amdgpu_cs_pipeline *pipe);
+
+void amdgpu_command_submission_pipelined_helper(amdgpu_device_handle device,
+						const struct amdgpu_ip_block_version *ip_block,
+						unsigned int ibs_per_submit,
+						unsigned int depth,
+						unsigned int count);
 #endif
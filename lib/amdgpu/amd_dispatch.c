@@ -3,6 +3,7 @@
 // Copyright 2022 Advanced Micro Devices, Inc.
 // Copyright 2023 Advanced Micro Devices, Inc.
 
+#include <pthread.h>
 #include <amdgpu.h>
 #include "amd_memory.h"
 #include "amd_dispatch.h"
@@ -848,3 +849,371 @@ void amdgpu_gfx_dispatch_test(amdgpu_device_handle device_handle, uint32_t ip_ty
 	}
 }
 
+
+/*
+ * Concurrent dispatch
+ *
+ * The memset or memcpy shader is loaded once and shared, each ring gets
+ * its own buffers, context and command buffer, built once and submitted
+ * over and over by a thread of its own, all rings at the same time.
+ */
+
+#define CONCURRENT_MAX_RINGS	32
+#define CONCURRENT_DEPTH	8
+
+struct dispatch_ring {
+	struct dispatch_engine *engine;
+	pthread_t thread;
+	uint32_t ring;
+
+	amdgpu_context_handle context;
+	struct amdgpu_ring_context *ring_context;	/* user queue */
+
+	amdgpu_bo_handle bo_src, bo_dst, bo_cmd;
+	amdgpu_va_handle va_src, va_dst, va_cmd;
+	uint64_t mc_src, mc_dst, mc_cmd;
+	volatile unsigned char *ptr_src, *ptr_dst;
+	uint32_t *ptr_cmd;
+	uint32_t cmd_dw;
+	amdgpu_bo_list_handle bo_list;
+
+	uint64_t seq_no[CONCURRENT_DEPTH];
+	uint64_t elapsed_ns;
+};
+
+struct dispatch_engine {
+	amdgpu_device_handle device;
+	const struct amdgpu_ip_block_version *ip_block;
+	uint32_t ip_type;
+	uint32_t version;
+	bool user_queue;
+	enum cs_type cs_type;
+	uint32_t size;
+	unsigned int count;
+
+	amdgpu_bo_handle bo_shader;
+	amdgpu_va_handle va_shader;
+	uint64_t mc_shader;
+
+	pthread_barrier_t barrier;
+	unsigned int num_rings;
+	struct dispatch_ring rings[CONCURRENT_MAX_RINGS];
+};
+
+static uint32_t buffer_desc_dw3(uint32_t version)
+{
+	switch (version) {
+	case 9:
+		return 0x74fac;
+	case 10:
+		return 0x1104bfac;
+	case 11:
+		return 0x1003dfac;
+	default:
+		return 0x1203dfac;
+	}
+}
+
+/* Buffer resource descriptor with a stride of 16 bytes */
+static void emit_buffer_desc(struct amdgpu_cmd_base *base_cmd, uint32_t reg,
+			     uint64_t addr, uint32_t size, uint32_t version)
+{
+	base_cmd->emit(base_cmd, PACKET3_COMPUTE(PKT3_SET_SH_REG, 4));
+	base_cmd->emit(base_cmd, reg);
+	base_cmd->emit(base_cmd, addr);
+	base_cmd->emit(base_cmd, (addr >> 32) | 0x100000);
+	base_cmd->emit(base_cmd, size / 16);
+	base_cmd->emit(base_cmd, buffer_desc_dw3(version));
+}
+
+static void dispatch_ring_init(struct dispatch_engine *e, struct dispatch_ring *r)
+{
+	struct amdgpu_cmd_base *base_cmd = get_cmd_base();
+	amdgpu_bo_handle resources[4];
+	int err;
+
+	if (e->user_queue) {
+		r->ring_context = calloc(1, sizeof(*r->ring_context));
+		igt_assert(r->ring_context);
+		e->ip_block->funcs->userq_create(e->device, r->ring_context, e->ip_type);
+	} else {
+		err = amdgpu_cs_ctx_create(e->device, &r->context);
+		igt_assert_eq(err, 0);
+	}
+
+	err = amdgpu_bo_alloc_and_map_sync(e->device, 4096, 4096,
+					   AMDGPU_GEM_DOMAIN_GTT, 0, AMDGPU_VM_MTYPE_UC,
+					   &r->bo_cmd, (void **)&r->ptr_cmd,
+					   &r->mc_cmd, &r->va_cmd,
+					   e->user_queue ? r->ring_context->timeline_syncobj_handle : 0,
+					   e->user_queue ? ++r->ring_context->point : 0,
+					   e->user_queue);
+	igt_assert_eq(err, 0);
+	if (e->user_queue) {
+		err = amdgpu_timeline_syncobj_wait(e->device,
+						   r->ring_context->timeline_syncobj_handle,
+						   r->ring_context->point);
+		igt_assert_eq(err, 0);
+	}
+
+	err = amdgpu_bo_alloc_and_map(e->device, e->size, 4096,
+				      AMDGPU_GEM_DOMAIN_VRAM,
+				      AMDGPU_GEM_CREATE_CPU_ACCESS_REQUIRED,
+				      &r->bo_src, (void **)&r->ptr_src,
+				      &r->mc_src, &r->va_src);
+	igt_assert_eq(err, 0);
+	memset((void *)r->ptr_src, 0x55, e->size);
+
+	err = amdgpu_bo_alloc_and_map(e->device, e->size, 4096,
+				      AMDGPU_GEM_DOMAIN_VRAM,
+				      AMDGPU_GEM_CREATE_CPU_ACCESS_REQUIRED,
+				      &r->bo_dst, (void **)&r->ptr_dst,
+				      &r->mc_dst, &r->va_dst);
+	igt_assert_eq(err, 0);
+	memset((void *)r->ptr_dst, 0, e->size);
+
+	memset(r->ptr_cmd, 0, 4096);
+	base_cmd->attach_buf(base_cmd, r->ptr_cmd, 4096);
+
+	amdgpu_dispatch_init(e->ip_type, base_cmd, e->version);
+	amdgpu_dispatch_write_cumask(base_cmd, e->version);
+	amdgpu_dispatch_write2hw(base_cmd, e->mc_shader, e->version, 0);
+
+	if (e->cs_type == CS_BUFFERCOPY) {
+		emit_buffer_desc(base_cmd, 0x240, r->mc_src, e->size, e->version);
+		emit_buffer_desc(base_cmd, 0x244, r->mc_dst, e->size, e->version);
+	} else {
+		emit_buffer_desc(base_cmd, 0x240, r->mc_dst, e->size, e->version);
+
+		/* The memset value */
+		base_cmd->emit(base_cmd, PACKET3_COMPUTE(PKT3_SET_SH_REG, 4));
+		base_cmd->emit(base_cmd, 0x244);
+		base_cmd->emit_repeat(base_cmd, 0x22222222, 4);
+	}
+
+	/* clear mmCOMPUTE_RESOURCE_LIMITS */
+	base_cmd->emit(base_cmd, PACKET3_COMPUTE(PKT3_SET_SH_REG, 1));
+	base_cmd->emit(base_cmd, 0x215);
+	base_cmd->emit(base_cmd, 0);
+
+	/* A thread group covers 1KiB */
+	base_cmd->emit(base_cmd, PACKET3_COMPUTE(PACKET3_DISPATCH_DIRECT, 3));
+	base_cmd->emit(base_cmd, e->size / 1024);
+	base_cmd->emit(base_cmd, 1);
+	base_cmd->emit(base_cmd, 1);
+	base_cmd->emit(base_cmd, 1);
+
+	base_cmd->emit_aligned(base_cmd, 7, GFX_COMPUTE_NOP);
+	r->cmd_dw = base_cmd->cdw;
+	free_cmd_base(base_cmd);
+
+	if (!e->user_queue) {
+		resources[0] = e->bo_shader;
+		resources[1] = r->bo_src;
+		resources[2] = r->bo_dst;
+		resources[3] = r->bo_cmd;
+		err = amdgpu_bo_list_create(e->device, 4, resources, NULL, &r->bo_list);
+		igt_assert_eq(err, 0);
+	}
+}
+
+static void dispatch_ring_fini(struct dispatch_engine *e, struct dispatch_ring *r)
+{
+	if (!e->user_queue)
+		amdgpu_bo_list_destroy(r->bo_list);
+
+	amdgpu_bo_unmap_and_free(r->bo_src, r->va_src, r->mc_src, e->size);
+	amdgpu_bo_unmap_and_free(r->bo_dst, r->va_dst, r->mc_dst, e->size);
+	amdgpu_bo_unmap_and_free(r->bo_cmd, r->va_cmd, r->mc_cmd, 4096);
+
+	if (e->user_queue) {
+		e->ip_block->funcs->userq_destroy(e->device, r->ring_context, e->ip_type);
+		free(r->ring_context);
+	} else {
+		amdgpu_cs_ctx_free(r->context);
+	}
+}
+
+static void dispatch_ring_wait(struct dispatch_engine *e, struct dispatch_ring *r,
+			       uint64_t seq_no)
+{
+	struct amdgpu_cs_fence fence_status = {
+		.context = r->context,
+		.ip_type = e->ip_type,
+		.ring = r->ring,
+		.fence = seq_no,
+	};
+	uint32_t expired;
+	int err;
+
+	err = amdgpu_cs_query_fence_status(&fence_status, AMDGPU_TIMEOUT_INFINITE,
+					   0, &expired);
+	igt_assert_eq(err, 0);
+	igt_assert_eq(expired, true);
+}
+
+static void *dispatch_ring_thread(void *data)
+{
+	struct dispatch_ring *r = data;
+	struct dispatch_engine *e = r->engine;
+	struct amdgpu_cs_ib_info ib_info = {
+		.ib_mc_address = r->mc_cmd,
+		.size = r->cmd_dw,
+	};
+	struct amdgpu_cs_request ibs_request = {
+		.ip_type = e->ip_type,
+		.ring = r->ring,
+		.resources = r->bo_list,
+		.number_of_ibs = 1,
+		.ibs = &ib_info,
+	};
+	struct timespec start = {};
+	unsigned int n;
+	int err;
+
+	pthread_barrier_wait(&e->barrier);
+	igt_nsec_elapsed(&start);
+
+	for (n = 0; n < e->count; n++) {
+		uint64_t *seq_no = &r->seq_no[n % CONCURRENT_DEPTH];
+
+		/* User queue submissions wait for completion themselves */
+		if (e->user_queue) {
+			r->ring_context->pm4_dw = r->cmd_dw;
+			e->ip_block->funcs->userq_submit(e->device, r->ring_context,
+							 e->ip_type, r->mc_cmd);
+			continue;
+		}
+
+		if (*seq_no)
+			dispatch_ring_wait(e, r, *seq_no);
+
+		err = amdgpu_cs_submit(r->context, 0, &ibs_request, 1);
+		igt_assert_eq(err, 0);
+		*seq_no = ibs_request.seq_no;
+	}
+
+	/* Submissions to a ring complete in order */
+	if (!e->user_queue && e->count)
+		dispatch_ring_wait(e, r, ibs_request.seq_no);
+
+	r->elapsed_ns = igt_nsec_elapsed(&start);
+
+	return NULL;
+}
+
+/**
+ * amdgpu_dispatch_concurrent_test:
+ * @device_handle: amdgpu device
+ * @ip_type: AMDGPU_HW_IP_COMPUTE or AMDGPU_HW_IP_GFX
+ * @copy: whether to run the memcpy shader instead of the memset one
+ * @size: bytes written by each dispatch, a multiple of 1KiB
+ * @count: dispatches per ring
+ * @userq: use user queues instead of the kernel rings
+ *
+ * Runs @count memset or memcpy dispatches on every available ring of
+ * @ip_type at the same time, from a thread per ring, checks the results
+ * and logs the bandwidth of each ring and of all of them together.
+ */
+void amdgpu_dispatch_concurrent_test(amdgpu_device_handle device_handle,
+				     uint32_t ip_type, bool copy,
+				     uint32_t size, unsigned int count, bool userq)
+{
+	struct dispatch_engine *e;
+	struct drm_amdgpu_info_hw_ip info;
+	uint32_t available_rings;
+	struct timespec start = {};
+	uint64_t elapsed_ns;
+	void *ptr_shader;
+	unsigned int n;
+	int r;
+
+	igt_assert(size && !(size % 1024));
+
+	r = amdgpu_query_hw_ip_info(device_handle, ip_type, 0, &info);
+	igt_assert_eq(r, 0);
+
+	if (info.hw_ip_version_major < 9 || info.hw_ip_version_major > 12) {
+		igt_info("SKIP ... unsupported gfx version %d\n",
+			 info.hw_ip_version_major);
+		return;
+	}
+
+	available_rings = userq ? (1 << info.num_userq_slots) - 1 :
+				  info.available_rings;
+	if (!available_rings) {
+		igt_info("SKIP ... no available rings\n");
+		return;
+	}
+
+	e = calloc(1, sizeof(*e));
+	igt_assert(e);
+	e->device = device_handle;
+	e->ip_block = get_ip_block(device_handle, ip_type);
+	e->ip_type = ip_type;
+	e->version = info.hw_ip_version_major;
+	e->user_queue = userq;
+	e->cs_type = copy ? CS_BUFFERCOPY : CS_BUFFERCLEAR;
+	e->size = size;
+	e->count = count;
+
+	r = amdgpu_bo_alloc_and_map(device_handle, 4096, 4096,
+				    AMDGPU_GEM_DOMAIN_VRAM, 0,
+				    &e->bo_shader, &ptr_shader,
+				    &e->mc_shader, &e->va_shader);
+	igt_assert_eq(r, 0);
+	memset(ptr_shader, 0, 4096);
+	r = amdgpu_dispatch_load_cs_shader(ptr_shader, e->cs_type, e->version);
+	igt_assert_eq(r, 0);
+
+	for (n = 0; n < CONCURRENT_MAX_RINGS; n++) {
+		struct dispatch_ring *ring = &e->rings[e->num_rings];
+
+		if (!(available_rings & (1u << n)))
+			continue;
+
+		ring->engine = e;
+		ring->ring = userq ? 0 : n;
+		dispatch_ring_init(e, ring);
+		e->num_rings++;
+	}
+
+	/* The threads start dispatching together, along with the clock */
+	pthread_barrier_init(&e->barrier, NULL, e->num_rings + 1);
+	for (n = 0; n < e->num_rings; n++) {
+		r = pthread_create(&e->rings[n].thread, NULL,
+				   dispatch_ring_thread, &e->rings[n]);
+		igt_assert_eq(r, 0);
+	}
+	pthread_barrier_wait(&e->barrier);
+	igt_nsec_elapsed(&start);
+
+	for (n = 0; n < e->num_rings; n++)
+		pthread_join(e->rings[n].thread, NULL);
+	elapsed_ns = igt_nsec_elapsed(&start);
+	pthread_barrier_destroy(&e->barrier);
+
+	for (n = 0; n < e->num_rings; n++) {
+		struct dispatch_ring *ring = &e->rings[n];
+
+		for (uint32_t i = 0; i < size; i++)
+			igt_assert_eq(ring->ptr_dst[i],
+				      copy ? ring->ptr_src[i] : 0x22);
+
+		igt_info("%s ip %u %s %u: %u dispatches of %u bytes, %.1f MiB/s\n",
+			 copy ? "memcpy" : "memset", ip_type,
+			 userq ? "user queue" : "ring", userq ? n : ring->ring,
+			 count, size,
+			 (double)count * size * 1e9 / ring->elapsed_ns / (1 << 20));
+
+		dispatch_ring_fini(e, ring);
+	}
+
+	igt_info("%s ip %u, %u %s: %.1f MiB/s\n",
+		 copy ? "memcpy" : "memset", ip_type, e->num_rings,
+		 userq ? "user queues" : "rings",
+		 (double)e->num_rings * count * size * 1e9 / elapsed_ns / (1 << 20));
+
+	amdgpu_bo_unmap_and_free(e->bo_shader, e->va_shader, e->mc_shader, 4096);
+	free(e);
+}
@@ -44,5 +44,9 @@ int amdgpu_memcpy_dispatch_test(amdgpu_device_handle device_handle,
 void amdgpu_dispatch_hang_slow_helper(amdgpu_device_handle device_handle,
 				      uint32_t ip_type, const struct pci_addr *pci, bool userq);
 
+void amdgpu_dispatch_concurrent_test(amdgpu_device_handle device_handle,
+				     uint32_t ip_type, bool copy,
+				     uint32_t size, unsigned int count, bool userq);
+
 
 #endif
@@ -204,6 +204,8 @@ struct amdgpu_ring_context {
 	uint64_t time_out;
 
 	struct drm_amdgpu_info_uq_fw_areas info;
+
+	struct amdgpu_bo_pool *bo_pool;	/* optional, the IBs are carved out of it */
 };
 
 struct amdgpu_cmd_base;
@@ -24,6 +24,7 @@
  */
 
 #include "amd_memory.h"
+#include "igt_list.h"
 #include "amd_PM4.h"
 #include "amd_ip_blocks.h"
 /**
@@ -399,3 +400,254 @@ void amdgpu_command_submission_multi_fence_wait_all(amdgpu_device_handle device,
 }
 
 
+
+/*
+ * BO pool
+ *
+ * Small buffers are carved out of large mapped slab BOs, one slab per
+ * heap, flags and power of two chunk size, so allocating and freeing
+ * them doesn't go through the BO and VA ioctls. Freed chunks can be held
+ * back until a CS fence signals, so the GPU is done with them before
+ * they get handed out again.
+ */
+
+#define BO_POOL_MIN_CHUNK	256
+#define BO_POOL_SLAB_SIZE	(1 << 20)
+
+struct amdgpu_bo_slab {
+	struct igt_list_head link;
+	amdgpu_bo_handle bo;
+	amdgpu_va_handle va_handle;
+	uint64_t mc_address;
+	void *cpu;
+	uint32_t size;
+
+	unsigned int heap;
+	uint64_t flags;
+	uint32_t chunk_size;
+	bool dedicated;		/* a single chunk too big for a slab */
+
+	uint32_t num_free;
+	uint32_t *free;		/* stack of free chunk indices */
+};
+
+struct amdgpu_bo_pool_pending {
+	struct igt_list_head link;
+	struct amdgpu_bo_slab *slab;
+	uint32_t index;
+	struct amdgpu_cs_fence fence;
+};
+
+struct amdgpu_bo_pool {
+	amdgpu_device_handle dev;
+	uint32_t slab_size;
+	struct igt_list_head slabs;
+	struct igt_list_head pending;
+};
+
+/**
+ * amdgpu_bo_pool_create
+ * @dev: amdgpu device
+ * @slab_size: size of the slab BOs, 0 for the default of 1MiB
+ *
+ * Returns: A new, empty, BO pool.
+ */
+struct amdgpu_bo_pool *
+amdgpu_bo_pool_create(amdgpu_device_handle dev, uint32_t slab_size)
+{
+	struct amdgpu_bo_pool *pool;
+
+	pool = calloc(1, sizeof(*pool));
+	igt_assert(pool);
+
+	pool->dev = dev;
+	pool->slab_size = slab_size ? ALIGN(slab_size, 4096) : BO_POOL_SLAB_SIZE;
+	IGT_INIT_LIST_HEAD(&pool->slabs);
+	IGT_INIT_LIST_HEAD(&pool->pending);
+
+	return pool;
+}
+
+static void slab_destroy(struct amdgpu_bo_slab *slab)
+{
+	igt_list_del(&slab->link);
+	amdgpu_bo_unmap_and_free(slab->bo, slab->va_handle, slab->mc_address,
+				 slab->size);
+	free(slab->free);
+	free(slab);
+}
+
+static void slab_put(struct amdgpu_bo_slab *slab, uint32_t index)
+{
+	if (slab->dedicated) {
+		slab_destroy(slab);
+		return;
+	}
+
+	slab->free[slab->num_free++] = index;
+}
+
+/* Returns the chunks whose fence signalled to their slabs */
+static void bo_pool_reap(struct amdgpu_bo_pool *pool, uint64_t timeout)
+{
+	struct amdgpu_bo_pool_pending *p, *tmp;
+
+	igt_list_for_each_entry_safe(p, tmp, &pool->pending, link) {
+		uint32_t expired = 0;
+		int r;
+
+		r = amdgpu_cs_query_fence_status(&p->fence, timeout, 0, &expired);
+		/* A failed fence means the job is gone as well */
+		if (!r && !expired)
+			continue;
+
+		igt_list_del(&p->link);
+		slab_put(p->slab, p->index);
+		free(p);
+	}
+}
+
+static struct amdgpu_bo_slab *
+slab_create(struct amdgpu_bo_pool *pool, uint32_t size, uint32_t chunk_size,
+	    unsigned int heap, uint64_t flags)
+{
+	struct amdgpu_bo_slab *slab;
+	uint32_t n;
+	int r;
+
+	slab = calloc(1, sizeof(*slab));
+	igt_assert(slab);
+
+	r = amdgpu_bo_alloc_and_map(pool->dev, size, 4096, heap, flags,
+				    &slab->bo, &slab->cpu, &slab->mc_address,
+				    &slab->va_handle);
+	if (r) {
+		free(slab);
+		return NULL;
+	}
+
+	slab->size = size;
+	slab->heap = heap;
+	slab->flags = flags;
+	slab->chunk_size = chunk_size;
+
+	slab->free = calloc(size / chunk_size, sizeof(*slab->free));
+	igt_assert(slab->free);
+	/* Hand out the chunks from the start of the slab */
+	for (n = size / chunk_size; n--; )
+		slab->free[slab->num_free++] = n;
+
+	igt_list_add(&slab->link, &pool->slabs);
+
+	return slab;
+}
+
+/**
+ * amdgpu_bo_pool_alloc
+ * @pool: BO pool
+ * @size: size of the buffer
+ * @alignment: GPU address alignment, at most 4096
+ * @heap: AMDGPU_GEM_DOMAIN_*
+ * @flags: AMDGPU_GEM_CREATE_*
+ * @chunk: returns the buffer
+ *
+ * Allocates a mapped buffer out of a slab of @pool. Buffers bigger than a
+ * quarter of a slab get a BO of their own. @chunk->bo is the BO backing
+ * the buffer, to be added to the BO lists of the submissions using it.
+ *
+ * Returns: 0 on success, the BO allocation error otherwise.
+ */
+int
+amdgpu_bo_pool_alloc(struct amdgpu_bo_pool *pool, uint32_t size,
+		     uint32_t alignment, unsigned int heap, uint64_t flags,
+		     struct amdgpu_bo_chunk *chunk)
+{
+	struct amdgpu_bo_slab *slab;
+	uint32_t chunk_size;
+
+	igt_assert(alignment <= 4096);
+
+	bo_pool_reap(pool, 0);
+
+	chunk_size = size > alignment ? size : alignment;
+	if (chunk_size < BO_POOL_MIN_CHUNK)
+		chunk_size = BO_POOL_MIN_CHUNK;
+	chunk_size = 1u << (32 - __builtin_clz(chunk_size - 1));
+
+	if (chunk_size > pool->slab_size / 4) {
+		slab = slab_create(pool, ALIGN(size, 4096), ALIGN(size, 4096),
+				   heap, flags);
+		if (!slab)
+			return -ENOMEM;
+		slab->dedicated = true;
+		goto found;
+	}
+
+	igt_list_for_each_entry(slab, &pool->slabs, link)
+		if (!slab->dedicated && slab->num_free &&
+		    slab->chunk_size == chunk_size &&
+		    slab->heap == heap && slab->flags == flags)
+			goto found;
+
+	slab = slab_create(pool, pool->slab_size, chunk_size, heap, flags);
+	if (!slab)
+		return -ENOMEM;
+
+found:
+	chunk->slab = slab;
+	chunk->index = slab->free[--slab->num_free];
+	chunk->size = size;
+	chunk->bo = slab->bo;
+	chunk->cpu = slab->cpu + chunk->index * slab->chunk_size;
+	chunk->mc_address = slab->mc_address + chunk->index * slab->chunk_size;
+
+	return 0;
+}
+
+/**
+ * amdgpu_bo_pool_free
+ * @pool: BO pool
+ * @chunk: buffer from amdgpu_bo_pool_alloc()
+ * @fence: fence of the last submission using the buffer, or NULL
+ *
+ * Returns @chunk to @pool. With a @fence, the buffer is only handed out
+ * again once the fence signalled.
+ */
+void
+amdgpu_bo_pool_free(struct amdgpu_bo_pool *pool, struct amdgpu_bo_chunk *chunk,
+		    const struct amdgpu_cs_fence *fence)
+{
+	struct amdgpu_bo_pool_pending *p;
+
+	if (!fence) {
+		slab_put(chunk->slab, chunk->index);
+		return;
+	}
+
+	p = malloc(sizeof(*p));
+	igt_assert(p);
+	p->slab = chunk->slab;
+	p->index = chunk->index;
+	p->fence = *fence;
+	igt_list_add_tail(&p->link, &pool->pending);
+}
+
+/**
+ * amdgpu_bo_pool_destroy
+ * @pool: BO pool
+ *
+ * Waits for the fences of the buffers freed with one and frees all the
+ * slab BOs. Buffers still allocated out of @pool become invalid.
+ */
+void
+amdgpu_bo_pool_destroy(struct amdgpu_bo_pool *pool)
+{
+	struct amdgpu_bo_slab *slab, *tmp;
+
+	bo_pool_reap(pool, AMDGPU_TIMEOUT_INFINITE);
+
+	igt_list_for_each_entry_safe(slab, tmp, &pool->slabs, link)
+		slab_destroy(slab);
+
+	free(pool);
+}
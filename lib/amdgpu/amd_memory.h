@@ -80,4 +80,32 @@ amdgpu_get_bo_list(amdgpu_device_handle dev, amdgpu_bo_handle bo1,
 void amdgpu_command_submission_multi_fence_wait_all(amdgpu_device_handle device,
 						    bool wait_all);
 
+struct amdgpu_bo_pool;
+struct amdgpu_bo_slab;
+
+struct amdgpu_bo_chunk {
+	amdgpu_bo_handle bo;	/* backing BO, for the BO lists */
+	void *cpu;
+	uint64_t mc_address;
+	uint32_t size;
+
+	struct amdgpu_bo_slab *slab;
+	uint32_t index;
+};
+
+struct amdgpu_bo_pool *
+amdgpu_bo_pool_create(amdgpu_device_handle dev, uint32_t slab_size);
+
+int
+amdgpu_bo_pool_alloc(struct amdgpu_bo_pool *pool, uint32_t size,
+		     uint32_t alignment, unsigned int heap, uint64_t flags,
+		     struct amdgpu_bo_chunk *chunk);
+
+void
+amdgpu_bo_pool_free(struct amdgpu_bo_pool *pool, struct amdgpu_bo_chunk *chunk,
+		    const struct amdgpu_cs_fence *fence);
+
+void
+amdgpu_bo_pool_destroy(struct amdgpu_bo_pool *pool);
+
 #endif
@@ -269,3 +269,165 @@ mm_queue_test_helper(amdgpu_device_handle device_handle, struct mmd_shared_conte
 	}
 	return r;
 }
+
+struct mmd_sessions {
+	amdgpu_device_handle device_handle;
+	unsigned int frames;
+	pthread_barrier_t barrier;
+};
+
+static void *
+mmd_session_thread(void *data)
+{
+	struct mmd_session *session = data;
+	struct mmd_sessions *sessions = session->sessions;
+	struct amdgpu_cs_ib_info ib_info = {0};
+	struct amdgpu_cs_request ibs_request = {0};
+	struct amdgpu_cs_fence fence_status = {0};
+	struct timespec start = {}, frame;
+	uint32_t expired;
+	unsigned int n;
+	int r;
+
+	ib_info.ib_mc_address = session->context.ib_mc_address;
+	ib_info.size = session->ndw;
+
+	ibs_request.ip_type = session->ip;
+	ibs_request.ring = session->ring;
+	ibs_request.resources = session->bo_list;
+	ibs_request.number_of_ibs = 1;
+	ibs_request.ibs = &ib_info;
+
+	fence_status.context = session->context.context_handle;
+	fence_status.ip_type = session->ip;
+	fence_status.ring = session->ring;
+
+	pthread_barrier_wait(&sessions->barrier);
+	igt_nsec_elapsed(&start);
+
+	/* A session decodes or encodes one frame after the other */
+	for (n = 0; n < sessions->frames; n++) {
+		memset(&frame, 0, sizeof(frame));
+		igt_nsec_elapsed(&frame);
+
+		r = amdgpu_cs_submit(session->context.context_handle, 0,
+				     &ibs_request, 1);
+		igt_assert_eq(r, 0);
+
+		fence_status.fence = ibs_request.seq_no;
+		r = amdgpu_cs_query_fence_status(&fence_status,
+						 AMDGPU_TIMEOUT_INFINITE,
+						 0, &expired);
+		igt_assert_eq(r, 0);
+
+		igt_stats_push_float(&session->latency,
+				     igt_nsec_elapsed(&frame) * 1e-3);
+	}
+
+	session->elapsed_ns = igt_nsec_elapsed(&start);
+
+	return NULL;
+}
+
+/**
+ * mmd_sessions_throughput:
+ * @device_handle: amdgpu device
+ * @ip: AMDGPU_HW_IP_* of the sessions
+ * @num_sessions: sessions running at the same time
+ * @frames: frames each session submits
+ * @prepare: sets up the resources and the IB of a session
+ * @cleanup: checks the result of a session and frees its resources
+ * @data: passed to the callbacks in the sessions
+ *
+ * Runs @num_sessions sessions concurrently, each with its own context and
+ * thread, spread over the rings, that is the instances, of @ip. The IB
+ * of a session is prepared once and then submitted @frames times, each
+ * submission waited on. Logs the frames/s of all sessions together and
+ * the distribution of the per frame latency of each session.
+ *
+ * Returns: The frames/s of all sessions together.
+ */
+double
+mmd_sessions_throughput(amdgpu_device_handle device_handle, unsigned int ip,
+			unsigned int num_sessions, unsigned int frames,
+			mmd_session_callback prepare,
+			mmd_session_callback cleanup, void *data)
+{
+	struct mmd_sessions sessions = {
+		.device_handle = device_handle,
+		.frames = frames,
+	};
+	struct drm_amdgpu_info_hw_ip info;
+	struct mmd_session *session;
+	struct timespec start = {};
+	uint64_t elapsed_ns;
+	unsigned int n, num_rings = 0;
+	uint32_t rings[32];
+	double fps;
+	int r;
+
+	r = amdgpu_query_hw_ip_info(device_handle, ip, 0, &info);
+	igt_assert_eq(r, 0);
+	for (n = 0; n < 32; n++)
+		if (info.available_rings & (1u << n))
+			rings[num_rings++] = n;
+	igt_require(num_rings);
+
+	session = calloc(num_sessions, sizeof(*session));
+	igt_assert(session);
+
+	for (n = 0; n < num_sessions; n++) {
+		session[n].sessions = &sessions;
+		session[n].data = data;
+		session[n].ip = ip;
+		session[n].ring = rings[n % num_rings];
+		igt_stats_init_with_size(&session[n].latency, frames);
+
+		r = mmd_context_init(device_handle, &session[n].context);
+		igt_assert_eq(r, 0);
+		prepare(device_handle, &session[n]);
+
+		r = amdgpu_bo_list_create(device_handle,
+					  session[n].context.num_resources,
+					  session[n].context.resources, NULL,
+					  &session[n].bo_list);
+		igt_assert_eq(r, 0);
+	}
+
+	pthread_barrier_init(&sessions.barrier, NULL, num_sessions + 1);
+	for (n = 0; n < num_sessions; n++) {
+		r = pthread_create(&session[n].thread, NULL,
+				   mmd_session_thread, &session[n]);
+		igt_assert_eq(r, 0);
+	}
+	pthread_barrier_wait(&sessions.barrier);
+	igt_nsec_elapsed(&start);
+
+	for (n = 0; n < num_sessions; n++)
+		pthread_join(session[n].thread, NULL);
+	elapsed_ns = igt_nsec_elapsed(&start);
+	pthread_barrier_destroy(&sessions.barrier);
+
+	fps = (double)num_sessions * frames * 1e9 / elapsed_ns;
+	igt_info("%u sessions on %u instances: %.1f frames/s\n",
+		 num_sessions, num_rings, fps);
+
+	for (n = 0; n < num_sessions; n++) {
+		igt_info("  session %u, instance %u: %.1f frames/s, latency p50 %.0f us, p99 %.0f us, max %.0f us\n",
+			 n, session[n].ring,
+			 frames * 1e9 / session[n].elapsed_ns,
+			 igt_stats_get_median(&session[n].latency),
+			 igt_stats_get_percentile(&session[n].latency, 99),
+			 igt_stats_get_percentile(&session[n].latency, 100));
+
+		r = amdgpu_bo_list_destroy(session[n].bo_list);
+		igt_assert_eq(r, 0);
+		cleanup(device_handle, &session[n]);
+		mmd_context_clean(device_handle, &session[n].context);
+		igt_stats_fini(&session[n].latency);
+	}
+
+	free(session);
+
+	return fps;
+}
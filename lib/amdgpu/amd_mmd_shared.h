@@ -3,6 +3,7 @@
  * Copyright 2014 Advanced Micro Devices, Inc.
  */
 
+#include <pthread.h>
 #include <amdgpu.h>
 #include "amdgpu_drm.h"
 
@@ -136,3 +137,29 @@ typedef int (*mm_test_callback) (amdgpu_device_handle device_handle, struct mmd_
 int
 mm_queue_test_helper(amdgpu_device_handle device_handle, struct mmd_shared_context *context,
 		mm_test_callback test, int err_type, const struct pci_addr *pci);
+
+struct mmd_sessions;
+
+struct mmd_session {
+	struct mmd_context context;
+	unsigned int ndw;	/* size of the prepared IB */
+	void *data;
+	void *priv;		/* for the callbacks */
+
+	unsigned int ip;
+	unsigned int ring;
+	amdgpu_bo_list_handle bo_list;
+	struct mmd_sessions *sessions;
+	pthread_t thread;
+	igt_stats_t latency;	/* us */
+	uint64_t elapsed_ns;
+};
+
+typedef void (*mmd_session_callback) (amdgpu_device_handle device_handle,
+		struct mmd_session *session);
+
+double
+mmd_sessions_throughput(amdgpu_device_handle device_handle, unsigned int ip,
+			unsigned int num_sessions, unsigned int frames,
+			mmd_session_callback prepare,
+			mmd_session_callback cleanup, void *data);
@@ -63,14 +63,39 @@ bool has_dmabuf_export_sync_file(int fd)
  * DMA_BUF_SYNC_READ, depending on if we care about the read or write fences.
  */
 int dmabuf_export_sync_file(int dmabuf, uint32_t flags)
+{
+	int sync_file;
+
+	igt_assert_eq(__dmabuf_export_sync_file(dmabuf, flags, &sync_file), 0);
+
+	return sync_file;
+}
+
+/**
+ * __dmabuf_export_sync_file:
+ * @dmabuf: The dmabuf fd
+ * @flags: The flags to control the behaviour
+ * @sync_file: Returns the exported sync file
+ *
+ * Like dmabuf_export_sync_file(), but returns the error instead of asserting,
+ * so callers can probe for support on any exporter.
+ *
+ * Returns: 0 on success, negative errno on failure.
+ */
+int __dmabuf_export_sync_file(int dmabuf, uint32_t flags, int *sync_file)
 {
 	struct igt_dma_buf_sync_file arg;
+	int err = 0;
 
 	arg.flags = flags;
 	arg.fd = -1;
-	do_ioctl(dmabuf, IGT_DMA_BUF_IOCTL_EXPORT_SYNC_FILE, &arg);
+	if (igt_ioctl(dmabuf, IGT_DMA_BUF_IOCTL_EXPORT_SYNC_FILE, &arg)) {
+		err = -errno;
+		errno = 0;
+	}
 
-	return arg.fd;
+	*sync_file = arg.fd;
+	return err;
 }
 
 /**
@@ -16,6 +16,7 @@
 bool has_dmabuf_export_sync_file(int fd);
 bool has_dmabuf_import_sync_file(int fd);
 int dmabuf_export_sync_file(int dmabuf, uint32_t flags);
+int __dmabuf_export_sync_file(int dmabuf, uint32_t flags, int *sync_file);
 void dmabuf_import_sync_file(int dmabuf, uint32_t flags, int sync_fd);
 void dmabuf_import_timeline_fence(int dmabuf, uint32_t flags,
 			     int timeline, uint32_t seqno);
@@ -49,6 +49,7 @@
 #include "drmtest.h"
 #include "i915_drm.h"
 #include "i915/gem.h"
+#include "i915/gem_mman.h"
 #include "xe/xe_query.h"
 #include "intel_chipset.h"
 #include "intel_io.h"
@@ -313,6 +314,85 @@ static void log_opened_device_path(const char *device_path)
 	igt_info("Opened device: %s\n", item->path);
 }
 
+/*
+ * Drivers behind the device nodes, as found by the previous opens, so that
+ * searches skip the nodes of other drivers, vgem or vkms for instance,
+ * without opening them again. A node is recognized by its inode, which
+ * changes when the node is recreated by a driver (un)load, and the table
+ * is dropped whenever modules get loaded.
+ */
+static struct {
+	dev_t rdev;
+	ino_t ino;
+	char driver[16];
+} _node_drivers[64];
+static int _node_drivers_count;
+static pthread_mutex_t _node_drivers_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static bool node_driver_lookup(const struct stat *st, char *driver, int len)
+{
+	bool found = false;
+
+	pthread_mutex_lock(&_node_drivers_lock);
+	for (int i = 0; i < _node_drivers_count; i++) {
+		if (_node_drivers[i].rdev == st->st_rdev &&
+		    _node_drivers[i].ino == st->st_ino) {
+			snprintf(driver, len, "%s", _node_drivers[i].driver);
+			found = true;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&_node_drivers_lock);
+
+	return found;
+}
+
+static void node_driver_store(const struct stat *st, const char *driver)
+{
+	pthread_mutex_lock(&_node_drivers_lock);
+	if (_node_drivers_count < ARRAY_SIZE(_node_drivers)) {
+		_node_drivers[_node_drivers_count].rdev = st->st_rdev;
+		_node_drivers[_node_drivers_count].ino = st->st_ino;
+		snprintf(_node_drivers[_node_drivers_count].driver,
+			 sizeof(_node_drivers[0].driver), "%s", driver);
+		_node_drivers_count++;
+	}
+	pthread_mutex_unlock(&_node_drivers_lock);
+}
+
+static void node_drivers_reset(void)
+{
+	pthread_mutex_lock(&_node_drivers_lock);
+	_node_drivers_count = 0;
+	pthread_mutex_unlock(&_node_drivers_lock);
+}
+
+static bool driver_matches(const char *dev_name, unsigned int chipset)
+{
+	unsigned int chip = DRIVER_ANY;
+	const char *forced;
+
+	/*
+	 * When using forced driver with DRIVER_ANY honor any driver name,
+	 * also those excluded from DRIVER_ANY or those that are not listed
+	 * in known modules.
+	 */
+	forced = forced_driver();
+	if (forced && chipset == DRIVER_ANY) {
+		if (strcmp(forced, dev_name)) {
+			igt_debug("Expected driver \"%s\" but got \"%s\"\n",
+				  forced, dev_name);
+			return false;
+		}
+
+		return true;
+	}
+
+	modulename_to_chipset(dev_name, &chip);
+
+	return (chipset & chip) == chip;
+}
+
 /**
  * __drm_open_device:
  * @name: DRM node name
@@ -331,40 +411,32 @@ static void log_opened_device_path(const char *device_path)
  */
 int __drm_open_device(const char *name, unsigned int chipset)
 {
-	const char *forced;
 	char dev_name[16] = "";
-	unsigned int chip = DRIVER_ANY;
+	struct stat st;
+	bool known;
 	int fd;
 
+	if (stat(name, &st))
+		return -1;
+
+	known = node_driver_lookup(&st, dev_name, sizeof(dev_name));
+	if (known && !driver_matches(dev_name, chipset))
+		return -1;
+
 	fd = open(name, O_RDWR);
 	if (fd == -1)
 		return -1;
 
-	if (__get_drm_device_name(fd, dev_name, sizeof(dev_name) - 1) == -1)
-		goto err;
-
-	/*
-	 * When using forced driver with DRIVER_ANY honor any driver name,
-	 * also those excluded from DRIVER_ANY or those that are not listed
-	 * in known modules.
-	 */
-	forced = forced_driver();
-	if (forced && chipset == DRIVER_ANY) {
-		if (strcmp(forced, dev_name)) {
-			igt_debug("Expected driver \"%s\" but got \"%s\"\n",
-				  forced, dev_name);
+	if (!known) {
+		if (__get_drm_device_name(fd, dev_name, sizeof(dev_name) - 1) == -1)
 			goto err;
-		} else {
-			goto opened;
-		}
-	}
 
-	modulename_to_chipset(dev_name, &chip);
+		node_driver_store(&st, dev_name);
 
-	if ((chipset & chip) != chip)
-		goto err;
+		if (!driver_matches(dev_name, chipset))
+			goto err;
+	}
 
-opened:
 	log_opened_device_path(name);
 	return fd;
 
@@ -474,6 +546,7 @@ void drm_load_module(unsigned int chipset)
 	}
 
 	pthread_mutex_unlock(&mutex);
+	node_drivers_reset();
 	igt_devices_scan();
 }
 
@@ -805,6 +878,8 @@ int __drm_close_driver(int fd)
 	if (is_xe_device(fd))
 		xe_device_put(fd);
 
+	gem_mmap_cache_flush(fd);
+
 	return close(fd);
 }
 
@@ -26,6 +26,7 @@
  */
 
 #include <i915_drm.h>
+#include <stdlib.h>
 
 #include "intel_reg.h"
 #include "drmtest.h"
@@ -118,10 +119,10 @@ static const uint32_t gen12_gpgpu_kernel[][4] = {
  * |       |       |
  * +---------------+ <---- 0 + ?
  *
+ * with both parts grown beyond a page by gen7_fill_rects_batch_size() when
+ * filling many rectangles.
  */
 
-#define PAGE_SIZE 4096
-#define BATCH_STATE_SPLIT 2048
 /* VFE STATE params */
 #define THREADS 1
 #define GEN7_GPGPU_URB_ENTRIES 0
@@ -130,23 +131,30 @@ static const uint32_t gen12_gpgpu_kernel[][4] = {
 #define GPGPU_CURBE_SIZE 1
 #define GEN7_VFE_STATE_GPGPU_MODE 1
 
+#define GPGPU_RECT_CMD_SIZE	96
+#define XEHP_RECT_CMD_SIZE	192
+
 void
-gen7_gpgpu_fillfunc(int i915,
-		    struct intel_buf *buf,
-		    unsigned x, unsigned y,
-		    unsigned width, unsigned height,
-		    uint8_t color)
+gen7_gpgpu_fillfunc_rects(int i915,
+			  struct intel_buf *buf,
+			  const struct igt_fill_rect *rects,
+			  unsigned int count)
 {
 	struct intel_bb *ibb;
-	uint32_t curbe_buffer, interface_descriptor;
+	uint32_t *curbe_buffers, interface_descriptor;
+	uint32_t size, state_split;
+
+	igt_assert(count);
 
-	ibb = intel_bb_create(i915, PAGE_SIZE);
+	size = gen7_fill_rects_batch_size(count, count * GPGPU_RECT_CMD_SIZE,
+					  &state_split);
+	ibb = intel_bb_create(i915, size);
 	intel_bb_add_intel_buf(ibb, buf, true);
 
-	intel_bb_ptr_set(ibb, BATCH_STATE_SPLIT);
+	intel_bb_ptr_set(ibb, state_split);
 
 	/* Fill curbe buffer data */
-	curbe_buffer = gen7_fill_curbe_buffer_data(ibb, color);
+	curbe_buffers = gen7_fill_rects_curbe_data(ibb, rects, count);
 
 	/*
 	 * const buffer needs to fill for every thread, but as we have just 1
@@ -167,9 +175,8 @@ gen7_gpgpu_fillfunc(int i915,
 	gen7_emit_vfe_state(ibb, THREADS, GEN7_GPGPU_URB_ENTRIES,
 			       GPGPU_URB_SIZE, GPGPU_CURBE_SIZE,
 			       GEN7_VFE_STATE_GPGPU_MODE);
-	gen7_emit_curbe_load(ibb, curbe_buffer);
-	gen7_emit_interface_descriptor_load(ibb, interface_descriptor);
-	gen7_emit_gpgpu_walk(ibb, x, y, width, height);
+	gen7_emit_fill_rects(ibb, rects, count, curbe_buffers,
+			     interface_descriptor, gen7_emit_gpgpu_walk);
 
 	intel_bb_out(ibb, MI_BATCH_BUFFER_END);
 	intel_bb_ptr_align(ibb, 32);
@@ -178,29 +185,46 @@ gen7_gpgpu_fillfunc(int i915,
 		      I915_EXEC_DEFAULT | I915_EXEC_NO_RELOC, true);
 
 	intel_bb_destroy(ibb);
+	free(curbe_buffers);
 }
 
 void
-gen8_gpgpu_fillfunc(int i915,
+gen7_gpgpu_fillfunc(int i915,
 		    struct intel_buf *buf,
 		    unsigned x, unsigned y,
 		    unsigned width, unsigned height,
 		    uint8_t color)
+{
+	const struct igt_fill_rect rect = { x, y, width, height, color };
+
+	gen7_gpgpu_fillfunc_rects(i915, buf, &rect, 1);
+}
+
+void
+gen8_gpgpu_fillfunc_rects(int i915,
+			  struct intel_buf *buf,
+			  const struct igt_fill_rect *rects,
+			  unsigned int count)
 {
 	struct intel_bb *ibb;
-	uint32_t curbe_buffer, interface_descriptor;
+	uint32_t *curbe_buffers, interface_descriptor;
+	uint32_t size, state_split;
+
+	igt_assert(count);
 
-	ibb = intel_bb_create(i915, PAGE_SIZE);
+	size = gen7_fill_rects_batch_size(count, count * GPGPU_RECT_CMD_SIZE,
+					  &state_split);
+	ibb = intel_bb_create(i915, size);
 	intel_bb_add_intel_buf(ibb, buf, true);
 
-	intel_bb_ptr_set(ibb, BATCH_STATE_SPLIT);
+	intel_bb_ptr_set(ibb, state_split);
 
 	/*
 	 * const buffer needs to fill for every thread, but as we have just 1
 	 * thread per every group, so need only one curbe data.
 	 * For each thread, just use thread group ID for buffer offset.
 	 */
-	curbe_buffer = gen7_fill_curbe_buffer_data(ibb, color);
+	curbe_buffers = gen7_fill_rects_curbe_data(ibb, rects, count);
 
 	interface_descriptor = gen8_fill_interface_descriptor(ibb, buf,
 				gen8_gpgpu_kernel, sizeof(gen8_gpgpu_kernel));
@@ -214,10 +238,8 @@ gen8_gpgpu_fillfunc(int i915,
 	gen8_emit_vfe_state(ibb, THREADS, GEN8_GPGPU_URB_ENTRIES,
 			    GPGPU_URB_SIZE, GPGPU_CURBE_SIZE);
 
-	gen7_emit_curbe_load(ibb, curbe_buffer);
-	gen7_emit_interface_descriptor_load(ibb, interface_descriptor);
-
-	gen8_emit_gpgpu_walk(ibb, x, y, width, height);
+	gen7_emit_fill_rects(ibb, rects, count, curbe_buffers,
+			     interface_descriptor, gen8_emit_gpgpu_walk);
 
 	intel_bb_out(ibb, MI_BATCH_BUFFER_END);
 	intel_bb_ptr_align(ibb, 32);
@@ -226,23 +248,40 @@ gen8_gpgpu_fillfunc(int i915,
 		      I915_EXEC_DEFAULT | I915_EXEC_NO_RELOC, true);
 
 	intel_bb_destroy(ibb);
+	free(curbe_buffers);
+}
+
+void
+gen8_gpgpu_fillfunc(int i915,
+		    struct intel_buf *buf,
+		    unsigned x, unsigned y,
+		    unsigned width, unsigned height,
+		    uint8_t color)
+{
+	const struct igt_fill_rect rect = { x, y, width, height, color };
+
+	gen8_gpgpu_fillfunc_rects(i915, buf, &rect, 1);
 }
 
 static void
-__gen9_gpgpu_fillfunc(int i915,
-		      struct intel_buf *buf,
-		      unsigned x, unsigned y,
-		      unsigned width, unsigned height,
-		      uint8_t color,
-		      const uint32_t kernel[][4], size_t kernel_size)
+__gen9_gpgpu_fillfunc_rects(int i915,
+			    struct intel_buf *buf,
+			    const struct igt_fill_rect *rects,
+			    unsigned int count,
+			    const uint32_t kernel[][4], size_t kernel_size)
 {
 	struct intel_bb *ibb;
-	uint32_t curbe_buffer, interface_descriptor;
+	uint32_t *curbe_buffers, interface_descriptor;
+	uint32_t size, state_split;
+
+	igt_assert(count);
 
-	ibb = intel_bb_create(i915, PAGE_SIZE);
+	size = gen7_fill_rects_batch_size(count, count * GPGPU_RECT_CMD_SIZE,
+					  &state_split);
+	ibb = intel_bb_create(i915, size);
 	intel_bb_add_intel_buf(ibb, buf, true);
 
-	intel_bb_ptr_set(ibb, BATCH_STATE_SPLIT);
+	intel_bb_ptr_set(ibb, state_split);
 
 	/*
 	 * const buffer needs to fill for every thread, but as we have just 1
@@ -250,7 +289,7 @@ __gen9_gpgpu_fillfunc(int i915,
 	 * For each thread, just use thread group ID for buffer offset.
 	 */
 	/* Fill curbe buffer data */
-	curbe_buffer = gen7_fill_curbe_buffer_data(ibb, color);
+	curbe_buffers = gen7_fill_rects_curbe_data(ibb, rects, count);
 
 	interface_descriptor = gen8_fill_interface_descriptor(ibb, buf,
 							      kernel,
@@ -267,10 +306,8 @@ __gen9_gpgpu_fillfunc(int i915,
 	gen8_emit_vfe_state(ibb, THREADS, GEN8_GPGPU_URB_ENTRIES,
 			    GPGPU_URB_SIZE, GPGPU_CURBE_SIZE);
 
-	gen7_emit_curbe_load(ibb, curbe_buffer);
-	gen7_emit_interface_descriptor_load(ibb, interface_descriptor);
-
-	gen8_emit_gpgpu_walk(ibb, x, y, width, height);
+	gen7_emit_fill_rects(ibb, rects, count, curbe_buffers,
+			     interface_descriptor, gen8_emit_gpgpu_walk);
 
 	intel_bb_out(ibb, MI_BATCH_BUFFER_END);
 	intel_bb_ptr_align(ibb, 32);
@@ -279,6 +316,7 @@ __gen9_gpgpu_fillfunc(int i915,
 		      I915_EXEC_RENDER | I915_EXEC_NO_RELOC, true);
 
 	intel_bb_destroy(ibb);
+	free(curbe_buffers);
 }
 
 static struct gpgpu_shader *__xehp_gpgpu_kernel(int i915)
@@ -333,20 +371,25 @@ send.tgm (16|M0)	null	r4	null	0x0	0x64000007		\n\
 	return kernel;
 }
 
-void xehp_gpgpu_fillfunc(int i915,
-			 struct intel_buf *buf,
-			 unsigned int x, unsigned int y,
-			 unsigned int width, unsigned int height,
-			 uint8_t color)
+void xehp_gpgpu_fillfunc_rects(int i915,
+			       struct intel_buf *buf,
+			       const struct igt_fill_rect *rects,
+			       unsigned int count)
 {
 	struct intel_bb *ibb;
 	struct gpgpu_shader *kernel;
 	struct xehp_interface_descriptor_data idd;
+	uint32_t size, state_split;
+
+	igt_assert(count);
 
-	ibb = intel_bb_create(i915, PAGE_SIZE);
+	/* The color is inline data of each walker, no curbe to reload */
+	size = gen7_fill_rects_batch_size(1, count * XEHP_RECT_CMD_SIZE,
+					  &state_split);
+	ibb = intel_bb_create(i915, size);
 	intel_bb_add_intel_buf(ibb, buf, true);
 
-	intel_bb_ptr_set(ibb, BATCH_STATE_SPLIT);
+	intel_bb_ptr_set(ibb, state_split);
 
 	kernel = __xehp_gpgpu_kernel(i915);
 	xehp_fill_interface_descriptor(ibb, buf, kernel->instr,
@@ -362,7 +405,10 @@ void xehp_gpgpu_fillfunc(int i915,
 	xehp_emit_state_compute_mode(ibb, false);
 	xehp_emit_state_binding_table_pool_alloc(ibb);
 	xehp_emit_cfe_state(ibb, THREADS);
-	xehp_emit_compute_walk(ibb, x, y, width, height, &idd, color);
+	for (unsigned int i = 0; i < count; i++)
+		xehp_emit_compute_walk(ibb, rects[i].x, rects[i].y,
+				       rects[i].width, rects[i].height,
+				       &idd, rects[i].color);
 
 	intel_bb_out(ibb, MI_BATCH_BUFFER_END);
 	intel_bb_ptr_align(ibb, 32);
@@ -373,15 +419,46 @@ void xehp_gpgpu_fillfunc(int i915,
 	intel_bb_destroy(ibb);
 }
 
+void xehp_gpgpu_fillfunc(int i915,
+			 struct intel_buf *buf,
+			 unsigned int x, unsigned int y,
+			 unsigned int width, unsigned int height,
+			 uint8_t color)
+{
+	const struct igt_fill_rect rect = { x, y, width, height, color };
+
+	xehp_gpgpu_fillfunc_rects(i915, buf, &rect, 1);
+}
+
+void gen9_gpgpu_fillfunc_rects(int i915,
+			       struct intel_buf *buf,
+			       const struct igt_fill_rect *rects,
+			       unsigned int count)
+{
+	__gen9_gpgpu_fillfunc_rects(i915, buf, rects, count,
+				    gen9_gpgpu_kernel,
+				    sizeof(gen9_gpgpu_kernel));
+}
+
 void gen9_gpgpu_fillfunc(int i915,
 			 struct intel_buf *buf,
 			 unsigned x, unsigned y,
 			 unsigned width, unsigned height,
 			 uint8_t color)
 {
-	__gen9_gpgpu_fillfunc(i915, buf, x, y, width, height, color,
-			      gen9_gpgpu_kernel,
-			      sizeof(gen9_gpgpu_kernel));
+	const struct igt_fill_rect rect = { x, y, width, height, color };
+
+	gen9_gpgpu_fillfunc_rects(i915, buf, &rect, 1);
+}
+
+void gen11_gpgpu_fillfunc_rects(int i915,
+				struct intel_buf *buf,
+				const struct igt_fill_rect *rects,
+				unsigned int count)
+{
+	__gen9_gpgpu_fillfunc_rects(i915, buf, rects, count,
+				    gen11_gpgpu_kernel,
+				    sizeof(gen11_gpgpu_kernel));
 }
 
 void gen11_gpgpu_fillfunc(int i915,
@@ -390,9 +467,19 @@ void gen11_gpgpu_fillfunc(int i915,
 			  unsigned width, unsigned height,
 			  uint8_t color)
 {
-	__gen9_gpgpu_fillfunc(i915, buf, x, y, width, height, color,
-			      gen11_gpgpu_kernel,
-			      sizeof(gen11_gpgpu_kernel));
+	const struct igt_fill_rect rect = { x, y, width, height, color };
+
+	gen11_gpgpu_fillfunc_rects(i915, buf, &rect, 1);
+}
+
+void gen12_gpgpu_fillfunc_rects(int i915,
+				struct intel_buf *buf,
+				const struct igt_fill_rect *rects,
+				unsigned int count)
+{
+	__gen9_gpgpu_fillfunc_rects(i915, buf, rects, count,
+				    gen12_gpgpu_kernel,
+				    sizeof(gen12_gpgpu_kernel));
 }
 
 void gen12_gpgpu_fillfunc(int i915,
@@ -401,7 +488,7 @@ void gen12_gpgpu_fillfunc(int i915,
 			  unsigned width, unsigned height,
 			  uint8_t color)
 {
-	__gen9_gpgpu_fillfunc(i915, buf, x, y, width, height, color,
-			      gen12_gpgpu_kernel,
-			      sizeof(gen12_gpgpu_kernel));
+	const struct igt_fill_rect rect = { x, y, width, height, color };
+
+	gen12_gpgpu_fillfunc_rects(i915, buf, &rect, 1);
 }
@@ -29,6 +29,14 @@
 
 #include "intel_bufops.h"
 
+struct igt_fill_rect;
+
+void
+gen7_gpgpu_fillfunc_rects(int i915,
+			  struct intel_buf *buf,
+			  const struct igt_fill_rect *rects,
+			  unsigned int count);
+
 void
 gen7_gpgpu_fillfunc(int i915,
 		    struct intel_buf *buf,
@@ -36,6 +44,12 @@ gen7_gpgpu_fillfunc(int i915,
 		    unsigned width, unsigned height,
 		    uint8_t color);
 
+void
+gen8_gpgpu_fillfunc_rects(int i915,
+			  struct intel_buf *buf,
+			  const struct igt_fill_rect *rects,
+			  unsigned int count);
+
 void
 gen8_gpgpu_fillfunc(int i915,
 		    struct intel_buf *buf,
@@ -43,24 +57,45 @@ gen8_gpgpu_fillfunc(int i915,
 		    unsigned width, unsigned height,
 		    uint8_t color);
 
+void gen9_gpgpu_fillfunc_rects(int i915,
+			       struct intel_buf *buf,
+			       const struct igt_fill_rect *rects,
+			       unsigned int count);
+
 void gen9_gpgpu_fillfunc(int i915,
 			 struct intel_buf *buf,
 			 unsigned x, unsigned y,
 			 unsigned width, unsigned height,
 			 uint8_t color);
 
+void gen11_gpgpu_fillfunc_rects(int i915,
+				struct intel_buf *buf,
+				const struct igt_fill_rect *rects,
+				unsigned int count);
+
 void gen11_gpgpu_fillfunc(int i915,
 			  struct intel_buf *buf,
 			  unsigned x, unsigned y,
 			  unsigned width, unsigned height,
 			  uint8_t color);
 
+void gen12_gpgpu_fillfunc_rects(int i915,
+				struct intel_buf *buf,
+				const struct igt_fill_rect *rects,
+				unsigned int count);
+
 void gen12_gpgpu_fillfunc(int i915,
 			  struct intel_buf *buf,
 			  unsigned x, unsigned y,
 			  unsigned width, unsigned height,
 			  uint8_t color);
 
+void
+xehp_gpgpu_fillfunc_rects(int i915,
+			  struct intel_buf *dst,
+			  const struct igt_fill_rect *rects,
+			  unsigned int count);
+
 void
 xehp_gpgpu_fillfunc(int i915,
 		    struct intel_buf *dst,
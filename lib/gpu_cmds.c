@@ -883,6 +883,99 @@ gen7_emit_media_objects(struct intel_bb *ibb,
 			gen_emit_media_object(ibb, x + i * 16, y + j * 16);
 }
 
+/*
+ * Batches filling rectangles keep the layout of the single fill, commands
+ * from the start and the state from BATCH_STATE_SPLIT, growing both to fit
+ * the commands and a curbe per rectangle.
+ */
+#define FILL_BATCH_SIZE		4096
+#define FILL_BATCH_STATE_SPLIT	2048
+#define FILL_SETUP_SIZE		512
+#define FILL_CURBE_SIZE		64
+
+/**
+ * gen7_fill_rects_batch_size:
+ * @curbes: number of curbes, one per rectangle or 1 with inline data
+ * @cmd_size: bytes of the commands filling all rectangles
+ * @state_split: returns where the state starts in the batch
+ *
+ * Returns: The size of a batch with room for the pipeline setup, the
+ * commands filling the rectangles, the state and the curbes.
+ */
+uint32_t
+gen7_fill_rects_batch_size(unsigned int curbes, size_t cmd_size,
+			   uint32_t *state_split)
+{
+	*state_split = max_t(uint32_t, FILL_BATCH_STATE_SPLIT,
+			     ALIGN(FILL_SETUP_SIZE + cmd_size, 64));
+
+	return ALIGN(*state_split + FILL_BATCH_SIZE - FILL_BATCH_STATE_SPLIT +
+		     (curbes - 1) * FILL_CURBE_SIZE, FILL_BATCH_SIZE);
+}
+
+/**
+ * gen7_fill_rects_curbe_data:
+ * @ibb: batch, with the pointer in the state
+ * @rects: rectangles to fill
+ * @count: number of rectangles
+ *
+ * Fills a curbe for each run of rectangles of the same color.
+ *
+ * Returns: The offset of the curbe of each rectangle, to be freed by the
+ * caller.
+ */
+uint32_t *
+gen7_fill_rects_curbe_data(struct intel_bb *ibb,
+			   const struct igt_fill_rect *rects,
+			   unsigned int count)
+{
+	uint32_t *curbe_buffers;
+
+	curbe_buffers = calloc(count, sizeof(*curbe_buffers));
+	igt_assert(curbe_buffers);
+
+	for (unsigned int i = 0; i < count; i++)
+		curbe_buffers[i] = i && rects[i].color == rects[i - 1].color ?
+			curbe_buffers[i - 1] :
+			gen7_fill_curbe_buffer_data(ibb, rects[i].color);
+
+	return curbe_buffers;
+}
+
+/**
+ * gen7_emit_fill_rects:
+ * @ibb: batch, with the pointer after the pipeline setup
+ * @rects: rectangles to fill
+ * @count: number of rectangles
+ * @curbe_buffers: curbes from gen7_fill_rects_curbe_data()
+ * @interface_descriptor: interface descriptor of the fill kernel
+ * @walk: emits the commands filling one rectangle
+ *
+ * Loads the curbe and interface descriptor and fills each rectangle,
+ * flushing the media state and reloading the curbe where the color changes.
+ */
+void
+gen7_emit_fill_rects(struct intel_bb *ibb,
+		     const struct igt_fill_rect *rects, unsigned int count,
+		     const uint32_t *curbe_buffers,
+		     uint32_t interface_descriptor,
+		     gen7_fill_walk_t walk)
+{
+	gen7_emit_curbe_load(ibb, curbe_buffers[0]);
+	gen7_emit_interface_descriptor_load(ibb, interface_descriptor);
+
+	for (unsigned int i = 0; i < count; i++) {
+		if (i && curbe_buffers[i] != curbe_buffers[i - 1]) {
+			/* Threads of the previous walk still read the curbe */
+			gen8_emit_media_state_flush(ibb);
+			gen7_emit_curbe_load(ibb, curbe_buffers[i]);
+		}
+
+		walk(ibb, rects[i].x, rects[i].y,
+		     rects[i].width, rects[i].height);
+	}
+}
+
 /**
  * xelp_emit_vfe_state:
  * @ibb: pointer to intel_bb
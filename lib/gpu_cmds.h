@@ -116,6 +116,26 @@ gen7_emit_media_objects(struct intel_bb *ibb,
 			unsigned int x, unsigned int y,
 			unsigned int width, unsigned int height);
 
+typedef void (*gen7_fill_walk_t)(struct intel_bb *ibb,
+				 unsigned int x, unsigned int y,
+				 unsigned int width, unsigned int height);
+
+uint32_t
+gen7_fill_rects_batch_size(unsigned int curbes, size_t cmd_size,
+			   uint32_t *state_split);
+
+uint32_t *
+gen7_fill_rects_curbe_data(struct intel_bb *ibb,
+			   const struct igt_fill_rect *rects,
+			   unsigned int count);
+
+void
+gen7_emit_fill_rects(struct intel_bb *ibb,
+		     const struct igt_fill_rect *rects, unsigned int count,
+		     const uint32_t *curbe_buffers,
+		     uint32_t interface_descriptor,
+		     gen7_fill_walk_t walk);
+
 void
 xehp_fill_interface_descriptor(struct intel_bb *ibb,
 			       struct intel_buf *dst,
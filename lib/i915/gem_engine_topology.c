@@ -22,11 +22,13 @@
  */
 
 #include <fcntl.h>
+#include <pthread.h>
 #include <sys/stat.h>
 #include <sys/syscall.h>
 #include <unistd.h>
 
 #include "drmtest.h"
+#include "igt_map.h"
 #include "igt_sysfs.h"
 #include "intel_chipset.h"
 #include "ioctl_wrappers.h"
@@ -82,13 +84,6 @@
  * ]|
  */
 
-/*
- * Limit what we support for simplicity due limitation in how much we
- * can address via execbuf2.
- */
-#define SIZEOF_QUERY		offsetof(struct drm_i915_query_engine_info, \
-					 engines[GEM_MAX_ENGINES])
-
 static int __gem_query(int fd, struct drm_i915_query *q)
 {
 	int err = 0;
@@ -165,23 +160,207 @@ static void init_engine(struct intel_execution_engine2 *e2,
 	igt_assert(ret < sizeof(e2->name));
 }
 
+/*
+ * MTL has two GT's, one containing render/compute/copy and the other
+ * containing media engines. Return gt id based on engine, or -1 for an
+ * engine class it doesn't know about.
+ */
+static int
+mtl_engine_to_gt_map(const struct i915_engine_class_instance *e)
+{
+	switch (e->engine_class) {
+	case I915_ENGINE_CLASS_RENDER:
+	case I915_ENGINE_CLASS_COMPUTE:
+	case I915_ENGINE_CLASS_COPY:
+		return 0;
+	case I915_ENGINE_CLASS_VIDEO:
+	case I915_ENGINE_CLASS_VIDEO_ENHANCE:
+		return 1;
+	default:
+		return -1;
+	}
+}
+
+/*
+ * The engine topology doesn't change for as long as the driver stays bound,
+ * yet tests walk it in loops and in every subtest. It is queried once per
+ * device and shared by all the fds opened on it, together with the gt of
+ * each engine and the mmio bases looked up so far.
+ *
+ * Entries are keyed by the device number of the node. Unbinding the driver,
+ * be it by unloading the module, through sysfs or by a hot unplug, removes
+ * the node and binding it again creates a new one, so an entry is only used
+ * while the inode of the node still matches and is replaced otherwise.
+ */
+struct engine_topology {
+	uint64_t rdev;
+	uint64_t ino;
+	int err;
+	unsigned int num_engines;
+	struct i915_engine_class_instance *engines;
+	int *gt;
+	int64_t *mmio_base;	/* -1 until looked up */
+};
+
+static struct {
+	pthread_mutex_t mutex;
+	struct igt_map *map;
+} topology_cache = {
+	.mutex = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static void topology_free(struct engine_topology *t)
+{
+	free(t->engines);
+	free(t->gt);
+	free(t->mmio_base);
+	free(t);
+}
+
+static void topology_delete_entry(struct igt_map_entry *entry)
+{
+	topology_free(entry->data);
+}
+
+static struct engine_topology *topology_create(int fd, const struct stat *st)
+{
+	const int size = 256 << 10; /* enough for 8 classes of 256 engines */
+	struct drm_i915_query_engine_info *info;
+	struct engine_topology *t;
+	uint32_t devid;
+
+	t = calloc(1, sizeof(*t));
+	igt_assert(t);
+	t->rdev = st->st_rdev;
+	t->ino = st->st_ino;
+
+	info = calloc(1, size);
+	igt_assert(info);
+	t->err = __gem_query_engines(fd, info, size);
+	if (t->err) {
+		free(info);
+		return t;
+	}
+
+	t->num_engines = info->num_engines;
+	t->engines = calloc(t->num_engines + 1, sizeof(*t->engines));
+	t->gt = calloc(t->num_engines + 1, sizeof(*t->gt));
+	t->mmio_base = calloc(t->num_engines + 1, sizeof(*t->mmio_base));
+	igt_assert(t->engines && t->gt && t->mmio_base);
+
+	devid = intel_get_drm_devid(fd);
+	for (unsigned int i = 0; i < t->num_engines; i++) {
+		t->engines[i] = info->engines[i].engine;
+		t->gt[i] = IS_METEORLAKE(devid) ?
+			   mtl_engine_to_gt_map(&t->engines[i]) : 0;
+		t->mmio_base[i] = -1;
+	}
+
+	free(info);
+	return t;
+}
+
+/* Called with topology_cache.mutex held */
+static struct engine_topology *topology_get(int fd)
+{
+	struct engine_topology *t;
+	struct stat st;
+	uint64_t rdev;
+
+	if (fstat(fd, &st))
+		return NULL;
+
+	if (!S_ISCHR(st.st_mode)) {
+		errno = ENOTTY;
+		return NULL;
+	}
+
+	if (!topology_cache.map)
+		topology_cache.map = igt_map_create(igt_map_hash_64,
+						    igt_map_equal_64);
+
+	rdev = st.st_rdev;
+	t = igt_map_search(topology_cache.map, &rdev);
+	if (t && t->ino == st.st_ino)
+		return t;
+
+	if (t)
+		igt_map_remove(topology_cache.map, &rdev, topology_delete_entry);
+
+	t = topology_create(fd, &st);
+	igt_map_insert(topology_cache.map, &t->rdev, t);
+
+	return t;
+}
+
+static int topology_find_engine(const struct engine_topology *t,
+				const char *name)
+{
+	for (unsigned int i = 0; i < t->num_engines; i++) {
+		struct intel_execution_engine2 e2;
+
+		init_engine(&e2, t->engines[i].engine_class,
+			    t->engines[i].engine_instance, i);
+		if (!strcmp(e2.name, name))
+			return i;
+	}
+
+	return -1;
+}
+
+/**
+ * __gem_list_engines:
+ * @fd: open i915 drm file descriptor
+ * @engines: Returned engines, with room for GEM_MAX_ENGINES
+ * @count: Returned engine count
+ *
+ * Lists the physical engines of the device, as __gem_query_engines() does
+ * but from the engine topology cached for the device.
+ *
+ * Returns: 0 on success, or the error of the engines query.
+ */
+int __gem_list_engines(int fd, struct i915_engine_class_instance *engines,
+		       unsigned int *count)
+{
+	struct engine_topology *t;
+	int err;
+
+	pthread_mutex_lock(&topology_cache.mutex);
+	t = topology_get(fd);
+	if (!t)
+		err = -errno;
+	else if (t->err)
+		err = t->err;
+	else if (t->num_engines > GEM_MAX_ENGINES)
+		err = -EINVAL;
+	else
+		err = 0;
+
+	if (!err) {
+		memcpy(engines, t->engines, t->num_engines * sizeof(*engines));
+		*count = t->num_engines;
+	}
+	pthread_mutex_unlock(&topology_cache.mutex);
+
+	return err;
+}
+
 static int __query_engine_list(int fd, struct intel_engine_data *ed)
 {
-	uint8_t buff[SIZEOF_QUERY] = { };
-	struct drm_i915_query_engine_info *query_engine =
-			(struct drm_i915_query_engine_info *) buff;
-	int i, err;
+	struct i915_engine_class_instance engines[GEM_MAX_ENGINES];
+	unsigned int count, i;
+	int err;
 
-	err = __gem_query_engines(fd, query_engine, SIZEOF_QUERY);
+	err = __gem_list_engines(fd, engines, &count);
 	if (err)
 		return err;
 
-	for (i = 0; i < query_engine->num_engines; i++)
+	for (i = 0; i < count; i++)
 		init_engine(&ed->engines[i],
-			    query_engine->engines[i].engine.engine_class,
-			    query_engine->engines[i].engine.engine_instance, i);
+			    engines[i].engine_class,
+			    engines[i].engine_instance, i);
 
-	ed->nengines = query_engine->num_engines;
+	ed->nengines = count;
 
 	return 0;
 }
@@ -350,36 +529,6 @@ struct intel_execution_engine2 gem_eb_flags_to_engine(unsigned int flags)
 	return e2__;
 }
 
-/*
- * MTL has two GT's, one containing render/compute/copy and the other
- * containing media engines. Return gt id based on engine.
- */
-static int
-mtl_engine_to_gt_map(const struct i915_engine_class_instance *e)
-{
-	switch (e->engine_class) {
-	case I915_ENGINE_CLASS_RENDER:
-	case I915_ENGINE_CLASS_COMPUTE:
-	case I915_ENGINE_CLASS_COPY:
-		return 0;
-	case I915_ENGINE_CLASS_VIDEO:
-	case I915_ENGINE_CLASS_VIDEO_ENHANCE:
-		return 1;
-	default:
-		igt_assert_f(0, "Unsupported engine class %d\n", e->engine_class);
-	}
-}
-
-static int gem_engine_to_gt_map(int i915, const struct i915_engine_class_instance *engine)
-{
-	uint32_t devid = intel_get_drm_devid(i915);
-
-	/* Only MTL multi-gt supported at present */
-	igt_require(intel_graphics_ver(devid) <= IP_VER(12, 70));
-
-	return IS_METEORLAKE(devid) ? mtl_engine_to_gt_map(engine) : 0;
-}
-
 /**
  * gem_list_engines:
  * @i915: i915 drm file descriptor
@@ -396,27 +545,41 @@ gem_list_engines(int i915,
 		 uint32_t class_mask,
 		 unsigned int *out)
 {
-	struct i915_engine_class_instance *engines;
-	struct drm_i915_query_engine_info *info;
-	const int size = 256 << 10; /* enough for 8 classes of 256 engines */
+	struct i915_engine_class_instance *engines = NULL;
 	unsigned int max = 0, count = 0;
+	struct engine_topology *t;
+	int *gt = NULL;
+
+	/* Copied out, igt_require() below must not leave the cache locked */
+	pthread_mutex_lock(&topology_cache.mutex);
+	t = topology_get(i915);
+	if (t && !t->err) {
+		max = t->num_engines;
+		engines = malloc((max + 1) * sizeof(*engines));
+		gt = malloc((max + 1) * sizeof(*gt));
+		igt_assert(engines && gt);
+		memcpy(engines, t->engines, max * sizeof(*engines));
+		memcpy(gt, t->gt, max * sizeof(*gt));
+	}
+	pthread_mutex_unlock(&topology_cache.mutex);
+	igt_assert(engines);
 
-	info = calloc(1, size);
-	igt_assert(!__gem_query_engines(i915, info, size));
-
-	max = info->num_engines;
-	engines = (struct i915_engine_class_instance *)info;
 	for (unsigned int i = 0; i < max; i++) {
-		const struct i915_engine_class_instance *e =
-			&info->engines[i].engine;
+		const struct i915_engine_class_instance e = engines[i];
 
-		if (!((class_mask >> e->engine_class) & 1))
+		if (!((class_mask >> e.engine_class) & 1))
 			continue;
-		if (!((gt_mask >> gem_engine_to_gt_map(i915, e)) & 1))
+
+		/* Only MTL multi-gt supported at present */
+		igt_require(intel_graphics_ver(intel_get_drm_devid(i915)) <= IP_VER(12, 70));
+		igt_assert_f(gt[i] >= 0,
+			     "Unsupported engine class %d\n", e.engine_class);
+		if (!((gt_mask >> gt[i]) & 1))
 			continue;
 
-		engines[count++] = *e;
+		engines[count++] = e;
 	}
+	free(gt);
 
 	if (!count) {
 		free(engines);
@@ -649,9 +812,41 @@ bool gem_engine_can_block_copy(int i915, const struct intel_execution_engine2 *e
 	return gem_engine_has_capability(i915, engine->name, "block_copy");
 }
 
+static int64_t topology_mmio_base(int i915, const char *engine)
+{
+	struct engine_topology *t;
+	int64_t mmio = -1;
+	int idx;
+
+	pthread_mutex_lock(&topology_cache.mutex);
+	t = topology_get(i915);
+	if (t && (idx = topology_find_engine(t, engine)) >= 0)
+		mmio = t->mmio_base[idx];
+	pthread_mutex_unlock(&topology_cache.mutex);
+
+	return mmio;
+}
+
+static void topology_set_mmio_base(int i915, const char *engine, uint32_t mmio)
+{
+	struct engine_topology *t;
+	int idx;
+
+	pthread_mutex_lock(&topology_cache.mutex);
+	t = topology_get(i915);
+	if (t && (idx = topology_find_engine(t, engine)) >= 0)
+		t->mmio_base[idx] = mmio;
+	pthread_mutex_unlock(&topology_cache.mutex);
+}
+
 uint32_t gem_engine_mmio_base(int i915, const char *engine)
 {
 	unsigned int mmio = 0;
+	int64_t cached;
+
+	cached = topology_mmio_base(i915, engine);
+	if (cached >= 0)
+		return cached;
 
 	if (gem_engine_property_scanf(i915, engine, "mmio_base",
 				      "%x", &mmio) < 0) {
@@ -677,6 +872,7 @@ uint32_t gem_engine_mmio_base(int i915, const char *engine)
 		}
 	}
 
+	topology_set_mmio_base(i915, engine, mmio);
 	return mmio;
 }
 
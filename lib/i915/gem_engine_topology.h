@@ -48,6 +48,9 @@ struct intel_engine_data {
 	struct intel_execution_engine2 engines[GEM_MAX_ENGINES];
 };
 
+int __gem_list_engines(int fd, struct i915_engine_class_instance *engines,
+		       unsigned int *count);
+
 bool gem_has_engine_topology(int fd);
 struct intel_engine_data intel_engine_list_of_physical(int fd);
 struct intel_engine_data intel_engine_list_for_ctx_cfg(int fd, const intel_ctx_cfg_t *cfg);
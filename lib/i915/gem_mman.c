@@ -25,10 +25,12 @@
 #include <stdbool.h>
 #include <sys/ioctl.h>
 #include <errno.h>
+#include <pthread.h>
 
 #include "igt_core.h"
 #include "igt_gt.h"
 #include "igt_device.h"
+#include "igt_map.h"
 #include "ioctl_wrappers.h"
 #include "intel_chipset.h"
 
@@ -656,6 +658,236 @@ void *gem_mmap__cpu_coherent(int fd, uint32_t handle, uint64_t offset,
 	return ptr;
 }
 
+/*
+ * Mapping cache
+ *
+ * Tests mapping the same few objects over and over pay for the mmap offset
+ * ioctl, the mmap() and faulting the pages in again on every access. With
+ * gem_mmap_get() a mapping is made once per fd, handle and type and handed
+ * out again until the handle is closed with gem_close(), or the fd with
+ * drm_close_driver(). A fd closed with a plain close() must be flushed with
+ * gem_mmap_cache_flush() beforehand, or its mappings could be handed out
+ * for a handle of a later fd with the same number.
+ *
+ * Mappings are looked up by fd, handle and type, and by address for
+ * gem_mmap_put(). Closing a handle while its mapping is still in use only
+ * drops it from the former, the last gem_mmap_put() unmaps it.
+ */
+struct mmap_cache_entry {
+	uint64_t key;
+	uint64_t addr;
+	uint64_t size;
+	unsigned int refcount;
+	bool closed;
+};
+
+static struct {
+	pthread_mutex_t mutex;
+	struct igt_map *keys;
+	struct igt_map *addrs;
+	unsigned int count;
+} mmap_cache = {
+	.mutex = PTHREAD_MUTEX_INITIALIZER,
+};
+
+#define MMAP_CACHE_MAX_TYPE	I915_MMAP_OFFSET_FIXED
+
+static uint64_t mmap_cache_key(int fd, uint32_t handle, unsigned int type)
+{
+	return (uint64_t)fd << 35 | (uint64_t)type << 32 | handle;
+}
+
+static void mmap_cache_free(struct mmap_cache_entry *e)
+{
+	igt_map_remove(mmap_cache.addrs, &e->addr, NULL);
+	gem_munmap(from_user_pointer(e->addr), e->size);
+	free(e);
+	mmap_cache.count--;
+}
+
+/* Called with mmap_cache.mutex held, unmaps the entry once unused */
+static void mmap_cache_close(struct mmap_cache_entry *e)
+{
+	igt_map_remove(mmap_cache.keys, &e->key, NULL);
+	e->closed = true;
+
+	if (!e->refcount)
+		mmap_cache_free(e);
+}
+
+static void *mmap_cache_map(int fd, uint32_t handle, uint64_t size,
+			    unsigned int type)
+{
+	const unsigned int prot = PROT_READ | PROT_WRITE;
+
+	switch (type) {
+	case I915_MMAP_OFFSET_GTT:
+		return __gem_mmap__gtt(fd, handle, size, prot);
+	case I915_MMAP_OFFSET_WC:
+		return __gem_mmap__wc(fd, handle, 0, size, prot);
+	case I915_MMAP_OFFSET_WB:
+		return __gem_mmap__cpu(fd, handle, 0, size, prot);
+	default:
+		return __gem_mmap_offset(fd, handle, 0, size, prot, type);
+	}
+}
+
+/**
+ * __gem_mmap_get:
+ * @fd: open i915 drm file descriptor
+ * @handle: gem buffer object handle
+ * @size: size of the mapping, from the start of the object
+ * @type: I915_MMAP_OFFSET_* type of the mapping
+ *
+ * Returns a read and write mapping of @handle of the given @type, from the
+ * mapping cache if it already holds one at least @size large, or made and
+ * added to it otherwise. The mapping must be released with gem_mmap_put()
+ * and not munmap()ed. Legacy mmap ioctls are used for the GTT, WC and WB
+ * types when the kernel lacks mmap offsets.
+ *
+ * Returns: A pointer to the mapping, NULL on failure, with errno set to
+ * EBUSY if the cached mapping is too small and still in use.
+ */
+void *__gem_mmap_get(int fd, uint32_t handle, uint64_t size, unsigned int type)
+{
+	uint64_t key = mmap_cache_key(fd, handle, type);
+	struct mmap_cache_entry *e;
+	void *ptr = NULL;
+
+	igt_assert(type <= MMAP_CACHE_MAX_TYPE);
+
+	pthread_mutex_lock(&mmap_cache.mutex);
+	if (!mmap_cache.keys) {
+		mmap_cache.keys = igt_map_create(igt_map_hash_64,
+						 igt_map_equal_64);
+		mmap_cache.addrs = igt_map_create(igt_map_hash_64,
+						  igt_map_equal_64);
+	}
+
+	e = igt_map_search(mmap_cache.keys, &key);
+	if (e && e->size < size) {
+		if (e->refcount) {
+			errno = EBUSY;
+			goto out;
+		}
+
+		mmap_cache_close(e);
+		e = NULL;
+	}
+
+	if (!e) {
+		ptr = mmap_cache_map(fd, handle, size, type);
+		if (!ptr)
+			goto out;
+
+		e = calloc(1, sizeof(*e));
+		igt_assert(e);
+		e->key = key;
+		e->addr = to_user_pointer(ptr);
+		e->size = size;
+		igt_map_insert(mmap_cache.keys, &e->key, e);
+		igt_map_insert(mmap_cache.addrs, &e->addr, e);
+		mmap_cache.count++;
+	}
+
+	e->refcount++;
+	ptr = from_user_pointer(e->addr);
+out:
+	pthread_mutex_unlock(&mmap_cache.mutex);
+
+	return ptr;
+}
+
+/**
+ * gem_mmap_get:
+ * @fd: open i915 drm file descriptor
+ * @handle: gem buffer object handle
+ * @size: size of the mapping, from the start of the object
+ * @type: I915_MMAP_OFFSET_* type of the mapping
+ *
+ * Like __gem_mmap_get() except we assert on failure.
+ *
+ * Returns: A pointer to the mapping.
+ */
+void *gem_mmap_get(int fd, uint32_t handle, uint64_t size, unsigned int type)
+{
+	void *ptr = __gem_mmap_get(fd, handle, size, type);
+
+	igt_assert(ptr);
+	return ptr;
+}
+
+/**
+ * gem_mmap_put:
+ * @ptr: mapping returned by gem_mmap_get()
+ *
+ * Releases a mapping from gem_mmap_get(). It stays cached for the next
+ * gem_mmap_get() of the same handle and type, unless the handle has been
+ * closed meanwhile.
+ */
+void gem_mmap_put(void *ptr)
+{
+	uint64_t addr = to_user_pointer(ptr);
+	struct mmap_cache_entry *e;
+
+	pthread_mutex_lock(&mmap_cache.mutex);
+	e = mmap_cache.addrs ? igt_map_search(mmap_cache.addrs, &addr) : NULL;
+	igt_assert_f(e && e->refcount,
+		     "%p is not a mapping from gem_mmap_get()\n", ptr);
+
+	if (!--e->refcount && e->closed)
+		mmap_cache_free(e);
+	pthread_mutex_unlock(&mmap_cache.mutex);
+}
+
+/**
+ * gem_mmap_cache_release:
+ * @fd: open drm file descriptor
+ * @handle: gem buffer object handle
+ *
+ * Drops the cached mappings of @handle, called by gem_close().
+ */
+void gem_mmap_cache_release(int fd, uint32_t handle)
+{
+	if (!READ_ONCE(mmap_cache.count))
+		return;
+
+	pthread_mutex_lock(&mmap_cache.mutex);
+	for (unsigned int type = 0; type <= MMAP_CACHE_MAX_TYPE; type++) {
+		uint64_t key = mmap_cache_key(fd, handle, type);
+		struct mmap_cache_entry *e;
+
+		e = igt_map_search(mmap_cache.keys, &key);
+		if (e)
+			mmap_cache_close(e);
+	}
+	pthread_mutex_unlock(&mmap_cache.mutex);
+}
+
+/**
+ * gem_mmap_cache_flush:
+ * @fd: open drm file descriptor
+ *
+ * Drops the cached mappings of all handles of @fd, called by
+ * drm_close_driver().
+ */
+void gem_mmap_cache_flush(int fd)
+{
+	struct igt_map_entry *pos;
+
+	if (!READ_ONCE(mmap_cache.count))
+		return;
+
+	pthread_mutex_lock(&mmap_cache.mutex);
+	igt_map_foreach(mmap_cache.keys, pos) {
+		struct mmap_cache_entry *e = pos->data;
+
+		if (e->key >> 35 == fd)
+			mmap_cache_close(e);
+	}
+	pthread_mutex_unlock(&mmap_cache.mutex);
+}
+
 bool gem_has_mappable_ggtt(int i915)
 {
 	struct drm_i915_gem_mmap_gtt arg = {};
@@ -68,6 +68,12 @@ void *__gem_mmap__cpu_coherent(int fd, uint32_t handle, uint64_t offset,
 
 int gem_munmap(void *ptr, uint64_t size);
 
+void *__gem_mmap_get(int fd, uint32_t handle, uint64_t size, unsigned int type);
+void *gem_mmap_get(int fd, uint32_t handle, uint64_t size, unsigned int type);
+void gem_mmap_put(void *ptr);
+void gem_mmap_cache_release(int fd, uint32_t handle);
+void gem_mmap_cache_flush(int fd);
+
 /**
  * gem_require_mmap_offset:
  * @fd: open i915 drm file descriptor
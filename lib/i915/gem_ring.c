@@ -21,10 +21,16 @@
  * IN THE SOFTWARE.
  */
 
+#include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <sys/ioctl.h>
+#include <sys/stat.h>
 #include <sys/time.h>
+#include <unistd.h>
 
 #include "gem.h"
 #include "gem_create.h"
@@ -36,6 +42,7 @@
 #include "ioctl_wrappers.h"
 #include "igt_dummyload.h"
 #include "igt_gt.h"
+#include "igt_sysfs.h"
 
 static int __execbuf(int fd, struct drm_i915_gem_execbuffer2 *execbuf)
 {
@@ -129,6 +136,161 @@ __gem_measure_ring_inflight(int fd, unsigned int engine, enum measure_ring_flags
 	return count - 2;
 }
 
+/*
+ * The measurement is kept in a file of a private directory in the runtime
+ * directory, so that the following tests of the same driver instance don't
+ * redo it. The entries are keyed by the boot and by the creation time of
+ * the drm device in sysfs, which changes with each driver load or bind.
+ * Setting IGT_RING_INFLIGHT_CACHE=0 measures every time.
+ */
+#define RING_CACHE_DIR "igt"
+#define RING_CACHE_FILE "ring_inflight"
+/* Far more batches than any ring holds, anything above is corrupted */
+#define RING_CACHE_MAX_COUNT (1u << 16)
+
+static bool ring_cache_key(int fd, char *key, size_t len)
+{
+	const char *env = getenv("IGT_RING_INFLIGHT_CACHE");
+	char boot_id[64] = {};
+	struct stat dev, st;
+	int dir, boot;
+
+	if (env && !atoi(env))
+		return false;
+
+	boot = open("/proc/sys/kernel/random/boot_id", O_RDONLY);
+	if (boot < 0)
+		return false;
+	if (read(boot, boot_id, sizeof(boot_id) - 1) <= 0)
+		boot_id[0] = '\0';
+	close(boot);
+	boot_id[strcspn(boot_id, "\n")] = '\0';
+	if (!boot_id[0])
+		return false;
+
+	if (fstat(fd, &dev))
+		return false;
+
+	/* The sysfs directory of the drm minor, created with the device */
+	dir = igt_sysfs_open(fd);
+	if (dir < 0)
+		return false;
+	if (fstat(dir, &st)) {
+		close(dir);
+		return false;
+	}
+	close(dir);
+
+	snprintf(key, len, "%s:%llx:%lld.%09ld", boot_id,
+		 (unsigned long long)dev.st_rdev,
+		 (long long)st.st_ctim.tv_sec, st.st_ctim.tv_nsec);
+
+	return true;
+}
+
+/*
+ * Without XDG_RUNTIME_DIR the directory ends up in the shared /tmp, so
+ * only use it if it's ours and nobody else can create files or links in
+ * it.
+ */
+static int ring_cache_open(int flags)
+{
+	const char *base = getenv("XDG_RUNTIME_DIR");
+	char path[PATH_MAX];
+	struct stat st;
+	int dir, file;
+
+	snprintf(path, sizeof(path), "%s/" RING_CACHE_DIR "-%u",
+		 base ?: "/tmp", getuid());
+	if (mkdir(path, 0700) && errno != EEXIST)
+		return -1;
+
+	dir = open(path, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+	if (dir < 0)
+		return -1;
+
+	if (fstat(dir, &st) || st.st_uid != getuid() || st.st_mode & 077) {
+		close(dir);
+		return -1;
+	}
+
+	file = openat(dir, RING_CACHE_FILE, flags | O_NOFOLLOW | O_CLOEXEC,
+		      0600);
+	close(dir);
+
+	return file;
+}
+
+static unsigned int
+ring_cache_lookup(const char *key, unsigned int engine,
+		  enum measure_ring_flags flags)
+{
+	unsigned int e, f, count = 0;
+	char line[256], k[160];
+	FILE *file;
+	int fd;
+
+	fd = ring_cache_open(O_RDONLY);
+	if (fd < 0)
+		return 0;
+
+	file = fdopen(fd, "r");
+	if (!file) {
+		close(fd);
+		return 0;
+	}
+
+	while (fgets(line, sizeof(line), file)) {
+		unsigned int c;
+
+		if (sscanf(line, "%159s %x %x %u", k, &e, &f, &c) != 4 ||
+		    !c || c > RING_CACHE_MAX_COUNT)
+			continue;
+
+		/* Later entries win, in case of a concurrent measurement */
+		if (e == engine && f == flags && !strcmp(k, key))
+			count = c;
+	}
+	fclose(file);
+
+	return count;
+}
+
+static void ring_cache_store(const char *key, unsigned int engine,
+			     enum measure_ring_flags flags, unsigned int count)
+{
+	char line[256];
+	int file, len;
+
+	file = ring_cache_open(O_WRONLY | O_APPEND | O_CREAT);
+	if (file < 0)
+		return;
+
+	/* A single small append, so entries of concurrent tests don't mix */
+	len = snprintf(line, sizeof(line), "%s %x %x %u\n",
+		       key, engine, flags, count);
+	igt_debug_on(write(file, line, len) != len);
+	close(file);
+}
+
+static unsigned int
+ring_inflight(int fd, const char *key, unsigned int engine,
+	      enum measure_ring_flags flags)
+{
+	unsigned int count = 0;
+
+	if (key)
+		count = ring_cache_lookup(key, engine, flags);
+
+	if (!count) {
+		count = __gem_measure_ring_inflight(fd, engine, flags);
+		if (key)
+			ring_cache_store(key, engine, flags, count);
+	}
+
+	return count;
+}
+
 /**
  * gem_measure_ring_inflight:
  * @fd: open i915 drm file descriptor
@@ -139,7 +301,9 @@ __gem_measure_ring_inflight(int fd, unsigned int engine, enum measure_ring_flags
  *		  used by the lrc init.
  *
  * This function calculates the maximum number of batches that can be inserted
- * at the same time in the ring on the selected engine.
+ * at the same time in the ring on the selected engine. The result is kept
+ * for the lifetime of the driver instance, the next calls, from this or any
+ * other test, reuse it instead of measuring again.
  *
  * Returns:
  * Number of batches that fit in the ring
@@ -147,8 +311,11 @@ __gem_measure_ring_inflight(int fd, unsigned int engine, enum measure_ring_flags
 unsigned int
 gem_measure_ring_inflight(int fd, unsigned int engine, enum measure_ring_flags flags)
 {
+	char key[160], *k;
 	unsigned int min = ~0u;
 
+	k = ring_cache_key(fd, key, sizeof(key)) ? key : NULL;
+
 	fd = drm_reopen_driver(fd);
 
 	/* When available, disable execbuf throttling */
@@ -157,13 +324,13 @@ gem_measure_ring_inflight(int fd, unsigned int engine, enum measure_ring_flags f
 	if (engine == ALL_ENGINES) {
 		for_each_physical_ring(e, fd) {
 			unsigned int count =
-				__gem_measure_ring_inflight(fd, eb_ring(e), flags);
+				ring_inflight(fd, k, eb_ring(e), flags);
 
 			if (count < min)
 				min = count;
 		}
 	} else {
-		min =  __gem_measure_ring_inflight(fd, engine, flags);
+		min = ring_inflight(fd, k, engine, flags);
 	}
 
 	close(fd);
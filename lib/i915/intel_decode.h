@@ -29,6 +29,19 @@
 
 struct intel_decode;
 
+/* An instruction found by intel_decode_records() */
+struct intel_decode_record {
+	uint32_t offset;	/* GPU address of the instruction */
+	uint32_t client;	/* bits 31:29 of the header */
+	uint32_t opcode;	/* opcode bits of the header for the client */
+	uint32_t length;	/* in dwords, including the header */
+	const char *name;	/* NULL if unknown */
+	const uint32_t *data;	/* the header, followed by the other dwords */
+};
+
+typedef int (*intel_decode_record_fn)(void *data,
+				      const struct intel_decode_record *record);
+
 struct intel_decode *intel_decode_context_alloc(uint32_t devid);
 void intel_decode_context_free(struct intel_decode *ctx);
 void intel_decode_set_dump_past_end(struct intel_decode *ctx, int dump_past_end);
@@ -38,5 +51,7 @@ void intel_decode_set_head_tail(struct intel_decode *ctx,
 				uint32_t head, uint32_t tail);
 void intel_decode_set_output_file(struct intel_decode *ctx, FILE *output);
 void intel_decode(struct intel_decode *ctx);
+int intel_decode_records(struct intel_decode *ctx,
+			 intel_decode_record_fn fn, void *data);
 
 #endif /* INTEL_DECODE_H */
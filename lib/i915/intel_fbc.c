@@ -39,20 +39,23 @@ bool intel_fbc_supported_on_chipset(int device, enum pipe pipe)
 		!strstr(buf, "stolen memory not initialised\n");
 }
 
-static bool _intel_fbc_is_enabled(int device, enum pipe pipe, int log_level, char *last_fbc_buf)
+/* How long the last successful intel_fbc_wait_until_enabled() took */
+static uint64_t fbc_enable_latency_ns;
+
+static bool _intel_fbc_is_enabled(struct igt_debugfs_file *status,
+				  int log_level, char *last_fbc_buf)
 {
-	char buf[FBC_STATUS_BUF_LEN];
+	const char *buf;
 	bool print = true;
-	int dir;
 
-	dir = igt_debugfs_pipe_dir(device, pipe, O_DIRECTORY);
-	igt_require_fd(dir);
-	igt_debugfs_simple_read(dir, "i915_fbc_status", buf, sizeof(buf));
-	close(dir);
+	buf = status ? igt_debugfs_file_read(status) : NULL;
+	if (!buf)
+		buf = "";
+
 	if (log_level != IGT_LOG_DEBUG)
 		last_fbc_buf[0] = '\0';
-	else if (strcmp(last_fbc_buf, buf))
-		strcpy(last_fbc_buf, buf);
+	else if (strncmp(last_fbc_buf, buf, FBC_STATUS_BUF_LEN - 1))
+		snprintf(last_fbc_buf, FBC_STATUS_BUF_LEN, "%s", buf);
 	else
 		print = false;
 
@@ -77,8 +80,18 @@ static bool _intel_fbc_is_enabled(int device, enum pipe pipe, int log_level, cha
 bool intel_fbc_is_enabled(int device, enum pipe pipe, int log_level)
 {
 	char last_fbc_buf[FBC_STATUS_BUF_LEN] = {'\0'};
+	struct igt_debugfs_file *status;
+	bool enabled;
+	int dir;
+
+	dir = igt_debugfs_pipe_dir(device, pipe, O_DIRECTORY);
+	igt_require_fd(dir);
+	status = igt_debugfs_file_open(dir, "i915_fbc_status");
+	enabled = _intel_fbc_is_enabled(status, log_level, last_fbc_buf);
+	igt_debugfs_file_close(status);
+	close(dir);
 
-	return _intel_fbc_is_enabled(device, pipe, log_level, last_fbc_buf);
+	return enabled;
 }
 
 /**
@@ -94,7 +107,18 @@ bool intel_fbc_is_enabled(int device, enum pipe pipe, int log_level)
 bool intel_fbc_wait_until_enabled(int device, enum pipe pipe)
 {
 	char last_fbc_buf[FBC_STATUS_BUF_LEN] = {'\0'};
-	bool enabled = igt_wait(_intel_fbc_is_enabled(device, pipe, IGT_LOG_DEBUG, last_fbc_buf), 2000, 1);
+	struct igt_debugfs_file *status;
+	bool enabled;
+	int dir;
+
+	dir = igt_debugfs_pipe_dir(device, pipe, O_DIRECTORY);
+	igt_require_fd(dir);
+	status = igt_debugfs_file_open(dir, "i915_fbc_status");
+	enabled = igt_wait_adaptive(_intel_fbc_is_enabled(status, IGT_LOG_DEBUG,
+							  last_fbc_buf),
+				    2000, 1, &fbc_enable_latency_ns);
+	igt_debugfs_file_close(status);
+	close(dir);
 
 	if (!enabled)
 		igt_info("FBC is not enabled: \n%s\n", last_fbc_buf);
@@ -102,6 +126,18 @@ bool intel_fbc_wait_until_enabled(int device, enum pipe pipe)
 	return enabled;
 }
 
+/**
+ * intel_fbc_last_enable_latency_ns:
+ *
+ * Returns:
+ * How long the last successful intel_fbc_wait_until_enabled() waited for FBC
+ * to be enabled, in nanoseconds.
+ */
+uint64_t intel_fbc_last_enable_latency_ns(void)
+{
+	return fbc_enable_latency_ns;
+}
+
 /**
  * intel_fbc_max_plane_size
  *
@@ -116,7 +116,7 @@ def generate_metric_sets(args, gen):
         for counter in counters:
           output_availability_funcs(set, counter)
 
-        c("\nstatic void\n")
+        c("\nstatic struct intel_perf_metric_set *\n")
         c(gen.chipset + "_add_" + set.underscore_name + "_metric_set(struct intel_perf *perf)")
         c("{\n")
         c.indent(4)
@@ -214,18 +214,34 @@ def generate_metric_sets(args, gen):
         c.outdent(4)
         c("}")
         c("\nassert(metric_set->n_counters <= {0});\n".format(len(counters)));
+        c("return metric_set;")
 
         c.outdent(4)
         c("}\n")
 
-    c("\nvoid")
-    c("intel_perf_load_metrics_" + gen.chipset + "(struct intel_perf *perf)")
-    c("{")
+    # Only this table is used until a metric set is needed, at which point
+    # its add function is called to instantiate it.
+    c("\nstatic const struct intel_perf_metric_set_desc " + gen.chipset + "_metric_sets[] = {")
     c.indent(4)
 
     for set in gen.sets:
-        c("{0}_add_{1}_metric_set(perf);".format(gen.chipset, set.underscore_name))
+        c("{")
+        c.indent(4)
+        c(".name = \"" + set.name + "\",")
+        c(".symbol_name = \"" + set.symbol_name + "\",")
+        c(".hw_config_guid = \"" + set.hw_config_guid + "\",")
+        c(".add = {0}_add_{1}_metric_set,".format(gen.chipset, set.underscore_name))
+        c.outdent(4)
+        c("},")
 
+    c.outdent(4)
+    c("};")
+
+    c("\nvoid")
+    c("intel_perf_register_metrics_" + gen.chipset + "(struct intel_perf *perf)")
+    c("{")
+    c.indent(4)
+    c("intel_perf_register_metric_sets(perf, {0}_metric_sets, sizeof({0}_metric_sets) / sizeof({0}_metric_sets[0]));".format(gen.chipset))
     c.outdent(4)
     c("}")
 
@@ -292,7 +308,7 @@ def main():
         """ % (header_define, header_define)))
 
     # Print out all set registration functions for each generation.
-    h("void intel_perf_load_metrics_" + gen.chipset + "(struct intel_perf *perf);\n\n")
+    h("void intel_perf_register_metrics_" + gen.chipset + "(struct intel_perf *perf);\n\n")
 
     h(textwrap.dedent("""\
         #endif /* %s */
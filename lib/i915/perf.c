@@ -25,6 +25,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <dirent.h>
 #include <fcntl.h>
 #include <sys/ioctl.h>
@@ -37,6 +38,7 @@
 
 #include <i915_drm.h>
 
+#include "igt_x86.h"
 #include "pciids.h"
 #include "i915_pciids_local.h"
 
@@ -258,13 +260,14 @@ is_arl_gt2(const struct intel_perf_devinfo *devinfo)
 	return false;
 }
 
-struct intel_perf *
-intel_perf_for_devinfo(uint32_t device_id,
-		       uint32_t revision,
-		       uint64_t timestamp_frequency,
-		       uint64_t gt_min_freq,
-		       uint64_t gt_max_freq,
-		       const struct drm_i915_query_topology_info *topology)
+static struct intel_perf *
+perf_for_devinfo(uint32_t device_id,
+		 uint32_t revision,
+		 uint64_t timestamp_frequency,
+		 uint64_t gt_min_freq,
+		 uint64_t gt_max_freq,
+		 const struct drm_i915_query_topology_info *topology,
+		 bool lazy)
 {
 	const struct intel_device_info *devinfo = intel_get_device_info(device_id);
 	struct intel_perf *perf;
@@ -359,77 +362,77 @@ intel_perf_for_devinfo(uint32_t device_id,
 	perf->devinfo.oa_timestamp_shift = 0;
 
 	if (devinfo->is_haswell) {
-		intel_perf_load_metrics_hsw(perf);
+		intel_perf_register_metrics_hsw(perf);
 	} else if (devinfo->is_broadwell) {
-		intel_perf_load_metrics_bdw(perf);
+		intel_perf_register_metrics_bdw(perf);
 	} else if (devinfo->is_cherryview) {
-		intel_perf_load_metrics_chv(perf);
+		intel_perf_register_metrics_chv(perf);
 	} else if (devinfo->is_skylake) {
 		switch (devinfo->gt) {
 		case 2:
-			intel_perf_load_metrics_sklgt2(perf);
+			intel_perf_register_metrics_sklgt2(perf);
 			break;
 		case 3:
-			intel_perf_load_metrics_sklgt3(perf);
+			intel_perf_register_metrics_sklgt3(perf);
 			break;
 		case 4:
-			intel_perf_load_metrics_sklgt4(perf);
+			intel_perf_register_metrics_sklgt4(perf);
 			break;
 		default:
 			return unsupported_i915_perf_platform(perf);
 		}
 	} else if (devinfo->is_broxton) {
 		perf->devinfo.eu_threads_count = 6;
-		intel_perf_load_metrics_bxt(perf);
+		intel_perf_register_metrics_bxt(perf);
 	} else if (devinfo->is_kabylake) {
 		switch (devinfo->gt) {
 		case 2:
-			intel_perf_load_metrics_kblgt2(perf);
+			intel_perf_register_metrics_kblgt2(perf);
 			break;
 		case 3:
-			intel_perf_load_metrics_kblgt3(perf);
+			intel_perf_register_metrics_kblgt3(perf);
 			break;
 		default:
 			return unsupported_i915_perf_platform(perf);
 		}
 	} else if (devinfo->is_geminilake) {
 		perf->devinfo.eu_threads_count = 6;
-		intel_perf_load_metrics_glk(perf);
+		intel_perf_register_metrics_glk(perf);
 	} else if (devinfo->is_coffeelake || devinfo->is_cometlake) {
 		switch (devinfo->gt) {
 		case 2:
-			intel_perf_load_metrics_cflgt2(perf);
+			intel_perf_register_metrics_cflgt2(perf);
 			break;
 		case 3:
-			intel_perf_load_metrics_cflgt3(perf);
+			intel_perf_register_metrics_cflgt3(perf);
 			break;
 		default:
 			return unsupported_i915_perf_platform(perf);
 		}
 	} else if (devinfo->is_cannonlake) {
-		intel_perf_load_metrics_cnl(perf);
+		intel_perf_register_metrics_cnl(perf);
 	} else if (devinfo->is_icelake) {
-		intel_perf_load_metrics_icl(perf);
+		intel_perf_register_metrics_icl(perf);
 	} else if (devinfo->is_elkhartlake || devinfo->is_jasperlake) {
-		intel_perf_load_metrics_ehl(perf);
+		intel_perf_register_metrics_ehl(perf);
 	} else if (devinfo->is_tigerlake) {
 		switch (devinfo->gt) {
 		case 1:
-			intel_perf_load_metrics_tglgt1(perf);
+			intel_perf_register_metrics_tglgt1(perf);
 			break;
 		case 2:
-			intel_perf_load_metrics_tglgt2(perf);
+			intel_perf_register_metrics_tglgt2(perf);
 			break;
 		default:
 			return unsupported_i915_perf_platform(perf);
 		}
 	} else if (devinfo->is_rocketlake) {
-		intel_perf_load_metrics_rkl(perf);
+		intel_perf_register_metrics_rkl(perf);
 	} else if (devinfo->is_dg1) {
-		intel_perf_load_metrics_dg1(perf);
+		intel_perf_register_metrics_dg1(perf);
 	} else if (devinfo->is_alderlake_s || devinfo->is_alderlake_p ||
 		   devinfo->is_raptorlake_s || devinfo->is_alderlake_n) {
-		intel_perf_load_metrics_adl(perf);
+		intel_perf_register_metrics_adl(perf);
 	} else if (devinfo->is_dg2) {
 		perf->devinfo.eu_threads_count = 8;
 		/* OA reports have the timestamp value shifted to the
@@ -440,11 +443,11 @@ intel_perf_for_devinfo(uint32_t device_id,
 		perf->devinfo.oa_timestamp_mask = 0x7fffffff;
 
 		if (is_acm_gt1(&perf->devinfo))
-			intel_perf_load_metrics_acmgt1(perf);
+			intel_perf_register_metrics_acmgt1(perf);
 		else if (is_acm_gt2(&perf->devinfo))
-			intel_perf_load_metrics_acmgt2(perf);
+			intel_perf_register_metrics_acmgt2(perf);
 		else if (is_acm_gt3(&perf->devinfo))
-			intel_perf_load_metrics_acmgt3(perf);
+			intel_perf_register_metrics_acmgt3(perf);
 		else
 			return unsupported_i915_perf_platform(perf);
 	} else if (devinfo->is_meteorlake) {
@@ -457,22 +460,54 @@ intel_perf_for_devinfo(uint32_t device_id,
 		perf->devinfo.oa_timestamp_mask = 0x7fffffff;
 
 		if (is_mtl_gt2(&perf->devinfo))
-			intel_perf_load_metrics_mtlgt2(perf);
+			intel_perf_register_metrics_mtlgt2(perf);
 		else if (is_mtl_gt3(&perf->devinfo))
-			intel_perf_load_metrics_mtlgt3(perf);
+			intel_perf_register_metrics_mtlgt3(perf);
 		else if (is_arl_gt1(&perf->devinfo))
-			intel_perf_load_metrics_mtlgt2(perf);
+			intel_perf_register_metrics_mtlgt2(perf);
 		else if (is_arl_gt2(&perf->devinfo))
-			intel_perf_load_metrics_mtlgt3(perf);
+			intel_perf_register_metrics_mtlgt3(perf);
 		else
 			return unsupported_i915_perf_platform(perf);
 	} else {
 		return unsupported_i915_perf_platform(perf);
 	}
 
+	if (!lazy)
+		intel_perf_load_metric_sets(perf);
+
 	return perf;
 }
 
+struct intel_perf *
+intel_perf_for_devinfo(uint32_t device_id,
+		       uint32_t revision,
+		       uint64_t timestamp_frequency,
+		       uint64_t gt_min_freq,
+		       uint64_t gt_max_freq,
+		       const struct drm_i915_query_topology_info *topology)
+{
+	return perf_for_devinfo(device_id, revision, timestamp_frequency,
+				gt_min_freq, gt_max_freq, topology, false);
+}
+
+/*
+ * Same as intel_perf_for_devinfo() but only registers the metric sets of the
+ * platform, they get instantiated on demand by intel_perf_find_metric_set()
+ * or all at once by intel_perf_load_metric_sets().
+ */
+struct intel_perf *
+intel_perf_for_devinfo_lazy(uint32_t device_id,
+			    uint32_t revision,
+			    uint64_t timestamp_frequency,
+			    uint64_t gt_min_freq,
+			    uint64_t gt_max_freq,
+			    const struct drm_i915_query_topology_info *topology)
+{
+	return perf_for_devinfo(device_id, revision, timestamp_frequency,
+				gt_min_freq, gt_max_freq, topology, true);
+}
+
 static int
 getparam(int drm_fd, uint32_t param, uint32_t *val)
 {
@@ -629,8 +664,8 @@ intel_sysfs_attr_id_to_name(int sysfs_dirfd, intel_sysfs_attr_id id, int gt)
 		intel_sysfs_attr_name[0][id];
 }
 
-struct intel_perf *
-intel_perf_for_fd(int drm_fd, int gt)
+static struct intel_perf *
+perf_for_fd(int drm_fd, int gt, bool lazy)
 {
 	uint32_t device_id;
 	uint32_t device_revision;
@@ -667,17 +702,30 @@ intel_perf_for_fd(int drm_fd, int gt)
 	if (!topology)
 		return NULL;
 
-	ret = intel_perf_for_devinfo(device_id,
-				     device_revision,
-				     timestamp_frequency,
-				     gt_min_freq * 1000000,
-				     gt_max_freq * 1000000,
-				     topology);
+	ret = perf_for_devinfo(device_id,
+			       device_revision,
+			       timestamp_frequency,
+			       gt_min_freq * 1000000,
+			       gt_max_freq * 1000000,
+			       topology,
+			       lazy);
 	free(topology);
 
 	return ret;
 }
 
+struct intel_perf *
+intel_perf_for_fd(int drm_fd, int gt)
+{
+	return perf_for_fd(drm_fd, gt, false);
+}
+
+struct intel_perf *
+intel_perf_for_fd_lazy(int drm_fd, int gt)
+{
+	return perf_for_fd(drm_fd, gt, true);
+}
+
 void
 intel_perf_free(struct intel_perf *perf)
 {
@@ -690,6 +738,7 @@ intel_perf_free(struct intel_perf *perf)
 		intel_perf_metric_set_free(metric_set);
 	}
 
+	free(perf->loaded_metric_sets);
 	free(perf);
 }
 
@@ -737,6 +786,52 @@ intel_perf_add_metric_set(struct intel_perf *perf,
 	igt_list_add_tail(&metric_set->link, &perf->metric_sets);
 }
 
+void
+intel_perf_register_metric_sets(struct intel_perf *perf,
+				const struct intel_perf_metric_set_desc *descs,
+				uint32_t n_descs)
+{
+	assert(!perf->metric_set_descs);
+
+	perf->metric_set_descs = descs;
+	perf->n_metric_set_descs = n_descs;
+	perf->loaded_metric_sets = calloc(n_descs, sizeof(*perf->loaded_metric_sets));
+}
+
+static struct intel_perf_metric_set *
+load_metric_set(struct intel_perf *perf, uint32_t index)
+{
+	if (!perf->loaded_metric_sets[index])
+		perf->loaded_metric_sets[index] = perf->metric_set_descs[index].add(perf);
+
+	return perf->loaded_metric_sets[index];
+}
+
+struct intel_perf_metric_set *
+intel_perf_find_metric_set(struct intel_perf *perf, const char *symbol_name)
+{
+	struct intel_perf_metric_set *metric_set;
+
+	igt_list_for_each_entry(metric_set, &perf->metric_sets, link) {
+		if (!strcasecmp(metric_set->symbol_name, symbol_name))
+			return metric_set;
+	}
+
+	for (uint32_t i = 0; i < perf->n_metric_set_descs; i++) {
+		if (!strcasecmp(perf->metric_set_descs[i].symbol_name, symbol_name))
+			return load_metric_set(perf, i);
+	}
+
+	return NULL;
+}
+
+void
+intel_perf_load_metric_sets(struct intel_perf *perf)
+{
+	for (uint32_t i = 0; i < perf->n_metric_set_descs; i++)
+		load_metric_set(perf, i);
+}
+
 static void
 load_metric_set_config(struct intel_perf_metric_set *metric_set, int drm_fd)
 {
@@ -823,150 +918,349 @@ intel_perf_load_perf_configs(struct intel_perf *perf, int drm_fd)
 	}
 }
 
+/*
+ * The accumulation helpers operate on runs of @n consecutive counters. The
+ * 40bit A counters keep their low 32 bits in dword 4 + a_index of a report
+ * and their high 8 bits in byte a_index starting at dword 40.
+ */
 static void
 accumulate_uint32(const uint32_t *report0,
                   const uint32_t *report1,
-                  uint64_t *deltas)
+                  uint64_t *deltas,
+                  int n)
+{
+	for (int i = 0; i < n; i++)
+		deltas[i] += (uint32_t)(report1[i] - report0[i]);
+}
+
+static inline uint64_t
+read_uint40(const uint32_t *report, int a_index)
 {
-	*deltas += (uint32_t)(*report1 - *report0);
+	const uint8_t *high_bytes = (const uint8_t *)(report + 40);
+
+	return report[a_index + 4] | (uint64_t)high_bytes[a_index] << 32;
 }
 
 static void
 accumulate_uint40(int a_index,
                   const uint32_t *report0,
                   const uint32_t *report1,
-                  uint64_t *deltas)
+                  uint64_t *deltas,
+                  int n)
+{
+	/* Both values are below 2^40, so masking also handles wraparound. */
+	for (int i = 0; i < n; i++)
+		deltas[i] += (read_uint40(report1, a_index + i) -
+			      read_uint40(report0, a_index + i)) & ((1ULL << 40) - 1);
+}
+
+typedef void (*accumulate_uint32_fn)(const uint32_t *report0,
+				     const uint32_t *report1,
+				     uint64_t *deltas, int n);
+typedef void (*accumulate_uint40_fn)(int a_index,
+				     const uint32_t *report0,
+				     const uint32_t *report1,
+				     uint64_t *deltas, int n);
+
+static inline uint32_t
+timestamp_delta32(const struct intel_perf *perf, uint32_t delta)
 {
-	const uint8_t *high_bytes0 = (uint8_t *)(report0 + 40);
-	const uint8_t *high_bytes1 = (uint8_t *)(report1 + 40);
-	uint64_t high0 = (uint64_t)(high_bytes0[a_index]) << 32;
-	uint64_t high1 = (uint64_t)(high_bytes1[a_index]) << 32;
-	uint64_t value0 = report0[a_index + 4] | high0;
-	uint64_t value1 = report1[a_index + 4] | high1;
-	uint64_t delta;
-
-	if (value0 > value1)
-		delta = (1ULL << 40) + value1 - value0;
+	if (perf->devinfo.oa_timestamp_shift >= 0)
+		return delta << perf->devinfo.oa_timestamp_shift;
 	else
-		delta = value1 - value0;
+		return delta >> (-perf->devinfo.oa_timestamp_shift);
+}
 
-	*deltas += delta;
+static inline uint64_t
+timestamp_delta64(const struct intel_perf *perf, uint64_t delta)
+{
+	if (perf->devinfo.oa_timestamp_shift >= 0)
+		return delta << perf->devinfo.oa_timestamp_shift;
+	else
+		return delta >> (-perf->devinfo.oa_timestamp_shift);
 }
 
-void intel_perf_accumulate_reports(struct intel_perf_accumulator *acc,
-				   const struct intel_perf *perf,
-				   const struct intel_perf_metric_set *metric_set,
-				   const struct drm_i915_perf_record_header *record0,
-				   const struct drm_i915_perf_record_header *record1)
+static inline __attribute__((always_inline)) void
+accumulate_a24u40_a14u32_b8_c8(const struct intel_perf *perf,
+			       const uint32_t *start, const uint32_t *end,
+			       uint64_t *deltas,
+			       accumulate_uint32_fn acc32,
+			       accumulate_uint40_fn acc40)
 {
-	const uint32_t *start = (const uint32_t *)(record0 + 1);
-	const uint32_t *end = (const uint32_t *)(record1 + 1);
-	uint64_t *deltas = acc->deltas;
-	int idx = 0;
-	int i;
+	/* timestamp */
+	deltas[0] += timestamp_delta32(perf, end[1] - start[1]);
+	acc32(start + 3, end + 3, deltas + 1, 1); /* clock */
 
-	memset(acc, 0, sizeof(*acc));
+	/* 4x 32bit A0-3 counters... */
+	acc32(start + 4, end + 4, deltas + 2, 4);
 
-	switch (metric_set->perf_oa_format) {
-	case I915_OA_FORMAT_A24u40_A14u32_B8_C8:
-		/* timestamp */
-		if (perf->devinfo.oa_timestamp_shift >= 0)
-			deltas[idx++] += (end[1] - start[1]) << perf->devinfo.oa_timestamp_shift;
-		else
-			deltas[idx++] += (end[1] - start[1]) >> (-perf->devinfo.oa_timestamp_shift);
-		accumulate_uint32(start + 3, end + 3, deltas + idx++); /* clock */
+	/* 20x 40bit A4-23 counters... */
+	acc40(4, start, end, deltas + 6, 20);
 
-		/* 4x 32bit A0-3 counters... */
-		for (i = 0; i < 4; i++)
-			accumulate_uint32(start + 4 + i, end + 4 + i, deltas + idx++);
+	/* 4x 32bit A24-27 counters... */
+	acc32(start + 28, end + 28, deltas + 26, 4);
 
-		/* 20x 40bit A4-23 counters... */
-		for (i = 0; i < 20; i++)
-			accumulate_uint40(i + 4, start, end, deltas + idx++);
+	/* 4x 40bit A28-31 counters... */
+	acc40(28, start, end, deltas + 30, 4);
 
-		/* 4x 32bit A24-27 counters... */
-		for (i = 0; i < 4; i++)
-			accumulate_uint32(start + 28 + i, end + 28 + i, deltas + idx++);
+	/* 5x 32bit A32-36 counters... */
+	acc32(start + 36, end + 36, deltas + 34, 5);
 
-		/* 4x 40bit A28-31 counters... */
-		for (i = 0; i < 4; i++)
-			accumulate_uint40(i + 28, start, end, deltas + idx++);
+	/* 1x 32bit A37 counter... */
+	acc32(start + 46, end + 46, deltas + 39, 1);
 
-		/* 5x 32bit A32-36 counters... */
-		for (i = 0; i < 5; i++)
-			accumulate_uint32(start + 36 + i, end + 36 + i, deltas + idx++);
+	/* 8x 32bit B counters + 8x 32bit C counters... */
+	acc32(start + 48, end + 48, deltas + 40, 16);
+}
 
-		/* 1x 32bit A37 counter... */
-		accumulate_uint32(start + 46, end + 46, deltas + idx++);
+static inline __attribute__((always_inline)) void
+accumulate_a32u40_a4u32_b8_c8(const struct intel_perf *perf,
+			      const uint32_t *start, const uint32_t *end,
+			      uint64_t *deltas,
+			      accumulate_uint32_fn acc32,
+			      accumulate_uint40_fn acc40)
+{
+	deltas[0] += timestamp_delta32(perf, end[1] - start[1]);
+	acc32(start + 3, end + 3, deltas + 1, 1); /* clock */
 
-		/* 8x 32bit B counters + 8x 32bit C counters... */
-		for (i = 0; i < 16; i++)
-			accumulate_uint32(start + 48 + i, end + 48 + i, deltas + idx++);
-		break;
+	/* 32x 40bit A counters... */
+	acc40(0, start, end, deltas + 2, 32);
 
-	case I915_OAR_FORMAT_A32u40_A4u32_B8_C8:
-	case I915_OA_FORMAT_A32u40_A4u32_B8_C8:
-		if (perf->devinfo.oa_timestamp_shift >= 0)
-			deltas[idx++] += (end[1] - start[1]) << perf->devinfo.oa_timestamp_shift;
-		else
-			deltas[idx++] += (end[1] - start[1]) >> (-perf->devinfo.oa_timestamp_shift);
-		accumulate_uint32(start + 3, end + 3, deltas + idx++); /* clock */
+	/* 4x 32bit A counters... */
+	acc32(start + 36, end + 36, deltas + 34, 4);
 
-		/* 32x 40bit A counters... */
-		for (i = 0; i < 32; i++)
-			accumulate_uint40(i, start, end, deltas + idx++);
+	/* 8x 32bit B counters + 8x 32bit C counters... */
+	acc32(start + 48, end + 48, deltas + 38, 16);
+}
 
-		/* 4x 32bit A counters... */
-		for (i = 0; i < 4; i++)
-			accumulate_uint32(start + 36 + i, end + 36 + i, deltas + idx++);
+static inline __attribute__((always_inline)) void
+accumulate_a45_b8_c8(const struct intel_perf *perf,
+		     const uint32_t *start, const uint32_t *end,
+		     uint64_t *deltas,
+		     accumulate_uint32_fn acc32)
+{
+	/* timestamp */
+	deltas[0] += timestamp_delta32(perf, end[1] - start[1]);
 
-		/* 8x 32bit B counters + 8x 32bit C counters... */
-		for (i = 0; i < 16; i++)
-			accumulate_uint32(start + 48 + i, end + 48 + i, deltas + idx++);
-		break;
+	acc32(start + 3, end + 3, deltas + 1, 61);
+}
 
-	case I915_OA_FORMAT_A45_B8_C8:
-		/* timestamp */
-		if (perf->devinfo.oa_timestamp_shift >= 0)
-			deltas[0] += (end[1] - start[1]) << perf->devinfo.oa_timestamp_shift;
-		else
-			deltas[0] += (end[1] - start[1]) >> (-perf->devinfo.oa_timestamp_shift);
+static inline __attribute__((always_inline)) void
+accumulate_mpec8u32_b8_c8(const struct intel_perf *perf,
+			  const uint32_t *start, const uint32_t *end,
+			  uint64_t *deltas,
+			  accumulate_uint32_fn acc32)
+{
+	const uint64_t *start64 = (const uint64_t *)start;
+	const uint64_t *end64 = (const uint64_t *)end;
 
-		for (i = 0; i < 61; i++)
-			accumulate_uint32(start + 3 + i, end + 3 + i, deltas + 1 + i);
-		break;
+	/* 64 bit timestamp */
+	deltas[0] += timestamp_delta64(perf, end64[1] - start64[1]);
 
-	case I915_OAM_FORMAT_MPEC8u32_B8_C8: {
-		const uint64_t *start64 = (const uint64_t *)(record0 + 1);
-		const uint64_t *end64 = (const uint64_t *)(record1 + 1);
+	/* 64 bit clock */
+	deltas[1] += end64[3] - start64[3];
 
-		/* 64 bit timestamp */
-		if (perf->devinfo.oa_timestamp_shift >= 0)
-			deltas[idx++] += (end64[1] - start64[1]) << perf->devinfo.oa_timestamp_shift;
-		else
-			deltas[idx++] += (end64[1] - start64[1]) >> (-perf->devinfo.oa_timestamp_shift);
+	/* 8x 32bit MPEC counters + 8x 32bit B counters + 8x 32bit C counters */
+	acc32(start + 8, end + 8, deltas + 2, 24);
+}
+
+static inline const uint32_t *
+record_report(const struct drm_i915_perf_record_header *record)
+{
+	return (const uint32_t *)(record + 1);
+}
 
-		/* 64 bit clock */
-		deltas[idx++] += end64[3] - start64[3];
+/*
+ * Sum up the deltas between each consecutive pair of @records. Unlike the
+ * delta between the first and the last record, this accounts for every
+ * counter wraparound in between.
+ */
+static inline __attribute__((always_inline)) void
+accumulate_records(struct intel_perf_accumulator *acc,
+		   const struct intel_perf *perf,
+		   const struct intel_perf_metric_set *metric_set,
+		   const struct drm_i915_perf_record_header * const *records,
+		   uint32_t n_records,
+		   accumulate_uint32_fn acc32,
+		   accumulate_uint40_fn acc40)
+{
+	uint64_t *deltas = acc->deltas;
+	uint32_t i;
+
+	memset(acc, 0, sizeof(*acc));
 
-		/* 8x 32bit MPEC counters */
-		for (i = 0; i < 8; i++)
-			accumulate_uint32(start + 8 + i, end + 8 + i, deltas + idx++);
+	switch (metric_set->perf_oa_format) {
+	case I915_OA_FORMAT_A24u40_A14u32_B8_C8:
+		for (i = 1; i < n_records; i++)
+			accumulate_a24u40_a14u32_b8_c8(perf,
+						       record_report(records[i - 1]),
+						       record_report(records[i]),
+						       deltas, acc32, acc40);
+		break;
 
-		/* 8x 32bit B counters */
-		for (i = 0; i < 8; i++)
-			accumulate_uint32(start + 16 + i, end + 16 + i, deltas + idx++);
+	case I915_OAR_FORMAT_A32u40_A4u32_B8_C8:
+	case I915_OA_FORMAT_A32u40_A4u32_B8_C8:
+		for (i = 1; i < n_records; i++)
+			accumulate_a32u40_a4u32_b8_c8(perf,
+						      record_report(records[i - 1]),
+						      record_report(records[i]),
+						      deltas, acc32, acc40);
+		break;
 
-		/* 8x 32bit C counters */
-		for (i = 0; i < 8; i++)
-			accumulate_uint32(start + 24 + i, end + 24 + i, deltas + idx++);
+	case I915_OA_FORMAT_A45_B8_C8:
+		for (i = 1; i < n_records; i++)
+			accumulate_a45_b8_c8(perf,
+					     record_report(records[i - 1]),
+					     record_report(records[i]),
+					     deltas, acc32);
+		break;
 
+	case I915_OAM_FORMAT_MPEC8u32_B8_C8:
+		for (i = 1; i < n_records; i++)
+			accumulate_mpec8u32_b8_c8(perf,
+						  record_report(records[i - 1]),
+						  record_report(records[i]),
+						  deltas, acc32);
 		break;
-		}
+
 	default:
 		assert(0);
 	}
+}
+
+static void
+accumulate_records_generic(struct intel_perf_accumulator *acc,
+			   const struct intel_perf *perf,
+			   const struct intel_perf_metric_set *metric_set,
+			   const struct drm_i915_perf_record_header * const *records,
+			   uint32_t n_records)
+{
+	accumulate_records(acc, perf, metric_set, records, n_records,
+			   accumulate_uint32, accumulate_uint40);
+}
+
+#if defined(__x86_64__) && !defined(__clang__) && defined(__GLIBC__) && !defined(__UCLIBC__)
+#pragma GCC push_options
+#pragma GCC target("avx2")
+
+#include <immintrin.h>
+
+static void
+accumulate_uint32_avx2(const uint32_t *report0,
+		       const uint32_t *report1,
+		       uint64_t *deltas,
+		       int n)
+{
+	int i;
+
+	for (i = 0; i + 4 <= n; i += 4) {
+		__m128i d = _mm_sub_epi32(_mm_loadu_si128((const __m128i *)(report1 + i)),
+					  _mm_loadu_si128((const __m128i *)(report0 + i)));
+		__m256i sum = _mm256_loadu_si256((const __m256i *)(deltas + i));
+
+		sum = _mm256_add_epi64(sum, _mm256_cvtepu32_epi64(d));
+		_mm256_storeu_si256((__m256i *)(deltas + i), sum);
+	}
+
+	accumulate_uint32(report0 + i, report1 + i, deltas + i, n - i);
+}
+
+/* Four consecutive 40bit A counters, zero extended to 64bit. */
+static inline __m256i
+read_uint40_avx2(const uint32_t *report, int a_index)
+{
+	const uint8_t *high_bytes = (const uint8_t *)(report + 40);
+	__m256i low, high;
+	int32_t high4;
+
+	memcpy(&high4, high_bytes + a_index, sizeof(high4));
+
+	low = _mm256_cvtepu32_epi64(_mm_loadu_si128((const __m128i *)(report + 4 + a_index)));
+	high = _mm256_cvtepu8_epi64(_mm_cvtsi32_si128(high4));
+
+	return _mm256_or_si256(low, _mm256_slli_epi64(high, 32));
+}
+
+static void
+accumulate_uint40_avx2(int a_index,
+		       const uint32_t *report0,
+		       const uint32_t *report1,
+		       uint64_t *deltas,
+		       int n)
+{
+	const __m256i mask = _mm256_set1_epi64x((1LL << 40) - 1);
+	int i;
+
+	for (i = 0; i + 4 <= n; i += 4) {
+		__m256i d = _mm256_sub_epi64(read_uint40_avx2(report1, a_index + i),
+					     read_uint40_avx2(report0, a_index + i));
+		__m256i sum = _mm256_loadu_si256((const __m256i *)(deltas + i));
+
+		sum = _mm256_add_epi64(sum, _mm256_and_si256(d, mask));
+		_mm256_storeu_si256((__m256i *)(deltas + i), sum);
+	}
+
+	accumulate_uint40(a_index + i, report0, report1, deltas + i, n - i);
+}
+
+static void
+accumulate_records_avx2(struct intel_perf_accumulator *acc,
+			const struct intel_perf *perf,
+			const struct intel_perf_metric_set *metric_set,
+			const struct drm_i915_perf_record_header * const *records,
+			uint32_t n_records)
+{
+	accumulate_records(acc, perf, metric_set, records, n_records,
+			   accumulate_uint32_avx2, accumulate_uint40_avx2);
+}
+
+#pragma GCC pop_options
+
+/* The PLT is not initialized when ifunc resolvers run, so all external
+ * functions must be inlined with __attribute__((flatten)).
+ */
+__attribute__((flatten))
+static void (*resolve_accumulate_records(void))(struct intel_perf_accumulator *acc,
+						const struct intel_perf *perf,
+						const struct intel_perf_metric_set *metric_set,
+						const struct drm_i915_perf_record_header * const *records,
+						uint32_t n_records)
+{
+	if (igt_x86_features() & AVX2)
+		return accumulate_records_avx2;
+
+	return accumulate_records_generic;
+}
+
+void intel_perf_accumulate_reports_batch(struct intel_perf_accumulator *acc,
+					 const struct intel_perf *perf,
+					 const struct intel_perf_metric_set *metric_set,
+					 const struct drm_i915_perf_record_header * const *records,
+					 uint32_t n_records)
+	__attribute__((ifunc("resolve_accumulate_records")));
+
+#else
+
+void intel_perf_accumulate_reports_batch(struct intel_perf_accumulator *acc,
+					 const struct intel_perf *perf,
+					 const struct intel_perf_metric_set *metric_set,
+					 const struct drm_i915_perf_record_header * const *records,
+					 uint32_t n_records)
+{
+	accumulate_records_generic(acc, perf, metric_set, records, n_records);
+}
+
+#endif
+
+void intel_perf_accumulate_reports(struct intel_perf_accumulator *acc,
+				   const struct intel_perf *perf,
+				   const struct intel_perf_metric_set *metric_set,
+				   const struct drm_i915_perf_record_header *record0,
+				   const struct drm_i915_perf_record_header *record1)
+{
+	const struct drm_i915_perf_record_header *records[] = { record0, record1 };
 
+	intel_perf_accumulate_reports_batch(acc, perf, metric_set, records, 2);
 }
 
 uint64_t intel_perf_read_record_timestamp(const struct intel_perf *perf,
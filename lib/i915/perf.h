@@ -280,14 +280,32 @@ struct intel_perf_logical_counter_group {
 	struct igt_list_head link;  /* link for intel_perf_logical_counter_group.groups */
 };
 
+/*
+ * Static description of a generated metric set, @add instantiates it and
+ * adds it to intel_perf.metric_sets.
+ */
+struct intel_perf_metric_set_desc {
+	const char *name;
+	const char *symbol_name;
+	const char *hw_config_guid;
+
+	struct intel_perf_metric_set *(*add)(struct intel_perf *perf);
+};
+
 struct intel_perf {
 	const char *name;
 
 	struct intel_perf_logical_counter_group *root_group;
 
+	/* Instantiated metric sets */
 	struct igt_list_head metric_sets;
 
 	struct intel_perf_devinfo devinfo;
+
+	/* Metric sets of the platform, instantiated on demand */
+	const struct intel_perf_metric_set_desc *metric_set_descs;
+	struct intel_perf_metric_set **loaded_metric_sets;
+	uint32_t n_metric_set_descs;
 };
 
 struct drm_i915_perf_record_header;
@@ -325,6 +343,13 @@ struct intel_perf *intel_perf_for_devinfo(uint32_t device_id,
 					  uint64_t gt_min_freq,
 					  uint64_t gt_max_freq,
 					  const struct drm_i915_query_topology_info *topology);
+struct intel_perf *intel_perf_for_fd_lazy(int drm_fd, int gt);
+struct intel_perf *intel_perf_for_devinfo_lazy(uint32_t device_id,
+					       uint32_t revision,
+					       uint64_t timestamp_frequency,
+					       uint64_t gt_min_freq,
+					       uint64_t gt_max_freq,
+					       const struct drm_i915_query_topology_info *topology);
 void intel_perf_free(struct intel_perf *perf);
 
 void intel_perf_add_logical_counter(struct intel_perf *perf,
@@ -334,6 +359,13 @@ void intel_perf_add_logical_counter(struct intel_perf *perf,
 void intel_perf_add_metric_set(struct intel_perf *perf,
 			       struct intel_perf_metric_set *metric_set);
 
+void intel_perf_register_metric_sets(struct intel_perf *perf,
+				     const struct intel_perf_metric_set_desc *descs,
+				     uint32_t n_descs);
+struct intel_perf_metric_set *intel_perf_find_metric_set(struct intel_perf *perf,
+							 const char *symbol_name);
+void intel_perf_load_metric_sets(struct intel_perf *perf);
+
 void intel_perf_load_perf_configs(struct intel_perf *perf, int drm_fd);
 
 void intel_perf_accumulate_reports(struct intel_perf_accumulator *acc,
@@ -341,6 +373,11 @@ void intel_perf_accumulate_reports(struct intel_perf_accumulator *acc,
 				   const struct intel_perf_metric_set *metric_set,
 				   const struct drm_i915_perf_record_header *record0,
 				   const struct drm_i915_perf_record_header *record1);
+void intel_perf_accumulate_reports_batch(struct intel_perf_accumulator *acc,
+					 const struct intel_perf *perf,
+					 const struct intel_perf_metric_set *metric_set,
+					 const struct drm_i915_perf_record_header * const *records,
+					 uint32_t n_records);
 
 uint64_t intel_perf_read_record_timestamp(const struct intel_perf *perf,
 					  const struct intel_perf_metric_set *metric_set,
@@ -39,6 +39,8 @@
 #define MAX(a,b) ((a) > (b) ? (a) : (b))
 #define ARRAY_SIZE(arr) (sizeof(arr) / sizeof((arr)[0]))
 
+#define INTEL_PERF_DATA_READER_INDEX_STRIDE 1024
+
 static inline bool
 oa_report_ctx_is_valid(const struct intel_perf_devinfo *devinfo,
 		       const uint8_t *_report)
@@ -86,6 +88,20 @@ append_record(struct intel_perf_data_reader *reader,
 	reader->records[reader->n_records++] = header;
 }
 
+static void
+append_index(struct intel_perf_data_reader *reader, const uint8_t *record)
+{
+	if (reader->n_index >= reader->n_allocated_index) {
+		reader->n_allocated_index = MAX(100, 2 * reader->n_allocated_index);
+		reader->index = realloc(reader->index,
+					reader->n_allocated_index *
+					sizeof(*reader->index));
+		assert(reader->index);
+	}
+
+	reader->index[reader->n_index++].offset = record - reader->mmap_data;
+}
+
 static void
 append_timestamp_correlation(struct intel_perf_data_reader *reader,
 			     const struct intel_perf_record_timestamp_correlation *corr)
@@ -103,21 +119,8 @@ append_timestamp_correlation(struct intel_perf_data_reader *reader,
 	reader->correlations[reader->n_correlations++] = corr;
 }
 
-static struct intel_perf_metric_set *
-find_metric_set(struct intel_perf *perf, const char *symbol_name)
-{
-	struct intel_perf_metric_set *metric_set;
-
-	igt_list_for_each_entry(metric_set, &perf->metric_sets, link) {
-		if (!strcmp(symbol_name, metric_set->symbol_name))
-			return metric_set;
-	}
-
-	return NULL;
-}
-
 static bool
-parse_data(struct intel_perf_data_reader *reader)
+parse_data(struct intel_perf_data_reader *reader, bool lazy)
 {
 	const struct intel_perf_record_device_info *record_info;
 	const struct intel_perf_record_device_topology *record_topology;
@@ -130,7 +133,11 @@ parse_data(struct intel_perf_data_reader *reader)
 
 		switch (header->type) {
 		case DRM_I915_PERF_RECORD_SAMPLE:
-			append_record(reader, header);
+			if (!lazy)
+				append_record(reader, header);
+			else if (!(reader->n_total_records % INTEL_PERF_DATA_READER_INDEX_STRIDE))
+				append_index(reader, iter);
+			reader->n_total_records++;
 			break;
 
 		case DRM_I915_PERF_RECORD_OA_REPORT_LOST:
@@ -182,12 +189,12 @@ parse_data(struct intel_perf_data_reader *reader)
 	record_info = reader->record_info;
 	record_topology = reader->record_topology;
 
-	reader->perf = intel_perf_for_devinfo(record_info->device_id,
-					      record_info->device_revision,
-					      record_info->timestamp_frequency,
-					      record_info->gt_min_frequency,
-					      record_info->gt_max_frequency,
-					      &record_topology->topology);
+	reader->perf = intel_perf_for_devinfo_lazy(record_info->device_id,
+						   record_info->device_revision,
+						   record_info->timestamp_frequency,
+						   record_info->gt_min_frequency,
+						   record_info->gt_max_frequency,
+						   &record_topology->topology);
 	if (!reader->perf) {
 		snprintf(reader->error_msg, sizeof(reader->error_msg),
 			 "Recording occured on unsupported device (0x%x)",
@@ -199,7 +206,8 @@ parse_data(struct intel_perf_data_reader *reader)
 
 	reader->metric_set_name = record_info->metric_set_name;
 	reader->metric_set_uuid = record_info->metric_set_uuid;
-	reader->metric_set = find_metric_set(reader->perf, record_info->metric_set_name);
+	reader->metric_set = intel_perf_find_metric_set(reader->perf,
+							record_info->metric_set_name);
 
 	return true;
 }
@@ -293,6 +301,9 @@ generate_cpu_events(struct intel_perf_data_reader *reader)
 	uint32_t last_ctx_id, current_ctx_id;
 	uint64_t gpu_ts_start, gpu_ts_end;
 
+	if (!reader->n_records)
+		return;
+
 	for (uint32_t i = 1; i < reader->n_records; i++) {
 		current_header = reader->records[i];
 
@@ -343,9 +354,8 @@ compute_correlation_chunks(struct intel_perf_data_reader *reader)
 	}
 }
 
-bool
-intel_perf_data_reader_init(struct intel_perf_data_reader *reader,
-			    int perf_file_fd)
+static bool
+map_file(struct intel_perf_data_reader *reader, int perf_file_fd)
 {
 	struct stat st;
 	if (fstat(perf_file_fd, &st) != 0) {
@@ -366,10 +376,136 @@ intel_perf_data_reader_init(struct intel_perf_data_reader *reader,
 		return false;
 	}
 
-	if (!parse_data(reader))
+	return true;
+}
+
+bool
+intel_perf_data_reader_init(struct intel_perf_data_reader *reader,
+			    int perf_file_fd)
+{
+	if (!map_file(reader, perf_file_fd))
+		return false;
+
+	if (!parse_data(reader, false))
+		return false;
+
+	compute_correlation_chunks(reader);
+	generate_cpu_events(reader);
+
+	return true;
+}
+
+/*
+ * Unlike intel_perf_data_reader_init(), only walks the record headers of
+ * the recording to build a sparse index of the samples. Nothing is decoded
+ * until a time window is requested with intel_perf_data_reader_load().
+ */
+bool
+intel_perf_data_reader_open(struct intel_perf_data_reader *reader,
+			    int perf_file_fd)
+{
+	if (!map_file(reader, perf_file_fd))
+		return false;
+
+	if (!parse_data(reader, true))
+		return false;
+
+	if (!reader->metric_set) {
+		snprintf(reader->error_msg, sizeof(reader->error_msg),
+			 "Unknown metric set %s", reader->metric_set_name);
+		return false;
+	}
+
+	if (reader->n_correlations < 2) {
+		snprintf(reader->error_msg, sizeof(reader->error_msg),
+			 "Less than 2 CPU/GPU timestamp correlation points");
 		return false;
+	}
 
 	compute_correlation_chunks(reader);
+
+	for (uint32_t i = 0; i < reader->n_index; i++) {
+		const struct drm_i915_perf_record_header *header =
+			(const struct drm_i915_perf_record_header *)
+			(reader->mmap_data + reader->index[i].offset);
+
+		reader->index[i].cpu_ts =
+			correlate_gpu_timestamp(reader,
+						intel_perf_read_record_timestamp(reader->perf,
+														reader->metric_set,
+														header));
+	}
+
+	return true;
+}
+
+/*
+ * Decodes the samples between the CPU timestamps @cpu_ts_start and
+ * @cpu_ts_end of a recording opened with intel_perf_data_reader_open()
+ * into @records and @timelines, replacing the previously loaded window. The
+ * window is widened to the nearest indexed samples on either side.
+ */
+bool
+intel_perf_data_reader_load(struct intel_perf_data_reader *reader,
+			    uint64_t cpu_ts_start, uint64_t cpu_ts_end)
+{
+	const uint8_t *iter, *end;
+	uint32_t first = 0, last, lo, hi;
+
+	if (cpu_ts_start > cpu_ts_end) {
+		snprintf(reader->error_msg, sizeof(reader->error_msg),
+			 "Invalid time window");
+		return false;
+	}
+
+	reader->n_records = 0;
+	reader->n_timelines = 0;
+	reader->first_record = 0;
+	if (!reader->n_index)
+		return true;
+
+	/* Last indexed sample at or before the start of the window... */
+	lo = 0;
+	hi = reader->n_index;
+	while (lo < hi) {
+		uint32_t mid = lo + (hi - lo) / 2;
+
+		if (reader->index[mid].cpu_ts <= cpu_ts_start) {
+			first = mid;
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	/* ... up to and including the first one past its end. */
+	for (last = first; last < reader->n_index; last++) {
+		if (reader->index[last].cpu_ts > cpu_ts_end)
+			break;
+	}
+
+	iter = reader->mmap_data + reader->index[first].offset;
+	if (last < reader->n_index) {
+		const struct drm_i915_perf_record_header *header =
+			(const struct drm_i915_perf_record_header *)
+			(reader->mmap_data + reader->index[last].offset);
+
+		end = (const uint8_t *) header + header->size;
+	} else {
+		end = reader->mmap_data + reader->mmap_size;
+	}
+
+	reader->first_record = first * INTEL_PERF_DATA_READER_INDEX_STRIDE;
+	while (iter < end) {
+		const struct drm_i915_perf_record_header *header =
+			(const struct drm_i915_perf_record_header *) iter;
+
+		if (header->type == DRM_I915_PERF_RECORD_SAMPLE)
+			append_record(reader, header);
+
+		iter += header->size;
+	}
+
 	generate_cpu_events(reader);
 
 	return true;
@@ -380,6 +516,7 @@ intel_perf_data_reader_fini(struct intel_perf_data_reader *reader)
 {
 	intel_perf_free(reader->perf);
 	free(reader->records);
+	free(reader->index);
 	free(reader->timelines);
 	free(reader->correlations);
 	munmap((void *)reader->mmap_data, reader->mmap_size);
@@ -59,6 +59,22 @@ struct intel_perf_data_reader {
 	uint32_t n_records;
 	uint32_t n_allocated_records;
 
+	/* Position of records[0] among the samples of the whole recording,
+	 * and the number of those samples.
+	 */
+	uint32_t first_record;
+	uint32_t n_total_records;
+
+	/* Sparse index of every 1024th sample, built by
+	 * intel_perf_data_reader_open().
+	 */
+	struct {
+		uint64_t offset;
+		uint64_t cpu_ts;
+	} *index;
+	uint32_t n_index;
+	uint32_t n_allocated_index;
+
 	/**/
 	struct intel_perf_timeline_item *timelines;
 	uint32_t n_timelines;
@@ -98,6 +114,11 @@ bool intel_perf_data_reader_init(struct intel_perf_data_reader *reader,
 				 int perf_file_fd);
 void intel_perf_data_reader_fini(struct intel_perf_data_reader *reader);
 
+bool intel_perf_data_reader_open(struct intel_perf_data_reader *reader,
+				 int perf_file_fd);
+bool intel_perf_data_reader_load(struct intel_perf_data_reader *reader,
+				 uint64_t cpu_ts_start, uint64_t cpu_ts_end);
+
 #ifdef __cplusplus
 };
 #endif
@@ -26,6 +26,7 @@
 
 #include "drmtest.h"
 #include "i915_3d.h"
+#include "igt_arena.h"
 #include "igt_aux.h"
 #include "igt_configfs.h"
 #include "igt_core.h"
@@ -33,6 +34,7 @@
 #include "igt_draw.h"
 #include "igt_dummyload.h"
 #include "igt_fb.h"
+#include "igt_flip_engine.h"
 #include "igt_frame.h"
 #include "igt_gt.h"
 #include "igt_kms.h"
@@ -0,0 +1,202 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2024 Intel Corporation
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "igt_arena.h"
+#include "igt_core.h"
+
+/**
+ * SECTION:igt_arena
+ * @short_description: Subtest lifetime memory allocator
+ * @title: Arena
+ * @include: igt.h
+ *
+ * Bump allocator for small temporary objects which don't outlive the
+ * subtest, like strings built for debug output or paths. Memory is carved
+ * from per-thread chunks, there's no way to free a single allocation.
+ * Everything allocated within a subtest is released at once when the
+ * subtest (or dynamic subtest) exits, no matter if it passed, failed or
+ * skipped. Allocations done outside of subtests live until the test exits.
+ *
+ * Don't use it for allocations proportional to the test runtime, like
+ * buffers allocated in a loop, these would pile up until subtest exit.
+ */
+
+#define ARENA_CHUNK_SIZE (64 << 10)
+#define ARENA_ALIGN 16
+#define ARENA_LEVELS 3 /* outside subtest, subtest, dynamic subtest */
+
+struct arena_chunk {
+	struct arena_chunk *next;
+	int level;
+	size_t size;
+	size_t used;
+	char data[] __attribute__((aligned(ARENA_ALIGN)));
+};
+
+static pthread_mutex_t arena_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct arena_chunk *arena_chunks[ARENA_LEVELS];
+static int arena_level;
+static unsigned long arena_generation;
+
+/* Chunk the thread currently allocates from, valid until scope leave */
+static __thread struct arena_chunk *current;
+static __thread unsigned long current_generation;
+
+static struct arena_chunk *arena_chunk_create(size_t size)
+{
+	struct arena_chunk *chunk;
+
+	chunk = malloc(sizeof(*chunk) + size);
+	igt_assert(chunk);
+
+	chunk->size = size;
+	chunk->used = 0;
+
+	pthread_mutex_lock(&arena_lock);
+	chunk->level = arena_level;
+	chunk->next = arena_chunks[arena_level];
+	arena_chunks[arena_level] = chunk;
+	pthread_mutex_unlock(&arena_lock);
+
+	return chunk;
+}
+
+/**
+ * igt_arena_alloc:
+ * @size: number of bytes
+ *
+ * Allocates @size bytes which are freed automatically when the current
+ * subtest exits. Asserts on allocation failure.
+ *
+ * Returns: pointer to uninitialized memory aligned to 16 bytes.
+ */
+void *igt_arena_alloc(size_t size)
+{
+	struct arena_chunk *chunk;
+	void *ptr;
+
+	size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+
+	/* Big allocations get own chunk not to waste the current one */
+	if (size > ARENA_CHUNK_SIZE / 4)
+		return arena_chunk_create(size)->data;
+
+	chunk = current;
+	if (!chunk || current_generation != READ_ONCE(arena_generation) ||
+	    chunk->level != READ_ONCE(arena_level) ||
+	    chunk->used + size > chunk->size) {
+		current_generation = READ_ONCE(arena_generation);
+		current = chunk = arena_chunk_create(ARENA_CHUNK_SIZE);
+	}
+
+	ptr = chunk->data + chunk->used;
+	chunk->used += size;
+
+	return ptr;
+}
+
+/**
+ * igt_arena_zalloc:
+ * @size: number of bytes
+ *
+ * Like igt_arena_alloc() but the memory is zeroed.
+ *
+ * Returns: pointer to zeroed memory aligned to 16 bytes.
+ */
+void *igt_arena_zalloc(size_t size)
+{
+	return memset(igt_arena_alloc(size), 0, size);
+}
+
+/**
+ * igt_arena_strdup:
+ * @str: string to duplicate
+ *
+ * Returns: copy of @str freed automatically when the current subtest exits.
+ */
+char *igt_arena_strdup(const char *str)
+{
+	size_t len = strlen(str) + 1;
+
+	return memcpy(igt_arena_alloc(len), str, len);
+}
+
+/**
+ * igt_arena_vprintf:
+ * @fmt: printf-style format string
+ * @ap: arguments
+ *
+ * Returns: formatted string freed automatically when the current subtest
+ * exits.
+ */
+char *igt_arena_vprintf(const char *fmt, va_list ap)
+{
+	va_list copy;
+	char *str;
+	int len;
+
+	va_copy(copy, ap);
+	len = vsnprintf(NULL, 0, fmt, copy);
+	va_end(copy);
+	igt_assert(len >= 0);
+
+	str = igt_arena_alloc(len + 1);
+	vsnprintf(str, len + 1, fmt, ap);
+
+	return str;
+}
+
+/**
+ * igt_arena_printf:
+ * @fmt: printf-style format string
+ * @...: arguments
+ *
+ * Returns: formatted string freed automatically when the current subtest
+ * exits.
+ */
+char *igt_arena_printf(const char *fmt, ...)
+{
+	va_list ap;
+	char *str;
+
+	va_start(ap, fmt);
+	str = igt_arena_vprintf(fmt, ap);
+	va_end(ap);
+
+	return str;
+}
+
+void __igt_arena_enter(void)
+{
+	pthread_mutex_lock(&arena_lock);
+	igt_assert(arena_level < ARENA_LEVELS - 1);
+	arena_level++;
+	pthread_mutex_unlock(&arena_lock);
+}
+
+void __igt_arena_leave(void)
+{
+	struct arena_chunk *chunk, *next;
+
+	pthread_mutex_lock(&arena_lock);
+	igt_assert(arena_level > 0);
+
+	chunk = arena_chunks[arena_level];
+	arena_chunks[arena_level] = NULL;
+	arena_level--;
+	arena_generation++;
+	pthread_mutex_unlock(&arena_lock);
+
+	for (; chunk; chunk = next) {
+		next = chunk->next;
+		free(chunk);
+	}
+}
@@ -0,0 +1,24 @@
+/* SPDX-License-Identifier: MIT */
+/*
+ * Copyright © 2024 Intel Corporation
+ */
+
+#ifndef __IGT_ARENA_H__
+#define __IGT_ARENA_H__
+
+#include <stdarg.h>
+#include <stddef.h>
+
+void *igt_arena_alloc(size_t size);
+void *igt_arena_zalloc(size_t size);
+char *igt_arena_strdup(const char *str);
+char *igt_arena_printf(const char *fmt, ...)
+	__attribute__((format(printf, 1, 2)));
+char *igt_arena_vprintf(const char *fmt, va_list ap)
+	__attribute__((format(printf, 1, 0)));
+
+/* igt_core internal, scopes follow subtest and dynamic subtest lifetime */
+void __igt_arena_enter(void);
+void __igt_arena_leave(void);
+
+#endif /* __IGT_ARENA_H__ */
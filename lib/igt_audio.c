@@ -299,14 +299,16 @@ void audio_signal_fill(struct audio_signal *signal, double *buffer,
 			freq->offset += count;
 			freq->offset %= freq->period_len;
 
-			for (j = 0; j < count; j++) {
-				for (k = 0; k < signal->channels; k++) {
-					if (freq->channel >= 0 &&
-					    freq->channel != k)
-						continue;
+			if (freq->channel >= 0) {
+				k = freq->channel;
+				for (j = 0; j < count; j++)
 					dst[j * signal->channels + k] +=
 						src[j] / freqs_per_channel[k];
-				}
+			} else {
+				for (j = 0; j < count; j++)
+					for (k = 0; k < signal->channels; k++)
+						dst[j * signal->channels + k] +=
+							src[j] / freqs_per_channel[k];
 			}
 
 			total += count;
@@ -322,70 +324,35 @@ static double hann_window(double v, size_t i, size_t N)
 	return v * 0.5 * (1 - cos(2.0 * M_PI * (double) i / (double) N));
 }
 
-/**
- * Checks that frequencies specified in signal, and only those, are included
- * in the input data.
- *
- * sampling_rate is given in Hz. samples_len is the number of elements in
- * samples.
+/* Normalizes the power of the bins, computed from an FFT of data_len samples */
+static void audio_normalize_power(double *bin_power, size_t bin_power_len,
+				  size_t data_len)
+{
+	size_t i;
+
+	for (i = 0; i < bin_power_len; i++)
+		bin_power[i] = 2 * bin_power[i] / data_len;
+}
+
+/*
+ * Checks that the frequencies of the signal for the channel, and only those,
+ * received power in the normalized bins of an FFT of data_len samples.
  */
-bool audio_signal_detect(struct audio_signal *signal, int sampling_rate,
-			 int channel, const double *samples, size_t samples_len)
+static bool audio_signal_detect_power(struct audio_signal *signal,
+				      int sampling_rate, int channel,
+				      const double *bin_power,
+				      size_t bin_power_len, size_t data_len)
 {
-	double *data;
-	size_t data_len = samples_len;
-	size_t bin_power_len = data_len / 2 + 1;
-	double bin_power[bin_power_len];
 	bool detected[FREQS_MAX];
-	int ret, freq_accuracy, freq, local_max_freq;
+	int freq_accuracy, freq, local_max_freq;
 	double max, local_max, threshold;
 	size_t i, j;
 	bool above, success;
 
-	/* gsl will mutate the array in-place, so make a copy */
-	data = malloc(samples_len * sizeof(double));
-	memcpy(data, samples, samples_len * sizeof(double));
-
-	/* Apply a Hann window to the input signal, to reduce frequency leaks
-	 * due to the endpoints of the signal being discontinuous.
-	 *
-	 * For more info:
-	 * - https://download.ni.com/evaluation/pxi/Understanding%20FFTs%20and%20Windowing.pdf
-	 * - https://en.wikipedia.org/wiki/Window_function
-	 */
-	for (i = 0; i < data_len; i++)
-		data[i] = hann_window(data[i], i, data_len);
-
 	/* Allowed error in Hz due to FFT step */
 	freq_accuracy = sampling_rate / data_len;
 	igt_debug("Allowed freq. error: %d Hz\n", freq_accuracy);
 
-	ret = gsl_fft_real_radix2_transform(data, 1, data_len);
-	if (ret != 0) {
-		free(data);
-		igt_assert(0);
-	}
-
-	/* Compute the power received by every bin of the FFT.
-	 *
-	 * For i < data_len / 2, the real part of the i-th term is stored at
-	 * data[i] and its imaginary part is stored at data[data_len - i].
-	 * i = 0 and i = data_len / 2 are special cases, they are purely real
-	 * so their imaginary part isn't stored.
-	 *
-	 * The power is encoded as the magnitude of the complex number and the
-	 * phase is encoded as its angle.
-	 */
-	bin_power[0] = data[0];
-	for (i = 1; i < bin_power_len - 1; i++) {
-		bin_power[i] = hypot(data[i], data[data_len - i]);
-	}
-	bin_power[bin_power_len - 1] = data[data_len / 2];
-
-	/* Normalize the power */
-	for (i = 0; i < bin_power_len; i++)
-		bin_power[i] = 2 * bin_power[i] / data_len;
-
 	/* Detect noise with a threshold on the power of low frequencies */
 	for (i = 0; i < bin_power_len; i++) {
 		freq = sampling_rate * i / data_len;
@@ -487,9 +454,268 @@ bool audio_signal_detect(struct audio_signal *signal, int sampling_rate,
 		}
 	}
 
+	return success;
+}
+
+/**
+ * Checks that frequencies specified in signal, and only those, are included
+ * in the input data.
+ *
+ * sampling_rate is given in Hz. samples_len is the number of elements in
+ * samples.
+ */
+bool audio_signal_detect(struct audio_signal *signal, int sampling_rate,
+			 int channel, const double *samples, size_t samples_len)
+{
+	double *data;
+	size_t data_len = samples_len;
+	size_t bin_power_len = data_len / 2 + 1;
+	double bin_power[bin_power_len];
+	int ret;
+	size_t i;
+
+	/* gsl will mutate the array in-place, so make a copy */
+	data = malloc(samples_len * sizeof(double));
+	memcpy(data, samples, samples_len * sizeof(double));
+
+	/* Apply a Hann window to the input signal, to reduce frequency leaks
+	 * due to the endpoints of the signal being discontinuous.
+	 *
+	 * For more info:
+	 * - https://download.ni.com/evaluation/pxi/Understanding%20FFTs%20and%20Windowing.pdf
+	 * - https://en.wikipedia.org/wiki/Window_function
+	 */
+	for (i = 0; i < data_len; i++)
+		data[i] = hann_window(data[i], i, data_len);
+
+	ret = gsl_fft_real_radix2_transform(data, 1, data_len);
+	if (ret != 0) {
+		free(data);
+		igt_assert(0);
+	}
+
+	/* Compute the power received by every bin of the FFT.
+	 *
+	 * For i < data_len / 2, the real part of the i-th term is stored at
+	 * data[i] and its imaginary part is stored at data[data_len - i].
+	 * i = 0 and i = data_len / 2 are special cases, they are purely real
+	 * so their imaginary part isn't stored.
+	 *
+	 * The power is encoded as the magnitude of the complex number and the
+	 * phase is encoded as its angle.
+	 */
+	bin_power[0] = data[0];
+	for (i = 1; i < bin_power_len - 1; i++) {
+		bin_power[i] = hypot(data[i], data[data_len - i]);
+	}
+	bin_power[bin_power_len - 1] = data[data_len / 2];
+
 	free(data);
 
-	return success;
+	audio_normalize_power(bin_power, bin_power_len, data_len);
+
+	return audio_signal_detect_power(signal, sampling_rate, channel,
+					 bin_power, bin_power_len, data_len);
+}
+
+struct audio_signal_detector {
+	struct audio_signal *signal;
+	int sampling_rate;
+	int capture_channels;
+	int channel_mapping[CHANNELS_MAX];
+
+	size_t window_len, hop_len;
+	int min_streak, streak;
+	bool detected;
+
+	/* The last window_len samples of each channel, as a ring */
+	double *history[CHANNELS_MAX];
+	size_t pos, received, pending;
+
+	double *hann, *data, *bin_power;
+	gsl_fft_real_wavetable *wavetable;
+	gsl_fft_real_workspace *workspace;
+};
+
+/**
+ * audio_signal_detector_init:
+ * @signal: The signal to detect
+ * @sampling_rate: The capture sampling rate, in Hz
+ * @capture_channels: The number of interleaved channels of the capture
+ * @channel_mapping: For each channel of @signal, the capture channel it is
+ * received on
+ * @window_len: The number of samples of each detection window
+ * @hop_len: The number of samples between the start of two windows, at most
+ * @window_len
+ * @min_streak: The number of consecutive windows the signal must be detected
+ * in, on all the channels, to decide it is received
+ *
+ * Create a detector deciding whether @signal is received while the capture is
+ * still running, as its chunks arrive. With @hop_len smaller than
+ * @window_len, the windows overlap and a streak spans @window_len +
+ * (@min_streak - 1) * @hop_len samples.
+ *
+ * The FFT plan and the window function are computed once for all the
+ * windows, unlike with repeated calls to audio_signal_detect().
+ *
+ * Returns: A newly-allocated detector, to be released with
+ * audio_signal_detector_fini()
+ */
+struct audio_signal_detector *
+audio_signal_detector_init(struct audio_signal *signal, int sampling_rate,
+			   int capture_channels, const int *channel_mapping,
+			   size_t window_len, size_t hop_len, int min_streak)
+{
+	struct audio_signal_detector *det;
+	int i;
+
+	igt_assert(hop_len > 0 && hop_len <= window_len);
+	igt_assert(min_streak > 0);
+
+	det = calloc(1, sizeof(*det));
+	igt_assert(det);
+
+	det->signal = signal;
+	det->sampling_rate = sampling_rate;
+	det->capture_channels = capture_channels;
+	det->window_len = window_len;
+	det->hop_len = hop_len;
+	det->min_streak = min_streak;
+
+	for (i = 0; i < signal->channels; i++) {
+		igt_assert(channel_mapping[i] >= 0 &&
+			   channel_mapping[i] < capture_channels);
+		det->channel_mapping[i] = channel_mapping[i];
+
+		det->history[i] = calloc(window_len, sizeof(double));
+		igt_assert(det->history[i]);
+	}
+
+	det->hann = malloc(window_len * sizeof(double));
+	det->data = malloc(window_len * sizeof(double));
+	det->bin_power = malloc((window_len / 2 + 1) * sizeof(double));
+	igt_assert(det->hann && det->data && det->bin_power);
+
+	for (i = 0; i < window_len; i++)
+		det->hann[i] = hann_window(1.0, i, window_len);
+
+	det->wavetable = gsl_fft_real_wavetable_alloc(window_len);
+	det->workspace = gsl_fft_real_workspace_alloc(window_len);
+	igt_assert(det->wavetable && det->workspace);
+
+	return det;
+}
+
+/**
+ * audio_signal_detector_fini:
+ * @det: The detector to release
+ *
+ * Release the detector.
+ */
+void audio_signal_detector_fini(struct audio_signal_detector *det)
+{
+	int i;
+
+	for (i = 0; i < det->signal->channels; i++)
+		free(det->history[i]);
+
+	gsl_fft_real_workspace_free(det->workspace);
+	gsl_fft_real_wavetable_free(det->wavetable);
+	free(det->bin_power);
+	free(det->data);
+	free(det->hann);
+	free(det);
+}
+
+/* Runs the detection on the last window of the channel */
+static bool audio_signal_detector_run(struct audio_signal_detector *det,
+				      int channel)
+{
+	const double *history = det->history[channel];
+	size_t len = det->window_len, head = len - det->pos;
+	size_t bin_power_len = len / 2 + 1;
+	double *data = det->data;
+	size_t i;
+
+	/* The oldest sample is at pos, unroll the ring into the window */
+	for (i = 0; i < head; i++)
+		data[i] = history[det->pos + i] * det->hann[i];
+	for (; i < len; i++)
+		data[i] = history[i - head] * det->hann[i];
+
+	igt_assert(gsl_fft_real_transform(data, 1, len, det->wavetable,
+					  det->workspace) == 0);
+
+	/*
+	 * Unlike the radix-2 transform, the mixed-radix one stores the real
+	 * and imaginary parts of the i-th term next to each other, at
+	 * data[2 * i - 1] and data[2 * i].
+	 */
+	det->bin_power[0] = data[0];
+	for (i = 1; i < bin_power_len - 1; i++)
+		det->bin_power[i] = hypot(data[2 * i - 1], data[2 * i]);
+	det->bin_power[bin_power_len - 1] = data[len - 1];
+
+	audio_normalize_power(det->bin_power, bin_power_len, len);
+
+	return audio_signal_detect_power(det->signal, det->sampling_rate,
+					 channel, det->bin_power,
+					 bin_power_len, len);
+}
+
+/**
+ * audio_signal_detector_push_s32_le:
+ * @det: The detector
+ * @samples: A chunk of interleaved S32_LE capture samples
+ * @samples_len: The number of elements in @samples
+ *
+ * Feed the next chunk of the capture to the detector, running the detection
+ * on every window completed by the chunk.
+ *
+ * Returns: true once the signal has been detected in enough consecutive
+ * windows. The capture can be stopped from then on.
+ */
+bool audio_signal_detector_push_s32_le(struct audio_signal_detector *det,
+				       const int32_t *samples,
+				       size_t samples_len)
+{
+	size_t frames, f;
+	int i;
+
+	igt_assert(samples_len % det->capture_channels == 0);
+	frames = samples_len / det->capture_channels;
+
+	for (f = 0; f < frames && !det->detected; f++) {
+		const int32_t *frame = samples + f * det->capture_channels;
+		bool ok = true;
+
+		for (i = 0; i < det->signal->channels; i++)
+			det->history[i][det->pos] =
+				(double)frame[det->channel_mapping[i]] / INT32_MAX;
+
+		det->pos = (det->pos + 1) % det->window_len;
+		det->received++;
+		det->pending++;
+
+		if (det->received < det->window_len ||
+		    det->pending < det->hop_len)
+			continue;
+
+		det->pending = 0;
+
+		/* No need to look at the other channels once one failed */
+		for (i = 0; i < det->signal->channels && ok; i++)
+			ok = audio_signal_detector_run(det, i);
+
+		det->streak = ok ? det->streak + 1 : 0;
+		det->detected = det->streak >= det->min_streak;
+
+		igt_debug("Detecting audio signal at sample %zu: %s, streak %d\n",
+			  det->received, ok ? "detected" : "not detected",
+			  det->streak);
+	}
+
+	return det->detected;
 }
 
 /**
@@ -308,6 +308,52 @@ void igt_unlock_mem(void);
 	ret__;								\
 })
 
+/**
+ * igt_wait_adaptive:
+ * @COND: condition to wait
+ * @timeout_ms: timeout in milliseconds
+ * @interval_ms: longest time we try to sleep between COND checks
+ * @elapsed_ns: where to store how long COND took to become true, or NULL
+ *
+ * Like igt_wait(), but COND is checked again after 50us first and the sleep
+ * doubles from there up to @interval_ms, so that a condition becoming true
+ * soon is noticed soon, without a long wait checking COND any more often
+ * than igt_wait() would.
+ *
+ * Returns:
+ * True of COND evaluated to true, false otherwise.
+ */
+#define igt_wait_adaptive(COND, timeout_ms, interval_ms, elapsed_ns) ({	\
+	const unsigned long max_us__ = 1000 * (interval_ms);		\
+	const uint64_t timeout_ns__ = (uint64_t)(timeout_ms) * 1000000;	\
+	unsigned long interval_us__ = min_t(unsigned long, 50, max_us__); \
+	uint64_t *elapsed_ns__ = (elapsed_ns);				\
+	struct timespec tv__ = {};					\
+	bool ret__;							\
+									\
+	do {								\
+		uint64_t elapsed__ = igt_nsec_elapsed(&tv__);		\
+									\
+		if (COND) {						\
+			igt_debug("%s took %"PRIu64"us\n", #COND,	\
+				  elapsed__ / 1000);			\
+			if (elapsed_ns__)				\
+				*elapsed_ns__ = elapsed__;		\
+			ret__ = true;					\
+			break;						\
+		}							\
+		if (elapsed__ > timeout_ns__) {				\
+			ret__ = false;					\
+			break;						\
+		}							\
+									\
+		usleep(interval_us__);					\
+		interval_us__ = min(2 * interval_us__, max_us__);	\
+	} while (1);							\
+									\
+	ret__;								\
+})
+
 struct igt_mean;
 void igt_start_siglatency(int sig); /* 0 => SIGRTMIN (default) */
 double igt_stop_siglatency(struct igt_mean *result);
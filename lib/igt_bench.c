@@ -0,0 +1,786 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2024 Intel Corporation
+ */
+
+/**
+ * SECTION:igt_bench
+ * @short_description: Common harness for the benchmarks
+ * @title: Benchmark harness
+ * @include: igt_bench.h
+ *
+ * The benchmark harness gives the programs in benchmarks/ a common set of
+ * options and a common way of timing and reporting a workload:
+ *
+ *   --duration=<s>   seconds each repetition runs for
+ *   --warmup=<s>     seconds to run before the first repetition
+ *   --reps=<n>       number of repetitions
+ *   --threads=<n>    number of processes running the workload concurrently
+ *   --pin=<policy>   CPU placement, see igt_fork_set_placement()
+ *   --governor=<gov> cpufreq governor to run under, restored on exit
+ *   --json=<file>    write the environment and results as JSON
+ *   --telemetry=<ms> sample the GT frequency and throttling, see
+ *                    #igt_telemetry
+ *
+ * The workload is a callback running a number of operations. Before the
+ * first repetition the harness calibrates how many operations take at least
+ * a millisecond, so that reading the clock does not skew short operations,
+ * then runs the workload for the warmup period. Each repetition yields the
+ * throughput in operations per second, summed over all processes, and the
+ * repetitions are summarized with #igt_stats_t, including a 95% confidence
+ * interval of the mean.
+ *
+ * Benchmarks timing their own events, like the latency of each submission,
+ * can add those distributions to the results with
+ * igt_bench_record_distribution().
+ *
+ * The JSON output records the kernel, driver, device id, GPU frequencies
+ * and CPU governor alongside the results, so that numbers from different
+ * machines and runs can be told apart. With --telemetry each result also
+ * carries the summary and trace of the GT telemetry sampled during its
+ * repetitions, and a warning is printed for results measured while the GT
+ * was throttled.
+ */
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/utsname.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "drmtest.h"
+#include "igt_aux.h"
+#include "igt_bench.h"
+#include "igt_device.h"
+#include "igt_device_scan.h"
+#include "igt_sysfs.h"
+#include "intel_chipset.h"
+
+/* Shortest time the operations between two clock reads should take */
+#define BATCH_NS 1000000
+
+/* Most telemetry samples kept in the trace of a result */
+#define MAX_TELEMETRY_SAMPLES 65536
+
+enum {
+	OPT_DURATION = 0x100,
+	OPT_WARMUP,
+	OPT_REPS,
+	OPT_THREADS,
+	OPT_PIN,
+	OPT_GOVERNOR,
+	OPT_JSON,
+	OPT_TELEMETRY,
+	OPT_HELP,
+};
+
+static const char *placement_names[] = {
+	[IGT_FORK_PLACEMENT_NONE] = "none",
+	[IGT_FORK_PLACEMENT_COMPACT] = "compact",
+	[IGT_FORK_PLACEMENT_SPREAD] = "spread",
+	[IGT_FORK_PLACEMENT_NUMA_LOCAL] = "numa-local",
+};
+
+static char **saved_governors;
+static int num_saved_governors;
+
+static double elapsed(const struct timespec *start, const struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) + 1e-9 * (end->tv_nsec - start->tv_nsec);
+}
+
+/**
+ * igt_bench_init:
+ * @bench: harness to initialize
+ * @name: name of the benchmark, used in the JSON output
+ *
+ * Sets the default options: a single process running 5 repetitions of 2
+ * seconds each after half a second of warmup.
+ */
+void igt_bench_init(struct igt_bench *bench, const char *name)
+{
+	struct utsname uts;
+
+	memset(bench, 0, sizeof(*bench));
+	bench->name = name;
+	bench->fd = -1;
+
+	if (!uname(&uts))
+		snprintf(bench->kernel, sizeof(bench->kernel), "%s %s",
+			 uts.sysname, uts.release);
+	for (int i = 0; i < ARRAY_SIZE(bench->gpu_freq); i++)
+		bench->gpu_freq[i] = -1;
+
+	bench->opts.duration = 2;
+	bench->opts.warmup = 0.5;
+	bench->opts.reps = 5;
+	bench->opts.threads = 1;
+	bench->opts.placement = IGT_FORK_PLACEMENT_NONE;
+
+	bench->unit = "ops/s";
+	bench->scale = 1;
+
+	bench->results = open_memstream(&bench->results_buf,
+					&bench->results_size);
+	igt_assert(bench->results);
+}
+
+static void usage(const char *prog, const char *help_str, FILE *out)
+{
+	fprintf(out, "Usage: %s [options]\n", prog);
+	if (help_str)
+		fputs(help_str, out);
+	fprintf(out,
+		"  --duration=<s>    Seconds each repetition runs for.\n"
+		"  --warmup=<s>      Seconds to run before the first repetition.\n"
+		"  --reps=<n>        Number of repetitions.\n"
+		"  --threads=<n>     Number of processes running concurrently.\n"
+		"  --pin=<policy>    Pin the processes to CPUs: none, compact,\n"
+		"                    spread or numa-local to the GPU.\n"
+		"  --governor=<gov>  Switch all CPUs to the given cpufreq governor\n"
+		"                    while running, like 'performance'.\n"
+		"  --json=<file>     Write the environment and results as JSON.\n"
+		"  --telemetry=<ms>  Sample the GT frequency, throttle reasons,\n"
+		"                    power and temperature every ms milliseconds.\n"
+		"  --help            Show this help.\n");
+}
+
+/**
+ * igt_bench_parse_opts:
+ * @bench: harness to store the options in
+ * @argc: argc from main()
+ * @argv: argv from main()
+ * @short_opts: getopt string of the benchmark's own options, or NULL
+ * @help_str: help text of the benchmark's own options, or NULL
+ * @handler: handler for the benchmark's own options
+ * @handler_data: data passed to @handler
+ *
+ * Parses the harness options, which are all long options, alongside the
+ * short options of the benchmark. Prints the help and exits on --help and
+ * on invalid options.
+ *
+ * Returns: The index of the first non-option argument.
+ */
+int igt_bench_parse_opts(struct igt_bench *bench, int argc, char **argv,
+			 const char *short_opts, const char *help_str,
+			 igt_opt_handler_t handler, void *handler_data)
+{
+	static const struct option long_opts[] = {
+		{ "duration", required_argument, NULL, OPT_DURATION },
+		{ "warmup", required_argument, NULL, OPT_WARMUP },
+		{ "reps", required_argument, NULL, OPT_REPS },
+		{ "threads", required_argument, NULL, OPT_THREADS },
+		{ "pin", required_argument, NULL, OPT_PIN },
+		{ "governor", required_argument, NULL, OPT_GOVERNOR },
+		{ "json", required_argument, NULL, OPT_JSON },
+		{ "telemetry", required_argument, NULL, OPT_TELEMETRY },
+		{ "help", no_argument, NULL, OPT_HELP },
+		{ }
+	};
+	struct igt_bench_opts *opts = &bench->opts;
+	int c;
+
+	while ((c = getopt_long(argc, argv, short_opts ?: "",
+				long_opts, NULL)) != -1) {
+		switch (c) {
+		case OPT_DURATION:
+			opts->duration = atof(optarg);
+			if (opts->duration <= 0)
+				goto err;
+			break;
+		case OPT_WARMUP:
+			opts->warmup = atof(optarg);
+			if (opts->warmup < 0)
+				goto err;
+			break;
+		case OPT_REPS:
+			opts->reps = max(atoi(optarg), 1);
+			break;
+		case OPT_THREADS:
+			opts->threads = max(atoi(optarg), 1);
+			break;
+		case OPT_PIN:
+			if (!igt_fork_placement_from_string(optarg,
+							    &opts->placement))
+				goto err;
+			break;
+		case OPT_GOVERNOR:
+			opts->governor = optarg;
+			break;
+		case OPT_JSON:
+			opts->json = optarg;
+			break;
+		case OPT_TELEMETRY:
+			opts->telemetry = max(atoi(optarg), 0);
+			if (!opts->telemetry)
+				goto err;
+			break;
+		case OPT_HELP:
+			usage(argv[0], help_str, stdout);
+			exit(0);
+		case '?':
+			goto err;
+		default:
+			if (!handler ||
+			    handler(c, 0, handler_data) != IGT_OPT_HANDLER_SUCCESS)
+				goto err;
+			break;
+		}
+	}
+
+	return optind;
+
+err:
+	usage(argv[0], help_str, stderr);
+	exit(1);
+}
+
+static void restore_governors(int sig)
+{
+	char path[80];
+
+	for (int cpu = 0; cpu < num_saved_governors; cpu++) {
+		int fd;
+
+		if (!saved_governors[cpu])
+			continue;
+
+		snprintf(path, sizeof(path),
+			 "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_governor",
+			 cpu);
+		fd = open(path, O_WRONLY);
+		if (fd >= 0) {
+			igt_ignore_warn(write(fd, saved_governors[cpu],
+					      strlen(saved_governors[cpu])));
+			close(fd);
+		}
+
+		free(saved_governors[cpu]);
+		saved_governors[cpu] = NULL;
+	}
+}
+
+static void set_governors(const char *governor)
+{
+	int ncpus = sysconf(_SC_NPROCESSORS_CONF);
+	char path[80];
+
+	saved_governors = calloc(ncpus, sizeof(*saved_governors));
+	igt_assert(saved_governors);
+	num_saved_governors = ncpus;
+	igt_install_exit_handler(restore_governors);
+
+	for (int cpu = 0; cpu < ncpus; cpu++) {
+		char buf[32];
+		int fd, len;
+
+		snprintf(path, sizeof(path),
+			 "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_governor",
+			 cpu);
+		fd = open(path, O_RDWR);
+		if (fd < 0)
+			continue;
+
+		len = read(fd, buf, sizeof(buf) - 1);
+		if (len > 0) {
+			buf[len] = '\0';
+			saved_governors[cpu] = strdup(buf);
+		}
+
+		if (pwrite(fd, governor, strlen(governor), 0) < 0)
+			igt_warn("Failed to set the %s governor on cpu%d: %m\n",
+				 governor, cpu);
+		close(fd);
+	}
+}
+
+static void read_governor(char *buf, size_t size)
+{
+	int fd, len;
+
+	snprintf(buf, size, "unknown");
+
+	fd = open("/sys/devices/system/cpu/cpu0/cpufreq/scaling_governor",
+		  O_RDONLY);
+	if (fd < 0)
+		return;
+
+	len = read(fd, buf, size - 1);
+	close(fd);
+	if (len <= 0) {
+		snprintf(buf, size, "unknown");
+		return;
+	}
+
+	buf[len] = '\0';
+	buf[strcspn(buf, "\n")] = '\0';
+}
+
+static void read_gpu_freq(struct igt_bench *bench)
+{
+	static const char * const i915_attrs[] = {
+		"gt_cur_freq_mhz", "gt_min_freq_mhz", "gt_max_freq_mhz",
+	};
+	static const char * const xe_attrs[] = {
+		"freq0/cur_freq", "freq0/min_freq", "freq0/max_freq",
+	};
+	const char * const *attrs;
+	int dir;
+
+	if (is_xe_device(bench->fd)) {
+		dir = xe_sysfs_gt_open(bench->fd, 0);
+		attrs = xe_attrs;
+	} else if (is_i915_device(bench->fd)) {
+		dir = igt_sysfs_open(bench->fd);
+		attrs = i915_attrs;
+	} else {
+		return;
+	}
+	if (dir < 0)
+		return;
+
+	for (int i = 0; i < ARRAY_SIZE(bench->gpu_freq); i++) {
+		uint32_t freq;
+
+		if (__igt_sysfs_get_u32(dir, attrs[i], &freq))
+			bench->gpu_freq[i] = freq;
+	}
+
+	close(dir);
+}
+
+/**
+ * igt_bench_set_device:
+ * @bench: harness
+ * @fd: DRM fd of the device under test
+ *
+ * Records the device, kernel and GPU frequencies for the JSON output, sets
+ * up the CPU placement relative to the device and switches the cpufreq
+ * governor if requested. Benchmarks without a device can skip this.
+ */
+void igt_bench_set_device(struct igt_bench *bench, int fd)
+{
+	struct igt_bench_opts *opts = &bench->opts;
+
+	bench->fd = fd;
+
+	if (__get_drm_device_name(fd, bench->driver, sizeof(bench->driver) - 1))
+		bench->driver[0] = '\0';
+
+	if (is_intel_device(fd))
+		bench->devid = intel_get_drm_devid(fd);
+
+	read_gpu_freq(bench);
+
+	if (opts->placement != IGT_FORK_PLACEMENT_NONE) {
+		char pci_slot[NAME_MAX];
+
+		igt_device_get_pci_slot_name(fd, pci_slot);
+		igt_fork_set_placement(opts->placement,
+				       igt_device_get_numa_node(pci_slot));
+	}
+
+	if (opts->governor)
+		set_governors(opts->governor);
+
+	if (opts->telemetry) {
+		double samples = opts->reps * opts->duration * 1000 /
+				 opts->telemetry;
+
+		bench->telemetry =
+			igt_telemetry_open(fd, 0, opts->telemetry,
+					   min(samples, (double)MAX_TELEMETRY_SAMPLES) + 1);
+		if (!bench->telemetry)
+			igt_warn("No GT telemetry on this device\n");
+	}
+}
+
+static double time_batch(igt_bench_fn fn, void *data, unsigned int thread,
+			 unsigned long count)
+{
+	struct timespec start, end;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	fn(data, thread, count);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	return elapsed(&start, &end);
+}
+
+static unsigned long calibrate(igt_bench_fn fn, void *data)
+{
+	unsigned long count = 1;
+
+	while (time_batch(fn, data, 0, count) < BATCH_NS * 1e-9 &&
+	       count < ULONG_MAX / 2)
+		count <<= 1;
+
+	return count;
+}
+
+static double run_rep(igt_bench_fn fn, void *data, unsigned int thread,
+		      unsigned long batch, double duration)
+{
+	struct timespec start, now;
+	unsigned long count = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	do {
+		fn(data, thread, batch);
+		count += batch;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+	} while (elapsed(&start, &now) < duration);
+
+	return count / elapsed(&start, &now);
+}
+
+/**
+ * igt_bench_ci95:
+ * @stats: An #igt_stats_t instance
+ *
+ * Computes the 95% confidence interval of the mean of @stats using the
+ * Student's t-distribution, which matters for the handful of repetitions
+ * benchmarks usually run.
+ *
+ * Returns: The half width of the interval, or 0 with fewer than 2 values.
+ */
+double igt_bench_ci95(igt_stats_t *stats)
+{
+	/* Two-tailed 97.5% quantiles for 1 to 30 degrees of freedom */
+	static const double t[] = {
+		12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306,
+		2.262, 2.228, 2.201, 2.179, 2.160, 2.145, 2.131, 2.120,
+		2.110, 2.101, 2.093, 2.086, 2.080, 2.074, 2.069, 2.064,
+		2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+	};
+	unsigned int df;
+
+	if (stats->n_values < 2)
+		return 0;
+
+	df = stats->n_values - 1;
+	return (df <= ARRAY_SIZE(t) ? t[df - 1] : 1.960) *
+		igt_stats_get_std_error(stats);
+}
+
+static void summarize(struct igt_bench_result *result)
+{
+	igt_stats_t *stats = &result->samples;
+
+	result->mean = igt_stats_get_mean(stats);
+	result->stddev = igt_stats_get_std_deviation(stats);
+	result->ci95 = igt_bench_ci95(stats);
+	result->median = igt_stats_get_median(stats);
+	result->trimean = igt_stats_get_trimean(stats);
+
+	result->min = INFINITY;
+	result->max = -INFINITY;
+	for (unsigned int i = 0; i < stats->n_values; i++) {
+		result->min = min(result->min, stats->values_f[i]);
+		result->max = max(result->max, stats->values_f[i]);
+	}
+}
+
+static void json_string(FILE *f, const char *str)
+{
+	fputc('"', f);
+	for (; *str; str++) {
+		if (*str == '"' || *str == '\\')
+			fputc('\\', f);
+		if ((unsigned char)*str >= 0x20)
+			fputc(*str, f);
+	}
+	fputc('"', f);
+}
+
+static void record_telemetry(struct igt_bench *bench, const char *label)
+{
+	struct igt_telemetry *t = bench->telemetry;
+	struct igt_telemetry_summary sum;
+	FILE *f = bench->results;
+
+	igt_telemetry_get_summary(t, &sum);
+
+	fprintf(f, ",\n\t\t\t\"telemetry\": {\n");
+	fprintf(f, "\t\t\t\t\"interval_ms\": %u,\n", bench->opts.telemetry);
+	fprintf(f, "\t\t\t\t\"samples\": %u,\n", sum.samples);
+	fprintf(f, "\t\t\t\t\"act_freq_min_mhz\": %u,\n", sum.act_min);
+	fprintf(f, "\t\t\t\t\"act_freq_mean_mhz\": %f,\n", sum.act_mean);
+	fprintf(f, "\t\t\t\t\"act_freq_max_mhz\": %u,\n", sum.act_max);
+	fprintf(f, "\t\t\t\t\"req_freq_mean_mhz\": %f,\n", sum.req_mean);
+	fprintf(f, "\t\t\t\t\"throttled\": %u,\n", sum.throttled);
+	fprintf(f, "\t\t\t\t\"reasons\": {");
+	for (int i = 0; i < IGT_THROTTLE_NUM_REASONS; i++)
+		fprintf(f, "%s\"%s\": %u", i ? ", " : "",
+			igt_throttle_reason_name(i), sum.reasons[i]);
+	fprintf(f, "},\n");
+	fprintf(f, "\t\t\t\t\"power_mean_mw\": %f,\n", sum.power_mean);
+	fprintf(f, "\t\t\t\t\"power_max_mw\": %f,\n", sum.power_max);
+	fprintf(f, "\t\t\t\t\"temp_max_c\": %f,\n", sum.temp_max);
+
+	/* time_ms, act_mhz, req_mhz, throttle mask, power_mw, temp_mc or -1 */
+	fprintf(f, "\t\t\t\t\"trace\": [");
+	for (unsigned int i = 0; i < igt_telemetry_num_samples(t); i++) {
+		const struct igt_telemetry_sample *s = igt_telemetry_get_sample(t, i);
+
+		fprintf(f, "%s[%.3f, %u, %u, %u, %d, %d]", i ? ", " : "",
+			s->time_ns / 1e6, s->act_freq, s->req_freq,
+			s->throttle, s->power_mw,
+			s->temp_mc == INT32_MIN ? -1 : s->temp_mc);
+	}
+	fprintf(f, "]\n\t\t\t}");
+
+	if (sum.throttled)
+		igt_warn("%s: GT throttled in %.1f%% of the samples, %u MHz min, %.0f MHz mean\n",
+			 label, 100. * sum.throttled / sum.samples,
+			 sum.act_min, sum.act_mean);
+}
+
+static void record_result(struct igt_bench *bench, const char *label,
+			  const struct igt_bench_result *result)
+{
+	FILE *f = bench->results;
+
+	fprintf(f, "%s\n\t\t{\n\t\t\t\"name\": ",
+		bench->num_results++ ? "," : "");
+	json_string(f, label);
+	fprintf(f, ",\n\t\t\t\"unit\": ");
+	json_string(f, bench->unit);
+	fprintf(f, ",\n");
+	fprintf(f, "\t\t\t\"batch\": %lu,\n", result->batch);
+	fprintf(f, "\t\t\t\"mean\": %f,\n", result->mean);
+	fprintf(f, "\t\t\t\"stddev\": %f,\n", result->stddev);
+	fprintf(f, "\t\t\t\"ci95\": %f,\n", result->ci95);
+	fprintf(f, "\t\t\t\"median\": %f,\n", result->median);
+	fprintf(f, "\t\t\t\"trimean\": %f,\n", result->trimean);
+	fprintf(f, "\t\t\t\"min\": %f,\n", result->min);
+	fprintf(f, "\t\t\t\"max\": %f,\n", result->max);
+	fprintf(f, "\t\t\t\"samples\": [");
+	for (unsigned int i = 0; i < result->samples.n_values; i++)
+		fprintf(f, "%s%f", i ? ", " : "", result->samples.values_f[i]);
+	fprintf(f, "]");
+	if (bench->telemetry)
+		record_telemetry(bench, label);
+	fprintf(f, "\n\t\t}");
+}
+
+/**
+ * igt_bench_set_unit:
+ * @bench: harness
+ * @unit: unit of the throughput, like "GB/s"
+ * @scale: amount of @unit per operation per second
+ *
+ * Makes the following igt_bench_run() calls report their throughput in
+ * @unit instead of operations per second, for workloads where an operation
+ * stands for a known amount of work, like bytes copied.
+ */
+void igt_bench_set_unit(struct igt_bench *bench, const char *unit,
+			double scale)
+{
+	bench->unit = unit;
+	bench->scale = scale;
+}
+
+/**
+ * igt_bench_run:
+ * @bench: harness
+ * @label: name of this measurement, used in the JSON output
+ * @fn: workload
+ * @data: data passed to @fn
+ * @result: output for the measurement, released with
+ *          igt_bench_result_fini()
+ *
+ * Calibrates and warms up @fn in the calling process, then runs the
+ * configured repetitions. With more than one thread, each repetition forks
+ * that many children with igt_fork(), which are pinned according to the
+ * placement policy, and the throughput of all children is summed.
+ */
+void igt_bench_run(struct igt_bench *bench, const char *label,
+		   igt_bench_fn fn, void *data,
+		   struct igt_bench_result *result)
+{
+	const struct igt_bench_opts *opts = &bench->opts;
+	double *shared = NULL;
+
+	memset(result, 0, sizeof(*result));
+	igt_stats_init_with_size(&result->samples, opts->reps);
+
+	if (opts->threads > 1) {
+		shared = mmap(NULL, opts->threads * sizeof(*shared),
+			      PROT_READ | PROT_WRITE,
+			      MAP_SHARED | MAP_ANON, -1, 0);
+		igt_assert(shared != MAP_FAILED);
+	} else {
+		igt_fork_apply_placement(0);
+	}
+
+	result->batch = calibrate(fn, data);
+	if (opts->warmup)
+		run_rep(fn, data, 0, result->batch, opts->warmup);
+
+	if (bench->telemetry)
+		igt_telemetry_start(bench->telemetry);
+
+	for (unsigned int n = 0; n < opts->reps; n++) {
+		double total = 0;
+
+		if (!shared) {
+			igt_stats_push_float(&result->samples, bench->scale *
+					     run_rep(fn, data, 0, result->batch,
+						     opts->duration));
+			continue;
+		}
+
+		igt_fork(child, opts->threads)
+			shared[child] = run_rep(fn, data, child, result->batch,
+						opts->duration);
+		igt_waitchildren();
+
+		for (unsigned int child = 0; child < opts->threads; child++)
+			total += shared[child];
+		igt_stats_push_float(&result->samples, bench->scale * total);
+	}
+
+	if (bench->telemetry)
+		igt_telemetry_stop(bench->telemetry);
+
+	if (shared)
+		munmap(shared, opts->threads * sizeof(*shared));
+
+	summarize(result);
+	record_result(bench, label, result);
+}
+
+/**
+ * igt_bench_record_distribution:
+ * @bench: harness
+ * @label: name of this measurement, used in the JSON output
+ * @unit: unit of the values in @stats, like "ns"
+ * @stats: the measured values
+ *
+ * Adds a distribution measured by the benchmark itself, typically latencies,
+ * to the JSON output next to the igt_bench_run() results. The count, mean,
+ * standard deviation and a few percentiles are recorded, and for a @stats
+ * initialized with igt_stats_init_histogram() also its non-empty buckets.
+ */
+void igt_bench_record_distribution(struct igt_bench *bench, const char *label,
+				   const char *unit, igt_stats_t *stats)
+{
+	static const double percentiles[] = { 50, 90, 99, 99.9 };
+	FILE *f = bench->results;
+	bool first = true;
+
+	fprintf(f, "%s\n\t\t{\n\t\t\t\"name\": ",
+		bench->num_results++ ? "," : "");
+	json_string(f, label);
+	fprintf(f, ",\n\t\t\t\"unit\": ");
+	json_string(f, unit);
+	fprintf(f, ",\n");
+	fprintf(f, "\t\t\t\"count\": %u,\n", stats->n_values);
+	fprintf(f, "\t\t\t\"mean\": %f,\n",
+		stats->n_values ? igt_stats_get_mean(stats) : 0);
+	fprintf(f, "\t\t\t\"stddev\": %f,\n",
+		stats->n_values ? igt_stats_get_std_deviation(stats) : 0);
+	fprintf(f, "\t\t\t\"min\": %f,\n", igt_stats_get_percentile(stats, 0));
+	for (int i = 0; i < ARRAY_SIZE(percentiles); i++)
+		fprintf(f, "\t\t\t\"p%g\": %f,\n", percentiles[i],
+			igt_stats_get_percentile(stats, percentiles[i]));
+	fprintf(f, "\t\t\t\"max\": %f", igt_stats_get_percentile(stats, 100));
+
+	if (stats->is_histogram) {
+		fprintf(f, ",\n\t\t\t\"buckets\": [");
+		for (unsigned int i = 0; i < igt_stats_get_n_buckets(stats); i++) {
+			uint64_t lower, upper, count;
+
+			count = igt_stats_get_bucket(stats, i, &lower, &upper);
+			if (!count)
+				continue;
+
+			fprintf(f, "%s[%" PRIu64 ", %" PRIu64 ", %" PRIu64 "]",
+				first ? "" : ", ", lower, upper, count);
+			first = false;
+		}
+		fprintf(f, "]");
+	}
+	fprintf(f, "\n\t\t}");
+}
+
+/**
+ * igt_bench_result_fini:
+ * @result: measurement from igt_bench_run()
+ */
+void igt_bench_result_fini(struct igt_bench_result *result)
+{
+	igt_stats_fini(&result->samples);
+}
+
+static void write_json(struct igt_bench *bench, FILE *f)
+{
+	const struct igt_bench_opts *opts = &bench->opts;
+
+	fprintf(f, "{\n\t\"benchmark\": ");
+	json_string(f, bench->name);
+	fprintf(f, ",\n\t\"environment\": {\n\t\t\"kernel\": ");
+	json_string(f, bench->kernel);
+	fprintf(f, ",\n\t\t\"driver\": ");
+	json_string(f, bench->driver);
+	fprintf(f, ",\n\t\t\"devid\": \"0x%04x\",\n", bench->devid);
+	fprintf(f, "\t\t\"gpu_cur_freq_mhz\": %d,\n", bench->gpu_freq[0]);
+	fprintf(f, "\t\t\"gpu_min_freq_mhz\": %d,\n", bench->gpu_freq[1]);
+	fprintf(f, "\t\t\"gpu_max_freq_mhz\": %d,\n", bench->gpu_freq[2]);
+	fprintf(f, "\t\t\"cpu_governor\": ");
+	json_string(f, bench->governor);
+	fprintf(f, ",\n\t\t\"cpus\": %ld\n\t},\n",
+		sysconf(_SC_NPROCESSORS_ONLN));
+
+	fprintf(f, "\t\"options\": {\n");
+	fprintf(f, "\t\t\"duration_s\": %f,\n", opts->duration);
+	fprintf(f, "\t\t\"warmup_s\": %f,\n", opts->warmup);
+	fprintf(f, "\t\t\"reps\": %u,\n", opts->reps);
+	fprintf(f, "\t\t\"threads\": %u,\n", opts->threads);
+	fprintf(f, "\t\t\"telemetry_ms\": %u,\n", opts->telemetry);
+	fprintf(f, "\t\t\"pin\": \"%s\"\n\t},\n",
+		placement_names[opts->placement]);
+
+	fprintf(f, "\t\"results\": [");
+	fwrite(bench->results_buf, 1, bench->results_size, f);
+	fprintf(f, "\n\t]\n}\n");
+}
+
+/**
+ * igt_bench_fini:
+ * @bench: harness
+ *
+ * Writes the JSON output if requested and restores the cpufreq governors.
+ */
+void igt_bench_fini(struct igt_bench *bench)
+{
+	fclose(bench->results);
+
+	if (bench->opts.json) {
+		FILE *f = fopen(bench->opts.json, "w");
+
+		read_governor(bench->governor, sizeof(bench->governor));
+		if (f) {
+			write_json(bench, f);
+			fclose(f);
+		} else {
+			igt_warn("Failed to open %s: %m\n", bench->opts.json);
+		}
+	}
+
+	free(bench->results_buf);
+	bench->results_buf = NULL;
+
+	igt_telemetry_close(bench->telemetry);
+	bench->telemetry = NULL;
+
+	if (num_saved_governors)
+		restore_governors(0);
+}
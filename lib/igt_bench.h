@@ -0,0 +1,116 @@
+/* SPDX-License-Identifier: MIT */
+/*
+ * Copyright © 2024 Intel Corporation
+ */
+
+#ifndef IGT_BENCH_H
+#define IGT_BENCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "igt_core.h"
+#include "igt_stats.h"
+#include "igt_telemetry.h"
+
+/**
+ * igt_bench_opts:
+ * @duration: seconds each repetition runs for
+ * @warmup: seconds to run before the first repetition
+ * @reps: number of repetitions
+ * @threads: number of processes running the benchmark concurrently
+ * @placement: how the processes are pinned to CPUs
+ * @governor: cpufreq governor to switch the CPUs to, or NULL
+ * @json: file to write the results to as JSON, or NULL
+ * @telemetry: milliseconds between two samples of the GT telemetry taken
+ *             during the repetitions, or 0 not to sample
+ *
+ * The harness options, see igt_bench_parse_opts(). Benchmarks can change
+ * the defaults set by igt_bench_init() before parsing the command line.
+ */
+struct igt_bench_opts {
+	double duration;
+	double warmup;
+	unsigned int reps;
+	unsigned int threads;
+	enum igt_fork_placement placement;
+	const char *governor;
+	const char *json;
+	unsigned int telemetry;
+};
+
+/**
+ * igt_bench_result:
+ * @samples: the throughput of each repetition, in operations per second
+ *           unless set otherwise with igt_bench_set_unit()
+ * @batch: calibrated number of operations timed at once
+ * @mean: mean throughput
+ * @stddev: standard deviation of the throughput
+ * @ci95: half width of the 95% confidence interval of @mean
+ * @median: median throughput
+ * @trimean: trimean of the throughput
+ * @min: lowest throughput
+ * @max: highest throughput
+ */
+struct igt_bench_result {
+	igt_stats_t samples;
+	unsigned long batch;
+	double mean;
+	double stddev;
+	double ci95;
+	double median;
+	double trimean;
+	double min;
+	double max;
+};
+
+struct igt_bench {
+	const char *name;
+	struct igt_bench_opts opts;
+
+	/* private */
+	int fd;
+	char kernel[256];
+	char driver[16];
+	uint32_t devid;
+	const char *unit;
+	double scale;
+	int gpu_freq[3];
+	char governor[32];
+	FILE *results;
+	char *results_buf;
+	size_t results_size;
+	unsigned int num_results;
+	struct igt_telemetry *telemetry;
+};
+
+/**
+ * igt_bench_fn:
+ * @data: benchmark private data
+ * @thread: index of the process running the benchmark
+ * @count: number of operations to run
+ *
+ * Runs @count operations of the measured workload.
+ */
+typedef void (*igt_bench_fn)(void *data, unsigned int thread,
+			     unsigned long count);
+
+void igt_bench_init(struct igt_bench *bench, const char *name);
+int igt_bench_parse_opts(struct igt_bench *bench, int argc, char **argv,
+			 const char *short_opts, const char *help_str,
+			 igt_opt_handler_t handler, void *handler_data);
+void igt_bench_set_device(struct igt_bench *bench, int fd);
+void igt_bench_set_unit(struct igt_bench *bench, const char *unit,
+			double scale);
+void igt_bench_run(struct igt_bench *bench, const char *label,
+		   igt_bench_fn fn, void *data,
+		   struct igt_bench_result *result);
+void igt_bench_record_distribution(struct igt_bench *bench, const char *label,
+				   const char *unit, igt_stats_t *stats);
+void igt_bench_result_fini(struct igt_bench_result *result);
+void igt_bench_fini(struct igt_bench *bench);
+
+double igt_bench_ci95(igt_stats_t *stats);
+
+#endif /* IGT_BENCH_H */
@@ -0,0 +1,294 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2025 Intel Corporation
+ */
+
+/**
+ * SECTION:igt_bufcmp
+ * @short_description: Parallel verification of large buffers
+ * @title: Buffer comparison
+ * @include: igt_bufcmp.h
+ *
+ * Copy and compression tests check gigabytes of results through WC mappings
+ * of device memory, where a plain memcmp() on a single thread takes longer
+ * than the GPU took to write them. igt_bufcmp() and its variants split the
+ * buffer across threads, each streaming blocks of it into a cached bounce
+ * buffer with igt_memcpy_from_wc() before comparing them.
+ *
+ * The reference is either another mapping, the pseudo-random stream from
+ * igt_rand_fill() or a constant 32bit value. Besides the number of
+ * mismatching words, the first #IGT_BUFCMP_MAX_REPORTED of them are kept.
+ * igt_bufcmp_print() lists them by offset, buf_ops_offset_to_xy() finds the
+ * pixel at an offset of a tiled surface, and blt_print_mismatches() lists
+ * them by coordinates in a blitter object.
+ */
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "igt_aux.h"
+#include "igt_bufcmp.h"
+#include "igt_core.h"
+#include "igt_rand.h"
+#include "igt_x86.h"
+
+#define BUFCMP_BLOCK (64 << 10)
+#define BUFCMP_MIN_CHUNK (4 << 20)
+#define BUFCMP_MAX_THREADS 64
+
+enum bufcmp_ref {
+	BUFCMP_BUFFER,
+	BUFCMP_RAND,
+	BUFCMP_VALUE,
+};
+
+struct bufcmp_chunk {
+	pthread_t thread;
+	const uint8_t *found;
+	const uint8_t *expected;
+	enum bufcmp_ref ref;
+	uint64_t seed;
+	uint32_t value;
+	size_t offset;
+	size_t size;
+	/* Two BUFCMP_BLOCK blocks to copy the found and expected data to */
+	uint8_t *bounce;
+	struct igt_bufcmp cmp;
+};
+
+static void bufcmp_fill_value(uint8_t *buf, size_t len, uint32_t value)
+{
+	size_t i;
+
+	for (i = 0; i + 4 <= len; i += 4)
+		memcpy(buf + i, &value, 4);
+
+	memcpy(buf + i, &value, len - i);
+}
+
+static void bufcmp_add(struct igt_bufcmp *cmp, uint64_t offset,
+		       const uint8_t *found, const uint8_t *expected,
+		       size_t len)
+{
+	struct igt_bufcmp_mismatch *m;
+
+	cmp->count++;
+	if (cmp->num_reported == IGT_BUFCMP_MAX_REPORTED)
+		return;
+
+	m = &cmp->reported[cmp->num_reported++];
+	m->offset = offset;
+	m->expected = 0;
+	m->found = 0;
+	memcpy(&m->expected, expected, len);
+	memcpy(&m->found, found, len);
+}
+
+/* Only called for blocks that differ, looks for the words that do */
+static void bufcmp_words(struct igt_bufcmp *cmp, uint64_t offset,
+			 const uint8_t *found, const uint8_t *expected,
+			 size_t len)
+{
+	for (size_t i = 0; i < len; i += 4) {
+		size_t n = min_t(size_t, 4, len - i);
+
+		if (memcmp(found + i, expected + i, n))
+			bufcmp_add(cmp, offset + i, found + i, expected + i, n);
+	}
+}
+
+static void *bufcmp_chunk_thread(void *data)
+{
+	struct bufcmp_chunk *chunk = data;
+	uint8_t *found = chunk->bounce;
+	uint8_t *expected = chunk->bounce + BUFCMP_BLOCK;
+	size_t done, len;
+
+	for (done = 0; done < chunk->size; done += len) {
+		size_t offset = chunk->offset + done;
+
+		len = min_t(size_t, BUFCMP_BLOCK, chunk->size - done);
+		igt_memcpy_from_wc(found, chunk->found + offset, len);
+
+		switch (chunk->ref) {
+		case BUFCMP_BUFFER:
+			igt_memcpy_from_wc(expected, chunk->expected + offset,
+					   len);
+			break;
+		case BUFCMP_RAND:
+			igt_rand_fill_at(expected, len, chunk->seed, offset);
+			break;
+		case BUFCMP_VALUE:
+			/* Chunks and blocks start on a word */
+			bufcmp_fill_value(expected, len, chunk->value);
+			break;
+		}
+
+		if (memcmp(found, expected, len))
+			bufcmp_words(&chunk->cmp, offset, found, expected, len);
+	}
+
+	return NULL;
+}
+
+static uint64_t bufcmp_parallel(struct igt_bufcmp *cmp,
+				const struct bufcmp_chunk *tmpl,
+				size_t size, int threads)
+{
+	struct bufcmp_chunk chunks[BUFCMP_MAX_THREADS];
+	struct igt_bufcmp total = {};
+	size_t chunk_size;
+	uint8_t *bounce;
+	int i, n;
+
+	if (threads <= 0)
+		threads = sysconf(_SC_NPROCESSORS_ONLN);
+
+	n = min_t(size_t, threads, size / BUFCMP_MIN_CHUNK);
+	n = clamp(n, 1, BUFCMP_MAX_THREADS);
+
+	/* Keep chunks page aligned, the last one takes the remainder */
+	chunk_size = (size / n) & ~4095ul;
+
+	/* Allocated here, the workers can't assert */
+	bounce = aligned_alloc(4096, 2 * BUFCMP_BLOCK * n);
+	igt_assert(bounce);
+
+	for (i = 0; i < n; i++) {
+		chunks[i] = *tmpl;
+		chunks[i].offset = i * chunk_size;
+		chunks[i].size = i == n - 1 ? size - i * chunk_size : chunk_size;
+		chunks[i].bounce = bounce + 2 * BUFCMP_BLOCK * i;
+		memset(&chunks[i].cmp, 0, sizeof(chunks[i].cmp));
+	}
+
+	/* The calling thread takes the first chunk */
+	for (i = 1; i < n; i++)
+		igt_assert_eq(pthread_create(&chunks[i].thread, NULL,
+					     bufcmp_chunk_thread,
+					     &chunks[i]), 0);
+
+	bufcmp_chunk_thread(&chunks[0]);
+
+	for (i = 1; i < n; i++)
+		pthread_join(chunks[i].thread, NULL);
+
+	free(bounce);
+
+	for (i = 0; i < n; i++) {
+		const struct igt_bufcmp *c = &chunks[i].cmp;
+		unsigned int copy;
+
+		copy = min(c->num_reported,
+			   IGT_BUFCMP_MAX_REPORTED - total.num_reported);
+		memcpy(&total.reported[total.num_reported], c->reported,
+		       copy * sizeof(*c->reported));
+		total.num_reported += copy;
+		total.count += c->count;
+	}
+
+	if (cmp)
+		*cmp = total;
+
+	return total.count;
+}
+
+/**
+ * igt_bufcmp:
+ * @cmp: where to store the mismatches, or NULL
+ * @found: buffer to check, usually a mapping of device memory
+ * @expected: reference buffer, may also be a mapping of device memory
+ * @size: size of both buffers in bytes
+ * @threads: maximum number of threads to use, 0 for one per online CPU
+ *
+ * Compares @found against @expected 32bit word by word, reading both with
+ * streaming loads. Buffers are split in chunks of at least 4MiB, each
+ * compared by a separate thread.
+ *
+ * Returns: the number of mismatching words, 0 if the buffers are the same.
+ */
+uint64_t igt_bufcmp(struct igt_bufcmp *cmp, const void *found,
+		    const void *expected, size_t size, int threads)
+{
+	struct bufcmp_chunk tmpl = {
+		.found = found,
+		.expected = expected,
+		.ref = BUFCMP_BUFFER,
+	};
+
+	return bufcmp_parallel(cmp, &tmpl, size, threads);
+}
+
+/**
+ * igt_bufcmp_rand:
+ * @cmp: where to store the mismatches, or NULL
+ * @found: buffer to check, usually a mapping of device memory
+ * @size: size of @found in bytes
+ * @seed: seed of the stream @found is expected to hold
+ * @threads: maximum number of threads to use, 0 for one per online CPU
+ *
+ * Like igt_bufcmp(), but compares against the start of the pseudo-random
+ * stream of @seed, regenerated as in igt_rand_verify() instead of read from
+ * a copy.
+ *
+ * Returns: the number of mismatching words, 0 if @found holds the stream.
+ */
+uint64_t igt_bufcmp_rand(struct igt_bufcmp *cmp, const void *found,
+			 size_t size, uint64_t seed, int threads)
+{
+	struct bufcmp_chunk tmpl = {
+		.found = found,
+		.ref = BUFCMP_RAND,
+		.seed = seed,
+	};
+
+	return bufcmp_parallel(cmp, &tmpl, size, threads);
+}
+
+/**
+ * igt_bufcmp_value:
+ * @cmp: where to store the mismatches, or NULL
+ * @found: buffer to check, usually a mapping of device memory
+ * @size: size of @found in bytes
+ * @value: 32bit value every word of @found is expected to hold
+ * @threads: maximum number of threads to use, 0 for one per online CPU
+ *
+ * Like igt_bufcmp(), but compares against a buffer filled with @value, for
+ * instance to check that a buffer was cleared.
+ *
+ * Returns: the number of mismatching words, 0 if all words are @value.
+ */
+uint64_t igt_bufcmp_value(struct igt_bufcmp *cmp, const void *found,
+			  size_t size, uint32_t value, int threads)
+{
+	struct bufcmp_chunk tmpl = {
+		.found = found,
+		.ref = BUFCMP_VALUE,
+		.value = value,
+	};
+
+	return bufcmp_parallel(cmp, &tmpl, size, threads);
+}
+
+/**
+ * igt_bufcmp_print:
+ * @cmp: result of a comparison
+ * @name: name of the buffer checked
+ *
+ * Logs the number of mismatches and the offsets and values of the first
+ * ones as warnings. Prints nothing if there are none.
+ */
+void igt_bufcmp_print(const struct igt_bufcmp *cmp, const char *name)
+{
+	if (!cmp->count)
+		return;
+
+	igt_warn("%s: %"PRIu64" mismatching words\n", name, cmp->count);
+	for (unsigned int i = 0; i < cmp->num_reported; i++)
+		igt_warn("%s: mismatch at offset 0x%"PRIx64": expected 0x%08x, found 0x%08x\n",
+			 name, cmp->reported[i].offset,
+			 cmp->reported[i].expected, cmp->reported[i].found);
+}
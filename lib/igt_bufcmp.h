@@ -0,0 +1,57 @@
+/* SPDX-License-Identifier: MIT */
+/*
+ * Copyright © 2025 Intel Corporation
+ */
+
+#ifndef IGT_BUFCMP_H
+#define IGT_BUFCMP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * IGT_BUFCMP_MAX_REPORTED:
+ *
+ * How many of the first mismatches a #igt_bufcmp keeps.
+ */
+#define IGT_BUFCMP_MAX_REPORTED 16
+
+/**
+ * igt_bufcmp_mismatch:
+ * @offset: offset in bytes of the mismatching 32bit word
+ * @expected: the expected word
+ * @found: the word found
+ *
+ * A 32bit word differing from what was expected. Words are counted from the
+ * start of the buffer, a partial word at its end is zero extended.
+ */
+struct igt_bufcmp_mismatch {
+	uint64_t offset;
+	uint32_t expected;
+	uint32_t found;
+};
+
+/**
+ * igt_bufcmp:
+ * @count: number of mismatching 32bit words
+ * @num_reported: number of entries in @reported
+ * @reported: the first mismatches, in buffer order
+ *
+ * Result of a buffer comparison.
+ */
+struct igt_bufcmp {
+	uint64_t count;
+	unsigned int num_reported;
+	struct igt_bufcmp_mismatch reported[IGT_BUFCMP_MAX_REPORTED];
+};
+
+uint64_t igt_bufcmp(struct igt_bufcmp *cmp, const void *found,
+		    const void *expected, size_t size, int threads);
+uint64_t igt_bufcmp_rand(struct igt_bufcmp *cmp, const void *found,
+			 size_t size, uint64_t seed, int threads);
+uint64_t igt_bufcmp_value(struct igt_bufcmp *cmp, const void *found,
+			  size_t size, uint32_t value, int threads);
+
+void igt_bufcmp_print(const struct igt_bufcmp *cmp, const char *name);
+
+#endif /* IGT_BUFCMP_H */
@@ -33,6 +33,7 @@
 #include <xmlrpc-c/base.h>
 #include <xmlrpc-c/client.h>
 #include <pthread.h>
+#include <unistd.h>
 #ifndef ANDROID
 #include <glib.h>
 #else
@@ -50,6 +51,7 @@
 #include "igt_kms.h"
 #include "igt_pipe_crc.h"
 #include "igt_rc.h"
+#include "igt_x86.h"
 
 /**
  * SECTION:igt_chamelium
@@ -121,6 +123,18 @@ struct chamelium_fb_crc_async_data {
 	igt_crc_t *ret;
 };
 
+struct chamelium_rpc_async_data {
+	struct chamelium *chamelium;
+	struct chamelium_port *port;
+	const char *method;
+	int args[5];
+	bool crop;
+
+	bool done;
+	xmlrpc_env fault;
+	xmlrpc_value *result;
+};
+
 struct chamelium {
 	xmlrpc_env env;
 	xmlrpc_client *client;
@@ -129,6 +143,13 @@ struct chamelium {
 	/* Indicates the last port to have been used for capturing video */
 	struct chamelium_port *capturing_port;
 
+	/* Resolution of the last video capture, read once per capture */
+	int captured_width, captured_height;
+	bool captured_resolution_valid;
+
+	/* Asynchronous RPCs started but not completed yet */
+	int rpc_in_flight;
+
 	int drm_fd;
 
 	struct igt_list_head edids;
@@ -1283,11 +1304,25 @@ void chamelium_port_get_video_params(struct chamelium *chamelium,
 	xmlrpc_DECREF(res);
 }
 
+static void chamelium_set_capturing_port(struct chamelium *chamelium,
+					 struct chamelium_port *port)
+{
+	chamelium->capturing_port = port;
+	chamelium->captured_resolution_valid = false;
+}
+
 static void chamelium_get_captured_resolution(struct chamelium *chamelium,
 					      int *w, int *h)
 {
 	xmlrpc_value *res, *res_w, *res_h;
 
+	/* All the frames of a capture share its resolution */
+	if (chamelium->captured_resolution_valid) {
+		*w = chamelium->captured_width;
+		*h = chamelium->captured_height;
+		return;
+	}
+
 	res = chamelium_rpc(chamelium, NULL, "GetCapturedResolution", "()");
 
 	xmlrpc_array_read_item(&chamelium->env, res, 0, &res_w);
@@ -1298,6 +1333,10 @@ static void chamelium_get_captured_resolution(struct chamelium *chamelium,
 	xmlrpc_DECREF(res_w);
 	xmlrpc_DECREF(res_h);
 	xmlrpc_DECREF(res);
+
+	chamelium->captured_width = *w;
+	chamelium->captured_height = *h;
+	chamelium->captured_resolution_valid = true;
 }
 
 static struct chamelium_frame_dump *frame_from_xml(struct chamelium *chamelium,
@@ -1354,7 +1393,7 @@ struct chamelium_frame_dump *chamelium_port_dump_pixels(struct chamelium *chamel
 	res = chamelium_rpc(chamelium, port, "DumpPixels",
 			    (w && h) ? "(iiiii)" : "(innnn)",
 			    port->id, x, y, w, h);
-	chamelium->capturing_port = port;
+	chamelium_set_capturing_port(chamelium, port);
 
 	frame = frame_from_xml(chamelium, res);
 	xmlrpc_DECREF(res);
@@ -1416,7 +1455,7 @@ igt_crc_t *chamelium_get_crc_for_area(struct chamelium *chamelium,
 	res = chamelium_rpc(chamelium, port, "ComputePixelChecksum",
 			    (w && h) ? "(iiiii)" : "(innnn)",
 			    port->id, x, y, w, h);
-	chamelium->capturing_port = port;
+	chamelium_set_capturing_port(chamelium, port);
 
 	crc_from_xml(chamelium, res, ret);
 	xmlrpc_DECREF(res);
@@ -1454,7 +1493,7 @@ void chamelium_start_capture(struct chamelium *chamelium,
 	xmlrpc_DECREF(chamelium_rpc(chamelium, port, "StartCapturingVideo",
 				    (w && h) ? "(iiiii)" : "(innnn)",
 				    port->id, x, y, w, h));
-	chamelium->capturing_port = port;
+	chamelium_set_capturing_port(chamelium, port);
 }
 
 /**
@@ -1503,7 +1542,7 @@ void chamelium_capture(struct chamelium *chamelium, struct chamelium_port *port,
 	xmlrpc_DECREF(chamelium_rpc(chamelium, port, "CaptureVideo",
 				    (w && h) ? "(iiiiii)" : "(iinnnn)",
 				    port->id, frame_count, x, y, w, h));
-	chamelium->capturing_port = port;
+	chamelium_set_capturing_port(chamelium, port);
 }
 
 /**
@@ -1565,6 +1604,307 @@ struct chamelium_frame_dump *chamelium_read_captured_frame(struct chamelium *cha
 	return frame;
 }
 
+/*
+ * Pipelined RPCs go through the asynchronous interface of the xmlrpc client,
+ * which keeps several requests in flight on its curl transport. They are
+ * bounded so that large frame dumps don't pile up in memory.
+ */
+#define CHAMELIUM_RPC_MAX_IN_FLIGHT 4
+#define CHAMELIUM_RPC_POLL_MS 5
+
+static void chamelium_rpc_async_done(const char *server_url,
+				     const char *method_name,
+				     xmlrpc_value *param_array,
+				     void *user_data,
+				     xmlrpc_env *fault,
+				     xmlrpc_value *result)
+{
+	struct chamelium_rpc_async_data *async = user_data;
+
+	if (fault->fault_occurred) {
+		xmlrpc_env_set_fault(&async->fault, fault->fault_code,
+				     fault->fault_string);
+	} else {
+		xmlrpc_INCREF(result);
+		async->result = result;
+	}
+
+	async->done = true;
+	async->chamelium->rpc_in_flight--;
+}
+
+static void chamelium_rpc_async_wait(struct chamelium *chamelium,
+				     struct chamelium_rpc_async_data *async)
+{
+	/* Completion handlers only run from within the client event loop */
+	while (async ? !async->done :
+	       chamelium->rpc_in_flight >= CHAMELIUM_RPC_MAX_IN_FLIGHT)
+		xmlrpc_client_event_loop_finish_timeout(chamelium->client,
+							CHAMELIUM_RPC_POLL_MS);
+}
+
+static struct chamelium_rpc_async_data *
+chamelium_rpc_async_start(struct chamelium *chamelium,
+			  struct chamelium_port *port, const char *method,
+			  const int *args, int n_args, bool crop)
+{
+	struct chamelium_rpc_async_data *async;
+	const char *format;
+
+	async = calloc(1, sizeof(*async));
+	igt_assert(async);
+
+	async->chamelium = chamelium;
+	async->port = port;
+	async->method = method;
+	async->crop = crop;
+	memcpy(async->args, args, n_args * sizeof(*args));
+	xmlrpc_env_init(&async->fault);
+
+	chamelium_rpc_async_wait(chamelium, NULL);
+
+	if (n_args == 1)
+		format = "(i)";
+	else
+		format = crop ? "(iiiii)" : "(innnn)";
+
+	if (chamelium->env.fault_occurred) {
+		xmlrpc_env_clean(&chamelium->env);
+		xmlrpc_env_init(&chamelium->env);
+	}
+
+	xmlrpc_client_start_rpcf(&chamelium->env, chamelium->client,
+				 chamelium->url, method,
+				 chamelium_rpc_async_done, async, format,
+				 args[0], args[1], args[2], args[3], args[4]);
+	if (chamelium->env.fault_occurred) {
+		/* Not started, finishing falls back to a synchronous call */
+		xmlrpc_env_set_fault(&async->fault,
+				     chamelium->env.fault_code,
+				     chamelium->env.fault_string);
+		async->done = true;
+	} else {
+		chamelium->rpc_in_flight++;
+	}
+
+	return async;
+}
+
+static xmlrpc_value *
+chamelium_rpc_async_finish(struct chamelium_rpc_async_data *async)
+{
+	struct chamelium *chamelium = async->chamelium;
+	xmlrpc_value *res;
+	const int *args = async->args;
+
+	chamelium_rpc_async_wait(chamelium, async);
+
+	res = async->result;
+	if (async->fault.fault_occurred) {
+		/*
+		 * Redo faulted calls synchronously, to get the same I2C
+		 * retries and FSM handling as any other RPC.
+		 */
+		igt_debug("Chamelium RPC call[%s] failed: %s, retrying\n",
+			  async->method, async->fault.fault_string);
+
+		if (!async->port)
+			res = chamelium_rpc(chamelium, NULL, async->method,
+					    "(i)", args[0]);
+		else
+			res = chamelium_rpc(chamelium, async->port,
+					    async->method,
+					    async->crop ? "(iiiii)" : "(innnn)",
+					    args[0], args[1], args[2], args[3],
+					    args[4]);
+	}
+
+	xmlrpc_env_clean(&async->fault);
+	free(async);
+
+	return res;
+}
+
+/**
+ * chamelium_port_dump_pixels_async_start:
+ * @chamelium: The Chamelium instance to use
+ * @port: The port to perform the video capture on
+ * @x: The X coordinate to crop the screen capture to
+ * @y: The Y coordinate to crop the screen capture to
+ * @w: The width of the area to crop the screen capture to, or 0 for the whole
+ * screen
+ * @h: The height of the area to crop the screen capture to, or 0 for the whole
+ * screen
+ *
+ * Starts the same frame dump as #chamelium_port_dump_pixels, without waiting
+ * for the Chamelium to answer. The caller can carry on, e.g. with preparing
+ * the next frame, while the dump is taken and downloaded.
+ *
+ * The returned structure should be passed to a subsequent call to
+ * #chamelium_frame_dump_async_finish. It should not be freed.
+ *
+ * Returns: An intermediate structure for the frame dump.
+ */
+struct chamelium_rpc_async_data *
+chamelium_port_dump_pixels_async_start(struct chamelium *chamelium,
+				       struct chamelium_port *port,
+				       int x, int y, int w, int h)
+{
+	int args[5] = { port->id, x, y, w, h };
+	struct chamelium_rpc_async_data *async;
+
+	async = chamelium_rpc_async_start(chamelium, port, "DumpPixels",
+					  args, 5, w && h);
+	chamelium_set_capturing_port(chamelium, port);
+
+	return async;
+}
+
+/**
+ * chamelium_read_captured_frame_async_start:
+ * @chamelium: The Chamelium instance to use
+ * @index: The index of the captured frame we want to get
+ *
+ * Starts reading a single video frame captured during the last video capture,
+ * like #chamelium_read_captured_frame, without waiting for it to be
+ * downloaded. Starting the reads of several frames before finishing them
+ * keeps the requests in flight together instead of paying a full round trip
+ * for each frame.
+ *
+ * The returned structure should be passed to a subsequent call to
+ * #chamelium_frame_dump_async_finish. It should not be freed.
+ *
+ * Returns: An intermediate structure for the frame read.
+ */
+struct chamelium_rpc_async_data *
+chamelium_read_captured_frame_async_start(struct chamelium *chamelium,
+					  unsigned int index)
+{
+	int args[5] = { index };
+	int w, h;
+
+	/* Queried before the reads, rather than once per frame */
+	chamelium_get_captured_resolution(chamelium, &w, &h);
+
+	return chamelium_rpc_async_start(chamelium, NULL, "ReadCapturedFrame",
+					 args, 1, false);
+}
+
+/**
+ * chamelium_frame_dump_async_finish:
+ * @async: An intermediate structure returned by
+ * #chamelium_port_dump_pixels_async_start or
+ * #chamelium_read_captured_frame_async_start
+ *
+ * Blocks until the frame is downloaded from the Chamelium, and then returns
+ * it. The frame dump should be freed using #chamelium_destroy_frame_dump.
+ *
+ * Returns: a chamelium_frame_dump struct
+ */
+struct chamelium_frame_dump *
+chamelium_frame_dump_async_finish(struct chamelium_rpc_async_data *async)
+{
+	struct chamelium *chamelium = async->chamelium;
+	struct chamelium_frame_dump *frame;
+	xmlrpc_value *res;
+
+	res = chamelium_rpc_async_finish(async);
+	frame = frame_from_xml(chamelium, res);
+	xmlrpc_DECREF(res);
+
+	return frame;
+}
+
+/**
+ * chamelium_port_start_video_stream:
+ * @chamelium: The Chamelium instance to use
+ * @stream: A connection to the Chamelium stream server
+ * @port: The port to stream the video input of
+ * @mode: What to do when the Chamelium runs out of memory
+ *
+ * Starts streaming the frames received on @port over the binary stream
+ * protocol, which doesn't go through any XML encoding. Frames are then read
+ * into preallocated frame dumps with #chamelium_stream_read_frame_dump, and
+ * the stream is stopped with #chamelium_stream_stop_realtime_video.
+ *
+ * Returns: true on success, false otherwise
+ */
+bool chamelium_port_start_video_stream(struct chamelium *chamelium,
+				       struct chamelium_stream *stream,
+				       struct chamelium_port *port,
+				       enum chamelium_stream_realtime_mode mode)
+{
+	int w, h;
+
+	chamelium_port_get_resolution(chamelium, port, &w, &h);
+
+	return chamelium_stream_dump_realtime_video(stream, port->id, w, h,
+						    mode);
+}
+
+/**
+ * chamelium_port_alloc_frame_dump:
+ * @port: The port the frames are going to be read from
+ * @width: The width of the frames
+ * @height: The height of the frames
+ *
+ * Allocates a frame dump for #chamelium_stream_read_frame_dump, which can be
+ * reused for every frame of a stream. It should be freed using
+ * #chamelium_destroy_frame_dump.
+ *
+ * Returns: a chamelium_frame_dump struct
+ */
+struct chamelium_frame_dump *
+chamelium_port_alloc_frame_dump(struct chamelium_port *port,
+				int width, int height)
+{
+	struct chamelium_frame_dump *dump = malloc(sizeof(*dump));
+
+	igt_assert(dump);
+
+	dump->width = width;
+	dump->height = height;
+	dump->size = (size_t) width * height * 3;
+	dump->port = port;
+	dump->bgr = malloc(dump->size);
+	igt_assert(dump->bgr);
+
+	return dump;
+}
+
+/**
+ * chamelium_stream_read_frame_dump:
+ * @stream: A connection to the Chamelium stream server
+ * @dump: A frame dump from #chamelium_port_alloc_frame_dump
+ * @frame_number: if non-NULL, will be set to the frame number
+ *
+ * Receives the next streamed frame straight into @dump.
+ *
+ * Returns: true if a frame matching the size of @dump was received, false
+ * otherwise
+ */
+bool chamelium_stream_read_frame_dump(struct chamelium_stream *stream,
+				      struct chamelium_frame_dump *dump,
+				      size_t *frame_number)
+{
+	size_t len;
+	int w, h;
+
+	len = chamelium_stream_receive_realtime_video(stream, frame_number,
+						      &w, &h, dump->bgr,
+						      dump->size);
+	if (!len)
+		return false;
+
+	if (w != dump->width || h != dump->height || len != dump->size) {
+		igt_warn("Unexpected streamed frame %dx%d (%zu bytes), "
+			 "want %dx%d\n", w, h, len, dump->width, dump->height);
+		return false;
+	}
+
+	return true;
+}
+
 /**
  * chamelium_get_captured_frame_count:
  * @chamelium: The Chamelium instance to use
@@ -1961,8 +2301,8 @@ void chamelium_assert_crc_eq_or_dump(struct chamelium *chamelium,
 	cairo_surface_t *capture;
 	bool eq;
 
-	igt_debug("Reference CRC: %s\n", igt_crc_to_string(reference_crc));
-	igt_debug("Captured CRC: %s\n", igt_crc_to_string(capture_crc));
+	igt_debug("Reference CRC: %s\n", igt_crc_to_arena_string(reference_crc));
+	igt_debug("Captured CRC: %s\n", igt_crc_to_arena_string(capture_crc));
 
 	eq = igt_check_crc_equal(reference_crc, capture_crc);
 	if (!eq && igt_frame_dump_is_enabled()) {
@@ -2245,54 +2585,153 @@ int chamelium_get_frame_limit(struct chamelium *chamelium,
 	return ret;
 }
 
-static uint32_t chamelium_xrgb_hash16(const unsigned char *buffer, int width,
-				      int height, int k, int m)
+/*
+ * The Chamelium hashes every fourth pixel of the frame, numbering the pixels
+ * in memory order, into one of four words: pixel 4n + k adds n + 1 times its
+ * RGB value to the sum of word 3 - k, modulo 2^64. The four sums are taken
+ * in a single pass over groups of four pixels, and ranges of groups can be
+ * summed separately and added up.
+ */
+typedef void (*fb_crc_sum_fn)(const unsigned char *buffer, size_t first,
+			      size_t last, uint64_t sum[4]);
+
+static void fb_crc_sum_scalar(const unsigned char *buffer, size_t first,
+			      size_t last, uint64_t sum[4])
 {
-	unsigned char r, g, b;
-	uint64_t sum = 0;
-	uint64_t count = 0;
-	uint64_t value;
-	uint32_t hash;
-	int index;
-	int i;
+	for (size_t n = first; n < last; n++) {
+		const unsigned char *p = buffer + n * 16;
 
-	for (i=0; i < width * height; i++) {
-		if ((i % m) != k)
-			continue;
+		for (int k = 0; k < 4; k++, p += 4) {
+			uint64_t value = p[2] | (p[1] << 8) | (p[0] << 16);
 
-		index = i * 4;
+			sum[k] += (n + 1) * value;
+		}
+	}
+}
 
-		r = buffer[index + 2];
-		g = buffer[index + 1];
-		b = buffer[index + 0];
+#if defined(__x86_64__) && !defined(__clang__)
+#pragma GCC push_options
+#pragma GCC target("ssse3")
+
+#include <tmmintrin.h>
+
+static void fb_crc_sum_ssse3(const unsigned char *buffer, size_t first,
+			     size_t last, uint64_t sum[4])
+{
+	/* BGRX to the RGB value, zero extended to 32 bits */
+	const __m128i rgb = _mm_setr_epi8(2, 1, 0, -1, 6, 5, 4, -1,
+					  10, 9, 8, -1, 14, 13, 12, -1);
+	__m128i acc02 = _mm_setzero_si128(), acc13 = _mm_setzero_si128();
+	__m128i count = _mm_set1_epi64x(first + 1);
+	const __m128i one = _mm_set1_epi64x(1);
+	uint64_t out[4];
 
-		value = r | (g << 8) | (b << 16);
-		sum += ++count * value;
+	for (size_t n = first; n < last; n++) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(buffer + n * 16));
+
+		v = _mm_shuffle_epi8(v, rgb);
+		/* Values fit in 24 bits and counts in 32, the products in 56 */
+		acc02 = _mm_add_epi64(acc02, _mm_mul_epu32(v, count));
+		acc13 = _mm_add_epi64(acc13,
+				      _mm_mul_epu32(_mm_srli_epi64(v, 32), count));
+		count = _mm_add_epi64(count, one);
 	}
 
-	hash = ((sum >> 0) ^ (sum >> 16) ^ (sum >> 32) ^ (sum >> 48)) & 0xffff;
+	_mm_storeu_si128((__m128i *)&out[0], acc02);
+	_mm_storeu_si128((__m128i *)&out[2], acc13);
+	sum[0] += out[0];
+	sum[1] += out[2];
+	sum[2] += out[1];
+	sum[3] += out[3];
+}
+
+#pragma GCC pop_options
+#endif
+
+static fb_crc_sum_fn fb_crc_sum;
+static pthread_once_t fb_crc_once = PTHREAD_ONCE_INIT;
 
-	return hash;
+static void fb_crc_select(void)
+{
+	fb_crc_sum = fb_crc_sum_scalar;
+
+#if defined(__x86_64__) && !defined(__clang__)
+	if (igt_x86_features() & SSSE3)
+		fb_crc_sum = fb_crc_sum_ssse3;
+#endif
+}
+
+struct fb_crc_chunk {
+	pthread_t thread;
+	const unsigned char *buffer;
+	size_t first, last;
+	uint64_t sum[4];
+};
+
+static void *fb_crc_chunk_thread(void *arg)
+{
+	struct fb_crc_chunk *chunk = arg;
+
+	fb_crc_sum(chunk->buffer, chunk->first, chunk->last, chunk->sum);
+
+	return NULL;
 }
 
+/* Groups of four pixels per thread, a 1080p frame is hashed by one */
+#define FB_CRC_MIN_CHUNK	(1ul << 19)
+#define FB_CRC_MAX_THREADS	16
+
 static void chamelium_do_calculate_fb_crc(cairo_surface_t *fb_surface,
 					  igt_crc_t *out)
 {
+	struct fb_crc_chunk chunks[FB_CRC_MAX_THREADS];
+	uint64_t sum[4] = {};
 	unsigned char *buffer;
-	int n = 4;
-	int w, h;
-	int i, j;
+	size_t pixels, groups;
+	int i, n;
+
+	pthread_once(&fb_crc_once, fb_crc_select);
 
 	buffer = cairo_image_surface_get_data(fb_surface);
-	w = cairo_image_surface_get_width(fb_surface);
-	h = cairo_image_surface_get_height(fb_surface);
+	pixels = (size_t)cairo_image_surface_get_width(fb_surface) *
+		 cairo_image_surface_get_height(fb_surface);
+	groups = pixels / 4;
+
+	n = min_t(size_t, sysconf(_SC_NPROCESSORS_ONLN), groups / FB_CRC_MIN_CHUNK);
+	n = clamp(n, 1, FB_CRC_MAX_THREADS);
 
 	for (i = 0; i < n; i++) {
-		j = n - i - 1;
-		out->crc[i] = chamelium_xrgb_hash16(buffer, w, h, j, n);
+		chunks[i].buffer = buffer;
+		chunks[i].first = groups * i / n;
+		chunks[i].last = groups * (i + 1) / n;
+		memset(chunks[i].sum, 0, sizeof(chunks[i].sum));
+		if (i)
+			igt_assert_eq(pthread_create(&chunks[i].thread, NULL,
+						     fb_crc_chunk_thread,
+						     &chunks[i]), 0);
+	}
+
+	/* The calling thread takes the first chunk and the partial group */
+	fb_crc_chunk_thread(&chunks[0]);
+	for (i = 0; i < pixels % 4; i++) {
+		const unsigned char *p = buffer + (groups * 4 + i) * 4;
+
+		sum[i] += (groups + 1) * (uint64_t)(p[2] | (p[1] << 8) | (p[0] << 16));
 	}
 
-	out->n_words = n;
+	for (i = 0; i < n; i++) {
+		if (i)
+			pthread_join(chunks[i].thread, NULL);
+		for (int k = 0; k < 4; k++)
+			sum[k] += chunks[i].sum[k];
+	}
+
+	for (i = 0; i < 4; i++) {
+		uint64_t s = sum[3 - i];
+
+		out->crc[i] = ((s >> 0) ^ (s >> 16) ^ (s >> 32) ^ (s >> 48)) & 0xffff;
+	}
+	out->n_words = 4;
 }
 
 /**
@@ -3114,6 +3553,9 @@ void chamelium_deinit(struct chamelium *chamelium)
 
 	close(chamelium->drm_fd);
 
+	/* Let any abandoned asynchronous call complete */
+	if (chamelium->rpc_in_flight)
+		xmlrpc_client_event_loop_finish(chamelium->client);
 	xmlrpc_client_destroy(chamelium->client);
 
 	for (i = 0; i < chamelium->port_count; i++)
@@ -32,6 +32,7 @@
 #include <stddef.h>
 #include <xf86drmMode.h>
 
+#include "igt_chamelium_stream.h"
 #include "igt_debugfs.h"
 #include "igt_kms.h"
 #include "igt_list.h"
@@ -44,6 +45,7 @@ struct chamelium;
 struct chamelium_port;
 struct chamelium_frame_dump;
 struct chamelium_fb_crc_async_data;
+struct chamelium_rpc_async_data;
 
 /**
  * chamelium_check:
@@ -232,6 +234,25 @@ struct chamelium_frame_dump *chamelium_port_dump_pixels(struct chamelium *chamel
 							struct chamelium_port *port,
 							int x, int y,
 							int w, int h);
+struct chamelium_rpc_async_data *
+chamelium_port_dump_pixels_async_start(struct chamelium *chamelium,
+				       struct chamelium_port *port,
+				       int x, int y, int w, int h);
+struct chamelium_rpc_async_data *
+chamelium_read_captured_frame_async_start(struct chamelium *chamelium,
+					  unsigned int index);
+struct chamelium_frame_dump *
+chamelium_frame_dump_async_finish(struct chamelium_rpc_async_data *async);
+bool chamelium_port_start_video_stream(struct chamelium *chamelium,
+				       struct chamelium_stream *stream,
+				       struct chamelium_port *port,
+				       enum chamelium_stream_realtime_mode mode);
+struct chamelium_frame_dump *
+chamelium_port_alloc_frame_dump(struct chamelium_port *port,
+				int width, int height);
+bool chamelium_stream_read_frame_dump(struct chamelium_stream *stream,
+				      struct chamelium_frame_dump *dump,
+				      size_t *frame_number);
 igt_crc_t *chamelium_calculate_fb_crc(int fd, struct igt_fb *fb);
 struct chamelium_fb_crc_async_data *chamelium_calculate_fb_crc_async_start(int fd,
 									   struct igt_fb *fb);
@@ -487,27 +487,18 @@ bool chamelium_stream_receive_realtime_audio(struct chamelium_stream *client,
 	return read_whole(client->fd, *buf, body_len);
 }
 
-/**
- * chamelium_stream_stop_realtime_audio:
- *
- * Stops real-time audio capture. This also drops any buffered audio pages.
- * The caller shouldn't call #chamelium_stream_receive_realtime_audio after
- * stopping audio capture.
- */
-bool chamelium_stream_stop_realtime_audio(struct chamelium_stream *client)
+static bool chamelium_stream_stop_dump(struct chamelium_stream *client,
+				       enum stream_message_type stop_type)
 {
 	enum stream_message_kind kind;
 	enum stream_message_type type;
 	enum stream_error err;
 	size_t len;
 
-	igt_debug("Stopping real-time audio capture\n");
-
-	if (!chamelium_stream_write_request(client,
-					    STREAM_MESSAGE_STOP_DUMP_AUDIO,
-					    NULL, 0))
+	if (!chamelium_stream_write_request(client, stop_type, NULL, 0))
 		return false;
 
+	/* Drop the data messages still queued before the response */
 	while (true) {
 		if (!chamelium_stream_read_header(client, &kind, &type,
 						  &err, &len))
@@ -520,7 +511,7 @@ bool chamelium_stream_stop_realtime_audio(struct chamelium_stream *client)
 			return false;
 	}
 
-	if (type != STREAM_MESSAGE_STOP_DUMP_AUDIO) {
+	if (type != stop_type) {
 		igt_warn("Unexpected response type %d\n", type);
 		return false;
 	}
@@ -537,6 +528,155 @@ bool chamelium_stream_stop_realtime_audio(struct chamelium_stream *client)
 	return true;
 }
 
+/**
+ * chamelium_stream_stop_realtime_audio:
+ *
+ * Stops real-time audio capture. This also drops any buffered audio pages.
+ * The caller shouldn't call #chamelium_stream_receive_realtime_audio after
+ * stopping audio capture.
+ */
+bool chamelium_stream_stop_realtime_audio(struct chamelium_stream *client)
+{
+	igt_debug("Stopping real-time audio capture\n");
+
+	return chamelium_stream_stop_dump(client, STREAM_MESSAGE_STOP_DUMP_AUDIO);
+}
+
+/**
+ * chamelium_stream_dump_realtime_video:
+ * @port_id: the Chamelium port to stream video from
+ * @width: the width of the video input
+ * @height: the height of the video input
+ *
+ * Starts streaming the video frames received on @port_id. The caller can
+ * then call #chamelium_stream_receive_realtime_video to receive them.
+ */
+bool chamelium_stream_dump_realtime_video(struct chamelium_stream *client,
+					  int port_id, int width, int height,
+					  enum chamelium_stream_realtime_mode mode)
+{
+	char req[5];
+
+	igt_debug("Starting real-time video capture on port %d (%dx%d)\n",
+		  port_id, width, height);
+
+	/* Port id, then the screen size the stream server should expect */
+	req[0] = port_id;
+	req[1] = width >> 8;
+	req[2] = width & 0xff;
+	req[3] = height >> 8;
+	req[4] = height & 0xff;
+	if (!chamelium_stream_call(client, STREAM_MESSAGE_VIDEO_STREAM,
+				   req, sizeof(req), NULL, 0))
+		return false;
+
+	/* Single pixel mode, then the real-time mode */
+	req[0] = 0;
+	req[1] = mode;
+	return chamelium_stream_call(client, STREAM_MESSAGE_DUMP_REALTIME_VIDEO,
+				     req, 2, NULL, 0);
+}
+
+/**
+ * chamelium_stream_receive_realtime_video:
+ * @frame_number: if non-NULL, will be set to the dumped frame number
+ * @width: will be set to the width of the frame
+ * @height: will be set to the height of the frame
+ * @buf: a caller allocated buffer for the frame pixels
+ * @buf_len: the size in bytes of @buf
+ *
+ * Receives one video frame from the streaming server straight into @buf,
+ * with the same 24 bits per pixel layout as the frames read over XML-RPC.
+ * Reusing the same buffer across frames avoids any allocation or copy on
+ * the receive path.
+ *
+ * In "best effort" mode, some frames can be dropped. This can be detected via
+ * the frame number.
+ *
+ * Returns: the size of the frame in bytes, or 0 on error. Frames larger than
+ * @buf_len are discarded and reported as errors.
+ */
+size_t chamelium_stream_receive_realtime_video(struct chamelium_stream *client,
+					       size_t *frame_number,
+					       int *width, int *height,
+					       void *buf, size_t buf_len)
+{
+	enum stream_message_kind kind;
+	enum stream_message_type type;
+	enum stream_error err;
+	size_t body_len;
+	char meta[12];
+
+	while (true) {
+		if (!chamelium_stream_read_header(client, &kind, &type,
+						  &err, &body_len))
+			return 0;
+
+		if (kind != STREAM_MESSAGE_DATA) {
+			igt_warn("Expected a data message, got kind %d\n", kind);
+			return 0;
+		}
+		if (type != STREAM_MESSAGE_DUMP_REALTIME_VIDEO) {
+			igt_warn("Expected real-time video dump message, "
+				 "got type %d\n", type);
+			return 0;
+		}
+
+		if (err == STREAM_ERROR_NONE)
+			break;
+		else if (err != STREAM_ERROR_VIDEO_MEM_OVERFLOW_DROP) {
+			igt_warn("Received error: %s (%d)\n",
+				 stream_error_str(err), err);
+			return 0;
+		}
+
+		igt_debug("Dropped a video frame because of an overflow\n");
+		igt_assert(body_len == 0);
+	}
+
+	/*
+	 * The frame metadata is laid out as follows:
+	 * - u32: frame number
+	 * - u16: width
+	 * - u16: height
+	 * - u8: channel
+	 * - u8[3]: padding
+	 */
+	igt_assert(body_len >= sizeof(meta));
+
+	if (!read_whole(client->fd, meta, sizeof(meta)))
+		return 0;
+	if (frame_number)
+		*frame_number = ntohl(*(uint32_t *) &meta[0]);
+	*width = ntohs(*(uint16_t *) &meta[4]);
+	*height = ntohs(*(uint16_t *) &meta[6]);
+	body_len -= sizeof(meta);
+
+	if (body_len > buf_len) {
+		igt_warn("Video frame too large (got %zu bytes, have %zu bytes)\n",
+			 body_len, buf_len);
+		read_and_discard(client->fd, body_len);
+		return 0;
+	}
+
+	if (!read_whole(client->fd, buf, body_len))
+		return 0;
+
+	return body_len;
+}
+
+/**
+ * chamelium_stream_stop_realtime_video:
+ *
+ * Stops real-time video capture. This also drops any buffered video frames.
+ */
+bool chamelium_stream_stop_realtime_video(struct chamelium_stream *client)
+{
+	igt_debug("Stopping real-time video capture\n");
+
+	return chamelium_stream_stop_dump(client, STREAM_MESSAGE_STOP_DUMP_VIDEO);
+}
+
 /**
  * chamelium_stream_init:
  *
@@ -49,5 +49,13 @@ bool chamelium_stream_receive_realtime_audio(struct chamelium_stream *client,
 					     size_t *page_count,
 					     int32_t **buf, size_t *buf_len);
 bool chamelium_stream_stop_realtime_audio(struct chamelium_stream *client);
+bool chamelium_stream_dump_realtime_video(struct chamelium_stream *client,
+					  int port_id, int width, int height,
+					  enum chamelium_stream_realtime_mode mode);
+size_t chamelium_stream_receive_realtime_video(struct chamelium_stream *client,
+					       size_t *frame_number,
+					       int *width, int *height,
+					       void *buf, size_t buf_len);
+bool chamelium_stream_stop_realtime_video(struct chamelium_stream *client);
 
 #endif
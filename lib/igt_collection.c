@@ -23,6 +23,7 @@
 
 #include "igt.h"
 #include "igt_collection.h"
+#include "igt_rand.h"
 
 /**
  * SECTION:igt_collection
@@ -37,6 +38,7 @@
  * - combinations
  * - variations with repetitions
  * - variations without repetitions
+ * - covering arrays
  *
  * ## Subsets
  *
@@ -90,6 +92,27 @@
  * (3, 1)
  * (3, 2)
  *
+ * ## Covering arrays
+ *
+ * Let A = { 0, 1 }, B = { 0, 1 } and C = { 0, 1 }
+ *
+ * With strength == 2 we got tuples taking one element of each set, such that
+ * every pair of elements of two different sets appears in at least one tuple,
+ * for instance:
+ *
+ * ( 0, 0, 0 )
+ * ( 0, 1, 1 )
+ * ( 1, 0, 1 )
+ * ( 1, 1, 0 )
+ *
+ * Bugs are mostly triggered by the interaction of a few parameters, so such a
+ * pairwise (or t-wise for strength t) matrix catches most of what the full
+ * product does in far fewer iterations, the gap growing quickly with the
+ * number of sets. The tuples are built greedily and depend on the seed, the
+ * same seed always producing the same tuples.
+ * igt_collection_iter_coverage() reports how many of the t-tuples of
+ * elements were covered so far.
+ *
  * # Usage examples:
  *
  * ## iterator is manually controlled:
@@ -138,6 +161,13 @@
  * for_each_variation_nr(result, result_size, set)
  *       // --- do sth with result ---
  *
+ * // one element of each of formats, modifiers and rotations per result,
+ * // covering all the pairs of them
+ * const struct igt_collection *sets[] = { formats, modifiers, rotations };
+ *
+ * for_each_covering(result, 2, seed, sets, ARRAY_SIZE(sets))
+ *       // --- do sth with result ---
+ *
  * // macro for iteration over set data - for_each_collection_data()
  * for_each_subset(subset, subset_size, set)
  *       for_each_collection_data(data, subset)
@@ -145,6 +175,27 @@
  * ]|
  */
 
+#define COVERING_CANDIDATES 32
+
+struct igt_collection_covering {
+	const struct igt_collection *sets[IGT_COLLECTION_MAXSIZE];
+	int num_sets;
+	int strength;
+	uint32_t rand;
+
+	/* Every @strength sized combination of the sets */
+	int num_combos;
+	struct covering_combo {
+		uint32_t mask;
+		int sets[IGT_COLLECTION_MAXSIZE];
+		uint64_t offset;
+	} *combos;
+
+	/* One bit per tuple of elements of each combination */
+	uint64_t *covered;
+	uint64_t num_tuples, num_covered;
+};
+
 struct igt_collection_iter {
 	const struct igt_collection *set;
 	enum igt_collection_iter_algo algorithm;
@@ -158,6 +209,8 @@ struct igt_collection_iter {
 		int current_result_size;
 		int idxs[IGT_COLLECTION_MAXSIZE];
 	} data;
+
+	struct igt_collection_covering *covering;
 };
 
 /**
@@ -286,6 +339,10 @@ void *igt_collection_get_pointer(struct igt_collection *set, int index)
  * igt_collection_duplicate() must be called to make result collection copy
  * before passing it to the thread.
  *
+ * A COVERING iterator returns variations with repetition covering every pair
+ * of elements at two different positions, see
+ * igt_collection_iter_create_covering().
+ *
  * Returns:
  * pointer to #igt_collection_iter. Asserts on memory allocation failure.
  */
@@ -296,6 +353,16 @@ igt_collection_iter_create(const struct igt_collection *set, int result_size,
 	struct igt_collection_iter *iter;
 
 	igt_assert(result_size > 0 && result_size <= IGT_COLLECTION_MAXSIZE);
+	if (algorithm == COVERING) {
+		const struct igt_collection *sets[IGT_COLLECTION_MAXSIZE];
+
+		for (int i = 0; i < result_size; i++)
+			sets[i] = set;
+
+		return igt_collection_iter_create_covering(sets, result_size,
+							   min(result_size, 2),
+							   0);
+	}
 	if (algorithm != VARIATION_R)
 		igt_assert(result_size <= set->size);
 
@@ -318,9 +385,101 @@ igt_collection_iter_create(const struct igt_collection *set, int result_size,
  */
 void igt_collection_iter_destroy(struct igt_collection_iter *iter)
 {
+	if (iter->covering) {
+		free(iter->covering->combos);
+		free(iter->covering->covered);
+		free(iter->covering);
+	}
 	free(iter);
 }
 
+/**
+ * igt_collection_iter_create_covering
+ * @sets: collections to take the elements of the results from
+ * @num_sets: number of collections, also the size of the results
+ * @strength: size of the combinations of elements to cover, 2 for pairwise
+ * @seed: seed of the generation
+ *
+ * Function creates a COVERING iterator. Each result holds one element of
+ * each of @sets, in order, and every combination of @strength elements taken
+ * from as many different sets appears in at least one result. That takes far
+ * fewer results than the full product of the sets.
+ *
+ * The results are deterministic for a given @seed, different seeds giving
+ * different but equally covering results.
+ *
+ * Returns:
+ * pointer to #igt_collection_iter. Asserts on memory allocation failure.
+ */
+struct igt_collection_iter *
+igt_collection_iter_create_covering(const struct igt_collection **sets,
+				    int num_sets, int strength, uint32_t seed)
+{
+	struct igt_collection_covering *cov;
+	struct igt_collection_iter *iter;
+	uint32_t mask;
+	int c = 0;
+
+	igt_assert(num_sets > 0 && num_sets <= IGT_COLLECTION_MAXSIZE);
+	igt_assert(strength > 0 && strength <= num_sets);
+
+	iter = calloc(1, sizeof(*iter));
+	igt_assert(iter);
+	cov = calloc(1, sizeof(*cov));
+	igt_assert(cov);
+
+	iter->algorithm = COVERING;
+	iter->result_size = num_sets;
+	iter->init = true;
+	iter->covering = cov;
+
+	for (int i = 0; i < num_sets; i++) {
+		igt_assert(sets[i]->size > 0);
+		cov->sets[i] = sets[i];
+	}
+	cov->num_sets = num_sets;
+	cov->strength = strength;
+	cov->rand = seed;
+
+	for (mask = 0; !(mask & (1 << num_sets)); mask++)
+		if (igt_hweight(mask) == strength)
+			cov->num_combos++;
+
+	cov->combos = calloc(cov->num_combos, sizeof(*cov->combos));
+	igt_assert(cov->combos);
+
+	for (mask = 0; !(mask & (1 << num_sets)); mask++) {
+		struct covering_combo *combo = &cov->combos[c];
+		uint64_t tuples = 1;
+		int n = 0;
+
+		if (igt_hweight(mask) != strength)
+			continue;
+
+		combo->mask = mask;
+		combo->offset = cov->num_tuples;
+		for (int i = 0; i < num_sets; i++) {
+			if (!(mask & (1 << i)))
+				continue;
+			combo->sets[n++] = i;
+			tuples *= sets[i]->size;
+		}
+
+		cov->num_tuples += tuples;
+		c++;
+	}
+
+	cov->covered = calloc(DIV_ROUND_UP(cov->num_tuples, 64),
+			      sizeof(*cov->covered));
+	igt_assert(cov->covered);
+
+	/* Mark the padding as covered so that it is never picked */
+	if (cov->num_tuples % 64)
+		cov->covered[cov->num_tuples / 64] = ~0ull << (cov->num_tuples % 64);
+
+	return iter;
+}
+
 static struct igt_collection *
 igt_collection_iter_subsets(struct igt_collection_iter *iter)
 {
@@ -479,6 +638,157 @@ retry:
 	return curr;
 }
 
+static uint64_t covering_tuple(const struct igt_collection_covering *cov,
+			       const struct covering_combo *combo,
+			       const int *idxs)
+{
+	uint64_t id = 0;
+
+	for (int j = 0; j < cov->strength; j++) {
+		int i = combo->sets[j];
+
+		id = id * cov->sets[i]->size + idxs[i];
+	}
+
+	return combo->offset + id;
+}
+
+static bool covering_test(const struct igt_collection_covering *cov,
+			  uint64_t tuple)
+{
+	return cov->covered[tuple / 64] & (1ull << (tuple % 64));
+}
+
+/* Number of tuples of @idxs not covered yet, among the combinations in @mask */
+static int covering_gain(const struct igt_collection_covering *cov,
+			 const int *idxs, uint32_t mask)
+{
+	int gain = 0;
+
+	for (int c = 0; c < cov->num_combos; c++)
+		if ((cov->combos[c].mask & mask) &&
+		    !covering_test(cov, covering_tuple(cov, &cov->combos[c], idxs)))
+			gain++;
+
+	return gain;
+}
+
+/* Sets the elements of an uncovered tuple in @idxs, returns their sets */
+static uint32_t covering_pick(struct igt_collection_covering *cov, int *idxs)
+{
+	uint64_t words = DIV_ROUND_UP(cov->num_tuples, 64);
+	uint64_t w = hars_petruska_f54_1_random64(&cov->rand) % words;
+	const struct covering_combo *combo;
+	uint64_t tuple;
+	int c;
+
+	while (!~cov->covered[w])
+		w = (w + 1) % words;
+	tuple = w * 64 + __builtin_ctzll(~cov->covered[w]);
+
+	for (c = cov->num_combos - 1; cov->combos[c].offset > tuple; c--)
+		;
+	combo = &cov->combos[c];
+
+	tuple -= combo->offset;
+	for (int j = cov->strength - 1; j >= 0; j--) {
+		int i = combo->sets[j];
+
+		idxs[i] = tuple % cov->sets[i]->size;
+		tuple /= cov->sets[i]->size;
+	}
+
+	return combo->mask;
+}
+
+/*
+ * Builds a candidate around an uncovered tuple, choosing the other elements
+ * one set at a time, in random order, to cover as many new tuples as possible.
+ */
+static void covering_candidate(struct igt_collection_covering *cov, int *idxs)
+{
+	int order[IGT_COLLECTION_MAXSIZE];
+	uint32_t fixed;
+	int n = 0;
+
+	fixed = covering_pick(cov, idxs);
+	for (int i = 0; i < cov->num_sets; i++) {
+		if (fixed & (1 << i))
+			continue;
+		idxs[i] = hars_petruska_f54_1_random(&cov->rand) %
+			  cov->sets[i]->size;
+		order[n++] = i;
+	}
+
+	for (int k = n - 1; k > 0; k--) {
+		int j = hars_petruska_f54_1_random(&cov->rand) % (k + 1);
+
+		igt_swap(order[k], order[j]);
+	}
+
+	for (int k = 0; k < n; k++) {
+		int i = order[k], size = cov->sets[i]->size;
+		int start = hars_petruska_f54_1_random(&cov->rand) % size;
+		int best = start, best_gain = -1;
+
+		for (int v = 0; v < size; v++) {
+			int gain;
+
+			idxs[i] = (start + v) % size;
+			gain = covering_gain(cov, idxs, 1 << i);
+			if (gain > best_gain) {
+				best_gain = gain;
+				best = idxs[i];
+			}
+		}
+		idxs[i] = best;
+	}
+}
+
+static struct igt_collection *
+igt_collection_iter_covering(struct igt_collection_iter *iter)
+{
+	struct igt_collection_covering *cov = iter->covering;
+	struct igt_collection *curr = &iter->result;
+	int *best = iter->data.idxs;
+	int idxs[IGT_COLLECTION_MAXSIZE];
+	int best_gain = -1;
+
+	if (iter->init) {
+		iter->init = false;
+		iter->result.size = iter->result_size;
+	}
+
+	if (cov->num_covered == cov->num_tuples)
+		return NULL;
+
+	/* AETG-like: keep the candidate covering the most new tuples */
+	for (int n = 0; n < COVERING_CANDIDATES; n++) {
+		int gain;
+
+		covering_candidate(cov, idxs);
+		gain = covering_gain(cov, idxs, ~0u);
+		if (gain > best_gain) {
+			best_gain = gain;
+			memcpy(best, idxs, sizeof(idxs));
+		}
+	}
+
+	for (int c = 0; c < cov->num_combos; c++) {
+		uint64_t tuple = covering_tuple(cov, &cov->combos[c], best);
+
+		if (!covering_test(cov, tuple)) {
+			cov->covered[tuple / 64] |= 1ull << (tuple % 64);
+			cov->num_covered++;
+		}
+	}
+
+	for (int i = 0; i < cov->num_sets; i++)
+		curr->set[i] = cov->sets[i]->set[best[i]];
+
+	return curr;
+}
+
 /**
  * igt_collection_iter_next
  * @iter: collection iterator
@@ -509,6 +819,9 @@ igt_collection_iter_next(struct igt_collection_iter *iter)
 	case VARIATION_NR:
 		ret_set = igt_collection_iter_variation_nr(iter);
 		break;
+	case COVERING:
+		ret_set = igt_collection_iter_covering(iter);
+		break;
 	default:
 		igt_assert_f(false, "Unknown algorithm\n");
 	}
@@ -536,3 +849,23 @@ igt_collection_iter_next_or_end(struct igt_collection_iter *iter)
 
 	return ret_set;
 }
+
+/**
+ * igt_collection_iter_coverage
+ * @iter: COVERING collection iterator
+ * @covered: returns the number of tuples covered by the results so far
+ * @total: returns the number of tuples to cover
+ *
+ * Reports the coverage of the results returned so far by a COVERING
+ * iterator, i.e. how many of the combinations of strength elements of
+ * different sets they hold. Once the iterator returned NULL @covered equals
+ * @total.
+ */
+void igt_collection_iter_coverage(const struct igt_collection_iter *iter,
+				  uint64_t *covered, uint64_t *total)
+{
+	igt_assert(iter->algorithm == COVERING);
+
+	*covered = iter->covering->num_covered;
+	*total = iter->covering->num_tuples;
+}
@@ -25,6 +25,7 @@
 #define __IGT_COLLECTION_H__
 
 #include <stdbool.h>
+#include <stdint.h>
 
 /* Maximum collection size we support, don't change unless you understand
  * the implementation */
@@ -35,6 +36,7 @@ enum igt_collection_iter_algo {
 	COMBINATION,
 	VARIATION_R,  /* variations with repetition */
 	VARIATION_NR, /* variations without repetitions */
+	COVERING,     /* t-wise covering array of variations with repetition */
 };
 
 struct igt_collection_data {
@@ -62,9 +64,15 @@ struct igt_collection_iter *
 igt_collection_iter_create(const struct igt_collection *set, int subset_size,
 			   enum igt_collection_iter_algo algorithm);
 
+struct igt_collection_iter *
+igt_collection_iter_create_covering(const struct igt_collection **sets,
+				    int num_sets, int strength, uint32_t seed);
+
 void igt_collection_iter_destroy(struct igt_collection_iter *iter);
 struct igt_collection *igt_collection_iter_next(struct igt_collection_iter *iter);
 struct igt_collection *igt_collection_iter_next_or_end(struct igt_collection_iter *iter);
+void igt_collection_iter_coverage(const struct igt_collection_iter *iter,
+				  uint64_t *covered, uint64_t *total);
 
 #define for_each_subset(__result, __size, __set) \
 	for (struct igt_collection_iter *igt_tokencat(__it, __LINE__) = \
@@ -90,6 +98,13 @@ struct igt_collection *igt_collection_iter_next_or_end(struct igt_collection_ite
 		((__result) = igt_collection_iter_next_or_end(\
 			igt_tokencat(__it, __LINE__))); )
 
+#define for_each_covering(__result, __strength, __seed, __sets, __num_sets) \
+	for (struct igt_collection_iter *igt_tokencat(__it, __LINE__) = \
+		igt_collection_iter_create_covering(__sets, __num_sets, \
+						    __strength, __seed); \
+		((__result) = igt_collection_iter_next_or_end(\
+			igt_tokencat(__it, __LINE__))); )
+
 #define for_each_collection_data(__data, __set) \
 	for (int igt_tokencat(__i, __LINE__) = 0; \
 		(__data = (igt_tokencat(__i, __LINE__) < __set->size) ? \
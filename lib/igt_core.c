@@ -54,6 +54,8 @@
 #include <ctype.h>
 #include <limits.h>
 #include <locale.h>
+#include <sched.h>
+#include <stdatomic.h>
 #include <uwildmat/uwildmat.h>
 #ifndef ANDROID
 #include <glib.h>
@@ -73,10 +75,12 @@
 #include "config.h"
 
 #include "igt_core.h"
+#include "igt_arena.h"
 #include "igt_aux.h"
 #include "igt_hook.h"
 #include "igt_sysfs.h"
 #include "igt_sysrq.h"
+#include "igt_telemetry.h"
 #include "igt_rc.h"
 #include "igt_list.h"
 #include "igt_map.h"
@@ -252,6 +256,12 @@
  * It is possible to run a shell script at certain points of test execution with
  * "--hook". See the usage description with "--help-hook" for details.
  *
+ * Setting the environment variable %IGT_FORK_SUBTESTS makes a test run its
+ * fixtures once and fork a fresh child for every subtest it executes. The
+ * child exits once the subtest has completed, so crashes and state leaked by
+ * one subtest don't carry over into the next, while the setup cost is only
+ * paid once per execution instead of once per subtest.
+ *
  * # Configuration
  *
  * Some of IGT's behavior can be configured through a configuration file.
@@ -324,6 +334,14 @@ int num_test_children;
 int test_children_sz;
 bool test_child;
 
+/* forked subtest state */
+static bool fork_subtests;
+static bool subtest_child;
+
+/* concurrent dynamic subtest state */
+static bool dynamic_worker;
+static void dynamic_workers_finish(bool kill_them);
+
 /* fork dynamic support state */
 pid_t *test_multi_fork_children;
 int num_test_multi_fork_children;
@@ -362,11 +380,38 @@ static int igt_exitcode = IGT_EXIT_SUCCESS;
 static const char *command_str;
 
 static char* igt_log_domain_filter;
-static struct {
-	char *entries[256];
-	uint8_t start, end;
-} log_buffer;
-static pthread_mutex_t log_buffer_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* How many of the most recent lines a failure dump shows */
+#define LOG_BUFFER_SIZE 256
+
+struct log_entry {
+	uint64_t seq;
+	char line[];
+};
+
+/*
+ * Every thread logs into a ring of its own so that logging from many
+ * threads doesn't serialize on a lock. The entries have a global
+ * sequence number for merging the rings back into one log when it's
+ * dumped. Lines are handed over with atomic exchanges, whoever swaps
+ * a line out of its slot owns it. Rings of exited threads are reused.
+ */
+struct log_ring {
+	struct log_ring *next;
+	_Atomic(bool) in_use;
+	unsigned int end; /* only touched by the owning thread */
+	_Atomic(struct log_entry *) entries[LOG_BUFFER_SIZE];
+};
+
+struct log_slot {
+	struct log_entry *entry;
+	_Atomic(struct log_entry *) *slot;
+};
+
+static _Atomic(struct log_ring *) log_rings;
+static _Atomic(uint64_t) log_seq;
+static __thread struct log_ring *log_ring_self;
+static pthread_key_t log_ring_key;
 #define LOG_PREFIX_SIZE 32
 char log_prefix[LOG_PREFIX_SIZE] = { 0 };
 
@@ -466,26 +511,144 @@ const char *igt_test_name(void)
 	return command_str;
 }
 
-static void _igt_log_buffer_append(char *line)
+static void log_ring_release(void *data)
 {
-	pthread_mutex_lock(&log_buffer_mutex);
+	struct log_ring *ring = data;
 
-	free(log_buffer.entries[log_buffer.end]);
-	log_buffer.entries[log_buffer.end] = line;
-	log_buffer.end++;
-	if (log_buffer.end == log_buffer.start)
-		log_buffer.start++;
+	atomic_store(&ring->in_use, false);
+}
 
-	pthread_mutex_unlock(&log_buffer_mutex);
+igt_constructor {
+	pthread_key_create(&log_ring_key, log_ring_release);
 }
 
-static void _igt_log_buffer_reset(void)
+static struct log_ring *log_ring_get(void)
+{
+	struct log_ring *ring = log_ring_self;
+
+	if (ring)
+		return ring;
+
+	for (ring = atomic_load(&log_rings); ring; ring = ring->next) {
+		bool in_use = false;
+
+		if (atomic_compare_exchange_strong(&ring->in_use, &in_use, true))
+			break;
+	}
+
+	if (!ring) {
+		ring = calloc(1, sizeof(*ring));
+		if (!ring)
+			return NULL;
+
+		atomic_init(&ring->in_use, true);
+		ring->next = atomic_load(&log_rings);
+		while (!atomic_compare_exchange_weak(&log_rings, &ring->next, ring))
+			;
+	}
+
+	log_ring_self = ring;
+	pthread_setspecific(log_ring_key, ring);
+
+	return ring;
+}
+
+/*
+ * A forked child only has the forking thread left, the rings of the
+ * others are free for reuse. Their lines stay for dumping.
+ */
+static void log_rings_after_fork(void)
+{
+	struct log_ring *ring;
+
+	for (ring = atomic_load(&log_rings); ring; ring = ring->next)
+		if (ring != log_ring_self)
+			atomic_store(&ring->in_use, false);
+}
+
+static void _igt_log_buffer_append(struct log_entry *entry)
 {
-	pthread_mutex_lock(&log_buffer_mutex);
+	struct log_ring *ring = log_ring_get();
 
-	log_buffer.start = log_buffer.end = 0;
+	if (!ring) {
+		free(entry);
+		return;
+	}
 
-	pthread_mutex_unlock(&log_buffer_mutex);
+	entry->seq = atomic_fetch_add(&log_seq, 1);
+	free(atomic_exchange(&ring->entries[ring->end++ % LOG_BUFFER_SIZE], entry));
+}
+
+static int log_slot_cmp(const void *a, const void *b)
+{
+	const struct log_slot *x = a, *y = b;
+
+	return x->entry->seq < y->entry->seq ? -1 : x->entry->seq > y->entry->seq;
+}
+
+/*
+ * Takes all the lines out of the rings, ordered by when they were
+ * logged. They're freed or put back with log_buffer_put().
+ */
+static struct log_slot *log_buffer_take(size_t *count)
+{
+	struct log_slot *slots = NULL;
+	struct log_ring *ring;
+	size_t size = 0;
+
+	*count = 0;
+
+	for (ring = atomic_load(&log_rings); ring; ring = ring->next) {
+		struct log_slot *tmp;
+		int i;
+
+		tmp = realloc(slots, (size + LOG_BUFFER_SIZE) * sizeof(*slots));
+		if (!tmp)
+			break;
+		slots = tmp;
+		size += LOG_BUFFER_SIZE;
+
+		for (i = 0; i < LOG_BUFFER_SIZE; i++) {
+			struct log_entry *entry = atomic_exchange(&ring->entries[i], NULL);
+
+			if (entry) {
+				slots[*count].entry = entry;
+				slots[*count].slot = &ring->entries[i];
+				(*count)++;
+			}
+		}
+	}
+
+	if (*count)
+		qsort(slots, *count, sizeof(*slots), log_slot_cmp);
+
+	return slots;
+}
+
+static void log_buffer_put(struct log_slot *slots, size_t count, bool keep)
+{
+	size_t i;
+
+	for (i = 0; i < count; i++) {
+		struct log_entry *empty = NULL;
+
+		/* The owner may have logged a new line in its place already */
+		if (!keep ||
+		    !atomic_compare_exchange_strong(slots[i].slot, &empty, slots[i].entry))
+			free(slots[i].entry);
+	}
+
+	free(slots);
+}
+
+static void _igt_log_buffer_reset(void)
+{
+	struct log_ring *ring;
+	int i;
+
+	for (ring = atomic_load(&log_rings); ring; ring = ring->next)
+		for (i = 0; i < LOG_BUFFER_SIZE; i++)
+			free(atomic_exchange(&ring->entries[i], NULL));
 }
 
 static void _log_to_runner_split(int stream, const char *str)
@@ -593,7 +756,8 @@ static void _subtest_starting_message(enum _subtest_type subtest_type,
 
 static void _igt_log_buffer_dump(void)
 {
-	uint8_t i;
+	struct log_slot *slots;
+	size_t count, i;
 
 	if (in_subtest && !in_dynamic_subtest && _igt_dynamic_tests_executed >= 0) {
 		/*
@@ -619,26 +783,22 @@ static void _igt_log_buffer_dump(void)
 	else
 		_log_line_fprintf(stderr, "Test %s failed.\n", command_str);
 
-	if (log_buffer.start == log_buffer.end) {
+	slots = log_buffer_take(&count);
+	if (!count) {
 		_log_line_fprintf(stderr, "No log.\n");
+		free(slots);
 		return;
 	}
 
-	pthread_mutex_lock(&log_buffer_mutex);
 	_log_line_fprintf(stderr, "**** DEBUG ****\n");
 
-	i = log_buffer.start;
-	do {
-		char *last_line = log_buffer.entries[i];
-		_log_line_fprintf(stderr, "%s", last_line);
-		i++;
-	} while (i != log_buffer.start && i != log_buffer.end);
+	for (i = count > LOG_BUFFER_SIZE ? count - LOG_BUFFER_SIZE : 0; i < count; i++)
+		_log_line_fprintf(stderr, "%s", slots[i].entry->line);
 
 	/* reset the buffer */
-	log_buffer.start = log_buffer.end = 0;
+	log_buffer_put(slots, count, false);
 
 	_log_line_fprintf(stderr, "****  END  ****\n");
-	pthread_mutex_unlock(&log_buffer_mutex);
 }
 
 /**
@@ -652,17 +812,16 @@ static void _igt_log_buffer_dump(void)
  */
 void igt_log_buffer_inspect(igt_buffer_log_handler_t check, void *data)
 {
-	uint8_t i;
-	pthread_mutex_lock(&log_buffer_mutex);
+	struct log_slot *slots;
+	size_t count, i;
 
-	i = log_buffer.start;
-	do {
-		if (check(log_buffer.entries[i], data))
+	slots = log_buffer_take(&count);
+
+	for (i = count > LOG_BUFFER_SIZE ? count - LOG_BUFFER_SIZE : 0; i < count; i++)
+		if (check(slots[i].entry->line, data))
 			break;
-		i++;
-	} while (i != log_buffer.start && i != log_buffer.end);
 
-	pthread_mutex_unlock(&log_buffer_mutex);
+	log_buffer_put(slots, count, true);
 }
 
 void igt_kmsg(const char *format, ...)
@@ -1078,6 +1237,8 @@ static void common_init_env(void)
 
 	stderr_needs_sentinel = getenv("IGT_SENTINEL_ON_STDERR") != NULL;
 
+	fork_subtests = getenv("IGT_FORK_SUBTESTS") != NULL;
+
 	env = getenv("IGT_FORCE_DRIVER");
 	if (env) {
 		__set_forced_driver(env);
@@ -1092,6 +1253,13 @@ static void common_init_env(void)
 	if (env) {
 		set_runner_socket(atoi(env));
 	}
+
+	env = getenv("IGT_RUNNER_RING_FD");
+	if (env && runner_connected()) {
+		const char *eventfd = getenv("IGT_RUNNER_RING_EVENTFD");
+
+		set_runner_ring(atoi(env), eventfd ? atoi(eventfd) : -1);
+	}
 }
 
 static int common_init(int *argc, char **argv,
@@ -1537,6 +1705,9 @@ bool __igt_run_subtest(const char *subtest_name, const char *file, const int lin
 		return false;
 	}
 
+	if (fork_subtests && !subtest_child && !__igt_fork_subtest(subtest_name))
+		return false;
+
 	igt_kmsg(KMSG_INFO "%s: starting subtest %s\n",
 		 command_str, subtest_name);
 	igt_trace("%s: starting subtest %s\n", command_str, subtest_name);
@@ -1551,6 +1722,9 @@ bool __igt_run_subtest(const char *subtest_name, const char *file, const int lin
 		.evt_type = IGT_HOOK_PRE_SUBTEST,
 		.target_name = subtest_name });
 
+	__igt_arena_enter();
+	__igt_telemetry_enter();
+
 	return (in_subtest = subtest_name);
 }
 
@@ -1571,6 +1745,9 @@ bool __igt_run_dynamic_subtest(const char *dynamic_subtest_name)
 	    uwildmat(dynamic_subtest_name, run_single_dynamic_subtest) == 0)
 		return false;
 
+	/* Don't run alongside concurrent dynamic subtests */
+	dynamic_workers_finish(false);
+
 	igt_kmsg(KMSG_INFO "%s: starting dynamic subtest %s\n",
 		 command_str, dynamic_subtest_name);
 	_subtest_starting_message(_SUBTEST_TYPE_DYNAMIC, dynamic_subtest_name);
@@ -1586,6 +1763,8 @@ bool __igt_run_dynamic_subtest(const char *dynamic_subtest_name)
 		.evt_type = IGT_HOOK_PRE_DYN_SUBTEST,
 		.target_name = dynamic_subtest_name });
 
+	__igt_arena_enter();
+
 	return (in_dynamic_subtest = dynamic_subtest_name);
 }
 
@@ -1675,6 +1854,23 @@ static void kill_and_wait(pid_t *pids, int size, int signum)
 	}
 }
 
+/*
+ * The zygote only sees the exit status of a forked subtest, so encode the
+ * result in it the same way a single subtest execution would.
+ */
+__noreturn static void exit_forked_subtest(const char *result)
+{
+	if (!strcmp(result, "SUCCESS"))
+		exit(IGT_EXIT_SUCCESS);
+	if (!strcmp(result, "SKIP"))
+		exit(IGT_EXIT_SKIP);
+
+	if (igt_exitcode == IGT_EXIT_SUCCESS || igt_exitcode == IGT_EXIT_SKIP)
+		exit(IGT_EXIT_FAILURE);
+
+	exit(igt_exitcode);
+}
+
 __noreturn static void exit_subtest(const char *result)
 {
 	struct timespec now;
@@ -1693,6 +1889,12 @@ __noreturn static void exit_subtest(const char *result)
 		pthread_exit(NULL);
 	}
 
+	/* A container bailing out takes its concurrent dynamic subtests along */
+	if (!in_dynamic_subtest) {
+		dynamic_workers_finish(true);
+		__igt_telemetry_leave();
+	}
+
 	igt_gettime(&now);
 
 	if (test_multi_fork_child)
@@ -1737,6 +1939,9 @@ __noreturn static void exit_subtest(const char *result)
 	intel_bb_reinit_allocator();
 	gem_pool_init();
 
+	/* Release everything the subtest put into the arena */
+	__igt_arena_leave();
+
 	if (!in_dynamic_subtest)
 		_igt_dynamic_tests_executed = -1;
 
@@ -1750,6 +1955,11 @@ __noreturn static void exit_subtest(const char *result)
 
 	*subtest_name = NULL;
 
+	if (subtest_child && jmptarget == &igt_subtest_jmpbuf)
+		exit_forked_subtest(result);
+	if (dynamic_worker && jmptarget == &igt_dynamic_jmpbuf)
+		exit_forked_subtest(result);
+
 	siglongjmp(*jmptarget, 1);
 }
 
@@ -1869,6 +2079,8 @@ void igt_success(void)
 		 * according to the dynamic tests that got
 		 * executed.
 		 */
+		dynamic_workers_finish(false);
+
 		if (dynamic_failed_one)
 			igt_fail(IGT_EXIT_FAILURE);
 
@@ -2443,6 +2655,23 @@ void igt_exit(void)
 		.evt_type = IGT_HOOK_POST_TEST,
 		.result = result });
 
+	if (igt_hook) {
+		char *stats = NULL;
+		size_t len = 0;
+		FILE *f;
+
+		igt_hook_barrier(igt_hook);
+
+		f = open_memstream(&stats, &len);
+		if (f) {
+			igt_hook_print_stats(igt_hook, f);
+			fclose(f);
+			if (len)
+				igt_debug("Hook timings:\n%s", stats);
+			free(stats);
+		}
+	}
+
 	exit(igt_exitcode);
 }
 
@@ -2595,6 +2824,223 @@ static void children_exit_handler(int sig)
 
 static pthread_mutex_t print_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+/* CPUs for the children in the order they're handed out */
+static struct {
+	enum igt_fork_placement placement;
+	int *cpus;
+	int num_cpus;
+} fork_placement;
+
+static int parse_cpulist(const char *list, const cpu_set_t *allowed,
+			 int *cpus, int max)
+{
+	int count = 0;
+
+	while (*list && *list != '\n') {
+		char *end;
+		long first, last;
+
+		first = last = strtol(list, &end, 10);
+		if (end == list)
+			break;
+		if (*end == '-')
+			last = strtol(end + 1, &end, 10);
+
+		for (long cpu = first; cpu <= last && count < max; cpu++)
+			if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, allowed))
+				cpus[count++] = cpu;
+
+		list = *end == ',' ? end + 1 : end;
+	}
+
+	return count;
+}
+
+static int read_node_cpus(int node, const cpu_set_t *allowed, int *cpus, int max)
+{
+	char path[64], buf[4096];
+	int fd, len;
+
+	snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+
+	len = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if (len < 0)
+		return -1;
+	buf[len] = '\0';
+
+	return parse_cpulist(buf, allowed, cpus, max);
+}
+
+/**
+ * igt_fork_set_placement:
+ * @placement: #igt_fork_placement policy
+ * @numa_node: NUMA node of the device under test, for
+ *             %IGT_FORK_PLACEMENT_NUMA_LOCAL
+ *
+ * Sets how children spawned with igt_fork() and igt_multi_fork() get pinned
+ * to CPUs. Only the CPUs the calling process is allowed to run on are used,
+ * and a child is placed according to its child number.
+ *
+ * %IGT_FORK_PLACEMENT_COMPACT fills the CPUs of one NUMA node before using
+ * the next, %IGT_FORK_PLACEMENT_SPREAD alternates between the nodes, both
+ * pinning every child to a single CPU. %IGT_FORK_PLACEMENT_NUMA_LOCAL keeps
+ * all children on the CPUs of @numa_node, see igt_device_get_numa_node(),
+ * and leaves them unpinned if the node isn't known.
+ */
+void igt_fork_set_placement(enum igt_fork_placement placement, int numa_node)
+{
+	int *node_cpus[64] = {};
+	int node_count[64] = {};
+	int num_nodes = 0, total = 0;
+	cpu_set_t allowed;
+	int max;
+
+	free(fork_placement.cpus);
+	memset(&fork_placement, 0, sizeof(fork_placement));
+
+	if (placement == IGT_FORK_PLACEMENT_NONE)
+		return;
+
+	if (sched_getaffinity(0, sizeof(allowed), &allowed)) {
+		igt_warn("Cannot get the CPU affinity, forked children are not placed: %m\n");
+		return;
+	}
+
+	max = CPU_COUNT(&allowed);
+	fork_placement.cpus = calloc(max, sizeof(*fork_placement.cpus));
+	if (!fork_placement.cpus)
+		return;
+
+	if (placement == IGT_FORK_PLACEMENT_NUMA_LOCAL) {
+		if (numa_node >= 0)
+			total = read_node_cpus(numa_node, &allowed,
+					       fork_placement.cpus, max);
+
+		if (total <= 0) {
+			igt_warn("No CPUs found on NUMA node %d, forked children are not placed\n",
+				 numa_node);
+			free(fork_placement.cpus);
+			fork_placement.cpus = NULL;
+			return;
+		}
+
+		goto out;
+	}
+
+	for (int node = 0; node < ARRAY_SIZE(node_cpus); node++) {
+		int count;
+
+		node_cpus[num_nodes] = calloc(max, sizeof(int));
+		if (!node_cpus[num_nodes])
+			break;
+
+		count = read_node_cpus(node, &allowed, node_cpus[num_nodes], max);
+		if (count > 0)
+			node_count[num_nodes++] = count;
+		else
+			free(node_cpus[num_nodes]);
+	}
+
+	if (!num_nodes) {
+		/* No NUMA information, it's all one node */
+		for (int cpu = 0; cpu < CPU_SETSIZE && total < max; cpu++)
+			if (CPU_ISSET(cpu, &allowed))
+				fork_placement.cpus[total++] = cpu;
+	} else if (placement == IGT_FORK_PLACEMENT_COMPACT) {
+		for (int node = 0; node < num_nodes; node++)
+			for (int i = 0; i < node_count[node] && total < max; i++)
+				fork_placement.cpus[total++] = node_cpus[node][i];
+	} else {
+		for (int i = 0; total < max; i++) {
+			int added = 0;
+
+			for (int node = 0; node < num_nodes && total < max; node++) {
+				if (i < node_count[node]) {
+					fork_placement.cpus[total++] = node_cpus[node][i];
+					added++;
+				}
+			}
+
+			if (!added)
+				break;
+		}
+	}
+
+	for (int node = 0; node < num_nodes; node++)
+		free(node_cpus[node]);
+
+out:
+	fork_placement.placement = placement;
+	fork_placement.num_cpus = total;
+}
+
+/**
+ * igt_fork_placement_from_string:
+ * @str: "none", "compact", "spread" or "numa-local"
+ * @placement: output for the parsed policy
+ *
+ * Helper for tools and benchmarks taking the placement as an option.
+ *
+ * Returns: Whether @str was a valid placement policy.
+ */
+bool igt_fork_placement_from_string(const char *str,
+				    enum igt_fork_placement *placement)
+{
+	static const char * const names[] = {
+		[IGT_FORK_PLACEMENT_NONE] = "none",
+		[IGT_FORK_PLACEMENT_COMPACT] = "compact",
+		[IGT_FORK_PLACEMENT_SPREAD] = "spread",
+		[IGT_FORK_PLACEMENT_NUMA_LOCAL] = "numa-local",
+	};
+
+	for (int i = 0; i < ARRAY_SIZE(names); i++) {
+		if (!strcmp(str, names[i])) {
+			*placement = i;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * igt_fork_apply_placement:
+ * @child: child number
+ *
+ * Pins the calling process or thread according to the policy set with
+ * igt_fork_set_placement(). This is done automatically in children of
+ * igt_fork() and igt_multi_fork(). Tests and benchmarks that spawn their own
+ * threads can call it directly.
+ *
+ * Returns: Whether the caller was pinned.
+ */
+bool igt_fork_apply_placement(unsigned int child)
+{
+	cpu_set_t cpus;
+
+	if (!fork_placement.num_cpus)
+		return false;
+
+	CPU_ZERO(&cpus);
+	if (fork_placement.placement == IGT_FORK_PLACEMENT_NUMA_LOCAL) {
+		for (int i = 0; i < fork_placement.num_cpus; i++)
+			CPU_SET(fork_placement.cpus[i], &cpus);
+	} else {
+		CPU_SET(fork_placement.cpus[child % fork_placement.num_cpus], &cpus);
+	}
+
+	if (sched_setaffinity(0, sizeof(cpus), &cpus)) {
+		igt_debug("Failed to pin child %u: %m\n", child);
+		return false;
+	}
+
+	return true;
+}
+
 bool __igt_fork(void)
 {
 	internal_assert(!test_with_subtests || in_subtest,
@@ -2626,7 +3072,7 @@ bool __igt_fork(void)
 		test_child = true;
 		pthread_mutex_init(&print_mutex, NULL);
 		pthread_mutex_init(&ahnd_map_mutex, NULL);
-		pthread_mutex_init(&log_buffer_mutex, NULL);
+		log_rings_after_fork();
 		ahnd_map = igt_map_create(igt_map_hash_64, igt_map_equal_64);
 		child_pid = getpid();
 		child_tid = -1;
@@ -2634,6 +3080,7 @@ bool __igt_fork(void)
 		reset_helper_process_list();
 		oom_adjust_for_doom();
 		igt_unshare_spins();
+		igt_fork_apply_placement(num_test_children - 1);
 
 		return true;
 	default:
@@ -2642,6 +3089,292 @@ bool __igt_fork(void)
 
 }
 
+/**
+ * __igt_fork_subtest:
+ * @subtest_name: name of the subtest about to start
+ *
+ * Fork a child to run @subtest_name in when %IGT_FORK_SUBTESTS is set. The
+ * child returns immediately to run the subtest and exits once it completes,
+ * while the parent waits for it and accounts for the result.
+ *
+ * Returns: true in the child, false in the parent once the child has exited.
+ */
+bool __igt_fork_subtest(const char *subtest_name)
+{
+	struct timespec start, now;
+	pid_t pid;
+	int status;
+
+	igt_gettime(&start);
+
+	/* ensure any buffers are flushed before fork */
+	fflush(NULL);
+
+	switch (pid = fork()) {
+	case -1:
+		igt_critical("Failed to fork subtest %s: %m\n", subtest_name);
+		exit(IGT_EXIT_FAILURE);
+	case 0:
+		subtest_child = true;
+		failed_one = false;
+		igt_exitcode = IGT_EXIT_SUCCESS;
+		pthread_mutex_init(&print_mutex, NULL);
+		log_rings_after_fork();
+		exit_handler_count = 0;
+		reset_helper_process_list();
+
+		return true;
+	default:
+		break;
+	}
+
+	status = __waitpid(pid);
+
+	if (WIFSIGNALED(status)) {
+		/* Killed without our signal handlers getting a say */
+		igt_gettime(&now);
+		_subtest_result_message(_SUBTEST_TYPE_NORMAL, subtest_name,
+					"CRASH", igt_time_elapsed(&start, &now));
+		status = 128 + WTERMSIG(status);
+	} else {
+		status = WEXITSTATUS(status);
+	}
+
+	switch (status) {
+	case IGT_EXIT_SUCCESS:
+		succeeded_one = true;
+		break;
+	case IGT_EXIT_SKIP:
+		skipped_one = true;
+		break;
+	case IGT_EXIT_ABORT:
+		exit(IGT_EXIT_ABORT);
+	default:
+		if (!failed_one)
+			igt_exitcode = status;
+		failed_one = true;
+		break;
+	}
+
+	return false;
+}
+
+/* Dynamic subtests running concurrently, in the order they were started */
+#define MAX_DYNAMIC_WORKERS 64
+
+static struct dynamic_worker {
+	pid_t pid;
+	char name[256];
+	char *resource;
+	int outfd, errfd, commsfd;
+	struct timespec start;
+} dynamic_workers[MAX_DYNAMIC_WORKERS];
+static int num_dynamic_workers;
+
+static int max_dynamic_workers(void)
+{
+	const char *env = getenv("IGT_DYNAMIC_PARALLEL");
+	long max;
+
+	if (env)
+		max = strtol(env, NULL, 0);
+	else
+		max = min_t(long, sysconf(_SC_NPROCESSORS_ONLN), 8);
+
+	return clamp(max, 1L, (long)MAX_DYNAMIC_WORKERS);
+}
+
+static void copy_captured_output(int fd, int outfd)
+{
+	char buf[4096];
+	off_t offset = 0;
+	ssize_t len;
+
+	while ((len = pread(fd, buf, sizeof(buf), offset)) > 0) {
+		if (write(outfd, buf, len) != len)
+			break;
+		offset += len;
+	}
+}
+
+static void close_dynamic_worker(struct dynamic_worker *worker)
+{
+	close(worker->outfd);
+	close(worker->errfd);
+	if (worker->commsfd >= 0)
+		close(worker->commsfd);
+	free(worker->resource);
+}
+
+/*
+ * Waits for the oldest worker and passes on its output as if the
+ * dynamic subtest had run in this process.
+ */
+static void reap_dynamic_worker(void)
+{
+	struct dynamic_worker worker;
+	struct timespec now;
+	int status;
+
+	/* Still listed while waiting, so a timeout can kill it */
+	status = __waitpid(dynamic_workers[0].pid);
+
+	worker = dynamic_workers[0];
+	num_dynamic_workers--;
+	memmove(&dynamic_workers[0], &dynamic_workers[1],
+		num_dynamic_workers * sizeof(dynamic_workers[0]));
+
+	fflush(stdout);
+	fflush(stderr);
+	copy_captured_output(worker.outfd, STDOUT_FILENO);
+	copy_captured_output(worker.errfd, STDERR_FILENO);
+	if (worker.commsfd >= 0)
+		forward_runner_capture(worker.commsfd);
+
+	if (WIFSIGNALED(status)) {
+		/* Killed without our signal handlers getting a say */
+		igt_gettime(&now);
+		_subtest_result_message(_SUBTEST_TYPE_DYNAMIC, worker.name,
+					"CRASH", igt_time_elapsed(&worker.start, &now));
+		status = 128 + WTERMSIG(status);
+	} else {
+		status = WEXITSTATUS(status);
+	}
+
+	close_dynamic_worker(&worker);
+
+	switch (status) {
+	case IGT_EXIT_SUCCESS:
+		break;
+	case IGT_EXIT_SKIP:
+		/* Skips don't count for the result of the container */
+		_igt_dynamic_tests_executed--;
+		break;
+	case IGT_EXIT_ABORT:
+		dynamic_workers_finish(true);
+		exit(IGT_EXIT_ABORT);
+	default:
+		dynamic_failed_one = true;
+		break;
+	}
+}
+
+static bool dynamic_worker_conflicts(const char *resource)
+{
+	/* Without a declared resource it conflicts with everything */
+	if (!resource)
+		return num_dynamic_workers > 0;
+
+	for (int i = 0; i < num_dynamic_workers; i++)
+		if (!dynamic_workers[i].resource ||
+		    !strcmp(dynamic_workers[i].resource, resource))
+			return true;
+
+	return false;
+}
+
+/*
+ * Waits for all the running dynamic subtests, or kills them when the
+ * containing subtest is bailing out.
+ */
+static void dynamic_workers_finish(bool kill_them)
+{
+	if (kill_them)
+		for (int i = 0; i < num_dynamic_workers; i++)
+			kill(dynamic_workers[i].pid, SIGKILL);
+
+	while (num_dynamic_workers)
+		reap_dynamic_worker();
+}
+
+/**
+ * __igt_run_dynamic_parallel:
+ * @dynamic_subtest_name: name of the dynamic subtest
+ * @resource: what the dynamic subtest uses exclusively, or NULL
+ *
+ * Starts @dynamic_subtest_name in a forked worker, first waiting for the
+ * running workers using the same @resource. See igt_dynamic_parallel().
+ *
+ * Returns: true in the worker, false in the test process.
+ */
+bool __igt_run_dynamic_parallel(const char *dynamic_subtest_name,
+				const char *resource)
+{
+	struct dynamic_worker *worker;
+	int max = max_dynamic_workers();
+
+	internal_assert(in_subtest && _igt_dynamic_tests_executed >= 0,
+			"igt_dynamic_parallel is allowed only inside igt_subtest_with_dynamic\n");
+	internal_assert(!in_dynamic_subtest,
+			"igt_dynamic_parallel is not allowed to be nested in another igt_dynamic\n");
+	internal_assert(!test_child && !test_multi_fork_child,
+			"igt_dynamic_parallel is not allowed in forked children\n");
+
+	if (max == 1)
+		return __igt_run_dynamic_subtest(dynamic_subtest_name);
+
+	if (!valid_name_for_subtest(dynamic_subtest_name)) {
+		igt_critical("Invalid dynamic subtest name \"%s\".\n",
+			     dynamic_subtest_name);
+		igt_exit();
+	}
+
+	if (run_single_dynamic_subtest &&
+	    uwildmat(dynamic_subtest_name, run_single_dynamic_subtest) == 0)
+		return false;
+
+	/* Keep the output in start order, wait for the oldest first */
+	while (num_dynamic_workers >= max ||
+	       dynamic_worker_conflicts(resource))
+		reap_dynamic_worker();
+
+	worker = &dynamic_workers[num_dynamic_workers];
+	memset(worker, 0, sizeof(*worker));
+	snprintf(worker->name, sizeof(worker->name), "%s", dynamic_subtest_name);
+	worker->resource = resource ? strdup(resource) : NULL;
+	worker->outfd = memfd_create("igt_dynamic_out", MFD_CLOEXEC);
+	worker->errfd = memfd_create("igt_dynamic_err", MFD_CLOEXEC);
+	worker->commsfd = runner_connected() ?
+		memfd_create("igt_dynamic_comms", MFD_CLOEXEC) : -1;
+	igt_assert(worker->outfd >= 0 && worker->errfd >= 0 &&
+		   (worker->commsfd >= 0 || !runner_connected()));
+	igt_gettime(&worker->start);
+
+	/* ensure any buffers are flushed before fork */
+	fflush(NULL);
+
+	switch (worker->pid = fork()) {
+	case -1:
+		close_dynamic_worker(worker);
+		igt_assert(0);
+	case 0:
+		dynamic_worker = true;
+		dup2(worker->outfd, STDOUT_FILENO);
+		dup2(worker->errfd, STDERR_FILENO);
+		if (worker->commsfd >= 0)
+			set_runner_capture(worker->commsfd);
+
+		/* The other workers are the test process' business */
+		for (int i = 0; i < num_dynamic_workers; i++)
+			close_dynamic_worker(&dynamic_workers[i]);
+		num_dynamic_workers = 0;
+
+		pthread_mutex_init(&print_mutex, NULL);
+		log_rings_after_fork();
+		exit_handler_count = 0;
+		reset_helper_process_list();
+
+		return __igt_run_dynamic_subtest(dynamic_subtest_name);
+	default:
+		break;
+	}
+
+	num_dynamic_workers++;
+	_igt_dynamic_tests_executed++;
+
+	return false;
+}
+
 static void dyn_children_exit_handler(int sig)
 {
 	int status;
@@ -2684,6 +3417,7 @@ bool __igt_multi_fork(void)
 	case 0:
 		test_multi_fork_child = true;
 		snprintf(log_prefix, LOG_PREFIX_SIZE, "<g:%d> ", num_test_multi_fork_children - 1);
+		igt_fork_apply_placement(num_test_multi_fork_children - 1);
 		num_test_multi_fork_children = 0; /* only parent should care */
 		pthread_mutex_init(&print_mutex, NULL);
 		child_pid = getpid(); /* for allocator */
@@ -3188,9 +3922,14 @@ igt_constructor {
 void igt_vlog(const char *domain, enum igt_log_level level, const char *format, va_list args)
 {
 	FILE *file;
-	char *line, *formatted_line;
-	char *thread_id;
+	struct log_entry *entry;
+	char thread_id[LOG_PREFIX_SIZE + 32];
+	char prefix[256];
+	char msg[256];
+	const char *line;
 	const char *program_name;
+	int prefixlen = 0, len;
+	va_list args_copy;
 	const char *igt_log_level_str[] = {
 		"DEBUG",
 		"INFO",
@@ -3207,40 +3946,50 @@ void igt_vlog(const char *domain, enum igt_log_level level, const char *format,
 	program_name = command_str;
 #endif
 
-	if (igt_thread_is_main()) {
-		thread_id = strdup(log_prefix);
-	} else {
-		if (asprintf(&thread_id, "%s[thread:%d] ", log_prefix, gettid()) == -1)
-			thread_id = NULL;
-	}
-
-	if (!thread_id)
+	if (igt_only_list_subtests() && level <= IGT_LOG_WARN)
 		return;
 
-	if (igt_only_list_subtests() && level <= IGT_LOG_WARN)
+	if (igt_thread_is_main())
+		snprintf(thread_id, sizeof(thread_id), "%s", log_prefix);
+	else
+		snprintf(thread_id, sizeof(thread_id), "%s[thread:%d] ", log_prefix, gettid());
+
+	if (!pthread_getspecific(__vlog_line_continuation)) {
+		prefixlen = snprintf(prefix, sizeof(prefix), "(%s:%d) %s%s%s%s: ", program_name,
+				     getpid(), thread_id, (domain) ? domain : "", (domain) ? "-" : "",
+				     igt_log_level_str[level]);
+		if (prefixlen < 0)
+			return;
+		prefixlen = min_t(int, prefixlen, sizeof(prefix) - 1);
+	}
+
+	/*
+	 * The line is formatted once, straight after the prefix in the
+	 * log buffer entry. Most lines are below the print level and
+	 * only kept for a failure dump, they don't need anything more.
+	 */
+	va_copy(args_copy, args);
+	len = vsnprintf(msg, sizeof(msg), format, args_copy);
+	va_end(args_copy);
+	if (len < 0)
 		return;
 
-	if (vasprintf(&line, format, args) == -1)
+	entry = malloc(sizeof(*entry) + prefixlen + len + 1);
+	if (!entry)
 		return;
 
-	if (pthread_getspecific(__vlog_line_continuation)) {
-		formatted_line = strdup(line);
-		if (!formatted_line)
-			goto out;
-	} else if (asprintf(&formatted_line, "(%s:%d) %s%s%s%s: %s", program_name,
-		     getpid(), thread_id, (domain) ? domain : "", (domain) ? "-" : "",
-		     igt_log_level_str[level], line) == -1) {
-		goto out;
-	}
+	memcpy(entry->line, prefix, prefixlen);
+	if (len < sizeof(msg))
+		memcpy(entry->line + prefixlen, msg, len + 1);
+	else
+		vsnprintf(entry->line + prefixlen, len + 1, format, args);
+	line = entry->line + prefixlen;
 
-	if (line[strlen(line) - 1] == '\n')
+	if (len && line[len - 1] == '\n')
 		pthread_setspecific(__vlog_line_continuation, (void*) false);
 	else
 		pthread_setspecific(__vlog_line_continuation, (void*) true);
 
-	/* append log buffer */
-	_igt_log_buffer_append(formatted_line);
-
 	/* check print log level */
 	if (igt_log_level > level)
 		goto out;
@@ -3268,7 +4017,7 @@ void igt_vlog(const char *domain, enum igt_log_level level, const char *format,
 	/* prepend all except information messages with process, domain and log
 	 * level information */
 	if (level != IGT_LOG_INFO) {
-		_log_line_fprintf(file, "%s", formatted_line);
+		_log_line_fprintf(file, "%s", entry->line);
 	} else {
 		_log_line_fprintf(file, "%s%s", thread_id, line);
 	}
@@ -3276,8 +4025,8 @@ void igt_vlog(const char *domain, enum igt_log_level level, const char *format,
 	pthread_mutex_unlock(&print_mutex);
 
 out:
-	free(line);
-	free(thread_id);
+	/* append log buffer, it owns the entry from here on */
+	_igt_log_buffer_append(entry);
 }
 
 static const char *timeout_op;
@@ -200,8 +200,11 @@ int igt_subtest_init_parse_opts(int *argc, char **argv,
 	igt_subtest_init_parse_opts(&argc, argv, NULL, NULL, NULL, NULL, NULL);
 
 bool __igt_run_subtest(const char *subtest_name, const char *file, const int line);
+bool __igt_fork_subtest(const char *subtest_name);
 bool __igt_enter_dynamic_container(void);
 bool __igt_run_dynamic_subtest(const char *dynamic_subtest_name);
+bool __igt_run_dynamic_parallel(const char *dynamic_subtest_name,
+				const char *resource);
 #define __igt_tokencat2(x, y) x ## y
 
 /**
@@ -381,6 +384,51 @@ bool __igt_run_dynamic_subtest(const char *dynamic_subtest_name);
 #define igt_dynamic_f(f...) \
 	__igt_dynamic_f(igt_unique(__tmpchar), f)
 
+/**
+ * igt_dynamic_parallel:
+ * @name: name of the dynamic subtest
+ * @resource: string naming what the dynamic subtest uses exclusively, or
+ *            NULL if it can't run alongside any other
+ *
+ * Like igt_dynamic(), but the code block runs in a forked worker while the
+ * test carries on to the next dynamic subtest, for iterating over hardware
+ * that can be exercised independently, like the engines in a non-display
+ * test. Dynamic subtests declaring the same @resource are run one after
+ * another.
+ *
+ * The output of each worker is held back until it exits and is then passed
+ * on as a whole, so results and logs stay per dynamic subtest, in the order
+ * the dynamic subtests were started. The containing subtest waits for all of
+ * them before yielding its result. State set up in the worker, including
+ * igt_fixture-like setup inside the block, is lost when it exits.
+ *
+ * The number of concurrent workers defaults to the number of CPUs, up to 8,
+ * and can be set with the IGT_DYNAMIC_PARALLEL environment variable. Setting
+ * it to 1 runs the blocks in the test process exactly like igt_dynamic().
+ */
+#define igt_dynamic_parallel(name, resource) \
+	for (; __igt_run_dynamic_parallel((name), (resource)) && \
+	       (sigsetjmp(igt_dynamic_jmpbuf, 1) == 0); \
+	     igt_success())
+#define __igt_dynamic_parallel_f(tmp, resource, format...) \
+	for (char tmp [256]; \
+	     snprintf( tmp , sizeof( tmp ), \
+		      format), \
+	     __igt_run_dynamic_parallel( tmp, (resource) ) && \
+	     (sigsetjmp(igt_dynamic_jmpbuf, 1) == 0); \
+	     igt_success())
+
+/**
+ * igt_dynamic_parallel_f:
+ * @resource: what the dynamic subtest uses exclusively, or NULL
+ * @...: format string and optional arguments
+ *
+ * Like igt_dynamic_parallel(), but also accepts a printf format string
+ * instead of a static string.
+ */
+#define igt_dynamic_parallel_f(resource, f...) \
+	__igt_dynamic_parallel_f(igt_unique(__tmpchar), resource, f)
+
 const char *igt_subtest_name(void);
 const char *igt_dynamic_subtest_name(void);
 bool igt_only_list_subtests(void);
@@ -1168,6 +1216,28 @@ bool __igt_multi_fork(void);
 
 int __igt_multi_wait(void);
 
+/**
+ * igt_fork_placement:
+ * @IGT_FORK_PLACEMENT_NONE: leave the children to the scheduler (default)
+ * @IGT_FORK_PLACEMENT_COMPACT: pin to single CPUs, filling a NUMA node first
+ * @IGT_FORK_PLACEMENT_SPREAD: pin to single CPUs, alternating NUMA nodes
+ * @IGT_FORK_PLACEMENT_NUMA_LOCAL: pin to the NUMA node of the device
+ *
+ * CPU placement policies for igt_fork() and igt_multi_fork() children, see
+ * igt_fork_set_placement().
+ */
+enum igt_fork_placement {
+	IGT_FORK_PLACEMENT_NONE,
+	IGT_FORK_PLACEMENT_COMPACT,
+	IGT_FORK_PLACEMENT_SPREAD,
+	IGT_FORK_PLACEMENT_NUMA_LOCAL,
+};
+
+void igt_fork_set_placement(enum igt_fork_placement placement, int numa_node);
+bool igt_fork_placement_from_string(const char *str,
+				    enum igt_fork_placement *placement);
+bool igt_fork_apply_placement(unsigned int child);
+
 /**
  * igt_helper_process:
  * @running: indicates whether the process is currently running
@@ -42,9 +42,22 @@
  * CRC32 code derived from work by Gary S. Brown.
  */
 
+#include "config.h"
+
+#include <pthread.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef __aarch64__
+#include <sys/auxv.h>
+#endif
+
+#include "igt_aux.h"
+#include "igt_core.h"
 #include "igt_crc.h"
+#include "igt_x86.h"
 
 const uint32_t igt_crc32_tab[256] = {
 	0x00000000, 0x77073096, 0xee0e612c, 0x990951ba, 0x076dc419, 0x706af48f,
@@ -92,16 +105,376 @@ const uint32_t igt_crc32_tab[256] = {
 	0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d
 };
 
+/*
+ * All the implementations below update the internal, inverted, CRC state
+ * and must give bit-identical results.
+ */
+typedef uint32_t (*crc32_update_fn)(uint32_t crc, const uint8_t *p, size_t size);
+
+static uint32_t crc32_update_bytes(uint32_t crc, const uint8_t *p, size_t size)
+{
+	while (size--)
+		crc = igt_crc32_tab[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+
+	return crc;
+}
+
+/* Slicing-by-8: crc32_slice_tab[k][n] is the CRC of byte n followed by k zeros */
+static uint32_t crc32_slice_tab[8][256];
+
+static void crc32_slice_init(void)
+{
+	int k, n;
+
+	memcpy(crc32_slice_tab[0], igt_crc32_tab, sizeof(igt_crc32_tab));
+
+	for (k = 1; k < 8; k++)
+		for (n = 0; n < 256; n++)
+			crc32_slice_tab[k][n] =
+				(crc32_slice_tab[k - 1][n] >> 8) ^
+				igt_crc32_tab[crc32_slice_tab[k - 1][n] & 0xFF];
+}
+
+static uint32_t crc32_update_slice8(uint32_t crc, const uint8_t *p, size_t size)
+{
+	while (size && ((uintptr_t)p & 7)) {
+		crc = igt_crc32_tab[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+		size--;
+	}
+
+	while (size >= 8) {
+		uint32_t lo, hi;
+
+		/* The table walk below assumes little-endian loads */
+		lo = (p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24) ^ crc;
+		hi = p[4] | p[5] << 8 | p[6] << 16 | (uint32_t)p[7] << 24;
+
+		crc = crc32_slice_tab[7][lo & 0xFF] ^
+		      crc32_slice_tab[6][(lo >> 8) & 0xFF] ^
+		      crc32_slice_tab[5][(lo >> 16) & 0xFF] ^
+		      crc32_slice_tab[4][lo >> 24] ^
+		      crc32_slice_tab[3][hi & 0xFF] ^
+		      crc32_slice_tab[2][(hi >> 8) & 0xFF] ^
+		      crc32_slice_tab[1][(hi >> 16) & 0xFF] ^
+		      crc32_slice_tab[0][hi >> 24];
+
+		p += 8;
+		size -= 8;
+	}
+
+	return crc32_update_bytes(crc, p, size);
+}
+
+#if defined(__x86_64__) && !defined(__clang__)
+#pragma GCC push_options
+#pragma GCC target("sse4.1,pclmul")
+
+#include <smmintrin.h>
+#include <wmmintrin.h>
+
+/*
+ * Carry-less multiplication folding, as in "Fast CRC Computation for
+ * Generic Polynomials Using PCLMULQDQ Instruction" (Intel, 2009), with the
+ * bit-reflected constants for the 0x04c11db7 polynomial given at the end of
+ * the paper. Folds 64 bytes per iteration.
+ */
+static uint32_t crc32_update_pclmul(uint32_t crc, const uint8_t *p, size_t size)
+{
+	static const uint64_t __attribute__((aligned(16))) k1k2[] = { 0x0154442bd4, 0x01c6e41596 };
+	static const uint64_t __attribute__((aligned(16))) k3k4[] = { 0x01751997d0, 0x00ccaa009e };
+	static const uint64_t __attribute__((aligned(16))) k5k0[] = { 0x0163cd6124, 0x0000000000 };
+	static const uint64_t __attribute__((aligned(16))) poly[] = { 0x01db710641, 0x01f7011641 };
+	__m128i x0, x1, x2, x3, x4, x5, x6, x7, x8;
+	size_t tail;
+
+	if (size < 64)
+		return crc32_update_slice8(crc, p, size);
+
+	tail = size & 15;
+	size -= tail;
+
+	x1 = _mm_loadu_si128((const __m128i *)(p + 0x00));
+	x2 = _mm_loadu_si128((const __m128i *)(p + 0x10));
+	x3 = _mm_loadu_si128((const __m128i *)(p + 0x20));
+	x4 = _mm_loadu_si128((const __m128i *)(p + 0x30));
+
+	x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(crc));
+
+	x0 = _mm_load_si128((const __m128i *)k1k2);
+
+	p += 64;
+	size -= 64;
+
+	while (size >= 64) {
+		x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+		x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+		x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+		x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+
+		x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+		x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+		x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+		x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x5),
+				   _mm_loadu_si128((const __m128i *)(p + 0x00)));
+		x2 = _mm_xor_si128(_mm_xor_si128(x2, x6),
+				   _mm_loadu_si128((const __m128i *)(p + 0x10)));
+		x3 = _mm_xor_si128(_mm_xor_si128(x3, x7),
+				   _mm_loadu_si128((const __m128i *)(p + 0x20)));
+		x4 = _mm_xor_si128(_mm_xor_si128(x4, x8),
+				   _mm_loadu_si128((const __m128i *)(p + 0x30)));
+
+		p += 64;
+		size -= 64;
+	}
+
+	/* Fold into 128 bits */
+	x0 = _mm_load_si128((const __m128i *)k3k4);
+
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+	while (size >= 16) {
+		x2 = _mm_loadu_si128((const __m128i *)p);
+
+		x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+		p += 16;
+		size -= 16;
+	}
+
+	/* Fold 128 bits into 64 */
+	x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+	x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+	x1 = _mm_srli_si128(x1, 8);
+	x1 = _mm_xor_si128(x1, x2);
+
+	x0 = _mm_loadl_epi64((const __m128i *)k5k0);
+
+	x2 = _mm_srli_si128(x1, 4);
+	x1 = _mm_and_si128(x1, x3);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	/* Barrett reduction to 32 bits */
+	x0 = _mm_load_si128((const __m128i *)poly);
+
+	x2 = _mm_and_si128(x1, x3);
+	x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+	x2 = _mm_and_si128(x2, x3);
+	x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	crc = _mm_extract_epi32(x1, 1);
+
+	return crc32_update_slice8(crc, p, tail);
+}
+
+#pragma GCC pop_options
+#endif
+
+#if defined(__aarch64__) && !defined(__clang__)
+#pragma GCC push_options
+#pragma GCC target("+crc")
+
+#include <arm_acle.h>
+
+/* The ARMv8 CRC32 instructions (not CRC32C) use the same polynomial */
+static uint32_t crc32_update_armv8(uint32_t crc, const uint8_t *p, size_t size)
+{
+	while (size && ((uintptr_t)p & 7)) {
+		crc = __crc32b(crc, *p++);
+		size--;
+	}
+
+	while (size >= 8) {
+		uint64_t v;
+
+		memcpy(&v, p, sizeof(v));
+		crc = __crc32d(crc, v);
+		p += 8;
+		size -= 8;
+	}
+
+	while (size--)
+		crc = __crc32b(crc, *p++);
+
+	return crc;
+}
+
+#pragma GCC pop_options
+#endif
+
+static crc32_update_fn crc32_update;
+static pthread_once_t crc32_once = PTHREAD_ONCE_INIT;
+
+static void crc32_select(void)
+{
+	const char *impl = getenv("IGT_CRC32_IMPL");
+
+	crc32_slice_init();
+	crc32_update = crc32_update_slice8;
+
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+	/* The PCLMUL and slicing paths are written for little-endian */
+	crc32_update = crc32_update_bytes;
+#endif
+
+	/* Forcing a portable path lets it be tested on any machine */
+	if (impl && !strcmp(impl, "bytes")) {
+		crc32_update = crc32_update_bytes;
+		return;
+	}
+	if (impl && !strcmp(impl, "slice8"))
+		return;
+
+#if defined(__x86_64__) && !defined(__clang__)
+	if ((igt_x86_features() & (SSE4_1 | PCLMUL)) == (SSE4_1 | PCLMUL))
+		crc32_update = crc32_update_pclmul;
+#endif
+
+#if defined(__aarch64__) && !defined(__clang__) && defined(HWCAP_CRC32)
+	if (getauxval(AT_HWCAP) & HWCAP_CRC32)
+		crc32_update = crc32_update_armv8;
+#endif
+}
+
+/**
+ * igt_cpu_crc32:
+ * @buf: data to checksum
+ * @size: size of @buf in bytes
+ *
+ * Computes the CRC32, as used by zlib and Ethernet, of @buf on the CPU.
+ * Uses PCLMULQDQ folding on x86 and the CRC32 instructions on ARMv8 when
+ * available, slicing-by-8 lookups otherwise. Setting IGT_CRC32_IMPL to
+ * "slice8" or "bytes" in the environment forces the slicing-by-8 or the
+ * bytewise implementation instead.
+ *
+ * Returns: the CRC32 of @buf.
+ */
 uint32_t igt_cpu_crc32(const void *buf, size_t size)
 {
+	pthread_once(&crc32_once, crc32_select);
+
+	return crc32_update(~0U, buf, size) ^ ~0U;
+}
+
+/*
+ * CRC combination, as in zlib: appending len zero bytes to a message
+ * multiplies its CRC by x^(8 * len) modulo the polynomial.
+ */
+static uint32_t crc32_multmodp(uint32_t a, uint32_t b)
+{
+	uint32_t m = 1u << 31, p = 0;
 
-	const uint8_t *p = buf;
+	for (;;) {
+		if (a & m) {
+			p ^= b;
+			if ((a & (m - 1)) == 0)
+				break;
+		}
+		m >>= 1;
+		b = b & 1 ? (b >> 1) ^ 0xedb88320 : b >> 1;
+	}
+
+	return p;
+}
+
+static uint32_t crc32_combine(uint32_t crc1, uint32_t crc2, size_t len2)
+{
+	uint32_t x2n = 1u << 30; /* x^1, then x^2^k */
+	uint32_t p = 1u << 31; /* x^0 */
+
+	/* x^(8 * len2) == product of x^2^k for the bits set in 8 * len2 */
+	x2n = crc32_multmodp(x2n, x2n);
+	x2n = crc32_multmodp(x2n, x2n);
+	x2n = crc32_multmodp(x2n, x2n);
+
+	while (len2) {
+		if (len2 & 1)
+			p = crc32_multmodp(x2n, p);
+		len2 >>= 1;
+		x2n = crc32_multmodp(x2n, x2n);
+	}
+
+	return crc32_multmodp(p, crc1) ^ crc2;
+}
+
+struct crc32_chunk {
+	pthread_t thread;
+	const uint8_t *buf;
+	size_t size;
 	uint32_t crc;
+};
 
-	crc = ~0U;
+static void *crc32_chunk_thread(void *arg)
+{
+	struct crc32_chunk *chunk = arg;
 
-	while (size--)
-		crc = igt_crc32_tab[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+	chunk->crc = igt_cpu_crc32(chunk->buf, chunk->size);
+
+	return NULL;
+}
+
+#define CRC32_MIN_CHUNK (16ul << 20)
+#define CRC32_MAX_THREADS 64
+
+/**
+ * igt_cpu_crc32_parallel:
+ * @buf: data to checksum
+ * @size: size of @buf in bytes
+ * @threads: maximum number of threads to use, 0 for one per online CPU
+ *
+ * Like igt_cpu_crc32(), but splits large buffers into chunks checksummed by
+ * separate threads and combines the results. Gives the same result as
+ * igt_cpu_crc32(). Buffers too small to be worth it are checksummed by the
+ * calling thread.
+ *
+ * Returns: the CRC32 of @buf.
+ */
+uint32_t igt_cpu_crc32_parallel(const void *buf, size_t size, int threads)
+{
+	struct crc32_chunk chunks[CRC32_MAX_THREADS];
+	size_t chunk_size;
+	uint32_t crc;
+	int i, n;
+
+	if (threads <= 0)
+		threads = sysconf(_SC_NPROCESSORS_ONLN);
+
+	n = min_t(size_t, threads, size / CRC32_MIN_CHUNK);
+	n = min(n, CRC32_MAX_THREADS);
+	if (n <= 1)
+		return igt_cpu_crc32(buf, size);
+
+	/* Keep chunks cacheline aligned, the last one takes the remainder */
+	chunk_size = (size / n) & ~63ul;
+
+	for (i = 0; i < n; i++) {
+		chunks[i].buf = (const uint8_t *)buf + i * chunk_size;
+		chunks[i].size = i == n - 1 ? size - i * chunk_size : chunk_size;
+		igt_assert_eq(pthread_create(&chunks[i].thread, NULL,
+					     crc32_chunk_thread, &chunks[i]), 0);
+	}
+
+	for (i = 0; i < n; i++)
+		pthread_join(chunks[i].thread, NULL);
+
+	crc = chunks[0].crc;
+	for (i = 1; i < n; i++)
+		crc = crc32_combine(crc, chunks[i].crc, chunks[i].size);
 
-	return crc ^ ~0U;
+	return crc;
 }
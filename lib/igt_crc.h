@@ -27,5 +27,6 @@
 extern const uint32_t igt_crc32_tab[256];
 
 uint32_t igt_cpu_crc32(const void *buf, size_t size);
+uint32_t igt_cpu_crc32_parallel(const void *buf, size_t size, int threads);
 
 #endif
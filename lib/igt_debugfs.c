@@ -405,6 +405,189 @@ int igt_debugfs_simple_read(int dir, const char *filename, char *buf, int size)
 	return len;
 }
 
+/*
+ * Debugfs files are mostly seq_files, which produce at most a page per read()
+ * call, so ask for plenty and let the buffer grow to the size of the file.
+ */
+#define DEBUGFS_FILE_CHUNK (64 << 10)
+
+struct igt_debugfs_file {
+	int fd;
+	char *buf;
+	size_t size;
+	/* Valid bytes in buf, and the offset in the file they end at */
+	size_t len;
+	off_t pos;
+	/* Start of the next line for igt_debugfs_file_next_line() */
+	size_t line;
+	bool eof;
+};
+
+/**
+ * igt_debugfs_file_open:
+ * @dir: fd of the debugfs directory
+ * @filename: file name
+ *
+ * Opens @filename for repeated reads with igt_debugfs_file_read() or
+ * igt_debugfs_file_next_line(). Each read starts again from the beginning of
+ * the file, so polling it does not need to open it again, and the file is
+ * read whole whatever its size.
+ *
+ * Returns:
+ * The file handle, to be released with igt_debugfs_file_close(), or NULL
+ * with errno set on failure.
+ */
+struct igt_debugfs_file *igt_debugfs_file_open(int dir, const char *filename)
+{
+	struct igt_debugfs_file *file;
+	int fd;
+
+	fd = openat(dir, filename, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return NULL;
+
+	file = calloc(1, sizeof(*file));
+	igt_assert(file);
+	file->fd = fd;
+
+	return file;
+}
+
+/**
+ * igt_debugfs_file_close:
+ * @file: file handle, may be NULL
+ *
+ * Closes @file and frees its buffer.
+ */
+void igt_debugfs_file_close(struct igt_debugfs_file *file)
+{
+	if (!file)
+		return;
+
+	close(file->fd);
+	free(file->buf);
+	free(file);
+}
+
+/**
+ * igt_debugfs_file_rewind:
+ * @file: file handle
+ *
+ * Makes the next igt_debugfs_file_next_line() start again from the beginning
+ * of @file, reading it again.
+ */
+void igt_debugfs_file_rewind(struct igt_debugfs_file *file)
+{
+	file->len = 0;
+	file->pos = 0;
+	file->line = 0;
+	file->eof = false;
+}
+
+/* Appends the next chunk of the file to the buffer, 0 at the end */
+static ssize_t debugfs_file_fill(struct igt_debugfs_file *file)
+{
+	ssize_t ret;
+
+	if (file->size - file->len < DEBUGFS_FILE_CHUNK + 1) {
+		file->size = max(2 * file->size,
+				 file->len + DEBUGFS_FILE_CHUNK + 1);
+		file->buf = realloc(file->buf, file->size);
+		igt_assert(file->buf);
+	}
+
+	do {
+		ret = pread(file->fd, file->buf + file->len,
+			    file->size - file->len - 1, file->pos);
+	} while (ret < 0 && errno == EINTR);
+
+	if (ret > 0) {
+		file->len += ret;
+		file->pos += ret;
+	} else {
+		file->eof = true;
+	}
+	file->buf[file->len] = '\0';
+
+	return ret;
+}
+
+/**
+ * igt_debugfs_file_read:
+ * @file: file handle
+ *
+ * Reads the whole of @file again from its start.
+ *
+ * Returns:
+ * The NUL terminated contents, valid until the next read of @file, or NULL
+ * with errno set on failure.
+ */
+const char *igt_debugfs_file_read(struct igt_debugfs_file *file)
+{
+	ssize_t ret;
+
+	igt_debugfs_file_rewind(file);
+	while ((ret = debugfs_file_fill(file)) > 0)
+		;
+
+	return ret < 0 ? NULL : file->buf;
+}
+
+/**
+ * igt_debugfs_file_next_line:
+ * @file: file handle
+ *
+ * Iterates over the lines of @file, reading it a chunk at a time so that
+ * stopping early does not pay for the rest of a large file. The first call,
+ * and the first one after the last line was returned or after
+ * igt_debugfs_file_rewind(), reads again from the beginning of the file.
+ * Right after igt_debugfs_file_read() it iterates over the contents that
+ * read returned instead.
+ *
+ * Returns:
+ * The next line without its newline, valid until the next call, or NULL
+ * once the whole file was returned or on a read error.
+ */
+char *igt_debugfs_file_next_line(struct igt_debugfs_file *file)
+{
+	char *line, *nl;
+
+	if (file->eof && file->line >= file->len) {
+		igt_debugfs_file_rewind(file);
+		return NULL;
+	}
+
+	for (;;) {
+		line = file->buf + file->line;
+		nl = file->len ? memchr(line, '\n', file->len - file->line) :
+				 NULL;
+		if (nl) {
+			*nl = '\0';
+			file->line = nl + 1 - file->buf;
+			return line;
+		}
+
+		if (file->eof) {
+			if (file->line >= file->len)
+				break;
+
+			file->line = file->len;
+			return line;
+		}
+
+		/* Keep only the partial line and read the following chunk */
+		if (file->line) {
+			memmove(file->buf, line, file->len - file->line);
+			file->len -= file->line;
+			file->line = 0;
+		}
+		debugfs_file_fill(file);
+	}
+
+	igt_debugfs_file_rewind(file);
+	return NULL;
+}
+
 /**
  * __igt_debugfs_read:
  * @fd: fd of the device
@@ -453,25 +636,23 @@ void __igt_debugfs_write(int fd, const char *filename, const char *buf, int size
  */
 bool igt_debugfs_search(int device, const char *filename, const char *substring)
 {
-	FILE *file;
-	size_t n = 0;
-	char *line = NULL;
+	struct igt_debugfs_file *file;
 	bool matched = false;
-	int fd;
+	char *line;
+	int dir;
 
-	fd = igt_debugfs_open(device, filename, O_RDONLY);
-	file = fdopen(fd, "r");
+	dir = igt_debugfs_dir(device);
+	file = igt_debugfs_file_open(dir, filename);
+	close(dir);
 	igt_assert(file);
 
-	while (getline(&line, &n, file) >= 0) {
+	while ((line = igt_debugfs_file_next_line(file))) {
 		matched = strstr(line, substring) != NULL;
 		if (matched)
 			break;
 	}
 
-	free(line);
-	fclose(file);
-	close(fd);
+	igt_debugfs_file_close(file);
 
 	return matched;
 }
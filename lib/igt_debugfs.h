@@ -46,6 +46,13 @@ void __igt_debugfs_write(int fd, const char *filename, const char *buf, int size
 int igt_debugfs_simple_read(int dir, const char *filename, char *buf, int size);
 bool igt_debugfs_search(int fd, const char *filename, const char *substring);
 
+struct igt_debugfs_file;
+struct igt_debugfs_file *igt_debugfs_file_open(int dir, const char *filename);
+void igt_debugfs_file_close(struct igt_debugfs_file *file);
+const char *igt_debugfs_file_read(struct igt_debugfs_file *file);
+void igt_debugfs_file_rewind(struct igt_debugfs_file *file);
+char *igt_debugfs_file_next_line(struct igt_debugfs_file *file);
+
 int igt_debugfs_gt_dir(int device, unsigned int gt);
 int igt_debugfs_gt_open(int device, unsigned int gt, const char *filename,
 			int mode);
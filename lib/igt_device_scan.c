@@ -36,6 +36,8 @@
 #ifdef __linux__
 #include <linux/limits.h>
 #endif
+#include <poll.h>
+#include <pthread.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/types.h>
@@ -207,8 +209,6 @@ enum dev_type {
 #define STR_INTEGRATED "integrated"
 #define STR_DISCRETE "discrete"
 
-static const char * const attrs[] = { "driver", "sriov_numvfs", "physfn" };
-
 static inline bool strequal(const char *a, const char *b)
 {
 	if (a == NULL || b == NULL)
@@ -259,6 +259,10 @@ static __thread struct {
 
 static void igt_device_free(struct igt_device *dev);
 
+/* udev events seen by igt_devices_cache_watch(), and when last scanned */
+static unsigned int cache_events;
+static unsigned int scanned_events;
+
 typedef char *(*devname_fn)(uint16_t, uint16_t);
 typedef enum dev_type (*devtype_fn)(uint16_t, uint16_t, const char *);
 
@@ -578,21 +582,47 @@ static void get_attrs_all(struct udev_device *dev, struct igt_device *idev)
 	}
 }
 
-static void get_attrs_limited(struct udev_device *dev, struct igt_device *idev)
+#define get_prop(dev, prop) ((char *) igt_map_search((dev)->props_map, prop))
+
+/*
+ * Sysattrs not loaded by a full scan are read when first looked up, so
+ * a scan only reads the driver link and the SR-IOV attributes are only
+ * read when a filter needs them.
+ */
+static char *get_attr(struct igt_device *dev, const char *attr)
 {
-	const char *value;
+	char *value = igt_map_search(dev->attrs_map, attr);
+	char path[PATH_MAX], buf[256];
+	struct stat st;
+	ssize_t len;
+	int fd;
 
-	for (int i = 0; i < ARRAY_SIZE(attrs); i++) {
-		value = udev_device_get_sysattr_value(dev, attrs[i]);
-		if (!value)
-			continue;
-		igt_device_add_attr(idev, attrs[i], value);
-		DBG("attr: %s, val: %s\n", attrs[i], value);
+	if (value || !dev->syspath)
+		return value;
+
+	snprintf(path, sizeof(path), "%s/%s", dev->syspath, attr);
+	if (lstat(path, &st))
+		return NULL;
+
+	if (S_ISLNK(st.st_mode)) {
+		igt_device_add_attr(dev, attr, NULL);
+	} else {
+		if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0)
+			return NULL;
+		len = read(fd, buf, sizeof(buf) - 1);
+		close(fd);
+		if (len < 0)
+			return NULL;
+
+		buf[len] = '\0';
+		buf[strcspn(buf, "\n")] = '\0';
+		igt_device_add_attr(dev, attr, buf);
 	}
+	DBG("lazy attr: %s\n", attr);
+
+	return igt_map_search(dev->attrs_map, attr);
 }
 
-#define get_prop(dev, prop) ((char *) igt_map_search((dev)->props_map, prop))
-#define get_attr(dev, attr) ((char *) igt_map_search((dev)->attrs_map, attr))
 #define get_prop_subsystem(dev) get_prop(dev, "SUBSYSTEM")
 #define is_drm_subsystem(dev)  (strequal(get_prop_subsystem(dev), "drm"))
 #define is_pci_subsystem(dev)  (strequal(get_prop_subsystem(dev), "pci"))
@@ -668,6 +698,26 @@ static char* strdup_nullsafe(const char* str)
 	return strdup(str);
 }
 
+/* Fills the fields derived from the properties of a PCI device */
+static bool set_pci_fields(struct igt_device *idev)
+{
+	uint16_t vendor, device;
+
+	if (!is_pci_subsystem(idev))
+		return true;
+
+	if (!set_vendor_device(idev) || !set_pci_slot_name(idev))
+		return false;
+
+	get_pci_vendor_device(idev, &vendor, &device);
+	idev->codename = __pci_codename(vendor, device);
+	idev->dev_type = __pci_devtype(vendor, device, idev->pci_slot_name);
+	idev->driver = strdup_nullsafe(get_attr(idev, "driver"));
+	igt_assert(idev->driver);
+
+	return true;
+}
+
 /* Create new igt_device from udev device.
  * Fills structure with most usable udev device variables, properties
  * and sysattrs.
@@ -689,21 +739,12 @@ static struct igt_device *igt_device_new_from_udev(struct udev_device *dev,
 		idev->drm_render = strdup(idev->devnode);
 
 	get_props(dev, idev);
-	limit_attrs ? get_attrs_limited(dev, idev) :
-		      get_attrs_all(dev, idev);
+	if (!limit_attrs)
+		get_attrs_all(dev, idev);
 
-	if (is_pci_subsystem(idev)) {
-		uint16_t vendor, device;
-
-		if (!set_vendor_device(idev) || !set_pci_slot_name(idev)) {
-			igt_device_free(idev);
-			return NULL;
-		}
-		get_pci_vendor_device(idev, &vendor, &device);
-		idev->codename = __pci_codename(vendor, device);
-		idev->dev_type = __pci_devtype(vendor, device, idev->pci_slot_name);
-		idev->driver = strdup_nullsafe(get_attr(idev, "driver"));
-		igt_assert(idev->driver);
+	if (!set_pci_fields(idev)) {
+		igt_device_free(idev);
+		return NULL;
 	}
 
 	return idev;
@@ -1030,6 +1071,19 @@ static void index_pci_devices(void)
 	}
 }
 
+static void finish_scan(void)
+{
+	struct igt_device *dev;
+
+	sort_all_devices();
+	index_pci_devices();
+
+	igt_list_for_each_entry(dev, &igt_devs.all, link) {
+		struct igt_device *dev_dup = duplicate_device(dev);
+		igt_list_add_tail(&dev_dup->link, &igt_devs.filtered);
+	}
+}
+
 /* Core scanning function.
  *
  * All scanned devices are kept inside igt_devs.all pointer array.
@@ -1046,9 +1100,10 @@ static void scan_drm_devices(bool limit_attrs)
 	struct udev *udev;
 	struct udev_enumerate *enumerate;
 	struct udev_list_entry *devices, *dev_list_entry;
-	struct igt_device *dev;
 	int ret;
 
+	scanned_events = cache_events;
+
 	udev = udev_new();
 	igt_assert(udev);
 
@@ -1085,13 +1140,7 @@ static void scan_drm_devices(bool limit_attrs)
 	udev_enumerate_unref(enumerate);
 	udev_unref(udev);
 
-	sort_all_devices();
-	index_pci_devices();
-
-	igt_list_for_each_entry(dev, &igt_devs.all, link) {
-		struct igt_device *dev_dup = duplicate_device(dev);
-		igt_list_add_tail(&dev_dup->link, &igt_devs.filtered);
-	}
+	finish_scan();
 }
 
 static void free_key_value(struct igt_map_entry *entry)
@@ -1133,6 +1182,264 @@ void igt_devices_free(void)
 	igt_devs.devs_scanned = false;
 }
 
+/*
+ * The device list can be cached in a file, see igt_devices_cache_save().
+ * Sysattrs aren't part of it, they're read lazily anyway. A cache listing
+ * a device which is no longer in sysfs is ignored as a whole.
+ */
+#define CACHE_MAGIC "igt-device-scan-cache 1"
+
+static void cache_write(FILE *f, const char *key, const char *value)
+{
+	if (value)
+		fprintf(f, "%s\t%s\n", key, value);
+}
+
+static bool write_cache(FILE *f)
+{
+	struct igt_map_entry *entry;
+	struct igt_device *dev;
+
+	fprintf(f, "%s\n", CACHE_MAGIC);
+
+	igt_list_for_each_entry(dev, &igt_devs.all, link) {
+		cache_write(f, "device", dev->syspath);
+		cache_write(f, "subsystem", dev->subsystem);
+		cache_write(f, "devnode", dev->devnode);
+		cache_write(f, "sysname", dev->sysname);
+		cache_write(f, "drm_card", dev->drm_card);
+		cache_write(f, "drm_render", dev->drm_render);
+		if (dev->parent)
+			cache_write(f, "parent", dev->parent->syspath);
+
+		igt_map_foreach(dev->props_map, entry)
+			fprintf(f, "prop\t%s=%s\n",
+				(char *)entry->key, (char *)entry->data);
+
+		fprintf(f, "end\n");
+	}
+
+	return !ferror(f);
+}
+
+static bool load_cache(const char *path)
+{
+	struct igt_device *dev = NULL, *parent;
+	char **parents = NULL;
+	size_t size = 0, count = 0, nparents = 0;
+	char *line = NULL;
+	bool ret = false;
+	ssize_t len;
+	FILE *f;
+
+	if ((f = fopen(path, "re")) == NULL)
+		return false;
+
+	if (getline(&line, &size, f) <= 0 ||
+	    strncmp(line, CACHE_MAGIC "\n", strlen(CACHE_MAGIC) + 1))
+		goto out;
+
+	while ((len = getline(&line, &size, f)) > 0) {
+		char *value;
+
+		if (line[len - 1] == '\n')
+			line[len - 1] = '\0';
+
+		if (!strcmp(line, "end")) {
+			/* A device gone from sysfs means the cache is stale */
+			if (!dev || !dev->syspath || !dev->subsystem ||
+			    access(dev->syspath, F_OK) ||
+			    !set_pci_fields(dev))
+				goto out;
+
+			igt_list_add_tail(&dev->link, &igt_devs.all);
+			dev = NULL;
+			count++;
+			continue;
+		}
+
+		if ((value = strchr(line, '\t')) == NULL)
+			goto out;
+		*value++ = '\0';
+
+		if (!strcmp(line, "device")) {
+			if (dev)
+				goto out;
+			dev = igt_device_new();
+			igt_assert(dev);
+			dev->syspath = strdup(value);
+			parents = realloc(parents, ++nparents * sizeof(*parents));
+			parents[count] = NULL;
+		} else if (!dev) {
+			goto out;
+		} else if (!strcmp(line, "subsystem")) {
+			dev->subsystem = strdup(value);
+		} else if (!strcmp(line, "devnode")) {
+			dev->devnode = strdup(value);
+		} else if (!strcmp(line, "sysname")) {
+			dev->sysname = strdup(value);
+		} else if (!strcmp(line, "drm_card")) {
+			dev->drm_card = strdup(value);
+		} else if (!strcmp(line, "drm_render")) {
+			dev->drm_render = strdup(value);
+		} else if (!strcmp(line, "parent")) {
+			parents[count] = strdup(value);
+		} else if (!strcmp(line, "prop")) {
+			char *eq = strchr(value, '=');
+
+			if (!eq)
+				goto out;
+			*eq++ = '\0';
+			igt_device_add_prop(dev, value, eq);
+		}
+	}
+
+	if (dev || !count)
+		goto out;
+
+	/* The devices are listed in the order of the cache */
+	count = 0;
+	igt_list_for_each_entry(parent, &igt_devs.all, link) {
+		const char *syspath = parents[count++];
+
+		if (!syspath)
+			continue;
+
+		parent->parent = igt_device_from_syspath(syspath);
+		if (!parent->parent)
+			goto out;
+	}
+
+	finish_scan();
+	ret = true;
+	DBG("Loaded %zu devices from %s\n", count, path);
+
+out:
+	if (dev) {
+		igt_device_free(dev);
+		free(dev);
+	}
+	for (size_t i = 0; i < nparents; i++)
+		free(parents[i]);
+	free(parents);
+	free(line);
+	fclose(f);
+
+	if (!ret)
+		igt_devices_free();
+
+	return ret;
+}
+
+/**
+ * igt_devices_cache_save:
+ * @path: file to write the cache to
+ *
+ * Writes the devices found by the last igt_devices_scan() to @path.
+ * Processes with IGT_DEVICE_SCAN_CACHE set to @path in their environment
+ * then load the device list from it instead of enumerating udev. If a
+ * device changed since the scan, as seen by igt_devices_cache_watch(),
+ * the cache is removed again.
+ *
+ * Returns: Whether the cache was written and is up to date.
+ */
+bool igt_devices_cache_save(const char *path)
+{
+	char tmp[PATH_MAX];
+	bool ret;
+	FILE *f;
+
+	if (!igt_devs.devs_scanned)
+		return false;
+
+	if (snprintf(tmp, sizeof(tmp), "%s.%d", path, getpid()) >= sizeof(tmp))
+		return false;
+
+	if ((f = fopen(tmp, "we")) == NULL)
+		return false;
+
+	ret = write_cache(f);
+	ret &= fclose(f) == 0;
+	if (ret)
+		ret = rename(tmp, path) == 0;
+	if (!ret) {
+		unlink(tmp);
+		return false;
+	}
+
+	if (__atomic_load_n(&cache_events, __ATOMIC_ACQUIRE) != scanned_events) {
+		unlink(path);
+		return false;
+	}
+
+	return true;
+}
+
+static void *cache_watch_thread(void *data)
+{
+	struct udev_monitor *mon = data;
+	const char *path = udev_get_userdata(udev_monitor_get_udev(mon));
+	struct pollfd pfd = {
+		.fd = udev_monitor_get_fd(mon),
+		.events = POLLIN,
+	};
+
+	while (poll(&pfd, 1, -1) >= 0) {
+		struct udev_device *dev = udev_monitor_receive_device(mon);
+
+		if (!dev)
+			continue;
+
+		DBG("udev %s %s, dropping %s\n", udev_device_get_action(dev),
+		    udev_device_get_syspath(dev), path);
+		__atomic_add_fetch(&cache_events, 1, __ATOMIC_RELEASE);
+		unlink(path);
+		udev_device_unref(dev);
+	}
+
+	return NULL;
+}
+
+/**
+ * igt_devices_cache_watch:
+ * @path: the cache file
+ *
+ * Starts a thread which removes the device cache at @path as soon as
+ * udev reports a change of a drm or pci device, so the following scans
+ * enumerate udev again. Call before igt_devices_scan() so no change goes
+ * unnoticed between the scan and igt_devices_cache_save().
+ *
+ * Returns: Whether the thread was started.
+ */
+bool igt_devices_cache_watch(const char *path)
+{
+	struct udev_monitor *mon;
+	struct udev *udev;
+	pthread_t thread;
+
+	udev = udev_new();
+	if (!udev)
+		return false;
+	udev_set_userdata(udev, strdup(path));
+
+	mon = udev_monitor_new_from_netlink(udev, "udev");
+	if (!mon ||
+	    udev_monitor_filter_add_match_subsystem_devtype(mon, "drm", NULL) ||
+	    udev_monitor_filter_add_match_subsystem_devtype(mon, "pci", NULL) ||
+	    udev_monitor_enable_receiving(mon) ||
+	    pthread_create(&thread, NULL, cache_watch_thread, mon)) {
+		if (mon)
+			udev_monitor_unref(mon);
+		free(udev_get_userdata(udev));
+		udev_unref(udev);
+		return false;
+	}
+
+	pthread_detach(thread);
+
+	return true;
+}
+
 /**
  * igt_devices_scan
  * @force: enforce scanning devices
@@ -1142,11 +1449,14 @@ void igt_devices_free(void)
 
 static void __igt_devices_scan(bool limit_attrs)
 {
+	const char *cache = getenv("IGT_DEVICE_SCAN_CACHE");
+
 	if (igt_devs.devs_scanned)
 		igt_devices_free();
 
 	prepare_scan();
-	scan_drm_devices(limit_attrs);
+	if (!limit_attrs || !cache || !load_cache(cache))
+		scan_drm_devices(limit_attrs);
 
 	igt_devs.devs_scanned = true;
 }
@@ -2167,6 +2477,37 @@ bool igt_device_find_card_by_sysname(const char *sysname,
 	return false;
 }
 
+/**
+ * igt_device_get_numa_node:
+ * @pci_slot_name: PCI slot name of the device, like "0000:03:00.0"
+ *
+ * Returns: The NUMA node the device is attached to, or -1 if it's not known
+ * or the system has no NUMA.
+ */
+int igt_device_get_numa_node(const char *pci_slot_name)
+{
+	char path[PATH_MAX], buf[16];
+	int fd, len, node = -1;
+
+	if (!pci_slot_name || !*pci_slot_name)
+		return -1;
+
+	snprintf(path, sizeof(path), "/sys/bus/pci/devices/%s/numa_node",
+		 pci_slot_name);
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+
+	len = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if (len > 0) {
+		buf[len] = '\0';
+		node = atoi(buf);
+	}
+
+	return node;
+}
+
 /**
  * igt_device_card_match_all
  * @filter: filter string.
@@ -66,6 +66,8 @@ struct igt_device_card {
 
 void igt_devices_scan(void);
 void igt_devices_scan_all_attrs(void);
+bool igt_devices_cache_save(const char *path);
+bool igt_devices_cache_watch(const char *path);
 
 void igt_devices_print(const struct igt_devices_print_format *fmt);
 void igt_devices_print_vendors(void);
@@ -96,6 +98,7 @@ bool igt_device_find_first_xe_discrete_card(struct igt_device_card *card);
 bool igt_device_find_xe_integrated_card(struct igt_device_card *card);
 bool igt_device_find_card_by_sysname(const char *sysname,
 				     struct igt_device_card *card);
+int igt_device_get_numa_node(const char *pci_slot_name);
 char *igt_device_get_pretty_name(struct igt_device_card *card, bool numeric);
 int igt_open_card(struct igt_device_card *card);
 int igt_open_render(struct igt_device_card *card);
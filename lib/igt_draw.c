@@ -22,6 +22,8 @@
  *
  */
 
+#include <limits.h>
+#include <string.h>
 #include <sys/mman.h>
 
 #include "igt_draw.h"
@@ -81,13 +83,6 @@ struct buf_data {
 	uint8_t pat_index;
 };
 
-struct rect {
-	int x;
-	int y;
-	int w;
-	int h;
-};
-
 /**
  * igt_draw_get_method_name:
  * @method: draw method
@@ -443,6 +438,67 @@ static void set_pixel(void *_ptr, int index, uint64_t color, int bpp)
 	}
 }
 
+static void set_pixels(void *_ptr, int index, int count, uint64_t color,
+		       int bpp)
+{
+	int i;
+
+	if (bpp == 8) {
+		memset((uint8_t *)_ptr + index, color, count);
+	} else if (bpp == 16) {
+		uint16_t *ptr = (uint16_t *)_ptr + index;
+		for (i = 0; i < count; i++)
+			ptr[i] = color;
+	} else if (bpp == 32) {
+		uint32_t *ptr = (uint32_t *)_ptr + index;
+		for (i = 0; i < count; i++)
+			ptr[i] = color;
+	} else if (bpp == 64) {
+		uint64_t *ptr = (uint64_t *)_ptr + index;
+		for (i = 0; i < count; i++)
+			ptr[i] = color;
+	} else {
+		igt_assert_f(false, "bpp: %d\n", bpp);
+	}
+}
+
+/*
+ * Returns the size in bytes of the runs of horizontally adjacent pixels that
+ * the tiling keeps contiguous in memory. Runs start at multiples of this size
+ * both in the tiled buffer and in the linear x coordinate.
+ */
+static int tiled_span_size(int fd, uint32_t tiling, int swizzle)
+{
+	const struct intel_device_info *info =
+		intel_get_device_info(intel_get_drm_devid(fd));
+	int span;
+
+	switch (tiling) {
+	case I915_TILING_X:
+		span = info->graphics_ver == 2 ? 128 : 512;
+		break;
+	case I915_TILING_Y:
+		if (info->graphics_ver == 2)
+			span = 8;
+		else if (info->is_grantsdale || info->is_alviso)
+			span = 32;
+		else
+			span = 16;
+		break;
+	case I915_TILING_4:
+		span = OW_SIZE;
+		break;
+	default:
+		igt_assert(false);
+	}
+
+	/* Bit 6 swizzling only ever moves whole 64 byte chunks around. */
+	if (swizzle != I915_BIT_6_SWIZZLE_NONE)
+		span = min(span, 64);
+
+	return span;
+}
+
 static void switch_blt_tiling(struct intel_bb *ibb, uint32_t tiling, bool on)
 {
 	uint32_t bcs_swctrl;
@@ -470,14 +526,13 @@ static void switch_blt_tiling(struct intel_bb *ibb, uint32_t tiling, bool on)
 }
 
 static void draw_rect_ptr_linear(void *ptr, uint32_t stride,
-				 struct rect *rect, uint64_t color, int bpp)
+				 const struct igt_draw_rect_desc *rect, int bpp)
 {
-	int x, y, line_begin;
+	int y, line_begin;
 
 	for (y = rect->y; y < rect->y + rect->h; y++) {
 		line_begin = y * stride / (bpp / 8);
-		for (x = rect->x; x < rect->x + rect->w; x++)
-			set_pixel(ptr, line_begin + x, color, bpp);
+		set_pixels(ptr, line_begin + rect->x, rect->w, rect->color, bpp);
 	}
 }
 
@@ -510,23 +565,50 @@ static linear_x_y_to_tiled_pos_fn linear_to_tiled_fn(int fd, uint32_t tiling)
 }
 
 static void draw_rect_ptr_tiled(int fd, void *ptr, uint32_t stride, uint32_t tiling,
-				int swizzle, struct rect *rect, uint64_t color,
+				int swizzle, const struct igt_draw_rect_desc *rect,
 				int bpp)
 {
 	linear_x_y_to_tiled_pos_fn linear_x_y_to_tiled_pos =
 		linear_to_tiled_fn(fd, tiling);
-	int x, y, pos;
+	int span = tiled_span_size(fd, tiling, swizzle) / (bpp / 8);
+	int x, y, n, pos;
 
+	/* Only look up the tiled position once per contiguous span. */
 	for (y = rect->y; y < rect->y + rect->h; y++) {
-		for (x = rect->x; x < rect->x + rect->w; x++) {
+		for (x = rect->x; x < rect->x + rect->w; x += n) {
+			n = min(span - x % span, rect->x + rect->w - x);
 			pos = linear_x_y_to_tiled_pos(x, y, stride, swizzle, bpp);
-			set_pixel(ptr, pos, color, bpp);
+			set_pixels(ptr, pos, n, rect->color, bpp);
 		}
 	}
 }
 
-static void draw_rect_mmap_cpu(int fd, struct buf_data *buf, struct rect *rect,
-			       uint32_t tiling, uint32_t swizzle, uint64_t color)
+static void draw_rects_ptr(int fd, void *ptr, struct buf_data *buf,
+			   const struct igt_draw_rect_desc *rects, int num_rects,
+			   uint32_t tiling, uint32_t swizzle)
+{
+	for (int i = 0; i < num_rects; i++) {
+		switch (tiling) {
+		case I915_TILING_NONE:
+			draw_rect_ptr_linear(ptr, buf->stride, &rects[i],
+					     buf->bpp);
+			break;
+		case I915_TILING_X:
+		case I915_TILING_Y:
+		case I915_TILING_4:
+			draw_rect_ptr_tiled(fd, ptr, buf->stride, tiling, swizzle,
+					    &rects[i], buf->bpp);
+			break;
+		default:
+			igt_assert(false);
+			break;
+		}
+	}
+}
+
+static void draw_rect_mmap_cpu(int fd, struct buf_data *buf,
+			       const struct igt_draw_rect_desc *rects,
+			       int num_rects, uint32_t tiling, uint32_t swizzle)
 {
 	void *ptr;
 
@@ -536,28 +618,16 @@ static void draw_rect_mmap_cpu(int fd, struct buf_data *buf, struct rect *rect,
 	ptr = gem_mmap__cpu_coherent(fd, buf->handle, 0, PAGE_ALIGN(buf->size),
 				     PROT_READ | PROT_WRITE);
 
-	switch (tiling) {
-	case I915_TILING_NONE:
-		draw_rect_ptr_linear(ptr, buf->stride, rect, color, buf->bpp);
-		break;
-	case I915_TILING_X:
-	case I915_TILING_Y:
-	case I915_TILING_4:
-		draw_rect_ptr_tiled(fd, ptr, buf->stride, tiling, swizzle, rect,
-				    color, buf->bpp);
-		break;
-	default:
-		igt_assert(false);
-		break;
-	}
+	draw_rects_ptr(fd, ptr, buf, rects, num_rects, tiling, swizzle);
 
 	gem_sw_finish(fd, buf->handle);
 
 	igt_assert(gem_munmap(ptr, buf->size) == 0);
 }
 
-static void draw_rect_mmap_gtt(int fd, struct buf_data *buf, struct rect *rect,
-			       uint64_t color)
+static void draw_rect_mmap_gtt(int fd, struct buf_data *buf,
+			       const struct igt_draw_rect_desc *rects,
+			       int num_rects)
 {
 	void *ptr;
 
@@ -567,13 +637,15 @@ static void draw_rect_mmap_gtt(int fd, struct buf_data *buf, struct rect *rect,
 	ptr = gem_mmap__gtt(fd, buf->handle, PAGE_ALIGN(buf->size),
 			    PROT_READ | PROT_WRITE);
 
-	draw_rect_ptr_linear(ptr, buf->stride, rect, color, buf->bpp);
+	for (int i = 0; i < num_rects; i++)
+		draw_rect_ptr_linear(ptr, buf->stride, &rects[i], buf->bpp);
 
 	igt_assert(gem_munmap(ptr, buf->size) == 0);
 }
 
-static void draw_rect_mmap_wc(int fd, struct buf_data *buf, struct rect *rect,
-			      uint32_t tiling, uint32_t swizzle, uint64_t color)
+static void draw_rect_mmap_wc(int fd, struct buf_data *buf,
+			      const struct igt_draw_rect_desc *rects,
+			      int num_rects, uint32_t tiling, uint32_t swizzle)
 {
 	void *ptr;
 
@@ -597,38 +669,43 @@ static void draw_rect_mmap_wc(int fd, struct buf_data *buf, struct rect *rect,
 				     PROT_READ | PROT_WRITE);
 	}
 
-	switch (tiling) {
-	case I915_TILING_NONE:
-		draw_rect_ptr_linear(ptr, buf->stride, rect, color, buf->bpp);
-		break;
-	case I915_TILING_X:
-	case I915_TILING_Y:
-	case I915_TILING_4:
-		draw_rect_ptr_tiled(fd, ptr, buf->stride, tiling, swizzle, rect,
-				    color, buf->bpp);
-		break;
-	default:
-		igt_assert(false);
-		break;
-	}
+	draw_rects_ptr(fd, ptr, buf, rects, num_rects, tiling, swizzle);
 
 	igt_assert(gem_munmap(ptr, buf->size) == 0);
 }
 
+#define PWRITE_CHUNK_SIZE (64 * 1024)
+
 static void draw_rect_pwrite_untiled(int fd, struct buf_data *buf,
-				     struct rect *rect, uint64_t color)
+				     const struct igt_draw_rect_desc *rect)
 {
-	int i, y, offset;
+	int i, y, rows;
 	int pixel_size = buf->bpp / 8;
-	uint8_t tmp[rect->w * pixel_size];
+	int row_size = rect->w * pixel_size;
+	uint64_t offset;
+	uint8_t *tmp;
+
+	/* Rectangles spanning the whole stride are contiguous in memory, so
+	 * write as many rows as fit in one chunk with a single pwrite. */
+	if (rect->x == 0 && row_size == buf->stride)
+		rows = max(1, min(rect->h, PWRITE_CHUNK_SIZE / row_size));
+	else
+		rows = 1;
 
-	for (i = 0; i < rect->w; i++)
-		set_pixel(tmp, i, color, buf->bpp);
+	tmp = malloc(row_size * rows);
+	igt_assert(tmp);
 
-	for (y = rect->y; y < rect->y + rect->h; y++) {
-		offset = (y * buf->stride) + (rect->x * pixel_size);
-		gem_write(fd, buf->handle, offset, tmp, rect->w * pixel_size);
+	for (i = 0; i < rect->w * rows; i++)
+		set_pixel(tmp, i, rect->color, buf->bpp);
+
+	for (y = rect->y; y < rect->y + rect->h; y += rows) {
+		int n = min(rows, rect->y + rect->h - y);
+
+		offset = ((uint64_t)y * buf->stride) + (rect->x * pixel_size);
+		gem_write(fd, buf->handle, offset, tmp, (uint64_t)row_size * n);
 	}
+
+	free(tmp);
 }
 
 typedef void (*tiled_pos_to_x_y_linear_fn)(int tiled_pos, uint32_t stride,
@@ -659,14 +736,31 @@ static tiled_pos_to_x_y_linear_fn tiled_to_linear_fn(int fd, uint32_t tiling)
 	}
 }
 
+static const struct igt_draw_rect_desc *
+find_rect(const struct igt_draw_rect_desc *rects, int num_rects, int x, int y)
+{
+	/* Later rectangles are drawn on top of earlier ones. */
+	for (int i = num_rects - 1; i >= 0; i--) {
+		const struct igt_draw_rect_desc *rect = &rects[i];
+
+		if (x >= rect->x && x < rect->x + rect->w &&
+		    y >= rect->y && y < rect->y + rect->h)
+			return rect;
+	}
+
+	return NULL;
+}
+
 static void draw_rect_pwrite_tiled(int fd, struct buf_data *buf,
-				   uint32_t tiling, struct rect *rect,
-				   uint64_t color, uint32_t swizzle)
+				   uint32_t tiling,
+				   const struct igt_draw_rect_desc *rects,
+				   int num_rects, uint32_t swizzle)
 {
 	tiled_pos_to_x_y_linear_fn tiled_pos_to_x_y_linear =
 		tiled_to_linear_fn(fd, tiling);
-	int i;
-	int tiled_pos, x, y, pixel_size;
+	const struct igt_draw_rect_desc *rect;
+	int span_pos, tiled_pos, x, y, pixel_size, span_size, i;
+	int min_x = INT_MAX, min_y = INT_MAX, max_x = 0, max_y = 0;
 	uint8_t tmp[4096];
 	int tmp_used = 0, tmp_size;
 	bool flush_tmp = false;
@@ -675,52 +769,78 @@ static void draw_rect_pwrite_tiled(int fd, struct buf_data *buf,
 
 	pixel_size = buf->bpp / 8;
 	tmp_size = sizeof(tmp) / pixel_size;
+	span_size = tiled_span_size(fd, tiling, swizzle);
+
+	for (i = 0; i < num_rects; i++) {
+		min_x = min(min_x, rects[i].x);
+		min_y = min(min_y, rects[i].y);
+		max_x = max(max_x, rects[i].x + rects[i].w);
+		max_y = max(max_y, rects[i].y + rects[i].h);
+	}
 
 	/* Instead of doing one pwrite per pixel, we try to group the maximum
 	 * amount of consecutive pixels we can in a single pwrite: that's why we
-	 * use the "tmp" variables. */
-	for (i = 0; i < tmp_size; i++)
-		set_pixel(tmp, i, color, buf->bpp);
-
-	for (tiled_pos = 0; tiled_pos < buf->size; tiled_pos += pixel_size) {
-		tiled_pos_to_x_y_linear(tiled_pos, buf->stride,
+	 * use the "tmp" variables. All the rectangles are handled in the same
+	 * pass over the buffer, so neighbouring rectangles also share pwrites.
+	 *
+	 * Each span of the tiling holds consecutive pixels of a single row, so
+	 * we only need to untile its first pixel, and can skip the spans that
+	 * don't touch any rectangle at all. */
+	for (span_pos = 0; span_pos < buf->size; span_pos += span_size) {
+		tiled_pos_to_x_y_linear(span_pos, buf->stride,
 					swizzle, buf->bpp, &x, &y);
 
-		if (x >= rect->x && x < rect->x + rect->w &&
-		    y >= rect->y && y < rect->y + rect->h) {
-			if (tmp_used == 0)
-				tmp_start_pos = tiled_pos;
-			tmp_used++;
-		} else {
-			flush_tmp = true;
-		}
-
-		if (tmp_used == tmp_size || (flush_tmp && tmp_used > 0) ||
-		    tiled_pos + pixel_size >= buf->size) {
-			gem_write(fd, buf->handle, tmp_start_pos, tmp,
-				  tmp_used * pixel_size);
-			flush_tmp = false;
-			pixels_written += tmp_used;
-			tmp_used = 0;
-
-			if (pixels_written == rect->w * rect->h)
+		for (i = 0; i < span_size / pixel_size; i++) {
+			tiled_pos = span_pos + i * pixel_size;
+			if (tiled_pos >= buf->size)
 				break;
+
+			if (y >= min_y && y < max_y &&
+			    x + i >= min_x && x + i < max_x)
+				rect = find_rect(rects, num_rects, x + i, y);
+			else
+				rect = NULL;
+
+			if (rect) {
+				if (tmp_used == 0)
+					tmp_start_pos = tiled_pos;
+				set_pixel(tmp, tmp_used, rect->color, buf->bpp);
+				tmp_used++;
+			} else {
+				flush_tmp = true;
+			}
+
+			if (tmp_used == tmp_size || (flush_tmp && tmp_used > 0) ||
+			    tiled_pos + pixel_size >= buf->size) {
+				if (tmp_used)
+					gem_write(fd, buf->handle, tmp_start_pos, tmp,
+						  tmp_used * pixel_size);
+				flush_tmp = false;
+				pixels_written += tmp_used;
+				tmp_used = 0;
+
+				if (num_rects == 1 &&
+				    pixels_written == rects[0].w * rects[0].h)
+					return;
+			}
 		}
 	}
 }
 
 static void draw_rect_pwrite(int fd, struct buf_data *buf,
-			     struct rect *rect, uint32_t tiling,
-			     uint32_t swizzle, uint64_t color)
+			     const struct igt_draw_rect_desc *rects,
+			     int num_rects, uint32_t tiling, uint32_t swizzle)
 {
 	switch (tiling) {
 	case I915_TILING_NONE:
-		draw_rect_pwrite_untiled(fd, buf, rect, color);
+		for (int i = 0; i < num_rects; i++)
+			draw_rect_pwrite_untiled(fd, buf, &rects[i]);
 		break;
 	case I915_TILING_X:
 	case I915_TILING_Y:
 	case I915_TILING_4:
-		draw_rect_pwrite_tiled(fd, buf, tiling, rect, color, swizzle);
+		draw_rect_pwrite_tiled(fd, buf, tiling, rects, num_rects,
+				       swizzle);
 		break;
 	default:
 		igt_assert(false);
@@ -759,9 +879,15 @@ static struct intel_buf *create_buf(int fd, struct buf_ops *bops,
 	return buf;
 }
 
+/* Worst case is XY_PAT_BLT: header, reloc and an 8x8 64bpp pattern. */
+#define BLT_RECT_MAX_DWORDS (6 + 8 * 8)
+/* Two tiling switches plus the batch buffer end. */
+#define BLT_BATCH_EXTRA_DWORDS (8 * 2 + 2)
+
 static void draw_rect_blt(int fd, struct cmd_data *cmd_data,
-			  struct buf_data *buf, struct rect *rect,
-			  uint32_t tiling, uint64_t color)
+			  struct buf_data *buf,
+			  const struct igt_draw_rect_desc *rects, int num_rects,
+			  uint32_t tiling)
 {
 	struct intel_bb *ibb;
 	struct intel_buf *dst;
@@ -772,7 +898,8 @@ static void draw_rect_blt(int fd, struct cmd_data *cmd_data,
 	uint32_t mocs;
 
 	dst = create_buf(fd, cmd_data->bops, buf, tiling);
-	ibb = intel_bb_create(fd, PAGE_SIZE);
+	ibb = intel_bb_create(fd, PAGE_ALIGN((num_rects * BLT_RECT_MAX_DWORDS +
+					      BLT_BATCH_EXTRA_DWORDS) * 4));
 	intel_bb_add_intel_buf(ibb, dst, true);
 
 	if (HAS_4TILE(intel_get_drm_devid(fd))) {
@@ -816,27 +943,28 @@ static void draw_rect_blt(int fd, struct cmd_data *cmd_data,
 		else
 			mocs = dst->mocs_index << XY_FAST_COLOR_BLT_MOCS_INDEX_SHIFT;
 
-		intel_bb_out(ibb, XY_FAST_COLOR_BLT | blt_cmd_depth);
-		intel_bb_out(ibb, blt_cmd_tiling | mocs | (pitch-1));
-		intel_bb_out(ibb, (rect->y << 16) | rect->x);
-		intel_bb_out(ibb, ((rect->y + rect->h) << 16) | (rect->x + rect->w));
-		intel_bb_emit_reloc_fenced(ibb, dst->handle, 0,
-					   I915_GEM_DOMAIN_RENDER, 0,
-					   dst->addr.offset);
-		intel_bb_out(ibb, 0);	/* TODO: Pass down enough info for target memory hint */
-		intel_bb_out(ibb, color);
-		intel_bb_out(ibb, color >> 32);	/* 64 bit color */
-		intel_bb_out(ibb, 0);	/* 96 bit color */
-		intel_bb_out(ibb, 0);	/* 128 bit color */
-		intel_bb_out(ibb, 0);	/* clear address */
-		intel_bb_out(ibb, 0);	/* clear address */
-		intel_bb_out(ibb, (1 << 29) | ((pitch-1) << 14) | (buf_height-1));
-		intel_bb_out(ibb, 0);	/* mipmap levels / qpitch */
-		intel_bb_out(ibb, 0);	/* mipmap index / alignment */
+		for (int i = 0; i < num_rects; i++) {
+			const struct igt_draw_rect_desc *rect = &rects[i];
+
+			intel_bb_out(ibb, XY_FAST_COLOR_BLT | blt_cmd_depth);
+			intel_bb_out(ibb, blt_cmd_tiling | mocs | (pitch-1));
+			intel_bb_out(ibb, (rect->y << 16) | rect->x);
+			intel_bb_out(ibb, ((rect->y + rect->h) << 16) | (rect->x + rect->w));
+			intel_bb_emit_reloc_fenced(ibb, dst->handle, 0,
+						   I915_GEM_DOMAIN_RENDER, 0,
+						   dst->addr.offset);
+			intel_bb_out(ibb, 0);	/* TODO: Pass down enough info for target memory hint */
+			intel_bb_out(ibb, rect->color);
+			intel_bb_out(ibb, rect->color >> 32);	/* 64 bit color */
+			intel_bb_out(ibb, 0);	/* 96 bit color */
+			intel_bb_out(ibb, 0);	/* 128 bit color */
+			intel_bb_out(ibb, 0);	/* clear address */
+			intel_bb_out(ibb, 0);	/* clear address */
+			intel_bb_out(ibb, (1 << 29) | ((pitch-1) << 14) | (buf_height-1));
+			intel_bb_out(ibb, 0);	/* mipmap levels / qpitch */
+			intel_bb_out(ibb, 0);	/* mipmap index / alignment */
+		}
 	} else if (buf->bpp == 64) {
-		int x = rect->x * 2;
-		int w = rect->w * 2;
-
 		blt_cmd_depth = 3 << 24; /* 32bpp */
 		blt_cmd_len = ((ver >= 8) ?  0x4 : 0x3) + 8*8;
 		blt_cmd_tiling = (tiling) ? XY_COLOR_BLT_TILED : 0;
@@ -844,16 +972,22 @@ static void draw_rect_blt(int fd, struct cmd_data *cmd_data,
 
 		switch_blt_tiling(ibb, tiling, true);
 
-		intel_bb_out(ibb, XY_PAT_BLT_IMMEDIATE_CMD_NOLEN | XY_COLOR_BLT_WRITE_ALPHA |
-			     XY_COLOR_BLT_WRITE_RGB | blt_cmd_tiling | blt_cmd_len);
-		intel_bb_out(ibb, blt_cmd_depth | (0xF0 << 16) | pitch);
-		intel_bb_out(ibb, (rect->y << 16) | x);
-		intel_bb_out(ibb, ((rect->y + rect->h) << 16) | (x + w));
-		intel_bb_emit_reloc_fenced(ibb, dst->handle, 0, I915_GEM_DOMAIN_RENDER,
-					   0, dst->addr.offset);
-		for (int i = 0; i < 8*8; i += 2) {
-			intel_bb_out(ibb, color);
-			intel_bb_out(ibb, color >> 32);
+		for (int i = 0; i < num_rects; i++) {
+			const struct igt_draw_rect_desc *rect = &rects[i];
+			int x = rect->x * 2;
+			int w = rect->w * 2;
+
+			intel_bb_out(ibb, XY_PAT_BLT_IMMEDIATE_CMD_NOLEN | XY_COLOR_BLT_WRITE_ALPHA |
+				     XY_COLOR_BLT_WRITE_RGB | blt_cmd_tiling | blt_cmd_len);
+			intel_bb_out(ibb, blt_cmd_depth | (0xF0 << 16) | pitch);
+			intel_bb_out(ibb, (rect->y << 16) | x);
+			intel_bb_out(ibb, ((rect->y + rect->h) << 16) | (x + w));
+			intel_bb_emit_reloc_fenced(ibb, dst->handle, 0, I915_GEM_DOMAIN_RENDER,
+						   0, dst->addr.offset);
+			for (int j = 0; j < 8*8; j += 2) {
+				intel_bb_out(ibb, rect->color);
+				intel_bb_out(ibb, rect->color >> 32);
+			}
 		}
 
 		switch_blt_tiling(ibb, tiling, false);
@@ -878,14 +1012,18 @@ static void draw_rect_blt(int fd, struct cmd_data *cmd_data,
 
 		switch_blt_tiling(ibb, tiling, true);
 
-		intel_bb_out(ibb, XY_COLOR_BLT_CMD_NOLEN | XY_COLOR_BLT_WRITE_ALPHA |
-			     XY_COLOR_BLT_WRITE_RGB | blt_cmd_tiling | blt_cmd_len);
-		intel_bb_out(ibb, blt_cmd_depth | (0xF0 << 16) | pitch);
-		intel_bb_out(ibb, (rect->y << 16) | rect->x);
-		intel_bb_out(ibb, ((rect->y + rect->h) << 16) | (rect->x + rect->w));
-		intel_bb_emit_reloc_fenced(ibb, dst->handle, 0, I915_GEM_DOMAIN_RENDER,
-					   0, dst->addr.offset);
-		intel_bb_out(ibb, color);
+		for (int i = 0; i < num_rects; i++) {
+			const struct igt_draw_rect_desc *rect = &rects[i];
+
+			intel_bb_out(ibb, XY_COLOR_BLT_CMD_NOLEN | XY_COLOR_BLT_WRITE_ALPHA |
+				     XY_COLOR_BLT_WRITE_RGB | blt_cmd_tiling | blt_cmd_len);
+			intel_bb_out(ibb, blt_cmd_depth | (0xF0 << 16) | pitch);
+			intel_bb_out(ibb, (rect->y << 16) | rect->x);
+			intel_bb_out(ibb, ((rect->y + rect->h) << 16) | (rect->x + rect->w));
+			intel_bb_emit_reloc_fenced(ibb, dst->handle, 0, I915_GEM_DOMAIN_RENDER,
+						   0, dst->addr.offset);
+			intel_bb_out(ibb, rect->color);
+		}
 
 		switch_blt_tiling(ibb, tiling, false);
 	}
@@ -895,55 +1033,91 @@ static void draw_rect_blt(int fd, struct cmd_data *cmd_data,
 	intel_buf_destroy(dst);
 }
 
+/* Keep the stacked source buffer within the render engine surface limits. */
+#define RENDER_TMP_MAX_HEIGHT 8192
+
 static void draw_rect_render(int fd, struct cmd_data *cmd_data,
-			     struct buf_data *buf, struct rect *rect,
-			     uint32_t tiling, uint64_t color)
+			     struct buf_data *buf,
+			     const struct igt_draw_rect_desc *rects,
+			     int num_rects, uint32_t tiling)
 {
 	struct intel_buf *src, *dst;
 	igt_render_copyfunc_t rendercopy = igt_get_render_copyfunc(fd);
+	struct igt_draw_rect_desc *tmp_rects;
 	struct intel_bb *ibb;
 	struct buf_data tmp;
 	int pixel_size = buf->bpp / 8;
+	int i, first, tmp_w, tmp_h;
 
 	igt_skip_on(!rendercopy);
 
-	/* We create a temporary buffer and copy from it using rendercopy. */
-	tmp.pat_index = buf->pat_index;
-	tmp.size = rect->w * rect->h * pixel_size;
-	if (is_i915_device(fd))
-		tmp.handle = gem_create(fd, tmp.size);
-	else
-		tmp.handle = xe_bo_create(fd, 0,
-					  ALIGN(tmp.size, xe_get_default_alignment(fd)),
-					  vram_if_possible(fd, 0),
-					  DRM_XE_GEM_CREATE_FLAG_NEEDS_VISIBLE_VRAM |
-					  DRM_XE_GEM_CREATE_FLAG_SCANOUT);
-
-	tmp.stride = rect->w * pixel_size;
-	tmp.bpp = buf->bpp;
-	tmp.width = rect->w;
-	tmp.height = rect->h;
-	if (is_i915_device(fd))
-		draw_rect_mmap_cpu(fd, &tmp, &(struct rect){0, 0, rect->w, rect->h},
-				   I915_TILING_NONE, I915_BIT_6_SWIZZLE_NONE, color);
-	else
-		draw_rect_mmap_wc(fd, &tmp, &(struct rect){0, 0, rect->w, rect->h},
-				  I915_TILING_NONE, I915_BIT_6_SWIZZLE_NONE, color);
+	tmp_rects = malloc(num_rects * sizeof(*tmp_rects));
+	igt_assert(tmp_rects);
 
-	src = create_buf(fd, cmd_data->bops, &tmp, I915_TILING_NONE);
 	dst = create_buf(fd, cmd_data->bops, buf, tiling);
 	ibb = intel_bb_create_with_context(fd, cmd_data->ctx, 0, NULL, PAGE_SIZE);
 
-	rendercopy(ibb, src, 0, 0, rect->w, rect->h, dst, rect->x, rect->y);
+	/* We create a temporary buffer with as many rectangles as fit stacked
+	 * on top of each other and copy from it using rendercopy. */
+	for (first = 0; first < num_rects; first = i) {
+		tmp_w = 0;
+		tmp_h = 0;
+		for (i = first; i < num_rects; i++) {
+			if (i > first &&
+			    tmp_h + rects[i].h > RENDER_TMP_MAX_HEIGHT)
+				break;
+
+			tmp_rects[i] = (struct igt_draw_rect_desc) {
+				.x = 0,
+				.y = tmp_h,
+				.w = rects[i].w,
+				.h = rects[i].h,
+				.color = rects[i].color,
+			};
+			tmp_w = max(tmp_w, rects[i].w);
+			tmp_h += rects[i].h;
+		}
+
+		tmp.pat_index = buf->pat_index;
+		tmp.size = tmp_w * tmp_h * pixel_size;
+		if (is_i915_device(fd))
+			tmp.handle = gem_create(fd, tmp.size);
+		else
+			tmp.handle = xe_bo_create(fd, 0,
+						  ALIGN(tmp.size, xe_get_default_alignment(fd)),
+						  vram_if_possible(fd, 0),
+						  DRM_XE_GEM_CREATE_FLAG_NEEDS_VISIBLE_VRAM |
+						  DRM_XE_GEM_CREATE_FLAG_SCANOUT);
+
+		tmp.stride = tmp_w * pixel_size;
+		tmp.bpp = buf->bpp;
+		tmp.width = tmp_w;
+		tmp.height = tmp_h;
+		if (is_i915_device(fd))
+			draw_rect_mmap_cpu(fd, &tmp, &tmp_rects[first], i - first,
+					   I915_TILING_NONE, I915_BIT_6_SWIZZLE_NONE);
+		else
+			draw_rect_mmap_wc(fd, &tmp, &tmp_rects[first], i - first,
+					  I915_TILING_NONE, I915_BIT_6_SWIZZLE_NONE);
+
+		src = create_buf(fd, cmd_data->bops, &tmp, I915_TILING_NONE);
+
+		for (int j = first; j < i; j++)
+			rendercopy(ibb, src, 0, tmp_rects[j].y,
+				   rects[j].w, rects[j].h,
+				   dst, rects[j].x, rects[j].y);
+
+		intel_buf_destroy(src);
+		gem_close(fd, tmp.handle);
+	}
 
 	intel_bb_destroy(ibb);
-	intel_buf_destroy(src);
 	intel_buf_destroy(dst);
-	gem_close(fd, tmp.handle);
+	free(tmp_rects);
 }
 
 /**
- * igt_draw_rect:
+ * igt_draw_rects:
  * @fd: the DRM file descriptor
  * @bops: buf ops, only required for IGT_DRAW_BLT and IGT_DRAW_RENDER
  * @ctx: the context, can be 0 if you don't want to think about it
@@ -954,22 +1128,26 @@ static void draw_rect_render(int fd, struct cmd_data *cmd_data,
  * @buf_height: the height of the buffer
  * @tiling: the tiling of the buffer
  * @method: method you're going to use to write to the buffer
- * @rect_x: horizontal position on the buffer where your rectangle starts
- * @rect_y: vertical position on the buffer where your rectangle starts
- * @rect_w: width of the rectangle
- * @rect_h: height of the rectangle
- * @color: color of the rectangle
+ * @rects: the rectangles to draw, each with its own color
+ * @num_rects: the number of entries in @rects
  * @bpp: bits per pixel
  *
- * This function draws a colored rectangle on the destination buffer, allowing
- * you to specify the method used to draw the rectangle.
+ * This function draws a list of colored rectangles on the destination buffer,
+ * in order, so later rectangles end up on top of earlier ones. The buffer is
+ * only mapped once for the CPU methods, and IGT_DRAW_BLT emits all the
+ * rectangles into a single batch, which makes this a lot cheaper than calling
+ * igt_draw_rect() in a loop.
+ *
+ * Like igt_draw_rect(), the GPU methods don't wait for the batch to complete:
+ * the kernel's implicit synchronization takes care of ordering against later
+ * CPU access and scanout.
  */
-void igt_draw_rect(int fd, struct buf_ops *bops, uint32_t ctx,
-		   uint32_t buf_handle, uint32_t buf_size, uint32_t buf_stride,
-		   int buf_width, int buf_height,
-		   uint32_t tiling, enum igt_draw_method method,
-		   int rect_x, int rect_y, int rect_w, int rect_h,
-		   uint64_t color, int bpp)
+void igt_draw_rects(int fd, struct buf_ops *bops, uint32_t ctx,
+		    uint32_t buf_handle, uint32_t buf_size, uint32_t buf_stride,
+		    int buf_width, int buf_height,
+		    uint32_t tiling, enum igt_draw_method method,
+		    const struct igt_draw_rect_desc *rects, int num_rects,
+		    int bpp)
 {
 	uint32_t buf_tiling, swizzle;
 
@@ -986,12 +1164,10 @@ void igt_draw_rect(int fd, struct buf_ops *bops, uint32_t ctx,
 		.bpp = bpp,
 		.pat_index = intel_get_pat_idx_uc(fd),
 	};
-	struct rect rect = {
-		.x = rect_x,
-		.y = rect_y,
-		.w = rect_w,
-		.h = rect_h,
-	};
+
+	igt_assert(num_rects >= 0);
+	if (!num_rects)
+		return;
 
 	swizzle = I915_BIT_6_SWIZZLE_NONE;
 	if (is_i915_device(fd) && tiling != I915_TILING_NONE && gem_available_fences(fd)) {
@@ -1001,22 +1177,22 @@ void igt_draw_rect(int fd, struct buf_ops *bops, uint32_t ctx,
 
 	switch (method) {
 	case IGT_DRAW_MMAP_CPU:
-		draw_rect_mmap_cpu(fd, &buf, &rect, tiling, swizzle, color);
+		draw_rect_mmap_cpu(fd, &buf, rects, num_rects, tiling, swizzle);
 		break;
 	case IGT_DRAW_MMAP_GTT:
-		draw_rect_mmap_gtt(fd, &buf, &rect, color);
+		draw_rect_mmap_gtt(fd, &buf, rects, num_rects);
 		break;
 	case IGT_DRAW_MMAP_WC:
-		draw_rect_mmap_wc(fd, &buf, &rect, tiling, swizzle, color);
+		draw_rect_mmap_wc(fd, &buf, rects, num_rects, tiling, swizzle);
 		break;
 	case IGT_DRAW_PWRITE:
-		draw_rect_pwrite(fd, &buf, &rect, tiling, swizzle, color);
+		draw_rect_pwrite(fd, &buf, rects, num_rects, tiling, swizzle);
 		break;
 	case IGT_DRAW_BLT:
-		draw_rect_blt(fd, &cmd_data, &buf, &rect, tiling, color);
+		draw_rect_blt(fd, &cmd_data, &buf, rects, num_rects, tiling);
 		break;
 	case IGT_DRAW_RENDER:
-		draw_rect_render(fd, &cmd_data, &buf, &rect, tiling, color);
+		draw_rect_render(fd, &cmd_data, &buf, rects, num_rects, tiling);
 		break;
 	default:
 		igt_assert(false);
@@ -1024,6 +1200,47 @@ void igt_draw_rect(int fd, struct buf_ops *bops, uint32_t ctx,
 	}
 }
 
+/**
+ * igt_draw_rect:
+ * @fd: the DRM file descriptor
+ * @bops: buf ops, only required for IGT_DRAW_BLT and IGT_DRAW_RENDER
+ * @ctx: the context, can be 0 if you don't want to think about it
+ * @buf_handle: the handle of the buffer where you're going to draw to
+ * @buf_size: the size of the buffer
+ * @buf_stride: the stride of the buffer
+ * @buf_width: the width of the buffer
+ * @buf_height: the height of the buffer
+ * @tiling: the tiling of the buffer
+ * @method: method you're going to use to write to the buffer
+ * @rect_x: horizontal position on the buffer where your rectangle starts
+ * @rect_y: vertical position on the buffer where your rectangle starts
+ * @rect_w: width of the rectangle
+ * @rect_h: height of the rectangle
+ * @color: color of the rectangle
+ * @bpp: bits per pixel
+ *
+ * This function draws a colored rectangle on the destination buffer, allowing
+ * you to specify the method used to draw the rectangle.
+ */
+void igt_draw_rect(int fd, struct buf_ops *bops, uint32_t ctx,
+		   uint32_t buf_handle, uint32_t buf_size, uint32_t buf_stride,
+		   int buf_width, int buf_height,
+		   uint32_t tiling, enum igt_draw_method method,
+		   int rect_x, int rect_y, int rect_w, int rect_h,
+		   uint64_t color, int bpp)
+{
+	struct igt_draw_rect_desc rect = {
+		.x = rect_x,
+		.y = rect_y,
+		.w = rect_w,
+		.h = rect_h,
+		.color = color,
+	};
+
+	igt_draw_rects(fd, bops, ctx, buf_handle, buf_size, buf_stride,
+		       buf_width, buf_height, tiling, method, &rect, 1, bpp);
+}
+
 /**
  * igt_draw_rect_fb:
  * @fd: the DRM file descriptor
@@ -1052,6 +1269,32 @@ void igt_draw_rect_fb(int fd, struct buf_ops *bops,
 		      igt_drm_format_to_bpp(fb->drm_format));
 }
 
+/**
+ * igt_draw_rect_list_fb:
+ * @fd: the DRM file descriptor
+ * @bops: buf ops, only required for IGT_DRAW_BLT and IGT_DRAW_RENDER
+ * @ctx: context, can be 0 if you don't want to think about it
+ * @fb: framebuffer
+ * @method: method you're going to use to write to the buffer
+ * @rects: the rectangles to draw, each with its own color
+ * @num_rects: the number of entries in @rects
+ *
+ * This is exactly the same as igt_draw_rects, but you can pass an igt_fb
+ * instead of manually providing its details. See igt_draw_rects.
+ */
+void igt_draw_rect_list_fb(int fd, struct buf_ops *bops,
+			   uint32_t ctx, struct igt_fb *fb,
+			   enum igt_draw_method method,
+			   const struct igt_draw_rect_desc *rects,
+			   int num_rects)
+{
+	igt_draw_rects(fd, bops, ctx, fb->gem_handle, fb->size, fb->strides[0],
+		       fb->width, fb->height,
+		       igt_fb_mod_to_tiling(fb->modifier), method,
+		       rects, num_rects,
+		       igt_drm_format_to_bpp(fb->drm_format));
+}
+
 /**
  * igt_draw_fill_fb:
  * @fd: the DRM file descriptor
@@ -48,6 +48,24 @@ enum igt_draw_method {
 	IGT_DRAW_METHOD_COUNT,
 };
 
+/**
+ * igt_draw_rect_desc:
+ * @x: horizontal position on the buffer where the rectangle starts
+ * @y: vertical position on the buffer where the rectangle starts
+ * @w: width of the rectangle
+ * @h: height of the rectangle
+ * @color: color of the rectangle
+ *
+ * One entry of the list passed to igt_draw_rects().
+ */
+struct igt_draw_rect_desc {
+	int x;
+	int y;
+	int w;
+	int h;
+	uint64_t color;
+};
+
 const char *igt_draw_get_method_name(enum igt_draw_method method);
 
 bool igt_draw_supports_method(int fd, enum igt_draw_method method);
@@ -59,11 +77,24 @@ void igt_draw_rect(int fd, struct buf_ops *bops, uint32_t ctx,
 		   int rect_x, int rect_y, int rect_w, int rect_h,
 		   uint64_t color, int bpp);
 
+void igt_draw_rects(int fd, struct buf_ops *bops, uint32_t ctx,
+		    uint32_t buf_handle, uint32_t buf_size, uint32_t buf_stride,
+		    int buf_width, int buf_height,
+		    uint32_t tiling, enum igt_draw_method method,
+		    const struct igt_draw_rect_desc *rects, int num_rects,
+		    int bpp);
+
 void igt_draw_rect_fb(int fd, struct buf_ops *bops,
 		      uint32_t ctx, struct igt_fb *fb,
 		      enum igt_draw_method method, int rect_x, int rect_y,
 		      int rect_w, int rect_h, uint64_t color);
 
+void igt_draw_rect_list_fb(int fd, struct buf_ops *bops,
+			   uint32_t ctx, struct igt_fb *fb,
+			   enum igt_draw_method method,
+			   const struct igt_draw_rect_desc *rects,
+			   int num_rects);
+
 void igt_draw_fill_fb(int fd, struct igt_fb *fb, uint64_t color);
 
 #endif /* __IGT_DRAW_H__ */
@@ -6,15 +6,22 @@
 #include <assert.h>
 #include <ctype.h>
 #include <dirent.h>
+#include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <linux/cn_proc.h>
+#include <linux/connector.h>
+#include <linux/netlink.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
 #include <strings.h>
 #include <stdlib.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/sysmacros.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "igt_drm_clients.h"
@@ -24,6 +31,42 @@
 #define ARRAY_SIZE(array) (sizeof(array) / sizeof(array[0]))
 #endif
 
+/*
+ * Scanning every fd of every process on each refresh is what dominates the
+ * cost of the tools on big machines, so only the DRM fds found by a full walk
+ * of /proc are re-read on each scan. Full walks happen on a slower cadence,
+ * while processes created in between are picked up through the proc
+ * connector, when available.
+ */
+#define DEFAULT_FULL_SCAN_INTERVAL_MS 5000
+#define MAX_RECENT_PIDS 1024
+
+struct drm_fd_entry {
+	unsigned int pid;
+	unsigned int fd;
+	unsigned int minor;
+	int fdinfo; /* Open /proc/<pid>/fdinfo/<fd>, or -1 if out of fds. */
+	bool seen;
+	char name[64];
+	char *cgroup; /* Read once when the fd is first found. */
+};
+
+struct igt_drm_clients_scanner {
+	struct drm_fd_entry *entries;
+	unsigned int num_entries;
+	unsigned int capacity;
+
+	/* Processes created since the last full walk, from the proc connector. */
+	unsigned int recent_pids[MAX_RECENT_PIDS];
+	unsigned int num_recent;
+	bool recent_overflow;
+
+	int proc_cn;
+	unsigned int full_scan_interval_ms;
+	bool full_scanned;
+	struct timespec last_full_scan;
+};
+
 /**
  * igt_drm_clients_init:
  * @private_data: private data to store in the struct
@@ -41,9 +84,35 @@ struct igt_drm_clients *igt_drm_clients_init(void *private_data)
 
 	clients->private_data = private_data;
 
+	clients->scanner = calloc(1, sizeof(*clients->scanner));
+	if (!clients->scanner) {
+		free(clients);
+		return NULL;
+	}
+
+	clients->scanner->proc_cn = -1;
+	clients->scanner->full_scan_interval_ms = DEFAULT_FULL_SCAN_INTERVAL_MS;
+
 	return clients;
 }
 
+/**
+ * igt_drm_clients_set_full_scan_interval:
+ * @clients: Previously initialised clients object
+ * @interval_ms: Minimum time between two walks of all the processes
+ *
+ * igt_drm_clients_scan() only re-reads the DRM fds it already knows about,
+ * plus the ones of processes reported as created by the kernel proc
+ * connector. All of /proc is walked again, to catch DRM fds opened by
+ * existing processes, at most every @interval_ms. Zero walks all of /proc on
+ * every scan.
+ */
+void igt_drm_clients_set_full_scan_interval(struct igt_drm_clients *clients,
+					    unsigned int interval_ms)
+{
+	clients->scanner->full_scan_interval_ms = interval_ms;
+}
+
 static struct igt_drm_client *
 igt_drm_clients_find(struct igt_drm_clients *clients,
 		     enum igt_drm_client_status status,
@@ -69,7 +138,7 @@ igt_drm_clients_find(struct igt_drm_clients *clients,
 
 static void
 igt_drm_client_update(struct igt_drm_client *c, unsigned int pid, char *name,
-		      const struct drm_client_fdinfo *info)
+		      const char *cgroup, const struct drm_client_fdinfo *info)
 {
 	unsigned int i;
 	int len;
@@ -101,6 +170,13 @@ igt_drm_client_update(struct igt_drm_client *c, unsigned int pid, char *name,
 			c->clients->max_name_len = len;
 	}
 
+	/* Update client cgroup if it changed (fd sharing). */
+	if (!c->cgroup || strcmp(c->cgroup, cgroup)) {
+		free(c->cgroup);
+		c->cgroup = strdup(cgroup);
+		assert(c->cgroup);
+	}
+
 	/* Engines */
 
 	c->agg_delta_engine_time = 0;
@@ -160,7 +236,8 @@ igt_drm_client_update(struct igt_drm_client *c, unsigned int pid, char *name,
 static void
 igt_drm_client_add(struct igt_drm_clients *clients,
 		   const struct drm_client_fdinfo *info,
-		   unsigned int pid, char *name, unsigned int drm_minor)
+		   unsigned int pid, char *name, const char *cgroup,
+		   unsigned int drm_minor)
 {
 	struct igt_drm_client *c;
 	unsigned int i;
@@ -235,7 +312,7 @@ igt_drm_client_add(struct igt_drm_clients *clients,
 	c->memory = calloc(c->regions->max_region_id + 1, sizeof(*c->memory));
 	assert(c->memory);
 
-	igt_drm_client_update(c, pid, name, info);
+	igt_drm_client_update(c, pid, name, cgroup, info);
 }
 
 static
@@ -262,6 +339,8 @@ void igt_drm_client_free(struct igt_drm_client *c, bool clear)
 
 	free(c->memory);
 
+	free(c->cgroup);
+
 	if (clear)
 		memset(c, 0, sizeof(*c));
 }
@@ -346,12 +425,24 @@ igt_drm_clients_sort(struct igt_drm_clients *clients,
  */
 void igt_drm_clients_free(struct igt_drm_clients *clients)
 {
+	struct igt_drm_clients_scanner *scanner = clients->scanner;
 	struct igt_drm_client *c;
-	unsigned int tmp;
+	unsigned int i;
+	int tmp;
 
 	igt_for_each_drm_client(clients, c, tmp)
 		igt_drm_client_free(c, false);
 
+	for (i = 0; i < scanner->num_entries; i++) {
+		if (scanner->entries[i].fdinfo >= 0)
+			close(scanner->entries[i].fdinfo);
+		free(scanner->entries[i].cgroup);
+	}
+	if (scanner->proc_cn >= 0)
+		close(scanner->proc_cn);
+	free(scanner->entries);
+	free(scanner);
+
 	free(clients->client);
 	free(clients);
 }
@@ -421,6 +512,41 @@ static void get_task_data(int pid_dir, unsigned int *pid, char *task, size_t tas
 	*pid = atoi(buf);
 }
 
+/*
+ * Path of the task in the cgroup v2 hierarchy, or in the first listed v1
+ * hierarchy if there is no unified one. Empty if unknown.
+ */
+static void get_task_cgroup(int pid_dir, char *cgroup, size_t cgroupsz)
+{
+	char buf[4096];
+	char *s, *e;
+
+	cgroup[0] = 0;
+
+	if (!readat2buf(pid_dir, "cgroup", buf, sizeof(buf)))
+		return;
+
+	/* Lines are "hierarchy-ID:controller-list:cgroup-path". */
+	s = strstr(buf, "0::");
+	if (s && (s == buf || s[-1] == '\n')) {
+		s += 3;
+	} else {
+		s = strchr(buf, ':');
+		if (s)
+			s = strchr(s + 1, ':');
+		if (!s)
+			return;
+		s++;
+	}
+
+	e = strchrnul(s, '\n');
+	if (e - s + 1 > cgroupsz)
+		e = s + cgroupsz - 1;
+
+	memcpy(cgroup, s, e - s);
+	cgroup[e - s] = 0;
+}
+
 
 static bool is_drm_fd(int fd_dir, const char *name, unsigned int *minor)
 {
@@ -463,6 +589,306 @@ static void clients_update_max_lengths(struct igt_drm_clients *clients)
 	}
 }
 
+static int proc_connector_open(void)
+{
+	char buf[NLMSG_SPACE(sizeof(struct cn_msg) +
+			     sizeof(enum proc_cn_mcast_op))] = { };
+	struct sockaddr_nl addr = {
+		.nl_family = AF_NETLINK,
+		.nl_groups = CN_IDX_PROC,
+	};
+	struct nlmsghdr *hdr = (struct nlmsghdr *)buf;
+	struct cn_msg *msg = NLMSG_DATA(hdr);
+	enum proc_cn_mcast_op op = PROC_CN_MCAST_LISTEN;
+	int sock;
+
+	sock = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+		      NETLINK_CONNECTOR);
+	if (sock < 0)
+		return -1;
+
+	if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)))
+		goto err;
+
+	hdr->nlmsg_len = sizeof(buf);
+	hdr->nlmsg_type = NLMSG_DONE;
+	msg->id.idx = CN_IDX_PROC;
+	msg->id.val = CN_VAL_PROC;
+	msg->len = sizeof(op);
+	memcpy(msg->data, &op, sizeof(op));
+
+	/* Listening needs CAP_NET_ADMIN, we fall back to full walks without. */
+	if (send(sock, buf, sizeof(buf), 0) != sizeof(buf))
+		goto err;
+
+	return sock;
+
+err:
+	close(sock);
+	return -1;
+}
+
+static void scanner_add_recent(struct igt_drm_clients_scanner *scanner,
+			       unsigned int pid)
+{
+	unsigned int i;
+
+	for (i = 0; i < scanner->num_recent; i++)
+		if (scanner->recent_pids[i] == pid)
+			return;
+
+	if (scanner->num_recent == MAX_RECENT_PIDS) {
+		scanner->recent_overflow = true;
+		return;
+	}
+
+	scanner->recent_pids[scanner->num_recent++] = pid;
+}
+
+static void proc_connector_drain(struct igt_drm_clients_scanner *scanner)
+{
+	char buf[4096] __attribute__((aligned(NLMSG_ALIGNTO)));
+	struct nlmsghdr *hdr;
+	int len;
+
+	while ((len = recv(scanner->proc_cn, buf, sizeof(buf), 0)) > 0) {
+		for (hdr = (struct nlmsghdr *)buf; NLMSG_OK(hdr, len);
+		     hdr = NLMSG_NEXT(hdr, len)) {
+			struct cn_msg *msg = NLMSG_DATA(hdr);
+			struct proc_event ev = { };
+
+			if (msg->id.idx != CN_IDX_PROC ||
+			    msg->id.val != CN_VAL_PROC)
+				continue;
+
+			/* The event is not 8 byte aligned in the message. */
+			memcpy(&ev, msg->data,
+			       msg->len < sizeof(ev) ? msg->len : sizeof(ev));
+
+			/* New threads share the fd table of their process. */
+			if (ev.what == PROC_EVENT_FORK &&
+			    ev.event_data.fork.child_pid ==
+			    ev.event_data.fork.child_tgid)
+				scanner_add_recent(scanner,
+						   ev.event_data.fork.child_tgid);
+			else if (ev.what == PROC_EVENT_EXEC)
+				scanner_add_recent(scanner,
+						   ev.event_data.exec.process_tgid);
+		}
+	}
+
+	/* Lost events, so some new processes may not be known. */
+	if (len < 0 && errno == ENOBUFS)
+		scanner->recent_overflow = true;
+}
+
+static struct drm_fd_entry *
+scanner_find(struct igt_drm_clients_scanner *scanner, unsigned int pid,
+	     unsigned int fd)
+{
+	unsigned int i;
+
+	for (i = 0; i < scanner->num_entries; i++)
+		if (scanner->entries[i].pid == pid &&
+		    scanner->entries[i].fd == fd)
+			return &scanner->entries[i];
+
+	return NULL;
+}
+
+static void scanner_remove(struct igt_drm_clients_scanner *scanner,
+			   unsigned int idx)
+{
+	if (scanner->entries[idx].fdinfo >= 0)
+		close(scanner->entries[idx].fdinfo);
+	free(scanner->entries[idx].cgroup);
+
+	memmove(&scanner->entries[idx], &scanner->entries[idx + 1],
+		(scanner->num_entries - idx - 1) * sizeof(*scanner->entries));
+	scanner->num_entries--;
+}
+
+/* Finds the DRM fds of a process, and opens the fdinfo of new ones. */
+static void scanner_scan_pid(struct igt_drm_clients_scanner *scanner,
+			     int proc_dir, const char *pid_str)
+{
+	unsigned int pid = 0, minor = 0;
+	struct dirent *fd_dent;
+	char name[64] = { };
+	char cgroup[PATH_MAX];
+	bool have_cgroup = false;
+	int pid_dir, fdinfo_dir = -1;
+	DIR *fd_dir = NULL;
+
+	pid_dir = openat(proc_dir, pid_str, O_DIRECTORY | O_RDONLY);
+	if (pid_dir < 0)
+		return;
+
+	fd_dir = opendirat(pid_dir, "fd");
+	if (!fd_dir)
+		goto out;
+
+	fdinfo_dir = openat(pid_dir, "fdinfo", O_DIRECTORY | O_RDONLY);
+	if (fdinfo_dir < 0)
+		goto out;
+
+	while ((fd_dent = readdir(fd_dir)) != NULL) {
+		struct drm_fd_entry *e;
+		unsigned int fd;
+
+		if (!isdigit(fd_dent->d_name[0]))
+			continue;
+
+		if (!is_drm_fd(dirfd(fd_dir), fd_dent->d_name, &minor))
+			continue;
+
+		if (!pid) {
+			get_task_data(pid_dir, &pid, name, sizeof(name));
+			if (!pid)
+				break;
+		}
+
+		fd = atoi(fd_dent->d_name);
+		e = scanner_find(scanner, pid, fd);
+		if (!e) {
+			if (scanner->num_entries == scanner->capacity) {
+				unsigned int capacity = scanner->capacity ?
+							scanner->capacity * 2 : 64;
+
+				e = realloc(scanner->entries,
+					    capacity * sizeof(*e));
+				if (!e)
+					break;
+
+				scanner->entries = e;
+				scanner->capacity = capacity;
+			}
+
+			if (!have_cgroup) {
+				get_task_cgroup(pid_dir, cgroup, sizeof(cgroup));
+				have_cgroup = true;
+			}
+
+			e = &scanner->entries[scanner->num_entries++];
+			e->pid = pid;
+			e->fd = fd;
+			e->fdinfo = openat(fdinfo_dir, fd_dent->d_name,
+					   O_RDONLY | O_CLOEXEC);
+			e->cgroup = strdup(cgroup);
+			assert(e->cgroup);
+		}
+
+		/* Also refreshes the name and minor of reused fd numbers. */
+		e->minor = minor;
+		e->seen = true;
+		strcpy(e->name, name);
+	}
+
+out:
+	if (fdinfo_dir >= 0)
+		close(fdinfo_dir);
+	if (fd_dir)
+		closedir(fd_dir);
+	close(pid_dir);
+}
+
+static void scanner_full_scan(struct igt_drm_clients_scanner *scanner)
+{
+	struct dirent *proc_dent;
+	DIR *proc_dir;
+	unsigned int i;
+
+	proc_dir = opendir("/proc");
+	if (!proc_dir)
+		return;
+
+	for (i = 0; i < scanner->num_entries; i++)
+		scanner->entries[i].seen = false;
+
+	while ((proc_dent = readdir(proc_dir)) != NULL) {
+		if (proc_dent->d_type != DT_DIR)
+			continue;
+		if (!isdigit(proc_dent->d_name[0]))
+			continue;
+
+		scanner_scan_pid(scanner, dirfd(proc_dir), proc_dent->d_name);
+	}
+
+	closedir(proc_dir);
+
+	/* Forget the fds which have been closed. */
+	for (i = scanner->num_entries; i--; )
+		if (!scanner->entries[i].seen)
+			scanner_remove(scanner, i);
+
+	scanner->num_recent = 0;
+	scanner->recent_overflow = false;
+	scanner->full_scanned = true;
+	clock_gettime(CLOCK_MONOTONIC, &scanner->last_full_scan);
+}
+
+static void scanner_scan_recent(struct igt_drm_clients_scanner *scanner)
+{
+	char pid_str[16];
+	unsigned int i;
+	int proc_dir;
+
+	if (!scanner->num_recent)
+		return;
+
+	proc_dir = open("/proc", O_DIRECTORY | O_RDONLY);
+	if (proc_dir < 0)
+		return;
+
+	/*
+	 * Rescanned until the next full walk, since a new process can open
+	 * its DRM fds any time after being created.
+	 */
+	for (i = 0; i < scanner->num_recent; i++) {
+		snprintf(pid_str, sizeof(pid_str), "%u",
+			 scanner->recent_pids[i]);
+		scanner_scan_pid(scanner, proc_dir, pid_str);
+	}
+
+	close(proc_dir);
+}
+
+static bool scanner_needs_full_scan(struct igt_drm_clients_scanner *scanner)
+{
+	struct timespec now;
+	uint64_t elapsed_ms;
+
+	if (!scanner->full_scanned || scanner->recent_overflow ||
+	    !scanner->full_scan_interval_ms)
+		return true;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	elapsed_ms = (now.tv_sec - scanner->last_full_scan.tv_sec) * 1000ull +
+		     (now.tv_nsec - scanner->last_full_scan.tv_nsec) / 1000000;
+
+	return elapsed_ms >= scanner->full_scan_interval_ms;
+}
+
+static unsigned int
+scanner_read(struct drm_fd_entry *e, struct drm_client_fdinfo *info,
+	     const char **name_map, unsigned int map_entries,
+	     const char **region_map, unsigned int region_entries)
+{
+	char path[64];
+
+	if (e->fdinfo >= 0)
+		return igt_parse_drm_fdinfo_fd(e->fdinfo, info,
+					       name_map, map_entries,
+					       region_map, region_entries);
+
+	/* Could not be kept open, look it up each time. */
+	snprintf(path, sizeof(path), "/proc/%u/fdinfo/%u", e->pid, e->fd);
+
+	return __igt_parse_drm_fdinfo(AT_FDCWD, path, info,
+				      name_map, map_entries,
+				      region_map, region_entries);
+}
+
 /**
  * igt_drm_clients_scan:
  * @clients: Previously initialised clients object
@@ -473,6 +899,12 @@ static void clients_update_max_lengths(struct igt_drm_clients *clients)
  * Scan all open file descriptors from all processes in order to find all DRM
  * clients and manage our internal list.
  *
+ * Only the fdinfo of the DRM fds found previously, kept open in between, is
+ * re-read on each call. All processes are walked again on the cadence set
+ * with igt_drm_clients_set_full_scan_interval(), while the ones created in
+ * between are scanned as soon as the kernel proc connector reports them, if
+ * the caller is allowed to listen to it.
+ *
  * If @name_map is provided each found engine in the fdinfo struct must
  * correspond to one of the provided names. In this case the index of the engine
  * stats tracked in struct igt_drm_client will be tracked under the same index
@@ -489,15 +921,17 @@ igt_drm_clients_scan(struct igt_drm_clients *clients,
 		     const char **name_map, unsigned int map_entries,
 		     const char **region_map, unsigned int region_entries)
 {
-	struct dirent *proc_dent;
+	struct igt_drm_clients_scanner *scanner;
 	struct igt_drm_client *c;
 	bool freed = false;
-	DIR *proc_dir;
+	unsigned int i;
 	int tmp;
 
 	if (!clients)
 		return clients;
 
+	scanner = clients->scanner;
+
 	/*
 	 * First mark all alive clients as 'probe' so we can figure out which
 	 * ones have existed since the previous scan.
@@ -510,86 +944,45 @@ igt_drm_clients_scan(struct igt_drm_clients *clients,
 			break; /* Free block at the end of array. */
 	}
 
-	proc_dir = opendir("/proc");
-	if (!proc_dir)
-		return clients;
+	if (!scanner->full_scanned && scanner->full_scan_interval_ms)
+		scanner->proc_cn = proc_connector_open();
+	if (scanner->proc_cn >= 0)
+		proc_connector_drain(scanner);
 
-	while ((proc_dent = readdir(proc_dir)) != NULL) {
-		unsigned int client_pid = 0, minor = 0;
-		int pid_dir = -1, fd_dir = -1;
-		struct dirent *fdinfo_dent;
-		char client_name[64] = { };
-		DIR *fdinfo_dir = NULL;
+	if (scanner_needs_full_scan(scanner))
+		scanner_full_scan(scanner);
+	else if (scanner->proc_cn >= 0)
+		scanner_scan_recent(scanner);
 
-		if (proc_dent->d_type != DT_DIR)
-			continue;
-		if (!isdigit(proc_dent->d_name[0]))
-			continue;
+	for (i = 0; i < scanner->num_entries; ) {
+		struct drm_fd_entry *e = &scanner->entries[i];
+		struct drm_client_fdinfo info = { };
 
-		pid_dir = openat(dirfd(proc_dir), proc_dent->d_name,
-				 O_DIRECTORY | O_RDONLY);
-		if (pid_dir < 0)
+		if (!scanner_read(e, &info, name_map, map_entries,
+				  region_map, region_entries)) {
+			/* Closed, or not a DRM fd with usage stats. */
+			scanner_remove(scanner, i);
 			continue;
+		}
+		i++;
 
-		fd_dir = openat(pid_dir, "fd", O_DIRECTORY | O_RDONLY);
-		if (fd_dir < 0)
-			goto next;
-
-		fdinfo_dir = opendirat(pid_dir, "fdinfo");
-		if (!fdinfo_dir)
-			goto next;
-
-		while ((fdinfo_dent = readdir(fdinfo_dir)) != NULL) {
-			struct drm_client_fdinfo info = { };
-
-			if (fdinfo_dent->d_type != DT_REG)
-				continue;
-			if (!isdigit(fdinfo_dent->d_name[0]))
-				continue;
-
-			if (!is_drm_fd(fd_dir, fdinfo_dent->d_name, &minor))
-				continue;
-
-			if (!__igt_parse_drm_fdinfo(dirfd(fdinfo_dir),
-						    fdinfo_dent->d_name, &info,
-						    name_map, map_entries,
-						    region_map, region_entries))
-				continue;
-
-			if (filter_client && !filter_client(clients, &info))
-				continue;
-
-			if (igt_drm_clients_find(clients, IGT_DRM_CLIENT_ALIVE,
-						 minor, info.id))
-				continue; /* Skip duplicate fds. */
-
-			if (!client_pid) {
-				get_task_data(pid_dir, &client_pid, client_name,
-					      sizeof(client_name));
-				assert(client_pid > 0);
-			}
+		if (filter_client && !filter_client(clients, &info))
+			continue;
 
-			c = igt_drm_clients_find(clients, IGT_DRM_CLIENT_PROBE,
-						 minor, info.id);
-			if (!c)
-				igt_drm_client_add(clients, &info, client_pid,
-						   client_name, minor);
-			else
-				igt_drm_client_update(c, client_pid,
-						      client_name, &info);
-		}
+		if (igt_drm_clients_find(clients, IGT_DRM_CLIENT_ALIVE,
+					 e->minor, info.id))
+			continue; /* Skip duplicate fds. */
 
-next:
-		if (fdinfo_dir)
-			closedir(fdinfo_dir);
-		if (fd_dir >= 0)
-			close(fd_dir);
-		if (pid_dir >= 0)
-			close(pid_dir);
+		c = igt_drm_clients_find(clients, IGT_DRM_CLIENT_PROBE,
+					 e->minor, info.id);
+		if (!c)
+			igt_drm_client_add(clients, &info, e->pid, e->name,
+					   e->cgroup, e->minor);
+		else
+			igt_drm_client_update(c, e->pid, e->name, e->cgroup,
+					      &info);
 	}
 
-	closedir(proc_dir);
-
 	/*
 	 * Clients still in 'probe' status after the scan have exited and need
 	 * to be freed.
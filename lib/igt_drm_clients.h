@@ -26,6 +26,7 @@
  */
 
 struct drm_client_fdinfo;
+struct igt_drm_clients_scanner;
 
 enum igt_drm_client_status {
 	IGT_DRM_CLIENT_FREE = 0, /* mbz */
@@ -68,6 +69,7 @@ struct igt_drm_client {
 	char pid_str[10]; /* Cached PID representation. */
 	char name[24]; /* Process name of the owning PID. */
 	char print_name[24]; /* Name without any non-printable characters. */
+	char *cgroup; /* cgroup path of the owning PID, empty if unknown. */
 	unsigned int samples; /* Count of times scanning updated this client. */
 
 	uint32_t utilization_mask; /* mask of enum igt_drm_client_utilization_type */
@@ -98,6 +100,8 @@ struct igt_drm_clients {
 
 	void *private_data;
 
+	struct igt_drm_clients_scanner *scanner; /* Incremental scanning state. */
+
 	struct igt_drm_client *client; /* Must be last. */
 };
 
@@ -107,6 +111,8 @@ struct igt_drm_clients {
 
 struct igt_drm_clients *igt_drm_clients_init(void *private_data);
 void igt_drm_clients_free(struct igt_drm_clients *clients);
+void igt_drm_clients_set_full_scan_interval(struct igt_drm_clients *clients,
+					    unsigned int interval_ms);
 
 struct igt_drm_clients *
 igt_drm_clients_scan(struct igt_drm_clients *clients,
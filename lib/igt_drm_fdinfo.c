@@ -38,143 +38,201 @@
 
 static size_t read_fdinfo(char *buf, const size_t sz, int at, const char *name)
 {
-	size_t count;
+	ssize_t count;
 	int fd;
 
 	fd = openat(at, name, O_RDONLY);
 	if (fd < 0)
 		return 0;
 
-	count = read(fd, buf, sz - 1);
-	if (count > 0)
-		buf[count - 1] = 0;
+	count = read(fd, buf, sz);
 	close(fd);
 
 	return count > 0 ? count : 0;
 }
 
-static const char *ignore_space(const char *s)
-{
-	for (; *s && isspace(*s); s++)
-		;
-
-	return s;
-}
+/*
+ * Keys after the "drm-" prefix. Those ending with a '-' are followed by an
+ * engine or region name. Sorted, with keys listed before the shorter keys
+ * they start with.
+ */
+enum fdinfo_key {
+	KEY_ACTIVE,
+	KEY_CLIENT_ID,
+	KEY_CYCLES,
+	KEY_DRIVER,
+	KEY_ENGINE_CAPACITY,
+	KEY_ENGINE,
+	KEY_MEMORY,
+	KEY_PDEV,
+	KEY_PURGEABLE,
+	KEY_RESIDENT,
+	KEY_SHARED,
+	KEY_TOTAL_CYCLES,
+	KEY_TOTAL,
+};
+
+#define FDINFO_KEY(k, s) [k] = { s, sizeof(s) - 1 }
+
+static const struct {
+	const char *str;
+	unsigned int len;
+} fdinfo_keys[] = {
+	FDINFO_KEY(KEY_ACTIVE, "active-"),
+	FDINFO_KEY(KEY_CLIENT_ID, "client-id"),
+	FDINFO_KEY(KEY_CYCLES, "cycles-"),
+	FDINFO_KEY(KEY_DRIVER, "driver"),
+	FDINFO_KEY(KEY_ENGINE_CAPACITY, "engine-capacity-"),
+	FDINFO_KEY(KEY_ENGINE, "engine-"),
+	FDINFO_KEY(KEY_MEMORY, "memory-"),
+	FDINFO_KEY(KEY_PDEV, "pdev"),
+	FDINFO_KEY(KEY_PURGEABLE, "purgeable-"),
+	FDINFO_KEY(KEY_RESIDENT, "resident-"),
+	FDINFO_KEY(KEY_SHARED, "shared-"),
+	FDINFO_KEY(KEY_TOTAL_CYCLES, "total-cycles-"),
+	FDINFO_KEY(KEY_TOTAL, "total-"),
+};
 
-static int parse_engine(const char *name, struct drm_client_fdinfo *info,
-			const char **name_map, unsigned int map_entries,
-			uint64_t *val)
+/*
+ * Matches @name, @len bytes long, against the key table. Returns the key and
+ * the length of its engine or region name suffix in @suffix, or -1.
+ */
+static int match_key(const char *name, size_t len, size_t *suffix)
 {
-	const char *p;
-	size_t name_len;
-	int found = -1;
 	unsigned int i;
 
-	p = strchr(name, ':');
-	if (!p)
-		return -1;
+	for (i = 0; i < ARRAY_SIZE(fdinfo_keys); i++) {
+		const char *str = fdinfo_keys[i].str;
+		size_t klen = fdinfo_keys[i].len;
 
-	name_len = p - name;
-	if (name_len < 1)
-		return -1;
-	p++;
+		if (str[0] < name[0])
+			continue;
+		if (str[0] > name[0])
+			break;
 
-	if (name_map) {
-		for (i = 0; i < map_entries; i++) {
-			if (!strncmp(name, name_map[i], name_len)) {
-				found = i;
-				break;
+		if (str[klen - 1] == '-') {
+			if (len > klen && !memcmp(name, str, klen)) {
+				*suffix = len - klen;
+				return i;
 			}
-		}
-	} else {
-		for (i = 0; i < info->num_engines; i++) {
-			if (!strncmp(name, info->names[i], name_len)) {
-				found = i;
-				break;
-			}
-		}
-
-		if (found < 0) {
-			assert((info->num_engines + 1) < ARRAY_SIZE(info->names));
-			assert(name_len  < sizeof(info->names[0]));
-			memcpy(info->names[info->num_engines], name, name_len);
-			info->names[info->num_engines][name_len] = '\0';
-			found = info->num_engines;
+		} else if (len == klen && !memcmp(name, str, klen)) {
+			*suffix = 0;
+			return i;
 		}
 	}
 
-	p++;
-	if (found >= 0)
-		*val = strtoull(p, NULL, 10);
+	return -1;
+}
+
+/*
+ * Lengths of the names of a map, or of the names discovered so far without
+ * one, to compare on length before contents.
+ */
+struct name_index {
+	const char **names;
+	unsigned int count;
+	size_t len[DRM_CLIENT_FDINFO_MAX_ENGINES];
+};
+
+static void name_index_init(struct name_index *index, const char **names,
+			    unsigned int count)
+{
+	unsigned int i;
+
+	assert(count <= ARRAY_SIZE(index->len));
 
-	return found;
+	index->names = names;
+	index->count = names ? count : 0;
+	for (i = 0; i < index->count; i++)
+		index->len[i] = strlen(names[i]);
 }
 
-static int parse_region(const char *name, struct drm_client_fdinfo *info,
-			const char **region_map, unsigned int region_entries,
-			uint64_t *val)
+static int name_index_find(const struct name_index *index, const char *name,
+			   size_t len)
 {
-	char *p;
-	ssize_t name_len;
-	int found = -1;
 	unsigned int i;
 
-	p = strchr(name, ':');
-	if (!p)
-		return -1;
+	for (i = 0; i < index->count; i++)
+		if (index->len[i] == len && !memcmp(index->names[i], name, len))
+			return i;
 
-	name_len = p - name;
-	if (name_len < 1)
-		return -1;
+	return -1;
+}
 
-	p++;
+/* Finds or, without a map, registers a name in @names and @index. */
+static int lookup_name(struct name_index *index, char (*names)[256],
+		       unsigned int num, unsigned int max,
+		       const char *name, size_t len)
+{
+	unsigned int i;
 
-	if (region_map) {
-		for (i = 0; i < region_entries; i++) {
-			if (!strncmp(name, region_map[i], name_len)) {
-				found = i;
-				if (!info->region_names[info->num_regions][0]) {
-					assert(name_len < sizeof(info->region_names[i]));
-					strncpy(info->region_names[i], name, name_len);
-				}
-				break;
-			}
-		}
-	} else {
-		for (i = 0; i < info->num_regions; i++) {
-			if (!strncmp(name, info->region_names[i], name_len)) {
-				found = i;
-				break;
-			}
-		}
+	if (index->names)
+		return name_index_find(index, name, len);
 
-		if (found < 0) {
-			assert((info->num_regions + 1) < ARRAY_SIZE(info->region_names));
-			assert((strlen(name) + 1) < sizeof(info->region_names[0]));
-			strncpy(info->region_names[info->num_regions], name, name_len);
-			found = info->num_regions;
-		}
-	}
+	for (i = 0; i < num; i++)
+		if (index->len[i] == len && !memcmp(names[i], name, len))
+			return i;
 
-	if (found < 0)
-		goto out;
-
-	p++;
-	*val = strtoull(p, &p, 10);
-	p = (char *)ignore_space(p);
-	if (!*p)
-		goto out;
-
-	if (!strcmp(p, "KiB")) {
-		*val *= 1024;
-	} else if (!strcmp(p, "MiB")) {
-		*val *= 1024 * 1024;
-	} else if (!strcmp(p, "GiB")) {
-		*val *= 1024 * 1024 * 1024;
-	}
+	/* Without a map the entries are indexed in order of appearance */
+	assert(num + 1 < max);
+	assert(len < sizeof(names[0]));
+	memcpy(names[num], name, len);
+	names[num][len] = '\0';
+	index->len[num] = len;
+
+	return num;
+}
 
-out:
-	return found;
+static const char *skip_space(const char *s, const char *end)
+{
+	while (s < end && isspace(*s))
+		s++;
+
+	return s;
+}
+
+static uint64_t parse_u64(const char **s, const char *end, bool *valid)
+{
+	const char *p = *s;
+	uint64_t val = 0;
+
+	while (p < end && *p >= '0' && *p <= '9')
+		val = val * 10 + (*p++ - '0');
+
+	*valid = p != *s;
+	*s = p;
+
+	return val;
+}
+
+static uint64_t parse_size(const char *s, const char *end)
+{
+	bool valid;
+	uint64_t val = parse_u64(&s, end, &valid);
+	size_t len;
+
+	s = skip_space(s, end);
+	len = end - s;
+
+	if (len == 3 && !memcmp(s, "KiB", 3))
+		val *= 1024;
+	else if (len == 3 && !memcmp(s, "MiB", 3))
+		val *= 1024 * 1024;
+	else if (len == 3 && !memcmp(s, "GiB", 3))
+		val *= 1024 * 1024 * 1024;
+
+	return val;
+}
+
+static void copy_value(char *dst, size_t size, const char *s, const char *end)
+{
+	size_t len = end - s;
+
+	if (len > size - 1)
+		len = size - 1;
+
+	memcpy(dst, s, len);
+	dst[len] = '\0';
 }
 
 #define UPDATE_REGION(idx, region, val)					\
@@ -206,94 +264,117 @@ out:
 		}							\
 	} while (0)
 
-#define strstartswith(a, b, plen__) ({					\
-		*plen__ = strlen(b);					\
-		strncmp(a, b, *plen__) == 0;				\
-})
-
-unsigned int
-__igt_parse_drm_fdinfo(int dir, const char *fd, struct drm_client_fdinfo *info,
-		       const char **name_map, unsigned int map_entries,
-		       const char **region_map, unsigned int region_entries)
+/*
+ * Parses the @len bytes of fdinfo text in @buf in a single pass, without
+ * modifying it or allocating anything.
+ */
+static unsigned int
+parse_fdinfo(const char *buf, size_t len, struct drm_client_fdinfo *info,
+	     const char **name_map, unsigned int map_entries,
+	     const char **region_map, unsigned int region_entries)
 {
 	bool regions_found[DRM_CLIENT_FDINFO_MAX_REGIONS] = { };
 	bool engines_found[DRM_CLIENT_FDINFO_MAX_ENGINES] = { };
 	unsigned int good = 0, num_capacity = 0;
-	char buf[4096], *_buf = buf;
-	char *l, *ctx = NULL;
-	size_t count;
-
-	count = read_fdinfo(buf, sizeof(buf), dir, fd);
-	if (!count)
-		return 0;
-
-	while ((l = strtok_r(_buf, "\n", &ctx))) {
-		uint64_t val = 0;
-		size_t keylen;
-		const char *v;
-		char *end_ptr;
-		int idx;
-
-		_buf = NULL;
-
-		if (strstartswith(l, "drm-driver:", &keylen)) {
-			v = ignore_space(l + keylen);
-			if (*v) {
-				strncpy(info->driver, v, sizeof(info->driver) - 1);
+	struct name_index engines, regions;
+	const char *end = buf + len;
+	const char *l, *eol;
+
+	name_index_init(&engines, name_map, map_entries);
+	name_index_init(&regions, region_map, region_entries);
+
+	for (l = buf; l < end; l = eol + 1) {
+		const char *colon, *name, *v;
+		size_t suffix;
+		uint64_t val;
+		bool valid;
+		int key, idx;
+
+		eol = memchr(l, '\n', end - l);
+		if (!eol)
+			eol = end;
+
+		if (eol - l < 4 || memcmp(l, "drm-", 4))
+			continue;
+
+		colon = memchr(l, ':', eol - l);
+		if (!colon)
+			continue;
+
+		key = match_key(l + 4, colon - l - 4, &suffix);
+		if (key < 0)
+			continue;
+
+		name = colon - suffix;
+		v = skip_space(colon + 1, eol);
+
+		switch (key) {
+		case KEY_DRIVER:
+			if (v < eol) {
+				copy_value(info->driver, sizeof(info->driver),
+					   v, eol);
 				good++;
 			}
-		}  else if (strstartswith(l, "drm-client-id:", &keylen)) {
-			v = l + keylen;
-			info->id = strtol(v, &end_ptr, 10);
-			if (end_ptr != v)
+			break;
+		case KEY_CLIENT_ID:
+			info->id = parse_u64(&v, eol, &valid);
+			if (valid)
 				good++;
-		} else if (strstartswith(l, "drm-pdev:", &keylen)) {
-			v = ignore_space(l + keylen);
-			strncpy(info->pdev, v, sizeof(info->pdev) - 1);
-		} else if (strstartswith(l, "drm-engine-capacity-", &keylen)) {
-			idx = parse_engine(l + keylen, info,
-					   name_map, map_entries, &val);
-			if (idx >= 0) {
+			break;
+		case KEY_PDEV:
+			copy_value(info->pdev, sizeof(info->pdev), v, eol);
+			break;
+		case KEY_ENGINE_CAPACITY:
+		case KEY_ENGINE:
+		case KEY_CYCLES:
+		case KEY_TOTAL_CYCLES:
+			idx = lookup_name(&engines, info->names,
+					  info->num_engines,
+					  ARRAY_SIZE(info->names),
+					  name, suffix);
+			if (idx < 0)
+				break;
+
+			val = parse_u64(&v, eol, &valid);
+			if (key == KEY_ENGINE_CAPACITY) {
 				info->capacity[idx] = val;
 				num_capacity++;
+			} else if (key == KEY_ENGINE) {
+				UPDATE_ENGINE(idx, engine_time, val,
+					      DRM_FDINFO_UTILIZATION_ENGINE_TIME);
+			} else if (key == KEY_CYCLES) {
+				UPDATE_ENGINE(idx, cycles, val,
+					      DRM_FDINFO_UTILIZATION_CYCLES);
+			} else {
+				UPDATE_ENGINE(idx, total_cycles, val,
+					      DRM_FDINFO_UTILIZATION_TOTAL_CYCLES);
 			}
-		} else if (strstartswith(l, "drm-engine-", &keylen)) {
-			idx = parse_engine(l + keylen, info,
-					   name_map, map_entries, &val);
-			UPDATE_ENGINE(idx, engine_time, val, DRM_FDINFO_UTILIZATION_ENGINE_TIME);
-		} else if (strstartswith(l, "drm-cycles-", &keylen)) {
-			idx = parse_engine(l + keylen, info,
-					   name_map, map_entries, &val);
-			UPDATE_ENGINE(idx, cycles, val, DRM_FDINFO_UTILIZATION_CYCLES);
-		} else if (strstartswith(l, "drm-total-cycles-", &keylen)) {
-			idx = parse_engine(l + keylen, info,
-					   name_map, map_entries, &val);
-			UPDATE_ENGINE(idx, total_cycles, val, DRM_FDINFO_UTILIZATION_TOTAL_CYCLES);
-		} else if (strstartswith(l, "drm-total-", &keylen)) {
-			idx = parse_region(l + keylen, info,
-					   region_map, region_entries, &val);
-			UPDATE_REGION(idx, total, val);
-		} else if (strstartswith(l, "drm-shared-", &keylen)) {
-			idx = parse_region(l + keylen, info,
-					   region_map, region_entries, &val);
-			UPDATE_REGION(idx, shared, val);
-		} else if (strstartswith(l, "drm-resident-", &keylen)) {
-			idx = parse_region(l + keylen, info,
-					   region_map, region_entries, &val);
-			UPDATE_REGION(idx, resident, val);
-		} else if (strstartswith(l, "drm-memory-", &keylen)) {
-			/* amdgpu legacy key */
-			idx = parse_region(l + keylen, info,
-					   region_map, region_entries, &val);
-			UPDATE_REGION(idx, resident, val);
-		} else if (strstartswith(l, "drm-purgeable-", &keylen)) {
-			idx = parse_region(l + keylen, info,
-					   region_map, region_entries, &val);
-			UPDATE_REGION(idx, purgeable, val);
-		} else if (strstartswith(l, "drm-active-", &keylen)) {
-			idx = parse_region(l + keylen, info,
-					   region_map, region_entries, &val);
-			UPDATE_REGION(idx, active, val);
+			break;
+		default:
+			idx = lookup_name(&regions, info->region_names,
+					  info->num_regions,
+					  ARRAY_SIZE(info->region_names),
+					  name, suffix);
+			if (idx < 0)
+				break;
+
+			if (region_map && !info->region_names[idx][0])
+				copy_value(info->region_names[idx],
+					   sizeof(info->region_names[idx]),
+					   name, colon);
+
+			val = parse_size(v, eol);
+			if (key == KEY_TOTAL)
+				UPDATE_REGION(idx, total, val);
+			else if (key == KEY_SHARED)
+				UPDATE_REGION(idx, shared, val);
+			else if (key == KEY_RESIDENT || key == KEY_MEMORY)
+				UPDATE_REGION(idx, resident, val); /* memory- is the amdgpu legacy key */
+			else if (key == KEY_PURGEABLE)
+				UPDATE_REGION(idx, purgeable, val);
+			else
+				UPDATE_REGION(idx, active, val);
+			break;
 		}
 	}
 
@@ -303,6 +384,39 @@ __igt_parse_drm_fdinfo(int dir, const char *fd, struct drm_client_fdinfo *info,
 	return good + info->num_engines + num_capacity + info->num_regions;
 }
 
+unsigned int
+__igt_parse_drm_fdinfo(int dir, const char *fd, struct drm_client_fdinfo *info,
+		       const char **name_map, unsigned int map_entries,
+		       const char **region_map, unsigned int region_entries)
+{
+	char buf[4096];
+	size_t count;
+
+	count = read_fdinfo(buf, sizeof(buf), dir, fd);
+	if (!count)
+		return 0;
+
+	return parse_fdinfo(buf, count, info, name_map, map_entries,
+			    region_map, region_entries);
+}
+
+unsigned int
+igt_parse_drm_fdinfo_fd(int fdinfo, struct drm_client_fdinfo *info,
+			const char **name_map, unsigned int map_entries,
+			const char **region_map, unsigned int region_entries)
+{
+	char buf[4096];
+	ssize_t count;
+
+	/* fdinfo is regenerated when read again from the start */
+	count = pread(fdinfo, buf, sizeof(buf), 0);
+	if (count <= 0)
+		return 0;
+
+	return parse_fdinfo(buf, count, info, name_map, map_entries,
+			    region_map, region_entries);
+}
+
 unsigned int
 igt_parse_drm_fdinfo(int drm_fd, struct drm_client_fdinfo *info,
 		     const char **name_map, unsigned int map_entries,
@@ -115,4 +115,26 @@ __igt_parse_drm_fdinfo(int dir, const char *fd,
 		       const char **name_map, unsigned int map_entries,
 		       const char **region_map, unsigned int region_entries);
 
+/**
+ * igt_parse_drm_fdinfo_fd: Parse an open drm fdinfo file
+ *
+ * Parse an already open /proc/<pid>/fdinfo/<fd> file, re-reading it from the
+ * start, so that polling a client doesn't need to look the file up again.
+ *
+ * @fdinfo: File descriptor of the open fdinfo file
+ * @info: Structure to populate with read data. Must be zeroed.
+ * @name_map: Optional array of strings representing engine names
+ * @map_entries: Number of strings in the names array
+ * @region_map: Optional array of strings representing memory regions
+ * @region_entries: Number of strings in the region map
+ *
+ * Returns the number of valid drm fdinfo keys found or zero if not all
+ * mandatory keys were present, no engines found or the file descriptor is
+ * gone.
+ */
+unsigned int
+igt_parse_drm_fdinfo_fd(int fdinfo, struct drm_client_fdinfo *info,
+			const char **name_map, unsigned int map_entries,
+			const char **region_map, unsigned int region_entries);
+
 #endif /* IGT_DRM_FDINFO_H */
@@ -41,6 +41,7 @@
 #include "igt_device.h"
 #include "igt_dummyload.h"
 #include "igt_gt.h"
+#include "igt_syncobj.h"
 #include "igt_vgem.h"
 #include "intel_allocator.h"
 #include "intel_chipset.h"
@@ -67,9 +68,22 @@
 static const int BATCH_SIZE = 4096;
 static const int LOOP_START_OFFSET = 64;
 
+/* Scratch dwords in the batch used by timed spinners, below spin->condition */
+#define SPIN_TS_DELTA_OFFSET 4064
+#define SPIN_TS_PAD_OFFSET 4072
+#define SPIN_MAX_CTX_TICKS (UINT32_MAX - 1000)
+#define CTX_TIMESTAMP 0x3a8
+#define CS_GPR(x) (0x600 + 8 * (x))
+enum { SPIN_START_TS, SPIN_NOW_TS };
+
 static IGT_LIST_HEAD(spin_list);
 static pthread_mutex_t list_lock = PTHREAD_MUTEX_INITIALIZER;
 
+/* Idle IGT_SPIN_POOL spinners waiting for reuse, protected by list_lock */
+#define SPIN_POOL_MAX 64
+static IGT_LIST_HEAD(spin_pool);
+static unsigned int spin_pool_count;
+
 static uint32_t
 handle_create(int fd, size_t sz, unsigned long flags, uint32_t **mem)
 {
@@ -88,6 +102,44 @@ handle_create(int fd, size_t sz, unsigned long flags, uint32_t **mem)
 	return gem_create(fd, sz);
 }
 
+static uint32_t spin_ns_to_ctx_ticks(int fd, uint64_t ns)
+{
+	int freq = 0;
+	struct drm_i915_getparam gp = {
+		.param = I915_PARAM_CS_TIMESTAMP_FREQUENCY,
+		.value = &freq,
+	};
+	uint64_t ticks;
+
+	igt_require(igt_ioctl(fd, DRM_IOCTL_I915_GETPARAM, &gp) == 0 && freq);
+
+	/* On gen11 context timestamp ticks at a different rate than CS one */
+	if (intel_gen(intel_get_drm_devid(fd)) == 11)
+		freq = 12500000;
+
+	ticks = DIV_ROUND_UP(ns * freq, NSEC_PER_SEC);
+	igt_assert_lt_u64(ticks, SPIN_MAX_CTX_TICKS);
+
+	return ticks;
+}
+
+static uint32_t *
+emit_batch_addr(uint32_t *cs, const uint32_t *batch,
+		const struct drm_i915_gem_exec_object2 *obj,
+		struct drm_i915_gem_relocation_entry *r, uint32_t delta)
+{
+	r->target_handle = obj->handle;
+	r->presumed_offset = obj->offset;
+	r->offset = (cs - batch) * sizeof(*cs);
+	r->read_domains = I915_GEM_DOMAIN_COMMAND;
+	r->delta = delta;
+
+	*cs++ = r->presumed_offset + r->delta;
+	*cs++ = (r->presumed_offset + r->delta) >> 32;
+
+	return cs;
+}
+
 static int
 emit_recursive_batch(igt_spin_t *spin,
 		     int fd, const struct igt_spin_factory *opts)
@@ -96,7 +148,7 @@ emit_recursive_batch(igt_spin_t *spin,
 #define BATCH IGT_SPIN_BATCH
 	const unsigned int devid = intel_get_drm_devid(fd);
 	const unsigned int gen = intel_gen(devid);
-	struct drm_i915_gem_relocation_entry relocs[3], *r;
+	struct drm_i915_gem_relocation_entry relocs[13], *r;
 	struct drm_i915_gem_execbuffer2 *execbuf;
 	struct drm_i915_gem_exec_object2 *obj;
 	unsigned int flags[GEM_MAX_ENGINES];
@@ -109,6 +161,10 @@ emit_recursive_batch(igt_spin_t *spin,
 
 	igt_assert(!(opts->ctx && opts->ctx_id));
 
+	/* Registers are addressed relative to the engine, requires gen11+ */
+	if (opts->timeout_ns)
+		igt_require(gen >= 11);
+
 	r = memset(relocs, 0, sizeof(relocs));
 	execbuf = memset(&spin->execbuf, 0, sizeof(spin->execbuf));
 	execbuf->rsvd1 = opts->ctx ? opts->ctx->id : opts->ctx_id;
@@ -278,6 +334,17 @@ emit_recursive_batch(igt_spin_t *spin,
 
 	spin->handle = obj[BATCH].handle;
 
+	if (opts->timeout_ns) {
+		/* store start timestamp */
+		*cs++ = MI_LOAD_REGISTER_IMM(1) | MI_LRI_LRM_CS_MMIO;
+		*cs++ = CS_GPR(SPIN_START_TS) + 4;
+		*cs++ = 0;
+		*cs++ = MI_LOAD_REGISTER_REG |
+			MI_LRI_LRM_CS_MMIO | MI_LRR_SOURCE_CS_MMIO;
+		*cs++ = CTX_TIMESTAMP;
+		*cs++ = CS_GPR(SPIN_START_TS);
+	}
+
 	igt_assert_lt(cs - spin->batch, LOOP_START_OFFSET / sizeof(*cs));
 	spin->condition = spin->batch + LOOP_START_OFFSET / sizeof(*cs);
 	cs = spin->condition;
@@ -291,6 +358,48 @@ emit_recursive_batch(igt_spin_t *spin,
 			*cs++ = 0xdeadbeef;
 	}
 
+	/*
+	 * Instead of relying on a timer thread calling igt_spin_end() let the
+	 * spinner compare its context runtime against the deadline and end
+	 * itself, the same way xe_spin does it.
+	 */
+	if (opts->timeout_ns) {
+		*cs++ = MI_LOAD_REGISTER_IMM(1) | MI_LRI_LRM_CS_MMIO;
+		*cs++ = CS_GPR(SPIN_NOW_TS) + 4;
+		*cs++ = 0;
+		*cs++ = MI_LOAD_REGISTER_REG |
+			MI_LRI_LRM_CS_MMIO | MI_LRR_SOURCE_CS_MMIO;
+		*cs++ = CTX_TIMESTAMP;
+		*cs++ = CS_GPR(SPIN_NOW_TS);
+
+		/* delta = now - start; inverted to match COND_BBE */
+		*cs++ = MI_MATH(4);
+		*cs++ = MI_MATH_LOAD(MI_MATH_REG_SRCA, MI_MATH_REG(SPIN_NOW_TS));
+		*cs++ = MI_MATH_LOAD(MI_MATH_REG_SRCB, MI_MATH_REG(SPIN_START_TS));
+		*cs++ = MI_MATH_SUB;
+		*cs++ = MI_MATH_STOREINV(MI_MATH_REG(SPIN_NOW_TS), MI_MATH_REG_ACCU);
+
+		/* Save delta for reading by COND_BBE */
+		*cs++ = MI_STORE_REGISTER_MEM_GEN8 | MI_LRI_LRM_CS_MMIO;
+		*cs++ = CS_GPR(SPIN_NOW_TS);
+		cs = emit_batch_addr(cs, spin->batch, &obj[BATCH], r++,
+				     SPIN_TS_DELTA_OFFSET);
+
+		/* Delay between SRM and COND_BBE to post the writes */
+		for (i = 0; i < 8; i++) {
+			*cs++ = MI_STORE_DWORD_IMM_GEN4;
+			cs = emit_batch_addr(cs, spin->batch, &obj[BATCH], r++,
+					     SPIN_TS_PAD_OFFSET);
+			*cs++ = 0;
+		}
+
+		/* Break if delta [time elapsed] > timeout */
+		*cs++ = MI_COND_BATCH_BUFFER_END | MI_DO_COMPARE | 2;
+		*cs++ = ~spin_ns_to_ctx_ticks(fd, opts->timeout_ns);
+		cs = emit_batch_addr(cs, spin->batch, &obj[BATCH], r++,
+				     SPIN_TS_DELTA_OFFSET);
+	}
+
 	/* Pad with a few nops so that we do not completely hog the system.
 	 *
 	 * Part of the attraction of using a recursive batch is that it is
@@ -303,7 +412,7 @@ emit_recursive_batch(igt_spin_t *spin,
 	 * trouble. See https://bugs.freedesktop.org/show_bug.cgi?id=102262
 	 */
 	if (!(opts->flags & IGT_SPIN_FAST))
-		cs += 960;
+		cs += opts->timeout_ns ? 896 : 960;
 
 	/*
 	 * When using a cmdparser, the batch is copied into a read only location
@@ -411,6 +520,10 @@ emit_recursive_batch(igt_spin_t *spin,
 	}
 
 	igt_assert_lt(cs - spin->batch, BATCH_SIZE / sizeof(*cs));
+	if (opts->timeout_ns)
+		igt_assert_lt(cs - spin->batch,
+			      SPIN_TS_DELTA_OFFSET / sizeof(*cs));
+	igt_assert(r - relocs <= ARRAY_SIZE(relocs));
 
 	/* Make it easier for callers to resubmit. */
 	for (i = 0; i < ARRAY_SIZE(spin->obj); i++) {
@@ -426,6 +539,114 @@ emit_recursive_batch(igt_spin_t *spin,
 	return fence_fd;
 }
 
+static bool spin_poolable(const struct igt_spin_factory *opts)
+{
+	return opts->flags & IGT_SPIN_POOL &&
+	       !(opts->flags & IGT_SPIN_INVALID_CS) &&
+	       !opts->dependency &&
+	       opts->engine != ALL_ENGINES;
+}
+
+static bool spin_pool_match(const igt_spin_t *spin, int fd,
+			    const struct igt_spin_factory *opts)
+{
+	const struct igt_spin_factory *o = &spin->opts;
+
+	return spin->fd == fd &&
+	       o->ctx == opts->ctx &&
+	       o->ctx_id == opts->ctx_id &&
+	       o->engine == opts->engine &&
+	       o->flags == opts->flags &&
+	       o->ahnd == opts->ahnd &&
+	       o->hwe == opts->hwe &&
+	       o->vm == opts->vm &&
+	       o->timeout_ns == opts->timeout_ns;
+}
+
+static int spin_restart(int fd, igt_spin_t *spin,
+			const struct igt_spin_factory *opts)
+{
+	struct drm_i915_gem_execbuffer2 *execbuf = &spin->execbuf;
+	int err;
+
+	igt_spin_reset(spin);
+
+	execbuf->flags &= ~(I915_EXEC_FENCE_IN | I915_EXEC_FENCE_SUBMIT);
+	execbuf->rsvd2 = 0;
+
+	if (opts->flags & IGT_SPIN_FENCE_IN && opts->fence != -1) {
+		execbuf->flags |= I915_EXEC_FENCE_IN;
+		execbuf->rsvd2 = opts->fence;
+	}
+
+	if (opts->flags & IGT_SPIN_FENCE_SUBMIT && opts->fence != -1) {
+		execbuf->flags |= I915_EXEC_FENCE_SUBMIT;
+		execbuf->rsvd2 = opts->fence;
+	}
+
+	err = __gem_execbuf_wr(fd, execbuf);
+	if (err)
+		return err;
+
+	if (opts->flags & IGT_SPIN_FENCE_OUT) {
+		spin->out_fence = execbuf->rsvd2 >> 32;
+		igt_assert(spin->out_fence >= 0);
+	}
+
+	return 0;
+}
+
+static void __igt_spin_free(int fd, igt_spin_t *spin);
+
+/*
+ * Takes an idle spinner created with matching options out of the pool and
+ * resubmits it, so we avoid creating, mapping and binding new objects.
+ */
+static igt_spin_t *spin_pool_get(int fd, const struct igt_spin_factory *opts)
+{
+	igt_spin_t *spin = NULL, *iter;
+	int err;
+
+	if (!spin_poolable(opts))
+		return NULL;
+
+	pthread_mutex_lock(&list_lock);
+	igt_list_for_each_entry(iter, &spin_pool, link) {
+		if (spin_pool_match(iter, fd, opts)) {
+			igt_list_del(&iter->link);
+			spin_pool_count--;
+			spin = iter;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&list_lock);
+
+	if (!spin)
+		return NULL;
+
+	if (spin->driver == INTEL_DRIVER_XE)
+		err = __xe_spin_restart(fd, spin);
+	else
+		err = spin_restart(fd, spin, opts);
+
+	/* Context might got banned in the meantime, fallback to new spinner */
+	if (err) {
+		igt_debug("Cannot reuse pooled spinner: %d\n", err);
+		if (spin->driver == INTEL_DRIVER_XE)
+			xe_spin_free(fd, spin);
+		else
+			__igt_spin_free(fd, spin);
+		return NULL;
+	}
+	spin->opts = *opts;
+
+	pthread_mutex_lock(&list_lock);
+	igt_list_add(&spin->link, &spin_list);
+	pthread_mutex_unlock(&list_lock);
+
+	return spin;
+}
+
 static igt_spin_t *
 spin_create(int fd, const struct igt_spin_factory *opts)
 {
@@ -435,6 +656,7 @@ spin_create(int fd, const struct igt_spin_factory *opts)
 	igt_assert(spin);
 
 	spin->driver = INTEL_DRIVER_I915;
+	spin->fd = fd;
 	spin->timerfd = -1;
 	spin->out_fence = emit_recursive_batch(spin, fd, opts);
 
@@ -448,9 +670,13 @@ spin_create(int fd, const struct igt_spin_factory *opts)
 igt_spin_t *
 __igt_spin_factory(int fd, const struct igt_spin_factory *opts)
 {
-	if (is_xe_device(fd)) {
-		igt_spin_t *spin;
+	igt_spin_t *spin;
 
+	spin = spin_pool_get(fd, opts);
+	if (spin)
+		return spin;
+
+	if (is_xe_device(fd)) {
 		spin = xe_spin_create(fd, opts);
 
 		pthread_mutex_lock(&list_lock);
@@ -472,6 +698,12 @@ __igt_spin_factory(int fd, const struct igt_spin_factory *opts)
  * contains the batch's handle that can be waited upon. The returned structure
  * must be passed to igt_spin_free() for post-processing.
  *
+ * With IGT_SPIN_POOL in @opts flags the spinner is returned to a per-fd pool
+ * on igt_spin_free() and recycled by the next factory call with the same
+ * options, instead of creating and destroying its objects each time. Pooled
+ * spinners must be released with igt_spin_pool_drain() before the context,
+ * allocator handle or @fd they were created with goes away.
+ *
  * Returns:
  * Structure with helper internal state for igt_spin_free().
  */
@@ -480,6 +712,10 @@ igt_spin_factory(int fd, const struct igt_spin_factory *opts)
 {
 	igt_spin_t *spin;
 
+	spin = spin_pool_get(fd, opts);
+	if (spin)
+		return spin;
+
 	if (is_xe_device(fd)) {
 		spin = xe_spin_create(fd, opts);
 
@@ -506,10 +742,11 @@ igt_spin_factory(int fd, const struct igt_spin_factory *opts)
 
 	spin = spin_create(fd, opts);
 
-	if (!(opts->flags & IGT_SPIN_INVALID_CS)) {
+	if (!(opts->flags & IGT_SPIN_INVALID_CS) && !opts->timeout_ns) {
 		/*
 		 * When injecting invalid CS into the batch, the spinner may
 		 * be killed immediately -- i.e. may already be completed!
+		 * Same applies to spinners timed by the GPU.
 		 */
 		igt_assert(gem_bo_busy(fd, spin->handle));
 		if (opts->flags & IGT_SPIN_FENCE_OUT) {
@@ -628,7 +865,7 @@ void igt_spin_end(igt_spin_t *spin)
 	}
 }
 
-static void __igt_spin_free(int fd, igt_spin_t *spin)
+static void spin_stop_timer(igt_spin_t *spin)
 {
 	if (spin->timerfd >= 0) {
 #ifdef ANDROID
@@ -643,7 +880,13 @@ static void __igt_spin_free(int fd, igt_spin_t *spin)
 #endif
 		igt_assert(pthread_join(spin->timer_thread, NULL) == 0);
 		close(spin->timerfd);
+		spin->timerfd = -1;
 	}
+}
+
+static void __igt_spin_free(int fd, igt_spin_t *spin)
+{
+	spin_stop_timer(spin);
 
 	igt_spin_end(spin);
 
@@ -676,8 +919,44 @@ static void __igt_spin_free(int fd, igt_spin_t *spin)
  * @spin: spin state from igt_spin_new()
  *
  * This function does the necessary post-processing after starting a
- * spin with igt_spin_new() and then frees it.
+ * spin with igt_spin_new() and then frees it. Spinners created with
+ * IGT_SPIN_POOL are ended, waited for and kept for reuse instead.
  */
+static bool spin_pool_put(int fd, igt_spin_t *spin)
+{
+	bool full;
+
+	if (!spin_poolable(&spin->opts))
+		return false;
+
+	pthread_mutex_lock(&list_lock);
+	full = spin_pool_count >= SPIN_POOL_MAX;
+	pthread_mutex_unlock(&list_lock);
+	if (full)
+		return false;
+
+	spin_stop_timer(spin);
+	igt_spin_end(spin);
+
+	if (spin->driver == INTEL_DRIVER_XE) {
+		igt_assert(syncobj_wait(fd, &spin->syncobj, 1, INT64_MAX,
+					0, NULL));
+	} else {
+		gem_sync(fd, spin->handle);
+		if (spin->out_fence >= 0) {
+			close(spin->out_fence);
+			spin->out_fence = -1;
+		}
+	}
+
+	pthread_mutex_lock(&list_lock);
+	igt_list_add(&spin->link, &spin_pool);
+	spin_pool_count++;
+	pthread_mutex_unlock(&list_lock);
+
+	return true;
+}
+
 void igt_spin_free(int fd, igt_spin_t *spin)
 {
 	if (!spin)
@@ -686,6 +965,9 @@ void igt_spin_free(int fd, igt_spin_t *spin)
 	igt_list_del(&spin->link);
 	pthread_mutex_unlock(&list_lock);
 
+	if (spin_pool_put(fd, spin))
+		return;
+
 	if (spin->driver == INTEL_DRIVER_XE)
 		xe_spin_free(fd, spin);
 	else
@@ -711,6 +993,37 @@ void igt_free_spins(int i915)
 		__igt_spin_free(i915, iter);
 	IGT_INIT_LIST_HEAD(&spin_list);
 	pthread_mutex_unlock(&list_lock);
+
+	igt_spin_pool_drain(i915);
+}
+
+/**
+ * igt_spin_pool_drain:
+ * @fd: open i915/xe drm file descriptor
+ *
+ * Frees idle spinners created with IGT_SPIN_POOL on @fd kept for reuse.
+ */
+void igt_spin_pool_drain(int fd)
+{
+	struct igt_spin *iter, *next;
+	IGT_LIST_HEAD(drain);
+
+	pthread_mutex_lock(&list_lock);
+	igt_list_for_each_entry_safe(iter, next, &spin_pool, link) {
+		if (iter->fd != fd)
+			continue;
+
+		igt_list_move(&iter->link, &drain);
+		spin_pool_count--;
+	}
+	pthread_mutex_unlock(&list_lock);
+
+	igt_list_for_each_entry_safe(iter, next, &drain, link) {
+		if (iter->driver == INTEL_DRIVER_XE)
+			xe_spin_free(fd, iter);
+		else
+			__igt_spin_free(fd, iter);
+	}
 }
 
 void igt_unshare_spins(void)
@@ -721,6 +1034,12 @@ void igt_unshare_spins(void)
 	igt_list_for_each_entry_safe(it, n, &spin_list, link)
 		IGT_INIT_LIST_HEAD(&it->link);
 	IGT_INIT_LIST_HEAD(&spin_list);
+
+	/* Pooled spinners belong to the parent, don't resubmit them */
+	igt_list_for_each_entry_safe(it, n, &spin_pool, link)
+		IGT_INIT_LIST_HEAD(&it->link);
+	IGT_INIT_LIST_HEAD(&spin_pool);
+	spin_pool_count = 0;
 }
 
 /**
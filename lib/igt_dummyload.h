@@ -43,6 +43,8 @@
  * @engine: Flags describing the engine to execute on
  * @flags: Set of IGT_SPIN_* flags
  * @fence: In-fence to wait on
+ * @timeout_ns: If non-zero the spinner ends itself after running for that
+ * many nanoseconds, timed by the GPU using context timestamp
  *
  * A factory struct which contains creation parameters for an igt_spin_t.
  */
@@ -57,6 +59,7 @@ typedef struct igt_spin_factory {
 	uint64_t ahnd;
 	struct drm_xe_engine_class_instance *hwe;
 	uint32_t vm;
+	uint64_t timeout_ns;
 } igt_spin_factory_t;
 
 typedef struct igt_spin {
@@ -95,6 +98,7 @@ typedef struct igt_spin {
 	uint32_t vm;
 	uint32_t syncobj;
 
+	int fd;
 } igt_spin_t;
 
 
@@ -107,6 +111,7 @@ typedef struct igt_spin {
 #define IGT_SPIN_INVALID_CS    (1 << 6)
 #define IGT_SPIN_USERPTR       (1 << 7)
 #define IGT_SPIN_SOFTDEP       (1 << 8)
+#define IGT_SPIN_POOL          (1 << 9)
 
 igt_spin_t *
 __igt_spin_factory(int fd, const igt_spin_factory_t *opts);
@@ -142,6 +147,7 @@ static inline void igt_spin_busywait_until_started(igt_spin_t *spin)
 void igt_terminate_spins(void);
 void igt_unshare_spins(void);
 void igt_free_spins(int i915);
+void igt_spin_pool_drain(int fd);
 
 struct intel_execution_engine2;
 
@@ -5,6 +5,8 @@
 
 #include <ctype.h>
 #include <libudev.h>
+#include <poll.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <sys/time.h>
 #include <time.h>
@@ -49,6 +51,17 @@ struct igt_facts_config igt_facts_config = {
 	.disable_udev = false,
 };
 
+/* What the last igt_facts() saw, to only rescan what changed since */
+static struct {
+	struct udev *udev;
+	struct udev_monitor *monitor;
+	bool rescan;
+	unsigned long taints;
+	uint64_t kmods_hash;
+} igt_facts_state = {
+	.rescan = true,
+};
+
 /**
  * igt_facts_lists_init:
  *
@@ -62,6 +75,9 @@ void igt_facts_lists_init(void)
 	IGT_INIT_LIST_HEAD(&igt_facts_list_kmod_head);
 	IGT_INIT_LIST_HEAD(&igt_facts_list_ktaint_head);
 	IGT_INIT_LIST_HEAD(&igt_facts_list_pci_gpu_head);
+
+	/* The lists are empty again, the next igt_facts() has to scan all */
+	igt_facts_state.rescan = true;
 }
 
 /**
@@ -571,7 +587,8 @@ out:
  *
  * This function scans for kernel taints using igt_kernel_tainted() and
  * igt_explain_taints(). It will cut off the explanation keeping only the
- * taint name.
+ * taint name. The list is left alone when the taint mask didn't change since
+ * the last scan.
  *
  * Returns: void
  */
@@ -588,6 +605,11 @@ static void igt_facts_scan_kernel_taints(const char *last_test)
 	 * taints = 0xFFFFFFFF;
 	 */
 
+	/* Taints are only ever added, the mask tells if any was */
+	if (!igt_facts_state.rescan && taints == igt_facts_state.taints)
+		return;
+	igt_facts_state.taints = taints;
+
 	igt_facts_list_mark(head);
 
 	while ((reason = igt_explain_taints(&taints))) {
@@ -610,16 +632,70 @@ static void igt_facts_scan_kernel_taints(const char *last_test)
 	igt_facts_list_sweep(head, last_test);
 }
 
+/**
+ * igt_facts_read_kmods:
+ * @loaded: bitmask of the loaded modules of igt_fact_kmod_list [out]
+ *
+ * This function reads /proc/modules once, unlike igt_kmod_is_loaded() for
+ * each module, and hashes the names of all the loaded modules.
+ *
+ * Returns: bool indicating if the loaded modules changed since the last call
+ */
+static bool igt_facts_read_kmods(unsigned long *loaded)
+{
+	uint64_t hash = 0xcbf29ce484222325ull; /* FNV-1a */
+	char *line = NULL;
+	size_t len = 0;
+	FILE *f;
+
+	*loaded = 0;
+
+	f = fopen("/proc/modules", "r");
+	if (!f) {
+		for (int i = 0; strcmp(igt_fact_kmod_list[i], "\0") != 0; i++)
+			if (igt_kmod_is_loaded(igt_fact_kmod_list[i]))
+				*loaded |= 1ul << i;
+
+		return true;
+	}
+
+	while (getline(&line, &len, f) > 0) {
+		char *end = strchr(line, ' ');
+
+		if (end)
+			*end = '\0';
+
+		for (const char *c = line; *c; c++)
+			hash = (hash ^ (uint8_t)*c) * 0x100000001b3ull;
+		hash = (hash ^ '\n') * 0x100000001b3ull;
+
+		for (int i = 0; strcmp(igt_fact_kmod_list[i], "\0") != 0; i++)
+			if (!strcmp(line, igt_fact_kmod_list[i]))
+				*loaded |= 1ul << i;
+	}
+	free(line);
+	fclose(f);
+
+	if (!igt_facts_state.rescan && hash == igt_facts_state.kmods_hash)
+		return false;
+
+	igt_facts_state.kmods_hash = hash;
+
+	return true;
+}
+
 /**
  * igt_facts_scan_kernel_loaded_kmods:
  * @last_test: name of the last test
+ * @loaded: bitmask of the loaded modules of igt_fact_kmod_list
  *
- * This function scans for loaded kmods using igt_fact_kmod_list and
- * igt_kmod_is_loaded().
+ * This function updates the loaded kmods facts from igt_fact_kmod_list and
+ * @loaded, as returned by igt_facts_read_kmods().
  *
  * Returns: void
  */
-static void igt_facts_scan_kernel_loaded_kmods(const char *last_test)
+static void igt_facts_scan_kernel_loaded_kmods(const char *last_test,
+					       unsigned long loaded)
 {
 	static struct igt_list_head *head = &igt_facts_list_kmod_head;
 	char *name = NULL;
@@ -629,7 +705,7 @@ static void igt_facts_scan_kernel_loaded_kmods(const char *last_test)
 	/* Iterate over igt_fact_kmod_list[] until the element contains "\0" */
 	for (int i = 0; strcmp(igt_fact_kmod_list[i], "\0") != 0; i++) {
 		asprintf(&name, "%s.%s", kmod_fact, igt_fact_kmod_list[i]);
-		if (igt_kmod_is_loaded(igt_fact_kmod_list[i]))
+		if (loaded & (1ul << i))
 			igt_facts_list_add(name, "true", last_test, head);
 
 		free(name);
@@ -638,20 +714,95 @@ static void igt_facts_scan_kernel_loaded_kmods(const char *last_test)
 	igt_facts_list_sweep(head, last_test);
 }
 
+/**
+ * igt_facts_devices_changed:
+ *
+ * This function drains the events of a udev monitor of the pci and drm
+ * subsystems, set up on the first call. Without a monitor, devices are
+ * assumed to always change.
+ *
+ * Returns: bool indicating if a pci or drm device was added, removed or
+ * changed since the last call
+ */
+static bool igt_facts_devices_changed(void)
+{
+	struct udev_monitor *monitor = igt_facts_state.monitor;
+	struct udev_device *dev;
+	struct pollfd pfd;
+	bool changed = false;
+
+	if (!monitor && !igt_facts_state.udev && !igt_facts_config.disable_udev) {
+		igt_facts_state.udev = udev_new();
+		if (igt_facts_state.udev)
+			monitor = udev_monitor_new_from_netlink(igt_facts_state.udev,
+								"udev");
+		if (monitor &&
+		    (udev_monitor_filter_add_match_subsystem_devtype(monitor,
+								     "pci",
+								     NULL) < 0 ||
+		     udev_monitor_filter_add_match_subsystem_devtype(monitor,
+								     "drm",
+								     NULL) < 0 ||
+		     udev_monitor_enable_receiving(monitor) < 0)) {
+			udev_monitor_unref(monitor);
+			monitor = NULL;
+		}
+		if (!monitor)
+			igt_debug("No udev monitor, rescanning devices every time\n");
+
+		igt_facts_state.monitor = monitor;
+		return true;
+	}
+
+	if (!monitor)
+		return true;
+
+	pfd.fd = udev_monitor_get_fd(monitor);
+	pfd.events = POLLIN;
+	while (poll(&pfd, 1, 0) > 0) {
+		changed = true;
+
+		/* The monitor is non-blocking, NULL when it dropped events */
+		dev = udev_monitor_receive_device(monitor);
+		if (!dev)
+			break;
+		udev_device_unref(dev);
+	}
+
+	return changed;
+}
+
 /**
  * igt_facts:
  * @last_test: name of the last test
  *
  * Call this function where you want to gather and report facts.
  *
+ * Only the first call scans everything. The next ones check what changed in
+ * between, cheaply enough to run after every test: the udev events of the pci
+ * and drm subsystems, the kernel taint mask and a hash of /proc/modules. The
+ * devices are rescanned on a udev event or when a module was loaded or
+ * unloaded, so that bindings are seen even without udev events.
+ *
  * Returns: void
  */
 void igt_facts(const char *last_test)
 {
-	igt_facts_scan_pci_gpus(last_test);
-	igt_facts_scan_pci_drm_cards(last_test);
+	unsigned long loaded;
+	bool kmods_changed;
+
+	kmods_changed = igt_facts_read_kmods(&loaded);
+
+	if (igt_facts_devices_changed() || kmods_changed ||
+	    igt_facts_state.rescan) {
+		igt_facts_scan_pci_gpus(last_test);
+		igt_facts_scan_pci_drm_cards(last_test);
+	}
 	igt_facts_scan_kernel_taints(last_test);
-	igt_facts_scan_kernel_loaded_kmods(last_test);
+	if (kmods_changed)
+		igt_facts_scan_kernel_loaded_kmods(last_test, loaded);
+
+	igt_facts_state.rescan = false;
 
 	fflush(stdout);
 	fflush(stderr);
@@ -755,6 +906,8 @@ static void igt_facts_test_mark_and_sweep(struct igt_list_head *head)
 void igt_facts_test(void)
 {
 	const char *last_test = "Unit Testing";
+	int kmods, ktaints;
+	unsigned long loaded;
 
 	igt_facts_lists_init();
 
@@ -780,4 +933,18 @@ void igt_facts_test(void)
 	/* Clean up the list and call igt_facts(). This should not crash */
 	igt_facts_list_mark_and_sweep(&igt_facts_list_pci_gpu_head);
 	igt_facts(last_test);
+
+	/* Nothing changed, a second call must keep the same facts */
+	kmods = igt_list_length(&igt_facts_list_kmod_head);
+	ktaints = igt_list_length(&igt_facts_list_ktaint_head);
+	igt_facts(last_test);
+	igt_assert_eq(igt_list_length(&igt_facts_list_kmod_head), kmods);
+	igt_assert_eq(igt_list_length(&igt_facts_list_ktaint_head), ktaints);
+	igt_assert(!igt_facts_read_kmods(&loaded));
+
+	/* After igt_facts_lists_init(), all is scanned again */
+	igt_facts_lists_init();
+	igt_facts(last_test);
+	igt_assert_eq(igt_list_length(&igt_facts_list_kmod_head), kmods);
+	igt_assert_eq(igt_list_length(&igt_facts_list_ktaint_head), ktaints);
 }
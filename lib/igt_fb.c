@@ -31,6 +31,7 @@
 #include <wchar.h>
 #include <inttypes.h>
 #include <pixman.h>
+#include <pthread.h>
 
 #include "drmtest.h"
 #include "i915/gem_create.h"
@@ -40,19 +41,23 @@
 #include "intel_pat.h"
 #include "igt_aux.h"
 #include "igt_color_encoding.h"
+#include "igt_draw.h"
 #include "igt_fb.h"
 #include "igt_halffloat.h"
 #include "igt_kms.h"
+#include "igt_list.h"
 #include "igt_matrix.h"
 #include "igt_vc4.h"
 #include "igt_amd.h"
 #include "igt_x86.h"
 #include "igt_nouveau.h"
 #include "igt_syncobj.h"
+#include "sw_sync.h"
 #include "ioctl_wrappers.h"
 #include "intel_batchbuffer.h"
 #include "intel_chipset.h"
 #include "intel_bufops.h"
+#include "surfaceformat.h"
 #include "xe/xe_ioctl.h"
 #include "xe/xe_query.h"
 
@@ -1084,10 +1089,183 @@ static void memset64(uint64_t *s, uint64_t c, size_t n)
 		s[i] = c;
 }
 
+/*
+ * Solid fills through the CPU have to go through a (possibly detiling,
+ * uncached or even remote) mapping of the whole buffer, which is slow for
+ * large fbs, especially on discrete parts. When the blitter can do the
+ * fill with a color blit we use that instead.
+ */
+static bool gpu_fill_disabled;
+
+/**
+ * igt_fb_set_gpu_fill:
+ * @enable: whether solid fills may use the blitter
+ *
+ * Solid color fills of Intel framebuffers are done with a color blit where
+ * the hardware supports it. This allows disabling that fast path so every
+ * fill goes through the CPU, e.g. to compare the cost of both. Enabled by
+ * default.
+ */
+void igt_fb_set_gpu_fill(bool enable)
+{
+	gpu_fill_disabled = !enable;
+}
+
+static bool gpu_fill_ok(const struct igt_fb *fb)
+{
+	uint32_t devid;
+
+	if (gpu_fill_disabled || !is_intel_device(fb->fd))
+		return false;
+
+	devid = intel_get_drm_devid(fb->fd);
+	if (intel_display_ver(devid) < 9)
+		return false;
+
+	if (!HAS_4TILE(devid) && !blt_has_xy_color(fb->fd))
+		return false;
+
+	for (int i = 0; i < fb->num_planes; i++)
+		if (fb->strides[i] > 32767 || fb->plane_height[i] > 32767)
+			return false;
+
+	switch (fb->modifier) {
+	case DRM_FORMAT_MOD_LINEAR:
+	case I915_FORMAT_MOD_X_TILED:
+		return true;
+	case I915_FORMAT_MOD_Y_TILED:
+		/* Y-tiled blits need BCS_SWCTRL, which only i915 lets us touch */
+		return !HAS_4TILE(devid) && is_i915_device(fb->fd);
+	case I915_FORMAT_MOD_4_TILED:
+		return HAS_4TILE(devid);
+	default:
+		return false;
+	}
+}
+
+static void gpu_fill_wait(const struct igt_fb *fb)
+{
+	int dmabuf;
+
+	if (is_i915_device(fb->fd)) {
+		gem_sync(fb->fd, fb->gem_handle);
+		return;
+	}
+
+	/* xe has no wait on a bo, the dma-buf sync waits for its fences */
+	dmabuf = prime_handle_to_fd(fb->fd, fb->gem_handle);
+	prime_sync_start(dmabuf, true);
+	prime_sync_end(dmabuf, true);
+	close(dmabuf);
+}
+
+static void gpu_fill_rect(struct buf_ops *bops, const struct igt_fb *fb,
+			  uint32_t tiling, unsigned int stride, int bpp,
+			  int y, int width, int height, uint64_t color)
+{
+	igt_draw_rect(fb->fd, bops, 0, fb->gem_handle, fb->size, stride,
+		      stride / (bpp / 8), y + height, tiling, IGT_DRAW_BLT,
+		      0, y, width, height, color, bpp);
+}
+
+/*
+ * Fill a fb with @r, @g, @b the same way cairo would. Only handles the
+ * formats cairo can paint directly, returns false if the fb must be painted
+ * through cairo.
+ */
+static bool gpu_fill_color(struct igt_fb *fb, double r, double g, double b)
+{
+	uint32_t r8, g8, b8, color;
+	struct buf_ops *bops;
+
+	if (!gpu_fill_ok(fb))
+		return false;
+
+	/* same rounding as cairo's double to 16 bit color conversion */
+	r8 = (uint16_t)(clamp(r, 0.0, 1.0) * (65536.0 - 1e-5)) >> 8;
+	g8 = (uint16_t)(clamp(g, 0.0, 1.0) * (65536.0 - 1e-5)) >> 8;
+	b8 = (uint16_t)(clamp(b, 0.0, 1.0) * (65536.0 - 1e-5)) >> 8;
+
+	switch (fb->drm_format) {
+	case DRM_FORMAT_XRGB8888:
+	case DRM_FORMAT_ARGB8888:
+		color = 0xff000000 | r8 << 16 | g8 << 8 | b8;
+		break;
+	case DRM_FORMAT_XBGR8888:
+	case DRM_FORMAT_ABGR8888:
+		color = 0xff000000 | b8 << 16 | g8 << 8 | r8;
+		break;
+	case DRM_FORMAT_RGB565:
+		color = (r8 >> 3) << 11 | (g8 >> 2) << 5 | b8 >> 3;
+		break;
+	default:
+		return false;
+	}
+
+	bops = buf_ops_create(fb->fd);
+	gpu_fill_rect(bops, fb, igt_fb_mod_to_tiling(fb->modifier),
+		      fb->strides[0], fb->plane_bpp[0],
+		      0, fb->width, fb->height, color);
+	buf_ops_destroy(bops);
+
+	gpu_fill_wait(fb);
+
+	return true;
+}
+
+struct yuv_clear_plane {
+	uint64_t value;
+	int bpp;
+};
+
+/*
+ * The clear value is the same for every pixel of a plane, so the plane can
+ * be filled as a linear surface regardless of its tiling.
+ */
+static bool gpu_clear_yuv(struct igt_fb *fb,
+			  const struct yuv_clear_plane *clear,
+			  const size_t *plane_size)
+{
+	struct buf_ops *bops;
+
+	if (!gpu_fill_ok(fb))
+		return false;
+
+	for (int i = 0; i < fb->num_planes; i++) {
+		unsigned int rows = plane_size[i] / fb->strides[i];
+
+		if (fb->offsets[i] % fb->strides[i] ||
+		    fb->offsets[i] / fb->strides[i] + rows > 32767)
+			return false;
+	}
+
+	bops = buf_ops_create(fb->fd);
+	for (int i = 0; i < fb->num_planes; i++) {
+		uint64_t value = clear[i].value;
+		int bpp = clear[i].bpp;
+
+		if (bpp == 8) {
+			value *= 0x01010101;
+			bpp = 32;
+		}
+
+		gpu_fill_rect(bops, fb, I915_TILING_NONE, fb->strides[i], bpp,
+			      fb->offsets[i] / fb->strides[i],
+			      fb->strides[i] / (bpp / 8),
+			      plane_size[i] / fb->strides[i], value);
+	}
+	buf_ops_destroy(bops);
+
+	gpu_fill_wait(fb);
+
+	return true;
+}
+
 static void clear_yuv_buffer(struct igt_fb *fb)
 {
 	bool full_range = fb->color_range == IGT_COLOR_YCBCR_FULL_RANGE;
 	int num_planes = lookup_drm_format(fb->drm_format)->num_planes;
+	struct yuv_clear_plane clear[num_planes];
 	size_t plane_size[num_planes];
 	void *ptr;
 
@@ -1104,81 +1282,92 @@ static void clear_yuv_buffer(struct igt_fb *fb)
 			ALIGN(fb->plane_height[i], tile_height);
 	}
 
-	/* Ensure the framebuffer is preallocated */
-	ptr = igt_fb_map_buffer(fb->fd, fb);
-	igt_assert(*(uint32_t *)ptr == 0);
-
 	switch (fb->drm_format) {
 	case DRM_FORMAT_NV12:
-		memset(ptr + fb->offsets[0],
-		       full_range ? 0x00 : 0x10,
-		       plane_size[0]);
-		memset(ptr + fb->offsets[1],
-		       0x80,
-		       plane_size[1]);
+	case DRM_FORMAT_NV16:
+	case DRM_FORMAT_NV21:
+	case DRM_FORMAT_NV61:
+		clear[0] = (struct yuv_clear_plane){ full_range ? 0x00 : 0x10, 8 };
+		clear[1] = (struct yuv_clear_plane){ 0x80, 8 };
 		break;
 	case DRM_FORMAT_XYUV8888:
-		wmemset(ptr + fb->offsets[0], full_range ? 0x00008080 : 0x00108080,
-			plane_size[0] / sizeof(wchar_t));
+		clear[0] = (struct yuv_clear_plane){
+			full_range ? 0x00008080 : 0x00108080, 32 };
 		break;
 	case DRM_FORMAT_YUYV:
 	case DRM_FORMAT_YVYU:
-		wmemset(ptr + fb->offsets[0],
-			full_range ? 0x80008000 : 0x80108010,
-			plane_size[0] / sizeof(wchar_t));
+		clear[0] = (struct yuv_clear_plane){
+			full_range ? 0x80008000 : 0x80108010, 32 };
 		break;
 	case DRM_FORMAT_UYVY:
 	case DRM_FORMAT_VYUY:
-		wmemset(ptr + fb->offsets[0],
-			full_range ? 0x00800080 : 0x10801080,
-			plane_size[0] / sizeof(wchar_t));
+		clear[0] = (struct yuv_clear_plane){
+			full_range ? 0x00800080 : 0x10801080, 32 };
 		break;
 	case DRM_FORMAT_P010:
 	case DRM_FORMAT_P012:
 	case DRM_FORMAT_P016:
-		wmemset(ptr, full_range ? 0 : 0x10001000,
-			plane_size[0] / sizeof(wchar_t));
-		wmemset(ptr + fb->offsets[1], 0x80008000,
-			plane_size[1] / sizeof(wchar_t));
+		clear[0] = (struct yuv_clear_plane){
+			full_range ? 0 : 0x10001000, 32 };
+		clear[1] = (struct yuv_clear_plane){ 0x80008000, 32 };
 		break;
 	case DRM_FORMAT_Y210:
 	case DRM_FORMAT_Y212:
 	case DRM_FORMAT_Y216:
-		wmemset(ptr + fb->offsets[0],
-			full_range ? 0x80000000 : 0x80001000,
-			plane_size[0] / sizeof(wchar_t));
+		clear[0] = (struct yuv_clear_plane){
+			full_range ? 0x80000000 : 0x80001000, 32 };
 		break;
 
 	case DRM_FORMAT_XVYU2101010:
 	case DRM_FORMAT_Y410:
-		wmemset(ptr + fb->offsets[0],
-			full_range ? 0x20000200 : 0x20010200,
-			plane_size[0] / sizeof(wchar_t));
+		clear[0] = (struct yuv_clear_plane){
+			full_range ? 0x20000200 : 0x20010200, 32 };
 		break;
 
 	case DRM_FORMAT_XVYU12_16161616:
 	case DRM_FORMAT_XVYU16161616:
 	case DRM_FORMAT_Y412:
 	case DRM_FORMAT_Y416:
-		memset64(ptr + fb->offsets[0],
-			 full_range ? 0x800000008000ULL : 0x800010008000ULL,
-			 plane_size[0] / sizeof(uint64_t));
+		clear[0] = (struct yuv_clear_plane){
+			full_range ? 0x800000008000ULL : 0x800010008000ULL, 64 };
 		break;
 	case DRM_FORMAT_YUV420:
 	case DRM_FORMAT_YUV422:
 	case DRM_FORMAT_YVU420:
 	case DRM_FORMAT_YVU422:
 		igt_assert(ARRAY_SIZE(plane_size) == 3);
-		memset(ptr + fb->offsets[0],
-		       full_range ? 0x00 : 0x10,
-		       plane_size[0]);
-		memset(ptr + fb->offsets[1],
-		       0x80,
-		       plane_size[1]);
-		memset(ptr + fb->offsets[2],
-		       0x80,
-		       plane_size[2]);
+		clear[0] = (struct yuv_clear_plane){ full_range ? 0x00 : 0x10, 8 };
+		clear[1] = (struct yuv_clear_plane){ 0x80, 8 };
+		clear[2] = (struct yuv_clear_plane){ 0x80, 8 };
 		break;
+	default:
+		igt_assert_f(0, "Clearing %s is not supported\n",
+			     igt_format_str(fb->drm_format));
+	}
+
+	if (gpu_clear_yuv(fb, clear, plane_size))
+		return;
+
+	/* Ensure the framebuffer is preallocated */
+	ptr = igt_fb_map_buffer(fb->fd, fb);
+	igt_assert(*(uint32_t *)ptr == 0);
+
+	for (int i = 0; i < num_planes; i++) {
+		void *plane = ptr + fb->offsets[i];
+
+		switch (clear[i].bpp) {
+		case 8:
+			memset(plane, clear[i].value, plane_size[i]);
+			break;
+		case 32:
+			wmemset(plane, clear[i].value,
+				plane_size[i] / sizeof(wchar_t));
+			break;
+		case 64:
+			memset64(plane, clear[i].value,
+				 plane_size[i] / sizeof(uint64_t));
+			break;
+		}
 	}
 
 	igt_fb_unmap_buffer(fb, ptr);
@@ -1462,60 +1651,328 @@ static uint16_t update_crc16_dp(uint16_t crc_old, uint16_t d)
 	return crc_new;
 }
 
+/*
+ * update_crc16_dp() computes F(crc_old ^ d) for a linear map F over GF(2),
+ * so a two table (high and low byte) lookup of F gives the same result
+ * without walking the individual bits.
+ */
+static uint16_t crc16_dp_table[2][256];
+static pthread_once_t crc16_dp_once = PTHREAD_ONCE_INIT;
+
+static void crc16_dp_init_table(void)
+{
+	for (int i = 0; i < 256; i++) {
+		crc16_dp_table[0][i] = update_crc16_dp(0, i << 8);
+		crc16_dp_table[1][i] = update_crc16_dp(0, i);
+	}
+}
+
+static inline uint16_t crc16_dp(uint16_t crc, uint16_t d)
+{
+	uint16_t x = crc ^ d;
+
+	return crc16_dp_table[0][x >> 8] ^ crc16_dp_table[1][x & 0xff];
+}
+
+/*
+ * A 16x16 matrix over GF(2), stored as the images of the unit vectors,
+ * used to advance a CRC over a run of data words. Since the CRC is linear
+ * the CRC of two consecutive runs is F^n(crc(first)) ^ crc(second), where
+ * n is the number of words in the second run and both CRCs start at 0.
+ */
+struct crc16_dp_matrix {
+	uint16_t col[16];
+};
+
+static uint16_t crc16_dp_matrix_apply(const struct crc16_dp_matrix *m,
+				      uint16_t v)
+{
+	uint16_t ret = 0;
+
+	for (int i = 0; v; i++, v >>= 1)
+		if (v & 1)
+			ret ^= m->col[i];
+
+	return ret;
+}
+
+static struct crc16_dp_matrix
+crc16_dp_matrix_mul(const struct crc16_dp_matrix *a,
+		    const struct crc16_dp_matrix *b)
+{
+	struct crc16_dp_matrix ret;
+
+	for (int i = 0; i < 16; i++)
+		ret.col[i] = crc16_dp_matrix_apply(a, b->col[i]);
+
+	return ret;
+}
+
+/* F^n, the effect of n data words on the previous CRC value */
+static struct crc16_dp_matrix crc16_dp_matrix_pow(uint64_t n)
+{
+	struct crc16_dp_matrix ret, f;
+
+	for (int i = 0; i < 16; i++) {
+		ret.col[i] = 1 << i;
+		f.col[i] = crc16_dp(1 << i, 0);
+	}
+
+	for (; n; n >>= 1) {
+		if (n & 1)
+			ret = crc16_dp_matrix_mul(&f, &ret);
+		f = crc16_dp_matrix_mul(&f, &f);
+	}
+
+	return ret;
+}
+
+/* Number of significant bits per color component of the format */
+static int fb_crc_component_bits(uint32_t drm_format)
+{
+	switch (drm_format) {
+	case DRM_FORMAT_XRGB2101010:
+	case DRM_FORMAT_ARGB2101010:
+	case DRM_FORMAT_XBGR2101010:
+	case DRM_FORMAT_ABGR2101010:
+	case DRM_FORMAT_P010:
+	case DRM_FORMAT_Y210:
+	case DRM_FORMAT_Y410:
+	case DRM_FORMAT_XVYU2101010:
+		return 10;
+	case DRM_FORMAT_P012:
+	case DRM_FORMAT_Y212:
+	case DRM_FORMAT_Y412:
+	case DRM_FORMAT_XVYU12_16161616:
+		return 12;
+	case DRM_FORMAT_P016:
+	case DRM_FORMAT_Y216:
+	case DRM_FORMAT_Y416:
+	case DRM_FORMAT_XVYU16161616:
+	case DRM_FORMAT_XRGB16161616:
+	case DRM_FORMAT_ARGB16161616:
+	case DRM_FORMAT_XBGR16161616:
+	case DRM_FORMAT_ABGR16161616:
+	case DRM_FORMAT_XRGB16161616F:
+	case DRM_FORMAT_ARGB16161616F:
+	case DRM_FORMAT_XBGR16161616F:
+	case DRM_FORMAT_ABGR16161616F:
+		return 16;
+	default:
+		return 8;
+	}
+}
+
+struct fb_crc_band {
+	pthread_t thread;
+	const uint8_t *data;
+	unsigned int stride;
+	int width, height;
+	/* byte index of R, G and B for 32bpp rgb, or the cairo format */
+	const int *rgb_idx;
+	cairo_format_t cairo_format;
+	int bits;
+	/* read each row through a bounce buffer, for WC/GTT mappings */
+	bool slow_reads;
+	uint16_t crc[3];
+};
+
+static inline uint16_t fb_crc_float_word(float v, int bits)
+{
+	uint32_t max = (1u << bits) - 1;
+
+	v = v < 0.f ? 0.f : v > 1.f ? 1.f : v;
+
+	return (uint16_t)(v * max + .5f) << (16 - bits);
+}
+
+static void *fb_crc_band(void *arg)
+{
+	struct fb_crc_band *band = arg;
+	uint16_t r = 0, g = 0, b = 0;
+	uint8_t *bounce = NULL;
+
+	if (band->slow_reads) {
+		bounce = malloc(band->width * 4);
+		igt_assert(bounce);
+	}
+
+	for (int y = 0; y < band->height; y++) {
+		const uint8_t *row = band->data + y * band->stride;
+
+		if (bounce) {
+			igt_memcpy_from_wc(bounce, row, band->width * 4);
+			row = bounce;
+		}
+
+		for (int x = 0; x < band->width; x++) {
+			uint16_t dr, dg, db;
+
+			if (band->rgb_idx) {
+				const uint8_t *p = row + x * 4;
+
+				/* the lsbs are zero padded */
+				dr = p[band->rgb_idx[0]] << 8;
+				dg = p[band->rgb_idx[1]] << 8;
+				db = p[band->rgb_idx[2]] << 8;
+			} else if (band->cairo_format == CAIRO_FORMAT_RGB30) {
+				uint32_t p = ((const uint32_t *)row)[x];
+
+				dr = ((p >> 20) & 0x3ff) << 6;
+				dg = ((p >> 10) & 0x3ff) << 6;
+				db = (p & 0x3ff) << 6;
+			} else {
+				const float *p = (const float *)row +
+					x * (band->cairo_format == CAIRO_FORMAT_RGB96F ? 3 : 4);
+
+				dr = fb_crc_float_word(p[0], band->bits);
+				dg = fb_crc_float_word(p[1], band->bits);
+				db = fb_crc_float_word(p[2], band->bits);
+			}
+
+			r = crc16_dp(r, dr);
+			g = crc16_dp(g, dg);
+			b = crc16_dp(b, db);
+		}
+	}
+
+	band->crc[0] = r;
+	band->crc[1] = g;
+	band->crc[2] = b;
+
+	free(bounce);
+
+	return NULL;
+}
+
+#define FB_CRC_MAX_THREADS 8
+
+static void fb_calc_crc(const struct fb_crc_band *tmpl, igt_crc_t *crc)
+{
+	struct fb_crc_band bands[FB_CRC_MAX_THREADS];
+	struct crc16_dp_matrix advance;
+	int num_bands, band_height, i;
+
+	num_bands = min_t(long, max_t(long, sysconf(_SC_NPROCESSORS_ONLN), 1),
+			  FB_CRC_MAX_THREADS);
+	num_bands = min(num_bands, max(tmpl->height, 1));
+	if ((int64_t)tmpl->width * tmpl->height < 512 * 512)
+		num_bands = 1;
+
+	band_height = DIV_ROUND_UP(tmpl->height, num_bands);
+	num_bands = max(DIV_ROUND_UP(tmpl->height, band_height), 1);
+
+	for (i = 0; i < num_bands; i++) {
+		bands[i] = *tmpl;
+		bands[i].data = tmpl->data + (size_t)i * band_height * tmpl->stride;
+		bands[i].height = min(band_height, tmpl->height - i * band_height);
+
+		if (i == 0 || pthread_create(&bands[i].thread, NULL,
+					     fb_crc_band, &bands[i]))
+			bands[i].thread = 0;
+	}
+
+	fb_crc_band(&bands[0]);
+	for (i = 1; i < num_bands; i++) {
+		if (bands[i].thread)
+			pthread_join(bands[i].thread, NULL);
+		else
+			fb_crc_band(&bands[i]);
+	}
+
+	/* all full bands have the same length, only the last one may differ */
+	advance = crc16_dp_matrix_pow((uint64_t)band_height * tmpl->width);
+	for (i = 1; i < num_bands; i++) {
+		struct crc16_dp_matrix m = advance;
+
+		if (bands[i].height != band_height)
+			m = crc16_dp_matrix_pow((uint64_t)bands[i].height * tmpl->width);
+
+		for (int c = 0; c < 3; c++)
+			bands[0].crc[c] = crc16_dp_matrix_apply(&m, bands[0].crc[c]) ^
+					  bands[i].crc[c];
+	}
+
+	crc->crc[0] = bands[0].crc[0];
+	crc->crc[1] = bands[0].crc[1];
+	crc->crc[2] = bands[0].crc[2];
+}
+
 /**
  * igt_fb_calc_crc:
  * @fb: pointer to an #igt_fb structure
  * @crc: pointer to an #igt_crc_t structure
  *
  * This function calculate the 16-bit frame CRC of RGB components over all
- * the active pixels.
+ * the active pixels, as specified for DisplayPort.
+ *
+ * 32bpp RGB formats are read directly from the buffer, all other formats
+ * are first converted to RGB with the precision of the format. Each color
+ * component is shifted in MSB first, with the LSBs zero padded to 16 bits.
  */
 void igt_fb_calc_crc(struct igt_fb *fb, igt_crc_t *crc)
 {
-	int x, y, i;
-	void *ptr;
-	uint8_t *data;
-	uint16_t din;
+	static const int xrgb_idx[3] = { 2, 1, 0 };
+	static const int xbgr_idx[3] = { 0, 1, 2 };
+	struct fb_crc_band tmpl = {
+		.width = fb->width,
+		.height = fb->height,
+		.bits = fb_crc_component_bits(fb->drm_format),
+	};
+	cairo_surface_t *surface = NULL;
+	void *ptr = NULL;
 
 	igt_assert(fb && crc);
 
-	ptr = igt_fb_map_buffer(fb->fd, fb);
-	igt_assert(ptr);
+	pthread_once(&crc16_dp_once, crc16_dp_init_table);
 
 	/* set for later CRC comparison */
 	crc->has_valid_frame = true;
 	crc->frame = 0;
 	crc->n_words = 3;
-	crc->crc[0] = 0;	/* R */
-	crc->crc[1] = 0;	/* G */
-	crc->crc[2] = 0;	/* B */
-
-	data = ptr + fb->offsets[0];
-	for (y = 0; y < fb->height; ++y) {
-		for (x = 0; x < fb->width; ++x) {
-			switch (fb->drm_format) {
-			case DRM_FORMAT_XRGB8888:
-				i = x * 4 + y * fb->strides[0];
-
-				din = data[i + 2] << 8; /* padding-zeros */
-				crc->crc[0] = update_crc16_dp(crc->crc[0], din);
-
-				/* Green-component */
-				din = data[i + 1] << 8;
-				crc->crc[1] = update_crc16_dp(crc->crc[1], din);
-
-				/* Blue-component */
-				din = data[i] << 8;
-				crc->crc[2] = update_crc16_dp(crc->crc[2], din);
-				break;
-			default:
-				igt_assert_f(0, "DRM Format Invalid");
-				break;
-			}
-		}
+
+	switch (fb->drm_format) {
+	case DRM_FORMAT_XRGB8888:
+	case DRM_FORMAT_ARGB8888:
+	case DRM_FORMAT_XBGR8888:
+	case DRM_FORMAT_ABGR8888:
+		ptr = igt_fb_map_buffer(fb->fd, fb);
+		igt_assert(ptr);
+
+		tmpl.data = ptr + fb->offsets[0];
+		tmpl.stride = fb->strides[0];
+		tmpl.slow_reads = is_intel_device(fb->fd);
+		tmpl.rgb_idx = (fb->drm_format == DRM_FORMAT_XRGB8888 ||
+				fb->drm_format == DRM_FORMAT_ARGB8888) ?
+			xrgb_idx : xbgr_idx;
+		break;
+	default:
+		igt_assert_f(lookup_drm_format(fb->drm_format),
+			     "DRM Format Invalid");
+
+		surface = igt_get_cairo_surface(fb->fd, fb);
+		cairo_surface_flush(surface);
+
+		tmpl.data = cairo_image_surface_get_data(surface);
+		tmpl.stride = cairo_image_surface_get_stride(surface);
+		tmpl.cairo_format = cairo_image_surface_get_format(surface);
+		if (tmpl.cairo_format == CAIRO_FORMAT_RGB24 ||
+		    tmpl.cairo_format == CAIRO_FORMAT_ARGB32)
+			tmpl.rgb_idx = xrgb_idx;
+		igt_assert_f(tmpl.rgb_idx ||
+			     tmpl.cairo_format == CAIRO_FORMAT_RGB30 ||
+			     tmpl.cairo_format == CAIRO_FORMAT_RGB96F ||
+			     tmpl.cairo_format == CAIRO_FORMAT_RGBA128F,
+			     "DRM Format Invalid");
+		break;
 	}
 
-	igt_fb_unmap_buffer(fb, ptr);
+	fb_calc_crc(&tmpl, crc);
+
+	if (ptr)
+		igt_fb_unmap_buffer(fb, ptr);
+	if (surface)
+		cairo_surface_destroy(surface);
 }
 
 /**
@@ -2040,6 +2497,184 @@ cairo_surface_t *igt_cairo_image_surface_create_from_png(const char *filename)
 	return image;
 }
 
+/*
+ * Cache of the decoded png images, and of their copies scaled to the sizes
+ * they get painted at, so that tests painting the same image into many fbs
+ * decode and scale it once per process. The least recently used images are
+ * dropped when the cache grows beyond its budget.
+ */
+struct fb_image_cache_entry {
+	struct igt_list_head link;
+	char *filename;
+	/* 0 for the image as decoded */
+	int width, height;
+	cairo_surface_t *image;
+	size_t size;
+};
+
+static struct {
+	struct igt_list_head lru;
+	size_t size;
+	size_t max_size;
+	bool init;
+} image_cache = {
+	.lru = { &image_cache.lru, &image_cache.lru },
+};
+
+#define FB_IMAGE_CACHE_DEFAULT_MB	128
+#define FB_IMAGE_CACHE_MAX_MB		1024
+
+static void image_cache_evict(size_t max_size)
+{
+	struct fb_image_cache_entry *e, *tmp;
+
+	igt_list_for_each_entry_safe_reverse(e, tmp, &image_cache.lru, link) {
+		if (image_cache.size <= max_size)
+			break;
+
+		igt_list_del(&e->link);
+		image_cache.size -= e->size;
+		cairo_surface_destroy(e->image);
+		free(e->filename);
+		free(e);
+	}
+}
+
+static void image_cache_init(void)
+{
+	const char *env;
+
+	if (image_cache.init)
+		return;
+
+	image_cache.init = true;
+	image_cache.max_size = (size_t)FB_IMAGE_CACHE_DEFAULT_MB << 20;
+
+	env = getenv("IGT_FB_IMAGE_CACHE_MB");
+	if (env)
+		image_cache.max_size = (size_t)clamp(atoi(env), 0,
+						     FB_IMAGE_CACHE_MAX_MB) << 20;
+}
+
+/**
+ * igt_fb_set_image_cache_size:
+ * @size: memory budget of the cache in bytes, 0 to disable it
+ *
+ * igt_paint_image() and igt_create_image_fb() keep the png images they
+ * decode, and the copies of them scaled to the painted sizes, so that an
+ * image is only decoded and scaled once. The least recently used images are
+ * dropped when the cache grows beyond @size.
+ *
+ * The budget is 128MiB by default, it can also be set by the
+ * IGT_FB_IMAGE_CACHE_MB environment variable, in MiB.
+ */
+void igt_fb_set_image_cache_size(size_t size)
+{
+	image_cache_init();
+
+	image_cache.max_size = size;
+	image_cache_evict(size);
+}
+
+static cairo_surface_t *image_cache_lookup(const char *filename,
+					   int width, int height)
+{
+	struct fb_image_cache_entry *e;
+
+	igt_list_for_each_entry(e, &image_cache.lru, link) {
+		if (e->width != width || e->height != height ||
+		    strcmp(e->filename, filename))
+			continue;
+
+		igt_list_move(&e->link, &image_cache.lru);
+		return e->image;
+	}
+
+	return NULL;
+}
+
+static void image_cache_add(const char *filename, int width, int height,
+			    cairo_surface_t *image)
+{
+	struct fb_image_cache_entry *e;
+	size_t size;
+
+	size = (size_t)cairo_image_surface_get_stride(image) *
+		cairo_image_surface_get_height(image);
+	if (size > image_cache.max_size)
+		return;
+
+	e = calloc(1, sizeof(*e));
+	igt_assert(e);
+
+	e->filename = strdup(filename);
+	igt_assert(e->filename);
+	e->width = width;
+	e->height = height;
+	e->image = cairo_surface_reference(image);
+	e->size = size;
+
+	image_cache_evict(image_cache.max_size - size);
+	igt_list_add(&e->link, &image_cache.lru);
+	image_cache.size += size;
+}
+
+/*
+ * Returns a reference to the image of @filename, scaled to @width x @height
+ * the way igt_paint_image() would paint it, or as decoded if @width is 0.
+ */
+static cairo_surface_t *image_cache_get(const char *filename,
+					int width, int height)
+{
+	cairo_surface_t *image, *decoded;
+	cairo_t *cr;
+
+	image_cache_init();
+
+	image = image_cache_lookup(filename, width, height);
+	if (image)
+		return cairo_surface_reference(image);
+
+	if (!width) {
+		image = igt_cairo_image_surface_create_from_png(filename);
+		igt_assert(cairo_surface_status(image) == CAIRO_STATUS_SUCCESS);
+	} else {
+		decoded = image_cache_get(filename, 0, 0);
+
+		image = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
+						   width, height);
+		cr = cairo_create(image);
+		cairo_scale(cr,
+			    (double)width / cairo_image_surface_get_width(decoded),
+			    (double)height / cairo_image_surface_get_height(decoded));
+		cairo_set_source_surface(cr, decoded, 0, 0);
+		cairo_paint(cr);
+		igt_assert(cairo_status(cr) == CAIRO_STATUS_SUCCESS);
+		cairo_destroy(cr);
+
+		cairo_surface_destroy(decoded);
+	}
+
+	if (image_cache.max_size)
+		image_cache_add(filename, width, height, image);
+
+	return image;
+}
+
+/*
+ * A scaled copy painted 1:1 only matches painting the image scaled when
+ * the destination is lined up with the pixels.
+ */
+static bool paint_unscaled_ok(cairo_t *cr)
+{
+	cairo_matrix_t m;
+
+	cairo_get_matrix(cr, &m);
+
+	return m.xx == 1.0 && m.yy == 1.0 && m.xy == 0.0 && m.yx == 0.0 &&
+	       m.x0 == floor(m.x0) && m.y0 == floor(m.y0);
+}
+
 /**
  * igt_paint_image:
  * @cr: cairo drawing context
@@ -2050,7 +2685,8 @@ cairo_surface_t *igt_cairo_image_surface_create_from_png(const char *filename)
  * @dst_height: height of the destination rectangle
  *
  * This function can be used to draw a scaled version of the supplied png image,
- * which is loaded from the package data directory.
+ * which is loaded from the package data directory. The decoded and scaled
+ * images are cached, see igt_fb_set_image_cache_size().
  */
 void igt_paint_image(cairo_t *cr, const char *filename,
 		     int dst_x, int dst_y, int dst_width, int dst_height)
@@ -2059,12 +2695,20 @@ void igt_paint_image(cairo_t *cr, const char *filename,
 	int img_width, img_height;
 	double scale_x, scale_y;
 
-	image = igt_cairo_image_surface_create_from_png(filename);
-	igt_assert(cairo_surface_status(image) == CAIRO_STATUS_SUCCESS);
+	image = image_cache_get(filename, 0, 0);
 
 	img_width = cairo_image_surface_get_width(image);
 	img_height = cairo_image_surface_get_height(image);
 
+	if ((dst_width != img_width || dst_height != img_height) &&
+	    dst_width > 0 && dst_height > 0 && image_cache.max_size &&
+	    paint_unscaled_ok(cr)) {
+		cairo_surface_destroy(image);
+		image = image_cache_get(filename, dst_width, dst_height);
+		img_width = dst_width;
+		img_height = dst_height;
+	}
+
 	scale_x = (double)dst_width / img_width;
 	scale_y = (double)dst_height / img_height;
 
@@ -2172,6 +2816,199 @@ unsigned int igt_create_fb(int fd, int width, int height, uint32_t format,
 					  fb, 0, 0);
 }
 
+/*
+ * Cache of the rendered contents of the color and pattern fbs. The key is
+ * the parameters of the painting plus the pixel format, since the initial
+ * contents of a freshly created fb depend on it. The modifier doesn't
+ * matter as the drawing always happens on a linear cairo image.
+ */
+enum fb_pattern {
+	FB_PATTERN_COLOR,
+	FB_PATTERN_TEST,
+	FB_PATTERN_COLOR_TEST,
+};
+
+struct fb_pattern_cache_entry {
+	struct igt_list_head link;
+	int width, height;
+	uint32_t drm_format;
+	enum fb_pattern pattern;
+	double r, g, b;
+	cairo_surface_t *image;
+	size_t size;
+};
+
+static struct {
+	struct igt_list_head lru;
+	size_t size;
+	size_t max_size;
+	bool init;
+	unsigned long hits, misses;
+} pattern_cache = {
+	.lru = { &pattern_cache.lru, &pattern_cache.lru },
+};
+
+#define FB_PATTERN_CACHE_MAX_MB 1024
+
+static void pattern_cache_evict(size_t max_size)
+{
+	struct fb_pattern_cache_entry *e, *tmp;
+
+	igt_list_for_each_entry_safe_reverse(e, tmp, &pattern_cache.lru, link) {
+		if (pattern_cache.size <= max_size)
+			break;
+
+		igt_list_del(&e->link);
+		pattern_cache.size -= e->size;
+		cairo_surface_destroy(e->image);
+		free(e);
+	}
+}
+
+static void pattern_cache_init(void)
+{
+	const char *env;
+
+	if (pattern_cache.init)
+		return;
+
+	pattern_cache.init = true;
+
+	env = getenv("IGT_FB_PATTERN_CACHE_MB");
+	if (env)
+		pattern_cache.max_size = (size_t)clamp(atoi(env), 0,
+						       FB_PATTERN_CACHE_MAX_MB) << 20;
+}
+
+/**
+ * igt_fb_set_pattern_cache_size:
+ * @size: memory budget of the cache in bytes, 0 to disable it
+ *
+ * Enables caching of the rendered contents of the framebuffers created by
+ * igt_create_color_fb(), igt_create_pattern_fb() and
+ * igt_create_color_pattern_fb(). Subsequent requests for a fb with the same
+ * size, format, color and pattern copy the cached image instead of painting
+ * it again; conversion to the fb format and tiling are still done for
+ * each fb. The least recently used images are dropped when the cache grows
+ * beyond @size.
+ *
+ * The cache is disabled by default, it can also be enabled by setting the
+ * IGT_FB_PATTERN_CACHE_MB environment variable to the budget in MiB.
+ */
+void igt_fb_set_pattern_cache_size(size_t size)
+{
+	pattern_cache_init();
+
+	pattern_cache.max_size = size;
+	pattern_cache_evict(size);
+
+	if (!size && (pattern_cache.hits || pattern_cache.misses)) {
+		igt_debug("fb pattern cache: %lu hits, %lu misses\n",
+			  pattern_cache.hits, pattern_cache.misses);
+		pattern_cache.hits = pattern_cache.misses = 0;
+	}
+}
+
+static struct fb_pattern_cache_entry *
+pattern_cache_lookup(const struct igt_fb *fb, enum fb_pattern pattern,
+		     double r, double g, double b)
+{
+	struct fb_pattern_cache_entry *e;
+
+	igt_list_for_each_entry(e, &pattern_cache.lru, link) {
+		if (e->width != fb->width || e->height != fb->height ||
+		    e->drm_format != fb->drm_format || e->pattern != pattern)
+			continue;
+
+		if (pattern != FB_PATTERN_TEST &&
+		    (e->r != r || e->g != g || e->b != b))
+			continue;
+
+		igt_list_move(&e->link, &pattern_cache.lru);
+		return e;
+	}
+
+	return NULL;
+}
+
+static void pattern_cache_add(const struct igt_fb *fb, cairo_surface_t *surface,
+			      enum fb_pattern pattern,
+			      double r, double g, double b)
+{
+	struct fb_pattern_cache_entry *e;
+	cairo_format_t format = cairo_image_surface_get_format(surface);
+	size_t size;
+	cairo_t *cr;
+
+	size = (size_t)cairo_format_stride_for_width(format, fb->width) * fb->height;
+	if (size > pattern_cache.max_size)
+		return;
+
+	e = calloc(1, sizeof(*e));
+	igt_assert(e);
+
+	e->width = fb->width;
+	e->height = fb->height;
+	e->drm_format = fb->drm_format;
+	e->pattern = pattern;
+	e->r = r;
+	e->g = g;
+	e->b = b;
+	e->size = size;
+
+	e->image = cairo_image_surface_create(format, fb->width, fb->height);
+	cr = cairo_create(e->image);
+	cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+	cairo_set_source_surface(cr, surface, 0, 0);
+	cairo_paint(cr);
+	igt_assert(cairo_status(cr) == CAIRO_STATUS_SUCCESS);
+	cairo_destroy(cr);
+
+	pattern_cache_evict(pattern_cache.max_size - size);
+	igt_list_add(&e->link, &pattern_cache.lru);
+	pattern_cache.size += size;
+}
+
+static void paint_fb_pattern(int fd, struct igt_fb *fb, enum fb_pattern pattern,
+			     double r, double g, double b)
+{
+	struct fb_pattern_cache_entry *e = NULL;
+	cairo_t *cr;
+
+	if (pattern == FB_PATTERN_COLOR && gpu_fill_color(fb, r, g, b))
+		return;
+
+	pattern_cache_init();
+
+	cr = igt_get_cairo_ctx(fd, fb);
+
+	if (pattern_cache.max_size)
+		e = pattern_cache_lookup(fb, pattern, r, g, b);
+
+	if (e) {
+		pattern_cache.hits++;
+
+		cairo_save(cr);
+		cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+		cairo_set_source_surface(cr, e->image, 0, 0);
+		cairo_paint(cr);
+		cairo_restore(cr);
+	} else {
+		if (pattern != FB_PATTERN_TEST)
+			igt_paint_color(cr, 0, 0, fb->width, fb->height, r, g, b);
+		if (pattern != FB_PATTERN_COLOR)
+			igt_paint_test_pattern(cr, fb->width, fb->height);
+
+		if (pattern_cache.max_size) {
+			pattern_cache.misses++;
+			cairo_surface_flush(cairo_get_target(cr));
+			pattern_cache_add(fb, cairo_get_target(cr), pattern, r, g, b);
+		}
+	}
+
+	igt_put_cairo_ctx(cr);
+}
+
 /**
  * igt_create_color_fb:
  * @fd: open drm file descriptor
@@ -2201,14 +3038,11 @@ unsigned int igt_create_color_fb(int fd, int width, int height,
 				 struct igt_fb *fb /* out */)
 {
 	unsigned int fb_id;
-	cairo_t *cr;
 
 	fb_id = igt_create_fb(fd, width, height, format, modifier, fb);
 	igt_assert(fb_id);
 
-	cr = igt_get_cairo_ctx(fd, fb);
-	igt_paint_color(cr, 0, 0, width, height, r, g, b);
-	igt_put_cairo_ctx(cr);
+	paint_fb_pattern(fd, fb, FB_PATTERN_COLOR, r, g, b);
 
 	return fb_id;
 }
@@ -2238,14 +3072,11 @@ unsigned int igt_create_pattern_fb(int fd, int width, int height,
 				   struct igt_fb *fb /* out */)
 {
 	unsigned int fb_id;
-	cairo_t *cr;
 
 	fb_id = igt_create_fb(fd, width, height, format, modifier, fb);
 	igt_assert(fb_id);
 
-	cr = igt_get_cairo_ctx(fd, fb);
-	igt_paint_test_pattern(cr, width, height);
-	igt_put_cairo_ctx(cr);
+	paint_fb_pattern(fd, fb, FB_PATTERN_TEST, 0, 0, 0);
 
 	return fb_id;
 }
@@ -2280,15 +3111,11 @@ unsigned int igt_create_color_pattern_fb(int fd, int width, int height,
 					 struct igt_fb *fb /* out */)
 {
 	unsigned int fb_id;
-	cairo_t *cr;
 
 	fb_id = igt_create_fb(fd, width, height, format, modifier, fb);
 	igt_assert(fb_id);
 
-	cr = igt_get_cairo_ctx(fd, fb);
-	igt_paint_color(cr, 0, 0, width, height, r, g, b);
-	igt_paint_test_pattern(cr, width, height);
-	igt_put_cairo_ctx(cr);
+	paint_fb_pattern(fd, fb, FB_PATTERN_COLOR_TEST, r, g, b);
 
 	return fb_id;
 }
@@ -2319,8 +3146,7 @@ unsigned int igt_create_image_fb(int fd, int width, int height,
 	uint32_t fb_id;
 	cairo_t *cr;
 
-	image = igt_cairo_image_surface_create_from_png(filename);
-	igt_assert(cairo_surface_status(image) == CAIRO_STATUS_SUCCESS);
+	image = image_cache_get(filename, 0, 0);
 	if (width == 0)
 		width = cairo_image_surface_get_width(image);
 	if (height == 0)
@@ -2480,12 +3306,18 @@ struct fb_blit_linear {
 	uint8_t *map;
 };
 
+struct fb_async_upload;
+static bool fb_async_upload_join(const struct igt_fb *fb, int fd);
+
 struct fb_blit_upload {
 	int fd;
 	struct igt_fb *fb;
 	struct fb_blit_linear linear;
 	struct buf_ops *bops;
 	struct intel_bb *ibb;
+	struct fb_async_upload *async;
+	/* Format of the linear copy when the render engine converts it */
+	uint32_t convert_format;
 };
 
 static enum blt_tiling_type fb_tile_to_blt_tile(uint64_t tile)
@@ -2578,6 +3410,70 @@ static bool blitter_ok(const struct igt_fb *fb)
 	return true;
 }
 
+/*
+ * Formats laid out like their cairo format but for the order of the
+ * channels are converted by the render engine, on its way between the fb
+ * and a linear copy in the cairo format, rather than by the CPU. Render
+ * copies sample and write each surface in its own format, so the surface
+ * formats are what does the conversion.
+ */
+static bool gpu_convert_disabled;
+
+/**
+ * igt_fb_set_gpu_convert:
+ * @enable: whether format conversions may use the render engine
+ *
+ * Framebuffers in formats cairo can't draw to directly are drawn in a cairo
+ * format and converted. Where the render engine can do the conversion, it
+ * does it in the same copy that tiles and compresses the fb. This allows
+ * disabling that fast path so the conversion is done by the CPU, e.g. to use
+ * it as the reference for the GPU one. Enabled by default.
+ */
+void igt_fb_set_gpu_convert(bool enable)
+{
+	gpu_convert_disabled = !enable;
+}
+
+/* Render surface formats not derived from the bpp and depth, 0 otherwise */
+static uint32_t render_surface_format(uint32_t drm_format)
+{
+	switch (drm_format) {
+	case DRM_FORMAT_XBGR8888:
+	case DRM_FORMAT_ABGR8888:
+		return SURFACEFORMAT_R8G8B8A8_UNORM;
+	case DRM_FORMAT_XBGR2101010:
+	case DRM_FORMAT_ABGR2101010:
+		return SURFACEFORMAT_R10G10B10A2_UNORM;
+	default:
+		return 0;
+	}
+}
+
+static uint32_t gpu_convert_format(const struct igt_fb *fb)
+{
+	const struct format_desc_struct *f = lookup_drm_format(fb->drm_format);
+	const struct format_desc_struct *linear;
+
+	if (gpu_convert_disabled || !f->convert || !is_intel_device(fb->fd))
+		return 0;
+
+	/* Only the gen9+ render copies honour the surface format */
+	if (intel_gen(intel_get_drm_devid(fb->fd)) < 9 ||
+	    !igt_get_render_copyfunc(fb->fd))
+		return 0;
+
+	/* Media compression is done by the vebox, which can't convert */
+	if (igt_fb_is_gen12_mc_ccs_modifier(fb->modifier) ||
+	    !render_surface_format(fb->drm_format))
+		return 0;
+
+	linear = lookup_drm_format(cairo_format_to_drm_format(f->cairo_id));
+	if (linear->plane_bpp[0] != f->plane_bpp[0])
+		return 0;
+
+	return linear->drm_id;
+}
+
 static bool use_enginecopy(const struct igt_fb *fb)
 {
 	if (!is_intel_device(fb->fd))
@@ -2726,6 +3622,7 @@ igt_fb_create_intel_buf(int fd, struct buf_ops *bops,
 	default:
 		break;
 	}
+	buf->surface_format = render_surface_format(fb->drm_format);
 
 	/* Make sure we close handle on destroy path */
 	intel_buf_set_ownership(buf, true);
@@ -3092,7 +3989,11 @@ static void do_block_copy(const struct igt_fb *src_fb,
 	}
 
 	blt_set_batch(&blt.bb, xe_bb, bb_size, mem_region);
-	blt_block_copy(src_fb->fd, ctx, e, ahnd, &blt, pext);
+	if (e)
+		blt_block_copy(src_fb->fd, ctx, e, ahnd, &blt, pext);
+	else
+		blt_copy_striped(src_fb->fd, ctx, ahnd, XY_BLOCK_COPY, &blt,
+				 pext, 0);
 
 	if (e)
 		gem_sync(src_fb->fd, blt.dst.handle);
@@ -3223,6 +4124,209 @@ void igt_xe2_blit_with_dst_pat(const struct igt_fb *dst_fb,
 			      src_fb->fd, NULL);
 }
 
+/*
+ * Pool of the linear staging bos of setup_linear_mapping(), so that mapping
+ * fbs over and over doesn't create and destroy a bo (and its vm binding)
+ * each time. The bos are bucketed by power of two size and tied to the drm
+ * client they were created on, since the fd number may get reused for a
+ * different client once closed.
+ */
+struct staging_bo {
+	struct igt_list_head link;
+	int fd;
+	unsigned long client_id;
+	uint32_t handle;
+	uint64_t size;
+};
+
+#define STAGING_POOL_MIN_BO_SIZE	(1ull << 20)
+#define STAGING_POOL_MAX_BO_SIZE	(256ull << 20)
+#define STAGING_POOL_MAX_SIZE		(512ull << 20)
+#define STAGING_POOL_MAX_BOS		16
+
+static struct {
+	pthread_mutex_t lock;
+	struct igt_list_head bos;
+	unsigned int count;
+	uint64_t size;
+	bool exit_handler;
+} staging_pool = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.bos = { &staging_pool.bos, &staging_pool.bos },
+};
+
+static bool drm_client_id(int fd, unsigned long *id)
+{
+	char path[64], line[256];
+	bool found = false;
+	FILE *file;
+
+	snprintf(path, sizeof(path), "/proc/self/fdinfo/%d", fd);
+	file = fopen(path, "r");
+	if (!file)
+		return false;
+
+	while (!found && fgets(line, sizeof(line), file))
+		found = sscanf(line, "drm-client-id: %lu", id) == 1;
+
+	fclose(file);
+
+	return found;
+}
+
+static uint64_t staging_bo_bucket(uint64_t size)
+{
+	if (size <= STAGING_POOL_MIN_BO_SIZE)
+		return STAGING_POOL_MIN_BO_SIZE;
+
+	return 1ull << (64 - __builtin_clzll(size - 1));
+}
+
+static void staging_bo_free(struct staging_bo *bo)
+{
+	unsigned long id;
+
+	staging_pool.count--;
+	staging_pool.size -= bo->size;
+	igt_list_del(&bo->link);
+
+	/* the client is gone along with all its handles otherwise */
+	if (drm_client_id(bo->fd, &id) && id == bo->client_id)
+		gem_close(bo->fd, bo->handle);
+
+	free(bo);
+}
+
+/**
+ * igt_fb_release_staging_bos:
+ * @fd: open drm file descriptor
+ *
+ * Frees the linear staging buffers cached for @fd by the cairo and mapping
+ * paths of tiled or compressed fbs. igt_display_fini() calls this, it's only
+ * needed by tests which want the memory back while keeping @fd open.
+ */
+void igt_fb_release_staging_bos(int fd)
+{
+	struct staging_bo *bo, *tmp;
+
+	/* Uploads still running put their staging bos back when done */
+	igt_warn_on_f(!fb_async_upload_join(NULL, fd),
+		      "Asynchronous fb upload failed\n");
+
+	pthread_mutex_lock(&staging_pool.lock);
+	igt_list_for_each_entry_safe(bo, tmp, &staging_pool.bos, link)
+		if (bo->fd == fd)
+			staging_bo_free(bo);
+	pthread_mutex_unlock(&staging_pool.lock);
+}
+
+static void staging_pool_exit_handler(int sig)
+{
+	struct staging_bo *bo, *tmp;
+
+	/* the kernel cleans up after us if we're killed */
+	if (sig)
+		return;
+
+	fb_async_upload_join(NULL, -1);
+
+	igt_list_for_each_entry_safe(bo, tmp, &staging_pool.bos, link)
+		staging_bo_free(bo);
+}
+
+static void staging_pool_atfork_child(void)
+{
+	struct staging_bo *bo, *tmp;
+
+	/* The bos are shared with the parent, so don't reuse nor close them */
+	pthread_mutex_init(&staging_pool.lock, NULL);
+	igt_list_for_each_entry_safe(bo, tmp, &staging_pool.bos, link)
+		free(bo);
+	IGT_INIT_LIST_HEAD(&staging_pool.bos);
+	staging_pool.count = 0;
+	staging_pool.size = 0;
+}
+
+static bool staging_pool_ok(const struct igt_fb *fb)
+{
+	return is_i915_device(fb->fd) || is_xe_device(fb->fd);
+}
+
+/*
+ * Lay out @fb and pick a bo for it from the pool. On a miss @fb is sized to
+ * its bucket so that the bo created for it can be put back into the pool.
+ */
+static bool staging_bo_get(struct igt_fb *fb)
+{
+	struct staging_bo *bo;
+	unsigned long id;
+	uint64_t size;
+
+	igt_calc_fb_size(fb);
+	size = staging_bo_bucket(fb->size);
+	if (size > STAGING_POOL_MAX_BO_SIZE || !drm_client_id(fb->fd, &id))
+		return false;
+
+	fb->size = size;
+
+	pthread_mutex_lock(&staging_pool.lock);
+	igt_list_for_each_entry(bo, &staging_pool.bos, link) {
+		if (bo->fd != fb->fd || bo->client_id != id || bo->size != size)
+			continue;
+
+		fb->gem_handle = bo->handle;
+		fb->is_dumb = false;
+
+		staging_pool.count--;
+		staging_pool.size -= bo->size;
+		igt_list_del(&bo->link);
+		free(bo);
+		break;
+	}
+	pthread_mutex_unlock(&staging_pool.lock);
+
+	return fb->gem_handle;
+}
+
+static void staging_bo_put(struct igt_fb *fb)
+{
+	struct staging_bo *bo;
+	unsigned long id;
+
+	if (fb->size != staging_bo_bucket(fb->size) ||
+	    fb->size > STAGING_POOL_MAX_BO_SIZE ||
+	    !drm_client_id(fb->fd, &id)) {
+		gem_close(fb->fd, fb->gem_handle);
+		return;
+	}
+
+	bo = calloc(1, sizeof(*bo));
+	igt_assert(bo);
+	bo->fd = fb->fd;
+	bo->client_id = id;
+	bo->handle = fb->gem_handle;
+	bo->size = fb->size;
+
+	pthread_mutex_lock(&staging_pool.lock);
+
+	if (!staging_pool.exit_handler) {
+		staging_pool.exit_handler = true;
+		igt_install_exit_handler(staging_pool_exit_handler);
+		pthread_atfork(NULL, NULL, staging_pool_atfork_child);
+	}
+
+	igt_list_add(&bo->link, &staging_pool.bos);
+	staging_pool.count++;
+	staging_pool.size += bo->size;
+
+	while (staging_pool.count > STAGING_POOL_MAX_BOS ||
+	       staging_pool.size > STAGING_POOL_MAX_SIZE)
+		staging_bo_free(igt_list_last_entry(&staging_pool.bos,
+						    bo, link));
+
+	pthread_mutex_unlock(&staging_pool.lock);
+}
+
 static void free_linear_mapping(struct fb_blit_upload *blit)
 {
 	int fd = blit->fd;
@@ -3240,37 +4344,157 @@ static void free_linear_mapping(struct fb_blit_upload *blit)
 
 		igt_amd_fb_convert_plane_to_tiled(fb, map, &linear->fb, linear->map);
 
-		munmap(map, fb->size);
-	} else if (is_nouveau_device(fd)) {
-		igt_nouveau_fb_blit(fb, &linear->fb);
-		igt_nouveau_delete_bo(&linear->fb);
-	} else if (is_xe_device(fd)) {
-		gem_munmap(linear->map, linear->fb.size);
+		munmap(map, fb->size);
+	} else if (is_nouveau_device(fd)) {
+		igt_nouveau_fb_blit(fb, &linear->fb);
+		igt_nouveau_delete_bo(&linear->fb);
+	} else if (is_xe_device(fd)) {
+		gem_munmap(linear->map, linear->fb.size);
+
+		if (blit->ibb)
+			copy_with_engine(blit, fb, &linear->fb);
+		else
+			blitcopy(fb, &linear->fb);
+
+		staging_bo_put(&linear->fb);
+	} else {
+		gem_munmap(linear->map, linear->fb.size);
+		gem_set_domain(fd, linear->fb.gem_handle,
+			I915_GEM_DOMAIN_GTT, 0);
+
+		if (blit->ibb)
+			copy_with_engine(blit, fb, &linear->fb);
+		else
+			blitcopy(fb, &linear->fb);
+
+		gem_sync(fd, linear->fb.gem_handle);
+		staging_bo_put(&linear->fb);
+	}
+
+	if (blit->ibb) {
+		intel_bb_destroy(blit->ibb);
+		buf_ops_destroy(blit->bops);
+	}
+}
+
+/*
+ * Uploads started by igt_put_cairo_ctx_async(). The copy back to the fb is
+ * done by a thread per upload, signalling a sw_sync fence once complete.
+ * Anything touching the fb contents or its bo waits for the pending uploads
+ * of the fb first, and so do igt_fb_release_staging_bos() and exit.
+ *
+ * A failed igt_assert in the thread only makes it exit, the waiter checks
+ * whether the upload completed and fails in the test thread.
+ */
+struct fb_async_upload {
+	struct igt_list_head link;
+	struct igt_fb *fb;
+	struct fb_blit_upload *blit;
+	pthread_t thread;
+	int fd;
+	int timeline;
+	bool completed;
+};
+
+static struct {
+	pthread_mutex_t lock;
+	struct igt_list_head list;
+	bool exit_handler;
+} async_uploads = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.list = { &async_uploads.list, &async_uploads.list },
+};
+
+/* Also run when the thread exits on a failed igt_assert */
+static void fb_async_upload_signal(void *arg)
+{
+	struct fb_async_upload *async = arg;
+
+	/* Nobody waits on the fence forever, whatever happened */
+	if (__sw_sync_timeline_inc(async->timeline, 1))
+		async->completed = false;
+}
+
+static void *fb_async_upload_thread(void *arg)
+{
+	struct fb_async_upload *async = arg;
+
+	pthread_cleanup_push(fb_async_upload_signal, async);
+	free_linear_mapping(async->blit);
+	async->completed = true;
+	pthread_cleanup_pop(1);
+
+	return NULL;
+}
 
-		if (blit->ibb)
-			copy_with_engine(blit, fb, &linear->fb);
-		else
-			blitcopy(fb, &linear->fb);
+static void fb_async_upload_exit_handler(int sig)
+{
+	/* the kernel cleans up after us if we're killed */
+	if (sig)
+		return;
 
-		gem_close(fd, linear->fb.gem_handle);
-	} else {
-		gem_munmap(linear->map, linear->fb.size);
-		gem_set_domain(fd, linear->fb.gem_handle,
-			I915_GEM_DOMAIN_GTT, 0);
+	fb_async_upload_join(NULL, -1);
+}
 
-		if (blit->ibb)
-			copy_with_engine(blit, fb, &linear->fb);
-		else
-			blitcopy(fb, &linear->fb);
+static void fb_async_upload_atfork_child(void)
+{
+	/* The threads are the parent's, there is nothing to join */
+	pthread_mutex_init(&async_uploads.lock, NULL);
+	IGT_INIT_LIST_HEAD(&async_uploads.list);
+}
 
-		gem_sync(fd, linear->fb.gem_handle);
-		gem_close(fd, linear->fb.gem_handle);
+static void fb_async_upload_start(struct fb_async_upload *async)
+{
+	pthread_mutex_lock(&async_uploads.lock);
+	if (!async_uploads.exit_handler) {
+		async_uploads.exit_handler = true;
+		igt_install_exit_handler(fb_async_upload_exit_handler);
+		pthread_atfork(NULL, NULL, fb_async_upload_atfork_child);
+	}
+	igt_list_add_tail(&async->link, &async_uploads.list);
+	pthread_mutex_unlock(&async_uploads.lock);
+
+	if (pthread_create(&async->thread, NULL, fb_async_upload_thread, async)) {
+		async->thread = pthread_self();
+		free_linear_mapping(async->blit);
+		async->completed = true;
+		fb_async_upload_signal(async);
 	}
+}
 
-	if (blit->ibb) {
-		intel_bb_destroy(blit->ibb);
-		buf_ops_destroy(blit->bops);
+/*
+ * Joins the pending uploads to @fb, to any fb on @fd, or all of them when
+ * neither is given. Returns whether they all completed.
+ */
+static bool fb_async_upload_join(const struct igt_fb *fb, int fd)
+{
+	struct fb_async_upload *async, *tmp;
+	bool completed = true;
+	IGT_LIST_HEAD(done);
+
+	pthread_mutex_lock(&async_uploads.lock);
+	igt_list_for_each_entry_safe(async, tmp, &async_uploads.list, link)
+		if (fb ? async->fb == fb : fd < 0 || async->fd == fd)
+			igt_list_move(&async->link, &done);
+	pthread_mutex_unlock(&async_uploads.lock);
+
+	igt_list_for_each_entry_safe(async, tmp, &done, link) {
+		if (!pthread_equal(async->thread, pthread_self()))
+			pthread_join(async->thread, NULL);
+
+		completed &= async->completed;
+		close(async->timeline);
+		free(async->blit);
+		free(async);
 	}
+
+	return completed;
+}
+
+static void fb_async_upload_wait(const struct igt_fb *fb)
+{
+	igt_assert_f(fb_async_upload_join(fb, -1),
+		     "Asynchronous upload to fb %u failed\n", fb->fb_id);
 }
 
 static void destroy_cairo_surface__gpu(void *arg)
@@ -3279,6 +4503,11 @@ static void destroy_cairo_surface__gpu(void *arg)
 
 	blit->fb->cairo_surface = NULL;
 
+	if (blit->async) {
+		fb_async_upload_start(blit->async);
+		return;
+	}
+
 	free_linear_mapping(blit);
 
 	free(blit);
@@ -3290,7 +4519,8 @@ static void setup_linear_mapping(struct fb_blit_upload *blit)
 	struct igt_fb *fb = blit->fb;
 	struct fb_blit_linear *linear = &blit->linear;
 
-	if (!igt_vc4_is_tiled(fb->modifier) && use_enginecopy(fb)) {
+	if (blit->convert_format ||
+	    (!igt_vc4_is_tiled(fb->modifier) && use_enginecopy(fb))) {
 		blit->bops = buf_ops_create(fd);
 		blit->ibb = intel_bb_create(fd, 4096);
 	}
@@ -3302,10 +4532,12 @@ static void setup_linear_mapping(struct fb_blit_upload *blit)
 	 */
 
 	igt_init_fb(&linear->fb, fb->fd, fb->width, fb->height,
-		    fb->drm_format, DRM_FORMAT_MOD_LINEAR,
+		    blit->convert_format ?: fb->drm_format,
+		    DRM_FORMAT_MOD_LINEAR,
 		    fb->color_encoding, fb->color_range);
 
-	create_bo_for_fb(&linear->fb, true);
+	if (!staging_pool_ok(fb) || !staging_bo_get(&linear->fb))
+		create_bo_for_fb(&linear->fb, true);
 
 	igt_assert(linear->fb.gem_handle > 0);
 
@@ -3369,6 +4601,7 @@ static void create_cairo_surface__gpu(int fd, struct igt_fb *fb)
 
 	blit->fd = fd;
 	blit->fb = fb;
+	blit->convert_format = gpu_convert_format(fb);
 	setup_linear_mapping(blit);
 
 	cairo_format = drm_format_to_cairo(fb->drm_format);
@@ -3749,6 +4982,20 @@ static void get_yuv_parameters(struct igt_fb *fb, struct yuv_parameters *params)
 	}
 }
 
+/*
+ * The conversions gather a row of pixels into a scratch buffer and feed
+ * it to igt_matrix_transform_array() in one go, which lets the matrix
+ * multiplication use SIMD instructions.
+ */
+static struct igt_vec4 *alloc_vec4_row(unsigned int width)
+{
+	struct igt_vec4 *row = malloc(sizeof(*row) * width);
+
+	igt_assert(row);
+
+	return row;
+}
+
 static void convert_yuv_to_rgb24(struct fb_convert *cvt)
 {
 	const struct format_desc_struct *src_fmt =
@@ -3763,11 +5010,13 @@ static void convert_yuv_to_rgb24(struct fb_convert *cvt)
 						    cvt->src.fb->color_encoding,
 						    cvt->src.fb->color_range);
 	uint8_t *buf;
+	struct igt_vec4 *row;
 	struct yuv_parameters params = { };
 
 	igt_assert(cvt->dst.fb->drm_format == DRM_FORMAT_XRGB8888 &&
 		   igt_format_is_yuv(cvt->src.fb->drm_format));
 
+	row = alloc_vec4_row(cvt->dst.fb->width);
 	buf = convert_src_get(cvt);
 	get_yuv_parameters(cvt->src.fb, &params);
 	y = buf + params.y_offset;
@@ -3781,17 +5030,11 @@ static void convert_yuv_to_rgb24(struct fb_convert *cvt)
 		uint8_t *rgb_tmp = rgb24;
 
 		for (j = 0; j < cvt->dst.fb->width; j++) {
-			struct igt_vec4 rgb, yuv;
+			row[j].d[0] = *y_tmp;
+			row[j].d[1] = *u_tmp;
+			row[j].d[2] = *v_tmp;
+			row[j].d[3] = 1.0f;
 
-			yuv.d[0] = *y_tmp;
-			yuv.d[1] = *u_tmp;
-			yuv.d[2] = *v_tmp;
-			yuv.d[3] = 1.0f;
-
-			rgb = igt_matrix_transform(&m, &yuv);
-			write_rgb(rgb_tmp, &rgb);
-
-			rgb_tmp += bpp;
 			y_tmp += params.ay_inc;
 
 			if ((src_fmt->hsub == 1) || (j % src_fmt->hsub)) {
@@ -3800,6 +5043,13 @@ static void convert_yuv_to_rgb24(struct fb_convert *cvt)
 			}
 		}
 
+		igt_matrix_transform_array(&m, row, row, cvt->dst.fb->width);
+
+		for (j = 0; j < cvt->dst.fb->width; j++) {
+			write_rgb(rgb_tmp, &row[j]);
+			rgb_tmp += bpp;
+		}
+
 		rgb24 += rgb24_stride;
 		y += params.ay_stride;
 
@@ -3810,6 +5060,7 @@ static void convert_yuv_to_rgb24(struct fb_convert *cvt)
 	}
 
 	convert_src_put(cvt, buf);
+	free(row);
 }
 
 static void convert_rgb24_to_yuv(struct fb_convert *cvt)
@@ -3826,10 +5077,12 @@ static void convert_rgb24_to_yuv(struct fb_convert *cvt)
 						    cvt->dst.fb->color_encoding,
 						    cvt->dst.fb->color_range);
 	struct yuv_parameters params = { };
+	struct igt_vec4 *row, *pair_row;
 
 	igt_assert(cvt->src.fb->drm_format == DRM_FORMAT_XRGB8888 &&
 		   igt_format_is_yuv(cvt->dst.fb->drm_format));
 
+	row = alloc_vec4_row(cvt->dst.fb->width * 2);
 	get_yuv_parameters(cvt->dst.fb, &params);
 	y = cvt->dst.ptr + params.y_offset;
 	u = cvt->dst.ptr + params.u_offset;
@@ -3842,16 +5095,31 @@ static void convert_rgb24_to_yuv(struct fb_convert *cvt)
 		uint8_t *v_tmp = v;
 
 		for (j = 0; j < cvt->dst.fb->width; j++) {
-			const uint8_t *pair_rgb24 = rgb_tmp;
-			struct igt_vec4 pair_rgb, rgb;
-			struct igt_vec4 pair_yuv, yuv;
+			read_rgb(&row[j], rgb_tmp);
+			rgb_tmp += bpp;
+		}
+		igt_matrix_transform_array(&m, row, row, cvt->dst.fb->width);
 
-			read_rgb(&rgb, rgb_tmp);
-			yuv = igt_matrix_transform(&m, &rgb);
+		/* row holding the bottom pixels of the chroma blocks */
+		pair_row = row;
+		if (!(i % dst_fmt->vsub) && dst_fmt->vsub > 1 &&
+		    i != (cvt->dst.fb->height - 1)) {
+			const uint8_t *pair_rgb24 = rgb24 + rgb24_stride * (dst_fmt->vsub - 1);
 
-			rgb_tmp += bpp;
+			pair_row = row + cvt->dst.fb->width;
+			for (j = 0; j < cvt->dst.fb->width; j++) {
+				read_rgb(&pair_row[j], pair_rgb24);
+				pair_rgb24 += bpp;
+			}
+			igt_matrix_transform_array(&m, pair_row, pair_row,
+						   cvt->dst.fb->width);
+		}
+
+		for (j = 0; j < cvt->dst.fb->width; j++) {
+			const struct igt_vec4 *yuv = &row[j];
+			const struct igt_vec4 *pair_yuv;
 
-			*y_tmp = clamp8(yuv.d[0]);
+			*y_tmp = clamp8(yuv->d[0]);
 			y_tmp += params.ay_inc;
 
 			if ((i % dst_fmt->vsub) || (j % dst_fmt->hsub))
@@ -3872,17 +5140,12 @@ static void convert_rgb24_to_yuv(struct fb_convert *cvt)
 			 * incrementing the paired pixel pointer in the
 			 * direction it's odd in.
 			 */
+			pair_yuv = &pair_row[j];
 			if (j != (cvt->dst.fb->width - 1))
-				pair_rgb24 += (dst_fmt->hsub - 1) * bpp;
+				pair_yuv += dst_fmt->hsub - 1;
 
-			if (i != (cvt->dst.fb->height - 1))
-				pair_rgb24 += rgb24_stride * (dst_fmt->vsub - 1);
-
-			read_rgb(&pair_rgb, pair_rgb24);
-			pair_yuv = igt_matrix_transform(&m, &pair_rgb);
-
-			*u_tmp = clamp8((yuv.d[1] + pair_yuv.d[1]) / 2.0f);
-			*v_tmp = clamp8((yuv.d[2] + pair_yuv.d[2]) / 2.0f);
+			*u_tmp = clamp8((yuv->d[1] + pair_yuv->d[1]) / 2.0f);
+			*v_tmp = clamp8((yuv->d[2] + pair_yuv->d[2]) / 2.0f);
 
 			u_tmp += params.uv_inc;
 			v_tmp += params.uv_inc;
@@ -3896,6 +5159,8 @@ static void convert_rgb24_to_yuv(struct fb_convert *cvt)
 			v += params.uv_stride;
 		}
 	}
+
+	free(row);
 }
 
 static void read_rgbf(struct igt_vec4 *rgb, const float *rgb24)
@@ -3927,11 +5192,13 @@ static void convert_yuv16_to_float(struct fb_convert *cvt, bool alpha)
 						    cvt->src.fb->color_encoding,
 						    cvt->src.fb->color_range);
 	uint16_t *buf;
+	struct igt_vec4 *row;
 	struct yuv_parameters params = { };
 
 	igt_assert(cvt->dst.fb->drm_format == IGT_FORMAT_FLOAT &&
 		   igt_format_is_yuv(cvt->src.fb->drm_format));
 
+	row = alloc_vec4_row(cvt->dst.fb->width);
 	buf = convert_src_get(cvt);
 	get_yuv_parameters(cvt->src.fb, &params);
 	igt_assert(!(params.y_offset % sizeof(*buf)) &&
@@ -3951,15 +5218,23 @@ static void convert_yuv16_to_float(struct fb_convert *cvt, bool alpha)
 		float *rgb_tmp = ptr;
 
 		for (j = 0; j < cvt->dst.fb->width; j++) {
-			struct igt_vec4 rgb, yuv;
+			row[j].d[0] = *y_tmp;
+			row[j].d[1] = *u_tmp;
+			row[j].d[2] = *v_tmp;
+			row[j].d[3] = 1.0f;
+
+			y_tmp += params.ay_inc;
+
+			if ((src_fmt->hsub == 1) || (j % src_fmt->hsub)) {
+				u_tmp += params.uv_inc;
+				v_tmp += params.uv_inc;
+			}
+		}
 
-			yuv.d[0] = *y_tmp;
-			yuv.d[1] = *u_tmp;
-			yuv.d[2] = *v_tmp;
-			yuv.d[3] = 1.0f;
+		igt_matrix_transform_array(&m, row, row, cvt->dst.fb->width);
 
-			rgb = igt_matrix_transform(&m, &yuv);
-			write_rgbf(rgb_tmp, &rgb);
+		for (j = 0; j < cvt->dst.fb->width; j++) {
+			write_rgbf(rgb_tmp, &row[j]);
 
 			if (alpha) {
 				rgb_tmp[3] = ((float)*a_tmp) / 65535.f;
@@ -3967,12 +5242,6 @@ static void convert_yuv16_to_float(struct fb_convert *cvt, bool alpha)
 			}
 
 			rgb_tmp += fpp;
-			y_tmp += params.ay_inc;
-
-			if ((src_fmt->hsub == 1) || (j % src_fmt->hsub)) {
-				u_tmp += params.uv_inc;
-				v_tmp += params.uv_inc;
-			}
 		}
 
 		ptr += float_stride;
@@ -3987,6 +5256,7 @@ static void convert_yuv16_to_float(struct fb_convert *cvt, bool alpha)
 	}
 
 	convert_src_put(cvt, buf);
+	free(row);
 }
 
 static void convert_float_to_yuv16(struct fb_convert *cvt, bool alpha)
@@ -4003,10 +5273,12 @@ static void convert_float_to_yuv16(struct fb_convert *cvt, bool alpha)
 						    cvt->dst.fb->color_encoding,
 						    cvt->dst.fb->color_range);
 	struct yuv_parameters params = { };
+	struct igt_vec4 *row, *pair_row;
 
 	igt_assert(cvt->src.fb->drm_format == IGT_FORMAT_FLOAT &&
 		   igt_format_is_yuv(cvt->dst.fb->drm_format));
 
+	row = alloc_vec4_row(cvt->dst.fb->width * 2);
 	get_yuv_parameters(cvt->dst.fb, &params);
 	igt_assert(!(params.a_offset % sizeof(*a)) &&
 		   !(params.y_offset % sizeof(*y)) &&
@@ -4025,13 +5297,26 @@ static void convert_float_to_yuv16(struct fb_convert *cvt, bool alpha)
 		uint16_t *u_tmp = u;
 		uint16_t *v_tmp = v;
 
-		for (j = 0; j < cvt->dst.fb->width; j++) {
-			const float *pair_float = rgb_tmp;
-			struct igt_vec4 pair_rgb, rgb;
-			struct igt_vec4 pair_yuv, yuv;
+		for (j = 0; j < cvt->dst.fb->width; j++)
+			read_rgbf(&row[j], &rgb_tmp[j * fpp]);
+		igt_matrix_transform_array(&m, row, row, cvt->dst.fb->width);
+
+		/* row holding the bottom pixels of the chroma blocks */
+		pair_row = row;
+		if (!(i % dst_fmt->vsub) && dst_fmt->vsub > 1 &&
+		    i != (cvt->dst.fb->height - 1)) {
+			const float *pair_float = ptr + float_stride * (dst_fmt->vsub - 1);
+
+			pair_row = row + cvt->dst.fb->width;
+			for (j = 0; j < cvt->dst.fb->width; j++)
+				read_rgbf(&pair_row[j], &pair_float[j * fpp]);
+			igt_matrix_transform_array(&m, pair_row, pair_row,
+						   cvt->dst.fb->width);
+		}
 
-			read_rgbf(&rgb, rgb_tmp);
-			yuv = igt_matrix_transform(&m, &rgb);
+		for (j = 0; j < cvt->dst.fb->width; j++) {
+			const struct igt_vec4 *yuv = &row[j];
+			const struct igt_vec4 *pair_yuv;
 
 			if (alpha) {
 				*a_tmp = rgb_tmp[3] * 65535.f + .5f;
@@ -4040,7 +5325,7 @@ static void convert_float_to_yuv16(struct fb_convert *cvt, bool alpha)
 
 			rgb_tmp += fpp;
 
-			*y_tmp = clamp16(yuv.d[0]);
+			*y_tmp = clamp16(yuv->d[0]);
 			y_tmp += params.ay_inc;
 
 			if ((i % dst_fmt->vsub) || (j % dst_fmt->hsub))
@@ -4061,17 +5346,12 @@ static void convert_float_to_yuv16(struct fb_convert *cvt, bool alpha)
 			 * incrementing the paired pixel pointer in the
 			 * direction it's odd in.
 			 */
+			pair_yuv = &pair_row[j];
 			if (j != (cvt->dst.fb->width - 1))
-				pair_float += (dst_fmt->hsub - 1) * fpp;
-
-			if (i != (cvt->dst.fb->height - 1))
-				pair_float += float_stride * (dst_fmt->vsub - 1);
+				pair_yuv += dst_fmt->hsub - 1;
 
-			read_rgbf(&pair_rgb, pair_float);
-			pair_yuv = igt_matrix_transform(&m, &pair_rgb);
-
-			*u_tmp = clamp16((yuv.d[1] + pair_yuv.d[1]) / 2.0f);
-			*v_tmp = clamp16((yuv.d[2] + pair_yuv.d[2]) / 2.0f);
+			*u_tmp = clamp16((yuv->d[1] + pair_yuv->d[1]) / 2.0f);
+			*v_tmp = clamp16((yuv->d[2] + pair_yuv->d[2]) / 2.0f);
 
 			u_tmp += params.uv_inc;
 			v_tmp += params.uv_inc;
@@ -4086,6 +5366,8 @@ static void convert_float_to_yuv16(struct fb_convert *cvt, bool alpha)
 			v += params.uv_stride / sizeof(*v);
 		}
 	}
+
+	free(row);
 }
 
 static void convert_Y410_to_float(struct fb_convert *cvt, bool alpha)
@@ -4101,27 +5383,27 @@ static void convert_Y410_to_float(struct fb_convert *cvt, bool alpha)
 						    cvt->src.fb->color_encoding,
 						    cvt->src.fb->color_range);
 	unsigned bpp = alpha ? 4 : 3;
+	struct igt_vec4 *row;
 
 	igt_assert((cvt->src.fb->drm_format == DRM_FORMAT_Y410 ||
 		    cvt->src.fb->drm_format == DRM_FORMAT_XVYU2101010) &&
 		   cvt->dst.fb->drm_format == IGT_FORMAT_FLOAT);
 
+	row = alloc_vec4_row(cvt->dst.fb->width);
 	uyv = buf = convert_src_get(cvt);
 
 	for (i = 0; i < cvt->dst.fb->height; i++) {
 		for (j = 0; j < cvt->dst.fb->width; j++) {
-			/* Convert 2x1 pixel blocks */
-			struct igt_vec4 yuv;
-			struct igt_vec4 rgb;
-
-			yuv.d[0] = (uyv[j] >> 10) & 0x3ff;
-			yuv.d[1] = uyv[j] & 0x3ff;
-			yuv.d[2] = (uyv[j] >> 20) & 0x3ff;
-			yuv.d[3] = 1.f;
+			row[j].d[0] = (uyv[j] >> 10) & 0x3ff;
+			row[j].d[1] = uyv[j] & 0x3ff;
+			row[j].d[2] = (uyv[j] >> 20) & 0x3ff;
+			row[j].d[3] = 1.f;
+		}
 
-			rgb = igt_matrix_transform(&m, &yuv);
+		igt_matrix_transform_array(&m, row, row, cvt->dst.fb->width);
 
-			write_rgbf(&ptr[j * bpp], &rgb);
+		for (j = 0; j < cvt->dst.fb->width; j++) {
+			write_rgbf(&ptr[j * bpp], &row[j]);
 			if (alpha)
 				ptr[j * bpp + 3] = (float)(uyv[j] >> 30) / 3.f;
 		}
@@ -4131,6 +5413,7 @@ static void convert_Y410_to_float(struct fb_convert *cvt, bool alpha)
 	}
 
 	convert_src_put(cvt, buf);
+	free(row);
 }
 
 static void convert_float_to_Y410(struct fb_convert *cvt, bool alpha)
@@ -4145,26 +5428,30 @@ static void convert_float_to_Y410(struct fb_convert *cvt, bool alpha)
 						    cvt->dst.fb->color_encoding,
 						    cvt->dst.fb->color_range);
 	unsigned bpp = alpha ? 4 : 3;
+	struct igt_vec4 *row;
 
 	igt_assert(cvt->src.fb->drm_format == IGT_FORMAT_FLOAT &&
 		   (cvt->dst.fb->drm_format == DRM_FORMAT_Y410 ||
 		    cvt->dst.fb->drm_format == DRM_FORMAT_XVYU2101010));
 
+	row = alloc_vec4_row(cvt->dst.fb->width);
+
 	for (i = 0; i < cvt->dst.fb->height; i++) {
+		for (j = 0; j < cvt->dst.fb->width; j++)
+			read_rgbf(&row[j], &ptr[j * bpp]);
+
+		igt_matrix_transform_array(&m, row, row, cvt->dst.fb->width);
+
 		for (j = 0; j < cvt->dst.fb->width; j++) {
-			struct igt_vec4 rgb;
-			struct igt_vec4 yuv;
 			uint8_t a = 0;
 			uint16_t y, cb, cr;
 
-			read_rgbf(&rgb, &ptr[j * bpp]);
 			if (alpha)
 				 a = ptr[j * bpp + 3] * 3.f + .5f;
 
-			yuv = igt_matrix_transform(&m, &rgb);
-			y = yuv.d[0];
-			cb = yuv.d[1];
-			cr = yuv.d[2];
+			y = row[j].d[0];
+			cb = row[j].d[1];
+			cr = row[j].d[2];
 
 			uyv[j] = ((cb & 0x3ff) << 0) |
 				  ((y & 0x3ff) << 10) |
@@ -4175,6 +5462,8 @@ static void convert_float_to_Y410(struct fb_convert *cvt, bool alpha)
 		ptr += float_stride;
 		uyv += uyv_stride;
 	}
+
+	free(row);
 }
 
 /* { R, G, B, X } */
@@ -4198,9 +5487,32 @@ static const unsigned char *rgbx_swizzle(uint32_t format)
 	}
 }
 
+/*
+ * Reorder the channels of a row of rgbx float pixels, @dst may be the same as
+ * @src. Done separately from the fp16/unorm16 conversion so that the latter
+ * can run over the whole row at once.
+ */
+static void swizzle_float_row(float *dst, const float *src,
+			      const unsigned char *swz, unsigned int width)
+{
+	for (unsigned int j = 0; j < width; j++) {
+		struct igt_vec4 rgb;
+
+		rgb.d[0] = src[swz[0]];
+		rgb.d[1] = src[swz[1]];
+		rgb.d[2] = src[swz[2]];
+		rgb.d[3] = src[swz[3]];
+
+		memcpy(dst, rgb.d, sizeof(rgb.d));
+
+		dst += 4;
+		src += 4;
+	}
+}
+
 static void convert_fp16_to_float(struct fb_convert *cvt)
 {
-	int i, j;
+	int i;
 	uint16_t *fp16;
 	float *ptr = cvt->dst.ptr;
 	unsigned int float_stride = cvt->dst.fb->strides[0] / sizeof(*ptr);
@@ -4212,26 +5524,10 @@ static void convert_fp16_to_float(struct fb_convert *cvt)
 	fp16 = buf + cvt->src.fb->offsets[0] / sizeof(*buf);
 
 	for (i = 0; i < cvt->dst.fb->height; i++) {
-		if (needs_reswizzle) {
-			const uint16_t *fp16_tmp = fp16;
-			float *rgb_tmp = ptr;
-
-			for (j = 0; j < cvt->dst.fb->width; j++) {
-				struct igt_vec4 rgb;
-
-				igt_half_to_float(fp16_tmp, rgb.d, 4);
+		igt_half_to_float(fp16, ptr, cvt->dst.fb->width * 4);
 
-				rgb_tmp[0] = rgb.d[swz[0]];
-				rgb_tmp[1] = rgb.d[swz[1]];
-				rgb_tmp[2] = rgb.d[swz[2]];
-				rgb_tmp[3] = rgb.d[swz[3]];
-
-				rgb_tmp += 4;
-				fp16_tmp += 4;
-			}
-		} else {
-			igt_half_to_float(fp16, ptr, cvt->dst.fb->width * 4);
-		}
+		if (needs_reswizzle)
+			swizzle_float_row(ptr, ptr, swz, cvt->dst.fb->width);
 
 		ptr += float_stride;
 		fp16 += fp16_stride;
@@ -4242,32 +5538,24 @@ static void convert_fp16_to_float(struct fb_convert *cvt)
 
 static void convert_float_to_fp16(struct fb_convert *cvt)
 {
-	int i, j;
+	int i;
 	uint16_t *fp16 = cvt->dst.ptr + cvt->dst.fb->offsets[0];
 	const float *ptr = cvt->src.ptr;
 	unsigned float_stride = cvt->src.fb->strides[0] / sizeof(*ptr);
 	unsigned fp16_stride = cvt->dst.fb->strides[0] / sizeof(*fp16);
 	const unsigned char *swz = rgbx_swizzle(cvt->dst.fb->drm_format);
 	bool needs_reswizzle = swz != swizzle_rgbx;
+	float *row = NULL;
+
+	if (needs_reswizzle) {
+		row = malloc(cvt->dst.fb->width * 4 * sizeof(*row));
+		igt_assert(row);
+	}
 
 	for (i = 0; i < cvt->dst.fb->height; i++) {
 		if (needs_reswizzle) {
-			const float *rgb_tmp = ptr;
-			uint16_t *fp16_tmp = fp16;
-
-			for (j = 0; j < cvt->dst.fb->width; j++) {
-				struct igt_vec4 rgb;
-
-				rgb.d[0] = rgb_tmp[swz[0]];
-				rgb.d[1] = rgb_tmp[swz[1]];
-				rgb.d[2] = rgb_tmp[swz[2]];
-				rgb.d[3] = rgb_tmp[swz[3]];
-
-				igt_float_to_half(rgb.d, fp16_tmp, 4);
-
-				rgb_tmp += 4;
-				fp16_tmp += 4;
-			}
+			swizzle_float_row(row, ptr, swz, cvt->dst.fb->width);
+			igt_float_to_half(row, fp16, cvt->dst.fb->width * 4);
 		} else {
 			igt_float_to_half(ptr, fp16, cvt->dst.fb->width * 4);
 		}
@@ -4275,6 +5563,8 @@ static void convert_float_to_fp16(struct fb_convert *cvt)
 		ptr += float_stride;
 		fp16 += fp16_stride;
 	}
+
+	free(row);
 }
 
 static void float_to_uint16(const float *f, uint16_t *h, unsigned int num)
@@ -4291,7 +5581,7 @@ static void uint16_to_float(const uint16_t *h, float *f, unsigned int num)
 
 static void convert_uint16_to_float(struct fb_convert *cvt)
 {
-	int i, j;
+	int i;
 	uint16_t *up16;
 	float *ptr = cvt->dst.ptr;
 	unsigned int float_stride = cvt->dst.fb->strides[0] / sizeof(*ptr);
@@ -4303,26 +5593,10 @@ static void convert_uint16_to_float(struct fb_convert *cvt)
 	up16 = buf + cvt->src.fb->offsets[0] / sizeof(*buf);
 
 	for (i = 0; i < cvt->dst.fb->height; i++) {
-		if (needs_reswizzle) {
-			const uint16_t *u16_tmp = up16;
-			float *rgb_tmp = ptr;
+		uint16_to_float(up16, ptr, cvt->dst.fb->width * 4);
 
-			for (j = 0; j < cvt->dst.fb->width; j++) {
-				struct igt_vec4 rgb;
-
-				uint16_to_float(u16_tmp, rgb.d, 4);
-
-				rgb_tmp[0] = rgb.d[swz[0]];
-				rgb_tmp[1] = rgb.d[swz[1]];
-				rgb_tmp[2] = rgb.d[swz[2]];
-				rgb_tmp[3] = rgb.d[swz[3]];
-
-				rgb_tmp += 4;
-				u16_tmp += 4;
-			}
-		} else {
-			uint16_to_float(up16, ptr, cvt->dst.fb->width * 4);
-		}
+		if (needs_reswizzle)
+			swizzle_float_row(ptr, ptr, swz, cvt->dst.fb->width);
 
 		ptr += float_stride;
 		up16 += up16_stride;
@@ -4333,32 +5607,24 @@ static void convert_uint16_to_float(struct fb_convert *cvt)
 
 static void convert_float_to_uint16(struct fb_convert *cvt)
 {
-	int i, j;
+	int i;
 	uint16_t *up16 = cvt->dst.ptr + cvt->dst.fb->offsets[0];
 	const float *ptr = cvt->src.ptr;
 	unsigned float_stride = cvt->src.fb->strides[0] / sizeof(*ptr);
 	unsigned up16_stride = cvt->dst.fb->strides[0] / sizeof(*up16);
 	const unsigned char *swz = rgbx_swizzle(cvt->dst.fb->drm_format);
 	bool needs_reswizzle = swz != swizzle_rgbx;
+	float *row = NULL;
+
+	if (needs_reswizzle) {
+		row = malloc(cvt->dst.fb->width * 4 * sizeof(*row));
+		igt_assert(row);
+	}
 
 	for (i = 0; i < cvt->dst.fb->height; i++) {
 		if (needs_reswizzle) {
-			const float *rgb_tmp = ptr;
-			uint16_t *u16_tmp = up16;
-
-			for (j = 0; j < cvt->dst.fb->width; j++) {
-				struct igt_vec4 rgb;
-
-				rgb.d[0] = rgb_tmp[swz[0]];
-				rgb.d[1] = rgb_tmp[swz[1]];
-				rgb.d[2] = rgb_tmp[swz[2]];
-				rgb.d[3] = rgb_tmp[swz[3]];
-
-				float_to_uint16(rgb.d, u16_tmp, 4);
-
-				rgb_tmp += 4;
-				u16_tmp += 4;
-			}
+			swizzle_float_row(row, ptr, swz, cvt->dst.fb->width);
+			float_to_uint16(row, up16, cvt->dst.fb->width * 4);
 		} else {
 			float_to_uint16(ptr, up16, cvt->dst.fb->width * 4);
 		}
@@ -4366,6 +5632,8 @@ static void convert_float_to_uint16(struct fb_convert *cvt)
 		ptr += float_stride;
 		up16 += up16_stride;
 	}
+
+	free(row);
 }
 
 static void convert_pixman(struct fb_convert *cvt)
@@ -4407,7 +5675,7 @@ static void convert_pixman(struct fb_convert *cvt)
 	convert_src_put(cvt, src_ptr);
 }
 
-static void fb_convert(struct fb_convert *cvt)
+static void __fb_convert(struct fb_convert *cvt)
 {
 	if ((drm_format_to_pixman(cvt->src.fb->drm_format) != PIXMAN_invalid) &&
 	    (drm_format_to_pixman(cvt->dst.fb->drm_format) != PIXMAN_invalid)) {
@@ -4528,6 +5796,230 @@ static void fb_convert(struct fb_convert *cvt)
 		     IGT_FORMAT_ARGS(cvt->dst.fb->drm_format));
 }
 
+/*
+ * Large conversions are split into bands of rows which are converted in
+ * parallel by a small pool of worker threads. The pool is created on first
+ * use and kept around for the lifetime of the process. Setting
+ * IGT_FB_CONVERT_THREADS=1 disables the parallel conversion, any other
+ * value limits the number of threads used (including the caller).
+ */
+#define FB_CONVERT_MAX_THREADS 16
+#define FB_CONVERT_MIN_PIXELS (256 * 1024)
+
+struct fb_convert_band {
+	struct fb_convert	cvt;
+	struct igt_fb		src_fb;
+	struct igt_fb		dst_fb;
+};
+
+static struct {
+	pthread_mutex_t		busy;
+	pthread_mutex_t		lock;
+	pthread_cond_t		work;
+	pthread_cond_t		done;
+	int			num_threads;
+	struct fb_convert_band	*bands;
+	int			num_bands;
+	int			next_band;
+	int			bands_done;
+} convert_pool = {
+	.busy = PTHREAD_MUTEX_INITIALIZER,
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.work = PTHREAD_COND_INITIALIZER,
+	.done = PTHREAD_COND_INITIALIZER,
+};
+
+static pthread_once_t convert_pool_once = PTHREAD_ONCE_INIT;
+
+static void *fb_convert_worker(void *arg)
+{
+	pthread_mutex_lock(&convert_pool.lock);
+	for (;;) {
+		int band;
+
+		while (convert_pool.next_band >= convert_pool.num_bands)
+			pthread_cond_wait(&convert_pool.work, &convert_pool.lock);
+
+		band = convert_pool.next_band++;
+		pthread_mutex_unlock(&convert_pool.lock);
+
+		__fb_convert(&convert_pool.bands[band].cvt);
+
+		pthread_mutex_lock(&convert_pool.lock);
+		if (++convert_pool.bands_done == convert_pool.num_bands)
+			pthread_cond_signal(&convert_pool.done);
+	}
+
+	return NULL;
+}
+
+/*
+ * The workers are not inherited by forked children, which fall back to
+ * converting from the calling thread only.
+ */
+static void fb_convert_pool_atfork_child(void)
+{
+	pthread_mutex_init(&convert_pool.busy, NULL);
+	pthread_mutex_init(&convert_pool.lock, NULL);
+	pthread_cond_init(&convert_pool.work, NULL);
+	pthread_cond_init(&convert_pool.done, NULL);
+	convert_pool.num_threads = 0;
+	convert_pool.num_bands = 0;
+	convert_pool.next_band = 0;
+}
+
+static void fb_convert_pool_init(void)
+{
+	const char *env;
+	int max_threads;
+
+	max_threads = min_t(long, max_t(long, sysconf(_SC_NPROCESSORS_ONLN), 1),
+			    FB_CONVERT_MAX_THREADS);
+
+	env = getenv("IGT_FB_CONVERT_THREADS");
+	if (env)
+		max_threads = clamp(atoi(env), 1, FB_CONVERT_MAX_THREADS);
+
+	while (convert_pool.num_threads + 1 < max_threads) {
+		pthread_attr_t attr;
+		pthread_t thread;
+		int ret;
+
+		pthread_attr_init(&attr);
+		pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+		ret = pthread_create(&thread, &attr, fb_convert_worker, NULL);
+		pthread_attr_destroy(&attr);
+		if (ret)
+			break;
+
+		convert_pool.num_threads++;
+	}
+
+	pthread_atfork(NULL, NULL, fb_convert_pool_atfork_child);
+
+	igt_debug("fb_convert: using %d threads\n",
+		  convert_pool.num_threads + 1);
+}
+
+static void fb_convert_band_buf(struct fb_convert_buf *band,
+				struct igt_fb *band_fb,
+				const struct fb_convert_buf *buf, void *ptr,
+				unsigned int y, unsigned int height)
+{
+	const struct format_desc_struct *f = lookup_drm_format(buf->fb->drm_format);
+
+	*band_fb = *buf->fb;
+	band_fb->height = height;
+
+	band->fb = band_fb;
+	band->ptr = ptr;
+	band->slow_reads = false;
+
+	/*
+	 * The single plane conversions don't agree on whether they honour
+	 * offsets[0], so move the pointer instead which works either way.
+	 * All the multi-planar (YUV) conversions go through the offsets.
+	 */
+	if (band_fb->num_planes == 1) {
+		band->ptr += y * band_fb->strides[0];
+		return;
+	}
+
+	for (int i = 0; i < band_fb->num_planes; i++)
+		band_fb->offsets[i] += (i ? y / f->vsub : y) * band_fb->strides[i];
+}
+
+static void fb_convert(struct fb_convert *cvt)
+{
+	const struct format_desc_struct *src_fmt =
+		lookup_drm_format(cvt->src.fb->drm_format);
+	const struct format_desc_struct *dst_fmt =
+		lookup_drm_format(cvt->dst.fb->drm_format);
+	unsigned int height = cvt->dst.fb->height;
+	unsigned int align, band_height, y;
+	struct fb_convert_band *bands;
+	int num_threads, num_bands, i;
+	void *src_buf;
+
+	if ((uint64_t)cvt->dst.fb->width * height < FB_CONVERT_MIN_PIXELS ||
+	    cvt->src.fb->height != height) {
+		__fb_convert(cvt);
+		return;
+	}
+
+	pthread_once(&convert_pool_once, fb_convert_pool_init);
+
+	/* only one parallel conversion at a time, others run serially */
+	if (pthread_mutex_trylock(&convert_pool.busy)) {
+		__fb_convert(cvt);
+		return;
+	}
+
+	num_threads = convert_pool.num_threads + 1;
+	if (num_threads == 1) {
+		pthread_mutex_unlock(&convert_pool.busy);
+		__fb_convert(cvt);
+		return;
+	}
+
+	/* bands must not split the chroma subsampling blocks */
+	align = max(src_fmt->vsub, dst_fmt->vsub);
+	band_height = ALIGN(DIV_ROUND_UP(height, num_threads), align);
+	num_bands = DIV_ROUND_UP(height, band_height);
+
+	bands = calloc(num_bands, sizeof(*bands));
+	igt_assert(bands);
+
+	/* read the whole source once, not once per band */
+	src_buf = convert_src_get(cvt);
+
+	for (i = 0, y = 0; i < num_bands; i++, y += band_height) {
+		unsigned int h = min(band_height, height - y);
+
+		fb_convert_band_buf(&bands[i].cvt.src, &bands[i].src_fb,
+				    &cvt->src, src_buf, y, h);
+		fb_convert_band_buf(&bands[i].cvt.dst, &bands[i].dst_fb,
+				    &cvt->dst, cvt->dst.ptr, y, h);
+	}
+
+	/*
+	 * Convert the first band from the calling thread before waking up
+	 * the workers, so any assertion on the formats fires in the test
+	 * thread rather than in a worker.
+	 */
+	__fb_convert(&bands[0].cvt);
+
+	pthread_mutex_lock(&convert_pool.lock);
+	convert_pool.bands = bands;
+	convert_pool.num_bands = num_bands;
+	convert_pool.next_band = 1;
+	convert_pool.bands_done = 1;
+	pthread_cond_broadcast(&convert_pool.work);
+
+	while (convert_pool.next_band < convert_pool.num_bands) {
+		int band = convert_pool.next_band++;
+
+		pthread_mutex_unlock(&convert_pool.lock);
+		__fb_convert(&bands[band].cvt);
+		pthread_mutex_lock(&convert_pool.lock);
+
+		convert_pool.bands_done++;
+	}
+
+	while (convert_pool.bands_done < convert_pool.num_bands)
+		pthread_cond_wait(&convert_pool.done, &convert_pool.lock);
+
+	convert_pool.bands = NULL;
+	convert_pool.num_bands = 0;
+	convert_pool.next_band = 0;
+	pthread_mutex_unlock(&convert_pool.lock);
+
+	convert_src_put(cvt, src_buf);
+	free(bands);
+
+	pthread_mutex_unlock(&convert_pool.busy);
+}
+
 static void destroy_cairo_surface__convert(void *arg)
 {
 	struct fb_convert_blit_upload *blit = arg;
@@ -4625,6 +6117,8 @@ static void create_cairo_surface__convert(int fd, struct igt_fb *fb)
  */
 void *igt_fb_map_buffer(int fd, struct igt_fb *fb)
 {
+	fb_async_upload_wait(fb);
+
 	return map_bo(fd, fb);
 }
 
@@ -4662,9 +6156,17 @@ static bool use_convert(const struct igt_fb *fb)
 cairo_surface_t *igt_get_cairo_surface(int fd, struct igt_fb *fb)
 {
 	if (fb->cairo_surface == NULL) {
-		if (use_convert(fb))
+		/*
+		 * Only the __gpu path converts the format with its render
+		 * copy, even for fbs the __gtt path could map directly.
+		 */
+		bool gpu_convert = gpu_convert_format(fb);
+
+		fb_async_upload_wait(fb);
+
+		if (use_convert(fb) && !gpu_convert)
 			create_cairo_surface__convert(fd, fb);
-		else if (use_blitter(fb) || use_enginecopy(fb) ||
+		else if (gpu_convert || use_blitter(fb) || use_enginecopy(fb) ||
 			 igt_vc4_is_tiled(fb->modifier) ||
 			 igt_amd_is_tiled(fb->modifier) ||
 			 is_nouveau_device(fb->fd))
@@ -4723,6 +6225,65 @@ void igt_put_cairo_ctx(cairo_t *cr)
 	cairo_destroy(cr);
 }
 
+/**
+ * igt_put_cairo_ctx_async:
+ * @cr: the cairo context returned by igt_get_cairo_ctx.
+ *
+ * Same as igt_put_cairo_ctx(), except that when the changes have to be
+ * copied back to the framebuffer with the GPU, the copy is done in the
+ * background. The returned fence signals once the framebuffer is up to date,
+ * so it can be passed to igt_plane_set_fence_fd() to have the commit wait for
+ * the copy instead of the CPU stalling on it.
+ *
+ * Mapping the framebuffer, drawing to it again or removing it waits for the
+ * copy to complete.
+ *
+ * Returns:
+ * A sync_file fence the caller must close, or -1 if the framebuffer was
+ * already updated by the time this returns.
+ */
+int igt_put_cairo_ctx_async(cairo_t *cr)
+{
+	cairo_surface_t *surface = cairo_get_target(cr);
+	struct fb_async_upload *async;
+	struct fb_blit_upload *blit;
+	int timeline, fence;
+
+	blit = cairo_surface_get_user_data(surface,
+					   (cairo_user_data_key_t *)create_cairo_surface__gpu);
+
+	/* Only the last reference does the upload */
+	if (!blit || cairo_surface_get_reference_count(surface) != 1)
+		goto sync;
+
+	timeline = __sw_sync_timeline_create();
+	if (timeline < 0)
+		goto sync;
+
+	fence = __sw_sync_timeline_create_fence(timeline, 1);
+	if (fence < 0) {
+		close(timeline);
+		goto sync;
+	}
+
+	async = calloc(1, sizeof(*async));
+	igt_assert(async);
+	async->fb = blit->fb;
+	async->blit = blit;
+	async->fd = blit->fd;
+	async->timeline = timeline;
+	blit->async = async;
+
+	igt_put_cairo_ctx(cr);
+
+	return fence;
+
+sync:
+	igt_put_cairo_ctx(cr);
+
+	return -1;
+}
+
 /**
  * igt_remove_fb:
  * @fd: open drm file descriptor
@@ -4738,6 +6299,7 @@ void igt_remove_fb(int fd, struct igt_fb *fb)
 		return;
 
 	cairo_surface_destroy(fb->cairo_surface);
+	fb_async_upload_wait(fb);
 	do_or_die(drmModeRmFB(fd, fb->fb_id));
 	if (fb->is_dumb)
 		kmstest_dumb_destroy(fd, fb->gem_handle);
@@ -141,6 +141,11 @@ struct intel_buf *igt_fb_create_intel_buf(int fd, struct buf_ops *bops,
 					  const struct igt_fb *fb, const char *name);
 unsigned int igt_create_fb(int fd, int width, int height, uint32_t format,
 			   uint64_t modifier, struct igt_fb *fb);
+void igt_fb_set_pattern_cache_size(size_t size);
+void igt_fb_set_gpu_fill(bool enable);
+void igt_fb_set_gpu_convert(bool enable);
+void igt_fb_set_image_cache_size(size_t size);
+void igt_fb_release_staging_bos(int fd);
 unsigned int igt_create_color_fb(int fd, int width, int height,
 				 uint32_t format, uint64_t modifier,
 				 double r, double g, double b,
@@ -196,6 +201,7 @@ cairo_surface_t *igt_get_cairo_surface(int fd, struct igt_fb *fb);
 cairo_surface_t *igt_cairo_image_surface_create_from_png(const char *filename);
 cairo_t *igt_get_cairo_ctx(int fd, struct igt_fb *fb);
 void igt_put_cairo_ctx(cairo_t *cr);
+int igt_put_cairo_ctx_async(cairo_t *cr);
 void igt_paint_color(cairo_t *cr, int x, int y, int w, int h,
 			 double r, double g, double b);
 void igt_paint_color_rand(cairo_t *cr, int x, int y, int w, int h);
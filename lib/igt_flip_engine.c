@@ -0,0 +1,355 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2024 Intel Corporation
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <xf86drm.h>
+#include <xf86drmMode.h>
+
+#include "igt_core.h"
+#include "igt_flip_engine.h"
+
+/**
+ * SECTION:igt_flip_engine
+ * @short_description: Event driven multi-pipe flip loop
+ * @title: Flip engine
+ * @include: igt.h
+ *
+ * Keeps a flip in flight on each of a set of pipes, cycling through a set
+ * of framebuffers per pipe for a given time. Completion events are picked
+ * up by polling the DRM fd, so every pipe flips as fast as it can on its
+ * own rather than in lockstep with the slowest one, and are dispatched to a
+ * callback per pipe with the vblank sequence number and timestamp. The
+ * achieved flip rate and the number of missed vblanks are tracked per pipe
+ * and logged when the run ends.
+ *
+ * The kernel refuses to queue a flip on a CRTC that still has one pending,
+ * so there's at most one flip in flight per pipe.
+ *
+ * |[<!-- language="c" -->
+ *	engine = igt_flip_engine_create(&display, 0);
+ *	for_each_pipe_with_valid_output(&display, pipe, output)
+ *		igt_flip_engine_add_pipe(engine, pipe, primary[pipe],
+ *					 fbs[pipe], 2, NULL, NULL);
+ *	igt_flip_engine_run(engine, 5000);
+ *	igt_flip_engine_get_stats(engine, PIPE_A, &stats);
+ *	igt_flip_engine_free(engine);
+ * ]|
+ */
+
+struct flip_stream {
+	struct igt_flip_engine *engine;
+	bool used;
+	enum pipe pipe;
+	uint32_t crtc_id;
+	igt_plane_t *plane;
+	struct igt_fb *fbs;
+	int n_fbs;
+	unsigned long next;
+	struct igt_atomic_template *tmpl;
+	igt_flip_cb_t cb;
+	void *data;
+
+	bool pending;
+	uint64_t submit_ns;
+	bool has_sequence;
+	unsigned int last_sequence;
+	unsigned long flips;
+	unsigned long missed;
+};
+
+struct igt_flip_engine {
+	igt_display_t *display;
+	uint32_t flags;
+	bool stop;
+	uint64_t elapsed_ns;
+	struct flip_stream streams[IGT_MAX_PIPES];
+};
+
+/**
+ * igt_flip_engine_create:
+ * @display: display to flip on
+ * @flags: extra page flip flags, like DRM_MODE_PAGE_FLIP_ASYNC
+ *
+ * Creates a flip engine for @display. Flips go through atomic nonblocking
+ * commits if @display supports atomic, through the legacy page flip ioctl
+ * otherwise. The pipes must already be set up with a mode and a
+ * framebuffer compatible with the ones to flip to.
+ *
+ * Returns: the flip engine, to be freed with igt_flip_engine_free().
+ */
+struct igt_flip_engine *igt_flip_engine_create(igt_display_t *display,
+					       uint32_t flags)
+{
+	struct igt_flip_engine *engine;
+
+	engine = calloc(1, sizeof(*engine));
+	igt_assert(engine);
+
+	engine->display = display;
+	engine->flags = flags;
+
+	return engine;
+}
+
+/**
+ * igt_flip_engine_add_pipe:
+ * @engine: the flip engine
+ * @pipe: pipe to flip on
+ * @plane: plane of @pipe to flip
+ * @fbs: framebuffers to cycle through
+ * @n_fbs: number of framebuffers in @fbs
+ * @cb: optional callback for each completed flip
+ * @data: pointer passed to @cb
+ *
+ * Adds @pipe to the pipes flipped by igt_flip_engine_run(). Without atomic
+ * support only the primary plane can be flipped.
+ *
+ * Changes still pending on the display get committed along with every flip,
+ * so commit the initial configuration before adding pipes.
+ */
+void igt_flip_engine_add_pipe(struct igt_flip_engine *engine, enum pipe pipe,
+			      igt_plane_t *plane, struct igt_fb *fbs, int n_fbs,
+			      igt_flip_cb_t cb, void *data)
+{
+	igt_display_t *display = engine->display;
+	struct flip_stream *stream;
+
+	igt_assert(pipe >= 0 && pipe < IGT_MAX_PIPES);
+	igt_assert(n_fbs > 0);
+
+	stream = &engine->streams[pipe];
+	igt_assert(!stream->used);
+
+	memset(stream, 0, sizeof(*stream));
+	stream->engine = engine;
+	stream->used = true;
+	stream->pipe = pipe;
+	stream->crtc_id = display->pipes[pipe].crtc_id;
+	stream->plane = plane;
+	stream->fbs = fbs;
+	stream->n_fbs = n_fbs;
+	stream->cb = cb;
+	stream->data = data;
+
+	if (display->is_atomic)
+		stream->tmpl = igt_atomic_template_capture(display);
+	else
+		igt_assert(plane->type == DRM_PLANE_TYPE_PRIMARY);
+}
+
+/* Same clock as the kernel event timestamps */
+static uint64_t monotonic_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void queue_flip(struct flip_stream *stream)
+{
+	struct igt_flip_engine *engine = stream->engine;
+	struct igt_fb *fb = &stream->fbs[stream->next % stream->n_fbs];
+	int ret;
+
+	stream->submit_ns = monotonic_ns();
+
+	if (stream->tmpl) {
+		igt_atomic_template_set_fb(stream->tmpl, stream->plane, fb);
+		ret = igt_atomic_template_try_commit(stream->tmpl,
+						     DRM_MODE_ATOMIC_NONBLOCK |
+						     DRM_MODE_PAGE_FLIP_EVENT |
+						     engine->flags,
+						     stream);
+	} else {
+		ret = drmModePageFlip(engine->display->drm_fd, stream->crtc_id,
+				      fb->fb_id,
+				      DRM_MODE_PAGE_FLIP_EVENT | engine->flags,
+				      stream);
+	}
+
+	igt_assert_f(ret == 0, "Queuing flip %lu on pipe %s failed: %s\n",
+		     stream->next, kmstest_pipe_name(stream->pipe),
+		     strerror(-ret));
+
+	stream->next++;
+	stream->pending = true;
+}
+
+static void flip_handler(int fd, unsigned int sequence, unsigned int tv_sec,
+			 unsigned int tv_usec, unsigned int crtc_id,
+			 void *user_data)
+{
+	struct flip_stream *stream = user_data;
+	struct igt_flip_engine *engine = stream->engine;
+	uint64_t received_ns = monotonic_ns();
+	igt_flip_event_t ev;
+
+	igt_assert_eq(crtc_id, stream->crtc_id);
+	igt_assert(stream->pending);
+
+	stream->pending = false;
+	stream->flips++;
+
+	/* Async flips don't wait for vblank, several can land in a frame */
+	if (stream->has_sequence && !(engine->flags & DRM_MODE_PAGE_FLIP_ASYNC) &&
+	    sequence - stream->last_sequence > 1)
+		stream->missed += sequence - stream->last_sequence - 1;
+
+	stream->has_sequence = true;
+	stream->last_sequence = sequence;
+
+	if (!stream->cb)
+		return;
+
+	ev.pipe = stream->pipe;
+	ev.frame = stream->flips;
+	ev.sequence = sequence;
+	ev.timestamp_ns = tv_sec * 1000000000ull + tv_usec * 1000ull;
+	ev.submit_ns = stream->submit_ns;
+	ev.received_ns = received_ns;
+	ev.fb = &stream->fbs[(stream->next - 1) % stream->n_fbs];
+
+	stream->cb(engine, &ev, stream->data);
+}
+
+/**
+ * igt_flip_engine_run:
+ * @engine: the flip engine
+ * @duration_ms: how long to keep flipping
+ *
+ * Flips on all the added pipes for @duration_ms, or until
+ * igt_flip_engine_stop() is called, and then waits for the flips still in
+ * flight. Statistics are reset at the start of each run and logged at the
+ * end.
+ *
+ * Fails the test if queuing a flip fails, or if no flip completes for a
+ * second.
+ */
+void igt_flip_engine_run(struct igt_flip_engine *engine,
+			 unsigned int duration_ms)
+{
+	drmEventContext evctx = {
+		.version = 3,
+		.page_flip_handler2 = flip_handler,
+	};
+	struct pollfd pfd = {
+		.fd = engine->display->drm_fd,
+		.events = POLLIN,
+	};
+	uint64_t duration_ns = duration_ms * 1000000ull;
+	struct timespec start = {};
+	bool pending;
+	int i;
+
+	engine->stop = false;
+
+	for (i = 0; i < IGT_MAX_PIPES; i++) {
+		struct flip_stream *stream = &engine->streams[i];
+
+		stream->has_sequence = false;
+		stream->flips = 0;
+		stream->missed = 0;
+	}
+
+	igt_nsec_elapsed(&start);
+
+	do {
+		bool queue = !engine->stop &&
+			igt_nsec_elapsed(&start) < duration_ns;
+
+		pending = false;
+		for (i = 0; i < IGT_MAX_PIPES; i++) {
+			struct flip_stream *stream = &engine->streams[i];
+
+			if (!stream->used)
+				continue;
+
+			if (!stream->pending && queue)
+				queue_flip(stream);
+
+			pending |= stream->pending;
+		}
+
+		if (!pending)
+			break;
+
+		igt_assert_f(poll(&pfd, 1, 1000) == 1,
+			     "Timed out waiting for flips to complete\n");
+		igt_assert_eq(drmHandleEvent(pfd.fd, &evctx), 0);
+	} while (1);
+
+	engine->elapsed_ns = igt_nsec_elapsed(&start);
+
+	for (i = 0; i < IGT_MAX_PIPES; i++) {
+		igt_flip_stats_t stats;
+
+		if (!engine->streams[i].used)
+			continue;
+
+		igt_flip_engine_get_stats(engine, i, &stats);
+		igt_info("Pipe %s: %lu flips, %.1f flips/s, %lu missed vblanks\n",
+			 kmstest_pipe_name(i), stats.flips, stats.flips_per_sec,
+			 stats.missed);
+	}
+}
+
+/**
+ * igt_flip_engine_stop:
+ * @engine: the flip engine
+ *
+ * Stops queuing flips, making igt_flip_engine_run() return once the flips in
+ * flight completed. Meant to be called from an #igt_flip_cb_t.
+ */
+void igt_flip_engine_stop(struct igt_flip_engine *engine)
+{
+	engine->stop = true;
+}
+
+/**
+ * igt_flip_engine_get_stats:
+ * @engine: the flip engine
+ * @pipe: pipe to get the statistics of
+ * @stats: filled with the statistics of the last igt_flip_engine_run()
+ */
+void igt_flip_engine_get_stats(struct igt_flip_engine *engine, enum pipe pipe,
+			       igt_flip_stats_t *stats)
+{
+	struct flip_stream *stream;
+
+	igt_assert(pipe >= 0 && pipe < IGT_MAX_PIPES);
+	stream = &engine->streams[pipe];
+	igt_assert(stream->used);
+
+	stats->flips = stream->flips;
+	stats->missed = stream->missed;
+	stats->flips_per_sec = engine->elapsed_ns ?
+		stream->flips * 1e9 / engine->elapsed_ns : 0;
+}
+
+/**
+ * igt_flip_engine_free:
+ * @engine: the flip engine
+ *
+ * Releases @engine. No flips may be in flight, which is guaranteed once
+ * igt_flip_engine_run() returned.
+ */
+void igt_flip_engine_free(struct igt_flip_engine *engine)
+{
+	int i;
+
+	if (!engine)
+		return;
+
+	for (i = 0; i < IGT_MAX_PIPES; i++)
+		igt_atomic_template_free(engine->streams[i].tmpl);
+
+	free(engine);
+}
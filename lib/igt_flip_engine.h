@@ -0,0 +1,78 @@
+/* SPDX-License-Identifier: MIT */
+/*
+ * Copyright © 2024 Intel Corporation
+ */
+
+#ifndef IGT_FLIP_ENGINE_H
+#define IGT_FLIP_ENGINE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "igt_fb.h"
+#include "igt_kms.h"
+
+struct igt_flip_engine;
+
+/**
+ * igt_flip_event_t:
+ * @pipe: pipe the flip completed on
+ * @frame: number of flips completed on @pipe so far, starting at 1
+ * @sequence: vblank sequence number reported by the kernel
+ * @timestamp_ns: vblank timestamp reported by the kernel, CLOCK_MONOTONIC
+ * @submit_ns: when the flip was queued, CLOCK_MONOTONIC
+ * @received_ns: when the flip event was read, CLOCK_MONOTONIC
+ * @fb: framebuffer that got flipped to
+ *
+ * Completion of a single flip, passed to the #igt_flip_cb_t of the pipe.
+ */
+typedef struct {
+	enum pipe pipe;
+	unsigned long frame;
+	unsigned int sequence;
+	uint64_t timestamp_ns;
+	uint64_t submit_ns;
+	uint64_t received_ns;
+	struct igt_fb *fb;
+} igt_flip_event_t;
+
+/**
+ * igt_flip_cb_t:
+ * @engine: the flip engine
+ * @ev: the completed flip
+ * @data: pointer passed to igt_flip_engine_add_pipe()
+ *
+ * Called for each completed flip, before the next flip on the same pipe is
+ * queued. Call igt_flip_engine_stop() to end the run early.
+ */
+typedef void (*igt_flip_cb_t)(struct igt_flip_engine *engine,
+			      const igt_flip_event_t *ev, void *data);
+
+/**
+ * igt_flip_stats_t:
+ * @flips: number of completed flips
+ * @missed: number of vblanks without a flip in between two flips, only
+ *          counted for vblank synchronized flips
+ * @flips_per_sec: flip rate over the run
+ *
+ * Flip statistics of a pipe, see igt_flip_engine_get_stats().
+ */
+typedef struct {
+	unsigned long flips;
+	unsigned long missed;
+	double flips_per_sec;
+} igt_flip_stats_t;
+
+struct igt_flip_engine *igt_flip_engine_create(igt_display_t *display,
+					       uint32_t flags);
+void igt_flip_engine_add_pipe(struct igt_flip_engine *engine, enum pipe pipe,
+			      igt_plane_t *plane, struct igt_fb *fbs, int n_fbs,
+			      igt_flip_cb_t cb, void *data);
+void igt_flip_engine_run(struct igt_flip_engine *engine,
+			 unsigned int duration_ms);
+void igt_flip_engine_stop(struct igt_flip_engine *engine);
+void igt_flip_engine_get_stats(struct igt_flip_engine *engine, enum pipe pipe,
+			       igt_flip_stats_t *stats);
+void igt_flip_engine_free(struct igt_flip_engine *engine);
+
+#endif /* IGT_FLIP_ENGINE_H */
@@ -29,11 +29,18 @@
 #include <fcntl.h>
 #include <pixman.h>
 #include <cairo.h>
+#include <stdint.h>
+#include <stdlib.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include <gsl/gsl_statistics_double.h>
 #include <gsl/gsl_fit.h>
 
 #include "igt_frame.h"
+#include "igt_aux.h"
 #include "igt_core.h"
+#include "igt_frame_dump.h"
 
 /**
  * SECTION:igt_frame
@@ -64,7 +71,8 @@ static void igt_write_frame_to_png(cairo_surface_t *surface, int fd,
 	const char *test_name;
 	const char *subtest_name;
 	const char *dynamic_subtest_name;
-	cairo_status_t status;
+	enum igt_frame_dump_format format = igt_frame_dump_get_format();
+	const char *ext = igt_frame_dump_extension(format);
 	int index;
 
 	test_name = igt_test_name();
@@ -72,19 +80,18 @@ static void igt_write_frame_to_png(cairo_surface_t *surface, int fd,
 	dynamic_subtest_name = igt_dynamic_subtest_name();
 
 	if (suffix)
-		snprintf(path, PATH_MAX, "%s/frame-%s-%s-%s-%s-%s.png",
+		snprintf(path, PATH_MAX, "%s/frame-%s-%s-%s-%s-%s.%s",
 			 igt_frame_dump_path, test_name, subtest_name,
-			 dynamic_subtest_name,  qualifier, suffix);
+			 dynamic_subtest_name,  qualifier, suffix, ext);
 	else
-		snprintf(path, PATH_MAX, "%s/frame-%s-%s-%s-%s.png",
+		snprintf(path, PATH_MAX, "%s/frame-%s-%s-%s-%s.%s",
 			 igt_frame_dump_path, test_name, subtest_name,
-			 dynamic_subtest_name, qualifier);
+			 dynamic_subtest_name, qualifier, ext);
 
 	igt_debug("Dumping %s frame to %s...\n", qualifier, path);
 
-	status = cairo_surface_write_to_png(surface, path);
-
-	igt_assert_eq(status, CAIRO_STATUS_SUCCESS);
+	/* Written in the background, see igt_frame_dump_flush() */
+	igt_frame_dump_queue(surface, path, format);
 
 	index = strlen(path);
 
@@ -103,7 +110,9 @@ static void igt_write_frame_to_png(cairo_surface_t *surface, int fd,
  * @reference_suffix: The suffix to give to the reference png file
  * @capture_suffix: The suffix to give to the capture png file
  *
- * Write previously compared frames to png files.
+ * Write previously compared frames to png files, or to raw frame dumps with
+ * IGT_FRAME_DUMP_FORMAT=raw. The files are written in the background, the
+ * dump report listing them right away.
  */
 void igt_write_compared_frames_to_png(cairo_surface_t *reference,
 				      cairo_surface_t *capture,
@@ -184,8 +193,9 @@ bool igt_check_analog_frame_match(cairo_surface_t *reference,
 	double c0, c1, cov00, cov01, cov11, sumsq;
 	double correlation;
 	unsigned char *reference_pixels, *capture_pixels;
-	unsigned char *p;
-	unsigned char *q;
+	int reference_stride, capture_stride;
+	const unsigned char *p;
+	const unsigned char *q;
 	bool match = true;
 	int diff;
 	int x, y;
@@ -199,19 +209,24 @@ bool igt_check_analog_frame_match(cairo_surface_t *reference,
 	    (void*)cairo_image_surface_get_data(reference),
 	    cairo_image_surface_get_stride(reference));
 	reference_pixels = (unsigned char *) pixman_image_get_data(reference_src);
+	reference_stride = pixman_image_get_stride(reference_src);
 
 	capture_src = pixman_image_create_bits(
 	    PIXMAN_x8r8g8b8, w, h,
 	    (void*)cairo_image_surface_get_data(capture),
 	    cairo_image_surface_get_stride(capture));
 	capture_pixels = (unsigned char *) pixman_image_get_data(capture_src);
+	capture_stride = pixman_image_get_stride(capture_src);
 
-	/* Collect the absolute error for each color value */
-	for (x = 0; x < w; x++) {
-		for (y = 0; y < h; y++) {
-			p = &capture_pixels[(x + y * w) * 4];
-			q = &reference_pixels[(x + y * w) * 4];
+	/*
+	 * Collect the absolute error for each color value, walking the
+	 * frames in memory order.
+	 */
+	for (y = 0; y < h; y++) {
+		p = capture_pixels + y * capture_stride;
+		q = reference_pixels + y * reference_stride;
 
+		for (x = 0; x < w; x++, p += 4, q += 4) {
 			for (i = 0; i < 3; i++) {
 				diff = (int) p[i] - q[i];
 				if (diff < 0)
@@ -275,8 +290,122 @@ complete:
 	return match;
 }
 
-#define XR24_COLOR_VALUE(data, stride, x, y, c) \
-	*((uint8_t *)(data) + (y) * (stride) + 4 * (x) + (c))
+#define XR24_ROW(data, stride, y) ((const uint8_t *)(data) + (y) * (stride))
+
+#define CHECKERBOARD_TILE 64
+
+static inline unsigned int xr24_diff_sum(const uint8_t *a, const uint8_t *b)
+{
+	return abs(a[0] - b[0]) + abs(a[1] - b[1]) + abs(a[2] - b[2]);
+}
+
+static inline bool xr24_diff_above(const uint8_t *a, const uint8_t *b,
+				   unsigned int threshold)
+{
+	return abs(a[0] - b[0]) > threshold ||
+		abs(a[1] - b[1]) > threshold ||
+		abs(a[2] - b[2]) > threshold;
+}
+
+#ifdef __SSE2__
+/* Per-channel absolute difference of 4 XR24 pixels, X channel cleared */
+static inline __m128i xr24_absdiff(const uint8_t *a, const uint8_t *b)
+{
+	__m128i va = _mm_loadu_si128((const __m128i *)a);
+	__m128i vb = _mm_loadu_si128((const __m128i *)b);
+	__m128i d = _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));
+
+	return _mm_and_si128(d, _mm_set1_epi32(0x00ffffff));
+}
+
+/* Sum of the absolute channel differences of 4 pixels, as 4 x 32 bits */
+static inline __m128i xr24_diff_sum4(const uint8_t *a, const uint8_t *b)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i ones = _mm_set1_epi16(1);
+	__m128i d = xr24_absdiff(a, b);
+	__m128i lo, hi;
+
+	/* Sums channel pairs, then the two pairs of each pixel */
+	lo = _mm_madd_epi16(_mm_unpacklo_epi8(d, zero), ones);
+	hi = _mm_madd_epi16(_mm_unpackhi_epi8(d, zero), ones);
+	lo = _mm_add_epi32(lo, _mm_srli_epi64(lo, 32));
+	hi = _mm_add_epi32(hi, _mm_srli_epi64(hi, 32));
+
+	return _mm_unpacklo_epi64(_mm_shuffle_epi32(lo, _MM_SHUFFLE(3, 1, 2, 0)),
+				  _mm_shuffle_epi32(hi, _MM_SHUFFLE(3, 1, 2, 0)));
+}
+#endif
+
+/* Marks the edges of row @y between @span and @width - @span */
+static void checkerboard_edges_row(const uint8_t *row, const uint8_t *up,
+				   const uint8_t *down, unsigned int width,
+				   unsigned int span, unsigned int threshold,
+				   unsigned char *edges)
+{
+	unsigned int x = span;
+
+#ifdef __SSE2__
+	const __m128i thr = _mm_set1_epi32(threshold);
+
+	for (; x + 4 + span <= width; x += 4) {
+		__m128i xdiff = xr24_diff_sum4(row + 4 * (x + span),
+					       row + 4 * (x - span));
+		__m128i ydiff = xr24_diff_sum4(down + 4 * x, up + 4 * x);
+		int mask;
+
+		mask = _mm_movemask_ps(_mm_castsi128_ps(
+			_mm_or_si128(_mm_cmpgt_epi32(xdiff, thr),
+				     _mm_cmpgt_epi32(ydiff, thr))));
+
+		edges[x + 0] = mask & 1;
+		edges[x + 1] = (mask >> 1) & 1;
+		edges[x + 2] = (mask >> 2) & 1;
+		edges[x + 3] = (mask >> 3) & 1;
+	}
+#endif
+
+	for (; x + span < width; x++) {
+		unsigned int xdiff, ydiff;
+
+		xdiff = xr24_diff_sum(row + 4 * (x + span), row + 4 * (x - span));
+		ydiff = xr24_diff_sum(down + 4 * x, up + 4 * x);
+
+		edges[x] = xdiff > threshold || ydiff > threshold;
+	}
+}
+
+/*
+ * Returns a bitmask of the pixels among the @n (up to 4) starting at @x
+ * with a channel differing by more than @threshold.
+ */
+static unsigned int checkerboard_errors(const uint8_t *ref, const uint8_t *cap,
+					unsigned int x, unsigned int n,
+					unsigned int threshold)
+{
+	unsigned int mask = 0, i;
+
+#ifdef __SSE2__
+	if (n == 4) {
+		__m128i over = _mm_subs_epu8(xr24_absdiff(ref + 4 * x, cap + 4 * x),
+					     _mm_set1_epi8(threshold));
+		int bytes = ~_mm_movemask_epi8(_mm_cmpeq_epi8(over,
+							      _mm_setzero_si128()));
+
+		for (i = 0; i < 4; i++)
+			if ((bytes >> (4 * i)) & 0x7)
+				mask |= 1 << i;
+
+		return mask;
+	}
+#endif
+
+	for (i = 0; i < n; i++)
+		if (xr24_diff_above(ref + 4 * (x + i), cap + 4 * (x + i), threshold))
+			mask |= 1 << i;
+
+	return mask;
+}
 
 /**
  * igt_check_checkerboard_frame_match:
@@ -313,13 +442,14 @@ bool igt_check_checkerboard_frame_match(cairo_surface_t *reference,
 	unsigned int width, height, ref_stride, cap_stride;
 	void *ref_data, *cap_data;
 	unsigned char *edges_map;
-	unsigned int x, y, c;
+	unsigned int x, y;
 	unsigned int errors = 0, pixels = 0;
 	unsigned int edge_threshold = 100;
 	unsigned int color_error_threshold = 24;
 	double error_rate_threshold = 0.01;
-	double error_rate;
+	double error_rate, max_errors;
 	unsigned int span = 2;
+	unsigned int tiles_x, tiles_y, *tile_errors, worst = 0;
 	bool match = false;
 
 	width = cairo_image_surface_get_width(reference);
@@ -336,76 +466,93 @@ bool igt_check_checkerboard_frame_match(cairo_surface_t *reference,
 	edges_map = calloc(1, width * height);
 	igt_assert(edges_map);
 
-	/* First pass to detect the pattern edges. */
-	for (y = 0; y < height; y++) {
-		if (y < span || y > (height - span - 1))
-			continue;
+	tiles_x = DIV_ROUND_UP(width, CHECKERBOARD_TILE);
+	tiles_y = DIV_ROUND_UP(height, CHECKERBOARD_TILE);
+	tile_errors = calloc(tiles_x * tiles_y, sizeof(*tile_errors));
+	igt_assert(tile_errors);
 
-		for (x = 0; x < width; x++) {
-			unsigned int xdiff = 0, ydiff = 0;
+	/* First pass to detect the pattern edges. */
+	for (y = span; y + span < height; y++)
+		checkerboard_edges_row(XR24_ROW(ref_data, ref_stride, y),
+				       XR24_ROW(ref_data, ref_stride, y - span),
+				       XR24_ROW(ref_data, ref_stride, y + span),
+				       width, span, edge_threshold,
+				       &edges_map[y * width]);
 
-			if (x < span || x > (width - span - 1))
-				continue;
+	/*
+	 * Second pass to detect errors. At most all the pixels get compared,
+	 * so once there are that many errors the frames can't match anymore.
+	 */
+	max_errors = error_rate_threshold * width * height;
 
-			for (c = 0; c < 3; c++) {
-				xdiff += abs(XR24_COLOR_VALUE(ref_data, ref_stride, x + span, y, c) -
-					     XR24_COLOR_VALUE(ref_data, ref_stride, x - span, y, c));
-				ydiff += abs(XR24_COLOR_VALUE(ref_data, ref_stride, x, y + span, c) -
-					     XR24_COLOR_VALUE(ref_data, ref_stride, x, y - span, c));
-			}
+	for (y = 0; y < height && errors < max_errors; y++) {
+		const uint8_t *ref = XR24_ROW(ref_data, ref_stride, y);
+		const uint8_t *cap = XR24_ROW(cap_data, cap_stride, y);
+		const unsigned char *edges = &edges_map[y * width];
 
-			edges_map[y * width + x] = (xdiff > edge_threshold ||
-						    ydiff > edge_threshold);
-		}
-	}
+		for (x = 0; x < width; x += 4) {
+			unsigned int n = min(4u, width - x);
+			unsigned int mask, i;
 
-	/* Second pass to detect errors. */
-	for (y = 0; y < height; y++) {
-		for (x = 0; x < width; x++) {
-			bool error = false;
+			mask = checkerboard_errors(ref, cap, x, n,
+						   color_error_threshold);
 
-			if (edges_map[y * width + x])
-				continue;
+			for (i = 0; i < n; i++) {
+				unsigned int px = x + i;
+				bool error = mask & (1 << i);
 
-			for (c = 0; c < 3; c++) {
-				unsigned int diff;
+				if (edges[px])
+					continue;
 
-				/* Compare the reference and capture values. */
-				diff = abs(XR24_COLOR_VALUE(ref_data, ref_stride, x, y, c) -
-					   XR24_COLOR_VALUE(cap_data, cap_stride, x, y, c));
+				/* Allow error if coming on or off an edge (on x). */
+				if (error && px >= span && px <= (width - span - 1) &&
+				    edges[px - span] != edges[px + span])
+					continue;
 
-				if (diff > color_error_threshold)
-					error = true;
-			}
+				/* Allow error if coming on or off an edge (on y). */
+				if (error && y >= span && y <= (height - span - 1) &&
+				    edges_map[(y - span) * width + px] !=
+				    edges_map[(y + span) * width + px])
+					continue;
 
-			/* Allow error if coming on or off an edge (on x). */
-			if (error && x >= span && x <= (width - span - 1) &&
-			    edges_map[y * width + (x - span)] !=
-			    edges_map[y * width + (x + span)])
-				continue;
+				if (error) {
+					errors++;
+					tile_errors[(y / CHECKERBOARD_TILE) * tiles_x +
+						    px / CHECKERBOARD_TILE]++;
+				}
 
-			/* Allow error if coming on or off an edge (on y). */
-			if (error && y >= span && y <= (height - span - 1) &&
-			    edges_map[(y - span) * width + x] !=
-			    edges_map[(y + span) * width + x] && error)
-				continue;
+				pixels++;
+			}
+		}
+	}
 
-			if (error)
-				errors++;
+	if (errors >= max_errors) {
+		error_rate = (double) errors / (width * height);
+	} else {
+		error_rate = (double) errors / pixels;
 
-			pixels++;
-		}
+		if (error_rate < error_rate_threshold)
+			match = true;
 	}
 
-	free(edges_map);
+	igt_debug("Checkerboard pattern %s with error rate %s%f %%\n",
+		  match ? "matched" : "not matched",
+		  errors >= max_errors ? "at least " : "", error_rate * 100);
 
-	error_rate = (double) errors / pixels;
+	if (!match) {
+		for (x = 1; x < tiles_x * tiles_y; x++)
+			if (tile_errors[x] > tile_errors[worst])
+				worst = x;
 
-	if (error_rate < error_rate_threshold)
-		match = true;
+		igt_debug("Most errors (%u) in the %ux%u block at %u,%u\n",
+			  tile_errors[worst],
+			  CHECKERBOARD_TILE, CHECKERBOARD_TILE,
+			  (worst % tiles_x) * CHECKERBOARD_TILE,
+			  (worst / tiles_x) * CHECKERBOARD_TILE);
+	}
 
-	igt_debug("Checkerboard pattern %s with error rate %f %%\n",
-		  match ? "matched" : "not matched", error_rate * 100);
+	free(tile_errors);
+	free(edges_map);
 
 	return match;
 }
@@ -0,0 +1,413 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2025 Intel Corporation
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "igt_aux.h"
+#include "igt_core.h"
+#include "igt_frame_dump.h"
+
+/**
+ * SECTION:igt_frame_dump
+ * @short_description: Asynchronous frame dumping
+ * @title: Frame dump
+ * @include: igt_frame_dump.h
+ *
+ * Helpers writing frames to files from a background thread, so that dumping
+ * many frames doesn't change the timing of the test dumping them.
+ *
+ * igt_frame_dump_queue() takes a copy of the frame and its capture time and
+ * hands it to the writer thread through a bounded queue, only blocking when
+ * the writer is that far behind. The writer encodes PNGs or, with
+ * IGT_FRAME_DUMP_FORMAT=raw in the environment, writes the pixels as they are
+ * after a #igt_frame_raw_header, which is much cheaper. igt_frame_convert
+ * turns the raw dumps into PNGs afterwards.
+ *
+ * The queue is flushed when the test exits.
+ */
+
+#define FRAME_DUMP_QUEUE_LEN 16
+
+struct frame_dump {
+	cairo_surface_t *surface;
+	char *path;
+	enum igt_frame_dump_format format;
+	uint64_t timestamp_ns;
+	uint64_t realtime_ns;
+};
+
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct frame_dump *queue[FRAME_DUMP_QUEUE_LEN];
+	unsigned int head, count;
+	bool busy;
+	pid_t pid;
+} dumper = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+};
+
+static uint64_t clock_ns(clockid_t clock)
+{
+	struct timespec ts;
+
+	clock_gettime(clock, &ts);
+
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/**
+ * igt_frame_dump_get_format:
+ *
+ * Returns: The frame dump format selected by IGT_FRAME_DUMP_FORMAT, "png"
+ * (the default) or "raw".
+ */
+enum igt_frame_dump_format igt_frame_dump_get_format(void)
+{
+	const char *format = getenv("IGT_FRAME_DUMP_FORMAT");
+
+	if (format && !strcmp(format, "raw"))
+		return IGT_FRAME_DUMP_RAW;
+
+	return IGT_FRAME_DUMP_PNG;
+}
+
+/**
+ * igt_frame_dump_extension:
+ * @format: The frame dump format
+ *
+ * Returns: The file name extension of the dumps in @format.
+ */
+const char *igt_frame_dump_extension(enum igt_frame_dump_format format)
+{
+	return format == IGT_FRAME_DUMP_RAW ? "igtraw" : "png";
+}
+
+static int write_all(int fd, const void *buf, size_t len)
+{
+	const char *p = buf;
+
+	while (len) {
+		ssize_t ret = write(fd, p, len);
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+
+		p += ret;
+		len -= ret;
+	}
+
+	return 0;
+}
+
+/**
+ * igt_frame_raw_write:
+ * @surface: The image surface to dump
+ * @path: The file to write
+ * @timestamp_ns: CLOCK_MONOTONIC capture time of the frame
+ * @realtime_ns: CLOCK_REALTIME capture time of the frame
+ *
+ * Writes @surface to @path uncompressed, after a #igt_frame_raw_header.
+ *
+ * Returns: 0 on success, a negative errno otherwise.
+ */
+int igt_frame_raw_write(cairo_surface_t *surface, const char *path,
+			uint64_t timestamp_ns, uint64_t realtime_ns)
+{
+	struct igt_frame_raw_header header = {
+		.magic = IGT_FRAME_RAW_MAGIC,
+		.version = IGT_FRAME_RAW_VERSION,
+		.timestamp_ns = timestamp_ns,
+		.realtime_ns = realtime_ns,
+	};
+	int fd, ret;
+
+	if (cairo_surface_get_type(surface) != CAIRO_SURFACE_TYPE_IMAGE)
+		return -EINVAL;
+
+	cairo_surface_flush(surface);
+	header.format = cairo_image_surface_get_format(surface);
+	header.width = cairo_image_surface_get_width(surface);
+	header.height = cairo_image_surface_get_height(surface);
+	header.stride = cairo_image_surface_get_stride(surface);
+
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		return -errno;
+
+	ret = write_all(fd, &header, sizeof(header));
+	if (!ret)
+		ret = write_all(fd, cairo_image_surface_get_data(surface),
+				(size_t)header.stride * header.height);
+
+	close(fd);
+
+	return ret;
+}
+
+static int read_all(int fd, void *buf, size_t len)
+{
+	char *p = buf;
+
+	while (len) {
+		ssize_t ret = read(fd, p, len);
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		if (!ret)
+			return -EIO;
+
+		p += ret;
+		len -= ret;
+	}
+
+	return 0;
+}
+
+/**
+ * igt_frame_raw_read:
+ * @path: The raw frame dump to read
+ * @header: Returns the header of the dump, may be NULL
+ *
+ * Reads a frame written by igt_frame_raw_write().
+ *
+ * Returns: A new image surface holding the frame, or NULL with errno set if
+ * @path can't be read or isn't a raw frame dump.
+ */
+cairo_surface_t *igt_frame_raw_read(const char *path,
+				    struct igt_frame_raw_header *header)
+{
+	struct igt_frame_raw_header hdr;
+	cairo_surface_t *surface = NULL;
+	unsigned char *data;
+	int fd, stride, ret;
+	uint32_t y;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+
+	ret = read_all(fd, &hdr, sizeof(hdr));
+	if (ret)
+		goto out;
+
+	ret = -EINVAL;
+	if (memcmp(hdr.magic, IGT_FRAME_RAW_MAGIC, sizeof(hdr.magic)) ||
+	    hdr.version != IGT_FRAME_RAW_VERSION)
+		goto out;
+
+	surface = cairo_image_surface_create(hdr.format, hdr.width, hdr.height);
+	if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS)
+		goto out;
+
+	data = cairo_image_surface_get_data(surface);
+	stride = cairo_image_surface_get_stride(surface);
+	if (stride > hdr.stride)
+		goto out;
+
+	for (y = 0; y < hdr.height; y++) {
+		ret = read_all(fd, data + y * stride, stride);
+		if (!ret && hdr.stride > stride)
+			ret = lseek(fd, hdr.stride - stride, SEEK_CUR) < 0 ?
+				-errno : 0;
+		if (ret)
+			goto out;
+	}
+	cairo_surface_mark_dirty(surface);
+
+	if (header)
+		*header = hdr;
+out:
+	close(fd);
+	if (ret && surface) {
+		cairo_surface_destroy(surface);
+		surface = NULL;
+	}
+	if (ret)
+		errno = -ret;
+
+	return surface;
+}
+
+static void frame_dump_write(struct frame_dump *dump)
+{
+	int ret;
+
+	if (dump->format == IGT_FRAME_DUMP_RAW)
+		ret = igt_frame_raw_write(dump->surface, dump->path,
+					  dump->timestamp_ns,
+					  dump->realtime_ns);
+	else
+		ret = cairo_surface_write_to_png(dump->surface, dump->path) ==
+			CAIRO_STATUS_SUCCESS ? 0 : -EIO;
+
+	if (ret)
+		igt_warn("Failed to dump frame to %s: %s\n", dump->path,
+			 strerror(-ret));
+
+	cairo_surface_destroy(dump->surface);
+	free(dump->path);
+	free(dump);
+}
+
+static void *frame_dump_thread(void *data)
+{
+	struct frame_dump *dump;
+
+	for (;;) {
+		pthread_mutex_lock(&dumper.lock);
+		while (!dumper.count)
+			pthread_cond_wait(&dumper.cond, &dumper.lock);
+
+		dump = dumper.queue[dumper.head];
+		dumper.head = (dumper.head + 1) % FRAME_DUMP_QUEUE_LEN;
+		dumper.count--;
+		dumper.busy = true;
+		pthread_cond_broadcast(&dumper.cond);
+		pthread_mutex_unlock(&dumper.lock);
+
+		frame_dump_write(dump);
+
+		pthread_mutex_lock(&dumper.lock);
+		dumper.busy = false;
+		pthread_cond_broadcast(&dumper.cond);
+		pthread_mutex_unlock(&dumper.lock);
+	}
+
+	return NULL;
+}
+
+static void frame_dump_exit_handler(int sig)
+{
+	/* Only drain the queue on a regular exit, not from a signal */
+	if (!sig)
+		igt_frame_dump_flush();
+}
+
+/* Starts the writer of this process, children don't inherit their parent's */
+static void frame_dump_start(void)
+{
+	pthread_t thread;
+
+	if (dumper.pid == getpid())
+		return;
+
+	if (!dumper.pid)
+		igt_install_exit_handler(frame_dump_exit_handler);
+
+	dumper.pid = getpid();
+	dumper.head = 0;
+	dumper.count = 0;
+	dumper.busy = false;
+
+	igt_assert_eq(pthread_create(&thread, NULL, frame_dump_thread, NULL),
+		      0);
+	pthread_detach(thread);
+}
+
+static cairo_surface_t *frame_dump_copy(cairo_surface_t *surface)
+{
+	cairo_surface_t *copy;
+	int stride, height;
+
+	cairo_surface_flush(surface);
+
+	copy = cairo_image_surface_create(cairo_image_surface_get_format(surface),
+					  cairo_image_surface_get_width(surface),
+					  cairo_image_surface_get_height(surface));
+	igt_assert(cairo_surface_status(copy) == CAIRO_STATUS_SUCCESS);
+
+	stride = cairo_image_surface_get_stride(surface);
+	height = cairo_image_surface_get_height(surface);
+	if (stride == cairo_image_surface_get_stride(copy)) {
+		memcpy(cairo_image_surface_get_data(copy),
+		       cairo_image_surface_get_data(surface),
+		       (size_t)stride * height);
+	} else {
+		int len = min(stride, cairo_image_surface_get_stride(copy));
+
+		for (int y = 0; y < height; y++)
+			memcpy(cairo_image_surface_get_data(copy) +
+			       y * cairo_image_surface_get_stride(copy),
+			       cairo_image_surface_get_data(surface) + y * stride,
+			       len);
+	}
+	cairo_surface_mark_dirty(copy);
+
+	return copy;
+}
+
+/**
+ * igt_frame_dump_queue:
+ * @surface: The surface to dump
+ * @path: The file to write
+ * @format: The file format
+ *
+ * Dumps @surface to @path from the background writer. The frame and the
+ * current time, recorded as its capture time in raw dumps, are copied before
+ * returning, so @surface can be reused or released right away.
+ *
+ * This only blocks when the writer is already a full queue of frames behind.
+ * Surfaces other than image surfaces are written synchronously.
+ */
+void igt_frame_dump_queue(cairo_surface_t *surface, const char *path,
+			  enum igt_frame_dump_format format)
+{
+	struct frame_dump *dump;
+
+	dump = calloc(1, sizeof(*dump));
+	igt_assert(dump);
+	dump->timestamp_ns = clock_ns(CLOCK_MONOTONIC);
+	dump->realtime_ns = clock_ns(CLOCK_REALTIME);
+	dump->path = strdup(path);
+	dump->format = format;
+	igt_assert(dump->path);
+
+	if (cairo_surface_get_type(surface) != CAIRO_SURFACE_TYPE_IMAGE) {
+		dump->surface = cairo_surface_reference(surface);
+		frame_dump_write(dump);
+		return;
+	}
+
+	dump->surface = frame_dump_copy(surface);
+
+	pthread_mutex_lock(&dumper.lock);
+	frame_dump_start();
+
+	while (dumper.count == FRAME_DUMP_QUEUE_LEN)
+		pthread_cond_wait(&dumper.cond, &dumper.lock);
+
+	dumper.queue[(dumper.head + dumper.count) % FRAME_DUMP_QUEUE_LEN] = dump;
+	dumper.count++;
+	pthread_cond_broadcast(&dumper.cond);
+	pthread_mutex_unlock(&dumper.lock);
+}
+
+/**
+ * igt_frame_dump_flush:
+ *
+ * Waits for all the frames queued with igt_frame_dump_queue() to be written.
+ */
+void igt_frame_dump_flush(void)
+{
+	pthread_mutex_lock(&dumper.lock);
+	if (dumper.pid == getpid())
+		while (dumper.count || dumper.busy)
+			pthread_cond_wait(&dumper.cond, &dumper.lock);
+	pthread_mutex_unlock(&dumper.lock);
+}
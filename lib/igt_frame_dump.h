@@ -0,0 +1,65 @@
+/* SPDX-License-Identifier: MIT */
+/*
+ * Copyright © 2025 Intel Corporation
+ */
+
+#ifndef IGT_FRAME_DUMP_H
+#define IGT_FRAME_DUMP_H
+
+#include <cairo.h>
+#include <stdint.h>
+
+#define IGT_FRAME_RAW_MAGIC "IGTFRAME"
+#define IGT_FRAME_RAW_VERSION 1
+
+/**
+ * igt_frame_raw_header:
+ * @magic: %IGT_FRAME_RAW_MAGIC, not NUL terminated
+ * @version: %IGT_FRAME_RAW_VERSION
+ * @format: The cairo_format_t of the pixels
+ * @width: Width in pixels
+ * @height: Height in pixels
+ * @stride: Bytes per line of pixels
+ * @reserved: Must be zero
+ * @timestamp_ns: CLOCK_MONOTONIC time the frame was captured at
+ * @realtime_ns: CLOCK_REALTIME time the frame was captured at
+ *
+ * Header of the raw frame dumps, followed by @height lines of @stride bytes
+ * of pixels as cairo lays them out, in host byte order.
+ */
+struct igt_frame_raw_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t format;
+	uint32_t width;
+	uint32_t height;
+	uint32_t stride;
+	uint32_t reserved;
+	uint64_t timestamp_ns;
+	uint64_t realtime_ns;
+};
+
+/**
+ * igt_frame_dump_format:
+ * @IGT_FRAME_DUMP_PNG: PNG files, slow to encode
+ * @IGT_FRAME_DUMP_RAW: Uncompressed frames with a #igt_frame_raw_header
+ *
+ * The file format of the frame dumps.
+ */
+enum igt_frame_dump_format {
+	IGT_FRAME_DUMP_PNG,
+	IGT_FRAME_DUMP_RAW,
+};
+
+enum igt_frame_dump_format igt_frame_dump_get_format(void);
+const char *igt_frame_dump_extension(enum igt_frame_dump_format format);
+void igt_frame_dump_queue(cairo_surface_t *surface, const char *path,
+			  enum igt_frame_dump_format format);
+void igt_frame_dump_flush(void);
+
+int igt_frame_raw_write(cairo_surface_t *surface, const char *path,
+			uint64_t timestamp_ns, uint64_t realtime_ns);
+cairo_surface_t *igt_frame_raw_read(const char *path,
+				    struct igt_frame_raw_header *header);
+
+#endif /* IGT_FRAME_DUMP_H */
@@ -170,13 +170,33 @@ static inline float _half_to_float(uint16_t val)
 
 static void float_to_half_f16c(const float *f, uint16_t *h, unsigned int num)
 {
-	for (int i = 0; i < num; i++)
+	unsigned int i = 0;
+
+	for (; i + 8 <= num; i += 8)
+		_mm_storeu_si128((__m128i *)&h[i],
+				 _mm256_cvtps_ph(_mm256_loadu_ps(&f[i]), 0));
+
+	for (; i + 4 <= num; i += 4)
+		_mm_storel_epi64((__m128i *)&h[i],
+				 _mm_cvtps_ph(_mm_loadu_ps(&f[i]), 0));
+
+	for (; i < num; i++)
 		h[i] = _cvtss_sh(f[i], 0);
 }
 
 static void half_to_float_f16c(const uint16_t *h, float *f, unsigned int num)
 {
-	for (int i = 0; i < num; i++)
+	unsigned int i = 0;
+
+	for (; i + 8 <= num; i += 8)
+		_mm256_storeu_ps(&f[i],
+				 _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)&h[i])));
+
+	for (; i + 4 <= num; i += 4)
+		_mm_storeu_ps(&f[i],
+			      _mm_cvtph_ps(_mm_loadl_epi64((const __m128i *)&h[i])));
+
+	for (; i < num; i++)
 		f[i] = _cvtsh_ss(h[i]);
 }
 
@@ -224,6 +244,47 @@ static void (*resolve_half_to_float(void))(const uint16_t *h, float *f, unsigned
 void igt_half_to_float(const uint16_t *h, float *f, unsigned int num)
 	__attribute__((ifunc("resolve_half_to_float")));
 
+#elif defined(__aarch64__)
+
+#include <arm_neon.h>
+
+/* The half precision conversions are part of the base armv8 SIMD set */
+void igt_float_to_half(const float *f, uint16_t *h, unsigned int num)
+{
+	unsigned int i = 0;
+
+	for (; i + 8 <= num; i += 8) {
+		float16x4_t lo = vcvt_f16_f32(vld1q_f32(&f[i]));
+		float16x8_t v = vcvt_high_f16_f32(lo, vld1q_f32(&f[i + 4]));
+
+		vst1q_u16(&h[i], vreinterpretq_u16_f16(v));
+	}
+
+	for (; i + 4 <= num; i += 4)
+		vst1_u16(&h[i], vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(&f[i]))));
+
+	for (; i < num; i++)
+		h[i] = _float_to_half(f[i]);
+}
+
+void igt_half_to_float(const uint16_t *h, float *f, unsigned int num)
+{
+	unsigned int i = 0;
+
+	for (; i + 8 <= num; i += 8) {
+		float16x8_t v = vreinterpretq_f16_u16(vld1q_u16(&h[i]));
+
+		vst1q_f32(&f[i], vcvt_f32_f16(vget_low_f16(v)));
+		vst1q_f32(&f[i + 4], vcvt_high_f32_f16(v));
+	}
+
+	for (; i + 4 <= num; i += 4)
+		vst1q_f32(&f[i], vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(&h[i]))));
+
+	for (; i < num; i++)
+		f[i] = _half_to_float(h[i]);
+}
+
 #else
 
 void igt_float_to_half(const float *f, uint16_t *h, unsigned int num)
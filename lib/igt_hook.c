@@ -5,13 +5,18 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <limits.h>
+#include <poll.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "igt_hook.h"
 
@@ -29,19 +34,51 @@
  * when initializing a test case, then calls @igt_hook_event_notify() for each
  * event that occurs during that test's execution and finally calls
  * @igt_hook_free() to clean up at the end.
+ *
+ * Hooks marked `async` run in the background, at most
+ * `IGT_HOOK_MAX_ASYNC` of them at once, and igt_core waits for them with
+ * @igt_hook_barrier() when the test exits. The time each hook takes is
+ * recorded and reported by @igt_hook_print_stats().
  */
 
 #define TEST_NAME_INITIAL_SIZE 16
+#define DEFAULT_MAX_ASYNC 4
 
 typedef uint16_t evt_mask_t;
 
+enum igt_hook_flags {
+	IGT_HOOK_ASYNC = 1 << 0,
+	IGT_HOOK_BARRIER = 1 << 1,
+};
+
 struct igt_hook_descriptor {
 	evt_mask_t evt_mask;
+	unsigned int flags;
 	char *cmd;
+
+	/* Timing of the runs */
+	unsigned long runs, failures;
+	uint64_t total_ns, max_ns;
+	char *max_test_fullname;
+};
+
+/* Reported by the process running an async hook once it is done */
+struct igt_hook_completion {
+	int status;
+	uint64_t duration_ns;
+};
+
+struct igt_hook_async {
+	int fd;
+	struct igt_hook_descriptor *descriptor;
+	char *test_fullname;
 };
 
 struct igt_hook {
 	struct igt_hook_descriptor *descriptors;
+	struct igt_hook_async *async;
+	size_t num_async, max_async;
+	pid_t pid;
 	char *test_name;
 	size_t test_name_size;
 	char *subtest_name;
@@ -84,10 +121,23 @@ static const char *igt_hook_evt_type_to_name(enum igt_hook_evt_type evt_type)
 	return "?";
 }
 
-static int igt_hook_parse_hook_str(const char *hook_str, evt_mask_t *evt_mask, const char **cmd)
+static unsigned int igt_hook_modifier(const char *name, size_t len)
+{
+	if (len == strlen("async") && !strncmp(name, "async", len))
+		return IGT_HOOK_ASYNC;
+	if (len == strlen("barrier") && !strncmp(name, "barrier", len))
+		return IGT_HOOK_ASYNC | IGT_HOOK_BARRIER;
+
+	return 0;
+}
+
+static int igt_hook_parse_hook_str(const char *hook_str, evt_mask_t *evt_mask,
+				   unsigned int *flags, const char **cmd)
 {
 	const char *s;
 
+	*flags = 0;
+
 	if (!strchr(hook_str, ':')) {
 		*evt_mask = ~0;
 		*cmd = hook_str;
@@ -114,6 +164,13 @@ static int igt_hook_parse_hook_str(const char *hook_str, evt_mask_t *evt_mask, c
 		has_match = false;
 		is_star = *evt_name == '*' && evt_name + 1 == s;
 
+		if (igt_hook_modifier(evt_name, s - evt_name)) {
+			*flags |= igt_hook_modifier(evt_name, s - evt_name);
+			if (*s++ == ':')
+				break;
+			continue;
+		}
+
 		for (evt_type = IGT_HOOK_PRE_TEST; evt_type < IGT_HOOK_NUM_EVENTS; evt_type++) {
 			if (!is_star) {
 				const char *this_event_name = igt_hook_evt_type_to_name(evt_type);
@@ -140,6 +197,10 @@ static int igt_hook_parse_hook_str(const char *hook_str, evt_mask_t *evt_mask, c
 			break;
 	}
 
+	/* Only modifiers, track all events */
+	if (!*evt_mask)
+		*evt_mask = ~0;
+
 	*cmd = s;
 
 	return 0;
@@ -206,9 +267,10 @@ int igt_hook_create(const char **hook_strs, size_t n, struct igt_hook **igt_hook
 	cmd_buffer_size = 0;
 	for (size_t i = 0; i < n; i++) {
 		evt_mask_t evt_mask;
+		unsigned int flags;
 		const char *cmd;
 
-		ret = igt_hook_parse_hook_str(hook_strs[i], &evt_mask, &cmd);
+		ret = igt_hook_parse_hook_str(hook_strs[i], &evt_mask, &flags, &cmd);
 		if (ret)
 			goto out;
 
@@ -223,11 +285,13 @@ int igt_hook_create(const char **hook_strs, size_t n, struct igt_hook **igt_hook
 	cmd_buffer = (void *)igt_hook->descriptors + (n + 1) * sizeof(*igt_hook->descriptors);
 	for (size_t i = 0; i < n; i++) {
 		evt_mask_t evt_mask;
+		unsigned int flags;
 		const char *cmd;
 
-		igt_hook_parse_hook_str(hook_strs[i], &evt_mask, &cmd);
+		igt_hook_parse_hook_str(hook_strs[i], &evt_mask, &flags, &cmd);
 		strcpy(cmd_buffer, cmd);
 		igt_hook->descriptors[i].evt_mask = evt_mask;
+		igt_hook->descriptors[i].flags = flags;
 		igt_hook->descriptors[i].cmd = cmd_buffer;
 		cmd_buffer += strlen(cmd) + 1;
 	}
@@ -245,6 +309,12 @@ int igt_hook_create(const char **hook_strs, size_t n, struct igt_hook **igt_hook
 	igt_hook->dyn_subtest_name[0] = '\0';
 	igt_hook->test_fullname[0] = '\0';
 
+	igt_hook->max_async = DEFAULT_MAX_ASYNC;
+	if (getenv("IGT_HOOK_MAX_ASYNC") && atoi(getenv("IGT_HOOK_MAX_ASYNC")) > 0)
+		igt_hook->max_async = atoi(getenv("IGT_HOOK_MAX_ASYNC"));
+	igt_hook->async = calloc(igt_hook->max_async, sizeof(*igt_hook->async));
+	igt_hook->pid = getpid();
+
 out:
 	if (ret)
 		igt_hook_free(igt_hook);
@@ -260,6 +330,9 @@ out:
  *
  * De-initialize an igt_hook struct returned by @igt_hook_create().
  *
+ * Async hooks still running are not waited for and complete on their own,
+ * see @igt_hook_barrier().
+ *
  * This is a no-op if @igt_hook is #NULL.
  */
 void igt_hook_free(struct igt_hook *igt_hook)
@@ -267,6 +340,14 @@ void igt_hook_free(struct igt_hook *igt_hook)
 	if (!igt_hook)
 		return;
 
+	for (size_t i = 0; i < igt_hook->num_async; i++) {
+		close(igt_hook->async[i].fd);
+		free(igt_hook->async[i].test_fullname);
+	}
+	free(igt_hook->async);
+	for (size_t i = 0; igt_hook->descriptors[i].cmd; i++)
+		free(igt_hook->descriptors[i].max_test_fullname);
+
 	free(igt_hook->test_name);
 	free(igt_hook->subtest_name);
 	free(igt_hook->dyn_subtest_name);
@@ -342,6 +423,227 @@ static void igt_hook_update_env_vars(struct igt_hook *igt_hook, struct igt_hook_
 	setenv("IGT_HOOK_RESULT", evt->result ?: "", 1);
 }
 
+static uint64_t igt_hook_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void igt_hook_account(struct igt_hook_descriptor *descriptor,
+			     const char *test_fullname, int status,
+			     uint64_t duration_ns)
+{
+	descriptor->runs++;
+	if (status)
+		descriptor->failures++;
+	descriptor->total_ns += duration_ns;
+
+	if (duration_ns >= descriptor->max_ns) {
+		descriptor->max_ns = duration_ns;
+		free(descriptor->max_test_fullname);
+		descriptor->max_test_fullname = strdup(test_fullname);
+	}
+}
+
+/*
+ * Runs @cmd and reports its exit status and duration through @fd. This runs
+ * in a grandchild of the test, so that the test is not left with children it
+ * doesn't know about, which igt_core would reap or complain about.
+ */
+static void __attribute__((noreturn))
+igt_hook_run_detached(const char *cmd, int fd)
+{
+	struct igt_hook_completion completion = { .status = -1 };
+	uint64_t start = igt_hook_now_ns();
+	pid_t pid;
+
+	pid = fork();
+	if (pid == 0) {
+		execl("/bin/sh", "sh", "-c", cmd, (char *)NULL);
+		_exit(127);
+	}
+
+	if (pid > 0)
+		while (waitpid(pid, &completion.status, 0) < 0 && errno == EINTR)
+			;
+	completion.duration_ns = igt_hook_now_ns() - start;
+
+	if (write(fd, &completion, sizeof(completion)) < 0)
+		_exit(1);
+	_exit(0);
+}
+
+static void igt_hook_async_complete(struct igt_hook *igt_hook, size_t i)
+{
+	struct igt_hook_async *async = &igt_hook->async[i];
+	struct igt_hook_completion completion = { .status = -1 };
+	ssize_t ret;
+
+	while ((ret = read(async->fd, &completion, sizeof(completion))) < 0 &&
+	       errno == EINTR)
+		;
+	if (ret != sizeof(completion))
+		completion.status = -1;
+
+	igt_hook_account(async->descriptor, async->test_fullname,
+			 completion.status, completion.duration_ns);
+
+	close(async->fd);
+	free(async->test_fullname);
+	igt_hook->async[i] = igt_hook->async[--igt_hook->num_async];
+}
+
+/* Waits for at least one of the async hooks selected by @flags to complete */
+static void igt_hook_async_wait_one(struct igt_hook *igt_hook, unsigned int flags)
+{
+	struct pollfd pfd[igt_hook->max_async];
+	size_t n = 0;
+
+	for (size_t i = 0; i < igt_hook->num_async; i++) {
+		pfd[i].fd = igt_hook->async[i].fd;
+		pfd[i].events = POLLIN;
+		pfd[i].revents = 0;
+		if ((igt_hook->async[i].descriptor->flags & flags) == flags)
+			n++;
+		else
+			pfd[i].fd = -1;
+	}
+	if (!n)
+		return;
+
+	while (poll(pfd, igt_hook->num_async, -1) < 0 && errno == EINTR)
+		;
+
+	/* Backwards, as completing moves the last entry in place */
+	for (size_t i = igt_hook->num_async; i--; )
+		if (pfd[i].revents)
+			igt_hook_async_complete(igt_hook, i);
+}
+
+static bool igt_hook_async_pending(struct igt_hook *igt_hook, unsigned int flags)
+{
+	for (size_t i = 0; i < igt_hook->num_async; i++)
+		if ((igt_hook->async[i].descriptor->flags & flags) == flags)
+			return true;
+
+	return false;
+}
+
+/* Hooks started by the parent of a forked test process are not ours */
+static void igt_hook_check_owner(struct igt_hook *igt_hook)
+{
+	if (igt_hook->pid == getpid())
+		return;
+
+	for (size_t i = 0; i < igt_hook->num_async; i++) {
+		close(igt_hook->async[i].fd);
+		free(igt_hook->async[i].test_fullname);
+	}
+	igt_hook->num_async = 0;
+	igt_hook->pid = getpid();
+}
+
+static void igt_hook_run_sync(struct igt_hook *igt_hook,
+			      struct igt_hook_descriptor *descriptor)
+{
+	uint64_t start = igt_hook_now_ns();
+	int status;
+
+	status = system(descriptor->cmd);
+	igt_hook_account(descriptor, igt_hook->test_fullname, status,
+			 igt_hook_now_ns() - start);
+}
+
+static void igt_hook_run_async(struct igt_hook *igt_hook,
+			       struct igt_hook_descriptor *descriptor)
+{
+	struct igt_hook_async *async;
+	int fds[2];
+	pid_t pid;
+
+	while (igt_hook->num_async == igt_hook->max_async)
+		igt_hook_async_wait_one(igt_hook, IGT_HOOK_ASYNC);
+
+	if (pipe2(fds, O_CLOEXEC)) {
+		igt_hook_run_sync(igt_hook, descriptor);
+		return;
+	}
+
+	pid = fork();
+	if (pid == 0) {
+		if (fork() == 0) {
+			close(fds[0]);
+			igt_hook_run_detached(descriptor->cmd, fds[1]);
+		}
+		_exit(0);
+	}
+	close(fds[1]);
+
+	if (pid < 0) {
+		close(fds[0]);
+		igt_hook_run_sync(igt_hook, descriptor);
+		return;
+	}
+	while (waitpid(pid, NULL, 0) < 0 && errno == EINTR)
+		;
+
+	async = &igt_hook->async[igt_hook->num_async++];
+	async->fd = fds[0];
+	async->descriptor = descriptor;
+	async->test_fullname = strdup(igt_hook->test_fullname);
+}
+
+/**
+ * igt_hook_barrier:
+ * @igt_hook: The igt_hook structure.
+ *
+ * Wait for all the async hooks started so far to complete.
+ *
+ * The argument to @igt_hook can be #NULL, which is equivalent to a no-op.
+ */
+void igt_hook_barrier(struct igt_hook *igt_hook)
+{
+	if (!igt_hook)
+		return;
+
+	igt_hook_check_owner(igt_hook);
+	while (igt_hook->num_async)
+		igt_hook_async_wait_one(igt_hook, IGT_HOOK_ASYNC);
+}
+
+/**
+ * igt_hook_print_stats:
+ * @igt_hook: The igt_hook structure.
+ * @f: File pointer where to write the output.
+ *
+ * Print how many times each hook ran and how long it took, in total and at
+ * most, to identify slow hooks. Async hooks still running are not accounted
+ * for.
+ */
+void igt_hook_print_stats(struct igt_hook *igt_hook, FILE *f)
+{
+	if (!igt_hook)
+		return;
+
+	for (size_t i = 0; igt_hook->descriptors[i].cmd; i++) {
+		struct igt_hook_descriptor *d = &igt_hook->descriptors[i];
+
+		if (!d->runs)
+			continue;
+
+		fprintf(f, "hook %zu%s: %lu runs, %lu failed, %.3fs total, "
+			"%.1fms mean, %.1fms max (%s): %s\n",
+			i, d->flags & IGT_HOOK_BARRIER ? " (barrier)" :
+			d->flags & IGT_HOOK_ASYNC ? " (async)" : "",
+			d->runs, d->failures, d->total_ns * 1e-9,
+			d->total_ns * 1e-6 / d->runs, d->max_ns * 1e-6,
+			d->max_test_fullname ?: "", d->cmd);
+	}
+}
+
 /**
  * igt_hook_event_notify:
  * @igt_hook: The igt_hook structure.
@@ -354,6 +656,9 @@ static void igt_hook_update_env_vars(struct igt_hook *igt_hook, struct igt_hook_
  * This function must be used to notify on a new igt_hook event. Calling it will
  * cause execution of the hook script if the event type matches the filters
  * provided during initialization of @igt_hook.
+ *
+ * Before the events starting a test, subtest or dynamic subtest, this waits
+ * for the `barrier` hooks still running.
  */
 void igt_hook_event_notify(struct igt_hook *igt_hook, struct igt_hook_evt *evt)
 {
@@ -363,6 +668,19 @@ void igt_hook_event_notify(struct igt_hook *igt_hook, struct igt_hook_evt *evt)
 	if (!igt_hook)
 		return;
 
+	igt_hook_check_owner(igt_hook);
+
+	switch (evt->evt_type) {
+	case IGT_HOOK_PRE_TEST:
+	case IGT_HOOK_PRE_SUBTEST:
+	case IGT_HOOK_PRE_DYN_SUBTEST:
+		while (igt_hook_async_pending(igt_hook, IGT_HOOK_BARRIER))
+			igt_hook_async_wait_one(igt_hook, IGT_HOOK_BARRIER);
+		break;
+	default:
+		break;
+	}
+
 	evt_bit = 1 << evt->evt_type;
 	igt_hook_update_test_name_pre_call(igt_hook, evt);
 
@@ -376,9 +694,17 @@ void igt_hook_event_notify(struct igt_hook *igt_hook, struct igt_hook_evt *evt)
 	if (has_match) {
 		igt_hook_update_env_vars(igt_hook, evt);
 
-		for (size_t i = 0; igt_hook->descriptors[i].cmd; i++)
-			if (evt_bit & igt_hook->descriptors[i].evt_mask)
-				system(igt_hook->descriptors[i].cmd);
+		for (size_t i = 0; igt_hook->descriptors[i].cmd; i++) {
+			struct igt_hook_descriptor *d = &igt_hook->descriptors[i];
+
+			if (!(evt_bit & d->evt_mask))
+				continue;
+
+			if (d->flags & IGT_HOOK_ASYNC)
+				igt_hook_run_async(igt_hook, d);
+			else
+				igt_hook_run_sync(igt_hook, d);
+		}
 	}
 
 	igt_hook_update_test_name_post_call(igt_hook, evt);
@@ -437,7 +763,9 @@ Examples:\n\
 The accepted format for a hook descriptor is `[<events>:]<cmd>`, where:\n\
 \n\
   - <events> is a comma-separated list of event descriptors, which defines the\n\
-    set of events be tracked. If omitted, all events are tracked.\n\
+    set of events be tracked. If omitted, all events are tracked. It may also\n\
+    contain the modifiers described below, all events being tracked if it\n\
+    contains nothing else.\n\
 \n\
   - <cmd> is a shell command to be executed on the occurrence each tracked\n\
     event. If the command contains ':', then passing <events> is required,\n\
@@ -516,7 +844,25 @@ available to the command:\n\
   applicable on the `IGT_HOOK_POST_KMOD_UNBIND` event and will be the empty\n\
   string for other types of events.\n\
 \n\
-Note that %s can be passed multiple times. Each descriptor is evaluated in turn\n\
+Note that %1$s can be passed multiple times. Each descriptor is evaluated in turn\n\
 when matching events and running hook commands.\n\
-", option_name);
+\n\
+By default the test waits for <cmd> to finish before going on. The following\n\
+modifiers change that:\n\
+\n\
+  async\n\
+  Run <cmd> in the background. At most IGT_HOOK_MAX_ASYNC (default %2$d) async\n\
+  commands run at once, further ones waiting for one of them to finish. The\n\
+  environment variables are those of the event the command was started for.\n\
+\n\
+  barrier\n\
+  Like async, but the command must finish before the next test, subtest or\n\
+  dynamic subtest starts.\n\
+\n\
+  # Collects telemetry in the background after each subtest.\n\
+  %1$s 'post-subtest,async:collect-telemetry.sh'\n\
+\n\
+All async commands are waited for when the test exits, and the number of runs\n\
+and the time taken by each hook are then logged as debug messages.\n\
+", option_name, DEFAULT_MAX_ASYNC);
 }
@@ -67,6 +67,8 @@ struct igt_hook_evt {
 int igt_hook_create(const char **hook_strs, size_t n, struct igt_hook **igt_hook_ptr);
 void igt_hook_free(struct igt_hook *igt_hook);
 void igt_hook_event_notify(struct igt_hook *igt_hook, struct igt_hook_evt *evt);
+void igt_hook_barrier(struct igt_hook *igt_hook);
+void igt_hook_print_stats(struct igt_hook *igt_hook, FILE *f);
 const char *igt_hook_error_str(int error);
 void igt_hook_print_help(FILE *f, const char *option_name);
 
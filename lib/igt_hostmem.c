@@ -0,0 +1,305 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2025 Intel Corporation
+ */
+
+/**
+ * SECTION:igt_hostmem
+ * @short_description: Host buffers of a chosen page size
+ * @title: Host memory
+ * @include: igt_hostmem.h
+ *
+ * Userptr and system allocator tests reach host memory allocated with
+ * malloc() or mmap(), whose page size depends on the state of transparent
+ * huge pages on the machine. As the GPU binds and faults in a range a page
+ * at a time, the same test measures something else from one machine to the
+ * next, and not what applications backed by huge pages see.
+ *
+ * igt_hostmem_alloc() allocates anonymous memory backed by the page size
+ * asked for, see #igt_hostmem_page, and optionally bound to a NUMA node,
+ * usually the one of the GPU from igt_hostmem_device_node(). Huge pages
+ * from hugetlbfs have to be reserved by the administrator first, use
+ * igt_hostmem_has_page() to check for them.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/mempolicy.h>
+#include <linux/mman.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "drmtest.h"
+#include "igt_aux.h"
+#include "igt_core.h"
+#include "igt_device.h"
+#include "igt_device_scan.h"
+#include "igt_hostmem.h"
+#include "igt_sysfs.h"
+
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23
+#endif
+
+#define HOSTMEM_MAX_NODES 1024
+
+static const struct {
+	const char *name;
+	size_t size;
+	const char *sysfs;
+} hostmem_pages[IGT_HOSTMEM_NUM_PAGES] = {
+	[IGT_HOSTMEM_4K] = { "4k", 4096 },
+	[IGT_HOSTMEM_THP] = { "thp", 2 << 20 },
+	[IGT_HOSTMEM_HUGETLB_2M] = { "hugetlb-2m", 2 << 20, "hugepages-2048kB" },
+	[IGT_HOSTMEM_HUGETLB_1G] = { "hugetlb-1g", 1 << 30, "hugepages-1048576kB" },
+};
+
+/**
+ * igt_hostmem_page_name:
+ * @page: page kind
+ *
+ * Returns: The name of @page, as accepted by igt_hostmem_parse_page().
+ */
+const char *igt_hostmem_page_name(enum igt_hostmem_page page)
+{
+	igt_assert(page < IGT_HOSTMEM_NUM_PAGES);
+
+	return hostmem_pages[page].name;
+}
+
+/**
+ * igt_hostmem_parse_page:
+ * @name: "4k", "thp", "hugetlb-2m" or "hugetlb-1g"
+ *
+ * Returns: The page kind named @name, or -1 if there is none.
+ */
+int igt_hostmem_parse_page(const char *name)
+{
+	for (int i = 0; i < IGT_HOSTMEM_NUM_PAGES; i++)
+		if (!strcmp(name, hostmem_pages[i].name))
+			return i;
+
+	return -1;
+}
+
+/**
+ * igt_hostmem_page_size:
+ * @page: page kind
+ *
+ * Returns: The size of the pages of kind @page.
+ */
+size_t igt_hostmem_page_size(enum igt_hostmem_page page)
+{
+	igt_assert(page < IGT_HOSTMEM_NUM_PAGES);
+
+	return hostmem_pages[page].size;
+}
+
+/**
+ * igt_hostmem_has_page:
+ * @page: page kind
+ * @size: bytes to allocate
+ *
+ * Checks whether @size bytes backed by @page can be allocated: transparent
+ * huge pages must not be disabled, and the hugetlbfs pool must have enough
+ * free pages. Transparent huge pages are still best effort, the kernel
+ * falls back to base pages when it cannot find free huge pages.
+ *
+ * Returns: true if the allocation is expected to succeed.
+ */
+bool igt_hostmem_has_page(enum igt_hostmem_page page, size_t size)
+{
+	char path[PATH_MAX];
+	uint64_t free_pages;
+	char *enabled;
+	bool ret;
+	int dir;
+
+	switch (page) {
+	case IGT_HOSTMEM_4K:
+		return true;
+	case IGT_HOSTMEM_THP:
+		dir = open("/sys/kernel/mm/transparent_hugepage", O_RDONLY);
+		if (dir < 0)
+			return false;
+
+		enabled = igt_sysfs_get(dir, "enabled");
+		close(dir);
+
+		ret = enabled && !strstr(enabled, "[never]");
+		free(enabled);
+
+		return ret;
+	case IGT_HOSTMEM_HUGETLB_2M:
+	case IGT_HOSTMEM_HUGETLB_1G:
+		snprintf(path, sizeof(path), "/sys/kernel/mm/hugepages/%s",
+			 hostmem_pages[page].sysfs);
+		dir = open(path, O_RDONLY);
+		if (dir < 0)
+			return false;
+
+		ret = __igt_sysfs_get_u64(dir, "free_hugepages", &free_pages) &&
+		      free_pages >= DIV_ROUND_UP(size, hostmem_pages[page].size);
+		close(dir);
+
+		return ret;
+	default:
+		igt_assert(0);
+	}
+}
+
+/**
+ * igt_hostmem_device_node:
+ * @drm_fd: fd of the device
+ *
+ * Returns: The NUMA node the device is attached to, or -1 if not known.
+ */
+int igt_hostmem_device_node(int drm_fd)
+{
+	char pci_slot[NAME_MAX];
+
+	igt_device_get_pci_slot_name(drm_fd, pci_slot);
+
+	return igt_device_get_numa_node(pci_slot);
+}
+
+static int hostmem_bind_node(void *ptr, size_t size, int node)
+{
+	unsigned long mask[HOSTMEM_MAX_NODES / (8 * sizeof(unsigned long))] = {};
+
+	if (node >= HOSTMEM_MAX_NODES)
+		return -EINVAL;
+
+	mask[node / (8 * sizeof(mask[0]))] |= 1ul << (node % (8 * sizeof(mask[0])));
+	if (syscall(SYS_mbind, ptr, size, MPOL_BIND, mask,
+		    HOSTMEM_MAX_NODES, 0))
+		return -errno;
+
+	return 0;
+}
+
+static void hostmem_populate(struct igt_hostmem *mem)
+{
+	size_t page_size = hostmem_pages[mem->page].size;
+
+	if (!madvise(mem->ptr, mem->size, MADV_POPULATE_WRITE))
+		return;
+
+	/* Older kernels, fault the pages in one at a time */
+	for (size_t offset = 0; offset < mem->size; offset += page_size)
+		((volatile char *)mem->ptr)[offset] = 0;
+}
+
+/**
+ * __igt_hostmem_alloc:
+ * @mem: the buffer to initialize
+ * @size: bytes to allocate, rounded up to the page size
+ * @page: the pages backing the buffer
+ * @node: NUMA node to allocate the pages from, or -1 for any
+ * @flags: %IGT_HOSTMEM_POPULATE or 0
+ *
+ * Allocates anonymous private memory backed by @page. Binding to @node is
+ * best effort, failing on a system without NUMA support is not an error.
+ *
+ * Returns: 0 on success, or a negative errno, -ENOMEM when the hugetlbfs
+ * pool is too small.
+ */
+int __igt_hostmem_alloc(struct igt_hostmem *mem, size_t size,
+			enum igt_hostmem_page page, int node,
+			unsigned int flags)
+{
+	int mmap_flags = MAP_PRIVATE | MAP_ANONYMOUS;
+	size_t align = 0;
+	int ret;
+
+	igt_assert(page < IGT_HOSTMEM_NUM_PAGES);
+
+	memset(mem, 0, sizeof(*mem));
+	mem->page = page;
+	mem->size = ALIGN(size, hostmem_pages[page].size);
+
+	switch (page) {
+	case IGT_HOSTMEM_THP:
+		/* Over-allocate to align the buffer to the huge page size */
+		align = hostmem_pages[page].size;
+		break;
+	case IGT_HOSTMEM_HUGETLB_2M:
+		mmap_flags |= MAP_HUGETLB | MAP_HUGE_2MB;
+		break;
+	case IGT_HOSTMEM_HUGETLB_1G:
+		mmap_flags |= MAP_HUGETLB | MAP_HUGE_1GB;
+		break;
+	default:
+		break;
+	}
+
+	mem->map_size = mem->size + align;
+	mem->map = mmap(NULL, mem->map_size, PROT_READ | PROT_WRITE,
+			mmap_flags, -1, 0);
+	if (mem->map == MAP_FAILED) {
+		ret = -errno;
+		memset(mem, 0, sizeof(*mem));
+		return ret;
+	}
+	mem->ptr = align ? (void *)ALIGN((uintptr_t)mem->map, align) : mem->map;
+
+	if (page == IGT_HOSTMEM_4K)
+		madvise(mem->ptr, mem->size, MADV_NOHUGEPAGE);
+	else if (page == IGT_HOSTMEM_THP)
+		madvise(mem->ptr, mem->size, MADV_HUGEPAGE);
+
+	if (node >= 0) {
+		ret = hostmem_bind_node(mem->ptr, mem->size, node);
+		if (ret)
+			igt_debug("Cannot bind host memory to node %d: %s\n",
+				  node, strerror(-ret));
+	}
+
+	if (flags & IGT_HOSTMEM_POPULATE)
+		hostmem_populate(mem);
+
+	return 0;
+}
+
+/**
+ * igt_hostmem_alloc:
+ * @mem: the buffer to initialize
+ * @size: bytes to allocate, rounded up to the page size
+ * @page: the pages backing the buffer
+ * @node: NUMA node to allocate the pages from, or -1 for any
+ * @flags: %IGT_HOSTMEM_POPULATE or 0
+ *
+ * As __igt_hostmem_alloc(), skipping when there are not enough free
+ * hugetlbfs pages and asserting on any other failure. Release the buffer
+ * with igt_hostmem_free().
+ */
+void igt_hostmem_alloc(struct igt_hostmem *mem, size_t size,
+		       enum igt_hostmem_page page, int node,
+		       unsigned int flags)
+{
+	int ret;
+
+	ret = __igt_hostmem_alloc(mem, size, page, node, flags);
+	igt_require_f(ret != -ENOMEM ||
+		      (page != IGT_HOSTMEM_HUGETLB_2M &&
+		       page != IGT_HOSTMEM_HUGETLB_1G),
+		      "Not enough free %s pages\n", igt_hostmem_page_name(page));
+	igt_assert_eq(ret, 0);
+}
+
+/**
+ * igt_hostmem_free:
+ * @mem: buffer from igt_hostmem_alloc()
+ *
+ * Releases the buffer.
+ */
+void igt_hostmem_free(struct igt_hostmem *mem)
+{
+	if (mem->map)
+		munmap(mem->map, mem->map_size);
+
+	memset(mem, 0, sizeof(*mem));
+}
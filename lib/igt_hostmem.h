@@ -0,0 +1,70 @@
+/* SPDX-License-Identifier: MIT */
+/*
+ * Copyright © 2025 Intel Corporation
+ */
+
+#ifndef IGT_HOSTMEM_H
+#define IGT_HOSTMEM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * igt_hostmem_page:
+ * @IGT_HOSTMEM_4K: base pages, with transparent huge pages disabled
+ * @IGT_HOSTMEM_THP: 2MiB aligned and advised for transparent huge pages
+ * @IGT_HOSTMEM_HUGETLB_2M: 2MiB pages from the hugetlbfs pool
+ * @IGT_HOSTMEM_HUGETLB_1G: 1GiB pages from the hugetlbfs pool
+ * @IGT_HOSTMEM_NUM_PAGES: number of page kinds
+ *
+ * The pages backing a host buffer allocated by igt_hostmem_alloc().
+ */
+enum igt_hostmem_page {
+	IGT_HOSTMEM_4K,
+	IGT_HOSTMEM_THP,
+	IGT_HOSTMEM_HUGETLB_2M,
+	IGT_HOSTMEM_HUGETLB_1G,
+	IGT_HOSTMEM_NUM_PAGES
+};
+
+/**
+ * IGT_HOSTMEM_POPULATE:
+ *
+ * Fault in all the pages of the buffer on allocation.
+ */
+#define IGT_HOSTMEM_POPULATE	(1 << 0)
+
+/**
+ * igt_hostmem:
+ * @ptr: start of the buffer, aligned to the page size
+ * @size: size of the buffer, rounded up to the page size
+ * @page: the pages backing the buffer
+ *
+ * A host buffer allocated by igt_hostmem_alloc().
+ */
+struct igt_hostmem {
+	void *ptr;
+	size_t size;
+	enum igt_hostmem_page page;
+
+	/* private */
+	void *map;
+	size_t map_size;
+};
+
+const char *igt_hostmem_page_name(enum igt_hostmem_page page);
+int igt_hostmem_parse_page(const char *name);
+size_t igt_hostmem_page_size(enum igt_hostmem_page page);
+bool igt_hostmem_has_page(enum igt_hostmem_page page, size_t size);
+
+int igt_hostmem_device_node(int drm_fd);
+
+int __igt_hostmem_alloc(struct igt_hostmem *mem, size_t size,
+			enum igt_hostmem_page page, int node,
+			unsigned int flags);
+void igt_hostmem_alloc(struct igt_hostmem *mem, size_t size,
+		       enum igt_hostmem_page page, int node,
+		       unsigned int flags);
+void igt_hostmem_free(struct igt_hostmem *mem);
+
+#endif /* IGT_HOSTMEM_H */
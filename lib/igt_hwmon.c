@@ -76,3 +76,30 @@ int igt_hwmon_open(int device)
 	return open(path, O_RDONLY);
 }
 
+/**
+ * igt_hwmon_attr_open:
+ * @device: fd of the device
+ * @attr: name of the hwmon attribute
+ *
+ * Opens a handle for repeatedly reading a hwmon attribute of the device, such
+ * as energy1_input, with igt_sysfs_attr_get_u64() and friends.
+ *
+ * Returns:
+ * The handle, or NULL if the device has no such attribute.
+ */
+struct igt_sysfs_attr *igt_hwmon_attr_open(int device, const char *attr)
+{
+	struct igt_sysfs_attr *a = NULL;
+	int hwmon;
+
+	hwmon = igt_hwmon_open(device);
+	if (hwmon < 0)
+		return NULL;
+
+	if (igt_sysfs_has_attr(hwmon, attr))
+		a = igt_sysfs_attr_open(hwmon, attr);
+	close(hwmon);
+
+	return a;
+}
+
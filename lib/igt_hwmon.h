@@ -8,6 +8,9 @@
 
 #include <stdbool.h>
 
+struct igt_sysfs_attr;
+
 int igt_hwmon_open(int device);
+struct igt_sysfs_attr *igt_hwmon_attr_open(int device, const char *attr);
 
 #endif /* IGT_HWMON_H */
@@ -969,45 +969,91 @@ static void kunit_results_free(struct igt_list_head *results,
 	free(*suite_name);
 }
 
-static int kunit_get_results(struct igt_list_head *results, const char *debugfs_path,
-			     const char *suite, struct igt_ktap_results **ktap)
+static int kunit_read_results(const char *debugfs_path, const char *suite,
+			      struct igt_ktap_results *ktap)
 {
 	char results_path[PATH_MAX];
-	FILE *results_stream;
-	char *buf = NULL;
-	size_t size = 0;
+	char buf[BUF_LEN];
+	int fd, err = -EINPROGRESS;
 	ssize_t len;
-	int err;
 
 	if (igt_debug_on(strlen(debugfs_path) + strlen(suite) + strlen("/results") >= PATH_MAX))
 		return -ENOSPC;
 
 	strcpy(stpcpy(stpcpy(results_path, debugfs_path), suite), "/results");
-	results_stream = fopen(results_path, "r");
-	if (igt_debug_on(!results_stream))
+	fd = open(results_path, O_RDONLY);
+	if (igt_debug_on(fd < 0))
 		return -errno;
 
-	*ktap = igt_ktap_alloc(results);
-	if (igt_debug_on(!*ktap)) {
-		err = -ENOMEM;
-		goto out_fclose;
-	}
+	/* Results reach the parser's consumer as soon as their line is in */
+	while (err == -EINPROGRESS && (len = read(fd, buf, sizeof(buf))) > 0)
+		err = igt_ktap_push(ktap, buf, len);
 
-	while (len = getline(&buf, &size, results_stream), len > 0) {
-		err = igt_ktap_parse(buf, *ktap);
-		if (err != -EINPROGRESS)
-			break;
-	}
+	close(fd);
 
-	free(buf);
+	return err;
+}
+
+static int kunit_get_results(struct igt_list_head *results, const char *debugfs_path,
+			     const char *suite, struct igt_ktap_results **ktap)
+{
+	int err;
+
+	*ktap = igt_ktap_alloc(results);
+	if (igt_debug_on(!*ktap))
+		return -ENOMEM;
+
+	err = kunit_read_results(debugfs_path, suite, *ktap);
 
 	igt_ktap_free(ktap);
-out_fclose:
-	fclose(results_stream);
 
 	return err;
 }
 
+struct kunit_case {
+	const struct igt_ktap_result *expected;
+	unsigned int count;
+	char *suite_name;
+	char *case_name;
+	char *msg;
+	int code;
+};
+
+/*
+ * A test case reports at most two results, the name of a parametrized
+ * case first, then its result. Anything after is ignored, and the first
+ * unexpected name is kept for the report.
+ */
+static void kunit_case_result(const struct igt_ktap_result *r, void *data)
+{
+	struct kunit_case *c = data;
+
+	if (c->count == 2 || (c->count && c->code != IGT_EXIT_INVALID) ||
+	    c->suite_name)
+		return;
+
+	c->count++;
+
+	if (strcmp(r->suite_name, c->expected->suite_name) ||
+	    strcmp(r->case_name, c->expected->case_name)) {
+		c->suite_name = strdup(r->suite_name);
+		c->case_name = strdup(r->case_name);
+		return;
+	}
+
+	free(c->msg);
+	c->msg = r->msg ? strdup(r->msg) : NULL;
+	c->code = r->code;
+}
+
+static void kunit_case_fini(struct kunit_case *c)
+{
+	free(c->suite_name);
+	free(c->case_name);
+	free(c->msg);
+	memset(c, 0, sizeof(*c));
+}
+
 static void kunit_get_tests(struct igt_list_head *tests,
 			    struct igt_ktest *tst,
 			    const char *suite,
@@ -1082,17 +1128,14 @@ static void __igt_kunit(struct igt_ktest *tst,
 	struct igt_ktap_result *t;
 
 	igt_list_for_each_entry(t, tests, link) {
-		char *suite_name = NULL, *case_name = NULL;
-		IGT_LIST_HEAD(results);
+		struct kunit_case c = { .expected = t, };
 		unsigned long taints;
 
 		igt_dynamic_f("%s%s%s",
 			      strcmp(t->suite_name, subtest) ?  t->suite_name : "",
 			      strcmp(t->suite_name, subtest) ? "-" : "",
 			      t->case_name) {
-			struct igt_ktap_result *r = NULL;
 			char glob[1024];
-			int i;
 
 			igt_skip_on(kmod_module_remove_module(tst->kmod, 0));
 			igt_skip_on(igt_kernel_tainted(&taints));
@@ -1105,47 +1148,38 @@ static void __igt_kunit(struct igt_ktest *tst,
 			igt_assert_eq(modprobe(tst->kmod, opts), 0);
 			igt_assert_eq(igt_kernel_tainted(&taints), 0);
 
-			igt_assert_eq(kunit_get_results(&results, debugfs_path,
-							t->suite_name, ktap), 0);
-
-			for (i = 0; i < 2; i++) {
-				kunit_result_free(&r, &suite_name, &case_name);
-				igt_fail_on(igt_list_empty(&results));
-
-				r = igt_list_first_entry(&results, r, link);
-
-				igt_fail_on_f(strcmp(r->suite_name, t->suite_name),
-					      "suite_name expected: %s, got: %s\n",
-					      t->suite_name, r->suite_name);
-				igt_fail_on_f(strcmp(r->case_name, t->case_name),
-					      "case_name expected: %s, got: %s\n",
-					      t->case_name, r->case_name);
-
-				if (r->code != IGT_EXIT_INVALID)
-					break;
-
-				/* result from parametrized test case */
-			}
-
-			igt_assert_neq(r->code, IGT_EXIT_INVALID);
-
-			if (r->msg && *r->msg) {
-				igt_skip_on_f(r->code == IGT_EXIT_SKIP,
-					      "%s\n", r->msg);
-				igt_fail_on_f(r->code == IGT_EXIT_FAILURE,
-					      "%s\n", r->msg);
-				igt_abort_on_f(r->code == IGT_EXIT_ABORT,
-					      "%s\n", r->msg);
+			igt_ktap_free(ktap);
+			*ktap = igt_ktap_alloc_fn(kunit_case_result, &c);
+			igt_assert(*ktap);
+			igt_assert_eq(kunit_read_results(debugfs_path,
+							 t->suite_name, *ktap), 0);
+			igt_ktap_free(ktap);
+
+			igt_fail_on(!c.count);
+			igt_fail_on_f(c.suite_name,
+				      "result expected: %s.%s, got: %s.%s\n",
+				      t->suite_name, t->case_name,
+				      c.suite_name, c.case_name);
+
+			igt_assert_neq(c.code, IGT_EXIT_INVALID);
+
+			if (c.msg && *c.msg) {
+				igt_skip_on_f(c.code == IGT_EXIT_SKIP,
+					      "%s\n", c.msg);
+				igt_fail_on_f(c.code == IGT_EXIT_FAILURE,
+					      "%s\n", c.msg);
+				igt_abort_on_f(c.code == IGT_EXIT_ABORT,
+					      "%s\n", c.msg);
 			} else {
-				igt_skip_on(r->code == IGT_EXIT_SKIP);
-				igt_fail_on(r->code == IGT_EXIT_FAILURE);
-				if (r->code == IGT_EXIT_ABORT)
-					igt_fail(r->code);
+				igt_skip_on(c.code == IGT_EXIT_SKIP);
+				igt_fail_on(c.code == IGT_EXIT_FAILURE);
+				if (c.code == IGT_EXIT_ABORT)
+					igt_fail(c.code);
 			}
-			igt_assert_eq(r->code, IGT_EXIT_SUCCESS);
+			igt_assert_eq(c.code, IGT_EXIT_SUCCESS);
 		}
 
-		kunit_results_free(&results, &suite_name, &case_name);
+		kunit_case_fini(&c);
 
 		if (igt_debug_on(igt_kernel_tainted(&taints))) {
 			igt_info("Kernel tainted, not executing more selftests.\n");
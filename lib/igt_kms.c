@@ -54,8 +54,10 @@
 #include "drmtest.h"
 #include "igt_core.h"
 #include "igt_kms.h"
+#include "igt_arena.h"
 #include "igt_aux.h"
 #include "igt_edid.h"
+#include "igt_list.h"
 #include "intel_chipset.h"
 #include "igt_debugfs.h"
 #include "igt_device.h"
@@ -769,6 +771,163 @@ igt_plane_rotations(igt_display_t *display, igt_plane_t *plane,
 	return rotations;
 }
 
+/*
+ * Snapshot of the KMS topology, kept across igt_display_require() calls on
+ * the same fd: the property names of each object, so that filling in the
+ * property ids doesn't need a GETPROPERTY ioctl per property, and which
+ * connectors have already been fully probed. The snapshot is dropped when a
+ * hotplug uevent is seen, see igt_kms_invalidate_topology().
+ */
+struct kms_cached_prop {
+	uint32_t id;
+	char name[DRM_PROP_NAME_LEN];
+};
+
+struct kms_cached_object {
+	struct igt_list_head link;
+	int fd;
+	dev_t rdev;
+	uint32_t object_id;
+	uint32_t object_type;
+	bool probed;
+	int count_props;
+	struct kms_cached_prop props[];
+};
+
+static IGT_LIST_HEAD(kms_cached_objects);
+
+static struct kms_cached_object *
+kms_cached_object_find(int fd, uint32_t object_id, uint32_t object_type)
+{
+	struct kms_cached_object *obj;
+	struct stat st;
+
+	if (fstat(fd, &st))
+		return NULL;
+
+	igt_list_for_each_entry(obj, &kms_cached_objects, link) {
+		if (obj->fd == fd && obj->rdev == st.st_rdev &&
+		    obj->object_id == object_id &&
+		    obj->object_type == object_type)
+			return obj;
+	}
+
+	return NULL;
+}
+
+/*
+ * Returns the cached property names of the given object, refreshing them if
+ * the object's property list changed or wasn't looked at before. Property
+ * ids are still read back from the kernel, which is a single ioctl, so a
+ * stale entry for a reused fd number is caught here too.
+ */
+static const struct kms_cached_object *
+kms_cached_props(int fd, uint32_t object_id, uint32_t object_type)
+{
+	drmModeObjectPropertiesPtr props;
+	struct kms_cached_object *obj;
+	struct stat st;
+	bool probed = false;
+	int i;
+
+	props = drmModeObjectGetProperties(fd, object_id, object_type);
+	igt_assert(props);
+
+	obj = kms_cached_object_find(fd, object_id, object_type);
+	if (obj) {
+		if (obj->count_props == props->count_props) {
+			for (i = 0; i < props->count_props; i++)
+				if (obj->props[i].id != props->props[i])
+					break;
+
+			if (i == props->count_props) {
+				drmModeFreeObjectProperties(props);
+				return obj;
+			}
+		}
+
+		probed = obj->probed;
+		igt_list_del(&obj->link);
+		free(obj);
+	}
+
+	igt_assert_eq(fstat(fd, &st), 0);
+
+	obj = calloc(1, sizeof(*obj) + props->count_props * sizeof(obj->props[0]));
+	igt_assert(obj);
+	obj->fd = fd;
+	obj->rdev = st.st_rdev;
+	obj->object_id = object_id;
+	obj->object_type = object_type;
+	obj->probed = probed;
+	obj->count_props = props->count_props;
+
+	for (i = 0; i < props->count_props; i++) {
+		drmModePropertyPtr prop = drmModeGetProperty(fd, props->props[i]);
+
+		igt_assert(prop);
+		obj->props[i].id = props->props[i];
+		memcpy(obj->props[i].name, prop->name, sizeof(obj->props[i].name));
+		drmModeFreeProperty(prop);
+	}
+
+	drmModeFreeObjectProperties(props);
+
+	igt_list_add(&obj->link, &kms_cached_objects);
+
+	return obj;
+}
+
+static bool kms_connector_probed(int fd, uint32_t connector_id)
+{
+	struct kms_cached_object *obj;
+
+	obj = kms_cached_object_find(fd, connector_id,
+				     DRM_MODE_OBJECT_CONNECTOR);
+
+	return obj && obj->probed;
+}
+
+static void kms_connector_set_probed(int fd, uint32_t connector_id)
+{
+	struct kms_cached_object *obj;
+
+	obj = kms_cached_object_find(fd, connector_id,
+				     DRM_MODE_OBJECT_CONNECTOR);
+	if (!obj)
+		obj = (struct kms_cached_object *)
+			kms_cached_props(fd, connector_id,
+					 DRM_MODE_OBJECT_CONNECTOR);
+
+	obj->probed = true;
+}
+
+/**
+ * igt_kms_invalidate_topology:
+ * @drm_fd: drm file descriptor, or -1 for all of them
+ *
+ * The property names of the KMS objects and whether the connectors were
+ * probed are remembered across igt_display_require() calls. This drops that
+ * snapshot, so that the next igt_display_require() or
+ * igt_display_reset_outputs() re-queries everything from the kernel.
+ *
+ * This is done automatically whenever igt_hotplug_detected() or its
+ * siblings see a uevent. Tests changing the topology in other ways, like
+ * reloading the driver, should call this.
+ */
+void igt_kms_invalidate_topology(int drm_fd)
+{
+	struct kms_cached_object *obj, *tmp;
+
+	igt_list_for_each_entry_safe(obj, tmp, &kms_cached_objects, link) {
+		if (drm_fd != -1 && obj->fd != drm_fd)
+			continue;
+
+		igt_list_del(&obj->link);
+		free(obj);
+	}
+}
+
 /*
  * Retrieve all the properties specified in props_name and store them into
  * plane->props.
@@ -777,36 +936,36 @@ static void
 igt_fill_plane_props(igt_display_t *display, igt_plane_t *plane,
 		     int num_props, const char * const prop_names[])
 {
-	drmModeObjectPropertiesPtr props;
+	const struct kms_cached_object *obj;
 	int i, j, fd;
 
 	fd = display->drm_fd;
 
-	props = drmModeObjectGetProperties(fd, plane->drm_plane->plane_id, DRM_MODE_OBJECT_PLANE);
-	igt_assert(props);
+	obj = kms_cached_props(fd, plane->drm_plane->plane_id, DRM_MODE_OBJECT_PLANE);
 
-	for (i = 0; i < props->count_props; i++) {
-		drmModePropertyPtr prop =
-			drmModeGetProperty(fd, props->props[i]);
+	for (i = 0; i < obj->count_props; i++) {
+		const struct kms_cached_prop *prop = &obj->props[i];
 
 		for (j = 0; j < num_props; j++) {
 			if (strcmp(prop->name, prop_names[j]) != 0)
 				continue;
 
-			plane->props[j] = props->props[i];
+			plane->props[j] = prop->id;
 			break;
 		}
 
-		if (strcmp(prop->name, "rotation") == 0)
-			plane->rotations = igt_plane_rotations(display, plane, prop);
+		if (strcmp(prop->name, "rotation") == 0) {
+			drmModePropertyPtr rotation =
+				drmModeGetProperty(fd, prop->id);
 
-		drmModeFreeProperty(prop);
+			igt_assert(rotation);
+			plane->rotations = igt_plane_rotations(display, plane, rotation);
+			drmModeFreeProperty(rotation);
+		}
 	}
 
 	if (!plane->rotations)
 		plane->rotations = IGT_ROTATION_0;
-
-	drmModeFreeObjectProperties(props);
 }
 
 /*
@@ -817,60 +976,44 @@ static void
 igt_atomic_fill_connector_props(igt_display_t *display, igt_output_t *output,
 			int num_connector_props, const char * const conn_prop_names[])
 {
-	drmModeObjectPropertiesPtr props;
-	int i, j, fd;
-
-	fd = display->drm_fd;
+	const struct kms_cached_object *obj;
+	int i, j;
 
-	props = drmModeObjectGetProperties(fd, output->config.connector->connector_id, DRM_MODE_OBJECT_CONNECTOR);
-	igt_assert(props);
+	obj = kms_cached_props(display->drm_fd, output->config.connector->connector_id, DRM_MODE_OBJECT_CONNECTOR);
 
-	for (i = 0; i < props->count_props; i++) {
-		drmModePropertyPtr prop =
-			drmModeGetProperty(fd, props->props[i]);
+	for (i = 0; i < obj->count_props; i++) {
+		const struct kms_cached_prop *prop = &obj->props[i];
 
 		for (j = 0; j < num_connector_props; j++) {
 			if (strcmp(prop->name, conn_prop_names[j]) != 0)
 				continue;
 
-			output->props[j] = props->props[i];
+			output->props[j] = prop->id;
 			break;
 		}
-
-		drmModeFreeProperty(prop);
 	}
-
-	drmModeFreeObjectProperties(props);
 }
 
 static void
 igt_fill_pipe_props(igt_display_t *display, igt_pipe_t *pipe,
 		    int num_crtc_props, const char * const crtc_prop_names[])
 {
-	drmModeObjectPropertiesPtr props;
-	int i, j, fd;
+	const struct kms_cached_object *obj;
+	int i, j;
 
-	fd = display->drm_fd;
+	obj = kms_cached_props(display->drm_fd, pipe->crtc_id, DRM_MODE_OBJECT_CRTC);
 
-	props = drmModeObjectGetProperties(fd, pipe->crtc_id, DRM_MODE_OBJECT_CRTC);
-	igt_assert(props);
-
-	for (i = 0; i < props->count_props; i++) {
-		drmModePropertyPtr prop =
-			drmModeGetProperty(fd, props->props[i]);
+	for (i = 0; i < obj->count_props; i++) {
+		const struct kms_cached_prop *prop = &obj->props[i];
 
 		for (j = 0; j < num_crtc_props; j++) {
 			if (strcmp(prop->name, crtc_prop_names[j]) != 0)
 				continue;
 
-			pipe->props[j] = props->props[i];
+			pipe->props[j] = prop->id;
 			break;
 		}
-
-		drmModeFreeProperty(prop);
 	}
-
-	drmModeFreeObjectProperties(props);
 }
 
 static igt_plane_t *igt_get_assigned_primary(igt_output_t *output, igt_pipe_t *pipe)
@@ -1814,14 +1957,14 @@ bool kmstest_force_connector_joiner(int drm_fd, drmModeConnector *connector, int
 void kmstest_force_edid(int drm_fd, drmModeConnector *connector,
 			const struct edid *edid)
 {
-	char *path;
+	const char *path;
 	int debugfs_fd, ret;
 	drmModeConnector *temp;
 
-	igt_assert_neq(asprintf(&path, "%s-%d/edid_override", kmstest_connector_type_str(connector->connector_type), connector->connector_type_id),
-		       -1);
+	path = igt_arena_printf("%s-%d/edid_override",
+				kmstest_connector_type_str(connector->connector_type),
+				connector->connector_type_id);
 	debugfs_fd = igt_debugfs_open(drm_fd, path, O_WRONLY | O_TRUNC);
-	free(path);
 
 	igt_require(debugfs_fd != -1);
 
@@ -2595,10 +2738,12 @@ static void igt_plane_reset(igt_plane_t *plane)
 	plane->gem_handle = 0;
 }
 
-static void igt_pipe_reset(igt_pipe_t *pipe)
+static void igt_pipe_reset(igt_pipe_t *pipe, bool keep_mode)
 {
-	igt_pipe_obj_set_prop_value(pipe, IGT_CRTC_MODE_ID, 0);
-	igt_pipe_obj_set_prop_value(pipe, IGT_CRTC_ACTIVE, 0);
+	if (!keep_mode) {
+		igt_pipe_obj_set_prop_value(pipe, IGT_CRTC_MODE_ID, 0);
+		igt_pipe_obj_set_prop_value(pipe, IGT_CRTC_ACTIVE, 0);
+	}
 	igt_pipe_obj_clear_prop_changed(pipe, IGT_CRTC_OUT_FENCE_PTR);
 
 	if (igt_pipe_obj_has_prop(pipe, IGT_CRTC_CTM))
@@ -2619,13 +2764,30 @@ static void igt_pipe_reset(igt_pipe_t *pipe)
 	pipe->out_fence_fd = -1;
 }
 
+/* Only an output as enabled by the last commit can be kept as it is */
+static bool output_can_linger(igt_output_t *output)
+{
+	igt_pipe_t *pipe;
+
+	if (output->pending_pipe == PIPE_NONE)
+		return false;
+
+	pipe = &output->display->pipes[output->pending_pipe];
+
+	return !output->use_override_mode &&
+	       !igt_output_is_prop_changed(output, IGT_CONNECTOR_CRTC_ID) &&
+	       !igt_pipe_obj_is_prop_changed(pipe, IGT_CRTC_MODE_ID) &&
+	       !igt_pipe_obj_is_prop_changed(pipe, IGT_CRTC_ACTIVE);
+}
+
 static void igt_output_reset(igt_output_t *output)
 {
 	output->pending_pipe = PIPE_NONE;
 	output->use_override_mode = false;
 	memset(&output->override_mode, 0, sizeof(output->override_mode));
 
-	igt_output_set_prop_value(output, IGT_CONNECTOR_CRTC_ID, 0);
+	if (output->lingering_pipe == PIPE_NONE)
+		igt_output_set_prop_value(output, IGT_CONNECTOR_CRTC_ID, 0);
 
 	if (igt_output_has_prop(output, IGT_CONNECTOR_BROADCAST_RGB))
 		igt_output_set_prop_value(output, IGT_CONNECTOR_BROADCAST_RGB,
@@ -2677,9 +2839,17 @@ static void igt_output_reset(igt_output_t *output)
  * - %IGT_PLANE_CRTC_ID
  * - %IGT_PLANE_ROTATION
  * - %IGT_PLANE_IN_FENCE_FD
+ *
+ * With igt_display_set_minimal_reset() enabled, on an atomic display, the
+ * outputs enabled by the last commit stay on their pipe in the hardware,
+ * without any plane. They are still reset to no pipe as far as the test can
+ * see, but setting them up again with the same pipe and mode in the next
+ * commit doesn't need a modeset. They are only disabled once the next state
+ * needs their output or pipe, or a commit fails with them enabled.
  */
 void igt_display_reset(igt_display_t *display)
 {
+	unsigned long keep = 0;
 	enum pipe pipe;
 	int i;
 
@@ -2689,6 +2859,19 @@ void igt_display_reset(igt_display_t *display)
 	 */
 	display->first_commit = true;
 
+	for (i = 0; i < display->n_outputs; i++) {
+		igt_output_t *output = &display->outputs[i];
+
+		if (!display->minimal_reset || !display->is_atomic)
+			output->lingering_pipe = PIPE_NONE;
+		else if (output->pending_pipe != PIPE_NONE)
+			output->lingering_pipe = output_can_linger(output) ?
+						 output->pending_pipe : PIPE_NONE;
+
+		if (output->lingering_pipe != PIPE_NONE)
+			keep |= 1ul << output->lingering_pipe;
+	}
+
 	for_each_pipe(display, pipe) {
 		igt_pipe_t *pipe_obj = &display->pipes[pipe];
 		igt_plane_t *plane;
@@ -2696,7 +2879,7 @@ void igt_display_reset(igt_display_t *display)
 		for_each_plane_on_pipe(display, pipe, plane)
 			igt_plane_reset(plane);
 
-		igt_pipe_reset(pipe_obj);
+		igt_pipe_reset(pipe_obj, keep & (1ul << pipe));
 	}
 
 	for (i = 0; i < display->n_outputs; i++) {
@@ -2706,6 +2889,38 @@ void igt_display_reset(igt_display_t *display)
 	}
 }
 
+/**
+ * igt_display_reset_full:
+ * @display: a pointer to an #igt_display_t structure
+ *
+ * Like igt_display_reset(), but also disables the outputs which a minimal
+ * reset would keep enabled, for tests which need the next commit to do a
+ * full modeset.
+ */
+void igt_display_reset_full(igt_display_t *display)
+{
+	bool minimal = display->minimal_reset;
+
+	display->minimal_reset = false;
+	igt_display_reset(display);
+	display->minimal_reset = minimal;
+}
+
+/**
+ * igt_display_set_minimal_reset:
+ * @display: a pointer to an #igt_display_t structure
+ * @enable: whether igt_display_reset() keeps the enabled outputs
+ *
+ * Selects whether igt_display_reset() keeps the outputs enabled by the last
+ * commit on their pipe, so that consecutive subtests using the same outputs,
+ * pipes and modes don't need a modeset each. This is also enabled by setting
+ * IGT_KMS_MINIMAL_RESET=1 in the environment.
+ */
+void igt_display_set_minimal_reset(igt_display_t *display, bool enable)
+{
+	display->minimal_reset = enable;
+}
+
 static void igt_fill_plane_format_mod(igt_display_t *display, igt_plane_t *plane);
 static void igt_fill_display_format_mod(igt_display_t *display);
 
@@ -2845,18 +3060,28 @@ void igt_display_reset_outputs(igt_display_t *display)
 		 * a pipe is set with igt_output_set_pipe().
 		 */
 		output->pending_pipe = PIPE_NONE;
+		output->lingering_pipe = PIPE_NONE;
 		output->id = resources->connectors[i];
 		output->display = display;
 
 		igt_output_refresh(output);
 
+		/*
+		 * Connectors without modes get a full probe, but only once
+		 * per topology snapshot: a disconnected connector would
+		 * otherwise be probed over DDC on every call.
+		 */
 		connector = output->config.connector;
 		if (connector &&
 		    (!connector->count_modes ||
-		     connector->connection == DRM_MODE_UNKNOWNCONNECTION)) {
+		     connector->connection == DRM_MODE_UNKNOWNCONNECTION) &&
+		    !kms_connector_probed(display->drm_fd, output->id)) {
 			output->force_reprobe = true;
 			igt_output_refresh(output);
 		}
+
+		if (output->config.connector)
+			kms_connector_set_probed(display->drm_fd, output->id);
 	}
 
 	/* Set reasonable default values for every object in the
@@ -2932,6 +3157,9 @@ void igt_display_require(igt_display_t *display, int drm_fd)
 	if (drmSetClientCap(drm_fd, DRM_CLIENT_CAP_ATOMIC, 1) == 0)
 		display->is_atomic = 1;
 
+	display->minimal_reset = igt_check_boolean_env_var("IGT_KMS_MINIMAL_RESET",
+							   false);
+
 	resources = drmModeGetResources(display->drm_fd);
 	if (!resources)
 		goto out;
@@ -3323,6 +3551,8 @@ void igt_display_fini(igt_display_t *display)
 	display->pipes = NULL;
 	free(display->planes);
 	display->planes = NULL;
+
+	igt_fb_release_staging_bos(display->drm_fd);
 }
 
 static void igt_display_refresh(igt_display_t *display)
@@ -4451,21 +4681,15 @@ static void igt_atomic_prepare_connector_commit(igt_output_t *output, drmModeAto
 }
 
 /*
- * Commit all the changes of all the planes,crtcs, connectors
- * atomically using drmModeAtomicCommit()
+ * Add the changes of all the planes, crtcs and connectors to the atomic
+ * property set
  */
-static int igt_atomic_commit(igt_display_t *display, uint32_t flags, void *user_data)
+static void igt_atomic_prepare_commit(igt_display_t *display, drmModeAtomicReq *req)
 {
-
-	int ret = 0, i;
+	int i;
 	enum pipe pipe;
-	drmModeAtomicReq *req;
 	igt_output_t *output;
 
-	if (display->is_atomic != 1)
-		return -1;
-	req = drmModeAtomicAlloc();
-
 	for_each_pipe(display, pipe) {
 		igt_pipe_t *pipe_obj = &display->pipes[pipe];
 		igt_plane_t *plane;
@@ -4499,12 +4723,91 @@ static int igt_atomic_commit(igt_display_t *display, uint32_t flags, void *user_
 
 		igt_atomic_prepare_connector_commit(output, req);
 	}
+}
+
+/*
+ * Commit all the changes of all the planes,crtcs, connectors
+ * atomically using drmModeAtomicCommit()
+ */
+/*
+ * Disables the outputs kept enabled by a minimal igt_display_reset() once
+ * their output or pipe is needed elsewhere, or all of them with @all.
+ * Returns whether any was disabled.
+ */
+static bool display_release_lingering(igt_display_t *display, bool all)
+{
+	bool released = false;
+	int i;
+
+	for (i = 0; i < display->n_outputs; i++) {
+		igt_output_t *output = &display->outputs[i];
+		enum pipe pipe = output->lingering_pipe;
+		igt_pipe_t *pipe_obj;
+
+		if (pipe == PIPE_NONE)
+			continue;
+
+		/* Set up again the same way, nothing to do */
+		if (output->pending_pipe == pipe) {
+			output->lingering_pipe = PIPE_NONE;
+			continue;
+		}
+
+		pipe_obj = &display->pipes[pipe];
+		if (!all && output->pending_pipe == PIPE_NONE &&
+		    !igt_output_is_prop_changed(output, IGT_CONNECTOR_CRTC_ID) &&
+		    !igt_pipe_get_output(pipe_obj))
+			continue;
+
+		LOG(display, "%s: releasing pipe %s\n", igt_output_name(output),
+		    kmstest_pipe_name(pipe));
+
+		output->lingering_pipe = PIPE_NONE;
+		if (output->pending_pipe == PIPE_NONE)
+			igt_output_set_prop_value(output, IGT_CONNECTOR_CRTC_ID, 0);
+		if (!igt_pipe_get_output(pipe_obj)) {
+			igt_pipe_obj_replace_prop_blob(pipe_obj, IGT_CRTC_MODE_ID,
+						       NULL, 0);
+			igt_pipe_obj_set_prop_value(pipe_obj, IGT_CRTC_ACTIVE, 0);
+		}
+		released = true;
+	}
+
+	return released;
+}
+
+static int __igt_atomic_commit(igt_display_t *display, uint32_t flags,
+			       void *user_data)
+{
+	drmModeAtomicReq *req;
+	int ret;
+
+	req = drmModeAtomicAlloc();
+
+	igt_atomic_prepare_commit(display, req);
 
 	ret = drmModeAtomicCommit(display->drm_fd, req, flags, user_data);
 
 	drmModeAtomicFree(req);
 	return ret;
+}
+
+static int igt_atomic_commit(igt_display_t *display, uint32_t flags, void *user_data)
+{
+	int ret;
+
+	if (display->is_atomic != 1)
+		return -1;
+
+	display_release_lingering(display, false);
+
+	ret = __igt_atomic_commit(display, flags, user_data);
+
+	/* The pipes kept enabled may be what the new state doesn't fit with */
+	if (ret && display_release_lingering(display, true))
+		ret = __igt_atomic_commit(display, flags, user_data);
 
+	return ret;
 }
 
 static void
@@ -4616,6 +4919,9 @@ static int do_display_commit(igt_display_t *display,
 	if (s == COMMIT_ATOMIC) {
 		ret = igt_atomic_commit(display, DRM_MODE_ATOMIC_ALLOW_MODESET, NULL);
 	} else {
+		/* Legacy commits can't keep a pipe enabled without its planes */
+		display_release_lingering(display, true);
+
 		for_each_pipe(display, pipe) {
 			igt_pipe_t *pipe_obj = &display->pipes[pipe];
 
@@ -4711,6 +5017,227 @@ void igt_display_commit_atomic(igt_display_t *display, uint32_t flags, void *use
 	igt_assert_eq(ret, 0);
 }
 
+#define IGT_ATOMIC_TEMPLATE_MAX_PATCHES 32
+
+struct igt_atomic_template {
+	igt_display_t *display;
+	drmModeAtomicReq *req;
+	int base;
+	int n_patches;
+	struct {
+		igt_plane_t *plane;
+		enum igt_atomic_plane_properties prop;
+		uint64_t value;
+	} patches[IGT_ATOMIC_TEMPLATE_MAX_PATCHES];
+};
+
+/**
+ * igt_atomic_template_capture:
+ * @display: #igt_display_t to capture the pending changes of
+ *
+ * Builds the atomic request of the changes pending on @display once, so
+ * that it can be committed repeatedly with igt_atomic_template_commit(),
+ * with only the framebuffer, in-fence and position of some planes
+ * patched in between, see igt_atomic_template_set_fb() and friends. This
+ * keeps the cost of building the request out of flip-heavy loops, where
+ * igt_display_try_commit_atomic() walks every pipe, plane and connector on
+ * each call.
+ *
+ * The pending changes are left pending on @display. Capturing right after
+ * a commit gives an empty template, to which only the patched properties
+ * get added.
+ *
+ * Returns: the template, to be freed with igt_atomic_template_free().
+ */
+struct igt_atomic_template *igt_atomic_template_capture(igt_display_t *display)
+{
+	struct igt_atomic_template *tmpl;
+
+	/* someone managed to bypass igt_display_require, catch them */
+	assert(display->n_pipes && display->n_outputs);
+	igt_assert(display->is_atomic);
+
+	tmpl = calloc(1, sizeof(*tmpl));
+	igt_assert(tmpl);
+
+	tmpl->display = display;
+	tmpl->req = drmModeAtomicAlloc();
+	igt_assert(tmpl->req);
+
+	LOG_INDENT(display, "template");
+	igt_display_refresh(display);
+	igt_atomic_prepare_commit(display, tmpl->req);
+	LOG_UNINDENT(display);
+
+	tmpl->base = drmModeAtomicGetCursor(tmpl->req);
+
+	return tmpl;
+}
+
+static void
+igt_atomic_template_patch(struct igt_atomic_template *tmpl, igt_plane_t *plane,
+			  enum igt_atomic_plane_properties prop, uint64_t value)
+{
+	int i;
+
+	/* it's an error to try an unsupported feature */
+	igt_assert(plane->props[prop]);
+
+	for (i = 0; i < tmpl->n_patches; i++) {
+		if (tmpl->patches[i].plane == plane &&
+		    tmpl->patches[i].prop == prop)
+			break;
+	}
+
+	if (i == tmpl->n_patches) {
+		igt_assert_lt(i, IGT_ATOMIC_TEMPLATE_MAX_PATCHES);
+		tmpl->patches[i].plane = plane;
+		tmpl->patches[i].prop = prop;
+		tmpl->n_patches++;
+	}
+
+	tmpl->patches[i].value = value;
+}
+
+/**
+ * igt_atomic_template_set_fb:
+ * @tmpl: template from igt_atomic_template_capture()
+ * @plane: plane to flip
+ * @fb: framebuffer to flip to
+ *
+ * Makes the following commits of @tmpl scan out @fb on @plane. Unlike
+ * igt_plane_set_fb(), this doesn't touch the source and destination
+ * rectangles: @fb is expected to match the framebuffer it replaces.
+ */
+void igt_atomic_template_set_fb(struct igt_atomic_template *tmpl,
+				igt_plane_t *plane, struct igt_fb *fb)
+{
+	igt_atomic_template_patch(tmpl, plane, IGT_PLANE_FB_ID,
+				  fb ? fb->fb_id : 0);
+}
+
+/**
+ * igt_atomic_template_set_fence_fd:
+ * @tmpl: template from igt_atomic_template_capture()
+ * @plane: plane the fence applies to
+ * @fence_fd: fence to wait on before scanning out, or -1 for none
+ *
+ * Sets the in-fence of @plane for the next commit of @tmpl. The fence stays
+ * owned by the caller, and is reset to -1 once committed.
+ */
+void igt_atomic_template_set_fence_fd(struct igt_atomic_template *tmpl,
+				      igt_plane_t *plane, int fence_fd)
+{
+	igt_atomic_template_patch(tmpl, plane, IGT_PLANE_IN_FENCE_FD,
+				  (int64_t)fence_fd);
+}
+
+/**
+ * igt_atomic_template_set_position:
+ * @tmpl: template from igt_atomic_template_capture()
+ * @plane: plane to move
+ * @x: X coordinate of the plane on the crtc
+ * @y: Y coordinate of the plane on the crtc
+ *
+ * Makes the following commits of @tmpl place @plane at (@x, @y).
+ */
+void igt_atomic_template_set_position(struct igt_atomic_template *tmpl,
+				      igt_plane_t *plane, int x, int y)
+{
+	igt_atomic_template_patch(tmpl, plane, IGT_PLANE_CRTC_X, (int64_t)x);
+	igt_atomic_template_patch(tmpl, plane, IGT_PLANE_CRTC_Y, (int64_t)y);
+}
+
+/**
+ * igt_atomic_template_try_commit:
+ * @tmpl: template from igt_atomic_template_capture()
+ * @flags: Flags passed to drmModeAtomicCommit.
+ * @user_data: User defined pointer passed to drmModeAtomicCommit.
+ *
+ * Commits the captured request of @tmpl with the current patches applied.
+ * Patched properties override the captured value of the same property.
+ *
+ * On success the patched framebuffers and positions are also recorded in
+ * the planes of the display, without flagging them as changed, so that
+ * regular commits can be mixed with template ones.
+ *
+ * Returns: 0 on success, or the error returned by drmModeAtomicCommit.
+ */
+int igt_atomic_template_try_commit(struct igt_atomic_template *tmpl,
+				   uint32_t flags, void *user_data)
+{
+	igt_display_t *display = tmpl->display;
+	int i, ret;
+
+	if (display->first_commit)
+		igt_fail_on_f(flags & (DRM_MODE_PAGE_FLIP_EVENT | DRM_MODE_ATOMIC_NONBLOCK),
+			      "First commit has to drop all stale events\n");
+
+	/*
+	 * Drop the patches of the previous commit and append the current
+	 * ones. drmModeAtomicCommit() keeps the last value added for a
+	 * property, so patches override the captured changes.
+	 */
+	drmModeAtomicSetCursor(tmpl->req, tmpl->base);
+
+	for (i = 0; i < tmpl->n_patches; i++) {
+		igt_plane_t *plane = tmpl->patches[i].plane;
+
+		igt_assert_lt(0, drmModeAtomicAddProperty(tmpl->req,
+							  plane->drm_plane->plane_id,
+							  plane->props[tmpl->patches[i].prop],
+							  tmpl->patches[i].value));
+	}
+
+	ret = drmModeAtomicCommit(display->drm_fd, tmpl->req, flags, user_data);
+	if (ret || (flags & DRM_MODE_ATOMIC_TEST_ONLY))
+		return ret;
+
+	for (i = 0; i < tmpl->n_patches; i++) {
+		if (tmpl->patches[i].prop == IGT_PLANE_IN_FENCE_FD) {
+			tmpl->patches[i].value = (int64_t)-1;
+			continue;
+		}
+
+		tmpl->patches[i].plane->values[tmpl->patches[i].prop] =
+			tmpl->patches[i].value;
+	}
+
+	return 0;
+}
+
+/**
+ * igt_atomic_template_commit:
+ * @tmpl: template from igt_atomic_template_capture()
+ * @flags: Flags passed to drmModeAtomicCommit.
+ * @user_data: User defined pointer passed to drmModeAtomicCommit.
+ *
+ * Like igt_atomic_template_try_commit(), but aborts the test if the commit
+ * fails.
+ */
+void igt_atomic_template_commit(struct igt_atomic_template *tmpl,
+				uint32_t flags, void *user_data)
+{
+	int ret = igt_atomic_template_try_commit(tmpl, flags, user_data);
+
+	igt_assert_eq(ret, 0);
+}
+
+/**
+ * igt_atomic_template_free:
+ * @tmpl: template from igt_atomic_template_capture()
+ *
+ * Releases @tmpl.
+ */
+void igt_atomic_template_free(struct igt_atomic_template *tmpl)
+{
+	if (!tmpl)
+		return;
+
+	drmModeAtomicFree(tmpl->req);
+	free(tmpl);
+}
+
 /**
  * igt_display_commit2:
  * @display: DRM device handle
@@ -4978,27 +5505,268 @@ void igt_output_set_pipe(igt_output_t *output, enum pipe pipe)
 	}
 }
 
+/*
+ * Searching for a mode combination that fits the bandwidth is done best
+ * first: combinations are tried by decreasing sum of pixel clocks, each
+ * output's modes being sorted by decreasing clock. Before a TEST_ONLY
+ * commit, a combination is checked against a simple bandwidth model:
+ *
+ * - every output needs one pipe per max_dotclock worth of pixel clock
+ *   (two or four when joining pipes), and there are only so many pipes;
+ * - a combination at least as demanding as one which already failed for
+ *   bandwidth reasons, i.e. with every clock at least as high, fails too.
+ *
+ * Modes with identical timings are only tried once per output, and the
+ * number of TEST_ONLY commits is capped.
+ */
+#define FIT_BW_MAX_COMMITS 256
+#define FIT_BW_MAX_CANDIDATES (1 << 16)
+
+struct fit_bw_combo {
+	uint64_t clock;
+	unsigned int last;
+	uint16_t mode[IGT_MAX_PIPES];
+};
+
+struct fit_bw_search {
+	igt_output_t **outputs;
+	int n_outputs;
+	int n_pipes;
+	int max_dotclock;
+
+	/* distinct modes of each output, by decreasing clock */
+	int *modes[IGT_MAX_PIPES];
+	int n_modes[IGT_MAX_PIPES];
+
+	struct fit_bw_combo *heap;
+	int heap_size;
+	int heap_alloc;
+
+	/* clocks of the combinations rejected for bandwidth */
+	int (*failed)[IGT_MAX_PIPES];
+	int n_failed;
+};
+
+static bool mode_timings_equal(const drmModeModeInfo *a,
+			       const drmModeModeInfo *b)
+{
+	return a->clock == b->clock &&
+		a->hdisplay == b->hdisplay &&
+		a->hsync_start == b->hsync_start &&
+		a->hsync_end == b->hsync_end &&
+		a->htotal == b->htotal &&
+		a->hskew == b->hskew &&
+		a->vdisplay == b->vdisplay &&
+		a->vsync_start == b->vsync_start &&
+		a->vsync_end == b->vsync_end &&
+		a->vtotal == b->vtotal &&
+		a->vscan == b->vscan &&
+		a->vrefresh == b->vrefresh &&
+		a->flags == b->flags;
+}
+
+static drmModeModeInfo *
+fit_bw_mode(struct fit_bw_search *search, int output, int idx)
+{
+	drmModeConnector *connector =
+		search->outputs[output]->config.connector;
+
+	return &connector->modes[search->modes[output][idx]];
+}
+
+static uint64_t fit_bw_clock(struct fit_bw_search *search,
+			     const struct fit_bw_combo *combo)
+{
+	uint64_t clock = 0;
+	int i;
+
+	for (i = 0; i < search->n_outputs; i++)
+		clock += fit_bw_mode(search, i, combo->mode[i])->clock;
+
+	return clock;
+}
+
+static void fit_bw_push(struct fit_bw_search *search,
+			const struct fit_bw_combo *combo)
+{
+	int i = search->heap_size++;
+
+	if (search->heap_size > search->heap_alloc) {
+		search->heap_alloc = max(2 * search->heap_alloc, 64);
+		search->heap = realloc(search->heap,
+				       search->heap_alloc * sizeof(*search->heap));
+		igt_assert(search->heap);
+	}
+
+	while (i && search->heap[(i - 1) / 2].clock < combo->clock) {
+		search->heap[i] = search->heap[(i - 1) / 2];
+		i = (i - 1) / 2;
+	}
+	search->heap[i] = *combo;
+}
+
+static void fit_bw_pop(struct fit_bw_search *search, struct fit_bw_combo *combo)
+{
+	struct fit_bw_combo last;
+	int i = 0;
+
+	*combo = search->heap[0];
+	last = search->heap[--search->heap_size];
+
+	for (;;) {
+		int child = 2 * i + 1;
+
+		if (child >= search->heap_size)
+			break;
+
+		if (child + 1 < search->heap_size &&
+		    search->heap[child + 1].clock > search->heap[child].clock)
+			child++;
+
+		if (search->heap[child].clock <= last.clock)
+			break;
+
+		search->heap[i] = search->heap[child];
+		i = child;
+	}
+	search->heap[i] = last;
+}
+
+/*
+ * Successors of a combination lower the mode of one output, at or after
+ * the last lowered one, so that every combination is generated once.
+ */
+static void fit_bw_push_successors(struct fit_bw_search *search,
+				   const struct fit_bw_combo *combo)
+{
+	int i;
+
+	for (i = combo->last; i < search->n_outputs; i++) {
+		struct fit_bw_combo next = *combo;
+
+		if (next.mode[i] + 1 >= search->n_modes[i])
+			continue;
+
+		next.mode[i]++;
+		next.last = i;
+		next.clock = fit_bw_clock(search, &next);
+		fit_bw_push(search, &next);
+	}
+}
+
+static bool fit_bw_plausible(struct fit_bw_search *search,
+			     const struct fit_bw_combo *combo)
+{
+	int i, j, pipes = 0;
+
+	if (search->max_dotclock) {
+		for (i = 0; i < search->n_outputs; i++) {
+			int clock = fit_bw_mode(search, i, combo->mode[i])->clock;
+
+			if (clock <= search->max_dotclock)
+				pipes += 1;
+			else if (clock <= 2 * search->max_dotclock)
+				pipes += 2;
+			else if (clock <= 4 * search->max_dotclock)
+				pipes += 4;
+			else
+				return false;
+		}
+
+		if (pipes > search->n_pipes)
+			return false;
+	}
+
+	for (j = 0; j < search->n_failed; j++) {
+		for (i = 0; i < search->n_outputs; i++) {
+			if (fit_bw_mode(search, i, combo->mode[i])->clock <
+			    search->failed[j][i])
+				break;
+		}
+
+		if (i == search->n_outputs)
+			return false;
+	}
+
+	return true;
+}
+
+static void fit_bw_record_failure(struct fit_bw_search *search,
+				  const struct fit_bw_combo *combo)
+{
+	int i;
+
+	search->failed = realloc(search->failed,
+				 (search->n_failed + 1) * sizeof(*search->failed));
+	igt_assert(search->failed);
+
+	for (i = 0; i < search->n_outputs; i++)
+		search->failed[search->n_failed][i] =
+			fit_bw_mode(search, i, combo->mode[i])->clock;
+
+	search->n_failed++;
+}
+
 static
 bool __override_all_active_output_modes_to_fit_bw(igt_display_t *display,
 						  igt_output_t *outputs[IGT_MAX_PIPES],
-						  const int n_outputs,
-						  int base)
+						  const int n_outputs)
 {
-	igt_output_t *output = NULL;
+	struct fit_bw_search search = {
+		.outputs = outputs,
+		.n_outputs = n_outputs,
+	};
+	struct fit_bw_combo combo = {};
+	int i, commits = 0, candidates = 0;
+	bool found = false;
 
-	if (base >= n_outputs)
-		return false;
+	for_each_pipe(display, i)
+		search.n_pipes++;
 
-	output = outputs[base];
+	if (is_intel_device(display->drm_fd))
+		search.max_dotclock = igt_get_max_dotclock(display->drm_fd);
 
-	for_each_connector_mode(output) {
+	for (i = 0; i < n_outputs; i++) {
+		drmModeConnector *connector = outputs[i]->config.connector;
+
+		if (!connector->count_modes)
+			goto out;
+
+		search.modes[i] = malloc(connector->count_modes * sizeof(int));
+		igt_assert(search.modes[i]);
+
+		for_each_connector_mode(outputs[i]) {
+			drmModeModeInfo *mode = &connector->modes[j__];
+			int k;
+
+			for (k = 0; k < search.n_modes[i]; k++)
+				if (mode_timings_equal(mode, fit_bw_mode(&search, i, k)))
+					break;
+
+			if (k == search.n_modes[i])
+				search.modes[i][search.n_modes[i]++] = j__;
+		}
+	}
+
+	combo.clock = fit_bw_clock(&search, &combo);
+	fit_bw_push(&search, &combo);
+
+	while (search.heap_size && !found &&
+	       commits < FIT_BW_MAX_COMMITS &&
+	       candidates++ < FIT_BW_MAX_CANDIDATES) {
 		int ret;
 
-		igt_output_override_mode(output, &output->config.connector->modes[j__]);
+		fit_bw_pop(&search, &combo);
+		fit_bw_push_successors(&search, &combo);
 
-		if (__override_all_active_output_modes_to_fit_bw(display, outputs, n_outputs, base + 1))
-			return true;
+		if (!fit_bw_plausible(&search, &combo))
+			continue;
+
+		for (i = 0; i < n_outputs; i++)
+			igt_output_override_mode(outputs[i],
+						 fit_bw_mode(&search, i, combo.mode[i]));
 
+		commits++;
 		if (display->is_atomic)
 			ret = igt_display_try_commit_atomic(display,
 					DRM_MODE_ATOMIC_TEST_ONLY |
@@ -5008,12 +5776,23 @@ bool __override_all_active_output_modes_to_fit_bw(igt_display_t *display,
 			ret = igt_display_try_commit2(display, COMMIT_LEGACY);
 
 		if (!ret)
-			return true;
-		else if (ret != -ENOSPC && ret != -EINVAL)
-			return false;
+			found = true;
+		else if (ret == -ENOSPC)
+			fit_bw_record_failure(&search, &combo);
+		else if (ret != -EINVAL)
+			break;
 	}
 
-	return false;
+	igt_debug("%s mode combination to fit bandwidth after %d commits\n",
+		  found ? "Found" : "No", commits);
+
+out:
+	for (i = 0; i < n_outputs; i++)
+		free(search.modes[i]);
+	free(search.heap);
+	free(search.failed);
+
+	return found;
 }
 
 /**
@@ -5044,7 +5823,7 @@ bool igt_override_all_active_output_modes_to_fit_bw(igt_display_t *display)
 	}
 	igt_require_f(n_outputs, "No active outputs found.\n");
 
-	return __override_all_active_output_modes_to_fit_bw(display, outputs, n_outputs, 0);
+	return __override_all_active_output_modes_to_fit_bw(display, outputs, n_outputs);
 }
 
 /*
@@ -5654,6 +6433,10 @@ bool event_detected(struct udev_monitor *mon, int timeout_secs,
 		udev_device_unref(dev);
 	}
 
+	/* Whatever changed, the probed topology may be stale now */
+	if (event_received)
+		igt_kms_invalidate_topology(-1);
+
 	return event_received;
 }
 
@@ -6976,12 +7759,11 @@ static int parse_path_connector(char *connector_path)
 {
 	int connector_id;
 	char *encoder;
-	char *connector_path_copy = strdup(connector_path);
+	char *connector_path_copy = igt_arena_strdup(connector_path);
 
 	encoder = strtok(connector_path_copy, ":");
 	igt_assert_f(!strcmp(encoder, "mst"), "PATH connector property expected to have 'mst'\n");
 	connector_id = atoi(strtok(NULL, "-"));
-	free(connector_path_copy);
 
 	return connector_id;
 }
@@ -484,6 +484,8 @@ typedef struct {
 	char *name;
 	bool force_reprobe;
 	enum pipe pending_pipe;
+	/* pipe still driven after a minimal igt_display_reset() */
+	enum pipe lingering_pipe;
 	bool use_override_mode;
 	drmModeModeInfo override_mode;
 
@@ -509,6 +511,7 @@ struct igt_display {
 	bool is_atomic;
 	bool has_virt_cursor_plane;
 	bool first_commit;
+	bool minimal_reset;
 
 	uint64_t *modifiers;
 	uint32_t *formats;
@@ -533,13 +536,28 @@ typedef struct {
 } igt_backlight_context_t;
 
 void igt_display_reset_outputs(igt_display_t *display);
+void igt_kms_invalidate_topology(int drm_fd);
 void igt_display_require(igt_display_t *display, int drm_fd);
 void igt_display_fini(igt_display_t *display);
 void igt_display_reset(igt_display_t *display);
+void igt_display_reset_full(igt_display_t *display);
+void igt_display_set_minimal_reset(igt_display_t *display, bool enable);
 int  igt_display_commit2(igt_display_t *display, enum igt_commit_style s);
 int  igt_display_commit(igt_display_t *display);
 int  igt_display_try_commit_atomic(igt_display_t *display, uint32_t flags, void *user_data);
 void igt_display_commit_atomic(igt_display_t *display, uint32_t flags, void *user_data);
+struct igt_atomic_template *igt_atomic_template_capture(igt_display_t *display);
+void igt_atomic_template_set_fb(struct igt_atomic_template *tmpl,
+				igt_plane_t *plane, struct igt_fb *fb);
+void igt_atomic_template_set_fence_fd(struct igt_atomic_template *tmpl,
+				      igt_plane_t *plane, int fence_fd);
+void igt_atomic_template_set_position(struct igt_atomic_template *tmpl,
+				      igt_plane_t *plane, int x, int y);
+int igt_atomic_template_try_commit(struct igt_atomic_template *tmpl,
+				   uint32_t flags, void *user_data);
+void igt_atomic_template_commit(struct igt_atomic_template *tmpl,
+				uint32_t flags, void *user_data);
+void igt_atomic_template_free(struct igt_atomic_template *tmpl);
 int  igt_display_try_commit2(igt_display_t *display, enum igt_commit_style s);
 int  igt_display_drop_events(igt_display_t *display);
 int  igt_display_get_n_pipes(igt_display_t *display);
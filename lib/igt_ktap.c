@@ -35,6 +35,14 @@ struct igt_ktap_results {
 	char *case_name;
 	unsigned int sub_last;
 	struct igt_list_head *results;
+
+	/* push mode */
+	igt_ktap_result_fn fn;
+	void *data;
+	int status;
+	bool overlong;
+	size_t line_len;
+	char line[BUF_LEN];
 };
 
 /**
@@ -243,6 +251,8 @@ int igt_ktap_parse(const char *buf, struct igt_ktap_results *ktap)
 		if (igt_debug_on(n == ktap->suite_count))
 			return 0;
 
+		if (ktap->fn)
+			free(ktap->suite_name);
 		ktap->suite_name = NULL;
 		ktap->expect = SUITE_START;
 
@@ -271,10 +281,14 @@ int igt_ktap_parse(const char *buf, struct igt_ktap_results *ktap)
 
 	if (ktap->expect == SUB_RESULT) {
 		/* KTAP parametrized test case name */
+		if (ktap->fn)
+			free(ktap->case_name);
 		ktap->case_name = case_name;
 
 	} else {
 		/* KTAP test case result */
+		if (ktap->fn)
+			free(ktap->case_name);
 		ktap->case_name = NULL;
 
 		/* last test case in a suite */
@@ -282,6 +296,24 @@ int igt_ktap_parse(const char *buf, struct igt_ktap_results *ktap)
 			ktap->expect = SUITE_RESULT;
 	}
 
+	/* Without a list the names stay with the parser, the rest is dropped */
+	if (ktap->fn) {
+		struct igt_ktap_result r = {
+			.suite_name = ktap->suite_name,
+			.case_name = case_name,
+			.msg = msg,
+			.code = code,
+		};
+
+		ktap->fn(&r, ktap->data);
+
+		if (case_name != ktap->case_name)
+			free(case_name);
+		free(msg);
+
+		return -EINPROGRESS;
+	}
+
 	if (igt_debug_on((result = calloc(1, sizeof(*result)), !result))) {
 		free(case_name);
 		free(msg);
@@ -297,6 +329,50 @@ int igt_ktap_parse(const char *buf, struct igt_ktap_results *ktap)
 	return -EINPROGRESS;
 }
 
+/**
+ * igt_ktap_push:
+ * @ktap: parser state, allocated with igt_ktap_alloc_fn()
+ * @buf: raw text, not necessarily split at line boundaries
+ * @len: length of @buf
+ *
+ * Feeds a chunk of a KTAP report to the parser, which passes each test
+ * case result to the callback as soon as its line is complete. Only the
+ * partial last line is kept between calls, in a fixed size buffer, and
+ * lines too long for it are dropped.
+ *
+ * Returns: -EINPROGRESS while more of the report is expected, otherwise
+ * the final status of the parse, also returned by any further call.
+ */
+int igt_ktap_push(struct igt_ktap_results *ktap, const char *buf, size_t len)
+{
+	while (len && ktap->status == -EINPROGRESS) {
+		const char *eol = memchr(buf, '\n', len);
+		size_t n = eol ? eol - buf + 1 : len;
+
+		if (ktap->line_len + n < sizeof(ktap->line)) {
+			memcpy(ktap->line + ktap->line_len, buf, n);
+			ktap->line_len += n;
+		} else {
+			ktap->overlong = true;
+		}
+
+		buf += n;
+		len -= n;
+
+		if (!eol)
+			break;
+
+		ktap->line[ktap->line_len] = '\0';
+		if (!igt_debug_on(ktap->overlong))
+			ktap->status = igt_ktap_parse(ktap->line, ktap);
+
+		ktap->line_len = 0;
+		ktap->overlong = false;
+	}
+
+	return ktap->status;
+}
+
 struct igt_ktap_results *igt_ktap_alloc(struct igt_list_head *results)
 {
 	struct igt_ktap_results *ktap = calloc(1, sizeof(*ktap));
@@ -306,12 +382,42 @@ struct igt_ktap_results *igt_ktap_alloc(struct igt_list_head *results)
 
 	ktap->expect = KTAP_START;
 	ktap->results = results;
+	ktap->status = -EINPROGRESS;
+
+	return ktap;
+}
+
+/**
+ * igt_ktap_alloc_fn:
+ * @fn: called with each test case result
+ * @data: passed to @fn
+ *
+ * Allocates a parser which doesn't queue the results, but passes them to
+ * @fn as they're parsed. The strings of a result are only valid during
+ * the call.
+ *
+ * Returns: The parser state, or NULL on allocation failure.
+ */
+struct igt_ktap_results *igt_ktap_alloc_fn(igt_ktap_result_fn fn, void *data)
+{
+	struct igt_ktap_results *ktap = igt_ktap_alloc(NULL);
+
+	if (!ktap)
+		return NULL;
+
+	ktap->fn = fn;
+	ktap->data = data;
 
 	return ktap;
 }
 
 void igt_ktap_free(struct igt_ktap_results **ktap)
 {
+	if (*ktap && (*ktap)->fn) {
+		free((*ktap)->suite_name);
+		free((*ktap)->case_name);
+	}
+
 	free(*ktap);
 	*ktap = NULL;
 }
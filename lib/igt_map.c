@@ -34,6 +34,7 @@
 
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "igt_map.h"
 
@@ -102,6 +103,21 @@ entry_is_present(const struct igt_map_entry *entry)
 	return entry->key != NULL && entry->key != deleted_key;
 }
 
+/*
+ * Double hashing step is smaller than the table size, so we can avoid
+ * a modulo on each probe.
+ */
+static inline uint32_t
+probe_next(const struct igt_map *map, uint32_t hash_address,
+	   uint32_t double_hash)
+{
+	hash_address += double_hash;
+	if (hash_address >= map->size)
+		hash_address -= map->size;
+
+	return hash_address;
+}
+
 /**
  * igt_map_create:
  * @hash_function: function that maps key to 32b hash
@@ -222,23 +238,20 @@ igt_map_search_pre_hashed(struct igt_map *map, uint32_t hash,
 {
 	uint32_t start_hash_address = hash % map->size;
 	uint32_t hash_address = start_hash_address;
+	uint32_t double_hash = 1 + hash % map->rehash;
 
 	do {
-		uint32_t double_hash;
-
 		struct igt_map_entry *entry = map->table + hash_address;
 
 		if (entry_is_free(entry)) {
 			return NULL;
-		} else if (entry_is_present(entry) && entry->hash == hash) {
+		} else if (entry->hash == hash && entry_is_present(entry)) {
 			if (map->key_equals_function(key, entry->key)) {
 				return entry;
 			}
 		}
 
-		double_hash = 1 + hash % map->rehash;
-
-		hash_address = (hash_address + double_hash) % map->size;
+		hash_address = probe_next(map, hash_address, double_hash);
 	} while (hash_address != start_hash_address);
 
 	return NULL;
@@ -275,6 +288,106 @@ igt_map_rehash(struct igt_map *map, int new_size_index)
 	free(old_map.table);
 }
 
+#define DIRTY_TEST(d, i) ((d)[(i) / 8] & (1 << ((i) % 8)))
+#define DIRTY_CLEAR(d, i) ((d)[(i) / 8] &= ~(1 << ((i) % 8)))
+#define DIRTY_SET(d, i) ((d)[(i) / 8] |= 1 << ((i) % 8))
+
+/*
+ * Drops tombstones without allocating a new table. All deleted entries are
+ * freed and present ones are marked dirty, then each dirty entry is placed
+ * again on its probe sequence, swapping with dirty entries it meets until
+ * nothing is left to place.
+ */
+static void
+igt_map_compact(struct igt_map *map)
+{
+	uint8_t *dirty;
+	uint32_t i;
+
+	if (map->entries == 0) {
+		memset(map->table, 0, map->size * sizeof(*map->table));
+		map->deleted_entries = 0;
+		return;
+	}
+
+	dirty = calloc((map->size + 7) / 8, 1);
+	if (dirty == NULL) {
+		igt_map_rehash(map, map->size_index);
+		return;
+	}
+
+	for (i = 0; i < map->size; i++) {
+		if (entry_is_deleted(&map->table[i]))
+			map->table[i].key = NULL;
+		else if (entry_is_present(&map->table[i]))
+			DIRTY_SET(dirty, i);
+	}
+	map->deleted_entries = 0;
+
+	for (i = 0; i < map->size; i++) {
+		struct igt_map_entry tmp;
+		uint32_t hash_address, double_hash;
+
+		if (!DIRTY_TEST(dirty, i))
+			continue;
+
+		DIRTY_CLEAR(dirty, i);
+		tmp = map->table[i];
+		map->table[i].key = NULL;
+
+		hash_address = tmp.hash % map->size;
+		double_hash = 1 + tmp.hash % map->rehash;
+		for (;;) {
+			struct igt_map_entry *entry = map->table + hash_address;
+
+			if (entry_is_free(entry)) {
+				*entry = tmp;
+				break;
+			}
+
+			if (DIRTY_TEST(dirty, hash_address)) {
+				struct igt_map_entry displaced = *entry;
+
+				DIRTY_CLEAR(dirty, hash_address);
+				*entry = tmp;
+				tmp = displaced;
+
+				hash_address = tmp.hash % map->size;
+				double_hash = 1 + tmp.hash % map->rehash;
+				continue;
+			}
+
+			hash_address = probe_next(map, hash_address, double_hash);
+		}
+	}
+
+	free(dirty);
+}
+
+/**
+ * igt_map_reserve:
+ * @map: igt_map pointer
+ * @entries: number of entries the map is expected to hold
+ *
+ * Grows the table upfront so that @entries can be inserted without
+ * rehashing. It never shrinks the map.
+ *
+ * Note that this rearranges the table, so previously found hash entries are
+ * no longer valid after this function.
+ */
+void
+igt_map_reserve(struct igt_map *map, uint32_t entries)
+{
+	int size_index = map->size_index;
+
+	while (size_index < ARRAY_SIZE(hash_sizes) - 1 &&
+	       hash_sizes[size_index].max_entries <= entries)
+		size_index++;
+
+	if (size_index != map->size_index)
+		igt_map_rehash(map, size_index);
+}
+
 /**
  * igt_map_insert:
  * @map: igt_map pointer
@@ -325,20 +438,20 @@ struct igt_map_entry *
 igt_map_insert_pre_hashed(struct igt_map *map, uint32_t hash,
 			  const void *key, void *data)
 {
-	uint32_t start_hash_address, hash_address;
+	uint32_t start_hash_address, hash_address, double_hash;
 	struct igt_map_entry *available_entry = NULL;
 
 	if (map->entries >= map->max_entries) {
 		igt_map_rehash(map, map->size_index + 1);
 	} else if (map->deleted_entries + map->entries >= map->max_entries) {
-		igt_map_rehash(map, map->size_index);
+		igt_map_compact(map);
 	}
 
 	start_hash_address = hash % map->size;
 	hash_address = start_hash_address;
+	double_hash = 1 + hash % map->rehash;
 	do {
 		struct igt_map_entry *entry = map->table + hash_address;
-		uint32_t double_hash;
 
 		if (!entry_is_present(entry)) {
 			/* Stash the first available entry we find */
@@ -359,18 +472,15 @@ igt_map_insert_pre_hashed(struct igt_map *map, uint32_t hash,
 		 * required to avoid memory leaks, perform a search
 		 * before inserting.
 		 */
-		if (!entry_is_deleted(entry) &&
-		    entry->hash == hash &&
+		if (entry->hash == hash &&
+		    !entry_is_deleted(entry) &&
 		    map->key_equals_function(key, entry->key)) {
 			entry->key = key;
 			entry->data = data;
 			return entry;
 		}
 
-
-		double_hash = 1 + hash % map->rehash;
-
-		hash_address = (hash_address + double_hash) % map->size;
+		hash_address = probe_next(map, hash_address, double_hash);
 	} while (hash_address != start_hash_address);
 
 	if (available_entry) {
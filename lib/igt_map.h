@@ -121,6 +121,9 @@ void
 igt_map_destroy(struct igt_map *map,
 		void (*delete_function)(struct igt_map_entry *entry));
 
+void
+igt_map_reserve(struct igt_map *map, uint32_t entries);
+
 struct igt_map_entry *
 igt_map_insert(struct igt_map *map, const void *key, void *data);
 
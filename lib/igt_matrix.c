@@ -23,6 +23,7 @@
 
 #include "igt_core.h"
 #include "igt_matrix.h"
+#include "igt_x86.h"
 
 /**
  * SECTION:igt_matrix
@@ -139,3 +140,158 @@ struct igt_mat4 igt_matrix_multiply(const struct igt_mat4 *a,
 
 	return ret;
 }
+
+static void matrix_transform_array(const struct igt_mat4 *m,
+				   struct igt_vec4 *dst,
+				   const struct igt_vec4 *src,
+				   unsigned int num)
+{
+	for (unsigned int i = 0; i < num; i++)
+		dst[i] = igt_matrix_transform(m, &src[i]);
+}
+
+#if defined(__x86_64__) && !defined(__clang__) && defined(__GLIBC__) && !defined(__UCLIBC__)
+#pragma GCC push_options
+#pragma GCC target("sse4.1")
+
+#include <smmintrin.h>
+
+/*
+ * The matrix is column major, so each output vector is the sum of the
+ * matrix columns scaled by the respective input element. The summation
+ * order matches igt_matrix_transform() so the results are bit identical.
+ */
+static void matrix_transform_array_sse41(const struct igt_mat4 *m,
+					 struct igt_vec4 *dst,
+					 const struct igt_vec4 *src,
+					 unsigned int num)
+{
+	const __m128 c0 = _mm_loadu_ps(&m->d[m(0, 0)]);
+	const __m128 c1 = _mm_loadu_ps(&m->d[m(0, 1)]);
+	const __m128 c2 = _mm_loadu_ps(&m->d[m(0, 2)]);
+	const __m128 c3 = _mm_loadu_ps(&m->d[m(0, 3)]);
+
+	for (unsigned int i = 0; i < num; i++) {
+		__m128 v = _mm_loadu_ps(src[i].d);
+		__m128 r;
+
+		r = _mm_mul_ps(c0, _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0)));
+		r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1))));
+		r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2))));
+		r = _mm_add_ps(r, _mm_mul_ps(c3, _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3))));
+
+		_mm_storeu_ps(dst[i].d, r);
+	}
+}
+
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx")
+
+#include <immintrin.h>
+
+/* Same as the SSE4.1 variant, two vectors per iteration. */
+static void matrix_transform_array_avx(const struct igt_mat4 *m,
+				       struct igt_vec4 *dst,
+				       const struct igt_vec4 *src,
+				       unsigned int num)
+{
+	const __m256 c0 = _mm256_broadcast_ps((const __m128 *)&m->d[m(0, 0)]);
+	const __m256 c1 = _mm256_broadcast_ps((const __m128 *)&m->d[m(0, 1)]);
+	const __m256 c2 = _mm256_broadcast_ps((const __m128 *)&m->d[m(0, 2)]);
+	const __m256 c3 = _mm256_broadcast_ps((const __m128 *)&m->d[m(0, 3)]);
+	unsigned int i;
+
+	for (i = 0; i + 2 <= num; i += 2) {
+		__m256 v = _mm256_loadu_ps(src[i].d);
+		__m256 r;
+
+		r = _mm256_mul_ps(c0, _mm256_permute_ps(v, _MM_SHUFFLE(0, 0, 0, 0)));
+		r = _mm256_add_ps(r, _mm256_mul_ps(c1, _mm256_permute_ps(v, _MM_SHUFFLE(1, 1, 1, 1))));
+		r = _mm256_add_ps(r, _mm256_mul_ps(c2, _mm256_permute_ps(v, _MM_SHUFFLE(2, 2, 2, 2))));
+		r = _mm256_add_ps(r, _mm256_mul_ps(c3, _mm256_permute_ps(v, _MM_SHUFFLE(3, 3, 3, 3))));
+
+		_mm256_storeu_ps(dst[i].d, r);
+	}
+
+	if (i < num) {
+		__m128 v = _mm_loadu_ps(src[i].d);
+		__m128 r;
+
+		r = _mm_mul_ps(_mm256_castps256_ps128(c0), _mm_permute_ps(v, _MM_SHUFFLE(0, 0, 0, 0)));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm256_castps256_ps128(c1), _mm_permute_ps(v, _MM_SHUFFLE(1, 1, 1, 1))));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm256_castps256_ps128(c2), _mm_permute_ps(v, _MM_SHUFFLE(2, 2, 2, 2))));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm256_castps256_ps128(c3), _mm_permute_ps(v, _MM_SHUFFLE(3, 3, 3, 3))));
+
+		_mm_storeu_ps(dst[i].d, r);
+	}
+}
+
+#pragma GCC pop_options
+
+/* The PLT is not initialized when ifunc resolvers run, so all external
+ * functions must be inlined with __attribute__((flatten)).
+ */
+__attribute__((flatten))
+static void (*resolve_matrix_transform_array(void))(const struct igt_mat4 *m,
+						    struct igt_vec4 *dst,
+						    const struct igt_vec4 *src,
+						    unsigned int num)
+{
+	unsigned int features = igt_x86_features();
+
+	if (features & AVX)
+		return matrix_transform_array_avx;
+
+	if (features & SSE4_1)
+		return matrix_transform_array_sse41;
+
+	return matrix_transform_array;
+}
+
+void igt_matrix_transform_array(const struct igt_mat4 *m,
+				struct igt_vec4 *dst,
+				const struct igt_vec4 *src,
+				unsigned int num)
+	__attribute__((ifunc("resolve_matrix_transform_array")));
+
+#elif defined(__aarch64__)
+
+#include <arm_neon.h>
+
+void igt_matrix_transform_array(const struct igt_mat4 *m,
+				struct igt_vec4 *dst,
+				const struct igt_vec4 *src,
+				unsigned int num)
+{
+	const float32x4_t c0 = vld1q_f32(&m->d[m(0, 0)]);
+	const float32x4_t c1 = vld1q_f32(&m->d[m(0, 1)]);
+	const float32x4_t c2 = vld1q_f32(&m->d[m(0, 2)]);
+	const float32x4_t c3 = vld1q_f32(&m->d[m(0, 3)]);
+
+	for (unsigned int i = 0; i < num; i++) {
+		float32x4_t v = vld1q_f32(src[i].d);
+		float32x4_t r;
+
+		/* avoid fused multiply-add to match the scalar results */
+		r = vmulq_laneq_f32(c0, v, 0);
+		r = vaddq_f32(r, vmulq_laneq_f32(c1, v, 1));
+		r = vaddq_f32(r, vmulq_laneq_f32(c2, v, 2));
+		r = vaddq_f32(r, vmulq_laneq_f32(c3, v, 3));
+
+		vst1q_f32(dst[i].d, r);
+	}
+}
+
+#else
+
+void igt_matrix_transform_array(const struct igt_mat4 *m,
+				struct igt_vec4 *dst,
+				const struct igt_vec4 *src,
+				unsigned int num)
+{
+	matrix_transform_array(m, dst, src, num);
+}
+
+#endif
@@ -94,4 +94,21 @@ igt_matrix_transform(const struct igt_mat4 *m,
 	return ret;
 }
 
+/**
+ * igt_matrix_transform_array:
+ * @m: The matrix
+ * @dst: The transformed vectors
+ * @src: The vectors to transform
+ * @num: Number of vectors
+ *
+ * Transform @num vectors from @src by the matrix @m and store the results
+ * in @dst. Equivalent to calling igt_matrix_transform() on each vector,
+ * but uses SIMD instructions where the CPU supports them. @dst and @src
+ * may be the same array.
+ */
+void igt_matrix_transform_array(const struct igt_mat4 *m,
+				struct igt_vec4 *dst,
+				const struct igt_vec4 *src,
+				unsigned int num);
+
 #endif /* __IGT_MATRIX_H__ */
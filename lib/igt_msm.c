@@ -30,12 +30,14 @@
 #include <sys/stat.h>
 #include <sys/ioctl.h>
 #include <fcntl.h>
+#include <unistd.h>
 
 #include "drmtest.h"
 #include "igt_aux.h"
 #include "igt_core.h"
 #include "igt_msm.h"
 #include "ioctl_wrappers.h"
+#include "sw_sync.h"
 
 /**
  * SECTION:igt_msm
@@ -299,6 +301,23 @@ __igt_msm_append_bo(struct msm_cmd *cmd, struct msm_bo *bo)
 	cmd->bos[cmd->nr_bos++] = bo;
 }
 
+/**
+ * igt_msm_cmd_reset:
+ * @cmd: the command stream object to reset
+ *
+ * Rewind a command stream object to its start and drop the BOs appended
+ * to it, so the cmdstream buffer can be reused for the next submit. The
+ * caller must make sure the previous submit of @cmd has completed.
+ */
+void
+igt_msm_cmd_reset(struct msm_cmd *cmd)
+{
+	cmd->cur = igt_msm_bo_map(cmd->cmdstream_bo);
+	cmd->nr_bos = 0;
+
+	__igt_msm_append_bo(cmd, cmd->cmdstream_bo);
+}
+
 /**
  * igt_msm_cmd_free:
  * @cmd: the command stream object to free
@@ -311,3 +330,133 @@ igt_msm_cmd_free(struct msm_cmd *cmd)
 	igt_msm_bo_free(cmd->cmdstream_bo);
 	free(cmd);
 }
+
+/**
+ * igt_msm_cmd_ring_new:
+ * @pipe: the submitqueue to submit cmdstream against
+ * @depth: the number of cmdstream buffers, that is the submits in flight
+ * @size: the size of each cmdstream buffer
+ *
+ * Allocate a ring of @depth reusable command stream objects. Each one is
+ * handed out again by igt_msm_cmd_ring_get() once its previous submit has
+ * completed, which bounds the number of submits in flight to @depth
+ * without allocating a new cmdstream BO per submit.
+ */
+struct msm_cmd_ring *
+igt_msm_cmd_ring_new(struct msm_pipe *pipe, unsigned int depth, size_t size)
+{
+	struct msm_cmd_ring *ring = calloc(1, sizeof(*ring));
+
+	igt_assert(depth);
+
+	ring->pipe = pipe;
+	ring->depth = depth;
+	ring->cmds = calloc(depth, sizeof(*ring->cmds));
+	ring->fences = malloc(depth * sizeof(*ring->fences));
+
+	for (unsigned i = 0; i < depth; i++) {
+		ring->cmds[i] = igt_msm_cmd_new(pipe, size);
+		ring->fences[i] = -1;
+	}
+
+	return ring;
+}
+
+/**
+ * igt_msm_cmd_ring_get:
+ * @ring: the ring to take a command stream object from
+ *
+ * Take the next command stream object of @ring, waiting for its previous
+ * submit to complete first if it is still in flight. The object is reset
+ * and ready to be built and passed to igt_msm_cmd_ring_submit().
+ */
+struct msm_cmd *
+igt_msm_cmd_ring_get(struct msm_cmd_ring *ring)
+{
+	unsigned idx = ring->next % ring->depth;
+	struct msm_cmd *cmd = ring->cmds[idx];
+
+	if (ring->fences[idx] >= 0) {
+		igt_assert_eq(sync_fence_wait(ring->fences[idx], -1), 0);
+		close(ring->fences[idx]);
+		ring->fences[idx] = -1;
+	}
+
+	igt_msm_cmd_reset(cmd);
+
+	return cmd;
+}
+
+/**
+ * igt_msm_cmd_ring_submit:
+ * @ring: the ring @cmd was taken from
+ * @cmd: the command stream object returned by igt_msm_cmd_ring_get()
+ *
+ * Submit @cmd and track its fence, the next igt_msm_cmd_ring_get() moves
+ * on to the following object of the ring without waiting on this one.
+ */
+void
+igt_msm_cmd_ring_submit(struct msm_cmd_ring *ring, struct msm_cmd *cmd)
+{
+	unsigned idx = ring->next % ring->depth;
+
+	igt_assert(ring->cmds[idx] == cmd);
+
+	ring->fences[idx] = igt_msm_cmd_submit(cmd);
+	ring->next++;
+}
+
+/**
+ * igt_msm_cmd_ring_wait:
+ * @ring: the ring to wait on
+ *
+ * Wait for all the submits of @ring in flight to complete. The fences are
+ * merged, so this takes a single wait however deep the ring is.
+ */
+void
+igt_msm_cmd_ring_wait(struct msm_cmd_ring *ring)
+{
+	int fence = -1;
+
+	for (unsigned i = 0; i < ring->depth; i++) {
+		if (ring->fences[i] < 0)
+			continue;
+
+		if (fence < 0) {
+			fence = ring->fences[i];
+		} else {
+			int merged = sync_fence_merge(fence, ring->fences[i]);
+
+			close(fence);
+			close(ring->fences[i]);
+			fence = merged;
+		}
+		ring->fences[i] = -1;
+	}
+
+	if (fence < 0)
+		return;
+
+	igt_assert_eq(sync_fence_wait(fence, -1), 0);
+	close(fence);
+}
+
+/**
+ * igt_msm_cmd_ring_free:
+ * @ring: the ring to free
+ *
+ * Wait for the submits of @ring in flight and free it along with its
+ * command stream objects.
+ */
+void
+igt_msm_cmd_ring_free(struct msm_cmd_ring *ring)
+{
+	igt_msm_cmd_ring_wait(ring);
+
+	for (unsigned i = 0; i < ring->depth; i++)
+		igt_msm_cmd_free(ring->cmds[i]);
+
+	free(ring->fences);
+	free(ring->cmds);
+	free(ring);
+}
@@ -166,8 +166,35 @@ struct msm_cmd {
 
 struct msm_cmd *igt_msm_cmd_new(struct msm_pipe *pipe, size_t size);
 int igt_msm_cmd_submit(struct msm_cmd *cmd);
+void igt_msm_cmd_reset(struct msm_cmd *cmd);
 void igt_msm_cmd_free(struct msm_cmd *cmd);
 
+/**
+ * msm_cmd_ring:
+ * @pipe: the submitqueue the command streams are submitted against
+ * @depth: the number of command streams, that is the submits in flight
+ * @next: the number of submits so far, the next slot modulo @depth
+ * @cmds: the reusable command stream objects
+ * @fences: the fence fd of the last submit of each slot, -1 if none
+ *
+ * Ring of reusable command stream objects, recycled once their previous
+ * submit has completed.
+ */
+struct msm_cmd_ring {
+	struct msm_pipe *pipe;
+	unsigned depth;
+	unsigned long next;
+	struct msm_cmd **cmds;
+	int *fences;
+};
+
+struct msm_cmd_ring *igt_msm_cmd_ring_new(struct msm_pipe *pipe,
+					  unsigned int depth, size_t size);
+struct msm_cmd *igt_msm_cmd_ring_get(struct msm_cmd_ring *ring);
+void igt_msm_cmd_ring_submit(struct msm_cmd_ring *ring, struct msm_cmd *cmd);
+void igt_msm_cmd_ring_wait(struct msm_cmd_ring *ring);
+void igt_msm_cmd_ring_free(struct msm_cmd_ring *ring);
+
 static inline void
 msm_cmd_emit(struct msm_cmd *cmd, uint32_t dword)
 {
@@ -0,0 +1,387 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2024 Intel Corporation
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "igt_openmetrics.h"
+
+/*
+ * A minimal OpenMetrics exporter for the monitoring tools.
+ *
+ * The tool renders its metrics into a text snapshot once per sampling period,
+ * between igt_openmetrics_begin() and igt_openmetrics_commit(), and then waits
+ * in igt_openmetrics_serve() instead of sleeping. Scrapes are answered from
+ * the last committed snapshot, so a scrape costs a single write and never
+ * triggers new sampling.
+ */
+
+struct buffer {
+	char *data;
+	size_t len;
+	size_t size;
+};
+
+struct igt_openmetrics {
+	int fd;
+	int port;
+	struct buffer build;
+	struct buffer published;
+};
+
+static void buffer_printf(struct buffer *b, const char *fmt, ...)
+	__attribute__((format(printf, 2, 3)));
+
+static void buffer_printf(struct buffer *b, const char *fmt, ...)
+{
+	va_list ap;
+	int len;
+
+	for (;;) {
+		va_start(ap, fmt);
+		len = vsnprintf(b->data + b->len, b->size - b->len, fmt, ap);
+		va_end(ap);
+		assert(len >= 0);
+
+		if (b->len + len < b->size)
+			break;
+
+		b->size = b->size ? 2 * b->size : 4096;
+		while (b->size <= b->len + len)
+			b->size *= 2;
+		b->data = realloc(b->data, b->size);
+		assert(b->data);
+	}
+
+	b->len += len;
+}
+
+static void buffer_label_value(struct buffer *b, const char *value)
+{
+	const char *s;
+
+	for (s = value; *s; s++) {
+		if (*s == '\\')
+			buffer_printf(b, "\\\\");
+		else if (*s == '"')
+			buffer_printf(b, "\\\"");
+		else if (*s == '\n')
+			buffer_printf(b, "\\n");
+		else
+			buffer_printf(b, "%c", *s);
+	}
+}
+
+/**
+ * igt_openmetrics_listen:
+ * @address: "[host:]port" to listen on
+ *
+ * Opens a TCP listener serving the metrics over HTTP at any path. Without a
+ * host all addresses are used, and port 0 picks any free port, see
+ * igt_openmetrics_port().
+ *
+ * Returns: The exporter, or NULL with errno set on failure.
+ */
+struct igt_openmetrics *igt_openmetrics_listen(const char *address)
+{
+	struct addrinfo hints = {
+		.ai_family = AF_UNSPEC,
+		.ai_socktype = SOCK_STREAM,
+		.ai_flags = AI_PASSIVE,
+	}, *res, *ai;
+	struct sockaddr_storage addr;
+	socklen_t addrlen = sizeof(addr);
+	struct igt_openmetrics *om;
+	char *host, *name, *port;
+	int fd = -1, ret;
+
+	host = strdup(address);
+	if (!host)
+		return NULL;
+
+	port = strrchr(host, ':');
+	if (port) {
+		*port++ = '\0';
+	} else {
+		port = host;
+		host = NULL;
+	}
+
+	/* [addr]:port for IPv6 */
+	name = host;
+	if (name && name[0] == '[' && name[strlen(name) - 1] == ']') {
+		name[strlen(name) - 1] = '\0';
+		name++;
+	}
+
+	ret = getaddrinfo(name && *name ? name : NULL, port, &hints, &res);
+	free(host ?: port);
+	if (ret) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	for (ai = res; ai; ai = ai->ai_next) {
+		int one = 1;
+
+		fd = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK |
+			    SOCK_CLOEXEC, ai->ai_protocol);
+		if (fd < 0)
+			continue;
+
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+		if (!bind(fd, ai->ai_addr, ai->ai_addrlen) && !listen(fd, 16))
+			break;
+
+		close(fd);
+		fd = -1;
+	}
+	freeaddrinfo(res);
+
+	if (fd < 0)
+		return NULL;
+
+	om = calloc(1, sizeof(*om));
+	assert(om);
+	om->fd = fd;
+
+	if (!getsockname(fd, (struct sockaddr *)&addr, &addrlen)) {
+		char serv[NI_MAXSERV];
+
+		if (!getnameinfo((struct sockaddr *)&addr, addrlen, NULL, 0,
+				 serv, sizeof(serv), NI_NUMERICSERV))
+			om->port = atoi(serv);
+	}
+
+	igt_openmetrics_begin(om);
+	igt_openmetrics_commit(om);
+
+	return om;
+}
+
+/**
+ * igt_openmetrics_port:
+ * @om: The exporter
+ *
+ * Returns: The TCP port the exporter listens on.
+ */
+int igt_openmetrics_port(const struct igt_openmetrics *om)
+{
+	return om->port;
+}
+
+/**
+ * igt_openmetrics_close:
+ * @om: The exporter
+ *
+ * Stops listening and frees the exporter.
+ */
+void igt_openmetrics_close(struct igt_openmetrics *om)
+{
+	if (!om)
+		return;
+
+	close(om->fd);
+	free(om->build.data);
+	free(om->published.data);
+	free(om);
+}
+
+/**
+ * igt_openmetrics_begin:
+ * @om: The exporter
+ *
+ * Starts rendering a new snapshot. Scrapes keep being answered with the
+ * previous one until igt_openmetrics_commit().
+ */
+void igt_openmetrics_begin(struct igt_openmetrics *om)
+{
+	om->build.len = 0;
+}
+
+/**
+ * igt_openmetrics_family:
+ * @om: The exporter
+ * @name: Metric family name
+ * @type: OpenMetrics type, such as "gauge" or "counter"
+ * @help: Description of the metric
+ *
+ * Starts a metric family. All its samples must follow before the next family.
+ */
+void igt_openmetrics_family(struct igt_openmetrics *om, const char *name,
+			    const char *type, const char *help)
+{
+	buffer_printf(&om->build, "# TYPE %s %s\n", name, type);
+	buffer_printf(&om->build, "# HELP %s %s\n", name, help);
+}
+
+/**
+ * igt_openmetrics_sample:
+ * @om: The exporter
+ * @name: Sample name, the family name for gauges
+ * @value: Sample value
+ * @...: NULL terminated list of label name and value string pairs
+ *
+ * Adds a sample to the current family. Label values are escaped as needed.
+ */
+void igt_openmetrics_sample(struct igt_openmetrics *om, const char *name,
+			    double value, ...)
+{
+	const char *label;
+	bool first = true;
+	va_list ap;
+
+	buffer_printf(&om->build, "%s", name);
+
+	va_start(ap, value);
+	while ((label = va_arg(ap, const char *))) {
+		const char *val = va_arg(ap, const char *);
+
+		buffer_printf(&om->build, "%s%s=\"", first ? "{" : ",", label);
+		buffer_label_value(&om->build, val ?: "");
+		buffer_printf(&om->build, "\"");
+		first = false;
+	}
+	va_end(ap);
+
+	buffer_printf(&om->build, "%s %.9g\n", first ? "" : "}", value);
+}
+
+/**
+ * igt_openmetrics_commit:
+ * @om: The exporter
+ *
+ * Publishes the snapshot rendered since igt_openmetrics_begin().
+ */
+void igt_openmetrics_commit(struct igt_openmetrics *om)
+{
+	struct buffer tmp;
+
+	buffer_printf(&om->build, "# EOF\n");
+
+	tmp = om->published;
+	om->published = om->build;
+	om->build = tmp;
+	om->build.len = 0;
+}
+
+static bool send_all(int fd, const char *data, size_t len)
+{
+	while (len) {
+		ssize_t ret = send(fd, data, len, MSG_NOSIGNAL);
+
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			return false;
+
+		data += ret;
+		len -= ret;
+	}
+
+	return true;
+}
+
+static void serve_client(struct igt_openmetrics *om, int fd)
+{
+	/* Don't let a stuck scraper stall the sampling loop */
+	struct timeval tv = { .tv_usec = 100000 };
+	char req[2048], hdr[256];
+	size_t len = 0;
+	int hlen;
+
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+	while (len < sizeof(req) - 1) {
+		ssize_t ret = recv(fd, req + len, sizeof(req) - 1 - len, 0);
+
+		if (ret <= 0)
+			break;
+
+		len += ret;
+		req[len] = '\0';
+		if (strstr(req, "\r\n\r\n"))
+			break;
+	}
+	req[len] = '\0';
+
+	if (strncmp(req, "GET ", 4) && strncmp(req, "HEAD ", 5)) {
+		hlen = snprintf(hdr, sizeof(hdr),
+				"HTTP/1.1 405 Method Not Allowed\r\n"
+				"Allow: GET, HEAD\r\n"
+				"Content-Length: 0\r\n"
+				"Connection: close\r\n\r\n");
+		send_all(fd, hdr, hlen);
+		return;
+	}
+
+	hlen = snprintf(hdr, sizeof(hdr),
+			"HTTP/1.1 200 OK\r\n"
+			"Content-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\n"
+			"Content-Length: %zu\r\n"
+			"Connection: close\r\n\r\n",
+			om->published.len);
+
+	if (send_all(fd, hdr, hlen) && req[0] == 'G')
+		send_all(fd, om->published.data, om->published.len);
+}
+
+static uint64_t now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * igt_openmetrics_serve:
+ * @om: The exporter
+ * @timeout_us: How long to serve for
+ *
+ * Answers scrapes with the last committed snapshot for @timeout_us, for use
+ * in place of sleeping between samples.
+ *
+ * Returns: False if interrupted by a signal before the timeout.
+ */
+bool igt_openmetrics_serve(struct igt_openmetrics *om, unsigned int timeout_us)
+{
+	uint64_t end = now_us() + timeout_us;
+
+	for (;;) {
+		struct pollfd p = { .fd = om->fd, .events = POLLIN };
+		uint64_t now = now_us();
+		int ret, fd;
+
+		if (now >= end)
+			return true;
+
+		ret = poll(&p, 1, (end - now + 999) / 1000);
+		if (ret < 0 && errno == EINTR)
+			return false;
+		if (ret <= 0)
+			continue;
+
+		fd = accept4(om->fd, NULL, NULL, SOCK_CLOEXEC);
+		if (fd < 0)
+			continue;
+
+		serve_client(om, fd);
+		close(fd);
+	}
+}
@@ -0,0 +1,27 @@
+/* SPDX-License-Identifier: MIT */
+/*
+ * Copyright © 2024 Intel Corporation
+ */
+
+#ifndef IGT_OPENMETRICS_H
+#define IGT_OPENMETRICS_H
+
+#include <stdbool.h>
+
+struct igt_openmetrics;
+
+struct igt_openmetrics *igt_openmetrics_listen(const char *address);
+int igt_openmetrics_port(const struct igt_openmetrics *om);
+void igt_openmetrics_close(struct igt_openmetrics *om);
+
+void igt_openmetrics_begin(struct igt_openmetrics *om);
+void igt_openmetrics_family(struct igt_openmetrics *om, const char *name,
+			    const char *type, const char *help);
+void igt_openmetrics_sample(struct igt_openmetrics *om, const char *name,
+			    double value, ...)
+	__attribute__((sentinel));
+void igt_openmetrics_commit(struct igt_openmetrics *om);
+
+bool igt_openmetrics_serve(struct igt_openmetrics *om, unsigned int timeout_us);
+
+#endif /* IGT_OPENMETRICS_H */
@@ -29,6 +29,7 @@
 #include "config.h"
 
 #include <inttypes.h>
+#include <limits.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -55,16 +56,126 @@
 #include "igt_os.h"
 #include "igt_sysfs.h"
 
+static uint64_t cgroup_memory_value(int dir, const char *attr)
+{
+	uint64_t value = UINT64_MAX;
+	char *str;
+
+	str = igt_sysfs_get(dir, attr);
+	if (str && strcmp(str, "max"))
+		value = strtoull(str, NULL, 10);
+	free(str);
+
+	return value;
+}
+
+/*
+ * The memory limit of the cgroup v2 hierarchy the process runs in, the
+ * lowest memory.high or memory.max up to the root. @used is the usage of
+ * the cgroup imposing the limit, without the page cache that can be
+ * reclaimed.
+ */
+static bool cgroup_memory_limit(uint64_t *limit, uint64_t *used)
+{
+	char path[PATH_MAX] = "/sys/fs/cgroup";
+	size_t rootlen = strlen(path);
+	char *line = NULL, *p;
+	size_t linelen = 0;
+	bool found = false;
+	FILE *f;
+
+	f = fopen("/proc/self/cgroup", "re");
+	if (!f)
+		return false;
+
+	while (getline(&line, &linelen, f) > 0) {
+		if (!strncmp(line, "0::", 3)) {
+			line[strcspn(line, "\n")] = '\0';
+			snprintf(path + rootlen, sizeof(path) - rootlen, "%s",
+				 strcmp(line + 3, "/") ? line + 3 : "");
+			found = true;
+			break;
+		}
+	}
+	free(line);
+	fclose(f);
+
+	if (!found)
+		return false;
+
+	*limit = UINT64_MAX;
+	*used = 0;
+
+	/* The root cgroup cannot be limited */
+	while (strlen(path) > rootlen) {
+		uint64_t value;
+		int dir;
+
+		dir = open(path, O_RDONLY | O_DIRECTORY);
+		if (dir < 0)
+			break;
+
+		value = min(cgroup_memory_value(dir, "memory.high"),
+			    cgroup_memory_value(dir, "memory.max"));
+		if (value < *limit) {
+			char *stat;
+
+			*limit = value;
+			*used = cgroup_memory_value(dir, "memory.current");
+			if (*used == UINT64_MAX)
+				*used = 0;
+
+			stat = igt_sysfs_get(dir, "memory.stat");
+			p = stat ? strstr(stat, "\nfile ") : NULL;
+			if (p)
+				*used -= min_t(uint64_t, *used,
+					       strtoull(p + 6, NULL, 10));
+			free(stat);
+		}
+		close(dir);
+
+		p = strrchr(path, '/');
+		*p = '\0';
+	}
+
+	return *limit != UINT64_MAX;
+}
+
+/**
+ * igt_get_memory_budget_mb:
+ *
+ * Tests running under a memory cgroup, such as the one the runner puts
+ * every test in with its --memory-budget option, get OOM-killed or
+ * throttled beyond the limit of the cgroup rather than when the system
+ * runs out of RAM. igt_get_total_ram_mb() and igt_get_avail_ram_mb() are
+ * capped to this budget, so that tests sizing their working set from them
+ * stay within it.
+ *
+ * Returns:
+ * The memory limit of the cgroup the process runs in, in MB, or 0 if there
+ * is none.
+ */
+uint64_t igt_get_memory_budget_mb(void)
+{
+	uint64_t limit, used;
+
+	if (!cgroup_memory_limit(&limit, &used))
+		return 0;
+
+	return limit / (1024*1024);
+}
+
 /**
  * igt_get_total_ram_mb:
  *
  * Returns:
- * The total amount of system RAM available in MB.
+ * The total amount of system RAM available in MB, capped to the memory
+ * budget of the cgroup, see igt_get_memory_budget_mb().
  */
 uint64_t
 igt_get_total_ram_mb(void)
 {
-	uint64_t retval;
+	uint64_t retval, limit, used;
 
 #ifdef HAVE_STRUCT_SYSINFO_TOTALRAM /* Linux */
 	struct sysinfo sysinf;
@@ -83,6 +194,9 @@ igt_get_total_ram_mb(void)
 #error "Unknown how to get RAM size for this OS"
 #endif
 
+	if (cgroup_memory_limit(&limit, &used))
+		retval = min(retval, limit);
+
 	return retval / (1024*1024);
 }
 
@@ -146,12 +260,13 @@ uint64_t igt_get_meminfo(const char *field)
  * igt_get_avail_ram_mb:
  *
  * Returns:
- * The amount of unused system RAM available in MB.
+ * The amount of unused system RAM available in MB, capped to what is left
+ * of the memory budget of the cgroup, see igt_get_memory_budget_mb().
  */
 uint64_t
 igt_get_avail_ram_mb(void)
 {
-	uint64_t retval;
+	uint64_t retval, limit, used;
 
 #ifdef HAVE_STRUCT_SYSINFO_TOTALRAM /* Linux */
 	char *info;
@@ -206,6 +321,9 @@ igt_get_avail_ram_mb(void)
 #error "Unknown how to get available RAM for this OS"
 #endif
 
+	if (cgroup_memory_limit(&limit, &used))
+		retval = min(retval, limit - min(limit, used));
+
 	return retval / (1024*1024);
 }
 
@@ -35,6 +35,7 @@ uint64_t igt_get_meminfo(const char *field);
 uint64_t igt_get_total_ram_mb(void);
 uint64_t igt_get_avail_ram_mb(void);
 uint64_t igt_get_total_swap_mb(void);
+uint64_t igt_get_memory_budget_mb(void);
 void *igt_get_total_pinnable_mem(size_t *pinned);
 
 int __igt_check_memory(uint64_t count, uint64_t size, unsigned mode,
@@ -36,6 +36,7 @@
 #include "igt_aux.h"
 #include "igt_core.h"
 #include "igt_panfrost.h"
+#include "igt_syncobj.h"
 #include "ioctl_wrappers.h"
 #include "intel_reg.h"
 #include "intel_chipset.h"
@@ -298,3 +299,142 @@ void igt_panfrost_free_job(int fd, struct panfrost_submit *submit)
         free(submit->args);
         free(submit);
 }
+
+/* Where the write value jobs of a ring write, after the job descriptor */
+#define JOB_RING_VALUE_OFFSET 64
+
+/**
+ * igt_panfrost_job_ring_new:
+ * @fd: device file descriptor
+ * @depth: number of jobs, that is the most jobs in flight
+ * @write_value: whether the jobs are WRITE_VALUE jobs rather than NULL jobs
+ *
+ * Allocates the BOs and out syncobjs of @depth jobs once, so submitting
+ * with igt_panfrost_job_ring_submit() only patches the job descriptor of
+ * the next job of the ring, instead of building a new job and its BOs.
+ * Each job has its own BO, so the jobs in flight don't wait on each other
+ * through implicit synchronization.
+ */
+struct panfrost_job_ring *
+igt_panfrost_job_ring_new(int fd, unsigned depth, bool write_value)
+{
+        struct panfrost_job_ring *ring = calloc(1, sizeof(*ring));
+
+        igt_assert(depth);
+
+        ring->fd = fd;
+        ring->depth = depth;
+        ring->write_value = write_value;
+        ring->bos = calloc(depth, sizeof(*ring->bos));
+        ring->syncobjs = calloc(depth, sizeof(*ring->syncobjs));
+
+        for (unsigned i = 0; i < depth; i++) {
+                ring->bos[i] = igt_panfrost_gem_new(fd, 4096);
+                igt_panfrost_bo_mmap(fd, ring->bos[i]);
+                ring->syncobjs[i] = syncobj_create(fd, DRM_SYNCOBJ_CREATE_SIGNALED);
+        }
+
+        ring->args.bo_handle_count = 1;
+
+        return ring;
+}
+
+/**
+ * igt_panfrost_job_ring_check:
+ * @ring: job ring
+ * @slot: job of the ring to check
+ *
+ * Asserts that the last submit of job @slot completed successfully, and
+ * wrote the value for WRITE_VALUE jobs. The job must be idle.
+ */
+void igt_panfrost_job_ring_check(struct panfrost_job_ring *ring, unsigned slot)
+{
+        struct mali_job_descriptor_header *header = ring->bos[slot]->map;
+
+        igt_assert(header->exception_status == 1 && header->fault_pointer == 0);
+        if (ring->write_value)
+                igt_assert_eq_u32(*(uint32_t *)(ring->bos[slot]->map +
+                                                JOB_RING_VALUE_OFFSET), 0);
+}
+
+/**
+ * igt_panfrost_job_ring_submit:
+ * @ring: job ring
+ *
+ * Submits the next job of @ring. If the job is still in flight from the
+ * previous round of the ring, waits for it and checks it completed first,
+ * which bounds the jobs in flight to the depth of the ring. The job
+ * descriptor is then rewritten, as the GPU updates its exception status.
+ *
+ * Returns the out syncobj of the submitted job.
+ */
+uint32_t igt_panfrost_job_ring_submit(struct panfrost_job_ring *ring)
+{
+        unsigned slot = ring->next % ring->depth;
+        struct panfrost_bo *bo = ring->bos[slot];
+        struct mali_job_descriptor_header header = {
+                .job_type = ring->write_value ? JOB_TYPE_SET_VALUE : JOB_TYPE_NULL,
+                .job_index = 1,
+                .job_descriptor_size = 1,
+        };
+        /* .unknow = 3 means write 0 at the address specified in .out */
+        struct mali_payload_set_value payload = {
+                .out = bo->offset + JOB_RING_VALUE_OFFSET,
+                .unknown = 3,
+        };
+        uint32_t handle = bo->handle;
+
+        if (ring->next >= ring->depth) {
+                igt_assert(syncobj_wait(ring->fd, &ring->syncobjs[slot], 1,
+                                        INT64_MAX, 0, NULL));
+                igt_panfrost_job_ring_check(ring, slot);
+        }
+
+        memcpy(bo->map, &header, sizeof(header));
+        if (ring->write_value) {
+                memcpy(bo->map + sizeof(header), &payload, sizeof(payload));
+                memset(bo->map + JOB_RING_VALUE_OFFSET, 0xff, sizeof(uint32_t));
+        }
+
+        ring->args.jc = bo->offset;
+        ring->args.bo_handles = to_user_pointer(&handle);
+        ring->args.out_sync = ring->syncobjs[slot];
+        do_ioctl(ring->fd, DRM_IOCTL_PANFROST_SUBMIT, &ring->args);
+
+        ring->next++;
+
+        return ring->args.out_sync;
+}
+
+/**
+ * igt_panfrost_job_ring_wait:
+ * @ring: job ring
+ *
+ * Waits for all the jobs of @ring in flight with a single syncobj wait.
+ */
+void igt_panfrost_job_ring_wait(struct panfrost_job_ring *ring)
+{
+        igt_assert(syncobj_wait(ring->fd, ring->syncobjs, ring->depth,
+                                INT64_MAX, DRM_SYNCOBJ_WAIT_FLAGS_WAIT_ALL,
+                                NULL));
+}
+
+/**
+ * igt_panfrost_job_ring_free:
+ * @ring: job ring
+ *
+ * Waits for the jobs of @ring in flight and frees it.
+ */
+void igt_panfrost_job_ring_free(struct panfrost_job_ring *ring)
+{
+        igt_panfrost_job_ring_wait(ring);
+
+        for (unsigned i = 0; i < ring->depth; i++) {
+                syncobj_destroy(ring->fd, ring->syncobjs[i]);
+                igt_panfrost_free_bo(ring->fd, ring->bos[i]);
+        }
+
+        free(ring->syncobjs);
+        free(ring->bos);
+        free(ring);
+}
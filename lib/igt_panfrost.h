@@ -48,6 +48,20 @@ struct panfrost_submit {
 	struct panfrost_bo *fbo;
 };
 
+/*
+ * Ring of reusable jobs, each with its own BO and out syncobj, patched and
+ * resubmitted once its previous submit has completed.
+ */
+struct panfrost_job_ring {
+        int fd;
+        bool write_value;
+        unsigned depth;
+        unsigned long next;
+        struct panfrost_bo **bos;
+        uint32_t *syncobjs;
+        struct drm_panfrost_submit args;
+};
+
 struct panfrost_bo *igt_panfrost_gem_new(int fd, size_t size);
 void igt_panfrost_free_bo(int fd, struct panfrost_bo *bo);
 
@@ -59,6 +73,13 @@ struct panfrost_submit *igt_panfrost_null_job(int fd);
 struct panfrost_submit *igt_panfrost_write_value_job(int fd, bool trigger_page_fault);
 void igt_panfrost_free_job(int fd, struct panfrost_submit *submit);
 
+struct panfrost_job_ring *igt_panfrost_job_ring_new(int fd, unsigned depth,
+                                                    bool write_value);
+uint32_t igt_panfrost_job_ring_submit(struct panfrost_job_ring *ring);
+void igt_panfrost_job_ring_check(struct panfrost_job_ring *ring, unsigned slot);
+void igt_panfrost_job_ring_wait(struct panfrost_job_ring *ring);
+void igt_panfrost_job_ring_free(struct panfrost_job_ring *ring);
+
 /* IOCTL wrappers */
 uint32_t igt_panfrost_get_bo_offset(int fd, uint32_t handle);
 uint32_t igt_panfrost_get_param(int fd, int param);
@@ -4,8 +4,10 @@
  */
 
 #include <inttypes.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/mount.h>
+#include <sys/utsname.h>
 #ifdef __linux__
 #include <sys/sysmacros.h>
 #endif
@@ -18,12 +20,17 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <poll.h>
+#include <pthread.h>
+#include <time.h>
 
 #include "drmtest.h"
+#include "igt_arena.h"
 #include "igt_aux.h"
 #include "igt_kms.h"
 #include "igt_debugfs.h"
 #include "igt_pipe_crc.h"
+#include "igt_sysfs.h"
+#include "igt_x86.h"
 
 /**
  * SECTION:igt_pipe_crc
@@ -179,9 +186,50 @@ char *igt_crc_to_string(igt_crc_t *crc)
 	return igt_crc_to_string_extended(crc, ' ', 4);
 }
 
+/**
+ * igt_crc_to_arena_string:
+ * @crc: pipe CRC value to print
+ *
+ * Like igt_crc_to_string() but the string is allocated from the subtest
+ * arena and released automatically when the subtest exits, so it can be
+ * passed directly to the logging functions.
+ *
+ * This should only ever be used for diagnostic debug output.
+ */
+const char *igt_crc_to_arena_string(igt_crc_t *crc)
+{
+	char *buf = igt_arena_alloc(9 * crc->n_words);
+	int i, len = 0;
+
+	for (i = 0; i < crc->n_words - 1; i++)
+		len += sprintf(buf + len, "%08x ", crc->crc[i]);
+
+	sprintf(buf + len, "%08x", crc->crc[i]);
+
+	return buf;
+}
+
 #define MAX_CRC_ENTRIES 10
 #define MAX_LINE_LEN (10 + 11 * MAX_CRC_ENTRIES + 1)
 
+struct crc_capture {
+	pthread_t thread;
+	bool threaded;
+	bool stop;
+	int error;
+
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+
+	/* ring of size entries, head and tail only ever increase */
+	unsigned int size;
+	uint64_t head;
+	uint64_t tail;
+	unsigned long dropped;
+	igt_crc_t *crcs;
+	uint64_t *timestamps;
+};
+
 struct _igt_pipe_crc {
 	int fd;
 	int dir;
@@ -191,6 +239,8 @@ struct _igt_pipe_crc {
 
 	enum pipe pipe;
 	char *source;
+
+	struct crc_capture *capture;
 };
 
 /**
@@ -299,6 +349,7 @@ void igt_pipe_crc_free(igt_pipe_crc_t *pipe_crc)
 	if (!pipe_crc)
 		return;
 
+	igt_pipe_crc_stop_capture(pipe_crc);
 	close(pipe_crc->ctl_fd);
 	close(pipe_crc->crc_fd);
 	close(pipe_crc->dir);
@@ -306,28 +357,76 @@ void igt_pipe_crc_free(igt_pipe_crc_t *pipe_crc)
 	free(pipe_crc);
 }
 
-static bool pipe_crc_init_from_string(igt_pipe_crc_t *pipe_crc, igt_crc_t *crc,
-				      const char *line)
+/*
+ * Hand-rolled parsing of the CRC lines, "0x%08x" for the frame (or
+ * "XXXXXXXXXX" if there's no frame counter) followed by " 0x%08x" per CRC
+ * word, as strtoul() shows up when reading lines at high refresh rates.
+ */
+static const char *parse_hex(const char *buf, const char *end, uint32_t *out)
 {
-	int i;
+	uint32_t val = 0;
+	const char *start;
+
+	while (buf < end && *buf == ' ')
+		buf++;
+
+	if (end - buf >= 2 && buf[0] == '0' && (buf[1] == 'x' || buf[1] == 'X'))
+		buf += 2;
+
+	for (start = buf; buf < end; buf++) {
+		char c = *buf;
+
+		if (c >= '0' && c <= '9')
+			val = val << 4 | (c - '0');
+		else if (c >= 'a' && c <= 'f')
+			val = val << 4 | (c - 'a' + 10);
+		else if (c >= 'A' && c <= 'F')
+			val = val << 4 | (c - 'A' + 10);
+		else
+			break;
+	}
+
+	*out = val;
+
+	return buf == start ? NULL : buf;
+}
+
+static bool crc_parse_line(igt_crc_t *crc, const char *line, size_t len)
+{
+	const char *end = line + len;
 	const char *buf;
+	int i;
 
-	if (strncmp(line, "XXXXXXXXXX", 10) == 0)
+	if (len < 10)
+		return false;
+
+	if (strncmp(line, "XXXXXXXXXX", 10) == 0) {
 		crc->has_valid_frame = false;
-	else {
+		crc->frame = 0;
+	} else {
 		crc->has_valid_frame = true;
-		crc->frame = strtoul(line, NULL, 16);
+		if (!parse_hex(line, line + 10, &crc->frame))
+			return false;
 	}
 
 	buf = line + 10;
-	for (i = 0; *buf != '\n'; i++, buf += 11)
-		crc->crc[i] = strtoul(buf, NULL, 16);
+	for (i = 0; i < DRM_MAX_CRC_NR && buf < end && *buf != '\n'; i++) {
+		buf = parse_hex(buf, end, &crc->crc[i]);
+		if (!buf)
+			return false;
+	}
 
 	crc->n_words = i;
 
 	return true;
 }
 
+static bool pipe_crc_init_from_string(igt_pipe_crc_t *pipe_crc, igt_crc_t *crc,
+				      const char *line)
+{
+	return crc_parse_line(crc, line, strlen(line));
+}
+
 static int read_crc(igt_pipe_crc_t *pipe_crc, igt_crc_t *out)
 {
 	ssize_t bytes_read;
@@ -403,6 +502,7 @@ void igt_pipe_crc_start(igt_pipe_crc_t *pipe_crc)
  */
 void igt_pipe_crc_stop(igt_pipe_crc_t *pipe_crc)
 {
+	igt_pipe_crc_stop_capture(pipe_crc);
 	close(pipe_crc->crc_fd);
 	pipe_crc->crc_fd = -1;
 }
@@ -592,3 +692,1082 @@ void igt_pipe_crc_collect_crc(igt_pipe_crc_t *pipe_crc, igt_crc_t *out_crc)
 	igt_pipe_crc_get_single(pipe_crc, out_crc);
 	igt_pipe_crc_stop(pipe_crc);
 }
+
+/*
+ * Reference CRC cache, see igt_pipe_crc_collect_reference(). Entries are
+ * appended to the file as "<key> <n_words> <crc words...>" lines, the last
+ * line of a key wins.
+ */
+#define REF_CRC_CACHE_MAGIC "igt-ref-crc-cache 1"
+#define REF_CRC_VERIFY_DEFAULT 8
+#define FNV1A_64_OFFSET 0xcbf29ce484222325ull
+#define FNV1A_64_PRIME 0x100000001b3ull
+
+struct ref_crc_entry {
+	uint64_t key;
+	igt_crc_t crc;
+};
+
+static struct {
+	bool init;
+	const char *path;
+	unsigned int verify;
+	uint64_t rng;
+	struct ref_crc_entry *entries;
+	unsigned int count, size;
+} ref_crc_cache;
+
+static void ref_crc_hash(uint64_t *hash, const void *data, size_t len)
+{
+	const uint8_t *p = data;
+
+	while (len--) {
+		*hash ^= *p++;
+		*hash *= FNV1A_64_PRIME;
+	}
+}
+
+static void ref_crc_hash_u64(uint64_t *hash, uint64_t value)
+{
+	ref_crc_hash(hash, &value, sizeof(value));
+}
+
+static void ref_crc_hash_str(uint64_t *hash, const char *str)
+{
+	ref_crc_hash(hash, str, strlen(str) + 1);
+}
+
+static struct ref_crc_entry *ref_crc_cache_add(uint64_t key)
+{
+	struct ref_crc_entry *e;
+
+	if (ref_crc_cache.count == ref_crc_cache.size) {
+		ref_crc_cache.size = max(2 * ref_crc_cache.size, 64u);
+		ref_crc_cache.entries = realloc(ref_crc_cache.entries,
+						ref_crc_cache.size *
+						sizeof(*ref_crc_cache.entries));
+		igt_assert(ref_crc_cache.entries);
+	}
+
+	e = &ref_crc_cache.entries[ref_crc_cache.count++];
+	memset(e, 0, sizeof(*e));
+	e->key = key;
+
+	return e;
+}
+
+static struct ref_crc_entry *ref_crc_cache_lookup(uint64_t key)
+{
+	for (unsigned int i = ref_crc_cache.count; i--; )
+		if (ref_crc_cache.entries[i].key == key)
+			return &ref_crc_cache.entries[i];
+
+	return NULL;
+}
+
+static void ref_crc_cache_load(const char *path)
+{
+	char *line = NULL;
+	size_t size = 0;
+	FILE *f;
+
+	f = fopen(path, "re");
+	if (!f)
+		return;
+
+	if (getline(&line, &size, f) <= 0 ||
+	    strncmp(line, REF_CRC_CACHE_MAGIC "\n",
+		    strlen(REF_CRC_CACHE_MAGIC) + 1))
+		goto out;
+
+	while (getline(&line, &size, f) > 0) {
+		struct ref_crc_entry *e;
+		char *str = line, *end;
+		uint64_t key;
+		int n_words;
+
+		key = strtoull(str, &end, 16);
+		if (end == str)
+			continue;
+		n_words = strtol(end, &str, 10);
+		if (str == end || n_words < 1 || n_words > DRM_MAX_CRC_NR)
+			continue;
+
+		e = ref_crc_cache_add(key);
+		for (e->crc.n_words = 0; e->crc.n_words < n_words; e->crc.n_words++) {
+			e->crc.crc[e->crc.n_words] = strtoul(str, &end, 16);
+			if (end == str)
+				break;
+			str = end;
+		}
+		if (e->crc.n_words != n_words)
+			ref_crc_cache.count--;
+	}
+
+out:
+	free(line);
+	fclose(f);
+}
+
+static void ref_crc_cache_init(void)
+{
+	struct timespec ts;
+	const char *env;
+
+	if (ref_crc_cache.init)
+		return;
+
+	ref_crc_cache.init = true;
+	ref_crc_cache.path = getenv("IGT_REF_CRC_CACHE");
+	if (!ref_crc_cache.path || !*ref_crc_cache.path) {
+		ref_crc_cache.path = NULL;
+		return;
+	}
+
+	ref_crc_cache.verify = REF_CRC_VERIFY_DEFAULT;
+	env = getenv("IGT_REF_CRC_CACHE_VERIFY");
+	if (env)
+		ref_crc_cache.verify = max(atoi(env), 0);
+
+	/* Not the igt seed, so each run verifies different entries */
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	ref_crc_cache.rng = ((uint64_t)ts.tv_sec << 32 ^ ts.tv_nsec ^ getpid()) | 1;
+
+	ref_crc_cache_load(ref_crc_cache.path);
+}
+
+/* Whether to recollect a cached reference CRC to check it is still valid */
+static bool ref_crc_cache_sample(void)
+{
+	uint64_t x = ref_crc_cache.rng;
+
+	if (!ref_crc_cache.verify)
+		return false;
+
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	ref_crc_cache.rng = x;
+
+	return x % ref_crc_cache.verify == 0;
+}
+
+static void ref_crc_cache_store(uint64_t key, const igt_crc_t *crc)
+{
+	struct ref_crc_entry *e = ref_crc_cache_add(key);
+	char buf[32 + 9 * DRM_MAX_CRC_NR];
+	int fd, len;
+
+	e->crc.n_words = crc->n_words;
+	memcpy(e->crc.crc, crc->crc, sizeof(crc->crc));
+
+	fd = open(ref_crc_cache.path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC,
+		  0644);
+	if (fd < 0)
+		return;
+
+	if (lseek(fd, 0, SEEK_END) == 0)
+		igt_ignore_warn(write(fd, REF_CRC_CACHE_MAGIC "\n",
+				      strlen(REF_CRC_CACHE_MAGIC) + 1));
+
+	/* A single write, so that concurrent tests don't interleave lines */
+	len = snprintf(buf, sizeof(buf), "%016" PRIx64 " %d", key,
+		       crc->n_words);
+	for (int i = 0; i < crc->n_words; i++)
+		len += snprintf(buf + len, sizeof(buf) - len, " %08x",
+				crc->crc[i]);
+	len += snprintf(buf + len, sizeof(buf) - len, "\n");
+	igt_ignore_warn(write(fd, buf, len));
+
+	close(fd);
+}
+
+/* Driver, kernel and display firmware versions */
+static void ref_crc_hash_device(int fd, uint64_t *hash)
+{
+	static const char * const firmware[] = {
+		"i915_dmc_info",
+		"amdgpu_firmware_info",
+	};
+	drmVersionPtr version;
+	struct utsname uts;
+	int dir;
+
+	if (!uname(&uts)) {
+		ref_crc_hash_str(hash, uts.release);
+		ref_crc_hash_str(hash, uts.version);
+	}
+
+	version = drmGetVersion(fd);
+	if (version) {
+		ref_crc_hash_str(hash, version->name);
+		ref_crc_hash_str(hash, version->date);
+		ref_crc_hash_u64(hash, version->version_major);
+		ref_crc_hash_u64(hash, version->version_minor);
+		ref_crc_hash_u64(hash, version->version_patchlevel);
+		drmFreeVersion(version);
+	}
+
+	dir = igt_debugfs_dir(fd);
+	if (dir < 0)
+		return;
+
+	for (int i = 0; i < ARRAY_SIZE(firmware); i++) {
+		char *info = igt_sysfs_get(dir, firmware[i]);
+		char *line, *save;
+
+		if (!info)
+			continue;
+
+		/* Skip the counters, only the firmware paths and versions */
+		for (line = strtok_r(info, "\n", &save); line;
+		     line = strtok_r(NULL, "\n", &save))
+			if (strstr(line, "version") || strstr(line, "path"))
+				ref_crc_hash_str(hash, line);
+		free(info);
+	}
+	close(dir);
+}
+
+static bool ref_crc_hash_blob(int fd, uint64_t blob_id, uint64_t *hash)
+{
+	drmModePropertyBlobPtr blob;
+
+	if (!blob_id) {
+		ref_crc_hash_u64(hash, 0);
+		return true;
+	}
+
+	blob = drmModeGetPropertyBlob(fd, blob_id);
+	if (!blob)
+		return false;
+
+	ref_crc_hash_u64(hash, blob->length);
+	ref_crc_hash(hash, blob->data, blob->length);
+	drmModeFreePropertyBlob(blob);
+
+	return true;
+}
+
+static bool ref_crc_hash_bo(int fd, uint32_t handle, uint64_t *hash)
+{
+	uint64_t chunk[8192];
+	uint64_t h = *hash;
+	const char *ptr;
+	off_t size;
+	int dmabuf;
+
+	if (drmPrimeHandleToFD(fd, handle, DRM_CLOEXEC, &dmabuf))
+		return false;
+
+	size = lseek(dmabuf, 0, SEEK_END);
+	ptr = size > 0 ? mmap(NULL, size, PROT_READ, MAP_SHARED, dmabuf, 0) :
+			 MAP_FAILED;
+	if (ptr == MAP_FAILED) {
+		close(dmabuf);
+		return false;
+	}
+
+	prime_sync_start(dmabuf, false);
+	for (off_t offset = 0; offset < size; offset += sizeof(chunk)) {
+		size_t len = min_t(off_t, size - offset, sizeof(chunk));
+
+		/* Framebuffers are often write-combined, read in bulk */
+		igt_memcpy_from_wc(chunk, ptr + offset, len);
+		for (size_t i = 0; i < len / sizeof(*chunk); i++) {
+			h ^= chunk[i];
+			h *= FNV1A_64_PRIME;
+		}
+		ref_crc_hash(&h, (char *)chunk + (len & ~7), len & 7);
+	}
+	prime_sync_end(dmabuf, false);
+
+	munmap((void *)ptr, size);
+	close(dmabuf);
+	*hash = h;
+
+	return true;
+}
+
+static bool ref_crc_hash_fb(int fd, uint32_t fb_id, uint64_t *hash)
+{
+	drmModeFB2Ptr fb;
+	bool ret = true;
+	int i;
+
+	fb = drmModeGetFB2(fd, fb_id);
+	if (!fb)
+		return false;
+
+	/* The compression metadata may not be visible through the mapping */
+	if (fb->flags & DRM_MODE_FB_MODIFIERS &&
+	    igt_fb_is_ccs_modifier(fb->modifier))
+		ret = false;
+
+	ref_crc_hash_u64(hash, fb->width);
+	ref_crc_hash_u64(hash, fb->height);
+	ref_crc_hash_u64(hash, fb->pixel_format);
+	ref_crc_hash_u64(hash, fb->flags & DRM_MODE_FB_MODIFIERS ?
+			 fb->modifier : DRM_FORMAT_MOD_INVALID);
+	for (i = 0; i < 4; i++) {
+		ref_crc_hash_u64(hash, fb->pitches[i]);
+		ref_crc_hash_u64(hash, fb->offsets[i]);
+	}
+
+	for (i = 0; i < 4; i++) {
+		bool seen = false;
+
+		for (int j = 0; j < i; j++)
+			seen |= fb->handles[j] == fb->handles[i];
+		if (!fb->handles[i] || seen)
+			continue;
+
+		if (ret)
+			ret = ref_crc_hash_bo(fd, fb->handles[i], hash);
+		gem_close(fd, fb->handles[i]);
+	}
+
+	/* Without CAP_SYS_ADMIN no handles are returned */
+	if (!fb->handles[0])
+		ret = false;
+
+	drmModeFreeFB2(fb);
+
+	return ret;
+}
+
+/*
+ * Hashes everything the reference CRC depends on: the device, the output,
+ * its mode and properties, the colour management of the pipe and the
+ * contents and properties of the planes scanned out.
+ */
+static bool ref_crc_key(igt_pipe_crc_t *pipe_crc, igt_display_t *display,
+			uint64_t *key)
+{
+	static const enum igt_atomic_connector_properties connector_props[] = {
+		IGT_CONNECTOR_SCALING_MODE,
+		IGT_CONNECTOR_BROADCAST_RGB,
+		IGT_CONNECTOR_MAX_BPC,
+		IGT_CONNECTOR_DITHERING_MODE,
+	};
+	static const enum igt_atomic_crtc_properties crtc_blobs[] = {
+		IGT_CRTC_CTM,
+		IGT_CRTC_GAMMA_LUT,
+		IGT_CRTC_DEGAMMA_LUT,
+	};
+	static const enum igt_atomic_crtc_properties crtc_props[] = {
+		IGT_CRTC_VRR_ENABLED,
+		IGT_CRTC_SCALING_FILTER,
+	};
+	static const enum igt_atomic_plane_properties plane_props[] = {
+		IGT_PLANE_SRC_X, IGT_PLANE_SRC_Y, IGT_PLANE_SRC_W, IGT_PLANE_SRC_H,
+		IGT_PLANE_CRTC_X, IGT_PLANE_CRTC_Y, IGT_PLANE_CRTC_W, IGT_PLANE_CRTC_H,
+		IGT_PLANE_ROTATION,
+		IGT_PLANE_COLOR_ENCODING,
+		IGT_PLANE_COLOR_RANGE,
+		IGT_PLANE_PIXEL_BLEND_MODE,
+		IGT_PLANE_ALPHA,
+		IGT_PLANE_ZPOS,
+		IGT_PLANE_SCALING_FILTER,
+	};
+	igt_output_t *output = NULL, *o;
+	igt_plane_t *plane;
+	drmModeModeInfo *mode;
+	igt_pipe_t *pipe;
+	uint64_t hash = FNV1A_64_OFFSET;
+	int fd = display->drm_fd;
+
+	if (pipe_crc->pipe < 0 || pipe_crc->pipe >= display->n_pipes)
+		return false;
+	pipe = &display->pipes[pipe_crc->pipe];
+
+	for_each_connected_output(display, o) {
+		if (o->pending_pipe != pipe->pipe)
+			continue;
+		if (output)
+			return false; /* cloned */
+		output = o;
+	}
+	if (!output)
+		return false;
+
+	ref_crc_hash_device(fd, &hash);
+	ref_crc_hash_str(&hash, pipe_crc->source);
+	ref_crc_hash_u64(&hash, pipe->pipe);
+
+	ref_crc_hash_str(&hash, output->name);
+	mode = igt_output_get_mode(output);
+	ref_crc_hash(&hash, mode, offsetof(drmModeModeInfo, type));
+	for (int i = 0; i < ARRAY_SIZE(connector_props); i++)
+		if (igt_output_has_prop(output, connector_props[i]))
+			ref_crc_hash_u64(&hash, output->values[connector_props[i]]);
+	if (igt_output_has_prop(output, IGT_CONNECTOR_HDR_OUTPUT_METADATA) &&
+	    !ref_crc_hash_blob(fd, output->values[IGT_CONNECTOR_HDR_OUTPUT_METADATA],
+			       &hash))
+		return false;
+
+	for (int i = 0; i < ARRAY_SIZE(crtc_blobs); i++)
+		if (igt_pipe_obj_has_prop(pipe, crtc_blobs[i]) &&
+		    !ref_crc_hash_blob(fd, pipe->values[crtc_blobs[i]], &hash))
+			return false;
+	for (int i = 0; i < ARRAY_SIZE(crtc_props); i++)
+		if (igt_pipe_obj_has_prop(pipe, crtc_props[i]))
+			ref_crc_hash_u64(&hash, pipe->values[crtc_props[i]]);
+
+	for_each_plane_on_pipe(display, pipe->pipe, plane) {
+		uint32_t fb_id = plane->values[IGT_PLANE_FB_ID];
+
+		if (!fb_id)
+			continue;
+
+		ref_crc_hash_u64(&hash, plane->index);
+		for (int i = 0; i < ARRAY_SIZE(plane_props); i++)
+			ref_crc_hash_u64(&hash, plane->values[plane_props[i]]);
+		if (!ref_crc_hash_fb(fd, fb_id, &hash))
+			return false;
+	}
+
+	*key = hash;
+
+	return true;
+}
+
+/**
+ * igt_pipe_crc_collect_reference:
+ * @pipe_crc: pipe CRC object
+ * @display: the display, as committed for the reference
+ * @out_crc: buffer for the captured CRC values
+ *
+ * Like igt_pipe_crc_collect_crc(), for the reference CRC a test compares
+ * its results against. The same reference is displayed over and over by
+ * many subtests and test binaries, so with the IGT_REF_CRC_CACHE
+ * environment variable set to a file, the CRCs are kept there and reused
+ * without waiting for any vblank.
+ *
+ * The cache key covers the kernel, driver and display firmware versions,
+ * the output and its mode, the colour management of the pipe and the
+ * contents and properties of all the planes enabled on it. Configurations
+ * it can't fully describe, like compressed framebuffers or cloned outputs,
+ * are always collected.
+ *
+ * One in IGT_REF_CRC_CACHE_VERIFY (8 by default, 0 to never) cached CRCs
+ * is collected again anyway, a stale entry is then replaced and reported.
+ */
+void igt_pipe_crc_collect_reference(igt_pipe_crc_t *pipe_crc,
+				    struct igt_display *display,
+				    igt_crc_t *out_crc)
+{
+	struct ref_crc_entry *e;
+	uint64_t key;
+
+	ref_crc_cache_init();
+	if (!ref_crc_cache.path || !ref_crc_key(pipe_crc, display, &key)) {
+		igt_pipe_crc_collect_crc(pipe_crc, out_crc);
+		return;
+	}
+
+	e = ref_crc_cache_lookup(key);
+	if (e && !ref_crc_cache_sample()) {
+		igt_debug_wait_for_keypress("crc");
+
+		memset(out_crc, 0, sizeof(*out_crc));
+		out_crc->n_words = e->crc.n_words;
+		memcpy(out_crc->crc, e->crc.crc, sizeof(out_crc->crc));
+		igt_debug("Cached reference CRC %s for %016" PRIx64 "\n",
+			  igt_crc_to_arena_string(out_crc), key);
+		return;
+	}
+
+	igt_pipe_crc_collect_crc(pipe_crc, out_crc);
+
+	if (e) {
+		if (!igt_find_crc_mismatch(&e->crc, out_crc, NULL))
+			return;
+
+		igt_info("Stale reference CRC %s for %016" PRIx64 ", now %s\n",
+			 igt_crc_to_arena_string(&e->crc), key,
+			 igt_crc_to_arena_string(out_crc));
+	}
+
+	ref_crc_cache_store(key, out_crc);
+}
+
+/*
+ * The kernel hands out a single CRC line per read(), so the capture reads
+ * in a loop until the fd would block, stamping each CRC as it arrives.
+ * Returns the number of CRCs read, or a negative error code.
+ */
+static int capture_pump(igt_pipe_crc_t *pipe_crc)
+{
+	struct crc_capture *capture = pipe_crc->capture;
+	char buf[MAX_LINE_LEN + 1];
+	int n = 0;
+
+	for (;;) {
+		struct timespec ts;
+		igt_crc_t crc;
+		ssize_t len;
+
+		len = read(pipe_crc->crc_fd, buf, MAX_LINE_LEN);
+		if (len < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN)
+				return n;
+			return -errno;
+		}
+
+		if (len == 0)
+			return n;
+
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+
+		if (!crc_parse_line(&crc, buf, len))
+			continue;
+
+		pthread_mutex_lock(&capture->lock);
+		capture->crcs[capture->head % capture->size] = crc;
+		capture->timestamps[capture->head % capture->size] =
+			ts.tv_sec * 1000000000ull + ts.tv_nsec;
+		capture->head++;
+		if (capture->head - capture->tail > capture->size) {
+			capture->tail = capture->head - capture->size;
+			capture->dropped++;
+		}
+		pthread_cond_broadcast(&capture->cond);
+		pthread_mutex_unlock(&capture->lock);
+
+		n++;
+	}
+}
+
+static void capture_init(igt_pipe_crc_t *pipe_crc, unsigned int ring_size,
+			 bool threaded);
+
+static void *capture_thread(void *arg)
+{
+	igt_pipe_crc_t *pipe_crc = arg;
+	struct crc_capture *capture = pipe_crc->capture;
+	struct pollfd pfd = {
+		.fd = pipe_crc->crc_fd,
+		.events = POLLIN,
+	};
+
+	while (!READ_ONCE(capture->stop)) {
+		int ret;
+
+		/* Wake up regularly to notice being stopped */
+		if (poll(&pfd, 1, 100) <= 0)
+			continue;
+
+		ret = capture_pump(pipe_crc);
+		if (ret < 0) {
+			pthread_mutex_lock(&capture->lock);
+			capture->error = ret;
+			pthread_cond_broadcast(&capture->cond);
+			pthread_mutex_unlock(&capture->lock);
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * igt_pipe_crc_start_capture:
+ * @pipe_crc: pipe CRC object
+ * @ring_size: number of CRCs to keep around
+ * @threaded: whether to read CRCs from a background thread
+ *
+ * Starts the CRC capture process on @pipe_crc like igt_pipe_crc_start(), but
+ * collects the CRCs into a ring of @ring_size entries, along with their
+ * CLOCK_MONOTONIC arrival time. Once the ring is full, the oldest CRCs are
+ * overwritten, see igt_pipe_crc_capture_dropped().
+ *
+ * With @threaded, a background thread reads the CRCs as soon as they are
+ * available, so none are lost by the kernel when the test is busy for a few
+ * frames. Otherwise the CRCs are read when calling
+ * igt_pipe_crc_capture_get() or igt_pipe_crc_capture_wait_frame().
+ *
+ * Stop with igt_pipe_crc_stop_capture() or igt_pipe_crc_stop().
+ */
+void igt_pipe_crc_start_capture(igt_pipe_crc_t *pipe_crc,
+				unsigned int ring_size, bool threaded)
+{
+	igt_pipe_crc_start(pipe_crc);
+	capture_init(pipe_crc, ring_size, threaded);
+}
+
+static void capture_init(igt_pipe_crc_t *pipe_crc, unsigned int ring_size,
+			 bool threaded)
+{
+	struct crc_capture *capture;
+	pthread_condattr_t attr;
+
+	igt_assert(ring_size);
+
+	fcntl(pipe_crc->crc_fd, F_SETFL, pipe_crc->flags | O_NONBLOCK);
+
+	capture = calloc(1, sizeof(*capture));
+	igt_assert(capture);
+
+	capture->size = ring_size;
+	capture->crcs = calloc(ring_size, sizeof(*capture->crcs));
+	capture->timestamps = calloc(ring_size, sizeof(*capture->timestamps));
+	igt_assert(capture->crcs && capture->timestamps);
+	pthread_mutex_init(&capture->lock, NULL);
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&capture->cond, &attr);
+	pthread_condattr_destroy(&attr);
+
+	pipe_crc->capture = capture;
+
+	if (threaded) {
+		igt_assert_eq(pthread_create(&capture->thread, NULL,
+					     capture_thread, pipe_crc), 0);
+		capture->threaded = true;
+	}
+}
+
+/**
+ * igt_pipe_crc_stop_capture:
+ * @pipe_crc: pipe CRC object
+ *
+ * Stops the CRC capture started with igt_pipe_crc_start_capture() and
+ * releases the ring. CRCs not consumed yet are lost. The kernel side of the
+ * capture is stopped later on by igt_pipe_crc_stop().
+ */
+void igt_pipe_crc_stop_capture(igt_pipe_crc_t *pipe_crc)
+{
+	struct crc_capture *capture = pipe_crc->capture;
+
+	if (!capture)
+		return;
+
+	if (capture->threaded) {
+		WRITE_ONCE(capture->stop, true);
+		pthread_join(capture->thread, NULL);
+	}
+
+	pipe_crc->capture = NULL;
+	fcntl(pipe_crc->crc_fd, F_SETFL, pipe_crc->flags);
+
+	pthread_cond_destroy(&capture->cond);
+	pthread_mutex_destroy(&capture->lock);
+	free(capture->timestamps);
+	free(capture->crcs);
+	free(capture);
+}
+
+static int capture_get_locked(struct crc_capture *capture, igt_crc_t *crcs,
+			      uint64_t *timestamps_ns, int max)
+{
+	int n = 0;
+
+	while (n < max && capture->tail < capture->head) {
+		unsigned int idx = capture->tail++ % capture->size;
+
+		crcs[n] = capture->crcs[idx];
+		if (timestamps_ns)
+			timestamps_ns[n] = capture->timestamps[idx];
+		n++;
+	}
+
+	return n;
+}
+
+/**
+ * igt_pipe_crc_capture_get:
+ * @pipe_crc: pipe CRC object with a capture running
+ * @crcs: array of at least @max CRCs to fill
+ * @timestamps_ns: optional array of at least @max arrival times to fill
+ * @max: maximum number of CRCs to return
+ *
+ * Consumes the CRCs captured so far, oldest first, without blocking.
+ *
+ * Returns: the number of CRCs stored into @crcs.
+ */
+int igt_pipe_crc_capture_get(igt_pipe_crc_t *pipe_crc, igt_crc_t *crcs,
+			     uint64_t *timestamps_ns, int max)
+{
+	struct crc_capture *capture = pipe_crc->capture;
+	int n;
+
+	igt_assert(capture);
+
+	if (!capture->threaded)
+		igt_assert_lte(0, capture_pump(pipe_crc));
+
+	pthread_mutex_lock(&capture->lock);
+	igt_assert_eq(capture->error, 0);
+	n = capture_get_locked(capture, crcs, timestamps_ns, max);
+	pthread_mutex_unlock(&capture->lock);
+
+	return n;
+}
+
+/**
+ * igt_pipe_crc_capture_wait_frame:
+ * @pipe_crc: pipe CRC object with a capture running
+ * @frame: frame counter value we're looking for
+ * @crc: buffer for the captured CRC value
+ * @timestamp_ns: optional buffer for the arrival time of the CRC
+ * @timeout_ms: how long to wait for the CRC
+ *
+ * Consumes captured CRCs until the one for @frame, or a later one if the
+ * CRC for @frame was dropped, waiting for it if needed. CRCs without a
+ * valid frame counter are returned right away.
+ *
+ * Returns: true if a CRC was stored into @crc, false on timeout.
+ */
+bool igt_pipe_crc_capture_wait_frame(igt_pipe_crc_t *pipe_crc,
+				     unsigned int frame, igt_crc_t *crc,
+				     uint64_t *timestamp_ns,
+				     unsigned int timeout_ms)
+{
+	struct crc_capture *capture = pipe_crc->capture;
+	struct timespec deadline;
+	bool found = false;
+
+	igt_assert(capture);
+
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	deadline.tv_sec += timeout_ms / 1000;
+	deadline.tv_nsec += (timeout_ms % 1000) * 1000000;
+	if (deadline.tv_nsec >= 1000000000) {
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000;
+	}
+
+	while (!found) {
+		if (!capture->threaded) {
+			struct pollfd pfd = {
+				.fd = pipe_crc->crc_fd,
+				.events = POLLIN,
+			};
+			struct timespec now;
+			int64_t left;
+
+			igt_assert_lte(0, capture_pump(pipe_crc));
+
+			if (capture->tail == capture->head) {
+				clock_gettime(CLOCK_MONOTONIC, &now);
+				left = (deadline.tv_sec - now.tv_sec) * 1000 +
+					(deadline.tv_nsec - now.tv_nsec) / 1000000;
+				if (left <= 0 || poll(&pfd, 1, left) <= 0)
+					break;
+				continue;
+			}
+		}
+
+		pthread_mutex_lock(&capture->lock);
+		while (capture->tail == capture->head && !capture->error) {
+			if (pthread_cond_timedwait(&capture->cond, &capture->lock,
+						   &deadline) == ETIMEDOUT)
+				break;
+		}
+		igt_assert_eq(capture->error, 0);
+
+		while (!found && capture_get_locked(capture, crc, timestamp_ns, 1))
+			found = !crc->has_valid_frame ||
+				!igt_vblank_before(crc->frame, frame);
+
+		if (!found && capture->tail == capture->head &&
+		    capture->threaded) {
+			struct timespec now;
+
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			if (now.tv_sec > deadline.tv_sec ||
+			    (now.tv_sec == deadline.tv_sec &&
+			     now.tv_nsec >= deadline.tv_nsec)) {
+				pthread_mutex_unlock(&capture->lock);
+				break;
+			}
+		}
+		pthread_mutex_unlock(&capture->lock);
+	}
+
+	if (found)
+		crc_sanity_checks(pipe_crc, crc);
+
+	return found;
+}
+
+/**
+ * igt_pipe_crc_capture_dropped:
+ * @pipe_crc: pipe CRC object with a capture running
+ *
+ * Returns: the number of CRCs overwritten in the ring before being consumed.
+ */
+unsigned long igt_pipe_crc_capture_dropped(igt_pipe_crc_t *pipe_crc)
+{
+	struct crc_capture *capture = pipe_crc->capture;
+	unsigned long dropped;
+
+	igt_assert(capture);
+
+	pthread_mutex_lock(&capture->lock);
+	dropped = capture->dropped;
+	pthread_mutex_unlock(&capture->lock);
+
+	return dropped;
+}
+
+#define CRC_GROUP_RING_SIZE 32
+
+struct _igt_pipe_crc_group {
+	int fd;
+	int n_pipes;
+	igt_pipe_crc_t **pipe_crcs;
+	struct pollfd *pfds;
+};
+
+/**
+ * igt_pipe_crc_group_new:
+ * @fd: fd of the device
+ * @pipes: display pipes to use as source
+ * @n_pipes: number of pipes in @pipes
+ * @source: CRC tap point to use as source on all the pipes
+ *
+ * Sets up the CRC capture of several pipes at once. Unlike a set of
+ * #igt_pipe_crc_t objects used one after another, the group starts the
+ * capture on all the pipes in one step and waits for the CRCs of all of
+ * them in a single poll() loop, so that validating several pipes costs
+ * about as many frames as validating one.
+ *
+ * Returns: A pipe CRC group, to be freed with igt_pipe_crc_group_free().
+ */
+igt_pipe_crc_group_t *
+igt_pipe_crc_group_new(int fd, const enum pipe *pipes, int n_pipes,
+		       const char *source)
+{
+	igt_pipe_crc_group_t *group;
+	int i;
+
+	igt_assert(n_pipes > 0);
+
+	group = calloc(1, sizeof(*group));
+	igt_assert(group);
+
+	group->fd = fd;
+	group->n_pipes = n_pipes;
+	group->pipe_crcs = calloc(n_pipes, sizeof(*group->pipe_crcs));
+	group->pfds = calloc(n_pipes, sizeof(*group->pfds));
+	igt_assert(group->pipe_crcs && group->pfds);
+
+	for (i = 0; i < n_pipes; i++)
+		group->pipe_crcs[i] = pipe_crc_new(fd, pipes[i], source,
+						   O_RDONLY | O_NONBLOCK);
+
+	return group;
+}
+
+/**
+ * igt_pipe_crc_group_free:
+ * @group: pipe CRC group
+ *
+ * Frees all resources associated with @group.
+ */
+void igt_pipe_crc_group_free(igt_pipe_crc_group_t *group)
+{
+	int i;
+
+	if (!group)
+		return;
+
+	for (i = 0; i < group->n_pipes; i++)
+		igt_pipe_crc_free(group->pipe_crcs[i]);
+
+	free(group->pfds);
+	free(group->pipe_crcs);
+	free(group);
+}
+
+/**
+ * igt_pipe_crc_group_start:
+ * @group: pipe CRC group
+ *
+ * Starts the CRC capture on all the pipes of @group, and waits until all of
+ * them produced their first CRC.
+ */
+void igt_pipe_crc_group_start(igt_pipe_crc_group_t *group)
+{
+	char buf[32];
+	int i, ready;
+
+	igt_pipe_crc_group_stop(group);
+
+	igt_reset_fifo_underrun_reporting(group->fd);
+
+	for (i = 0; i < group->n_pipes; i++) {
+		igt_pipe_crc_t *pipe_crc = group->pipe_crcs[i];
+		const char *src = pipe_crc->source;
+
+		igt_assert_eq(write(pipe_crc->ctl_fd, src, strlen(src)), strlen(src));
+	}
+
+	igt_set_timeout(10, "Opening crc fds, and poll for first CRCs.");
+
+	for (i = 0; i < group->n_pipes; i++) {
+		igt_pipe_crc_t *pipe_crc = group->pipe_crcs[i];
+
+		sprintf(buf, "crtc-%d/crc/data", pipe_crc->pipe);
+		pipe_crc->crc_fd = openat(pipe_crc->dir, buf, pipe_crc->flags);
+		igt_assert(pipe_crc->crc_fd != -1);
+
+		group->pfds[i].fd = pipe_crc->crc_fd;
+		group->pfds[i].events = POLLIN;
+	}
+
+	/* Wait until every pipe has a CRC, without consuming any */
+	do {
+		igt_assert_lte(0, poll(group->pfds, group->n_pipes, -1));
+
+		for (i = 0, ready = 0; i < group->n_pipes; i++) {
+			if (group->pfds[i].revents & POLLIN)
+				group->pfds[i].fd = -1;
+			if (group->pfds[i].fd == -1)
+				ready++;
+		}
+	} while (ready < group->n_pipes);
+
+	igt_reset_timeout();
+
+	for (i = 0; i < group->n_pipes; i++) {
+		capture_init(group->pipe_crcs[i], CRC_GROUP_RING_SIZE, false);
+		group->pfds[i].fd = group->pipe_crcs[i]->crc_fd;
+	}
+
+	errno = 0;
+}
+
+/**
+ * igt_pipe_crc_group_stop:
+ * @group: pipe CRC group
+ *
+ * Stops the CRC capture on all the pipes of @group.
+ */
+void igt_pipe_crc_group_stop(igt_pipe_crc_group_t *group)
+{
+	int i;
+
+	for (i = 0; i < group->n_pipes; i++)
+		igt_pipe_crc_stop(group->pipe_crcs[i]);
+}
+
+/*
+ * Reads whatever CRCs are available on all pipes, waiting for at least one
+ * of the pipes in @waiting if none is.
+ */
+static void crc_group_wait(igt_pipe_crc_group_t *group, const bool *waiting)
+{
+	int i;
+
+	for (i = 0; i < group->n_pipes; i++)
+		group->pfds[i].fd = waiting[i] ? group->pipe_crcs[i]->crc_fd : -1;
+
+	igt_set_timeout(5, "CRC reading");
+	while (poll(group->pfds, group->n_pipes, -1) < 0)
+		igt_assert_eq(errno, EINTR);
+	igt_reset_timeout();
+
+	for (i = 0; i < group->n_pipes; i++) {
+		if (group->pfds[i].revents & POLLIN)
+			igt_assert_lte(0, capture_pump(group->pipe_crcs[i]));
+	}
+}
+
+static bool crc_group_next(igt_pipe_crc_group_t *group, int i, igt_crc_t *crc)
+{
+	struct crc_capture *capture = group->pipe_crcs[i]->capture;
+
+	igt_assert(capture);
+
+	return capture_get_locked(capture, crc, NULL, 1);
+}
+
+/**
+ * igt_pipe_crc_group_get_crcs:
+ * @group: pipe CRC group
+ * @n_crcs: number of CRCs to capture on each pipe
+ * @out_crcs: array of @n_crcs times the number of pipes in @group
+ *
+ * Reads the next @n_crcs CRCs of every pipe of @group, blocking until they
+ * are all there. The CRCs are stored frame by frame: CRC k of the pipe at
+ * index i of the group goes to @out_crcs[k * n_pipes + i].
+ *
+ * Callers must start and stop the capturing themselves by calling
+ * igt_pipe_crc_group_start() and igt_pipe_crc_group_stop().
+ */
+void igt_pipe_crc_group_get_crcs(igt_pipe_crc_group_t *group, int n_crcs,
+				 igt_crc_t *out_crcs)
+{
+	int count[group->n_pipes];
+	bool waiting[group->n_pipes];
+	int i, left;
+
+	memset(count, 0, sizeof(count));
+
+	do {
+		left = 0;
+		for (i = 0; i < group->n_pipes; i++) {
+			while (count[i] < n_crcs &&
+			       crc_group_next(group, i,
+					      &out_crcs[count[i] * group->n_pipes + i]))
+				count[i]++;
+
+			waiting[i] = count[i] < n_crcs;
+			left += waiting[i];
+		}
+
+		if (left)
+			crc_group_wait(group, waiting);
+	} while (left);
+
+	for (i = 0; i < n_crcs * group->n_pipes; i++)
+		crc_sanity_checks(group->pipe_crcs[i % group->n_pipes], &out_crcs[i]);
+}
+
+/**
+ * igt_pipe_crc_group_get_current:
+ * @group: pipe CRC group
+ * @out_crcs: array of one CRC per pipe in @group
+ *
+ * Like igt_pipe_crc_get_current() for all the pipes of @group at once:
+ * waits for the CRC of the frame following the current one on every pipe,
+ * so that all the CRCs reflect the state of the display at the time of the
+ * call.
+ */
+void igt_pipe_crc_group_get_current(igt_pipe_crc_group_t *group,
+				    igt_crc_t *out_crcs)
+{
+	unsigned int frame[group->n_pipes];
+	bool waiting[group->n_pipes];
+	int i, left;
+
+	for (i = 0; i < group->n_pipes; i++) {
+		frame[i] = kmstest_get_vblank(group->fd,
+					      group->pipe_crcs[i]->pipe, 0) + 1;
+		waiting[i] = true;
+	}
+
+	do {
+		left = 0;
+		for (i = 0; i < group->n_pipes; i++) {
+			igt_crc_t *crc = &out_crcs[i];
+
+			while (waiting[i] && crc_group_next(group, i, crc))
+				waiting[i] = crc->has_valid_frame &&
+					igt_vblank_before(crc->frame, frame[i]);
+
+			left += waiting[i];
+		}
+
+		if (left)
+			crc_group_wait(group, waiting);
+	} while (left);
+
+	for (i = 0; i < group->n_pipes; i++)
+		crc_sanity_checks(group->pipe_crcs[i], &out_crcs[i]);
+}
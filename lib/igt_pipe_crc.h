@@ -10,6 +10,7 @@
 #include <stdint.h>
 
 enum pipe;
+struct igt_display;
 
 /**
  * igt_pipe_crc_t:
@@ -19,6 +20,14 @@ enum pipe;
  */
 typedef struct _igt_pipe_crc igt_pipe_crc_t;
 
+/**
+ * igt_pipe_crc_group_t:
+ *
+ * Support structure for capturing the CRCs of several pipes at once. Needs
+ * to be allocated and set up with igt_pipe_crc_group_new().
+ */
+typedef struct _igt_pipe_crc_group igt_pipe_crc_group_t;
+
 #define DRM_MAX_CRC_NR 10
 /**
  * igt_crc_t:
@@ -45,6 +54,7 @@ void igt_assert_crc_equal(const igt_crc_t *a, const igt_crc_t *b);
 bool igt_check_crc_equal(const igt_crc_t *a, const igt_crc_t *b);
 char *igt_crc_to_string_extended(igt_crc_t *crc, char delimiter, int crc_size);
 char *igt_crc_to_string(igt_crc_t *crc);
+const char *igt_crc_to_arena_string(igt_crc_t *crc);
 
 void igt_require_pipe_crc(int fd);
 igt_pipe_crc_t *
@@ -64,5 +74,30 @@ void igt_pipe_crc_get_for_frame(int drm_fd, igt_pipe_crc_t *pipe_crc,
 				unsigned int vblank, igt_crc_t *crc);
 
 void igt_pipe_crc_collect_crc(igt_pipe_crc_t *pipe_crc, igt_crc_t *out_crc);
+void igt_pipe_crc_collect_reference(igt_pipe_crc_t *pipe_crc,
+				    struct igt_display *display,
+				    igt_crc_t *out_crc);
+
+void igt_pipe_crc_start_capture(igt_pipe_crc_t *pipe_crc,
+				unsigned int ring_size, bool threaded);
+void igt_pipe_crc_stop_capture(igt_pipe_crc_t *pipe_crc);
+int igt_pipe_crc_capture_get(igt_pipe_crc_t *pipe_crc, igt_crc_t *crcs,
+			     uint64_t *timestamps_ns, int max);
+bool igt_pipe_crc_capture_wait_frame(igt_pipe_crc_t *pipe_crc,
+				     unsigned int frame, igt_crc_t *crc,
+				     uint64_t *timestamp_ns,
+				     unsigned int timeout_ms);
+unsigned long igt_pipe_crc_capture_dropped(igt_pipe_crc_t *pipe_crc);
+
+igt_pipe_crc_group_t *
+igt_pipe_crc_group_new(int fd, const enum pipe *pipes, int n_pipes,
+		       const char *source);
+void igt_pipe_crc_group_free(igt_pipe_crc_group_t *group);
+void igt_pipe_crc_group_start(igt_pipe_crc_group_t *group);
+void igt_pipe_crc_group_stop(igt_pipe_crc_group_t *group);
+void igt_pipe_crc_group_get_crcs(igt_pipe_crc_group_t *group, int n_crcs,
+				 igt_crc_t *out_crcs);
+void igt_pipe_crc_group_get_current(igt_pipe_crc_group_t *group,
+				    igt_crc_t *out_crcs);
 
 #endif /* __IGT_PIPE_CRC_H__ */
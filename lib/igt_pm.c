@@ -528,6 +528,7 @@ static void __igt_pm_sata_link_pm_exit_handler(int sig)
 
 static char __igt_pm_runtime_autosuspend[64];
 static char __igt_pm_runtime_control[64];
+static struct igt_sysfs_attr *__igt_pm_runtime_status;
 
 static int __igt_restore_runtime_pm(void)
 {
@@ -562,6 +563,9 @@ static int __igt_restore_runtime_pm(void)
 
 	close(fd);
 
+	igt_sysfs_attr_close(__igt_pm_runtime_status);
+	__igt_pm_runtime_status = NULL;
+
 	close(__igt_pm_power);
 	__igt_pm_power = -1;
 
@@ -719,15 +723,20 @@ void igt_disable_runtime_pm(void)
 	close(fd);
 }
 
-static enum igt_runtime_pm_status __igt_get_runtime_pm_status(int fd)
+/* Kept open as the status is polled while waiting for transitions. */
+static struct igt_sysfs_attr *runtime_status_attr(void)
 {
-	ssize_t n_read;
-	char buf[32];
+	if (!__igt_pm_runtime_status)
+		__igt_pm_runtime_status =
+			igt_sysfs_attr_open(__igt_pm_power, "runtime_status");
+	igt_assert_f(__igt_pm_runtime_status, "Can't open runtime_status\n");
 
-	lseek(fd, 0, SEEK_SET);
-	n_read = read(fd, buf, ARRAY_SIZE(buf) - 1);
-	igt_assert(n_read >= 0);
-	buf[n_read] = '\0';
+	return __igt_pm_runtime_status;
+}
+
+static enum igt_runtime_pm_status parse_runtime_pm_status(const char *buf)
+{
+	size_t n_read = strlen(buf);
 
 	if (strncmp(buf, "suspended\n", n_read) == 0)
 		return IGT_RUNTIME_PM_STATUS_SUSPENDED;
@@ -742,6 +751,16 @@ static enum igt_runtime_pm_status __igt_get_runtime_pm_status(int fd)
 	return IGT_RUNTIME_PM_STATUS_UNKNOWN;
 }
 
+static enum igt_runtime_pm_status __igt_get_runtime_pm_status(void)
+{
+	char buf[32];
+
+	igt_assert(igt_sysfs_attr_read(runtime_status_attr(),
+				       buf, sizeof(buf)) >= 0);
+
+	return parse_runtime_pm_status(buf);
+}
+
 /**
  * igt_get_runtime_pm_status:
  *
@@ -749,19 +768,10 @@ static enum igt_runtime_pm_status __igt_get_runtime_pm_status(int fd)
  */
 enum igt_runtime_pm_status igt_get_runtime_pm_status(void)
 {
-	enum igt_runtime_pm_status status;
-	int fd;
-
 	if (__igt_pm_power < 0)
 		return IGT_RUNTIME_PM_STATUS_UNKNOWN;
 
-	fd = openat(__igt_pm_power, "runtime_status", O_RDONLY);
-	igt_assert_f(fd >= 0, "Can't open runtime_status\n");
-
-	status = __igt_get_runtime_pm_status(fd);
-	close(fd);
-
-	return status;
+	return __igt_get_runtime_pm_status();
 }
 
 static const char *_pm_status_name(enum igt_runtime_pm_status status)
@@ -780,38 +790,76 @@ static const char *_pm_status_name(enum igt_runtime_pm_status status)
 	}
 }
 
+struct pm_status_wait {
+	enum igt_runtime_pm_status expected;
+	enum igt_runtime_pm_status status;
+};
+
+static bool match_pm_status(const char *value, void *data)
+{
+	struct pm_status_wait *w = data;
+
+	w->status = parse_runtime_pm_status(value);
+
+	return w->status == w->expected;
+}
+
 /**
- * igt_wait_for_pm_status:
+ * __igt_wait_for_pm_status:
  * @status: desired runtime PM status
+ * @timeout_ms: how long to wait for the transition
+ * @elapsed_ns: optional return location for the time the transition took
  *
- * Waits until for the driver to switch to into the desired runtime PM status,
- * with a 10 second timeout.
+ * Waits for the driver to switch into the desired runtime PM status. The
+ * status is re-read with an adaptive backoff, so the returned latency is
+ * close to the actual runtime suspend entry or exit time instead of being
+ * rounded up to a fixed polling interval.
  *
  * Return: True if the desired runtime PM status was attained, false if the
  *         operation timed out.
  */
-bool igt_wait_for_pm_status(enum igt_runtime_pm_status status)
+bool __igt_wait_for_pm_status(enum igt_runtime_pm_status status,
+			      unsigned int timeout_ms, uint64_t *elapsed_ns)
 {
-	enum igt_runtime_pm_status expected = status;
-	bool ret;
-	int fd;
+	struct pm_status_wait w = {
+		.expected = status,
+		.status = IGT_RUNTIME_PM_STATUS_UNKNOWN,
+	};
+	int64_t ret;
 
 	if (__igt_pm_power < 0)
 		return false;
 
-	fd = openat(__igt_pm_power, "runtime_status", O_RDONLY);
-	igt_assert_f(fd >= 0, "Can't open runtime_status\n");
+	ret = igt_sysfs_attr_wait_for(runtime_status_attr(), match_pm_status,
+				      &w, timeout_ms);
+	if (ret < 0) {
+		igt_warn("timeout: pm_status expected:%s, got:%s\n",
+			 _pm_status_name(w.expected),
+			 _pm_status_name(w.status));
+		return false;
+	}
 
-	ret = igt_wait((status = __igt_get_runtime_pm_status(fd)) == expected,
-		       10000, 100);
-	close(fd);
+	igt_debug("pm_status %s after %.3fms\n",
+		  _pm_status_name(w.expected), ret * 1e-6);
+	if (elapsed_ns)
+		*elapsed_ns = ret;
 
-	if (!ret)
-		igt_warn("timeout: pm_status expected:%s, got:%s\n",
-			_pm_status_name(expected),
-			_pm_status_name(status));
+	return true;
+}
 
-	return ret;
+/**
+ * igt_wait_for_pm_status:
+ * @status: desired runtime PM status
+ *
+ * Waits until for the driver to switch to into the desired runtime PM status,
+ * with a 10 second timeout.
+ *
+ * Return: True if the desired runtime PM status was attained, false if the
+ *         operation timed out.
+ */
+bool igt_wait_for_pm_status(enum igt_runtime_pm_status status)
+{
+	return __igt_wait_for_pm_status(status, 10000, NULL);
 }
 
 static const char *yesno(bool x)
@@ -882,21 +930,23 @@ bool igt_pm_pc8_plus_residencies_enabled(int msr_fd)
  */
 bool i915_output_is_lpsp_capable(int drm_fd, igt_output_t *output)
 {
-	char buf[256];
-	int fd, len;
+	struct igt_debugfs_file *file;
+	const char *buf = NULL;
+	bool capable;
+	int fd;
 
 	fd = igt_debugfs_connector_dir(drm_fd, output->name, O_RDONLY);
 	igt_require(fd >= 0);
-	len = igt_debugfs_simple_read(fd, "i915_lpsp_capability",
-				      buf, sizeof(buf));
+	file = igt_debugfs_file_open(fd, "i915_lpsp_capability");
+	close(fd);
 
 	/* if i915_lpsp_capability not present return the capability as false */
-	if (len < 0)
-		return false;
+	if (file)
+		buf = igt_debugfs_file_read(file);
+	capable = buf && strstr(buf, "LPSP: capable");
+	igt_debugfs_file_close(file);
 
-	close(fd);
-
-	return strstr(buf, "LPSP: capable");
+	return capable;
 }
 
 static int igt_pm_open_pci_firmware_node(struct pci_device *pci_dev)
@@ -1394,22 +1444,25 @@ void igt_pm_print_pci_card_runtime_status(void)
  */
 bool i915_is_slpc_enabled_gt(int drm_fd, int gt)
 {
-	int dir, debugfs_fd;
-	char buf[4096] = {};
+	struct igt_debugfs_file *file;
+	const char *buf = NULL;
+	bool enabled;
+	int dir;
 
 	dir = igt_debugfs_gt_dir(drm_fd, gt);
 	igt_require(dir);
 
-	debugfs_fd = openat(dir, "uc/guc_slpc_info", O_RDONLY);
+	file = igt_debugfs_file_open(dir, "uc/guc_slpc_info");
+	close(dir);
 	/* if guc_slpc_info not present then return false */
-	if (debugfs_fd < 0)
+	if (!file)
 		return false;
 
-	read(debugfs_fd, buf, sizeof(buf)-1);
-
-	close(debugfs_fd);
+	buf = igt_debugfs_file_read(file);
+	enabled = buf && strstr(buf, "SLPC state: running");
+	igt_debugfs_file_close(file);
 
-	return strstr(buf, "SLPC state: running");
+	return enabled;
 }
 
 /**
@@ -74,6 +74,8 @@ bool igt_setup_runtime_pm(int device);
 void igt_disable_runtime_pm(void);
 void igt_restore_runtime_pm(void);
 enum igt_runtime_pm_status igt_get_runtime_pm_status(void);
+bool __igt_wait_for_pm_status(enum igt_runtime_pm_status status,
+			      unsigned int timeout_ms, uint64_t *elapsed_ns);
 bool igt_wait_for_pm_status(enum igt_runtime_pm_status status);
 bool igt_pm_dmc_loaded(int debugfs);
 bool igt_pm_pc8_plus_residencies_enabled(int msr_fd);
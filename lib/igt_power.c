@@ -119,14 +119,14 @@ int igt_power_open(int fd, struct igt_power *p, const char *domain)
 {
 	int i;
 
-	p->hwmon_fd = -1;
+	p->hwmon_energy = NULL;
 	p->bat_fd = -1;
 	p->rapl.fd = -1;
 
 	if (fd >= 0 && is_intel_dgfx(fd)) {
 		if (strncmp(domain, "gpu", strlen("gpu")) == 0) {
-			p->hwmon_fd = igt_hwmon_open(fd);
-			if (p->hwmon_fd >= 0)
+			p->hwmon_energy = igt_hwmon_attr_open(fd, "energy1_input");
+			if (p->hwmon_energy)
 				return 0;
 		}
 	} else {
@@ -155,9 +155,8 @@ void igt_power_get_energy(struct igt_power *power, struct power_sample *s)
 	igt_assert(!clock_gettime(CLOCK_MONOTONIC, &ts));
 	s->time =  ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
 
-	if (power->hwmon_fd >= 0) {
-		if (igt_sysfs_has_attr(power->hwmon_fd, "energy1_input"))
-			s->energy = igt_sysfs_get_u64(power->hwmon_fd, "energy1_input");
+	if (power->hwmon_energy) {
+		s->energy = igt_sysfs_attr_get_u64(power->hwmon_energy);
 	} else if (power->bat_fd >= 0) {
 		s->energy = bat_get_energy(power->bat_fd);
 	} else if (power->rapl.fd >= 0) {
@@ -178,7 +177,7 @@ void igt_power_get_energy(struct igt_power *power, struct power_sample *s)
 double igt_power_get_mJ(const struct igt_power *power,
 			const struct power_sample *p0, const struct power_sample *p1)
 {
-	if (power->hwmon_fd >= 0)
+	if (power->hwmon_energy)
 		return (p1->energy - p0->energy) * 1e-3;
 	else if (power->bat_fd >= 0)
 		return (p0->energy - p1->energy) * 1e-3; /* battery measures remaining energy */
@@ -226,9 +225,9 @@ double igt_power_get_s(const struct power_sample *p0,
  */
 void igt_power_close(struct igt_power *power)
 {
-	if (power->hwmon_fd >= 0) {
-		close(power->hwmon_fd);
-		power->hwmon_fd = -1;
+	if (power->hwmon_energy) {
+		igt_sysfs_attr_close(power->hwmon_energy);
+		power->hwmon_energy = NULL;
 	} else if (power->bat_fd >= 0) {
 		close(power->bat_fd);
 		power->bat_fd = -1;
@@ -252,7 +251,7 @@ int igt_power_bat_open(struct igt_power *p, int index)
 	char path[64];
 	int fd;
 
-	p->hwmon_fd = -1;
+	p->hwmon_energy = NULL;
 	p->bat_fd = -1;
 	p->rapl.fd = -1;
 
@@ -39,9 +39,11 @@ struct power_sample {
 	uint64_t time;
 };
 
+struct igt_sysfs_attr;
+
 struct igt_power {
 	struct rapl rapl;
-	int hwmon_fd;
+	struct igt_sysfs_attr *hwmon_energy;
 	int bat_fd;
 };
 
@@ -52,7 +54,7 @@ int igt_power_bat_open(struct igt_power *p, int index);
 
 static inline bool igt_power_valid(struct igt_power *p)
 {
-	return p->rapl.fd >= 0 || p->hwmon_fd >= 0 || p->bat_fd >= 0;
+	return p->rapl.fd >= 0 || p->hwmon_energy || p->bat_fd >= 0;
 }
 
 void igt_power_get_energy(struct igt_power *p, struct power_sample *s);
@@ -88,14 +88,12 @@ static bool sink_status_checks(void)
 	return env && atoi(env);
 }
 
-static bool psr_active_check(int debugfs_fd, enum psr_mode mode, igt_output_t *output)
+static bool psr_active_check(int debugfs_fd, struct igt_debugfs_file *status,
+			     enum psr_mode mode, igt_output_t *output)
 {
-	char debugfs_file[128] = {0};
-	char buf[PSR_STATUS_MAX_LEN];
 	drmModeConnector *c = NULL;
-	const char *state;
+	const char *state, *buf;
 	bool active;
-	int ret;
 
 	if (mode == PR_MODE || mode == PR_MODE_SEL_FETCH) {
 		igt_assert_f(output, "Output not given\n");
@@ -111,12 +109,9 @@ static bool psr_active_check(int debugfs_fd, enum psr_mode mode, igt_output_t *o
 	else
 		igt_assert_f(false, "Invalid psr mode\n");
 
-	SET_DEBUGFS_PATH(output, debugfs_file);
-	ret = igt_debugfs_simple_read(debugfs_fd, debugfs_file,
-				     buf, sizeof(buf));
-	if (ret < 0) {
-		igt_info("Could not read i915_edp_psr_status: %s\n",
-			 strerror(-ret));
+	buf = status ? igt_debugfs_file_read(status) : NULL;
+	if (!buf) {
+		igt_info("Could not read i915_edp_psr_status: %m\n");
 		return false;
 	}
 
@@ -138,40 +133,103 @@ static bool psr_active_check(int debugfs_fd, enum psr_mode mode, igt_output_t *o
 
 #define PSR_TIMEOUT(timeout)	((igt_run_in_simulation() ? 10 : 1) * (timeout))
 
+/* The status file is kept open while polling it */
+static struct igt_debugfs_file *psr_status_open(int debugfs_fd,
+						igt_output_t *output)
+{
+	char debugfs_file[128] = {0};
+
+	SET_DEBUGFS_PATH(output, debugfs_file);
+
+	return igt_debugfs_file_open(debugfs_fd, debugfs_file);
+}
+
+/* How long the last successful waits for PSR to be entered or exited took */
+static uint64_t psr_entry_latency_ns;
+static int64_t psr_exit_latency_ns = -1;
+
 /*
  * For PSR1, we wait until PSR is active. We wait until DEEP_SLEEP for PSR2.
  */
 bool psr_wait_entry(int debugfs_fd, enum psr_mode mode, igt_output_t *output)
 {
-	return igt_wait(psr_active_check(debugfs_fd, mode, output), PSR_TIMEOUT(500), 20);
+	struct igt_debugfs_file *status = psr_status_open(debugfs_fd, output);
+	bool ret;
+
+	ret = igt_wait_adaptive(psr_active_check(debugfs_fd, status, mode,
+						 output),
+				PSR_TIMEOUT(500), 20, &psr_entry_latency_ns);
+	igt_debugfs_file_close(status);
+
+	return ret;
 }
 
-bool psr_wait_update(int debugfs_fd, enum psr_mode mode, igt_output_t *output)
+static bool __psr_wait_update(int debugfs_fd, enum psr_mode mode,
+			      igt_output_t *output, unsigned int timeout_ms)
 {
+	struct igt_debugfs_file *status = psr_status_open(debugfs_fd, output);
+	bool ret;
+
 	/*
 	 * TODO: After enabling Panel Replay on DP2.1, observe that the SRD status
 	 * remains in the SRDENT_ON state. Remove the polling mechanism for the SRD
 	 * status change for the DP2.1 output.
 	 */
 	if (output != NULL &&
-	    output->config.connector->connector_type == DRM_MODE_CONNECTOR_DisplayPort)
-		return igt_wait(psr_active_check(debugfs_fd, mode, output), PSR_TIMEOUT(40), 1);
-	else
-		return igt_wait(!psr_active_check(debugfs_fd, mode, output), PSR_TIMEOUT(40), 1);
+	    output->config.connector->connector_type == DRM_MODE_CONNECTOR_DisplayPort) {
+		/* Nothing exits, so there's no exit latency to report */
+		psr_exit_latency_ns = -1;
+		ret = igt_wait_adaptive(psr_active_check(debugfs_fd, status,
+							 mode, output),
+					PSR_TIMEOUT(timeout_ms), 1, NULL);
+	} else {
+		uint64_t latency;
+
+		ret = igt_wait_adaptive(!psr_active_check(debugfs_fd, status,
+							  mode, output),
+					PSR_TIMEOUT(timeout_ms), 1, &latency);
+		psr_exit_latency_ns = ret ? latency : -1;
+	}
+	igt_debugfs_file_close(status);
+
+	return ret;
+}
+
+bool psr_wait_update(int debugfs_fd, enum psr_mode mode, igt_output_t *output)
+{
+	return __psr_wait_update(debugfs_fd, mode, output, 40);
 }
 
 bool psr_long_wait_update(int debugfs_fd, enum psr_mode mode, igt_output_t *output)
 {
-	/*
-	 * TODO: After enabling Panel Replay on DP2.1, observe that the SRD status
-	 * remains in the SRDENT_ON state. Remove the polling mechanism for the SRD
-	 * status change for the DP2.1 output.
-	 */
-	if (output != NULL &&
-	    output->config.connector->connector_type == DRM_MODE_CONNECTOR_DisplayPort)
-		return igt_wait(psr_active_check(debugfs_fd, mode, output), PSR_TIMEOUT(500), 1);
-	else
-		return igt_wait(!psr_active_check(debugfs_fd, mode, output), PSR_TIMEOUT(500), 1);
+	return __psr_wait_update(debugfs_fd, mode, output, 500);
+}
+
+/**
+ * psr_last_entry_latency_ns:
+ *
+ * Returns:
+ * How long the last successful psr_wait_entry() waited for PSR to be active,
+ * in nanoseconds.
+ */
+uint64_t psr_last_entry_latency_ns(void)
+{
+	return psr_entry_latency_ns;
+}
+
+/**
+ * psr_last_exit_latency_ns:
+ *
+ * Returns:
+ * How long the last psr_wait_update() or psr_long_wait_update() waited for
+ * PSR to exit, in nanoseconds, or -1 if that wait failed or didn't wait for
+ * an exit. The latter is the case on DisplayPort outputs, where Panel Replay
+ * stays in SRDENT_ON through the update and the wait only checks that it
+ * is still active.
+ */
+int64_t psr_last_exit_latency_ns(void)
+{
+	return psr_exit_latency_ns;
 }
 
 static ssize_t psr_write(int debugfs_fd, const char *buf, igt_output_t *output)
@@ -389,15 +447,14 @@ void psr_sink_error_check(int debugfs_fd, enum psr_mode mode, igt_output_t *outp
 
 /* Return the the last or last but one su blocks */
 static bool
-psr2_read_last_num_su_blocks_val(int debugfs_fd, uint16_t *num_su_blocks)
+psr2_read_last_num_su_blocks_val(struct igt_debugfs_file *status,
+				 uint16_t *num_su_blocks)
 {
-	char buf[PSR_STATUS_MAX_LEN];
+	const char *buf;
 	char *str, *str2;
-	int ret;
 
-	ret = igt_debugfs_simple_read(debugfs_fd, "i915_edp_psr_status", buf,
-				      sizeof(buf));
-	if (ret < 0)
+	buf = status ? igt_debugfs_file_read(status) : NULL;
+	if (!buf)
 		return false;
 
 	str = strstr(buf, PSR2_SU_BLOCK_STR_LOOKUP);
@@ -419,23 +476,31 @@ psr2_read_last_num_su_blocks_val(int debugfs_fd, uint16_t *num_su_blocks)
 
 bool psr2_wait_su(int debugfs_fd, uint16_t *num_su_blocks)
 {
-	return igt_wait(psr2_read_last_num_su_blocks_val(debugfs_fd, num_su_blocks), 40, 1);
+	struct igt_debugfs_file *status;
+	bool ret;
+
+	status = igt_debugfs_file_open(debugfs_fd, "i915_edp_psr_status");
+	ret = igt_wait_adaptive(psr2_read_last_num_su_blocks_val(status,
+								 num_su_blocks),
+				40, 1, NULL);
+	igt_debugfs_file_close(status);
+
+	return ret;
 }
 
 void psr_print_debugfs(int debugfs_fd)
 {
-	char buf[PSR_STATUS_MAX_LEN];
-	int ret;
-
-	ret = igt_debugfs_simple_read(debugfs_fd, "i915_edp_psr_status", buf,
-				      sizeof(buf));
-	if (ret < 0) {
-		igt_info("Could not read i915_edp_psr_status: %s\n",
-			 strerror(-ret));
-		return;
-	}
-
-	igt_info("%s", buf);
+	struct igt_debugfs_file *status;
+	const char *buf = NULL;
+
+	status = igt_debugfs_file_open(debugfs_fd, "i915_edp_psr_status");
+	if (status)
+		buf = igt_debugfs_file_read(status);
+	if (!buf)
+		igt_info("Could not read i915_edp_psr_status: %m\n");
+	else
+		igt_info("%s", buf);
+	igt_debugfs_file_close(status);
 }
 
 bool i915_psr2_selective_fetch_check(int drm_fd, igt_output_t *output)
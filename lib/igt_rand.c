@@ -1,3 +1,9 @@
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "igt_aux.h"
+#include "igt_core.h"
 #include "igt_rand.h"
 
 /**
@@ -35,3 +41,252 @@ uint32_t hars_petruska_f54_1_random_unsafe(void)
 {
 	return hars_petruska_f54_1_random(&global);
 }
+
+/*
+ * The buffer fills use a counter based generator: word n of the stream for a
+ * seed is the SplitMix64 finalizer applied to seed + (n + 1) * golden ratio.
+ * Any part of the stream can be generated without generating what precedes
+ * it, which lets threads fill chunks of a buffer independently and lets the
+ * content of a buffer be checked against the stream instead of a copy. With
+ * no dependency between the words, the loops are vectorised by the compiler.
+ */
+#define RAND_FILL_GAMMA 0x9e3779b97f4a7c15ull
+
+static inline uint64_t rand_fill_word(uint64_t seed, uint64_t n)
+{
+	uint64_t z = seed + (n + 1) * RAND_FILL_GAMMA;
+
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+	return z ^ (z >> 31);
+}
+
+static inline uint8_t rand_fill_byte(uint64_t seed, uint64_t offset)
+{
+	return rand_fill_word(seed, offset / 8) >> (8 * (offset % 8));
+}
+
+/**
+ * igt_rand_fill_at:
+ * @buf: buffer to fill
+ * @len: length of @buf in bytes
+ * @seed: seed of the stream
+ * @offset: offset in the stream of the first byte of @buf
+ *
+ * Fills @buf with bytes @offset to @offset + @len of the pseudo-random stream
+ * of @seed. Chunks of a buffer can be filled separately, in any order and
+ * from any thread, giving the same content as filling it at once with
+ * igt_rand_fill(). The stream is made of 64bit words in host byte order.
+ */
+void igt_rand_fill_at(void *buf, size_t len, uint64_t seed, uint64_t offset)
+{
+	uint8_t *p = buf;
+	uint64_t n;
+	size_t i;
+
+	while (len && offset % 8) {
+		*p++ = rand_fill_byte(seed, offset++);
+		len--;
+	}
+
+	n = offset / 8;
+	for (i = 0; i < len / 8; i++) {
+		uint64_t v = rand_fill_word(seed, n + i);
+
+		memcpy(p + 8 * i, &v, sizeof(v));
+	}
+
+	p += 8 * i;
+	offset += 8 * i;
+	for (i = 0; i < len % 8; i++)
+		p[i] = rand_fill_byte(seed, offset + i);
+}
+
+/**
+ * igt_rand_fill:
+ * @buf: buffer to fill
+ * @len: length of @buf in bytes
+ * @seed: seed of the stream
+ *
+ * Fills @buf with the start of the pseudo-random stream of @seed, see
+ * igt_rand_fill_at().
+ */
+void igt_rand_fill(void *buf, size_t len, uint64_t seed)
+{
+	igt_rand_fill_at(buf, len, seed, 0);
+}
+
+/**
+ * igt_rand_verify_at:
+ * @buf: buffer to check
+ * @len: length of @buf in bytes
+ * @seed: seed of the stream
+ * @offset: offset in the stream of the first byte of @buf
+ *
+ * Checks that @buf holds what igt_rand_fill_at() would have filled it with,
+ * regenerating the stream instead of comparing against a copy.
+ *
+ * Returns: the offset in @buf of the first byte that differs, or -1 if all of
+ * them match.
+ */
+ssize_t igt_rand_verify_at(const void *buf, size_t len, uint64_t seed,
+			   uint64_t offset)
+{
+	const uint8_t *p = buf;
+	size_t i = 0, j;
+
+	while (i < len && (offset + i) % 8) {
+		if (p[i] != rand_fill_byte(seed, offset + i))
+			return i;
+		i++;
+	}
+
+	/* Check blocks at once, only looking for the byte of a failed one */
+	while (len - i >= 8) {
+		size_t words = min_t(size_t, (len - i) / 8, 64);
+		uint64_t n = (offset + i) / 8, diff = 0;
+
+		for (j = 0; j < words; j++) {
+			uint64_t v;
+
+			memcpy(&v, p + i + 8 * j, sizeof(v));
+			diff |= v ^ rand_fill_word(seed, n + j);
+		}
+
+		if (diff)
+			break;
+
+		i += 8 * words;
+	}
+
+	for (; i < len; i++)
+		if (p[i] != rand_fill_byte(seed, offset + i))
+			return i;
+
+	return -1;
+}
+
+/**
+ * igt_rand_verify:
+ * @buf: buffer to check
+ * @len: length of @buf in bytes
+ * @seed: seed of the stream
+ *
+ * Checks that @buf holds the start of the pseudo-random stream of @seed, see
+ * igt_rand_verify_at().
+ *
+ * Returns: the offset in @buf of the first byte that differs, or -1 if all of
+ * them match.
+ */
+ssize_t igt_rand_verify(const void *buf, size_t len, uint64_t seed)
+{
+	return igt_rand_verify_at(buf, len, seed, 0);
+}
+
+#define RAND_FILL_MIN_CHUNK (4 << 20)
+#define RAND_FILL_MAX_THREADS 64
+
+struct rand_fill_chunk {
+	pthread_t thread;
+	uint8_t *buf;
+	size_t len;
+	uint64_t seed;
+	uint64_t offset;
+	bool verify;
+	ssize_t mismatch;
+};
+
+static void *rand_fill_chunk_thread(void *data)
+{
+	struct rand_fill_chunk *chunk = data;
+
+	if (chunk->verify)
+		chunk->mismatch = igt_rand_verify_at(chunk->buf, chunk->len,
+						     chunk->seed, chunk->offset);
+	else
+		igt_rand_fill_at(chunk->buf, chunk->len, chunk->seed,
+				 chunk->offset);
+
+	return NULL;
+}
+
+static ssize_t rand_fill_parallel(void *buf, size_t len, uint64_t seed,
+				  int threads, bool verify)
+{
+	struct rand_fill_chunk chunks[RAND_FILL_MAX_THREADS];
+	size_t chunk_len;
+	int i, n;
+
+	if (threads <= 0)
+		threads = sysconf(_SC_NPROCESSORS_ONLN);
+
+	n = min_t(size_t, threads, len / RAND_FILL_MIN_CHUNK);
+	n = min(n, RAND_FILL_MAX_THREADS);
+	if (n <= 1) {
+		if (verify)
+			return igt_rand_verify(buf, len, seed);
+
+		igt_rand_fill(buf, len, seed);
+		return -1;
+	}
+
+	/* Keep chunks cacheline aligned, the last one takes the remainder */
+	chunk_len = (len / n) & ~63ul;
+
+	for (i = 0; i < n; i++) {
+		chunks[i].buf = (uint8_t *)buf + i * chunk_len;
+		chunks[i].len = i == n - 1 ? len - i * chunk_len : chunk_len;
+		chunks[i].seed = seed;
+		chunks[i].offset = i * chunk_len;
+		chunks[i].verify = verify;
+		chunks[i].mismatch = -1;
+		igt_assert_eq(pthread_create(&chunks[i].thread, NULL,
+					     rand_fill_chunk_thread,
+					     &chunks[i]), 0);
+	}
+
+	for (i = 0; i < n; i++)
+		pthread_join(chunks[i].thread, NULL);
+
+	for (i = 0; i < n; i++)
+		if (chunks[i].mismatch >= 0)
+			return chunks[i].offset + chunks[i].mismatch;
+
+	return -1;
+}
+
+/**
+ * igt_rand_fill_parallel:
+ * @buf: buffer to fill
+ * @len: length of @buf in bytes
+ * @seed: seed of the stream
+ * @threads: maximum number of threads to use, 0 for one per online CPU
+ *
+ * Like igt_rand_fill(), but splits large buffers into chunks filled by
+ * separate threads, for instance to fill large buffers through a mapping of
+ * device memory. Buffers too small to be worth it are filled by the calling
+ * thread.
+ */
+void igt_rand_fill_parallel(void *buf, size_t len, uint64_t seed, int threads)
+{
+	rand_fill_parallel(buf, len, seed, threads, false);
+}
+
+/**
+ * igt_rand_verify_parallel:
+ * @buf: buffer to check
+ * @len: length of @buf in bytes
+ * @seed: seed of the stream
+ * @threads: maximum number of threads to use, 0 for one per online CPU
+ *
+ * Like igt_rand_verify(), but splits large buffers into chunks checked by
+ * separate threads.
+ *
+ * Returns: the offset in @buf of the first byte that differs, or -1 if all of
+ * them match.
+ */
+ssize_t igt_rand_verify_parallel(const void *buf, size_t len, uint64_t seed,
+				 int threads)
+{
+	return rand_fill_parallel((void *)buf, len, seed, threads, true);
+}
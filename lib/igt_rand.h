@@ -24,7 +24,9 @@
 #ifndef IGT_RAND_H
 #define IGT_RAND_H
 
+#include <stddef.h>
 #include <stdint.h>
+#include <sys/types.h>
 
 uint32_t hars_petruska_f54_1_random(uint32_t *state);
 uint64_t hars_petruska_f54_1_random64(uint32_t *s);
@@ -45,4 +47,13 @@ static inline uint32_t hars_petruska_f54_1_random_unsafe_max(uint32_t ep_ro)
 	return ((uint64_t)hars_petruska_f54_1_random_unsafe() * ep_ro) >> 32;
 }
 
+void igt_rand_fill(void *buf, size_t len, uint64_t seed);
+void igt_rand_fill_at(void *buf, size_t len, uint64_t seed, uint64_t offset);
+void igt_rand_fill_parallel(void *buf, size_t len, uint64_t seed, int threads);
+ssize_t igt_rand_verify(const void *buf, size_t len, uint64_t seed);
+ssize_t igt_rand_verify_at(const void *buf, size_t len, uint64_t seed,
+			   uint64_t offset);
+ssize_t igt_rand_verify_parallel(const void *buf, size_t len, uint64_t seed,
+				 int threads);
+
 #endif /* IGT_RAND_H */
@@ -8,6 +8,7 @@
 #include <fcntl.h>
 #include <limits.h>
 #include <pciaccess.h>
+#include <pthread.h>
 
 #include "drmtest.h"
 #include "igt_core.h"
@@ -371,6 +372,67 @@ void igt_sriov_bind_vf_drm_driver(int pf, unsigned int vf_num)
 	igt_assert(__igt_sriov_bind_vf_drm_driver(pf, vf_num, true));
 }
 
+struct vf_bind {
+	pthread_t thread;
+	int sysfs;
+	char *pci_slot;
+	bool ret;
+};
+
+static void *vf_bind_thread(void *data)
+{
+	struct vf_bind *b = data;
+
+	b->ret = igt_sysfs_set(b->sysfs, "device/driver/bind", b->pci_slot);
+
+	return NULL;
+}
+
+/**
+ * igt_sriov_bind_vf_drm_drivers - Bind DRM driver to VFs
+ * @pf: PF device file descriptor
+ * @num_vfs: Number of VFs, from VF1, to bind the driver to
+ *
+ * Bind the DRM driver to VFs 1 to @num_vfs, probing all of them at the same
+ * time rather than one after another as igt_sriov_bind_vf_drm_driver() would.
+ * It asserts on failure.
+ */
+void igt_sriov_bind_vf_drm_drivers(int pf, unsigned int num_vfs)
+{
+	struct vf_bind *binds;
+	unsigned int vf;
+	int sysfs;
+
+	igt_assert(num_vfs > 0);
+
+	sysfs = igt_sysfs_open(pf);
+	igt_assert_fd(sysfs);
+
+	binds = calloc(num_vfs, sizeof(*binds));
+	igt_assert(binds);
+
+	for (vf = 0; vf < num_vfs; vf++) {
+		binds[vf].sysfs = sysfs;
+		binds[vf].pci_slot = __igt_sriov_get_vf_pci_slot_alloc(sysfs, vf + 1);
+		igt_assert(binds[vf].pci_slot);
+		igt_debug("vf_num: %u, pci_slot: %s\n", vf + 1, binds[vf].pci_slot);
+		igt_assert_eq(pthread_create(&binds[vf].thread, NULL,
+					     vf_bind_thread, &binds[vf]), 0);
+	}
+
+	for (vf = 0; vf < num_vfs; vf++)
+		pthread_join(binds[vf].thread, NULL);
+
+	for (vf = 0; vf < num_vfs; vf++) {
+		igt_assert_f(binds[vf].ret, "Failed to bind VF%u (%s)\n",
+			     vf + 1, binds[vf].pci_slot);
+		free(binds[vf].pci_slot);
+	}
+
+	free(binds);
+	close(sysfs);
+}
+
 /**
  * igt_sriov_unbind_vf_drm_driver - Unbind DRM driver from VF
  * @pf: PF device file descriptor
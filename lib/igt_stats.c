@@ -26,12 +26,15 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "igt_aux.h"
 #include "igt_core.h"
 #include "igt_stats.h"
 
 #define U64_MAX         ((uint64_t)~0ULL)
 
-#define sorted_value(stats, i) (stats->is_float ? stats->sorted_f[i] : stats->sorted_u64[i])
+#define sorted_value(stats, i) \
+	(stats->is_histogram ? histogram_value(stats, i) : \
+	 stats->is_float ? stats->sorted_f[i] : stats->sorted_u64[i])
 #define unsorted_value(stats, i) (stats->is_float ? stats->values_f[i] : stats->values_u64[i])
 
 /**
@@ -64,7 +67,103 @@
  *
  *	igt_stats_fini(&stats);
  * ]|
+ *
+ * By default every pushed sample is kept, and median, quartiles and other
+ * order statistics sort them. For benchmarks pushing millions of samples
+ * igt_stats_init_histogram() selects a log-linear histogram, HDR style,
+ * with bounded memory and constant time igt_stats_push(). Order statistics
+ * are then approximated with relative error bounded by the chosen
+ * precision, while mean and variance stay exact. Histograms collected per
+ * thread can be combined with igt_stats_merge().
+ */
+
+/*
+ * Values below 2^precision get a bucket each, above that every power of two
+ * range is split into 2^precision buckets.
  */
+static unsigned int histogram_index(const igt_stats_t *stats, uint64_t value)
+{
+	unsigned int p = stats->precision;
+	unsigned int shift;
+
+	if (value < (1ull << p))
+		return value;
+
+	shift = 63 - __builtin_clzll(value) - p;
+
+	return (shift + 1) << p | ((value >> shift) & ((1ull << p) - 1));
+}
+
+static void histogram_bounds(const igt_stats_t *stats, unsigned int idx,
+			     uint64_t *lower, uint64_t *upper)
+{
+	unsigned int p = stats->precision;
+	unsigned int shift;
+
+	if (idx < (1u << p)) {
+		*lower = *upper = idx;
+		return;
+	}
+
+	shift = (idx >> p) - 1;
+	*lower = ((1ull << p) | (idx & ((1ull << p) - 1))) << shift;
+	*upper = *lower + ((1ull << shift) - 1);
+}
+
+static double histogram_bucket_value(const igt_stats_t *stats,
+				     unsigned int idx)
+{
+	uint64_t lower, upper;
+	double value;
+
+	histogram_bounds(stats, idx, &lower, &upper);
+	value = lower + (upper - lower) / 2.;
+
+	/* Outermost buckets are better represented by the real extremes */
+	if (value < stats->min)
+		value = stats->min;
+	if (value > stats->max)
+		value = stats->max;
+
+	return value;
+}
+
+/* Approximates the value at position @rank of the sorted dataset */
+static double histogram_value(const igt_stats_t *stats, unsigned int rank)
+{
+	uint64_t seen = 0;
+	unsigned int i;
+
+	for (i = 0; i < stats->n_buckets; i++) {
+		seen += stats->buckets[i];
+		if (rank < seen)
+			return histogram_bucket_value(stats, i);
+	}
+
+	return stats->max;
+}
+
+/* Mean of the values at positions [@first, @last] of the sorted dataset */
+static double histogram_range_mean(const igt_stats_t *stats,
+				   unsigned int first, unsigned int last)
+{
+	uint64_t start = 0, end;
+	double sum = 0.;
+	unsigned int i;
+
+	for (i = 0; i < stats->n_buckets && start <= last; i++) {
+		end = start + stats->buckets[i];
+		if (end > first) {
+			uint64_t lo = max_t(uint64_t, start, first);
+			uint64_t hi = min_t(uint64_t, end, last + 1);
+
+			sum += (hi - lo) * histogram_bucket_value(stats, i);
+		}
+		start = end;
+	}
+
+	return sum / (last - first + 1);
+}
 
 static unsigned int get_new_capacity(int need)
 {
@@ -83,7 +182,7 @@ static void igt_stats_ensure_capacity(igt_stats_t *stats,
 	unsigned int new_n_values = stats->n_values + n_additional_values;
 	unsigned int new_capacity;
 
-	if (new_n_values <= stats->capacity)
+	if (stats->is_histogram || new_n_values <= stats->capacity)
 		return;
 
 	new_capacity = get_new_capacity(new_n_values);
@@ -137,6 +236,36 @@ void igt_stats_init_with_size(igt_stats_t *stats, unsigned int capacity)
 	stats->range[1] = -HUGE_VAL;
 }
 
+/**
+ * igt_stats_init_histogram:
+ * @stats: An #igt_stats_t instance
+ * @precision: Number of significant bits kept for each value, 1 to 12
+ *
+ * Like igt_stats_init() but instead of storing every data sample, @stats
+ * only counts them in a log-linear histogram. Memory used is bounded by
+ * @precision and pushing a value takes constant time. Median, quartiles,
+ * IQM and trimean are approximated with relative error below
+ * 2^-@precision, mean, variance, min and max are exact. Floating point
+ * values can't be pushed in this mode.
+ *
+ * igt_stats_fini() must be called once finished with @stats.
+ */
+void igt_stats_init_histogram(igt_stats_t *stats, unsigned int precision)
+{
+	igt_assert(precision >= 1 && precision <= 12);
+
+	memset(stats, 0, sizeof(*stats));
+
+	stats->is_histogram = true;
+	stats->precision = precision;
+	stats->n_buckets = (65 - precision) << precision;
+	stats->buckets = calloc(stats->n_buckets, sizeof(*stats->buckets));
+	igt_assert(stats->buckets);
+
+	stats->min = U64_MAX;
+	stats->max = 0;
+}
+
 /**
  * igt_stats_fini:
  * @stats: An #igt_stats_t instance
@@ -147,6 +276,7 @@ void igt_stats_fini(igt_stats_t *stats)
 {
 	free(stats->values_u64);
 	free(stats->sorted_u64);
+	free(stats->buckets);
 }
 
 
@@ -212,6 +342,25 @@ void igt_stats_push(igt_stats_t *stats, uint64_t value)
 		return;
 	}
 
+	if (stats->is_histogram) {
+		double delta = value - stats->running_mean;
+
+		stats->buckets[histogram_index(stats, value)]++;
+		stats->n_values++;
+
+		/* Welford's online algorithm, we can't revisit samples later */
+		stats->running_mean += delta / stats->n_values;
+		stats->running_m2 += delta * (value - stats->running_mean);
+
+		stats->mean_variance_valid = false;
+
+		if (value < stats->min)
+			stats->min = value;
+		if (value > stats->max)
+			stats->max = value;
+		return;
+	}
+
 	igt_stats_ensure_capacity(stats, 1);
 
 	stats->values_u64[stats->n_values++] = value;
@@ -235,6 +384,8 @@ void igt_stats_push(igt_stats_t *stats, uint64_t value)
  */
 void igt_stats_push_float(igt_stats_t *stats, double value)
 {
+	igt_assert(!stats->is_histogram);
+
 	igt_stats_ensure_capacity(stats, 1);
 
 	if (!stats->is_float) {
@@ -276,6 +427,99 @@ void igt_stats_push_array(igt_stats_t *stats,
 		igt_stats_push(stats, values[i]);
 }
 
+/**
+ * igt_stats_merge:
+ * @stats: An #igt_stats_t instance
+ * @other: An #igt_stats_t instance to merge into @stats
+ *
+ * Adds the @other dataset to @stats, for example to combine histograms
+ * collected by separate threads. Histograms have to be created with the same
+ * precision. A histogram can't be merged into an exact @stats.
+ */
+void igt_stats_merge(igt_stats_t *stats, igt_stats_t *other)
+{
+	unsigned int i;
+
+	if (!other->is_histogram) {
+		for (i = 0; i < other->n_values; i++) {
+			if (other->is_float)
+				igt_stats_push_float(stats, other->values_f[i]);
+			else
+				igt_stats_push(stats, other->values_u64[i]);
+		}
+		return;
+	}
+
+	igt_assert(stats->is_histogram);
+	igt_assert_eq(stats->precision, other->precision);
+
+	if (!other->n_values)
+		return;
+
+	for (i = 0; i < stats->n_buckets; i++)
+		stats->buckets[i] += other->buckets[i];
+
+	/* Chan et al. parallel variance */
+	if (stats->n_values) {
+		double n = (double)stats->n_values + other->n_values;
+		double delta = other->running_mean - stats->running_mean;
+
+		stats->running_mean += delta * other->n_values / n;
+		stats->running_m2 += other->running_m2 +
+			delta * delta * stats->n_values * other->n_values / n;
+	} else {
+		stats->running_mean = other->running_mean;
+		stats->running_m2 = other->running_m2;
+	}
+	stats->n_values += other->n_values;
+	stats->mean_variance_valid = false;
+
+	if (other->min < stats->min)
+		stats->min = other->min;
+	if (other->max > stats->max)
+		stats->max = other->max;
+}
+
+/**
+ * igt_stats_get_n_buckets:
+ * @stats: An #igt_stats_t instance initialized with igt_stats_init_histogram()
+ *
+ * Returns: number of histogram buckets, to be read with igt_stats_get_bucket().
+ */
+unsigned int igt_stats_get_n_buckets(igt_stats_t *stats)
+{
+	igt_assert(stats->is_histogram);
+	return stats->n_buckets;
+}
+
+/**
+ * igt_stats_get_bucket:
+ * @stats: An #igt_stats_t instance initialized with igt_stats_init_histogram()
+ * @idx: bucket index
+ * @lower: (out): lowest value counted in the bucket
+ * @upper: (out): highest value counted in the bucket
+ *
+ * Exports a histogram bucket, buckets are ordered by the values they count.
+ *
+ * Returns: number of values counted in the bucket.
+ */
+uint64_t igt_stats_get_bucket(igt_stats_t *stats, unsigned int idx,
+			      uint64_t *lower, uint64_t *upper)
+{
+	uint64_t l, u;
+
+	igt_assert(stats->is_histogram);
+	igt_assert(idx < stats->n_buckets);
+
+	histogram_bounds(stats, idx, &l, &u);
+	if (lower)
+		*lower = l;
+	if (upper)
+		*upper = u;
+
+	return stats->buckets[idx];
+}
+
 /**
  * igt_stats_get_min:
  * @stats: An #igt_stats_t instance
@@ -340,7 +584,7 @@ static int cmp_f(const void *pa, const void *pb)
 
 static void igt_stats_ensure_sorted_values(igt_stats_t *stats)
 {
-	if (stats->sorted_array_valid)
+	if (stats->is_histogram || stats->sorted_array_valid)
 		return;
 
 	if (!stats->sorted_u64) {
@@ -479,6 +723,37 @@ double igt_stats_get_median(igt_stats_t *stats)
 					     NULL, NULL);
 }
 
+/**
+ * igt_stats_get_percentile:
+ * @stats: An #igt_stats_t instance
+ * @percentile: The percentile to retrieve, between 0 and 100
+ *
+ * Retrieves the value below which @percentile percent of the @stats dataset
+ * falls, interpolating linearly between the two closest ranks. The 50th
+ * percentile is the median.
+ */
+double igt_stats_get_percentile(igt_stats_t *stats, double percentile)
+{
+	unsigned int lower;
+	double rank;
+
+	igt_assert(percentile >= 0. && percentile <= 100.);
+
+	if (!stats->n_values)
+		return 0.;
+
+	igt_stats_ensure_sorted_values(stats);
+
+	rank = percentile / 100. * (stats->n_values - 1);
+	lower = rank;
+	if (lower == stats->n_values - 1)
+		return sorted_value(stats, lower);
+
+	return sorted_value(stats, lower) +
+		(rank - lower) * (sorted_value(stats, lower + 1) -
+				  sorted_value(stats, lower));
+}
+
 /*
  * Algorithm popularised by Knuth in:
  *
@@ -490,12 +765,18 @@ double igt_stats_get_median(igt_stats_t *stats)
 static void igt_stats_knuth_mean_variance(igt_stats_t *stats)
 {
 	double mean = 0., m2 = 0.;
-	unsigned int i;
+	unsigned int i = 0;
 
 	if (stats->mean_variance_valid)
 		return;
 
-	for (i = 0; i < stats->n_values; i++) {
+	if (stats->is_histogram) {
+		mean = stats->running_mean;
+		m2 = stats->running_m2;
+		i = stats->n_values;
+	}
+
+	for (; i < stats->n_values; i++) {
 		double delta = unsorted_value(stats, i) - mean;
 
 		mean += delta / (i + 1);
@@ -585,8 +866,13 @@ double igt_stats_get_iqm(igt_stats_t *stats)
 	q3 = 3 * stats->n_values / 4;
 
 	mean = 0;
-	for (i = 0; i <= q3 - q1; i++)
-		mean += (sorted_value(stats, q1 + i) - mean) / (i + 1);
+	if (stats->is_histogram) {
+		mean = histogram_range_mean(stats, q1, q3);
+		i = q3 - q1 + 1;
+	} else {
+		for (i = 0; i <= q3 - q1; i++)
+			mean += (sorted_value(stats, q1 + i) - mean) / (i + 1);
+	}
 
 	if (stats->n_values % 4) {
 		double rem = .5 * (stats->n_values % 4) / 4;
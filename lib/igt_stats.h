@@ -35,6 +35,9 @@
  * @is_float: Whether @values_f or @values_u64 is valid
  * @values_f: An array containing pushed float values
  * @n_values: The number of pushed values
+ *
+ * When initialized with igt_stats_init_histogram() pushed values are not
+ * stored, @values_u64 and @values_f are not valid then.
  */
 typedef struct {
 	unsigned int n_values;
@@ -58,10 +61,17 @@ typedef struct {
 		uint64_t *sorted_u64;
 		double *sorted_f;
 	};
+
+	unsigned int is_histogram : 1;
+	unsigned int precision;
+	unsigned int n_buckets;
+	uint64_t *buckets;
+	double running_mean, running_m2;
 } igt_stats_t;
 
 void igt_stats_init(igt_stats_t *stats);
 void igt_stats_init_with_size(igt_stats_t *stats, unsigned int capacity);
+void igt_stats_init_histogram(igt_stats_t *stats, unsigned int precision);
 void igt_stats_fini(igt_stats_t *stats);
 bool igt_stats_is_population(igt_stats_t *stats);
 void igt_stats_set_population(igt_stats_t *stats, bool full_population);
@@ -69,6 +79,10 @@ void igt_stats_push(igt_stats_t *stats, uint64_t value);
 void igt_stats_push_float(igt_stats_t *stats, double value);
 void igt_stats_push_array(igt_stats_t *stats,
 			  const uint64_t *values, unsigned int n_values);
+void igt_stats_merge(igt_stats_t *stats, igt_stats_t *other);
+unsigned int igt_stats_get_n_buckets(igt_stats_t *stats);
+uint64_t igt_stats_get_bucket(igt_stats_t *stats, unsigned int idx,
+			      uint64_t *lower, uint64_t *upper);
 uint64_t igt_stats_get_min(igt_stats_t *stats);
 uint64_t igt_stats_get_max(igt_stats_t *stats);
 uint64_t igt_stats_get_range(igt_stats_t *stats);
@@ -79,6 +93,7 @@ double igt_stats_get_iqm(igt_stats_t *stats);
 double igt_stats_get_mean(igt_stats_t *stats);
 double igt_stats_get_trimean(igt_stats_t *stats);
 double igt_stats_get_median(igt_stats_t *stats);
+double igt_stats_get_percentile(igt_stats_t *stats, double percentile);
 double igt_stats_get_variance(igt_stats_t *stats);
 double igt_stats_get_std_deviation(igt_stats_t *stats);
 double igt_stats_get_std_error(igt_stats_t *stats);
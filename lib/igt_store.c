@@ -29,19 +29,76 @@ void igt_store_word(int fd, uint64_t ahnd, const intel_ctx_t *ctx,
 		    uint64_t target_gpu_addr,
 		    uint64_t store_offset, uint32_t store_value)
 {
-	const int SCRATCH = 0;
-	const int BATCH = 1;
+	const struct igt_store_entry store = {
+		.target_handle = target_handle,
+		.target_gpu_addr = target_gpu_addr,
+		.store_offset = store_offset,
+		.store_value = store_value,
+	};
+
+	igt_store_words(fd, ahnd, ctx, e, fence, &store, 1);
+}
+
+/**
+ * igt_store_words:
+ * @fd: open i915 drm file descriptor
+ * @ahnd: allocator handle, 0 for relocations
+ * @ctx: context to execute on
+ * @e: engine to execute on
+ * @fence: fence the batch waits for, -1 for none
+ * @stores: array of the dwords to write
+ * @count: number of entries in @stores
+ *
+ * Writes all of @stores with MI_STORE_DWORD_IMM from a single batch, in
+ * the order of the array, so that tests storing many values on an engine
+ * pay for one execbuf rather than one per value. The targets may repeat,
+ * a handle has to come with the same @target_gpu_addr each time.
+ */
+void igt_store_words(int fd, uint64_t ahnd, const intel_ctx_t *ctx,
+		     const struct intel_execution_engine2 *e, int fence,
+		     const struct igt_store_entry *stores, unsigned int count)
+{
 	const unsigned int gen = intel_gen(intel_get_drm_devid(fd));
-	struct drm_i915_gem_exec_object2 obj[2];
-	struct drm_i915_gem_relocation_entry reloc;
+	struct drm_i915_gem_exec_object2 *obj;
+	struct drm_i915_gem_relocation_entry *reloc;
 	struct drm_i915_gem_execbuffer2 execbuf;
-	uint32_t batch[16];
-	uint64_t bb_offset, delta;
+	unsigned int n, t, num_targets = 0;
+	uint32_t *batch, bb_size;
+	uint64_t bb_offset;
 	int i;
 
+	igt_assert(count);
+
+	/* Up to 4 dwords per store and the batch end */
+	bb_size = ALIGN((4 * count + 1) * sizeof(uint32_t), 4096);
+	batch = calloc(1, bb_size);
+	obj = calloc(count + 1, sizeof(*obj));
+	reloc = calloc(count, sizeof(*reloc));
+	igt_assert(batch && obj && reloc);
+
+	for (n = 0; n < count; n++) {
+		for (t = 0; t < num_targets; t++)
+			if (obj[t].handle == stores[n].target_handle)
+				break;
+
+		if (t < num_targets) {
+			igt_assert(!ahnd ||
+				   obj[t].offset == stores[n].target_gpu_addr);
+			continue;
+		}
+
+		obj[num_targets].handle = stores[n].target_handle;
+		if (ahnd) {
+			obj[num_targets].offset = stores[n].target_gpu_addr;
+			obj[num_targets].flags |= EXEC_OBJECT_PINNED |
+						  EXEC_OBJECT_WRITE;
+		}
+		num_targets++;
+	}
+
 	memset(&execbuf, 0, sizeof(execbuf));
 	execbuf.buffers_ptr = to_user_pointer(obj);
-	execbuf.buffer_count = ARRAY_SIZE(obj);
+	execbuf.buffer_count = num_targets + 1;
 	execbuf.flags = e->flags;
 	execbuf.rsvd1 = ctx->id;
 	if (fence != -1) {
@@ -51,50 +108,55 @@ void igt_store_word(int fd, uint64_t ahnd, const intel_ctx_t *ctx,
 	if (gem_store_dword_needs_secure(fd))
 		execbuf.flags |= I915_EXEC_SECURE;
 
-	memset(obj, 0, sizeof(obj));
-	obj[SCRATCH].handle = target_handle;
-
-	obj[BATCH].handle = gem_create(fd, 4096);
-	obj[BATCH].relocs_ptr = to_user_pointer(&reloc);
-	obj[BATCH].relocation_count = !ahnd ? 1 : 0;
-	bb_offset = get_offset(ahnd, obj[BATCH].handle, 4096, 0);
-	memset(&reloc, 0, sizeof(reloc));
+	obj[num_targets].handle = gem_create(fd, bb_size);
+	obj[num_targets].relocs_ptr = to_user_pointer(reloc);
+	obj[num_targets].relocation_count = !ahnd ? count : 0;
+	bb_offset = get_offset(ahnd, obj[num_targets].handle, bb_size, 0);
+	if (ahnd) {
+		obj[num_targets].offset = bb_offset;
+		obj[num_targets].flags |= EXEC_OBJECT_PINNED;
+	}
 
 	i = 0;
-	delta = sizeof(uint32_t) * store_offset;
-	if (!ahnd) {
-		reloc.target_handle = obj[SCRATCH].handle;
-		reloc.presumed_offset = -1;
-		reloc.offset = sizeof(uint32_t) * (i + 1);
-		reloc.delta = lower_32_bits(delta);
-		igt_assert_eq(upper_32_bits(delta), 0);
-		reloc.read_domains = I915_GEM_DOMAIN_INSTRUCTION;
-		reloc.write_domain = I915_GEM_DOMAIN_INSTRUCTION;
-	} else {
-		obj[SCRATCH].offset = target_gpu_addr;
-		obj[SCRATCH].flags |= EXEC_OBJECT_PINNED | EXEC_OBJECT_WRITE;
-		obj[BATCH].offset = bb_offset;
-		obj[BATCH].flags |= EXEC_OBJECT_PINNED;
-	}
-	batch[i] = MI_STORE_DWORD_IMM_GEN4 | (gen < 6 ? 1 << 22 : 0);
-	if (gen >= 8) {
-		uint64_t addr = target_gpu_addr + delta;
-		batch[++i] = lower_32_bits(addr);
-		batch[++i] = upper_32_bits(addr);
-	} else if (gen >= 4) {
-		batch[++i] = 0;
-		batch[++i] = lower_32_bits(delta);
-		igt_assert_eq(upper_32_bits(delta), 0);
-		reloc.offset += sizeof(uint32_t);
-	} else {
-		batch[i]--;
-		batch[++i] = lower_32_bits(delta);
-		igt_assert_eq(upper_32_bits(delta), 0);
+	for (n = 0; n < count; n++) {
+		uint64_t delta = sizeof(uint32_t) * stores[n].store_offset;
+
+		if (!ahnd) {
+			reloc[n].target_handle = stores[n].target_handle;
+			reloc[n].presumed_offset = -1;
+			reloc[n].offset = sizeof(uint32_t) * (i + 1);
+			reloc[n].delta = lower_32_bits(delta);
+			igt_assert_eq(upper_32_bits(delta), 0);
+			reloc[n].read_domains = I915_GEM_DOMAIN_INSTRUCTION;
+			reloc[n].write_domain = I915_GEM_DOMAIN_INSTRUCTION;
+		}
+
+		batch[i] = MI_STORE_DWORD_IMM_GEN4 | (gen < 6 ? 1 << 22 : 0);
+		if (gen >= 8) {
+			uint64_t addr = stores[n].target_gpu_addr + delta;
+			batch[++i] = lower_32_bits(addr);
+			batch[++i] = upper_32_bits(addr);
+		} else if (gen >= 4) {
+			batch[++i] = 0;
+			batch[++i] = lower_32_bits(delta);
+			igt_assert_eq(upper_32_bits(delta), 0);
+			reloc[n].offset += sizeof(uint32_t);
+		} else {
+			batch[i]--;
+			batch[++i] = lower_32_bits(delta);
+			igt_assert_eq(upper_32_bits(delta), 0);
+		}
+		batch[++i] = stores[n].store_value;
+		i++;
 	}
-	batch[++i] = store_value;
-	batch[++i] = MI_BATCH_BUFFER_END;
-	gem_write(fd, obj[BATCH].handle, 0, batch, sizeof(batch));
+	batch[i] = MI_BATCH_BUFFER_END;
+
+	gem_write(fd, obj[num_targets].handle, 0, batch, bb_size);
 	gem_execbuf(fd, &execbuf);
-	gem_close(fd, obj[BATCH].handle);
-	put_offset(ahnd, obj[BATCH].handle);
+	gem_close(fd, obj[num_targets].handle);
+	put_offset(ahnd, obj[num_targets].handle);
+
+	free(reloc);
+	free(obj);
+	free(batch);
 }
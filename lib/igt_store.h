@@ -5,8 +5,25 @@
 
 #include "igt_gt.h"
 
+/**
+ * igt_store_entry:
+ * @target_handle: object to write to
+ * @target_gpu_addr: address of the object, when using an allocator
+ * @store_offset: offset of the dword in the object, in dwords
+ * @store_value: value to write
+ */
+struct igt_store_entry {
+	uint32_t target_handle;
+	uint64_t target_gpu_addr;
+	uint64_t store_offset;
+	uint32_t store_value;
+};
+
 void igt_store_word(int fd, uint64_t ahnd, const intel_ctx_t *ctx,
 		    const struct intel_execution_engine2 *e,
 		    int fence, uint32_t target_handle,
 		    uint64_t target_gpu_addr,
 		    uint64_t store_offset, uint32_t store_value);
+void igt_store_words(int fd, uint64_t ahnd, const intel_ctx_t *ctx,
+		     const struct intel_execution_engine2 *e, int fence,
+		     const struct igt_store_entry *stores, unsigned int count);
@@ -35,6 +35,7 @@
 #include <limits.h>
 #include <string.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <unistd.h>
 #include <i915_drm.h>
 #include <dirent.h>
@@ -1099,6 +1100,335 @@ void igt_sysfs_set_boolean(int dir, const char *attr, bool value)
 		     "Failed to write %u to %s attribute (%s)\n", value, attr, strerror(errno));
 }
 
+/*
+ * Attribute handles keep the attribute open, so that polling it costs a single
+ * pread() instead of an openat(), read() and close(), as sysfs regenerates the
+ * contents on every read from offset zero.
+ */
+struct igt_sysfs_attr {
+	int fd;
+	char name[NAME_MAX];
+};
+
+static struct igt_sysfs_attr *attr_open(int dir, const char *attr, int flags)
+{
+	struct igt_sysfs_attr *a;
+	int fd;
+
+	fd = openat(dir, attr, flags | O_CLOEXEC);
+	if (igt_debug_on(fd < 0))
+		return NULL;
+
+	a = calloc(1, sizeof(*a));
+	igt_assert(a);
+
+	a->fd = fd;
+	strncpy(a->name, attr, sizeof(a->name) - 1);
+
+	return a;
+}
+
+/**
+ * igt_sysfs_attr_open:
+ * @dir: directory corresponding to attribute
+ * @attr: name of the sysfs node to open
+ *
+ * Opens a handle for repeatedly reading a sysfs attribute.
+ *
+ * Returns:
+ * The handle, or NULL if the attribute can not be opened.
+ */
+struct igt_sysfs_attr *igt_sysfs_attr_open(int dir, const char *attr)
+{
+	return attr_open(dir, attr, O_RDONLY);
+}
+
+/**
+ * igt_sysfs_attr_open_rw:
+ * @dir: directory corresponding to attribute
+ * @attr: name of the sysfs node to open
+ *
+ * Like igt_sysfs_attr_open(), but the handle can also be written with
+ * igt_sysfs_attr_printf().
+ *
+ * Returns:
+ * The handle, or NULL if the attribute can not be opened for writing.
+ */
+struct igt_sysfs_attr *igt_sysfs_attr_open_rw(int dir, const char *attr)
+{
+	return attr_open(dir, attr, O_RDWR);
+}
+
+/**
+ * igt_sysfs_attr_close:
+ * @a: attribute handle, may be NULL
+ *
+ * Closes a handle opened with igt_sysfs_attr_open().
+ */
+void igt_sysfs_attr_close(struct igt_sysfs_attr *a)
+{
+	if (!a)
+		return;
+
+	close(a->fd);
+	free(a);
+}
+
+/**
+ * igt_sysfs_attr_read:
+ * @a: attribute handle
+ * @buf: buffer where the contents will be stored
+ * @len: size of the buffer
+ *
+ * Reads the current contents of the attribute, terminated with a NUL.
+ *
+ * Returns:
+ * Number of bytes read, or -errno on failure.
+ */
+int igt_sysfs_attr_read(struct igt_sysfs_attr *a, char *buf, int len)
+{
+	ssize_t ret;
+
+	igt_assert(len > 0);
+
+	do {
+		ret = pread(a->fd, buf, len - 1, 0);
+	} while (ret < 0 && errno == EINTR);
+
+	if (ret < 0) {
+		ret = -errno;
+		buf[0] = '\0';
+		igt_debug("Failed to read %s attribute (%s)\n",
+			  a->name, strerror(-ret));
+		return ret;
+	}
+
+	buf[ret] = '\0';
+
+	return ret;
+}
+
+/**
+ * igt_sysfs_attr_scanf:
+ * @a: attribute handle
+ * @fmt: scanf format string
+ * @...: Additional paramaters to store the scaned input values
+ *
+ * scanf() wrapper for attribute handles.
+ *
+ * Returns:
+ * Number of values successfully scanned (which can be 0), EOF on errors or
+ * premature end of file.
+ */
+int igt_sysfs_attr_scanf(struct igt_sysfs_attr *a, const char *fmt, ...)
+{
+	char buf[4096]; /* Attributes are at most a page. */
+	va_list ap;
+	int ret;
+
+	if (igt_sysfs_attr_read(a, buf, sizeof(buf)) < 0)
+		return EOF;
+
+	va_start(ap, fmt);
+	ret = vsscanf(buf, fmt, ap);
+	va_end(ap);
+
+	return ret;
+}
+
+/**
+ * igt_sysfs_attr_printf:
+ * @a: attribute handle from igt_sysfs_attr_open_rw()
+ * @fmt: printf format string
+ * @...: values to format
+ *
+ * printf() wrapper for attribute handles. The whole value is written with a
+ * single pwrite() at offset 0.
+ *
+ * Returns:
+ * Number of characters written, or -errno on failure.
+ */
+int igt_sysfs_attr_printf(struct igt_sysfs_attr *a, const char *fmt, ...)
+{
+	char buf[4096]; /* Attributes are at most a page. */
+	va_list ap;
+	ssize_t ret;
+	int len;
+
+	va_start(ap, fmt);
+	len = vsnprintf(buf, sizeof(buf), fmt, ap);
+	va_end(ap);
+	if (igt_debug_on(len < 0 || len >= sizeof(buf)))
+		return -EINVAL;
+
+	/* As igt_sysfs_printf(), always write so empty strings still count */
+	do {
+		ret = pwrite(a->fd, buf, len ?: 1, 0);
+	} while (ret < 0 && errno == EINTR);
+
+	if (ret < 0) {
+		ret = -errno;
+		igt_debug("Failed to write %s attribute (%s)\n",
+			  a->name, strerror(-ret));
+		return ret;
+	}
+
+	return len;
+}
+
+/**
+ * __igt_sysfs_attr_get_u32:
+ * @a: attribute handle
+ * @value: pointer for storing read value
+ *
+ * Convenience wrapper to read a unsigned 32bit integer from an attribute
+ * handle.
+ *
+ * Returns:
+ * True if value successfully read, false otherwise.
+ */
+bool __igt_sysfs_attr_get_u32(struct igt_sysfs_attr *a, uint32_t *value)
+{
+	if (igt_debug_on(igt_sysfs_attr_scanf(a, "%u", value) != 1))
+		return false;
+
+	return true;
+}
+
+/**
+ * igt_sysfs_attr_get_u32:
+ * @a: attribute handle
+ *
+ * Convenience wrapper to read a unsigned 32bit integer from an attribute
+ * handle. It asserts on failure.
+ *
+ * Returns:
+ * Read value.
+ */
+uint32_t igt_sysfs_attr_get_u32(struct igt_sysfs_attr *a)
+{
+	uint32_t value;
+
+	igt_assert_f(__igt_sysfs_attr_get_u32(a, &value),
+		     "Failed to read %s attribute (%s)\n", a->name, strerror(errno));
+
+	return value;
+}
+
+/**
+ * __igt_sysfs_attr_get_u64:
+ * @a: attribute handle
+ * @value: pointer for storing read value
+ *
+ * Convenience wrapper to read a unsigned 64bit integer from an attribute
+ * handle.
+ *
+ * Returns:
+ * True if value successfully read, false otherwise.
+ */
+bool __igt_sysfs_attr_get_u64(struct igt_sysfs_attr *a, uint64_t *value)
+{
+	if (igt_debug_on(igt_sysfs_attr_scanf(a, "%"PRIu64, value) != 1))
+		return false;
+
+	return true;
+}
+
+/**
+ * igt_sysfs_attr_get_u64:
+ * @a: attribute handle
+ *
+ * Convenience wrapper to read a unsigned 64bit integer from an attribute
+ * handle. It asserts on failure.
+ *
+ * Returns:
+ * Read value.
+ */
+uint64_t igt_sysfs_attr_get_u64(struct igt_sysfs_attr *a)
+{
+	uint64_t value;
+
+	igt_assert_f(__igt_sysfs_attr_get_u64(a, &value),
+		     "Failed to read %s attribute (%s)\n", a->name, strerror(errno));
+
+	return value;
+}
+
+/**
+ * igt_sysfs_attr_wait:
+ * @a: attribute handle
+ * @timeout_ms: how long to wait, or -1 to wait forever
+ *
+ * Waits for the kernel to signal a change of the attribute with
+ * sysfs_notify(). Only some attributes are notified, the others never
+ * signal and the wait always times out. Changes are only reported after the
+ * contents have been read at least once since opening the handle or the last
+ * notification, so read the attribute before waiting to not miss any.
+ *
+ * Returns:
+ * 1 if the attribute was notified, 0 on timeout, or -errno on failure.
+ */
+int igt_sysfs_attr_wait(struct igt_sysfs_attr *a, int timeout_ms)
+{
+	struct pollfd p = { .fd = a->fd, .events = POLLPRI };
+	int ret;
+
+	ret = poll(&p, 1, timeout_ms);
+	if (ret < 0)
+		return -errno;
+
+	return ret > 0 && p.revents & (POLLPRI | POLLERR);
+}
+
+/**
+ * igt_sysfs_attr_wait_for:
+ * @a: attribute handle
+ * @match: predicate called with the current contents of the attribute
+ * @data: private data passed to @match
+ * @timeout_ms: how long to wait for @match to succeed
+ *
+ * Re-reads the attribute until @match returns true. In between reads the
+ * wait sleeps in igt_sysfs_attr_wait(), so attributes notified by the
+ * kernel are re-read as soon as they change. For the others the sleep
+ * starts at 1ms and doubles up to 64ms, keeping the latency of quick
+ * transitions low without busy polling long ones.
+ *
+ * Returns:
+ * The time in nanoseconds it took for @match to succeed, -ETIMEDOUT if it
+ * did not within @timeout_ms, or another -errno on failure.
+ */
+int64_t igt_sysfs_attr_wait_for(struct igt_sysfs_attr *a,
+				bool (*match)(const char *value, void *data),
+				void *data, int timeout_ms)
+{
+	struct timespec tv = {};
+	int interval_ms = 1, remaining_ms;
+	char buf[4096];
+	int64_t elapsed;
+	int ret;
+
+	igt_nsec_elapsed(&tv);
+	for (;;) {
+		ret = igt_sysfs_attr_read(a, buf, sizeof(buf));
+		if (ret < 0)
+			return ret;
+
+		elapsed = igt_nsec_elapsed(&tv);
+		if (match(buf, data))
+			return elapsed;
+
+		if (elapsed >= (int64_t)timeout_ms * NSEC_PER_MSEC)
+			return -ETIMEDOUT;
+
+		remaining_ms = timeout_ms - elapsed / NSEC_PER_MSEC;
+		ret = igt_sysfs_attr_wait(a, min(interval_ms, remaining_ms));
+		if (ret < 0)
+			return ret;
+		if (!ret && interval_ms < 64)
+			interval_ms <<= 1;
+	}
+}
+
 static void bind_con(const char *name, bool enable)
 {
 	const char *path = "/sys/class/vtconsole";
@@ -79,6 +79,9 @@
 #define igt_sysfs_rps_set_boolean(dir, id, value) \
 	igt_sysfs_set_boolean(dir, igt_sysfs_dir_id_to_name(dir, id), value)
 
+#define igt_sysfs_rps_attr_open(dir, id) \
+	igt_sysfs_attr_open(dir, igt_sysfs_dir_id_to_name(dir, id))
+
 enum i915_attr_id {
 	RPS_ACT_FREQ_MHZ,
 	RPS_CUR_FREQ_MHZ,
@@ -140,6 +143,25 @@ bool igt_sysfs_get_boolean(int dir, const char *attr);
 bool __igt_sysfs_set_boolean(int dir, const char *attr, bool value);
 void igt_sysfs_set_boolean(int dir, const char *attr, bool value);
 
+struct igt_sysfs_attr;
+
+struct igt_sysfs_attr *igt_sysfs_attr_open(int dir, const char *attr);
+struct igt_sysfs_attr *igt_sysfs_attr_open_rw(int dir, const char *attr);
+void igt_sysfs_attr_close(struct igt_sysfs_attr *a);
+int igt_sysfs_attr_read(struct igt_sysfs_attr *a, char *buf, int len);
+int igt_sysfs_attr_scanf(struct igt_sysfs_attr *a, const char *fmt, ...)
+	__attribute__((format(scanf,2,3)));
+int igt_sysfs_attr_printf(struct igt_sysfs_attr *a, const char *fmt, ...)
+	__attribute__((format(printf,2,3)));
+bool __igt_sysfs_attr_get_u32(struct igt_sysfs_attr *a, uint32_t *value);
+uint32_t igt_sysfs_attr_get_u32(struct igt_sysfs_attr *a);
+bool __igt_sysfs_attr_get_u64(struct igt_sysfs_attr *a, uint64_t *value);
+uint64_t igt_sysfs_attr_get_u64(struct igt_sysfs_attr *a);
+int igt_sysfs_attr_wait(struct igt_sysfs_attr *a, int timeout_ms);
+int64_t igt_sysfs_attr_wait_for(struct igt_sysfs_attr *a,
+				bool (*match)(const char *value, void *data),
+				void *data, int timeout_ms);
+
 void bind_fbcon(bool enable);
 void fbcon_blink_enable(bool enable);
 
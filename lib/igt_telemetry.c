@@ -0,0 +1,523 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2025 Intel Corporation
+ */
+
+/**
+ * SECTION:igt_telemetry
+ * @short_description: Background trace of GT frequency and throttling
+ * @title: GT telemetry
+ * @include: igt_telemetry.h
+ *
+ * A performance test or benchmark result standing out from the others is
+ * often explained by the GT running below the requested frequency, because
+ * it hit a power or thermal limit. The frequency and throttle attributes in
+ * sysfs only tell the state at the moment they are read, so this samples
+ * them from a background thread while the workload runs.
+ *
+ * Each sample records the actual and requested frequency, the active
+ * throttle reasons and, where the device has a hwmon interface, the power
+ * drawn and the temperature. The last samples are kept in a ring buffer of
+ * a fixed capacity as a trace, while the summary from
+ * igt_telemetry_get_summary() covers every sample taken.
+ *
+ * The benchmark harness traces its repetitions with --telemetry, see
+ * igt_bench_parse_opts(). Tests opt in with igt_telemetry_auto(), after
+ * which igt_core traces every subtest and logs the summary when it ends,
+ * with the trace at debug level to be dumped alongside a failure.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "drmtest.h"
+#include "igt_aux.h"
+#include "igt_core.h"
+#include "igt_hwmon.h"
+#include "igt_sysfs.h"
+#include "igt_telemetry.h"
+
+#define TELEMETRY_AUTO_CAPACITY	1024
+#define TELEMETRY_AUTO_INTERVAL	10
+
+struct igt_telemetry {
+	int gt;
+	unsigned int interval_ms;
+	unsigned int capacity;
+
+	struct igt_sysfs_attr *act_freq;
+	struct igt_sysfs_attr *req_freq;
+	struct igt_sysfs_attr *throttle[IGT_THROTTLE_NUM_REASONS];
+	struct igt_sysfs_attr *energy;
+	struct igt_sysfs_attr *temp;
+
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	bool running;
+	bool stop;
+	pid_t owner;
+
+	/* Owned by the sampling thread while running */
+	uint64_t start_ns;
+	uint64_t last_energy;
+	uint64_t last_energy_ns;
+	struct igt_telemetry_sample *ring;
+	unsigned int count;
+
+	uint64_t act_sum;
+	uint64_t req_sum;
+	uint64_t power_sum;
+	unsigned int power_samples;
+	struct igt_telemetry_summary summary;
+};
+
+static const char * const throttle_names[IGT_THROTTLE_NUM_REASONS] = {
+	[IGT_THROTTLE_PL1] = "pl1",
+	[IGT_THROTTLE_PL2] = "pl2",
+	[IGT_THROTTLE_PL4] = "pl4",
+	[IGT_THROTTLE_PROCHOT] = "prochot",
+	[IGT_THROTTLE_RATL] = "ratl",
+	[IGT_THROTTLE_THERMAL] = "thermal",
+	[IGT_THROTTLE_VR_TDC] = "vr_tdc",
+	[IGT_THROTTLE_VR_THERMALERT] = "vr_thermalert",
+};
+
+static struct igt_telemetry *auto_telemetry;
+
+/**
+ * igt_throttle_reason_name:
+ * @reason: throttle reason
+ *
+ * Returns: The name of @reason, as in the sysfs throttle attributes.
+ */
+const char *igt_throttle_reason_name(enum igt_throttle_reason reason)
+{
+	igt_assert(reason < IGT_THROTTLE_NUM_REASONS);
+
+	return throttle_names[reason];
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static struct igt_sysfs_attr *open_optional(int dir, const char *attr)
+{
+	return igt_sysfs_has_attr(dir, attr) ? igt_sysfs_attr_open(dir, attr) : NULL;
+}
+
+/**
+ * igt_telemetry_open:
+ * @drm_fd: fd of an i915 or xe device
+ * @gt: GT to trace
+ * @interval_ms: time between two samples
+ * @capacity: number of samples kept in the trace
+ *
+ * Opens the frequency, throttle and hwmon attributes of @gt for sampling
+ * with igt_telemetry_start(). Throttle reasons, power and temperature the
+ * device does not expose are left out of the samples.
+ *
+ * Returns: The telemetry, or NULL if the GT has no frequency attributes.
+ */
+struct igt_telemetry *igt_telemetry_open(int drm_fd, int gt,
+					 unsigned int interval_ms,
+					 unsigned int capacity)
+{
+	const char *act, *req, *throttle_fmt;
+	struct igt_telemetry *t;
+	pthread_condattr_t attr;
+	char name[64];
+	int dir;
+
+	if (is_xe_device(drm_fd)) {
+		dir = xe_sysfs_gt_open(drm_fd, gt);
+		if (dir < 0)
+			return NULL;
+
+		act = "freq0/act_freq";
+		req = "freq0/cur_freq";
+		throttle_fmt = "freq0/throttle/reason_%s";
+	} else if (is_i915_device(drm_fd)) {
+		dir = igt_sysfs_gt_open(drm_fd, gt);
+		if (dir < 0)
+			return NULL;
+
+		act = igt_sysfs_dir_id_to_name(dir, RPS_ACT_FREQ_MHZ);
+		req = igt_sysfs_dir_id_to_name(dir, RPS_CUR_FREQ_MHZ);
+		throttle_fmt = "throttle_reason_%s";
+	} else {
+		return NULL;
+	}
+
+	t = calloc(1, sizeof(*t));
+	igt_assert(t);
+	t->gt = gt;
+	t->interval_ms = max(interval_ms, 1u);
+	t->capacity = max(capacity, 1u);
+	t->ring = calloc(t->capacity, sizeof(*t->ring));
+	igt_assert(t->ring);
+
+	t->act_freq = open_optional(dir, act);
+	t->req_freq = open_optional(dir, req);
+	for (int i = 0; i < IGT_THROTTLE_NUM_REASONS; i++) {
+		snprintf(name, sizeof(name), throttle_fmt, throttle_names[i]);
+		t->throttle[i] = open_optional(dir, name);
+	}
+	close(dir);
+
+	t->energy = igt_hwmon_attr_open(drm_fd, "energy1_input");
+	for (int i = 1; i <= 3 && !t->temp; i++) {
+		snprintf(name, sizeof(name), "temp%d_input", i);
+		t->temp = igt_hwmon_attr_open(drm_fd, name);
+	}
+
+	pthread_mutex_init(&t->mutex, NULL);
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&t->cond, &attr);
+	pthread_condattr_destroy(&attr);
+
+	if (!t->act_freq) {
+		igt_debug("No frequency attributes on gt%d\n", gt);
+		igt_telemetry_close(t);
+		return NULL;
+	}
+
+	return t;
+}
+
+/**
+ * igt_telemetry_close:
+ * @t: telemetry from igt_telemetry_open(), may be NULL
+ *
+ * Stops sampling and releases @t.
+ */
+void igt_telemetry_close(struct igt_telemetry *t)
+{
+	if (!t)
+		return;
+
+	igt_telemetry_stop(t);
+
+	igt_sysfs_attr_close(t->act_freq);
+	igt_sysfs_attr_close(t->req_freq);
+	for (int i = 0; i < IGT_THROTTLE_NUM_REASONS; i++)
+		igt_sysfs_attr_close(t->throttle[i]);
+	igt_sysfs_attr_close(t->energy);
+	igt_sysfs_attr_close(t->temp);
+
+	pthread_cond_destroy(&t->cond);
+	pthread_mutex_destroy(&t->mutex);
+	free(t->ring);
+	free(t);
+}
+
+static void accumulate(struct igt_telemetry *t,
+		       const struct igt_telemetry_sample *s)
+{
+	struct igt_telemetry_summary *sum = &t->summary;
+
+	sum->samples++;
+	sum->act_min = min(sum->act_min, s->act_freq);
+	sum->act_max = max(sum->act_max, s->act_freq);
+	t->act_sum += s->act_freq;
+	t->req_sum += s->req_freq;
+
+	if (s->throttle)
+		sum->throttled++;
+	for (int i = 0; i < IGT_THROTTLE_NUM_REASONS; i++)
+		if (s->throttle & (1u << i))
+			sum->reasons[i]++;
+
+	if (s->power_mw >= 0) {
+		t->power_sum += s->power_mw;
+		t->power_samples++;
+		sum->power_max = max(sum->power_max, (double)s->power_mw);
+	}
+
+	if (s->temp_mc != INT32_MIN)
+		sum->temp_max = max(sum->temp_max, s->temp_mc / 1000.);
+}
+
+static void sample(struct igt_telemetry *t)
+{
+	struct igt_telemetry_sample *s = &t->ring[t->count % t->capacity];
+	uint64_t ns = now_ns();
+	uint64_t energy;
+	uint32_t val;
+	int temp;
+
+	memset(s, 0, sizeof(*s));
+	s->time_ns = ns - t->start_ns;
+
+	__igt_sysfs_attr_get_u32(t->act_freq, &s->act_freq);
+	if (t->req_freq)
+		__igt_sysfs_attr_get_u32(t->req_freq, &s->req_freq);
+
+	for (int i = 0; i < IGT_THROTTLE_NUM_REASONS; i++)
+		if (t->throttle[i] &&
+		    __igt_sysfs_attr_get_u32(t->throttle[i], &val) && val)
+			s->throttle |= 1u << i;
+
+	/* Energy is in uJ, averaged over the time since the last sample */
+	s->power_mw = -1;
+	if (t->energy && __igt_sysfs_attr_get_u64(t->energy, &energy)) {
+		if (t->last_energy_ns && ns > t->last_energy_ns &&
+		    energy >= t->last_energy)
+			s->power_mw = (energy - t->last_energy) * 1000000 /
+				      (ns - t->last_energy_ns);
+		t->last_energy = energy;
+		t->last_energy_ns = ns;
+	}
+
+	s->temp_mc = INT32_MIN;
+	if (t->temp && igt_sysfs_attr_scanf(t->temp, "%d", &temp) == 1)
+		s->temp_mc = temp;
+
+	accumulate(t, s);
+	t->count++;
+}
+
+static void *sampler(void *data)
+{
+	struct igt_telemetry *t = data;
+	struct timespec next;
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+
+	pthread_mutex_lock(&t->mutex);
+	while (!t->stop) {
+		struct timespec now;
+
+		sample(t);
+
+		next.tv_nsec += t->interval_ms * 1000000ul;
+		next.tv_sec += next.tv_nsec / NSEC_PER_SEC;
+		next.tv_nsec %= NSEC_PER_SEC;
+
+		/* Fell behind, drop the missed samples rather than bunch up */
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		if (igt_time_elapsed(&next, &now) > 0)
+			next = now;
+
+		while (!t->stop &&
+		       pthread_cond_timedwait(&t->cond, &t->mutex, &next) != ETIMEDOUT)
+			;
+	}
+	pthread_mutex_unlock(&t->mutex);
+
+	return NULL;
+}
+
+/**
+ * igt_telemetry_start:
+ * @t: telemetry
+ *
+ * Clears the trace and summary and starts sampling from a background
+ * thread, which does not take any signals.
+ */
+void igt_telemetry_start(struct igt_telemetry *t)
+{
+	sigset_t all, old;
+
+	igt_telemetry_stop(t);
+
+	t->count = 0;
+	t->act_sum = 0;
+	t->req_sum = 0;
+	t->power_sum = 0;
+	t->power_samples = 0;
+	t->last_energy_ns = 0;
+	memset(&t->summary, 0, sizeof(t->summary));
+	t->summary.act_min = UINT32_MAX;
+	t->summary.power_max = -1;
+	t->summary.temp_max = -273;
+
+	t->start_ns = now_ns();
+	t->stop = false;
+	t->owner = getpid();
+
+	/* Leave the signals, and the igt_fail() they may lead to, to the test */
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, &old);
+	igt_assert_eq(pthread_create(&t->thread, NULL, sampler, t), 0);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+	t->running = true;
+}
+
+/**
+ * igt_telemetry_stop:
+ * @t: telemetry
+ *
+ * Stops sampling, keeping the trace and summary until the next
+ * igt_telemetry_start(). Does nothing if not sampling, or when called from
+ * a child process of the one that started sampling.
+ */
+void igt_telemetry_stop(struct igt_telemetry *t)
+{
+	if (!t->running || t->owner != getpid())
+		return;
+
+	pthread_mutex_lock(&t->mutex);
+	t->stop = true;
+	pthread_cond_signal(&t->cond);
+	pthread_mutex_unlock(&t->mutex);
+
+	pthread_join(t->thread, NULL);
+	t->running = false;
+}
+
+/**
+ * igt_telemetry_get_summary:
+ * @t: telemetry
+ * @summary: output for the summary
+ *
+ * Summarizes every sample taken since igt_telemetry_start(), also while
+ * still sampling.
+ */
+void igt_telemetry_get_summary(struct igt_telemetry *t,
+			       struct igt_telemetry_summary *summary)
+{
+	pthread_mutex_lock(&t->mutex);
+
+	*summary = t->summary;
+	if (summary->samples) {
+		summary->act_mean = (double)t->act_sum / summary->samples;
+		summary->req_mean = (double)t->req_sum / summary->samples;
+	} else {
+		summary->act_min = 0;
+	}
+	summary->power_mean = t->power_samples ?
+		(double)t->power_sum / t->power_samples : -1;
+
+	pthread_mutex_unlock(&t->mutex);
+}
+
+/**
+ * igt_telemetry_num_samples:
+ * @t: telemetry
+ *
+ * Returns: The number of samples in the trace, at most the capacity.
+ */
+unsigned int igt_telemetry_num_samples(struct igt_telemetry *t)
+{
+	return min(t->count, t->capacity);
+}
+
+/**
+ * igt_telemetry_get_sample:
+ * @t: telemetry, not sampling
+ * @idx: index in the trace, oldest first
+ *
+ * Returns: The sample at @idx of the trace.
+ */
+const struct igt_telemetry_sample *
+igt_telemetry_get_sample(struct igt_telemetry *t, unsigned int idx)
+{
+	unsigned int first = t->count > t->capacity ? t->count % t->capacity : 0;
+
+	igt_assert(!t->running);
+	igt_assert(idx < igt_telemetry_num_samples(t));
+
+	return &t->ring[(first + idx) % t->capacity];
+}
+
+/**
+ * igt_telemetry_print:
+ * @t: telemetry, not sampling
+ * @name: what was traced, like the subtest name
+ *
+ * Logs the summary at info level and the trace at debug level.
+ */
+void igt_telemetry_print(struct igt_telemetry *t, const char *name)
+{
+	struct igt_telemetry_summary sum;
+	char buf[512];
+	int len;
+
+	igt_telemetry_get_summary(t, &sum);
+	if (!sum.samples)
+		return;
+
+	len = snprintf(buf, sizeof(buf),
+		       "%s: gt%d %u samples, freq %u/%.0f/%u MHz min/mean/max, requested %.0f MHz, throttled %.1f%%",
+		       name, t->gt, sum.samples, sum.act_min, sum.act_mean,
+		       sum.act_max, sum.req_mean,
+		       100. * sum.throttled / sum.samples);
+	for (int i = 0; i < IGT_THROTTLE_NUM_REASONS; i++)
+		if (sum.reasons[i] && len < sizeof(buf))
+			len += snprintf(buf + len, sizeof(buf) - len, " %s %.1f%%",
+					throttle_names[i],
+					100. * sum.reasons[i] / sum.samples);
+	if (sum.power_mean >= 0 && len < sizeof(buf))
+		len += snprintf(buf + len, sizeof(buf) - len,
+				", power %.1f/%.1f W mean/max",
+				sum.power_mean / 1000, sum.power_max / 1000);
+	if (sum.temp_max > -273 && len < sizeof(buf))
+		snprintf(buf + len, sizeof(buf) - len, ", temp max %.1f C",
+			 sum.temp_max);
+	igt_info("%s\n", buf);
+
+	for (unsigned int i = 0; i < igt_telemetry_num_samples(t); i++) {
+		const struct igt_telemetry_sample *s = igt_telemetry_get_sample(t, i);
+		char power[16] = "-", temp[16] = "-";
+
+		if (s->power_mw >= 0)
+			snprintf(power, sizeof(power), "%d mW", s->power_mw);
+		if (s->temp_mc != INT32_MIN)
+			snprintf(temp, sizeof(temp), "%.1f C", s->temp_mc / 1000.);
+
+		igt_debug("%s: %.3f ms act %u req %u MHz throttle 0x%x power %s temp %s\n",
+			  name, s->time_ns / 1e6, s->act_freq, s->req_freq,
+			  s->throttle, power, temp);
+	}
+}
+
+/**
+ * igt_telemetry_auto:
+ * @drm_fd: fd of an i915 or xe device
+ * @gt: GT to trace
+ * @interval_ms: time between two samples, or 0 for 10ms
+ *
+ * Opts the test into tracing @gt during every following subtest. When a
+ * subtest ends, igt_core logs the summary and trace, see
+ * igt_telemetry_print(). Usually called from the first igt_fixture, does
+ * nothing if the GT has no frequency attributes.
+ */
+void igt_telemetry_auto(int drm_fd, int gt, unsigned int interval_ms)
+{
+	igt_telemetry_close(auto_telemetry);
+	auto_telemetry = igt_telemetry_open(drm_fd, gt,
+					    interval_ms ?: TELEMETRY_AUTO_INTERVAL,
+					    TELEMETRY_AUTO_CAPACITY);
+}
+
+void __igt_telemetry_enter(void)
+{
+	if (auto_telemetry)
+		igt_telemetry_start(auto_telemetry);
+}
+
+void __igt_telemetry_leave(void)
+{
+	if (!auto_telemetry || !auto_telemetry->running ||
+	    auto_telemetry->owner != getpid())
+		return;
+
+	igt_telemetry_stop(auto_telemetry);
+	igt_telemetry_print(auto_telemetry, igt_subtest_name());
+}
@@ -0,0 +1,112 @@
+/* SPDX-License-Identifier: MIT */
+/*
+ * Copyright © 2025 Intel Corporation
+ */
+
+#ifndef IGT_TELEMETRY_H
+#define IGT_TELEMETRY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * igt_throttle_reason:
+ * @IGT_THROTTLE_PL1: sustained power limit
+ * @IGT_THROTTLE_PL2: burst power limit
+ * @IGT_THROTTLE_PL4: peak current limit
+ * @IGT_THROTTLE_PROCHOT: processor hot signal
+ * @IGT_THROTTLE_RATL: running average thermal limit
+ * @IGT_THROTTLE_THERMAL: thermal limit
+ * @IGT_THROTTLE_VR_TDC: voltage regulator current limit
+ * @IGT_THROTTLE_VR_THERMALERT: voltage regulator thermal alert
+ * @IGT_THROTTLE_NUM_REASONS: number of reasons
+ *
+ * Why the GT frequency is held below the requested one, as a bit index
+ * into #igt_telemetry_sample.throttle.
+ */
+enum igt_throttle_reason {
+	IGT_THROTTLE_PL1,
+	IGT_THROTTLE_PL2,
+	IGT_THROTTLE_PL4,
+	IGT_THROTTLE_PROCHOT,
+	IGT_THROTTLE_RATL,
+	IGT_THROTTLE_THERMAL,
+	IGT_THROTTLE_VR_TDC,
+	IGT_THROTTLE_VR_THERMALERT,
+	IGT_THROTTLE_NUM_REASONS
+};
+
+/**
+ * igt_telemetry_sample:
+ * @time_ns: time since igt_telemetry_start()
+ * @act_freq: actual GT frequency in MHz
+ * @req_freq: requested GT frequency in MHz
+ * @throttle: mask of the active #igt_throttle_reason
+ * @power_mw: average power since the previous sample, or -1
+ * @temp_mc: temperature in millidegrees Celsius, or INT32_MIN
+ */
+struct igt_telemetry_sample {
+	uint64_t time_ns;
+	uint32_t act_freq;
+	uint32_t req_freq;
+	uint32_t throttle;
+	int32_t power_mw;
+	int32_t temp_mc;
+};
+
+/**
+ * igt_telemetry_summary:
+ * @samples: number of samples taken
+ * @act_min: lowest actual frequency in MHz
+ * @act_max: highest actual frequency in MHz
+ * @act_mean: mean actual frequency in MHz
+ * @req_mean: mean requested frequency in MHz
+ * @throttled: samples with any throttle reason active
+ * @reasons: samples each #igt_throttle_reason was active in
+ * @power_mean: mean power in mW, or -1 without hwmon energy
+ * @power_max: highest power in mW, or -1 without hwmon energy
+ * @temp_max: highest temperature in degrees Celsius, or -273 without
+ *            hwmon temperature
+ *
+ * Covers every sample taken, including those already dropped from the
+ * trace.
+ */
+struct igt_telemetry_summary {
+	unsigned int samples;
+	uint32_t act_min;
+	uint32_t act_max;
+	double act_mean;
+	double req_mean;
+	unsigned int throttled;
+	unsigned int reasons[IGT_THROTTLE_NUM_REASONS];
+	double power_mean;
+	double power_max;
+	double temp_max;
+};
+
+struct igt_telemetry;
+
+const char *igt_throttle_reason_name(enum igt_throttle_reason reason);
+
+struct igt_telemetry *igt_telemetry_open(int drm_fd, int gt,
+					 unsigned int interval_ms,
+					 unsigned int capacity);
+void igt_telemetry_close(struct igt_telemetry *t);
+
+void igt_telemetry_start(struct igt_telemetry *t);
+void igt_telemetry_stop(struct igt_telemetry *t);
+
+void igt_telemetry_get_summary(struct igt_telemetry *t,
+			       struct igt_telemetry_summary *summary);
+unsigned int igt_telemetry_num_samples(struct igt_telemetry *t);
+const struct igt_telemetry_sample *
+igt_telemetry_get_sample(struct igt_telemetry *t, unsigned int idx);
+void igt_telemetry_print(struct igt_telemetry *t, const char *name);
+
+void igt_telemetry_auto(int drm_fd, int gt, unsigned int interval_ms);
+
+/* igt_core internal, traces each subtest of tests calling igt_telemetry_auto() */
+void __igt_telemetry_enter(void);
+void __igt_telemetry_leave(void);
+
+#endif /* IGT_TELEMETRY_H */
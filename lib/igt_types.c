@@ -6,6 +6,7 @@
 #include <unistd.h>
 
 #include "drmtest.h"
+#include "i915/gem_mman.h"
 #include "igt_types.h"
 #include "xe/xe_query.h"
 
@@ -18,6 +19,8 @@ void igt_cleanup_fd(volatile int *fd)
 	if (is_xe_device(*fd))
 		xe_device_put(*fd);
 
+	gem_mmap_cache_flush(*fd);
+
 	close(*fd);
 	*fd = -1;
 }
@@ -68,15 +68,138 @@ igt_v3d_create_bo(int fd, size_t size)
 	return bo;
 }
 
+/*
+ * Size buckets of the BO cache, powers of two from a page to 8MiB. Bigger
+ * BOs are rare enough in the tests to be allocated as they come.
+ */
+#define V3D_BO_CACHE_BUCKETS 12
+
+struct v3d_bo_cache {
+	int fd;
+	uint64_t size;
+	uint64_t max_size;
+	struct igt_list_head buckets[V3D_BO_CACHE_BUCKETS];
+};
+
+static bool v3d_bo_cache_put(struct v3d_bo_cache *cache, struct v3d_bo *bo)
+{
+	unsigned int bucket = ffs(bo->size / PAGE_SIZE) - 1;
+
+	if (cache->size + bo->size > cache->max_size)
+		return false;
+
+	/* Oldest first, they are the most likely to be idle by reuse */
+	igt_list_add_tail(&bo->link, &cache->buckets[bucket]);
+	cache->size += bo->size;
+
+	return true;
+}
+
 void
 igt_v3d_free_bo(int fd, struct v3d_bo *bo)
 {
+	if (bo->cache && v3d_bo_cache_put(bo->cache, bo))
+		return;
+
 	if (bo->map)
 		munmap(bo->map, bo->size);
 	gem_close(fd, bo->handle);
 	free(bo);
 }
 
+static bool v3d_bo_busy(int fd, struct v3d_bo *bo)
+{
+	struct drm_v3d_wait_bo arg = {
+		.handle = bo->handle,
+	};
+
+	return igt_ioctl(fd, DRM_IOCTL_V3D_WAIT_BO, &arg) && errno == ETIME;
+}
+
+/**
+ * igt_v3d_bo_cache_create:
+ * @fd: device file descriptor
+ * @max_size: the most bytes of idle BOs kept around
+ *
+ * Creates a cache of BOs bucketed by size, for tests and benchmarks
+ * submitting many jobs. BOs from igt_v3d_bo_cache_alloc() go back to the
+ * cache on igt_v3d_free_bo(), mapping included, so the next allocation of
+ * the same bucket skips the BO creation, the CMA allocation behind it and
+ * the mmap.
+ *
+ * Returns the new cache.
+ */
+struct v3d_bo_cache *igt_v3d_bo_cache_create(int fd, uint64_t max_size)
+{
+	struct v3d_bo_cache *cache = calloc(1, sizeof(*cache));
+
+	cache->fd = fd;
+	cache->max_size = max_size;
+	for (int i = 0; i < V3D_BO_CACHE_BUCKETS; i++)
+		IGT_INIT_LIST_HEAD(&cache->buckets[i]);
+
+	return cache;
+}
+
+/**
+ * igt_v3d_bo_cache_alloc:
+ * @cache: BO cache
+ * @size: size of the BO in bytes
+ *
+ * Takes the oldest BO of the bucket of @size out of @cache if the GPU is
+ * done with it, or creates one otherwise. The size is rounded up to the
+ * bucket size and a reused BO keeps the contents and the mapping it had.
+ *
+ * Returns the BO, to be freed with igt_v3d_free_bo().
+ */
+struct v3d_bo *igt_v3d_bo_cache_alloc(struct v3d_bo_cache *cache, size_t size)
+{
+	unsigned int pages = DIV_ROUND_UP(size, PAGE_SIZE);
+	unsigned int bucket = pages > 1 ? igt_fls(pages - 1) : 0;
+	struct igt_list_head *head;
+	struct v3d_bo *bo;
+
+	if (bucket >= V3D_BO_CACHE_BUCKETS)
+		return igt_v3d_create_bo(cache->fd, size);
+
+	head = &cache->buckets[bucket];
+	if (!igt_list_empty(head)) {
+		bo = igt_list_first_entry(head, bo, link);
+		if (!v3d_bo_busy(cache->fd, bo)) {
+			igt_list_del(&bo->link);
+			cache->size -= bo->size;
+			return bo;
+		}
+	}
+
+	bo = igt_v3d_create_bo(cache->fd, (size_t)PAGE_SIZE << bucket);
+	bo->cache = cache;
+
+	return bo;
+}
+
+/**
+ * igt_v3d_bo_cache_destroy:
+ * @cache: BO cache
+ *
+ * Frees the BOs held by @cache and the cache itself. All the BOs allocated
+ * from it must have been freed before.
+ */
+void igt_v3d_bo_cache_destroy(struct v3d_bo_cache *cache)
+{
+	struct v3d_bo *bo, *tmp;
+
+	for (int i = 0; i < V3D_BO_CACHE_BUCKETS; i++) {
+		igt_list_for_each_entry_safe(bo, tmp, &cache->buckets[i], link) {
+			igt_list_del(&bo->link);
+			bo->cache = NULL;
+			igt_v3d_free_bo(cache->fd, bo);
+		}
+	}
+
+	free(cache);
+}
+
 uint32_t
 igt_v3d_get_bo_offset(int fd, uint32_t handle)
 {
@@ -135,6 +258,10 @@ igt_v3d_mmap_bo(int fd, uint32_t handle, uint32_t size, unsigned prot)
 
 void igt_v3d_bo_mmap(int fd, struct v3d_bo *bo)
 {
+	/* BOs reused from a cache keep their mapping */
+	if (bo->map)
+		return;
+
 	bo->map = igt_v3d_mmap_bo(fd, bo->handle, bo->size,
 				  PROT_READ | PROT_WRITE);
 	igt_assert(bo->map);
@@ -193,9 +320,18 @@ void igt_v3d_set_multisync(struct drm_v3d_multi_sync *ms, enum v3d_queue wait_st
 	ms->wait_stage = wait_stage;
 }
 
-static void v3d_cl_init(int fd, struct v3d_cl **cl)
+static struct v3d_bo *
+v3d_create_bo(int fd, struct v3d_bo_cache *cache, size_t size)
+{
+	if (cache)
+		return igt_v3d_bo_cache_alloc(cache, size);
+
+	return igt_v3d_create_bo(fd, size);
+}
+
+static void v3d_cl_init(int fd, struct v3d_bo_cache *cache, struct v3d_cl **cl)
 {
-	struct v3d_bo *bo = igt_v3d_create_bo(fd, PAGE_SIZE);
+	struct v3d_bo *bo = v3d_create_bo(fd, cache, PAGE_SIZE);
 
 	*cl = calloc(1, sizeof(**cl));
 
@@ -213,7 +349,15 @@ static void v3d_cl_destroy(int fd, struct v3d_cl *cl)
 	free(cl);
 }
 
-struct v3d_cl_job *igt_v3d_noop_job(int fd)
+/**
+ * __igt_v3d_noop_job:
+ * @fd: device file descriptor
+ * @cache: BO cache to allocate the job BOs from, or NULL
+ *
+ * Like igt_v3d_noop_job(), with the BOs of the job taken from @cache when
+ * given, and returned to it by igt_v3d_free_cl_job().
+ */
+struct v3d_cl_job *__igt_v3d_noop_job(int fd, struct v3d_bo_cache *cache)
 {
 	struct v3d_cl_job *job;
 	struct v3d_cl_reloc tile_list_start;
@@ -221,12 +365,12 @@ struct v3d_cl_job *igt_v3d_noop_job(int fd)
 
 	job = calloc(1, sizeof(*job));
 
-	job->tile_alloc = igt_v3d_create_bo(fd, 131 * PAGE_SIZE);
-	job->tile_state = igt_v3d_create_bo(fd, PAGE_SIZE);
+	job->tile_alloc = v3d_create_bo(fd, cache, 131 * PAGE_SIZE);
+	job->tile_state = v3d_create_bo(fd, cache, PAGE_SIZE);
 
-	v3d_cl_init(fd, &job->bcl);
-	v3d_cl_init(fd, &job->rcl);
-	v3d_cl_init(fd, &job->icl);
+	v3d_cl_init(fd, cache, &job->bcl);
+	v3d_cl_init(fd, cache, &job->rcl);
+	v3d_cl_init(fd, cache, &job->icl);
 
 	cl_emit(job->bcl, NUMBER_OF_LAYERS, config) {
 		config.number_of_layers = 1;
@@ -344,6 +488,11 @@ struct v3d_cl_job *igt_v3d_noop_job(int fd)
 	return job;
 }
 
+struct v3d_cl_job *igt_v3d_noop_job(int fd)
+{
+	return __igt_v3d_noop_job(fd, NULL);
+}
+
 void igt_v3d_free_cl_job(int fd, struct v3d_cl_job *job)
 {
 	free(from_user_pointer(job->submit->bo_handles));
@@ -357,14 +506,14 @@ void igt_v3d_free_cl_job(int fd, struct v3d_cl_job *job)
 }
 
 /**
- * igt_v3d_empty_shader:
+ * __igt_v3d_empty_shader:
  * @fd: device file descriptor
+ * @cache: BO cache to allocate the job BOs from, or NULL
  *
- * This helper returns a simple compute dispatch job. It sets the
- * configurations (cfg) needed for the job and has the assembled instructions
- * necessary to process an empty shader.
+ * Like igt_v3d_empty_shader(), with the BOs of the job taken from @cache
+ * when given, and returned to it by igt_v3d_free_csd_job().
  */
-struct v3d_csd_job *igt_v3d_empty_shader(int fd)
+struct v3d_csd_job *__igt_v3d_empty_shader(int fd, struct v3d_bo_cache *cache)
 {
 	struct v3d_csd_job *job;
 	uint32_t *bos;
@@ -378,8 +527,8 @@ struct v3d_csd_job *igt_v3d_empty_shader(int fd)
 
 	job = calloc(1, sizeof(*job));
 
-	job->shader_assembly = igt_v3d_create_bo(fd, PAGE_SIZE);
-	job->cl = igt_v3d_create_bo(fd, PAGE_SIZE);
+	job->shader_assembly = v3d_create_bo(fd, cache, PAGE_SIZE);
+	job->cl = v3d_create_bo(fd, cache, PAGE_SIZE);
 	job->submit = calloc(1, sizeof(*job->submit));
 
 	igt_v3d_bo_mmap(fd, job->shader_assembly);
@@ -415,6 +564,19 @@ struct v3d_csd_job *igt_v3d_empty_shader(int fd)
 	return job;
 }
 
+/**
+ * igt_v3d_empty_shader:
+ * @fd: device file descriptor
+ *
+ * This helper returns a simple compute dispatch job. It sets the
+ * configurations (cfg) needed for the job and has the assembled instructions
+ * necessary to process an empty shader.
+ */
+struct v3d_csd_job *igt_v3d_empty_shader(int fd)
+{
+	return __igt_v3d_empty_shader(fd, NULL);
+}
+
 /**
  * igt_v3d_free_csd_job:
  * @fd: device file descriptor
@@ -27,6 +27,7 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "igt_list.h"
 #include "v3d_drm.h"
 
 #define PAGE_SIZE 4096
@@ -43,12 +44,17 @@
 #define V3D_CSD_CFG5_THREADING (1 << 0)
 
 struct v3d_cl;
+struct v3d_bo_cache;
 
 struct v3d_bo {
 	int handle;
 	uint32_t offset;
 	uint32_t size;
 	void *map;
+
+	/* The cache the BO returns to when freed, if any */
+	struct v3d_bo_cache *cache;
+	struct igt_list_head link;
 };
 
 struct v3d_cl_job {
@@ -69,6 +75,10 @@ struct v3d_csd_job {
 struct v3d_bo *igt_v3d_create_bo(int fd, size_t size);
 void igt_v3d_free_bo(int fd, struct v3d_bo *bo);
 
+struct v3d_bo_cache *igt_v3d_bo_cache_create(int fd, uint64_t max_size);
+struct v3d_bo *igt_v3d_bo_cache_alloc(struct v3d_bo_cache *cache, size_t size);
+void igt_v3d_bo_cache_destroy(struct v3d_bo_cache *cache);
+
 /* IOCTL wrappers */
 uint32_t igt_v3d_get_bo_offset(int fd, uint32_t handle);
 uint32_t igt_v3d_get_param(int fd, enum drm_v3d_param param);
@@ -84,9 +94,11 @@ void igt_v3d_perfmon_destroy(int fd, uint32_t id);
 
 void igt_v3d_set_multisync(struct drm_v3d_multi_sync *ms, enum v3d_queue wait_stage);
 
+struct v3d_cl_job *__igt_v3d_noop_job(int fd, struct v3d_bo_cache *cache);
 struct v3d_cl_job *igt_v3d_noop_job(int fd);
 void igt_v3d_free_cl_job(int fd, struct v3d_cl_job *job);
 
+struct v3d_csd_job *__igt_v3d_empty_shader(int fd, struct v3d_bo_cache *cache);
 struct v3d_csd_job *igt_v3d_empty_shader(int fd);
 void igt_v3d_free_csd_job(int fd, struct v3d_csd_job *job);
 
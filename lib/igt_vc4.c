@@ -24,6 +24,7 @@
 #include "drmtest.h"
 #include "igt_aux.h"
 #include "igt_fb.h"
+#include "igt_list.h"
 #include "igt_vc4.h"
 #include "ioctl_wrappers.h"
 #include "vc4_packet.h"
@@ -72,20 +73,20 @@ bool igt_vc4_is_v3d(int fd)
 }
 
 /**
- * igt_vc4_get_cleared_bo:
+ * igt_vc4_clear_bo:
  * @fd: device file descriptor
- * @size: size of the BO in bytes
+ * @handle: BO handle
+ * @size: size of the BO in bytes, a multiple of 4KiB
  * @clearval: u32 value that the buffer should be completely cleared with
  *
- * This helper returns a new BO with the given size, which has just been
- * cleared using the render engine.
+ * This helper submits a job clearing the BO with the render engine. It
+ * doesn't wait for the job to complete.
  */
-uint32_t igt_vc4_get_cleared_bo(int fd, size_t size, uint32_t clearval)
+void igt_vc4_clear_bo(int fd, uint32_t handle, size_t size, uint32_t clearval)
 {
 	/* A single row will be a page. */
 	uint32_t width = 1024;
 	uint32_t height = size / (width * 4);
-	uint32_t handle = igt_vc4_create_bo(fd, size);
 	struct drm_vc4_submit_cl submit = {
 		.color_write = {
 			.hindex = 0,
@@ -112,6 +113,22 @@ uint32_t igt_vc4_get_cleared_bo(int fd, size_t size, uint32_t clearval)
 	igt_assert_eq_u32(width * height * 4, size);
 
 	do_ioctl(fd, DRM_IOCTL_VC4_SUBMIT_CL, &submit);
+}
+
+/**
+ * igt_vc4_get_cleared_bo:
+ * @fd: device file descriptor
+ * @size: size of the BO in bytes
+ * @clearval: u32 value that the buffer should be completely cleared with
+ *
+ * This helper returns a new BO with the given size, which has just been
+ * cleared using the render engine.
+ */
+uint32_t igt_vc4_get_cleared_bo(int fd, size_t size, uint32_t clearval)
+{
+	uint32_t handle = igt_vc4_create_bo(fd, size);
+
+	igt_vc4_clear_bo(fd, handle, size, clearval);
 
 	return handle;
 }
@@ -128,6 +145,167 @@ igt_vc4_create_bo(int fd, size_t size)
 	return create.handle;
 }
 
+/**
+ * igt_vc4_bo_busy:
+ * @fd: device file descriptor
+ * @handle: BO handle
+ *
+ * Returns whether the GPU is still using the BO.
+ */
+bool igt_vc4_bo_busy(int fd, uint32_t handle)
+{
+	struct drm_vc4_wait_bo arg = {
+		.handle = handle,
+	};
+
+	return igt_ioctl(fd, DRM_IOCTL_VC4_WAIT_BO, &arg) && errno == ETIME;
+}
+
+/*
+ * Size buckets of the BO cache, powers of two from a page to 8MiB. Bigger
+ * BOs are rare enough in the tests to be allocated as they come.
+ */
+#define VC4_BO_CACHE_BUCKETS 12
+
+struct vc4_bo_cache_entry {
+	struct igt_list_head link;
+	uint32_t handle;
+};
+
+struct vc4_bo_cache {
+	int fd;
+	bool madvise;
+	uint64_t size;
+	uint64_t max_size;
+	struct igt_list_head buckets[VC4_BO_CACHE_BUCKETS];
+};
+
+static unsigned int vc4_bo_cache_bucket(size_t size)
+{
+	unsigned int pages = DIV_ROUND_UP(size, VC4_GPU_PAGE_SIZE);
+
+	return pages > 1 ? igt_fls(pages - 1) : 0;
+}
+
+/**
+ * igt_vc4_bo_cache_create:
+ * @fd: device file descriptor
+ * @max_size: the most bytes of idle BOs kept around
+ *
+ * Creates a cache of BOs bucketed by size, for tests and benchmarks
+ * submitting many jobs, as BO allocation from CMA is expensive. When the
+ * kernel supports it, the idle BOs of the cache are marked purgeable, so
+ * they don't hold on to CMA the kernel runs short of.
+ *
+ * Returns the new cache.
+ */
+struct vc4_bo_cache *igt_vc4_bo_cache_create(int fd, uint64_t max_size)
+{
+	struct vc4_bo_cache *cache = calloc(1, sizeof(*cache));
+
+	cache->fd = fd;
+	cache->max_size = max_size;
+	cache->madvise = igt_vc4_get_param(fd, DRM_VC4_PARAM_SUPPORTS_MADVISE);
+	for (int i = 0; i < VC4_BO_CACHE_BUCKETS; i++)
+		IGT_INIT_LIST_HEAD(&cache->buckets[i]);
+
+	return cache;
+}
+
+/**
+ * igt_vc4_bo_cache_alloc:
+ * @cache: BO cache
+ * @size: size of the BO in bytes
+ *
+ * Takes the oldest BO of the bucket of @size out of @cache if the GPU is
+ * done with it and the kernel didn't purge it, or creates one otherwise.
+ * The size is rounded up to the bucket size and the contents of a reused
+ * BO are undefined.
+ *
+ * Returns the BO handle, to be freed with igt_vc4_bo_cache_free().
+ */
+uint32_t igt_vc4_bo_cache_alloc(struct vc4_bo_cache *cache, size_t size)
+{
+	unsigned int bucket = vc4_bo_cache_bucket(size);
+	struct vc4_bo_cache_entry *entry, *tmp;
+
+	if (bucket >= VC4_BO_CACHE_BUCKETS)
+		return igt_vc4_create_bo(cache->fd, size);
+
+	igt_list_for_each_entry_safe(entry, tmp, &cache->buckets[bucket], link) {
+		uint32_t handle = entry->handle;
+
+		if (igt_vc4_bo_busy(cache->fd, handle))
+			break;
+
+		igt_list_del(&entry->link);
+		cache->size -= (uint64_t)VC4_GPU_PAGE_SIZE << bucket;
+		free(entry);
+
+		if (!cache->madvise || igt_vc4_purgeable_bo(cache->fd, handle,
+							    false))
+			return handle;
+
+		/* Purged under memory pressure, try the next one */
+		gem_close(cache->fd, handle);
+	}
+
+	return igt_vc4_create_bo(cache->fd, (size_t)VC4_GPU_PAGE_SIZE << bucket);
+}
+
+/**
+ * igt_vc4_bo_cache_free:
+ * @cache: BO cache
+ * @handle: BO handle from igt_vc4_bo_cache_alloc()
+ * @size: size the BO was allocated with
+ *
+ * Returns the BO to @cache, marked purgeable, or closes it if @cache is
+ * full. The BO must not be mapped anymore.
+ */
+void igt_vc4_bo_cache_free(struct vc4_bo_cache *cache, uint32_t handle,
+			   size_t size)
+{
+	unsigned int bucket = vc4_bo_cache_bucket(size);
+	uint64_t bucket_size = (uint64_t)VC4_GPU_PAGE_SIZE << bucket;
+	struct vc4_bo_cache_entry *entry;
+
+	if (bucket >= VC4_BO_CACHE_BUCKETS ||
+	    cache->size + bucket_size > cache->max_size) {
+		gem_close(cache->fd, handle);
+		return;
+	}
+
+	if (cache->madvise)
+		igt_vc4_purgeable_bo(cache->fd, handle, true);
+
+	entry = malloc(sizeof(*entry));
+	entry->handle = handle;
+	/* Oldest first, they are the most likely to be idle by reuse */
+	igt_list_add_tail(&entry->link, &cache->buckets[bucket]);
+	cache->size += bucket_size;
+}
+
+/**
+ * igt_vc4_bo_cache_destroy:
+ * @cache: BO cache
+ *
+ * Closes the BOs held by @cache and frees the cache.
+ */
+void igt_vc4_bo_cache_destroy(struct vc4_bo_cache *cache)
+{
+	struct vc4_bo_cache_entry *entry, *tmp;
+
+	for (int i = 0; i < VC4_BO_CACHE_BUCKETS; i++) {
+		igt_list_for_each_entry_safe(entry, tmp, &cache->buckets[i],
+					     link) {
+			gem_close(cache->fd, entry->handle);
+			free(entry);
+		}
+	}
+
+	free(cache);
+}
+
 void *
 igt_vc4_mmap_bo(int fd, uint32_t handle, uint32_t size, unsigned prot)
 {
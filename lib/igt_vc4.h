@@ -33,8 +33,18 @@
 
 #define VC4_GPU_PAGE_SIZE 4096
 
+struct vc4_bo_cache;
+
+void igt_vc4_clear_bo(int fd, uint32_t handle, size_t size, uint32_t clearval);
 uint32_t igt_vc4_get_cleared_bo(int fd, size_t size, uint32_t clearval);
 int igt_vc4_create_bo(int fd, size_t size);
+bool igt_vc4_bo_busy(int fd, uint32_t handle);
+
+struct vc4_bo_cache *igt_vc4_bo_cache_create(int fd, uint64_t max_size);
+uint32_t igt_vc4_bo_cache_alloc(struct vc4_bo_cache *cache, size_t size);
+void igt_vc4_bo_cache_free(struct vc4_bo_cache *cache, uint32_t handle,
+			   size_t size);
+void igt_vc4_bo_cache_destroy(struct vc4_bo_cache *cache);
 void *igt_vc4_mmap_bo(int fd, uint32_t handle, uint32_t size, unsigned prot);
 uint64_t igt_vc4_get_param(int fd, uint32_t param);
 bool igt_vc4_purgeable_bo(int fd, int handle, bool purgeable);
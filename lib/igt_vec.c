@@ -27,15 +27,27 @@
 #include "igt_core.h"
 #include "igt_vec.h"
 
+static bool igt_vec_is_inline(const struct igt_vec *vec)
+{
+	return vec->elems == (void *)vec->inline_elems;
+}
+
 void igt_vec_init(struct igt_vec *vec, int elem_size)
 {
 	memset(vec, 0, sizeof(*vec));
 	vec->elem_size = elem_size;
+
+	/* Start with the inline storage if it fits at least a few elements */
+	if (elem_size <= (int)sizeof(vec->inline_elems) / 2) {
+		vec->elems = vec->inline_elems;
+		vec->size = sizeof(vec->inline_elems) / elem_size;
+	}
 }
 
 void igt_vec_fini(struct igt_vec *vec)
 {
-	free(vec->elems);
+	if (!igt_vec_is_inline(vec))
+		free(vec->elems);
 	memset(vec, 0, sizeof(*vec));
 }
 
@@ -46,20 +58,76 @@ void *igt_vec_elem(const struct igt_vec *vec, int idx)
 	return vec->elems + idx * vec->elem_size;
 }
 
-static void *igt_vec_grow(struct igt_vec *vec)
+static void igt_vec_resize(struct igt_vec *vec, int size)
+{
+	void *elems;
+
+	if (igt_vec_is_inline(vec)) {
+		elems = malloc(size * vec->elem_size);
+		igt_assert(elems);
+		memcpy(elems, vec->elems, vec->len * vec->elem_size);
+	} else {
+		elems = realloc(vec->elems, size * vec->elem_size);
+		igt_assert(elems);
+	}
+
+	vec->elems = elems;
+	vec->size = size;
+}
+
+/**
+ * igt_vec_reserve:
+ * @vec: vector
+ * @count: number of elements
+ *
+ * Makes sure @vec can hold @count elements without reallocating.
+ */
+void igt_vec_reserve(struct igt_vec *vec, int count)
 {
-	if (vec->len++ >= vec->size) {
-		vec->size = vec->size ? vec->size * 2 : 8;
-		vec->elems = realloc(vec->elems, vec->size * vec->elem_size);
-		igt_assert(vec->elems);
+	igt_assert(count >= 0);
+
+	if (count > vec->size)
+		igt_vec_resize(vec, count);
+}
+
+static void *igt_vec_grow(struct igt_vec *vec, int count)
+{
+	int len = vec->len;
+
+	if (len + count > vec->size) {
+		int size = vec->size ? vec->size * 2 : 8;
+
+		while (size < len + count)
+			size *= 2;
+
+		igt_vec_resize(vec, size);
 	}
 
-	return igt_vec_elem(vec, vec->len - 1);
+	vec->len += count;
+
+	return vec->elems + len * vec->elem_size;
 }
 
 void igt_vec_push(struct igt_vec *vec, void *elem)
 {
-	memcpy(igt_vec_grow(vec), elem, vec->elem_size);
+	memcpy(igt_vec_grow(vec, 1), elem, vec->elem_size);
+}
+
+/**
+ * igt_vec_push_n:
+ * @vec: vector
+ * @elems: array of elements
+ * @count: number of elements in @elems
+ *
+ * Appends @count elements from @elems to the end of @vec, growing the
+ * storage at most once.
+ */
+void igt_vec_push_n(struct igt_vec *vec, const void *elems, int count)
+{
+	igt_assert(count >= 0);
+
+	if (count)
+		memcpy(igt_vec_grow(vec, count), elems, count * vec->elem_size);
 }
 
 int igt_vec_length(const struct igt_vec *vec)
@@ -79,11 +147,29 @@ int igt_vec_index(const struct igt_vec *vec, void *elem)
 
 void igt_vec_remove(struct igt_vec *vec, int idx)
 {
-	igt_assert(idx >= 0 && idx < vec->len);
+	void *elem = igt_vec_elem(vec, idx);
 
-	memmove(igt_vec_elem(vec, idx),
-		igt_vec_elem(vec, idx + 1),
+	memmove(elem, elem + vec->elem_size,
 		(vec->len - 1 - idx) * vec->elem_size);
 
 	vec->len--;
 }
+
+/**
+ * igt_vec_swap_remove:
+ * @vec: vector
+ * @idx: index of the element to remove
+ *
+ * Removes the element at @idx by moving the last element into its place.
+ * Unlike igt_vec_remove() this doesn't preserve the order of elements but
+ * runs in constant time.
+ */
+void igt_vec_swap_remove(struct igt_vec *vec, int idx)
+{
+	void *elem = igt_vec_elem(vec, idx);
+
+	if (idx != vec->len - 1)
+		memcpy(elem, igt_vec_elem(vec, vec->len - 1), vec->elem_size);
+
+	vec->len--;
+}
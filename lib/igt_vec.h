@@ -24,17 +24,29 @@
 #ifndef __IGT_VEC_H__
 #define __IGT_VEC_H__
 
+#include <stdint.h>
+
+#define IGT_VEC_INLINE_SIZE 64
+
+/*
+ * Small vectors live in the inline storage, so a struct igt_vec must
+ * not be copied by value.
+ */
 struct igt_vec {
 	void *elems;
 	int elem_size, size, len;
+	uint64_t inline_elems[IGT_VEC_INLINE_SIZE / sizeof(uint64_t)];
 };
 
 void igt_vec_init(struct igt_vec *vec, int elem_size);
 void igt_vec_fini(struct igt_vec *vec);
+void igt_vec_reserve(struct igt_vec *vec, int count);
 void igt_vec_push(struct igt_vec *vec, void *elem);
+void igt_vec_push_n(struct igt_vec *vec, const void *elems, int count);
 int igt_vec_length(const struct igt_vec *vec);
 void *igt_vec_elem(const struct igt_vec *vec, int idx);
 int igt_vec_index(const struct igt_vec *vec, void *elem);
 void igt_vec_remove(struct igt_vec *vec, int idx);
+void igt_vec_swap_remove(struct igt_vec *vec, int idx);
 
 #endif /* __IGT_VEC_H__ */
@@ -8,7 +8,6 @@
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
-#include <ftw.h>
 #include <limits.h>
 #include <stddef.h>
 #include <stdio.h>
@@ -249,6 +248,129 @@ static bool detach_pipeline_item(igt_vkms_t *dev,
 	return ret == 0;
 }
 
+/*
+ * The dirfd based helpers below are used to build and tear down whole
+ * pipelines: the item directories are opened once and every item and
+ * attribute is then reached relative to them, instead of resolving the full
+ * configfs path again for each of them.
+ */
+struct vkms_dirs {
+	int dev;
+	int items[VKMS_PIPELINE_ITEM_CONNECTOR + 1];
+};
+
+static void open_device_dirs(igt_vkms_t *dev, struct vkms_dirs *dirs)
+{
+	int i;
+
+	dirs->dev = open(dev->path, O_RDONLY | O_DIRECTORY);
+	igt_assert_f(dirs->dev >= 0, "Error opening '%s'. Got errno=%d (%s)\n",
+		     dev->path, errno, strerror(errno));
+
+	for (i = 0; i < ARRAY_SIZE(dirs->items); i++) {
+		const char *name = get_pipeline_item_dir_name(i);
+
+		dirs->items[i] = openat(dirs->dev, name,
+					O_RDONLY | O_DIRECTORY);
+		igt_assert_f(dirs->items[i] >= 0,
+			     "Error opening '%s/%s'. Got errno=%d (%s)\n",
+			     dev->path, name, errno, strerror(errno));
+	}
+}
+
+static void close_device_dirs(struct vkms_dirs *dirs)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(dirs->items); i++)
+		close(dirs->items[i]);
+	close(dirs->dev);
+}
+
+static void add_pipeline_item_at(struct vkms_dirs *dirs,
+				 enum vkms_pipeline_item item, const char *name)
+{
+	int ret;
+
+	ret = mkdirat(dirs->items[item], name, 0777);
+	igt_assert_f(ret == 0,
+		     "Unable to mkdir directory '%s/%s'. Got errno=%d (%s)\n",
+		     get_pipeline_item_dir_name(item), name, errno,
+		     strerror(errno));
+}
+
+static void write_int_at(struct vkms_dirs *dirs, enum vkms_pipeline_item item,
+			 const char *name, const char *filename, int value)
+{
+	char path[PATH_MAX];
+	int fd, ret;
+
+	ret = snprintf(path, sizeof(path), "%s/%s", name, filename);
+	igt_assert(ret >= 0 && ret < sizeof(path));
+
+	fd = openat(dirs->items[item], path, O_WRONLY);
+	igt_assert_f(fd >= 0, "Error opening '%s/%s'\n",
+		     get_pipeline_item_dir_name(item), path);
+
+	ret = dprintf(fd, "%d", value);
+	close(fd);
+	igt_assert_f(ret > 0, "Error writing to '%s/%s'\n",
+		     get_pipeline_item_dir_name(item), path);
+}
+
+static bool attach_pipeline_item_at(igt_vkms_t *dev, struct vkms_dirs *dirs,
+				    enum vkms_pipeline_item src_item,
+				    const char *src_item_name,
+				    enum vkms_pipeline_item dst_item,
+				    const char *dst_item_name)
+{
+	char link_path[PATH_MAX];
+	char dst_path[PATH_MAX];
+	int ret;
+
+	ret = snprintf(link_path, sizeof(link_path), "%s/%s/%s", src_item_name,
+		       get_attach_dir_name(src_item), dst_item_name);
+	igt_assert(ret >= 0 && ret < sizeof(link_path));
+
+	/* configfs resolves the target itself, it has to be an absolute path */
+	get_pipeline_item_path(dev, dst_item, dst_item_name, dst_path,
+			       sizeof(dst_path));
+
+	ret = symlinkat(dst_path, dirs->items[src_item], link_path);
+	return ret == 0;
+}
+
+static int for_each_dir_entry(int parent, const char *path,
+			      int (*fn)(int dirfd, const char *name,
+					const void *data),
+			      const void *data)
+{
+	struct dirent *ent;
+	DIR *dir;
+	int fd, ret = 0;
+
+	fd = openat(parent, path, O_RDONLY | O_DIRECTORY);
+	if (fd < 0)
+		return -1;
+
+	dir = fdopendir(fd);
+	if (!dir) {
+		close(fd);
+		return -1;
+	}
+
+	while (!ret && (ent = readdir(dir))) {
+		if (strcmp(ent->d_name, ".") == 0 ||
+		    strcmp(ent->d_name, "..") == 0)
+			continue;
+
+		ret = fn(dirfd(dir), ent->d_name, data);
+	}
+
+	closedir(dir);
+	return ret;
+}
+
 /**
  * igt_require_vkms_configfs:
  *
@@ -491,6 +613,7 @@ igt_vkms_t *igt_vkms_device_create_from_config(igt_vkms_config_t *cfg)
 	igt_vkms_crtc_config_t *crtc;
 	igt_vkms_encoder_config_t *encoder;
 	igt_vkms_connector_config_t *connector;
+	struct vkms_dirs dirs;
 	const char *name;
 	int n, i;
 
@@ -501,14 +624,16 @@ igt_vkms_t *igt_vkms_device_create_from_config(igt_vkms_config_t *cfg)
 	if (!dev)
 		return NULL;
 
+	open_device_dirs(dev, &dirs);
+
 	for (n = 0; (crtc = &cfg->crtcs[n])->name; n++) {
 		igt_debug("\t- CRTC %d:\n", n);
 		igt_debug("\t\t- name: %s\n", crtc->name);
 		igt_debug("\t\t- writeback: %d\n", crtc->writeback);
 
-		igt_vkms_device_add_crtc(dev, crtc->name);
-		igt_vkms_crtc_set_writeback_enabled(dev, crtc->name,
-						    crtc->writeback);
+		add_pipeline_item_at(&dirs, VKMS_PIPELINE_ITEM_CRTC, crtc->name);
+		write_int_at(&dirs, VKMS_PIPELINE_ITEM_CRTC, crtc->name,
+			     VKMS_FILE_CRTC_WRITEBACK, crtc->writeback);
 	}
 
 	for (n = 0; (plane = &cfg->planes[n])->name; n++) {
@@ -517,13 +642,23 @@ igt_vkms_t *igt_vkms_device_create_from_config(igt_vkms_config_t *cfg)
 		igt_debug("\t\t- type: %d\n", plane->type);
 		igt_debug("\t\t- possible_crtcs:\n");
 
-		igt_vkms_device_add_plane(dev, plane->name);
-		igt_vkms_plane_set_type(dev, plane->name, plane->type);
+		if (plane->type != DRM_PLANE_TYPE_OVERLAY &&
+		    plane->type != DRM_PLANE_TYPE_PRIMARY &&
+		    plane->type != DRM_PLANE_TYPE_CURSOR)
+			igt_assert(!"Cannot be reached: Unknown plane type");
+
+		add_pipeline_item_at(&dirs, VKMS_PIPELINE_ITEM_PLANE,
+				     plane->name);
+		write_int_at(&dirs, VKMS_PIPELINE_ITEM_PLANE, plane->name,
+			     VKMS_FILE_PLANE_TYPE, plane->type);
 
 		for (i = 0; (name = plane->possible_crtcs[i]); i++) {
 			igt_debug("\t\t\t- %s\n", name);
 
-			igt_vkms_plane_attach_crtc(dev, plane->name, name);
+			attach_pipeline_item_at(dev, &dirs,
+						VKMS_PIPELINE_ITEM_PLANE,
+						plane->name,
+						VKMS_PIPELINE_ITEM_CRTC, name);
 		}
 	}
 
@@ -532,12 +667,16 @@ igt_vkms_t *igt_vkms_device_create_from_config(igt_vkms_config_t *cfg)
 		igt_debug("\t\t- name: %s\n", encoder->name);
 		igt_debug("\t\t- possible_crtcs:\n");
 
-		igt_vkms_device_add_encoder(dev, encoder->name);
+		add_pipeline_item_at(&dirs, VKMS_PIPELINE_ITEM_ENCODER,
+				     encoder->name);
 
 		for (i = 0; (name = encoder->possible_crtcs[i]); i++) {
 			igt_debug("\t\t\t- %s\n", name);
 
-			igt_vkms_encoder_attach_crtc(dev, encoder->name, name);
+			attach_pipeline_item_at(dev, &dirs,
+						VKMS_PIPELINE_ITEM_ENCODER,
+						encoder->name,
+						VKMS_PIPELINE_ITEM_CRTC, name);
 		}
 	}
 
@@ -550,69 +689,195 @@ igt_vkms_t *igt_vkms_device_create_from_config(igt_vkms_config_t *cfg)
 		igt_debug("\t\t- status: %d\n", connector->status);
 		igt_debug("\t\t- possible_encoders:\n");
 
-		igt_vkms_device_add_connector(dev, connector->name);
-		igt_vkms_connector_set_status(dev, connector->name,
-					      connector->status);
+		if (connector->status != DRM_MODE_CONNECTED &&
+		    connector->status != DRM_MODE_DISCONNECTED &&
+		    connector->status != DRM_MODE_UNKNOWNCONNECTION)
+			igt_assert(!"Cannot be reached: Unknown connector status");
+
+		add_pipeline_item_at(&dirs, VKMS_PIPELINE_ITEM_CONNECTOR,
+				     connector->name);
+		write_int_at(&dirs, VKMS_PIPELINE_ITEM_CONNECTOR,
+			     connector->name, VKMS_FILE_CONNECTOR_STATUS,
+			     connector->status);
 
 		for (i = 0; (name = connector->possible_encoders[i]); i++) {
 			igt_debug("\t\t\t- %s\n", name);
 
-			igt_vkms_connector_attach_encoder(dev, connector->name,
-							  name);
+			attach_pipeline_item_at(dev, &dirs,
+						VKMS_PIPELINE_ITEM_CONNECTOR,
+						connector->name,
+						VKMS_PIPELINE_ITEM_ENCODER,
+						name);
 		}
 	}
 
+	close_device_dirs(&dirs);
+
 	return dev;
 }
 
-static int detach_pipeline_items(const char *path, const struct stat *info,
-				 const int typeflag, struct FTW *pathinfo)
+static void add_topology_plane(igt_vkms_t *dev, struct vkms_dirs *dirs,
+			       const char *name, int type, const char *crtc)
 {
-	/*
-	 * Level 4 are the links in the possible_* directories:
-	 * vkms/<dev>/<pipeline items>/<pipeline item>/<possible_*>/<links>
-	 */
-	if (pathinfo->level == 4 && typeflag == FTW_SL) {
-		igt_debug("Detaching pipeline item %s\n", path);
-		return unlink(path);
-	}
+	bool attached;
+
+	add_pipeline_item_at(dirs, VKMS_PIPELINE_ITEM_PLANE, name);
+	write_int_at(dirs, VKMS_PIPELINE_ITEM_PLANE, name, VKMS_FILE_PLANE_TYPE,
+		     type);
 
-	/* Ignore the other files, they are removed by remove_pipeline_items */
-	return 0;
+	attached = attach_pipeline_item_at(dev, dirs, VKMS_PIPELINE_ITEM_PLANE,
+					   name, VKMS_PIPELINE_ITEM_CRTC, crtc);
+	igt_assert_f(attached, "Error attaching plane '%s' to CRTC '%s'\n",
+		     name, crtc);
 }
 
-static int remove_pipeline_items(const char *path, const struct stat *info,
-				 const int typeflag, struct FTW *pathinfo)
+/**
+ * igt_vkms_device_create_from_topology:
+ * @topo: Device topology
+ *
+ * Create a VKMS device made of @topo->num_pipelines identical and independent
+ * pipelines, without going through a per item configuration. Pipeline N is
+ * made of:
+ *
+ * - CRTC "crtc-N", with a writeback connector if @topo->writeback is set
+ * - Primary plane "primary-N"
+ * - Overlay planes "overlay-N-0" to "overlay-N-<@topo->overlays_per_crtc - 1>"
+ * - Cursor plane "cursor-N" if @topo->cursor is set
+ * - Encoder "encoder-N" and connected connector "connector-N"
+ *
+ * The device is left disabled. Unlike igt_vkms_device_create_from_config(),
+ * the number of items is not bounded by %VKMS_MAX_PIPELINE_ITEMS, only by the
+ * limits VKMS enforces when the device is enabled.
+ */
+igt_vkms_t *igt_vkms_device_create_from_topology(const igt_vkms_topology_t *topo)
 {
-	/* Level 0 is the device root directory: vkms/<dev> */
-	if (pathinfo->level == 0) {
-		igt_debug("Removing pipeline item %s\n", path);
-		return rmdir(path);
-	}
+	char crtc[32], plane[32], encoder[32], connector[32];
+	struct vkms_dirs dirs;
+	igt_vkms_t *dev;
+	bool attached;
+	int n, i;
+
+	igt_debug("Creating device %s from topology: %d pipelines, %d overlays per CRTC, cursor %d, writeback %d\n",
+		  topo->device_name, topo->num_pipelines,
+		  topo->overlays_per_crtc, topo->cursor, topo->writeback);
+
+	dev = igt_vkms_device_create(topo->device_name);
+	if (!dev)
+		return NULL;
+
+	open_device_dirs(dev, &dirs);
+
+	for (n = 0; n < topo->num_pipelines; n++) {
+		snprintf(crtc, sizeof(crtc), "crtc-%d", n);
+		add_pipeline_item_at(&dirs, VKMS_PIPELINE_ITEM_CRTC, crtc);
+		write_int_at(&dirs, VKMS_PIPELINE_ITEM_CRTC, crtc,
+			     VKMS_FILE_CRTC_WRITEBACK, topo->writeback);
+
+		snprintf(plane, sizeof(plane), "primary-%d", n);
+		add_topology_plane(dev, &dirs, plane, DRM_PLANE_TYPE_PRIMARY,
+				   crtc);
+
+		for (i = 0; i < topo->overlays_per_crtc; i++) {
+			snprintf(plane, sizeof(plane), "overlay-%d-%d", n, i);
+			add_topology_plane(dev, &dirs, plane,
+					   DRM_PLANE_TYPE_OVERLAY, crtc);
+		}
 
-	/*
-	 * Level 2 directories are the pipeline items:
-	 * vkms/<dev>/<pipeline items>/<pipeline item>
-	 */
-	if (pathinfo->level == 2 && typeflag == FTW_DP) {
-		igt_debug("Removing pipeline item %s\n", path);
-		return rmdir(path);
+		if (topo->cursor) {
+			snprintf(plane, sizeof(plane), "cursor-%d", n);
+			add_topology_plane(dev, &dirs, plane,
+					   DRM_PLANE_TYPE_CURSOR, crtc);
+		}
+
+		snprintf(encoder, sizeof(encoder), "encoder-%d", n);
+		add_pipeline_item_at(&dirs, VKMS_PIPELINE_ITEM_ENCODER, encoder);
+		attached = attach_pipeline_item_at(dev, &dirs,
+						   VKMS_PIPELINE_ITEM_ENCODER,
+						   encoder,
+						   VKMS_PIPELINE_ITEM_CRTC,
+						   crtc);
+		igt_assert_f(attached,
+			     "Error attaching encoder '%s' to CRTC '%s'\n",
+			     encoder, crtc);
+
+		snprintf(connector, sizeof(connector), "connector-%d", n);
+		add_pipeline_item_at(&dirs, VKMS_PIPELINE_ITEM_CONNECTOR,
+				     connector);
+		write_int_at(&dirs, VKMS_PIPELINE_ITEM_CONNECTOR, connector,
+			     VKMS_FILE_CONNECTOR_STATUS, DRM_MODE_CONNECTED);
+		attached = attach_pipeline_item_at(dev, &dirs,
+						   VKMS_PIPELINE_ITEM_CONNECTOR,
+						   connector,
+						   VKMS_PIPELINE_ITEM_ENCODER,
+						   encoder);
+		igt_assert_f(attached,
+			     "Error attaching connector '%s' to encoder '%s'\n",
+			     connector, encoder);
 	}
 
-	/* Ignore the other files, they are removed by VKMS */
-	return 0;
+	close_device_dirs(&dirs);
+
+	return dev;
 }
 
-static int remove_device_dir(igt_vkms_t *dev)
+static int detach_link(int dirfd, const char *name, const void *data)
+{
+	igt_debug("Detaching pipeline item %s\n", name);
+
+	return unlinkat(dirfd, name, 0);
+}
+
+static int detach_pipeline_item_links(int dirfd, const char *name,
+				      const void *data)
 {
+	const char *attach_dir_name = data;
+	char path[PATH_MAX];
 	int ret;
 
-	ret = nftw(dev->path, detach_pipeline_items, 64, FTW_DEPTH | FTW_PHYS);
+	ret = snprintf(path, sizeof(path), "%s/%s", name, attach_dir_name);
+	igt_assert(ret >= 0 && ret < sizeof(path));
+
+	return for_each_dir_entry(dirfd, path, detach_link, NULL);
+}
+
+static int remove_pipeline_item_dir(int dirfd, const char *name,
+				    const void *data)
+{
+	igt_debug("Removing pipeline item %s\n", name);
+
+	/* The attribute files are removed by VKMS */
+	return unlinkat(dirfd, name, AT_REMOVEDIR);
+}
+
+static int remove_device_dir(igt_vkms_t *dev)
+{
+	enum vkms_pipeline_item item;
+	int dirfd, ret = 0;
+
+	dirfd = open(dev->path, O_RDONLY | O_DIRECTORY);
+	if (dirfd < 0)
+		return -1;
+
+	/* Items can't be removed while other items link to them */
+	for (item = 0; !ret && item <= VKMS_PIPELINE_ITEM_CONNECTOR; item++) {
+		if (item == VKMS_PIPELINE_ITEM_CRTC)
+			continue;
+
+		ret = for_each_dir_entry(dirfd, get_pipeline_item_dir_name(item),
+					 detach_pipeline_item_links,
+					 get_attach_dir_name(item));
+	}
+
+	for (item = 0; !ret && item <= VKMS_PIPELINE_ITEM_CONNECTOR; item++)
+		ret = for_each_dir_entry(dirfd, get_pipeline_item_dir_name(item),
+					 remove_pipeline_item_dir, NULL);
+
+	close(dirfd);
 	if (ret)
 		return ret;
 
-	ret = nftw(dev->path, remove_pipeline_items, 64, FTW_DEPTH | FTW_PHYS);
-	return ret;
+	igt_debug("Removing pipeline item %s\n", dev->path);
+	return rmdir(dev->path);
 }
 
 /**
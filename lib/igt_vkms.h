@@ -62,6 +62,25 @@ typedef struct igt_vkms_config {
 	igt_vkms_connector_config_t connectors[VKMS_MAX_PIPELINE_ITEMS];
 } igt_vkms_config_t;
 
+/**
+ * igt_vkms_topology_t:
+ * @device_name: Device name
+ * @num_pipelines: Number of CRTC, encoder and connector pipelines
+ * @overlays_per_crtc: Number of overlay planes of each CRTC
+ * @cursor: Whether each CRTC has a cursor plane
+ * @writeback: Whether each CRTC has a writeback connector
+ *
+ * Structure used to create a VKMS device made of identical pipelines, see
+ * igt_vkms_device_create_from_topology().
+ */
+typedef struct igt_vkms_topology {
+	const char *device_name;
+	int num_pipelines;
+	int overlays_per_crtc;
+	bool cursor;
+	bool writeback;
+} igt_vkms_topology_t;
+
 void igt_require_vkms_configfs(void);
 
 void igt_vkms_get_device_enabled_path(igt_vkms_t *dev, char *path, size_t len);
@@ -89,6 +108,7 @@ void igt_vkms_get_connector_possible_encoders_path(igt_vkms_t *dev,
 
 igt_vkms_t *igt_vkms_device_create(const char *name);
 igt_vkms_t *igt_vkms_device_create_from_config(igt_vkms_config_t *cfg);
+igt_vkms_t *igt_vkms_device_create_from_topology(const igt_vkms_topology_t *topo);
 void igt_vkms_device_destroy(igt_vkms_t *dev);
 void igt_vkms_destroy_all_devices(void);
 
@@ -68,6 +68,8 @@ char *igt_x86_features_to_string(unsigned features, char *line)
 		line += sprintf(line, ", avx2");
 	if (features & F16C)
 		line += sprintf(line, ", f16c");
+	if (features & PCLMUL)
+		line += sprintf(line, ", pclmul");
 
 	(void)line;
 
@@ -184,6 +186,30 @@ static void (*resolve_memcpy_from_wc(void))(void *, const void *, unsigned long)
 void igt_memcpy_from_wc(void *dst, const void *src, unsigned long len)
 	__attribute__((ifunc("resolve_memcpy_from_wc")));
 
+#elif defined(__aarch64__)
+/*
+ * There are no streaming loads as such on arm64, but moving 64 bytes at a
+ * time with non-temporal load pairs keeps the reads from uncached memory
+ * as wide as they get and avoids polluting the caches with them.
+ */
+void igt_memcpy_from_wc(void *dst, const void *src, unsigned long len)
+{
+	while (len >= 64) {
+		asm volatile("ldnp q0, q1, [%[src]]\n\t"
+			     "ldnp q2, q3, [%[src], #32]\n\t"
+			     "stp q0, q1, [%[dst]]\n\t"
+			     "stp q2, q3, [%[dst], #32]\n\t"
+			     :
+			     : [src] "r" (src), [dst] "r" (dst)
+			     : "v0", "v1", "v2", "v3", "memory");
+
+		src = (const char *)src + 64;
+		dst = (char *)dst + 64;
+		len -= 64;
+	}
+
+	memcpy(dst, src, len);
+}
 #else
 void igt_memcpy_from_wc(void *dst, const void *src, unsigned long len)
 {
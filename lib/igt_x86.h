@@ -48,6 +48,7 @@
 #define AVX	0x80
 #define AVX2	0x100
 #define F16C	0x200
+#define PCLMUL	0x400
 
 #if defined(__x86_64__) || defined(__i386__)
 
@@ -74,6 +75,10 @@
 #define bit_SSSE3	(1 << 9)
 #endif
 
+#ifndef bit_PCLMUL
+#define bit_PCLMUL	(1 << 1)
+#endif
+
 #ifndef bit_SSE4_1
 #define bit_SSE4_1	(1 << 19)
 #endif
@@ -147,6 +152,9 @@ static inline unsigned igt_x86_features(void)
 
 		if (ecx & bit_F16C)
 			features |= F16C;
+
+		if (ecx & bit_PCLMUL)
+			features |= PCLMUL;
 	}
 
 	if (max >= 7) {
@@ -14,11 +14,12 @@
 #include <unistd.h>
 #include "igt.h"
 #include "igt_map.h"
+#include "igt_syncobj.h"
 #include "intel_allocator.h"
 #include "intel_allocator_msgchannel.h"
 #include "intel_pat.h"
+#include "xe/xe_ioctl.h"
 #include "xe/xe_query.h"
-#include "xe/xe_util.h"
 
 #ifdef ALLOCDBG
 #define alloc_info igt_info
@@ -35,10 +36,12 @@ static const char *reqtype_str[] = {
 	[REQ_UNRESERVE]		= "unreserve",
 	[REQ_RESERVE_IF_NOT_ALLOCATED] = "reserve-ina",
 	[REQ_IS_RESERVED]	= "is reserved",
+	[REQ_ALLOC_BATCH]	= "alloc batch",
+	[REQ_FREE_BATCH]	= "free batch",
 };
 static inline const char *reqstr(enum reqtype request_type)
 {
-	igt_assert(request_type >= REQ_STOP && request_type <= REQ_IS_RESERVED);
+	igt_assert(request_type >= REQ_STOP && request_type <= REQ_FREE_BATCH);
 	return reqtype_str[request_type];
 }
 #else
@@ -73,6 +76,46 @@ struct handle_entry {
 	struct allocator *al;
 };
 
+/*
+ * Per-process cache of address ranges allocated from the allocator thread.
+ * Small objects are suballocated from those chunks locally, so they never
+ * cost a round-trip to the main process.
+ */
+#define ALLOC_CACHE_CHUNKS		16
+#define ALLOC_CACHE_CHUNK_SIZE		(4ull << 20)
+#define ALLOC_CACHE_MAX_OBJ_SIZE	(256ull << 10)
+
+/*
+ * Handles used for the chunks in the main process allocator, pid is
+ * encoded to keep chunks of different children apart.
+ */
+#define ALLOC_CACHE_CHUNK_HANDLE(pid, idx) \
+	(0x80000000u | (((uint32_t)(pid) & 0x3fffff) << 4) | (idx))
+
+struct cache_chunk {
+	uint32_t handle;
+	uint64_t start;
+	uint64_t end;
+	uint64_t next;
+	uint32_t live;
+};
+
+struct cache_object {
+	uint32_t handle;
+	uint64_t offset;
+	uint64_t size;
+	int chunk;
+};
+
+struct allocator_cache {
+	pid_t pid;
+	uint64_t default_alignment;
+	struct igt_map *objects;
+	struct cache_chunk chunks[ALLOC_CACHE_CHUNKS];
+	int num_chunks;
+	pthread_mutex_t mutex;
+};
+
 /* For tracking alloc()/free() for Xe */
 struct ahnd_info {
 	int fd;
@@ -81,6 +124,9 @@ struct ahnd_info {
 	enum intel_driver driver;
 	struct igt_map *bind_map;
 	pthread_mutex_t bind_map_mutex;
+	struct xe_bind_queue *bind_queue;
+	pid_t bind_queue_pid;
+	struct allocator_cache *cache;
 };
 
 enum allocator_bind_op {
@@ -105,6 +151,9 @@ intel_allocator_random_create(int fd, uint64_t start, uint64_t end);
 struct intel_allocator *
 intel_allocator_simple_create(int fd, uint64_t start, uint64_t end,
 			      enum allocator_strategy strategy);
+struct intel_allocator *
+intel_allocator_tree_create(int fd, uint64_t start, uint64_t end,
+			    enum allocator_strategy strategy);
 
 /*
  * Instead of trying to find first empty handle just get new one. Assuming
@@ -350,6 +399,10 @@ static struct intel_allocator *intel_allocator_create(int fd,
 		ial = intel_allocator_simple_create(fd, start, end,
 						    allocator_strategy);
 		break;
+	case INTEL_ALLOCATOR_TREE:
+		ial = intel_allocator_tree_create(fd, start, end,
+						  allocator_strategy);
+		break;
 	default:
 		igt_assert_f(ial, "Allocator type %d not implemented\n",
 			     allocator_type);
@@ -416,6 +469,114 @@ static struct allocator *allocator_open(int fd, uint32_t ctx, uint32_t vm,
 	return al;
 }
 
+static const char *op_str[] = {
+	[INTEL_ALLOCATOR_OP_ALLOC]	= "alloc",
+	[INTEL_ALLOCATOR_OP_FREE]	= "free",
+	[INTEL_ALLOCATOR_OP_RESERVE]	= "reserve",
+	[INTEL_ALLOCATOR_OP_UNRESERVE]	= "unreserve",
+	[INTEL_ALLOCATOR_OP_QUERY]	= "query",
+};
+
+static void __get_stats(struct intel_allocator *ial,
+			struct intel_allocator_stats *stats)
+{
+	*stats = ial->stats;
+	if (ial->get_usage)
+		ial->get_usage(ial, stats);
+
+	stats->fragmentation = 0;
+	if (stats->free_bytes)
+		stats->fragmentation = 1.0 - (double) stats->largest_hole /
+					     (double) stats->free_bytes;
+}
+
+static void update_stats(struct intel_allocator *ial,
+			 const struct alloc_req *req,
+			 const struct alloc_resp *resp, uint64_t ns)
+{
+	struct intel_allocator_stats *stats = &ial->stats;
+	enum intel_allocator_op op;
+	int bucket;
+	uint32_t i;
+
+	switch (req->request_type) {
+	case REQ_ALLOC:
+		op = INTEL_ALLOCATOR_OP_ALLOC;
+		if (resp->alloc.offset != ALLOC_INVALID_ADDRESS)
+			stats->allocs++;
+		else
+			stats->alloc_failures++;
+		break;
+	case REQ_ALLOC_BATCH:
+		op = INTEL_ALLOCATOR_OP_ALLOC;
+		for (i = 0; i < resp->alloc_batch.count; i++) {
+			if (resp->alloc_batch.offsets[i] != ALLOC_INVALID_ADDRESS)
+				stats->allocs++;
+			else
+				stats->alloc_failures++;
+		}
+		break;
+	case REQ_FREE:
+		op = INTEL_ALLOCATOR_OP_FREE;
+		stats->frees += resp->free.freed;
+		break;
+	case REQ_FREE_BATCH:
+		op = INTEL_ALLOCATOR_OP_FREE;
+		stats->frees += resp->free_batch.freed;
+		break;
+	case REQ_RESERVE:
+		op = INTEL_ALLOCATOR_OP_RESERVE;
+		stats->reserves += resp->reserve.reserved;
+		break;
+	case REQ_RESERVE_IF_NOT_ALLOCATED:
+		op = INTEL_ALLOCATOR_OP_RESERVE;
+		stats->reserves += resp->reserve_if_not_allocated.reserved;
+		break;
+	case REQ_UNRESERVE:
+		op = INTEL_ALLOCATOR_OP_UNRESERVE;
+		stats->unreserves += resp->unreserve.unreserved;
+		break;
+	default:
+		op = INTEL_ALLOCATOR_OP_QUERY;
+		break;
+	}
+
+	bucket = ns ? 63 - __builtin_clzll(ns) : 0;
+	bucket = min(bucket, INTEL_ALLOCATOR_LATENCY_BUCKETS - 1);
+	stats->latency[op][bucket]++;
+}
+
+static void dump_stats(struct allocator *al)
+{
+	struct intel_allocator_stats stats;
+	const char *path;
+	char *buf = NULL;
+	size_t len = 0;
+	FILE *f;
+
+	__get_stats(al->ial, &stats);
+
+	f = open_memstream(&buf, &len);
+	if (!f)
+		return;
+	fprintf(f, "{\"fd\": %d, \"ctx\": %u, \"vm\": %u, \"type\": %u, "
+		"\"stats\": ", al->fd, al->ctx, al->vm, al->ial->type);
+	intel_allocator_stats_to_json(&stats, f);
+	fputc('}', f);
+	fclose(f);
+
+	igt_debug("allocator stats: %s\n", buf);
+
+	/* IGT_ALLOCATOR_STATS=<file> collects one json line per allocator */
+	path = getenv("IGT_ALLOCATOR_STATS");
+	if (path && (f = fopen(path, "a"))) {
+		fprintf(f, "%s\n", buf);
+		fclose(f);
+	}
+
+	free(buf);
+}
+
 static bool allocator_close(uint64_t ahnd)
 {
 	struct allocator *al;
@@ -429,6 +590,7 @@ static bool allocator_close(uint64_t ahnd)
 
 	released = __allocator_put(al);
 	if (released) {
+		dump_stats(al);
 		is_empty = al->ial->is_empty(al->ial);
 		intel_allocator_destroy(al->ial);
 	}
@@ -481,8 +643,9 @@ static int handle_request(struct alloc_req *req, struct alloc_resp *resp)
 		struct intel_allocator *ial;
 		struct allocator *al;
 		uint64_t start, end, size, ahnd;
-		uint32_t ctx, vm;
+		uint32_t ctx, vm, i;
 		bool allocated, reserved, unreserved;
+		struct timespec ts = {};
 		/* Used when debug is on, so avoid compilation warnings */
 		(void) ctx;
 		(void) vm;
@@ -504,6 +667,7 @@ static int handle_request(struct alloc_req *req, struct alloc_resp *resp)
 			ial = al->ial;
 			igt_assert(ial);
 			pthread_mutex_lock(&ial->mutex);
+			igt_nsec_elapsed(&ts);
 		}
 
 		switch (req->request_type) {
@@ -576,6 +740,7 @@ static int handle_request(struct alloc_req *req, struct alloc_resp *resp)
 			ial->get_address_range(ial, &start, &end);
 			resp->address_range.start = start;
 			resp->address_range.end = end;
+			resp->address_range.default_alignment = ial->default_alignment;
 			alloc_info("<address range> [tid: %ld] ahnd: %" PRIx64
 				   ", ctx: %u, vm: %u"
 				   ", start: 0x%" PRIx64 ", end: 0x%" PRId64 "\n",
@@ -616,6 +781,46 @@ static int handle_request(struct alloc_req *req, struct alloc_resp *resp)
 				   req->free.handle, resp->free.freed);
 			break;
 
+		case REQ_ALLOC_BATCH:
+			resp->response_type = RESP_ALLOC_BATCH;
+			igt_assert(req->alloc_batch.count <= ALLOC_BATCH_MAX);
+			resp->alloc_batch.count = req->alloc_batch.count;
+			for (i = 0; i < req->alloc_batch.count; i++) {
+				uint64_t alignment;
+
+				alignment = max(ial->default_alignment,
+						req->alloc_batch.objs[i].alignment);
+				resp->alloc_batch.offsets[i] =
+					ial->alloc(ial,
+						   req->alloc_batch.objs[i].handle,
+						   req->alloc_batch.objs[i].size,
+						   alignment,
+						   req->alloc_batch.pat_index,
+						   req->alloc_batch.strategy);
+			}
+			alloc_info("<alloc batch> [tid: %ld] ahnd: %" PRIx64
+				   ", ctx: %u, vm: %u, count: %u"
+				   ", pat_index: %u, strategy: %u\n",
+				   (long) req->tid, req->allocator_handle,
+				   al->ctx, al->vm, req->alloc_batch.count,
+				   req->alloc_batch.pat_index,
+				   req->alloc_batch.strategy);
+			break;
+
+		case REQ_FREE_BATCH:
+			resp->response_type = RESP_FREE_BATCH;
+			igt_assert(req->free_batch.count <= ALLOC_BATCH_MAX);
+			resp->free_batch.freed = 0;
+			for (i = 0; i < req->free_batch.count; i++)
+				resp->free_batch.freed +=
+					ial->free(ial, req->free_batch.handles[i]);
+			alloc_info("<free batch> [tid: %ld] ahnd: %" PRIx64
+				   ", ctx: %u, vm: %u, count: %u, freed: %u\n",
+				   (long) req->tid, req->allocator_handle,
+				   al->ctx, al->vm, req->free_batch.count,
+				   resp->free_batch.freed);
+			break;
+
 		case REQ_IS_ALLOCATED:
 			resp->response_type = RESP_IS_ALLOCATED;
 			allocated = ial->is_allocated(ial,
@@ -716,8 +921,10 @@ static int handle_request(struct alloc_req *req, struct alloc_resp *resp)
 			break;
 		}
 
-		if (req->request_type > REQ_CLOSE)
+		if (req->request_type > REQ_CLOSE) {
+			update_stats(ial, req, resp, igt_nsec_elapsed(&ts));
 			pthread_mutex_unlock(&ial->mutex);
+		}
 
 		return 0;
 	}
@@ -893,6 +1100,9 @@ static void track_ahnd(int fd, uint64_t ahnd, uint32_t vm)
 		ainfo->driver = get_intel_driver(fd);
 		ainfo->bind_map = igt_map_create(igt_map_hash_32, igt_map_equal_32);
 		pthread_mutex_init(&ainfo->bind_map_mutex, NULL);
+		ainfo->bind_queue = NULL;
+		ainfo->bind_queue_pid = 0;
+		ainfo->cache = NULL;
 		bind_debug("[TRACK AHND] pid: %d, tid: %d, create <fd: %d, "
 			   "ahnd: %llx, vm: %u, driver: %d, ahnd_map: %p, bind_map: %p>\n",
 			   getpid(), gettid(), ainfo->fd,
@@ -913,11 +1123,164 @@ static void untrack_ahnd(uint64_t ahnd)
 	if (ainfo) {
 		bind_debug("[UNTRACK AHND]: pid: %d, tid: %d, removing ahnd: %llx\n",
 			   getpid(), gettid(), (long long)ahnd);
+		if (ainfo->bind_queue_pid == getpid())
+			xe_bind_queue_destroy(ainfo->bind_queue);
 		igt_map_remove(ahnd_map, &ahnd, map_entry_free_func);
 	}
 	pthread_mutex_unlock(&ahnd_map_mutex);
 }
 
+static struct allocator_cache *get_cache(uint64_t ahnd)
+{
+	struct allocator_cache *cache = NULL;
+	struct ahnd_info *ainfo;
+
+	pthread_mutex_lock(&ahnd_map_mutex);
+	ainfo = igt_map_search(ahnd_map, &ahnd);
+	/* Cache inherited from the parent belongs to it, not to us */
+	if (ainfo && ainfo->cache && ainfo->cache->pid == getpid())
+		cache = ainfo->cache;
+	pthread_mutex_unlock(&ahnd_map_mutex);
+
+	return cache;
+}
+
+static bool cache_add_chunk(struct allocator_cache *cache, uint64_t ahnd)
+{
+	struct cache_chunk *chunk = &cache->chunks[cache->num_chunks];
+	struct alloc_req req = { .request_type = REQ_ALLOC,
+				 .allocator_handle = ahnd,
+				 .alloc.size = ALLOC_CACHE_CHUNK_SIZE,
+				 .alloc.alignment = ALLOC_CACHE_MAX_OBJ_SIZE,
+				 .alloc.pat_index = DEFAULT_PAT_INDEX,
+				 .alloc.strategy = ALLOC_STRATEGY_NONE };
+	struct alloc_resp resp;
+
+	req.alloc.handle = ALLOC_CACHE_CHUNK_HANDLE(cache->pid,
+						    cache->num_chunks);
+
+	igt_assert(handle_request(&req, &resp) == 0);
+	igt_assert(resp.response_type == RESP_ALLOC);
+
+	if (resp.alloc.offset == ALLOC_INVALID_ADDRESS)
+		return false;
+
+	chunk->handle = req.alloc.handle;
+	chunk->start = resp.alloc.offset;
+	chunk->end = chunk->start + ALLOC_CACHE_CHUNK_SIZE;
+	chunk->next = chunk->start;
+	chunk->live = 0;
+	cache->num_chunks++;
+
+	return true;
+}
+
+static uint64_t cache_alloc(struct allocator_cache *cache, uint64_t ahnd,
+			    uint32_t handle, uint64_t size, uint64_t alignment)
+{
+	struct cache_object *obj;
+	struct cache_chunk *chunk;
+	uint64_t offset = ALLOC_INVALID_ADDRESS;
+	int i;
+
+	alignment = max(alignment, cache->default_alignment);
+	if (size > ALLOC_CACHE_MAX_OBJ_SIZE ||
+	    alignment > ALLOC_CACHE_MAX_OBJ_SIZE)
+		return ALLOC_INVALID_ADDRESS;
+
+	pthread_mutex_lock(&cache->mutex);
+	obj = igt_map_search(cache->objects, &handle);
+	if (obj) {
+		offset = obj->offset;
+		goto out;
+	}
+
+	for (i = 0; i < cache->num_chunks; i++) {
+		chunk = &cache->chunks[i];
+		offset = ALIGN(chunk->next, alignment);
+		if (offset + size <= chunk->end)
+			break;
+	}
+
+	if (i == cache->num_chunks) {
+		if (i == ALLOC_CACHE_CHUNKS || !cache_add_chunk(cache, ahnd)) {
+			offset = ALLOC_INVALID_ADDRESS;
+			goto out;
+		}
+		chunk = &cache->chunks[i];
+		offset = chunk->next;
+	}
+
+	chunk->next = offset + size;
+	chunk->live++;
+
+	obj = malloc(sizeof(*obj));
+	igt_assert(obj);
+	obj->handle = handle;
+	obj->offset = offset;
+	obj->size = size;
+	obj->chunk = i;
+	igt_map_insert(cache->objects, &obj->handle, obj);
+
+out:
+	pthread_mutex_unlock(&cache->mutex);
+
+	return offset;
+}
+
+static bool cache_free(struct allocator_cache *cache, uint32_t handle)
+{
+	struct cache_object *obj;
+	struct cache_chunk *chunk;
+	bool freed = false;
+
+	pthread_mutex_lock(&cache->mutex);
+	obj = igt_map_search(cache->objects, &handle);
+	if (obj) {
+		/* Chunk is reused from the beginning once it gets empty */
+		chunk = &cache->chunks[obj->chunk];
+		if (--chunk->live == 0)
+			chunk->next = chunk->start;
+		igt_map_remove(cache->objects, &handle, map_entry_free_func);
+		freed = true;
+	}
+	pthread_mutex_unlock(&cache->mutex);
+
+	return freed;
+}
+
+static bool cache_is_allocated(struct allocator_cache *cache, uint32_t handle,
+			       uint64_t size, uint64_t offset, bool *allocated)
+{
+	struct cache_object *obj;
+
+	pthread_mutex_lock(&cache->mutex);
+	obj = igt_map_search(cache->objects, &handle);
+	if (obj)
+		*allocated = obj->offset == offset && obj->size == size;
+	pthread_mutex_unlock(&cache->mutex);
+
+	return obj;
+}
+
+static void cache_destroy(struct allocator_cache *cache, uint64_t ahnd)
+{
+	struct alloc_req req = { .request_type = REQ_FREE,
+				 .allocator_handle = ahnd };
+	struct alloc_resp resp;
+	int i;
+
+	for (i = 0; i < cache->num_chunks; i++) {
+		req.free.handle = cache->chunks[i].handle;
+		igt_assert(handle_request(&req, &resp) == 0);
+		igt_assert(resp.response_type == RESP_FREE);
+	}
+
+	igt_map_destroy(cache->objects, map_entry_free_func);
+	pthread_mutex_destroy(&cache->mutex);
+	free(cache);
+}
+
 static uint64_t __intel_allocator_open_full(int fd, uint32_t ctx,
 					    uint32_t vm,
 					    uint64_t start, uint64_t end,
@@ -1084,6 +1447,11 @@ bool intel_allocator_close(uint64_t allocator_handle)
 	struct alloc_req req = { .request_type = REQ_CLOSE,
 				 .allocator_handle = allocator_handle };
 	struct alloc_resp resp;
+	struct allocator_cache *cache;
+
+	cache = get_cache(allocator_handle);
+	if (cache)
+		cache_destroy(cache, allocator_handle);
 
 	igt_assert(handle_request(&req, &resp) == 0);
 	igt_assert(resp.response_type == RESP_CLOSE);
@@ -1221,9 +1589,23 @@ uint64_t __intel_allocator_alloc(uint64_t allocator_handle, uint32_t handle,
 				 .alloc.pat_index = pat_index,
 	};
 	struct alloc_resp resp;
+	struct allocator_cache *cache;
+	uint64_t offset;
 
 	igt_assert((alignment & (alignment-1)) == 0);
 
+	cache = strategy == ALLOC_STRATEGY_NONE ?
+		get_cache(allocator_handle) : NULL;
+	if (cache) {
+		offset = cache_alloc(cache, allocator_handle, handle, size,
+				     alignment);
+		if (offset != ALLOC_INVALID_ADDRESS) {
+			track_object(allocator_handle, handle, offset, size,
+				     pat_index, TO_BIND);
+			return offset;
+		}
+	}
+
 	igt_assert(handle_request(&req, &resp) == 0);
 	igt_assert(resp.response_type == RESP_ALLOC);
 
@@ -1304,6 +1686,13 @@ bool intel_allocator_free(uint64_t allocator_handle, uint32_t handle)
 				 .allocator_handle = allocator_handle,
 				 .free.handle = handle };
 	struct alloc_resp resp;
+	struct allocator_cache *cache;
+
+	cache = get_cache(allocator_handle);
+	if (cache && cache_free(cache, handle)) {
+		track_object(allocator_handle, handle, 0, 0, 0, TO_UNBIND);
+		return true;
+	}
 
 	igt_assert(handle_request(&req, &resp) == 0);
 	igt_assert(resp.response_type == RESP_FREE);
@@ -1313,6 +1702,227 @@ bool intel_allocator_free(uint64_t allocator_handle, uint32_t handle)
 	return resp.free.freed;
 }
 
+static int flush_alloc_batch(struct alloc_req *req,
+			     struct intel_allocator_batch_obj *objs,
+			     const int *idx)
+{
+	struct alloc_resp resp;
+	struct intel_allocator_batch_obj *obj;
+	int i, allocated = 0;
+
+	if (!req->alloc_batch.count)
+		return 0;
+
+	igt_assert(handle_request(req, &resp) == 0);
+	igt_assert(resp.response_type == RESP_ALLOC_BATCH);
+	igt_assert_eq(resp.alloc_batch.count, req->alloc_batch.count);
+
+	for (i = 0; i < req->alloc_batch.count; i++) {
+		obj = &objs[idx[i]];
+		obj->offset = resp.alloc_batch.offsets[i];
+		if (obj->offset == ALLOC_INVALID_ADDRESS)
+			continue;
+
+		track_object(req->allocator_handle, obj->handle, obj->offset,
+			     obj->size, req->alloc_batch.pat_index, TO_BIND);
+		allocated++;
+	}
+	req->alloc_batch.count = 0;
+
+	return allocated;
+}
+
+/**
+ * __intel_allocator_alloc_batch:
+ * @allocator_handle: handle to an allocator
+ * @objs: array of objects to allocate
+ * @count: number of entries in @objs
+ * @pat_index: chosen pat_index for the binding
+ * @strategy: chosen allocator strategy
+ *
+ * Same as __intel_allocator_alloc() called for each entry of @objs, but
+ * objects are sent to the allocator in groups of up to #ALLOC_BATCH_MAX,
+ * what saves round-trips in multiprocess mode. Assigned address (or
+ * ALLOC_INVALID_ADDRESS) is written to the @offset field of each entry.
+ *
+ * Returns: number of objects which got a valid address.
+ */
+int __intel_allocator_alloc_batch(uint64_t allocator_handle,
+				  struct intel_allocator_batch_obj *objs,
+				  int count, uint8_t pat_index,
+				  enum allocator_strategy strategy)
+{
+	struct alloc_req req = { .request_type = REQ_ALLOC_BATCH,
+				 .allocator_handle = allocator_handle,
+				 .alloc_batch.pat_index = pat_index,
+				 .alloc_batch.strategy = strategy };
+	struct allocator_cache *cache = NULL;
+	int idx[ALLOC_BATCH_MAX];
+	int i, n, allocated = 0;
+
+	if (strategy == ALLOC_STRATEGY_NONE)
+		cache = get_cache(allocator_handle);
+
+	for (i = 0; i < count; i++) {
+		igt_assert((objs[i].alignment & (objs[i].alignment - 1)) == 0);
+
+		if (cache) {
+			objs[i].offset = cache_alloc(cache, allocator_handle,
+						     objs[i].handle,
+						     objs[i].size,
+						     objs[i].alignment);
+			if (objs[i].offset != ALLOC_INVALID_ADDRESS) {
+				track_object(allocator_handle, objs[i].handle,
+					     objs[i].offset, objs[i].size,
+					     pat_index, TO_BIND);
+				allocated++;
+				continue;
+			}
+		}
+
+		n = req.alloc_batch.count++;
+		idx[n] = i;
+		req.alloc_batch.objs[n].handle = objs[i].handle;
+		req.alloc_batch.objs[n].size = objs[i].size;
+		req.alloc_batch.objs[n].alignment = objs[i].alignment;
+
+		if (req.alloc_batch.count == ALLOC_BATCH_MAX)
+			allocated += flush_alloc_batch(&req, objs, idx);
+	}
+	allocated += flush_alloc_batch(&req, objs, idx);
+
+	return allocated;
+}
+
+/**
+ * intel_allocator_alloc_batch:
+ * @allocator_handle: handle to an allocator
+ * @objs: array of objects to allocate
+ * @count: number of entries in @objs
+ *
+ * Same as __intel_allocator_alloc_batch() but asserts if allocator can't
+ * return valid address for any of the objects. Uses default allocation
+ * strategy chosen during opening the allocator.
+ */
+void intel_allocator_alloc_batch(uint64_t allocator_handle,
+				 struct intel_allocator_batch_obj *objs,
+				 int count)
+{
+	igt_assert_eq(__intel_allocator_alloc_batch(allocator_handle, objs,
+						    count, DEFAULT_PAT_INDEX,
+						    ALLOC_STRATEGY_NONE),
+		      count);
+}
+
+static int flush_free_batch(struct alloc_req *req)
+{
+	struct alloc_resp resp;
+	int i;
+
+	if (!req->free_batch.count)
+		return 0;
+
+	igt_assert(handle_request(req, &resp) == 0);
+	igt_assert(resp.response_type == RESP_FREE_BATCH);
+
+	for (i = 0; i < req->free_batch.count; i++)
+		track_object(req->allocator_handle, req->free_batch.handles[i],
+			     0, 0, 0, TO_UNBIND);
+	req->free_batch.count = 0;
+
+	return resp.free_batch.freed;
+}
+
+/**
+ * intel_allocator_free_batch:
+ * @allocator_handle: handle to an allocator
+ * @handles: array of object handles to be freed
+ * @count: number of entries in @handles
+ *
+ * Same as intel_allocator_free() called for each of @handles, but
+ * objects are sent to the allocator in groups of up to #ALLOC_BATCH_MAX.
+ *
+ * Returns: number of objects which were successfully freed.
+ */
+int intel_allocator_free_batch(uint64_t allocator_handle,
+			       const uint32_t *handles, int count)
+{
+	struct alloc_req req = { .request_type = REQ_FREE_BATCH,
+				 .allocator_handle = allocator_handle };
+	struct allocator_cache *cache;
+	int i, freed = 0;
+
+	cache = get_cache(allocator_handle);
+
+	for (i = 0; i < count; i++) {
+		if (cache && cache_free(cache, handles[i])) {
+			track_object(allocator_handle, handles[i], 0, 0, 0,
+				     TO_UNBIND);
+			freed++;
+			continue;
+		}
+
+		req.free_batch.handles[req.free_batch.count++] = handles[i];
+		if (req.free_batch.count == ALLOC_BATCH_MAX)
+			freed += flush_free_batch(&req);
+	}
+	freed += flush_free_batch(&req);
+
+	return freed;
+}
+
+/**
+ * intel_allocator_enable_cache:
+ * @allocator_handle: handle to an allocator
+ *
+ * Enables per-process cache for the @allocator_handle. Cache allocates
+ * a few chunks of address space from the allocator thread on demand and
+ * suballocates objects up to 256KiB from them locally, so those don't
+ * need a request to the main process. Bigger objects and allocations
+ * with explicit strategy are passed to the allocator as usual.
+ *
+ * Note. Cache is meaningful only in a child in multiprocess mode and it
+ * should be enabled before any object is allocated, objects already
+ * allocated in the allocator are not known to the cache. Chunks are
+ * returned to the allocator on intel_allocator_close().
+ *
+ * Returns: true if cache is enabled, false if the allocator is local to
+ * this process and the cache wouldn't give anything.
+ */
+bool intel_allocator_enable_cache(uint64_t allocator_handle)
+{
+	struct alloc_req req = { .request_type = REQ_ADDRESS_RANGE,
+				 .allocator_handle = allocator_handle };
+	struct alloc_resp resp;
+	struct allocator_cache *cache;
+	struct ahnd_info *ainfo;
+
+	if (is_same_process())
+		return false;
+
+	if (get_cache(allocator_handle))
+		return true;
+
+	igt_assert(handle_request(&req, &resp) == 0);
+	igt_assert(resp.response_type == RESP_ADDRESS_RANGE);
+
+	cache = calloc(1, sizeof(*cache));
+	igt_assert(cache);
+	cache->pid = getpid();
+	cache->default_alignment = resp.address_range.default_alignment;
+	cache->objects = igt_map_create(igt_map_hash_32, igt_map_equal_32);
+	pthread_mutex_init(&cache->mutex, NULL);
+
+	pthread_mutex_lock(&ahnd_map_mutex);
+	ainfo = igt_map_search(ahnd_map, &allocator_handle);
+	igt_assert_f(ainfo, "[ENABLE CACHE] => MISSING ahnd %llx <=\n",
+		     (long long)allocator_handle);
+	ainfo->cache = cache;
+	pthread_mutex_unlock(&ahnd_map_mutex);
+
+	return true;
+}
+
 /**
  * intel_allocator_is_allocated:
  * @allocator_handle: handle to an allocator
@@ -1335,6 +1945,12 @@ bool intel_allocator_is_allocated(uint64_t allocator_handle, uint32_t handle,
 				 .is_allocated.size = size,
 				 .is_allocated.offset = offset };
 	struct alloc_resp resp;
+	struct allocator_cache *cache;
+	bool allocated;
+
+	cache = get_cache(allocator_handle);
+	if (cache && cache_is_allocated(cache, handle, size, offset, &allocated))
+		return allocated;
 
 	igt_assert(handle_request(&req, &resp) == 0);
 	igt_assert(resp.response_type == RESP_IS_ALLOCATED);
@@ -1459,6 +2075,16 @@ bool intel_allocator_reserve_if_not_allocated(uint64_t allocator_handle,
 				 .reserve.start = offset,
 				 .reserve.end = offset + size };
 	struct alloc_resp resp;
+	struct allocator_cache *cache;
+	bool allocated;
+
+	cache = get_cache(allocator_handle);
+	if (cache && cache_is_allocated(cache, handle, size, offset, &allocated) &&
+	    allocated) {
+		if (is_allocatedp)
+			*is_allocatedp = true;
+		return false;
+	}
 
 	igt_assert(handle_request(&req, &resp) == 0);
 	igt_assert(resp.response_type == RESP_RESERVE_IF_NOT_ALLOCATED);
@@ -1494,16 +2120,114 @@ void intel_allocator_print(uint64_t allocator_handle)
 	}
 }
 
+/**
+ * intel_allocator_get_stats:
+ * @allocator_handle: handle to an allocator
+ * @stats: pointer to the structure where stats are written
+ *
+ * Function fills @stats with counters collected for the allocator since
+ * it was created, current occupancy of its address space and latency
+ * histograms of the requests it served. Counters are updated on every
+ * request so they are always available, intel_allocator_close() of the
+ * last user dumps them as json to the debug log (and to the file pointed
+ * by IGT_ALLOCATOR_STATS environment variable if set).
+ *
+ * Note. Reading stats possible only in the main process.
+ *
+ * Returns: true if @stats were filled, false otherwise.
+ **/
+bool intel_allocator_get_stats(uint64_t allocator_handle,
+			       struct intel_allocator_stats *stats)
+{
+	struct allocator *al;
+
+	igt_assert(allocator_handle);
+	igt_assert(stats);
+
+	if (multiprocess && !is_same_process()) {
+		igt_warn("Allocator stats are in main process only\n");
+		return false;
+	}
+
+	pthread_mutex_lock(&map_mutex);
+	al = __allocator_find_by_handle(allocator_handle);
+	pthread_mutex_unlock(&map_mutex);
+	igt_assert(al);
+
+	pthread_mutex_lock(&al->ial->mutex);
+	__get_stats(al->ial, stats);
+	pthread_mutex_unlock(&al->ial->mutex);
+
+	return true;
+}
+
+/**
+ * intel_allocator_stats_to_json:
+ * @stats: allocator stats
+ * @f: output stream
+ *
+ * Function writes @stats to @f as single line json object. Latency
+ * histograms are written as arrays of #INTEL_ALLOCATOR_LATENCY_BUCKETS
+ * counters, entry i covering requests which took [2^i, 2^(i+1)) ns.
+ **/
+void intel_allocator_stats_to_json(const struct intel_allocator_stats *stats,
+				   FILE *f)
+{
+	int op, i;
+
+	fprintf(f, "{\"allocs\": %" PRIu64 ", \"alloc_failures\": %" PRIu64
+		", \"frees\": %" PRIu64 ", \"reserves\": %" PRIu64
+		", \"unreserves\": %" PRIu64,
+		stats->allocs, stats->alloc_failures, stats->frees,
+		stats->reserves, stats->unreserves);
+	fprintf(f, ", \"live_objects\": %" PRIu64 ", \"live_bytes\": %" PRIu64
+		", \"reserved_areas\": %" PRIu64 ", \"reserved_bytes\": %" PRIu64
+		", \"free_bytes\": %" PRIu64 ", \"holes\": %" PRIu64
+		", \"largest_hole\": %" PRIu64 ", \"fragmentation\": %.4f",
+		stats->live_objects, stats->live_bytes,
+		stats->reserved_areas, stats->reserved_bytes,
+		stats->free_bytes, stats->holes, stats->largest_hole,
+		stats->fragmentation);
+
+	fprintf(f, ", \"latency_ns_log2\": {");
+	for (op = 0; op < INTEL_ALLOCATOR_OP_NUM; op++) {
+		fprintf(f, "%s\"%s\": [", op ? ", " : "", op_str[op]);
+		for (i = 0; i < INTEL_ALLOCATOR_LATENCY_BUCKETS; i++)
+			fprintf(f, "%s%" PRIu64, i ? ", " : "",
+				stats->latency[op][i]);
+		fprintf(f, "]");
+	}
+	fprintf(f, "}}");
+}
+
+/*
+ * Binds go to a bind queue of the vm, so they are pipelined behind the
+ * previous ones. The queue isn't shared with children which inherited
+ * @ainfo, each process gets its own.
+ */
+static struct xe_bind_queue *get_bind_queue(struct ahnd_info *ainfo)
+{
+	if (ainfo->bind_queue_pid != getpid()) {
+		ainfo->bind_queue = xe_bind_queue_create(ainfo->fd, ainfo->vm);
+		ainfo->bind_queue_pid = getpid();
+	}
+
+	return ainfo->bind_queue;
+}
+
 static void __xe_op_bind(struct ahnd_info *ainfo, uint32_t sync_in, uint32_t sync_out)
 {
+	struct drm_xe_sync syncs[2];
 	struct allocator_object *obj;
+	struct xe_bind_queue *bq;
 	struct igt_map_entry *pos;
-	struct igt_list_head obj_list;
-	struct xe_object *entry, *tmp;
-
-	IGT_INIT_LIST_HEAD(&obj_list);
+	uint32_t num_syncs = 0;
+	uint64_t point;
 
 	pthread_mutex_lock(&ainfo->bind_map_mutex);
+	bq = get_bind_queue(ainfo);
+	point = bq->point;
+
 	igt_map_foreach(ainfo->bind_map, pos) {
 		obj = pos->data;
 
@@ -1516,14 +2240,13 @@ static void __xe_op_bind(struct ahnd_info *ainfo, uint32_t sync_in, uint32_t syn
 			  obj->handle, obj->offset,
 			  obj->size, obj->pat_index);
 
-		entry = malloc(sizeof(*entry));
-		entry->handle = obj->handle;
-		entry->offset = obj->offset;
-		entry->size = obj->size;
-		entry->pat_index = obj->pat_index;
-		entry->bind_op = obj->bind_op == TO_BIND ? XE_OBJECT_BIND :
-							   XE_OBJECT_UNBIND;
-		igt_list_add(&entry->link, &obj_list);
+		if (obj->bind_op == TO_BIND)
+			xe_bind_queue_map(bq, obj->handle, 0, obj->offset,
+					  ALIGN(obj->size, 4096),
+					  obj->pat_index, 0);
+		else
+			xe_bind_queue_unmap(bq, obj->offset,
+					    ALIGN(obj->size, 4096));
 
 		/*
 		 * We clean bind_map even before calling bind/unbind
@@ -1536,14 +2259,32 @@ static void __xe_op_bind(struct ahnd_info *ainfo, uint32_t sync_in, uint32_t syn
 				       map_entry_free_func);
 	}
 
-	xe_bind_unbind_async(ainfo->fd, ainfo->vm, 0, &obj_list, sync_in, sync_out);
+	if (sync_in)
+		syncs[num_syncs++] = (struct drm_xe_sync) {
+			.type = DRM_XE_SYNC_TYPE_SYNCOBJ,
+			.handle = sync_in,
+		};
+	if (sync_out)
+		syncs[num_syncs++] = (struct drm_xe_sync) {
+			.type = DRM_XE_SYNC_TYPE_SYNCOBJ,
+			.flags = DRM_XE_SYNC_FLAG_SIGNAL,
+			.handle = sync_out,
+		};
+
+	if (xe_bind_queue_flush(bq, syncs, num_syncs) == point && sync_out) {
+		/* Nothing new, @sync_out follows the binds still in flight */
+		if (point)
+			syncobj_timeline_to_binary(ainfo->fd, sync_out,
+						   bq->syncobj, point, 0);
+		else
+			syncobj_signal(ainfo->fd, &sync_out, 1);
+	}
+
+	/* User didn't pass sync out, wait for completion */
+	if (!sync_out)
+		xe_bind_queue_wait(bq);
 
 	pthread_mutex_unlock(&ainfo->bind_map_mutex);
-
-	igt_list_for_each_entry_safe(entry, tmp, &obj_list, link) {
-		igt_list_del(&entry->link);
-		free(entry);
-	}
 }
 
 uint64_t get_offset_pat_index(uint64_t ahnd, uint32_t handle, uint64_t size,
@@ -1654,11 +2395,30 @@ static void __free_ahnd_map(void)
 	igt_map_foreach(ahnd_map, pos) {
 		ainfo = pos->data;
 		igt_map_destroy(ainfo->bind_map, map_entry_free_func);
+		if (ainfo->cache) {
+			igt_map_destroy(ainfo->cache->objects,
+					map_entry_free_func);
+			free(ainfo->cache);
+		}
 	}
 
 	igt_map_destroy(ahnd_map, map_entry_free_func);
 }
 
+/*
+ * Shared memory ring is the default, IGT_ALLOCATOR_CHANNEL=msgqueue switches
+ * back to SysV message queue.
+ */
+static enum msg_channel_type allocator_channel_type(void)
+{
+	const char *env = getenv("IGT_ALLOCATOR_CHANNEL");
+
+	if (env && !strcmp(env, "msgqueue"))
+		return CHANNEL_SYSVIPC_MSGQUEUE;
+
+	return CHANNEL_SHM_RING;
+}
+
 /**
  * intel_allocator_init:
  *
@@ -1686,7 +2446,7 @@ void intel_allocator_init(void)
 	ahnd_map = igt_map_create(igt_map_hash_64, igt_map_equal_64);
 	igt_assert(handles && ctx_map && vm_map && ahnd_map);
 
-	channel = intel_allocator_get_msgchannel(CHANNEL_SYSVIPC_MSGQUEUE);
+	channel = intel_allocator_get_msgchannel(allocator_channel_type());
 }
 
 igt_constructor {
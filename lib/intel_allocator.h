@@ -9,6 +9,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <pthread.h>
+#include <stdio.h>
 #include <stdint.h>
 #include <stdatomic.h>
 #include "i915/gem_submission.h"
@@ -32,7 +33,8 @@
  *
  * - Allocator has to work in multiprocess / multithread environment.
  * - Allocator backend (algorithm) should be plugable. Currently we support
- *   SIMPLE (borrowed from Mesa allocator), RELOC (pseudo allocator which
+ *   SIMPLE (borrowed from Mesa allocator), TREE (SIMPLE with holes kept
+ *   in a balanced tree for many objects), RELOC (pseudo allocator which
  *   returns incremented addresses without checking overlapping)
  *   and RANDOM (pseudo allocator which randomize addresses without
  *   checking overlapping).
@@ -122,6 +124,13 @@
  *
  * Calling stop() request to stop allocator thread unblocking all pending
  * children (if any).
+ *
+ * Each request costs a round-trip to the allocator thread, so objects which
+ * are allocated together should be passed at once to
+ * intel_allocator_alloc_batch() / intel_allocator_free_batch(). A child
+ * can additionally call intel_allocator_enable_cache() on its allocator
+ * handle, then small allocations are served from address ranges reserved
+ * in advance and don't leave the process at all.
  */
 
 enum allocator_strategy {
@@ -130,6 +139,73 @@ enum allocator_strategy {
 	ALLOC_STRATEGY_HIGH_TO_LOW
 };
 
+/**
+ * intel_allocator_batch_obj:
+ * @handle: handle to an object
+ * @size: size of an object
+ * @alignment: determines object alignment
+ * @offset: assigned address, filled by intel_allocator_alloc_batch()
+ *
+ * Entry of an object array passed to intel_allocator_alloc_batch().
+ */
+struct intel_allocator_batch_obj {
+	uint32_t handle;
+	uint64_t size;
+	uint64_t alignment;
+	uint64_t offset;
+};
+
+enum intel_allocator_op {
+	INTEL_ALLOCATOR_OP_ALLOC,
+	INTEL_ALLOCATOR_OP_FREE,
+	INTEL_ALLOCATOR_OP_RESERVE,
+	INTEL_ALLOCATOR_OP_UNRESERVE,
+	INTEL_ALLOCATOR_OP_QUERY,
+	INTEL_ALLOCATOR_OP_NUM,
+};
+
+/* Bucket i counts requests which took [2^i, 2^(i+1)) ns, last one is open */
+#define INTEL_ALLOCATOR_LATENCY_BUCKETS 24
+
+/**
+ * intel_allocator_stats:
+ * @allocs: number of successfully allocated objects
+ * @alloc_failures: number of allocations without suitable hole
+ * @frees: number of freed objects
+ * @reserves: number of reserved areas
+ * @unreserves: number of unreserved areas
+ * @live_objects: number of currently allocated objects
+ * @live_bytes: size of currently allocated objects
+ * @reserved_areas: number of currently reserved areas
+ * @reserved_bytes: size of currently reserved areas
+ * @free_bytes: size of free address space
+ * @holes: number of free holes
+ * @largest_hole: size of the largest free hole
+ * @fragmentation: 1 - @largest_hole / @free_bytes, 0 for single hole
+ * @latency: histogram of time spent in the allocator per operation
+ *
+ * Counters collected for each allocator. Occupancy fields are filled in
+ * only for allocators which track their address space (simple, tree).
+ */
+struct intel_allocator_stats {
+	uint64_t allocs;
+	uint64_t alloc_failures;
+	uint64_t frees;
+	uint64_t reserves;
+	uint64_t unreserves;
+
+	uint64_t live_objects;
+	uint64_t live_bytes;
+	uint64_t reserved_areas;
+	uint64_t reserved_bytes;
+	uint64_t free_bytes;
+	uint64_t holes;
+	uint64_t largest_hole;
+	double fragmentation;
+
+	uint64_t latency[INTEL_ALLOCATOR_OP_NUM][INTEL_ALLOCATOR_LATENCY_BUCKETS];
+};
+
 struct intel_allocator {
 	int fd;
 	uint8_t type;
@@ -161,6 +237,12 @@ struct intel_allocator {
 	bool (*is_empty)(struct intel_allocator *ial);
 
 	void (*print)(struct intel_allocator *ial, bool full);
+
+	/* optional, fills occupancy part of the stats */
+	void (*get_usage)(struct intel_allocator *ial,
+			  struct intel_allocator_stats *stats);
+
+	struct intel_allocator_stats stats;
 };
 
 void intel_allocator_init(void);
@@ -195,6 +277,16 @@ uint64_t intel_allocator_alloc_with_strategy(uint64_t allocator_handle,
 					     uint64_t size, uint64_t alignment,
 					     enum allocator_strategy strategy);
 bool intel_allocator_free(uint64_t allocator_handle, uint32_t handle);
+int __intel_allocator_alloc_batch(uint64_t allocator_handle,
+				  struct intel_allocator_batch_obj *objs,
+				  int count, uint8_t pat_index,
+				  enum allocator_strategy strategy);
+void intel_allocator_alloc_batch(uint64_t allocator_handle,
+				 struct intel_allocator_batch_obj *objs,
+				 int count);
+int intel_allocator_free_batch(uint64_t allocator_handle,
+			       const uint32_t *handles, int count);
+bool intel_allocator_enable_cache(uint64_t allocator_handle);
 bool intel_allocator_is_allocated(uint64_t allocator_handle, uint32_t handle,
 				  uint64_t size, uint64_t offset);
 bool intel_allocator_reserve(uint64_t allocator_handle, uint32_t handle,
@@ -209,6 +301,10 @@ bool intel_allocator_reserve_if_not_allocated(uint64_t allocator_handle,
 					      bool *is_allocatedp);
 
 void intel_allocator_print(uint64_t allocator_handle);
+bool intel_allocator_get_stats(uint64_t allocator_handle,
+			       struct intel_allocator_stats *stats);
+void intel_allocator_stats_to_json(const struct intel_allocator_stats *stats,
+				   FILE *f);
 
 void intel_allocator_bind(uint64_t allocator_handle,
 			  uint32_t sync_in, uint32_t sync_out);
@@ -217,6 +313,7 @@ void intel_allocator_bind(uint64_t allocator_handle,
 #define INTEL_ALLOCATOR_NONE   0
 #define INTEL_ALLOCATOR_RELOC  1
 #define INTEL_ALLOCATOR_SIMPLE 2
+#define INTEL_ALLOCATOR_TREE   3
 
 #define GEN8_GTT_ADDRESS_WIDTH 48
 
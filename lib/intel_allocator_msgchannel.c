@@ -5,9 +5,14 @@
 
 #include <sys/types.h>
 #include <sys/ipc.h>
+#include <sys/mman.h>
 #include <sys/msg.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <signal.h>
 #include "igt.h"
 #include "intel_allocator_msgchannel.h"
 
@@ -182,6 +187,345 @@ static struct msg_channel msgqueue_channel = {
 	.recv_resp = msgqueue_recv_resp,
 };
 
+/* ----- SHARED MEMORY RING ----- */
+
+/*
+ * Requests go through a bounded multi-producer/single-consumer ring living
+ * in an anonymous shared mapping created before the children are forked.
+ * Each slot carries a sequence number telling whether it is free for
+ * producer (seq == pos) or holds a published request for the allocator
+ * thread (seq == pos + 1). Responses are delivered into per-tid mailboxes
+ * in the same mapping. Sleeping is done with futexes and the waker only
+ * enters the kernel when the other side has announced it is going to sleep,
+ * so under load most requests don't need any syscall at all.
+ */
+
+#define SHM_RING_SIZE 4096	/* must be power of two */
+#define SHM_MAILBOXES 4096	/* must be power of two */
+
+enum {
+	MAILBOX_EMPTY,
+	MAILBOX_READY,
+	MAILBOX_WAITING,
+};
+
+struct shm_slot {
+	uint32_t seq;
+	struct alloc_req request;
+};
+
+struct shm_mailbox {
+	pid_t owner;
+	uint32_t state;
+	struct alloc_resp response;
+};
+
+struct shm_data {
+	uint32_t shutdown;
+
+	/* Producers claim slots by bumping the tail */
+	uint32_t tail __attribute__((aligned(64)));
+	uint32_t space_seq;
+	uint32_t space_waiters;
+
+	/* Only touched by the allocator thread, apart from the wakeups */
+	uint32_t head __attribute__((aligned(64)));
+	uint32_t req_seq;
+	uint32_t consumer_waiting;
+	uint32_t consumers;
+
+	struct shm_slot ring[SHM_RING_SIZE] __attribute__((aligned(64)));
+	struct shm_mailbox mailbox[SHM_MAILBOXES];
+};
+
+static int shm_futex_wait(uint32_t *addr, uint32_t val)
+{
+	int ret;
+
+	/* Shared mapping between processes, so no FUTEX_PRIVATE_FLAG */
+	ret = syscall(SYS_futex, addr, FUTEX_WAIT, val, NULL, NULL, 0);
+	if (ret == -1 && (errno == EAGAIN || errno == EINTR))
+		ret = 0;
+
+	return ret;
+}
+
+static void shm_futex_wake(uint32_t *addr, int count)
+{
+	syscall(SYS_futex, addr, FUTEX_WAKE, count, NULL, NULL, 0);
+}
+
+static bool shm_shutdown(struct shm_data *shm)
+{
+	return __atomic_load_n(&shm->shutdown, __ATOMIC_ACQUIRE);
+}
+
+static void shm_init(struct msg_channel *channel)
+{
+	struct shm_data *shm;
+
+	igt_debug("Init shared memory channel\n");
+
+	shm = mmap(NULL, sizeof(*shm), PROT_READ | PROT_WRITE,
+		   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	igt_assert(shm != MAP_FAILED);
+
+	for (int i = 0; i < SHM_RING_SIZE; i++)
+		shm->ring[i].seq = i;
+
+	channel->priv = shm;
+	channel->ready = true;
+}
+
+#define SHM_DEINIT_TIMEOUT_MS 100
+static void shm_deinit(struct msg_channel *channel)
+{
+	struct shm_data *shm = channel->priv;
+	int time_left = SHM_DEINIT_TIMEOUT_MS;
+
+	igt_debug("Deinit shared memory channel\n");
+
+	/* Kick everyone still sleeping on the channel */
+	__atomic_store_n(&shm->shutdown, 1, __ATOMIC_SEQ_CST);
+	__atomic_add_fetch(&shm->req_seq, 1, __ATOMIC_SEQ_CST);
+	__atomic_add_fetch(&shm->space_seq, 1, __ATOMIC_SEQ_CST);
+	shm_futex_wake(&shm->req_seq, INT_MAX);
+	shm_futex_wake(&shm->space_seq, INT_MAX);
+	for (int i = 0; i < SHM_MAILBOXES; i++)
+		if (__atomic_load_n(&shm->mailbox[i].state, __ATOMIC_ACQUIRE) ==
+		    MAILBOX_WAITING)
+			shm_futex_wake(&shm->mailbox[i].state, INT_MAX);
+
+	/* Don't pull the mapping from under the allocator thread */
+	while (time_left-- > 0 &&
+	       __atomic_load_n(&shm->consumers, __ATOMIC_ACQUIRE))
+		usleep(1000);
+
+	if (!__atomic_load_n(&shm->consumers, __ATOMIC_ACQUIRE))
+		munmap(shm, sizeof(*shm));
+	else
+		igt_warn("Allocator thread still active, leaking channel\n");
+
+	channel->priv = NULL;
+	channel->ready = false;
+}
+
+static struct shm_mailbox *shm_get_mailbox(struct shm_data *shm, pid_t tid,
+					   bool claim)
+{
+	/* Thread ids are mostly sequential, use them directly as a hash */
+	uint32_t idx = tid;
+	bool reclaim = false;
+
+retry:
+	for (int i = 0; i < SHM_MAILBOXES; i++) {
+		struct shm_mailbox *mb = &shm->mailbox[(idx + i) & (SHM_MAILBOXES - 1)];
+		pid_t owner = __atomic_load_n(&mb->owner, __ATOMIC_ACQUIRE);
+
+		if (owner == tid)
+			return mb;
+
+		if (!claim)
+			continue;
+
+		/* Reuse boxes left behind by threads which are gone */
+		if (reclaim && owner &&
+		    kill(owner, 0) == -1 && errno == ESRCH &&
+		    __atomic_compare_exchange_n(&mb->owner, &owner, tid, false,
+						__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+			return mb;
+
+		owner = 0;
+		if (__atomic_compare_exchange_n(&mb->owner, &owner, tid, false,
+						__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+			return mb;
+
+		if (owner == tid)
+			return mb;
+	}
+
+	if (claim && !reclaim) {
+		reclaim = true;
+		goto retry;
+	}
+
+	return NULL;
+}
+
+static int shm_send_req(struct msg_channel *channel,
+			struct alloc_req *request)
+{
+	struct shm_data *shm = channel->priv;
+	struct shm_mailbox *mb;
+	struct shm_slot *slot;
+	uint32_t pos, seq, space;
+	int32_t diff;
+
+	/* Stop request comes from the parent which doesn't wait for response */
+	if (request->request_type != REQ_STOP) {
+		mb = shm_get_mailbox(shm, request->tid, true);
+		if (!mb) {
+			igt_warn("Error: no free mailbox for tid %d\n",
+				 request->tid);
+			errno = ENOSPC;
+			return -1;
+		}
+		__atomic_store_n(&mb->state, MAILBOX_EMPTY, __ATOMIC_RELAXED);
+	}
+
+	pos = __atomic_load_n(&shm->tail, __ATOMIC_RELAXED);
+	for (;;) {
+		if (shm_shutdown(shm)) {
+			errno = EPIPE;
+			return -1;
+		}
+
+		slot = &shm->ring[pos & (SHM_RING_SIZE - 1)];
+		seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+		diff = (int32_t)(seq - pos);
+
+		if (diff == 0) {
+			if (__atomic_compare_exchange_n(&shm->tail, &pos, pos + 1,
+							true, __ATOMIC_RELAXED,
+							__ATOMIC_RELAXED))
+				break;
+		} else if (diff < 0) {
+			/* Ring is full, wait for the allocator thread */
+			space = __atomic_load_n(&shm->space_seq, __ATOMIC_SEQ_CST);
+			__atomic_add_fetch(&shm->space_waiters, 1, __ATOMIC_SEQ_CST);
+			if (__atomic_load_n(&slot->seq, __ATOMIC_SEQ_CST) == seq)
+				shm_futex_wait(&shm->space_seq, space);
+			__atomic_sub_fetch(&shm->space_waiters, 1, __ATOMIC_SEQ_CST);
+			pos = __atomic_load_n(&shm->tail, __ATOMIC_RELAXED);
+		} else {
+			pos = __atomic_load_n(&shm->tail, __ATOMIC_RELAXED);
+		}
+	}
+
+	memcpy(&slot->request, request, sizeof(*request));
+	__atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+
+	__atomic_add_fetch(&shm->req_seq, 1, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&shm->consumer_waiting, __ATOMIC_SEQ_CST))
+		shm_futex_wake(&shm->req_seq, 1);
+
+	return 0;
+}
+
+static int shm_recv_req(struct msg_channel *channel,
+			struct alloc_req *request)
+{
+	struct shm_data *shm = channel->priv;
+	struct shm_slot *slot;
+	uint32_t pos, req;
+	int ret = -1;
+
+	__atomic_add_fetch(&shm->consumers, 1, __ATOMIC_SEQ_CST);
+
+	pos = shm->head;
+	slot = &shm->ring[pos & (SHM_RING_SIZE - 1)];
+
+	while (!shm_shutdown(shm)) {
+		if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) == pos + 1) {
+			memcpy(request, &slot->request, sizeof(*request));
+			__atomic_store_n(&slot->seq, pos + SHM_RING_SIZE,
+					 __ATOMIC_RELEASE);
+			shm->head = pos + 1;
+
+			__atomic_add_fetch(&shm->space_seq, 1, __ATOMIC_SEQ_CST);
+			if (__atomic_load_n(&shm->space_waiters, __ATOMIC_SEQ_CST))
+				shm_futex_wake(&shm->space_seq, INT_MAX);
+
+			ret = sizeof(*request);
+			break;
+		}
+
+		req = __atomic_load_n(&shm->req_seq, __ATOMIC_SEQ_CST);
+		__atomic_store_n(&shm->consumer_waiting, 1, __ATOMIC_SEQ_CST);
+		if (__atomic_load_n(&slot->seq, __ATOMIC_SEQ_CST) != pos + 1 &&
+		    !shm_shutdown(shm))
+			shm_futex_wait(&shm->req_seq, req);
+		__atomic_store_n(&shm->consumer_waiting, 0, __ATOMIC_SEQ_CST);
+	}
+
+	if (ret == -1)
+		errno = EPIPE;
+
+	__atomic_sub_fetch(&shm->consumers, 1, __ATOMIC_SEQ_CST);
+
+	return ret;
+}
+
+static int shm_send_resp(struct msg_channel *channel,
+			 struct alloc_resp *response)
+{
+	struct shm_data *shm = channel->priv;
+	struct shm_mailbox *mb;
+
+	mb = shm_get_mailbox(shm, response->tid, false);
+	if (!mb) {
+		igt_warn("Error: no mailbox for tid %d\n", response->tid);
+		errno = ENOENT;
+		return -1;
+	}
+
+	memcpy(&mb->response, response, sizeof(*response));
+	if (__atomic_exchange_n(&mb->state, MAILBOX_READY, __ATOMIC_SEQ_CST) ==
+	    MAILBOX_WAITING)
+		shm_futex_wake(&mb->state, 1);
+
+	return 0;
+}
+
+static int shm_recv_resp(struct msg_channel *channel,
+			 struct alloc_resp *response)
+{
+	struct shm_data *shm = channel->priv;
+	struct shm_mailbox *mb;
+	uint32_t state;
+
+	mb = shm_get_mailbox(shm, response->tid, false);
+	if (!mb) {
+		errno = ENOENT;
+		return -1;
+	}
+
+	for (;;) {
+		state = __atomic_load_n(&mb->state, __ATOMIC_ACQUIRE);
+		if (state == MAILBOX_READY)
+			break;
+
+		if (shm_shutdown(shm)) {
+			errno = EPIPE;
+			return -1;
+		}
+
+		if (state == MAILBOX_EMPTY &&
+		    !__atomic_compare_exchange_n(&mb->state, &state,
+						 MAILBOX_WAITING, false,
+						 __ATOMIC_SEQ_CST,
+						 __ATOMIC_SEQ_CST))
+			continue;
+
+		shm_futex_wait(&mb->state, MAILBOX_WAITING);
+	}
+
+	memcpy(response, &mb->response, sizeof(*response));
+	__atomic_store_n(&mb->state, MAILBOX_EMPTY, __ATOMIC_RELAXED);
+
+	return sizeof(*response);
+}
+
+static struct msg_channel shm_channel = {
+	.priv = NULL,
+	.init = shm_init,
+	.deinit = shm_deinit,
+	.send_req = shm_send_req,
+	.recv_req = shm_recv_req,
+	.send_resp = shm_send_resp,
+	.recv_resp = shm_recv_resp,
+};
+
 struct msg_channel *intel_allocator_get_msgchannel(enum msg_channel_type type)
 {
 	struct msg_channel *channel = NULL;
@@ -189,6 +533,10 @@ struct msg_channel *intel_allocator_get_msgchannel(enum msg_channel_type type)
 	switch (type) {
 	case CHANNEL_SYSVIPC_MSGQUEUE:
 		channel = &msgqueue_channel;
+		break;
+	case CHANNEL_SHM_RING:
+		channel = &shm_channel;
+		break;
 	}
 
 	igt_assert(channel);
@@ -23,6 +23,8 @@ enum reqtype {
 	REQ_UNRESERVE,
 	REQ_RESERVE_IF_NOT_ALLOCATED,
 	REQ_IS_RESERVED,
+	REQ_ALLOC_BATCH,
+	REQ_FREE_BATCH,
 };
 
 enum resptype {
@@ -36,8 +38,13 @@ enum resptype {
 	RESP_UNRESERVE,
 	RESP_IS_RESERVED,
 	RESP_RESERVE_IF_NOT_ALLOCATED,
+	RESP_ALLOC_BATCH,
+	RESP_FREE_BATCH,
 };
 
+/* Maximum number of objects handled in a single batch request */
+#define ALLOC_BATCH_MAX 16
+
 struct alloc_req {
 	enum reqtype request_type;
 
@@ -86,6 +93,21 @@ struct alloc_req {
 			uint64_t end;
 		} is_reserved;
 
+		struct {
+			uint8_t pat_index;
+			uint8_t strategy;
+			uint32_t count;
+			struct {
+				uint32_t handle;
+				uint64_t size;
+				uint64_t alignment;
+			} objs[ALLOC_BATCH_MAX];
+		} alloc_batch;
+
+		struct {
+			uint32_t count;
+			uint32_t handles[ALLOC_BATCH_MAX];
+		} free_batch;
 	};
 };
 
@@ -105,6 +127,7 @@ struct alloc_resp {
 		struct {
 			uint64_t start;
 			uint64_t end;
+			uint64_t default_alignment;
 			uint8_t direction;
 		} address_range;
 
@@ -132,6 +155,15 @@ struct alloc_resp {
 			bool allocated;
 			bool reserved;
 		} reserve_if_not_allocated;
+
+		struct {
+			uint32_t count;
+			uint64_t offsets[ALLOC_BATCH_MAX];
+		} alloc_batch;
+
+		struct {
+			uint32_t freed;
+		} free_batch;
 	};
 };
 
@@ -147,7 +179,8 @@ struct msg_channel {
 };
 
 enum msg_channel_type {
-	CHANNEL_SYSVIPC_MSGQUEUE
+	CHANNEL_SYSVIPC_MSGQUEUE,
+	CHANNEL_SHM_RING,
 };
 
 struct msg_channel *intel_allocator_get_msgchannel(enum msg_channel_type type);
@@ -210,6 +210,15 @@ static bool intel_allocator_reloc_is_empty(struct intel_allocator *ial)
 	return !ialr->allocated_objects;
 }
 
+static void intel_allocator_reloc_get_usage(struct intel_allocator *ial,
+					    struct intel_allocator_stats *stats)
+{
+	struct intel_allocator_reloc *ialr = ial->priv;
+
+	/* Offsets are only handed out, there's no address space tracking */
+	stats->live_objects = ialr->allocated_objects;
+}
+
 struct intel_allocator *
 intel_allocator_reloc_create(int fd, uint64_t start, uint64_t end)
 {
@@ -231,6 +240,7 @@ intel_allocator_reloc_create(int fd, uint64_t start, uint64_t end)
 	ial->destroy = intel_allocator_reloc_destroy;
 	ial->print = intel_allocator_reloc_print;
 	ial->is_empty = intel_allocator_reloc_is_empty;
+	ial->get_usage = intel_allocator_reloc_get_usage;
 
 	ialr = ial->priv = calloc(1, sizeof(*ialr));
 	igt_assert(ial->priv);
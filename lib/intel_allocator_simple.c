@@ -16,10 +16,18 @@
 struct intel_allocator *
 intel_allocator_simple_create(int fd, uint64_t start, uint64_t end,
 			      enum allocator_strategy strategy);
+struct intel_allocator *
+intel_allocator_tree_create(int fd, uint64_t start, uint64_t end,
+			    enum allocator_strategy strategy);
 
 struct simple_vma_heap {
 	struct igt_list_head holes;
 	enum allocator_strategy strategy;
+
+	/* Tree heap, holes are in root instead of holes list */
+	bool tree;
+	struct simple_vma_node *root;
+	uint32_t seed;
 };
 
 struct simple_vma_hole {
@@ -68,6 +76,376 @@ static void map_entry_free_func(struct igt_map_entry *entry)
 #define GEN8_GTT_ADDRESS_WIDTH 48
 #define DECANONICAL(offset) (offset & ((1ull << GEN8_GTT_ADDRESS_WIDTH) - 1))
 
+/*
+ * Tree heap. Holes are kept in a treap ordered by offset, where each node
+ * also tracks the largest hole size within its subtree. This lets alloc skip
+ * whole subtrees which can't fit the request and keeps alloc/free
+ * logarithmic, even with 100k+ objects bound. The allocation results are the
+ * same as for the list heap - the first fitting hole walking from the top
+ * (HIGH_TO_LOW) or from the bottom (LOW_TO_HIGH) of the address space.
+ */
+struct simple_vma_node {
+	struct simple_vma_node *left;
+	struct simple_vma_node *right;
+	uint64_t offset;
+	uint64_t size;
+	uint64_t max_size;
+	uint32_t priority;
+};
+
+static inline uint64_t node_max_size(struct simple_vma_node *node)
+{
+	return node ? node->max_size : 0;
+}
+
+static void node_update(struct simple_vma_node *node)
+{
+	node->max_size = max(node->size, max(node_max_size(node->left),
+					     node_max_size(node->right)));
+}
+
+/* Own prng, don't disturb the random() sequence of the tests */
+static uint32_t tree_heap_priority(struct simple_vma_heap *heap)
+{
+	uint32_t x = heap->seed;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	heap->seed = x;
+
+	return x;
+}
+
+static struct simple_vma_node *
+tree_merge(struct simple_vma_node *low, struct simple_vma_node *high)
+{
+	if (!low)
+		return high;
+	if (!high)
+		return low;
+
+	if (low->priority > high->priority) {
+		low->right = tree_merge(low->right, high);
+		node_update(low);
+		return low;
+	}
+
+	high->left = tree_merge(low, high->left);
+	node_update(high);
+	return high;
+}
+
+/* Splits into nodes with offset < @offset and the rest */
+static void tree_split(struct simple_vma_node *node, uint64_t offset,
+		       struct simple_vma_node **low,
+		       struct simple_vma_node **high)
+{
+	if (!node) {
+		*low = *high = NULL;
+		return;
+	}
+
+	if (node->offset < offset) {
+		tree_split(node->right, offset, &node->right, high);
+		*low = node;
+	} else {
+		tree_split(node->left, offset, low, &node->left);
+		*high = node;
+	}
+	node_update(node);
+}
+
+static void tree_heap_insert(struct simple_vma_heap *heap,
+			     uint64_t offset, uint64_t size)
+{
+	struct simple_vma_node *node, *low, *high;
+
+	node = calloc(1, sizeof(*node));
+	igt_assert(node);
+	node->offset = offset;
+	node->size = size;
+	node->max_size = size;
+	node->priority = tree_heap_priority(heap);
+
+	tree_split(heap->root, offset, &low, &high);
+	heap->root = tree_merge(tree_merge(low, node), high);
+}
+
+static struct simple_vma_node *
+tree_erase(struct simple_vma_node *node, uint64_t offset)
+{
+	struct simple_vma_node *ret;
+
+	igt_assert(node);
+
+	if (node->offset == offset) {
+		ret = tree_merge(node->left, node->right);
+		free(node);
+		return ret;
+	}
+
+	if (offset < node->offset)
+		node->left = tree_erase(node->left, offset);
+	else
+		node->right = tree_erase(node->right, offset);
+	node_update(node);
+
+	return node;
+}
+
+/*
+ * Refreshes max_size on the path to the node at @offset. Moving the offset
+ * of a hole within its neighbours doesn't change the ordering, so the node
+ * can be modified in place first.
+ */
+static void tree_fixup(struct simple_vma_node *node, uint64_t offset)
+{
+	igt_assert(node);
+
+	if (offset < node->offset)
+		tree_fixup(node->left, offset);
+	else if (offset > node->offset)
+		tree_fixup(node->right, offset);
+	node_update(node);
+}
+
+/* Highest hole with offset <= @offset */
+static struct simple_vma_node *tree_find_le(struct simple_vma_heap *heap,
+					    uint64_t offset)
+{
+	struct simple_vma_node *node = heap->root, *found = NULL;
+
+	while (node) {
+		if (node->offset <= offset) {
+			found = node;
+			node = node->right;
+		} else {
+			node = node->left;
+		}
+	}
+
+	return found;
+}
+
+/* Lowest hole with offset > @offset */
+static struct simple_vma_node *tree_find_gt(struct simple_vma_heap *heap,
+					    uint64_t offset)
+{
+	struct simple_vma_node *node = heap->root, *found = NULL;
+
+	while (node) {
+		if (node->offset > offset) {
+			found = node;
+			node = node->left;
+		} else {
+			node = node->right;
+		}
+	}
+
+	return found;
+}
+
+static void tree_heap_free(struct simple_vma_heap *heap,
+			   uint64_t offset, uint64_t size)
+{
+	struct simple_vma_node *high_hole, *low_hole;
+	bool high_adjacent, low_adjacent;
+
+	igt_assert(size > 0);
+	igt_assert(offset + size == 0 || offset + size > offset);
+
+	low_hole = tree_find_le(heap, offset);
+	high_hole = tree_find_gt(heap, offset);
+
+	if (high_hole)
+		igt_assert(offset + size <= high_hole->offset);
+	high_adjacent = high_hole && offset + size == high_hole->offset;
+
+	if (low_hole) {
+		igt_assert(low_hole->offset + low_hole->size > low_hole->offset);
+		igt_assert(low_hole->offset + low_hole->size <= offset);
+	}
+	low_adjacent = low_hole && low_hole->offset + low_hole->size == offset;
+
+	if (low_adjacent && high_adjacent) {
+		low_hole->size += size + high_hole->size;
+		heap->root = tree_erase(heap->root, high_hole->offset);
+		tree_fixup(heap->root, low_hole->offset);
+	} else if (low_adjacent) {
+		low_hole->size += size;
+		tree_fixup(heap->root, low_hole->offset);
+	} else if (high_adjacent) {
+		high_hole->offset = offset;
+		high_hole->size += size;
+		tree_fixup(heap->root, high_hole->offset);
+	} else {
+		tree_heap_insert(heap, offset, size);
+	}
+}
+
+static void tree_hole_alloc(struct simple_vma_heap *heap,
+			    struct simple_vma_node *hole,
+			    uint64_t offset, uint64_t size)
+{
+	uint64_t waste;
+
+	igt_assert(hole->offset <= offset);
+	igt_assert(hole->size >= offset - hole->offset + size);
+
+	if (offset == hole->offset && size == hole->size) {
+		heap->root = tree_erase(heap->root, hole->offset);
+		return;
+	}
+
+	waste = (hole->size - size) - (offset - hole->offset);
+	if (waste == 0) {
+		hole->size -= size;
+		tree_fixup(heap->root, hole->offset);
+		return;
+	}
+
+	if (offset == hole->offset) {
+		hole->offset += size;
+		hole->size -= size;
+		tree_fixup(heap->root, hole->offset);
+		return;
+	}
+
+	/* Allocated in the middle, split into low and high hole */
+	hole->size = offset - hole->offset;
+	tree_fixup(heap->root, hole->offset);
+	tree_heap_insert(heap, offset + size, waste);
+}
+
+static bool tree_hole_fits(struct simple_vma_node *hole, uint64_t *offset,
+			   uint64_t size, uint64_t alignment,
+			   enum allocator_strategy strategy)
+{
+	uint64_t misalign;
+
+	if (size > hole->size)
+		return false;
+
+	if (strategy == ALLOC_STRATEGY_HIGH_TO_LOW) {
+		*offset = (hole->size - size) + hole->offset;
+		*offset = (*offset / alignment) * alignment;
+
+		return *offset >= hole->offset;
+	}
+
+	*offset = hole->offset;
+	misalign = *offset % alignment;
+	if (misalign) {
+		uint64_t pad = alignment - misalign;
+
+		if (pad > hole->size - size)
+			return false;
+
+		*offset += pad;
+	}
+
+	return true;
+}
+
+static struct simple_vma_node *
+tree_find_hole(struct simple_vma_node *node, uint64_t *offset,
+	       uint64_t size, uint64_t alignment,
+	       enum allocator_strategy strategy)
+{
+	struct simple_vma_node *first, *second, *found;
+
+	if (node_max_size(node) < size)
+		return NULL;
+
+	if (strategy == ALLOC_STRATEGY_HIGH_TO_LOW) {
+		first = node->right;
+		second = node->left;
+	} else {
+		first = node->left;
+		second = node->right;
+	}
+
+	found = tree_find_hole(first, offset, size, alignment, strategy);
+	if (found)
+		return found;
+
+	if (tree_hole_fits(node, offset, size, alignment, strategy))
+		return node;
+
+	return tree_find_hole(second, offset, size, alignment, strategy);
+}
+
+static bool tree_heap_alloc(struct simple_vma_heap *heap,
+			    uint64_t *offset, uint64_t size,
+			    uint64_t alignment,
+			    enum allocator_strategy strategy)
+{
+	struct simple_vma_node *hole;
+
+	hole = tree_find_hole(heap->root, offset, size, alignment, strategy);
+	if (!hole)
+		return false;
+
+	tree_hole_alloc(heap, hole, *offset, size);
+
+	return true;
+}
+
+static bool tree_heap_alloc_addr(struct simple_vma_heap *heap,
+				 uint64_t offset, uint64_t size)
+{
+	struct simple_vma_node *hole;
+
+	hole = tree_find_le(heap, offset);
+	if (!hole || hole->size < offset - hole->offset + size)
+		return false;
+
+	tree_hole_alloc(heap, hole, offset, size);
+
+	return true;
+}
+
+static void tree_heap_destroy(struct simple_vma_node *node)
+{
+	if (!node)
+		return;
+
+	tree_heap_destroy(node->left);
+	tree_heap_destroy(node->right);
+	free(node);
+}
+
+/* Walks the holes from high to low like the list heap */
+static uint64_t tree_heap_walk(struct simple_vma_node *node, bool print)
+{
+	uint64_t total;
+
+	if (!node)
+		return 0;
+
+	total = tree_heap_walk(node->right, print);
+	if (print)
+		igt_info("offset = %"PRIu64" (0x%"PRIx64", "
+			 "size = %"PRIu64" (0x%"PRIx64")\n",
+			 node->offset, node->offset, node->size,
+			 node->size);
+	total += node->size;
+	total += tree_heap_walk(node->left, print);
+
+	return total;
+}
+
+static void tree_heap_count(struct simple_vma_node *node, uint64_t *holes,
+			    uint64_t *total)
+{
+	for (; node; node = node->left) {
+		tree_heap_count(node->right, holes, total);
+		(*holes)++;
+		*total += node->size;
+	}
+}
+
 static void simple_vma_heap_validate(struct simple_vma_heap *heap)
 {
 	uint64_t prev_offset = 0;
@@ -113,6 +491,11 @@ static void simple_vma_heap_free(struct simple_vma_heap *heap,
 	 */
 	igt_assert(offset + size == 0 || offset + size > offset);
 
+	if (heap->tree) {
+		tree_heap_free(heap, offset, size);
+		return;
+	}
+
 	simple_vma_heap_validate(heap);
 
 	/* Find immediately higher and lower holes if they exist. */
@@ -168,9 +551,12 @@ static void simple_vma_heap_free(struct simple_vma_heap *heap,
 
 static void simple_vma_heap_init(struct simple_vma_heap *heap,
 				 uint64_t start, uint64_t size,
-				 enum allocator_strategy strategy)
+				 enum allocator_strategy strategy, bool tree)
 {
 	IGT_INIT_LIST_HEAD(&heap->holes);
+	heap->tree = tree;
+	heap->root = NULL;
+	heap->seed = 0x9e3779b9;
 	simple_vma_heap_free(heap, start, size);
 
 	/* Use LOW_TO_HIGH or HIGH_TO_LOW strategy only */
@@ -184,6 +570,12 @@ static void simple_vma_heap_finish(struct simple_vma_heap *heap)
 {
 	struct simple_vma_hole *hole, *tmp;
 
+	if (heap->tree) {
+		tree_heap_destroy(heap->root);
+		heap->root = NULL;
+		return;
+	}
+
 	simple_vma_foreach_hole_safe(hole, heap, tmp)
 		free(hole);
 }
@@ -254,8 +646,6 @@ static bool simple_vma_heap_alloc(struct simple_vma_heap *heap,
 	igt_assert(size > 0);
 	igt_assert(alignment > 0);
 
-	simple_vma_heap_validate(heap);
-
 	/* Ensure we support only NONE/LOW_TO_HIGH/HIGH_TO_LOW strategies */
 	igt_assert(strategy == ALLOC_STRATEGY_NONE ||
 		   strategy == ALLOC_STRATEGY_LOW_TO_HIGH ||
@@ -265,6 +655,11 @@ static bool simple_vma_heap_alloc(struct simple_vma_heap *heap,
 	if (strategy == ALLOC_STRATEGY_NONE)
 		strategy = heap->strategy;
 
+	if (heap->tree)
+		return tree_heap_alloc(heap, offset, size, alignment, strategy);
+
+	simple_vma_heap_validate(heap);
+
 	if (strategy == ALLOC_STRATEGY_HIGH_TO_LOW) {
 		simple_vma_foreach_hole_safe(hole, heap, tmp) {
 			if (size > hole->size)
@@ -348,6 +743,9 @@ static bool simple_vma_heap_alloc_addr(struct intel_allocator_simple *ials,
 	 */
 	igt_assert(offset + size == 0 || offset + size > offset);
 
+	if (heap->tree)
+		return tree_heap_alloc_addr(heap, offset, size);
+
 	/* Find the hole if one exists. */
 	simple_vma_foreach_hole_safe(hole, heap, tmp) {
 		if (hole->offset > offset)
@@ -638,12 +1036,16 @@ static void intel_allocator_simple_print(struct intel_allocator *ial, bool full)
 
 	if (full) {
 		igt_info("holes:\n");
-		simple_vma_foreach_hole(hole, heap) {
-			igt_info("offset = %"PRIu64" (0x%"PRIx64", "
-				 "size = %"PRIu64" (0x%"PRIx64")\n",
-				 hole->offset, hole->offset, hole->size,
-				 hole->size);
-			total_free += hole->size;
+		if (heap->tree) {
+			total_free = tree_heap_walk(heap->root, true);
+		} else {
+			simple_vma_foreach_hole(hole, heap) {
+				igt_info("offset = %"PRIu64" (0x%"PRIx64", "
+					 "size = %"PRIu64" (0x%"PRIx64")\n",
+					 hole->offset, hole->offset, hole->size,
+					 hole->size);
+				total_free += hole->size;
+			}
 		}
 		igt_assert(total_free <= ials->total_size);
 		igt_info("total_free: %" PRIx64
@@ -682,6 +1084,8 @@ static void intel_allocator_simple_print(struct intel_allocator *ial, bool full)
 		}
 		igt_assert(ials->reserved_areas == reserved_areas);
 		igt_assert(ials->reserved_size == reserved_size);
+	} else if (heap->tree) {
+		total_free = tree_heap_walk(heap->root, false);
 	} else {
 		simple_vma_foreach_hole(hole, heap)
 			total_free += hole->size;
@@ -695,14 +1099,42 @@ static void intel_allocator_simple_print(struct intel_allocator *ial, bool full)
 		 ials->allocated_objects, ials->reserved_areas);
 }
 
-struct intel_allocator *
-intel_allocator_simple_create(int fd, uint64_t start, uint64_t end,
-			      enum allocator_strategy strategy)
+static void intel_allocator_simple_get_usage(struct intel_allocator *ial,
+					     struct intel_allocator_stats *stats)
+{
+	struct intel_allocator_simple *ials = ial->priv;
+	struct simple_vma_heap *heap = &ials->heap;
+	struct simple_vma_hole *hole;
+
+	stats->live_objects = ials->allocated_objects;
+	stats->live_bytes = ials->allocated_size;
+	stats->reserved_areas = ials->reserved_areas;
+	stats->reserved_bytes = ials->reserved_size;
+	stats->free_bytes = 0;
+	stats->holes = 0;
+
+	if (heap->tree) {
+		tree_heap_count(heap->root, &stats->holes, &stats->free_bytes);
+		stats->largest_hole = node_max_size(heap->root);
+	} else {
+		stats->largest_hole = 0;
+		simple_vma_foreach_hole(hole, heap) {
+			stats->holes++;
+			stats->free_bytes += hole->size;
+			stats->largest_hole = max(stats->largest_hole,
+						  hole->size);
+		}
+	}
+}
+
+static struct intel_allocator *
+__intel_allocator_simple_create(int fd, uint64_t start, uint64_t end,
+				enum allocator_strategy strategy, bool tree)
 {
 	struct intel_allocator *ial;
 	struct intel_allocator_simple *ials;
 
-	igt_debug("Using simple allocator\n");
+	igt_debug("Using simple allocator%s\n", tree ? " (tree heap)" : "");
 
 	ial = calloc(1, sizeof(*ial));
 	igt_assert(ial);
@@ -718,6 +1150,7 @@ intel_allocator_simple_create(int fd, uint64_t start, uint64_t end,
 	ial->destroy = intel_allocator_simple_destroy;
 	ial->is_empty = intel_allocator_simple_is_empty;
 	ial->print = intel_allocator_simple_print;
+	ial->get_usage = intel_allocator_simple_get_usage;
 	ials = ial->priv = malloc(sizeof(struct intel_allocator_simple));
 	igt_assert(ials);
 
@@ -729,7 +1162,7 @@ intel_allocator_simple_create(int fd, uint64_t start, uint64_t end,
 	ials->end = end;
 	ials->total_size = end - start;
 	simple_vma_heap_init(&ials->heap, ials->start, ials->total_size,
-			     strategy);
+			     strategy, tree);
 
 	ials->allocated_size = 0;
 	ials->allocated_objects = 0;
@@ -738,3 +1171,17 @@ intel_allocator_simple_create(int fd, uint64_t start, uint64_t end,
 
 	return ial;
 }
+
+struct intel_allocator *
+intel_allocator_simple_create(int fd, uint64_t start, uint64_t end,
+			      enum allocator_strategy strategy)
+{
+	return __intel_allocator_simple_create(fd, start, end, strategy, false);
+}
+
+struct intel_allocator *
+intel_allocator_tree_create(int fd, uint64_t start, uint64_t end,
+			    enum allocator_strategy strategy)
+{
+	return __intel_allocator_simple_create(fd, start, end, strategy, true);
+}
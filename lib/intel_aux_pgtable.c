@@ -99,7 +99,8 @@ pgt_table_count(int address_bits, struct intel_buf **bufs, int buf_count)
 }
 
 static void
-pgt_calc_size(struct pgtable *pgt, struct intel_buf **bufs, int buf_count)
+pgt_calc_size(struct pgtable *pgt, struct intel_buf **bufs, int buf_count,
+	      int spare)
 {
 	int level;
 
@@ -114,6 +115,9 @@ pgt_calc_size(struct pgtable *pgt, struct intel_buf **bufs, int buf_count)
 		li->table_count = pgt_table_count(li->desc->idx_shift +
 						  li->desc->idx_bits,
 						  bufs, buf_count);
+		/* Room for tables added later, the top table stays single. */
+		if (level < pgt->levels - 1)
+			li->table_count += spare;
 
 		pgt->size = li->alloc_base +
 			    li->table_count * li->desc->table_size;
@@ -134,6 +138,26 @@ static uint64_t pgt_alloc_table(struct pgtable *pgt, int level)
 	return table;
 }
 
+/* Whether the tables still free are enough to map @bufs. */
+static bool
+pgt_has_room(struct pgtable *pgt, struct intel_buf **bufs, int buf_count)
+{
+	int level;
+
+	for (level = 0; level < pgt->levels - 1; level++) {
+		struct pgtable_level_info *li = &pgt->level_info[level];
+		int needed = pgt_table_count(li->desc->idx_shift +
+					     li->desc->idx_bits,
+					     bufs, buf_count);
+
+		if (li->alloc_ptr + needed * li->desc->table_size >
+		    li->alloc_base + li->table_count * li->desc->table_size)
+			return false;
+	}
+
+	return true;
+}
+
 static int pgt_entry_index(struct pgtable *pgt, int level, uint64_t address)
 {
 	const struct pgtable_level_desc *ld = pgt->level_info[level].desc;
@@ -341,19 +365,34 @@ static uint64_t pgt_get_lx_flags(void)
 	return entry.l;
 }
 
+struct aux_pgtable_surface {
+	uint64_t addr;
+	uint64_t end;
+	uint64_t aux_addr;
+	uint64_t l1_flags;
+};
+
 static void
-pgt_populate_entries_for_buf(struct pgtable *pgt,
-			     struct intel_buf *buf,
-			     uint64_t top_table,
-			     int surface_idx)
+pgt_get_surface(struct intel_buf *buf, int surface_idx,
+		struct aux_pgtable_surface *surface)
 {
-	uint64_t surface_addr = buf->addr.offset + buf->surface[surface_idx].offset;
-	uint64_t surface_end = surface_addr +  buf->surface[surface_idx].size;
-	uint64_t aux_addr = buf->addr.offset + buf->ccs[surface_idx].offset;
-	uint64_t l1_flags = pgt_get_l1_flags(buf, surface_idx);
-	uint64_t lx_flags = pgt_get_lx_flags();
-	uint64_t aux_ccs_block_size = 1 << pgt->level_info->desc[0].entry_ptr_shift;
+	igt_assert(!(buf->surface[surface_idx].stride % 512));
+	igt_assert_eq(buf->ccs[surface_idx].stride,
+		      buf->surface[surface_idx].stride / 512 * 64);
+
+	surface->addr = buf->addr.offset + buf->surface[surface_idx].offset;
+	surface->end = surface->addr + buf->surface[surface_idx].size;
+	surface->aux_addr = buf->addr.offset + buf->ccs[surface_idx].offset;
+	surface->l1_flags = pgt_get_l1_flags(buf, surface_idx);
+}
 
+static uint64_t pgt_aux_ccs_block_size(struct pgtable *pgt)
+{
+	return 1 << pgt->level_info->desc[0].entry_ptr_shift;
+}
+
+static uint64_t pgt_main_surface_block_size(struct pgtable *pgt)
+{
 	/*
 	 * The block size on the main surface mapped by one AUX CCS block:
 	 *       CCS block size *
@@ -361,15 +400,21 @@ pgt_populate_entries_for_buf(struct pgtable *pgt,
 	 *   2   bits per main surface CL *
 	 *   64  bytes per main surface CL
 	 */
-	uint64_t main_surface_block_size = aux_ccs_block_size * 8 / 2 * 64;
+	return pgt_aux_ccs_block_size(pgt) * 8 / 2 * 64;
+}
 
-	igt_assert(!(buf->surface[surface_idx].stride % 512));
-	igt_assert_eq(buf->ccs[surface_idx].stride,
-		      buf->surface[surface_idx].stride / 512 * 64);
+static void
+pgt_populate_entries_for_surface(struct pgtable *pgt,
+				 const struct aux_pgtable_surface *surface,
+				 uint64_t top_table)
+{
+	uint64_t surface_addr = surface->addr;
+	uint64_t aux_addr = surface->aux_addr;
+	uint64_t lx_flags = pgt_get_lx_flags();
 
-	for (; surface_addr < surface_end;
-	     surface_addr += main_surface_block_size,
-	     aux_addr += aux_ccs_block_size) {
+	for (; surface_addr < surface->end;
+	     surface_addr += pgt_main_surface_block_size(pgt),
+	     aux_addr += pgt_aux_ccs_block_size(pgt)) {
 		uint64_t table = top_table;
 		int level;
 
@@ -377,7 +422,56 @@ pgt_populate_entries_for_buf(struct pgtable *pgt,
 			table = pgt_get_child_table(pgt, table, level,
 						    surface_addr, lx_flags);
 
-		pgt_set_l1_entry(pgt, table, surface_addr, aux_addr, l1_flags);
+		pgt_set_l1_entry(pgt, table, surface_addr, aux_addr,
+				 surface->l1_flags);
+	}
+}
+
+static void
+pgt_populate_entries_for_buf(struct pgtable *pgt,
+			     struct intel_buf *buf,
+			     uint64_t top_table,
+			     int surface_idx)
+{
+	struct aux_pgtable_surface surface;
+
+	pgt_get_surface(buf, surface_idx, &surface);
+	pgt_populate_entries_for_surface(pgt, &surface, top_table);
+}
+
+/*
+ * Invalidates the L1 entries mapping @surface, the tables on the way stay
+ * allocated.
+ */
+static void
+pgt_clear_entries_for_surface(struct pgtable *pgt,
+			      const struct aux_pgtable_surface *surface,
+			      uint64_t top_table)
+{
+	uint64_t surface_addr;
+
+	for (surface_addr = surface->addr; surface_addr < surface->end;
+	     surface_addr += pgt_main_surface_block_size(pgt)) {
+		uint64_t table = top_table;
+		uint64_t *entry_ptr;
+		int level;
+
+		for (level = pgt->levels - 1; level >= 1; level--) {
+			entry_ptr = (uint64_t *)(pgt->ptr + table) +
+				    pgt_entry_index(pgt, level, surface_addr);
+			if (!*entry_ptr)
+				break;
+
+			table = (*entry_ptr & ptr_mask(pgt, level)) -
+				pgt->buf->addr.offset;
+		}
+
+		if (level)
+			continue;
+
+		entry_ptr = (uint64_t *)(pgt->ptr + table) +
+			    pgt_entry_index(pgt, 0, surface_addr);
+		*entry_ptr = 0;
 	}
 }
 
@@ -417,7 +511,7 @@ static void pgt_populate_entries(struct pgtable *pgt,
 
 static struct pgtable *
 pgt_create(const struct pgtable_level_desc *level_descs, int levels,
-	   struct intel_buf **bufs, int buf_count)
+	   struct intel_buf **bufs, int buf_count, int spare)
 {
 	struct pgtable *pgt;
 	int level;
@@ -438,7 +532,7 @@ pgt_create(const struct pgtable_level_desc *level_descs, int levels,
 			pgt->max_align = li->desc->table_size;
 	}
 
-	pgt_calc_size(pgt, bufs, buf_count);
+	pgt_calc_size(pgt, bufs, buf_count, spare);
 
 	return pgt;
 }
@@ -449,56 +543,56 @@ static void pgt_destroy(struct pgtable *pgt)
 	free(pgt);
 }
 
-struct intel_buf *
-intel_aux_pgtable_create(struct intel_bb *ibb,
-			 struct intel_buf **bufs, int buf_count)
-{
-	static const struct pgtable_level_desc level_desc_table_tgl[] = {
-		{
-			.idx_shift = 16,
-			.idx_bits = 8,
-			.entry_ptr_shift = 8,
-			.table_size = 8 * 1024,
-		},
-		{
-			.idx_shift = 24,
-			.idx_bits = 12,
-			.entry_ptr_shift = 13,
-			.table_size = 32 * 1024,
-		},
-		{
-			.idx_shift = 36,
-			.idx_bits = 12,
-			.entry_ptr_shift = 15,
-			.table_size = 32 * 1024,
-		}
-	};
-	static const struct pgtable_level_desc level_desc_table_mtl[] = {
-		{
-			.idx_shift = 20,
-			.idx_bits = 4,
-			.entry_ptr_shift = 12,
-			.table_size = 8 * 1024,
-		},
-		{
-			.idx_shift = 24,
-			.idx_bits = 12,
-			.entry_ptr_shift = 11,
-			.table_size = 32 * 1024,
-		},
-		{
-			.idx_shift = 36,
-			.idx_bits = 12,
-			.entry_ptr_shift = 15,
-			.table_size = 32 * 1024,
-		},
-	};
+static const struct pgtable_level_desc level_desc_table_tgl[] = {
+	{
+		.idx_shift = 16,
+		.idx_bits = 8,
+		.entry_ptr_shift = 8,
+		.table_size = 8 * 1024,
+	},
+	{
+		.idx_shift = 24,
+		.idx_bits = 12,
+		.entry_ptr_shift = 13,
+		.table_size = 32 * 1024,
+	},
+	{
+		.idx_shift = 36,
+		.idx_bits = 12,
+		.entry_ptr_shift = 15,
+		.table_size = 32 * 1024,
+	}
+};
 
+static const struct pgtable_level_desc level_desc_table_mtl[] = {
+	{
+		.idx_shift = 20,
+		.idx_bits = 4,
+		.entry_ptr_shift = 12,
+		.table_size = 8 * 1024,
+	},
+	{
+		.idx_shift = 24,
+		.idx_bits = 12,
+		.entry_ptr_shift = 11,
+		.table_size = 32 * 1024,
+	},
+	{
+		.idx_shift = 36,
+		.idx_bits = 12,
+		.entry_ptr_shift = 15,
+		.table_size = 32 * 1024,
+	},
+};
+
+static struct pgtable *
+aux_pgtable_alloc(struct intel_bb *ibb, struct intel_buf **bufs, int buf_count,
+		  int spare)
+{
 	const struct pgtable_level_desc *level_desc;
 	uint32_t levels;
 	struct pgtable *pgt;
 	struct buf_ops *bops;
-	struct intel_buf *buf;
 
 	igt_assert(buf_count);
 	bops = bufs[0]->bops;
@@ -511,7 +605,7 @@ intel_aux_pgtable_create(struct intel_bb *ibb,
 		levels = ARRAY_SIZE(level_desc_table_tgl);
 	}
 
-	pgt = pgt_create(&level_desc[0], levels, bufs, buf_count);
+	pgt = pgt_create(&level_desc[0], levels, bufs, buf_count, spare);
 	pgt->ibb = ibb;
 	pgt->buf = intel_buf_create(bops, pgt->size, 1, 8, 0, I915_TILING_NONE,
 				    I915_COMPRESSION_NONE);
@@ -520,6 +614,18 @@ intel_aux_pgtable_create(struct intel_bb *ibb,
 	intel_bb_add_intel_buf_with_alignment(ibb, pgt->buf,
 					      pgt->max_align, false);
 
+	return pgt;
+}
+
+struct intel_buf *
+intel_aux_pgtable_create(struct intel_bb *ibb,
+			 struct intel_buf **bufs, int buf_count)
+{
+	struct pgtable *pgt;
+	struct intel_buf *buf;
+
+	pgt = aux_pgtable_alloc(ibb, bufs, buf_count, 0);
+
 	pgt_map(ibb->fd, pgt);
 	pgt_populate_entries(pgt, bufs, buf_count);
 	pgt_unmap(pgt);
@@ -530,6 +636,208 @@ intel_aux_pgtable_create(struct intel_bb *ibb,
 	return buf;
 }
 
+/*
+ * The aux table cached by an intel_bb, see intel_bb_set_aux_pgtable_cache().
+ * It keeps the tables of the surfaces it mapped so far, the same surface
+ * coming back reuses its entries and a new one only adds the tables it
+ * misses. Tables are never freed, the whole table is rebuilt once they run
+ * out, or once the table bo moved.
+ */
+#define AUX_PGTABLE_CACHE_SPARE_TABLES	16
+#define AUX_PGTABLE_CACHE_MAPPINGS	16
+
+struct aux_pgtable_mapping {
+	int surface_count;
+	struct aux_pgtable_surface surface[2];
+};
+
+struct intel_aux_pgtable {
+	struct pgtable *pgt;
+	/* The address the entries were written for */
+	uint64_t offset;
+	int mapping_count;
+	struct aux_pgtable_mapping mappings[AUX_PGTABLE_CACHE_MAPPINGS];
+};
+
+static void
+aux_pgtable_mapping_init(struct aux_pgtable_mapping *mapping,
+			 struct intel_buf *buf)
+{
+	int i;
+
+	igt_assert_eq(buf->surface[0].offset, 0);
+
+	mapping->surface_count = buf->format_is_yuv_semiplanar ? 2 : 1;
+	for (i = 0; i < mapping->surface_count; i++)
+		pgt_get_surface(buf, i, &mapping->surface[i]);
+}
+
+static bool
+aux_pgtable_mapping_equal(const struct aux_pgtable_mapping *a,
+			  const struct aux_pgtable_mapping *b)
+{
+	return a->surface_count == b->surface_count &&
+	       !memcmp(a->surface, b->surface,
+		       a->surface_count * sizeof(a->surface[0]));
+}
+
+static bool
+aux_pgtable_mapping_overlap(const struct aux_pgtable_mapping *a,
+			    const struct aux_pgtable_mapping *b)
+{
+	int i, j;
+
+	for (i = 0; i < a->surface_count; i++)
+		for (j = 0; j < b->surface_count; j++)
+			if (a->surface[i].addr < b->surface[j].end &&
+			    b->surface[j].addr < a->surface[i].end)
+				return true;
+
+	return false;
+}
+
+static bool
+aux_pgtable_cache_lookup(struct intel_aux_pgtable *cache,
+			 const struct aux_pgtable_mapping *mapping)
+{
+	int i;
+
+	for (i = 0; i < cache->mapping_count; i++)
+		if (aux_pgtable_mapping_equal(&cache->mappings[i], mapping))
+			return true;
+
+	return false;
+}
+
+static struct intel_aux_pgtable *
+aux_pgtable_cache_create(struct intel_bb *ibb,
+			 struct intel_buf **bufs, int buf_count)
+{
+	struct intel_aux_pgtable *cache;
+	uint64_t top_table;
+
+	cache = calloc(1, sizeof(*cache));
+	igt_assert(cache);
+
+	cache->pgt = aux_pgtable_alloc(ibb, bufs, buf_count,
+				       AUX_PGTABLE_CACHE_SPARE_TABLES);
+	cache->offset = cache->pgt->buf->addr.offset;
+	pgt_map(ibb->fd, cache->pgt);
+
+	top_table = pgt_alloc_table(cache->pgt, cache->pgt->levels - 1);
+	/* Top level table must be at offset 0. */
+	igt_assert(top_table == 0);
+
+	return cache;
+}
+
+/* Releases the aux table kept by @ibb, if any. */
+void gen12_aux_pgtable_cache_destroy(struct intel_bb *ibb)
+{
+	struct intel_aux_pgtable *cache = ibb->aux_pgtable;
+
+	if (!cache)
+		return;
+
+	pgt_unmap(cache->pgt);
+	intel_buf_destroy(cache->pgt->buf);
+	pgt_destroy(cache->pgt);
+	free(cache);
+
+	ibb->aux_pgtable = NULL;
+}
+
+/*
+ * Brings the cached table of @ibb up to date with @bufs, sorted by address,
+ * and returns its bo, added to @ibb.
+ */
+static struct intel_buf *
+aux_pgtable_cache_update(struct intel_bb *ibb,
+			 struct intel_buf **bufs, int buf_count)
+{
+	struct intel_aux_pgtable *cache = ibb->aux_pgtable;
+	struct aux_pgtable_mapping mappings[2];
+	struct intel_buf *new_bufs[2];
+	int new_mappings[2];
+	int new_count = 0;
+	bool synced = false;
+	int i, j;
+
+	for (i = 0; i < buf_count; i++)
+		aux_pgtable_mapping_init(&mappings[i], bufs[i]);
+
+	if (cache) {
+		struct pgtable *pgt = cache->pgt;
+
+		intel_bb_add_intel_buf_with_alignment(ibb, pgt->buf,
+						      pgt->max_align, false);
+		if (pgt->buf->addr.offset != cache->offset)
+			cache->mapping_count = 0;
+
+		for (i = 0; i < buf_count; i++) {
+			if (aux_pgtable_cache_lookup(cache, &mappings[i]))
+				continue;
+
+			new_bufs[new_count] = bufs[i];
+			new_mappings[new_count++] = i;
+		}
+
+		if (!cache->mapping_count ||
+		    cache->mapping_count + new_count > AUX_PGTABLE_CACHE_MAPPINGS ||
+		    !pgt_has_room(pgt, new_bufs, new_count)) {
+			/* Earlier batches may still walk the old table. */
+			intel_bb_sync(ibb);
+			gen12_aux_pgtable_cache_destroy(ibb);
+			cache = NULL;
+		}
+	}
+
+	if (!cache) {
+		cache = aux_pgtable_cache_create(ibb, bufs, buf_count);
+		ibb->aux_pgtable = cache;
+
+		for (i = 0; i < buf_count; i++)
+			new_mappings[i] = i;
+		new_count = buf_count;
+	}
+
+	/*
+	 * Drop what was mapped in place of the new surfaces, waiting for the
+	 * batches that could still use it first.
+	 */
+	for (i = cache->mapping_count - 1; i >= 0; i--) {
+		for (j = 0; j < new_count; j++)
+			if (aux_pgtable_mapping_overlap(&cache->mappings[i],
+							&mappings[new_mappings[j]]))
+				break;
+		if (j == new_count)
+			continue;
+
+		if (!synced) {
+			intel_bb_sync(ibb);
+			synced = true;
+		}
+
+		for (j = 0; j < cache->mappings[i].surface_count; j++)
+			pgt_clear_entries_for_surface(cache->pgt,
+						      &cache->mappings[i].surface[j],
+						      0);
+		cache->mappings[i] = cache->mappings[--cache->mapping_count];
+	}
+
+	for (i = 0; i < new_count; i++) {
+		struct aux_pgtable_mapping *mapping = &mappings[new_mappings[i]];
+
+		for (j = 0; j < mapping->surface_count; j++)
+			pgt_populate_entries_for_surface(cache->pgt,
+							 &mapping->surface[j],
+							 0);
+		cache->mappings[cache->mapping_count++] = *mapping;
+	}
+
+	return cache->pgt->buf;
+}
+
 static void
 aux_pgtable_reserve_buf_slot(struct intel_buf **bufs, int buf_count,
 			     struct intel_buf *new_buf)
@@ -625,9 +933,15 @@ gen12_aux_pgtable_init(struct aux_pgtable_info *info,
 		info->buf_count++;
 	}
 
-	info->pgtable_buf = intel_aux_pgtable_create(ibb,
-						     info->bufs,
-						     info->buf_count);
+	info->pgtable_cached = ibb->aux_pgtable_cache &&
+			       ibb->allocator_type != INTEL_ALLOCATOR_NONE;
+	if (info->pgtable_cached)
+		info->pgtable_buf = aux_pgtable_cache_update(ibb, info->bufs,
+							     info->buf_count);
+	else
+		info->pgtable_buf = intel_aux_pgtable_create(ibb,
+							     info->bufs,
+							     info->buf_count);
 
 	igt_assert(info->pgtable_buf);
 }
@@ -645,7 +959,8 @@ gen12_aux_pgtable_cleanup(struct intel_bb *ibb, struct aux_pgtable_info *info)
 		igt_assert_eq_u64(addr, info->buf_pin_offsets[i]);
 	}
 
-	if (info->pgtable_buf) {
+	/* A cached table stays in the bb for the next batch */
+	if (info->pgtable_buf && !info->pgtable_cached) {
 		intel_bb_remove_intel_buf(ibb, info->pgtable_buf);
 		intel_buf_destroy(info->pgtable_buf);
 	}
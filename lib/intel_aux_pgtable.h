@@ -8,6 +8,7 @@ struct aux_pgtable_info {
 	struct intel_buf *bufs[2];
 	uint64_t buf_pin_offsets[2];
 	struct intel_buf *pgtable_buf;
+	bool pgtable_cached;
 };
 
 struct intel_buf *
@@ -23,6 +24,8 @@ gen12_aux_pgtable_init(struct aux_pgtable_info *info,
 void
 gen12_aux_pgtable_cleanup(struct intel_bb *ibb, struct aux_pgtable_info *info);
 
+void gen12_aux_pgtable_cache_destroy(struct intel_bb *ibb);
+
 uint32_t
 gen12_create_aux_pgtable_state(struct intel_bb *batch,
 			       struct intel_buf *aux_pgtable_buf);
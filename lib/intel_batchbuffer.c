@@ -25,7 +25,6 @@
  *
  **************************************************************************/
 
-#include <search.h>
 #ifndef ANDROID
 #include <glib.h>
 #else
@@ -36,8 +35,10 @@
 #include "huc_copy.h"
 #include "i915/gem_create.h"
 #include "i915/gem_mman.h"
+#include "intel_aux_pgtable.h"
 #include "intel_blt.h"
 #include "igt_aux.h"
+#include "igt_map.h"
 #include "igt_syncobj.h"
 #include "intel_batchbuffer.h"
 #include "intel_bufops.h"
@@ -743,6 +744,34 @@ igt_fillfunc_t igt_get_media_fillfunc(int devid)
 	return fill;
 }
 
+/**
+ * igt_get_media_fillfunc_rects:
+ * @devid: pci device id
+ *
+ * Returns:
+ *
+ * The platform-specific media function filling many rectangles in one batch
+ * for the device specified with @devid. Will return NULL when no media fill
+ * function is implemented.
+ */
+igt_fillfunc_rects_t igt_get_media_fillfunc_rects(int devid)
+{
+	igt_fillfunc_rects_t fill = NULL;
+
+	if (intel_graphics_ver(devid) >= IP_VER(12, 50)) {
+		/* current implementation defeatured PIPELINE_MEDIA */
+	} else if (IS_GEN12(devid))
+		fill = gen12_media_fillfunc_rects;
+	else if (IS_GEN9(devid) || IS_GEN10(devid) || IS_GEN11(devid))
+		fill = gen9_media_fillfunc_rects;
+	else if (IS_GEN8(devid))
+		fill = gen8_media_fillfunc_rects;
+	else if (IS_GEN7(devid))
+		fill = gen7_media_fillfunc_rects;
+
+	return fill;
+}
+
 igt_vme_func_t igt_get_media_vme_func(int devid)
 {
 	igt_vme_func_t fill = NULL;
@@ -783,6 +812,36 @@ igt_fillfunc_t igt_get_gpgpu_fillfunc(int devid)
 	return fill;
 }
 
+/**
+ * igt_get_gpgpu_fillfunc_rects:
+ * @devid: pci device id
+ *
+ * Returns:
+ *
+ * The platform-specific gpgpu function filling many rectangles in one batch
+ * for the device specified with @devid. Will return NULL when no gpgpu fill
+ * function is implemented.
+ */
+igt_fillfunc_rects_t igt_get_gpgpu_fillfunc_rects(int devid)
+{
+	igt_fillfunc_rects_t fill = NULL;
+
+	if (intel_graphics_ver(devid) >= IP_VER(12, 50))
+		fill = xehp_gpgpu_fillfunc_rects;
+	else if (IS_GEN12(devid))
+		fill = gen12_gpgpu_fillfunc_rects;
+	else if (IS_GEN11(devid))
+		fill = gen11_gpgpu_fillfunc_rects;
+	else if (IS_GEN9(devid) || IS_GEN10(devid))
+		fill = gen9_gpgpu_fillfunc_rects;
+	else if (IS_GEN8(devid))
+		fill = gen8_gpgpu_fillfunc_rects;
+	else if (IS_GEN7(devid))
+		fill = gen7_gpgpu_fillfunc_rects;
+
+	return fill;
+}
+
 /**
  * igt_get_media_spinfunc:
  * @devid: pci device id
@@ -807,6 +866,60 @@ igt_media_spinfunc_t igt_get_media_spinfunc(int devid)
 /* Intel batchbuffer v2 */
 static bool intel_bb_debug_tree = false;
 
+/*
+ * Execobjs live in chunks, so neither adding a handle to the cache nor to
+ * the objects array of the current execbuf needs an allocation. The cache
+ * is an igt_map indexed by handle of the execobj embedded in each entry.
+ */
+#define BB_OBJECT_CHUNK_SIZE 64
+
+struct intel_bb_object {
+	struct drm_i915_gem_exec_object2 exec;
+	struct intel_bb_object *next_free;
+	bool current;
+
+	/* xe persistent binds, what is currently bound for the object */
+	bool bound;
+	uint64_t bound_addr;
+	uint64_t bound_range;
+	uint64_t bound_rsvd1;
+};
+
+struct intel_bb_object_chunk {
+	struct intel_bb_object_chunk *next;
+	struct intel_bb_object objects[BB_OBJECT_CHUNK_SIZE];
+};
+
+static inline struct intel_bb_object *
+to_bb_object(struct drm_i915_gem_exec_object2 *object)
+{
+	struct intel_bb_object *obj;
+
+	return igt_container_of(object, obj, exec);
+}
+
+static struct xe_bind_queue *__xe_bb_bind_queue(struct intel_bb *ibb)
+{
+	if (!ibb->xe_bind_queue)
+		ibb->xe_bind_queue = xe_bind_queue_create(ibb->fd, ibb->vm_id);
+
+	return ibb->xe_bind_queue;
+}
+
+/*
+ * In persistent binds mode unbind of an object which leaves the cache is
+ * deferred and issued together with binds of the next exec.
+ */
+static void __xe_queue_unbind(struct intel_bb *ibb, struct intel_bb_object *obj)
+{
+	if (!obj->bound)
+		return;
+
+	xe_bind_queue_unmap(__xe_bb_bind_queue(ibb), obj->bound_addr,
+			    obj->bound_range);
+	obj->bound = false;
+}
+
 /*
  * __reallocate_objects:
  * @ibb: pointer to intel_bb
@@ -1275,20 +1388,35 @@ static void __intel_bb_destroy_relocations(struct intel_bb *ibb)
 
 static void __intel_bb_destroy_objects(struct intel_bb *ibb)
 {
+	uint32_t i;
+
+	for (i = 0; i < ibb->num_objects; i++)
+		to_bb_object(ibb->objects[i])->current = false;
+
 	free(ibb->objects);
 	ibb->objects = NULL;
 
-	tdestroy(ibb->current, free);
-	ibb->current = NULL;
-
 	ibb->num_objects = 0;
 	ibb->allocated_objects = 0;
 }
 
 static void __intel_bb_destroy_cache(struct intel_bb *ibb)
 {
-	tdestroy(ibb->root, free);
-	ibb->root = NULL;
+	struct intel_bb_object_chunk *chunk;
+	struct igt_map_entry *pos;
+
+	if (ibb->cache)
+		igt_map_foreach(ibb->cache, pos)
+			__xe_queue_unbind(ibb, to_bb_object(pos->data));
+
+	igt_map_destroy(ibb->cache, NULL);
+	ibb->cache = NULL;
+
+	while ((chunk = ibb->object_chunks)) {
+		ibb->object_chunks = chunk->next;
+		free(chunk);
+	}
+	ibb->free_objects = NULL;
 }
 
 static void __intel_bb_remove_intel_bufs(struct intel_bb *ibb)
@@ -1299,48 +1427,6 @@ static void __intel_bb_remove_intel_bufs(struct intel_bb *ibb)
 		intel_bb_remove_intel_buf(ibb, entry);
 }
 
-/**
- * intel_bb_destroy:
- * @ibb: pointer to intel_bb
- *
- * Frees all relocations / objects allocated during filling the batch.
- */
-void intel_bb_destroy(struct intel_bb *ibb)
-{
-	igt_assert(ibb);
-
-	ibb->refcount--;
-	igt_assert_f(ibb->refcount == 0, "Trying to destroy referenced bb!");
-
-	__intel_bb_remove_intel_bufs(ibb);
-	__intel_bb_destroy_relocations(ibb);
-	__intel_bb_destroy_objects(ibb);
-	__intel_bb_destroy_cache(ibb);
-
-	if (ibb->allocator_type != INTEL_ALLOCATOR_NONE) {
-		if (intel_bb_do_tracking) {
-			pthread_mutex_lock(&intel_bb_list_lock);
-			igt_list_del(&ibb->link);
-			pthread_mutex_unlock(&intel_bb_list_lock);
-		}
-
-		intel_allocator_free(ibb->allocator_handle, ibb->handle);
-		intel_allocator_close(ibb->allocator_handle);
-	}
-	gem_close(ibb->fd, ibb->handle);
-
-	if (ibb->fence >= 0)
-		close(ibb->fence);
-	if (ibb->engine_syncobj)
-		syncobj_destroy(ibb->fd, ibb->engine_syncobj);
-	if (ibb->vm_id && !ibb->ctx)
-		xe_vm_destroy(ibb->fd, ibb->vm_id);
-
-	free(ibb->batch);
-	free(ibb->cfg);
-	free(ibb);
-}
-
 /*
  * Since we re-use drm_i915_gem_exec_object2 to store details about the object
  * for submission to Xe, we don't have dedicated fields for the info needed for
@@ -1393,39 +1479,162 @@ static struct drm_xe_vm_bind_op *xe_alloc_bind_ops(struct intel_bb *ibb,
 	return bind_ops;
 }
 
-static void __unbind_xe_objects(struct intel_bb *ibb)
+/* Queues a map, or an unmap, of every object of the current execbuf */
+static void __xe_queue_objects(struct intel_bb *ibb, bool map)
 {
-	struct drm_xe_sync syncs[2] = {
-		{ .type = DRM_XE_SYNC_TYPE_SYNCOBJ },
-		{ .type = DRM_XE_SYNC_TYPE_SYNCOBJ, .flags = DRM_XE_SYNC_FLAG_SIGNAL, },
+	struct xe_bind_queue *bq = __xe_bb_bind_queue(ibb);
+	struct drm_i915_gem_exec_object2 **objects = ibb->objects;
+
+	igt_debug("bind: %s %u objects\n", map ? "MAP" : "UNMAP",
+		  ibb->num_objects);
+	for (int i = 0; i < ibb->num_objects; i++) {
+		uint64_t rsvd1 = objects[i]->rsvd1;
+
+		if (map)
+			xe_bind_queue_map(bq, objects[i]->handle, 0,
+					  objects[i]->offset, XE_OBJ_SIZE(rsvd1),
+					  XE_OBJ_PAT_IDX(rsvd1),
+					  XE_OBJ_PXP(rsvd1) ?
+					  DRM_XE_VM_BIND_FLAG_CHECK_PXP : 0);
+		else
+			xe_bind_queue_unmap(bq, objects[i]->offset,
+					    XE_OBJ_SIZE(rsvd1));
+	}
+}
+
+/*
+ * Flushes the queued binds and unbinds. Range being unbound may still be
+ * in use by previous exec, so in that case the flush waits for it before
+ * the vm is touched.
+ */
+static void __xe_bb_flush_binds(struct intel_bb *ibb)
+{
+	struct xe_bind_queue *bq = __xe_bb_bind_queue(ibb);
+	struct drm_xe_sync sync = {
+		.type = DRM_XE_SYNC_TYPE_SYNCOBJ,
+		.handle = ibb->engine_syncobj,
 	};
-	int ret;
+	bool unbind = false;
 
-	syncs[0].handle = ibb->engine_syncobj;
-	syncs[1].handle = syncobj_create(ibb->fd, 0);
+	for (int i = 0; i < bq->num_ops; i++)
+		unbind |= bq->ops[i].op == DRM_XE_VM_BIND_OP_UNMAP;
 
-	if (ibb->num_objects > 1) {
-		struct drm_xe_vm_bind_op *bind_ops;
-		uint32_t op = DRM_XE_VM_BIND_OP_UNMAP;
+	xe_bind_queue_flush(bq, &sync, unbind && ibb->engine_syncobj ? 1 : 0);
+}
 
-		bind_ops = xe_alloc_bind_ops(ibb, op, 0, 0);
-		xe_vm_bind_array(ibb->fd, ibb->vm_id, 0, bind_ops,
-				 ibb->num_objects, syncs, 2);
-		free(bind_ops);
-	} else {
-		igt_debug("bind: UNMAP\n");
-		igt_debug("  offset: %llx, size: %llx\n",
-			  (long long)ibb->batch_offset, (long long)ibb->size);
-		xe_vm_unbind_async(ibb->fd, ibb->vm_id, 0, 0,
-				   ibb->batch_offset, ibb->size, syncs, 2);
-	}
-	ret = syncobj_wait_err(ibb->fd, &syncs[1].handle, 1, INT64_MAX, 0);
-	igt_assert_eq(ret, 0);
-	syncobj_destroy(ibb->fd, syncs[1].handle);
+static void __unbind_xe_objects(struct intel_bb *ibb)
+{
+	__xe_queue_objects(ibb, false);
+	__xe_bb_flush_binds(ibb);
+	xe_bind_queue_wait(ibb->xe_bind_queue);
 
 	ibb->xe_bound = false;
 }
 
+/*
+ * Queues binds of objects of the current execbuf which are not bound yet
+ * (or were bound with different offset / attributes), after unbinds queued
+ * since previous exec.
+ */
+static void __xe_bind_persistent(struct intel_bb *ibb)
+{
+	struct drm_i915_gem_exec_object2 **objects = ibb->objects;
+	struct xe_bind_queue *bq = __xe_bb_bind_queue(ibb);
+	struct intel_bb_object *obj;
+
+	for (int i = 0; i < ibb->num_objects; i++) {
+		uint64_t rsvd1 = objects[i]->rsvd1;
+
+		obj = to_bb_object(objects[i]);
+
+		if (obj->bound && obj->bound_addr == objects[i]->offset &&
+		    obj->bound_rsvd1 == rsvd1)
+			continue;
+
+		if (obj->bound)
+			xe_bind_queue_unmap(bq, obj->bound_addr,
+					    obj->bound_range);
+
+		xe_bind_queue_map(bq, objects[i]->handle, 0,
+				  objects[i]->offset, XE_OBJ_SIZE(rsvd1),
+				  XE_OBJ_PAT_IDX(rsvd1),
+				  XE_OBJ_PXP(rsvd1) ?
+				  DRM_XE_VM_BIND_FLAG_CHECK_PXP : 0);
+
+		obj->bound = true;
+		obj->bound_addr = objects[i]->offset;
+		obj->bound_range = XE_OBJ_SIZE(rsvd1);
+		obj->bound_rsvd1 = rsvd1;
+	}
+
+	igt_debug("bind: %u delta ops\n", bq->num_ops);
+}
+
+/* Synchronously unbinds everything bound in persistent binds mode */
+static void __xe_unbind_persistent(struct intel_bb *ibb)
+{
+	struct igt_map_entry *pos;
+
+	if (ibb->cache)
+		igt_map_foreach(ibb->cache, pos)
+			__xe_queue_unbind(ibb, to_bb_object(pos->data));
+
+	if (!ibb->xe_bind_queue)
+		return;
+
+	__xe_bb_flush_binds(ibb);
+	xe_bind_queue_wait(ibb->xe_bind_queue);
+}
+
+/**
+ * intel_bb_destroy:
+ * @ibb: pointer to intel_bb
+ *
+ * Frees all relocations / objects allocated during filling the batch.
+ */
+void intel_bb_destroy(struct intel_bb *ibb)
+{
+	igt_assert(ibb);
+
+	ibb->refcount--;
+	igt_assert_f(ibb->refcount == 0, "Trying to destroy referenced bb!");
+
+	__intel_bb_remove_intel_bufs(ibb);
+	__intel_bb_destroy_relocations(ibb);
+	__intel_bb_destroy_objects(ibb);
+	__intel_bb_destroy_cache(ibb);
+
+	if (ibb->xe_persistent)
+		__xe_unbind_persistent(ibb);
+
+	gen9_render_state_destroy(ibb);
+	gen12_aux_pgtable_cache_destroy(ibb);
+
+	if (ibb->allocator_type != INTEL_ALLOCATOR_NONE) {
+		if (intel_bb_do_tracking) {
+			pthread_mutex_lock(&intel_bb_list_lock);
+			igt_list_del(&ibb->link);
+			pthread_mutex_unlock(&intel_bb_list_lock);
+		}
+
+		intel_allocator_free(ibb->allocator_handle, ibb->handle);
+		intel_allocator_close(ibb->allocator_handle);
+	}
+	gem_close(ibb->fd, ibb->handle);
+
+	if (ibb->fence >= 0)
+		close(ibb->fence);
+	if (ibb->engine_syncobj)
+		syncobj_destroy(ibb->fd, ibb->engine_syncobj);
+	xe_bind_queue_destroy(ibb->xe_bind_queue);
+	if (ibb->vm_id && !ibb->ctx)
+		xe_vm_destroy(ibb->fd, ibb->vm_id);
+
+	free(ibb->batch);
+	free(ibb->cfg);
+	free(ibb);
+}
+
 /*
  * intel_bb_reset:
  * @ibb: pointer to intel_bb
@@ -1457,8 +1666,12 @@ void intel_bb_reset(struct intel_bb *ibb, bool purge_objects_cache)
 	for (i = 0; i < ibb->num_objects; i++)
 		ibb->objects[i]->flags &= EXEC_OBJECT_SUPPORTS_48B_ADDRESS;
 
-	if (ibb->driver == INTEL_DRIVER_XE && ibb->xe_bound)
-		__unbind_xe_objects(ibb);
+	if (ibb->driver == INTEL_DRIVER_XE && ibb->xe_bound) {
+		if (ibb->xe_persistent)
+			ibb->xe_bound = false;
+		else
+			__unbind_xe_objects(ibb);
+	}
 
 	__intel_bb_destroy_relocations(ibb);
 	__intel_bb_destroy_objects(ibb);
@@ -1487,8 +1700,9 @@ void intel_bb_reset(struct intel_bb *ibb, bool purge_objects_cache)
 					   vram_if_possible(ibb->fd, 0),
 					   DRM_XE_GEM_CREATE_FLAG_NEEDS_VISIBLE_VRAM);
 
-	/* Reacquire offset for RELOC and SIMPLE */
+	/* Reacquire offset for RELOC, SIMPLE and TREE */
 	if (ibb->allocator_type == INTEL_ALLOCATOR_SIMPLE ||
+	    ibb->allocator_type == INTEL_ALLOCATOR_TREE ||
 	    ibb->allocator_type == INTEL_ALLOCATOR_RELOC)
 		ibb->batch_offset = __intel_bb_get_offset(ibb,
 							  ibb->handle,
@@ -1564,7 +1778,7 @@ void intel_bb_print(struct intel_bb *ibb)
 	igt_info("gtt_size: %" PRIu64 ", supports 48bit: %d\n",
 		 ibb->gtt_size, ibb->supports_48b_address);
 	igt_info("ctx: %u\n", ibb->ctx);
-	igt_info("root: %p\n", ibb->root);
+	igt_info("cache: %p\n", ibb->cache);
 	igt_info("objects: %p, num_objects: %u, allocated obj: %u\n",
 		 ibb->objects, ibb->num_objects, ibb->allocated_objects);
 	igt_info("relocs: %p, num_relocs: %u, allocated_relocs: %u\n----\n",
@@ -1624,6 +1838,81 @@ void intel_bb_set_debug(struct intel_bb *ibb, bool debug)
 	ibb->debug = debug;
 }
 
+/**
+ * intel_bb_set_persistent_binds:
+ * @ibb: pointer to intel_bb
+ * @persistent: true / false
+ *
+ * On xe objects of the bb are normally bound before each exec and unbound
+ * on intel_bb_reset(). With @persistent set to true bindings are kept
+ * between execs and exec only binds objects which weren't bound yet and
+ * unbinds those which were removed from the bb in the meantime, so
+ * repeated execs of the same objects don't touch the vm at all.
+ *
+ * Note. As bindings outlive the execbuf objects have to be removed from
+ * the bb (intel_bb_remove_object(), intel_buf_destroy()...) before their
+ * handles are closed. Not supported in lr mode, no-op on i915.
+ */
+void intel_bb_set_persistent_binds(struct intel_bb *ibb, bool persistent)
+{
+	igt_assert(ibb);
+
+	if (ibb->driver != INTEL_DRIVER_XE)
+		return;
+
+	igt_assert_f(!ibb->lr_mode, "Persistent binds not supported in lr mode\n");
+	igt_assert_f(!ibb->xe_bound, "Reset bb before changing binds mode\n");
+
+	if (ibb->xe_persistent && !persistent)
+		__xe_unbind_persistent(ibb);
+
+	ibb->xe_persistent = persistent;
+}
+
+/**
+ * intel_bb_set_render_state_cache:
+ * @ibb: pointer to intel_bb
+ * @enable: true / false
+ *
+ * With @enable set to true the gen9+ render copies and clears build their
+ * static state, the kernel, the sampler and the color calculator, blend,
+ * viewport and scissor states, once in a bo kept by @ibb and only emit the
+ * surface states, the vertices and the commands to each batch. Useful when
+ * many copies go through the same bb. The state bo is released on
+ * intel_bb_destroy(). Disabled by default.
+ */
+void intel_bb_set_render_state_cache(struct intel_bb *ibb, bool enable)
+{
+	igt_assert(ibb);
+
+	ibb->render_state_cache = enable;
+}
+
+/**
+ * intel_bb_set_aux_pgtable_cache:
+ * @ibb: pointer to intel_bb
+ * @enable: true / false
+ *
+ * With @enable set to true the gen12+ render and vebox copies of compressed
+ * surfaces keep their aux table in @ibb instead of building a new one for
+ * each batch. Surfaces which kept their address reuse their entries and only
+ * the new ones are written, waiting for the previous batch to complete
+ * before overwriting entries it may use. Requires an allocator, it is
+ * ignored otherwise. The table is released on intel_bb_destroy() or when
+ * disabling. Disabled by default.
+ */
+void intel_bb_set_aux_pgtable_cache(struct intel_bb *ibb, bool enable)
+{
+	igt_assert(ibb);
+
+	if (!enable) {
+		intel_bb_sync(ibb);
+		gen12_aux_pgtable_cache_destroy(ibb);
+	}
+
+	ibb->aux_pgtable_cache = enable;
+}
+
 /**
  * intel_bb_set_dump_base64:
  * @ibb: pointer to intel_bb
@@ -1636,40 +1925,58 @@ void intel_bb_set_dump_base64(struct intel_bb *ibb, bool dump)
 	ibb->dump_base64 = dump;
 }
 
-static int __compare_objects(const void *p1, const void *p2)
+static struct intel_bb_object *__alloc_object(struct intel_bb *ibb)
 {
-	const struct drm_i915_gem_exec_object2 *o1 = p1, *o2 = p2;
+	struct intel_bb_object_chunk *chunk;
+	struct intel_bb_object *obj;
+	int i;
 
-	return (int) ((int64_t) o1->handle - (int64_t) o2->handle);
+	if (!ibb->free_objects) {
+		chunk = malloc(sizeof(*chunk));
+		igt_assert(chunk);
+		chunk->next = ibb->object_chunks;
+		ibb->object_chunks = chunk;
+
+		for (i = BB_OBJECT_CHUNK_SIZE - 1; i >= 0; i--) {
+			chunk->objects[i].next_free = ibb->free_objects;
+			ibb->free_objects = &chunk->objects[i];
+		}
+	}
+
+	obj = ibb->free_objects;
+	ibb->free_objects = obj->next_free;
+	memset(obj, 0, sizeof(*obj));
+
+	return obj;
 }
 
 static struct drm_i915_gem_exec_object2 *
 __add_to_cache(struct intel_bb *ibb, uint32_t handle)
 {
-	struct drm_i915_gem_exec_object2 **found, *object;
+	struct drm_i915_gem_exec_object2 *object;
+	struct intel_bb_object *obj;
 
-	object = malloc(sizeof(*object));
-	igt_assert(object);
+	if (!ibb->cache) {
+		ibb->cache = igt_map_create(igt_map_hash_32, igt_map_equal_32);
+		igt_assert(ibb->cache);
+	}
 
-	object->handle = handle;
-	object->alignment = 0;
-	found = tsearch((void *) object, &ibb->root, __compare_objects);
+	object = igt_map_search(ibb->cache, &handle);
+	if (object)
+		return object;
 
-	if (*found == object) {
-		memset(object, 0, sizeof(*object));
-		object->handle = handle;
-		object->offset = INTEL_BUF_INVALID_ADDRESS;
-	} else {
-		free(object);
-		object = *found;
-	}
+	obj = __alloc_object(ibb);
+	obj->exec.handle = handle;
+	obj->exec.offset = INTEL_BUF_INVALID_ADDRESS;
+	igt_map_insert(ibb->cache, &obj->exec.handle, &obj->exec);
 
-	return object;
+	return &obj->exec;
 }
 
 static bool __remove_from_cache(struct intel_bb *ibb, uint32_t handle)
 {
-	struct drm_i915_gem_exec_object2 **found, *object;
+	struct drm_i915_gem_exec_object2 *object;
+	struct intel_bb_object *obj;
 
 	object = intel_bb_find_object(ibb, handle);
 	if (!object) {
@@ -1677,79 +1984,62 @@ static bool __remove_from_cache(struct intel_bb *ibb, uint32_t handle)
 		return false;
 	}
 
-	found = tdelete((void *) object, &ibb->root, __compare_objects);
-	if (!found)
-		return false;
+	igt_map_remove(ibb->cache, &handle, NULL);
 
-	free(object);
+	obj = to_bb_object(object);
+	__xe_queue_unbind(ibb, obj);
+	obj->next_free = ibb->free_objects;
+	ibb->free_objects = obj;
 
 	return true;
 }
 
-static int __compare_handles(const void *p1, const void *p2)
-{
-	return (int) (*(int32_t *) p1 - *(int32_t *) p2);
-}
-
 static void __add_to_objects(struct intel_bb *ibb,
 			     struct drm_i915_gem_exec_object2 *object)
 {
-	uint32_t **found, *handle;
-
-	handle = malloc(sizeof(*handle));
-	igt_assert(handle);
+	struct intel_bb_object *obj = to_bb_object(object);
 
-	*handle = object->handle;
-	found = tsearch((void *) handle, &ibb->current, __compare_handles);
+	if (obj->current)
+		return;
 
-	if (*found == handle) {
-		__reallocate_objects(ibb);
-		igt_assert(ibb->num_objects < ibb->allocated_objects);
-		ibb->objects[ibb->num_objects++] = object;
-	} else {
-		free(handle);
-	}
+	__reallocate_objects(ibb);
+	igt_assert(ibb->num_objects < ibb->allocated_objects);
+	ibb->objects[ibb->num_objects++] = object;
+	obj->current = true;
 }
 
 static void __remove_from_objects(struct intel_bb *ibb,
 				  struct drm_i915_gem_exec_object2 *object)
 {
-	uint32_t i, **handle, *to_free;
-	bool found = false;
-
-	for (i = 0; i < ibb->num_objects; i++) {
-		if (ibb->objects[i] == object) {
-			found = true;
-			break;
-		}
-	}
+	struct intel_bb_object *obj = to_bb_object(object);
+	uint32_t i;
 
 	/*
 	 * When we reset bb (without purging) we have:
 	 * 1. cache which contains all cached objects
 	 * 2. objects array which contains only bb object (cleared in reset
 	 *    path with bb object added at the end)
-	 * So !found is normal situation and no warning is added here.
+	 * So object not being current is normal situation and no warning
+	 * is added here.
 	 */
-	if (!found)
+	if (!obj->current)
 		return;
 
-	ibb->num_objects--;
-	if (i < ibb->num_objects)
-		memmove(&ibb->objects[i], &ibb->objects[i + 1],
-			sizeof(object) * (ibb->num_objects - i));
+	for (i = 0; i < ibb->num_objects; i++)
+		if (ibb->objects[i] == object)
+			break;
 
-	handle = tfind((void *) &object->handle,
-		       &ibb->current, __compare_handles);
-	if (!handle) {
-		igt_warn("Object %u doesn't exist in the tree, can't remove",
+	if (i == ibb->num_objects) {
+		igt_warn("Object %u doesn't exist in the objects array, can't remove",
 			 object->handle);
 		return;
 	}
 
-	to_free = *handle;
-	tdelete((void *) &object->handle, &ibb->current, __compare_handles);
-	free(to_free);
+	obj->current = false;
+	ibb->num_objects--;
+	if (i < ibb->num_objects)
+		memmove(&ibb->objects[i], &ibb->objects[i + 1],
+			sizeof(object) * (ibb->num_objects - i));
 }
 
 /**
@@ -1801,7 +2091,8 @@ __intel_bb_add_object(struct intel_bb *ibb, uint32_t handle, uint64_t size,
 			 * For simple allocator check entry consistency
 			 * - reserve if it is not already allocated.
 			 */
-			if (ibb->allocator_type == INTEL_ALLOCATOR_SIMPLE) {
+			if (ibb->allocator_type == INTEL_ALLOCATOR_SIMPLE ||
+			    ibb->allocator_type == INTEL_ALLOCATOR_TREE) {
 				bool allocated, reserved;
 
 				reserved = intel_allocator_reserve_if_not_allocated(ibb->allocator_handle,
@@ -1819,7 +2110,8 @@ __intel_bb_add_object(struct intel_bb *ibb, uint32_t handle, uint64_t size,
 		 * we can expect addresses passed by the user can be moved
 		 * within the driver.
 		 */
-		if (ibb->allocator_type == INTEL_ALLOCATOR_SIMPLE)
+		if (ibb->allocator_type == INTEL_ALLOCATOR_SIMPLE ||
+		    ibb->allocator_type == INTEL_ALLOCATOR_TREE)
 			igt_assert_f(object->offset == offset,
 				     "(pid: %ld) handle: %u, offset not match: %" PRIx64 " <> %" PRIx64 "\n",
 				     (long) getpid(), handle,
@@ -2003,32 +2295,27 @@ void intel_bb_print_intel_bufs(struct intel_bb *ibb)
 struct drm_i915_gem_exec_object2 *
 intel_bb_find_object(struct intel_bb *ibb, uint32_t handle)
 {
-	struct drm_i915_gem_exec_object2 object = { .handle = handle };
-	struct drm_i915_gem_exec_object2 **found;
-
-	found = tfind((void *) &object, &ibb->root, __compare_objects);
-	if (!found)
+	if (!ibb->cache)
 		return NULL;
 
-	return *found;
+	return igt_map_search(ibb->cache, &handle);
 }
 
 bool
 intel_bb_object_set_flag(struct intel_bb *ibb, uint32_t handle, uint64_t flag)
 {
-	struct drm_i915_gem_exec_object2 object = { .handle = handle };
-	struct drm_i915_gem_exec_object2 **found;
+	struct drm_i915_gem_exec_object2 *found;
 
-	igt_assert_f(ibb->root, "Trying to search in null tree\n");
+	igt_assert_f(ibb->cache, "Trying to search in null cache\n");
 
-	found = tfind((void *) &object, &ibb->root, __compare_objects);
+	found = intel_bb_find_object(ibb, handle);
 	if (!found) {
 		igt_warn("Trying to set fence on not found handle: %u\n",
 			 handle);
 		return false;
 	}
 
-	(*found)->flags |= flag;
+	found->flags |= flag;
 
 	return true;
 }
@@ -2036,17 +2323,16 @@ intel_bb_object_set_flag(struct intel_bb *ibb, uint32_t handle, uint64_t flag)
 bool
 intel_bb_object_clear_flag(struct intel_bb *ibb, uint32_t handle, uint64_t flag)
 {
-	struct drm_i915_gem_exec_object2 object = { .handle = handle };
-	struct drm_i915_gem_exec_object2 **found;
+	struct drm_i915_gem_exec_object2 *found;
 
-	found = tfind((void *) &object, &ibb->root, __compare_objects);
+	found = intel_bb_find_object(ibb, handle);
 	if (!found) {
 		igt_warn("Trying to set fence on not found handle: %u\n",
 			 handle);
 		return false;
 	}
 
-	(*found)->flags &= ~flag;
+	found->flags &= ~flag;
 
 	return true;
 }
@@ -2366,29 +2652,25 @@ static void intel_bb_dump_base64(struct intel_bb *ibb, int linelen)
 	free(str);
 }
 
-static void print_node(const void *node, VISIT which, int depth)
+static void print_cache(struct intel_bb *ibb)
 {
-	const struct drm_i915_gem_exec_object2 *object =
-		*(const struct drm_i915_gem_exec_object2 **) node;
-	(void) depth;
+	const struct drm_i915_gem_exec_object2 *object;
+	struct igt_map_entry *pos;
 
-	switch (which) {
-	case preorder:
-	case endorder:
-		break;
+	if (!ibb->cache)
+		return;
 
-	case postorder:
-	case leaf:
+	igt_map_foreach(ibb->cache, pos) {
+		object = pos->data;
 		igt_info("\t handle: %u, offset: 0x%" PRIx64 "\n",
 			 object->handle, (uint64_t) object->offset);
-		break;
 	}
 }
 
 void intel_bb_dump_cache(struct intel_bb *ibb)
 {
 	igt_info("[pid: %ld] dump cache\n", (long) getpid());
-	twalk(ibb->root, print_node);
+	print_cache(ibb);
 }
 
 static struct drm_i915_gem_exec_object2 *
@@ -2429,7 +2711,8 @@ static void update_offsets(struct intel_bb *ibb,
 		object = intel_bb_find_object(ibb, entry->handle);
 		igt_assert(object);
 
-		if (ibb->allocator_type == INTEL_ALLOCATOR_SIMPLE)
+		if (ibb->allocator_type == INTEL_ALLOCATOR_SIMPLE ||
+		    ibb->allocator_type == INTEL_ALLOCATOR_TREE)
 			igt_assert(object->offset == entry->addr.offset);
 		else
 			entry->addr.offset = object->offset;
@@ -2440,37 +2723,10 @@ static void update_offsets(struct intel_bb *ibb,
 
 #define LINELEN 76
 
-/*
- * __xe_bb_exec:
- * @ibb: pointer to intel_bb
- * @flags: I915_EXEC_* flags used to select the engine to submit to (internally
- * converted to DRM_XE_ENGINE_* ones)
- * @sync: if true wait for execbuf completion, otherwise caller is responsible
- * to wait for completion
- *
- * Submits the intel_bb to HW. If an exec_queue was provided during the creation
- * of the intel_bb, it will be used for the submission; otherwise, a new
- * exec_queue will be created targeting the engine specified in the flags. The
- * exec_queue created in the latter case will be saved internally and re-used
- * for subsequent submissions to the same engine, but it will be replaced if the
- * intel_bb is re-submitted to a different engine.
- *
- * Returns: 0 on success, otherwise errno.
- */
-int __xe_bb_exec(struct intel_bb *ibb, uint64_t flags, bool sync)
+static uint32_t __xe_bb_exec_queue(struct intel_bb *ibb, uint64_t flags)
 {
-	int ret = 0;
 	uint32_t engine = flags & (I915_EXEC_BSD_MASK | I915_EXEC_RING_MASK);
 	uint32_t engine_id;
-	struct drm_xe_sync syncs[2] = {
-		{ .type = DRM_XE_SYNC_TYPE_SYNCOBJ, .flags = DRM_XE_SYNC_FLAG_SIGNAL, },
-		{ .type = DRM_XE_SYNC_TYPE_SYNCOBJ, .flags = DRM_XE_SYNC_FLAG_SIGNAL, },
-	};
-	struct drm_xe_vm_bind_op *bind_ops;
-	void *map;
-
-	igt_assert_eq(ibb->num_relocs, 0);
-	igt_assert_eq(ibb->xe_bound, false);
 
 	if (ibb->ctx) {
 		engine_id = ibb->ctx;
@@ -2512,31 +2768,76 @@ int __xe_bb_exec(struct intel_bb *ibb, uint64_t flags, bool sync)
 	}
 	ibb->last_engine = engine;
 
+	return engine_id;
+}
+
+/*
+ * Copies the batch to the bo and flushes the binds of the objects, @fence
+ * is filled with a wait on the last bind of the vm. Returns false when
+ * nothing was ever bound and there is nothing to wait for.
+ */
+static bool __xe_bb_bind(struct intel_bb *ibb, struct drm_xe_sync *fence)
+{
+	void *map;
+
 	map = xe_bo_map(ibb->fd, ibb->handle, ibb->size);
 	memcpy(map, ibb->batch, ibb->size);
 	gem_munmap(map, ibb->size);
 
-	syncs[0].handle = syncobj_create(ibb->fd, 0);
-	if (ibb->num_objects > 1) {
-		bind_ops = xe_alloc_bind_ops(ibb, DRM_XE_VM_BIND_OP_MAP, 0, 0);
-		xe_vm_bind_array(ibb->fd, ibb->vm_id, 0, bind_ops,
-				 ibb->num_objects, syncs, 1);
-		free(bind_ops);
-	} else {
-		igt_debug("bind: MAP\n");
-		igt_debug("  handle: %u, offset: %llx, size: %llx\n",
-			  ibb->handle, (long long)ibb->batch_offset,
-			  (long long)ibb->size);
-		xe_vm_bind_async(ibb->fd, ibb->vm_id, 0, ibb->handle, 0,
-				 ibb->batch_offset, ibb->size, syncs, 1);
-	}
+	if (ibb->xe_persistent)
+		__xe_bind_persistent(ibb);
+	else
+		__xe_queue_objects(ibb, true);
+	__xe_bb_flush_binds(ibb);
 	ibb->xe_bound = true;
 
-	syncs[0].flags &= ~DRM_XE_SYNC_FLAG_SIGNAL;
+	return xe_bind_queue_fence(ibb->xe_bind_queue, fence);
+}
+
+/*
+ * __xe_bb_exec:
+ * @ibb: pointer to intel_bb
+ * @flags: I915_EXEC_* flags used to select the engine to submit to (internally
+ * converted to DRM_XE_ENGINE_* ones)
+ * @sync: if true wait for execbuf completion, otherwise caller is responsible
+ * to wait for completion
+ *
+ * Submits the intel_bb to HW. If an exec_queue was provided during the creation
+ * of the intel_bb, it will be used for the submission; otherwise, a new
+ * exec_queue will be created targeting the engine specified in the flags. The
+ * exec_queue created in the latter case will be saved internally and re-used
+ * for subsequent submissions to the same engine, but it will be replaced if the
+ * intel_bb is re-submitted to a different engine.
+ *
+ * Returns: 0 on success, otherwise errno.
+ */
+int __xe_bb_exec(struct intel_bb *ibb, uint64_t flags, bool sync)
+{
+	int ret = 0;
+	uint32_t engine_id;
+	struct drm_xe_sync syncs[2] = {
+		{ },
+		{ .type = DRM_XE_SYNC_TYPE_SYNCOBJ, .flags = DRM_XE_SYNC_FLAG_SIGNAL, },
+	};
+	bool bound;
+
+	igt_assert_eq(ibb->num_relocs, 0);
+	igt_assert_eq(ibb->xe_bound, false);
+
+	engine_id = __xe_bb_exec_queue(ibb, flags);
+
+	/* Exec is queued behind the binds, the cpu doesn't wait for them */
+	bound = __xe_bb_bind(ibb, &syncs[0]);
+
 	ibb->engine_syncobj = syncobj_create(ibb->fd, 0);
 	syncs[1].handle = ibb->engine_syncobj;
 
-	ret = xe_exec_sync_failable(ibb->fd, engine_id, ibb->batch_offset, syncs, 2);
+	if (bound)
+		ret = xe_exec_sync_failable(ibb->fd, engine_id,
+					    ibb->batch_offset, syncs, 2);
+	else
+		ret = xe_exec_sync_failable(ibb->fd, engine_id,
+					    ibb->batch_offset, &syncs[1], 1);
 
 	if (sync)
 		intel_bb_sync(ibb);
@@ -2736,7 +3037,7 @@ int __intel_bb_exec(struct intel_bb *ibb, uint32_t end_offset,
 		intel_bb_dump_execbuf(ibb, &execbuf);
 		if (intel_bb_debug_tree) {
 			igt_info("\nTree:\n");
-			twalk(ibb->root, print_node);
+			print_cache(ibb);
 		}
 	}
 
@@ -2770,6 +3071,276 @@ void intel_bb_exec(struct intel_bb *ibb, uint32_t end_offset,
 			igt_assert_eq(__xe_bb_exec(ibb, flags, sync), 0);
 }
 
+struct intel_bb_frozen {
+	struct intel_bb *ibb;
+	int fd;
+	enum intel_driver driver;
+
+	/* i915 */
+	struct drm_i915_gem_execbuffer2 execbuf;
+	struct drm_i915_gem_exec_object2 *objects;
+	struct drm_i915_gem_relocation_entry *relocs;
+	int fence;
+
+	/* xe */
+	uint32_t engine_id;
+	uint64_t batch_offset;
+	uint32_t syncobjs[2];
+	int last;
+	bool submitted;
+};
+
+/**
+ * intel_bb_freeze:
+ * @ibb: pointer to intel_bb
+ * @end_offset: offset of the last instruction in the bb (for i915)
+ * @flags: flags passed directly to execbuf
+ *
+ * Captures finished @ibb (batch contents, objects, offsets and relocations
+ * on i915, bound vmas on xe) into an immutable submission descriptor which
+ * can be resubmitted with intel_bb_replay() without rebuilding the batch.
+ * Frozen @ibb is referenced so it must not be modified, executed or reset
+ * until intel_bb_frozen_destroy() is called.
+ *
+ * Returns: pointer to the frozen submission descriptor.
+ */
+struct intel_bb_frozen *
+intel_bb_freeze(struct intel_bb *ibb, uint32_t end_offset, uint64_t flags)
+{
+	struct intel_bb_frozen *frozen;
+
+	igt_assert(ibb);
+
+	frozen = calloc(1, sizeof(*frozen));
+	igt_assert(frozen);
+
+	frozen->ibb = ibb;
+	frozen->fd = ibb->fd;
+	frozen->driver = ibb->driver;
+	frozen->fence = -1;
+
+	if (ibb->driver == INTEL_DRIVER_I915) {
+		ibb->objects[0]->handle = ibb->handle;
+		ibb->objects[0]->offset = ibb->batch_offset;
+		gem_write(ibb->fd, ibb->handle, 0, ibb->batch, ibb->size);
+
+		frozen->objects = create_objects_array(ibb);
+		if (ibb->num_relocs) {
+			frozen->relocs = malloc(sizeof(*frozen->relocs) *
+						ibb->num_relocs);
+			igt_assert(frozen->relocs);
+			memcpy(frozen->relocs, ibb->relocs,
+			       sizeof(*frozen->relocs) * ibb->num_relocs);
+		}
+		frozen->objects[0].relocs_ptr = to_user_pointer(frozen->relocs);
+		frozen->objects[0].relocation_count = ibb->num_relocs;
+
+		frozen->execbuf.buffers_ptr = to_user_pointer(frozen->objects);
+		frozen->execbuf.buffer_count = ibb->num_objects;
+		frozen->execbuf.batch_len = end_offset;
+		frozen->execbuf.rsvd1 = ibb->ctx;
+		frozen->execbuf.flags = flags | I915_EXEC_BATCH_FIRST;
+		if (ibb->enforce_relocs)
+			frozen->execbuf.flags &= ~I915_EXEC_NO_RELOC;
+	} else {
+		struct drm_xe_sync fence;
+		uint64_t point;
+
+		igt_assert_eq(ibb->num_relocs, 0);
+		igt_assert_eq(ibb->xe_bound, false);
+		igt_assert_f(!intel_bb_get_lr_mode(ibb),
+			     "Replay is not supported in lr mode\n");
+
+		frozen->engine_id = __xe_bb_exec_queue(ibb, flags);
+		frozen->batch_offset = ibb->batch_offset;
+
+		/*
+		 * Binds stay in place until the descriptor is destroyed. With
+		 * persistent binds everything may be bound already, then
+		 * nothing is submitted and there is nothing to wait for.
+		 */
+		point = __xe_bb_bind_queue(ibb)->point;
+		if (__xe_bb_bind(ibb, &fence) && fence.timeline_value != point)
+			xe_bind_queue_wait(ibb->xe_bind_queue);
+
+		frozen->syncobjs[0] = syncobj_create(ibb->fd, 0);
+		frozen->syncobjs[1] = syncobj_create(ibb->fd, 0);
+	}
+
+	intel_bb_ref(ibb);
+
+	return frozen;
+}
+
+static int __i915_bb_replay(struct intel_bb_frozen *frozen, uint32_t count,
+			    bool chain)
+{
+	struct drm_i915_gem_execbuffer2 *execbuf = &frozen->execbuf;
+	uint64_t flags = execbuf->flags;
+	uint32_t i;
+	int ret = 0;
+
+	for (i = 0; i < count; i++) {
+		bool signal = chain || i == count - 1;
+
+		execbuf->flags = flags;
+		execbuf->rsvd2 = 0;
+		if (chain && frozen->fence >= 0) {
+			execbuf->flags |= I915_EXEC_FENCE_IN;
+			execbuf->rsvd2 = frozen->fence;
+		}
+		if (signal)
+			execbuf->flags |= I915_EXEC_FENCE_OUT;
+
+		ret = __gem_execbuf_wr(frozen->fd, execbuf);
+		if (ret)
+			break;
+
+		if (signal) {
+			if (frozen->fence >= 0)
+				close(frozen->fence);
+			frozen->fence = execbuf->rsvd2 >> 32;
+		}
+	}
+	execbuf->flags = flags;
+
+	return ret;
+}
+
+static int __xe_bb_replay(struct intel_bb_frozen *frozen, uint32_t count,
+			  bool chain)
+{
+	struct drm_xe_sync syncs[2] = {};
+	uint32_t i, num_syncs;
+	int ret = 0;
+
+	for (i = 0; i < count; i++) {
+		bool signal = chain || i == count - 1;
+
+		num_syncs = 0;
+		if (chain && frozen->submitted) {
+			syncs[num_syncs].type = DRM_XE_SYNC_TYPE_SYNCOBJ;
+			syncs[num_syncs].flags = 0;
+			syncs[num_syncs].handle = frozen->syncobjs[frozen->last];
+			num_syncs++;
+		}
+		if (signal) {
+			syncs[num_syncs].type = DRM_XE_SYNC_TYPE_SYNCOBJ;
+			syncs[num_syncs].flags = DRM_XE_SYNC_FLAG_SIGNAL;
+			syncs[num_syncs].handle = frozen->syncobjs[!frozen->last];
+			num_syncs++;
+		}
+
+		ret = xe_exec_sync_failable(frozen->fd, frozen->engine_id,
+					    frozen->batch_offset,
+					    num_syncs ? syncs : NULL, num_syncs);
+		if (ret)
+			break;
+
+		if (signal) {
+			frozen->last = !frozen->last;
+			frozen->submitted = true;
+		}
+	}
+
+	return ret;
+}
+
+/**
+ * __intel_bb_replay:
+ * @frozen: pointer to frozen submission descriptor
+ * @count: number of submissions
+ * @chain: if true each submission waits on the fence of the previous one
+ *
+ * Resubmits batch captured by intel_bb_freeze() @count times. Only the last
+ * submission signals a fence unless @chain is set, submissions to the same
+ * context are executed in order anyway.
+ *
+ * Returns: 0 on success, otherwise errno.
+ */
+int __intel_bb_replay(struct intel_bb_frozen *frozen, uint32_t count,
+		      bool chain)
+{
+	igt_assert(frozen);
+
+	if (frozen->driver == INTEL_DRIVER_I915)
+		return __i915_bb_replay(frozen, count, chain);
+
+	return __xe_bb_replay(frozen, count, chain);
+}
+
+/**
+ * intel_bb_replay:
+ * @frozen: pointer to frozen submission descriptor
+ * @count: number of submissions
+ * @chain: if true each submission waits on the fence of the previous one
+ *
+ * Resubmits batch captured by intel_bb_freeze() @count times. Asserts on
+ * failure.
+ */
+void intel_bb_replay(struct intel_bb_frozen *frozen, uint32_t count,
+		     bool chain)
+{
+	igt_assert_eq(__intel_bb_replay(frozen, count, chain), 0);
+}
+
+/**
+ * intel_bb_frozen_sync:
+ * @frozen: pointer to frozen submission descriptor
+ *
+ * Waits for completion of the last replayed submission.
+ *
+ * Returns: 0 on success, otherwise errno.
+ */
+int intel_bb_frozen_sync(struct intel_bb_frozen *frozen)
+{
+	int ret = 0;
+
+	igt_assert(frozen);
+
+	if (frozen->driver == INTEL_DRIVER_I915) {
+		if (frozen->fence >= 0) {
+			ret = sync_fence_wait(frozen->fence, -1);
+			if (ret == 0) {
+				close(frozen->fence);
+				frozen->fence = -1;
+			}
+		}
+	} else if (frozen->submitted) {
+		ret = syncobj_wait_err(frozen->fd,
+				       &frozen->syncobjs[frozen->last],
+				       1, INT64_MAX, 0);
+	}
+
+	return ret;
+}
+
+/**
+ * intel_bb_frozen_destroy:
+ * @frozen: pointer to frozen submission descriptor
+ *
+ * Waits for outstanding submissions, frees the descriptor and drops the
+ * reference to the intel_bb it was captured from.
+ */
+void intel_bb_frozen_destroy(struct intel_bb_frozen *frozen)
+{
+	igt_assert(frozen);
+
+	intel_bb_frozen_sync(frozen);
+
+	if (frozen->driver == INTEL_DRIVER_XE) {
+		syncobj_destroy(frozen->fd, frozen->syncobjs[0]);
+		syncobj_destroy(frozen->fd, frozen->syncobjs[1]);
+	} else if (frozen->fence >= 0) {
+		close(frozen->fence);
+	}
+
+	intel_bb_unref(frozen->ibb);
+	free(frozen->relocs);
+	free(frozen->objects);
+	free(frozen);
+}
+
 /**
  * intel_bb_get_object_address:
  * @ibb: pointer to intel_bb
@@ -2781,16 +3352,15 @@ void intel_bb_exec(struct intel_bb *ibb, uint32_t end_offset,
  */
 uint64_t intel_bb_get_object_offset(struct intel_bb *ibb, uint32_t handle)
 {
-	struct drm_i915_gem_exec_object2 object = { .handle = handle };
-	struct drm_i915_gem_exec_object2 **found;
+	struct drm_i915_gem_exec_object2 *found;
 
 	igt_assert(ibb);
 
-	found = tfind((void *)&object, &ibb->root, __compare_objects);
+	found = intel_bb_find_object(ibb, handle);
 	if (!found)
 		return INTEL_BUF_INVALID_ADDRESS;
 
-	return (*found)->offset;
+	return found->offset;
 }
 
 /*
@@ -200,6 +200,47 @@ typedef void (*igt_fillfunc_t)(int i915,
 igt_fillfunc_t igt_get_gpgpu_fillfunc(int devid);
 igt_fillfunc_t igt_get_media_fillfunc(int devid);
 
+/**
+ * igt_fill_rect:
+ * @x: destination pixel x-coordination
+ * @y: destination pixel y-coordination
+ * @width: width of the filled rectangle
+ * @height: height of the filled rectangle
+ * @color: fill color to use
+ *
+ * One of the rectangles filled by an #igt_fillfunc_rects_t.
+ */
+struct igt_fill_rect {
+	unsigned int x, y;
+	unsigned int width, height;
+	uint8_t color;
+};
+
+/**
+ * igt_fillfunc_rects_t:
+ * @i915: drm fd
+ * @buf: destination intel_buf object
+ * @rects: rectangles to fill
+ * @count: number of rectangles
+ *
+ * This is the type of the per-platform functions filling many rectangles
+ * using the media or gpgpu pipeline. The platform-specific implementation can
+ * be obtained by calling igt_get_media_fillfunc_rects() or
+ * igt_get_gpgpu_fillfunc_rects().
+ *
+ * Unlike an #igt_fillfunc_t called for each rectangle, the pipeline state is
+ * set up once and all rectangles are filled from a single batchbuffer, with
+ * the fill color reloaded only where it changes from one rectangle to the
+ * next. This makes it usable for initializing large buffers on the GPU.
+ */
+typedef void (*igt_fillfunc_rects_t)(int i915,
+				     struct intel_buf *buf,
+				     const struct igt_fill_rect *rects,
+				     unsigned int count);
+
+igt_fillfunc_rects_t igt_get_gpgpu_fillfunc_rects(int devid);
+igt_fillfunc_rects_t igt_get_media_fillfunc_rects(int devid);
+
 typedef void (*igt_vme_func_t)(int i915,
 			       uint32_t ctx,
 			       struct intel_buf *src,
@@ -278,11 +319,10 @@ struct intel_bb {
 	/* Context configuration */
 	intel_ctx_cfg_t *cfg;
 
-	/* Cache */
-	void *root;
-
-	/* Current objects for execbuf */
-	void *current;
+	/* Cache of execobjs indexed by handle */
+	struct igt_map *cache;
+	struct intel_bb_object_chunk *object_chunks;
+	struct intel_bb_object *free_objects;
 
 	/* Objects for current execbuf */
 	struct drm_i915_gem_exec_object2 **objects;
@@ -304,10 +344,23 @@ struct intel_bb {
 	 */
 	int32_t refcount;
 
+	/* xe: objects stay bound between execs, only delta is (un)bound */
+	bool xe_persistent;
+	/* xe: (un)binds of the vm, flushed before each exec */
+	struct xe_bind_queue *xe_bind_queue;
+
 	/* long running mode */
 	bool lr_mode;
 	int64_t user_fence_offset;
 	uint64_t user_fence_value;
+
+	/* Static render copy state kept between execs, see rendercopy_gen9.c */
+	bool render_state_cache;
+	struct gen9_render_state *render_state;
+
+	/* Aux table kept between execs, see intel_aux_pgtable.c */
+	bool aux_pgtable_cache;
+	struct intel_aux_pgtable *aux_pgtable;
 };
 
 struct intel_bb *
@@ -355,6 +408,9 @@ void intel_bb_print(struct intel_bb *ibb);
 void intel_bb_dump(struct intel_bb *ibb, const char *filename, bool in_hex);
 void intel_bb_set_debug(struct intel_bb *ibb, bool debug);
 void intel_bb_set_dump_base64(struct intel_bb *ibb, bool dump);
+void intel_bb_set_persistent_binds(struct intel_bb *ibb, bool persistent);
+void intel_bb_set_render_state_cache(struct intel_bb *ibb, bool enable);
+void intel_bb_set_aux_pgtable_cache(struct intel_bb *ibb, bool enable);
 
 static inline uint32_t intel_bb_offset(struct intel_bb *ibb)
 {
@@ -508,6 +564,16 @@ void intel_bb_dump_cache(struct intel_bb *ibb);
 
 void intel_bb_exec(struct intel_bb *ibb, uint32_t end_offset,
 		   uint64_t flags, bool sync);
+
+struct intel_bb_frozen;
+struct intel_bb_frozen *
+intel_bb_freeze(struct intel_bb *ibb, uint32_t end_offset, uint64_t flags);
+int __intel_bb_replay(struct intel_bb_frozen *frozen, uint32_t count,
+		      bool chain);
+void intel_bb_replay(struct intel_bb_frozen *frozen, uint32_t count,
+		     bool chain);
+int intel_bb_frozen_sync(struct intel_bb_frozen *frozen);
+void intel_bb_frozen_destroy(struct intel_bb_frozen *frozen);
 int __xe_bb_exec(struct intel_bb *ibb, uint64_t flags, bool sync);
 
 uint64_t intel_bb_get_object_offset(struct intel_bb *ibb, uint32_t handle);
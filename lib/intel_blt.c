@@ -5,6 +5,7 @@
 
 #include <errno.h>
 #include <sys/ioctl.h>
+#include <sys/stat.h>
 #include <sys/time.h>
 #include <malloc.h>
 #include <cairo.h>
@@ -975,6 +976,114 @@ void blt_copy_init(int fd, struct blt_copy_data *blt)
 	blt->driver = get_intel_driver(fd);
 }
 
+/*
+ * Encoded block-copy commands of the last few copy shapes. Encoding queries
+ * the device for the platform and the memory type of the regions, so
+ * repeating a copy of the same shape over other buffers only patches the
+ * addresses and MOCS indices into the cached command.
+ */
+#define BLOCK_COPY_CACHE_SIZE	8
+
+struct block_copy_obj_key {
+	uint32_t region;
+	uint32_t pitch;
+	enum blt_tiling_type tiling;
+	enum blt_compression compression;
+	enum blt_compression_type compression_type;
+	int16_t x1, y1, x2, y2;
+	uint16_t x_offset, y_offset;
+};
+
+/*
+ * Keyed on the device rather than on the fd, fd numbers get reused for
+ * other devices once closed.
+ */
+struct block_copy_key {
+	dev_t rdev;
+	uint32_t devid;
+	enum blt_color_depth color_depth;
+	bool inplace;
+	bool extended;
+	struct block_copy_obj_key src, dst;
+};
+
+static __thread struct block_copy_cache {
+	struct block_copy_key key;
+	struct gen12_block_copy_data data;
+	unsigned int ip_ver;
+	bool valid;
+} block_copy_cache[BLOCK_COPY_CACHE_SIZE];
+static __thread unsigned int block_copy_cache_next;
+
+static void block_copy_obj_key(struct block_copy_obj_key *key,
+			       const struct blt_copy_object *obj)
+{
+	key->region = obj->region;
+	key->pitch = obj->pitch;
+	key->tiling = obj->tiling;
+	key->compression = obj->compression;
+	key->compression_type = obj->compression_type;
+	key->x1 = obj->x1;
+	key->y1 = obj->y1;
+	key->x2 = obj->x2;
+	key->y2 = obj->y2;
+	key->x_offset = obj->x_offset;
+	key->y_offset = obj->y_offset;
+}
+
+static const struct block_copy_cache *
+block_copy_lookup(int fd, const struct blt_copy_data *blt, bool extended)
+{
+	struct block_copy_cache *entry;
+	struct block_copy_key key;
+	struct stat st;
+
+	igt_assert_eq(fstat(fd, &st), 0);
+
+	/* Zeroed so that padding doesn't defeat memcmp() */
+	memset(&key, 0, sizeof(key));
+	key.rdev = st.st_rdev;
+	key.devid = intel_get_drm_devid(fd);
+	key.color_depth = blt->color_depth;
+	key.inplace = blt->src.handle == blt->dst.handle;
+	key.extended = extended;
+	block_copy_obj_key(&key.src, &blt->src);
+	block_copy_obj_key(&key.dst, &blt->dst);
+
+	for (int i = 0; i < BLOCK_COPY_CACHE_SIZE; i++)
+		if (block_copy_cache[i].valid &&
+		    !memcmp(&block_copy_cache[i].key, &key, sizeof(key)))
+			return &block_copy_cache[i];
+
+	entry = &block_copy_cache[block_copy_cache_next++ % BLOCK_COPY_CACHE_SIZE];
+	entry->key = key;
+	entry->ip_ver = intel_graphics_ver(key.devid);
+	memset(&entry->data, 0, sizeof(entry->data));
+	fill_data(&entry->data, blt, 0, 0, extended, entry->ip_ver);
+	entry->valid = true;
+
+	return entry;
+}
+
+static void block_copy_patch(struct gen12_block_copy_data *data,
+			     const struct blt_copy_data *blt,
+			     uint64_t src_offset, uint64_t dst_offset,
+			     unsigned int ip_ver)
+{
+	if (ip_ver >= IP_VER(20, 0)) {
+		data->dw01_xe2.dst_mocs_index = blt->dst.mocs_index;
+		data->dw08_xe2.src_mocs_index = blt->src.mocs_index;
+	} else {
+		data->dw01.dst_mocs_index = blt->dst.mocs_index;
+		data->dw08.src_mocs_index = blt->src.mocs_index;
+	}
+
+	data->dw04.dst_address_lo = dst_offset;
+	data->dw05.dst_address_hi = dst_offset >> 32;
+	data->dw09.src_address_lo = src_offset;
+	data->dw10.src_address_hi = src_offset >> 32;
+}
+
 /**
  * emit_blt_block_copy:
  * @fd: drm fd
@@ -997,11 +1106,12 @@ uint64_t emit_blt_block_copy(int fd,
 			     uint64_t bb_pos,
 			     bool emit_bbe)
 {
-	unsigned int ip_ver = intel_graphics_ver(intel_get_drm_devid(fd));
-	struct gen12_block_copy_data data = {};
+	const struct block_copy_cache *cached;
+	struct gen12_block_copy_data data;
 	struct gen12_block_copy_data_ext dext = {};
 	uint64_t dst_offset, src_offset, bb_offset;
 	uint32_t bbe = MI_BATCH_BUFFER_END;
+	unsigned int ip_ver;
 	uint8_t *bb;
 
 	igt_assert_f(ahnd, "block-copy supports softpin only\n");
@@ -1015,7 +1125,10 @@ uint64_t emit_blt_block_copy(int fd,
 	dst_offset += blt->dst.plane_offset;
 	bb_offset = get_offset(ahnd, blt->bb.handle, blt->bb.size, 0);
 
-	fill_data(&data, blt, src_offset, dst_offset, ext, ip_ver);
+	cached = block_copy_lookup(fd, blt, ext);
+	ip_ver = cached->ip_ver;
+	data = cached->data;
+	block_copy_patch(&data, blt, src_offset, dst_offset, ip_ver);
 
 	bb = bo_map(fd, blt->bb.handle, blt->bb.size, blt->driver);
 
@@ -1290,7 +1403,7 @@ uint64_t emit_blt_ctrl_surf_copy(int fd,
 	size_t data_sz;
 	uint64_t dst_offset, src_offset, bb_offset, alignment;
 	uint32_t bbe = MI_BATCH_BUFFER_END;
-	uint32_t *bb;
+	uint8_t *bb;
 	uint32_t ccs_per_page, max_blocks, src_step, dst_step;
 	int32_t left_blocks;
 
@@ -1655,7 +1768,7 @@ uint64_t emit_blt_fast_copy(int fd,
 	struct gen12_fast_copy_data data = {};
 	uint64_t dst_offset, src_offset, bb_offset;
 	uint32_t bbe = MI_BATCH_BUFFER_END;
-	uint32_t *bb;
+	uint8_t *bb;
 
 	data.dw00.client = 0x2;
 	data.dw00.opcode = 0x42;
@@ -1798,6 +1911,196 @@ int blt_fast_copy(int fd,
 	return ret;
 }
 
+#define BLT_STRIPE_MAX_ENGINES	16
+
+static uint32_t color_depth_bpp(enum blt_color_depth depth)
+{
+	switch (depth) {
+	case CD_8bit:
+		return 8;
+	case CD_16bit:
+		return 16;
+	case CD_32bit:
+		return 32;
+	case CD_64bit:
+		return 64;
+	case CD_96bit:
+		return 96;
+	default:
+		return 128;
+	}
+}
+
+static uint32_t gcd_u32(uint32_t a, uint32_t b)
+{
+	while (b) {
+		uint32_t t = a % b;
+
+		a = b;
+		b = t;
+	}
+
+	return a;
+}
+
+static uint32_t lcm_u32(uint32_t a, uint32_t b)
+{
+	return a / gcd_u32(a, b) * b;
+}
+
+/*
+ * Rows a band has to be a multiple of: whole tile rows of both surfaces
+ * and, when compressed, whole 64KiB blocks so that no compression block
+ * is shared by two engines.
+ */
+static uint32_t stripe_row_alignment(const struct blt_copy_data *blt)
+{
+	uint32_t bpp = color_depth_bpp(blt->color_depth);
+	const struct blt_copy_object *objs[] = { &blt->src, &blt->dst };
+	uint32_t align = 1;
+
+	for (int i = 0; i < ARRAY_SIZE(objs); i++) {
+		align = lcm_u32(align, blt_get_aligned_height(1, bpp,
+							      objs[i]->tiling));
+		if (objs[i]->compression && objs[i]->pitch)
+			align = lcm_u32(align, SZ_64K / gcd_u32(objs[i]->pitch,
+								SZ_64K));
+	}
+
+	return align;
+}
+
+/**
+ * blt_copy_striped:
+ * @fd: drm fd
+ * @ctx: intel_ctx_t context, its VM is used for all engines
+ * @ahnd: allocator handle
+ * @cmd: XY_BLOCK_COPY or XY_FAST_COPY
+ * @blt: blitter data
+ * @ext: extended blitter data for block-copy, NULL for fast-copy
+ * @num_engines: number of copy engines to use, 0 for all of them
+ *
+ * Function does the blit described in @blt like blt_block_copy() or
+ * blt_fast_copy(), but divides it into bands of rows and submits them to
+ * several copy engines in parallel, then waits for all of them. Bands are
+ * aligned to whole tile rows of @src and @dst, and to 64KiB of compressed
+ * surfaces. Copies too small to split, or on i915, are done by a single
+ * call on @ctx.
+ *
+ * Returns:
+ * exec status.
+ */
+int blt_copy_striped(int fd, const intel_ctx_t *ctx, uint64_t ahnd,
+		     enum blt_cmd_type cmd,
+		     const struct blt_copy_data *blt,
+		     const struct blt_block_copy_data_ext *ext,
+		     unsigned int num_engines)
+{
+	struct drm_xe_engine_class_instance *hwe;
+	uint32_t queues[BLT_STRIPE_MAX_ENGINES];
+	uint32_t syncs[BLT_STRIPE_MAX_ENGINES];
+	uint32_t bbs[BLT_STRIPE_MAX_ENGINES];
+	struct blt_copy_data band;
+	unsigned int n = 0, bands;
+	uint32_t align, rows, step = 0;
+	int ret = 0, err;
+
+	igt_assert(cmd == XY_BLOCK_COPY || cmd == XY_FAST_COPY);
+	igt_assert_f(ahnd, "striped copy supports softpin only\n");
+	igt_assert_f(blt, "striped copy requires data to do blit\n");
+	igt_assert_neq(blt->driver, 0);
+
+	if (!num_engines || num_engines > BLT_STRIPE_MAX_ENGINES)
+		num_engines = BLT_STRIPE_MAX_ENGINES;
+
+	if (blt->driver == INTEL_DRIVER_XE)
+		xe_for_each_engine(fd, hwe)
+			if (hwe->engine_class == DRM_XE_ENGINE_CLASS_COPY)
+				n++;
+
+	align = stripe_row_alignment(blt);
+	rows = blt->dst.y2 - blt->dst.y1;
+	bands = min(min(num_engines, n), rows / align);
+	if (bands > 1) {
+		step = ALIGN(DIV_ROUND_UP(rows, bands), align);
+		bands = DIV_ROUND_UP(rows, step);
+	}
+
+	if (bands <= 1)
+		return cmd == XY_BLOCK_COPY ?
+			blt_block_copy(fd, ctx, NULL, ahnd, blt, ext) :
+			blt_fast_copy(fd, ctx, NULL, ahnd, blt);
+
+	n = 0;
+	xe_for_each_engine(fd, hwe) {
+		if (hwe->engine_class != DRM_XE_ENGINE_CLASS_COPY)
+			continue;
+		if (n == bands)
+			break;
+		queues[n++] = xe_exec_queue_create(fd, ctx->vm, hwe, 0);
+	}
+
+	/* Emit every band first so that all of them get bound at once */
+	for (unsigned int i = 0; i < bands; i++) {
+		uint32_t start = i * step;
+		uint32_t end = min(start + step, rows);
+
+		bbs[i] = xe_bo_create(fd, 0, blt->bb.size, blt->bb.region, 0);
+		syncs[i] = syncobj_create(fd, 0);
+
+		band = *blt;
+		band.src.y1 = blt->src.y1 + start;
+		band.src.y2 = blt->src.y1 + end;
+		band.dst.y1 = blt->dst.y1 + start;
+		band.dst.y2 = blt->dst.y1 + end;
+		band.bb.handle = bbs[i];
+
+		if (cmd == XY_BLOCK_COPY)
+			emit_blt_block_copy(fd, ahnd, &band, ext, 0, true);
+		else
+			emit_blt_fast_copy(fd, ahnd, &band, 0, true);
+	}
+	intel_allocator_bind(ahnd, 0, 0);
+
+	for (unsigned int i = 0; i < bands; i++) {
+		struct drm_xe_sync sync = {
+			.type = DRM_XE_SYNC_TYPE_SYNCOBJ,
+			.flags = DRM_XE_SYNC_FLAG_SIGNAL,
+			.handle = syncs[i],
+		};
+		struct drm_xe_exec exec = {
+			.exec_queue_id = queues[i],
+			.syncs = to_user_pointer(&sync),
+			.num_syncs = 1,
+			.address = CANONICAL(get_offset(ahnd, bbs[i],
+							blt->bb.size, 0)),
+			.num_batch_buffer = 1,
+		};
+
+		/* Don't leave the join waiting for bands never submitted */
+		if (!ret)
+			ret = __xe_exec(fd, &exec);
+		if (ret)
+			syncobj_signal(fd, &syncs[i], 1);
+	}
+
+	/* Join the bands */
+	err = syncobj_wait_err(fd, syncs, bands, INT64_MAX,
+			       DRM_SYNCOBJ_WAIT_FLAGS_WAIT_ALL);
+	ret = ret ?: err;
+
+	for (unsigned int i = 0; i < bands; i++) {
+		put_offset(ahnd, bbs[i]);
+		syncobj_destroy(fd, syncs[i]);
+		xe_exec_queue_destroy(fd, queues[i]);
+	}
+	intel_allocator_bind(ahnd, 0, 0);
+	for (unsigned int i = 0; i < bands; i++)
+		gem_close(fd, bbs[i]);
+
+	return ret;
+}
+
 struct xe_mem_copy_data {
 	struct {
 		union {
@@ -1963,15 +2266,30 @@ static void dump_bb_mem_copy_cmd(int fd, struct xe_mem_copy_data *data)
 	}
 }
 
-static uint64_t emit_blt_mem_copy(int fd, uint64_t ahnd,
-				  const struct blt_mem_copy_data *mem,
-				  uint64_t bb_pos, bool emit_bbe)
+/**
+ * emit_blt_mem_copy:
+ * @fd: drm fd
+ * @ahnd: allocator handle
+ * @mem: blitter data for mem-copy
+ * @bb_pos: position at which insert mem copy commands
+ * @emit_bbe: emit MI_BATCH_BUFFER_END after mem-copy or not
+ *
+ * Function emits mem-copy blit between @src and @dst described in @mem object
+ * at @bb_pos. Allows concatenating with other commands to
+ * achieve pipelining.
+ *
+ * Returns:
+ * Next write position in batch.
+ */
+uint64_t emit_blt_mem_copy(int fd, uint64_t ahnd,
+			   const struct blt_mem_copy_data *mem,
+			   uint64_t bb_pos, bool emit_bbe)
 {
 	struct xe_mem_copy_data data = {};
 	uint64_t dst_offset, src_offset, shift;
 	uint32_t width, height, width_max, height_max, remain;
 	uint32_t bbe = MI_BATCH_BUFFER_END;
-	uint32_t *bb;
+	uint8_t *bb;
 	uint32_t devid = intel_get_drm_devid(fd);
 
 	if (mem->mode == MODE_BYTE) {
@@ -2733,3 +3051,42 @@ void blt_dump_corruption_info_32b(const struct blt_copy_object *surf1,
 		igt_info("\n");
 	}
 }
+
+/**
+ * blt_print_mismatches:
+ * @fd: drm fd
+ * @obj: blitter object the mismatches were found in
+ * @bpp: bits per pixel of @obj
+ * @cmp: result of comparing the mapping of @obj
+ *
+ * Logs the mismatches found by igt_bufcmp() in @obj, by coordinates of the
+ * pixel when the tiling of @obj is known to buf_ops_offset_to_xy(), by
+ * offset otherwise. Prints nothing if there are none.
+ */
+void blt_print_mismatches(int fd, const struct blt_copy_object *obj,
+			  uint32_t bpp, const struct igt_bufcmp *cmp)
+{
+	struct buf_ops *bops;
+	unsigned int x, y;
+
+	if (!cmp->count)
+		return;
+
+	bops = buf_ops_create(fd);
+
+	igt_warn("handle %u: %"PRIu64" mismatching words\n",
+		 obj->handle, cmp->count);
+	for (unsigned int i = 0; i < cmp->num_reported; i++) {
+		const struct igt_bufcmp_mismatch *m = &cmp->reported[i];
+
+		if (buf_ops_offset_to_xy(bops, blt_tile_to_i915_tile(obj->tiling),
+					 obj->pitch, bpp, m->offset, &x, &y))
+			igt_warn("handle %u: mismatch at (%u, %u): expected 0x%08x, found 0x%08x\n",
+				 obj->handle, x, y, m->expected, m->found);
+		else
+			igt_warn("handle %u: mismatch at offset 0x%"PRIx64": expected 0x%08x, found 0x%08x\n",
+				 obj->handle, m->offset, m->expected, m->found);
+	}
+
+	buf_ops_destroy(bops);
+}
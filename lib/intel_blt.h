@@ -50,6 +50,7 @@
 #include <malloc.h>
 #include "drm.h"
 #include "igt.h"
+#include "igt_bufcmp.h"
 #include "intel_cmds_info.h"
 
 #define CCS_RATIO(fd) (intel_gen(intel_get_drm_devid(fd)) >= 20 ? 512 : 256)
@@ -275,6 +276,12 @@ int blt_fast_copy(int fd,
 		  uint64_t ahnd,
 		  const struct blt_copy_data *blt);
 
+int blt_copy_striped(int fd, const intel_ctx_t *ctx, uint64_t ahnd,
+		     enum blt_cmd_type cmd,
+		     const struct blt_copy_data *blt,
+		     const struct blt_block_copy_data_ext *ext,
+		     unsigned int num_engines);
+
 void blt_mem_copy_init(int fd, struct blt_mem_copy_data *mem,
 		       enum blt_memop_mode mode,
 		       enum blt_memop_type copy_type);
@@ -282,6 +289,10 @@ void blt_mem_copy_init(int fd, struct blt_mem_copy_data *mem,
 void blt_mem_set_init(int fd, struct blt_mem_set_data *mem,
 		      enum blt_memop_type fill_type);
 
+uint64_t emit_blt_mem_copy(int fd, uint64_t ahnd,
+			   const struct blt_mem_copy_data *mem,
+			   uint64_t bb_pos, bool emit_bbe);
+
 int blt_mem_copy(int fd, const intel_ctx_t *ctx,
 			 const struct intel_execution_engine2 *e,
 			 uint64_t ahnd,
@@ -350,5 +361,7 @@ void blt_surface_to_png(int fd, uint32_t run_id, const char *fileid,
 			uint32_t width, uint32_t height, uint32_t bpp);
 void blt_dump_corruption_info_32b(const struct blt_copy_object *surf1,
 				  const struct blt_copy_object *surf2);
+void blt_print_mismatches(int fd, const struct blt_copy_object *obj,
+			  uint32_t bpp, const struct igt_bufcmp *cmp);
 
 #endif
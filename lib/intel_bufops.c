@@ -22,6 +22,7 @@
  *
  */
 
+#include <pthread.h>
 #include <sys/ioctl.h>
 #include <cairo.h>
 
@@ -498,6 +499,70 @@ static tile_fn __get_tile_fn_ptr(int fd, int tiling)
 	return fn;
 }
 
+/*
+ * Consecutive pixels of a row are contiguous in memory within spans of
+ * the given size in bytes: a row of a tile for X tiling, an oword column
+ * for Y, Yf and Tile4. The spans are aligned to their size both in the
+ * surface and in memory, so each span needs a single tile_fn lookup.
+ */
+static unsigned int __get_tile_span(int fd, int tiling, unsigned int stride)
+{
+	const struct intel_device_info *info =
+		intel_get_device_info(intel_get_drm_devid(fd));
+
+	switch (tiling) {
+	case I915_TILING_NONE:
+		return stride;
+	case I915_TILING_X:
+		return info->graphics_ver == 2 ? 128 : 512;
+	case I915_TILING_Y:
+		/*
+		 * y_ptr() gets the oword column pitch right only for the
+		 * 128B x 32 rows layout, keep the older ones pixel by pixel.
+		 */
+		if (info->graphics_ver == 2 ||
+		    info->is_grantsdale || info->is_alviso)
+			return 4;
+		return 16;
+	case I915_TILING_Yf:
+	case I915_TILING_4:
+		return 16;
+	default:
+		return 4;
+	}
+}
+
+static unsigned int copy_span_pixels(int fd, unsigned int bpp,
+				     unsigned int stride,
+				     int tiling, uint32_t swizzle)
+{
+	unsigned int cpp = bpp / 8;
+	unsigned int span;
+
+	/* The copies move 32 bit pixels, keep any other bpp pixel by pixel */
+	if (bpp != 32)
+		return 1;
+
+	span = __get_tile_span(fd, tiling, stride);
+
+	/* Bit 6 swizzling moves the 64 byte halves of each 128 bytes around */
+	if (swizzle)
+		span = min(span, 64u);
+
+	return max(span / cpp, 1u);
+}
+
+static void *span_ptr(tile_fn fn, void *map, const struct intel_buf *buf,
+		      unsigned int x, unsigned int y, uint32_t swizzle)
+{
+	void *ptr = fn(map, x, y, buf->surface[0].stride, buf->bpp/8);
+
+	if (swizzle)
+		ptr = from_user_pointer(swizzle_addr(ptr, swizzle));
+
+	return ptr;
+}
+
 static bool is_cache_coherent(int fd, uint32_t handle)
 {
 	return gem_get_caching(fd, handle) != I915_CACHING_NONE;
@@ -549,11 +614,21 @@ static void __copy_ccs(struct buf_ops *bops, struct intel_buf *buf,
 	munmap(map, size);
 }
 
-static void *mmap_write(int fd, const struct intel_buf *buf, bool *malloced)
+/*
+ * How the buffer ended up being mapped for the CPU copies, which decides how
+ * many threads are worth throwing at them.
+ */
+enum buf_map {
+	BUF_MAP_MALLOC,
+	BUF_MAP_CPU,
+	BUF_MAP_WC,
+};
+
+static void *mmap_write(int fd, const struct intel_buf *buf, enum buf_map *type)
 {
 	void *map = NULL;
 
-	*malloced = false;
+	*type = BUF_MAP_WC;
 
 	if (buf->bops->driver == INTEL_DRIVER_XE)
 		return xe_bo_map(fd, buf->handle, buf->surface[0].size);
@@ -576,10 +651,12 @@ static void *mmap_write(int fd, const struct intel_buf *buf, bool *malloced)
 			map = __gem_mmap__cpu(fd, buf->handle, 0, buf->surface[0].size,
 					      PROT_READ | PROT_WRITE);
 
-		if (map)
+		if (map) {
 			gem_set_domain(fd, buf->handle,
 				       I915_GEM_DOMAIN_CPU,
 				       I915_GEM_DOMAIN_CPU);
+			*type = BUF_MAP_CPU;
+		}
 	}
 
 	if (!map && gem_mmap__has_wc(fd)) {
@@ -596,15 +673,16 @@ static void *mmap_write(int fd, const struct intel_buf *buf, bool *malloced)
 	if (!map) {
 		map = malloc(buf->surface[0].size);
 		igt_assert(map);
-		*malloced = true;
+		*type = BUF_MAP_MALLOC;
 	}
 
 	return map;
 }
 
-static void munmap_write(void *map, int fd, const struct intel_buf *buf, bool malloced)
+static void munmap_write(void *map, int fd, const struct intel_buf *buf,
+			 enum buf_map type)
 {
-	if (malloced) {
+	if (type == BUF_MAP_MALLOC) {
 		igt_assert(__gem_write(fd, buf->handle, 0, map, buf->surface[0].size) == 0);
 		free(map);
 	} else {
@@ -612,11 +690,11 @@ static void munmap_write(void *map, int fd, const struct intel_buf *buf, bool ma
 	}
 }
 
-static void *mmap_read(int fd, struct intel_buf *buf, bool *malloced)
+static void *mmap_read(int fd, struct intel_buf *buf, enum buf_map *type)
 {
 	void *map = NULL;
 
-	*malloced = false;
+	*type = BUF_MAP_WC;
 
 	if (buf->bops->driver == INTEL_DRIVER_XE)
 		return xe_bo_map(fd, buf->handle, buf->surface[0].size);
@@ -638,8 +716,10 @@ static void *mmap_read(int fd, struct intel_buf *buf, bool *malloced)
 			map = __gem_mmap__cpu(fd, buf->handle, 0, buf->surface[0].size,
 					      PROT_READ);
 
-		if (map)
+		if (map) {
 			gem_set_domain(fd, buf->handle, I915_GEM_DOMAIN_CPU, 0);
+			*type = BUF_MAP_CPU;
+		}
 	}
 
 	if (!map && gem_mmap__has_wc(fd)) {
@@ -655,7 +735,7 @@ static void *mmap_read(int fd, struct intel_buf *buf, bool *malloced)
 	if (!map) {
 		map = malloc(buf->surface[0].size);
 		igt_assert(map);
-		*malloced = true;
+		*type = BUF_MAP_MALLOC;
 
 		igt_assert(__gem_read(fd, buf->handle, 0, map, buf->surface[0].size) == 0);
 	}
@@ -663,38 +743,223 @@ static void *mmap_read(int fd, struct intel_buf *buf, bool *malloced)
 	return map;
 }
 
-static void munmap_read(void *map, int fd, const struct intel_buf *buf, bool malloced)
+static void munmap_read(void *map, int fd, const struct intel_buf *buf,
+			enum buf_map type)
 {
-	if (malloced)
+	if (type == BUF_MAP_MALLOC)
 		free(map);
 	else
 		munmap(map, buf->surface[0].size);
 }
 
-static void __copy_linear_to(int fd, struct intel_buf *buf,
-			     const uint32_t *linear,
-			     int tiling, uint32_t swizzle)
+/*
+ * Large copies through the CPU are spread over a few threads, in bands of
+ * whole tile rows. Copies from or to WC (or GTT) mappings are bound by the
+ * uncached bandwidth rather than by the CPU, reads in particular, so those
+ * get fewer threads than copies involving only cacheable memory.
+ */
+#define BUF_COPY_MIN_SIZE	(4 << 20)
+#define BUF_COPY_MAX_THREADS	8
+
+struct buf_copy {
+	const struct intel_buf *buf;
+	tile_fn fn;
+	void *map;
+	uint32_t *linear;
+	uint32_t swizzle;
+	unsigned int span;
+	int tile_rows;
+	bool to_linear;
+	bool bounce;
+};
+
+typedef void (*buf_copy_fn)(const struct buf_copy *copy, int start, int end);
+
+struct buf_copy_band {
+	buf_copy_fn fn;
+	const struct buf_copy *copy;
+	int start, end;
+	pthread_t thread;
+	bool threaded;
+};
+
+static int buf_copy_threads(const struct intel_buf *buf, enum buf_map type,
+			    bool read)
+{
+	static int max_threads;
+	int threads;
+
+	if (!max_threads) {
+		const char *env = getenv("IGT_BUF_COPY_THREADS");
+		int n = env ? atoi(env) : sysconf(_SC_NPROCESSORS_ONLN);
+
+		max_threads = clamp(n, 1, BUF_COPY_MAX_THREADS);
+	}
+
+	if (buf->surface[0].size < BUF_COPY_MIN_SIZE)
+		return 1;
+
+	if (type == BUF_MAP_WC)
+		threads = read ? 2 : 4;
+	else
+		threads = BUF_COPY_MAX_THREADS;
+
+	return min(threads, max_threads);
+}
+
+static void *buf_copy_thread(void *arg)
+{
+	struct buf_copy_band *band = arg;
+
+	band->fn(band->copy, band->start, band->end);
+
+	return NULL;
+}
+
+/*
+ * Run @fn over @rows rows split in up to @threads bands, each a multiple
+ * of @align rows. The first band runs on the calling thread.
+ */
+static void buf_copy_bands(buf_copy_fn fn, const struct buf_copy *copy,
+			   int rows, int align, int threads)
 {
-	const tile_fn fn = __get_tile_fn_ptr(fd, tiling);
-	int height = intel_buf_height(buf);
+	struct buf_copy_band bands[BUF_COPY_MAX_THREADS] = {};
+	int band_rows, num_bands = 0;
+
+	band_rows = ALIGN(DIV_ROUND_UP(rows, threads), align);
+	for (int start = 0; start < rows; start += band_rows) {
+		struct buf_copy_band *band = &bands[num_bands++];
+
+		band->fn = fn;
+		band->copy = copy;
+		band->start = start;
+		band->end = min(start + band_rows, rows);
+	}
+
+	for (int i = 1; i < num_bands; i++)
+		bands[i].threaded = !pthread_create(&bands[i].thread, NULL,
+						    buf_copy_thread, &bands[i]);
+
+	for (int i = 0; i < num_bands; i++) {
+		if (bands[i].threaded)
+			pthread_join(bands[i].thread, NULL);
+		else
+			fn(copy, bands[i].start, bands[i].end);
+	}
+}
+
+static void copy_tiled_row(const struct buf_copy *copy, void *map,
+			   int map_y, int y)
+{
+	const struct intel_buf *buf = copy->buf;
 	int width = intel_buf_width(buf);
-	bool malloced;
-	void *map;
 
-	map = mmap_write(fd, buf, &malloced);
+	for (int x = 0; x < width; x += copy->span) {
+		unsigned int n = min_t(unsigned int, copy->span, width - x);
+		void *ptr = span_ptr(copy->fn, map, buf, x, map_y,
+				     copy->swizzle);
 
-	for (int y = 0; y < height; y++) {
-		for (int x = 0; x < width; x++) {
-			uint32_t *ptr = fn(map, x, y, buf->surface[0].stride, buf->bpp/8);
+		if (copy->to_linear)
+			memcpy(&copy->linear[y * width + x], ptr,
+			       n * sizeof(*copy->linear));
+		else
+			memcpy(ptr, &copy->linear[y * width + x],
+			       n * sizeof(*copy->linear));
+	}
+}
 
-			if (swizzle)
-				ptr = from_user_pointer(swizzle_addr(ptr,
-								     swizzle));
-			*ptr = linear[y * width + x];
-		}
+/*
+ * Reading the small spans straight from a WC mapping is slow, so stream
+ * each row of tiles into a cached bounce buffer first. The bounce buffer
+ * is page aligned, like the mapping and the start of each row of tiles, so
+ * the bit 6 swizzling of the addresses stays the same.
+ */
+static void copy_tiled_rows_bounce(const struct buf_copy *copy,
+				   int start, int end)
+{
+	const struct intel_buf *buf = copy->buf;
+	size_t row_size = (size_t)buf->surface[0].stride * copy->tile_rows;
+	void *bounce;
+
+	bounce = aligned_alloc(4096, ALIGN(row_size, 4096));
+	igt_assert(bounce);
+
+	for (int y0 = start; y0 < end; y0 += copy->tile_rows) {
+		size_t offset = (size_t)y0 * buf->surface[0].stride;
+
+		igt_memcpy_from_wc(bounce, copy->map + offset,
+				   min_t(size_t, row_size,
+					 buf->surface[0].size - offset));
+
+		for (int y = y0; y < min(y0 + copy->tile_rows, end); y++)
+			copy_tiled_row(copy, bounce, y - y0, y);
 	}
 
-	munmap_write(map, fd, buf, malloced);
+	free(bounce);
+}
+
+static void copy_tiled_rows(const struct buf_copy *copy, int start, int end)
+{
+	if (copy->bounce) {
+		copy_tiled_rows_bounce(copy, start, end);
+		return;
+	}
+
+	for (int y = start; y < end; y++)
+		copy_tiled_row(copy, copy->map, y, y);
+}
+
+/* Rows per tile, matching the geometry of __get_tile_fn_ptr() */
+static int tile_rows(int fd, int tiling)
+{
+	const struct intel_device_info *info =
+		intel_get_device_info(intel_get_drm_devid(fd));
+
+	switch (tiling) {
+	case I915_TILING_NONE:
+		return 1;
+	case I915_TILING_X:
+		return info->graphics_ver == 2 ? 16 : 8;
+	case I915_TILING_Y:
+		if (info->graphics_ver == 2)
+			return 16;
+		if (info->is_grantsdale || info->is_alviso)
+			return 8;
+		return 32;
+	default:
+		return 32;
+	}
+}
+
+static void __copy_tiled(int fd, struct intel_buf *buf, uint32_t *linear,
+			 int tiling, uint32_t swizzle, bool to_linear)
+{
+	struct buf_copy copy = {
+		.buf = buf,
+		.fn = __get_tile_fn_ptr(fd, tiling),
+		.linear = linear,
+		.swizzle = swizzle,
+		.span = copy_span_pixels(fd, buf->bpp, buf->surface[0].stride,
+					 tiling, swizzle),
+		.to_linear = to_linear,
+	};
+	enum buf_map type;
+
+	copy.map = mmap_write(fd, buf, &type);
+	copy.tile_rows = tile_rows(fd, tiling);
+	copy.bounce = to_linear && type == BUF_MAP_WC && tiling != I915_TILING_NONE;
+
+	buf_copy_bands(copy_tiled_rows, &copy, intel_buf_height(buf),
+		       copy.tile_rows, buf_copy_threads(buf, type, to_linear));
+
+	munmap_write(copy.map, fd, buf, type);
+}
+
+static void __copy_linear_to(int fd, struct intel_buf *buf,
+			     const uint32_t *linear,
+			     int tiling, uint32_t swizzle)
+{
+	__copy_tiled(fd, buf, (uint32_t *)linear, tiling, swizzle, false);
 }
 
 static void copy_linear_to_none(struct buf_ops *bops, struct intel_buf *buf,
@@ -742,26 +1007,7 @@ static void copy_linear_to_tile4(struct buf_ops *bops, struct intel_buf *buf,
 static void __copy_to_linear(int fd, struct intel_buf *buf,
 			     uint32_t *linear, int tiling, uint32_t swizzle)
 {
-	const tile_fn fn = __get_tile_fn_ptr(fd, tiling);
-	int height = intel_buf_height(buf);
-	int width = intel_buf_width(buf);
-	bool malloced;
-	void *map;
-
-	map = mmap_write(fd, buf, &malloced);
-
-	for (int y = 0; y < height; y++) {
-		for (int x = 0; x < width; x++) {
-			uint32_t *ptr = fn(map, x, y, buf->surface[0].stride, buf->bpp/8);
-
-			if (swizzle)
-				ptr = from_user_pointer(swizzle_addr(ptr,
-								     swizzle));
-			linear[y * width + x] = *ptr;
-		}
-	}
-
-	munmap_write(map, fd, buf, malloced);
+	__copy_tiled(fd, buf, linear, tiling, swizzle, true);
 }
 
 static void copy_none_to_linear(struct buf_ops *bops, struct intel_buf *buf,
@@ -806,6 +1052,36 @@ static void copy_tile4_to_linear(struct buf_ops *bops, struct intel_buf *buf,
 	__copy_to_linear(bops->fd, buf, linear, I915_TILING_4, 0);
 }
 
+static void copy_bytes_rows(const struct buf_copy *copy, int start, int end)
+{
+	size_t size = copy->buf->surface[0].size;
+	size_t offset = (size_t)start << 12;
+	size_t len = min_t(size_t, (size_t)end << 12, size) - offset;
+	void *linear = (void *)copy->linear + offset;
+	void *map = copy->map + offset;
+
+	if (copy->to_linear)
+		igt_memcpy_from_wc(linear, map, len);
+	else
+		memcpy(map, linear, len);
+}
+
+/* Plain copies of the whole bo, split in 4KiB "rows" */
+static void copy_bytes(struct intel_buf *buf, void *map, uint32_t *linear,
+		       enum buf_map type, bool to_linear)
+{
+	struct buf_copy copy = {
+		.buf = buf,
+		.map = map,
+		.linear = linear,
+		.to_linear = to_linear,
+	};
+
+	buf_copy_bands(copy_bytes_rows, &copy,
+		       DIV_ROUND_UP(buf->surface[0].size, 4096), 16,
+		       buf_copy_threads(buf, type, to_linear));
+}
+
 static void copy_linear_to_gtt(struct buf_ops *bops, struct intel_buf *buf,
 			       uint32_t *linear)
 {
@@ -819,7 +1095,7 @@ static void copy_linear_to_gtt(struct buf_ops *bops, struct intel_buf *buf,
 	gem_set_domain(bops->fd, buf->handle,
 		       I915_GEM_DOMAIN_GTT, I915_GEM_DOMAIN_GTT);
 
-	memcpy(map, linear, buf->surface[0].size);
+	copy_bytes(buf, map, linear, BUF_MAP_WC, false);
 
 	munmap(map, buf->surface[0].size);
 }
@@ -837,7 +1113,7 @@ static void copy_gtt_to_linear(struct buf_ops *bops, struct intel_buf *buf,
 	gem_set_domain(bops->fd, buf->handle,
 		       I915_GEM_DOMAIN_GTT, 0);
 
-	igt_memcpy_from_wc(linear, map, buf->surface[0].size);
+	copy_bytes(buf, map, linear, BUF_MAP_WC, true);
 
 	munmap(map, buf->surface[0].size);
 }
@@ -845,27 +1121,27 @@ static void copy_gtt_to_linear(struct buf_ops *bops, struct intel_buf *buf,
 static void copy_linear_to_wc(struct buf_ops *bops, struct intel_buf *buf,
 			      uint32_t *linear)
 {
-	bool malloced;
+	enum buf_map type;
 	void *map;
 
 	DEBUGFN();
 
-	map = mmap_write(bops->fd, buf, &malloced);
-	memcpy(map, linear, buf->surface[0].size);
-	munmap_write(map, bops->fd, buf, malloced);
+	map = mmap_write(bops->fd, buf, &type);
+	copy_bytes(buf, map, linear, type, false);
+	munmap_write(map, bops->fd, buf, type);
 }
 
 static void copy_wc_to_linear(struct buf_ops *bops, struct intel_buf *buf,
 			      uint32_t *linear)
 {
-	bool malloced;
+	enum buf_map type;
 	void *map;
 
 	DEBUGFN();
 
-	map = mmap_read(bops->fd, buf, &malloced);
-	igt_memcpy_from_wc(linear, map, buf->surface[0].size);
-	munmap_read(map, bops->fd, buf, malloced);
+	map = mmap_read(bops->fd, buf, &type);
+	copy_bytes(buf, map, linear, type, true);
+	munmap_read(map, bops->fd, buf, type);
 }
 
 void intel_buf_to_linear(struct buf_ops *bops, struct intel_buf *buf,
@@ -940,6 +1216,82 @@ void linear_to_intel_buf(struct buf_ops *bops, struct intel_buf *buf,
 		__copy_ccs(bops, buf, linear, CCS_LINEAR_TO_BUF);
 }
 
+/**
+ * buf_ops_offset_to_xy:
+ * @bops: pointer to buf_ops
+ * @tiling: surface tiling
+ * @stride: surface stride in bytes
+ * @bpp: bits per pixel
+ * @offset: offset in bytes in the surface
+ * @x: where to store the column of the pixel at @offset
+ * @y: where to store the row of the pixel at @offset
+ *
+ * Finds the pixel stored at @offset in a surface, for instance to report
+ * where a mismatch found by igt_bufcmp() is. The tile functions only map
+ * coordinates to offsets, but each row of tiles is contiguous in memory,
+ * so only the spans of pixels of the row of tiles holding @offset are
+ * looked up.
+ *
+ * Returns: false if there is no tile function for @tiling.
+ */
+bool buf_ops_offset_to_xy(struct buf_ops *bops, uint32_t tiling,
+			  uint32_t stride, unsigned int bpp, uint64_t offset,
+			  unsigned int *x, unsigned int *y)
+{
+	unsigned int cpp = bpp / 8, width, span, rows;
+	uint32_t swizzle = 0;
+	unsigned int y0;
+	tile_fn fn;
+
+	igt_assert(bops);
+	igt_assert(cpp && stride);
+
+	switch (tiling) {
+	case I915_TILING_NONE:
+		*x = offset % stride / cpp;
+		*y = offset / stride;
+		return true;
+	case I915_TILING_X:
+		swizzle = bops->swizzle_x;
+		break;
+	case I915_TILING_Y:
+		swizzle = bops->swizzle_y;
+		break;
+	case I915_TILING_Yf:
+	case I915_TILING_4:
+		break;
+	default:
+		return false;
+	}
+
+	fn = __get_tile_fn_ptr(bops->fd, tiling);
+	span = copy_span_pixels(bops->fd, bpp, stride, tiling, swizzle);
+	rows = tile_rows(bops->fd, tiling);
+	width = stride / cpp;
+	y0 = offset / ((uint64_t)stride * rows) * rows;
+
+	for (unsigned int ty = y0; ty < y0 + rows; ty++) {
+		for (unsigned int tx = 0; tx < width; tx += span) {
+			unsigned int n = min(span, width - tx);
+			void *ptr = fn(NULL, tx, ty, stride, cpp);
+			uint64_t pos;
+
+			/* The mappings are page aligned, as is NULL */
+			if (swizzle)
+				ptr = from_user_pointer(swizzle_addr(ptr, swizzle));
+
+			pos = to_user_pointer(ptr);
+			if (offset >= pos && offset < pos + n * cpp) {
+				*x = tx + (offset - pos) / cpp;
+				*y = ty;
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
 static uint32_t __get_min_stride(uint32_t width, uint32_t bpp, int tiling)
 {
 	switch (tiling) {
@@ -22,6 +22,8 @@ struct intel_buf {
 	uint32_t height;
 	uint32_t tiling;
 	uint32_t bpp, depth;
+	/* Render surface format, derived from bpp and depth when 0 */
+	uint32_t surface_format;
 	uint32_t compression;
 	uint32_t swizzle_mode;
 	uint32_t yuv_semiplanar_bpp;
@@ -132,6 +134,10 @@ void intel_buf_to_linear(struct buf_ops *bops, struct intel_buf *buf,
 void linear_to_intel_buf(struct buf_ops *bops, struct intel_buf *buf,
 			 uint32_t *linear);
 
+bool buf_ops_offset_to_xy(struct buf_ops *bops, uint32_t tiling,
+			  uint32_t stride, unsigned int bpp, uint64_t offset,
+			  unsigned int *x, unsigned int *y);
+
 bool buf_ops_has_hw_fence(struct buf_ops *bops, uint32_t tiling);
 bool buf_ops_has_tiling_support(struct buf_ops *bops, uint32_t tiling);
 
@@ -2070,6 +2070,351 @@ bool xe_run_intel_compute_kernel_on_engine(int fd,
 	return __run_intel_compute_kernel(fd, eci, user, alloc_prefs);
 }
 
+#define ENV_MAX_SLOTS		64
+#define ENV_SLOT_BATCH		0x1000
+#define ENV_SLOT_INDIRECT	0x100
+
+enum env_entry {
+	ENV_KERNEL,
+	ENV_INDIRECT,
+	ENV_INPUT,
+	ENV_OUTPUT,
+	ENV_GENERAL_STATE,
+	ENV_BATCH,
+	ENV_SYNC,
+	/* xe2lpg only */
+	ENV_DYNAMIC_STATE,
+	ENV_SURFACE_STATE,
+	ENV_BINDING_TABLE,
+	ENV_STATE_CONTEXT,
+	ENV_MAX_ENTRIES
+};
+
+struct intel_compute_env_slot {
+	uint32_t work_size;
+	bool pending;
+};
+
+/**
+ * struct intel_compute_env - Persistent compute execution environment
+ *
+ * Holds the VM, exec queue and every buffer a compute dispatch needs, so
+ * that only the kernel arguments have to be written per dispatch. See
+ * intel_compute_env_create().
+ */
+struct intel_compute_env {
+	struct bo_execenv execenv;
+	struct bo_dict_entry bo_dict[ENV_MAX_ENTRIES];
+	int entries;
+	bool xe2;
+	unsigned int num_slots;
+	struct intel_compute_env_slot slots[ENV_MAX_SLOTS];
+};
+
+static uint64_t env_input_addr(struct intel_compute_env *env, unsigned int slot)
+{
+	return ADDR_INPUT + slot * size_input(env->execenv.array_size);
+}
+
+static uint64_t env_output_addr(struct intel_compute_env *env, unsigned int slot)
+{
+	return ADDR_OUTPUT + slot * size_output(env->execenv.array_size);
+}
+
+static uint64_t *env_sync(struct intel_compute_env *env, unsigned int slot)
+{
+	return (uint64_t *)env->bo_dict[ENV_SYNC].data + slot;
+}
+
+/*
+ * The walkers' post-sync writes land at ADDR_BATCH, so the batches of the
+ * slots start one page above, where no dispatch can clobber them.
+ */
+static uint64_t env_batch_offset(unsigned int slot)
+{
+	return (slot + 1) * ENV_SLOT_BATCH;
+}
+
+static void env_build_batch(struct intel_compute_env *env, unsigned int slot,
+			    uint32_t work_size)
+{
+	uint32_t *batch = env->bo_dict[ENV_BATCH].data + env_batch_offset(slot);
+	uint64_t indirect = OFFSET_INDIRECT_DATA_START + slot * ENV_SLOT_INDIRECT;
+
+	if (env->xe2)
+		xe2lpg_compute_exec_compute(env->execenv.fd, batch,
+					    ADDR_GENERAL_STATE_BASE,
+					    ADDR_SURFACE_STATE_BASE,
+					    ADDR_DYNAMIC_STATE_BASE,
+					    ADDR_INSTRUCTION_STATE_BASE,
+					    XE2_ADDR_STATE_CONTEXT_DATA_BASE,
+					    indirect, OFFSET_KERNEL, 0, false,
+					    work_size);
+	else
+		xehpc_compute_exec_compute(env->execenv.fd, batch,
+					   ADDR_GENERAL_STATE_BASE,
+					   ADDR_SURFACE_STATE_BASE,
+					   ADDR_DYNAMIC_STATE_BASE,
+					   ADDR_INSTRUCTION_STATE_BASE,
+					   indirect, OFFSET_KERNEL);
+
+	env->slots[slot].work_size = work_size;
+}
+
+/**
+ * intel_compute_env_create:
+ * @fd: file descriptor of the opened DRM Xe device
+ * @eci: engine to dispatch on, or NULL for the default compute engine
+ * @user: user-provided execution environment, or NULL. @user->array_size
+ *        is the largest work size that can be dispatched, @user->kernel
+ *        replaces the default square kernel and @user->vm the VM.
+ * @alloc_prefs: where to allocate the buffers
+ * @num_slots: number of dispatches that can be in flight at once
+ *
+ * Sets up everything run_intel_compute_kernel() sets up per call once: the
+ * VM and exec queue, the kernel, the state heaps, and a batch, kernel
+ * arguments and input and output arrays per slot. Dispatching then only
+ * writes the kernel arguments of the slot, and rebuilds its batch when the
+ * work size changes.
+ *
+ * Only XeHPC and Xe2 and later are supported.
+ *
+ * Returns: The environment, or NULL if the device is not supported.
+ */
+struct intel_compute_env *
+intel_compute_env_create(int fd, struct drm_xe_engine_class_instance *eci,
+			 struct user_execenv *user,
+			 enum execenv_alloc_prefs alloc_prefs,
+			 unsigned int num_slots)
+{
+	unsigned int ip_ver = intel_graphics_ver(intel_get_drm_devid(fd));
+	const struct intel_compute_kernels *kernels;
+	const unsigned char *kernel;
+	unsigned int kernel_size;
+	struct intel_compute_env *env;
+	struct bo_dict_entry *bo_dict;
+
+	igt_assert(num_slots && num_slots <= ENV_MAX_SLOTS);
+
+	if (!is_xe_device(fd)) {
+		igt_debug("Xe device expected\n");
+		return NULL;
+	}
+
+	if (ip_ver != IP_VER(12, 60) && ip_ver < IP_VER(20, 01)) {
+		igt_debug("GPU version 0x%x not supported\n", ip_ver);
+		return NULL;
+	}
+
+	if (user && user->kernel) {
+		kernel = user->kernel;
+		kernel_size = user->kernel_size;
+	} else {
+		kernels = intel_compute_find_kernels(intel_compute_square_kernels,
+						     ip_ver);
+		if (!validate_kernels(kernels, false, false, ip_ver))
+			return NULL;
+		kernel = kernels->kernel;
+		kernel_size = kernels->size;
+	}
+
+	env = calloc(1, sizeof(*env));
+	igt_assert(env);
+	env->xe2 = ip_ver >= IP_VER(20, 01);
+	env->num_slots = num_slots;
+	bo_dict = env->bo_dict;
+
+	bo_execenv_create(fd, &env->execenv, eci, user);
+
+	bo_dict[ENV_KERNEL] = (struct bo_dict_entry) {
+		.addr = ADDR_INSTRUCTION_STATE_BASE + OFFSET_KERNEL,
+		.size = ALIGN(kernel_size, xe_get_default_alignment(fd)),
+		.name = "instr state base" };
+	bo_dict[ENV_INDIRECT] = (struct bo_dict_entry) {
+		.addr = ADDR_GENERAL_STATE_BASE + OFFSET_INDIRECT_DATA_START,
+		.size = ALIGN(num_slots * ENV_SLOT_INDIRECT, SIZE_INDIRECT_OBJECT),
+		.name = "indirect object base" };
+	bo_dict[ENV_INPUT] = (struct bo_dict_entry) {
+		.addr = ADDR_INPUT,
+		.size = num_slots * size_input(env->execenv.array_size),
+		.name = "addr input" };
+	bo_dict[ENV_OUTPUT] = (struct bo_dict_entry) {
+		.addr = ADDR_OUTPUT,
+		.size = num_slots * size_output(env->execenv.array_size),
+		.name = "addr output" };
+	bo_dict[ENV_GENERAL_STATE] = (struct bo_dict_entry) {
+		.addr = ADDR_GENERAL_STATE_BASE,
+		.size = SIZE_GENERAL_STATE,
+		.name = "general state base" };
+	bo_dict[ENV_BATCH] = (struct bo_dict_entry) {
+		.addr = ADDR_BATCH,
+		.size = ALIGN(env_batch_offset(num_slots), SIZE_BATCH),
+		.name = "batch" };
+	bo_dict[ENV_SYNC] = (struct bo_dict_entry) {
+		.addr = ADDR_SYNC,
+		.size = xe_bb_size(fd, num_slots * sizeof(uint64_t)),
+		.name = "sync" };
+	env->entries = ENV_SYNC + 1;
+
+	if (env->xe2) {
+		bo_dict[ENV_DYNAMIC_STATE] = (struct bo_dict_entry) {
+			.addr = ADDR_DYNAMIC_STATE_BASE,
+			.size = SIZE_DYNAMIC_STATE,
+			.name = "dynamic state base" };
+		bo_dict[ENV_SURFACE_STATE] = (struct bo_dict_entry) {
+			.addr = ADDR_SURFACE_STATE_BASE,
+			.size = SIZE_SURFACE_STATE,
+			.name = "surface state base" };
+		bo_dict[ENV_BINDING_TABLE] = (struct bo_dict_entry) {
+			.addr = ADDR_BINDING_TABLE,
+			.size = SIZE_BINDING_TABLE,
+			.name = "binding table" };
+		bo_dict[ENV_STATE_CONTEXT] = (struct bo_dict_entry) {
+			.addr = XE2_ADDR_STATE_CONTEXT_DATA_BASE,
+			.size = 0x10000,
+			.name = "state context data base" };
+		env->entries = ENV_MAX_ENTRIES;
+	}
+
+	bo_execenv_bind(&env->execenv, alloc_prefs, bo_dict, env->entries);
+
+	memcpy(bo_dict[ENV_KERNEL].data, kernel, kernel_size);
+	if (env->xe2) {
+		/*
+		 * The kernel reaches the arrays through the pointers in its
+		 * arguments, the surface states only describe those of slot 0.
+		 */
+		create_dynamic_state(bo_dict[ENV_DYNAMIC_STATE].data, OFFSET_KERNEL);
+		xehp_create_surface_state(bo_dict[ENV_SURFACE_STATE].data,
+					  ADDR_INPUT, ADDR_OUTPUT);
+		xehp_create_surface_state(bo_dict[ENV_BINDING_TABLE].data,
+					  ADDR_INPUT, ADDR_OUTPUT);
+	}
+
+	for (unsigned int slot = 0; slot < num_slots; slot++)
+		env_build_batch(env, slot, env->execenv.array_size);
+
+	return env;
+}
+
+/**
+ * intel_compute_env_input:
+ * @env: environment from intel_compute_env_create()
+ * @slot: dispatch slot
+ *
+ * Returns: CPU mapping of the input array of @slot.
+ */
+float *intel_compute_env_input(struct intel_compute_env *env, unsigned int slot)
+{
+	igt_assert(slot < env->num_slots);
+
+	return env->bo_dict[ENV_INPUT].data +
+	       slot * size_input(env->execenv.array_size);
+}
+
+/**
+ * intel_compute_env_output:
+ * @env: environment from intel_compute_env_create()
+ * @slot: dispatch slot
+ *
+ * Returns: CPU mapping of the output array of @slot.
+ */
+float *intel_compute_env_output(struct intel_compute_env *env, unsigned int slot)
+{
+	igt_assert(slot < env->num_slots);
+
+	return env->bo_dict[ENV_OUTPUT].data +
+	       slot * size_output(env->execenv.array_size);
+}
+
+/**
+ * intel_compute_env_wait:
+ * @env: environment from intel_compute_env_create()
+ * @slot: dispatch slot
+ *
+ * Waits for the last dispatch of @slot to complete, if any.
+ */
+void intel_compute_env_wait(struct intel_compute_env *env, unsigned int slot)
+{
+	igt_assert(slot < env->num_slots);
+
+	if (!env->slots[slot].pending)
+		return;
+
+	xe_wait_ufence(env->execenv.fd, env_sync(env, slot), USER_FENCE_VALUE,
+		       env->execenv.exec_queue, INT64_MAX);
+	env->slots[slot].pending = false;
+}
+
+/**
+ * intel_compute_env_sync:
+ * @env: environment from intel_compute_env_create()
+ *
+ * Waits for all dispatches to complete.
+ */
+void intel_compute_env_sync(struct intel_compute_env *env)
+{
+	for (unsigned int slot = 0; slot < env->num_slots; slot++)
+		intel_compute_env_wait(env, slot);
+}
+
+/**
+ * intel_compute_env_dispatch:
+ * @env: environment from intel_compute_env_create()
+ * @slot: dispatch slot, whose input and output arrays are used
+ * @work_size: number of elements to process, at most the array size the
+ *             environment was created with
+ *
+ * Submits the kernel over the arrays of @slot without waiting for it to
+ * complete, see intel_compute_env_wait(). Waits for the previous dispatch
+ * of @slot first, so cycling through the slots keeps up to the number of
+ * slots dispatches in flight.
+ */
+void intel_compute_env_dispatch(struct intel_compute_env *env,
+				unsigned int slot, uint32_t work_size)
+{
+	struct drm_xe_sync sync = {
+		.type = DRM_XE_SYNC_TYPE_USER_FENCE,
+		.flags = DRM_XE_SYNC_FLAG_SIGNAL,
+		.timeline_value = USER_FENCE_VALUE,
+		.addr = ADDR_SYNC + slot * sizeof(uint64_t),
+	};
+	uint32_t *indirect = env->bo_dict[ENV_INDIRECT].data +
+			     slot * ENV_SLOT_INDIRECT;
+
+	igt_assert(work_size && work_size <= env->execenv.array_size);
+	intel_compute_env_wait(env, slot);
+
+	if (env->xe2)
+		xelpg_create_indirect_data(indirect, env_input_addr(env, slot),
+					   env_output_addr(env, slot), work_size);
+	else
+		xehpc_create_indirect_data(indirect, env_input_addr(env, slot),
+					   env_output_addr(env, slot), work_size);
+
+	if (env->slots[slot].work_size != work_size)
+		env_build_batch(env, slot, work_size);
+
+	*env_sync(env, slot) = 0;
+	xe_exec_sync(env->execenv.fd, env->execenv.exec_queue,
+		     ADDR_BATCH + env_batch_offset(slot), &sync, 1);
+	env->slots[slot].pending = true;
+}
+
+/**
+ * intel_compute_env_destroy:
+ * @env: environment from intel_compute_env_create()
+ *
+ * Waits for all dispatches, then releases the environment.
+ */
+void intel_compute_env_destroy(struct intel_compute_env *env)
+{
+	intel_compute_env_sync(env);
+	bo_execenv_unbind(&env->execenv, env->bo_dict, env->entries);
+	bo_execenv_destroy(&env->execenv);
+	free(env);
+}
+
 /**
  * xe2lpg_compute_preempt_exec - run a pipeline compatible with XE2 and
  * submit long and short kernels for preemption occurrence.
@@ -2083,6 +2428,8 @@ bool xe_run_intel_compute_kernel_on_engine(int fd,
  * @sip_kernel_size: size of @sip_kernel
  * @loop_kernel: loop kernel binary stoppable by cpu write
  * @loop_kernel_size: size of @loop_kernel
+ * @preempt_ns: if not NULL, returns the time the short kernel took from
+ *		submission to completion while the long kernel was running
  */
 static void xe2lpg_compute_preempt_exec(int fd, const unsigned char *long_kernel,
 					unsigned int long_kernel_size,
@@ -2094,7 +2441,8 @@ static void xe2lpg_compute_preempt_exec(int fd, const unsigned char *long_kernel
 					unsigned int loop_kernel_size,
 					struct drm_xe_engine_class_instance *eci,
 					bool threadgroup_preemption,
-					enum execenv_alloc_prefs alloc_prefs)
+					enum execenv_alloc_prefs alloc_prefs,
+					uint64_t *preempt_ns)
 {
 	struct bo_dict_entry bo_dict_long[] = {
 		{ .addr = ADDR_INSTRUCTION_STATE_BASE + OFFSET_KERNEL,
@@ -2133,6 +2481,8 @@ static void xe2lpg_compute_preempt_exec(int fd, const unsigned char *long_kernel
 	struct bo_execenv execenv_short, execenv_long;
 	float *input_short, *output_short, *input_long;
 	uint64_t *post_data;
+	struct timespec start;
+	uint64_t elapsed;
 	unsigned int long_kernel_loop_count = 0;
 	int64_t timeout_one_ns = 1;
 	bool use_loop_kernel = loop_kernel && !threadgroup_preemption;
@@ -2207,7 +2557,9 @@ static void xe2lpg_compute_preempt_exec(int fd, const unsigned char *long_kernel
 	 * Regardless scenario - wmtp or threadgroup short job (compute
 	 * square) must complete first and long job must be still active.
 	 */
+	igt_nsec_elapsed(&start);
 	bo_execenv_exec(&execenv_short, ADDR_BATCH);
+	elapsed = igt_nsec_elapsed(&start);
 	bo_check_square(input_short, output_short, SIZE_DATA);
 
 	/*
@@ -2228,6 +2580,9 @@ static void xe2lpg_compute_preempt_exec(int fd, const unsigned char *long_kernel
 	bo_execenv_sync(&execenv_long);
 	igt_assert_eq_u64(POST_SYNC_VALUE, *post_data);
 
+	if (preempt_ns)
+		*preempt_ns = elapsed;
+
 	bo_execenv_unbind(&execenv_short, bo_dict_short, entries);
 	bo_execenv_unbind(&execenv_long, bo_dict_long, entries);
 
@@ -2247,7 +2602,8 @@ static const struct {
 			     unsigned int loop_kernel_size,
 			     struct drm_xe_engine_class_instance *eci,
 			     bool threadgroup_preemption,
-			     enum execenv_alloc_prefs alloc_prefs);
+			     enum execenv_alloc_prefs alloc_prefs,
+			     uint64_t *preempt_ns);
 	uint32_t compat;
 	enum xe_compute_preempt_type preempt_type;
 } intel_compute_preempt_batches[] = {
@@ -2302,7 +2658,8 @@ static const char *xe_preempt_type_to_str(enum xe_compute_preempt_type type)
 static bool __run_intel_compute_kernel_preempt(int fd,
 		struct drm_xe_engine_class_instance *eci,
 		bool threadgroup_preemption,
-		enum execenv_alloc_prefs alloc_prefs)
+		enum execenv_alloc_prefs alloc_prefs,
+		uint64_t *preempt_ns)
 {
 	unsigned int ip_ver = intel_graphics_ver(intel_get_drm_devid(fd));
 	int batch;
@@ -2343,7 +2700,7 @@ static bool __run_intel_compute_kernel_preempt(int fd,
 							  kernels->loop_kernel_size,
 							  eci,
 							  threadgroup_preemption,
-							  alloc_prefs);
+							  alloc_prefs, preempt_ns);
 
 	return true;
 }
@@ -2390,5 +2747,31 @@ bool run_intel_compute_kernel_preempt(int fd,
 		enum execenv_alloc_prefs alloc_prefs)
 {
 	return __run_intel_compute_kernel_preempt(fd, eci, threadgroup_preemption,
-						  alloc_prefs);
+						  alloc_prefs, NULL);
+}
+
+/**
+ * run_intel_compute_kernel_preempt_latency - runs the preemption scenario
+ * and measures it.
+ *
+ * @fd: file descriptor of the opened DRM Xe device
+ * @eci: engine class instance
+ * @threadgroup_preemption: use threadgroup instead of mid thread preemption
+ * @alloc_prefs: where to allocate the buffers
+ * @preempt_ns: returns the time the short kernel took from submission to
+ *		completion, preempting the long kernel
+ *
+ * Same as run_intel_compute_kernel_preempt(), which only checks that the
+ * long kernel got preempted.
+ *
+ * Returns true on success, false otherwise.
+ */
+bool run_intel_compute_kernel_preempt_latency(int fd,
+		struct drm_xe_engine_class_instance *eci,
+		bool threadgroup_preemption,
+		enum execenv_alloc_prefs alloc_prefs,
+		uint64_t *preempt_ns)
+{
+	return __run_intel_compute_kernel_preempt(fd, eci, threadgroup_preemption,
+						  alloc_prefs, preempt_ns);
 }
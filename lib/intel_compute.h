@@ -81,6 +81,8 @@ enum xe_compute_preempt_type {
 	PREEMPT_WMTP  = 1 << 1,
 };
 
+struct intel_compute_env;
+
 extern const struct intel_compute_kernels intel_compute_square_kernels[];
 
 bool run_intel_compute_kernel(int fd, struct user_execenv *user,
@@ -91,5 +93,23 @@ bool xe_run_intel_compute_kernel_on_engine(int fd, struct drm_xe_engine_class_in
 bool run_intel_compute_kernel_preempt(int fd, struct drm_xe_engine_class_instance *eci,
 				      bool threadgroup_preemption,
 				      enum execenv_alloc_prefs alloc_prefs);
+bool run_intel_compute_kernel_preempt_latency(int fd,
+					      struct drm_xe_engine_class_instance *eci,
+					      bool threadgroup_preemption,
+					      enum execenv_alloc_prefs alloc_prefs,
+					      uint64_t *preempt_ns);
 bool xe_kernel_preempt_check(int fd, enum xe_compute_preempt_type required_preempt);
+
+struct intel_compute_env *
+intel_compute_env_create(int fd, struct drm_xe_engine_class_instance *eci,
+			 struct user_execenv *user,
+			 enum execenv_alloc_prefs alloc_prefs,
+			 unsigned int num_slots);
+float *intel_compute_env_input(struct intel_compute_env *env, unsigned int slot);
+float *intel_compute_env_output(struct intel_compute_env *env, unsigned int slot);
+void intel_compute_env_dispatch(struct intel_compute_env *env,
+				unsigned int slot, uint32_t work_size);
+void intel_compute_env_wait(struct intel_compute_env *env, unsigned int slot);
+void intel_compute_env_sync(struct intel_compute_env *env);
+void intel_compute_env_destroy(struct intel_compute_env *env);
 #endif	/* INTEL_COMPUTE_H */
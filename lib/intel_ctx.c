@@ -6,7 +6,9 @@
 #include <stddef.h>
 
 #include "i915/gem_engine_topology.h"
+#include "igt_map.h"
 #include "igt_syncobj.h"
+#include "igt_vec.h"
 #include "intel_allocator.h"
 #include "intel_ctx.h"
 #include "ioctl_wrappers.h"
@@ -23,6 +25,10 @@
  * struct which contains the context ID and its configuration.  This makes
  * it easier to pass around a context without losing the context create
  * information.
+ *
+ * Tests creating contexts in a loop can take them from a #intel_ctx_pool
+ * instead, which recycles the contexts returned to it, and the exec queues
+ * on Xe, for the next request of the same configuration.
  */
 
 static void
@@ -37,9 +43,6 @@ static size_t sizeof_param_engines(int count)
 	return offsetof(struct i915_context_param_engines, engines[count]);
 }
 
-#define SIZEOF_QUERY		offsetof(struct drm_i915_query_engine_info, \
-					 engines[GEM_MAX_ENGINES])
-
 /**
  * intel_ctx_cfg_all_physical:
  * @fd: open i915 drm file descriptor
@@ -50,16 +53,10 @@ static size_t sizeof_param_engines(int count)
  */
 intel_ctx_cfg_t intel_ctx_cfg_all_physical(int fd)
 {
-	uint8_t buff[SIZEOF_QUERY] = { };
-	struct drm_i915_query_engine_info *qei = (void *) buff;
 	intel_ctx_cfg_t cfg = {};
-	int i;
 
-	if (__gem_query_engines(fd, qei, SIZEOF_QUERY) == 0) {
-		cfg.num_engines = qei->num_engines;
-		for (i = 0; i < qei->num_engines; i++)
-			cfg.engines[i] = qei->engines[i].engine;
-	}
+	if (__gem_list_engines(fd, cfg.engines, &cfg.num_engines))
+		cfg.num_engines = 0;
 
 	return cfg;
 }
@@ -486,3 +483,325 @@ int intel_ctx_xe_sync(intel_ctx_t *ctx, bool reset_syncs)
 
 	return ret;
 }
+
+/**
+ * intel_ctx_pool:
+ *
+ * A pool of contexts, or of exec queues on Xe, see intel_ctx_pool_create().
+ */
+struct intel_ctx_pool {
+	int fd;
+	bool xe;
+	unsigned int max_idle, num_idle;
+
+	/* struct ctx_pool_key -> struct ctx_pool_bucket */
+	struct igt_map *buckets;
+	/* intel_ctx_t handed out -> its struct ctx_pool_bucket */
+	struct igt_map *busy;
+};
+
+/* Zeroed but for the fields relevant to the context, to be hashed as bytes */
+struct ctx_pool_key {
+	intel_ctx_cfg_t cfg;
+	struct drm_xe_engine_class_instance eci;
+};
+
+struct ctx_pool_bucket {
+	struct ctx_pool_key key;
+	struct igt_vec idle;
+};
+
+static uint32_t ctx_pool_key_hash(const void *key)
+{
+	const uint8_t *p = key;
+	uint32_t hash = 2166136261u;
+
+	/* FNV-1a */
+	for (size_t i = 0; i < sizeof(struct ctx_pool_key); i++)
+		hash = (hash ^ p[i]) * 16777619u;
+
+	return hash;
+}
+
+static int ctx_pool_key_equal(const void *a, const void *b)
+{
+	return !memcmp(a, b, sizeof(struct ctx_pool_key));
+}
+
+static uint32_t ctx_pool_ptr_hash(const void *key)
+{
+	uint64_t ptr = (uintptr_t)key;
+
+	return igt_map_hash_64(&ptr);
+}
+
+static int ctx_pool_ptr_equal(const void *a, const void *b)
+{
+	return a == b;
+}
+
+static void ctx_pool_key_i915(struct ctx_pool_key *key,
+			      const intel_ctx_cfg_t *cfg)
+{
+	unsigned int count;
+
+	memset(key, 0, sizeof(*key));
+	if (!cfg)
+		return;
+
+	key->cfg.flags = cfg->flags;
+	key->cfg.vm = cfg->vm;
+	key->cfg.nopersist = cfg->nopersist;
+	key->cfg.load_balance = cfg->load_balance;
+	key->cfg.parallel = cfg->parallel;
+	key->cfg.num_engines = cfg->num_engines;
+	key->cfg.width = cfg->width;
+
+	count = cfg->parallel ? cfg->num_engines * cfg->width : cfg->num_engines;
+	for (unsigned int i = 0; i < count && i < GEM_MAX_ENGINES; i++)
+		key->cfg.engines[i] = cfg->engines[i];
+}
+
+static void ctx_pool_key_xe(struct ctx_pool_key *key, uint32_t vm,
+			    const struct drm_xe_engine_class_instance *eci)
+{
+	memset(key, 0, sizeof(*key));
+	key->cfg.vm = vm;
+	key->eci.engine_class = eci->engine_class;
+	key->eci.engine_instance = eci->engine_instance;
+	key->eci.gt_id = eci->gt_id;
+}
+
+static void ctx_pool_free(struct intel_ctx_pool *pool, const intel_ctx_t *ctx)
+{
+	if (pool->xe) {
+		xe_exec_queue_destroy(pool->fd, ctx->exec_queue);
+		free((void *)ctx);
+	} else {
+		intel_ctx_destroy(pool->fd, ctx);
+	}
+}
+
+/*
+ * Whether @ctx can be handed out again, its mutable state back to the
+ * defaults: neither banned nor involved in a reset, at the default priority.
+ */
+static bool ctx_pool_reset(struct intel_ctx_pool *pool, const intel_ctx_t *ctx)
+{
+	int err;
+
+	if (pool->xe) {
+		struct drm_xe_exec_queue_get_property prop = {
+			.exec_queue_id = ctx->exec_queue,
+			.property = DRM_XE_EXEC_QUEUE_GET_PROPERTY_BAN,
+		};
+
+		return !igt_ioctl(pool->fd, DRM_IOCTL_XE_EXEC_QUEUE_GET_PROPERTY,
+				  &prop) && !prop.value;
+	} else {
+		struct drm_i915_reset_stats stats = { .ctx_id = ctx->id };
+
+		if (igt_ioctl(pool->fd, DRM_IOCTL_I915_GET_RESET_STATS, &stats) ||
+		    stats.batch_active || stats.batch_pending)
+			return false;
+
+		err = __gem_context_set_priority(pool->fd, ctx->id,
+						 I915_CONTEXT_DEFAULT_PRIORITY);
+		return !err || err == -ENODEV;
+	}
+}
+
+/**
+ * intel_ctx_pool_create:
+ * @fd: open i915 or xe drm file descriptor
+ * @max_idle: maximum number of contexts kept for reuse
+ *
+ * Creates a pool recycling the contexts, or the exec queues on Xe, returned
+ * to it with intel_ctx_pool_put() for the next intel_ctx_pool_get() of the
+ * same configuration, skipping the creation ioctl and its extensions.
+ *
+ * Contexts are only recycled when that is invisible to their next user,
+ * short of the requests they still have in flight, which the next requests
+ * on the context will be ordered after. A context involved in a reset or
+ * banned is destroyed rather than recycled, and the priority of i915
+ * contexts is reset to the default. Other parameters changed with
+ * gem_context_set_param() are not restored, so such contexts must be
+ * destroyed with intel_ctx_destroy() rather than returned to the pool.
+ *
+ * Returns: the new pool.
+ */
+struct intel_ctx_pool *intel_ctx_pool_create(int fd, unsigned int max_idle)
+{
+	struct intel_ctx_pool *pool;
+
+	pool = calloc(1, sizeof(*pool));
+	igt_assert(pool);
+
+	pool->fd = fd;
+	pool->xe = is_xe_device(fd);
+	pool->max_idle = max_idle;
+	pool->buckets = igt_map_create(ctx_pool_key_hash, ctx_pool_key_equal);
+	pool->busy = igt_map_create(ctx_pool_ptr_hash, ctx_pool_ptr_equal);
+
+	return pool;
+}
+
+/**
+ * intel_ctx_pool_destroy:
+ * @pool: pool to destroy
+ *
+ * Destroys @pool and all its contexts, including the ones not returned to
+ * it yet.
+ */
+void intel_ctx_pool_destroy(struct intel_ctx_pool *pool)
+{
+	struct igt_map_entry *entry;
+
+	igt_map_foreach(pool->busy, entry)
+		ctx_pool_free(pool, entry->key);
+	igt_map_destroy(pool->busy, NULL);
+
+	igt_map_foreach(pool->buckets, entry) {
+		struct ctx_pool_bucket *bucket = entry->data;
+
+		for (int i = 0; i < igt_vec_length(&bucket->idle); i++)
+			ctx_pool_free(pool, *(const intel_ctx_t **)
+				      igt_vec_elem(&bucket->idle, i));
+		igt_vec_fini(&bucket->idle);
+		free(bucket);
+	}
+	igt_map_destroy(pool->buckets, NULL);
+
+	free(pool);
+}
+
+static struct ctx_pool_bucket *
+ctx_pool_bucket(struct intel_ctx_pool *pool, const struct ctx_pool_key *key)
+{
+	struct ctx_pool_bucket *bucket;
+
+	bucket = igt_map_search(pool->buckets, key);
+	if (bucket)
+		return bucket;
+
+	bucket = calloc(1, sizeof(*bucket));
+	igt_assert(bucket);
+	bucket->key = *key;
+	igt_vec_init(&bucket->idle, sizeof(const intel_ctx_t *));
+	igt_map_insert(pool->buckets, &bucket->key, bucket);
+
+	return bucket;
+}
+
+/* Takes an idle context out of @bucket, NULL if there is none */
+static const intel_ctx_t *
+ctx_pool_take(struct intel_ctx_pool *pool, struct ctx_pool_bucket *bucket)
+{
+	int last = igt_vec_length(&bucket->idle) - 1;
+	const intel_ctx_t *ctx;
+
+	if (last < 0)
+		return NULL;
+
+	ctx = *(const intel_ctx_t **)igt_vec_elem(&bucket->idle, last);
+	igt_vec_remove(&bucket->idle, last);
+	pool->num_idle--;
+	igt_map_insert(pool->busy, ctx, bucket);
+
+	return ctx;
+}
+
+/**
+ * intel_ctx_pool_get:
+ * @pool: i915 context pool
+ * @cfg: configuration of the context, or NULL for a default one
+ *
+ * Like intel_ctx_create() but reuses a context of the same configuration
+ * returned to @pool when there is one.
+ *
+ * Returns: a context to return with intel_ctx_pool_put().
+ */
+const intel_ctx_t *intel_ctx_pool_get(struct intel_ctx_pool *pool,
+				      const intel_ctx_cfg_t *cfg)
+{
+	struct ctx_pool_bucket *bucket;
+	struct ctx_pool_key key;
+	const intel_ctx_t *ctx;
+
+	igt_assert(!pool->xe);
+
+	ctx_pool_key_i915(&key, cfg);
+	bucket = ctx_pool_bucket(pool, &key);
+
+	ctx = ctx_pool_take(pool, bucket);
+	if (!ctx) {
+		ctx = intel_ctx_create(pool->fd, cfg);
+		igt_map_insert(pool->busy, ctx, bucket);
+	}
+
+	return ctx;
+}
+
+/**
+ * intel_ctx_pool_get_xe:
+ * @pool: xe exec queue pool
+ * @vm: vm of the exec queue
+ * @eci: engine of the exec queue
+ *
+ * Returns an intel_ctx_t, as from intel_ctx_xe(), holding an exec queue for
+ * @eci on @vm, reusing one returned to @pool when there is one.
+ *
+ * Returns: a context to return with intel_ctx_pool_put().
+ */
+const intel_ctx_t *
+intel_ctx_pool_get_xe(struct intel_ctx_pool *pool, uint32_t vm,
+		      struct drm_xe_engine_class_instance *eci)
+{
+	struct ctx_pool_bucket *bucket;
+	struct ctx_pool_key key;
+	const intel_ctx_t *ctx;
+
+	igt_assert(pool->xe);
+
+	ctx_pool_key_xe(&key, vm, eci);
+	bucket = ctx_pool_bucket(pool, &key);
+
+	ctx = ctx_pool_take(pool, bucket);
+	if (!ctx) {
+		ctx = intel_ctx_xe(pool->fd, vm,
+				   xe_exec_queue_create(pool->fd, vm, eci, 0),
+				   0, 0, 0);
+		igt_map_insert(pool->busy, ctx, bucket);
+	}
+
+	return ctx;
+}
+
+/**
+ * intel_ctx_pool_put:
+ * @pool: pool @ctx was taken from
+ * @ctx: context to return, or NULL
+ *
+ * Returns @ctx to @pool for reuse, or destroys it if @pool already keeps
+ * as many idle contexts as it may or if it can't be reset, see
+ * intel_ctx_pool_create().
+ */
+void intel_ctx_pool_put(struct intel_ctx_pool *pool, const intel_ctx_t *ctx)
+{
+	struct ctx_pool_bucket *bucket;
+
+	if (!ctx)
+		return;
+
+	bucket = igt_map_search(pool->busy, ctx);
+	igt_assert_f(bucket, "context not taken from this pool\n");
+	igt_map_remove(pool->busy, ctx, NULL);
+
+	if (pool->num_idle >= pool->max_idle || !ctx_pool_reset(pool, ctx)) {
+		ctx_pool_free(pool, ctx);
+		return;
+	}
+
+	igt_vec_push(&bucket->idle, &ctx);
+	pool->num_idle++;
+}
@@ -89,6 +89,18 @@ void intel_ctx_destroy(int fd, const intel_ctx_t *ctx);
 
 unsigned int intel_ctx_engine_class(const intel_ctx_t *ctx, unsigned int engine);
 
+struct drm_xe_engine_class_instance;
+struct intel_ctx_pool;
+
+struct intel_ctx_pool *intel_ctx_pool_create(int fd, unsigned int max_idle);
+void intel_ctx_pool_destroy(struct intel_ctx_pool *pool);
+const intel_ctx_t *intel_ctx_pool_get(struct intel_ctx_pool *pool,
+				      const intel_ctx_cfg_t *cfg);
+const intel_ctx_t *
+intel_ctx_pool_get_xe(struct intel_ctx_pool *pool, uint32_t vm,
+		      struct drm_xe_engine_class_instance *eci);
+void intel_ctx_pool_put(struct intel_ctx_pool *pool, const intel_ctx_t *ctx);
+
 intel_ctx_t *intel_ctx_xe(int fd, uint32_t vm, uint32_t exec_queue,
 			  uint32_t sync_in, uint32_t sync_bind, uint32_t sync_out);
 int __intel_ctx_xe_exec(const intel_ctx_t *ctx, uint64_t ahnd, uint64_t bb_offset);
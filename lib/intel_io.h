@@ -44,6 +44,7 @@ struct intel_register_range {
 
 struct intel_register_map {
 	struct intel_register_range *map;
+	uint32_t count;
 	uint32_t top;
 	uint32_t alignment_mask;
 };
@@ -68,6 +69,8 @@ int intel_register_access_init(struct intel_mmio_data *mmio_data,
 			       struct pci_device *pci_dev, int safe);
 void intel_register_access_fini(struct intel_mmio_data *mmio_data);
 uint32_t intel_register_read(struct intel_mmio_data *mmio_data, uint32_t reg);
+void intel_register_read_n(struct intel_mmio_data *mmio_data, uint32_t reg,
+			   uint32_t *vals, unsigned int count);
 void intel_register_write(struct intel_mmio_data *mmio_data, uint32_t reg,
 			  uint32_t val);
 int intel_register_access_needs_fakewake(struct intel_mmio_data *mmio_data);
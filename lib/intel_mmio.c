@@ -326,6 +326,68 @@ out:
 	return ret;
 }
 
+/**
+ * intel_register_read_n:
+ * @mmio_data:  mmio structure for IO operations
+ * @reg: offset of the first register
+ * @vals: returned register values
+ * @count: number of consecutive registers to read
+ *
+ * 32-bit reads of the @count registers from @reg on, like as many calls to
+ * intel_register_read(). With the register access white lists enabled, the
+ * lookup is done once per register range rather than for every register,
+ * and the registers of a range are then read back to back.
+ *
+ * Registers blocked for safety read as 0xffffffff.
+ */
+void
+intel_register_read_n(struct intel_mmio_data *mmio_data, uint32_t reg,
+		      uint32_t *vals, unsigned int count)
+{
+	struct intel_register_range *range;
+	bool blocked = false;
+	unsigned int n;
+
+	if (intel_gen(mmio_data->pci_device_id) >= 6)
+		igt_assert(mmio_data->key != -1);
+
+	if (!mmio_data->safe) {
+		while (count--) {
+			*vals++ = ioread32(mmio_data->igt_mmio, reg);
+			reg += 4;
+		}
+		return;
+	}
+
+	while (count) {
+		range = intel_get_register_range(mmio_data->map,
+						 reg,
+						 INTEL_RANGE_READ);
+		if (!range) {
+			/* Only warn once for a run of blocked registers */
+			if (!blocked)
+				igt_warn("Register read blocked for safety ""(*0x%08x)\n", reg);
+			blocked = true;
+
+			*vals++ = 0xffffffff;
+			reg += 4;
+			count--;
+			continue;
+		}
+		blocked = false;
+
+		/* Up to the last register wholly inside the range */
+		n = (range->base + range->size - reg + 1) / 4;
+		if (n > count)
+			n = count;
+		count -= n;
+		while (n--) {
+			*vals++ = ioread32(mmio_data->igt_mmio, reg);
+			reg += 4;
+		}
+	}
+}
+
 /**
  * intel_register_write:
  * @mmio_data:  mmio structure for IO operations
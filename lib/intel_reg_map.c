@@ -148,14 +148,17 @@ intel_get_register_map(uint32_t devid)
 
 	map.alignment_mask = 0x3;
 
+	for (map.count = 0; !(map.map[map.count].flags & INTEL_RANGE_END); )
+		map.count++;
+
 	return map;
 }
 
 struct intel_register_range *
 intel_get_register_range(struct intel_register_map map, uint32_t offset, uint32_t mode)
 {
-	struct intel_register_range *range = map.map;
-	uint32_t align = map.alignment_mask;
+	struct intel_register_range *range;
+	uint32_t lo = 0, hi = map.count;
 
 	if (offset & map.alignment_mask)
 		return NULL;
@@ -163,18 +166,27 @@ intel_get_register_range(struct intel_register_map map, uint32_t offset, uint32_
 	if (offset >= map.top)
 		return NULL;
 
-	while (!(range->flags & INTEL_RANGE_END)) {
-		/*  list is assumed to be in order */
-		if (offset < range->base)
-			break;
-
-		if ( (offset >= range->base) &&
-		     (offset + align) <= (range->base + range->size)) {
-			if ((mode & range->flags) == mode)
-				return range;
-		}
-		range++;
+	/*
+	 * The list is in order and the ranges don't overlap, look for the
+	 * last one starting at or below the offset.
+	 */
+	while (lo < hi) {
+		uint32_t mid = (lo + hi) / 2;
+
+		if (map.map[mid].base <= offset)
+			lo = mid + 1;
+		else
+			hi = mid;
 	}
+	if (!lo)
+		return NULL;
+
+	range = &map.map[lo - 1];
+	if (offset + map.alignment_mask > range->base + range->size)
+		return NULL;
+
+	if ((mode & range->flags) != mode)
+		return NULL;
 
-	return NULL;
+	return range;
 }
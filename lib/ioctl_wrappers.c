@@ -46,6 +46,8 @@
 #include <sys/utsname.h>
 #include <termios.h>
 #include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
 
 #include "drmtest.h"
 #include "i915_drm.h"
@@ -53,7 +55,9 @@
 #include "intel_batchbuffer.h"
 #include "intel_chipset.h"
 #include "intel_io.h"
+#include "igt_aux.h"
 #include "igt_debugfs.h"
+#include "igt_sizes.h"
 #include "igt_sysfs.h"
 #include "igt_x86.h"
 #include "config.h"
@@ -290,6 +294,8 @@ void gem_close(int fd, uint32_t handle)
 
 	igt_assert_neq(handle, 0);
 
+	gem_mmap_cache_release(fd, handle);
+
 	memset(&close_bo, 0, sizeof(close_bo));
 	close_bo.handle = handle;
 	do_ioctl(fd, DRM_IOCTL_GEM_CLOSE, &close_bo);
@@ -380,6 +386,192 @@ static void mmap_read(int fd, uint32_t handle, uint64_t offset, void *buf, uint6
 	munmap(map, offset + length);
 }
 
+/*
+ * gem_write() and gem_read() use pwrite and pread unless a test or the
+ * environment opts in to a WB mmap. In the auto mode, the mmap is only used
+ * when faster for the device, as measured on the first large transfer to it.
+ * Only transfers from GEM_TRANSFER_MMAP_MIN are worth the mmap and the
+ * faults.
+ */
+#define GEM_TRANSFER_MMAP_MIN	SZ_256K
+#define GEM_TRANSFER_CALIBRATE	SZ_1M
+#define GEM_TRANSFER_MAX_DEVS	8
+
+static struct {
+	pthread_mutex_t mutex;
+	int mode; /* -1 until set, or read from IGT_GEM_TRANSFER */
+	struct {
+		dev_t rdev;
+		bool mmap_write;
+		bool mmap_read;
+	} devs[GEM_TRANSFER_MAX_DEVS];
+	unsigned int num_devs;
+} transfer = {
+	.mutex = PTHREAD_MUTEX_INITIALIZER,
+	.mode = -1,
+};
+
+/*
+ * Transfers through a WB mmap, after moving the object to the CPU domain
+ * which waits for the GPU and clflushes as needed, the same as pwrite and
+ * pread do. The write is flushed to the display like pwrite does, in case the
+ * object is a framebuffer.
+ */
+static bool wb_transfer(int fd, uint32_t handle, uint64_t offset,
+			void *buf, uint64_t length, bool write)
+{
+	struct drm_i915_gem_sw_finish finish = { .handle = handle };
+	void *map;
+
+	map = __gem_mmap__cpu_coherent(fd, handle, 0, offset + length,
+				       write ? PROT_READ | PROT_WRITE : PROT_READ);
+	if (!map)
+		return false;
+
+	if (__gem_set_domain(fd, handle, I915_GEM_DOMAIN_CPU,
+			     write ? I915_GEM_DOMAIN_CPU : 0)) {
+		munmap(map, offset + length);
+		return false;
+	}
+
+	if (write) {
+		memcpy(map + offset, buf, length);
+		igt_ioctl(fd, DRM_IOCTL_I915_GEM_SW_FINISH, &finish);
+	} else {
+		memcpy(buf, map + offset, length);
+	}
+	munmap(map, offset + length);
+
+	return true;
+}
+
+/* Timed on a fd of its own, to leave the objects and contexts of the test be */
+static void transfer_calibrate(int test_fd, bool *mmap_write, bool *mmap_read)
+{
+	uint64_t best[2][2] = { { -1ull, -1ull }, { -1ull, -1ull } };
+	uint64_t size = GEM_TRANSFER_CALIBRATE;
+	uint32_t handle;
+	void *buf;
+	int fd;
+
+	*mmap_write = false;
+	*mmap_read = false;
+
+	fd = drm_reopen_driver(test_fd);
+	if (__gem_create(fd, &size, &handle)) {
+		drm_close_driver(fd);
+		return;
+	}
+
+	buf = calloc(1, size);
+	igt_assert(buf);
+
+	/* best[by mmap][read], the first round also faults the pages in */
+	for (int i = 0; i < 4; i++) {
+		for (int read = 0; read <= 1; read++) {
+			struct timespec tv = {};
+			int ret;
+
+			igt_nsec_elapsed(&tv);
+			ret = read ? __gem_read(fd, handle, 0, buf, size) :
+				     __gem_write(fd, handle, 0, buf, size);
+			if (ret)
+				goto out;
+			best[0][read] = min(best[0][read], igt_nsec_elapsed(&tv));
+
+			memset(&tv, 0, sizeof(tv));
+			igt_nsec_elapsed(&tv);
+			if (!wb_transfer(fd, handle, 0, buf, size, !read))
+				goto out;
+			best[1][read] = min(best[1][read], igt_nsec_elapsed(&tv));
+		}
+	}
+
+	*mmap_write = best[1][0] < best[0][0];
+	*mmap_read = best[1][1] < best[0][1];
+	igt_debug("Transfers of %"PRIu64" bytes: pwrite %"PRIu64"ns, pread %"PRIu64"ns, WB mmap write %"PRIu64"ns, read %"PRIu64"ns\n",
+		  size, best[0][0], best[0][1], best[1][0], best[1][1]);
+out:
+	free(buf);
+	gem_close(fd, handle);
+	drm_close_driver(fd);
+}
+
+static bool transfer_by_mmap(int fd, uint32_t handle, uint64_t length,
+			     bool write)
+{
+	struct drm_i915_gem_get_tiling tiling = { .handle = handle };
+	struct stat st;
+	bool ret = false;
+	unsigned int i;
+
+	pthread_mutex_lock(&transfer.mutex);
+	if (transfer.mode < 0) {
+		const char *env = getenv("IGT_GEM_TRANSFER");
+
+		transfer.mode = GEM_TRANSFER_IOCTL;
+		if (env && !strcmp(env, "auto"))
+			transfer.mode = GEM_TRANSFER_AUTO;
+		else if (env && !strcmp(env, "mmap"))
+			transfer.mode = GEM_TRANSFER_MMAP;
+	}
+
+	if (transfer.mode != GEM_TRANSFER_AUTO) {
+		ret = transfer.mode == GEM_TRANSFER_MMAP;
+		goto out;
+	}
+
+	if (length < GEM_TRANSFER_MMAP_MIN || fstat(fd, &st))
+		goto out;
+
+	/* pwrite and pread take care of the bit 17 swizzling of tiled objects */
+	if (!__gem_get_tiling(fd, &tiling) &&
+	    tiling.tiling_mode != I915_TILING_NONE)
+		goto out;
+
+	for (i = 0; i < transfer.num_devs; i++)
+		if (transfer.devs[i].rdev == st.st_rdev)
+			break;
+
+	if (i == transfer.num_devs) {
+		if (i == GEM_TRANSFER_MAX_DEVS)
+			goto out;
+
+		transfer.devs[i].rdev = st.st_rdev;
+		transfer_calibrate(fd, &transfer.devs[i].mmap_write,
+				   &transfer.devs[i].mmap_read);
+		transfer.num_devs++;
+	}
+
+	ret = write ? transfer.devs[i].mmap_write : transfer.devs[i].mmap_read;
+out:
+	pthread_mutex_unlock(&transfer.mutex);
+
+	return ret;
+}
+
+/**
+ * gem_set_transfer_mode:
+ * @mode: how gem_write() and gem_read() transfer data
+ *
+ * By default, or with IGT_GEM_TRANSFER=ioctl in the environment,
+ * gem_write() and gem_read() use pwrite and pread. Tests that only use them
+ * to move data around can opt in to %GEM_TRANSFER_AUTO, also selected by
+ * IGT_GEM_TRANSFER=auto, where transfers of at least 256KiB to untiled
+ * objects go through a WB mmap on devices where that measured faster. The
+ * measurement happens on the first such transfer, on a separate fd.
+ * %GEM_TRANSFER_MMAP, or IGT_GEM_TRANSFER=mmap, always uses a WB mmap.
+ *
+ * Either way, an mmap is used when the object or the kernel doesn't
+ * support pwrite or pread, as on discrete.
+ */
+void gem_set_transfer_mode(enum gem_transfer_mode mode)
+{
+	pthread_mutex_lock(&transfer.mutex);
+	transfer.mode = mode;
+	pthread_mutex_unlock(&transfer.mutex);
+}
+
 int __gem_write(int fd, uint32_t handle, uint64_t offset, const void *buf, uint64_t length)
 {
 	struct drm_i915_gem_pwrite gem_pwrite;
@@ -407,12 +599,18 @@ int __gem_write(int fd, uint32_t handle, uint64_t offset, const void *buf, uint6
  *
  * Method to write to a gem object. Uses the PWRITE ioctl when it is
  * available, else it uses mmap + memcpy to upload linear data to a
- * subrange of a gem buffer object.
+ * subrange of a gem buffer object. Uploads can go through a WB mmap
+ * instead when opted in, see gem_set_transfer_mode().
  */
 void gem_write(int fd, uint32_t handle, uint64_t offset, const void *buf, uint64_t length)
 {
-	int ret = __gem_write(fd, handle, offset, buf, length);
+	int ret;
+
+	if (transfer_by_mmap(fd, handle, length, true) &&
+	    wb_transfer(fd, handle, offset, (void *)buf, length, true))
+		return;
 
+	ret = __gem_write(fd, handle, offset, buf, length);
 	igt_assert(ret == 0 || ret == -EOPNOTSUPP);
 
 	if (ret == -EOPNOTSUPP)
@@ -445,12 +643,18 @@ int __gem_read(int fd, uint32_t handle, uint64_t offset, void *buf, uint64_t len
  *
  * Method to read from a gem object. Uses the PREAD ioctl when it is
  * available, else it uses mmap + memcpy to download linear data from a
- * subrange of a gem buffer object.
+ * subrange of a gem buffer object. Downloads can go through a WB mmap
+ * instead when opted in, see gem_set_transfer_mode().
  */
 void gem_read(int fd, uint32_t handle, uint64_t offset, void *buf, uint64_t length)
 {
-	int ret = __gem_read(fd, handle, offset, buf, length);
+	int ret;
+
+	if (transfer_by_mmap(fd, handle, length, false) &&
+	    wb_transfer(fd, handle, offset, buf, length, false))
+		return;
 
+	ret = __gem_read(fd, handle, offset, buf, length);
 	igt_assert(ret == 0 || ret == -EOPNOTSUPP);
 
 	if (ret == -EOPNOTSUPP)
@@ -63,6 +63,21 @@ uint32_t gem_get_caching(int fd, uint32_t handle);
 uint32_t gem_flink(int fd, uint32_t handle);
 uint32_t gem_open(int fd, uint32_t name);
 void gem_close(int fd, uint32_t handle);
+/**
+ * gem_transfer_mode:
+ * @GEM_TRANSFER_AUTO: pwrite/pread, or a WB mmap for large transfers when faster
+ * @GEM_TRANSFER_IOCTL: pwrite/pread whenever the kernel supports them, the default
+ * @GEM_TRANSFER_MMAP: a WB mmap whenever the object supports it
+ *
+ * How gem_write() and gem_read() transfer data, see gem_set_transfer_mode().
+ */
+enum gem_transfer_mode {
+	GEM_TRANSFER_AUTO,
+	GEM_TRANSFER_IOCTL,
+	GEM_TRANSFER_MMAP,
+};
+
+void gem_set_transfer_mode(enum gem_transfer_mode mode);
 int __gem_write(int fd, uint32_t handle, uint64_t offset, const void *buf, uint64_t length);
 void gem_write(int fd, uint32_t handle, uint64_t offset,  const void *buf, uint64_t length);
 int __gem_read(int fd, uint32_t handle, uint64_t offset, void *buf, uint64_t length);
@@ -23,6 +23,7 @@
  */
 
 #include <i915_drm.h>
+#include <stdlib.h>
 
 #include "media_fill.h"
 #include "gen7_media.h"
@@ -144,22 +145,44 @@ static const uint32_t gen12_media_kernel[][4] = {
 #define MEDIA_CURBE_SIZE 2
 #define GEN7_VFE_STATE_MEDIA_MODE 0
 
+/* A media object and state flush for each 16x16 block of a rectangle */
+#define MEDIA_OBJECT_CMD_SIZE 40
+/* A state flush and curbe load where the color changes */
+#define MEDIA_RECT_CMD_SIZE 24
+
+static uint32_t
+media_fill_rects_batch_size(const struct igt_fill_rect *rects,
+			    unsigned int count, uint32_t *state_split)
+{
+	size_t cmd_size = 0;
+
+	igt_assert(count);
+
+	for (unsigned int i = 0; i < count; i++)
+		cmd_size += (size_t)(rects[i].width / 16) *
+			    (rects[i].height / 16) * MEDIA_OBJECT_CMD_SIZE +
+			    MEDIA_RECT_CMD_SIZE;
+
+	return gen7_fill_rects_batch_size(count, cmd_size, state_split);
+}
+
 void
-gen7_media_fillfunc(int i915,
-		    struct intel_buf *buf,
-		    unsigned int x, unsigned int y,
-		    unsigned int width, unsigned int height,
-		    uint8_t color)
+gen7_media_fillfunc_rects(int i915,
+			  struct intel_buf *buf,
+			  const struct igt_fill_rect *rects,
+			  unsigned int count)
 {
 	struct intel_bb *ibb;
-	uint32_t curbe_buffer, interface_descriptor;
+	uint32_t *curbe_buffers, interface_descriptor;
+	uint32_t size, state_split;
 
-	ibb = intel_bb_create(i915, PAGE_SIZE);
+	size = media_fill_rects_batch_size(rects, count, &state_split);
+	ibb = intel_bb_create(i915, size);
 	intel_bb_add_intel_buf(ibb, buf, true);
 
-	intel_bb_ptr_set(ibb, BATCH_STATE_SPLIT);
+	intel_bb_ptr_set(ibb, state_split);
 
-	curbe_buffer = gen7_fill_curbe_buffer_data(ibb, color);
+	curbe_buffers = gen7_fill_rects_curbe_data(ibb, rects, count);
 	interface_descriptor = gen7_fill_interface_descriptor(ibb, buf,
 					gen7_media_kernel,
 					sizeof(gen7_media_kernel));
@@ -172,11 +195,8 @@ gen7_media_fillfunc(int i915,
 	gen7_emit_vfe_state(ibb, THREADS, MEDIA_URB_ENTRIES, MEDIA_URB_SIZE,
 			    MEDIA_CURBE_SIZE, GEN7_VFE_STATE_MEDIA_MODE);
 
-	gen7_emit_curbe_load(ibb, curbe_buffer);
-
-	gen7_emit_interface_descriptor_load(ibb, interface_descriptor);
-
-	gen7_emit_media_objects(ibb, x, y, width, height);
+	gen7_emit_fill_rects(ibb, rects, count, curbe_buffers,
+			     interface_descriptor, gen7_emit_media_objects);
 
 	intel_bb_out(ibb, MI_BATCH_BUFFER_END);
 	intel_bb_ptr_align(ibb, 32);
@@ -185,24 +205,38 @@ gen7_media_fillfunc(int i915,
 		      I915_EXEC_DEFAULT | I915_EXEC_NO_RELOC, true);
 
 	intel_bb_destroy(ibb);
+	free(curbe_buffers);
 }
 
 void
-gen8_media_fillfunc(int i915,
+gen7_media_fillfunc(int i915,
 		    struct intel_buf *buf,
 		    unsigned int x, unsigned int y,
 		    unsigned int width, unsigned int height,
 		    uint8_t color)
+{
+	const struct igt_fill_rect rect = { x, y, width, height, color };
+
+	gen7_media_fillfunc_rects(i915, buf, &rect, 1);
+}
+
+void
+gen8_media_fillfunc_rects(int i915,
+			  struct intel_buf *buf,
+			  const struct igt_fill_rect *rects,
+			  unsigned int count)
 {
 	struct intel_bb *ibb;
-	uint32_t curbe_buffer, interface_descriptor;
+	uint32_t *curbe_buffers, interface_descriptor;
+	uint32_t size, state_split;
 
-	ibb = intel_bb_create(i915, PAGE_SIZE);
+	size = media_fill_rects_batch_size(rects, count, &state_split);
+	ibb = intel_bb_create(i915, size);
 	intel_bb_add_intel_buf(ibb, buf, true);
 
-	intel_bb_ptr_set(ibb, BATCH_STATE_SPLIT);
+	intel_bb_ptr_set(ibb, state_split);
 
-	curbe_buffer = gen7_fill_curbe_buffer_data(ibb, color);
+	curbe_buffers = gen7_fill_rects_curbe_data(ibb, rects, count);
 	interface_descriptor = gen8_fill_interface_descriptor(ibb, buf,
 					gen8_media_kernel,
 					sizeof(gen8_media_kernel));
@@ -215,11 +249,8 @@ gen8_media_fillfunc(int i915,
 	gen8_emit_vfe_state(ibb, THREADS, MEDIA_URB_ENTRIES, MEDIA_URB_SIZE,
 			    MEDIA_CURBE_SIZE);
 
-	gen7_emit_curbe_load(ibb, curbe_buffer);
-
-	gen7_emit_interface_descriptor_load(ibb, interface_descriptor);
-
-	gen7_emit_media_objects(ibb, x, y, width, height);
+	gen7_emit_fill_rects(ibb, rects, count, curbe_buffers,
+			     interface_descriptor, gen7_emit_media_objects);
 
 	intel_bb_out(ibb, MI_BATCH_BUFFER_END);
 	intel_bb_ptr_align(ibb, 32);
@@ -228,26 +259,40 @@ gen8_media_fillfunc(int i915,
 		      I915_EXEC_DEFAULT | I915_EXEC_NO_RELOC, true);
 
 	intel_bb_destroy(ibb);
+	free(curbe_buffers);
+}
+
+void
+gen8_media_fillfunc(int i915,
+		    struct intel_buf *buf,
+		    unsigned int x, unsigned int y,
+		    unsigned int width, unsigned int height,
+		    uint8_t color)
+{
+	const struct igt_fill_rect rect = { x, y, width, height, color };
+
+	gen8_media_fillfunc_rects(i915, buf, &rect, 1);
 }
 
 static void
-__gen9_media_fillfunc(int i915,
-		      struct intel_buf *buf,
-		      unsigned int x, unsigned int y,
-		      unsigned int width, unsigned int height,
-		      uint8_t color,
-		      const uint32_t kernel[][4], size_t kernel_size)
+__gen9_media_fillfunc_rects(int i915,
+			    struct intel_buf *buf,
+			    const struct igt_fill_rect *rects,
+			    unsigned int count,
+			    const uint32_t kernel[][4], size_t kernel_size)
 {
 	struct intel_bb *ibb;
-	uint32_t curbe_buffer, interface_descriptor;
+	uint32_t *curbe_buffers, interface_descriptor;
+	uint32_t size, state_split;
 
-	ibb = intel_bb_create(i915, PAGE_SIZE);
+	size = media_fill_rects_batch_size(rects, count, &state_split);
+	ibb = intel_bb_create(i915, size);
 	intel_bb_add_intel_buf(ibb, buf, true);
 
 	/* setup states */
-	intel_bb_ptr_set(ibb, BATCH_STATE_SPLIT);
+	intel_bb_ptr_set(ibb, state_split);
 
-	curbe_buffer = gen7_fill_curbe_buffer_data(ibb, color);
+	curbe_buffers = gen7_fill_rects_curbe_data(ibb, rects, count);
 	interface_descriptor = gen8_fill_interface_descriptor(ibb, buf,
 							      kernel,
 							      kernel_size);
@@ -265,11 +310,8 @@ __gen9_media_fillfunc(int i915,
 	gen8_emit_vfe_state(ibb, THREADS, MEDIA_URB_ENTRIES, MEDIA_URB_SIZE,
 			    MEDIA_CURBE_SIZE);
 
-	gen7_emit_curbe_load(ibb, curbe_buffer);
-
-	gen7_emit_interface_descriptor_load(ibb, interface_descriptor);
-
-	gen7_emit_media_objects(ibb, x, y, width, height);
+	gen7_emit_fill_rects(ibb, rects, count, curbe_buffers,
+			     interface_descriptor, gen7_emit_media_objects);
 
 	intel_bb_out(ibb, GEN8_PIPELINE_SELECT | PIPELINE_SELECT_MEDIA |
 		     GEN9_FORCE_MEDIA_AWAKE_DISABLE |
@@ -285,6 +327,18 @@ __gen9_media_fillfunc(int i915,
 		      I915_EXEC_RENDER | I915_EXEC_NO_RELOC, true);
 
 	intel_bb_destroy(ibb);
+	free(curbe_buffers);
+}
+
+void
+gen9_media_fillfunc_rects(int i915,
+			  struct intel_buf *buf,
+			  const struct igt_fill_rect *rects,
+			  unsigned int count)
+{
+	__gen9_media_fillfunc_rects(i915, buf, rects, count,
+				    gen8_media_kernel,
+				    sizeof(gen8_media_kernel));
 }
 
 void
@@ -294,8 +348,9 @@ gen9_media_fillfunc(int i915,
 		    unsigned int width, unsigned int height,
 		    uint8_t color)
 {
-	__gen9_media_fillfunc(i915, buf, x, y, width, height, color,
-			      gen8_media_kernel, sizeof(gen8_media_kernel));
+	const struct igt_fill_rect rect = { x, y, width, height, color };
+
+	gen9_media_fillfunc_rects(i915, buf, &rect, 1);
 }
 
 static void
@@ -371,6 +426,17 @@ gen11_media_vme_func(int i915,
 			       sizeof(gen11_media_vme_kernel));
 }
 
+void
+gen12_media_fillfunc_rects(int i915,
+			   struct intel_buf *buf,
+			   const struct igt_fill_rect *rects,
+			   unsigned int count)
+{
+	__gen9_media_fillfunc_rects(i915, buf, rects, count,
+				    gen12_media_kernel,
+				    sizeof(gen12_media_kernel));
+}
+
 void
 gen12_media_fillfunc(int i915,
 		     struct intel_buf *buf,
@@ -378,6 +444,7 @@ gen12_media_fillfunc(int i915,
 		     unsigned int width, unsigned int height,
 		     uint8_t color)
 {
-	__gen9_media_fillfunc(i915, buf, x, y, width, height, color,
-			      gen12_media_kernel, sizeof(gen12_media_kernel));
+	const struct igt_fill_rect rect = { x, y, width, height, color };
+
+	gen12_media_fillfunc_rects(i915, buf, &rect, 1);
 }
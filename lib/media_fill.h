@@ -28,6 +28,14 @@
 #include <stdint.h>
 #include "intel_bufops.h"
 
+struct igt_fill_rect;
+
+void
+gen7_media_fillfunc_rects(int i915,
+			  struct intel_buf *buf,
+			  const struct igt_fill_rect *rects,
+			  unsigned int count);
+
 void
 gen7_media_fillfunc(int i915,
 		    struct intel_buf *buf,
@@ -35,6 +43,12 @@ gen7_media_fillfunc(int i915,
 		    unsigned int width, unsigned int height,
 		    uint8_t color);
 
+void
+gen8_media_fillfunc_rects(int i915,
+			  struct intel_buf *buf,
+			  const struct igt_fill_rect *rects,
+			  unsigned int count);
+
 void
 gen8_media_fillfunc(int i915,
 		    struct intel_buf *buf,
@@ -42,6 +56,12 @@ gen8_media_fillfunc(int i915,
 		    unsigned int width, unsigned int height,
 		    uint8_t color);
 
+void
+gen9_media_fillfunc_rects(int i915,
+			  struct intel_buf *buf,
+			  const struct igt_fill_rect *rects,
+			  unsigned int count);
+
 void
 gen9_media_fillfunc(int i915,
 		    struct intel_buf *buf,
@@ -56,6 +76,12 @@ gen11_media_vme_func(int i915,
 		     unsigned int width, unsigned int height,
 		     struct intel_buf *dst);
 
+void
+gen12_media_fillfunc_rects(int i915,
+			   struct intel_buf *buf,
+			   const struct igt_fill_rect *rects,
+			   unsigned int count);
+
 void
 gen12_media_fillfunc(int i915,
 		     struct intel_buf *buf,
@@ -83,3 +83,5 @@ void gen2_render_copyfunc(struct intel_bb *ibb,
 			  struct intel_buf *src, uint32_t src_x, uint32_t src_y,
 			  uint32_t width, uint32_t height,
 			  struct intel_buf *dst, uint32_t dst_x, uint32_t dst_y);
+
+void gen9_render_state_destroy(struct intel_bb *ibb);
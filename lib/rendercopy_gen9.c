@@ -15,6 +15,9 @@
 #include <i915_drm.h>
 
 #include "drmtest.h"
+#include "i915/gem_create.h"
+#include "i915/gem_mman.h"
+#include "ioctl_wrappers.h"
 #include "intel_aux_pgtable.h"
 #include "intel_bufops.h"
 #include "intel_batchbuffer.h"
@@ -26,6 +29,8 @@
 #include "intel_reg.h"
 #include "igt_aux.h"
 #include "intel_chipset.h"
+#include "xe/xe_ioctl.h"
+#include "xe/xe_query.h"
 
 #define VERTEX_SIZE (3*4)
 
@@ -200,7 +205,8 @@ gen9_bind_buf(struct intel_bb *ibb, const struct intel_buf *buf, int is_dst,
 	ss = intel_bb_ptr_align(ibb, 64);
 
 	ss->ss0.surface_type = SURFACE_2D;
-	ss->ss0.surface_format = gen4_surface_format(buf->bpp, buf->depth);
+	ss->ss0.surface_format = buf->surface_format ?:
+				 gen4_surface_format(buf->bpp, buf->depth);
 	ss->ss0.vertical_alignment = 1; /* align 4 */
 	ss->ss0.horizontal_alignment = 1; /* align 4 or HALIGN_32 on display ver >= 13*/
 
@@ -676,7 +682,8 @@ gen7_emit_push_constants(struct intel_bb *ibb) {
 }
 
 static void
-gen9_emit_state_base_address(struct intel_bb *ibb) {
+gen9_emit_state_base_address(struct intel_bb *ibb, uint32_t state_handle,
+			     uint64_t state_offset) {
 
 	/* WaBindlessSurfaceStateModifyEnable:skl,bxt */
 	/* The length has to be one less if we dont modify
@@ -699,18 +706,18 @@ gen9_emit_state_base_address(struct intel_bb *ibb) {
 			    BASE_ADDRESS_MODIFY, ibb->batch_offset);
 
 	/* dynamic */
-	intel_bb_emit_reloc(ibb, ibb->handle,
+	intel_bb_emit_reloc(ibb, state_handle,
 			    I915_GEM_DOMAIN_RENDER | I915_GEM_DOMAIN_INSTRUCTION, 0,
-			    BASE_ADDRESS_MODIFY, ibb->batch_offset);
+			    BASE_ADDRESS_MODIFY, state_offset);
 
 	/* indirect */
 	intel_bb_out(ibb, 0);
 	intel_bb_out(ibb, 0);
 
 	/* instruction */
-	intel_bb_emit_reloc(ibb, ibb->handle,
+	intel_bb_emit_reloc(ibb, state_handle,
 			    I915_GEM_DOMAIN_INSTRUCTION, 0,
-			    BASE_ADDRESS_MODIFY, ibb->batch_offset);
+			    BASE_ADDRESS_MODIFY, state_offset);
 
 	/* general state buffer size */
 	intel_bb_out(ibb, 0xfffff000 | 1);
@@ -1182,6 +1189,119 @@ static void gen12_emit_pxp_state(struct intel_bb *ibb, bool enable,
 
 #define BATCH_STATE_SPLIT 2048
 
+/*
+ * With intel_bb_set_render_state_cache() the state which doesn't depend on
+ * the copy, that is the kernel, the sampler and the color calculator, blend,
+ * viewport and scissor states, lives in a bo of its own. It is built once per
+ * intel_bb and kernel, at the same offsets it would have in the batch, and
+ * the dynamic and instruction state base addresses point to it. Only the
+ * surface states, the vertices and the commands go to each batch.
+ */
+#define RENDER_STATE_SIZE 4096
+
+struct gen9_render_state {
+	uint32_t handle;
+	uint64_t offset;
+
+	const void *ps_kernel;
+	uint32_t ps_kernel_off;
+	uint32_t ps_sampler_state;
+	uint32_t cc_state;
+	uint32_t blend_state;
+	uint32_t cc_viewport;
+	uint32_t sf_clip_viewport;
+	uint32_t scissor_state;
+};
+
+static void gen9_render_state_upload(struct intel_bb *ibb,
+				     struct gen9_render_state *state,
+				     uint32_t end)
+{
+	uint8_t *batch = (uint8_t *)ibb->batch;
+	uint8_t *map;
+
+	igt_assert(end <= RENDER_STATE_SIZE);
+
+	if (ibb->driver == INTEL_DRIVER_I915) {
+		gem_write(ibb->fd, state->handle, BATCH_STATE_SPLIT,
+			  batch + BATCH_STATE_SPLIT, end - BATCH_STATE_SPLIT);
+	} else {
+		map = xe_bo_map(ibb->fd, state->handle, RENDER_STATE_SIZE);
+		memcpy(map + BATCH_STATE_SPLIT, batch + BATCH_STATE_SPLIT,
+		       end - BATCH_STATE_SPLIT);
+		gem_munmap(map, RENDER_STATE_SIZE);
+	}
+
+	/* The per copy state is built over it and expects zeroed memory */
+	memset(batch + BATCH_STATE_SPLIT, 0, end - BATCH_STATE_SPLIT);
+}
+
+static struct gen9_render_state *
+gen9_render_state_get(struct intel_bb *ibb, const uint32_t ps_kernel[][4],
+		      uint32_t ps_kernel_size)
+{
+	struct gen9_render_state *state = ibb->render_state;
+	struct drm_i915_gem_exec_object2 *obj;
+
+	if (!state) {
+		state = calloc(1, sizeof(*state));
+		igt_assert(state);
+
+		if (ibb->driver == INTEL_DRIVER_I915)
+			state->handle = gem_create(ibb->fd, RENDER_STATE_SIZE);
+		else
+			state->handle = xe_bo_create(ibb->fd, 0, RENDER_STATE_SIZE,
+						     vram_if_possible(ibb->fd, 0),
+						     DRM_XE_GEM_CREATE_FLAG_NEEDS_VISIBLE_VRAM);
+		state->offset = INTEL_BUF_INVALID_ADDRESS;
+		ibb->render_state = state;
+	}
+
+	if (state->ps_kernel != ps_kernel) {
+		/* Copies with the previous kernel may still read the state */
+		if (state->ps_kernel)
+			intel_bb_sync(ibb);
+
+		intel_bb_ptr_set(ibb, BATCH_STATE_SPLIT);
+		state->ps_sampler_state = gen8_create_sampler(ibb);
+		state->ps_kernel_off = gen8_fill_ps(ibb, ps_kernel, ps_kernel_size);
+		state->cc_state = gen6_create_cc_state(ibb);
+		state->blend_state = gen8_create_blend_state(ibb);
+		state->cc_viewport = gen6_create_cc_viewport(ibb);
+		state->sf_clip_viewport = gen7_create_sf_clip_viewport(ibb);
+		state->scissor_state = gen6_create_scissor_rect(ibb);
+		gen9_render_state_upload(ibb, state, intel_bb_offset(ibb));
+		state->ps_kernel = ps_kernel;
+	}
+
+	obj = intel_bb_add_object(ibb, state->handle, RENDER_STATE_SIZE,
+				  state->offset, 0, false);
+	state->offset = obj->offset;
+
+	return state;
+}
+
+/**
+ * gen9_render_state_destroy:
+ * @ibb: pointer to intel_bb
+ *
+ * Releases the static render state kept by @ibb, if any. Called on
+ * intel_bb_destroy(), after the bb objects are gone.
+ */
+void gen9_render_state_destroy(struct intel_bb *ibb)
+{
+	struct gen9_render_state *state = ibb->render_state;
+
+	if (!state)
+		return;
+
+	if (ibb->allocator_type != INTEL_ALLOCATOR_NONE)
+		intel_allocator_free(ibb->allocator_handle, state->handle);
+	gem_close(ibb->fd, state->handle);
+	free(state);
+	ibb->render_state = NULL;
+}
+
 static
 void _gen9_render_op(struct intel_bb *ibb,
 		     struct intel_buf *src,
@@ -1200,6 +1320,9 @@ void _gen9_render_op(struct intel_bb *ibb,
 	uint32_t aux_pgtable_state;
 	bool fast_clear = !src;
 	uint32_t pxp_scratch_offset;
+	struct gen9_render_state *state = NULL;
+	uint32_t state_handle = ibb->handle;
+	uint64_t state_offset = ibb->batch_offset;
 
 	if (!fast_clear)
 		igt_assert(src->bpp == dst->bpp);
@@ -1211,19 +1334,38 @@ void _gen9_render_op(struct intel_bb *ibb,
 	if (!fast_clear)
 		intel_bb_add_intel_buf(ibb, src, false);
 
+	if (ibb->render_state_cache) {
+		state = gen9_render_state_get(ibb, ps_kernel, ps_kernel_size);
+		state_handle = state->handle;
+		state_offset = state->offset;
+	}
+
 	intel_bb_ptr_set(ibb, BATCH_STATE_SPLIT);
 
 	ps_binding_table  = gen8_bind_surfaces(ibb, src, dst);
-	ps_sampler_state  = gen8_create_sampler(ibb);
-	ps_kernel_off = gen8_fill_ps(ibb, ps_kernel, ps_kernel_size);
-	vertex_buffer = gen7_fill_vertex_buffer_data(ibb, src, src_x, src_y,
-						     dst, dst_x, dst_y,
-						     width, height);
-	cc.cc_state = gen6_create_cc_state(ibb);
-	cc.blend_state = gen8_create_blend_state(ibb);
-	viewport.cc_state = gen6_create_cc_viewport(ibb);
-	viewport.sf_clip_state = gen7_create_sf_clip_viewport(ibb);
-	scissor_state = gen6_create_scissor_rect(ibb);
+	if (state) {
+		ps_sampler_state = state->ps_sampler_state;
+		ps_kernel_off = state->ps_kernel_off;
+		vertex_buffer = gen7_fill_vertex_buffer_data(ibb, src, src_x, src_y,
+							     dst, dst_x, dst_y,
+							     width, height);
+		cc.cc_state = state->cc_state;
+		cc.blend_state = state->blend_state;
+		viewport.cc_state = state->cc_viewport;
+		viewport.sf_clip_state = state->sf_clip_viewport;
+		scissor_state = state->scissor_state;
+	} else {
+		ps_sampler_state  = gen8_create_sampler(ibb);
+		ps_kernel_off = gen8_fill_ps(ibb, ps_kernel, ps_kernel_size);
+		vertex_buffer = gen7_fill_vertex_buffer_data(ibb, src, src_x, src_y,
+							     dst, dst_x, dst_y,
+							     width, height);
+		cc.cc_state = gen6_create_cc_state(ibb);
+		cc.blend_state = gen8_create_blend_state(ibb);
+		viewport.cc_state = gen6_create_cc_viewport(ibb);
+		viewport.sf_clip_state = gen7_create_sf_clip_viewport(ibb);
+		scissor_state = gen6_create_scissor_rect(ibb);
+	}
 	aux_pgtable_state = gen12_create_aux_pgtable_state(ibb, aux_pgtable_buf);
 
 	/* TODO: there is other state which isn't setup */
@@ -1264,7 +1406,7 @@ void _gen9_render_op(struct intel_bb *ibb,
 
 	gen7_emit_push_constants(ibb);
 
-	gen9_emit_state_base_address(ibb);
+	gen9_emit_state_base_address(ibb, state_handle, state_offset);
 
 	if (HAS_4TILE(ibb->devid) || intel_gen(ibb->devid) > 12) {
 		intel_bb_out(ibb, GEN4_3DSTATE_BINDING_TABLE_POOL_ALLOC | 2);
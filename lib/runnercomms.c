@@ -4,12 +4,14 @@
  */
 
 #include <assert.h>
+#include <errno.h>
 #include <signal.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "igt_aux.h"
@@ -27,6 +29,8 @@
  */
 
 static sig_atomic_t runner_socket_fd = -1;
+static struct runnerring *runner_ring;
+static int runner_ring_eventfd = -1;
 
 /**
  * set_runner_socket:
@@ -76,11 +80,432 @@ bool runner_connected(void)
  */
 void send_to_runner(struct runnerpacket *packet)
 {
-	if (runner_connected())
-		write(runner_socket_fd, packet, packet->size);
+	if (!runner_connected())
+		goto out;
+
+	if (runner_ring) {
+		if (runnerring_write(runner_ring, runner_ring_eventfd, packet,
+				     true))
+			goto out;
+
+		/* Don't wait for a stuck ring on every packet that follows */
+		if (errno == ETIMEDOUT)
+			runner_ring = NULL;
+	}
+
+	write(runner_socket_fd, packet, packet->size);
+out:
 	free(packet);
 }
 
+static size_t ring_record_size(uint32_t packetsize)
+{
+	/* Keeps every header 4-aligned, so it never wraps around */
+	return (sizeof(uint32_t) + packetsize + 3) & ~(size_t)3;
+}
+
+static size_t ring_size(const struct runnerring *ring)
+{
+	return sizeof(*ring) + ring->size;
+}
+
+/* Copy to and from the ring data at a free-running offset, wrapping as needed */
+static void ring_copy_in(struct runnerring *ring, uint32_t offset,
+			 const void *src, size_t len)
+{
+	uint32_t start = offset & (ring->size - 1);
+	size_t first = min_t(size_t, len, ring->size - start);
+
+	memcpy(ring->data + start, src, first);
+	memcpy(ring->data, (const char *)src + first, len - first);
+}
+
+static void ring_copy_out(const struct runnerring *ring, uint32_t offset,
+			  void *dst, size_t len)
+{
+	uint32_t start = offset & (ring->size - 1);
+	size_t first = min_t(size_t, len, ring->size - start);
+
+	memcpy(dst, ring->data + start, first);
+	memcpy((char *)dst + first, ring->data, len - first);
+}
+
+static void ring_clear(struct runnerring *ring, uint32_t offset, size_t len)
+{
+	uint32_t start = offset & (ring->size - 1);
+	size_t first = min_t(size_t, len, ring->size - start);
+
+	memset(ring->data + start, 0, first);
+	memset(ring->data, 0, len - first);
+}
+
+static void ring_notify(int eventfd)
+{
+	uint64_t one = 1;
+
+	if (eventfd >= 0)
+		write(eventfd, &one, sizeof(one));
+}
+
+static uint64_t ring_now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000ull + ts.tv_nsec / 1000;
+}
+
+/* Kicks the reader and backs off, false once waited for too long */
+static bool ring_wait(int eventfd, uint64_t *deadline)
+{
+	uint64_t now = ring_now_us();
+
+	if (!*deadline) {
+		*deadline = now + RUNNERRING_WAIT_TIMEOUT_US;
+	} else if (now >= *deadline) {
+		errno = ETIMEDOUT;
+		return false;
+	}
+
+	ring_notify(eventfd);
+	usleep(100);
+	return true;
+}
+
+/**
+ * runnerring_create:
+ * @size: size of the packet area in octets, a power of two
+ * @memfd: return location for the memfd backing the ring
+ *
+ * Creates a runnerring for igt_runner to read. The memfd is to be
+ * passed to the test, which maps it with set_runner_ring().
+ *
+ * Returns: The mapped ring, or NULL on failure.
+ */
+struct runnerring *runnerring_create(uint32_t size, int *memfd)
+{
+	struct runnerring *ring;
+	int fd;
+
+	assert(size && !(size & (size - 1)));
+
+	fd = memfd_create("igt_runner_ring", 0);
+	if (fd < 0)
+		return NULL;
+
+	if (ftruncate(fd, sizeof(*ring) + size)) {
+		close(fd);
+		return NULL;
+	}
+
+	ring = mmap(NULL, sizeof(*ring) + size, PROT_READ | PROT_WRITE,
+		    MAP_SHARED, fd, 0);
+	if (ring == MAP_FAILED) {
+		close(fd);
+		return NULL;
+	}
+
+	ring->size = size;
+	ring->head = ring->tail = 0;
+	ring->waiting = 0;
+	ring->stall_tail = 0;
+	ring->stall_since = 0;
+	__atomic_store_n(&ring->magic, RUNNERRING_MAGIC, __ATOMIC_RELEASE);
+
+	*memfd = fd;
+	return ring;
+}
+
+/**
+ * runnerring_destroy:
+ * @ring: ring to unmap
+ *
+ * Unmaps a ring mapped with runnerring_create().
+ */
+void runnerring_destroy(struct runnerring *ring)
+{
+	if (ring)
+		munmap(ring, ring_size(ring));
+}
+
+/**
+ * runnerring_write:
+ * @ring: ring to write to
+ * @eventfd: eventfd to notify the reader with, or -1
+ * @packet: packet to write
+ * @wait: whether to wait for the reader to make space
+ *
+ * Writes @packet to @ring. The reader is only notified through
+ * @eventfd if it has said it's waiting, so a burst of packets costs a
+ * single syscall at most. Packets too large for the ring are left to
+ * the caller to send some other way, after the ring has been drained
+ * to keep the ordering intact. Waiting for the reader gives up after
+ * RUNNERRING_WAIT_TIMEOUT_US.
+ *
+ * Returns: true if the packet was written, false otherwise with errno
+ * set to EMSGSIZE for packets too large, ENOSPC if the ring is full
+ * and @wait is false, or ETIMEDOUT if waiting for the reader timed out
+ * or the reader skipped the packet as stalled.
+ */
+bool runnerring_write(struct runnerring *ring, int eventfd,
+		      const struct runnerpacket *packet, bool wait)
+{
+	size_t len = ring_record_size(packet->size);
+	uint32_t head, tail, header, *hdr;
+	uint64_t deadline = 0;
+
+	/* The ring is for the chatty small packets, big ones take the socket */
+	if (len > ring->size / 4) {
+		while (wait && __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) !=
+		       __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE)) {
+			if (!ring_wait(eventfd, &deadline))
+				return false;
+		}
+
+		errno = EMSGSIZE;
+		return false;
+	}
+
+	head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+	while (true) {
+		tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+		if (head - tail + len <= ring->size) {
+			if (__atomic_compare_exchange_n(&ring->head, &head, head + len,
+							true, __ATOMIC_ACQ_REL,
+							__ATOMIC_RELAXED))
+				break;
+
+			continue;
+		}
+
+		if (!wait) {
+			errno = ENOSPC;
+			return false;
+		}
+
+		if (!ring_wait(eventfd, &deadline))
+			return false;
+
+		head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+	}
+
+	/* Lets the reader skip the record should we never commit it */
+	hdr = (uint32_t *)(ring->data + (head & (ring->size - 1)));
+	__atomic_store_n(hdr, packet->size, __ATOMIC_RELEASE);
+
+	ring_copy_in(ring, head + sizeof(header), packet, packet->size);
+
+	header = packet->size;
+	if (!__atomic_compare_exchange_n(hdr, &header,
+					 packet->size | RUNNERRING_COMMITTED,
+					 false, __ATOMIC_SEQ_CST,
+					 __ATOMIC_RELAXED)) {
+		/* Too late, the reader gave up on us */
+		errno = ETIMEDOUT;
+		return false;
+	}
+
+	if (__atomic_exchange_n(&ring->waiting, 0, __ATOMIC_SEQ_CST))
+		ring_notify(eventfd);
+
+	return true;
+}
+
+static void ring_discard(struct runnerring *ring)
+{
+	uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+	memset(ring->data, 0, ring->size);
+	__atomic_store_n(&ring->tail, head, __ATOMIC_RELEASE);
+}
+
+/*
+ * The oldest record is reserved but not committed. A writer that died
+ * or is stuck before committing would block the ring for good, so the
+ * record is skipped once it has stayed like this for long enough.
+ */
+static ssize_t ring_skip_stalled(struct runnerring *ring, uint32_t tail,
+				 uint32_t *hdr, uint32_t header)
+{
+	uint64_t now = ring_now_us();
+
+	if (tail == __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE))
+		return 0;
+
+	if (ring->stall_tail != tail || !ring->stall_since) {
+		ring->stall_tail = tail;
+		ring->stall_since = now;
+		return 0;
+	}
+
+	if (now - ring->stall_since < RUNNERRING_STALL_TIMEOUT_US)
+		return 0;
+
+	ring->stall_since = 0;
+
+	/* Died before even writing the size, nothing to go by */
+	if (!header) {
+		ring_discard(ring);
+		errno = EPIPE;
+		return -1;
+	}
+
+	/* Makes the commit fail, should the writer ever get to it */
+	if (!__atomic_compare_exchange_n(hdr, &header, 0, false,
+					 __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+		return 0;
+
+	if (header < sizeof(struct runnerpacket) ||
+	    ring_record_size(header) > ring->size / 4) {
+		ring_discard(ring);
+		errno = EINVAL;
+		return -1;
+	}
+
+	ring_clear(ring, tail, ring_record_size(header));
+	__atomic_store_n(&ring->tail, tail + ring_record_size(header),
+			 __ATOMIC_RELEASE);
+	errno = EPIPE;
+	return -1;
+}
+
+/**
+ * runnerring_read:
+ * @ring: ring to read from
+ * @buf: buffer to copy the packet to
+ * @bufsize: size of @buf
+ *
+ * Reads the oldest committed packet from @ring into @buf. When the
+ * ring is empty, the writers are asked to notify the reader through
+ * the eventfd on their next packet. A packet left uncommitted for
+ * RUNNERRING_STALL_TIMEOUT_US is skipped, for the next call to read
+ * the ones after it.
+ *
+ * Returns: Size of the packet read, 0 if the ring is empty, or -1 if
+ * the ring contents were invalid and have been discarded, with errno
+ * set to EINVAL, or a stalled packet was skipped, with errno set to
+ * EPIPE.
+ */
+ssize_t runnerring_read(struct runnerring *ring, void *buf, size_t bufsize)
+{
+	uint32_t tail = ring->tail;
+	uint32_t *hdr = (uint32_t *)(ring->data + (tail & (ring->size - 1)));
+	uint32_t header, size;
+
+	header = __atomic_load_n(hdr, __ATOMIC_SEQ_CST);
+	if (!(header & RUNNERRING_COMMITTED)) {
+		__atomic_store_n(&ring->waiting, 1, __ATOMIC_SEQ_CST);
+
+		header = __atomic_load_n(hdr, __ATOMIC_SEQ_CST);
+		if (!(header & RUNNERRING_COMMITTED))
+			return ring_skip_stalled(ring, tail, hdr, header);
+
+		__atomic_store_n(&ring->waiting, 0, __ATOMIC_RELAXED);
+	}
+
+	size = header & ~RUNNERRING_COMMITTED;
+	if (size < sizeof(struct runnerpacket) || size > bufsize ||
+	    ring_record_size(size) > ring->size / 4) {
+		ring_discard(ring);
+		errno = EINVAL;
+		return -1;
+	}
+
+	ring_copy_out(ring, tail + sizeof(header), buf, size);
+
+	/*
+	 * Writers only write the header of a record once it's
+	 * complete, anything else in the space being handed back
+	 * must not be mistaken for one later.
+	 */
+	ring_clear(ring, tail, ring_record_size(size));
+	__atomic_store_n(&ring->tail, tail + ring_record_size(size),
+			 __ATOMIC_RELEASE);
+
+	return size;
+}
+
+/**
+ * set_runner_ring:
+ * @memfd: memfd backing a ring created with runnerring_create()
+ * @eventfd: eventfd to notify igt_runner with
+ *
+ * Maps the ring and makes send_to_runner() use it instead of the
+ * socket set with set_runner_socket(), which is still used for
+ * packets that don't fit in the ring.
+ */
+void set_runner_ring(int memfd, int eventfd)
+{
+	struct runnerring *ring;
+	struct stat sb;
+
+	if (fstat(memfd, &sb) || sb.st_size <= sizeof(*ring))
+		return;
+
+	ring = mmap(NULL, sb.st_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+		    memfd, 0);
+	if (ring == MAP_FAILED)
+		return;
+
+	if (__atomic_load_n(&ring->magic, __ATOMIC_ACQUIRE) != RUNNERRING_MAGIC ||
+	    ring_size(ring) != sb.st_size) {
+		munmap(ring, sb.st_size);
+		return;
+	}
+
+	runner_ring = ring;
+	runner_ring_eventfd = eventfd;
+}
+
+/**
+ * set_runner_capture:
+ * @fd: file to write the packets to
+ *
+ * Makes send_to_runner() write the packets to @fd instead of sending them
+ * to igt_runner, to be sent later with forward_runner_capture(). For
+ * output that can't be sent as it's produced, like from concurrently
+ * running dynamic subtests. Does nothing when not connected to igt_runner.
+ */
+void set_runner_capture(int fd)
+{
+	if (!runner_connected())
+		return;
+
+	/* The mapping is left for the process we were forked from */
+	runner_ring = NULL;
+	runner_ring_eventfd = -1;
+	runner_socket_fd = fd;
+}
+
+/**
+ * forward_runner_capture:
+ * @fd: file written to by another process after set_runner_capture()
+ *
+ * Sends the packets captured in @fd to igt_runner, in order.
+ */
+void forward_runner_capture(int fd)
+{
+	struct runnerpacket header, *packet;
+	off_t offset = 0;
+
+	while (pread(fd, &header, sizeof(header), offset) == sizeof(header)) {
+		if (header.size < sizeof(header))
+			break;
+
+		packet = malloc(header.size);
+		if (!packet)
+			break;
+
+		if (pread(fd, packet, header.size, offset) != header.size) {
+			free(packet);
+			break;
+		}
+		offset += header.size;
+
+		send_to_runner(packet);
+	}
+}
+
 /* If enough data left, copy the data to dst, advance p, reduce size */
 static void read_integer(void* dst, size_t bytes, const char **p, uint32_t *size)
 {
@@ -482,7 +907,11 @@ void log_to_runner_sig_safe(const char *str, size_t len)
 	memcpy(p.data, str, prlen);
 	p.size += prlen + 1;
 
-	write(runner_socket_fd, &p, p.size);
+	/* Can't wait for space here, the interrupted code may hold up the reader */
+	if (!(runner_ring &&
+	      runnerring_write(runner_ring, runner_ring_eventfd,
+			       (struct runnerpacket *)&p, false)))
+		write(runner_socket_fd, &p, p.size);
 
 	len -= prlen;
 	if (len)
@@ -9,6 +9,7 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <sys/types.h>
 
 /*
  * A flat struct that can and will be directly dumped to
@@ -110,6 +111,53 @@ void set_runner_socket(int fd);
 bool runner_connected(void);
 void send_to_runner(struct runnerpacket *packet);
 
+/*
+ * A ring of runnerpackets in memory shared between the test and
+ * igt_runner, to send packets without a syscall each. Any number of
+ * threads and forked processes of the test can write to the ring,
+ * igt_runner is the only reader.
+ *
+ * Each record in data[] is a uint32_t header followed by the packet,
+ * padded to a multiple of 4 octets. The header holds the packet size
+ * as soon as the space is reserved, with RUNNERRING_COMMITTED set once
+ * the packet is completely written. head and tail are free-running
+ * offsets, taken modulo size.
+ *
+ * A record left uncommitted for RUNNERRING_STALL_TIMEOUT_US, by a
+ * writer that died or got stuck halfway, is skipped by the reader.
+ * Writers waiting for RUNNERRING_WAIT_TIMEOUT_US for the reader give
+ * up, and send_to_runner() uses the socket from then on. Records
+ * committed behind a stalled one would be read after packets sent to
+ * the socket meanwhile, so writers wait longer than it takes the
+ * reader to skip it, and only give up on a reader that stopped
+ * reading. The reader drains the ring before each socket packet.
+ */
+struct runnerring {
+	uint32_t magic;
+	uint32_t size; /* Size of data[] in octets, a power of two */
+	uint32_t head; /* Space reserved by writers up to here */
+	uint32_t tail; /* Space consumed by the reader up to here */
+	uint32_t waiting; /* Reader wants an eventfd notification */
+	uint32_t stall_tail; /* Reader only, tail found uncommitted... */
+	uint64_t stall_since; /* ...since this CLOCK_MONOTONIC time in us */
+
+	char data[];
+};
+
+#define RUNNERRING_MAGIC 0x52554e52 /* "RUNR" */
+#define RUNNERRING_COMMITTED (1u << 31)
+#define RUNNERRING_STALL_TIMEOUT_US 5000000
+#define RUNNERRING_WAIT_TIMEOUT_US (2 * RUNNERRING_STALL_TIMEOUT_US)
+
+struct runnerring *runnerring_create(uint32_t size, int *memfd);
+void runnerring_destroy(struct runnerring *ring);
+bool runnerring_write(struct runnerring *ring, int eventfd,
+		      const struct runnerpacket *packet, bool wait);
+ssize_t runnerring_read(struct runnerring *ring, void *buf, size_t bufsize);
+void set_runner_ring(int memfd, int eventfd);
+void set_runner_capture(int fd);
+void forward_runner_capture(int fd);
+
 runnerpacket_read_helper read_runnerpacket(const struct runnerpacket *packet);
 
 /*
@@ -86,6 +86,21 @@ static bool sw_sync_fd_is_valid(int fd)
 	return status >= 0;
 }
 
+int __sw_sync_timeline_create(void)
+{
+	char buf[128];
+	int fd;
+
+	if (!kernel_sw_sync_path(buf, sizeof(buf)))
+		return -ENOENT;
+
+	fd = open(buf, O_RDWR);
+	if (fd < 0)
+		return -errno;
+
+	return fd;
+}
+
 int sw_sync_timeline_create(void)
 {
 	char buf[128];
@@ -119,7 +134,7 @@ int sw_sync_timeline_create_fence(int fd, uint32_t seqno)
 	return fence;
 }
 
-static int __sw_sync_timeline_inc(int fd, uint32_t count)
+int __sw_sync_timeline_inc(int fd, uint32_t count)
 {
 	int err;
 
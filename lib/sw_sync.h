@@ -35,7 +35,9 @@
 
 void igt_require_sw_sync(void);
 
+int __sw_sync_timeline_create(void);
 int sw_sync_timeline_create(void);
+int __sw_sync_timeline_inc(int timeline, uint32_t count);
 void sw_sync_timeline_inc(int timeline, uint32_t count);
 
 int __sw_sync_timeline_create_fence(int timeline, uint32_t seqno);
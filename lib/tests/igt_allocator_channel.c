@@ -0,0 +1,106 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2025 Intel Corporation
+ */
+
+#include <pthread.h>
+#include <time.h>
+
+#include "igt_core.h"
+#include "intel_allocator_msgchannel.h"
+
+#define REQUESTS_PER_CHILD 2000
+#define MAX_CHILDREN 64
+
+static struct msg_channel *channel;
+
+/* Trivial allocator thread replacement answering every request */
+static void *server(void *data)
+{
+	struct alloc_req req;
+	struct alloc_resp resp = {};
+
+	while (channel->recv_req(channel, &req) > 0) {
+		if (req.request_type == REQ_STOP)
+			break;
+
+		resp.response_type = RESP_ALLOC;
+		resp.tid = req.tid;
+		resp.alloc.offset = req.alloc.size * 2;
+		igt_assert_eq(channel->send_resp(channel, &resp), 0);
+	}
+
+	return NULL;
+}
+
+static void child_requests(void)
+{
+	pid_t tid = gettid();
+
+	for (int i = 0; i < REQUESTS_PER_CHILD; i++) {
+		struct alloc_req req = {
+			.request_type = REQ_ALLOC,
+			.tid = tid,
+			.alloc.size = tid + i,
+		};
+		struct alloc_resp resp = {
+			.tid = tid,
+		};
+
+		igt_assert_eq(channel->send_req(channel, &req), 0);
+		igt_assert(channel->recv_resp(channel, &resp) > 0);
+		igt_assert_eq(resp.tid, tid);
+		igt_assert_eq_u64(resp.alloc.offset, (uint64_t)(tid + i) * 2);
+	}
+}
+
+static double elapsed(const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (now.tv_sec - start->tv_sec) +
+	       (now.tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+static void throughput(enum msg_channel_type type)
+{
+	struct alloc_req stop = { .request_type = REQ_STOP };
+
+	channel = intel_allocator_get_msgchannel(type);
+
+	for (int children = 1; children <= MAX_CHILDREN; children *= 2) {
+		struct timespec start;
+		pthread_t thread;
+		double t;
+
+		channel->init(channel);
+		pthread_create(&thread, NULL, server, NULL);
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		igt_fork(child, children)
+			child_requests();
+		igt_waitchildren();
+		t = elapsed(&start);
+
+		igt_assert_eq(channel->send_req(channel, &stop), 0);
+		pthread_join(thread, NULL);
+		channel->deinit(channel);
+
+		igt_info("%2d processes: %.0f requests/s\n", children,
+			 children * REQUESTS_PER_CHILD / t);
+	}
+}
+
+igt_main
+{
+	igt_subtest("shm-ring")
+		throughput(CHANNEL_SHM_RING);
+
+	igt_subtest("msgqueue") {
+		/* Resizing the queue needs CAP_SYS_RESOURCE */
+		igt_require(geteuid() == 0);
+		throughput(CHANNEL_SYSVIPC_MSGQUEUE);
+	}
+}
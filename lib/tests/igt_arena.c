@@ -0,0 +1,85 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2024 Intel Corporation
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "igt_arena.h"
+#include "igt_core.h"
+
+IGT_TEST_DESCRIPTION("Exercise the subtest lifetime arena allocator");
+
+#define NUM_STRINGS 8192
+
+static char *strings[NUM_STRINGS];
+
+static void fill_strings(int count)
+{
+	for (int i = 0; i < count; i++) {
+		strings[i] = igt_arena_printf("string-%d", i);
+		igt_assert(((uintptr_t)strings[i] & 15) == 0);
+	}
+}
+
+static void check_strings(int count)
+{
+	char buf[32];
+
+	for (int i = 0; i < count; i++) {
+		snprintf(buf, sizeof(buf), "string-%d", i);
+		igt_assert_eq(strcmp(strings[i], buf), 0);
+	}
+}
+
+igt_main
+{
+	char *global;
+
+	igt_fixture
+		global = igt_arena_strdup("outside of subtests");
+
+	igt_subtest("alloc") {
+		/* Spans several chunks */
+		fill_strings(NUM_STRINGS);
+		check_strings(NUM_STRINGS);
+	}
+
+	igt_subtest("large") {
+		size_t sz = 4 << 20;
+		char *small = igt_arena_strdup("small");
+		uint8_t *big = igt_arena_zalloc(sz);
+
+		for (size_t i = 0; i < sz; i++)
+			igt_assert_eq(big[i], 0);
+		memset(big, 0xff, sz);
+
+		igt_assert_eq(strcmp(small, "small"), 0);
+		igt_assert_eq(strcmp(igt_arena_strdup("after"), "after"), 0);
+	}
+
+	igt_subtest_with_dynamic("dynamic") {
+		fill_strings(16);
+
+		for (int n = 0; n < 64; n++) {
+			igt_dynamic_f("loop-%d", n) {
+				/* Freed at the end of every dynamic subtest */
+				igt_assert(igt_arena_alloc(1 << 20));
+				fill_strings(NUM_STRINGS / 64);
+				check_strings(NUM_STRINGS / 64);
+			}
+		}
+
+		fill_strings(16);
+		check_strings(16);
+	}
+
+	igt_subtest("failure") {
+		igt_arena_printf("%s", "released on skip too");
+		igt_skip("arena is released on skip\n");
+	}
+
+	igt_subtest("outside")
+		igt_assert_eq(strcmp(global, "outside of subtests"), 0);
+}
@@ -174,6 +174,51 @@ static void test_signal_detect_phaseshift(struct audio_signal *signal)
 	igt_assert(!ok);
 }
 
+static void test_signal_detect_streaming(struct audio_signal *signal)
+{
+	size_t len = 8 * BUFFER_LEN, i, chunk = 128;
+	int mapping[CHANNELS] = { 0 };
+	struct audio_signal_detector *det;
+	double *buf;
+	int32_t *capture;
+	bool ok = false;
+
+	buf = malloc(len * sizeof(double));
+	capture = calloc(len, sizeof(int32_t));
+	igt_assert(buf && capture);
+
+	/* Silence first, then the signal from the middle of a window on */
+	audio_signal_fill(signal, buf, len / CHANNELS);
+	for (i = BUFFER_LEN + BUFFER_LEN / 3; i < len; i++)
+		capture[i] = buf[i] * INT32_MAX;
+
+	det = audio_signal_detector_init(signal, SAMPLING_RATE, CHANNELS,
+					 mapping, BUFFER_LEN, BUFFER_LEN / 2, 3);
+	for (i = 0; i < len && !ok; i += chunk)
+		ok = audio_signal_detector_push_s32_le(det, capture + i, chunk);
+	audio_signal_detector_fini(det);
+
+	/* The first window full of the signal ends at 5 * BUFFER_LEN / 2 */
+	igt_assert(ok);
+	igt_assert_eq(i, 5 * BUFFER_LEN / 2 + 2 * BUFFER_LEN / 2);
+
+	/* A held sample breaks the streak */
+	for (i = 0; i < 5; i++)
+		capture[2 * BUFFER_LEN + i] = capture[2 * BUFFER_LEN];
+	det = audio_signal_detector_init(signal, SAMPLING_RATE, CHANNELS,
+					 mapping, BUFFER_LEN, BUFFER_LEN / 2, 3);
+	ok = false;
+	for (i = 0; i < len && !ok; i += chunk)
+		ok = audio_signal_detector_push_s32_le(det, capture + i, chunk);
+	audio_signal_detector_fini(det);
+
+	igt_assert(ok);
+	igt_assert(i > 5 * BUFFER_LEN / 2 + 2 * BUFFER_LEN / 2);
+
+	free(capture);
+	free(buf);
+}
+
 igt_main
 {
 	struct audio_signal *signal = NULL;
@@ -215,6 +260,9 @@ igt_main
 		igt_subtest("signal-detect-phaseshift")
 			test_signal_detect_phaseshift(signal);
 
+		igt_subtest("signal-detect-streaming")
+			test_signal_detect_streaming(signal);
+
 		igt_fixture {
 			audio_signal_fini(signal);
 		}
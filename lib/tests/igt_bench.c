@@ -0,0 +1,178 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2024 Intel Corporation
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "igt_bench.h"
+#include "igt_core.h"
+
+IGT_TEST_DESCRIPTION("Check the benchmark harness statistics and reporting");
+
+struct spin {
+	unsigned long *calls;
+	volatile unsigned long sink;
+};
+
+static void spin(void *data, unsigned int thread, unsigned long count)
+{
+	struct spin *s = data;
+
+	for (unsigned long i = 0; i < count; i++)
+		s->sink += i;
+	s->calls[thread]++;
+}
+
+static void short_run(struct igt_bench *bench, unsigned int threads)
+{
+	igt_bench_init(bench, "igt_bench");
+	bench->opts.duration = 0.01;
+	bench->opts.warmup = 0.01;
+	bench->opts.reps = 3;
+	bench->opts.threads = threads;
+}
+
+static char *read_file(const char *path)
+{
+	static char buf[8192];
+	FILE *f = fopen(path, "r");
+	size_t len;
+
+	igt_assert(f);
+	len = fread(buf, 1, sizeof(buf) - 1, f);
+	fclose(f);
+	buf[len] = '\0';
+
+	return buf;
+}
+
+igt_main
+{
+	igt_subtest("ci95") {
+		igt_stats_t stats;
+
+		igt_stats_init(&stats);
+		igt_stats_push_float(&stats, 2);
+		igt_assert_eq_double(igt_bench_ci95(&stats), 0);
+
+		igt_stats_push_float(&stats, 4);
+		igt_stats_push_float(&stats, 6);
+		igt_stats_push_float(&stats, 8);
+		igt_stats_push_float(&stats, 10);
+
+		/* t(4) = 2.776, standard error sqrt(10) / sqrt(5) */
+		igt_assert(fabs(igt_bench_ci95(&stats) - 2.776 * sqrt(2)) < 1e-3);
+		igt_stats_fini(&stats);
+	}
+
+	igt_subtest("run") {
+		unsigned long calls = 0;
+		struct spin s = { .calls = &calls };
+		struct igt_bench_result result;
+		struct igt_bench bench;
+
+		short_run(&bench, 1);
+		igt_bench_run(&bench, "spin", spin, &s, &result);
+
+		igt_assert(result.batch >= 1);
+		igt_assert_eq(result.samples.n_values, 3);
+		igt_assert(calls > 3);
+		igt_assert(result.min > 0);
+		igt_assert(result.min <= result.mean);
+		igt_assert(result.mean <= result.max);
+		igt_assert(result.ci95 >= 0);
+
+		igt_bench_result_fini(&result);
+		igt_bench_fini(&bench);
+	}
+
+	igt_subtest("threads") {
+		struct igt_bench_result result;
+		struct igt_bench bench;
+		struct spin s;
+
+		s.calls = mmap(NULL, 4096, PROT_READ | PROT_WRITE,
+			       MAP_SHARED | MAP_ANON, -1, 0);
+		igt_assert(s.calls != MAP_FAILED);
+
+		short_run(&bench, 2);
+		igt_bench_run(&bench, "spin", spin, &s, &result);
+
+		igt_assert_eq(result.samples.n_values, 3);
+		igt_assert(s.calls[0]);
+		igt_assert(s.calls[1]);
+
+		igt_bench_result_fini(&result);
+		igt_bench_fini(&bench);
+		munmap(s.calls, 4096);
+	}
+
+	igt_subtest("json") {
+		char path[] = "/tmp/igt_bench.XXXXXX";
+		unsigned long calls = 0;
+		struct spin s = { .calls = &calls };
+		struct igt_bench_result result;
+		struct igt_bench bench;
+		const char *json;
+		int fd;
+
+		fd = mkstemp(path);
+		igt_assert_fd(fd);
+		close(fd);
+
+		short_run(&bench, 1);
+		bench.opts.json = path;
+		igt_bench_run(&bench, "first", spin, &s, &result);
+		igt_bench_result_fini(&result);
+		igt_bench_run(&bench, "second", spin, &s, &result);
+		igt_bench_result_fini(&result);
+		igt_bench_fini(&bench);
+
+		json = read_file(path);
+		unlink(path);
+
+		igt_assert(strstr(json, "\"benchmark\": \"igt_bench\""));
+		igt_assert(strstr(json, "\"environment\": {"));
+		igt_assert(strstr(json, "\"reps\": 3,"));
+		igt_assert(strstr(json, "\"name\": \"first\""));
+		igt_assert(strstr(json, "},\n\t\t{\n\t\t\t\"name\": \"second\""));
+		igt_assert(strstr(json, "\n\t]\n}\n"));
+	}
+
+	igt_subtest("distribution") {
+		char path[] = "/tmp/igt_bench.XXXXXX";
+		struct igt_bench bench;
+		igt_stats_t stats;
+		const char *json;
+		int fd;
+
+		fd = mkstemp(path);
+		igt_assert_fd(fd);
+		close(fd);
+
+		short_run(&bench, 1);
+		bench.opts.json = path;
+
+		igt_stats_init_histogram(&stats, 4);
+		for (int i = 1; i <= 100; i++)
+			igt_stats_push(&stats, i);
+		igt_bench_record_distribution(&bench, "latency", "ns", &stats);
+		igt_stats_fini(&stats);
+		igt_bench_fini(&bench);
+
+		json = read_file(path);
+		unlink(path);
+
+		igt_assert(strstr(json, "\"name\": \"latency\""));
+		igt_assert(strstr(json, "\"unit\": \"ns\""));
+		igt_assert(strstr(json, "\"count\": 100,"));
+		igt_assert(strstr(json, "\"min\": 1.000000,"));
+		igt_assert(strstr(json, "\"p99.9\": "));
+		igt_assert(strstr(json, "\"buckets\": [[1, 1, 1], [2, 2, 1]"));
+	}
+}
@@ -0,0 +1,92 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2025 Intel Corporation
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "igt_aux.h"
+#include "igt_bufcmp.h"
+#include "igt_core.h"
+#include "igt_rand.h"
+
+IGT_TEST_DESCRIPTION("Check igt_bufcmp finds and reports mismatches however the buffer is split");
+
+igt_main
+{
+	size_t size = (64 << 20) + 13;
+	uint8_t *ref, *buf;
+
+	igt_fixture {
+		ref = malloc(size);
+		buf = malloc(size);
+		igt_assert(ref && buf);
+
+		igt_rand_fill(ref, size, 7);
+	}
+
+	igt_subtest("match") {
+		memcpy(buf, ref, size);
+
+		for (int threads = 0; threads <= 7; threads++) {
+			igt_assert_eq_u64(igt_bufcmp(NULL, buf, ref, size,
+						     threads), 0);
+			igt_assert_eq_u64(igt_bufcmp_rand(NULL, buf, size, 7,
+							  threads), 0);
+		}
+
+		memset(buf, 0xa5, size);
+		igt_assert_eq_u64(igt_bufcmp_value(NULL, buf, size, 0xa5a5a5a5, 0),
+				  0);
+	}
+
+	igt_subtest("mismatches") {
+		/* Spread over the chunks, including the partial last word */
+		size_t offsets[] = { 0, 5, 4096, 12 << 20, 40 << 20, size - 1 };
+		struct igt_bufcmp cmp;
+
+		memcpy(buf, ref, size);
+		for (int i = 0; i < ARRAY_SIZE(offsets); i++)
+			buf[offsets[i]] ^= 0x80;
+
+		for (int threads = 0; threads <= 7; threads++) {
+			igt_assert_eq_u64(igt_bufcmp(&cmp, buf, ref, size,
+						     threads),
+					  ARRAY_SIZE(offsets));
+			igt_assert_eq(cmp.num_reported, ARRAY_SIZE(offsets));
+
+			for (int i = 0; i < ARRAY_SIZE(offsets); i++) {
+				struct igt_bufcmp_mismatch *m = &cmp.reported[i];
+
+				igt_assert_eq_u64(m->offset, offsets[i] & ~3ul);
+				igt_assert_eq_u32(m->expected ^ m->found,
+						  0x80u << 8 * (offsets[i] & 3));
+			}
+
+			igt_assert_eq_u64(igt_bufcmp_rand(NULL, buf, size, 7,
+							  threads),
+					  ARRAY_SIZE(offsets));
+		}
+	}
+
+	igt_subtest("reported-first") {
+		struct igt_bufcmp cmp;
+
+		memset(buf, 0, size);
+		igt_assert_eq_u64(igt_bufcmp_value(&cmp, buf, size, 1, 0),
+				  DIV_ROUND_UP(size, 4));
+		igt_assert_eq(cmp.num_reported, IGT_BUFCMP_MAX_REPORTED);
+
+		for (int i = 0; i < IGT_BUFCMP_MAX_REPORTED; i++) {
+			igt_assert_eq_u64(cmp.reported[i].offset, 4 * i);
+			igt_assert_eq_u32(cmp.reported[i].expected, 1);
+			igt_assert_eq_u32(cmp.reported[i].found, 0);
+		}
+	}
+
+	igt_fixture {
+		free(buf);
+		free(ref);
+	}
+}
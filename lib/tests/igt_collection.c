@@ -0,0 +1,168 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2025 Intel Corporation
+ */
+
+#include <string.h>
+
+#include "igt_aux.h"
+#include "igt_collection.h"
+#include "drmtest.h"
+#include "igt_core.h"
+
+IGT_TEST_DESCRIPTION("Check the covering iterator covers all the t-tuples");
+
+#define MAX_ROWS 4096
+
+struct rows {
+	int n;
+	int v[MAX_ROWS][IGT_COLLECTION_MAXSIZE];
+};
+
+static void generate(struct rows *rows, const struct igt_collection **sets,
+		     int num_sets, int strength, uint32_t seed)
+{
+	struct igt_collection *result;
+
+	rows->n = 0;
+	for_each_covering(result, strength, seed, sets, num_sets) {
+		igt_assert_eq(result->size, num_sets);
+		igt_assert(rows->n < MAX_ROWS);
+		for (int i = 0; i < num_sets; i++)
+			rows->v[rows->n][i] = igt_collection_get_value(result, i);
+		rows->n++;
+	}
+}
+
+/* Checks every pair, or triple, of values of different sets is in a row */
+static void check_covered(const struct rows *rows,
+			  const struct igt_collection **sets, int num_sets,
+			  int strength)
+{
+	for (uint32_t mask = 0; mask < 1u << num_sets; mask++) {
+		int idx[IGT_COLLECTION_MAXSIZE] = {};
+		int s[3], n = 0;
+
+		if (igt_hweight(mask) != strength)
+			continue;
+		for (int i = 0; i < num_sets; i++)
+			if (mask & (1 << i))
+				s[n++] = i;
+
+		for (;;) {
+			bool found = false;
+			int j;
+
+			for (int r = 0; r < rows->n && !found; r++) {
+				found = true;
+				for (j = 0; j < n; j++)
+					if (rows->v[r][s[j]] != sets[s[j]]->set[idx[j]].value)
+						found = false;
+			}
+			igt_assert_f(found, "tuple not covered\n");
+
+			for (j = n - 1; j >= 0; j--) {
+				if (++idx[j] < sets[s[j]]->size)
+					break;
+				idx[j] = 0;
+			}
+			if (j < 0)
+				break;
+		}
+	}
+}
+
+igt_main
+{
+	static const int sizes[] = { 6, 4, 3, 5, 2, 4, 3 };
+	const struct igt_collection *sets[ARRAY_SIZE(sizes)];
+	static struct rows a, b;
+	int product = 1;
+
+	igt_fixture {
+		for (int i = 0; i < ARRAY_SIZE(sizes); i++) {
+			struct igt_collection *set = igt_collection_create(sizes[i]);
+
+			for (int j = 0; j < sizes[i]; j++)
+				igt_collection_set_value(set, j, 10 * i + j);
+			sets[i] = set;
+			product *= sizes[i];
+		}
+	}
+
+	igt_subtest("pairwise") {
+		generate(&a, sets, ARRAY_SIZE(sets), 2, 1);
+		check_covered(&a, sets, ARRAY_SIZE(sets), 2);
+
+		/* At least the product of the two largest sets */
+		igt_assert_lte(6 * 5, a.n);
+		igt_assert_lt(a.n, product / 20);
+		igt_info("%d rows out of %d\n", a.n, product);
+	}
+
+	igt_subtest("three-wise") {
+		generate(&a, sets, ARRAY_SIZE(sets), 3, 1);
+		check_covered(&a, sets, ARRAY_SIZE(sets), 3);
+		igt_assert_lt(a.n, product / 4);
+		igt_info("%d rows out of %d\n", a.n, product);
+	}
+
+	igt_subtest("full-strength") {
+		generate(&a, sets, 3, 3, 1);
+		igt_assert_eq(a.n, 6 * 4 * 3);
+	}
+
+	igt_subtest("deterministic") {
+		generate(&a, sets, ARRAY_SIZE(sets), 2, 7);
+		generate(&b, sets, ARRAY_SIZE(sets), 2, 7);
+		igt_assert_eq(a.n, b.n);
+		igt_assert(!memcmp(a.v, b.v, a.n * sizeof(a.v[0])));
+
+		generate(&b, sets, ARRAY_SIZE(sets), 2, 8);
+		check_covered(&b, sets, ARRAY_SIZE(sets), 2);
+		igt_assert(a.n != b.n || memcmp(a.v, b.v, a.n * sizeof(a.v[0])));
+	}
+
+	igt_subtest("coverage") {
+		struct igt_collection_iter *iter;
+		uint64_t covered, total, last = 0;
+
+		iter = igt_collection_iter_create_covering(sets, ARRAY_SIZE(sets),
+							   2, 1);
+		igt_collection_iter_coverage(iter, &covered, &total);
+		igt_assert_eq_u64(covered, 0);
+
+		while (igt_collection_iter_next(iter)) {
+			igt_collection_iter_coverage(iter, &covered, &total);
+			igt_assert(last < covered);
+			last = covered;
+		}
+		igt_assert_eq_u64(covered, total);
+		igt_collection_iter_destroy(iter);
+	}
+
+	igt_subtest("single-set") {
+		struct igt_collection_iter *iter;
+		struct igt_collection *result;
+		bool seen[4][4] = {};
+		int n = 0;
+
+		/* Pairwise variations with repetition of a single set */
+		iter = igt_collection_iter_create(sets[1], 3, COVERING);
+		while ((result = igt_collection_iter_next(iter))) {
+			seen[result->set[0].value % 10][result->set[2].value % 10] = true;
+			n++;
+		}
+		igt_collection_iter_destroy(iter);
+
+		for (int i = 0; i < 4; i++)
+			for (int j = 0; j < 4; j++)
+				igt_assert(seen[i][j]);
+		igt_assert_lt(n, 4 * 4 * 4);
+	}
+
+	igt_fixture {
+		for (int i = 0; i < ARRAY_SIZE(sizes); i++)
+			igt_collection_destroy((struct igt_collection *)sets[i]);
+	}
+}
@@ -0,0 +1,91 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2024 Intel Corporation
+ */
+
+#include <stdlib.h>
+
+#include "drmtest.h"
+#include "igt_core.h"
+#include "igt_crc.h"
+
+IGT_TEST_DESCRIPTION("Check the accelerated igt_cpu_crc32 against the bytewise CRC");
+
+static uint32_t reference_crc32(const uint8_t *p, size_t size)
+{
+	uint32_t crc = ~0U;
+
+	while (size--)
+		crc = igt_crc32_tab[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+
+	return crc ^ ~0U;
+}
+
+static uint8_t *random_buffer(size_t size)
+{
+	uint8_t *buf = malloc(size);
+
+	igt_assert(buf);
+	for (size_t i = 0; i < size; i++)
+		buf[i] = random();
+
+	return buf;
+}
+
+igt_main
+{
+	igt_subtest("known-value") {
+		/* The standard CRC32 check value */
+		igt_assert_eq_u32(igt_cpu_crc32("123456789", 9), 0xcbf43926);
+		igt_assert_eq_u32(igt_cpu_crc32(NULL, 0), 0);
+	}
+
+	igt_subtest("sizes-and-alignments") {
+		uint8_t *buf = random_buffer(1024 + 16);
+
+		/* Covers the head, folding and tail paths of all variants */
+		for (int offset = 0; offset < 16; offset++)
+			for (size_t size = 0; size <= 1024; size++)
+				igt_assert_eq_u32(igt_cpu_crc32(buf + offset, size),
+						  reference_crc32(buf + offset, size));
+
+		free(buf);
+	}
+
+	igt_subtest("portable-paths") {
+		static const char * const impls[] = { "slice8", "bytes" };
+		size_t size = (40 << 20) + 13;
+		uint8_t *buf = random_buffer(size);
+		uint32_t crc = reference_crc32(buf, size);
+
+		/* The implementation is picked once per process */
+		for (int i = 0; i < ARRAY_SIZE(impls); i++) {
+			igt_fork(child, 1) {
+				setenv("IGT_CRC32_IMPL", impls[i], 1);
+
+				for (int offset = 0; offset < 16; offset++)
+					for (size_t len = 0; len <= 1024; len++)
+						igt_assert_eq_u32(igt_cpu_crc32(buf + offset, len),
+								  reference_crc32(buf + offset, len));
+
+				igt_assert_eq_u32(igt_cpu_crc32_parallel(buf, size, 2),
+						  crc);
+			}
+			igt_waitchildren();
+		}
+
+		free(buf);
+	}
+
+	igt_subtest("parallel") {
+		size_t size = (96 << 20) + 13;
+		uint8_t *buf = random_buffer(size);
+		uint32_t crc = igt_cpu_crc32(buf, size);
+
+		for (int threads = 0; threads <= 7; threads++)
+			igt_assert_eq_u32(igt_cpu_crc32_parallel(buf, size, threads),
+					  crc);
+
+		free(buf);
+	}
+}
@@ -0,0 +1,132 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2025 Intel Corporation
+ */
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "igt_core.h"
+#include "igt_debugfs.h"
+
+IGT_TEST_DESCRIPTION("Check reading files whole and by line with an igt_debugfs_file");
+
+#define NUM_LINES 20000
+
+static char dirname[] = "/tmp/igt_debugfs_file.XXXXXX";
+static int dir = -1;
+
+static void write_file(const char *name, const char *contents)
+{
+	int fd;
+
+	fd = openat(dir, name, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	igt_assert_fd(fd);
+	igt_assert_eq(write(fd, contents, strlen(contents)), strlen(contents));
+	close(fd);
+}
+
+static char *numbered_lines(int count)
+{
+	char *contents, *p;
+	int i;
+
+	/* Over the size of a read chunk, for growing the buffer */
+	contents = malloc(count * 16 + 1);
+	igt_assert(contents);
+
+	p = contents;
+	for (i = 0; i < count; i++)
+		p += sprintf(p, "line %d\n", i);
+
+	return contents;
+}
+
+igt_main
+{
+	struct igt_debugfs_file *file;
+	char *contents;
+
+	igt_fixture {
+		igt_assert(mkdtemp(dirname));
+		dir = open(dirname, O_RDONLY | O_DIRECTORY);
+		igt_assert_fd(dir);
+
+		contents = numbered_lines(NUM_LINES);
+		write_file("large", contents);
+	}
+
+	igt_subtest("read-whole") {
+		const char *buf;
+
+		file = igt_debugfs_file_open(dir, "large");
+		igt_assert(file);
+
+		buf = igt_debugfs_file_read(file);
+		igt_assert(buf);
+		igt_assert_eq(strcmp(buf, contents), 0);
+
+		/* Again from the start */
+		buf = igt_debugfs_file_read(file);
+		igt_assert_eq(strcmp(buf, contents), 0);
+
+		igt_debugfs_file_close(file);
+	}
+
+	igt_subtest("next-line") {
+		char expected[32], *line;
+		int i;
+
+		file = igt_debugfs_file_open(dir, "large");
+		igt_assert(file);
+
+		for (i = 0; (line = igt_debugfs_file_next_line(file)); i++) {
+			snprintf(expected, sizeof(expected), "line %d", i);
+			igt_assert_eq(strcmp(line, expected), 0);
+		}
+		igt_assert_eq(i, NUM_LINES);
+
+		/* Starts over after the last line, or when rewound */
+		igt_assert_eq(strcmp(igt_debugfs_file_next_line(file), "line 0"), 0);
+		igt_assert_eq(strcmp(igt_debugfs_file_next_line(file), "line 1"), 0);
+		igt_debugfs_file_rewind(file);
+		igt_assert_eq(strcmp(igt_debugfs_file_next_line(file), "line 0"), 0);
+
+		igt_debugfs_file_close(file);
+	}
+
+	igt_subtest("no-trailing-newline") {
+		write_file("partial", "first\nsecond");
+
+		file = igt_debugfs_file_open(dir, "partial");
+		igt_assert(file);
+		igt_assert_eq(strcmp(igt_debugfs_file_next_line(file), "first"), 0);
+		igt_assert_eq(strcmp(igt_debugfs_file_next_line(file), "second"), 0);
+		igt_assert(!igt_debugfs_file_next_line(file));
+		igt_debugfs_file_close(file);
+	}
+
+	igt_subtest("empty") {
+		write_file("empty", "");
+
+		file = igt_debugfs_file_open(dir, "empty");
+		igt_assert(file);
+		igt_assert_eq(strcmp(igt_debugfs_file_read(file), ""), 0);
+		igt_assert(!igt_debugfs_file_next_line(file));
+		igt_debugfs_file_close(file);
+	}
+
+	igt_subtest("missing")
+		igt_assert(!igt_debugfs_file_open(dir, "missing"));
+
+	igt_fixture {
+		unlinkat(dir, "large", 0);
+		unlinkat(dir, "partial", 0);
+		unlinkat(dir, "empty", 0);
+		close(dir);
+		rmdir(dirname);
+		free(contents);
+	}
+}
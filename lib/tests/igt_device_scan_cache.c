@@ -0,0 +1,106 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2025 Intel Corporation
+ */
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "igt_core.h"
+#include "igt_device_scan.h"
+
+IGT_TEST_DESCRIPTION("Check the device scan cache survives a save and reload, and is dropped once stale");
+
+#define CACHED_SYSNAME "igt-cached-card"
+
+static char *read_file(const char *path)
+{
+	char *buf = NULL;
+	size_t size = 0;
+	FILE *f;
+
+	f = fopen(path, "r");
+	igt_assert(f);
+	igt_assert(getdelim(&buf, &size, '\0', f) > 0);
+	fclose(f);
+
+	return buf;
+}
+
+igt_main
+{
+	char dir[] = "/tmp/igt-device-scan-XXXXXX";
+	char syspath[PATH_MAX], cache[PATH_MAX], saved[PATH_MAX];
+
+	igt_fixture {
+		FILE *f;
+
+		igt_require(mkdtemp(dir));
+		snprintf(syspath, sizeof(syspath), "%s/%s", dir, CACHED_SYSNAME);
+		snprintf(cache, sizeof(cache), "%s/cache", dir);
+		snprintf(saved, sizeof(saved), "%s/saved", dir);
+		igt_assert(mkdir(syspath, 0755) == 0);
+
+		/* A drm device which can only have come from the cache */
+		f = fopen(cache, "w");
+		igt_assert(f);
+		fprintf(f, "igt-device-scan-cache 1\n"
+			"device\t%s\n"
+			"subsystem\tdrm\n"
+			"devnode\t/dev/dri/card42\n"
+			"sysname\t" CACHED_SYSNAME "\n"
+			"drm_card\t/dev/dri/card42\n"
+			"prop\tDEVNAME=dri/card42\n"
+			"end\n", syspath);
+		igt_assert(fclose(f) == 0);
+	}
+
+	igt_subtest("round-trip") {
+		struct igt_device_card card;
+		char *orig, *copy;
+
+		setenv("IGT_DEVICE_SCAN_CACHE", cache, 1);
+		igt_devices_scan();
+		igt_assert(igt_device_find_card_by_sysname(CACHED_SYSNAME, &card));
+		igt_assert_eq(strcmp(card.subsystem, "drm"), 0);
+		igt_assert_eq(strcmp(card.card, "/dev/dri/card42"), 0);
+
+		igt_assert(igt_devices_cache_save(saved));
+		orig = read_file(cache);
+		copy = read_file(saved);
+		igt_assert_eq(strcmp(orig, copy), 0);
+		free(orig);
+		free(copy);
+
+		setenv("IGT_DEVICE_SCAN_CACHE", saved, 1);
+		igt_devices_scan();
+		igt_assert(igt_device_find_card_by_sysname(CACHED_SYSNAME, &card));
+		igt_assert_eq(strcmp(card.card, "/dev/dri/card42"), 0);
+	}
+
+	igt_subtest("stale-entry") {
+		struct igt_device_card card;
+
+		setenv("IGT_DEVICE_SCAN_CACHE", cache, 1);
+		igt_devices_scan();
+		igt_assert(igt_device_find_card_by_sysname(CACHED_SYSNAME, &card));
+
+		/* Once the device is gone, udev is enumerated instead */
+		igt_assert(rmdir(syspath) == 0);
+		igt_devices_scan();
+		igt_assert(!igt_device_find_card_by_sysname(CACHED_SYSNAME, &card));
+	}
+
+	igt_fixture {
+		unsetenv("IGT_DEVICE_SCAN_CACHE");
+		igt_devices_free();
+		unlink(cache);
+		unlink(saved);
+		rmdir(syspath);
+		rmdir(dir);
+	}
+}
@@ -0,0 +1,135 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2024 Intel Corporation
+ */
+
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "igt_core.h"
+#include "igt_drm_fdinfo.h"
+
+IGT_TEST_DESCRIPTION("Check parsing of drm fdinfo text");
+
+#define ARRAY_SIZE(arr) (sizeof(arr)/sizeof(arr[0]))
+
+static const char *engine_map[] = {
+	"render", "copy", "video", "video-enhance", "compute",
+};
+
+static const char *region_map[] = {
+	"system", "vram0",
+};
+
+static unsigned int parse(const char *text, struct drm_client_fdinfo *info,
+			  bool maps)
+{
+	unsigned int ret;
+	int fd;
+
+	fd = memfd_create("fdinfo", 0);
+	igt_assert_fd(fd);
+	igt_assert_eq(write(fd, text, strlen(text)), strlen(text));
+
+	memset(info, 0, sizeof(*info));
+	ret = igt_parse_drm_fdinfo_fd(fd, info,
+				      maps ? engine_map : NULL,
+				      maps ? ARRAY_SIZE(engine_map) : 0,
+				      maps ? region_map : NULL,
+				      maps ? ARRAY_SIZE(region_map) : 0);
+	close(fd);
+
+	return ret;
+}
+
+static const char xe_fdinfo[] =
+	"pos:\t0\n"
+	"flags:\t02100002\n"
+	"drm-driver:\txe\n"
+	"drm-client-id:\t42\n"
+	"drm-pdev:\t0000:00:02.0\n"
+	"drm-total-system:\t12 KiB\n"
+	"drm-resident-system:\t3 MiB\n"
+	"drm-total-vram0:\t1 GiB\n"
+	"drm-active-vram0:\t7\n"
+	"drm-cycles-render:\t1234\n"
+	"drm-total-cycles-render:\t99999\n"
+	"drm-engine-capacity-video:\t2\n"
+	"drm-cycles-video:\t55\n"
+	"drm-total-cycles-video:\t66\n"
+	"drm-cycles-video-enhance:\t5";
+
+igt_main
+{
+	struct drm_client_fdinfo info;
+
+	igt_subtest("with-maps") {
+		igt_assert_eq(parse(xe_fdinfo, &info, true), 8);
+
+		igt_assert_eq(strcmp(info.driver, "xe"), 0);
+		igt_assert_eq(strcmp(info.pdev, "0000:00:02.0"), 0);
+		igt_assert_eq_u64(info.id, 42);
+
+		igt_assert_eq(info.num_engines, 3);
+		igt_assert_eq(info.last_engine_index, 3);
+		igt_assert_eq_u64(info.cycles[0], 1234);
+		igt_assert_eq_u64(info.total_cycles[0], 99999);
+		igt_assert_eq_u64(info.cycles[2], 55);
+		igt_assert_eq_u64(info.total_cycles[2], 66);
+		igt_assert_eq_u64(info.cycles[3], 5);
+		igt_assert_eq(info.capacity[0], 1);
+		igt_assert_eq(info.capacity[2], 2);
+		igt_assert_eq(info.utilization_mask,
+			      DRM_FDINFO_UTILIZATION_CYCLES |
+			      DRM_FDINFO_UTILIZATION_TOTAL_CYCLES);
+
+		igt_assert_eq(info.num_regions, 2);
+		igt_assert_eq(strcmp(info.region_names[0], "system"), 0);
+		igt_assert_eq(strcmp(info.region_names[1], "vram0"), 0);
+		igt_assert_eq_u64(info.region_mem[0].total, 12 << 10);
+		igt_assert_eq_u64(info.region_mem[0].resident, 3 << 20);
+		igt_assert_eq_u64(info.region_mem[1].total, 1 << 30);
+		igt_assert_eq_u64(info.region_mem[1].active, 7);
+	}
+
+	igt_subtest("without-maps") {
+		igt_assert_eq(parse(xe_fdinfo, &info, false), 8);
+
+		/* Names are indexed in order of appearance */
+		igt_assert_eq(info.num_engines, 3);
+		igt_assert_eq(strcmp(info.names[0], "render"), 0);
+		igt_assert_eq(strcmp(info.names[1], "video"), 0);
+		igt_assert_eq(strcmp(info.names[2], "video-enhance"), 0);
+		igt_assert_eq_u64(info.cycles[1], 55);
+		igt_assert_eq_u64(info.cycles[2], 5);
+
+		igt_assert_eq(info.num_regions, 2);
+		igt_assert_eq(strcmp(info.region_names[1], "vram0"), 0);
+		igt_assert_eq_u64(info.region_mem[1].total, 1 << 30);
+	}
+
+	igt_subtest("legacy-memory-key") {
+		igt_assert_eq(parse("drm-driver:\tamdgpu\n"
+				    "drm-client-id:\t3\n"
+				    "drm-memory-vram:\t100 KiB\n"
+				    "drm-engine-gfx:\t10 ns\n", &info, false), 4);
+
+		igt_assert_eq_u64(info.region_mem[0].resident, 100 << 10);
+		igt_assert_eq_u64(info.engine_time[0], 10);
+		igt_assert_eq(info.utilization_mask,
+			      DRM_FDINFO_UTILIZATION_ENGINE_TIME);
+	}
+
+	igt_subtest("unexpected-format") {
+		/* No client id, engines or regions */
+		igt_assert_eq(parse("drm-driver:\ti915\n", &info, false), 0);
+
+		/* Names are matched exactly, not by prefix */
+		igt_assert_eq(parse("drm-driver:\txe\n"
+				    "drm-client-id:\t1\n"
+				    "drm-cycles-vid:\t1\n"
+				    "drm-cyclesrender:\t1\n"
+				    "drm-total-vram:\t1\n", &info, true), 0);
+	}
+}
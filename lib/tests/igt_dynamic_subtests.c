@@ -139,6 +139,61 @@ __noreturn static void no_dynamic_subtests_entered_leads_to_skip(void)
 	igt_exit();
 }
 
+__noreturn static void parallel_dynamic_subtests_pass(void)
+{
+	char prog[] = "igt_no_exit";
+	char *fake_argv[] = {prog};
+	int fake_argc = ARRAY_SIZE(fake_argv);
+
+	igt_subtest_init(fake_argc, fake_argv);
+
+	igt_subtest_with_dynamic("subtest") {
+		for (int i = 0; i < 4; i++) {
+			igt_dynamic_parallel_f(NULL, "dynamic-%d", i)
+				igt_info("Parallel dynamic subtest %d\n", i);
+		}
+	}
+
+	igt_exit();
+}
+
+__noreturn static void parallel_dynamic_subtest_failure_leads_to_fail(void)
+{
+	char prog[] = "igt_no_exit";
+	char *fake_argv[] = {prog};
+	int fake_argc = ARRAY_SIZE(fake_argv);
+	static const char * const resources[] = { "a", "b", "a" };
+
+	igt_subtest_init(fake_argc, fake_argv);
+
+	igt_subtest_with_dynamic("subtest") {
+		for (int i = 0; i < ARRAY_SIZE(resources); i++) {
+			igt_dynamic_parallel_f(resources[i], "dynamic-%d", i)
+				igt_assert(i != 1);
+		}
+	}
+
+	igt_exit();
+}
+
+__noreturn static void parallel_dynamic_subtests_skipping_leads_to_skip(void)
+{
+	char prog[] = "igt_no_exit";
+	char *fake_argv[] = {prog};
+	int fake_argc = ARRAY_SIZE(fake_argv);
+
+	igt_subtest_init(fake_argc, fake_argv);
+
+	igt_subtest_with_dynamic("subtest") {
+		for (int i = 0; i < 3; i++) {
+			igt_dynamic_parallel_f("engine", "dynamic-%d", i)
+				igt_skip("Skipping\n");
+		}
+	}
+
+	igt_exit();
+}
+
 int main(int argc, char **argv)
 {
 	int ret;
@@ -164,5 +219,16 @@ int main(int argc, char **argv)
 	ret = do_fork(no_dynamic_subtests_entered_leads_to_skip);
 	internal_assert_wexited(ret, IGT_EXIT_SKIP);
 
+	setenv("IGT_DYNAMIC_PARALLEL", "4", 1);
+
+	ret = do_fork(parallel_dynamic_subtests_pass);
+	internal_assert_wexited(ret, IGT_EXIT_SUCCESS);
+
+	ret = do_fork(parallel_dynamic_subtest_failure_leads_to_fail);
+	internal_assert_wexited(ret, IGT_EXIT_FAILURE);
+
+	ret = do_fork(parallel_dynamic_subtests_skipping_leads_to_skip);
+	internal_assert_wexited(ret, IGT_EXIT_SKIP);
+
 	return 0;
 }
@@ -0,0 +1,67 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2025 Intel Corporation
+ */
+
+#include "drmtest.h"
+#include "igt_core.h"
+#include "igt_fb.h"
+
+IGT_TEST_DESCRIPTION("Check cairo drawing lands in the channel order of RGBA ordered fbs");
+
+static const struct {
+	uint32_t format;
+	uint32_t mask;
+	uint32_t red;
+} formats[] = {
+	{ DRM_FORMAT_XBGR8888, 0x00ffffff, 0x000000ff },
+	{ DRM_FORMAT_ABGR8888, 0xffffffff, 0xff0000ff },
+	{ DRM_FORMAT_XBGR2101010, 0x3fffffff, 0x000003ff },
+};
+
+static void check_red(int fd, uint64_t modifier, int i)
+{
+	struct igt_fb fb;
+	uint32_t *map;
+	cairo_t *cr;
+
+	igt_create_fb(fd, 64, 64, formats[i].format, modifier, &fb);
+
+	cr = igt_get_cairo_ctx(fd, &fb);
+	igt_paint_color_alpha(cr, 0, 0, fb.width, fb.height, 1.0, 0.0, 0.0, 1.0);
+	igt_put_cairo_ctx(cr);
+
+	/* Linear, so the pixel in the middle is at a known place */
+	map = igt_fb_map_buffer(fd, &fb);
+	igt_assert_eq_u32(map[0] & formats[i].mask, formats[i].red);
+	igt_assert_eq_u32(map[32 * fb.strides[0] / 4 + 32] & formats[i].mask,
+			  formats[i].red);
+	igt_fb_unmap_buffer(&fb, map);
+
+	igt_remove_fb(fd, &fb);
+}
+
+igt_main
+{
+	int fd = -1;
+
+	igt_fixture
+		fd = drm_open_driver(DRIVER_INTEL | DRIVER_XE);
+
+	igt_subtest_with_dynamic("linear") {
+		for (int i = 0; i < ARRAY_SIZE(formats); i++)
+			igt_dynamic_f("%s", igt_format_str(formats[i].format))
+				check_red(fd, DRM_FORMAT_MOD_LINEAR, i);
+	}
+
+	igt_subtest_with_dynamic("linear-cpu-convert") {
+		igt_fb_set_gpu_convert(false);
+		for (int i = 0; i < ARRAY_SIZE(formats); i++)
+			igt_dynamic_f("%s", igt_format_str(formats[i].format))
+				check_red(fd, DRM_FORMAT_MOD_LINEAR, i);
+		igt_fb_set_gpu_convert(true);
+	}
+
+	igt_fixture
+		drm_close_driver(fd);
+}
@@ -23,6 +23,7 @@
  */
 
 #include <errno.h>
+#include <sched.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -163,6 +164,37 @@ __noreturn static void subtest_leak(void)
 	igt_exit();
 }
 
+__noreturn static void igt_fork_placement(void)
+{
+	cpu_set_t allowed, cpus;
+
+	igt_simple_init(fake_argc, fake_argv);
+
+	internal_assert(sched_getaffinity(0, sizeof(allowed), &allowed) == 0);
+	igt_fork_set_placement(IGT_FORK_PLACEMENT_COMPACT, -1);
+
+	if (fork_type_dyn) {
+		igt_multi_fork(i, 2) {
+			igt_assert(sched_getaffinity(0, sizeof(cpus), &cpus) == 0);
+			igt_assert_eq(CPU_COUNT(&cpus), 1);
+		}
+	} else {
+		igt_fork(i, 2) {
+			igt_assert(sched_getaffinity(0, sizeof(cpus), &cpus) == 0);
+			igt_assert_eq(CPU_COUNT(&cpus), 1);
+		}
+	}
+
+	igt_waitchildren();
+	igt_fork_set_placement(IGT_FORK_PLACEMENT_NONE, -1);
+
+	/* The parent itself is left alone */
+	igt_assert(sched_getaffinity(0, sizeof(cpus), &cpus) == 0);
+	igt_assert(CPU_EQUAL(&cpus, &allowed));
+
+	igt_exit();
+}
+
 int main(int argc, char **argv)
 {
 	int ret;
@@ -193,6 +225,10 @@ int main(int argc, char **argv)
 		printf("\ncheck subtest leak %d\n", fork_type_dyn);
 		ret = do_fork(subtest_leak);
 		internal_assert_wexited(ret, IGT_EXIT_FAILURE); /* not asserted! */
+
+		printf("\ncheck that children get pinned by the placement policy\n");
+		ret = do_fork(igt_fork_placement);
+		internal_assert_wexited(ret, IGT_EXIT_SUCCESS);
 	}
 
 	printf("SUCCESS all tests passed\n");
@@ -149,6 +149,67 @@ static void test_all_env_vars(void)
 	free(line);
 }
 
+static void test_async_hooks(void)
+{
+	struct igt_hook_evt evt = {
+		.evt_type = IGT_HOOK_POST_SUBTEST,
+		.result = "SUCCESS",
+	};
+	struct igt_hook *igt_hook;
+	struct timespec start;
+	char *buf;
+	size_t len;
+	FILE *f;
+	int ret;
+
+	ret = igt_single_hook("post-subtest,async:sleep 0.5", &igt_hook);
+	igt_assert(ret == 0);
+
+	igt_gettime(&start);
+	igt_hook_event_notify(igt_hook, &evt);
+	igt_assert(igt_nsec_elapsed(&start) < 250 * NSEC_PER_MSEC);
+
+	igt_hook_barrier(igt_hook);
+	igt_assert(igt_nsec_elapsed(&start) >= 500 * NSEC_PER_MSEC);
+
+	f = open_memstream(&buf, &len);
+	igt_assert(f);
+	igt_hook_print_stats(igt_hook, f);
+	fclose(f);
+	igt_assert_f(strstr(buf, "(async): 1 runs, 0 failed"),
+		     "Unexpected stats: %s\n", buf);
+
+	free(buf);
+	igt_hook_free(igt_hook);
+}
+
+static void test_barrier_hooks(void)
+{
+	struct igt_hook_evt evt = {
+		.evt_type = IGT_HOOK_POST_SUBTEST,
+		.result = "SUCCESS",
+	};
+	struct igt_hook *igt_hook;
+	struct timespec start;
+	int ret;
+
+	ret = igt_single_hook("post-subtest,barrier:sleep 0.5", &igt_hook);
+	igt_assert(ret == 0);
+
+	igt_gettime(&start);
+	igt_hook_event_notify(igt_hook, &evt);
+	igt_assert(igt_nsec_elapsed(&start) < 250 * NSEC_PER_MSEC);
+
+	/* The next subtest must not start before the hook is done */
+	evt.evt_type = IGT_HOOK_PRE_SUBTEST;
+	evt.target_name = "foo";
+	evt.result = NULL;
+	igt_hook_event_notify(igt_hook, &evt);
+	igt_assert(igt_nsec_elapsed(&start) >= 500 * NSEC_PER_MSEC);
+
+	igt_hook_free(igt_hook);
+}
+
 igt_main
 {
 	test_invalid_hook_descriptors();
@@ -163,5 +224,11 @@ igt_main
 
 		igt_subtest("all-env-vars")
 			test_all_env_vars();
+
+		igt_subtest("async-hooks")
+			test_async_hooks();
+
+		igt_subtest("barrier-hooks")
+			test_barrier_hooks();
 	}
 }
@@ -0,0 +1,42 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2025 Intel Corporation
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "igt_core.h"
+#include "igt_hostmem.h"
+
+IGT_TEST_DESCRIPTION("Check the alignment and size of host buffers of each page size");
+
+igt_main
+{
+	struct igt_hostmem mem;
+
+	igt_subtest("parse-page") {
+		for (int i = 0; i < IGT_HOSTMEM_NUM_PAGES; i++)
+			igt_assert_eq(igt_hostmem_parse_page(igt_hostmem_page_name(i)), i);
+		igt_assert_eq(igt_hostmem_parse_page("64k"), -1);
+	}
+
+	for (int i = 0; i < IGT_HOSTMEM_NUM_PAGES; i++) {
+		igt_subtest_f("alloc-%s", igt_hostmem_page_name(i)) {
+			size_t page_size = igt_hostmem_page_size(i);
+
+			igt_require(igt_hostmem_has_page(i, page_size));
+
+			/* Rounded up to a whole page, at a page boundary */
+			igt_hostmem_alloc(&mem, page_size / 2 + 1, i, -1,
+					  IGT_HOSTMEM_POPULATE);
+			igt_assert_eq(mem.page, i);
+			igt_assert_eq(mem.size, page_size);
+			igt_assert_eq((uintptr_t)mem.ptr % page_size, 0);
+
+			memset(mem.ptr, 0xc5, mem.size);
+			igt_hostmem_free(&mem);
+			igt_assert(!mem.ptr);
+		}
+	}
+}
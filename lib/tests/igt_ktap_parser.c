@@ -230,6 +230,76 @@ static void ktap_top_version(void)
 	igt_ktap_free(&ktap);
 }
 
+struct push_data {
+	unsigned int count;
+	int codes[4];
+	char *names[4];
+};
+
+static void push_result(const struct igt_ktap_result *result, void *data)
+{
+	struct push_data *d = data;
+
+	igt_assert_lt(d->count, 4);
+	igt_assert_eq(strcmp(result->suite_name, "test_suite"), 0);
+	d->codes[d->count] = result->code;
+	igt_assert_lt(0, asprintf(&d->names[d->count], "%s%s%s",
+				  result->case_name,
+				  result->msg ? ":" : "",
+				  result->msg ?: ""));
+	d->count++;
+}
+
+static void ktap_push(void)
+{
+	static const char report[] =
+		"KTAP version 1\n"
+		"1..1\n"
+		"    KTAP version 1\n"
+		"    # Subtest: test_suite\n"
+		"    1..3\n"
+		"        KTAP version 1\n"
+		"        # Subtest: test_case_1\n"
+		"        ok 1 parameter 1\n"
+		"        not ok 2 parameter 2 # failure message\n"
+		"    ok 1 test_case_1\n"
+		"    not ok 2 test_case_2 # failure message\n"
+		"    ok 3 test_case_3 # SKIP with a message\n"
+		"not ok 1 test_suite\n";
+	struct push_data d = {};
+	struct igt_ktap_results *ktap;
+	size_t chunk, i, len = strlen(report);
+	int err = -EINPROGRESS;
+
+	/* The results mustn't depend on how the report is split */
+	for (chunk = 1; chunk <= len; chunk += 7) {
+		memset(&d, 0, sizeof(d));
+		ktap = igt_ktap_alloc_fn(push_result, &d);
+		igt_require(ktap);
+
+		for (i = 0; i < len; i += chunk)
+			err = igt_ktap_push(ktap, report + i,
+					    len - i < chunk ? len - i : chunk);
+		igt_assert_eq(err, 0);
+		igt_assert_eq(igt_ktap_push(ktap, "ok 2 test_suite\n", 16), 0);
+
+		igt_ktap_free(&ktap);
+
+		igt_assert_eq(d.count, 4);
+		igt_assert_eq(d.codes[0], IGT_EXIT_INVALID);
+		igt_assert_eq(strcmp(d.names[0], "test_case_1"), 0);
+		igt_assert_eq(d.codes[1], IGT_EXIT_SUCCESS);
+		igt_assert_eq(strcmp(d.names[1], "test_case_1"), 0);
+		igt_assert_eq(d.codes[2], IGT_EXIT_FAILURE);
+		igt_assert_eq(strcmp(d.names[2], "test_case_2:failure message"), 0);
+		igt_assert_eq(d.codes[3], IGT_EXIT_SKIP);
+		igt_assert_eq(strcmp(d.names[3], "test_case_3:with a message"), 0);
+
+		for (i = 0; i < d.count; i++)
+			free(d.names[i]);
+	}
+}
+
 igt_main
 {
 	igt_subtest("list")
@@ -243,4 +313,7 @@ igt_main
 
 	igt_subtest("top-ktap-version")
 		ktap_top_version();
+
+	igt_subtest("push")
+		ktap_push();
 }
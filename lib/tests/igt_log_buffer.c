@@ -0,0 +1,104 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2025 Intel Corporation
+ */
+
+#include <pthread.h>
+
+#include "igt_core.h"
+
+IGT_TEST_DESCRIPTION("Exercise the log buffer kept for failure dumps");
+
+#define NUM_THREADS 8
+/* Fits in the buffer all at once */
+#define LINES_PER_THREAD 30
+
+struct inspect_state {
+	int lines;
+	int last[NUM_THREADS];
+	bool ordered;
+};
+
+static bool inspect_line(const char *line, void *data)
+{
+	struct inspect_state *state = data;
+	const char *marker = strstr(line, "log-buffer ");
+	int thread, count;
+
+	if (!marker || sscanf(marker, "log-buffer %d %d", &thread, &count) != 2)
+		return false;
+
+	if (thread < 0 || thread >= NUM_THREADS || count <= state->last[thread])
+		state->ordered = false;
+	else
+		state->last[thread] = count;
+
+	state->lines++;
+
+	return false;
+}
+
+static void inspect(struct inspect_state *state)
+{
+	memset(state, 0, sizeof(*state));
+	for (int i = 0; i < NUM_THREADS; i++)
+		state->last[i] = -1;
+	state->ordered = true;
+
+	igt_log_buffer_inspect(inspect_line, state);
+}
+
+static void *log_thread(void *data)
+{
+	int thread = (intptr_t)data;
+
+	for (int i = 0; i < LINES_PER_THREAD; i++)
+		igt_debug("log-buffer %d %d\n", thread, i);
+
+	return NULL;
+}
+
+igt_main
+{
+	struct inspect_state state;
+
+	igt_subtest("single-thread") {
+		for (int i = 0; i < 10; i++)
+			igt_debug("log-buffer 0 %d\n", i);
+
+		inspect(&state);
+		igt_assert_eq(state.lines, 10);
+		igt_assert(state.ordered);
+		igt_assert_eq(state.last[0], 9);
+
+		/* Inspecting leaves the lines in place */
+		inspect(&state);
+		igt_assert_eq(state.lines, 10);
+	}
+
+	igt_subtest("most-recent-kept") {
+		for (int i = 0; i < 1000; i++)
+			igt_debug("log-buffer 0 %d\n", i);
+
+		inspect(&state);
+		igt_assert_eq(state.lines, 256);
+		igt_assert(state.ordered);
+		igt_assert_eq(state.last[0], 999);
+	}
+
+	igt_subtest("threads-merged") {
+		pthread_t threads[NUM_THREADS];
+
+		for (int i = 0; i < NUM_THREADS; i++)
+			pthread_create(&threads[i], NULL, log_thread, (void *)(intptr_t)i);
+		for (int i = 0; i < NUM_THREADS; i++)
+			pthread_join(threads[i], NULL);
+
+		inspect(&state);
+		igt_assert_eq(state.lines, NUM_THREADS * LINES_PER_THREAD);
+		igt_assert(state.ordered);
+
+		for (int i = 0; i < NUM_THREADS; i++)
+			igt_assert_eq(state.last[i], LINES_PER_THREAD - 1);
+	}
+}
@@ -0,0 +1,222 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2024 Intel Corporation
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "igt_aux.h"
+#include "igt_core.h"
+#include "igt_map.h"
+
+IGT_TEST_DESCRIPTION("Exercise igt_map under insert/remove churn");
+
+#define NUM_KEYS 4096
+#define CHURN_LOOPS (64 * NUM_KEYS)
+#define BENCH_ROUNDS 64
+
+static uint32_t keys[NUM_KEYS];
+static bool present[NUM_KEYS];
+
+static void check_all(struct igt_map *map)
+{
+	uint32_t i, entries = 0;
+
+	for (i = 0; i < NUM_KEYS; i++) {
+		void *data = igt_map_search(map, &keys[i]);
+
+		if (present[i]) {
+			igt_assert(data == &present[i]);
+			entries++;
+		} else {
+			igt_assert(data == NULL);
+		}
+	}
+
+	igt_assert_eq(map->entries, entries);
+}
+
+/* Allocator like workload: random handles come and go */
+static void churn(struct igt_map *map, uint32_t loops)
+{
+	uint32_t i, n;
+
+	for (i = 0; i < loops; i++) {
+		n = random() % NUM_KEYS;
+
+		if (present[n]) {
+			igt_map_remove(map, &keys[n], NULL);
+			present[n] = false;
+		} else {
+			igt_map_insert(map, &keys[n], &present[n]);
+			present[n] = true;
+		}
+
+		if (!(i % NUM_KEYS))
+			check_all(map);
+	}
+}
+
+static void cleanup(struct igt_map *map)
+{
+	igt_map_destroy(map, NULL);
+	memset(present, 0, sizeof(present));
+}
+
+/*
+ * Leaves a map of NUM_KEYS max entries with @live of them present and
+ * tombstones in the rest, so the next insertion drops the tombstones.
+ */
+static struct igt_map *tombstoned_map(uint32_t live, unsigned int seed)
+{
+	struct igt_map *map;
+	uint32_t i, n;
+
+	map = igt_map_create(igt_map_hash_32, igt_map_equal_32);
+	igt_map_reserve(map, NUM_KEYS - 1);
+	igt_assert_eq(map->max_entries, NUM_KEYS);
+
+	for (i = 0; i < NUM_KEYS; i++) {
+		igt_map_insert(map, &keys[i], &present[i]);
+		present[i] = true;
+	}
+
+	srandom(seed);
+	while (map->entries > live) {
+		n = random() % NUM_KEYS;
+		if (present[n]) {
+			igt_map_remove(map, &keys[n], NULL);
+			present[n] = false;
+		}
+	}
+	igt_assert_eq(map->entries + map->deleted_entries, map->max_entries);
+
+	return map;
+}
+
+static uint32_t first_absent(void)
+{
+	uint32_t n;
+
+	for (n = 0; present[n]; n++)
+		;
+
+	return n;
+}
+
+/*
+ * What dropping the tombstones took before compaction: a new table of the
+ * same size, refilled with the present entries.
+ */
+static struct igt_map *full_rehash(struct igt_map *map)
+{
+	struct igt_map_entry *entry;
+	struct igt_map *fresh;
+
+	fresh = igt_map_create(map->hash_function, map->key_equals_function);
+	igt_map_reserve(fresh, map->max_entries - 1);
+
+	igt_map_foreach(map, entry)
+		igt_map_insert_pre_hashed(fresh, entry->hash, entry->key,
+					  entry->data);
+	igt_map_destroy(map, NULL);
+
+	return fresh;
+}
+
+/* Times dropping the tombstones of @live entries maps, in place or not */
+static uint64_t drop_tombstones(uint32_t live, bool rehash)
+{
+	uint64_t total = 0;
+	uint32_t round, n;
+
+	for (round = 0; round < BENCH_ROUNDS; round++) {
+		struct igt_map *map = tombstoned_map(live, round);
+		struct timespec tv = {};
+
+		n = first_absent();
+
+		igt_nsec_elapsed(&tv);
+		if (rehash)
+			map = full_rehash(map);
+		igt_map_insert(map, &keys[n], &present[n]);
+		total += igt_nsec_elapsed(&tv);
+
+		present[n] = true;
+		igt_assert_eq(map->deleted_entries, 0);
+		check_all(map);
+
+		cleanup(map);
+	}
+
+	return total / BENCH_ROUNDS;
+}
+
+igt_main
+{
+	struct igt_map *map;
+	uint32_t i;
+
+	igt_fixture {
+		srandom(0xdeadbeef);
+		for (i = 0; i < NUM_KEYS; i++)
+			keys[i] = random();
+	}
+
+	igt_describe("Check tombstones are dropped without growing the table");
+	igt_subtest("churn") {
+		uint32_t size;
+
+		map = igt_map_create(igt_map_hash_32, igt_map_equal_32);
+		churn(map, CHURN_LOOPS / 4);
+		size = map->size;
+
+		churn(map, CHURN_LOOPS);
+		check_all(map);
+		igt_assert_eq(map->size, size);
+		igt_assert(map->deleted_entries + map->entries < map->max_entries);
+
+		cleanup(map);
+	}
+
+	igt_describe("Check reserved map doesn't rehash while filled up");
+	igt_subtest("reserve") {
+		struct igt_map_entry *table;
+
+		map = igt_map_create(igt_map_hash_32, igt_map_equal_32);
+		igt_map_reserve(map, NUM_KEYS);
+		table = map->table;
+		igt_assert(map->max_entries > NUM_KEYS);
+
+		for (i = 0; i < NUM_KEYS; i++) {
+			igt_map_insert(map, &keys[i], &present[i]);
+			present[i] = true;
+		}
+		igt_assert(map->table == table);
+		check_all(map);
+
+		/* Reserve never shrinks */
+		igt_map_reserve(map, 1);
+		igt_assert(map->table == table);
+
+		cleanup(map);
+	}
+
+	igt_describe("Compare dropping tombstones in place with a full rehash of the same map");
+	igt_subtest("benchmark") {
+		static const uint32_t loads[] = { 10, 50, 90 };
+
+		for (i = 0; i < ARRAY_SIZE(loads); i++) {
+			uint32_t live = NUM_KEYS * loads[i] / 100;
+			uint64_t compact, rehash;
+
+			compact = drop_tombstones(live, false);
+			rehash = drop_tombstones(live, true);
+
+			igt_info("%u%% present, %u%% tombstones: compaction %.3fus, full rehash %.3fus\n",
+				 loads[i], 100 - loads[i],
+				 compact * 1e-3, rehash * 1e-3);
+		}
+	}
+}
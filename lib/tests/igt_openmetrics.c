@@ -0,0 +1,104 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2024 Intel Corporation
+ */
+
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "igt_core.h"
+#include "igt_openmetrics.h"
+
+IGT_TEST_DESCRIPTION("Check the OpenMetrics exporter snapshots and scrapes");
+
+static char *scrape(struct igt_openmetrics *om, const char *request)
+{
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_port = htons(igt_openmetrics_port(om)),
+		.sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+	};
+	static char buf[4096];
+	size_t len = 0;
+	ssize_t ret;
+	int fd;
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	igt_assert_fd(fd);
+	igt_assert_eq(connect(fd, (struct sockaddr *)&addr, sizeof(addr)), 0);
+	igt_assert_eq(write(fd, request, strlen(request)), strlen(request));
+
+	/* The connection is queued, so a single thread can serve it */
+	igt_assert(igt_openmetrics_serve(om, 10000));
+
+	while ((ret = read(fd, buf + len, sizeof(buf) - 1 - len)) > 0)
+		len += ret;
+	buf[len] = '\0';
+	close(fd);
+
+	return buf;
+}
+
+igt_main
+{
+	struct igt_openmetrics *om = NULL;
+
+	igt_fixture {
+		om = igt_openmetrics_listen("127.0.0.1:0");
+		igt_assert(om);
+		igt_assert(igt_openmetrics_port(om) > 0);
+	}
+
+	igt_subtest("empty") {
+		const char *resp = scrape(om, "GET /metrics HTTP/1.1\r\n\r\n");
+
+		igt_assert(!strncmp(resp, "HTTP/1.1 200 OK\r\n", 17));
+		igt_assert(strstr(resp, "Content-Type: application/openmetrics-text"));
+		igt_assert(strstr(resp, "\r\n\r\n# EOF\n"));
+	}
+
+	igt_subtest("snapshot") {
+		const char *resp;
+
+		igt_openmetrics_begin(om);
+		igt_openmetrics_family(om, "test_busy_ratio", "gauge", "Busy");
+		igt_openmetrics_sample(om, "test_busy_ratio", 0.5,
+				       "engine", "rcs0", NULL);
+		igt_openmetrics_sample(om, "test_busy_ratio", 1,
+				       "engine", "a\"b\\c\nd", "gt", "0", NULL);
+		igt_openmetrics_family(om, "test_count", "gauge", "Count");
+		igt_openmetrics_sample(om, "test_count", 3, NULL);
+
+		/* Scrapes see the previous snapshot until committed */
+		resp = scrape(om, "GET / HTTP/1.1\r\n\r\n");
+		igt_assert(!strstr(resp, "test_count"));
+
+		igt_openmetrics_commit(om);
+		resp = scrape(om, "GET / HTTP/1.1\r\n\r\n");
+		igt_assert(strstr(resp,
+				  "\r\n\r\n"
+				  "# TYPE test_busy_ratio gauge\n"
+				  "# HELP test_busy_ratio Busy\n"
+				  "test_busy_ratio{engine=\"rcs0\"} 0.5\n"
+				  "test_busy_ratio{engine=\"a\\\"b\\\\c\\nd\",gt=\"0\"} 1\n"
+				  "# TYPE test_count gauge\n"
+				  "# HELP test_count Count\n"
+				  "test_count 3\n"
+				  "# EOF\n"));
+	}
+
+	igt_subtest("head-and-post") {
+		const char *resp = scrape(om, "HEAD /metrics HTTP/1.1\r\n\r\n");
+
+		igt_assert(!strncmp(resp, "HTTP/1.1 200 OK\r\n", 17));
+		igt_assert(!strstr(resp, "# EOF"));
+
+		resp = scrape(om, "POST /metrics HTTP/1.1\r\n\r\n");
+		igt_assert(!strncmp(resp, "HTTP/1.1 405", 12));
+	}
+
+	igt_fixture
+		igt_openmetrics_close(om);
+}
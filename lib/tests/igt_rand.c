@@ -0,0 +1,82 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2025 Intel Corporation
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "igt_core.h"
+#include "igt_rand.h"
+
+IGT_TEST_DESCRIPTION("Check the igt_rand_fill stream is the same however it is generated");
+
+igt_main
+{
+	igt_subtest("deterministic") {
+		uint8_t a[256], b[256];
+
+		igt_rand_fill(a, sizeof(a), 1);
+		igt_rand_fill(b, sizeof(b), 1);
+		igt_assert(!memcmp(a, b, sizeof(a)));
+
+		igt_rand_fill(b, sizeof(b), 2);
+		igt_assert(memcmp(a, b, sizeof(a)));
+	}
+
+	igt_subtest("offsets-and-alignments") {
+		uint8_t ref[512], buf[512 + 8];
+
+		igt_rand_fill(ref, sizeof(ref), 0xc0ffee);
+
+		/* Covers the head, word and tail paths for all alignments */
+		for (int offset = 0; offset < 16; offset++)
+			for (size_t len = 0; len <= 64; len++)
+				for (int align = 0; align < 8; align++) {
+					memset(buf, 0, sizeof(buf));
+					igt_rand_fill_at(buf + align, len,
+							 0xc0ffee, offset);
+					igt_assert(!memcmp(buf + align,
+							   ref + offset, len));
+					igt_assert_eq(igt_rand_verify_at(buf + align,
+									 len, 0xc0ffee,
+									 offset), -1);
+				}
+	}
+
+	igt_subtest("verify-mismatch") {
+		uint8_t buf[1024];
+
+		igt_rand_fill(buf, sizeof(buf), 3);
+		igt_assert_eq(igt_rand_verify(buf, sizeof(buf), 3), -1);
+
+		for (int i = 0; i < sizeof(buf); i += 61) {
+			buf[i] ^= 0x10;
+			igt_assert_eq(igt_rand_verify(buf, sizeof(buf), 3), i);
+			buf[i] ^= 0x10;
+		}
+	}
+
+	igt_subtest("parallel") {
+		size_t size = (64 << 20) + 13;
+		uint8_t *ref = malloc(size), *buf = malloc(size);
+
+		igt_assert(ref && buf);
+		igt_rand_fill(ref, size, 5);
+
+		for (int threads = 0; threads <= 7; threads++) {
+			memset(buf, 0, size);
+			igt_rand_fill_parallel(buf, size, 5, threads);
+			igt_assert(!memcmp(buf, ref, size));
+			igt_assert_eq(igt_rand_verify_parallel(buf, size, 5,
+							       threads), -1);
+		}
+
+		buf[size - 3] ^= 1;
+		igt_assert_eq(igt_rand_verify_parallel(buf, size, 5, 0),
+			      size - 3);
+
+		free(buf);
+		free(ref);
+	}
+}
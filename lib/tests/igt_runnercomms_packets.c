@@ -3,6 +3,8 @@
  * Copyright © 2022 Intel Corporation
  */
 
+#include <errno.h>
+
 #include "runnercomms.h"
 
 #include "igt_core.h"
@@ -260,4 +262,108 @@ igt_main
 
 		free(packet);
 	}
+
+	igt_subtest_group {
+		struct runnerring *ring;
+		char buf[4096];
+		int memfd;
+
+		igt_fixture {
+			ring = runnerring_create(1024, &memfd);
+			igt_assert(ring);
+		}
+
+		igt_subtest("ring-write-and-read") {
+			for (typeof (*basic_creation) *t = basic_creation; t->create; t++) {
+				struct runnerpacket *packet;
+
+				packet = t->create();
+				igt_assert(runnerring_write(ring, -1, packet, false));
+				free(packet);
+			}
+
+			for (typeof (*basic_creation) *t = basic_creation; t->create; t++) {
+				struct runnerpacket *packet = (struct runnerpacket *)buf;
+
+				igt_assert_lt(0, runnerring_read(ring, buf, sizeof(buf)));
+				t->validate(packet);
+			}
+
+			igt_assert_eq(runnerring_read(ring, buf, sizeof(buf)), 0);
+			igt_assert(ring->waiting);
+		}
+
+		igt_subtest("ring-wraparound") {
+			/* Odd-sized packets to hit every wrap position */
+			for (int i = 0; i < 1000; i++) {
+				struct runnerpacket *packet;
+				runnerpacket_read_helper helper;
+				char text[16];
+
+				snprintf(text, sizeof(text), "%.*s", i % 13, "abcdefghijklm");
+				packet = runnerpacket_log(num8, text);
+				igt_assert(runnerring_write(ring, -1, packet, false));
+				free(packet);
+
+				igt_assert_lt(0, runnerring_read(ring, buf, sizeof(buf)));
+				helper = read_runnerpacket((struct runnerpacket *)buf);
+				igt_assert_eq(helper.type, PACKETTYPE_LOG);
+				igt_assert_eqstr(helper.log.text, text);
+			}
+		}
+
+		igt_subtest("ring-full") {
+			struct runnerpacket *packet;
+			int written = 0;
+
+			packet = runnerpacket_log(num8, text1);
+			while (runnerring_write(ring, -1, packet, false))
+				written++;
+			igt_assert_lt(0, written);
+
+			/* Reading one makes space for one more */
+			igt_assert_lt(0, runnerring_read(ring, buf, sizeof(buf)));
+			igt_assert(runnerring_write(ring, -1, packet, false));
+			igt_assert(!runnerring_write(ring, -1, packet, false));
+
+			while (runnerring_read(ring, buf, sizeof(buf)) > 0)
+				written--;
+			igt_assert_eq(written, 0);
+
+			free(packet);
+		}
+
+		igt_subtest("ring-stalled-writer") {
+			struct runnerpacket *packet;
+			runnerpacket_read_helper helper;
+			uint32_t *hdr;
+
+			/* Reserve a record as a writer dying before its commit would */
+			packet = runnerpacket_log(num8, text1);
+			hdr = (uint32_t *)(ring->data + (ring->head & (ring->size - 1)));
+			*hdr = packet->size;
+			ring->head += (sizeof(*hdr) + packet->size + 3) & ~3u;
+			igt_assert(runnerring_write(ring, -1, packet, false));
+			free(packet);
+
+			igt_assert_eq(runnerring_read(ring, buf, sizeof(buf)), 0);
+			igt_assert_eq(runnerring_read(ring, buf, sizeof(buf)), 0);
+
+			ring->stall_since -= RUNNERRING_STALL_TIMEOUT_US;
+			igt_assert_eq(runnerring_read(ring, buf, sizeof(buf)), -1);
+			igt_assert_eq(errno, EPIPE);
+
+			igt_assert_lt(0, runnerring_read(ring, buf, sizeof(buf)));
+			helper = read_runnerpacket((struct runnerpacket *)buf);
+			igt_assert_eq(helper.type, PACKETTYPE_LOG);
+			igt_assert_eqstr(helper.log.text, text1);
+
+			igt_assert_eq(runnerring_read(ring, buf, sizeof(buf)), 0);
+		}
+
+		igt_fixture {
+			runnerring_destroy(ring);
+			close(memfd);
+		}
+	}
 }
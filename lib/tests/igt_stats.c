@@ -120,6 +120,27 @@ static void test_quartiles(void)
 	igt_stats_fini(&stats);
 }
 
+static void test_percentile(void)
+{
+	static const uint64_t s1[] =
+		{ 47, 49, 6, 7, 15, 36, 39, 40, 41, 42, 43 };
+	igt_stats_t stats;
+
+	igt_stats_init(&stats);
+	igt_assert_eq_double(igt_stats_get_percentile(&stats, 50), 0);
+
+	igt_stats_push_array(&stats, s1, ARRAY_SIZE(s1));
+
+	igt_assert_eq_double(igt_stats_get_percentile(&stats, 0), 6);
+	igt_assert_eq_double(igt_stats_get_percentile(&stats, 10), 7);
+	igt_assert_eq_double(igt_stats_get_percentile(&stats, 50),
+			     igt_stats_get_median(&stats));
+	igt_assert_eq_double(igt_stats_get_percentile(&stats, 95), 48);
+	igt_assert_eq_double(igt_stats_get_percentile(&stats, 100), 49);
+
+	igt_stats_fini(&stats);
+}
+
 static void test_invalidate_sorted(void)
 {
 	igt_stats_t stats;
@@ -228,6 +249,66 @@ static void test_reallocation(void)
 	igt_stats_fini(&stats);
 }
 
+static void test_histogram(void)
+{
+	igt_stats_t exact, hist, half[2];
+	uint64_t lower, upper, count = 0;
+	double q1, q2, q3, e1, e2, e3;
+	unsigned int i;
+
+	igt_stats_init_with_size(&exact, 100000);
+	igt_stats_init_histogram(&hist, 7);
+	igt_stats_init_histogram(&half[0], 7);
+	igt_stats_init_histogram(&half[1], 7);
+
+	for (i = 0; i < 100000; i++) {
+		uint64_t v = (i * 2654435761u) % 1000000;
+
+		igt_stats_push(&exact, v);
+		igt_stats_push(&hist, v);
+		igt_stats_push(&half[i & 1], v);
+	}
+
+	igt_assert_eq(hist.n_values, exact.n_values);
+	igt_assert_eq(igt_stats_get_min(&hist), igt_stats_get_min(&exact));
+	igt_assert_eq(igt_stats_get_max(&hist), igt_stats_get_max(&exact));
+	igt_assert(fabs(igt_stats_get_mean(&hist) -
+			igt_stats_get_mean(&exact)) < 1e-6 * igt_stats_get_mean(&exact));
+	igt_assert(fabs(igt_stats_get_variance(&hist) -
+			igt_stats_get_variance(&exact)) < 1e-6 * igt_stats_get_variance(&exact));
+
+	/* Order statistics within the relative error given by precision */
+	igt_stats_get_quartiles(&exact, &e1, &e2, &e3);
+	igt_stats_get_quartiles(&hist, &q1, &q2, &q3);
+	igt_assert(fabs(q1 - e1) <= e1 / 128);
+	igt_assert(fabs(q2 - e2) <= e2 / 128);
+	igt_assert(fabs(q3 - e3) <= e3 / 128);
+	igt_assert(fabs(igt_stats_get_iqm(&hist) - igt_stats_get_iqm(&exact)) <=
+		   igt_stats_get_iqm(&exact) / 128);
+
+	/* Merged per-thread histograms are equal to the single one */
+	igt_stats_merge(&half[0], &half[1]);
+	igt_assert_eq(half[0].n_values, hist.n_values);
+	igt_assert_eq_double(igt_stats_get_median(&half[0]),
+			     igt_stats_get_median(&hist));
+	igt_assert(fabs(igt_stats_get_mean(&half[0]) -
+			igt_stats_get_mean(&hist)) < 1e-6 * igt_stats_get_mean(&hist));
+
+	for (i = 0; i < igt_stats_get_n_buckets(&hist); i++) {
+		uint64_t n = igt_stats_get_bucket(&hist, i, &lower, &upper);
+
+		igt_assert(lower <= upper);
+		igt_assert(upper - lower <= lower / 128);
+		count += n;
+	}
+	igt_assert_eq(count, hist.n_values);
+
+	igt_stats_fini(&exact);
+	igt_stats_fini(&hist);
+	igt_stats_fini(&half[0]);
+	igt_stats_fini(&half[1]);
+}
+
 igt_simple_main
 {
 	test_init_zero();
@@ -235,9 +316,11 @@ igt_simple_main
 	test_min_max();
 	test_range();
 	test_quartiles();
+	test_percentile();
 	test_invalidate_sorted();
 	test_mean();
 	test_invalidate_mean();
 	test_std_deviation();
 	test_reallocation();
+	test_histogram();
 }
@@ -0,0 +1,78 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2024 Intel Corporation
+ */
+
+#include "igt_core.h"
+#include "igt_vec.h"
+
+IGT_TEST_DESCRIPTION("Exercise igt_vec growth and removal");
+
+static void check_values(struct igt_vec *vec, const uint32_t *values, int count)
+{
+	igt_assert_eq(igt_vec_length(vec), count);
+
+	for (int i = 0; i < count; i++)
+		igt_assert_eq(*(uint32_t *)igt_vec_elem(vec, i), values[i]);
+}
+
+igt_main
+{
+	struct igt_vec vec;
+
+	igt_subtest("inline") {
+		uint32_t values[64];
+
+		igt_vec_init(&vec, sizeof(uint32_t));
+
+		/* Crosses from the inline storage to the heap */
+		for (uint32_t i = 0; i < 64; i++) {
+			values[i] = i;
+			igt_vec_push(&vec, &i);
+			check_values(&vec, values, i + 1);
+		}
+
+		igt_vec_fini(&vec);
+	}
+
+	igt_subtest("push-n") {
+		uint32_t values[1000];
+
+		for (int i = 0; i < 1000; i++)
+			values[i] = i * 3;
+
+		igt_vec_init(&vec, sizeof(uint32_t));
+		igt_vec_push_n(&vec, values, 3);
+		igt_vec_push_n(&vec, values + 3, 997);
+		check_values(&vec, values, 1000);
+		igt_vec_fini(&vec);
+
+		igt_vec_init(&vec, sizeof(uint32_t));
+		igt_vec_reserve(&vec, 1000);
+		igt_assert_lte(1000, vec.size);
+		igt_vec_push_n(&vec, values, 1000);
+		check_values(&vec, values, 1000);
+		igt_vec_fini(&vec);
+	}
+
+	igt_subtest("remove") {
+		uint32_t values[] = { 0, 1, 2, 3, 4, 5 };
+
+		igt_vec_init(&vec, sizeof(uint32_t));
+		igt_vec_push_n(&vec, values, 6);
+
+		igt_vec_remove(&vec, 5);
+		check_values(&vec, (uint32_t[]){ 0, 1, 2, 3, 4 }, 5);
+
+		igt_vec_remove(&vec, 0);
+		check_values(&vec, (uint32_t[]){ 1, 2, 3, 4 }, 4);
+
+		igt_vec_swap_remove(&vec, 0);
+		check_values(&vec, (uint32_t[]){ 4, 2, 3 }, 3);
+
+		igt_vec_swap_remove(&vec, 2);
+		check_values(&vec, (uint32_t[]){ 4, 2 }, 2);
+
+		igt_vec_fini(&vec);
+	}
+}
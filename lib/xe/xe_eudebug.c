@@ -6,6 +6,8 @@
 #include <fcntl.h>
 #include <poll.h>
 #include <signal.h>
+#include <stdatomic.h>
+#include <sys/eventfd.h>
 #include <sys/select.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -1090,6 +1092,214 @@ static void debugger_signal_handler(int sig, siginfo_t *info, void *context)
 		d->received_sigint = true;
 }
 
+/*
+ * Events are drained from the debug fd by the reader thread into a single
+ * producer, single consumer ring and handed to the triggers by the worker
+ * thread, so slow triggers don't let the kernel event queue fill up.
+ * Each record is the time it was read followed by the event, padded to
+ * 8 bytes.
+ */
+#define EVENT_RING_SIZE (8 * 1024 * 1024)
+#define EVENT_READ_BATCH 64
+
+struct xe_eudebug_event_ring {
+	uint8_t *buf;
+	_Atomic(uint64_t) head;
+	_Atomic(uint64_t) tail;
+	_Atomic(uint64_t) produced;
+	_Atomic(uint64_t) consumed;
+	int efd;
+};
+
+static struct xe_eudebug_event_ring *event_ring_create(void)
+{
+	struct xe_eudebug_event_ring *r;
+
+	r = calloc(1, sizeof(*r));
+	igt_assert(r);
+	r->buf = malloc(EVENT_RING_SIZE);
+	igt_assert(r->buf);
+	r->efd = eventfd(0, EFD_NONBLOCK);
+	igt_assert_lte(0, r->efd);
+
+	return r;
+}
+
+static void event_ring_destroy(struct xe_eudebug_event_ring *r)
+{
+	close(r->efd);
+	free(r->buf);
+	free(r);
+}
+
+static void event_ring_copy(struct xe_eudebug_event_ring *r, uint64_t pos,
+			    void *data, size_t len, bool in)
+{
+	size_t off = pos & (EVENT_RING_SIZE - 1);
+	size_t first = min_t(size_t, len, EVENT_RING_SIZE - off);
+
+	if (in) {
+		memcpy(r->buf + off, data, first);
+		memcpy(r->buf, (uint8_t *)data + first, len - first);
+	} else {
+		memcpy(data, r->buf + off, first);
+		memcpy((uint8_t *)data + first, r->buf, len - first);
+	}
+}
+
+/* Returns the queue depth after the push, 0 if the ring is full */
+static uint64_t event_ring_push(struct xe_eudebug_event_ring *r,
+				struct drm_xe_eudebug_event *e, uint64_t ts)
+{
+	uint64_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+	uint64_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+	size_t len = ALIGN(sizeof(ts) + e->len, 8);
+
+	if (EVENT_RING_SIZE - (head - tail) < len)
+		return 0;
+
+	event_ring_copy(r, head, &ts, sizeof(ts), true);
+	event_ring_copy(r, head + sizeof(ts), e, e->len, true);
+	atomic_store_explicit(&r->head, head + len, memory_order_release);
+
+	return atomic_fetch_add(&r->produced, 1) + 1 -
+	       atomic_load(&r->consumed);
+}
+
+static bool event_ring_pop(struct xe_eudebug_event_ring *r,
+			   struct drm_xe_eudebug_event *e, uint64_t *ts)
+{
+	uint64_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+	uint64_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+	struct drm_xe_eudebug_event hdr;
+
+	if (head == tail)
+		return false;
+
+	event_ring_copy(r, tail, ts, sizeof(*ts), false);
+	event_ring_copy(r, tail + sizeof(*ts), &hdr, sizeof(hdr), false);
+	event_ring_copy(r, tail + sizeof(*ts), e, hdr.len, false);
+	atomic_store_explicit(&r->tail, tail + ALIGN(sizeof(*ts) + hdr.len, 8),
+			      memory_order_release);
+	atomic_fetch_add(&r->consumed, 1);
+
+	return true;
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	igt_assert_eq(clock_gettime(CLOCK_MONOTONIC, &ts), 0);
+
+	return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static bool debugger_worker_stopped(struct xe_eudebug_debugger *d)
+{
+	return READ_ONCE(d->worker_state) == DEBUGGER_WORKER_INACTIVE ||
+	       READ_ONCE(d->received_sigint);
+}
+
+/* Reads up to EVENT_READ_BATCH events which are ready, returns their number */
+static unsigned int debugger_read_batch(struct xe_eudebug_debugger *d,
+					struct drm_xe_eudebug_event *e)
+{
+	struct xe_eudebug_event_ring *r = d->ring;
+	struct pollfd p = { .fd = d->fd, .events = POLLIN };
+	unsigned int n = 0;
+	uint64_t depth;
+
+	do {
+		int err = xe_eudebug_read_event(d->fd, e);
+
+		if (err) {
+			igt_info("xe_eudebug_read_event returned %d\n", err);
+			break;
+		}
+
+		while (!(depth = event_ring_push(r, e, now_ns()))) {
+			if (debugger_worker_stopped(d))
+				return n;
+			usleep(100);
+		}
+		d->stats.max_queue_depth = max(d->stats.max_queue_depth, depth);
+		n++;
+	} while (n < EVENT_READ_BATCH && poll(&p, 1, 0) == 1 &&
+		 (p.revents & POLLIN));
+
+	return n;
+}
+
+static void *debugger_reader_loop(void *data)
+{
+	uint8_t buf[MAX_EVENT_SIZE];
+	struct drm_xe_eudebug_event *e = (void *)buf;
+	struct xe_eudebug_debugger *d = data;
+	struct pollfd p = {
+		.events = POLLIN,
+		.revents = 0,
+	};
+	int timeout_ms = 100, ret;
+	sigset_t mask;
+
+	/* Signals are for the worker, which runs the triggers */
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGINT);
+	sigaddset(&mask, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+	do {
+		p.fd = d->fd;
+		ret = poll(&p, 1, timeout_ms);
+		if (debugger_worker_stopped(d))
+			break;
+
+		if (ret == -1) {
+			if (errno == EINTR)
+				continue;
+
+			igt_info("poll failed with errno %d\n", errno);
+			break;
+		}
+
+		if (ret == 1 && (p.revents & POLLIN)) {
+			unsigned int n = debugger_read_batch(d, e);
+
+			if (n) {
+				d->stats.batches++;
+				d->stats.max_batch = max_t(uint64_t,
+							   d->stats.max_batch, n);
+				igt_assert_eq(eventfd_write(d->ring->efd, 1), 0);
+			}
+		}
+	} while ((ret && READ_ONCE(d->worker_state) == DEBUGGER_WORKER_QUITTING) ||
+		 READ_ONCE(d->worker_state) == DEBUGGER_WORKER_ACTIVE);
+
+	WRITE_ONCE(d->reader_done, true);
+	eventfd_write(d->ring->efd, 1);
+
+	return NULL;
+}
+
+static void debugger_handle_events(struct xe_eudebug_debugger *d,
+				   struct drm_xe_eudebug_event *e)
+{
+	uint64_t ts, latency;
+
+	while (!READ_ONCE(d->received_sigint) && event_ring_pop(d->ring, e, &ts)) {
+		++d->event_count;
+
+		xe_eudebug_event_log_write(d->log, e);
+		debugger_run_triggers(d, e);
+
+		latency = now_ns() - ts;
+		d->stats.events++;
+		d->stats.latency_total_ns += latency;
+		d->stats.latency_max_ns = max(d->stats.latency_max_ns, latency);
+	}
+}
+
 static void *debugger_worker_loop(void *data)
 {
 	uint8_t buf[MAX_EVENT_SIZE];
@@ -1101,6 +1311,7 @@ static void *debugger_worker_loop(void *data)
 	};
 	int timeout_ms = 100, ret;
 	struct sigaction sa = { 0 };
+	eventfd_t val;
 
 	igt_assert(d->master_fd >= 0);
 
@@ -1115,7 +1326,7 @@ static void *debugger_worker_loop(void *data)
 	igt_assert_eq(sigaction(SIGTERM, &sa, NULL), 0);
 
 	do {
-		p.fd = d->fd;
+		p.fd = d->ring->efd;
 		ret = poll(&p, 1, timeout_ms);
 		if (d->received_sigint) {
 			d->handled_sigint = true;
@@ -1134,20 +1345,16 @@ static void *debugger_worker_loop(void *data)
 			break;
 		}
 
-		if (ret == 1 && (p.revents & POLLIN)) {
-			int err = xe_eudebug_read_event(d->fd, e);
+		if (ret == 1)
+			eventfd_read(d->ring->efd, &val);
 
-			if (!err) {
-				++d->event_count;
+		debugger_handle_events(d, e);
+	} while (!READ_ONCE(d->reader_done) &&
+		 READ_ONCE(d->worker_state) != DEBUGGER_WORKER_INACTIVE);
 
-				xe_eudebug_event_log_write(d->log, e);
-				debugger_run_triggers(d, e);
-			} else {
-				igt_info("xe_eudebug_read_event returned %d\n", ret);
-			}
-		}
-	} while ((ret && READ_ONCE(d->worker_state) == DEBUGGER_WORKER_QUITTING) ||
-		 READ_ONCE(d->worker_state) == DEBUGGER_WORKER_ACTIVE);
+	/* Whatever the reader queued before it quit */
+	if (READ_ONCE(d->worker_state) != DEBUGGER_WORKER_INACTIVE)
+		debugger_handle_events(d, e);
 
 	d->worker_state = DEBUGGER_WORKER_INACTIVE;
 
@@ -1341,16 +1548,24 @@ void xe_eudebug_debugger_remove_trigger(struct xe_eudebug_debugger *d,
  *
  * Starts the debugger worker. Worker is resposible for reading all
  * incoming events from the debugger, put then into debugger log and
- * execute appropriate event triggers. Note that using the debuggers
+ * execute appropriate event triggers. Events are read by a separate
+ * reader thread and queued for the worker, so the kernel event queue
+ * is drained while triggers run. Note that using the debuggers
  * event log while worker is running is not safe.
  */
 void xe_eudebug_debugger_start_worker(struct xe_eudebug_debugger *d)
 {
 	int ret;
 
+	memset(&d->stats, 0, sizeof(d->stats));
+	d->ring = event_ring_create();
+	d->reader_done = false;
 	d->worker_state = DEBUGGER_WORKER_ACTIVE;
-	ret = pthread_create(&d->worker_thread, NULL, &debugger_worker_loop, d);
 
+	ret = pthread_create(&d->reader_thread, NULL, &debugger_reader_loop, d);
+	igt_assert_f(ret == 0, "Debugger reader thread creation failed!");
+
+	ret = pthread_create(&d->worker_thread, NULL, &debugger_worker_loop, d);
 	igt_assert_f(ret == 0, "Debugger worker thread creation failed!");
 }
 
@@ -1358,7 +1573,8 @@ void xe_eudebug_debugger_start_worker(struct xe_eudebug_debugger *d)
  * xe_eudebug_debugger_stop_worker:
  * @d: pointer to the debugger
  *
- * Stops the debugger worker. Event log is sorted by seqno after closure.
+ * Stops the debugger worker and its reader. Event log is sorted by seqno
+ * after closure.
  */
 void xe_eudebug_debugger_stop_worker(struct xe_eudebug_debugger *d,
 				     int timeout_s)
@@ -1382,6 +1598,19 @@ void xe_eudebug_debugger_stop_worker(struct xe_eudebug_debugger *d,
 	igt_assert_f(ret == 0 || ret != ESRCH,
 		     "pthread join failed with error %d!\n", ret);
 
+	ret = pthread_join(d->reader_thread, NULL);
+	igt_assert_f(ret == 0, "pthread join failed with error %d!\n", ret);
+	event_ring_destroy(d->ring);
+	d->ring = NULL;
+
+	igt_debug("debugger: %" PRIu64 " events in %" PRIu64 " reads, "
+		  "max batch %" PRIu64 ", max queue depth %" PRIu64 ", "
+		  "latency avg %" PRIu64 "ns max %" PRIu64 "ns\n",
+		  d->stats.events, d->stats.batches, d->stats.max_batch,
+		  d->stats.max_queue_depth,
+		  d->stats.events ? d->stats.latency_total_ns / d->stats.events : 0,
+		  d->stats.latency_max_ns);
+
 	event_log_sort(d->log);
 }
 
@@ -24,6 +24,30 @@ enum xe_eudebug_debugger_worker_state {
 	DEBUGGER_WORKER_QUITTING,
 };
 
+/**
+ * struct xe_eudebug_debugger_stats:
+ * @events: events handed to the triggers
+ * @batches: wakeups of the reader which read at least one event
+ * @max_batch: most events read in a single wakeup
+ * @max_queue_depth: most events read but not handled yet
+ * @latency_total_ns: sum of the times from reading events to having run
+ *		      their triggers
+ * @latency_max_ns: longest of those times
+ *
+ * Measures how quickly the debugger services events, valid once the worker
+ * is stopped.
+ */
+struct xe_eudebug_debugger_stats {
+	uint64_t events;
+	uint64_t batches;
+	uint64_t max_batch;
+	uint64_t max_queue_depth;
+	uint64_t latency_total_ns;
+	uint64_t latency_max_ns;
+};
+
+struct xe_eudebug_event_ring;
+
 struct xe_eudebug_debugger {
 	int fd;
 	uint64_t flags;
@@ -44,6 +68,12 @@ struct xe_eudebug_debugger {
 	pthread_t worker_thread;
 	enum xe_eudebug_debugger_worker_state worker_state;
 
+	/* Reads events into the ring, the worker runs their triggers */
+	pthread_t reader_thread;
+	struct xe_eudebug_event_ring *ring;
+	bool reader_done;
+	struct xe_eudebug_debugger_stats stats;
+
 	bool received_sigint;
 	bool handled_sigint;
 	bool received_signal;
@@ -332,6 +332,216 @@ void xe_vm_unbind_sync(int fd, uint32_t vm, uint64_t offset,
 	__xe_vm_bind_sync(fd, vm, 0, offset, addr, size, DRM_XE_VM_BIND_OP_UNMAP);
 }
 
+/**
+ * xe_bind_queue_create:
+ * @fd: xe device fd
+ * @vm: vm to bind to
+ *
+ * Creates a bind queue for @vm with its own bind exec queue and timeline
+ * syncobj. The queue signals syncobjs, so it can't be used with vms in
+ * long running mode which only accept user fences.
+ *
+ * Returns: the bind queue, to be released with xe_bind_queue_destroy().
+ */
+struct xe_bind_queue *xe_bind_queue_create(int fd, uint32_t vm)
+{
+	struct xe_bind_queue *bq;
+
+	bq = calloc(1, sizeof(*bq));
+	igt_assert(bq);
+
+	bq->fd = fd;
+	bq->vm = vm;
+	bq->exec_queue = xe_bind_exec_queue_create(fd, vm, 0);
+	bq->syncobj = syncobj_create(fd, 0);
+
+	return bq;
+}
+
+/**
+ * xe_bind_queue_destroy:
+ * @bq: bind queue
+ *
+ * Waits for the flushed operations and releases the queue. Operations
+ * which were never flushed are dropped.
+ */
+void xe_bind_queue_destroy(struct xe_bind_queue *bq)
+{
+	if (!bq)
+		return;
+
+	xe_bind_queue_wait(bq);
+	syncobj_destroy(bq->fd, bq->syncobj);
+	xe_exec_queue_destroy(bq->fd, bq->exec_queue);
+	free(bq->ops);
+	free(bq);
+}
+
+/**
+ * xe_bind_queue_add:
+ * @bq: bind queue
+ * @op: operation to queue
+ *
+ * Queues a copy of @op until the next xe_bind_queue_flush(). Operations
+ * are applied in the order they were queued, DEFAULT_PAT_INDEX of map
+ * operations is replaced with the write-back pat index.
+ */
+void xe_bind_queue_add(struct xe_bind_queue *bq,
+		       const struct drm_xe_vm_bind_op *op)
+{
+	const uint32_t inc = 4096 / sizeof(*bq->ops);
+	struct drm_xe_vm_bind_op *new;
+
+	if (bq->num_ops == bq->allocated_ops) {
+		bq->ops = realloc(bq->ops, sizeof(*bq->ops) *
+				  (inc + bq->allocated_ops));
+		igt_assert(bq->ops);
+		bq->allocated_ops += inc;
+	}
+
+	new = &bq->ops[bq->num_ops++];
+	*new = *op;
+	if (new->pat_index == DEFAULT_PAT_INDEX)
+		new->pat_index = intel_get_pat_idx_wb(bq->fd);
+}
+
+/**
+ * xe_bind_queue_map:
+ * @bq: bind queue
+ * @bo: buffer object to map
+ * @offset: offset within @bo
+ * @addr: gpu virtual address
+ * @size: size of the mapping
+ * @pat_index: pat index, DEFAULT_PAT_INDEX for write-back
+ * @flags: DRM_XE_VM_BIND_FLAG_* flags
+ *
+ * Queues a map operation, see xe_bind_queue_add().
+ */
+void xe_bind_queue_map(struct xe_bind_queue *bq, uint32_t bo, uint64_t offset,
+		       uint64_t addr, uint64_t size, uint8_t pat_index,
+		       uint32_t flags)
+{
+	struct drm_xe_vm_bind_op op = {
+		.obj = bo,
+		.obj_offset = offset,
+		.range = size,
+		.addr = addr,
+		.op = DRM_XE_VM_BIND_OP_MAP,
+		.flags = flags,
+		.pat_index = pat_index,
+	};
+
+	xe_bind_queue_add(bq, &op);
+}
+
+/**
+ * xe_bind_queue_unmap:
+ * @bq: bind queue
+ * @addr: gpu virtual address
+ * @size: size of the range
+ *
+ * Queues an unmap operation, see xe_bind_queue_add().
+ */
+void xe_bind_queue_unmap(struct xe_bind_queue *bq, uint64_t addr,
+			 uint64_t size)
+{
+	struct drm_xe_vm_bind_op op = {
+		.range = size,
+		.addr = addr,
+		.op = DRM_XE_VM_BIND_OP_UNMAP,
+	};
+
+	xe_bind_queue_add(bq, &op);
+}
+
+/**
+ * xe_bind_queue_flush:
+ * @bq: bind queue
+ * @syncs: additional syncs of the bind, may be NULL
+ * @num_syncs: number of @syncs
+ *
+ * Submits the queued operations in a single bind ioctl, which signals the
+ * next point of the queue's timeline besides @syncs. Flushes are executed
+ * in order, without the CPU waiting for them. Nothing is submitted, and
+ * @syncs are ignored, if no operation was queued.
+ *
+ * Returns: the timeline point signalled by the last submitted flush.
+ */
+uint64_t xe_bind_queue_flush(struct xe_bind_queue *bq,
+			     struct drm_xe_sync *syncs, uint32_t num_syncs)
+{
+	struct drm_xe_sync all[XE_BIND_QUEUE_MAX_SYNCS];
+	struct drm_xe_vm_bind_op *op = bq->ops;
+
+	if (!bq->num_ops)
+		return bq->point;
+
+	igt_assert(num_syncs < XE_BIND_QUEUE_MAX_SYNCS);
+	all[0] = (struct drm_xe_sync) {
+		.type = DRM_XE_SYNC_TYPE_TIMELINE_SYNCOBJ,
+		.flags = DRM_XE_SYNC_FLAG_SIGNAL,
+		.handle = bq->syncobj,
+		.timeline_value = bq->point + 1,
+	};
+	if (num_syncs)
+		memcpy(&all[1], syncs, num_syncs * sizeof(*syncs));
+
+	if (bq->num_ops > 1)
+		xe_vm_bind_array(bq->fd, bq->vm, bq->exec_queue, bq->ops,
+				 bq->num_ops, all, num_syncs + 1);
+	else
+		igt_assert_eq(___xe_vm_bind(bq->fd, bq->vm, bq->exec_queue,
+					    op->obj, op->obj_offset, op->addr,
+					    op->range, op->op, op->flags,
+					    all, num_syncs + 1,
+					    op->prefetch_mem_region_instance,
+					    op->pat_index, 0, op->extensions), 0);
+
+	bq->num_ops = 0;
+
+	return ++bq->point;
+}
+
+/**
+ * xe_bind_queue_fence:
+ * @bq: bind queue
+ * @sync: sync to fill
+ *
+ * Fills @sync with a wait on the last flush of @bq, to make an exec or
+ * another bind depend on it.
+ *
+ * Returns: false, leaving @sync untouched, if nothing was flushed yet.
+ */
+bool xe_bind_queue_fence(struct xe_bind_queue *bq, struct drm_xe_sync *sync)
+{
+	if (!bq->point)
+		return false;
+
+	*sync = (struct drm_xe_sync) {
+		.type = DRM_XE_SYNC_TYPE_TIMELINE_SYNCOBJ,
+		.handle = bq->syncobj,
+		.timeline_value = bq->point,
+	};
+
+	return true;
+}
+
+/**
+ * xe_bind_queue_wait:
+ * @bq: bind queue
+ *
+ * Waits until all flushed operations of @bq are complete.
+ */
+void xe_bind_queue_wait(struct xe_bind_queue *bq)
+{
+	if (!bq->point)
+		return;
+
+	igt_assert_eq(syncobj_timeline_wait_err(bq->fd, &bq->syncobj,
+						&bq->point, 1, INT64_MAX,
+						DRM_SYNCOBJ_WAIT_FLAGS_WAIT_ALL), 0);
+}
+
 void xe_vm_destroy(int fd, uint32_t vm)
 {
 	struct drm_xe_vm_destroy destroy = {
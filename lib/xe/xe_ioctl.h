@@ -11,12 +11,42 @@
 #ifndef XE_IOCTL_H
 #define XE_IOCTL_H
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <xe_drm.h>
 
 #define DRM_XE_UFENCE_WAIT_MASK_U64    0xffffffffffffffffu
 
+#define XE_BIND_QUEUE_MAX_SYNCS	8
+
+/**
+ * struct xe_bind_queue:
+ * @fd: xe device fd
+ * @vm: vm the operations are applied to
+ * @exec_queue: bind exec queue the operations are submitted to
+ * @syncobj: timeline syncobj signalled by each flush
+ * @point: timeline point of the last flush, 0 if nothing was flushed yet
+ * @ops: operations queued since the last flush
+ * @num_ops: number of queued operations
+ * @allocated_ops: size of @ops
+ *
+ * Accumulates bind and unbind operations of a vm and submits them as a
+ * single array on a dedicated bind exec queue, so consecutive flushes are
+ * pipelined and execs can wait on the timeline point of the last flush
+ * instead of the CPU waiting for the binds.
+ */
+struct xe_bind_queue {
+	int fd;
+	uint32_t vm;
+	uint32_t exec_queue;
+	uint32_t syncobj;
+	uint64_t point;
+	struct drm_xe_vm_bind_op *ops;
+	uint32_t num_ops;
+	uint32_t allocated_ops;
+};
+
 uint32_t xe_cs_prefetch_size(int fd);
 uint64_t xe_bb_size(int fd, uint64_t reqsize);
 uint32_t xe_vm_create(int fd, uint32_t flags, uint64_t ext);
@@ -65,6 +95,19 @@ void xe_vm_bind_array(int fd, uint32_t vm, uint32_t exec_queue,
 void xe_vm_unbind_all_async(int fd, uint32_t vm, uint32_t exec_queue,
 			    uint32_t bo, struct drm_xe_sync *sync,
 			    uint32_t num_syncs);
+struct xe_bind_queue *xe_bind_queue_create(int fd, uint32_t vm);
+void xe_bind_queue_destroy(struct xe_bind_queue *bq);
+void xe_bind_queue_add(struct xe_bind_queue *bq,
+		       const struct drm_xe_vm_bind_op *op);
+void xe_bind_queue_map(struct xe_bind_queue *bq, uint32_t bo, uint64_t offset,
+		       uint64_t addr, uint64_t size, uint8_t pat_index,
+		       uint32_t flags);
+void xe_bind_queue_unmap(struct xe_bind_queue *bq, uint64_t addr,
+			 uint64_t size);
+uint64_t xe_bind_queue_flush(struct xe_bind_queue *bq,
+			     struct drm_xe_sync *syncs, uint32_t num_syncs);
+bool xe_bind_queue_fence(struct xe_bind_queue *bq, struct drm_xe_sync *sync);
+void xe_bind_queue_wait(struct xe_bind_queue *bq);
 void xe_vm_destroy(int fd, uint32_t vm);
 uint32_t __xe_bo_create(int fd, uint32_t vm, uint64_t size, uint32_t placement,
 			uint32_t flags, void *ext, uint32_t *handle);
@@ -10,13 +10,16 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/sysmacros.h>
 #include <sys/types.h>
 #include <unistd.h>
 
 #include "drmtest.h"
+#include "igt_x86.h"
 #include "intel_chipset.h"
 #include "intel_hwconfig_types.h"
 #include "ioctl_wrappers.h"
@@ -162,13 +165,14 @@ is_acm_gt3(const struct intel_xe_perf_devinfo *devinfo)
 
 #undef DEVID
 
-struct intel_xe_perf *
-intel_xe_perf_for_devinfo(uint32_t device_id,
-			  uint32_t revision,
-			  uint64_t timestamp_frequency,
-			  uint64_t gt_min_freq,
-			  uint64_t gt_max_freq,
-			  const struct intel_xe_topology_info *topology)
+static struct intel_xe_perf *
+xe_perf_for_devinfo(uint32_t device_id,
+		    uint32_t revision,
+		    uint64_t timestamp_frequency,
+		    uint64_t gt_min_freq,
+		    uint64_t gt_max_freq,
+		    const struct intel_xe_topology_info *topology,
+		    bool lazy)
 {
 	const struct intel_device_info *devinfo = intel_get_device_info(device_id);
 	struct intel_xe_perf *perf;
@@ -262,21 +266,21 @@ intel_xe_perf_for_devinfo(uint32_t device_id,
 	if (devinfo->is_tigerlake) {
 		switch (devinfo->gt) {
 		case 1:
-			intel_xe_perf_load_metrics_tglgt1(perf);
+			intel_xe_perf_register_metrics_tglgt1(perf);
 			break;
 		case 2:
-			intel_xe_perf_load_metrics_tglgt2(perf);
+			intel_xe_perf_register_metrics_tglgt2(perf);
 			break;
 		default:
 			return unsupported_xe_oa_platform(perf);
 		}
 	} else if (devinfo->is_rocketlake) {
-		intel_xe_perf_load_metrics_rkl(perf);
+		intel_xe_perf_register_metrics_rkl(perf);
 	} else if (devinfo->is_dg1) {
-		intel_xe_perf_load_metrics_dg1(perf);
+		intel_xe_perf_register_metrics_dg1(perf);
 	} else if (devinfo->is_alderlake_s || devinfo->is_alderlake_p ||
 		   devinfo->is_raptorlake_s || devinfo->is_alderlake_n) {
-		intel_xe_perf_load_metrics_adl(perf);
+		intel_xe_perf_register_metrics_adl(perf);
 	} else if (devinfo->is_dg2) {
 		perf->devinfo.eu_threads_count = 8;
 		/* OA reports have the timestamp value shifted to the
@@ -287,31 +291,64 @@ intel_xe_perf_for_devinfo(uint32_t device_id,
 		perf->devinfo.oa_timestamp_mask = 0x7fffffff;
 
 		if (is_acm_gt1(&perf->devinfo))
-			intel_xe_perf_load_metrics_acmgt1(perf);
+			intel_xe_perf_register_metrics_acmgt1(perf);
 		else if (is_acm_gt2(&perf->devinfo))
-			intel_xe_perf_load_metrics_acmgt2(perf);
+			intel_xe_perf_register_metrics_acmgt2(perf);
 		else if (is_acm_gt3(&perf->devinfo))
-			intel_xe_perf_load_metrics_acmgt3(perf);
+			intel_xe_perf_register_metrics_acmgt3(perf);
 		else
 			return unsupported_xe_oa_platform(perf);
 	} else if (devinfo->is_pontevecchio) {
 		perf->devinfo.eu_threads_count = 8;
-		intel_xe_perf_load_metrics_pvc(perf);
+		intel_xe_perf_register_metrics_pvc(perf);
 	} else if (devinfo->is_lunarlake) {
-		intel_xe_perf_load_metrics_lnl(perf);
+		intel_xe_perf_register_metrics_lnl(perf);
 	} else if (devinfo->is_battlemage) {
-		intel_xe_perf_load_metrics_bmg(perf);
+		intel_xe_perf_register_metrics_bmg(perf);
 	} else if (devinfo->is_pantherlake) {
-		intel_xe_perf_load_metrics_ptl(perf);
+		intel_xe_perf_register_metrics_ptl(perf);
 	} else if (intel_graphics_ver(device_id) >= IP_VER(20, 0)) {
-		intel_xe_perf_load_metrics_lnl(perf);
+		intel_xe_perf_register_metrics_lnl(perf);
 	} else {
 		return unsupported_xe_oa_platform(perf);
 	}
 
+	if (!lazy)
+		intel_xe_perf_load_metric_sets(perf);
+
 	return perf;
 }
 
+struct intel_xe_perf *
+intel_xe_perf_for_devinfo(uint32_t device_id,
+			  uint32_t revision,
+			  uint64_t timestamp_frequency,
+			  uint64_t gt_min_freq,
+			  uint64_t gt_max_freq,
+			  const struct intel_xe_topology_info *topology)
+{
+	return xe_perf_for_devinfo(device_id, revision, timestamp_frequency,
+				   gt_min_freq, gt_max_freq, topology, false);
+}
+
+/*
+ * Same as intel_xe_perf_for_devinfo() but only registers the metric sets of
+ * the platform, they get instantiated on demand by
+ * intel_xe_perf_find_metric_set() or all at once by
+ * intel_xe_perf_load_metric_sets().
+ */
+struct intel_xe_perf *
+intel_xe_perf_for_devinfo_lazy(uint32_t device_id,
+			       uint32_t revision,
+			       uint64_t timestamp_frequency,
+			       uint64_t gt_min_freq,
+			       uint64_t gt_max_freq,
+			       const struct intel_xe_topology_info *topology)
+{
+	return xe_perf_for_devinfo(device_id, revision, timestamp_frequency,
+				   gt_min_freq, gt_max_freq, topology, true);
+}
+
 static bool
 read_fd_uint64(int fd, uint64_t *out_value)
 {
@@ -546,7 +583,7 @@ next:
 }
 
 static struct intel_xe_perf *
-xe_perf_for_fd(int drm_fd, int gt)
+xe_perf_for_fd(int drm_fd, int gt, bool lazy)
 {
 	uint32_t device_id;
 	uint32_t device_revision = 0;
@@ -587,12 +624,13 @@ xe_perf_for_fd(int drm_fd, int gt)
 		return NULL;
 	}
 
-	ret = intel_xe_perf_for_devinfo(device_id,
-				     device_revision,
-				     oau->oa_timestamp_freq,
-				     gt_min_freq * 1000000,
-				     gt_max_freq * 1000000,
-				     topology);
+	ret = xe_perf_for_devinfo(device_id,
+				  device_revision,
+				  oau->oa_timestamp_freq,
+				  gt_min_freq * 1000000,
+				  gt_max_freq * 1000000,
+				  topology,
+				  lazy);
 	if (!ret)
 		igt_warn("intel_xe_perf_for_devinfo failed\n");
 
@@ -607,7 +645,16 @@ intel_xe_perf_for_fd(int drm_fd, int gt)
 	if (!is_xe_device(drm_fd))
 		return NULL;
 
-	return xe_perf_for_fd(drm_fd, gt);
+	return xe_perf_for_fd(drm_fd, gt, false);
+}
+
+struct intel_xe_perf *
+intel_xe_perf_for_fd_lazy(int drm_fd, int gt)
+{
+	if (!is_xe_device(drm_fd))
+		return NULL;
+
+	return xe_perf_for_fd(drm_fd, gt, true);
 }
 
 void
@@ -622,6 +669,7 @@ intel_xe_perf_free(struct intel_xe_perf *perf)
 		intel_xe_perf_metric_set_free(metric_set);
 	}
 
+	free(perf->loaded_metric_sets);
 	free(perf);
 }
 
@@ -669,6 +717,52 @@ intel_xe_perf_add_metric_set(struct intel_xe_perf *perf,
 	igt_list_add_tail(&metric_set->link, &perf->metric_sets);
 }
 
+void
+intel_xe_perf_register_metric_sets(struct intel_xe_perf *perf,
+				   const struct intel_xe_perf_metric_set_desc *descs,
+				   uint32_t n_descs)
+{
+	igt_assert(!perf->metric_set_descs);
+
+	perf->metric_set_descs = descs;
+	perf->n_metric_set_descs = n_descs;
+	perf->loaded_metric_sets = calloc(n_descs, sizeof(*perf->loaded_metric_sets));
+}
+
+static struct intel_xe_perf_metric_set *
+load_metric_set(struct intel_xe_perf *perf, uint32_t index)
+{
+	if (!perf->loaded_metric_sets[index])
+		perf->loaded_metric_sets[index] = perf->metric_set_descs[index].add(perf);
+
+	return perf->loaded_metric_sets[index];
+}
+
+struct intel_xe_perf_metric_set *
+intel_xe_perf_find_metric_set(struct intel_xe_perf *perf, const char *symbol_name)
+{
+	struct intel_xe_perf_metric_set *metric_set;
+
+	igt_list_for_each_entry(metric_set, &perf->metric_sets, link) {
+		if (!strcasecmp(metric_set->symbol_name, symbol_name))
+			return metric_set;
+	}
+
+	for (uint32_t i = 0; i < perf->n_metric_set_descs; i++) {
+		if (!strcasecmp(perf->metric_set_descs[i].symbol_name, symbol_name))
+			return load_metric_set(perf, i);
+	}
+
+	return NULL;
+}
+
+void
+intel_xe_perf_load_metric_sets(struct intel_xe_perf *perf)
+{
+	for (uint32_t i = 0; i < perf->n_metric_set_descs; i++)
+		load_metric_set(perf, i);
+}
+
 static void
 load_metric_set_config(struct intel_xe_perf_metric_set *metric_set, int drm_fd)
 {
@@ -763,161 +857,399 @@ intel_xe_perf_load_perf_configs(struct intel_xe_perf *perf, int drm_fd)
 	}
 }
 
+/*
+ * The accumulation helpers operate on runs of @n consecutive counters. The
+ * 40bit A counters keep their low 32 bits in dword 4 + a_index of a report
+ * and their high 8 bits in byte a_index starting at dword 40.
+ */
 static void
 accumulate_uint32(const uint32_t *report0,
                   const uint32_t *report1,
-                  uint64_t *deltas)
+                  uint64_t *deltas,
+                  int n)
+{
+	for (int i = 0; i < n; i++)
+		deltas[i] += (uint32_t)(report1[i] - report0[i]);
+}
+
+static inline uint64_t
+read_uint40(const uint32_t *report, int a_index)
 {
-	*deltas += (uint32_t)(*report1 - *report0);
+	const uint8_t *high_bytes = (const uint8_t *)(report + 40);
+
+	return report[a_index + 4] | (uint64_t)high_bytes[a_index] << 32;
 }
 
 static void
 accumulate_uint40(int a_index,
                   const uint32_t *report0,
                   const uint32_t *report1,
-                  uint64_t *deltas)
-{
-	const uint8_t *high_bytes0 = (uint8_t *)(report0 + 40);
-	const uint8_t *high_bytes1 = (uint8_t *)(report1 + 40);
-	uint64_t high0 = (uint64_t)(high_bytes0[a_index]) << 32;
-	uint64_t high1 = (uint64_t)(high_bytes1[a_index]) << 32;
-	uint64_t value0 = report0[a_index + 4] | high0;
-	uint64_t value1 = report1[a_index + 4] | high1;
-	uint64_t delta;
-
-	if (value0 > value1)
-		delta = (1ULL << 40) + value1 - value0;
+                  uint64_t *deltas,
+                  int n)
+{
+	/* Both values are below 2^40, so masking also handles wraparound. */
+	for (int i = 0; i < n; i++)
+		deltas[i] += (read_uint40(report1, a_index + i) -
+			      read_uint40(report0, a_index + i)) & ((1ULL << 40) - 1);
+}
+
+static void
+accumulate_uint64(const uint64_t *report0,
+                  const uint64_t *report1,
+                  uint64_t *deltas,
+                  int n)
+{
+	for (int i = 0; i < n; i++)
+		deltas[i] += report1[i] - report0[i];
+}
+
+typedef void (*accumulate_uint32_fn)(const uint32_t *report0,
+				     const uint32_t *report1,
+				     uint64_t *deltas, int n);
+typedef void (*accumulate_uint40_fn)(int a_index,
+				     const uint32_t *report0,
+				     const uint32_t *report1,
+				     uint64_t *deltas, int n);
+typedef void (*accumulate_uint64_fn)(const uint64_t *report0,
+				     const uint64_t *report1,
+				     uint64_t *deltas, int n);
+
+static inline uint32_t
+timestamp_delta32(const struct intel_xe_perf *perf, uint32_t delta)
+{
+	if (perf->devinfo.oa_timestamp_shift >= 0)
+		return delta << perf->devinfo.oa_timestamp_shift;
 	else
-		delta = value1 - value0;
+		return delta >> (-perf->devinfo.oa_timestamp_shift);
+}
 
-	*deltas += delta;
+static inline uint64_t
+timestamp_delta64(const struct intel_xe_perf *perf, uint64_t delta)
+{
+	if (perf->devinfo.oa_timestamp_shift >= 0)
+		return delta << perf->devinfo.oa_timestamp_shift;
+	else
+		return delta >> (-perf->devinfo.oa_timestamp_shift);
 }
 
-void intel_xe_perf_accumulate_reports(struct intel_xe_perf_accumulator *acc,
-				      const struct intel_xe_perf *perf,
-				      const struct intel_xe_perf_metric_set *metric_set,
-				      const struct intel_xe_perf_record_header *record0,
-				      const struct intel_xe_perf_record_header *record1)
+static inline __attribute__((always_inline)) void
+accumulate_a24u40_a14u32_b8_c8(const struct intel_xe_perf *perf,
+			       const uint32_t *start, const uint32_t *end,
+			       uint64_t *deltas,
+			       accumulate_uint32_fn acc32,
+			       accumulate_uint40_fn acc40)
+{
+	/* timestamp */
+	deltas[0] += timestamp_delta32(perf, end[1] - start[1]);
+	acc32(start + 3, end + 3, deltas + 1, 1); /* clock */
+
+	/* 4x 32bit A0-3 counters... */
+	acc32(start + 4, end + 4, deltas + 2, 4);
+
+	/* 20x 40bit A4-23 counters... */
+	acc40(4, start, end, deltas + 6, 20);
+
+	/* 4x 32bit A24-27 counters... */
+	acc32(start + 28, end + 28, deltas + 26, 4);
+
+	/* 4x 40bit A28-31 counters... */
+	acc40(28, start, end, deltas + 30, 4);
+
+	/* 5x 32bit A32-36 counters... */
+	acc32(start + 36, end + 36, deltas + 34, 5);
+
+	/* 1x 32bit A37 counter... */
+	acc32(start + 46, end + 46, deltas + 39, 1);
+
+	/* 8x 32bit B counters + 8x 32bit C counters... */
+	acc32(start + 48, end + 48, deltas + 40, 16);
+}
+
+static inline __attribute__((always_inline)) void
+accumulate_a32u40_a4u32_b8_c8(const struct intel_xe_perf *perf,
+			      const uint32_t *start, const uint32_t *end,
+			      uint64_t *deltas,
+			      accumulate_uint32_fn acc32,
+			      accumulate_uint40_fn acc40)
+{
+	deltas[0] += timestamp_delta32(perf, end[1] - start[1]);
+	acc32(start + 3, end + 3, deltas + 1, 1); /* clock */
+
+	/* 32x 40bit A counters... */
+	acc40(0, start, end, deltas + 2, 32);
+
+	/* 4x 32bit A counters... */
+	acc32(start + 36, end + 36, deltas + 34, 4);
+
+	/* 8x 32bit B counters + 8x 32bit C counters... */
+	acc32(start + 48, end + 48, deltas + 38, 16);
+}
+
+static inline __attribute__((always_inline)) void
+accumulate_mpec8u32_b8_c8(const struct intel_xe_perf *perf,
+			  const uint32_t *start, const uint32_t *end,
+			  uint64_t *deltas,
+			  accumulate_uint32_fn acc32)
+{
+	const uint64_t *start64 = (const uint64_t *)start;
+	const uint64_t *end64 = (const uint64_t *)end;
+
+	/* 64 bit timestamp */
+	deltas[0] += timestamp_delta64(perf, end64[1] - start64[1]);
+
+	/* 64 bit clock */
+	deltas[1] += end64[3] - start64[3];
+
+	/* 8x 32bit MPEC counters + 8x 32bit B counters + 8x 32bit C counters */
+	acc32(start + 8, end + 8, deltas + 2, 24);
+}
+
+static inline __attribute__((always_inline)) void
+accumulate_pec64u64(const struct intel_xe_perf *perf,
+		    const uint32_t *start, const uint32_t *end,
+		    uint64_t *deltas,
+		    accumulate_uint64_fn acc64)
+{
+	const uint64_t *start64 = (const uint64_t *)start;
+	const uint64_t *end64 = (const uint64_t *)end;
+
+	/* 64 bit timestamp */
+	deltas[0] += timestamp_delta64(perf, end64[1] - start64[1]);
+
+	/* 64 bit clock */
+	deltas[1] += end64[3] - start64[3];
+
+	/* 64x 64bit PEC counters */
+	acc64(start64 + 4, end64 + 4, deltas + 2, 64);
+}
+
+static inline const uint32_t *
+record_report(const struct intel_xe_perf_record_header *record)
+{
+	return (const uint32_t *)(record + 1);
+}
+
+/*
+ * Sum up the deltas between each consecutive pair of @records. Unlike the
+ * delta between the first and the last record, this accounts for every
+ * counter wraparound in between.
+ */
+static inline __attribute__((always_inline)) void
+accumulate_records(struct intel_xe_perf_accumulator *acc,
+		   const struct intel_xe_perf *perf,
+		   const struct intel_xe_perf_metric_set *metric_set,
+		   const struct intel_xe_perf_record_header * const *records,
+		   uint32_t n_records,
+		   accumulate_uint32_fn acc32,
+		   accumulate_uint40_fn acc40,
+		   accumulate_uint64_fn acc64)
 {
-	const uint32_t *start = (const uint32_t *)(record0 + 1);
-	const uint32_t *end = (const uint32_t *)(record1 + 1);
-	const uint64_t *start64 = (const uint64_t *)(record0 + 1);
-	const uint64_t *end64 = (const uint64_t *)(record1 + 1);
 	uint64_t *deltas = acc->deltas;
-	int idx = 0;
-	int i;
+	uint32_t i;
 
 	memset(acc, 0, sizeof(*acc));
 
 	switch (metric_set->perf_oa_format) {
 	case XE_OA_FORMAT_A24u40_A14u32_B8_C8:
-		/* timestamp */
-		if (perf->devinfo.oa_timestamp_shift >= 0)
-			deltas[idx++] += (end[1] - start[1]) << perf->devinfo.oa_timestamp_shift;
-		else
-			deltas[idx++] += (end[1] - start[1]) >> (-perf->devinfo.oa_timestamp_shift);
-		accumulate_uint32(start + 3, end + 3, deltas + idx++); /* clock */
+		for (i = 1; i < n_records; i++)
+			accumulate_a24u40_a14u32_b8_c8(perf,
+						       record_report(records[i - 1]),
+						       record_report(records[i]),
+						       deltas, acc32, acc40);
+		break;
 
-		/* 4x 32bit A0-3 counters... */
-		for (i = 0; i < 4; i++)
-			accumulate_uint32(start + 4 + i, end + 4 + i, deltas + idx++);
+	case XE_OAR_FORMAT_A32u40_A4u32_B8_C8:
+	case XE_OA_FORMAT_A32u40_A4u32_B8_C8:
+		for (i = 1; i < n_records; i++)
+			accumulate_a32u40_a4u32_b8_c8(perf,
+						      record_report(records[i - 1]),
+						      record_report(records[i]),
+						      deltas, acc32, acc40);
+		break;
 
-		/* 20x 40bit A4-23 counters... */
-		for (i = 0; i < 20; i++)
-			accumulate_uint40(i + 4, start, end, deltas + idx++);
+	case XE_OAM_FORMAT_MPEC8u32_B8_C8:
+		for (i = 1; i < n_records; i++)
+			accumulate_mpec8u32_b8_c8(perf,
+						  record_report(records[i - 1]),
+						  record_report(records[i]),
+						  deltas, acc32);
+		break;
 
-		/* 4x 32bit A24-27 counters... */
-		for (i = 0; i < 4; i++)
-			accumulate_uint32(start + 28 + i, end + 28 + i, deltas + idx++);
+	case XE_OA_FORMAT_PEC64u64:
+		for (i = 1; i < n_records; i++)
+			accumulate_pec64u64(perf,
+					    record_report(records[i - 1]),
+					    record_report(records[i]),
+					    deltas, acc64);
+		break;
 
-		/* 4x 40bit A28-31 counters... */
-		for (i = 0; i < 4; i++)
-			accumulate_uint40(i + 28, start, end, deltas + idx++);
+	default:
+		assert(0);
+	}
+}
 
-		/* 5x 32bit A32-36 counters... */
-		for (i = 0; i < 5; i++)
-			accumulate_uint32(start + 36 + i, end + 36 + i, deltas + idx++);
+static void
+accumulate_records_generic(struct intel_xe_perf_accumulator *acc,
+			   const struct intel_xe_perf *perf,
+			   const struct intel_xe_perf_metric_set *metric_set,
+			   const struct intel_xe_perf_record_header * const *records,
+			   uint32_t n_records)
+{
+	accumulate_records(acc, perf, metric_set, records, n_records,
+			   accumulate_uint32, accumulate_uint40,
+			   accumulate_uint64);
+}
 
-		/* 1x 32bit A37 counter... */
-		accumulate_uint32(start + 46, end + 46, deltas + idx++);
+#if defined(__x86_64__) && !defined(__clang__) && defined(__GLIBC__) && !defined(__UCLIBC__)
+#pragma GCC push_options
+#pragma GCC target("avx2")
 
-		/* 8x 32bit B counters + 8x 32bit C counters... */
-		for (i = 0; i < 16; i++)
-			accumulate_uint32(start + 48 + i, end + 48 + i, deltas + idx++);
-		break;
+#include <immintrin.h>
 
-	case XE_OAR_FORMAT_A32u40_A4u32_B8_C8:
-	case XE_OA_FORMAT_A32u40_A4u32_B8_C8:
-		if (perf->devinfo.oa_timestamp_shift >= 0)
-			deltas[idx++] += (end[1] - start[1]) << perf->devinfo.oa_timestamp_shift;
-		else
-			deltas[idx++] += (end[1] - start[1]) >> (-perf->devinfo.oa_timestamp_shift);
-		accumulate_uint32(start + 3, end + 3, deltas + idx++); /* clock */
+static void
+accumulate_uint32_avx2(const uint32_t *report0,
+		       const uint32_t *report1,
+		       uint64_t *deltas,
+		       int n)
+{
+	int i;
 
-		/* 32x 40bit A counters... */
-		for (i = 0; i < 32; i++)
-			accumulate_uint40(i, start, end, deltas + idx++);
+	for (i = 0; i + 4 <= n; i += 4) {
+		__m128i d = _mm_sub_epi32(_mm_loadu_si128((const __m128i *)(report1 + i)),
+					  _mm_loadu_si128((const __m128i *)(report0 + i)));
+		__m256i sum = _mm256_loadu_si256((const __m256i *)(deltas + i));
 
-		/* 4x 32bit A counters... */
-		for (i = 0; i < 4; i++)
-			accumulate_uint32(start + 36 + i, end + 36 + i, deltas + idx++);
+		sum = _mm256_add_epi64(sum, _mm256_cvtepu32_epi64(d));
+		_mm256_storeu_si256((__m256i *)(deltas + i), sum);
+	}
 
-		/* 8x 32bit B counters + 8x 32bit C counters... */
-		for (i = 0; i < 16; i++)
-			accumulate_uint32(start + 48 + i, end + 48 + i, deltas + idx++);
-		break;
+	accumulate_uint32(report0 + i, report1 + i, deltas + i, n - i);
+}
 
-	case XE_OAM_FORMAT_MPEC8u32_B8_C8:
-		/* 64 bit timestamp */
-		if (perf->devinfo.oa_timestamp_shift >= 0)
-			deltas[idx++] += (end64[1] - start64[1]) << perf->devinfo.oa_timestamp_shift;
-		else
-			deltas[idx++] += (end64[1] - start64[1]) >> (-perf->devinfo.oa_timestamp_shift);
+/* Four consecutive 40bit A counters, zero extended to 64bit. */
+static inline __m256i
+read_uint40_avx2(const uint32_t *report, int a_index)
+{
+	const uint8_t *high_bytes = (const uint8_t *)(report + 40);
+	__m256i low, high;
+	int32_t high4;
 
-		/* 64 bit clock */
-		deltas[idx++] += end64[3] - start64[3];
+	memcpy(&high4, high_bytes + a_index, sizeof(high4));
 
-		/* 8x 32bit MPEC counters */
-		for (i = 0; i < 8; i++)
-			accumulate_uint32(start + 8 + i, end + 8 + i, deltas + idx++);
+	low = _mm256_cvtepu32_epi64(_mm_loadu_si128((const __m128i *)(report + 4 + a_index)));
+	high = _mm256_cvtepu8_epi64(_mm_cvtsi32_si128(high4));
 
-		/* 8x 32bit B counters */
-		for (i = 0; i < 8; i++)
-			accumulate_uint32(start + 16 + i, end + 16 + i, deltas + idx++);
+	return _mm256_or_si256(low, _mm256_slli_epi64(high, 32));
+}
 
-		/* 8x 32bit C counters */
-		for (i = 0; i < 8; i++)
-			accumulate_uint32(start + 24 + i, end + 24 + i, deltas + idx++);
+static void
+accumulate_uint40_avx2(int a_index,
+		       const uint32_t *report0,
+		       const uint32_t *report1,
+		       uint64_t *deltas,
+		       int n)
+{
+	const __m256i mask = _mm256_set1_epi64x((1LL << 40) - 1);
+	int i;
 
-		break;
+	for (i = 0; i + 4 <= n; i += 4) {
+		__m256i d = _mm256_sub_epi64(read_uint40_avx2(report1, a_index + i),
+					     read_uint40_avx2(report0, a_index + i));
+		__m256i sum = _mm256_loadu_si256((const __m256i *)(deltas + i));
 
-	case XE_OA_FORMAT_PEC64u64:
-		/* 64 bit timestamp */
-		if (perf->devinfo.oa_timestamp_shift >= 0)
-			deltas[idx++] += (end64[1] - start64[1]) << perf->devinfo.oa_timestamp_shift;
-		else
-			deltas[idx++] += (end64[1] - start64[1]) >> (-perf->devinfo.oa_timestamp_shift);
+		sum = _mm256_add_epi64(sum, _mm256_and_si256(d, mask));
+		_mm256_storeu_si256((__m256i *)(deltas + i), sum);
+	}
 
-		/* 64 bit clock */
-		deltas[idx++] += end64[3] - start64[3];
+	accumulate_uint40(a_index + i, report0, report1, deltas + i, n - i);
+}
 
-		/* 64x 64bit PEC counters */
-		for (i = 0; i < 64; i++)
-			deltas[idx++] += end64[4 + i] - start64[4 + i];
+static void
+accumulate_uint64_avx2(const uint64_t *report0,
+		       const uint64_t *report1,
+		       uint64_t *deltas,
+		       int n)
+{
+	int i;
 
-		break;
+	for (i = 0; i + 4 <= n; i += 4) {
+		__m256i d = _mm256_sub_epi64(_mm256_loadu_si256((const __m256i *)(report1 + i)),
+					     _mm256_loadu_si256((const __m256i *)(report0 + i)));
+		__m256i sum = _mm256_loadu_si256((const __m256i *)(deltas + i));
 
-	default:
-		assert(0);
+		_mm256_storeu_si256((__m256i *)(deltas + i), _mm256_add_epi64(sum, d));
 	}
+
+	accumulate_uint64(report0 + i, report1 + i, deltas + i, n - i);
 }
 
-uint64_t intel_xe_perf_read_record_timestamp(const struct intel_xe_perf *perf,
+static void
+accumulate_records_avx2(struct intel_xe_perf_accumulator *acc,
+			const struct intel_xe_perf *perf,
+			const struct intel_xe_perf_metric_set *metric_set,
+			const struct intel_xe_perf_record_header * const *records,
+			uint32_t n_records)
+{
+	accumulate_records(acc, perf, metric_set, records, n_records,
+			   accumulate_uint32_avx2, accumulate_uint40_avx2,
+			   accumulate_uint64_avx2);
+}
+
+#pragma GCC pop_options
+
+/* The PLT is not initialized when ifunc resolvers run, so all external
+ * functions must be inlined with __attribute__((flatten)).
+ */
+__attribute__((flatten))
+static void (*resolve_accumulate_records(void))(struct intel_xe_perf_accumulator *acc,
+						const struct intel_xe_perf *perf,
+						const struct intel_xe_perf_metric_set *metric_set,
+						const struct intel_xe_perf_record_header * const *records,
+						uint32_t n_records)
+{
+	if (igt_x86_features() & AVX2)
+		return accumulate_records_avx2;
+
+	return accumulate_records_generic;
+}
+
+void intel_xe_perf_accumulate_reports_batch(struct intel_xe_perf_accumulator *acc,
+					    const struct intel_xe_perf *perf,
+					    const struct intel_xe_perf_metric_set *metric_set,
+					    const struct intel_xe_perf_record_header * const *records,
+					    uint32_t n_records)
+	__attribute__((ifunc("resolve_accumulate_records")));
+
+#else
+
+void intel_xe_perf_accumulate_reports_batch(struct intel_xe_perf_accumulator *acc,
+					    const struct intel_xe_perf *perf,
+					    const struct intel_xe_perf_metric_set *metric_set,
+					    const struct intel_xe_perf_record_header * const *records,
+					    uint32_t n_records)
+{
+	accumulate_records_generic(acc, perf, metric_set, records, n_records);
+}
+
+#endif
+
+void intel_xe_perf_accumulate_reports(struct intel_xe_perf_accumulator *acc,
+				      const struct intel_xe_perf *perf,
+				      const struct intel_xe_perf_metric_set *metric_set,
+				      const struct intel_xe_perf_record_header *record0,
+				      const struct intel_xe_perf_record_header *record1)
+{
+	const struct intel_xe_perf_record_header *records[] = { record0, record1 };
+
+	intel_xe_perf_accumulate_reports_batch(acc, perf, metric_set, records, 2);
+}
+
+uint64_t intel_xe_perf_read_report_timestamp(const struct intel_xe_perf *perf,
 					     const struct intel_xe_perf_metric_set *metric_set,
-					     const struct intel_xe_perf_record_header *record)
+					     const void *report)
 {
-       const uint32_t *report32 = (const uint32_t *)(record + 1);
-       const uint64_t *report64 = (const uint64_t *)(record + 1);
+       const uint32_t *report32 = report;
+       const uint64_t *report64 = report;
        uint64_t ts;
 
        switch (metric_set->perf_oa_format) {
@@ -943,6 +1275,13 @@ uint64_t intel_xe_perf_read_record_timestamp(const struct intel_xe_perf *perf,
        return ts;
 }
 
+uint64_t intel_xe_perf_read_record_timestamp(const struct intel_xe_perf *perf,
+					     const struct intel_xe_perf_metric_set *metric_set,
+					     const struct intel_xe_perf_record_header *record)
+{
+	return intel_xe_perf_read_report_timestamp(perf, metric_set, record + 1);
+}
+
 uint64_t intel_xe_perf_read_record_timestamp_raw(const struct intel_xe_perf *perf,
 						 const struct intel_xe_perf_metric_set *metric_set,
 						 const struct intel_xe_perf_record_header *record)
@@ -1087,3 +1426,176 @@ void intel_xe_perf_ioctl_err(int fd, enum drm_xe_observation_op op, void *arg, i
 	igt_assert_eq(errno, err);
 	errno = 0;
 }
+
+/* Largest single read() used to hand consumed reports back to the kernel. */
+#define XE_OA_MMAP_RELEASE_CHUNK (1 << 20)
+
+/*
+ * The kernel clears the report id and timestamp of every report it hands
+ * out, so a slot holds a new report once either of them is set again.
+ */
+static bool oa_mmap_landed(const struct intel_xe_oa_mmap *map, size_t offset)
+{
+	const void *report = map->vaddr + offset;
+
+	if (map->hdr_64bit) {
+		const uint64_t *report64 = report;
+
+		return READ_ONCE(report64[0]) || READ_ONCE(report64[1]);
+	} else {
+		const uint32_t *report32 = report;
+
+		return READ_ONCE(report32[0]) || READ_ONCE(report32[1]);
+	}
+}
+
+/**
+ * intel_xe_oa_mmap_open:
+ * @stream_fd: OA stream fd
+ * @report_size: size of the reports of the stream format
+ * @hdr_64bit: whether the format has 64 bit report id and timestamp
+ *
+ * Maps the OA buffer of @stream_fd read-only, so that reports can be parsed in
+ * place with intel_xe_oa_mmap_next() rather than copied out with read().
+ *
+ * Returns: the mapping, or NULL with errno set if the kernel doesn't allow
+ * mapping the OA buffer.
+ */
+struct intel_xe_oa_mmap *
+intel_xe_oa_mmap_open(int stream_fd, size_t report_size, bool hdr_64bit)
+{
+	struct drm_xe_oa_stream_info info = {};
+	struct intel_xe_oa_mmap *map;
+	void *vaddr;
+	int err;
+
+	if (igt_ioctl(stream_fd, DRM_XE_OBSERVATION_IOCTL_INFO, &info))
+		return NULL;
+
+	vaddr = mmap(NULL, info.oa_buf_size, PROT_READ, MAP_PRIVATE,
+		     stream_fd, 0);
+	if (vaddr == MAP_FAILED)
+		return NULL;
+
+	map = calloc(1, sizeof(*map));
+	if (map) {
+		map->release_size = min_t(size_t, info.oa_buf_size,
+					  XE_OA_MMAP_RELEASE_CHUNK);
+		map->release_size -= map->release_size % report_size;
+		map->scratch = malloc(map->release_size);
+	}
+	if (!map || !map->scratch) {
+		err = errno;
+		free(map);
+		munmap(vaddr, info.oa_buf_size);
+		errno = err;
+		return NULL;
+	}
+
+	map->stream_fd = stream_fd;
+	map->vaddr = vaddr;
+	map->size = info.oa_buf_size;
+	/* The OA unit only writes whole reports before wrapping */
+	map->circ_size = info.oa_buf_size - info.oa_buf_size % report_size;
+	map->report_size = report_size;
+	map->hdr_64bit = hdr_64bit;
+
+	return map;
+}
+
+/**
+ * intel_xe_oa_mmap_next:
+ * @map: OA buffer mapping
+ *
+ * Returns: a pointer to the next report in the OA buffer, valid until the
+ * next call to intel_xe_oa_mmap_release(), or NULL if the OA unit hasn't
+ * written any more reports yet.
+ */
+const void *intel_xe_oa_mmap_next(struct intel_xe_oa_mmap *map)
+{
+	const void *report;
+
+	if (map->pending + map->report_size > map->circ_size ||
+	    !oa_mmap_landed(map, map->head))
+		return NULL;
+
+	/* Only look at the body once the header says it's there */
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+	report = map->vaddr + map->head;
+	map->head += map->report_size;
+	if (map->head == map->circ_size)
+		map->head = 0;
+	map->pending += map->report_size;
+
+	return report;
+}
+
+/**
+ * intel_xe_oa_mmap_release:
+ * @map: OA buffer mapping
+ * @oa_status: returns the DRM_XE_OASTATUS flags raised meanwhile, may be NULL
+ *
+ * Hands the reports returned by intel_xe_oa_mmap_next() back to the kernel,
+ * which lets the OA unit reuse their space. The uAPI has no way of moving the
+ * head of the OA buffer other than read(), so this reads the consumed bytes in
+ * as few calls as possible and throws them away. Reports the kernel doesn't
+ * consider available yet are released by a later call.
+ *
+ * If the OA buffer overflowed, the kernel restarted it from the beginning and
+ * so does @map.
+ *
+ * Returns: 0 on success, or a negative errno.
+ */
+int intel_xe_oa_mmap_release(struct intel_xe_oa_mmap *map, uint32_t *oa_status)
+{
+	if (oa_status)
+		*oa_status = 0;
+
+	while (map->pending) {
+		struct drm_xe_oa_stream_status status = {};
+		ssize_t len;
+
+		len = read(map->stream_fd, map->scratch,
+			   min(map->pending, map->release_size));
+		if (len > 0) {
+			map->pending -= len;
+			continue;
+		}
+		if (len == 0 || errno == EAGAIN)
+			break;
+		if (errno == EINTR)
+			continue;
+		if (errno != EIO)
+			return -errno;
+
+		if (igt_ioctl(map->stream_fd, DRM_XE_OBSERVATION_IOCTL_STATUS,
+			      &status))
+			return -errno;
+		if (oa_status)
+			*oa_status |= status.oa_status;
+
+		if (status.oa_status & DRM_XE_OASTATUS_BUFFER_OVERFLOW) {
+			map->head = 0;
+			map->pending = 0;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * intel_xe_oa_mmap_close:
+ * @map: OA buffer mapping
+ *
+ * Unmaps the OA buffer. The stream fd is left open.
+ */
+void intel_xe_oa_mmap_close(struct intel_xe_oa_mmap *map)
+{
+	if (!map)
+		return;
+
+	munmap((void *)map->vaddr, map->size);
+	free(map->scratch);
+	free(map);
+}
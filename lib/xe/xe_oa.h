@@ -312,14 +312,32 @@ struct intel_xe_perf_logical_counter_group {
 	struct igt_list_head link;  /* link for intel_xe_perf_logical_counter_group.groups */
 };
 
+/*
+ * Static description of a generated metric set, @add instantiates it and
+ * adds it to intel_xe_perf.metric_sets.
+ */
+struct intel_xe_perf_metric_set_desc {
+	const char *name;
+	const char *symbol_name;
+	const char *hw_config_guid;
+
+	struct intel_xe_perf_metric_set *(*add)(struct intel_xe_perf *perf);
+};
+
 struct intel_xe_perf {
 	const char *name;
 
 	struct intel_xe_perf_logical_counter_group *root_group;
 
+	/* Instantiated metric sets */
 	struct igt_list_head metric_sets;
 
 	struct intel_xe_perf_devinfo devinfo;
+
+	/* Metric sets of the platform, instantiated on demand */
+	const struct intel_xe_perf_metric_set_desc *metric_set_descs;
+	struct intel_xe_perf_metric_set **loaded_metric_sets;
+	uint32_t n_metric_set_descs;
 };
 
 /* This is identical to 'struct drm_i915_query_topology_info' at present */
@@ -337,7 +355,10 @@ struct intel_xe_topology_info {
 
 struct intel_xe_perf_record_header {
 	uint32_t type;
-	uint16_t pad;
+	/* Stream of a multi stream recording the record belongs to, always 0
+	 * otherwise (see intel_xe_perf_record_stream_info).
+	 */
+	uint16_t stream_id;
 	uint16_t size;
 };
 
@@ -376,6 +397,13 @@ struct intel_xe_perf *intel_xe_perf_for_devinfo(uint32_t device_id,
 						uint64_t gt_min_freq,
 						uint64_t gt_max_freq,
 						const struct intel_xe_topology_info *topology);
+struct intel_xe_perf *intel_xe_perf_for_fd_lazy(int drm_fd, int gt);
+struct intel_xe_perf *intel_xe_perf_for_devinfo_lazy(uint32_t device_id,
+						     uint32_t revision,
+						     uint64_t timestamp_frequency,
+						     uint64_t gt_min_freq,
+						     uint64_t gt_max_freq,
+						     const struct intel_xe_topology_info *topology);
 void intel_xe_perf_free(struct intel_xe_perf *perf);
 
 void intel_xe_perf_add_logical_counter(struct intel_xe_perf *perf,
@@ -385,6 +413,13 @@ void intel_xe_perf_add_logical_counter(struct intel_xe_perf *perf,
 void intel_xe_perf_add_metric_set(struct intel_xe_perf *perf,
 				  struct intel_xe_perf_metric_set *metric_set);
 
+void intel_xe_perf_register_metric_sets(struct intel_xe_perf *perf,
+					const struct intel_xe_perf_metric_set_desc *descs,
+					uint32_t n_descs);
+struct intel_xe_perf_metric_set *intel_xe_perf_find_metric_set(struct intel_xe_perf *perf,
+							       const char *symbol_name);
+void intel_xe_perf_load_metric_sets(struct intel_xe_perf *perf);
+
 void intel_xe_perf_load_perf_configs(struct intel_xe_perf *perf, int drm_fd);
 
 
@@ -399,7 +434,15 @@ void intel_xe_perf_accumulate_reports(struct intel_xe_perf_accumulator *acc,
 				      const struct intel_xe_perf_metric_set *metric_set,
 				      const struct intel_xe_perf_record_header *record0,
 				      const struct intel_xe_perf_record_header *record1);
+void intel_xe_perf_accumulate_reports_batch(struct intel_xe_perf_accumulator *acc,
+					    const struct intel_xe_perf *perf,
+					    const struct intel_xe_perf_metric_set *metric_set,
+					    const struct intel_xe_perf_record_header * const *records,
+					    uint32_t n_records);
 
+uint64_t intel_xe_perf_read_report_timestamp(const struct intel_xe_perf *perf,
+					     const struct intel_xe_perf_metric_set *metric_set,
+					     const void *report);
 uint64_t intel_xe_perf_read_record_timestamp(const struct intel_xe_perf *perf,
 					     const struct intel_xe_perf_metric_set *metric_set,
 					     const struct intel_xe_perf_record_header *record);
@@ -416,6 +459,36 @@ void intel_xe_oa_prop_to_ext(struct intel_xe_oa_open_prop *properties,
 int intel_xe_perf_ioctl(int fd, enum drm_xe_observation_op op, void *arg);
 void intel_xe_perf_ioctl_err(int fd, enum drm_xe_observation_op op, void *arg, int err);
 
+/**
+ * intel_xe_oa_mmap:
+ *
+ * Reader of an OA buffer mapped in the address space of the process, see
+ * intel_xe_oa_mmap_open().
+ */
+struct intel_xe_oa_mmap {
+	int stream_fd;
+	const uint8_t *vaddr;
+	size_t size;
+	/* Part of the buffer holding reports, a multiple of the report size */
+	size_t circ_size;
+	size_t report_size;
+	bool hdr_64bit;
+
+	/* Offset of the next report to parse */
+	size_t head;
+	/* Bytes parsed but not released to the kernel yet */
+	size_t pending;
+
+	void *scratch;
+	size_t release_size;
+};
+
+struct intel_xe_oa_mmap *
+intel_xe_oa_mmap_open(int stream_fd, size_t report_size, bool hdr_64bit);
+const void *intel_xe_oa_mmap_next(struct intel_xe_oa_mmap *map);
+int intel_xe_oa_mmap_release(struct intel_xe_oa_mmap *map, uint32_t *oa_status);
+void intel_xe_oa_mmap_close(struct intel_xe_oa_mmap *map);
+
 #ifdef __cplusplus
 };
 #endif
@@ -34,6 +34,9 @@ enum intel_xe_perf_record_type {
 	/* intel_xe_perf_record_timestamp_correlation */
 	INTEL_XE_PERF_RECORD_TYPE_TIMESTAMP_CORRELATION,
 
+	/* intel_xe_perf_record_stream_info */
+	INTEL_XE_PERF_RECORD_TYPE_STREAM_INFO,
+
 	INTEL_XE_PERF_RECORD_MAX /* non-ABI */
 };
 
@@ -46,6 +49,12 @@ struct intel_xe_perf_record_version {
 
 #define INTEL_XE_PERF_RECORD_VERSION (1)
 
+/* Recording of several OA streams, with one
+ * intel_xe_perf_record_stream_info per stream and the records of all
+ * streams interleaved in timestamp order.
+ */
+#define INTEL_XE_PERF_RECORD_VERSION_MULTI_STREAM (2)
+
 	uint32_t pad;
 } __attribute__((packed));
 
@@ -85,6 +94,37 @@ struct intel_xe_perf_record_device_topology {
 	struct intel_xe_topology_info topology;
 };
 
+/* Description of one of the streams of a multi stream recording. The
+ * samples, lost report and timestamp correlation records of the stream carry
+ * its stream_id in their intel_xe_perf_record_header.
+ */
+struct intel_xe_perf_record_stream_info {
+	uint32_t stream_id;
+
+	/* OA unit and its enum drm_xe_oa_unit_type */
+	uint32_t oa_unit_id;
+	uint32_t oa_unit_type;
+
+	/* GT and engine used for the timestamp correlations */
+	uint32_t gt_id;
+	uint32_t engine_class;
+	uint32_t engine_instance;
+
+	/* enum intel_xe_oa_format_name */
+	uint32_t oa_format;
+
+	uint32_t pad;
+
+	/* Frequency of the timestamps in the records. */
+	uint64_t timestamp_frequency;
+
+	/* Metric set name */
+	char metric_set_name[256];
+
+	/* Configuration identifier */
+	char metric_set_uuid[40];
+} __attribute__((packed));
+
 /* Timestamp correlation between CPU/GPU. */
 struct intel_xe_perf_record_timestamp_correlation {
 	/* In CLOCK_MONOTONIC */
@@ -22,6 +22,8 @@
 #define MAX(a,b) ((a) > (b) ? (a) : (b))
 #define ARRAY_SIZE(arr) (sizeof(arr) / sizeof((arr)[0]))
 
+#define INTEL_XE_PERF_DATA_READER_INDEX_STRIDE 1024
+
 static inline bool
 oa_report_ctx_is_valid(const struct intel_xe_perf_devinfo *devinfo,
 		       const uint8_t *_report)
@@ -69,6 +71,20 @@ append_record(struct intel_xe_perf_data_reader *reader,
 	reader->records[reader->n_records++] = header;
 }
 
+static void
+append_index(struct intel_xe_perf_data_reader *reader, const uint8_t *record)
+{
+	if (reader->n_index >= reader->n_allocated_index) {
+		reader->n_allocated_index = MAX(100, 2 * reader->n_allocated_index);
+		reader->index = realloc(reader->index,
+					reader->n_allocated_index *
+					sizeof(*reader->index));
+		assert(reader->index);
+	}
+
+	reader->index[reader->n_index++].offset = record - reader->mmap_data;
+}
+
 static void
 append_timestamp_correlation(struct intel_xe_perf_data_reader *reader,
 			     const struct intel_xe_perf_record_timestamp_correlation *corr)
@@ -86,21 +102,36 @@ append_timestamp_correlation(struct intel_xe_perf_data_reader *reader,
 	reader->correlations[reader->n_correlations++] = corr;
 }
 
-static struct intel_xe_perf_metric_set *
-find_metric_set(struct intel_xe_perf *perf, const char *symbol_name)
+static void
+append_stream(struct intel_xe_perf_data_reader *reader,
+	      const struct intel_xe_perf_record_stream_info *stream)
 {
-	struct intel_xe_perf_metric_set *metric_set;
+	if (reader->n_streams >= reader->n_allocated_streams) {
+		reader->n_allocated_streams = MAX(4, 2 * reader->n_allocated_streams);
+		reader->streams =
+			(const struct intel_xe_perf_record_stream_info **)
+			realloc((void *) reader->streams,
+				reader->n_allocated_streams *
+				sizeof(*reader->streams));
+		assert(reader->streams);
+	}
+
+	reader->streams[reader->n_streams++] = stream;
+}
 
-	igt_list_for_each_entry(metric_set, &perf->metric_sets, link) {
-		if (!strcmp(symbol_name, metric_set->symbol_name))
-			return metric_set;
+static const struct intel_xe_perf_record_stream_info *
+find_stream(struct intel_xe_perf_data_reader *reader, uint32_t stream_id)
+{
+	for (uint32_t i = 0; i < reader->n_streams; i++) {
+		if (reader->streams[i]->stream_id == stream_id)
+			return reader->streams[i];
 	}
 
 	return NULL;
 }
 
 static bool
-parse_data(struct intel_xe_perf_data_reader *reader)
+parse_data(struct intel_xe_perf_data_reader *reader, bool lazy)
 {
 	const struct intel_xe_perf_record_device_info *record_info;
 	const struct intel_xe_perf_record_device_topology *record_topology;
@@ -113,7 +144,13 @@ parse_data(struct intel_xe_perf_data_reader *reader)
 
 		switch (header->type) {
 		case INTEL_XE_PERF_RECORD_TYPE_SAMPLE:
-			append_record(reader, header);
+			if (header->stream_id != reader->stream_id)
+				break;
+			if (!lazy)
+				append_record(reader, header);
+			else if (!(reader->n_total_records % INTEL_XE_PERF_DATA_READER_INDEX_STRIDE))
+				append_index(reader, iter);
+			reader->n_total_records++;
 			break;
 
 		case INTEL_XE_PERF_RECORD_OA_TYPE_REPORT_LOST:
@@ -124,10 +161,12 @@ parse_data(struct intel_xe_perf_data_reader *reader)
 		case INTEL_XE_PERF_RECORD_TYPE_VERSION: {
 			struct intel_xe_perf_record_version *version =
 				(struct intel_xe_perf_record_version*) (header + 1);
-			if (version->version != INTEL_XE_PERF_RECORD_VERSION) {
+			if (version->version != INTEL_XE_PERF_RECORD_VERSION &&
+			    version->version != INTEL_XE_PERF_RECORD_VERSION_MULTI_STREAM) {
 				snprintf(reader->error_msg, sizeof(reader->error_msg),
-					 "Unsupported recording version (%u, expected %u)",
-					 version->version, INTEL_XE_PERF_RECORD_VERSION);
+					 "Unsupported recording version (%u, expected %u or %u)",
+					 version->version, INTEL_XE_PERF_RECORD_VERSION,
+					 INTEL_XE_PERF_RECORD_VERSION_MULTI_STREAM);
 				return false;
 			}
 			break;
@@ -146,10 +185,20 @@ parse_data(struct intel_xe_perf_data_reader *reader)
 		}
 
 		case INTEL_XE_PERF_RECORD_TYPE_TIMESTAMP_CORRELATION: {
+			if (header->stream_id != reader->stream_id)
+				break;
 			append_timestamp_correlation(reader,
 						     (const struct intel_xe_perf_record_timestamp_correlation *) (header + 1));
 			break;
 		}
+
+		case INTEL_XE_PERF_RECORD_TYPE_STREAM_INFO: {
+			assert(header->size == (sizeof(struct intel_xe_perf_record_stream_info) +
+						sizeof(*header)));
+			append_stream(reader,
+				      (const struct intel_xe_perf_record_stream_info *) (header + 1));
+			break;
+		}
 		}
 
 		iter += header->size;
@@ -165,12 +214,12 @@ parse_data(struct intel_xe_perf_data_reader *reader)
 	record_info = reader->record_info;
 	record_topology = reader->record_topology;
 
-	reader->perf = intel_xe_perf_for_devinfo(record_info->device_id,
-						 record_info->device_revision,
-						 record_info->timestamp_frequency,
-						 record_info->gt_min_frequency,
-						 record_info->gt_max_frequency,
-						 &record_topology->topology);
+	reader->perf = intel_xe_perf_for_devinfo_lazy(record_info->device_id,
+						      record_info->device_revision,
+						      record_info->timestamp_frequency,
+						      record_info->gt_min_frequency,
+						      record_info->gt_max_frequency,
+						      &record_topology->topology);
 	if (!reader->perf) {
 		snprintf(reader->error_msg, sizeof(reader->error_msg),
 			 "Recording occured on unsupported device (0x%x)",
@@ -180,9 +229,28 @@ parse_data(struct intel_xe_perf_data_reader *reader)
 
 	reader->devinfo = reader->perf->devinfo;
 
-	reader->metric_set_name = record_info->metric_set_name;
-	reader->metric_set_uuid = record_info->metric_set_uuid;
-	reader->metric_set = find_metric_set(reader->perf, record_info->metric_set_name);
+	if (reader->n_streams) {
+		const struct intel_xe_perf_record_stream_info *stream =
+			find_stream(reader, reader->stream_id);
+
+		if (!stream) {
+			snprintf(reader->error_msg, sizeof(reader->error_msg),
+				 "No stream %u in recording", reader->stream_id);
+			return false;
+		}
+
+		reader->metric_set_name = stream->metric_set_name;
+		reader->metric_set_uuid = stream->metric_set_uuid;
+	} else if (reader->stream_id) {
+		snprintf(reader->error_msg, sizeof(reader->error_msg),
+			 "Not a multi stream recording");
+		return false;
+	} else {
+		reader->metric_set_name = record_info->metric_set_name;
+		reader->metric_set_uuid = record_info->metric_set_uuid;
+	}
+	reader->metric_set = intel_xe_perf_find_metric_set(reader->perf,
+							   reader->metric_set_name);
 
 	return true;
 }
@@ -276,6 +344,9 @@ generate_cpu_events(struct intel_xe_perf_data_reader *reader)
 	uint32_t last_ctx_id, current_ctx_id;
 	uint64_t gpu_ts_start, gpu_ts_end;
 
+	if (!reader->n_records)
+		return;
+
 	for (uint32_t i = 1; i < reader->n_records; i++) {
 		current_header = reader->records[i];
 
@@ -326,9 +397,8 @@ compute_correlation_chunks(struct intel_xe_perf_data_reader *reader)
 	}
 }
 
-bool
-intel_xe_perf_data_reader_init(struct intel_xe_perf_data_reader *reader,
-			       int perf_file_fd)
+static bool
+map_file(struct intel_xe_perf_data_reader *reader, int perf_file_fd)
 {
 	struct stat st;
 	if (fstat(perf_file_fd, &st) != 0) {
@@ -349,7 +419,23 @@ intel_xe_perf_data_reader_init(struct intel_xe_perf_data_reader *reader,
 		return false;
 	}
 
-	if (!parse_data(reader))
+	return true;
+}
+
+/*
+ * Loads the records of the stream @stream_id of a multi stream recording,
+ * stream 0 being the only stream of other recordings.
+ */
+bool
+intel_xe_perf_data_reader_init_stream(struct intel_xe_perf_data_reader *reader,
+				      int perf_file_fd, uint32_t stream_id)
+{
+	if (!map_file(reader, perf_file_fd))
+		return false;
+
+	reader->stream_id = stream_id;
+
+	if (!parse_data(reader, false))
 		return false;
 
 	compute_correlation_chunks(reader);
@@ -358,12 +444,148 @@ intel_xe_perf_data_reader_init(struct intel_xe_perf_data_reader *reader,
 	return true;
 }
 
+bool
+intel_xe_perf_data_reader_init(struct intel_xe_perf_data_reader *reader,
+			       int perf_file_fd)
+{
+	return intel_xe_perf_data_reader_init_stream(reader, perf_file_fd, 0);
+}
+
+/*
+ * Unlike intel_xe_perf_data_reader_init_stream(), only walks the record
+ * headers of the recording to build a sparse index of the samples of
+ * @stream_id. Nothing is decoded until a time window is requested with
+ * intel_xe_perf_data_reader_load().
+ */
+bool
+intel_xe_perf_data_reader_open_stream(struct intel_xe_perf_data_reader *reader,
+				      int perf_file_fd, uint32_t stream_id)
+{
+	if (!map_file(reader, perf_file_fd))
+		return false;
+
+	reader->stream_id = stream_id;
+
+	if (!parse_data(reader, true))
+		return false;
+
+	if (!reader->metric_set) {
+		snprintf(reader->error_msg, sizeof(reader->error_msg),
+			 "Unknown metric set %s", reader->metric_set_name);
+		return false;
+	}
+
+	if (reader->n_correlations < 2) {
+		snprintf(reader->error_msg, sizeof(reader->error_msg),
+			 "Less than 2 CPU/GPU timestamp correlation points");
+		return false;
+	}
+
+	compute_correlation_chunks(reader);
+
+	for (uint32_t i = 0; i < reader->n_index; i++) {
+		const struct intel_xe_perf_record_header *header =
+			(const struct intel_xe_perf_record_header *)
+			(reader->mmap_data + reader->index[i].offset);
+
+		reader->index[i].cpu_ts =
+			correlate_gpu_timestamp(reader,
+						intel_xe_perf_read_record_timestamp(reader->perf,
+														   reader->metric_set,
+														   header));
+	}
+
+	return true;
+}
+
+bool
+intel_xe_perf_data_reader_open(struct intel_xe_perf_data_reader *reader,
+			       int perf_file_fd)
+{
+	return intel_xe_perf_data_reader_open_stream(reader, perf_file_fd, 0);
+}
+
+/*
+ * Decodes the samples between the CPU timestamps @cpu_ts_start and
+ * @cpu_ts_end of a recording opened with intel_xe_perf_data_reader_open()
+ * into @records and @timelines, replacing the previously loaded window. The
+ * window is widened to the nearest indexed samples on either side.
+ */
+bool
+intel_xe_perf_data_reader_load(struct intel_xe_perf_data_reader *reader,
+			       uint64_t cpu_ts_start, uint64_t cpu_ts_end)
+{
+	const uint8_t *iter, *end;
+	uint32_t first = 0, last, lo, hi;
+
+	if (cpu_ts_start > cpu_ts_end) {
+		snprintf(reader->error_msg, sizeof(reader->error_msg),
+			 "Invalid time window");
+		return false;
+	}
+
+	reader->n_records = 0;
+	reader->n_timelines = 0;
+	reader->first_record = 0;
+	if (!reader->n_index)
+		return true;
+
+	/* Last indexed sample at or before the start of the window... */
+	lo = 0;
+	hi = reader->n_index;
+	while (lo < hi) {
+		uint32_t mid = lo + (hi - lo) / 2;
+
+		if (reader->index[mid].cpu_ts <= cpu_ts_start) {
+			first = mid;
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	/* ... up to and including the first one past its end. */
+	for (last = first; last < reader->n_index; last++) {
+		if (reader->index[last].cpu_ts > cpu_ts_end)
+			break;
+	}
+
+	iter = reader->mmap_data + reader->index[first].offset;
+	if (last < reader->n_index) {
+		const struct intel_xe_perf_record_header *header =
+			(const struct intel_xe_perf_record_header *)
+			(reader->mmap_data + reader->index[last].offset);
+
+		end = (const uint8_t *) header + header->size;
+	} else {
+		end = reader->mmap_data + reader->mmap_size;
+	}
+
+	reader->first_record = first * INTEL_XE_PERF_DATA_READER_INDEX_STRIDE;
+	while (iter < end) {
+		const struct intel_xe_perf_record_header *header =
+			(const struct intel_xe_perf_record_header *) iter;
+
+		if (header->type == INTEL_XE_PERF_RECORD_TYPE_SAMPLE &&
+		    header->stream_id == reader->stream_id)
+			append_record(reader, header);
+
+		iter += header->size;
+	}
+
+	generate_cpu_events(reader);
+
+	return true;
+}
+
 void
 intel_xe_perf_data_reader_fini(struct intel_xe_perf_data_reader *reader)
 {
 	intel_xe_perf_free(reader->perf);
 	free(reader->records);
+	free(reader->index);
 	free(reader->timelines);
 	free(reader->correlations);
+	free(reader->streams);
 	munmap((void *)reader->mmap_data, reader->mmap_size);
 }
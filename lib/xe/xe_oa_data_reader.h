@@ -41,6 +41,22 @@ struct intel_xe_perf_data_reader {
 	uint32_t n_records;
 	uint32_t n_allocated_records;
 
+	/* Position of records[0] among the samples of the whole recording,
+	 * and the number of those samples.
+	 */
+	uint32_t first_record;
+	uint32_t n_total_records;
+
+	/* Sparse index of every 1024th sample, built by
+	 * intel_xe_perf_data_reader_open().
+	 */
+	struct {
+		uint64_t offset;
+		uint64_t cpu_ts;
+	} *index;
+	uint32_t n_index;
+	uint32_t n_allocated_index;
+
 	/**/
 	struct intel_xe_perf_timeline_item *timelines;
 	uint32_t n_timelines;
@@ -58,6 +74,14 @@ struct intel_xe_perf_data_reader {
 	} correlation_chunks[4];
 	uint32_t n_correlation_chunks;
 
+	/* Streams of a multi stream recording, empty for single stream
+	 * recordings. Only the records of stream_id are loaded.
+	 */
+	const struct intel_xe_perf_record_stream_info **streams;
+	uint32_t n_streams;
+	uint32_t n_allocated_streams;
+	uint32_t stream_id;
+
 	const char *metric_set_uuid;
 	const char *metric_set_name;
 
@@ -80,6 +104,15 @@ bool intel_xe_perf_data_reader_init(struct intel_xe_perf_data_reader *reader,
 				    int perf_file_fd);
 void intel_xe_perf_data_reader_fini(struct intel_xe_perf_data_reader *reader);
 
+bool intel_xe_perf_data_reader_open(struct intel_xe_perf_data_reader *reader,
+				    int perf_file_fd);
+bool intel_xe_perf_data_reader_init_stream(struct intel_xe_perf_data_reader *reader,
+					   int perf_file_fd, uint32_t stream_id);
+bool intel_xe_perf_data_reader_open_stream(struct intel_xe_perf_data_reader *reader,
+					   int perf_file_fd, uint32_t stream_id);
+bool intel_xe_perf_data_reader_load(struct intel_xe_perf_data_reader *reader,
+				    uint64_t cpu_ts_start, uint64_t cpu_ts_end);
+
 #ifdef __cplusplus
 };
 #endif
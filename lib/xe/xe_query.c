@@ -8,6 +8,7 @@
 
 #include <stdlib.h>
 #include <pthread.h>
+#include <stdatomic.h>
 
 #ifdef HAVE_VALGRIND
 #include <valgrind/valgrind.h>
@@ -314,11 +315,31 @@ const char *xe_engine_class_short_string(uint32_t engine_class)
 	}
 }
 
+/*
+ * Every accessor looks the device up, often from the inner loops of
+ * multithreaded tests, so lookups of the low fds every test uses don't
+ * take the mutex: the devices are also published in an array indexed by
+ * fd, which readers load without locking. The mutex only serializes
+ * insertion and removal, and lookups of fds beyond the array, in the map.
+ *
+ * As before, a device must not be put while other threads still use its
+ * fd, so readers never see a device being freed.
+ */
+#define XE_DEVICE_CACHE_FDS	1024
+
 static struct xe_device_cache {
 	pthread_mutex_t cache_mutex;
 	struct igt_map *map;
+	_Atomic(struct xe_device *) fds[XE_DEVICE_CACHE_FDS];
 } cache;
 
+static void publish_in_cache(int fd, struct xe_device *xe_dev)
+{
+	if (fd >= 0 && fd < XE_DEVICE_CACHE_FDS)
+		atomic_store_explicit(&cache.fds[fd], xe_dev,
+				      memory_order_release);
+}
+
 static struct xe_device *find_in_cache_unlocked(int fd)
 {
 	return igt_map_search(cache.map, &fd);
@@ -328,6 +349,10 @@ static struct xe_device *find_in_cache(int fd)
 {
 	struct xe_device *xe_dev;
 
+	if (fd >= 0 && fd < XE_DEVICE_CACHE_FDS)
+		return atomic_load_explicit(&cache.fds[fd],
+					    memory_order_acquire);
+
 	pthread_mutex_lock(&cache.cache_mutex);
 	xe_dev = find_in_cache_unlocked(fd);
 	pthread_mutex_unlock(&cache.cache_mutex);
@@ -413,6 +438,7 @@ struct xe_device *xe_device_get(int fd)
 	prev = find_in_cache_unlocked(fd);
 	if (!prev) {
 		igt_map_insert(cache.map, &xe_dev->fd, xe_dev);
+		publish_in_cache(fd, xe_dev);
 	} else {
 		xe_device_free(xe_dev);
 		xe_dev = prev;
@@ -436,8 +462,10 @@ static void delete_in_cache(struct igt_map_entry *entry)
 void xe_device_put(int fd)
 {
 	pthread_mutex_lock(&cache.cache_mutex);
-	if (find_in_cache_unlocked(fd))
+	if (find_in_cache_unlocked(fd)) {
+		publish_in_cache(fd, NULL);
 		igt_map_remove(cache.map, &fd, delete_in_cache);
+	}
 	pthread_mutex_unlock(&cache.cache_mutex);
 }
 
@@ -472,6 +500,8 @@ int xe_supports_faults(int fd)
 static void xe_device_destroy_cache(void)
 {
 	pthread_mutex_lock(&cache.cache_mutex);
+	for (int fd = 0; fd < XE_DEVICE_CACHE_FDS; fd++)
+		publish_in_cache(fd, NULL);
 	igt_map_destroy(cache.map, delete_in_cache);
 	pthread_mutex_unlock(&cache.cache_mutex);
 }
@@ -26,6 +26,7 @@
 #define MI_LRR_DST_CS_MMIO			(1 << 19)
 #define MI_LRR_SRC_CS_MMIO			(1 << 18)
 #define CTX_TIMESTAMP 0x3a8
+#define RING_TIMESTAMP 0x358
 #define CS_GPR(x) (0x600 + 8 * (x))
 
 enum { START_TS, NOW_TS };
@@ -53,11 +54,15 @@ void xe_spin_init(struct xe_spin *spin, struct xe_spin_opts *opts)
 	uint64_t ticks_delta_addr = opts->addr + offsetof(struct xe_spin, ticks_delta);
 	uint64_t pad_addr = opts->addr + offsetof(struct xe_spin, pad);
 	uint64_t timestamp_addr = opts->addr + offsetof(struct xe_spin, timestamp);
+	uint64_t start_ts_addr = opts->addr + offsetof(struct xe_spin, start_timestamp);
+	uint64_t end_ts_addr = opts->addr + offsetof(struct xe_spin, end_timestamp);
 	int b = 0;
 
 	spin->start = 0;
 	spin->end = 0xffffffff;
 	spin->ticks_delta = 0;
+	spin->start_timestamp = 0;
+	spin->end_timestamp = 0;
 
 	if (opts->ctx_ticks) {
 		/* store start timestamp */
@@ -69,6 +74,13 @@ void xe_spin_init(struct xe_spin *spin, struct xe_spin_opts *opts)
 		spin->batch[b++] = CS_GPR(START_TS);
 	}
 
+	if (opts->cs_timestamps) {
+		spin->batch[b++] = MI_STORE_REGISTER_MEM_GEN8 | MI_SRM_CS_MMIO;
+		spin->batch[b++] = RING_TIMESTAMP;
+		spin->batch[b++] = start_ts_addr;
+		spin->batch[b++] = start_ts_addr >> 32;
+	}
+
 	spin->batch[b++] = MI_STORE_DWORD_IMM_GEN4;
 	spin->batch[b++] = start_addr;
 	spin->batch[b++] = start_addr >> 32;
@@ -79,6 +91,13 @@ void xe_spin_init(struct xe_spin *spin, struct xe_spin_opts *opts)
 	if (opts->preempt)
 		spin->batch[b++] = MI_ARB_CHECK;
 
+	if (opts->cs_timestamps) {
+		spin->batch[b++] = MI_STORE_REGISTER_MEM_GEN8 | MI_SRM_CS_MMIO;
+		spin->batch[b++] = RING_TIMESTAMP;
+		spin->batch[b++] = end_ts_addr;
+		spin->batch[b++] = end_ts_addr >> 32;
+	}
+
 	if (opts->write_timestamp) {
 		spin->batch[b++] = MI_LOAD_REGISTER_REG | MI_LRR_DST_CS_MMIO | MI_LRR_SRC_CS_MMIO;
 		spin->batch[b++] = CTX_TIMESTAMP;
@@ -207,6 +226,158 @@ void xe_spin_end(struct xe_spin *spin)
 	WRITE_ONCE(spin->end, 0);
 }
 
+/**
+ * xe_spin_array_create:
+ * @fd: xe device fd
+ * @vm: vm the spinners are bound to
+ * @count: number of spinners
+ * @ahnd: allocator handle, if 0 the spinners are bound at @opts->addr
+ * @opts: options applied to every spinner, @opts->addr is overridden
+ *
+ * Creates @count spinners in a single bo with a single bind, so tests
+ * which need many of them don't pay a bo, mapping and bind each. Spinners
+ * are submitted with xe_spin_array_submit() to any exec_queue of @vm.
+ *
+ * Returns: the spinner array, to be released with xe_spin_array_destroy().
+ */
+struct xe_spin_array *xe_spin_array_create(int fd, uint32_t vm,
+					   unsigned int count, uint64_t ahnd,
+					   struct xe_spin_opts *opts)
+{
+	struct xe_spin_array *arr;
+
+	igt_assert(count);
+	arr = calloc(1, sizeof(*arr));
+	igt_assert(arr);
+
+	arr->fd = fd;
+	arr->vm = vm;
+	arr->ahnd = ahnd;
+	arr->count = count;
+	arr->opts = *opts;
+	arr->stride = ALIGN(sizeof(struct xe_spin), 64);
+	arr->bo_size = xe_bb_size(fd, count * arr->stride);
+
+	arr->bo = xe_bo_create(fd, vm, arr->bo_size, vram_if_possible(fd, 0),
+			       DRM_XE_GEM_CREATE_FLAG_NEEDS_VISIBLE_VRAM);
+	arr->map = xe_bo_map(fd, arr->bo, arr->bo_size);
+	if (ahnd)
+		arr->addr = intel_allocator_alloc_with_strategy(ahnd, arr->bo,
+								arr->bo_size, 0,
+								ALLOC_STRATEGY_LOW_TO_HIGH);
+	else
+		arr->addr = opts->addr;
+	xe_vm_bind_sync(fd, vm, arr->bo, 0, arr->addr, arr->bo_size);
+
+	/* Idle spinners have their syncobj signalled */
+	arr->syncobjs = calloc(count, sizeof(*arr->syncobjs));
+	igt_assert(arr->syncobjs);
+	for (unsigned int i = 0; i < count; i++)
+		arr->syncobjs[i] = syncobj_create(fd, DRM_SYNCOBJ_CREATE_SIGNALED);
+
+	return arr;
+}
+
+/**
+ * xe_spin_array_get:
+ * @arr: spinner array
+ * @idx: spinner index
+ *
+ * Returns: the mapped spinner @idx of @arr.
+ */
+struct xe_spin *xe_spin_array_get(struct xe_spin_array *arr, unsigned int idx)
+{
+	igt_assert_lt(idx, arr->count);
+
+	return (struct xe_spin *)((char *)arr->map + idx * arr->stride);
+}
+
+/**
+ * xe_spin_array_addr:
+ * @arr: spinner array
+ * @idx: spinner index
+ *
+ * Returns: the gpu address of spinner @idx of @arr.
+ */
+uint64_t xe_spin_array_addr(struct xe_spin_array *arr, unsigned int idx)
+{
+	igt_assert_lt(idx, arr->count);
+
+	return arr->addr + idx * arr->stride;
+}
+
+/**
+ * xe_spin_array_submit:
+ * @arr: spinner array
+ * @idx: spinner index
+ * @exec_queue: exec_queue to run the spinner on
+ *
+ * Initializes spinner @idx, which must be idle, and submits it to
+ * @exec_queue without waiting for it to start.
+ */
+void xe_spin_array_submit(struct xe_spin_array *arr, unsigned int idx,
+			  uint32_t exec_queue)
+{
+	struct drm_xe_sync sync = {
+		.type = DRM_XE_SYNC_TYPE_SYNCOBJ, .flags = DRM_XE_SYNC_FLAG_SIGNAL,
+		.handle = arr->syncobjs[idx],
+	};
+	struct xe_spin_opts opts = arr->opts;
+
+	igt_assert(syncobj_wait(arr->fd, &sync.handle, 1, 0, 0, NULL));
+	syncobj_reset(arr->fd, &sync.handle, 1);
+
+	opts.addr = xe_spin_array_addr(arr, idx);
+	xe_spin_init(xe_spin_array_get(arr, idx), &opts);
+	xe_exec_sync(arr->fd, exec_queue, opts.addr, &sync, 1);
+}
+
+/**
+ * xe_spin_array_sync_end:
+ * @arr: spinner array
+ *
+ * Ends all spinners of @arr and waits until they are idle.
+ */
+void xe_spin_array_sync_end(struct xe_spin_array *arr)
+{
+	for (unsigned int i = 0; i < arr->count; i++)
+		xe_spin_end(xe_spin_array_get(arr, i));
+
+	igt_assert(syncobj_wait(arr->fd, arr->syncobjs, arr->count, INT64_MAX,
+				DRM_SYNCOBJ_WAIT_FLAGS_WAIT_ALL, NULL));
+}
+
+/**
+ * xe_spin_array_destroy:
+ * @arr: spinner array
+ *
+ * Ends the spinners of @arr, unbinds and releases them.
+ */
+void xe_spin_array_destroy(struct xe_spin_array *arr)
+{
+	xe_spin_array_sync_end(arr);
+
+	for (unsigned int i = 0; i < arr->count; i++)
+		syncobj_destroy(arr->fd, arr->syncobjs[i]);
+	free(arr->syncobjs);
+
+	xe_vm_unbind_sync(arr->fd, arr->vm, 0, arr->addr, arr->bo_size);
+	if (arr->ahnd)
+		intel_allocator_free(arr->ahnd, arr->bo);
+	munmap(arr->map, arr->bo_size);
+	gem_close(arr->fd, arr->bo);
+	free(arr);
+}
+
+static uint32_t xe_spin_ctx_ticks(int fd, const struct igt_spin_factory *opt)
+{
+	if (!opt->timeout_ns)
+		return 0;
+
+	return xe_spin_nsec_to_ticks(fd, opt->hwe ? opt->hwe->gt_id : 0,
+				     opt->timeout_ns);
+}
+
 /**
  * xe_spin_create:
  * @opt: controlling options such as allocator handle, exec_queue, vm etc
@@ -237,6 +408,7 @@ xe_spin_create(int fd, const struct igt_spin_factory *opt)
 	igt_assert(spin);
 
 	spin->driver = INTEL_DRIVER_XE;
+	spin->fd = fd;
 	spin->syncobj = syncobj_create(fd, 0);
 	spin->vm = opt->vm;
 	spin->engine = opt->engine;
@@ -259,7 +431,8 @@ xe_spin_create(int fd, const struct igt_spin_factory *opt)
 	addr = intel_allocator_alloc_with_strategy(ahnd, spin->handle, bo_size, 0, ALLOC_STRATEGY_LOW_TO_HIGH);
 	xe_vm_bind_sync(fd, spin->vm, spin->handle, 0, addr, bo_size);
 
-	xe_spin_init_opts(xe_spin, .addr = addr, .preempt = !(opt->flags & IGT_SPIN_NO_PREEMPTION));
+	xe_spin_init_opts(xe_spin, .addr = addr, .preempt = !(opt->flags & IGT_SPIN_NO_PREEMPTION),
+			  .ctx_ticks = xe_spin_ctx_ticks(fd, opt));
 	exec.exec_queue_id = spin->engine;
 	exec.address = addr;
 	sync.handle = spin->syncobj;
@@ -274,6 +447,42 @@ xe_spin_create(int fd, const struct igt_spin_factory *opt)
 	return spin;
 }
 
+/**
+ * __xe_spin_restart:
+ * @fd: xe device fd
+ * @spin: idle spinner created by xe_spin_create
+ *
+ * Rewrites the spin batch and submits it again reusing the bo, binding and
+ * exec_queue of @spin, waiting until it starts.
+ *
+ * Returns: 0 on success, -errno on exec failure.
+ */
+int __xe_spin_restart(int fd, struct igt_spin *spin)
+{
+	struct drm_xe_sync sync = {
+		.type = DRM_XE_SYNC_TYPE_SYNCOBJ, .flags = DRM_XE_SYNC_FLAG_SIGNAL,
+		.handle = spin->syncobj,
+	};
+	struct drm_xe_exec exec = {
+		.exec_queue_id = spin->engine,
+		.address = spin->address,
+		.num_batch_buffer = 1,
+		.num_syncs = 1,
+		.syncs = to_user_pointer(&sync),
+	};
+
+	igt_assert(spin->driver == INTEL_DRIVER_XE);
+
+	xe_spin_init_opts(spin->xe_spin, .addr = spin->address,
+			  .preempt = !(spin->opts.flags & IGT_SPIN_NO_PREEMPTION),
+			  .ctx_ticks = xe_spin_ctx_ticks(fd, &spin->opts));
+	if (igt_ioctl(fd, DRM_IOCTL_XE_EXEC, &exec))
+		return -errno;
+	xe_spin_wait_started(spin->xe_spin);
+
+	return 0;
+}
+
 static void xe_spin_sync_wait(int fd, struct igt_spin *spin)
 {
 	igt_assert(syncobj_wait(fd, &spin->syncobj, 1, INT64_MAX, 0, NULL));
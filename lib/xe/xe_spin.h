@@ -18,6 +18,7 @@
 
 /* Wrapper to integrate with igt_dummyload, aka igt_spin */
 igt_spin_t *xe_spin_create(int fd, const struct igt_spin_factory *opt);
+int __xe_spin_restart(int fd, struct igt_spin *spin);
 void xe_spin_free(int fd, struct igt_spin *spin);
 
 /*
@@ -46,6 +47,8 @@ struct xe_spin_mem_copy {
  * @addr: offset of spinner within vm
  * @preempt: allow spinner to be preempted or not
  * @ctx_ticks: number of ticks after which spinner is stopped, applied if > 0
+ * @cs_timestamps: record the CS timestamp when the spinner starts and on
+ *		   every loop iteration
  * @mem_copy: container of objects used for memory copy (optional)
  *
  * Used to initialize struct xe_spin spinner behavior.
@@ -55,10 +58,15 @@ struct xe_spin_opts {
 	bool preempt;
 	uint32_t ctx_ticks;
 	bool write_timestamp;
+	bool cs_timestamps;
 	struct xe_spin_mem_copy *mem_copy;
 };
 
-/* Mapped GPU object */
+/*
+ * Mapped GPU object. With cs_timestamps @start_timestamp is the CS timestamp
+ * at which the spinner started and @end_timestamp the one of its last loop
+ * iteration, that is when it ended or was switched out.
+ */
 struct xe_spin {
 	uint32_t batch[128];
 	uint64_t pad;
@@ -67,6 +75,8 @@ struct xe_spin {
 	uint32_t ticks_delta;
 	uint64_t exec_sync;
 	uint32_t timestamp;
+	uint32_t start_timestamp;
+	uint32_t end_timestamp;
 };
 
 uint32_t xe_spin_nsec_to_ticks(int fd, int gt_id, uint64_t nsec);
@@ -77,6 +87,38 @@ bool xe_spin_started(struct xe_spin *spin);
 void xe_spin_wait_started(struct xe_spin *spin);
 void xe_spin_end(struct xe_spin *spin);
 
+/*
+ * xe_spin_array: several spinners sharing a single bo and bind, each one
+ * submitted to an exec_queue chosen by the caller.
+ */
+
+struct xe_spin_array {
+	int fd;
+	uint32_t vm;
+	uint32_t bo;
+	size_t bo_size;
+	size_t stride;
+	uint64_t addr;
+	uint64_t ahnd;
+	void *map;
+	unsigned int count;
+	uint32_t *syncobjs;
+	struct xe_spin_opts opts;
+};
+
+struct xe_spin_array *xe_spin_array_create(int fd, uint32_t vm,
+					   unsigned int count, uint64_t ahnd,
+					   struct xe_spin_opts *opts);
+#define xe_spin_array_create_opts(fd, vm, count, ahnd, ...) \
+	xe_spin_array_create(fd, vm, count, ahnd, \
+			     &((struct xe_spin_opts){__VA_ARGS__}))
+struct xe_spin *xe_spin_array_get(struct xe_spin_array *arr, unsigned int idx);
+uint64_t xe_spin_array_addr(struct xe_spin_array *arr, unsigned int idx);
+void xe_spin_array_submit(struct xe_spin_array *arr, unsigned int idx,
+			  uint32_t exec_queue);
+void xe_spin_array_sync_end(struct xe_spin_array *arr);
+void xe_spin_array_destroy(struct xe_spin_array *arr);
+
 /*
  * xe_cork: higher level API that simplifies exec'ing an xe_spin by taking care
  * of vm creation, exec call, etc.
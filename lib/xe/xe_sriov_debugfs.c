@@ -543,6 +543,35 @@ DEFINE_XE_SRIOV_PF_DEBUGFS_FUNC(bool *, get_boolean, __igt_sysfs_get_boolean)
  */
 DEFINE_XE_SRIOV_PF_DEBUGFS_FUNC(bool, set_boolean, __igt_sysfs_set_boolean)
 
+/**
+ * __xe_sriov_pf_debugfs_dir_set_u64 - Set a 64-bit unsigned integer in debugfs
+ * @pf: PF device file descriptor
+ * @dirfd: debugfs directory of @pf, as returned by igt_debugfs_dir()
+ * @vf_num: VF number
+ * @gt_num: GT number
+ * @attr: Debugfs attribute to write to
+ * @value: The value to set
+ *
+ * Like __xe_sriov_pf_debugfs_set_u64(), but with the debugfs directory
+ * already open, for writing many attributes in a row.
+ *
+ * Return: 0 on success, negative error code on failure.
+ */
+int __xe_sriov_pf_debugfs_dir_set_u64(int pf, int dirfd, unsigned int vf_num,
+				      unsigned int gt_num, const char *attr,
+				      uint64_t value)
+{
+	char attr_path[SRIOV_DEBUGFS_PATH_MAX];
+	int err;
+
+	err = attr_path_resolve(pf, vf_num, gt_num, attr, dirfd, attr_path,
+				sizeof(attr_path));
+	if (err)
+		return err;
+
+	return __igt_sysfs_set_u64(dirfd, attr_path, value) ? 0 : -1;
+}
+
 /**
  * __xe_sriov_vf_debugfs_get_selfconfig - Read VF's configuration data.
  * @vf: VF device file descriptor
@@ -32,6 +32,9 @@ int __xe_sriov_pf_debugfs_get_u64(int pf, unsigned int vf_num,
 int __xe_sriov_pf_debugfs_set_u64(int pf, unsigned int vf_num,
 				  unsigned int gt_num, const char *attr,
 				  uint64_t value);
+int __xe_sriov_pf_debugfs_dir_set_u64(int pf, int dirfd, unsigned int vf_num,
+				      unsigned int gt_num, const char *attr,
+				      uint64_t value);
 int __xe_sriov_pf_debugfs_get_boolean(int pf, unsigned int vf_num,
 				      unsigned int gt_num, const char *attr,
 				      bool *value);
@@ -722,6 +722,270 @@ void xe_sriov_set_sched_priority(int pf, unsigned int vf_num, unsigned int gt_nu
 	igt_fail_on(__xe_sriov_set_sched_priority(pf, vf_num, gt_num, value));
 }
 
+/**
+ * xe_sriov_config_create - Allocate an empty SR-IOV configuration
+ * @pf: PF device file descriptor
+ * @num_vfs: Number of VFs to enable
+ *
+ * Allocates a configuration enabling @num_vfs VFs of @pf, with no attribute
+ * staged yet: what isn't staged is left as it is by xe_sriov_config_apply().
+ *
+ * Return: The configuration, to be freed with xe_sriov_config_destroy().
+ */
+struct xe_sriov_config *xe_sriov_config_create(int pf, unsigned int num_vfs)
+{
+	struct xe_sriov_config *cfg;
+	unsigned int gt;
+
+	igt_assert(num_vfs <= igt_sriov_get_total_vfs(pf));
+
+	cfg = calloc(1, sizeof(*cfg));
+	igt_assert(cfg);
+
+	cfg->num_vfs = num_vfs;
+	xe_for_each_gt(pf, gt)
+		cfg->num_gts = max(cfg->num_gts, gt + 1);
+
+	cfg->fns = calloc(cfg->num_gts * (num_vfs + 1), sizeof(*cfg->fns));
+	igt_assert(cfg->fns);
+
+	return cfg;
+}
+
+/**
+ * xe_sriov_config_destroy - Free an SR-IOV configuration
+ * @cfg: Configuration from xe_sriov_config_create()
+ */
+void xe_sriov_config_destroy(struct xe_sriov_config *cfg)
+{
+	free(cfg->fns);
+	free(cfg);
+}
+
+static struct xe_sriov_fn_config *
+config_fn(struct xe_sriov_config *cfg, unsigned int vf_num, unsigned int gt_num)
+{
+	igt_assert(vf_num <= cfg->num_vfs && gt_num < cfg->num_gts);
+
+	return &cfg->fns[gt_num * (cfg->num_vfs + 1) + vf_num];
+}
+
+#define for_each_config_fn(fn__, cfg__, vf_num__, gt_num__) \
+	for (unsigned int n__ = (vf_num__) == XE_SRIOV_CONFIG_ALL ? 0 : (vf_num__); \
+	     n__ <= ((vf_num__) == XE_SRIOV_CONFIG_ALL ? (cfg__)->num_vfs : (vf_num__)) && \
+	     ((fn__) = config_fn((cfg__), n__, (gt_num__))); n__++)
+
+/**
+ * xe_sriov_config_set_quota - Stage the quota of a shared resource
+ * @cfg: Configuration
+ * @vf_num: VF number (1-based), 0 for PF or XE_SRIOV_CONFIG_ALL
+ * @gt_num: GT number
+ * @res: Shared resource type (see enum xe_sriov_shared_res)
+ * @value: Quota to set, the spare for the PF
+ */
+void xe_sriov_config_set_quota(struct xe_sriov_config *cfg, unsigned int vf_num,
+			       unsigned int gt_num, enum xe_sriov_shared_res res,
+			       uint64_t value)
+{
+	struct xe_sriov_fn_config *fn;
+
+	for_each_config_fn(fn, cfg, vf_num, gt_num) {
+		fn->quota[res] = value;
+		fn->set |= 1u << res;
+	}
+}
+
+/**
+ * xe_sriov_config_set_exec_quantum_ms - Stage the execution quantum
+ * @cfg: Configuration
+ * @vf_num: VF number (1-based), 0 for PF or XE_SRIOV_CONFIG_ALL
+ * @gt_num: GT number
+ * @value: Execution quantum in milliseconds
+ */
+void xe_sriov_config_set_exec_quantum_ms(struct xe_sriov_config *cfg,
+					 unsigned int vf_num,
+					 unsigned int gt_num, uint32_t value)
+{
+	struct xe_sriov_fn_config *fn;
+
+	for_each_config_fn(fn, cfg, vf_num, gt_num) {
+		fn->exec_quantum_ms = value;
+		fn->set |= XE_SRIOV_CONFIG_EXEC_QUANTUM;
+	}
+}
+
+/**
+ * xe_sriov_config_set_preempt_timeout_us - Stage the preemption timeout
+ * @cfg: Configuration
+ * @vf_num: VF number (1-based), 0 for PF or XE_SRIOV_CONFIG_ALL
+ * @gt_num: GT number
+ * @value: Preemption timeout in microseconds
+ */
+void xe_sriov_config_set_preempt_timeout_us(struct xe_sriov_config *cfg,
+					    unsigned int vf_num,
+					    unsigned int gt_num, uint32_t value)
+{
+	struct xe_sriov_fn_config *fn;
+
+	for_each_config_fn(fn, cfg, vf_num, gt_num) {
+		fn->preempt_timeout_us = value;
+		fn->set |= XE_SRIOV_CONFIG_PREEMPT_TIMEOUT;
+	}
+}
+
+/**
+ * xe_sriov_config_set_sched_priority - Stage the scheduling priority
+ * @cfg: Configuration
+ * @vf_num: VF number (1-based), 0 for PF or XE_SRIOV_CONFIG_ALL
+ * @gt_num: GT number
+ * @value: Scheduling priority (enum xe_sriov_sched_priority)
+ */
+void xe_sriov_config_set_sched_priority(struct xe_sriov_config *cfg,
+					unsigned int vf_num, unsigned int gt_num,
+					enum xe_sriov_sched_priority value)
+{
+	struct xe_sriov_fn_config *fn;
+
+	for_each_config_fn(fn, cfg, vf_num, gt_num) {
+		fn->sched_priority = value;
+		fn->set |= XE_SRIOV_CONFIG_SCHED_PRIORITY;
+	}
+}
+
+#define XE_SRIOV_CONFIG_QUOTAS ((1u << XE_SRIOV_SHARED_RES_NUM) - 1)
+
+static int config_write_fn(int pf, int dirfd, unsigned int vf_num,
+			   unsigned int gt_num,
+			   const struct xe_sriov_fn_config *fn, unsigned int mask)
+{
+	unsigned int set = fn->set & mask;
+	enum xe_sriov_shared_res res;
+	int ret = 0;
+
+	xe_sriov_for_each_shared_res(res) {
+		if (!(set & (1u << res)))
+			continue;
+
+		ret = __xe_sriov_pf_debugfs_dir_set_u64(pf, dirfd, vf_num, gt_num,
+							xe_sriov_shared_res_attr_name(res, vf_num),
+							fn->quota[res]);
+		if (ret)
+			return ret;
+	}
+
+	if (set & XE_SRIOV_CONFIG_EXEC_QUANTUM)
+		ret = __xe_sriov_pf_debugfs_dir_set_u64(pf, dirfd, vf_num, gt_num,
+							"exec_quantum_ms",
+							fn->exec_quantum_ms);
+	if (!ret && set & XE_SRIOV_CONFIG_PREEMPT_TIMEOUT)
+		ret = __xe_sriov_pf_debugfs_dir_set_u64(pf, dirfd, vf_num, gt_num,
+							"preempt_timeout_us",
+							fn->preempt_timeout_us);
+	if (!ret && set & XE_SRIOV_CONFIG_SCHED_PRIORITY)
+		ret = __xe_sriov_pf_debugfs_dir_set_u64(pf, dirfd, vf_num, gt_num,
+							"sched_priority",
+							fn->sched_priority);
+
+	return ret;
+}
+
+static int config_write(int pf, const struct xe_sriov_config *cfg,
+			unsigned int mask)
+{
+	unsigned int gt, vf_num;
+	int dirfd, ret = 0;
+
+	dirfd = igt_debugfs_dir(pf);
+	if (igt_debug_on(dirfd < 0))
+		return -ENOENT;
+
+	for (gt = 0; gt < cfg->num_gts && !ret; gt++)
+		for (vf_num = 0; vf_num <= cfg->num_vfs && !ret; vf_num++)
+			ret = config_write_fn(pf, dirfd, vf_num, gt,
+					      &cfg->fns[gt * (cfg->num_vfs + 1) + vf_num],
+					      mask);
+
+	close(dirfd);
+
+	return ret;
+}
+
+/**
+ * __xe_sriov_config_apply - Apply a staged SR-IOV configuration
+ * @pf: PF device file descriptor
+ * @cfg: Configuration
+ *
+ * Writes all the attributes staged in @cfg, through a single debugfs
+ * directory, and enables @cfg->num_vfs VFs, probing their driver all at the
+ * same time with igt_sriov_bind_vf_drm_drivers() if @cfg->probe is set.
+ *
+ * The quotas are written before the VFs are enabled and the scheduling
+ * attributes after. The VFs are disabled first only if some quota is staged
+ * or another number of VFs is enabled, so a configuration changing just the
+ * scheduling attributes of the enabled VFs doesn't cycle them. The VFs are
+ * enabled with the driver autoprobe off, the driver then being bound to all
+ * of them at once or not at all.
+ *
+ * Return: 0 on success, negative error code on failure.
+ */
+int __xe_sriov_config_apply(int pf, const struct xe_sriov_config *cfg)
+{
+	unsigned int enabled = igt_sriov_get_enabled_vfs(pf);
+	unsigned int set = 0;
+	bool autoprobe;
+	int ret;
+
+	for (unsigned int i = 0; i < cfg->num_gts * (cfg->num_vfs + 1); i++)
+		set |= cfg->fns[i].set;
+
+	/* Quotas can only be changed while the VFs are disabled */
+	if (enabled && (enabled != cfg->num_vfs || set & XE_SRIOV_CONFIG_QUOTAS)) {
+		igt_sriov_disable_vfs(pf);
+		enabled = 0;
+	}
+
+	if (set & XE_SRIOV_CONFIG_QUOTAS) {
+		ret = config_write(pf, cfg, XE_SRIOV_CONFIG_QUOTAS);
+		if (ret)
+			return ret;
+	}
+
+	if (!enabled && cfg->num_vfs) {
+		autoprobe = igt_sriov_is_driver_autoprobe_enabled(pf);
+		if (autoprobe)
+			igt_sriov_disable_driver_autoprobe(pf);
+
+		igt_sriov_enable_vfs(pf, cfg->num_vfs);
+
+		if (autoprobe)
+			igt_sriov_enable_driver_autoprobe(pf);
+	}
+
+	if (set & ~XE_SRIOV_CONFIG_QUOTAS) {
+		ret = config_write(pf, cfg, ~XE_SRIOV_CONFIG_QUOTAS);
+		if (ret)
+			return ret;
+	}
+
+	if (!enabled && cfg->num_vfs && cfg->probe)
+		igt_sriov_bind_vf_drm_drivers(pf, cfg->num_vfs);
+
+	return 0;
+}
+
+/**
+ * xe_sriov_config_apply - Apply a staged SR-IOV configuration
+ * @pf: PF device file descriptor
+ * @cfg: Configuration
+ *
+ * A throwing version of __xe_sriov_config_apply().
+ * Instead of returning an error code, it asserts in case of an error.
+ */
+void xe_sriov_config_apply(int pf, const struct xe_sriov_config *cfg)
+{
+	igt_fail_on(__xe_sriov_config_apply(pf, cfg));
+}
+
 /**
  * xe_sriov_require_default_scheduling_attributes - Ensure default SR-IOV scheduling attributes
  * @pf_fd: PF device file descriptor
@@ -90,6 +90,50 @@ struct xe_sriov_provisioned_range {
 	uint64_t end;
 };
 
+/**
+ * XE_SRIOV_CONFIG_ALL - Stage an attribute for the PF and all the VFs of a
+ * struct xe_sriov_config at once, in place of a VF number
+ */
+#define XE_SRIOV_CONFIG_ALL (~0u)
+
+/**
+ * struct xe_sriov_fn_config - Staged attributes of a PF or VF on a GT
+ * @set: Mask of the staged attributes, BIT(res) for the quota of a shared
+ *       resource and the XE_SRIOV_CONFIG_* bits for the others
+ * @quota: Quotas of the shared resources, spares for the PF
+ * @exec_quantum_ms: Execution quantum in milliseconds
+ * @preempt_timeout_us: Preemption timeout in microseconds
+ * @sched_priority: Scheduling priority
+ */
+struct xe_sriov_fn_config {
+	unsigned int set;
+	uint64_t quota[XE_SRIOV_SHARED_RES_NUM];
+	uint32_t exec_quantum_ms;
+	uint32_t preempt_timeout_us;
+	enum xe_sriov_sched_priority sched_priority;
+};
+
+#define XE_SRIOV_CONFIG_EXEC_QUANTUM	(1u << XE_SRIOV_SHARED_RES_NUM)
+#define XE_SRIOV_CONFIG_PREEMPT_TIMEOUT	(2u << XE_SRIOV_SHARED_RES_NUM)
+#define XE_SRIOV_CONFIG_SCHED_PRIORITY	(4u << XE_SRIOV_SHARED_RES_NUM)
+
+/**
+ * struct xe_sriov_config - Staged provisioning of a PF and its VFs
+ * @num_vfs: Number of VFs to enable
+ * @num_gts: Number of GTs in @fns
+ * @probe: Whether to bind the DRM driver to the VFs once they are enabled
+ * @fns: Staged attributes, of the PF and then the VFs of each GT in turn
+ *
+ * A whole configuration is staged with the xe_sriov_config_set_*() helpers
+ * and then written at once by xe_sriov_config_apply().
+ */
+struct xe_sriov_config {
+	unsigned int num_vfs;
+	unsigned int num_gts;
+	bool probe;
+	struct xe_sriov_fn_config *fns;
+};
+
 const char *xe_sriov_shared_res_to_string(enum xe_sriov_shared_res res);
 bool xe_sriov_is_shared_res_provisionable(int pf, enum xe_sriov_shared_res res, unsigned int gt);
 int xe_sriov_find_ggtt_provisioned_pte_offsets(int pf_fd, int gt, struct xe_mmio *mmio,
@@ -147,6 +191,22 @@ int __xe_sriov_set_sched_priority(int pf, unsigned int vf_num, unsigned int gt_n
 				  enum xe_sriov_sched_priority value);
 void xe_sriov_set_sched_priority(int pf, unsigned int vf_num, unsigned int gt_num,
 				 enum xe_sriov_sched_priority value);
+struct xe_sriov_config *xe_sriov_config_create(int pf, unsigned int num_vfs);
+void xe_sriov_config_destroy(struct xe_sriov_config *cfg);
+void xe_sriov_config_set_quota(struct xe_sriov_config *cfg, unsigned int vf_num,
+			       unsigned int gt_num, enum xe_sriov_shared_res res,
+			       uint64_t value);
+void xe_sriov_config_set_exec_quantum_ms(struct xe_sriov_config *cfg,
+					 unsigned int vf_num,
+					 unsigned int gt_num, uint32_t value);
+void xe_sriov_config_set_preempt_timeout_us(struct xe_sriov_config *cfg,
+					    unsigned int vf_num,
+					    unsigned int gt_num, uint32_t value);
+void xe_sriov_config_set_sched_priority(struct xe_sriov_config *cfg,
+					unsigned int vf_num, unsigned int gt_num,
+					enum xe_sriov_sched_priority value);
+int __xe_sriov_config_apply(int pf, const struct xe_sriov_config *cfg);
+void xe_sriov_config_apply(int pf, const struct xe_sriov_config *cfg);
 void xe_sriov_require_default_scheduling_attributes(int pf);
 void xe_sriov_disable_vfs_restore_auto_provisioning(int pf);
 
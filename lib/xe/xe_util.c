@@ -283,6 +283,21 @@ uint32_t xe_nsec_to_ticks(int fd, int gt_id, uint64_t nsec)
 	return div64_u64_round_up(nsec * refclock, NSEC_PER_SEC);
 }
 
+/**
+ * xe_ticks_to_nsec: convert timestamp ticks to time in nanoseconds
+ * @fd: opened device
+ * @gt_id: tile id
+ * @ticks: timestamp ticks
+ *
+ * Return: Timestamp ticks converted to nanoseconds.
+ */
+uint64_t xe_ticks_to_nsec(int fd, int gt_id, uint64_t ticks)
+{
+	uint32_t refclock = reference_clock(fd, gt_id);
+
+	return ticks * NSEC_PER_SEC / refclock;
+}
+
 /**
  * xe_fast_copy: simplify fast-copy from src to dst bo
  * @fd: opened device
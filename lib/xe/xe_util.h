@@ -48,6 +48,7 @@ void xe_bind_unbind_async(int fd, uint32_t vm, uint32_t bind_engine,
 			  uint32_t sync_in, uint32_t sync_out);
 
 uint32_t xe_nsec_to_ticks(int fd, int gt_id, uint64_t ns);
+uint64_t xe_ticks_to_nsec(int fd, int gt_id, uint64_t ticks);
 
 void xe_fast_copy(int fd,
 		  uint32_t src_bo, uint32_t src_region, uint8_t src_pat_index,
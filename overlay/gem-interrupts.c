@@ -34,6 +34,7 @@
 #include "igt_perf.h"
 
 #include "gem-interrupts.h"
+#include "pmu.h"
 #include "debugfs.h"
 
 static long long debugfs_read(void)
@@ -109,12 +110,13 @@ static long long interrupts_read(void)
 	return val;
 }
 
-int gem_interrupts_init(struct gem_interrupts *irqs)
+int gem_interrupts_init(struct gem_interrupts *irqs, struct pmu *pmu)
 {
 	memset(irqs, 0, sizeof(*irqs));
 
-	irqs->fd = perf_igfx_open(I915_PMU_INTERRUPTS);
-	if (irqs->fd < 0 && interrupts_read() < 0)
+	irqs->pmu = pmu;
+	irqs->idx = pmu_add(pmu, I915_PMU_INTERRUPTS);
+	if (irqs->idx < 0 && interrupts_read() < 0)
 		irqs->error = ENODEV;
 
 	return irqs->error;
@@ -128,7 +130,7 @@ int gem_interrupts_update(struct gem_interrupts *irqs)
 	if (irqs->error)
 		return irqs->error;
 
-	if (irqs->fd < 0) {
+	if (irqs->idx < 0) {
 		long long ret;
 		ret = interrupts_read();
 		if (ret < 0)
@@ -136,12 +138,8 @@ int gem_interrupts_update(struct gem_interrupts *irqs)
 		else
 			val = ret;
 	} else {
-		uint64_t data[2];
-
-		if (read(irqs->fd, data, sizeof(data)) < 0)
-			return irqs->error = errno;
-
-		val = data[0];
+		/* Sampled by pmu_update() on the shared counter group. */
+		val = pmu_value(irqs->pmu, irqs->idx);
 	}
 
 	update = irqs->last_count == 0;
@@ -27,13 +27,16 @@
 
 #include <stdint.h>
 
+struct pmu;
+
 struct gem_interrupts {
 	long unsigned last_count, count, delta;
 	int error;
-	int fd;
+	struct pmu *pmu;
+	int idx;
 };
 
-int gem_interrupts_init(struct gem_interrupts *irqs);
+int gem_interrupts_init(struct gem_interrupts *irqs, struct pmu *pmu);
 int gem_interrupts_update(struct gem_interrupts *irqs);
 
 #endif /* GEM_INTERRUPTS_H */
@@ -22,60 +22,39 @@
  *
  */
 
-#include <unistd.h>
-#include <fcntl.h>
 #include <errno.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "igt_drm_clients.h"
+#include "igt_drm_fdinfo.h"
+
 #include "gem-objects.h"
-#include "debugfs.h"
-
-/* /sys/kernel/debug/dri/0/i915_gem_objects:
- *	46 objects, 20107264 bytes
- *	42 [42] objects, 15863808 [15863808] bytes in gtt
- *	  0 [0] active objects, 0 [0] bytes
- *	  42 [42] inactive objects, 15863808 [15863808] bytes
- *	0 unbound objects, 0 bytes
- *	3 purgeable objects, 4456448 bytes
- *	30 pinned mappable objects, 3821568 bytes
- *	1 fault mappable objects, 3145728 bytes
- *	2145386496 [536870912] gtt total
- *
- *	Xorg: 35 objects, 16347136 bytes (0 active, 12103680 inactive, 0 unbound)
+
+#define IGPU_PCI "0000:00:02.0"
+
+/*
+ * Memory usage is taken from the drm-total-* and drm-resident-* keys in
+ * fdinfo, via the incremental client scanner which only re-parses the
+ * fdinfo of known DRM fds on each update, instead of having the driver
+ * walk every object to print i915_gem_objects in debugfs.
  */
 
-int gem_objects_init(struct gem_objects *obj)
+static bool client_match(const struct igt_drm_clients *clients,
+			 const struct drm_client_fdinfo *info)
 {
-	char buf[8192], *b;
-	int fd, len;
+	return !strcmp(info->driver, "i915") && !strcmp(info->pdev, IGPU_PCI);
+}
 
+int gem_objects_init(struct gem_objects *obj)
+{
 	memset(obj, 0, sizeof(*obj));
 
-	sprintf(buf, "%s/i915_gem_objects", debugfs_dri_path);
-	fd = open(buf, 0);
-	if (fd < 0)
-		return errno;
-	len = read(fd, buf+1, sizeof(buf)-2);
-	close(fd);
-
-	if (len < 0)
-		return EIO;
-
-	/* Add sentinel values for the string searches */
-	buf[0] = '\n';
-	buf[len+1] = '\0';
-
-	b = strstr(buf, "gtt total");
-	if (b == NULL)
-		return EIO;
-
-	while (*b != '\n')
-		b--;
-
-	sscanf(b, "%ld [%ld]",
-	       &obj->max_gtt, &obj->max_aperture);
+	obj->clients = igt_drm_clients_init(NULL);
+	if (obj->clients == NULL)
+		return ENOMEM;
 
 	return 0;
 }
@@ -93,93 +72,72 @@ static void insert_sorted(struct gem_objects *obj,
 	*prev = comm;
 }
 
-int gem_objects_update(struct gem_objects *obj)
+static struct gem_objects_comm *
+find_comm(struct gem_objects_comm *list, unsigned int pid)
 {
-	char buf[8192], *b;
-	struct gem_objects_comm *comm;
-	struct gem_objects_comm *freed;
-	int fd, len, ret;
-
-	freed = obj->comm;
-	obj->comm = NULL;
+	for (; list; list = list->next)
+		if (list->pid == pid)
+			return list;
 
-	sprintf(buf, "%s/i915_gem_objects", debugfs_dri_path);
-	fd = open(buf, 0);
-	if (fd < 0) {
-		ret = errno;
-		goto done;
-	}
-	len = read(fd, buf, sizeof(buf)-1);
-	close(fd);
-
-	if (len < 0) {
-		ret = EIO;
-		goto done;
-	}
-
-	buf[len] = '\0';
-	while (buf[--len] == '\n')
-		buf[len] = '\0';
-
-	b = buf;
+	return NULL;
+}
 
-	sscanf(b, "%lu objects, %lu bytes",
-	       &obj->total_count, &obj->total_bytes);
+int gem_objects_update(struct gem_objects *obj)
+{
+	struct gem_objects_comm *comm, *next;
+	struct gem_objects_comm *list = NULL;
+	struct igt_drm_client *c;
+	int tmp;
 
-	b = strchr(b, '\n');
-	sscanf(b, "%*d [%*d] objects, %lu [%lu] bytes in gtt",
-	       &obj->total_gtt, &obj->total_aperture);
+	if (obj->clients == NULL)
+		return ENODEV;
 
-	ret = 0;
-	b = strchr(b, ':');
-	if (b == NULL)
-		goto done;
+	igt_drm_clients_scan(obj->clients, client_match, NULL, 0, NULL, 0);
 
-	while (*b != '\n')
-		b--;
-	b++;
+	obj->total_bytes = obj->total_resident = 0;
 
-	do {
-		char *eol, *colon;
+	/* Clients are per DRM fd, sum up their memory per process. */
+	igt_for_each_drm_client(obj->clients, c, tmp) {
+		long unsigned bytes = 0, resident = 0;
+		unsigned int r;
 
-		comm = freed;
-		if (comm)
-			freed = comm->next;
-		else
-			comm = malloc(sizeof(*comm));
-		if (comm == NULL)
-			break;
+		if (c->status != IGT_DRM_CLIENT_ALIVE || !c->regions)
+			continue;
 
-		/* Xorg: 35 objects, 16347136 bytes (0 active, 12103680 inactive, 0 unbound) */
-		eol = strchr(b, '\n');
-		if (eol) {
-			do {
-			*eol++ = '\0';
-			} while (*eol == '\n');
+		for (r = 0; r <= c->regions->max_region_id; r++) {
+			bytes += c->memory[r].total;
+			resident += c->memory[r].resident;
 		}
 
-		colon = strchr(b, ':');
-		if (!colon) { /* out of buffer space */
-			free(comm);
-			break;
+		comm = find_comm(list, c->pid);
+		if (comm == NULL) {
+			comm = calloc(1, sizeof(*comm));
+			if (comm == NULL)
+				break;
+
+			comm->pid = c->pid;
+			snprintf(comm->name, sizeof(comm->name), "%s:",
+				 c->print_name);
+			comm->next = list;
+			list = comm;
 		}
 
-		memcpy(comm->name, b, colon-b+1);
-		comm->name[colon-b+1] = '\0';
+		comm->bytes += bytes;
+		comm->resident += resident;
+		obj->total_bytes += bytes;
+		obj->total_resident += resident;
+	}
 
-		sscanf(colon + 1, "%lu objects, %lu bytes",
-		       &comm->count, &comm->bytes);
+	for (comm = obj->comm; comm; comm = next) {
+		next = comm->next;
+		free(comm);
+	}
+	obj->comm = NULL;
 
+	for (comm = list; comm; comm = next) {
+		next = comm->next;
 		insert_sorted(obj, comm);
-		b = eol;
-	} while (b != NULL);
-
-done:
-	while (freed) {
-		comm = freed;
-		freed = comm->next;
-		free(comm);
 	}
 
-	return ret;
+	return 0;
 }
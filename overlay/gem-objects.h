@@ -27,15 +27,17 @@
 
 #include <stdint.h>
 
+struct igt_drm_clients;
+
 struct gem_objects {
-	long unsigned total_bytes, total_count;
-	long unsigned total_gtt, total_aperture;
-	long unsigned max_gtt, max_aperture;
+	struct igt_drm_clients *clients;
+	long unsigned total_bytes, total_resident;
 	struct gem_objects_comm {
 		struct gem_objects_comm *next;
 		char name[256];
+		unsigned int pid;
 		long unsigned bytes;
-		long unsigned count;
+		long unsigned resident;
 	} *comm;
 };
 
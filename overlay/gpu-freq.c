@@ -31,29 +31,19 @@
 #include "igt_perf.h"
 
 #include "gpu-freq.h"
+#include "pmu.h"
 #include "debugfs.h"
 
-static int perf_open(void)
-{
-	int fd;
-
-	fd = perf_igfx_open_group(I915_PMU_ACTUAL_FREQUENCY, -1);
-	if (perf_igfx_open_group(I915_PMU_REQUESTED_FREQUENCY, fd) < 0) {
-		close(fd);
-		fd = -1;
-	}
-
-	return fd;
-}
-
-int gpu_freq_init(struct gpu_freq *gf)
+int gpu_freq_init(struct gpu_freq *gf, struct pmu *pmu)
 {
 	char buf[4096], *s;
 	int fd, len = -1;
 
 	memset(gf, 0, sizeof(*gf));
 
-	gf->fd = perf_open();
+	gf->pmu = pmu;
+	gf->act_idx = pmu_add(pmu, I915_PMU_ACTUAL_FREQUENCY);
+	gf->req_idx = pmu_add(pmu, I915_PMU_REQUESTED_FREQUENCY);
 
 	sprintf(buf, "%s/i915_frequency_info", debugfs_dri_path);
 	fd = open(buf, 0);
@@ -119,7 +109,7 @@ int gpu_freq_update(struct gpu_freq *gf)
 	if (gf->error)
 		return gf->error;
 
-	if (gf->fd < 0) {
+	if (gf->act_idx < 0 || gf->req_idx < 0) {
 		char buf[4096], *s;
 		int fd, len = -1;
 
@@ -156,16 +146,12 @@ int gpu_freq_update(struct gpu_freq *gf)
 	} else {
 		struct gpu_freq_stat *s = &gf->stat[gf->count++&1];
 		struct gpu_freq_stat *d = &gf->stat[gf->count&1];
-		uint64_t data[4], d_time;
-		int len;
-
-		len = read(gf->fd, data, sizeof(data));
-		if (len < 0)
-			return gf->error = errno;
+		uint64_t d_time;
 
-		s->timestamp = data[1];
-		s->act = data[2];
-		s->req = data[3];
+		/* Sampled by pmu_update() on the shared counter group. */
+		s->timestamp = gf->pmu->time;
+		s->act = pmu_value(gf->pmu, gf->act_idx);
+		s->req = pmu_value(gf->pmu, gf->req_idx);
 
 		if (gf->count == 1)
 			return EAGAIN;
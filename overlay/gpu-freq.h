@@ -27,12 +27,15 @@
 
 #include <stdint.h>
 
+struct pmu;
+
 struct gpu_freq {
 	struct gpu_freq_stat {
 		uint64_t act, req;
 		uint64_t timestamp;
 	} stat[2];
-	int fd;
+	struct pmu *pmu;
+	int act_idx, req_idx;
 	int count;
 	int is_byt;
 	int min, max;
@@ -42,7 +45,7 @@ struct gpu_freq {
 	int error;
 };
 
-int gpu_freq_init(struct gpu_freq *gf);
+int gpu_freq_init(struct gpu_freq *gf, struct pmu *pmu);
 int gpu_freq_update(struct gpu_freq *gf);
 
 #endif /* GPU_FREQ_H */
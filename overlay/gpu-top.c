@@ -34,13 +34,7 @@
 #include "igt_perf.h"
 
 #include "gpu-top.h"
-
-#define RING_TAIL      0x00
-#define RING_HEAD      0x04
-#define ADDR_MASK      0x001FFFFC
-#define RING_CTL       0x0C
-#define   RING_WAIT		(1<<11)
-#define   RING_WAIT_SEMAPHORE	(1<<10)
+#include "pmu.h"
 
 static int perf_init(struct gpu_top *gt)
 {
@@ -56,116 +50,85 @@ static int perf_init(struct gpu_top *gt)
 		{ 0, 0, NULL }
 	};
 
-	d = &engines[0];
-
-	gt->fd = perf_igfx_open_group(I915_PMU_ENGINE_BUSY(d->class, d->inst),
-				      -1);
-	if (gt->fd < 0)
-		return -1;
-
-	if (perf_igfx_open_group(I915_PMU_ENGINE_WAIT(d->class, d->inst),
-				 gt->fd) >= 0)
-		gt->have_wait = 1;
-
-	if (perf_igfx_open_group(I915_PMU_ENGINE_SEMA(d->class, d->inst),
-				 gt->fd) >= 0)
-		gt->have_sema = 1;
-
-	gt->ring[0].name = d->name;
-	gt->num_rings = 1;
+	for (d = &engines[0]; d->name && gt->num_rings < MAX_RINGS; d++) {
+		struct gpu_top_ring *ring = &gt->ring[gt->num_rings];
 
-	for (d++; d->name; d++) {
-		if (perf_igfx_open_group(I915_PMU_ENGINE_BUSY(d->class,
-							      d->inst),
-					gt->fd) < 0)
+		ring->busy_idx = pmu_add(gt->pmu,
+					 I915_PMU_ENGINE_BUSY(d->class, d->inst));
+		if (ring->busy_idx < 0)
 			continue;
 
-		if (gt->have_wait &&
-		    perf_igfx_open_group(I915_PMU_ENGINE_WAIT(d->class,
-							      d->inst),
-					 gt->fd) < 0)
-			return -1;
+		ring->wait_idx = pmu_add(gt->pmu,
+					 I915_PMU_ENGINE_WAIT(d->class, d->inst));
+		if (ring->wait_idx >= 0)
+			gt->have_wait = 1;
 
-		if (gt->have_sema &&
-		    perf_igfx_open_group(I915_PMU_ENGINE_SEMA(d->class,
-							      d->inst),
-				   gt->fd) < 0)
-			return -1;
+		ring->sema_idx = pmu_add(gt->pmu,
+					 I915_PMU_ENGINE_SEMA(d->class, d->inst));
+		if (ring->sema_idx >= 0)
+			gt->have_sema = 1;
 
-		gt->ring[gt->num_rings++].name = d->name;
+		ring->name = d->name;
+		gt->num_rings++;
 	}
 
-	return 0;
+	return gt->num_rings ? 0 : -1;
 }
 
-void gpu_top_init(struct gpu_top *gt)
+void gpu_top_init(struct gpu_top *gt, struct pmu *pmu)
 {
 	memset(gt, 0, sizeof(*gt));
-	gt->fd = -1;
+	gt->pmu = pmu;
 
 	perf_init(gt);
 }
 
+static uint8_t busy_percent(uint64_t delta, uint64_t d_time)
+{
+	uint64_t busy = (100 * delta + d_time/2) / d_time;
+
+	/* in case of rounding + sampling errors, fudge */
+	return busy > 100 ? 100 : busy;
+}
+
+/* Must be called after pmu_update() on the shared counter group. */
 int gpu_top_update(struct gpu_top *gt)
 {
-	uint32_t data[1024];
-	int update, len;
+	struct gpu_top_stat *s, *d;
+	uint64_t d_time;
+	int n;
 
-	if (gt->fd < 0)
+	if (!gt->num_rings || !gt->pmu->count)
 		return 0;
 
-	if (gt->type == PERF) {
-		struct gpu_top_stat *s = &gt->stat[gt->count++&1];
-		struct gpu_top_stat *d = &gt->stat[gt->count&1];
-		uint64_t *sample, d_time;
-		int n, m;
-
-		len = read(gt->fd, data, sizeof(data));
-		if (len < 0)
-			return 0;
-
-		sample = (uint64_t *)data + 1;
-
-		s->time = *sample++;
-		for (n = m = 0; n < gt->num_rings; n++) {
-			s->busy[n] = sample[m++];
-			if (gt->have_wait)
-				s->wait[n] = sample[m++];
-			if (gt->have_sema)
-				s->sema[n] = sample[m++];
-		}
-
-		if (gt->count == 1)
-			return 0;
-
-		d_time = s->time - d->time;
-		for (n = 0; n < gt->num_rings; n++) {
-			gt->ring[n].u.u.busy = (100 * (s->busy[n] - d->busy[n]) + d_time/2) / d_time;
-			if (gt->have_wait)
-				gt->ring[n].u.u.wait = (100 * (s->wait[n] - d->wait[n]) + d_time/2) / d_time;
-			if (gt->have_sema)
-				gt->ring[n].u.u.sema = (100 * (s->sema[n] - d->sema[n]) + d_time/2) / d_time;
-
-			/* in case of rounding + sampling errors, fudge */
-			if (gt->ring[n].u.u.busy > 100)
-				gt->ring[n].u.u.busy = 100;
-			if (gt->ring[n].u.u.wait > 100)
-				gt->ring[n].u.u.wait = 100;
-			if (gt->ring[n].u.u.sema > 100)
-				gt->ring[n].u.u.sema = 100;
-		}
-
-		update = 1;
-	} else {
-		while ((len = read(gt->fd, data, sizeof(data))) > 0) {
-			uint32_t *ptr = &data[len/sizeof(uint32_t) - MAX_RINGS];
-			gt->ring[0].u.payload = ptr[0];
-			gt->ring[1].u.payload = ptr[1];
-			gt->ring[2].u.payload = ptr[2];
-			gt->ring[3].u.payload = ptr[3];
-			update = 1;
-		}
+	s = &gt->stat[gt->count++&1];
+	d = &gt->stat[gt->count&1];
+
+	s->time = gt->pmu->time;
+	for (n = 0; n < gt->num_rings; n++) {
+		struct gpu_top_ring *ring = &gt->ring[n];
+
+		s->busy[n] = pmu_value(gt->pmu, ring->busy_idx);
+		if (ring->wait_idx >= 0)
+			s->wait[n] = pmu_value(gt->pmu, ring->wait_idx);
+		if (ring->sema_idx >= 0)
+			s->sema[n] = pmu_value(gt->pmu, ring->sema_idx);
+	}
+
+	if (gt->count == 1)
+		return 0;
+
+	d_time = s->time - d->time;
+	if (d_time == 0) {
+		gt->count--;
+		return 0;
+	}
+
+	for (n = 0; n < gt->num_rings; n++) {
+		gt->ring[n].u.u.busy = busy_percent(s->busy[n] - d->busy[n], d_time);
+		gt->ring[n].u.u.wait = busy_percent(s->wait[n] - d->wait[n], d_time);
+		gt->ring[n].u.u.sema = busy_percent(s->sema[n] - d->sema[n], d_time);
 	}
 
-	return update;
+	return 1;
 }
@@ -29,9 +29,10 @@
 
 #include <stdint.h>
 
+struct pmu;
+
 struct gpu_top {
-	enum { PERF, MMIO } type;
-	int fd;
+	struct pmu *pmu;
 
 	int num_rings;
 	int have_wait;
@@ -39,6 +40,7 @@ struct gpu_top {
 
 	struct gpu_top_ring {
 		const char *name;
+		int busy_idx, wait_idx, sema_idx;
 		union gpu_top_payload {
 			struct {
 				uint8_t busy;
@@ -58,7 +60,7 @@ struct gpu_top {
 	int count;
 };
 
-void gpu_top_init(struct gpu_top *gt);
+void gpu_top_init(struct gpu_top *gt, struct pmu *pmu);
 int gpu_top_update(struct gpu_top *gt);
 
 #endif /* GPU_TOP_H */
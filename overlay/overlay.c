@@ -25,6 +25,7 @@
 #include <sys/types.h>
 #include <sys/mman.h>
 #include <cairo.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
@@ -47,6 +48,7 @@
 #include "gpu-freq.h"
 #include "gpu-top.h"
 #include "gpu-perf.h"
+#include "pmu.h"
 #include "power.h"
 #include "rc6.h"
 
@@ -101,6 +103,8 @@ struct overlay_gpu_top {
 	struct chart busy[MAX_RINGS];
 	struct chart wait[MAX_RINGS];
 	struct chart cpu;
+	int update;
+	int has_cpu;
 };
 
 struct overlay_gpu_perf {
@@ -118,12 +122,16 @@ struct overlay_gpu_freq {
 	struct chart request;
 	struct chart power_chart;
 	double power_max;
+	int has_freq;
+	int has_rc6;
+	int has_power;
+	int has_irqs;
 };
 
 struct overlay_gem_objects {
 	struct gem_objects gem_objects;
-	struct chart aperture;
-	struct chart gtt;
+	struct chart resident;
+	struct chart total;
 	int error;
 };
 
@@ -134,6 +142,18 @@ struct overlay_context {
 
 	time_t time;
 
+	/*
+	 * The counters are sampled from a separate thread, so that the
+	 * sampling period is not disturbed by how long it takes to present
+	 * the overlay. The lock protects the panels below against the
+	 * renderer, which redraws for every new generation of samples.
+	 */
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	unsigned int generation;
+	int sample_period;
+	struct pmu pmu;
+
 	struct overlay_gpu_top gpu_top;
 	struct overlay_gpu_perf gpu_perf;
 	struct overlay_gpu_freq gpu_freq;
@@ -153,7 +173,7 @@ static void init_gpu_top(struct overlay_context *ctx,
 	int n;
 
 	cpu_top_init(&gt->cpu_top);
-	gpu_top_init(&gt->gpu_top);
+	gpu_top_init(&gt->gpu_top, &ctx->pmu);
 
 	chart_init(&gt->cpu, "CPU", 120);
 	chart_set_position(&gt->cpu, PAD, PAD);
@@ -189,20 +209,18 @@ static void init_gpu_top(struct overlay_context *ctx,
 
 static void show_gpu_top(struct overlay_context *ctx, struct overlay_gpu_top *gt)
 {
-	int y, y1, y2, n, update, len;
+	int y, y1, y2, n, update = gt->update, len;
 	cairo_pattern_t *linear;
 	char txt[160];
 	int rewind;
 	int do_rewind;
 
-	update = gpu_top_update(&gt->gpu_top);
-
 	cairo_rectangle(ctx->cr, PAD-.5, PAD-.5, ctx->width/2-SIZE_PAD+1, ctx->height/2-SIZE_PAD+1);
 	cairo_set_source_rgb(ctx->cr, .15, .15, .15);
 	cairo_set_line_width(ctx->cr, 1);
 	cairo_stroke(ctx->cr);
 
-	if (update && cpu_top_update(&gt->cpu_top) == 0)
+	if (gt->has_cpu)
 		chart_add_sample(&gt->cpu, gt->cpu_top.busy);
 
 	for (n = 0; n < gt->gpu_top.num_rings; n++) {
@@ -325,8 +343,6 @@ static void show_gpu_perf(struct overlay_context *ctx, struct overlay_gpu_perf *
 	int has_ctx = 0;
 	int has_flips = 0;
 
-	gpu_perf_update(&gp->gpu_perf);
-
 	for (n = 0; n < MAX_RINGS; n++) {
 		if (gp->gpu_perf.ctx_switch[n])
 			has_ctx = n + 1;
@@ -541,7 +557,7 @@ skip_comm:
 static void init_gpu_freq(struct overlay_context *ctx,
 			  struct overlay_gpu_freq *gf)
 {
-	if (gpu_freq_init(&gf->gpu_freq) == 0) {
+	if (gpu_freq_init(&gf->gpu_freq, &ctx->pmu) == 0) {
 		chart_init(&gf->current, "current", 120);
 		chart_set_position(&gf->current, PAD, ctx->height/2 + HALF_PAD);
 		chart_set_size(&gf->current, ctx->width/2 - SIZE_PAD, ctx->height/2 - SIZE_PAD);
@@ -567,8 +583,8 @@ static void init_gpu_freq(struct overlay_context *ctx,
 		gf->power_max = 0;
 	}
 
-	rc6_init(&gf->rc6);
-	gem_interrupts_init(&gf->irqs);
+	rc6_init(&gf->rc6, &ctx->pmu);
+	gem_interrupts_init(&gf->irqs, &ctx->pmu);
 }
 
 static void show_gpu_freq(struct overlay_context *ctx, struct overlay_gpu_freq *gf)
@@ -576,10 +592,10 @@ static void show_gpu_freq(struct overlay_context *ctx, struct overlay_gpu_freq *
 	char buf[160];
 	int y1, y2, y, len;
 
-	int has_freq = gpu_freq_update(&gf->gpu_freq) == 0;
-	int has_rc6 = rc6_update(&gf->rc6) == 0;
-	int has_power = power_update(&gf->power) == 0;
-	int has_irqs = gem_interrupts_update(&gf->irqs) == 0;
+	int has_freq = gf->has_freq;
+	int has_rc6 = gf->has_rc6;
+	int has_power = gf->has_power;
+	int has_irqs = gf->has_irqs;
 	cairo_pattern_t *linear;
 
 	cairo_rectangle(ctx->cr, PAD-.5, ctx->height/2+HALF_PAD-.5, ctx->width/2-SIZE_PAD+1, ctx->height/2-SIZE_PAD+1);
@@ -727,19 +743,17 @@ static void init_gem_objects(struct overlay_context *ctx,
 	if (go->error)
 		return;
 
-	chart_init(&go->aperture, "aperture", 120);
-	chart_set_position(&go->aperture, ctx->width/2+HALF_PAD, ctx->height/2 + HALF_PAD);
-	chart_set_size(&go->aperture, ctx->width/2 - SIZE_PAD, ctx->height/2 - SIZE_PAD);
-	chart_set_stroke_rgba(&go->aperture, 0.75, 0.25, 0.50, 1.);
-	chart_set_mode(&go->aperture, CHART_STROKE);
-	chart_set_range(&go->aperture, 0, go->gem_objects.max_gtt);
-
-	chart_init(&go->gtt, "gtt", 120);
-	chart_set_position(&go->gtt, ctx->width/2+HALF_PAD, ctx->height/2 + HALF_PAD);
-	chart_set_size(&go->gtt, ctx->width/2 - SIZE_PAD, ctx->height/2 - SIZE_PAD);
-	chart_set_fill_rgba(&go->gtt, 0.25, 0.5, 0.5, 1.);
-	chart_set_mode(&go->gtt, CHART_FILL);
-	chart_set_range(&go->gtt, 0, go->gem_objects.max_gtt);
+	chart_init(&go->resident, "resident", 120);
+	chart_set_position(&go->resident, ctx->width/2+HALF_PAD, ctx->height/2 + HALF_PAD);
+	chart_set_size(&go->resident, ctx->width/2 - SIZE_PAD, ctx->height/2 - SIZE_PAD);
+	chart_set_stroke_rgba(&go->resident, 0.75, 0.25, 0.50, 1.);
+	chart_set_mode(&go->resident, CHART_STROKE);
+
+	chart_init(&go->total, "total", 120);
+	chart_set_position(&go->total, ctx->width/2+HALF_PAD, ctx->height/2 + HALF_PAD);
+	chart_set_size(&go->total, ctx->width/2 - SIZE_PAD, ctx->height/2 - SIZE_PAD);
+	chart_set_fill_rgba(&go->total, 0.25, 0.5, 0.5, 1.);
+	chart_set_mode(&go->total, CHART_FILL);
 }
 
 static void show_gem_objects(struct overlay_context *ctx, struct overlay_gem_objects *go)
@@ -747,10 +761,9 @@ static void show_gem_objects(struct overlay_context *ctx, struct overlay_gem_obj
 	struct gem_objects_comm *comm;
 	char buf[310];
 	cairo_pattern_t *linear;
+	double range[2];
 	int x, y, y1, y2;
 
-	if (go->error == 0)
-		go->error = gem_objects_update(&go->gem_objects);
 	if (go->error)
 		return;
 
@@ -759,11 +772,17 @@ static void show_gem_objects(struct overlay_context *ctx, struct overlay_gem_obj
 	cairo_set_line_width(ctx->cr, 1);
 	cairo_stroke(ctx->cr);
 
-	chart_add_sample(&go->gtt, go->gem_objects.total_gtt);
-	chart_add_sample(&go->aperture, go->gem_objects.total_aperture);
+	chart_add_sample(&go->total, go->gem_objects.total_bytes);
+	chart_add_sample(&go->resident, go->gem_objects.total_resident);
 
-	chart_draw(&go->gtt, ctx->cr);
-	chart_draw(&go->aperture, ctx->cr);
+	range[0] = range[1] = 0;
+	chart_get_range(&go->total, range);
+	chart_get_range(&go->resident, range);
+	chart_set_range(&go->total, 0, range[1]);
+	chart_set_range(&go->resident, 0, range[1]);
+
+	chart_draw(&go->total, ctx->cr);
+	chart_draw(&go->resident, ctx->cr);
 
 
 	y = ctx->height/2 + HALF_PAD + 12 - 2;
@@ -787,8 +806,9 @@ static void show_gem_objects(struct overlay_context *ctx, struct overlay_gem_obj
 	cairo_pattern_destroy(linear);
 	cairo_fill(ctx->cr);
 
-	sprintf(buf, "Total: %ldMB, %ld objects",
-		go->gem_objects.total_bytes >> 20, go->gem_objects.total_count);
+	sprintf(buf, "Total: %ldMB, %ldMB resident",
+		go->gem_objects.total_bytes >> 20,
+		go->gem_objects.total_resident >> 20);
 	cairo_set_source_rgba(ctx->cr, 1, 1, 1, 1);
 	cairo_move_to(ctx->cr, x, y);
 	cairo_show_text(ctx->cr, buf);
@@ -800,8 +820,8 @@ static void show_gem_objects(struct overlay_context *ctx, struct overlay_gem_obj
 		if ((comm->bytes >> 20) == 0)
 			break;
 
-		sprintf(buf, "%s %ldMB, %ld objects",
-			comm->name, comm->bytes >> 20, comm->count);
+		sprintf(buf, "%s %ldMB, %ldMB resident",
+			comm->name, comm->bytes >> 20, comm->resident >> 20);
 		cairo_move_to(ctx->cr, x, y);
 		cairo_show_text(ctx->cr, buf);
 		y += 12;
@@ -830,6 +850,49 @@ static int get_sample_period(struct config *config)
 	return 500000;
 }
 
+static void update_gpu_top(struct overlay_gpu_top *gt)
+{
+	gt->update = gpu_top_update(&gt->gpu_top);
+	gt->has_cpu = gt->update && cpu_top_update(&gt->cpu_top) == 0;
+}
+
+static void update_gpu_freq(struct overlay_gpu_freq *gf)
+{
+	gf->has_freq = gpu_freq_update(&gf->gpu_freq) == 0;
+	gf->has_rc6 = rc6_update(&gf->rc6) == 0;
+	gf->has_power = power_update(&gf->power) == 0;
+	gf->has_irqs = gem_interrupts_update(&gf->irqs) == 0;
+}
+
+static void update_gem_objects(struct overlay_gem_objects *go)
+{
+	if (go->error == 0)
+		go->error = gem_objects_update(&go->gem_objects);
+}
+
+static void *sampler(void *arg)
+{
+	struct overlay_context *ctx = arg;
+
+	for (;;) {
+		/* One read of the counter group feeds all the panels. */
+		pmu_update(&ctx->pmu);
+
+		pthread_mutex_lock(&ctx->lock);
+		update_gpu_top(&ctx->gpu_top);
+		gpu_perf_update(&ctx->gpu_perf.gpu_perf);
+		update_gpu_freq(&ctx->gpu_freq);
+		update_gem_objects(&ctx->gem_objects);
+		ctx->generation++;
+		pthread_cond_signal(&ctx->cond);
+		pthread_mutex_unlock(&ctx->lock);
+
+		usleep(ctx->sample_period);
+	}
+
+	return NULL;
+}
+
 static void overlay_snapshot(struct overlay_context *ctx)
 {
 	char buf[1024];
@@ -862,7 +925,9 @@ int main(int argc, char **argv)
 	};
 	struct overlay_context ctx;
 	struct config config;
-	int index, sample_period;
+	unsigned int generation = 0;
+	pthread_t thread;
+	int index;
 	int daemonize = 1, renice = 0;
 	int i;
 
@@ -924,16 +989,27 @@ int main(int argc, char **argv)
 	signal(SIGUSR1, signal_snapshot);
 
 	debugfs_init();
+	pmu_init(&ctx.pmu);
 
 	init_gpu_top(&ctx, &ctx.gpu_top);
 	init_gpu_perf(&ctx, &ctx.gpu_perf);
 	init_gpu_freq(&ctx, &ctx.gpu_freq);
 	init_gem_objects(&ctx, &ctx.gem_objects);
 
-	sample_period = get_sample_period(&config);
+	ctx.sample_period = get_sample_period(&config);
+	ctx.generation = 0;
+	pthread_mutex_init(&ctx.lock, NULL);
+	pthread_cond_init(&ctx.cond, NULL);
+	i = pthread_create(&thread, NULL, sampler, &ctx);
+	if (i)
+		return i;
 
-	i = 0;
 	while (1) {
+		pthread_mutex_lock(&ctx.lock);
+		while (ctx.generation == generation)
+			pthread_cond_wait(&ctx.cond, &ctx.lock);
+		generation = ctx.generation;
+
 		ctx.time = time(NULL);
 
 		ctx.cr = cairo_create(ctx.surface);
@@ -960,6 +1036,7 @@ int main(int argc, char **argv)
 		}
 
 		cairo_destroy(ctx.cr);
+		pthread_mutex_unlock(&ctx.lock);
 
 		overlay_show(ctx.surface);
 
@@ -967,8 +1044,6 @@ int main(int argc, char **argv)
 			overlay_snapshot(&ctx);
 			take_snapshot = 0;
 		}
-
-		usleep(sample_period);
 	}
 
 	return 0;
@@ -0,0 +1,62 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2024 Intel Corporation
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "igt_perf.h"
+
+#include "pmu.h"
+
+void pmu_init(struct pmu *pmu)
+{
+	memset(pmu, 0, sizeof(*pmu));
+	pmu->fd = -1;
+}
+
+/*
+ * Adds the i915 counter @config to the group, returning its index for
+ * pmu_value() or -1 if the counter is not available.
+ */
+int pmu_add(struct pmu *pmu, uint64_t config)
+{
+	int fd;
+
+	if (pmu->num_counters == MAX_PMU_COUNTERS)
+		return -1;
+
+	fd = perf_igfx_open_group(config, pmu->fd);
+	if (fd < 0)
+		return -1;
+
+	if (pmu->fd < 0)
+		pmu->fd = fd;
+
+	return pmu->num_counters++;
+}
+
+int pmu_update(struct pmu *pmu)
+{
+	uint64_t data[2 + MAX_PMU_COUNTERS];
+	ssize_t len;
+	int n;
+
+	if (pmu->fd < 0)
+		return ENODEV;
+
+	len = read(pmu->fd, data, sizeof(data));
+	if (len < 0)
+		return errno;
+	if (len < (2 + pmu->num_counters) * sizeof(uint64_t))
+		return EIO;
+
+	pmu->time = data[1];
+	for (n = 0; n < pmu->num_counters; n++)
+		pmu->value[n] = data[2 + n];
+	pmu->count++;
+
+	return 0;
+}
@@ -0,0 +1,36 @@
+/* SPDX-License-Identifier: MIT */
+/*
+ * Copyright © 2024 Intel Corporation
+ */
+
+#ifndef PMU_H
+#define PMU_H
+
+#include <stdint.h>
+
+#define MAX_PMU_COUNTERS 64
+
+/*
+ * All i915 counters used by the overlay are opened as a single perf group,
+ * so one read() per sample period returns a consistent snapshot for every
+ * panel instead of each of them reading their own counters.
+ */
+struct pmu {
+	int fd;
+	int num_counters;
+	int count;
+
+	uint64_t time;
+	uint64_t value[MAX_PMU_COUNTERS];
+};
+
+void pmu_init(struct pmu *pmu);
+int pmu_add(struct pmu *pmu, uint64_t config);
+int pmu_update(struct pmu *pmu);
+
+static inline uint64_t pmu_value(const struct pmu *pmu, int idx)
+{
+	return pmu->value[idx];
+}
+
+#endif /* PMU_H */
@@ -34,13 +34,15 @@
 #include "igt_perf.h"
 
 #include "rc6.h"
+#include "pmu.h"
 
-int rc6_init(struct rc6 *rc6)
+int rc6_init(struct rc6 *rc6, struct pmu *pmu)
 {
 	memset(rc6, 0, sizeof(*rc6));
 
-	rc6->fd = perf_igfx_open(I915_PMU_RC6_RESIDENCY);
-	if (rc6->fd < 0) {
+	rc6->pmu = pmu;
+	rc6->idx = pmu_add(pmu, I915_PMU_RC6_RESIDENCY);
+	if (rc6->idx < 0) {
 		struct stat st;
 		if (stat("/sys/class/drm/card0/power", &st) < 0)
 			return rc6->error = errno;
@@ -88,7 +90,7 @@ int rc6_update(struct rc6 *rc6)
 	if (rc6->error)
 		return rc6->error;
 
-	if (rc6->fd < 0) {
+	if (rc6->idx < 0) {
 		struct stat st;
 
 		if (stat("/sys/class/drm/card0/power/rc6_residency_ms", &st) < 0)
@@ -99,13 +101,9 @@ int rc6_update(struct rc6 *rc6)
 		s->rc6pp_residency = file_to_u64("/sys/class/drm/card0/power/rc6pp_residency_ms");
 		s->timestamp = clock_ms_to_u64();
 	} else {
-		uint64_t data[2];
-
-		if (read(rc6->fd, data, sizeof(data)) < sizeof(data))
-			return rc6->error = errno;
-
-		s->timestamp = data[1] / 1e6;
-		s->rc6_residency = data[0] / 1e6;
+		/* Sampled by pmu_update() on the shared counter group. */
+		s->timestamp = rc6->pmu->time / 1e6;
+		s->rc6_residency = pmu_value(rc6->pmu, rc6->idx) / 1e6;
 	}
 
 	if (rc6->count == 1)
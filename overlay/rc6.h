@@ -27,6 +27,8 @@
 
 #include <stdint.h>
 
+struct pmu;
+
 struct rc6 {
 	struct rc6_stat {
 		uint64_t rc6_residency;
@@ -35,7 +37,8 @@ struct rc6 {
 		uint64_t timestamp;
 	} stat[2];
 
-	int fd;
+	struct pmu *pmu;
+	int idx;
 	int count;
 	int error;
 
@@ -47,7 +50,7 @@ struct rc6 {
 	uint8_t rc6_combined;
 };
 
-int rc6_init(struct rc6 *rc6);
+int rc6_init(struct rc6 *rc6, struct pmu *pmu);
 int rc6_update(struct rc6 *rc6);
 
 #endif /* RC6_H */
@@ -1,6 +1,7 @@
 #include <ctype.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <math.h>
 #ifdef ANDROID
 #include "android/glib.h"
 #else
@@ -18,8 +19,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/ioctl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/mman.h>
-#include <sys/select.h>
 #include <sys/signalfd.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
@@ -29,17 +31,24 @@
 #include <sys/wait.h>
 #include <dirent.h>
 #include <poll.h>
+#include <pthread.h>
 #include <time.h>
 #include <unistd.h>
+#include <zlib.h>
 
 #include "igt_aux.h"
 #include "igt_core.h"
+#include "igt_device_scan.h"
 #include "igt_facts.h"
 #include "igt_taints.h"
 #include "igt_vec.h"
 #include "executor.h"
 #include "kmemleak.h"
+#include "live_results.h"
+#include "memcg.h"
 #include "output_strings.h"
+#include "resources.h"
+#include "resultgen.h"
 #include "runnercomms.h"
 
 #define KMSG_HEADER "[IGT] "
@@ -545,6 +554,53 @@ static const char *filenames[_F_LAST] = {
 	[_F_SOCKET] = "comms",
 };
 
+/*
+ * Prunes the already executed subtests from @entry using the results
+ * in @dirfd.
+ *
+ * Returns: true if the entry needs to be (re-)executed, false if it
+ * was completed or is not suitable to re-run.
+ */
+static bool prune_entry(int dirfd, struct job_list_entry *entry)
+{
+	bool rerun = true;
+	int fd;
+
+	if ((fd = openat(dirfd, filenames[_F_SOCKET], O_RDONLY)) >= 0) {
+		if (!prune_from_comms(entry, fd)) {
+			/*
+			 * No subtests, or incomplete before the first
+			 * subtest. Not suitable to re-run.
+			 */
+			rerun = false;
+		} else if (entry->binary[0] == '\0') {
+			/* Full completed */
+			rerun = false;
+		}
+
+		close (fd);
+	}
+
+	if ((fd = openat(dirfd, filenames[_F_JOURNAL], O_RDONLY)) >= 0) {
+		if (!prune_from_journal(entry, fd)) {
+			/*
+			 * The test does not have subtests, or
+			 * incompleted before the first subtest
+			 * began. Either way, not suitable to
+			 * re-run.
+			 */
+			rerun = false;
+		} else if (entry->binary[0] == '\0') {
+			/* This test is fully completed */
+			rerun = false;
+		}
+
+		close(fd);
+	}
+
+	return rerun;
+}
+
 static int open_at_end(int dirfd, const char *name)
 {
 	int fd = openat(dirfd, name, O_RDWR | O_CREAT | O_CLOEXEC, 0666);
@@ -562,9 +618,53 @@ static int open_at_end(int dirfd, const char *name)
 	return fd;
 }
 
+/*
+ * Decompresses the gzip file @name into an anonymous file, so readers
+ * can mmap() or stdio it like an uncompressed output file. Whatever
+ * could be decompressed of a truncated file is kept.
+ */
+static int open_decompressed(int dirfd, const char *name)
+{
+	char buf[65536];
+	gzFile gz;
+	int fd, memfd;
+	int s;
+
+	if ((fd = openat(dirfd, name, O_RDONLY | O_CLOEXEC)) < 0)
+		return -1;
+
+	if ((memfd = memfd_create(name, MFD_CLOEXEC)) < 0) {
+		close(fd);
+		return -1;
+	}
+
+	if ((gz = gzdopen(fd, "rb")) == NULL) {
+		close(fd);
+		close(memfd);
+		errno = ENOMEM;
+		return -1;
+	}
+
+	while ((s = gzread(gz, buf, sizeof(buf))) > 0)
+		write(memfd, buf, s);
+	gzclose(gz);
+
+	lseek(memfd, 0, SEEK_SET);
+	return memfd;
+}
+
 static int open_for_reading(int dirfd, const char *name)
 {
-	return openat(dirfd, name, O_RDONLY);
+	char gzname[32];
+	int fd;
+
+	fd = openat(dirfd, name, O_RDONLY);
+	if (fd >= 0 || errno != ENOENT)
+		return fd;
+
+	/* Written with --compress-output? */
+	snprintf(gzname, sizeof(gzname), "%s.gz", name);
+	return open_decompressed(dirfd, gzname);
 }
 
 bool open_output_files(int dirfd, int *fds, bool write)
@@ -629,6 +729,302 @@ static void fsync_outputs(int *fds)
 	}
 }
 
+/*
+ * With --compress-output, out.txt, err.txt and dmesg.txt are written
+ * as out.txt.gz etc. The executor writes to a pipe in outputs[] as
+ * usual and a thread per file compresses from the pipe to the file,
+ * keeping the compression off the monitoring loop.
+ */
+struct output_compressor {
+	pthread_t thread;
+	int pipefd;
+	int fd;
+	gzFile gz;
+	bool sync;
+	off_t base;
+	size_t in; /* uncompressed octets, atomic */
+	size_t out; /* compressed octets, atomic */
+	bool running;
+};
+
+static struct output_compressor compressors[_F_LAST];
+
+static bool is_compressible(int fid)
+{
+	return fid == _F_OUT || fid == _F_ERR || fid == _F_DMESG;
+}
+
+static void *output_compressor_thread(void *arg)
+{
+	struct output_compressor *c = arg;
+	char buf[65536];
+	ssize_t s;
+	int avail;
+
+	while ((s = read(c->pipefd, buf, sizeof(buf))) != 0) {
+		if (s < 0) {
+			if (errno == EINTR)
+				continue;
+
+			errf("Error reading output to compress: %m\n");
+			break;
+		}
+
+		if (gzwrite(c->gz, buf, s) != s)
+			errf("Error writing compressed output\n");
+
+		/*
+		 * Once the test goes quiet, make everything so far
+		 * decompressable from the file in case we don't get
+		 * to close it properly.
+		 */
+		if (c->sync ||
+		    (!ioctl(c->pipefd, FIONREAD, &avail) && avail == 0))
+			gzflush(c->gz, Z_SYNC_FLUSH);
+		if (c->sync)
+			fdatasync(c->fd);
+
+		__atomic_add_fetch(&c->in, s, __ATOMIC_RELAXED);
+		__atomic_store_n(&c->out, lseek(c->fd, 0, SEEK_CUR) - c->base,
+				 __ATOMIC_RELAXED);
+	}
+
+	return NULL;
+}
+
+/*
+ * Replaces outputs[@fid] with the write end of a pipe that gets
+ * compressed to the real file.
+ */
+static bool start_compressor(int *outputs, int fid, bool sync)
+{
+	struct output_compressor *c = &compressors[fid];
+	int pipefds[2];
+
+	if (pipe2(pipefds, O_CLOEXEC))
+		return false;
+
+	memset(c, 0, sizeof(*c));
+	c->fd = outputs[fid];
+	c->pipefd = pipefds[0];
+	c->sync = sync;
+	c->base = lseek(c->fd, 0, SEEK_END);
+
+	/* Appending starts a new gzip member, readers handle that */
+	c->gz = gzdopen(c->fd, "ab1");
+	if (!c->gz)
+		goto err;
+
+	if (pthread_create(&c->thread, NULL, output_compressor_thread, c)) {
+		/* gzclose() closes the file too, don't let the caller */
+		gzclose(c->gz);
+		c->fd = -1;
+		outputs[fid] = -1;
+		goto err;
+	}
+
+	c->running = true;
+	outputs[fid] = pipefds[1];
+	return true;
+
+err:
+	close(pipefds[0]);
+	close(pipefds[1]);
+	return false;
+}
+
+static void finish_compressors(int *outputs)
+{
+	for (int i = 0; i < _F_LAST; i++) {
+		struct output_compressor *c = &compressors[i];
+
+		if (!c->running)
+			continue;
+
+		/* The thread finishes on EOF */
+		close(outputs[i]);
+		outputs[i] = -1;
+		pthread_join(c->thread, NULL);
+		close(c->pipefd);
+
+		gzflush(c->gz, Z_FINISH);
+		if (c->sync)
+			fsync(c->fd);
+		gzclose(c->gz);
+		c->running = false;
+	}
+}
+
+/*
+ * The disk usage of the compressed outputs, estimated from the
+ * compression ratio achieved so far. @disk_usage is the uncompressed
+ * amount.
+ */
+static size_t compressed_disk_usage(size_t disk_usage)
+{
+	size_t in = 0, out = 0;
+
+	for (int i = 0; i < _F_LAST; i++) {
+		if (!compressors[i].running)
+			continue;
+
+		in += __atomic_load_n(&compressors[i].in, __ATOMIC_RELAXED);
+		out += __atomic_load_n(&compressors[i].out, __ATOMIC_RELAXED);
+	}
+
+	if (!in)
+		return disk_usage;
+
+	return disk_usage * ((double)out / in);
+}
+
+static bool open_compressed_output_files(int dirfd, int *fds,
+					 struct settings *settings)
+{
+	char gzname[32];
+	int i;
+
+	for (i = 0; i < _F_LAST; i++) {
+		if (!is_compressible(i)) {
+			fds[i] = open_at_end(dirfd, filenames[i]);
+		} else {
+			snprintf(gzname, sizeof(gzname), "%s.gz", filenames[i]);
+			fds[i] = openat(dirfd, gzname,
+					O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0666);
+			if (fds[i] >= 0 && !start_compressor(fds, i, settings->sync)) {
+				if (fds[i] >= 0)
+					close(fds[i]);
+				fds[i] = -1;
+			}
+		}
+
+		if (fds[i] < 0) {
+			fds[i] = -1;
+			finish_compressors(fds);
+			while (--i >= 0)
+				close(fds[i]);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Background syncing for --durability=journal. Each request holds a
+ * dup of the fd, so the caller is free to close its own right away,
+ * and the executor never waits for the disk at a subtest boundary.
+ */
+struct async_sync_request {
+	int fd;
+	bool directory;
+};
+
+static struct {
+	pid_t pid;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct igt_vec requests;
+	bool busy;
+} async_sync;
+
+static void *async_sync_thread(void *data)
+{
+	pthread_mutex_lock(&async_sync.lock);
+	for (;;) {
+		struct async_sync_request req;
+		int last;
+
+		while (!(last = igt_vec_length(&async_sync.requests)))
+			pthread_cond_wait(&async_sync.cond, &async_sync.lock);
+
+		req = *(struct async_sync_request *)igt_vec_elem(&async_sync.requests, last - 1);
+		igt_vec_remove(&async_sync.requests, last - 1);
+		async_sync.busy = true;
+		pthread_mutex_unlock(&async_sync.lock);
+
+		if (req.directory)
+			fsync(req.fd);
+		else
+			fdatasync(req.fd);
+		close(req.fd);
+
+		pthread_mutex_lock(&async_sync.lock);
+		async_sync.busy = false;
+		pthread_cond_broadcast(&async_sync.cond);
+	}
+
+	return NULL;
+}
+
+static bool start_async_sync(void)
+{
+	pthread_t thread;
+
+	/* Threads don't survive fork(), parallel workers start their own */
+	if (async_sync.pid == getpid())
+		return true;
+
+	pthread_mutex_init(&async_sync.lock, NULL);
+	pthread_cond_init(&async_sync.cond, NULL);
+	igt_vec_init(&async_sync.requests, sizeof(struct async_sync_request));
+	async_sync.busy = false;
+
+	if (pthread_create(&thread, NULL, async_sync_thread, NULL)) {
+		errf("Warning: Cannot start the sync thread, syncing synchronously\n");
+		return false;
+	}
+	pthread_detach(thread);
+	async_sync.pid = getpid();
+
+	return true;
+}
+
+static void queue_sync(int fd, bool directory)
+{
+	struct async_sync_request req = { .directory = directory };
+
+	if (fd < 0)
+		return;
+
+	/* Tests are forked while requests are queued, don't leak into them */
+	if (!start_async_sync() ||
+	    (req.fd = fcntl(fd, F_DUPFD_CLOEXEC, 0)) < 0) {
+		if (directory)
+			fsync(fd);
+		else
+			fdatasync(fd);
+		return;
+	}
+
+	pthread_mutex_lock(&async_sync.lock);
+	igt_vec_push(&async_sync.requests, &req);
+	pthread_cond_signal(&async_sync.cond);
+	pthread_mutex_unlock(&async_sync.lock);
+}
+
+/*
+ * With --durability=journal, make what the journal or comms file says
+ * about subtest starts and results durable without stalling. --sync
+ * already syncs these synchronously.
+ */
+static void sync_boundary(struct settings *settings, int fd)
+{
+	if (settings->sync_journal && !settings->sync)
+		queue_sync(fd, false);
+}
+
+static void wait_async_syncs(void)
+{
+	if (async_sync.pid != getpid())
+		return;
+
+	pthread_mutex_lock(&async_sync.lock);
+	while (igt_vec_length(&async_sync.requests) || async_sync.busy)
+		pthread_cond_wait(&async_sync.cond, &async_sync.lock);
+	pthread_mutex_unlock(&async_sync.lock);
+}
+
 const char *get_out_filename(int fid)
 {
 	if (fid >= 0 && fid < _F_LAST)
@@ -637,8 +1033,24 @@ const char *get_out_filename(int fid)
 	return "output-filename-index-error";
 }
 
-/* Returns the number of bytes written to disk, or a negative number on error */
-static long dump_dmesg(int kmsgfd, int outfd, ssize_t size)
+#define KMSG_RECORD_SIZE 2048
+#define KMSG_BATCH_SIZE (32 * KMSG_RECORD_SIZE)
+
+static long flush_dmesg(int outfd, const char *buf, size_t len)
+{
+	if (len)
+		write(outfd, buf, len);
+
+	return len;
+}
+
+/*
+ * Returns the number of bytes written to disk, or a negative number on
+ * error. Records at @warn_level or more serious are counted in
+ * @warnings, if not NULL.
+ */
+static long dump_dmesg(int kmsgfd, int outfd, ssize_t size,
+		       int warn_level, long *warnings)
 {
 	/*
 	 * Write kernel messages to the log file until we reach
@@ -646,6 +1058,10 @@ static long dump_dmesg(int kmsgfd, int outfd, ssize_t size)
 	 * /dev/kmsg doesn't support seeking to -1 from SEEK_END
 	 * so we need to use a second fd to read a message to
 	 *  match against, or stop when we reach EAGAIN.
+	 *
+	 * Every read() of /dev/kmsg returns a single record, but
+	 * the records are collected and written out in batches to
+	 * keep the syscall count down when the kernel is chatty.
 	 */
 
 	int comparefd;
@@ -653,7 +1069,9 @@ static long dump_dmesg(int kmsgfd, int outfd, ssize_t size)
 	unsigned long long seq, cmpseq, usec;
 	bool underflow_once = false;
 	char cont;
-	char buf[2048];
+	char cmpbuf[KMSG_RECORD_SIZE];
+	char buf[KMSG_BATCH_SIZE];
+	size_t used = 0;
 	ssize_t r;
 	long written = 0;
 
@@ -671,17 +1089,19 @@ static long dump_dmesg(int kmsgfd, int outfd, ssize_t size)
 	lseek(comparefd, 0, SEEK_END);
 
 	while (1) {
+		char *record;
+
 		if (comparefd >= 0) {
-			r = read(comparefd, buf, sizeof(buf) - 1);
+			r = read(comparefd, cmpbuf, sizeof(cmpbuf) - 1);
 			if (r < 0) {
 				if (errno != EAGAIN && errno != EPIPE) {
 					errf("Warning: Error reading kmsg comparison record: %m\n");
 					close(comparefd);
-					return 0;
+					return written + flush_dmesg(outfd, buf, used);
 				}
 			} else {
-				buf[r] = '\0';
-				if (sscanf(buf, "%u,%llu,%llu,%c;",
+				cmpbuf[r] = '\0';
+				if (sscanf(cmpbuf, "%u,%llu,%llu,%c;",
 					   &flags, &cmpseq, &usec, &cont) == 4) {
 					/* Reading comparison record done. */
 					close(comparefd);
@@ -690,7 +1110,13 @@ static long dump_dmesg(int kmsgfd, int outfd, ssize_t size)
 			}
 		}
 
-		r = read(kmsgfd, buf, sizeof(buf));
+		if (sizeof(buf) - used < KMSG_RECORD_SIZE) {
+			written += flush_dmesg(outfd, buf, used);
+			used = 0;
+		}
+
+		record = buf + used;
+		r = read(kmsgfd, record, KMSG_RECORD_SIZE);
 		if (r < 0) {
 			if (errno == EPIPE) {
 				if (!underflow_once) {
@@ -702,19 +1128,26 @@ static long dump_dmesg(int kmsgfd, int outfd, ssize_t size)
 				errf("Warning: Buffer too small for kernel log record, record lost.\n");
 				continue;
 			} else if (errno != EAGAIN) {
+				int err = errno;
+
 				errf("Error reading from kmsg: %m\n");
-				return -errno;
+				flush_dmesg(outfd, buf, used);
+				close(comparefd);
+				return -err;
 			}
 
 			/* EAGAIN, so we're done dumping */
 			close(comparefd);
-			return written;
+			return written + flush_dmesg(outfd, buf, used);
 		}
 
-		write(outfd, buf, r);
-		written += r;
+		used += r;
 
-		if (comparefd < 0 && sscanf(buf, "%u,%llu,%llu,%c;",
+		/* Records start with the syslog priority, the level in the low bits */
+		if (warnings && (strtoul(record, NULL, 10) & 7) <= warn_level)
+			(*warnings)++;
+
+		if (comparefd < 0 && sscanf(record, "%u,%llu,%llu,%c;",
 					    &flags, &seq, &usec, &cont) == 4) {
 			/*
 			 * Comparison record has been read, compare
@@ -722,14 +1155,13 @@ static long dump_dmesg(int kmsgfd, int outfd, ssize_t size)
 			 * enough.
 			 */
 			if (seq >= cmpseq)
-				return written;
+				return written + flush_dmesg(outfd, buf, used);
 		}
 
-		if (size && written >= size) {
+		if (size && written + used >= size) {
 			if (comparefd >= 0)
 				close(comparefd);
-
-			return written;
+			return written + flush_dmesg(outfd, buf, used);
 		}
 	}
 }
@@ -823,11 +1255,15 @@ static const char *show_kernel_task_state(const char *msg)
 static bool disk_usage_limit_exceeded(struct settings *settings,
 				      size_t disk_usage)
 {
+	if (settings->compress_output)
+		disk_usage = compressed_disk_usage(disk_usage);
+
 	return settings->disk_usage_limit != 0 &&
 		disk_usage > settings->disk_usage_limit;
 }
 
 static const char *need_to_timeout(struct settings *settings,
+				   int per_test_timeout,
 				   int killed,
 				   unsigned long taints,
 				   double time_since_activity,
@@ -871,7 +1307,7 @@ static const char *need_to_timeout(struct settings *settings,
 	if (settings->abort_mask & ABORT_TAINT &&
 	    is_tainted(taints)) {
 		/* list of timeouts that may postpone immediate kill on taint */
-		if (settings->per_test_timeout || settings->inactivity_timeout) {
+		if (per_test_timeout || settings->inactivity_timeout) {
 			if (is_tainted(taints) == (1 << TAINT_WARN) &&
 			    taints & (1 << TAINT_SOFT_LOCKUP))
 				decrease = 2;
@@ -882,8 +1318,8 @@ static const char *need_to_timeout(struct settings *settings,
 		}
 	}
 
-	if (settings->per_test_timeout != 0 &&
-	    time_since_subtest > settings->per_test_timeout / decrease) {
+	if (per_test_timeout != 0 &&
+	    time_since_subtest > per_test_timeout / decrease) {
 		if (decrease > 1)
 			return "Killing the test because the kernel is tainted.\n";
 		return show_kernel_task_state("Per-test timeout exceeded. Killing the current test with SIGQUIT.\n");
@@ -926,6 +1362,24 @@ static void write_packet_with_canary(int fd, struct runnerpacket *packet, bool s
 		fdatasync(fd);
 }
 
+/*
+ * Note a communication breakdown in the comms file, and make sure it
+ * doesn't go unnoticed in the results.
+ */
+static void write_comms_error(int *outputs, struct settings *settings,
+			      const char *text)
+{
+	struct runnerpacket *message, *override;
+
+	message = runnerpacket_log(STDOUT_FILENO, text);
+	write_packet_with_canary(outputs[_F_SOCKET], message, false);
+	free(message);
+
+	override = runnerpacket_resultoverride("warn");
+	write_packet_with_canary(outputs[_F_SOCKET], override, settings->sync);
+	free(override);
+}
+
 /* TODO: Refactor this macro from here and from various tests to lib */
 #define KB(x) ((x) * 1024)
 
@@ -948,31 +1402,203 @@ static size_t calc_last_dmesg_chunk(size_t limit, size_t disk_usage)
 	return dt != 0 ? dt : -1;
 }
 
+/* Size of the shared memory ring for --comms-ring */
+#define COMMS_RING_SIZE (1 << 20)
+
+/* How many reads to do from one fd before checking on the others */
+#define MONITOR_DRAIN_LIMIT 16
+
+static void monitor_add(int epfd, int fd, uint32_t events)
+{
+	struct epoll_event ev = { .events = events, .data.fd = fd };
+
+	if (fd < 0)
+		return;
+
+	if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev))
+		errf("Warning: Cannot monitor fd %d: %m\n", fd);
+}
+
+static void set_nonblocking(int fd)
+{
+	int flags;
+
+	if (fd >= 0 && (flags = fcntl(fd, F_GETFL)) >= 0)
+		fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+/*
+ * Moves data from the pipe @infd to @outfd without a detour through
+ * userspace, as long as splice() is supported for @outfd. Otherwise
+ * copies through @buf.
+ *
+ * Returns: the number of bytes moved, 0 on EOF, or -1 with errno set.
+ */
+static ssize_t copy_from_pipe(int infd, int outfd, char *buf, size_t bufsize,
+			      bool *use_splice)
+{
+	ssize_t s;
+
+	if (*use_splice) {
+		s = splice(infd, NULL, outfd, NULL, bufsize,
+			   SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+		if (s >= 0 || (errno != EINVAL && errno != ENOSYS))
+			return s;
+
+		*use_splice = false;
+	}
+
+	s = read(infd, buf, bufsize);
+	if (s > 0)
+		write(outfd, buf, s);
+
+	return s;
+}
+
 /*
  * Returns:
  *  =0 - Success
  *  <0 - Failure executing
  *  >0 - Timeout happened, need to recreate from journal
  */
+/* What the live results need to know about the running test */
+struct live_execution {
+	const char *binary;
+	char subtest[256];
+	char dynamic_subtest[256];
+	long dmesg_warnings;
+	/* dmesg_warnings when the subtest and dynamic subtest started */
+	long subtest_warnings;
+	long dynamic_warnings;
+	int results;
+};
+
+static void live_handle_packet(struct live_execution *live,
+			       const struct runnerpacket *packet,
+			       const struct resource_tracker *resources)
+{
+	struct live_result result = { .binary = live->binary, .time = -1.0 };
+	runnerpacket_read_helper helper;
+
+	if (packet->type != PACKETTYPE_SUBTEST_START &&
+	    packet->type != PACKETTYPE_SUBTEST_RESULT &&
+	    packet->type != PACKETTYPE_DYNAMIC_SUBTEST_START &&
+	    packet->type != PACKETTYPE_DYNAMIC_SUBTEST_RESULT)
+		return;
+
+	helper = read_runnerpacket(packet);
+	switch (helper.type) {
+	case PACKETTYPE_SUBTEST_START:
+		if (!helper.subteststart.name)
+			break;
+		snprintf(live->subtest, sizeof(live->subtest), "%s",
+			 helper.subteststart.name);
+		live->dynamic_subtest[0] = '\0';
+		live->subtest_warnings = live->dmesg_warnings;
+		break;
+	case PACKETTYPE_DYNAMIC_SUBTEST_START:
+		if (!helper.dynamicsubteststart.name)
+			break;
+		snprintf(live->dynamic_subtest, sizeof(live->dynamic_subtest), "%s",
+			 helper.dynamicsubteststart.name);
+		live->dynamic_warnings = live->dmesg_warnings;
+		break;
+	case PACKETTYPE_SUBTEST_RESULT:
+		if (!helper.subtestresult.name || !helper.subtestresult.result)
+			break;
+		result.subtest = helper.subtestresult.name;
+		result.result = result_from_output_string(helper.subtestresult.result);
+		if (helper.subtestresult.timeused)
+			result.time = strtod(helper.subtestresult.timeused, NULL);
+		/* Subtests skipped without starting have no dmesg or usage */
+		if (!strcmp(live->subtest, result.subtest)) {
+			result.dmesg_warnings = live->dmesg_warnings - live->subtest_warnings;
+			if (resources)
+				result.resources = &resources->subtest_usage;
+		} else {
+			result.dmesg_warnings = -1;
+		}
+		live_results_write(&result);
+		live->subtest[0] = '\0';
+		live->results++;
+		break;
+	case PACKETTYPE_DYNAMIC_SUBTEST_RESULT:
+		if (!helper.dynamicsubtestresult.name ||
+		    !helper.dynamicsubtestresult.result || !live->subtest[0])
+			break;
+		result.subtest = live->subtest;
+		result.dynamic_subtest = helper.dynamicsubtestresult.name;
+		result.result = result_from_output_string(helper.dynamicsubtestresult.result);
+		if (helper.dynamicsubtestresult.timeused)
+			result.time = strtod(helper.dynamicsubtestresult.timeused, NULL);
+		result.dmesg_warnings = live->dmesg_warnings - live->dynamic_warnings;
+		live_results_write(&result);
+		live->dynamic_subtest[0] = '\0';
+		live->results++;
+		break;
+	default:
+		break;
+	}
+}
+
+/*
+ * Records what's left open when the test exits. The final results can
+ * still differ, resultgen also looks at the logs.
+ */
+static void live_handle_exit(struct live_execution *live, int status,
+			     bool timeout, double time)
+{
+	struct live_result result = {
+		.binary = live->binary,
+		.result = timeout ? "timeout" : "incomplete",
+		.time = -1.0,
+		.dmesg_warnings = -1,
+	};
+
+	if (live->subtest[0] && live->dynamic_subtest[0]) {
+		result.subtest = live->subtest;
+		result.dynamic_subtest = live->dynamic_subtest;
+		live_results_write(&result);
+		result.dynamic_subtest = NULL;
+	}
+
+	if (live->subtest[0]) {
+		result.subtest = live->subtest;
+		live_results_write(&result);
+	} else if (!live->results) {
+		/* A test without subtests */
+		if (!timeout)
+			result.result = result_from_exitcode(status);
+		result.time = time;
+		result.dmesg_warnings = live->dmesg_warnings;
+		live_results_write(&result);
+	}
+}
+
 static int monitor_output(pid_t child,
 			  int outfd, int errfd, int socketfd,
+			  struct runnerring *ring, int ringeventfd,
 			  int kmsgfd, int sigfd,
 			  int *outputs,
+			  struct resource_tracker *resources,
+			  const char *binary,
 			  double *time_spent,
+			  int per_test_timeout,
 			  struct settings *settings,
 			  char **abortreason,
 			  bool *abort_already_written)
 {
-	fd_set set;
+	struct live_execution live = { .binary = binary };
+	struct epoll_event events[6];
 	char *buf;
 	size_t bufsize;
 	char *outbuf = NULL;
 	size_t outbufsize = 0;
 	char current_subtest[256] = {};
 	struct signalfd_siginfo siginfo;
+	struct rusage rusage;
 	ssize_t s;
-	int n, status;
-	int nfds = outfd;
+	int n, status, epfd, drained;
 	const int interval_length = 1;
 	int wd_timeout;
 	int killed = 0; /* 0 if not killed, signal number otherwise */
@@ -982,21 +1608,41 @@ static int monitor_output(pid_t child,
 	size_t disk_usage = 0;
 	size_t dmsg_chunk_size = 4096 * max_t(size_t, sysconf(_SC_NPROCESSORS_ONLN), 16);
 	long dmesgwritten;
+	bool out_pending = false, err_pending = false, kmsg_pending = false;
+	/*
+	 * Compressed outputs are pipes, where a non-blocking splice
+	 * could fail for the output side being full and lose the
+	 * edge-triggered wakeup.
+	 */
+	bool use_splice = !settings->compress_output;
 	bool socket_comms_used = false; /* whether the test actually uses comms */
 	bool results_received = false; /* whether we already have test results that might need overriding if we detect an abort condition */
 
 	runner_gettime(&time_beg);
 	time_last_activity = time_last_subtest = time_killed = time_beg;
 
-	if (errfd > nfds)
-		nfds = errfd;
-	if (socketfd > nfds)
-		nfds = socketfd;
-	if (kmsgfd > nfds)
-		nfds = kmsgfd;
-	if (sigfd > nfds)
-		nfds = sigfd;
-	nfds++;
+	/*
+	 * The output fds are edge-triggered and drained on every
+	 * wakeup, up to MONITOR_DRAIN_LIMIT reads so that a test
+	 * flooding one of them can't keep us from checking timeouts.
+	 * The rest is picked up on the next round without
+	 * waiting. The signalfd is level-triggered, it's read one
+	 * signal at a time.
+	 */
+	epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (epfd < 0) {
+		errf("Error creating epoll instance: %m\n");
+		return -1;
+	}
+
+	set_nonblocking(outfd);
+	set_nonblocking(errfd);
+	monitor_add(epfd, outfd, EPOLLIN | EPOLLET);
+	monitor_add(epfd, errfd, EPOLLIN | EPOLLET);
+	monitor_add(epfd, socketfd, EPOLLIN | EPOLLET);
+	monitor_add(epfd, ringeventfd, EPOLLIN | EPOLLET);
+	monitor_add(epfd, kmsgfd, EPOLLIN | EPOLLET);
+	monitor_add(epfd, sigfd, EPOLLIN);
 
 	/*
 	 * If we're still alive, we want to kill the test process
@@ -1012,7 +1658,7 @@ static int monitor_output(pid_t child,
 	if (wd_timeout < 120) {
 		/*
 		 * Watchdog timeout smaller, warn the user. With the
-		 * short select() timeout we're using we're able to
+		 * short epoll_wait() timeout we're using we're able to
 		 * ping the watchdog regardless.
 		 */
 		if (settings->log_level >= LOG_LEVEL_VERBOSE) {
@@ -1026,155 +1672,254 @@ static int monitor_output(pid_t child,
 
 	while (outfd >= 0 || errfd >= 0 || sigfd >= 0) {
 		const char *timeout_reason;
-		struct timeval tv = { .tv_sec = interval_length };
-
-		FD_ZERO(&set);
-		if (outfd >= 0)
-			FD_SET(outfd, &set);
-		if (errfd >= 0)
-			FD_SET(errfd, &set);
-		if (socketfd >= 0)
-			FD_SET(socketfd, &set);
-		if (kmsgfd >= 0)
-			FD_SET(kmsgfd, &set);
-		if (sigfd >= 0)
-			FD_SET(sigfd, &set);
-
-		n = select(nfds, &set, NULL, NULL, &tv);
+		bool outready = out_pending, errready = err_pending;
+		bool socketready = false, kmsgready = kmsg_pending, sigready = false;
+		bool ringready = false;
+		bool pending = out_pending || err_pending || kmsg_pending;
+
+		n = epoll_wait(epfd, events, sizeof(events) / sizeof(events[0]),
+			       pending ? 0 : interval_length * 1000);
 		ping_watchdogs();
 
 		if (n < 0) {
 			/* TODO */
+			close(epfd);
 			return -1;
 		}
 
+		for (int i = 0; i < n; i++) {
+			int fd = events[i].data.fd;
+
+			if (fd == outfd)
+				outready = true;
+			else if (fd == errfd)
+				errready = true;
+			else if (fd == socketfd)
+				socketready = true;
+			else if (fd == ringeventfd)
+				ringready = true;
+			else if (fd == kmsgfd)
+				kmsgready = true;
+			else if (fd == sigfd)
+				sigready = true;
+		}
+
 		runner_gettime(&time_now);
 
 		/* TODO: Refactor these handlers to their own functions */
-		if (outfd >= 0 && FD_ISSET(outfd, &set)) {
+		if (outfd >= 0 && outready) {
 			char *newline;
 
 			time_last_activity = time_now;
+			out_pending = false;
 
-			s = read(outfd, buf, bufsize);
-			if (s <= 0) {
-				if (s < 0) {
-					errf("Error reading test's stdout: %m\n");
+			for (drained = 0; outfd >= 0; drained++) {
+				if (drained == MONITOR_DRAIN_LIMIT) {
+					out_pending = true;
+					break;
 				}
 
-				close(outfd);
-				outfd = -1;
-				goto out_end;
-			}
+				s = read(outfd, buf, bufsize);
+				if (s < 0 && errno == EAGAIN)
+					break;
 
-			write(outputs[_F_OUT], buf, s);
-			disk_usage += s;
-			if (settings->sync) {
-				fdatasync(outputs[_F_OUT]);
-			}
+				if (s <= 0) {
+					if (s < 0) {
+						errf("Error reading test's stdout: %m\n");
+					}
 
-			outbuf = realloc(outbuf, outbufsize + s);
-			memcpy(outbuf + outbufsize, buf, s);
-			outbufsize += s;
+					close(outfd);
+					outfd = -1;
+					break;
+				}
 
-			while ((newline = memchr(outbuf, '\n', outbufsize)) != NULL) {
-				size_t linelen = newline - outbuf + 1;
+				write(outputs[_F_OUT], buf, s);
+				disk_usage += s;
+				if (settings->sync) {
+					fdatasync(outputs[_F_OUT]);
+				}
 
-				if (linelen > strlen(STARTING_SUBTEST) &&
-				    !memcmp(outbuf, STARTING_SUBTEST, strlen(STARTING_SUBTEST))) {
-					write(outputs[_F_JOURNAL], outbuf + strlen(STARTING_SUBTEST),
-					      linelen - strlen(STARTING_SUBTEST));
-					if (settings->sync) {
-						fdatasync(outputs[_F_JOURNAL]);
-					}
-					memcpy(current_subtest, outbuf + strlen(STARTING_SUBTEST),
-					       linelen - strlen(STARTING_SUBTEST));
-					current_subtest[linelen - strlen(STARTING_SUBTEST)] = '\0';
+				outbuf = realloc(outbuf, outbufsize + s);
+				memcpy(outbuf + outbufsize, buf, s);
+				outbufsize += s;
 
-					time_last_subtest = time_now;
-					disk_usage = s;
+				while ((newline = memchr(outbuf, '\n', outbufsize)) != NULL) {
+					size_t linelen = newline - outbuf + 1;
 
-					if (settings->log_level >= LOG_LEVEL_VERBOSE) {
-						fwrite(outbuf, 1, linelen, stdout);
-					}
-				}
-				if (linelen > strlen(SUBTEST_RESULT) &&
-				    !memcmp(outbuf, SUBTEST_RESULT, strlen(SUBTEST_RESULT))) {
-					char *delim = memchr(outbuf, ':', linelen);
-
-					if (delim != NULL) {
-						size_t subtestlen = delim - outbuf - strlen(SUBTEST_RESULT);
-						if (memcmp(current_subtest, outbuf + strlen(SUBTEST_RESULT),
-							   subtestlen)) {
-							/* Result for a test that didn't ever start */
-							write(outputs[_F_JOURNAL],
-							      outbuf + strlen(SUBTEST_RESULT),
-							      subtestlen);
-							write(outputs[_F_JOURNAL], "\n", 1);
-							if (settings->sync) {
-								fdatasync(outputs[_F_JOURNAL]);
-							}
-							current_subtest[0] = '\0';
+					if (linelen > strlen(STARTING_SUBTEST) &&
+					    !memcmp(outbuf, STARTING_SUBTEST, strlen(STARTING_SUBTEST))) {
+						write(outputs[_F_JOURNAL], outbuf + strlen(STARTING_SUBTEST),
+						      linelen - strlen(STARTING_SUBTEST));
+						if (settings->sync) {
+							fdatasync(outputs[_F_JOURNAL]);
 						}
+						sync_boundary(settings, outputs[_F_JOURNAL]);
+						memcpy(current_subtest, outbuf + strlen(STARTING_SUBTEST),
+						       linelen - strlen(STARTING_SUBTEST));
+						current_subtest[linelen - strlen(STARTING_SUBTEST)] = '\0';
+
+						if (resources && !socket_comms_used)
+							resources_subtest_start(resources, current_subtest);
+
+						time_last_subtest = time_now;
+						disk_usage = s;
 
 						if (settings->log_level >= LOG_LEVEL_VERBOSE) {
 							fwrite(outbuf, 1, linelen, stdout);
 						}
 					}
-				}
-				if (linelen > strlen(STARTING_DYNAMIC_SUBTEST) &&
-				    !memcmp(outbuf, STARTING_DYNAMIC_SUBTEST, strlen(STARTING_DYNAMIC_SUBTEST))) {
-					time_last_subtest = time_now;
-					disk_usage = s;
+					if (linelen > strlen(SUBTEST_RESULT) &&
+					    !memcmp(outbuf, SUBTEST_RESULT, strlen(SUBTEST_RESULT))) {
+						char *delim = memchr(outbuf, ':', linelen);
+
+						if (delim != NULL) {
+							size_t subtestlen = delim - outbuf - strlen(SUBTEST_RESULT);
+							if (memcmp(current_subtest, outbuf + strlen(SUBTEST_RESULT),
+								   subtestlen)) {
+								/* Result for a test that didn't ever start */
+								write(outputs[_F_JOURNAL],
+								      outbuf + strlen(SUBTEST_RESULT),
+								      subtestlen);
+								write(outputs[_F_JOURNAL], "\n", 1);
+								if (settings->sync) {
+									fdatasync(outputs[_F_JOURNAL]);
+								}
+								sync_boundary(settings, outputs[_F_JOURNAL]);
+								current_subtest[0] = '\0';
+							}
+
+							if (resources && !socket_comms_used)
+								resources_subtest_end(resources);
 
-					if (settings->log_level >= LOG_LEVEL_VERBOSE) {
-						fwrite(outbuf, 1, linelen, stdout);
+							if (settings->log_level >= LOG_LEVEL_VERBOSE) {
+								fwrite(outbuf, 1, linelen, stdout);
+							}
+						}
 					}
-				}
-				if (linelen > strlen(DYNAMIC_SUBTEST_RESULT) &&
-				    !memcmp(outbuf, DYNAMIC_SUBTEST_RESULT, strlen(DYNAMIC_SUBTEST_RESULT))) {
-					char *delim = memchr(outbuf, ':', linelen);
+					if (linelen > strlen(STARTING_DYNAMIC_SUBTEST) &&
+					    !memcmp(outbuf, STARTING_DYNAMIC_SUBTEST, strlen(STARTING_DYNAMIC_SUBTEST))) {
+						time_last_subtest = time_now;
+						disk_usage = s;
 
-					if (delim != NULL) {
 						if (settings->log_level >= LOG_LEVEL_VERBOSE) {
 							fwrite(outbuf, 1, linelen, stdout);
 						}
 					}
-				}
+					if (linelen > strlen(DYNAMIC_SUBTEST_RESULT) &&
+					    !memcmp(outbuf, DYNAMIC_SUBTEST_RESULT, strlen(DYNAMIC_SUBTEST_RESULT))) {
+						char *delim = memchr(outbuf, ':', linelen);
 
-				memmove(outbuf, newline + 1, outbufsize - linelen);
-				outbufsize -= linelen;
+						if (delim != NULL) {
+							if (settings->log_level >= LOG_LEVEL_VERBOSE) {
+								fwrite(outbuf, 1, linelen, stdout);
+							}
+						}
+					}
+
+					memmove(outbuf, newline + 1, outbufsize - linelen);
+					outbufsize -= linelen;
+				}
 			}
 		}
-	out_end:
 
-		if (errfd >= 0 && FD_ISSET(errfd, &set)) {
+		if (errfd >= 0 && errready) {
+			bool written = false;
+
 			time_last_activity = time_now;
+			err_pending = false;
 
-			s = read(errfd, buf, bufsize);
-			if (s <= 0) {
-				if (s < 0) {
-					errf("Error reading test's stderr: %m\n");
+			/* stderr isn't parsed, splice it straight to err.txt */
+			for (drained = 0; errfd >= 0; drained++) {
+				if (drained == MONITOR_DRAIN_LIMIT) {
+					err_pending = true;
+					break;
 				}
-				close(errfd);
-				errfd = -1;
-			} else {
-				write(outputs[_F_ERR], buf, s);
-				disk_usage += s;
-				if (settings->sync) {
-					fdatasync(outputs[_F_ERR]);
+
+				s = copy_from_pipe(errfd, outputs[_F_ERR], buf, bufsize,
+						   &use_splice);
+				if (s < 0 && errno == EAGAIN)
+					break;
+
+				if (s <= 0) {
+					if (s < 0) {
+						errf("Error reading test's stderr: %m\n");
+					}
+					close(errfd);
+					errfd = -1;
+					break;
 				}
+
+				disk_usage += s;
+				written = true;
+			}
+
+			if (written && settings->sync) {
+				fdatasync(outputs[_F_ERR]);
 			}
 		}
 
-		if (socketfd >= 0 && FD_ISSET(socketfd, &set)) {
+		if (ringeventfd >= 0 && ringready) {
+			uint64_t count;
+
+			/* Just rearm the notification, the ring is drained below */
+			read(ringeventfd, &count, sizeof(count));
+		}
+
+		/*
+		 * The ring is cheap to check when empty, so it's drained
+		 * on every round and not only when notified.
+		 */
+		if ((socketfd >= 0 && socketready) || ring) {
 			struct runnerpacket *packet;
+			bool ring_empty = !ring;
 
-			time_last_activity = time_now;
+			if (socketready)
+				time_last_activity = time_now;
 
-			/* Fully drain everything */
+			/*
+			 * Fully drain everything. The ring goes first,
+			 * the test only falls back to the socket once the
+			 * ring is empty.
+			 */
 			while (true) {
-				s = recv(socketfd, buf, bufsize, MSG_DONTWAIT);
+				s = 0;
+
+				if (!ring_empty) {
+					s = runnerring_read(ring, buf, bufsize);
+					if (s < 0 && errno == EPIPE) {
+						errf("Communication ring error: Packet never committed\n");
+						write_comms_error(outputs, settings,
+								  "\nrunner: Communication ring error, a packet was never completely written. "
+								  "Packet is discarded, test result and logs might be incorrect.\n");
+						/* The ones after it can be read */
+						continue;
+					} else if (s < 0) {
+						errf("Communication ring error: Invalid packet size\n");
+						write_comms_error(outputs, settings,
+								  "\nrunner: Communication ring error, invalid packet size. "
+								  "Ring contents are discarded, test result and logs might be incorrect.\n");
+						s = 0;
+					}
+
+					if (s == 0)
+						ring_empty = true;
+					else
+						time_last_activity = time_now;
+				}
+
+				if (s == 0) {
+					if (socketfd < 0 || !socketready)
+						break;
+
+					s = recv(socketfd, buf, bufsize, MSG_DONTWAIT);
+
+					/*
+					 * Packets committed to the ring before
+					 * the test fell back to the socket go
+					 * first.
+					 */
+					ring_empty = !ring;
+				}
 
 				if (s < 0) {
 					if (errno == EAGAIN)
@@ -1189,22 +1934,20 @@ static int monitor_output(pid_t child,
 
 				packet = (struct runnerpacket *)buf;
 				if (s < sizeof(*packet) || s != packet->size) {
-					struct runnerpacket *message, *override;
-
 					errf("Socket communication error: Received %zd bytes, expected %zd\n",
 					     s, s >= sizeof(packet->size) ? packet->size : sizeof(*packet));
-					message = runnerpacket_log(STDOUT_FILENO,
-								   "\nrunner: Socket communication error, invalid packet size. "
-								   "Packet is discarded, test result and logs might be incorrect.\n");
-					write_packet_with_canary(outputs[_F_SOCKET], message, false);
-					free(message);
+					write_comms_error(outputs, settings,
+							  "\nrunner: Socket communication error, invalid packet size. "
+							  "Packet is discarded, test result and logs might be incorrect.\n");
 
-					override = runnerpacket_resultoverride("warn");
-					write_packet_with_canary(outputs[_F_SOCKET], override, settings->sync);
-					free(override);
-
-					/* Continue using socket comms, hope for the best. */
-					goto socket_end;
+					/*
+					 * Continue using socket comms, hope for
+					 * the best. Only this datagram is
+					 * dropped, the socket is edge-triggered
+					 * so the ones queued behind it must
+					 * still be read now.
+					 */
+					continue;
 				}
 
 				/*
@@ -1253,10 +1996,29 @@ static int monitor_output(pid_t child,
 				write_packet_with_canary(outputs[_F_SOCKET], packet, settings->sync);
 				disk_usage += packet->size;
 
+				if (packet->type == PACKETTYPE_SUBTEST_START ||
+				    packet->type == PACKETTYPE_SUBTEST_RESULT ||
+				    packet->type == PACKETTYPE_DYNAMIC_SUBTEST_START ||
+				    packet->type == PACKETTYPE_DYNAMIC_SUBTEST_RESULT)
+					sync_boundary(settings, outputs[_F_SOCKET]);
+
 				if (packet->type == PACKETTYPE_SUBTEST_RESULT ||
 				    packet->type == PACKETTYPE_DYNAMIC_SUBTEST_RESULT)
 					results_received = true;
 
+				if (resources && packet->type == PACKETTYPE_SUBTEST_START) {
+					runnerpacket_read_helper helper = read_runnerpacket(packet);
+
+					if (helper.type == PACKETTYPE_SUBTEST_START &&
+					    helper.subteststart.name)
+						resources_subtest_start(resources, helper.subteststart.name);
+				} else if (resources && packet->type == PACKETTYPE_SUBTEST_RESULT) {
+					resources_subtest_end(resources);
+				}
+
+				if (live_results_enabled())
+					live_handle_packet(&live, packet, resources);
+
 				if (settings->log_level >= LOG_LEVEL_VERBOSE) {
 					runnerpacket_read_helper helper = {};
 					const char *time;
@@ -1306,22 +2068,29 @@ static int monitor_output(pid_t child,
 		}
 	socket_end:
 
-		if (kmsgfd >= 0 && FD_ISSET(kmsgfd, &set)) {
+		if (kmsgfd >= 0 && kmsgready) {
 			time_last_activity = time_now;
 
-			dmesgwritten = dump_dmesg(kmsgfd, outputs[_F_DMESG], dmsg_chunk_size);
+			dmesgwritten = dump_dmesg(kmsgfd, outputs[_F_DMESG], dmsg_chunk_size,
+						  settings->dmesg_warn_level,
+						  &live.dmesg_warnings);
 			if (settings->sync)
 				fdatasync(outputs[_F_DMESG]);
 
 			if (dmesgwritten < 0) {
 				close(kmsgfd);
 				kmsgfd = -1;
+				kmsg_pending = false;
 			} else {
 				disk_usage += dmesgwritten;
+				if (resources)
+					resources_add_dmesg(resources, dmesgwritten);
+				/* Stopped at the chunk size, there's more to read */
+				kmsg_pending = dmesgwritten >= dmsg_chunk_size;
 			}
 		}
 
-		if (sigfd >= 0 && FD_ISSET(sigfd, &set)) {
+		if (sigfd >= 0 && sigready) {
 			double time;
 
 			s = read(sigfd, &siginfo, sizeof(siginfo));
@@ -1329,7 +2098,12 @@ static int monitor_output(pid_t child,
 				errf("Error reading from signalfd: %m\n");
 				continue;
 			} else if (siginfo.ssi_signo == SIGCHLD) {
-				if (child != waitpid(child, &status, WNOHANG)) {
+				pid_t reaped = wait4(child, &status, WNOHANG, &rusage);
+
+				if (reaped == child && resources)
+					resources_end(resources, &rusage);
+
+				if (child != reaped) {
 					errf("Failed to reap child\n");
 					status = 9999;
 				} else if (WIFEXITED(status)) {
@@ -1383,12 +2157,14 @@ static int monitor_output(pid_t child,
 						override = runnerpacket_resultoverride("notrun");
 						write_packet_with_canary(outputs[_F_SOCKET], override, settings->sync);
 						free(override);
+						sync_boundary(settings, outputs[_F_SOCKET]);
 					} else {
 						dprintf(outputs[_F_JOURNAL], "%s%d (0.000s)\n",
 							EXECUTOR_EXIT,
 							GRACEFUL_EXITCODE);
 						if (settings->sync)
 							fdatasync(outputs[_F_JOURNAL]);
+						sync_boundary(settings, outputs[_F_JOURNAL]);
 					}
 				}
 
@@ -1398,6 +2174,7 @@ static int monitor_output(pid_t child,
 					errf("Error terminating child with %s, errno=%d\n",
 					     killed == SIGQUIT ? "SIGQUIT" : "SIGKILL", errno);
 
+					close(epfd);
 					return -1;
 				}
 				time_killed = time_now;
@@ -1505,6 +2282,11 @@ static int monitor_output(pid_t child,
 					exitpacket = runnerpacket_exit(status, timestr);
 					write_packet_with_canary(outputs[_F_SOCKET], exitpacket, settings->sync);
 					free(exitpacket);
+					sync_boundary(settings, outputs[_F_SOCKET]);
+
+					if (live_results_enabled())
+						live_handle_exit(&live, status,
+								 timeoutresult, time);
 				} else {
 					const char *exitline;
 
@@ -1515,6 +2297,7 @@ static int monitor_output(pid_t child,
 					if (settings->sync) {
 						fdatasync(outputs[_F_JOURNAL]);
 					}
+					sync_boundary(settings, outputs[_F_JOURNAL]);
 				}
 
 				if (status == IGT_EXIT_ABORT) {
@@ -1528,11 +2311,13 @@ static int monitor_output(pid_t child,
 			}
 
 			child = 0;
-			sigfd = -1; /* we are dying, no signal handling for now */
+			/* we are dying, no signal handling for now */
+			epoll_ctl(epfd, EPOLL_CTL_DEL, sigfd, NULL);
+			sigfd = -1;
 		}
 
 		igt_kernel_tainted(&taints);
-		timeout_reason = need_to_timeout(settings, killed,
+		timeout_reason = need_to_timeout(settings, per_test_timeout, killed,
 						 taints,
 						 igt_time_elapsed(&time_last_activity, &time_now),
 						 igt_time_elapsed(&time_last_subtest, &time_now),
@@ -1553,7 +2338,8 @@ static int monitor_output(pid_t child,
 				}
 
 				dmsg_chunk_size = calc_last_dmesg_chunk(settings->disk_usage_limit, disk_usage);
-				dump_dmesg(kmsgfd, outputs[_F_DMESG], dmsg_chunk_size);
+				dump_dmesg(kmsgfd, outputs[_F_DMESG], dmsg_chunk_size,
+					   settings->dmesg_warn_level, NULL);
 				if (settings->sync)
 					fdatasync(outputs[_F_DMESG]);
 
@@ -1564,6 +2350,7 @@ static int monitor_output(pid_t child,
 				close(errfd);
 				close(socketfd);
 				close(kmsgfd);
+				close(epfd);
 				return -1;
 			}
 
@@ -1584,7 +2371,8 @@ static int monitor_output(pid_t child,
 	}
 
 	dmsg_chunk_size = calc_last_dmesg_chunk(settings->disk_usage_limit, disk_usage);
-	dmesgwritten = dump_dmesg(kmsgfd, outputs[_F_DMESG], dmsg_chunk_size);
+	dmesgwritten = dump_dmesg(kmsgfd, outputs[_F_DMESG], dmsg_chunk_size,
+				  settings->dmesg_warn_level, NULL);
 	if (settings->sync)
 		fdatasync(outputs[_F_DMESG]);
 	if (dmesgwritten > 0) {
@@ -1608,6 +2396,7 @@ static int monitor_output(pid_t child,
 	close(errfd);
 	close(socketfd);
 	close(kmsgfd);
+	close(epfd);
 
 	if (aborting)
 		return -1;
@@ -1744,16 +2533,67 @@ static char *entry_display_name(struct job_list_entry *entry)
 			size += strlen(delim) + strlen(entry->subtests[i]);
 			ret = realloc(ret, size);
 
-			strcat(ret, delim);
-			strcat(ret, entry->subtests[i]);
+			strcat(ret, delim);
+			strcat(ret, entry->subtests[i]);
+
+			delim = ", ";
+		}
+		/* There's already room for this */
+		strcat(ret, ")");
+	}
+
+	return ret;
+}
+
+#define ADAPTIVE_TIMEOUT_MIN 30
+
+static int entry_per_test_timeout(struct execute_state *state,
+				  struct settings *settings,
+				  struct job_list_entry *entry)
+{
+	double p99;
+	int timeout;
+
+	if (!settings->adaptive_timeout || !state->runtimes)
+		return settings->per_test_timeout;
+
+	p99 = runtime_db_entry_p99(state->runtimes, entry);
+	if (p99 < 0.0)
+		return settings->per_test_timeout;
+
+	timeout = max_t(int, ceil(p99 * settings->adaptive_timeout),
+			ADAPTIVE_TIMEOUT_MIN);
+	if (settings->per_test_timeout)
+		timeout = min(timeout, settings->per_test_timeout);
+
+	if (settings->log_level >= LOG_LEVEL_VERBOSE)
+		outf("Adaptive per-test timeout: %ds\n", timeout);
+
+	return timeout;
+}
+
+/*
+ * Checks whether @entry is expected to finish before the overall
+ * timeout, so that we don't start tests only to kill them half way.
+ */
+static bool predict_overall_timeout(struct execute_state *state,
+				    struct settings *settings,
+				    struct job_list_entry *entry)
+{
+	double estimate;
+
+	if (!state->runtimes || state->time_left <= 0.0)
+		return false;
 
-			delim = ", ";
-		}
-		/* There's already room for this */
-		strcat(ret, ")");
-	}
+	estimate = runtime_db_entry_estimate(state->runtimes, entry);
+	if (estimate <= state->time_left)
+		return false;
 
-	return ret;
+	if (settings->log_level >= LOG_LEVEL_NORMAL)
+		outf("Next test is expected to take %.0fs, only %.0fs left. Stopping.\n",
+		     estimate, state->time_left);
+
+	return true;
 }
 
 /*
@@ -1779,6 +2619,11 @@ static int execute_next_entry(struct execute_state *state,
 	int errpipe[2] = { -1, -1 };
 	int socket[2] = { -1, -1 };
 	int outfd, errfd, socketfd;
+	struct runnerring *ring = NULL;
+	int ringfd = -1, ringeventfd = -1;
+	struct resource_tracker resources;
+	int resourcesfd = -1;
+	struct test_memcg memcg = { .dirfd = -1, .procsfd = -1 };
 	char name[32];
 	pid_t child;
 	int result;
@@ -1791,7 +2636,9 @@ static int execute_next_entry(struct execute_state *state,
 		return -1;
 	}
 
-	if (!open_output_files(dirfd, outputs, true)) {
+	if (settings->compress_output ?
+	    !open_compressed_output_files(dirfd, outputs, settings) :
+	    !open_output_files(dirfd, outputs, true)) {
 		errf("Error opening output files\n");
 		result = -1;
 		goto out_dirfd;
@@ -1800,6 +2647,10 @@ static int execute_next_entry(struct execute_state *state,
 	if (settings->sync) {
 		fsync(dirfd);
 		fsync(resdirfd);
+	} else if (settings->sync_journal) {
+		/* The journal has to be found after a crash */
+		queue_sync(dirfd, true);
+		queue_sync(resdirfd, true);
 	}
 
 	if (pipe(outpipe) || pipe(errpipe)) {
@@ -1814,6 +2665,20 @@ static int execute_next_entry(struct execute_state *state,
 		goto out_pipe;
 	}
 
+	if (settings->comms_ring) {
+		/* The socket still works without it, so not fatal */
+		ring = runnerring_create(COMMS_RING_SIZE, &ringfd);
+		if (ring)
+			ringeventfd = eventfd(0, EFD_NONBLOCK);
+		if (!ring || ringeventfd < 0) {
+			errf("Warning: Cannot create communication ring: %m\n");
+			runnerring_destroy(ring);
+			ring = NULL;
+			close(ringfd);
+			ringfd = -1;
+		}
+	}
+
 	if ((kmsgfd = open("/dev/kmsg", O_RDONLY | O_CLOEXEC | O_NONBLOCK)) < 0) {
 		errf("Warning: Cannot open /dev/kmsg\n");
 	} else {
@@ -1841,6 +2706,10 @@ static int execute_next_entry(struct execute_state *state,
 		outf("%s\n", buf);
 	}
 
+	if (settings->memory_budget &&
+	    !memcg_create(&memcg, name, settings->memory_budget))
+		errf("Warning: Cannot create memory cgroup, running without the memory budget: %m\n");
+
 	/*
 	 * Flush outputs before forking so our (buffered) output won't
 	 * end up in the test outputs.
@@ -1865,11 +2734,23 @@ static int execute_next_entry(struct execute_state *state,
 
 		sigprocmask(SIG_UNBLOCK, sigmask, NULL);
 
+		if (memcg.procsfd >= 0 && !memcg_enter(&memcg))
+			errf("Warning: Cannot enter memory cgroup: %m\n");
+
 		if (socketfd >= 0 && !getenv("IGT_RUNNER_DISABLE_SOCKET_COMMUNICATION")) {
 			snprintf(envstring, sizeof(envstring), "%d", socketfd);
 			setenv("IGT_RUNNER_SOCKET_FD", envstring, 1);
+
+			if (ring) {
+				snprintf(envstring, sizeof(envstring), "%d", ringfd);
+				setenv("IGT_RUNNER_RING_FD", envstring, 1);
+				snprintf(envstring, sizeof(envstring), "%d", ringeventfd);
+				setenv("IGT_RUNNER_RING_EVENTFD", envstring, 1);
+			}
 		}
 		setenv("IGT_SENTINEL_ON_STDERR", "1", 1);
+		if (settings->fork_subtests)
+			setenv("IGT_FORK_SUBTESTS", "1", 1);
 
 		execute_test_process(outfd, errfd, socketfd, settings, entry);
 		/* unreachable */
@@ -1882,19 +2763,49 @@ static int execute_next_entry(struct execute_state *state,
 	close(errpipe[1]);
 	close(socket[1]);
 	outpipe[1] = errpipe[1] = socket[1] = -1;
+	/* The mapping stays, the test has its own copy of the fd */
+	close(ringfd);
+	ringfd = -1;
+
+	if (settings->collect_resources) {
+		resourcesfd = openat(dirfd, RESOURCES_FILENAME,
+				     O_CREAT | O_WRONLY | O_APPEND | O_CLOEXEC, 0666);
+		if (resourcesfd < 0)
+			errf("Warning: Cannot open %s: %m\n", RESOURCES_FILENAME);
+		else
+			resources_begin(&resources, child, resourcesfd,
+					memcg.dirfd);
+	}
 
 	result = monitor_output(child, outfd, errfd, socketfd,
+				ring, ringeventfd,
 				kmsgfd, sigfd,
-				outputs, time_spent, settings,
+				outputs,
+				resourcesfd >= 0 ? &resources : NULL,
+				entry->binary,
+				time_spent,
+				entry_per_test_timeout(state, settings, entry),
+				settings,
 				abortreason, abort_already_written);
 
+	if (resourcesfd >= 0) {
+		if (settings->sync)
+			fsync(resourcesfd);
+		close(resourcesfd);
+	}
+
 out_kmsgfd:
+	memcg_destroy(&memcg);
 	close(kmsgfd);
+	runnerring_destroy(ring);
+	close(ringfd);
+	close(ringeventfd);
 out_pipe:
 	close(outpipe[0]);
 	close(outpipe[1]);
 	close(errpipe[0]);
 	close(errpipe[1]);
+	finish_compressors(outputs);
 	if (settings->sync)
 		fsync_outputs(outputs);
 	close_outputs(outputs);
@@ -1950,6 +2861,7 @@ static int remove_file(int dirfd, const char *name)
 
 static bool clear_test_result_directory(int dirfd)
 {
+	char gzname[32];
 	int i;
 
 	for (i = 0; i < _F_LAST; i++) {
@@ -1958,6 +2870,14 @@ static bool clear_test_result_directory(int dirfd)
 			     filenames[i]);
 			return false;
 		}
+
+		/* Left behind by --compress-output */
+		snprintf(gzname, sizeof(gzname), "%s.gz", filenames[i]);
+		if (remove_file(dirfd, gzname)) {
+			errf("Error deleting %s from test result directory: %m\n",
+			     gzname);
+			return false;
+		}
 	}
 
 	return true;
@@ -1984,7 +2904,8 @@ static bool clear_old_results(char *path)
 	if (remove_file(dirfd, "uname.txt") ||
 	    remove_file(dirfd, "starttime.txt") ||
 	    remove_file(dirfd, "endtime.txt") ||
-	    remove_file(dirfd, "aborted.txt")) {
+	    remove_file(dirfd, "aborted.txt") ||
+	    remove_file(dirfd, RUNTIME_DB_RECORDED_FILENAME)) {
 		close(dirfd);
 		errf("Error clearing old results: %m\n");
 		return false;
@@ -2063,7 +2984,7 @@ bool initialize_execute_state_from_resume(int dirfd,
 					  struct job_list *list)
 {
 	struct job_list_entry *entry;
-	int resdirfd, fd, i;
+	int resdirfd, i;
 
 	clear_settings(settings);
 	free_job_list(list);
@@ -2083,6 +3004,15 @@ bool initialize_execute_state_from_resume(int dirfd,
 
 	init_time_left(state, settings);
 
+	/*
+	 * Parallel execution completes tests out of order, each entry
+	 * gets checked against its results when it's scheduled.
+	 */
+	if (settings->parallel_devices) {
+		close(dirfd);
+		return true;
+	}
+
 	for (i = list->size; i >= 0; i--) {
 		char name[32];
 
@@ -2096,39 +3026,7 @@ bool initialize_execute_state_from_resume(int dirfd,
 		goto success;
 
 	entry = &list->entries[i];
-	state->next = i;
-
-	if ((fd = openat(resdirfd, filenames[_F_SOCKET], O_RDONLY)) >= 0) {
-		if (!prune_from_comms(entry, fd)) {
-			/*
-			 * No subtests, or incomplete before the first
-			 * subtest. Not suitable to re-run.
-			 */
-			state->next = i + 1;
-		} else if (entry->binary[0] == '\0') {
-			/* Full completed */
-			state->next = i + 1;
-		}
-
-		close (fd);
-	}
-
-	if ((fd = openat(resdirfd, filenames[_F_JOURNAL], O_RDONLY)) >= 0) {
-		if (!prune_from_journal(entry, fd)) {
-			/*
-			 * The test does not have subtests, or
-			 * incompleted before the first subtest
-			 * began. Either way, not suitable to
-			 * re-run.
-			 */
-			state->next = i + 1;
-		} else if (entry->binary[0] == '\0') {
-			/* This test is fully completed */
-			state->next = i + 1;
-		}
-
-		close(fd);
-	}
+	state->next = prune_entry(resdirfd, entry) ? i : i + 1;
 
  success:
 	close(resdirfd);
@@ -2414,6 +3312,471 @@ static int open_comms_if_valid(int resdirfd, size_t testidx)
 	return -1;
 }
 
+static void write_abort_for_entry(struct settings *settings,
+				  struct job_list *job_list,
+				  int resdirfd, size_t idx,
+				  const char *reason)
+{
+	char *prev = entry_display_name(&job_list->entries[idx]);
+	char *next = (idx + 1 < job_list->size ?
+		      entry_display_name(&job_list->entries[idx + 1]) :
+		      strdup("nothing"));
+	int commsfd;
+
+	commsfd = open_comms_if_valid(resdirfd, idx);
+	if (commsfd >= 0) {
+		lseek(commsfd, 0, SEEK_END);
+		write_packet_with_canary(commsfd, runnerpacket_log(STDOUT_FILENO, "\nThis test caused an abort condition: "), false);
+		write_packet_with_canary(commsfd, runnerpacket_log(STDOUT_FILENO, reason), false);
+		write_packet_with_canary(commsfd, runnerpacket_resultoverride("abort"), settings->sync);
+
+		close(commsfd);
+	} else {
+		write_abort_file(resdirfd, reason, prev, next);
+	}
+
+	free(prev);
+	free(next);
+}
+
+/*
+ * Parallel execution: the runner forks a worker process per device,
+ * and each worker executes one job list entry at a time with
+ * IGT_DEVICE pointing to its device. A worker runs the same
+ * execute_next_entry() as the serial executor, so output monitoring,
+ * timeouts, watchdog pings and dmesg collection stay per test. The
+ * runner only schedules and handles abort conditions.
+ */
+struct worker_report {
+	int result;
+	bool abort_already_written;
+	char reason[1024];
+};
+
+struct worker {
+	char *device_filter;
+	pid_t pid; /* 0 when idle */
+	size_t idx;
+	int reportfd;
+	struct job_list_entry entry;
+};
+
+static void copy_job_list_entry(struct job_list_entry *dst,
+				const struct job_list_entry *src)
+{
+	dst->binary = strdup(src->binary);
+	dst->subtest_count = src->subtest_count;
+	dst->subtests = NULL;
+	dst->exclusive = src->exclusive;
+
+	if (src->subtest_count) {
+		dst->subtests = calloc(src->subtest_count, sizeof(*dst->subtests));
+		for (size_t i = 0; i < src->subtest_count; i++)
+			dst->subtests[i] = strdup(src->subtests[i]);
+	}
+}
+
+static void free_job_list_entry(struct job_list_entry *entry)
+{
+	for (size_t i = 0; i < entry->subtest_count; i++)
+		free(entry->subtests[i]);
+	free(entry->subtests);
+	free(entry->binary);
+	memset(entry, 0, sizeof(*entry));
+}
+
+/*
+ * Fills @entry with what is left to execute of the job list entry
+ * @idx, taking into account results from an earlier (interrupted)
+ * execution.
+ *
+ * Returns: false if there's nothing to execute.
+ */
+static bool prepare_entry(struct job_list *job_list, size_t idx,
+			  int resdirfd, struct job_list_entry *entry)
+{
+	char name[32];
+	int dirfd;
+
+	copy_job_list_entry(entry, &job_list->entries[idx]);
+
+	snprintf(name, sizeof(name), "%zd", idx);
+	dirfd = openat(resdirfd, name, O_DIRECTORY | O_RDONLY);
+	if (dirfd < 0)
+		return true;
+
+	if (!prune_entry(dirfd, entry)) {
+		close(dirfd);
+		free_job_list_entry(entry);
+		return false;
+	}
+
+	close(dirfd);
+	return true;
+}
+
+static int get_device_filters(struct settings *settings, char ***filters)
+{
+	struct igt_device_card card;
+	int count = 0;
+
+	*filters = NULL;
+
+	igt_devices_scan();
+	igt_device_filter_add(settings->parallel_devices);
+
+	for (int i = 0; i < igt_device_filter_count(); i++) {
+		char *filter;
+		int k;
+
+		if (!igt_device_card_match(igt_device_filter_get(i), &card))
+			continue;
+
+		if (card.pci_slot_name[0])
+			asprintf(&filter, "pci:slot=%s", card.pci_slot_name);
+		else
+			asprintf(&filter, "drm:%s", card.card);
+
+		for (k = 0; k < count; k++)
+			if (!strcmp((*filters)[k], filter))
+				break;
+
+		if (k < count) {
+			free(filter);
+			continue;
+		}
+
+		*filters = realloc(*filters, (count + 1) * sizeof(**filters));
+		(*filters)[count++] = filter;
+	}
+
+	igt_device_filter_free_all();
+
+	return count;
+}
+
+static void __attribute__((noreturn))
+execute_worker(struct worker *worker, const char *device_filter,
+	       struct execute_state *state, size_t total,
+	       struct settings *settings,
+	       int testdirfd, int resdirfd,
+	       int sigfd, sigset_t *sigmask, int reportfd)
+{
+	struct execute_state wstate = *state;
+	struct worker_report report = {};
+	char *reason = NULL;
+
+	if (device_filter)
+		setenv("IGT_DEVICE", device_filter, 1);
+
+	if (settings->log_level >= LOG_LEVEL_VERBOSE)
+		outf("Executing entry %zd on %s\n", worker->idx,
+		     device_filter ?: "all devices");
+
+	wstate.next = worker->idx;
+	report.result = execute_next_entry(&wstate, total, NULL, settings,
+					   &worker->entry,
+					   testdirfd, resdirfd,
+					   sigfd, sigmask,
+					   &reason, &report.abort_already_written);
+	if (reason)
+		snprintf(report.reason, sizeof(report.reason), "%s", reason);
+
+	wait_async_syncs();
+	write(reportfd, &report, sizeof(report));
+
+	fflush(stdout);
+	fflush(stderr);
+
+	/* Don't run the atexit handlers, the runner owns the watchdogs */
+	_exit(0);
+}
+
+static bool start_worker(struct worker *worker, const char *device_filter,
+			 struct execute_state *state, size_t total,
+			 struct settings *settings,
+			 int testdirfd, int resdirfd,
+			 int sigfd, sigset_t *sigmask)
+{
+	int report[2];
+	pid_t pid;
+
+	if (pipe2(report, O_CLOEXEC)) {
+		errf("Error creating pipes: %m\n");
+		return false;
+	}
+
+	fflush(stdout);
+	fflush(stderr);
+
+	pid = fork();
+	if (pid < 0) {
+		errf("Failed to fork: %m\n");
+		close(report[0]);
+		close(report[1]);
+		return false;
+	} else if (pid == 0) {
+		close(report[0]);
+		execute_worker(worker, device_filter, state, total, settings,
+			       testdirfd, resdirfd, sigfd, sigmask, report[1]);
+		/* unreachable */
+	}
+
+	close(report[1]);
+	worker->reportfd = report[0];
+	worker->pid = pid;
+
+	return true;
+}
+
+static void signal_workers(struct worker *workers, int num_workers, int sig)
+{
+	for (int i = 0; i < num_workers; i++)
+		if (workers[i].pid)
+			kill(workers[i].pid, sig);
+}
+
+/*
+ * Returns: true if all scheduled entries were executed, false on
+ * errors and abort conditions. @die is set if the runner was killed
+ * by a signal.
+ */
+static bool execute_parallel(struct execute_state *state,
+			     struct settings *settings,
+			     struct job_list *job_list,
+			     int testdirfd, int resdirfd,
+			     int sigfd, sigset_t *sigmask,
+			     bool *die)
+{
+	struct worker *workers;
+	struct igt_vec requeue;
+	char **filters;
+	int num_workers, busy = 0;
+	bool exclusive_running = false;
+	bool stopping = false;
+	bool status = true;
+	double last = timeofday_double();
+
+	num_workers = get_device_filters(settings, &filters);
+	if (num_workers == 0) {
+		errf("No devices matching %s for parallel execution\n",
+		     settings->parallel_devices);
+		return false;
+	}
+
+	if (settings->log_level >= LOG_LEVEL_NORMAL) {
+		outf("Executing on %d devices in parallel:\n", num_workers);
+		for (int i = 0; i < num_workers; i++)
+			outf("  %s\n", filters[i]);
+	}
+
+	workers = calloc(num_workers, sizeof(*workers));
+	for (int i = 0; i < num_workers; i++)
+		workers[i].device_filter = filters[i];
+
+	igt_vec_init(&requeue, sizeof(size_t));
+
+	for (;;) {
+		struct signalfd_siginfo siginfo;
+		struct pollfd sigpoll = { .fd = sigfd, .events = POLLIN };
+		double now;
+		pid_t pid;
+		int ret;
+
+		while (!stopping && !exclusive_running) {
+			struct worker *worker = NULL;
+			const char *device_filter;
+			bool from_requeue;
+			size_t idx;
+
+			from_requeue = igt_vec_length(&requeue) > 0;
+			if (from_requeue)
+				idx = *(size_t *)igt_vec_elem(&requeue, 0);
+			else if (state->next < job_list->size)
+				idx = state->next;
+			else
+				break;
+
+			/* Exclusive tests wait for everything else to finish */
+			if (job_list->entries[idx].exclusive && busy)
+				break;
+
+			if (predict_overall_timeout(state, settings,
+						    &job_list->entries[idx])) {
+				state->time_left = 0.0;
+				stopping = true;
+				break;
+			}
+
+			for (int i = 0; i < num_workers; i++) {
+				if (!workers[i].pid) {
+					worker = &workers[i];
+					break;
+				}
+			}
+			if (!worker)
+				break;
+
+			if (from_requeue)
+				igt_vec_remove(&requeue, 0);
+			else
+				state->next++;
+
+			if (!prepare_entry(job_list, idx, resdirfd, &worker->entry))
+				continue;
+
+			/* and get all devices to themselves */
+			device_filter = worker->entry.exclusive ? NULL : worker->device_filter;
+
+			worker->idx = idx;
+			if (!start_worker(worker, device_filter, state,
+					  job_list->size, settings,
+					  testdirfd, resdirfd,
+					  sigfd, sigmask)) {
+				free_job_list_entry(&worker->entry);
+				stopping = true;
+				status = false;
+				break;
+			}
+
+			busy++;
+			exclusive_running = worker->entry.exclusive;
+		}
+
+		if (!busy)
+			break;
+
+		ret = poll(&sigpoll, 1, 1000);
+		if (ret < 0 && errno != EINTR) {
+			errf("Poll on signalfd failed with %m\n");
+			signal_workers(workers, num_workers, SIGTERM);
+			stopping = true;
+			status = false;
+			*die = true;
+		}
+
+		if (ret > 0 &&
+		    read(sigfd, &siginfo, sizeof(siginfo)) == sizeof(siginfo) &&
+		    siginfo.ssi_signo != SIGCHLD) {
+			/* Workers handle signals like the serial runner does */
+			errf("Runner is being killed by %s\n",
+			     strsignal(siginfo.ssi_signo));
+			signal_workers(workers, num_workers, siginfo.ssi_signo);
+			stopping = true;
+			status = false;
+			*die = true;
+		}
+
+		while ((pid = waitpid(-1, NULL, WNOHANG)) > 0) {
+			struct worker_report report = {};
+			struct worker *worker = NULL;
+			char *reason = NULL;
+
+			for (int i = 0; i < num_workers; i++) {
+				if (workers[i].pid == pid) {
+					worker = &workers[i];
+					break;
+				}
+			}
+			if (!worker)
+				continue;
+
+			if (read(worker->reportfd, &report, sizeof(report)) != sizeof(report)) {
+				errf("Worker for entry %zd died unexpectedly\n",
+				     worker->idx);
+				report.result = -1;
+			}
+			close(worker->reportfd);
+
+			worker->pid = 0;
+			busy--;
+			if (worker->entry.exclusive)
+				exclusive_running = false;
+			free_job_list_entry(&worker->entry);
+
+			if (report.reason[0])
+				reason = strdup(report.reason);
+			else if (!stopping)
+				reason = need_to_abort(settings);
+
+			if (reason) {
+				if (!report.abort_already_written)
+					write_abort_for_entry(settings, job_list,
+							      resdirfd, worker->idx,
+							      reason);
+				free(reason);
+
+				/* Tests running concurrently become notrun */
+				if (!stopping)
+					signal_workers(workers, num_workers, SIGHUP);
+				stopping = true;
+				status = false;
+			} else if (report.result < 0) {
+				stopping = true;
+				status = false;
+			} else if (report.result > 0 && !stopping) {
+				/* Continue after the killed subtest */
+				igt_vec_push(&requeue, &worker->idx);
+			}
+		}
+
+		now = timeofday_double();
+		reduce_time_left(settings, state, now - last);
+		last = now;
+
+		if (!stopping && overall_timeout_exceeded(state)) {
+			if (settings->log_level >= LOG_LEVEL_NORMAL)
+				outf("Overall timeout time exceeded, stopping.\n");
+
+			stopping = true;
+		}
+	}
+
+	igt_vec_fini(&requeue);
+	for (int i = 0; i < num_workers; i++)
+		free(filters[i]);
+	free(filters);
+	free(workers);
+
+	return status;
+}
+
+static char device_scan_cache[PATH_MAX];
+
+static void remove_device_scan_cache(void)
+{
+	unlink(device_scan_cache);
+}
+
+/*
+ * Scans the devices once and passes the result to the tests through
+ * IGT_DEVICE_SCAN_CACHE, so they don't each enumerate udev again. The
+ * cache is removed on any drm or pci device change, the tests then fall
+ * back to scanning on their own.
+ */
+static void setup_device_scan_cache(void)
+{
+	const char *dir = getenv("XDG_RUNTIME_DIR") ?: "/tmp";
+
+	snprintf(device_scan_cache, sizeof(device_scan_cache),
+		 "%s/igt_device_scan.%d", dir, getpid());
+
+	if (!igt_devices_cache_watch(device_scan_cache)) {
+		errf("Warning: Cannot watch for device changes, not caching the device scan\n");
+		return;
+	}
+
+	igt_devices_scan();
+	if (!igt_devices_cache_save(device_scan_cache)) {
+		errf("Warning: Cannot write the device scan cache %s\n",
+		     device_scan_cache);
+		return;
+	}
+
+	setenv("IGT_DEVICE_SCAN_CACHE", device_scan_cache, 1);
+	atexit(remove_device_scan_cache);
+}
+
 bool execute(struct execute_state *state,
 	     struct settings *settings,
 	     struct job_list *job_list)
@@ -2450,6 +3813,9 @@ bool execute(struct execute_state *state,
 		setenv(env_var->key, env_var->value, 1);
 	}
 
+	if (settings->device_scan_cache)
+		setup_device_scan_cache();
+
 	if ((resdirfd = open(settings->results_path, O_DIRECTORY | O_RDONLY)) < 0) {
 		/* Initialize state should have done this */
 		errf("Error: Failure opening results path %s\n",
@@ -2498,8 +3864,16 @@ bool execute(struct execute_state *state,
 		close(timefd);
 	}
 
+	if (settings->live_results && !live_results_enabled() &&
+	    !live_results_open(resdirfd, settings->live_results_socket))
+		errf("Warning: Cannot open %s: %m\n", LIVE_RESULTS_FILENAME);
+
 	oom_immortal();
 
+	/* Created before forking any parallel workers, they share it */
+	if (settings->memory_budget && !memcg_init())
+		errf("Warning: Cannot set up memory cgroups, running without the memory budget\n");
+
 	sigemptyset(&sigmask);
 	sigaddset(&sigmask, SIGCHLD);
 	sigaddset(&sigmask, SIGINT);
@@ -2560,7 +3934,20 @@ bool execute(struct execute_state *state,
 		}
 	}
 
-	for (; state->next < job_list->size;
+	if (settings->runtime_db)
+		state->runtimes = runtime_db_load(settings->runtime_db);
+
+	if (settings->parallel_devices) {
+		bool die = false;
+
+		status = execute_parallel(state, settings, job_list,
+					  testdirfd, resdirfd,
+					  sigfd, &sigmask, &die);
+		if (die)
+			goto end;
+	}
+
+	for (; !settings->parallel_devices && state->next < job_list->size;
 	     state->next++) {
 		char *reason = NULL;
 		char *job_name;
@@ -2571,12 +3958,20 @@ bool execute(struct execute_state *state,
 		if (settings->facts)
 			igt_facts(last_test);
 
-		if (settings->kmemleak_each)
+		if (settings->kmemleak_background) {
+			char *next_test = entry_display_name(&job_list->entries[state->next]);
+
+			if (!runner_kmemleak_background(last_test, next_test,
+							resdirfd, settings->sync))
+				errf("Failed to collect kmemleak logs in the background\n");
+			free(next_test);
+		} else if (settings->kmemleak_each) {
 			if (!runner_kmemleak(last_test, resdirfd,
 					     settings->kmemleak_each,
 					     settings->sync))
 				errf("Failed to collect kmemleak logs after %s\n",
 				     last_test);
+		}
 
 		if (settings->facts || settings->kmemleak_each)
 			last_test = entry_display_name(&job_list->entries[state->next]);
@@ -2586,6 +3981,12 @@ bool execute(struct execute_state *state,
 			goto end;
 		}
 
+		if (predict_overall_timeout(state, settings,
+					    &job_list->entries[state->next])) {
+			state->time_left = 0.0;
+			break;
+		}
+
 		if (settings->cov_results_per_test) {
 			code_coverage_start(settings, sigfd, &reason);
 			job_name = entry_display_name(&job_list->entries[state->next]);
@@ -2608,29 +4009,10 @@ bool execute(struct execute_state *state,
 		}
 
 		if (reason != NULL || (reason = need_to_abort(settings)) != NULL) {
-			char *prev = entry_display_name(&job_list->entries[state->next]);
-			char *next = (state->next + 1 < job_list->size ?
-				      entry_display_name(&job_list->entries[state->next + 1]) :
-				      strdup("nothing"));
-
-			if (!already_written) {
-				int commsfd;
-
-				commsfd = open_comms_if_valid(resdirfd, state->next);
-				if (commsfd >= 0) {
-					lseek(commsfd, 0, SEEK_END);
-					write_packet_with_canary(commsfd, runnerpacket_log(STDOUT_FILENO, "\nThis test caused an abort condition: "), false);
-					write_packet_with_canary(commsfd, runnerpacket_log(STDOUT_FILENO, reason), false);
-					write_packet_with_canary(commsfd, runnerpacket_resultoverride("abort"), settings->sync);
-
-					close(commsfd);
-				} else {
-					write_abort_file(resdirfd, reason, prev, next);
-				}
-			}
+			if (!already_written)
+				write_abort_for_entry(settings, job_list, resdirfd,
+						      state->next, reason);
 
-			free(prev);
-			free(next);
 			free(reason);
 			status = false;
 			break;
@@ -2661,8 +4043,12 @@ bool execute(struct execute_state *state,
 				status = false;
 				goto end_post_signal_restore;
 			}
+			if (!runner_kmemleak_wait())
+				errf("Failed to collect kmemleak logs in the background\n");
 			close(sigfd);
 			close(testdirfd);
+			runtime_db_free(state->runtimes);
+			live_results_close();
 			if (!initialize_execute_state_from_resume(resdirfd, state, settings, job_list))
 				return false;
 			state->time_left = time_left;
@@ -2674,6 +4060,9 @@ bool execute(struct execute_state *state,
 	if (settings->facts)
 		igt_facts(last_test);
 
+	if (!runner_kmemleak_wait())
+		errf("Failed to collect kmemleak logs in the background\n");
+
 	if (settings->kmemleak)
 		if (!runner_kmemleak(last_test, resdirfd,
 				     settings->kmemleak_each, settings->sync))
@@ -2685,6 +4074,9 @@ bool execute(struct execute_state *state,
 	}
 
  end:
+	/* Bailing out early can leave a scan running */
+	runner_kmemleak_wait();
+
 	if (settings->enable_code_coverage && !settings->cov_results_per_test) {
 		char *reason = NULL;
 
@@ -2702,6 +4094,11 @@ bool execute(struct execute_state *state,
 	if (should_die_because_signal(sigfd))
 		status = false;
  end_post_signal_restore:
+	wait_async_syncs();
+	memcg_fini();
+	runtime_db_free(state->runtimes);
+	state->runtimes = NULL;
+	live_results_close();
 	close(sigfd);
 	close(testdirfd);
 	close(resdirfd);
@@ -2,6 +2,7 @@
 #define RUNNER_EXECUTOR_H
 
 #include "job_list.h"
+#include "runtime_db.h"
 #include "settings.h"
 
 struct execute_state
@@ -14,6 +15,8 @@ struct execute_state
 	 */
 	double time_left;
 	bool dry;
+	/* Loaded during execute() if settings->runtime_db is set */
+	struct runtime_db *runtimes;
 };
 
 enum {
@@ -1,4 +1,5 @@
 #include <ctype.h>
+#include <elf.h>
 #include <errno.h>
 #include <fcntl.h>
 #ifdef __linux__
@@ -7,12 +8,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
 #include "job_list.h"
 #include "igt_core.h"
+#include "runtime_db.h"
 
 static bool matches_any(const char *str, struct regex_list *list)
 {
@@ -40,21 +44,203 @@ static void add_job_list_entry(struct job_list *job_list,
 	entry->binary = binary;
 	entry->subtests = subtests;
 	entry->subtest_count = subtest_count;
+	entry->exclusive = false;
 }
 
-static void add_subtests(struct job_list *job_list, struct settings *settings,
-			 char *binary,
-			 struct regex_list *include, struct regex_list *exclude)
+/*
+ * The subtests of a binary, from its --list-subtests output or from the
+ * list cache. @status is the pclose() status of the listing, or
+ * LISTING_NOT_RUN if the binary couldn't be executed.
+ */
+struct subtest_listing {
+	const char *binary;
+	FILE *pipe;
+	char **names;
+	size_t count;
+	int status;
+	char key[128];
+};
+
+#define LISTING_NOT_RUN (-2)
+
+#define NOTE_ALIGN(x) (((x) + 3) & ~3u)
+
+/*
+ * Reads the build ID note of an ELF binary, which changes with each
+ * rebuild even when the size and the timestamps wouldn't tell.
+ */
+static void build_id(int fd, size_t size, char *buf, size_t len)
+{
+	const Elf64_Ehdr *ehdr;
+	const uint8_t *map;
+
+	*buf = '\0';
+
+	if (size < sizeof(*ehdr))
+		return;
+
+	map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED)
+		return;
+
+	ehdr = (const Elf64_Ehdr *)map;
+	if (memcmp(ehdr->e_ident, ELFMAG, SELFMAG) ||
+	    ehdr->e_ident[EI_CLASS] != ELFCLASS64 ||
+	    ehdr->e_phoff + (uint64_t)ehdr->e_phnum * sizeof(Elf64_Phdr) > size)
+		goto out;
+
+	for (int i = 0; i < ehdr->e_phnum; i++) {
+		const Elf64_Phdr *phdr =
+			(const Elf64_Phdr *)(map + ehdr->e_phoff) + i;
+		uint64_t off;
+
+		if (phdr->p_type != PT_NOTE || phdr->p_offset + phdr->p_filesz > size)
+			continue;
+
+		for (off = 0; off + sizeof(Elf64_Nhdr) <= phdr->p_filesz; ) {
+			const Elf64_Nhdr *nhdr =
+				(const Elf64_Nhdr *)(map + phdr->p_offset + off);
+			const uint8_t *desc = (const uint8_t *)(nhdr + 1) +
+					      NOTE_ALIGN(nhdr->n_namesz);
+
+			off += sizeof(*nhdr) + NOTE_ALIGN(nhdr->n_namesz) +
+			       NOTE_ALIGN(nhdr->n_descsz);
+			if (off > phdr->p_filesz)
+				break;
+
+			if (nhdr->n_type != NT_GNU_BUILD_ID ||
+			    nhdr->n_namesz != 4 ||
+			    memcmp(nhdr + 1, "GNU", 4))
+				continue;
+
+			for (int j = 0; j < nhdr->n_descsz && 2 * j + 2 < len; j++)
+				sprintf(buf + 2 * j, "%02x", desc[j]);
+			goto out;
+		}
+	}
+
+out:
+	munmap((void *)map, size);
+}
+
+static bool listing_key(struct settings *settings,
+			struct subtest_listing *l)
+{
+	char path[PATH_MAX], id[41];
+	struct stat st;
+	int fd;
+
+	snprintf(path, sizeof(path), "%s/%s", settings->test_root, l->binary);
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	if (fstat(fd, &st)) {
+		close(fd);
+		return false;
+	}
+
+	build_id(fd, st.st_size, id, sizeof(id));
+	close(fd);
+
+	snprintf(l->key, sizeof(l->key), "%lld %lld.%09ld %llu %s",
+		 (long long)st.st_size, (long long)st.st_mtim.tv_sec,
+		 st.st_mtim.tv_nsec, (unsigned long long)st.st_ino,
+		 id[0] ? id : "-");
+
+	return true;
+}
+
+static void listing_cache_path(struct settings *settings,
+			       struct subtest_listing *l,
+			       char *path, size_t len)
+{
+	snprintf(path, len, "%s/%s.subtests", settings->list_cache, l->binary);
+}
+
+/*
+ * A cache file holds the key of the binary it was listed from, the
+ * status of the listing and the subtests, one per line.
+ */
+static bool listing_cache_load(struct settings *settings,
+			       struct subtest_listing *l)
+{
+	char path[PATH_MAX];
+	char *line = NULL;
+	size_t line_len = 0;
+	ssize_t n;
+	FILE *f;
+
+	if (!settings->list_cache || !listing_key(settings, l))
+		return false;
+
+	listing_cache_path(settings, l, path, sizeof(path));
+	f = fopen(path, "r");
+	if (!f)
+		return false;
+
+	if (getline(&line, &line_len, f) <= 0 ||
+	    strcspn(line, "\n") != strlen(l->key) ||
+	    strncmp(line, l->key, strlen(l->key)) ||
+	    fscanf(f, "%d\n", &l->status) != 1)
+		goto miss;
+
+	while ((n = getline(&line, &line_len, f)) > 0) {
+		line[strcspn(line, "\n")] = '\0';
+
+		l->count++;
+		l->names = realloc(l->names, l->count * sizeof(*l->names));
+		l->names[l->count - 1] = strdup(line);
+	}
+
+	free(line);
+	fclose(f);
+
+	return true;
+
+miss:
+	free(line);
+	fclose(f);
+
+	return false;
+}
+
+static void listing_cache_store(struct settings *settings,
+				struct subtest_listing *l)
+{
+	char path[PATH_MAX], tmp[PATH_MAX];
+	FILE *f;
+
+	if (!settings->list_cache || !l->key[0])
+		return;
+
+	mkdir(settings->list_cache, 0755);
+
+	/* Written aside and renamed, concurrent runners share the cache */
+	listing_cache_path(settings, l, path, sizeof(path));
+	snprintf(tmp, sizeof(tmp), "%s.%d", path, getpid());
+	f = fopen(tmp, "w");
+	if (!f)
+		return;
+
+	fprintf(f, "%s\n%d\n", l->key, l->status);
+	for (size_t i = 0; i < l->count; i++)
+		fprintf(f, "%s\n", l->names[i]);
+
+	if (fclose(f) || rename(tmp, path))
+		unlink(tmp);
+}
+
+static void listing_start(struct settings *settings,
+			  struct subtest_listing *l)
 {
-	FILE *p;
 	char cmd[256] = {};
-	char *subtestname;
-	char **subtests = NULL;
-	size_t num_subtests = 0;
 	int s;
 
+	l->status = LISTING_NOT_RUN;
+
 	s = snprintf(cmd, sizeof(cmd), "%s/%s --list-subtests",
-		     settings->test_root, binary);
+		     settings->test_root, l->binary);
 	if (s < 0) {
 		fprintf(stderr, "Failure generating command string, this shouldn't happen.\n");
 		return;
@@ -62,32 +248,94 @@ static void add_subtests(struct job_list *job_list, struct settings *settings,
 
 	if (s >= sizeof(cmd)) {
 		fprintf(stderr, "Path to binary too long, ignoring: %s/%s\n",
-			settings->test_root, binary);
+			settings->test_root, l->binary);
 		return;
 	}
 
-	p = popen(cmd, "r");
-	if (!p) {
+	/* Keyed before running, a rebuild meanwhile only misses the cache */
+	if (settings->list_cache && !listing_key(settings, l))
+		l->key[0] = '\0';
+
+	l->pipe = popen(cmd, "r");
+	if (!l->pipe)
 		fprintf(stderr, "popen failed when executing %s: %s\n",
 			cmd,
 			strerror(errno));
+}
+
+static void listing_finish(struct settings *settings,
+			   struct subtest_listing *l)
+{
+	char *subtestname;
+
+	if (!l->pipe)
 		return;
+
+	while (fscanf(l->pipe, "%ms", &subtestname) == 1) {
+		l->count++;
+		l->names = realloc(l->names, l->count * sizeof(*l->names));
+		l->names[l->count - 1] = subtestname;
+	}
+
+	l->status = pclose(l->pipe);
+	l->pipe = NULL;
+
+	/* Only cache the complete listings */
+	if (l->status == 0 ||
+	    (WIFEXITED(l->status) && WEXITSTATUS(l->status) == IGT_EXIT_INVALID))
+		listing_cache_store(settings, l);
+}
+
+/*
+ * Lists the subtests of the binaries, from the cache when the binary
+ * didn't change since, running the --list-subtests of the others
+ * concurrently, as many at a time as there are CPUs.
+ */
+static void list_subtests(struct settings *settings,
+			  struct subtest_listing **l, size_t n)
+{
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	size_t window = cpus > 0 ? cpus : 1;
+	size_t started = 0, done;
+
+	for (done = 0; done < n; done++) {
+		for (; started < n && started - done < window; started++)
+			if (!listing_cache_load(settings, l[started]))
+				listing_start(settings, l[started]);
+
+		listing_finish(settings, l[done]);
 	}
+}
 
-	while (fscanf(p, "%ms", &subtestname) == 1) {
+static void listing_fini(struct subtest_listing *l)
+{
+	for (size_t i = 0; i < l->count; i++)
+		free(l->names[i]);
+	free(l->names);
+}
+
+static void add_listed_subtests(struct job_list *job_list,
+				struct settings *settings,
+				struct subtest_listing *l,
+				struct regex_list *include,
+				struct regex_list *exclude)
+{
+	const char *binary = l->binary;
+	char **subtests = NULL;
+	size_t num_subtests = 0;
+	int s;
+
+	for (size_t i = 0; i < l->count; i++) {
+		char *subtestname = l->names[i];
 		char piglitname[256];
 
 		generate_piglit_name(binary, subtestname, piglitname, sizeof(piglitname));
 
-		if (exclude && exclude->size && matches_any(piglitname, exclude)) {
-			free(subtestname);
+		if (exclude && exclude->size && matches_any(piglitname, exclude))
 			continue;
-		}
 
-		if (include && include->size && !matches_any(piglitname, include)) {
-			free(subtestname);
+		if (include && include->size && !matches_any(piglitname, include))
 			continue;
-		}
 
 		if (settings->multiple_mode) {
 			num_subtests++;
@@ -99,15 +347,13 @@ static void add_subtests(struct job_list *job_list, struct settings *settings,
 			add_job_list_entry(job_list, strdup(binary), subtests, 1);
 			subtests = NULL;
 		}
-
-		free(subtestname);
 	}
 
 	if (num_subtests)
 		add_job_list_entry(job_list, strdup(binary), subtests, num_subtests);
 
-	s = pclose(p);
-	if (s == 0) {
+	s = l->status;
+	if (s == 0 || s == LISTING_NOT_RUN) {
 		return;
 	} else if (s == -1) {
 		fprintf(stderr, "popen error when executing %s: %s\n", binary, strerror(errno));
@@ -134,10 +380,28 @@ static void add_subtests(struct job_list *job_list, struct settings *settings,
 	}
 }
 
+static void add_subtests(struct job_list *job_list, struct settings *settings,
+			 char *binary,
+			 struct regex_list *include, struct regex_list *exclude)
+{
+	struct subtest_listing l = { .binary = binary }, *lp = &l;
+
+	list_subtests(settings, &lp, 1);
+	add_listed_subtests(job_list, settings, &l, include, exclude);
+	listing_fini(&l);
+}
+
 static bool filtered_job_list(struct job_list *job_list,
 			      struct settings *settings,
 			      int fd)
 {
+	struct filtered_binary {
+		struct subtest_listing listing;
+		struct regex_list *include;
+		bool all;
+	} *binaries = NULL;
+	struct subtest_listing **listings;
+	size_t num_binaries = 0, num_listings = 0;
 	FILE *f;
 	char buf[128];
 	bool ok;
@@ -150,6 +414,8 @@ static bool filtered_job_list(struct job_list *job_list,
 	f = fdopen(fd, "r");
 
 	while (fscanf(f, "%127s", buf) == 1) {
+		struct filtered_binary *b;
+
 		if (!strcmp(buf, "TESTLIST") || !(strcmp(buf, "END")))
 			continue;
 
@@ -160,6 +426,11 @@ static bool filtered_job_list(struct job_list *job_list,
 		if (settings->exclude_regexes.size && matches_any(buf, &settings->exclude_regexes))
 			continue;
 
+		binaries = realloc(binaries, ++num_binaries * sizeof(*binaries));
+		b = &binaries[num_binaries - 1];
+		memset(b, 0, sizeof(*b));
+		b->listing.binary = strdup(buf);
+
 		/*
 		 * If the binary name matches include filters (or include filters not present),
 		 * all subtests except those matching exclude filters are added.
@@ -172,20 +443,37 @@ static bool filtered_job_list(struct job_list *job_list,
 				 * get to omit executing
 				 * --list-subtests.
 				 */
-				add_job_list_entry(job_list, strdup(buf), NULL, 0);
-			else
-				add_subtests(job_list, settings, buf,
-					     NULL, &settings->exclude_regexes);
+				b->all = true;
 			continue;
 		}
 
 		/*
 		 * Binary name doesn't match exclude or include filters.
 		 */
-		add_subtests(job_list, settings, buf,
-			     &settings->include_regexes,
-			     &settings->exclude_regexes);
+		b->include = &settings->include_regexes;
+	}
+
+	/* The listings run concurrently, the job list keeps the order */
+	listings = calloc(num_binaries, sizeof(*listings));
+	for (size_t i = 0; i < num_binaries; i++)
+		if (!binaries[i].all)
+			listings[num_listings++] = &binaries[i].listing;
+	list_subtests(settings, listings, num_listings);
+	free(listings);
+
+	for (size_t i = 0; i < num_binaries; i++) {
+		struct filtered_binary *b = &binaries[i];
+
+		if (b->all)
+			add_job_list_entry(job_list, strdup(b->listing.binary), NULL, 0);
+		else
+			add_listed_subtests(job_list, settings, &b->listing,
+					    b->include, &settings->exclude_regexes);
+
+		listing_fini(&b->listing);
+		free((char *)b->listing.binary);
 	}
+	free(binaries);
 
 	ok = job_list->size != 0;
 	if (!ok)
@@ -401,21 +689,172 @@ void init_job_list(struct job_list *job_list)
 	memset(job_list, 0, sizeof(*job_list));
 }
 
+static void free_job_list_entry(struct job_list_entry *entry)
+{
+	size_t k;
+
+	free(entry->binary);
+	for (k = 0; k < entry->subtest_count; k++) {
+		free(entry->subtests[k]);
+	}
+	free(entry->subtests);
+}
+
 void free_job_list(struct job_list *job_list)
 {
-	int i, k;
+	int i;
+
+	for (i = 0; i < job_list->size; i++)
+		free_job_list_entry(&job_list->entries[i]);
+	free(job_list->entries);
+	init_job_list(job_list);
+}
+
+static bool entry_matches_any(struct job_list_entry *entry,
+			      struct regex_list *list)
+{
+	char piglitname[256];
+	size_t i;
+
+	if (matches_any(entry->binary, list))
+		return true;
+
+	generate_piglit_name(entry->binary, NULL, piglitname, sizeof(piglitname));
+	if (matches_any(piglitname, list))
+		return true;
+
+	for (i = 0; i < entry->subtest_count; i++) {
+		generate_piglit_name(entry->binary, entry->subtests[i],
+				     piglitname, sizeof(piglitname));
+		if (matches_any(piglitname, list))
+			return true;
+	}
+
+	return false;
+}
+
+static void mark_exclusive_entries(struct job_list *job_list,
+				   struct settings *settings)
+{
+	size_t i;
+
+	if (!settings->exclusive_regexes.size)
+		return;
 
 	for (i = 0; i < job_list->size; i++) {
 		struct job_list_entry *entry = &job_list->entries[i];
 
-		free(entry->binary);
-		for (k = 0; k < entry->subtest_count; k++) {
-			free(entry->subtests[k]);
+		entry->exclusive = entry_matches_any(entry, &settings->exclusive_regexes);
+	}
+}
+
+struct shard_key {
+	double weight;
+	size_t idx;
+};
+
+static int cmp_shard_key(const void *a, const void *b)
+{
+	const struct shard_key *ka = a, *kb = b;
+
+	if (ka->weight != kb->weight)
+		return ka->weight < kb->weight ? 1 : -1;
+
+	return ka->idx < kb->idx ? -1 : ka->idx > kb->idx;
+}
+
+/*
+ * Assigns each entry to a shard so that the expected runtime of the
+ * shards is as even as possible, heaviest entries first, always to the
+ * currently lightest shard. Entries without runtime history are
+ * weighted by their subtest count, scaled by the average known
+ * runtime of a subtest. Given the same job list and runtime database
+ * the result is the same on every machine.
+ *
+ * Returns: an array of the shard (counting from 0) of each entry.
+ */
+static int *partition_job_list(struct job_list *job_list,
+			       struct settings *settings)
+{
+	struct runtime_db *db = NULL;
+	struct shard_key *keys;
+	double *load, known_time = 0.0, per_subtest = 1.0;
+	size_t i, known_subtests = 0;
+	int *shards;
+
+	if (settings->runtime_db)
+		db = runtime_db_load(settings->runtime_db);
+
+	keys = calloc(job_list->size, sizeof(*keys));
+	for (i = 0; i < job_list->size; i++) {
+		struct job_list_entry *entry = &job_list->entries[i];
+
+		keys[i].idx = i;
+		keys[i].weight = db ? runtime_db_entry_estimate(db, entry) : -1.0;
+		if (keys[i].weight >= 0.0) {
+			known_time += keys[i].weight;
+			known_subtests += entry->subtest_count ?: 1;
 		}
-		free(entry->subtests);
 	}
-	free(job_list->entries);
-	init_job_list(job_list);
+
+	if (known_time > 0.0)
+		per_subtest = known_time / known_subtests;
+
+	for (i = 0; i < job_list->size; i++) {
+		struct job_list_entry *entry = &job_list->entries[i];
+
+		if (keys[i].weight < 0.0)
+			keys[i].weight = per_subtest * (entry->subtest_count ?: 1);
+	}
+
+	qsort(keys, job_list->size, sizeof(*keys), cmp_shard_key);
+
+	load = calloc(settings->shard_count, sizeof(*load));
+	shards = calloc(job_list->size, sizeof(*shards));
+	for (i = 0; i < job_list->size; i++) {
+		int s, lightest = 0;
+
+		for (s = 1; s < settings->shard_count; s++)
+			if (load[s] < load[lightest])
+				lightest = s;
+
+		load[lightest] += keys[i].weight;
+		shards[keys[i].idx] = lightest;
+	}
+
+	if (settings->log_level >= LOG_LEVEL_VERBOSE)
+		for (i = 0; i < settings->shard_count; i++)
+			printf("Shard %zd/%d: expected runtime %.1fs\n",
+			       i + 1, settings->shard_count, load[i]);
+
+	free(load);
+	free(keys);
+	runtime_db_free(db);
+
+	return shards;
+}
+
+static void shard_job_list(struct job_list *job_list,
+			   struct settings *settings)
+{
+	int *shards;
+	size_t i, kept = 0;
+
+	if (settings->shard_count <= 1 || !job_list->size)
+		return;
+
+	shards = partition_job_list(job_list, settings);
+
+	/* Keep the entries of this shard in their original order */
+	for (i = 0; i < job_list->size; i++) {
+		if (shards[i] == settings->shard_index - 1)
+			job_list->entries[kept++] = job_list->entries[i];
+		else
+			free_job_list_entry(&job_list->entries[i]);
+	}
+	job_list->size = kept;
+
+	free(shards);
 }
 
 bool create_job_list(struct job_list *job_list,
@@ -455,6 +894,18 @@ bool create_job_list(struct job_list *job_list,
 	else
 		result = filtered_job_list(job_list, settings, fd);
 
+	if (result) {
+		mark_exclusive_entries(job_list, settings);
+		shard_job_list(job_list, settings);
+	}
+
+	if (result && settings->longest_first) {
+		struct runtime_db *db = runtime_db_load(settings->runtime_db);
+
+		runtime_db_sort_longest_first(db, job_list);
+		runtime_db_free(db);
+	}
+
 	close(fd);
 	close(dirfd);
 
@@ -462,6 +913,7 @@ bool create_job_list(struct job_list *job_list,
 }
 
 static char joblist_filename[] = "joblist.txt";
+static char exclusive_prefix[] = "exclusive:";
 bool serialize_job_list(struct job_list *job_list, struct settings *settings)
 {
 	int dirfd, fd;
@@ -511,6 +963,9 @@ bool serialize_job_list(struct job_list *job_list, struct settings *settings)
 
 	for (i = 0; i < job_list->size; i++) {
 		struct job_list_entry *entry = &job_list->entries[i];
+
+		if (entry->exclusive)
+			fputs(exclusive_prefix, f);
 		fputs(entry->binary, f);
 
 		if (entry->subtest_count) {
@@ -557,9 +1012,10 @@ bool read_job_list(struct job_list *job_list, int dirfd)
 	}
 
 	while ((read = getline(&line, &line_len, f))) {
-		char *binary, *sublist, *comma;
+		char *binary, *sublist, *comma, *start = line;
 		char **subtests = NULL;
 		size_t num_subtests = 0, len;
+		bool exclusive = false;
 
 		if (read < 0) {
 			if (errno == EINTR)
@@ -572,14 +1028,20 @@ bool read_job_list(struct job_list *job_list, int dirfd)
 		if (len > 0 && line[len - 1] == '\n')
 			line[len - 1] = '\0';
 
-		sublist = strchr(line, ' ');
+		if (!strncmp(start, exclusive_prefix, strlen(exclusive_prefix))) {
+			start += strlen(exclusive_prefix);
+			exclusive = true;
+		}
+
+		sublist = strchr(start, ' ');
 		if (!sublist) {
-			add_job_list_entry(job_list, strdup(line), NULL, 0);
+			add_job_list_entry(job_list, strdup(start), NULL, 0);
+			job_list->entries[job_list->size - 1].exclusive = exclusive;
 			continue;
 		}
 
 		*sublist++ = '\0';
-		binary = strdup(line);
+		binary = strdup(start);
 
 		do {
 			comma = strchr(sublist, ',');
@@ -594,6 +1056,7 @@ bool read_job_list(struct job_list *job_list, int dirfd)
 		} while (comma != NULL);
 
 		add_job_list_entry(job_list, binary, subtests, num_subtests);
+		job_list->entries[job_list->size - 1].exclusive = exclusive;
 	}
 
 	free(line);
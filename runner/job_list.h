@@ -19,6 +19,11 @@ struct job_list_entry {
 	 * the above array.
 	 */
 	size_t subtest_count;
+	/*
+	 * Run without any other test executing concurrently when
+	 * executing on multiple devices in parallel.
+	 */
+	bool exclusive;
 };
 
 struct job_list
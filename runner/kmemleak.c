@@ -6,7 +6,9 @@
 #include <unistd.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "kmemleak.h"
@@ -16,6 +18,18 @@ static char runner_kmemleak_file[256] = "/sys/kernel/debug/kmemleak";
 
 #define MAX_WRITE_RETRIES 5
 
+/* The scan running in the background, see runner_kmemleak_background() */
+static struct {
+	pthread_t thread;
+	bool running;
+	unsigned int generation;
+	char *last_test;
+	char *next_test;
+	int resdirfd;
+	bool sync;
+	bool result;
+} background_scan;
+
 /**
  * runner_kmemleak_write: Writes the buffer to the file descriptor retrying when
  * possible.
@@ -144,6 +158,7 @@ static bool runner_kmemleak_scan(void)
 /**
  * runner_kmemleak_append_to:
  * @last_test: last test name to append to the file
+ * @next_test: test started while scanning, or NULL
  * @resdirfd: file descriptor of the results directory
  * @kmemleak_each: if true we scan after each test
  * @sync: sync the kmemleak file often
@@ -153,7 +168,8 @@ static bool runner_kmemleak_scan(void)
  *
  * Returns: true if appending to the file was successful, false otherwise.
  */
-static bool runner_kmemleak_append_to(const char *last_test, int resdirfd,
+static bool runner_kmemleak_append_to(const char *last_test,
+				      const char *next_test, int resdirfd,
 				      bool kmemleak_each, bool sync)
 {
 	const char *before = "kmemleaks found before running any test\n\n";
@@ -178,6 +194,18 @@ static bool runner_kmemleak_append_to(const char *last_test, int resdirfd,
 	if (kmemleak_each) {
 		if (!last_test) {
 			runner_kmemleak_write(resfilefd, before, strlen(before));
+		} else if (next_test) {
+			/*
+			 * Leaks younger than the kmemleak minimum age
+			 * can't show up in the scan, which leaves the
+			 * early moments of next_test out of it.
+			 */
+			snprintf(buf, sizeof(buf),
+				 "\n\nkmemleaks found after running %s (scan %u, overlapped with the start of %s):\n",
+				 last_test, background_scan.generation, next_test);
+
+			runner_kmemleak_write(resfilefd, buf, strlen(buf));
+			memset(buf, 0, sizeof(buf));
 		} else {
 			/* Write \n\n last_test \n to buf */
 			snprintf(buf, sizeof(buf),
@@ -257,7 +285,7 @@ bool runner_kmemleak(const char *last_test, int resdirfd, bool kmemleak_each,
 {
 	/* Scan to collect results */
 	if (runner_kmemleak_scan())
-		if (!runner_kmemleak_append_to(last_test, resdirfd,
+		if (!runner_kmemleak_append_to(last_test, NULL, resdirfd,
 					       kmemleak_each, sync))
 			return false;
 
@@ -266,3 +294,88 @@ bool runner_kmemleak(const char *last_test, int resdirfd, bool kmemleak_each,
 
 	return true;
 }
+
+static void *runner_kmemleak_thread(void *data)
+{
+	background_scan.result = true;
+
+	if (runner_kmemleak_scan())
+		background_scan.result =
+			runner_kmemleak_append_to(background_scan.last_test,
+						  background_scan.next_test,
+						  background_scan.resdirfd,
+						  true, background_scan.sync);
+
+	runner_kmemleak_clear();
+
+	return NULL;
+}
+
+/**
+ * runner_kmemleak_wait:
+ *
+ * Wait for the scan started with runner_kmemleak_background() to
+ * finish, if any.
+ *
+ * Returns: false if the scan failed to collect its results, true
+ * otherwise.
+ */
+bool runner_kmemleak_wait(void)
+{
+	if (!background_scan.running)
+		return true;
+
+	pthread_join(background_scan.thread, NULL);
+	background_scan.running = false;
+
+	free(background_scan.last_test);
+	free(background_scan.next_test);
+	background_scan.last_test = background_scan.next_test = NULL;
+
+	return background_scan.result;
+}
+
+/**
+ * runner_kmemleak_background:
+ * @last_test: last test name to append to the file
+ * @next_test: test that is going to run during the scan
+ * @resdirfd: file descriptor of the results directory
+ * @sync: sync the kmemleak file often
+ *
+ * Like runner_kmemleak() with kmemleak_each, but the scan runs in a
+ * background thread so @next_test can start right away. The leaks are
+ * recorded under a header naming both tests and the generation of the
+ * scan. Only one scan runs at a time, a previous one is waited for
+ * first.
+ *
+ * Returns: false if the previous scan failed, true otherwise.
+ */
+bool runner_kmemleak_background(const char *last_test, const char *next_test,
+				int resdirfd, bool sync)
+{
+	bool ret = runner_kmemleak_wait();
+
+	/* Nothing ran yet, so there's nothing to overlap with */
+	if (!last_test)
+		return runner_kmemleak(NULL, resdirfd, true, sync) && ret;
+
+	background_scan.generation++;
+	background_scan.last_test = strdup(last_test);
+	background_scan.next_test = strdup(next_test);
+	background_scan.resdirfd = resdirfd;
+	background_scan.sync = sync;
+
+	if (pthread_create(&background_scan.thread, NULL,
+			   runner_kmemleak_thread, NULL)) {
+		runner_kmemleak_thread(NULL);
+		free(background_scan.last_test);
+		free(background_scan.next_test);
+		background_scan.last_test = background_scan.next_test = NULL;
+
+		return background_scan.result && ret;
+	}
+
+	background_scan.running = true;
+
+	return ret;
+}
@@ -10,6 +10,9 @@
 bool runner_kmemleak_init(const char *unit_test_kmemleak_file);
 bool runner_kmemleak(const char *last_test, int resdirfd,
 		     bool kmemleak_each, bool sync);
+bool runner_kmemleak_background(const char *last_test, const char *next_test,
+				int resdirfd, bool sync);
+bool runner_kmemleak_wait(void);
 
 #define KMEMLEAK_RESFILENAME "kmemleak.txt"
 
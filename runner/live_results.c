@@ -0,0 +1,138 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2025 Intel Corporation
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <json.h>
+
+#include "job_list.h"
+#include "live_results.h"
+#include "resultgen.h"
+
+/*
+ * Results are appended to LIVE_RESULTS_FILENAME as one JSON object per
+ * line, for example:
+ *
+ *   {"test":"igt@foo@bar","result":"pass","time":1.234,
+ *    "timestamp":1700000000.123,"dmesg-warnings":0,"resources":{...}}
+ *
+ * Every line is a single write() to a file opened with O_APPEND, so
+ * the parallel workers can share it. The same line, without the
+ * newline, is sent as a datagram to the optional socket. A listener
+ * that isn't there, or can't keep up, loses records but never stalls
+ * the run.
+ */
+static struct {
+	int fd;
+	int sockfd;
+	struct sockaddr_un addr;
+} live = { .fd = -1, .sockfd = -1 };
+
+/**
+ * live_results_open:
+ * @resdirfd: The results directory
+ * @socket_path: Unix datagram socket to also send the records to, or NULL
+ *
+ * Starts writing live results. Resuming a run keeps appending to the
+ * records already written.
+ *
+ * Returns: Whether the results file could be opened.
+ */
+bool live_results_open(int resdirfd, const char *socket_path)
+{
+	live.fd = openat(resdirfd, LIVE_RESULTS_FILENAME,
+			 O_CREAT | O_WRONLY | O_APPEND | O_CLOEXEC, 0666);
+	if (live.fd < 0)
+		return false;
+
+	if (socket_path && strlen(socket_path) < sizeof(live.addr.sun_path)) {
+		live.addr.sun_family = AF_UNIX;
+		strcpy(live.addr.sun_path, socket_path);
+		live.sockfd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	}
+
+	return true;
+}
+
+void live_results_close(void)
+{
+	if (live.fd >= 0)
+		close(live.fd);
+	if (live.sockfd >= 0)
+		close(live.sockfd);
+	live.fd = live.sockfd = -1;
+}
+
+bool live_results_enabled(void)
+{
+	return live.fd >= 0;
+}
+
+/**
+ * live_results_write:
+ * @result: The result to record
+ *
+ * Appends @result to the results file and sends it to the socket.
+ */
+void live_results_write(const struct live_result *result)
+{
+	struct json_object *obj;
+	char name[768];
+	struct timespec now;
+	const char *str;
+	char *line;
+	int len;
+
+	if (live.fd < 0)
+		return;
+
+	generate_piglit_name(result->binary, result->subtest, name, sizeof(name));
+	if (result->dynamic_subtest) {
+		char base[sizeof(name)];
+
+		strcpy(base, name);
+		generate_piglit_name_for_dynamic(base, result->dynamic_subtest,
+						 name, sizeof(name));
+	}
+
+	clock_gettime(CLOCK_REALTIME, &now);
+
+	obj = json_object_new_object();
+	json_object_object_add(obj, "test", json_object_new_string(name));
+	json_object_object_add(obj, "result",
+			       json_object_new_string(result->result));
+	if (result->time >= 0)
+		json_object_object_add(obj, "time",
+				       json_object_new_double(result->time));
+	json_object_object_add(obj, "timestamp",
+			       json_object_new_double(now.tv_sec + now.tv_nsec * 1e-9));
+	if (result->dmesg_warnings >= 0)
+		json_object_object_add(obj, "dmesg-warnings",
+				       json_object_new_int64(result->dmesg_warnings));
+	if (result->resources)
+		add_resource_usage(obj, result->resources);
+
+	str = json_object_to_json_string_ext(obj, JSON_C_TO_STRING_PLAIN);
+	len = asprintf(&line, "%s\n", str);
+	json_object_put(obj);
+	if (len < 0)
+		return;
+
+	write(live.fd, line, len);
+
+	if (live.sockfd >= 0)
+		sendto(live.sockfd, line, len - 1, MSG_DONTWAIT | MSG_NOSIGNAL,
+		       (struct sockaddr *)&live.addr, sizeof(live.addr));
+
+	free(line);
+}
@@ -0,0 +1,33 @@
+/* SPDX-License-Identifier: MIT
+ * Copyright © 2025 Intel Corporation
+ */
+
+#ifndef RUNNER_LIVE_RESULTS_H
+#define RUNNER_LIVE_RESULTS_H
+
+#include <stdbool.h>
+
+#include "resources.h"
+
+#define LIVE_RESULTS_FILENAME "results.ndjson"
+
+/*
+ * A result as soon as the executor knows it, before resultgen has
+ * looked at the logs. Unknown values are negative or NULL.
+ */
+struct live_result {
+	const char *binary;
+	const char *subtest;
+	const char *dynamic_subtest;
+	const char *result;
+	double time; /* seconds */
+	long dmesg_warnings;
+	const struct resource_usage *resources;
+};
+
+bool live_results_open(int resdirfd, const char *socket_path);
+void live_results_close(void);
+bool live_results_enabled(void);
+void live_results_write(const struct live_result *result);
+
+#endif /* RUNNER_LIVE_RESULTS_H */
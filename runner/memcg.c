@@ -0,0 +1,235 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2025 Intel Corporation
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "memcg.h"
+
+#define CGROUP_ROOT "/sys/fs/cgroup"
+#define MEMCG_RMDIR_TRIES 100
+
+/*
+ * Tests run in children of a cgroup created by the runner directly
+ * under the root cgroup. Cgroup v2 only lets a cgroup without
+ * processes of its own hand controllers down to its children, the
+ * root being the exception, and the cgroup the runner was started in
+ * usually has other processes, like the shell. The runner is root
+ * anyway.
+ *
+ * The test cgroups are named after the result directories, so the
+ * parallel workers forked from the runner share its cgroup.
+ */
+static struct {
+	int dirfd;
+	char name[32];
+} runner_memcg = { .dirfd = -1 };
+
+static bool write_string(int dirfd, const char *name, const char *value)
+{
+	ssize_t len = strlen(value);
+	bool ret;
+	int fd;
+
+	if ((fd = openat(dirfd, name, O_WRONLY | O_CLOEXEC)) < 0)
+		return false;
+
+	ret = write(fd, value, len) == len;
+	close(fd);
+
+	return ret;
+}
+
+static bool has_memory_controller(int dirfd, const char *name)
+{
+	char buf[256], *tok, *saveptr;
+	ssize_t s;
+	int fd;
+
+	if ((fd = openat(dirfd, name, O_RDONLY | O_CLOEXEC)) < 0)
+		return false;
+
+	s = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if (s <= 0)
+		return false;
+	buf[s] = '\0';
+
+	for (tok = strtok_r(buf, " \n", &saveptr); tok;
+	     tok = strtok_r(NULL, " \n", &saveptr))
+		if (!strcmp(tok, "memory"))
+			return true;
+
+	return false;
+}
+
+/**
+ * memcg_init:
+ *
+ * Creates the cgroup the test cgroups are created in, enabling the
+ * memory controller for them. Needs cgroup v2 mounted at
+ * /sys/fs/cgroup.
+ *
+ * Returns: Whether test cgroups can be created.
+ */
+bool memcg_init(void)
+{
+	int rootfd;
+
+	if (runner_memcg.dirfd >= 0)
+		return true;
+
+	if ((rootfd = open(CGROUP_ROOT, O_DIRECTORY | O_RDONLY | O_CLOEXEC)) < 0)
+		return false;
+
+	if (!has_memory_controller(rootfd, "cgroup.controllers"))
+		goto err;
+
+	if (!has_memory_controller(rootfd, "cgroup.subtree_control") &&
+	    !write_string(rootfd, "cgroup.subtree_control", "+memory"))
+		goto err;
+
+	snprintf(runner_memcg.name, sizeof(runner_memcg.name),
+		 "igt_runner.%d", getpid());
+	if (mkdirat(rootfd, runner_memcg.name, 0755) && errno != EEXIST)
+		goto err;
+
+	runner_memcg.dirfd = openat(rootfd, runner_memcg.name,
+				    O_DIRECTORY | O_RDONLY | O_CLOEXEC);
+	if (runner_memcg.dirfd < 0 ||
+	    !write_string(runner_memcg.dirfd, "cgroup.subtree_control", "+memory")) {
+		if (runner_memcg.dirfd >= 0)
+			close(runner_memcg.dirfd);
+		runner_memcg.dirfd = -1;
+		unlinkat(rootfd, runner_memcg.name, AT_REMOVEDIR);
+		goto err;
+	}
+
+	close(rootfd);
+	return true;
+
+err:
+	close(rootfd);
+	return false;
+}
+
+/**
+ * memcg_fini:
+ *
+ * Removes the cgroup created by memcg_init(), once all test cgroups
+ * are gone.
+ */
+void memcg_fini(void)
+{
+	char path[64];
+
+	if (runner_memcg.dirfd < 0)
+		return;
+
+	close(runner_memcg.dirfd);
+	runner_memcg.dirfd = -1;
+
+	snprintf(path, sizeof(path), CGROUP_ROOT "/%s", runner_memcg.name);
+	rmdir(path);
+}
+
+/**
+ * memcg_create:
+ * @cg: Test cgroup to initialize
+ * @name: Name of the cgroup, unique among the tests executing
+ * @budget: Memory budget of the test in bytes
+ *
+ * Creates a cgroup for one test execution. Beyond @budget the memory
+ * of the test is reclaimed and its allocations throttled, which shows
+ * in its memory pressure stall information. The OOM killer only steps
+ * in at 5/4 of @budget.
+ *
+ * Returns: Whether the cgroup was created.
+ */
+bool memcg_create(struct test_memcg *cg, const char *name, size_t budget)
+{
+	char value[32];
+
+	cg->dirfd = cg->procsfd = -1;
+	snprintf(cg->name, sizeof(cg->name), "%s", name);
+
+	if (!memcg_init())
+		return false;
+
+	if (mkdirat(runner_memcg.dirfd, cg->name, 0755) && errno != EEXIST)
+		return false;
+
+	cg->dirfd = openat(runner_memcg.dirfd, cg->name,
+			   O_DIRECTORY | O_RDONLY | O_CLOEXEC);
+	if (cg->dirfd < 0)
+		goto err;
+
+	snprintf(value, sizeof(value), "%zu", budget + budget / 4);
+	if (!write_string(cg->dirfd, "memory.max", value))
+		goto err;
+
+	snprintf(value, sizeof(value), "%zu", budget);
+	if (!write_string(cg->dirfd, "memory.high", value))
+		goto err;
+
+	/* Opened now, the forked test has to enter before exec */
+	cg->procsfd = openat(cg->dirfd, "cgroup.procs", O_WRONLY | O_CLOEXEC);
+	if (cg->procsfd < 0)
+		goto err;
+
+	return true;
+
+err:
+	memcg_destroy(cg);
+	return false;
+}
+
+/**
+ * memcg_enter:
+ * @cg: Test cgroup
+ *
+ * Moves the calling process into @cg, to be called by the forked test
+ * process before executing the test.
+ *
+ * Returns: Whether the process was moved.
+ */
+bool memcg_enter(struct test_memcg *cg)
+{
+	return cg->procsfd >= 0 && write(cg->procsfd, "0", 1) == 1;
+}
+
+/**
+ * memcg_destroy:
+ * @cg: Test cgroup
+ *
+ * Kills any process the test left behind and removes @cg.
+ */
+void memcg_destroy(struct test_memcg *cg)
+{
+	int i;
+
+	if (cg->procsfd >= 0)
+		close(cg->procsfd);
+	cg->procsfd = -1;
+
+	if (cg->dirfd < 0)
+		return;
+
+	/* Stray children of the test keep the cgroup busy */
+	write_string(cg->dirfd, "cgroup.kill", "1");
+	close(cg->dirfd);
+	cg->dirfd = -1;
+
+	for (i = 0; i < MEMCG_RMDIR_TRIES; i++) {
+		if (!unlinkat(runner_memcg.dirfd, cg->name, AT_REMOVEDIR) ||
+		    errno != EBUSY)
+			break;
+		usleep(10000);
+	}
+}
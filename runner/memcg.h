@@ -0,0 +1,28 @@
+/* SPDX-License-Identifier: MIT
+ * Copyright © 2025 Intel Corporation
+ */
+
+#ifndef RUNNER_MEMCG_H
+#define RUNNER_MEMCG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * A cgroup v2 child of the runner's cgroup, limiting the memory of
+ * one test execution.
+ */
+struct test_memcg {
+	int dirfd;
+	int procsfd;
+	char name[32];
+};
+
+bool memcg_init(void);
+void memcg_fini(void);
+
+bool memcg_create(struct test_memcg *cg, const char *name, size_t budget);
+bool memcg_enter(struct test_memcg *cg);
+void memcg_destroy(struct test_memcg *cg);
+
+#endif /* RUNNER_MEMCG_H */
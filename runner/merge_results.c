@@ -0,0 +1,19 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "resultgen.h"
+
+int main(int argc, char **argv)
+{
+	if (argc < 3) {
+		fprintf(stderr, "Usage: %s <output-path> <shard-results-path>...\n", argv[0]);
+		exit(1);
+	}
+
+	if (merge_results_paths(argv[1], &argv[2], argc - 2)) {
+		printf("Results merged\n");
+		exit(0);
+	}
+
+	exit(1);
+}
@@ -0,0 +1,686 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2025 Intel Corporation
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "i915_drm.h"
+#include "igt_perf.h"
+#include "resources.h"
+
+#define MAX_ENGINE_INSTANCES 8
+#define MAX_CARDS 8
+#define MAX_XE_GTS 4
+#define MAX_XE_ENGINES 64
+
+/*
+ * xe only counts the ticks an engine was active, and the ticks that
+ * passed in total, so the busy time is accumulated from the ratio
+ * each time the counters are read.
+ */
+struct xe_engine_counter {
+	int active_fd, total_fd;
+	uint64_t active, total, time;
+	uint64_t busy; /* ns */
+};
+
+/*
+ * The engine busyness counters and the energy counters are system
+ * wide, they're opened once on first use and kept for the lifetime
+ * of the runner.
+ */
+static struct {
+	bool initialized;
+	int gpu_fds[(I915_ENGINE_CLASS_COMPUTE + 1) * MAX_ENGINE_INSTANCES];
+	int num_gpu_fds;
+	struct xe_engine_counter xe_engines[MAX_XE_ENGINES];
+	int num_xe_engines;
+	struct igt_power power;
+	bool have_power;
+	struct igt_power power_gpu;
+	bool have_power_gpu;
+	int card_fds[MAX_CARDS];
+	int num_card_fds;
+} counters;
+
+/*
+ * The runner doesn't open the DRM devices, so the hwmon energy of
+ * the Intel cards is found by walking sysfs. Only discrete cards
+ * register one, its first energy counter covers the whole card.
+ */
+static void open_card_energy(void)
+{
+	struct dirent *card;
+	DIR *dir;
+
+	if ((dir = opendir("/sys/class/drm")) == NULL)
+		return;
+
+	while ((card = readdir(dir)) && counters.num_card_fds < MAX_CARDS) {
+		struct dirent *hwmon;
+		char path[PATH_MAX];
+		DIR *hwmondir;
+
+		if (strncmp(card->d_name, "card", 4) ||
+		    strchr(card->d_name, '-'))
+			continue;
+
+		snprintf(path, sizeof(path), "/sys/class/drm/%s/device/hwmon",
+			 card->d_name);
+		if ((hwmondir = opendir(path)) == NULL)
+			continue;
+
+		while ((hwmon = readdir(hwmondir))) {
+			char name[16] = {};
+			int fd;
+
+			if (hwmon->d_name[0] == '.')
+				continue;
+
+			snprintf(path, sizeof(path),
+				 "/sys/class/drm/%s/device/hwmon/%s/name",
+				 card->d_name, hwmon->d_name);
+			if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0)
+				continue;
+			read(fd, name, sizeof(name) - 1);
+			close(fd);
+
+			if (strcmp(name, "i915\n") && strcmp(name, "xe\n"))
+				continue;
+
+			snprintf(path, sizeof(path),
+				 "/sys/class/drm/%s/device/hwmon/%s/energy1_input",
+				 card->d_name, hwmon->d_name);
+			if ((fd = open(path, O_RDONLY | O_CLOEXEC)) >= 0)
+				counters.card_fds[counters.num_card_fds++] = fd;
+			break;
+		}
+
+		closedir(hwmondir);
+	}
+
+	closedir(dir);
+}
+
+static void read_xe_counter(int fd, uint64_t *value, uint64_t *time)
+{
+	uint64_t data[2]; /* value, time enabled */
+
+	if (read(fd, data, sizeof(data)) == sizeof(data)) {
+		*value = data[0];
+		if (time)
+			*time = data[1];
+	}
+}
+
+static void open_xe_engine(uint64_t type, uint64_t active, uint64_t total)
+{
+	struct xe_engine_counter *c;
+
+	if (counters.num_xe_engines == MAX_XE_ENGINES)
+		return;
+
+	c = &counters.xe_engines[counters.num_xe_engines];
+
+	/* Opening the events of engines that don't exist fails */
+	c->active_fd = igt_perf_open(type, active);
+	if (c->active_fd < 0)
+		return;
+
+	c->total_fd = igt_perf_open(type, total);
+	if (c->total_fd < 0) {
+		close(c->active_fd);
+		return;
+	}
+
+	read_xe_counter(c->active_fd, &c->active, NULL);
+	read_xe_counter(c->total_fd, &c->total, &c->time);
+	counters.num_xe_engines++;
+}
+
+static void open_xe_engines(const char *device)
+{
+	uint32_t gt_shift, class_shift, instance_shift;
+	uint64_t type, active, total, param;
+	int gt, class, instance;
+
+	type = igt_perf_type_id(device);
+	if (!type ||
+	    perf_event_config(device, "engine-active-ticks", &active) ||
+	    perf_event_config(device, "engine-total-ticks", &total) ||
+	    perf_event_format(device, "gt", &gt_shift) ||
+	    perf_event_format(device, "engine_class", &class_shift) ||
+	    perf_event_format(device, "engine_instance", &instance_shift))
+		return;
+
+	for (gt = 0; gt < MAX_XE_GTS; gt++) {
+		for (class = 0; class <= I915_ENGINE_CLASS_COMPUTE; class++) {
+			for (instance = 0; instance < MAX_ENGINE_INSTANCES; instance++) {
+				param = (uint64_t)gt << gt_shift |
+					(uint64_t)class << class_shift |
+					(uint64_t)instance << instance_shift;
+				open_xe_engine(type, active | param,
+					       total | param);
+			}
+		}
+	}
+}
+
+/* There's one xe PMU per device, named after its PCI address */
+static void open_xe_counters(void)
+{
+	struct dirent *device;
+	DIR *dir;
+
+	if ((dir = opendir("/sys/bus/event_source/devices")) == NULL)
+		return;
+
+	while ((device = readdir(dir)))
+		if (!strncmp(device->d_name, "xe_", 3))
+			open_xe_engines(device->d_name);
+
+	closedir(dir);
+}
+
+static void open_counters(void)
+{
+	int class, instance;
+
+	if (counters.initialized)
+		return;
+
+	counters.initialized = true;
+
+	for (class = 0; class <= I915_ENGINE_CLASS_COMPUTE; class++) {
+		for (instance = 0; instance < MAX_ENGINE_INSTANCES; instance++) {
+			int fd = perf_igfx_open(I915_PMU_ENGINE_BUSY(class, instance));
+
+			if (fd >= 0)
+				counters.gpu_fds[counters.num_gpu_fds++] = fd;
+		}
+	}
+	open_xe_counters();
+
+	counters.have_power = igt_power_open(-1, &counters.power, "pkg") == 0;
+	counters.have_power_gpu = igt_power_open(-1, &counters.power_gpu, "gpu") == 0;
+	open_card_energy();
+}
+
+static uint64_t read_card_energy(void)
+{
+	uint64_t total = 0;
+	int i;
+
+	for (i = 0; i < counters.num_card_fds; i++) {
+		char buf[32];
+		ssize_t s;
+
+		s = pread(counters.card_fds[i], buf, sizeof(buf) - 1, 0);
+		if (s <= 0)
+			continue;
+		buf[s] = '\0';
+
+		total += strtoull(buf, NULL, 10);
+	}
+
+	return total;
+}
+
+static uint64_t read_gpu_busy(void)
+{
+	uint64_t total = 0;
+	int i;
+
+	for (i = 0; i < counters.num_gpu_fds; i++) {
+		uint64_t data[2]; /* value, time enabled */
+
+		if (read(counters.gpu_fds[i], data, sizeof(data)) == sizeof(data))
+			total += data[0];
+	}
+
+	for (i = 0; i < counters.num_xe_engines; i++) {
+		struct xe_engine_counter *c = &counters.xe_engines[i];
+		uint64_t active = c->active, ticks = c->total, time = c->time;
+
+		read_xe_counter(c->active_fd, &active, NULL);
+		read_xe_counter(c->total_fd, &ticks, &time);
+
+		if (ticks > c->total && active >= c->active)
+			c->busy += (double)(active - c->active) /
+				(ticks - c->total) * (time - c->time);
+
+		c->active = active;
+		c->total = ticks;
+		c->time = time;
+		total += c->busy;
+	}
+
+	return total;
+}
+
+static bool read_proc_cpu(pid_t pid, double *user, double *sys)
+{
+	char path[64], buf[1024];
+	unsigned long utime, stime;
+	char *p;
+	ssize_t s;
+	int fd;
+
+	snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+	if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0)
+		return false;
+
+	s = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if (s <= 0)
+		return false;
+	buf[s] = '\0';
+
+	/* The command name can contain anything, parse after it */
+	if ((p = strrchr(buf, ')')) == NULL)
+		return false;
+
+	/* Fields 14 and 15, counting from the state at field 3 */
+	if (sscanf(p + 1, " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",
+		   &utime, &stime) != 2)
+		return false;
+
+	*user = (double)utime / sysconf(_SC_CLK_TCK);
+	*sys = (double)stime / sysconf(_SC_CLK_TCK);
+
+	return true;
+}
+
+static long read_proc_hwm(pid_t pid)
+{
+	char path[64];
+	char *line = NULL;
+	size_t linelen = 0;
+	long hwm = -1;
+	FILE *f;
+
+	snprintf(path, sizeof(path), "/proc/%d/status", pid);
+	if ((f = fopen(path, "re")) == NULL)
+		return -1;
+
+	while (getline(&line, &linelen, f) > 0) {
+		if (sscanf(line, "VmHWM: %ld kB", &hwm) == 1)
+			break;
+	}
+
+	free(line);
+	fclose(f);
+
+	return hwm;
+}
+
+static void reset_proc_hwm(pid_t pid)
+{
+	char path[64];
+	int fd;
+
+	/* Writing 5 resets the peak resident set size */
+	snprintf(path, sizeof(path), "/proc/%d/clear_refs", pid);
+	if ((fd = open(path, O_WRONLY | O_CLOEXEC)) < 0)
+		return;
+
+	write(fd, "5", 1);
+	close(fd);
+}
+
+/*
+ * Pressure stall information of the test's memory cgroup, or of the
+ * whole system when the test doesn't run in one.
+ */
+static bool read_mem_stall(int memcgfd, uint64_t *some, uint64_t *full)
+{
+	char buf[256];
+	ssize_t s;
+	int fd;
+
+	if (memcgfd >= 0)
+		fd = openat(memcgfd, "memory.pressure", O_RDONLY | O_CLOEXEC);
+	else
+		fd = open("/proc/pressure/memory", O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+
+	s = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if (s <= 0)
+		return false;
+	buf[s] = '\0';
+
+	return sscanf(buf,
+		      "some avg10=%*f avg60=%*f avg300=%*f total=%" SCNu64
+		      " full avg10=%*f avg60=%*f avg300=%*f total=%" SCNu64,
+		      some, full) == 2;
+}
+
+static void take_sample(struct resource_tracker *tracker,
+			struct resource_sample *sample)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	sample->time = ts.tv_sec * 1000000000ull + ts.tv_nsec;
+
+	if (!read_proc_cpu(tracker->pid, &sample->cpu_user, &sample->cpu_sys))
+		sample->cpu_user = sample->cpu_sys = -1.0;
+
+	sample->gpu_busy = read_gpu_busy();
+
+	if (counters.have_power)
+		igt_power_get_energy(&counters.power, &sample->energy);
+	if (counters.have_power_gpu)
+		igt_power_get_energy(&counters.power_gpu, &sample->energy_gpu);
+	sample->energy_card = read_card_energy();
+
+	sample->have_mem_stall = read_mem_stall(tracker->memcgfd,
+						&sample->mem_stall_some,
+						&sample->mem_stall_full);
+
+	sample->dmesg_bytes = tracker->dmesg_bytes;
+}
+
+static void usage_since(const struct resource_sample *start,
+			const struct resource_sample *end,
+			struct resource_usage *usage)
+{
+	if (start->cpu_user >= 0 && end->cpu_user >= 0) {
+		usage->cpu_user = end->cpu_user - start->cpu_user;
+		usage->cpu_sys = end->cpu_sys - start->cpu_sys;
+	} else {
+		usage->cpu_user = usage->cpu_sys = -1.0;
+	}
+
+	usage->gpu_busy = -1.0;
+	if (counters.num_gpu_fds || counters.num_xe_engines)
+		usage->gpu_busy = (end->gpu_busy - start->gpu_busy) * 1e-9;
+
+	usage->energy = -1.0;
+	if (counters.have_power)
+		usage->energy = igt_power_get_mJ(&counters.power,
+						 &start->energy,
+						 &end->energy) * 1e-3;
+
+	usage->energy_gpu = -1.0;
+	if (counters.have_power_gpu)
+		usage->energy_gpu = igt_power_get_mJ(&counters.power_gpu,
+						     &start->energy_gpu,
+						     &end->energy_gpu) * 1e-3;
+
+	usage->energy_card = -1.0;
+	if (counters.num_card_fds)
+		usage->energy_card = (end->energy_card - start->energy_card) * 1e-6;
+
+	usage->wall = (end->time - start->time) * 1e-9;
+
+	usage->mem_stall_some = usage->mem_stall_full = -1.0;
+	if (start->have_mem_stall && end->have_mem_stall) {
+		usage->mem_stall_some = (end->mem_stall_some - start->mem_stall_some) * 1e-6;
+		usage->mem_stall_full = (end->mem_stall_full - start->mem_stall_full) * 1e-6;
+	}
+
+	usage->dmesg_bytes = end->dmesg_bytes - start->dmesg_bytes;
+}
+
+static void write_usage_line(struct resource_tracker *tracker,
+			     const char *prefix,
+			     const struct resource_usage *usage)
+{
+	char buf[512];
+	int len;
+
+	if (tracker->fd < 0)
+		return;
+
+	len = snprintf(buf, sizeof(buf), "%s ", prefix);
+	len += format_resource_usage(buf + len, sizeof(buf) - len, usage);
+	if (len >= sizeof(buf) - 1)
+		len = sizeof(buf) - 2;
+	buf[len++] = '\n';
+
+	write(tracker->fd, buf, len);
+}
+
+/**
+ * resources_begin:
+ * @tracker: Tracker to initialize
+ * @pid: The test process
+ * @fd: Where to write the results, usually RESOURCES_FILENAME in the
+ * test's result directory
+ * @memcgfd: The memory cgroup the test runs in, or -1
+ *
+ * Starts accounting the resources used by the test execution @pid.
+ * The memory stall time is the one of @memcgfd, or of the whole system
+ * without it.
+ */
+void resources_begin(struct resource_tracker *tracker, pid_t pid, int fd,
+		     int memcgfd)
+{
+	open_counters();
+
+	memset(tracker, 0, sizeof(*tracker));
+	tracker->pid = pid;
+	tracker->fd = fd;
+	tracker->memcgfd = memcgfd;
+
+	take_sample(tracker, &tracker->exec_start);
+	/* The CPU time of the whole execution comes from rusage at the end */
+	tracker->exec_start.cpu_user = tracker->exec_start.cpu_sys = 0.0;
+}
+
+/**
+ * resources_subtest_start:
+ * @tracker: Resource tracker
+ * @name: Name of the subtest starting
+ *
+ * Marks the beginning of a subtest. A subtest still open gets its
+ * usage written first.
+ */
+void resources_subtest_start(struct resource_tracker *tracker, const char *name)
+{
+	if (tracker->subtest[0])
+		resources_subtest_end(tracker);
+
+	snprintf(tracker->subtest, sizeof(tracker->subtest), "%s", name);
+	tracker->subtest[strcspn(tracker->subtest, " \n")] = '\0';
+	if (!tracker->subtest[0])
+		return;
+
+	reset_proc_hwm(tracker->pid);
+	take_sample(tracker, &tracker->subtest_start);
+}
+
+/**
+ * resources_subtest_end:
+ * @tracker: Resource tracker
+ *
+ * Writes the usage of the currently running subtest, if any.
+ */
+void resources_subtest_end(struct resource_tracker *tracker)
+{
+	struct resource_sample now;
+	struct resource_usage usage;
+	char prefix[sizeof(tracker->subtest) + 8];
+
+	if (!tracker->subtest[0])
+		return;
+
+	take_sample(tracker, &now);
+	usage_since(&tracker->subtest_start, &now, &usage);
+	usage.max_rss = read_proc_hwm(tracker->pid);
+
+	snprintf(prefix, sizeof(prefix), "subtest %s", tracker->subtest);
+	write_usage_line(tracker, prefix, &usage);
+	tracker->subtest_usage = usage;
+
+	tracker->subtest[0] = '\0';
+}
+
+/**
+ * resources_add_dmesg:
+ * @tracker: Resource tracker
+ * @bytes: Amount of kernel log written
+ *
+ * Accounts kernel log output to the test and the running subtest.
+ */
+void resources_add_dmesg(struct resource_tracker *tracker, long bytes)
+{
+	if (bytes > 0)
+		tracker->dmesg_bytes += bytes;
+}
+
+/**
+ * resources_end:
+ * @tracker: Resource tracker
+ * @rusage: Resource usage of the reaped test process
+ *
+ * Finishes accounting the test execution, closing any subtest left
+ * open by a crash. The CPU time and peak memory usage come from
+ * @rusage, covering also the children the test waited for.
+ */
+void resources_end(struct resource_tracker *tracker, const struct rusage *rusage)
+{
+	struct resource_sample now;
+	struct resource_usage usage;
+
+	resources_subtest_end(tracker);
+
+	take_sample(tracker, &now);
+	usage_since(&tracker->exec_start, &now, &usage);
+	usage.cpu_user = rusage->ru_utime.tv_sec + rusage->ru_utime.tv_usec * 1e-6;
+	usage.cpu_sys = rusage->ru_stime.tv_sec + rusage->ru_stime.tv_usec * 1e-6;
+	usage.max_rss = rusage->ru_maxrss;
+
+	write_usage_line(tracker, "exec", &usage);
+}
+
+/**
+ * format_resource_usage:
+ * @buf: Output buffer
+ * @size: Size of @buf
+ * @usage: Usage to format
+ *
+ * Formats @usage as space separated key=value pairs, leaving out
+ * values that weren't measured.
+ *
+ * Returns: The length of the formatted string, as with snprintf().
+ */
+int format_resource_usage(char *buf, size_t size, const struct resource_usage *usage)
+{
+	int len = 0;
+
+#define APPEND(fmt, ...) len += snprintf(buf + len, size > len ? size - len : 0, \
+					 "%s" fmt, len ? " " : "", __VA_ARGS__)
+	if (usage->cpu_user >= 0)
+		APPEND("cpu-user=%.3f cpu-sys=%.3f", usage->cpu_user, usage->cpu_sys);
+	if (usage->max_rss >= 0)
+		APPEND("max-rss=%ld", usage->max_rss);
+	if (usage->gpu_busy >= 0)
+		APPEND("gpu-busy=%.6f", usage->gpu_busy);
+	if (usage->energy >= 0)
+		APPEND("energy=%.3f", usage->energy);
+	if (usage->energy_gpu >= 0)
+		APPEND("energy-gpu=%.3f", usage->energy_gpu);
+	if (usage->energy_card >= 0)
+		APPEND("energy-card=%.3f", usage->energy_card);
+	if (usage->wall >= 0)
+		APPEND("wall=%.6f", usage->wall);
+	if (usage->mem_stall_some >= 0)
+		APPEND("mem-stall-some=%.6f mem-stall-full=%.6f",
+		       usage->mem_stall_some, usage->mem_stall_full);
+	if (usage->dmesg_bytes >= 0)
+		APPEND("dmesg-bytes=%ld", usage->dmesg_bytes);
+#undef APPEND
+
+	return len;
+}
+
+/**
+ * parse_resources_line:
+ * @line: A line from RESOURCES_FILENAME
+ * @name: Output for the subtest name, or NULL for the whole execution
+ * @usage: Output for the parsed usage
+ *
+ * Returns: Whether @line could be parsed. On success @name needs to
+ * be freed by the caller.
+ */
+bool parse_resources_line(const char *line, char **name, struct resource_usage *usage)
+{
+	const char *p;
+
+	usage->cpu_user = usage->cpu_sys = -1.0;
+	usage->max_rss = -1;
+	usage->gpu_busy = usage->energy = -1.0;
+	usage->energy_gpu = usage->energy_card = usage->wall = -1.0;
+	usage->mem_stall_some = usage->mem_stall_full = -1.0;
+	usage->dmesg_bytes = -1;
+	*name = NULL;
+
+	if (!strncmp(line, "exec", 4) && (line[4] == ' ' || line[4] == '\n' || !line[4])) {
+		p = line + 4;
+	} else if (!strncmp(line, "subtest ", 8)) {
+		size_t namelen = strcspn(line + 8, " \n");
+
+		if (!namelen)
+			return false;
+
+		*name = strndup(line + 8, namelen);
+		p = line + 8 + namelen;
+	} else {
+		return false;
+	}
+
+	while (*p == ' ')
+		p++;
+
+	while (*p && *p != '\n') {
+		const char *eq = strchr(p, '=');
+		size_t keylen;
+
+		if (!eq)
+			break;
+		keylen = eq - p;
+
+		if (keylen == 8 && !strncmp(p, "cpu-user", keylen))
+			usage->cpu_user = strtod(eq + 1, NULL);
+		else if (keylen == 7 && !strncmp(p, "cpu-sys", keylen))
+			usage->cpu_sys = strtod(eq + 1, NULL);
+		else if (keylen == 7 && !strncmp(p, "max-rss", keylen))
+			usage->max_rss = strtol(eq + 1, NULL, 10);
+		else if (keylen == 8 && !strncmp(p, "gpu-busy", keylen))
+			usage->gpu_busy = strtod(eq + 1, NULL);
+		else if (keylen == 6 && !strncmp(p, "energy", keylen))
+			usage->energy = strtod(eq + 1, NULL);
+		else if (keylen == 10 && !strncmp(p, "energy-gpu", keylen))
+			usage->energy_gpu = strtod(eq + 1, NULL);
+		else if (keylen == 11 && !strncmp(p, "energy-card", keylen))
+			usage->energy_card = strtod(eq + 1, NULL);
+		else if (keylen == 4 && !strncmp(p, "wall", keylen))
+			usage->wall = strtod(eq + 1, NULL);
+		else if (keylen == 14 && !strncmp(p, "mem-stall-some", keylen))
+			usage->mem_stall_some = strtod(eq + 1, NULL);
+		else if (keylen == 14 && !strncmp(p, "mem-stall-full", keylen))
+			usage->mem_stall_full = strtod(eq + 1, NULL);
+		else if (keylen == 11 && !strncmp(p, "dmesg-bytes", keylen))
+			usage->dmesg_bytes = strtol(eq + 1, NULL, 10);
+
+		p = eq + strcspn(eq, " \n");
+		while (*p == ' ')
+			p++;
+	}
+
+	return true;
+}
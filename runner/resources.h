@@ -0,0 +1,70 @@
+/* SPDX-License-Identifier: MIT
+ * Copyright © 2025 Intel Corporation
+ */
+
+#ifndef RUNNER_RESOURCES_H
+#define RUNNER_RESOURCES_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/resource.h>
+#include <sys/types.h>
+
+#include "igt_power.h"
+
+#define RESOURCES_FILENAME "resources.txt"
+
+/*
+ * Resources used by a subtest, or by a whole test execution. Values
+ * that couldn't be measured on this machine are negative.
+ */
+struct resource_usage {
+	double cpu_user; /* seconds */
+	double cpu_sys; /* seconds */
+	long max_rss; /* kB */
+	double gpu_busy; /* seconds, summed over all engines */
+	double energy; /* joules, RAPL package domain */
+	double energy_gpu; /* joules, RAPL graphics domain */
+	double energy_card; /* joules, hwmon of the discrete cards */
+	double wall; /* seconds the energy was measured over */
+	double mem_stall_some; /* seconds some tasks stalled on memory */
+	double mem_stall_full; /* seconds all tasks stalled on memory */
+	long dmesg_bytes;
+};
+
+struct resource_sample {
+	double cpu_user, cpu_sys;
+	uint64_t gpu_busy;
+	struct power_sample energy;
+	struct power_sample energy_gpu;
+	uint64_t energy_card; /* uJ */
+	uint64_t time; /* ns */
+	bool have_mem_stall;
+	uint64_t mem_stall_some, mem_stall_full; /* us */
+	long dmesg_bytes;
+};
+
+struct resource_tracker {
+	pid_t pid;
+	int fd;
+	int memcgfd;
+	long dmesg_bytes;
+	struct resource_sample exec_start;
+	struct resource_sample subtest_start;
+	char subtest[256];
+	/* Usage of the subtest that ended last */
+	struct resource_usage subtest_usage;
+};
+
+void resources_begin(struct resource_tracker *tracker, pid_t pid, int fd,
+		     int memcgfd);
+void resources_subtest_start(struct resource_tracker *tracker, const char *name);
+void resources_subtest_end(struct resource_tracker *tracker);
+void resources_add_dmesg(struct resource_tracker *tracker, long bytes);
+void resources_end(struct resource_tracker *tracker, const struct rusage *rusage);
+
+int format_resource_usage(char *buf, size_t size, const struct resource_usage *usage);
+bool parse_resources_line(const char *line, char **name, struct resource_usage *usage);
+
+#endif /* RUNNER_RESOURCES_H */
@@ -2,6 +2,7 @@
 #include <ctype.h>
 #include <fcntl.h>
 #include <inttypes.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <string.h>
 #include <sys/mman.h>
@@ -14,6 +15,7 @@
 #include "igt_aux.h"
 #include "igt_core.h"
 #include "runnercomms.h"
+#include "resources.h"
 #include "resultgen.h"
 #include "settings.h"
 #include "executor.h"
@@ -208,6 +210,17 @@ static void parse_result_string(const char *resultstring, size_t len, const char
 	}
 }
 
+/* Maps a result as the tests print it to the result reported */
+const char *result_from_output_string(const char *resultstring)
+{
+	const char *result;
+	double time;
+
+	parse_result_string(resultstring, strlen(resultstring), &result, &time);
+
+	return result;
+}
+
 static void parse_subtest_result(const char *subtest,
 				 const char *resulttextprefix,
 				 const char **result,
@@ -316,6 +329,91 @@ static void set_runtime(struct json_object *obj, double time)
 			       json_object_new_double(time));
 }
 
+static void add_resource(struct json_object *resobj, const char *key, double value)
+{
+	struct json_object *old;
+	bool peak = !strcmp(key, "max-rss");
+	bool integer = peak || !strcmp(key, "dmesg-bytes");
+
+	/* Average power is derived, see update_power() */
+	if (value < 0 || !strncmp(key, "power", 5))
+		return;
+
+	/* Peak memory usage is the largest seen, the rest add up */
+	if (json_object_object_get_ex(resobj, key, &old)) {
+		double oldvalue = json_object_get_double(old);
+
+		if (peak)
+			value = max(value, oldvalue);
+		else
+			value += oldvalue;
+	}
+
+	json_object_object_add(resobj, key,
+			       integer ? json_object_new_int(value) :
+			       json_object_new_double(value));
+}
+
+/*
+ * The energy adds up over subtests and merged executions, the average
+ * power of the total is recomputed from it and the time it covers.
+ */
+static void update_power(struct json_object *resobj)
+{
+	static const char * const keys[][2] = {
+		{ "energy", "power" },
+		{ "energy-gpu", "power-gpu" },
+		{ "energy-card", "power-card" },
+	};
+	struct json_object *wall, *energy;
+	double seconds;
+	int i;
+
+	if (!json_object_object_get_ex(resobj, "wall", &wall))
+		return;
+
+	seconds = json_object_get_double(wall);
+	if (seconds <= 0)
+		return;
+
+	for (i = 0; i < ARRAY_SIZE(keys); i++) {
+		if (!json_object_object_get_ex(resobj, keys[i][0], &energy))
+			continue;
+
+		json_object_object_add(resobj, keys[i][1],
+				       json_object_new_double(json_object_get_double(energy) /
+							      seconds));
+	}
+}
+
+void add_resource_usage(struct json_object *obj,
+			const struct resource_usage *usage)
+{
+	struct json_object *resobj = get_or_create_json_object(obj, "resources");
+
+	add_resource(resobj, "cpu-user", usage->cpu_user);
+	add_resource(resobj, "cpu-sys", usage->cpu_sys);
+	add_resource(resobj, "max-rss", usage->max_rss);
+	add_resource(resobj, "gpu-busy", usage->gpu_busy);
+	add_resource(resobj, "energy", usage->energy);
+	add_resource(resobj, "energy-gpu", usage->energy_gpu);
+	add_resource(resobj, "energy-card", usage->energy_card);
+	add_resource(resobj, "wall", usage->wall);
+	add_resource(resobj, "mem-stall-some", usage->mem_stall_some);
+	add_resource(resobj, "mem-stall-full", usage->mem_stall_full);
+	add_resource(resobj, "dmesg-bytes", usage->dmesg_bytes);
+	update_power(resobj);
+}
+
+static void merge_resources(struct json_object *obj, struct json_object *src)
+{
+	struct json_object *resobj = get_or_create_json_object(obj, "resources");
+
+	json_object_object_foreach(src, key, value)
+		add_resource(resobj, key, json_object_get_double(value));
+	update_power(resobj);
+}
+
 struct match_item
 {
 	const char *where;
@@ -829,11 +927,214 @@ static const char igt_dmesg_whitelist[] =
 static const char igt_piglit_style_dmesg_blacklist[] =
 	"(\\[drm:|drm_|intel_|i915_|\\[drm\\])";
 
-static bool init_dmesg_regex(GRegex **re, const char *regex, const char *msg)
+/*
+ * A dmesg regex along with what makes matching it cheaper on long logs:
+ * the literals the regex requires, one of which has to be in a line for
+ * it to match, and the results for the messages seen already, as the
+ * same messages tend to repeat.
+ */
+struct dmesg_regex {
+	GRegex *re;
+	char **literals;
+	GHashTable *seen;
+};
+
+#define DMESG_REGEX_SEEN_MAX 16384
+
+static void free_literals(char **literals)
+{
+	if (!literals)
+		return;
+
+	for (char **l = literals; *l; l++)
+		free(*l);
+	free(literals);
+}
+
+/* Length of the bracket expression starting at @p */
+static size_t bracket_len(const char *p)
+{
+	const char *q = p + 1;
+
+	if (*q == '^')
+		q++;
+	if (*q == ']')
+		q++;
+	while (*q && *q != ']') {
+		if (*q == '\\' && q[1])
+			q++;
+		q++;
+	}
+
+	return *q ? q - p + 1 : q - p;
+}
+
+/* Length of the group or bracket expression starting at @p */
+static size_t group_len(const char *p)
+{
+	const char *q = p;
+	int depth = 0;
+
+	if (*p == '[')
+		return bracket_len(p);
+
+	while (*q) {
+		if (*q == '\\' && q[1]) {
+			q += 2;
+		} else if (*q == '[') {
+			q += bracket_len(q);
+		} else {
+			if (*q == '(')
+				depth++;
+			else if (*q == ')' && --depth == 0)
+				return q - p + 1;
+			q++;
+		}
+	}
+
+	return q - p;
+}
+
+/*
+ * Finds the longest literal of a top level alternative of a regex,
+ * [@p, @end), that any match has to contain.
+ */
+static char *alternative_literal(const char *p, const char *end)
+{
+	char run[256], best[256] = "";
+	size_t len = 0;
+
+	for (; p <= end; p++) {
+		char c = 0;
+
+		if (p < end) {
+			if (*p == '\\' && p + 1 < end && ispunct(p[1]))
+				c = *++p;
+			else if (*p == '\\' && p + 1 < end)
+				p++;
+			else if (*p == '[' || *p == '(')
+				p += group_len(p) - 1;
+			else if (*p == '{' && strchr(p, '}'))
+				p = strchr(p, '}');
+			else if (!strchr("\\.^$+?*{}()[]|", *p))
+				c = *p;
+
+			/* Optional, ends the run without being part of it */
+			if (c && p + 1 < end && strchr("?*{", p[1]))
+				c = 0;
+		}
+
+		if (c && len < sizeof(run) - 1) {
+			run[len++] = c;
+			continue;
+		}
+
+		run[len] = '\0';
+		if (len > strlen(best))
+			strcpy(best, run);
+		len = 0;
+	}
+
+	return strlen(best) >= 2 ? strdup(best) : NULL;
+}
+
+/*
+ * Collects a required literal per top level alternative of @regex, or
+ * returns NULL if some alternative has none, in which case all lines go
+ * to the regex.
+ */
+static char **required_literals(const char *regex)
+{
+	const char *p = regex, *end = regex + strlen(regex), *alt;
+	char **literals = NULL;
+	size_t count = 0;
+
+	/*
+	 * Leave the options, like case insensitivity, and the escapes which
+	 * stand for characters, like \x41, to the regex.
+	 */
+	if (strstr(regex, "(?"))
+		return NULL;
+	for (const char *e = strchr(regex, '\\'); e && e[1]; e = strchr(e + 2, '\\'))
+		if (isalnum(e[1]) && !strchr("dDsSwWbB", e[1]))
+			return NULL;
+
+	/* A single group around everything doesn't change the alternatives */
+	if (*p == '(' && strncmp(p, "(?", 2) && group_len(p) == end - p) {
+		p++;
+		end--;
+	}
+
+	for (alt = p; p <= end; p++) {
+		char *literal;
+
+		if (p < end && *p != '|') {
+			if (*p == '\\' && p + 1 < end)
+				p++;
+			else if (*p == '[' || *p == '(')
+				p += group_len(p) - 1;
+			continue;
+		}
+
+		literal = alternative_literal(alt, p);
+		if (!literal) {
+			literals = realloc(literals, (count + 1) * sizeof(*literals));
+			literals[count] = NULL;
+			free_literals(literals);
+			return NULL;
+		}
+
+		literals = realloc(literals, (count + 2) * sizeof(*literals));
+		literals[count++] = literal;
+		literals[count] = NULL;
+		alt = p + 1;
+	}
+
+	return literals;
+}
+
+/* Whether @msg contains one of @literals, always true without literals */
+static bool literals_match(char **literals, const char *msg)
+{
+	size_t len = strlen(msg);
+
+	if (!literals)
+		return true;
+
+	for (char **l = literals; *l; l++)
+		if (memmem(msg, len, *l, strlen(*l)))
+			return true;
+
+	return false;
+}
+
+/**
+ * dmesg_regex_prefilter:
+ * @regex: dmesg regex
+ * @msg: kernel message
+ *
+ * For testing the literals taken from @regex.
+ *
+ * Returns: false if @msg is rejected without running @regex, which has
+ * to mean @regex doesn't match @msg.
+ */
+bool dmesg_regex_prefilter(const char *regex, const char *msg)
+{
+	char **literals = required_literals(regex);
+	bool ret = literals_match(literals, msg);
+
+	free_literals(literals);
+
+	return ret;
+}
+
+static bool init_dmesg_regex(struct dmesg_regex *re, const char *regex, const char *msg)
 {
 	GError *err = NULL;
 
-	*re = g_regex_new(regex, G_REGEX_OPTIMIZE, 0, &err);
+	memset(re, 0, sizeof(*re));
+
+	re->re = g_regex_new(regex, G_REGEX_OPTIMIZE, 0, &err);
 	if (err) {
 		fprintf(stderr, "Cannot compile %s : %s\n",
 			msg, err->message);
@@ -842,10 +1143,34 @@ static bool init_dmesg_regex(GRegex **re, const char *regex, const char *msg)
 		return false;
 	}
 
+	re->literals = required_literals(regex);
+	re->seen = g_hash_table_new_full(g_str_hash, g_str_equal, free, NULL);
+
 	return true;
 }
 
-static bool init_regex_whitelist(struct settings *settings, GRegex **re)
+static bool dmesg_regex_match(struct dmesg_regex *re, const char *msg)
+{
+	gpointer seen;
+	bool match;
+
+	if (!literals_match(re->literals, msg))
+		return false;
+
+	seen = g_hash_table_lookup(re->seen, msg);
+	if (seen)
+		return GPOINTER_TO_INT(seen) == 2;
+
+	match = g_regex_match(re->re, msg, 0, NULL);
+
+	if (g_hash_table_size(re->seen) >= DMESG_REGEX_SEEN_MAX)
+		g_hash_table_remove_all(re->seen);
+	g_hash_table_insert(re->seen, strdup(msg), GINT_TO_POINTER(match ? 2 : 1));
+
+	return match;
+}
+
+static bool init_regex_whitelist(struct settings *settings, struct dmesg_regex *re)
 {
 	const char *regex = settings->piglit_style_dmesg ?
 		igt_piglit_style_dmesg_blacklist :
@@ -857,23 +1182,26 @@ static bool init_regex_whitelist(struct settings *settings, GRegex **re)
 	return init_dmesg_regex(re, regex, what);
 }
 
-static bool not_ignored(GRegex *re, const char *msg)
+static bool not_ignored(struct dmesg_regex *re, const char *msg)
 {
-	if (!re)
+	if (!re->re)
 		return true;
 
-	return !g_regex_match(re, msg, 0, NULL);
+	return !dmesg_regex_match(re, msg);
 }
 
-static void clean_regex(GRegex **re)
+static void clean_regex(struct dmesg_regex *re)
 {
-	if (*re)
-		g_regex_unref(*re);
+	if (re->re)
+		g_regex_unref(re->re);
+	if (re->seen)
+		g_hash_table_destroy(re->seen);
+	free_literals(re->literals);
 
-	*re = NULL;
+	memset(re, 0, sizeof(*re));
 }
 
-static void add_ignored_regex(GRegex **re, char *src)
+static void add_ignored_regex(struct dmesg_regex *re, char *src)
 {
 	char *s;
 
@@ -881,10 +1209,10 @@ static void add_ignored_regex(GRegex **re, char *src)
 	if (s)
 		*s = 0;
 
-	if (*re)
-		g_regex_unref(*re);
+	clean_regex(re);
 
-	init_dmesg_regex(re, src, "ignore match");
+	if (!init_dmesg_regex(re, src, "ignore match"))
+		clean_regex(re);
 	fprintf(stderr, "igt_resultgen: Added ignore regex '%s'\n", src);
 }
 
@@ -1020,8 +1348,8 @@ static bool fill_from_dmesg(int fd,
 	char piglit_name[256];
 	char dynamic_piglit_name[256];
 	size_t i;
-	GRegex *re;
-	GRegex *re_ignore; /* regex for dynamically ignored dmesg line */
+	struct dmesg_regex re;
+	struct dmesg_regex re_ignore = {}; /* regex for dynamically ignored dmesg line */
 
 	if (!f) {
 		return false;
@@ -1032,7 +1360,6 @@ static bool fill_from_dmesg(int fd,
 		return false;
 	}
 
-	re_ignore = NULL;
 	while (getline(&line, &linelen, f) > 0) {
 		char *formatted;
 		unsigned flags;
@@ -1094,16 +1421,16 @@ static bool fill_from_dmesg(int fd,
 
 		if (settings->piglit_style_dmesg) {
 			if ((flags & 0x07) <= settings->dmesg_warn_level && continuation != 'c' &&
-			    g_regex_match(re, message, 0, NULL) &&
-			    not_ignored(re_ignore, message)) {
+			    dmesg_regex_match(&re, message) &&
+			    not_ignored(&re_ignore, message)) {
 				append_line(&warnings, &warningslen, formatted);
 				if (current_test != NULL)
 					append_line(&dynamic_warnings, &dynamic_warnings_len, formatted);
 			}
 		} else {
 			if ((flags & 0x07) <= settings->dmesg_warn_level && continuation != 'c' &&
-			    !g_regex_match(re, message, 0, NULL) &&
-			    not_ignored(re_ignore, message)) {
+			    !dmesg_regex_match(&re, message) &&
+			    not_ignored(&re_ignore, message)) {
 				append_line(&warnings, &warningslen, formatted);
 				if (current_test != NULL)
 					append_line(&dynamic_warnings, &dynamic_warnings_len, formatted);
@@ -1151,12 +1478,12 @@ static bool fill_from_dmesg(int fd,
 	free(warnings);
 	free(dynamic_warnings);
 	clean_regex(&re_ignore);
-	g_regex_unref(re);
+	clean_regex(&re);
 	fclose(f);
 	return true;
 }
 
-static const char *result_from_exitcode(int exitcode)
+const char *result_from_exitcode(int exitcode)
 {
 	switch (exitcode) {
 	case IGT_EXIT_SKIP:
@@ -2169,6 +2496,49 @@ static void add_to_totals(const char *binary,
 	}
 }
 
+static void fill_from_resources(int dirfd, const char *binary,
+				struct results *results)
+{
+	char piglit_name[256];
+	char *line = NULL;
+	size_t linelen = 0;
+	int fd;
+	FILE *f;
+
+	if ((fd = openat(dirfd, RESOURCES_FILENAME, O_RDONLY)) < 0)
+		return;
+
+	if ((f = fdopen(fd, "r")) == NULL) {
+		close(fd);
+		return;
+	}
+
+	while (getline(&line, &linelen, f) > 0) {
+		struct resource_usage usage;
+		struct json_object *obj;
+		char *subtest;
+
+		if (!parse_resources_line(line, &subtest, &usage))
+			continue;
+
+		generate_piglit_name(binary, subtest, piglit_name, sizeof(piglit_name));
+
+		/* Only attach to tests that ended up in the results */
+		if (json_object_object_get_ex(results->tests, piglit_name, &obj))
+			add_resource_usage(obj, &usage);
+
+		/* The whole execution is accounted with the binary's runtime */
+		if (!subtest)
+			add_resource_usage(get_or_create_json_object(results->runtimes, piglit_name),
+					   &usage);
+
+		free(subtest);
+	}
+
+	free(line);
+	fclose(f);
+}
+
 static bool parse_test_directory(int dirfd,
 				 struct job_list_entry *entry,
 				 struct settings *settings,
@@ -2243,6 +2613,7 @@ static bool parse_test_directory(int dirfd,
 
 	override_results(entry->binary, &subtests, results->tests);
 	prune_subtests(settings, entry, &subtests, results->tests);
+	fill_from_resources(dirfd, entry->binary, results);
 
 	add_to_totals(entry->binary, &subtests, results);
 
@@ -2301,34 +2672,19 @@ static void create_result_root_nodes(struct json_object *root,
 	json_object_object_add(root, "runtimes", results->runtimes);
 }
 
-struct json_object *generate_results_json(int dirfd)
+static struct json_object *create_results_header(int dirfd,
+						 struct settings *settings)
 {
-	struct settings settings;
-	struct job_list job_list;
 	struct json_object *obj, *elapsed, *arr;
-	struct results results;
-	int testdirfd, fd;
+	int fd;
 	size_t i;
 
-	init_settings(&settings);
-	init_job_list(&job_list);
-
-	if (!read_settings_from_dir(&settings, dirfd)) {
-		fprintf(stderr, "resultgen: Cannot parse settings\n");
-		return NULL;
-	}
-
-	if (!read_job_list(&job_list, dirfd)) {
-		fprintf(stderr, "resultgen: Cannot parse job list\n");
-		return NULL;
-	}
-
 	obj = json_object_new_object();
 	json_object_object_add(obj, "__type__", json_object_new_string("TestrunResult"));
 	json_object_object_add(obj, "results_version", json_object_new_int(10));
 	json_object_object_add(obj, "name",
-			       settings.name ?
-			       json_object_new_string(settings.name) :
+			       settings->name ?
+			       json_object_new_string(settings->name) :
 			       json_object_new_string(""));
 
 	if ((fd = openat(dirfd, "uname.txt", O_RDONLY)) >= 0) {
@@ -2344,8 +2700,8 @@ struct json_object *generate_results_json(int dirfd)
 	}
 
 	arr = json_object_new_array();
-	for (i = 0; i < settings.cmdline.argc; i++)
-		json_object_array_add(arr, json_object_new_string(settings.cmdline.argv[i]));
+	for (i = 0; i < settings->cmdline.argc; i++)
+		json_object_array_add(arr, json_object_new_string(settings->cmdline.argv[i]));
 	json_object_object_add(obj, "cmdline", arr);
 
 	elapsed = json_object_new_object();
@@ -2364,8 +2720,6 @@ struct json_object *generate_results_json(int dirfd)
 	}
 	json_object_object_add(obj, "time_elapsed", elapsed);
 
-	create_result_root_nodes(obj, &results);
-
 	/*
 	 * Result fields that won't be added:
 	 *
@@ -2379,70 +2733,118 @@ struct json_object *generate_results_json(int dirfd)
 	 * - options
 	 */
 
-	for (i = 0; i < job_list.size; i++) {
-		char name[16];
+	return obj;
+}
 
-		snprintf(name, 16, "%zd", i);
-		fprintf(stderr, "results: parsing output: %s/ for test: %s\n",
-			name, job_list.entries[i].binary);
-		if ((testdirfd = openat(dirfd, name, O_DIRECTORY | O_RDONLY)) < 0) {
-			if (settings.log_level >= LOG_LEVEL_NORMAL)
-				fprintf(stderr, "results: no output, setting notrun\n");
+static void parse_job_list_entry(int dirfd, size_t i,
+				 struct job_list_entry *entry,
+				 struct settings *settings,
+				 struct results *results)
+{
+	char name[16];
+	int testdirfd;
 
-			try_add_notrun_results(&job_list.entries[i], &settings, &results);
-			continue;
-		}
+	snprintf(name, 16, "%zd", i);
+	fprintf(stderr, "results: parsing output: %s/ for test: %s\n",
+		name, entry->binary);
+	if ((testdirfd = openat(dirfd, name, O_DIRECTORY | O_RDONLY)) < 0) {
+		if (settings->log_level >= LOG_LEVEL_NORMAL)
+			fprintf(stderr, "results: no output, setting notrun\n");
 
-		if (!parse_test_directory(testdirfd, &job_list.entries[i], &settings, &results)) {
-			if (settings.log_level >= LOG_LEVEL_NORMAL)
-				fprintf(stderr, "results: no useful output, setting notrun\n");
+		try_add_notrun_results(entry, settings, results);
+		return;
+	}
 
-			try_add_notrun_results(&job_list.entries[i], &settings, &results);
-		}
-		close(testdirfd);
+	if (!parse_test_directory(testdirfd, entry, settings, results)) {
+		if (settings->log_level >= LOG_LEVEL_NORMAL)
+			fprintf(stderr, "results: no useful output, setting notrun\n");
+
+		try_add_notrun_results(entry, settings, results);
 	}
+	close(testdirfd);
+}
+
+static void add_aborted_result(int dirfd, struct results *results)
+{
+	char buf[4096];
+	char piglit_name[] = "igt@runner@aborted";
+	struct subtest_list abortsub = {};
+	struct json_object *aborttest;
+	ssize_t s;
+	int fd;
+
+	if ((fd = openat(dirfd, "aborted.txt", O_RDONLY)) < 0)
+		return;
 
-	if ((fd = openat(dirfd, "aborted.txt", O_RDONLY)) >= 0) {
-		char buf[4096];
-		char piglit_name[] = "igt@runner@aborted";
-		struct subtest_list abortsub = {};
-		struct json_object *aborttest = get_or_create_json_object(results.tests, piglit_name);
-		ssize_t s;
+	aborttest = get_or_create_json_object(results->tests, piglit_name);
+	add_subtest(&abortsub, strdup("aborted"));
 
-		add_subtest(&abortsub, strdup("aborted"));
+	s = read(fd, buf, sizeof(buf));
 
-		s = read(fd, buf, sizeof(buf));
+	json_object_object_add(aborttest, "out",
+			       new_escaped_json_string(buf, s));
+	json_object_object_add(aborttest, "err",
+			       json_object_new_string(""));
+	json_object_object_add(aborttest, "dmesg",
+			       json_object_new_string(""));
+	json_object_object_add(aborttest, "result",
+			       json_object_new_string("fail"));
+
+	add_to_totals("runner", &abortsub, results);
 
-		json_object_object_add(aborttest, "out",
-				       new_escaped_json_string(buf, s));
-		json_object_object_add(aborttest, "err",
-				       json_object_new_string(""));
-		json_object_object_add(aborttest, "dmesg",
-				       json_object_new_string(""));
-		json_object_object_add(aborttest, "result",
-				       json_object_new_string("fail"));
+	free_subtests(&abortsub);
+	close(fd);
+}
 
-		add_to_totals("runner", &abortsub, &results);
+static bool read_results_inputs(int dirfd, struct settings *settings,
+				struct job_list *job_list)
+{
+	init_settings(settings);
+	init_job_list(job_list);
 
-		free_subtests(&abortsub);
-		close(fd);
+	if (!read_settings_from_dir(settings, dirfd)) {
+		fprintf(stderr, "resultgen: Cannot parse settings\n");
+		return false;
+	}
+
+	if (!read_job_list(job_list, dirfd)) {
+		fprintf(stderr, "resultgen: Cannot parse job list\n");
+		return false;
 	}
 
+	return true;
+}
+
+struct json_object *generate_results_json(int dirfd)
+{
+	struct settings settings;
+	struct job_list job_list;
+	struct json_object *obj;
+	struct results results;
+	size_t i;
+
+	if (!read_results_inputs(dirfd, &settings, &job_list))
+		return NULL;
+
+	obj = create_results_header(dirfd, &settings);
+	create_result_root_nodes(obj, &results);
+
+	for (i = 0; i < job_list.size; i++)
+		parse_job_list_entry(dirfd, i, &job_list.entries[i], &settings, &results);
+
+	add_aborted_result(dirfd, &results);
+
 	clear_settings(&settings);
 	free_job_list(&job_list);
 
 	return obj;
 }
 
-bool generate_results(int dirfd)
+static bool write_results_json(int dirfd, struct json_object *obj)
 {
-	struct json_object *obj = generate_results_json(dirfd);
 	const char *json_string;
 	int resultsfd;
 
-	if (obj == NULL)
-		return false;
-
 	/* TODO: settings.overwrite */
 	if ((resultsfd = openat(dirfd, "results.json", O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0) {
 		fprintf(stderr, "resultgen: Cannot create results file\n");
@@ -2468,6 +2870,16 @@ bool generate_results(int dirfd)
 	return true;
 }
 
+bool generate_results(int dirfd)
+{
+	struct json_object *obj = generate_results_json(dirfd);
+
+	if (obj == NULL)
+		return false;
+
+	return write_results_json(dirfd, obj);
+}
+
 bool generate_results_path(char *resultspath)
 {
 	int dirfd = open(resultspath, O_DIRECTORY | O_RDONLY);
@@ -2477,3 +2889,477 @@ bool generate_results_path(char *resultspath)
 
 	return generate_results(dirfd);
 }
+
+static const char *test_result(struct json_object *test)
+{
+	struct json_object *obj;
+
+	if (!json_object_object_get_ex(test, "result", &obj))
+		return NULL;
+
+	return json_object_get_string(obj);
+}
+
+static void merge_tests(struct json_object *dst, struct json_object *src)
+{
+	json_object_object_foreach(src, name, test) {
+		struct json_object *old, *oldout, *out;
+		const char *result;
+		char *merged;
+
+		if (!json_object_object_get_ex(dst, name, &old)) {
+			json_object_object_add(dst, name, json_object_get(test));
+			continue;
+		}
+
+		result = test_result(old);
+		if (result && !strcmp(result, "notrun")) {
+			json_object_object_add(dst, name, json_object_get(test));
+			continue;
+		}
+
+		result = test_result(test);
+		if (result && !strcmp(result, "notrun"))
+			continue;
+
+		/* Every shard that aborted has its own reason */
+		if (!strcmp(name, "igt@runner@aborted") &&
+		    json_object_object_get_ex(old, "out", &oldout) &&
+		    json_object_object_get_ex(test, "out", &out)) {
+			if (asprintf(&merged, "%s\n%s",
+				     json_object_get_string(oldout),
+				     json_object_get_string(out)) < 0)
+				continue;
+
+			json_object_object_add(old, "out", json_object_new_string(merged));
+			free(merged);
+			continue;
+		}
+
+		fprintf(stderr, "merge: Warning: %s has results in more than one shard, keeping the first\n",
+			name);
+	}
+}
+
+static void merge_totals(struct json_object *dst, struct json_object *src)
+{
+	json_object_object_foreach(src, key, srctotal) {
+		struct json_object *dsttotal = get_totals_object(dst, key);
+
+		json_object_object_foreach(srctotal, result, count) {
+			struct json_object *numobj;
+			int old = 0;
+
+			if (json_object_object_get_ex(dsttotal, result, &numobj))
+				old = json_object_get_int(numobj);
+
+			json_object_object_add(dsttotal, result,
+					       json_object_new_int(old + json_object_get_int(count)));
+		}
+	}
+}
+
+static void merge_runtimes(struct json_object *dst, struct json_object *src)
+{
+	json_object_object_foreach(src, name, srcobj) {
+		struct json_object *timeobj, *end, *resobj;
+
+		if (json_object_object_get_ex(srcobj, "resources", &resobj))
+			merge_resources(get_or_create_json_object(dst, name), resobj);
+
+		if (!json_object_object_get_ex(srcobj, "time", &timeobj) ||
+		    !json_object_object_get_ex(timeobj, "end", &end))
+			continue;
+
+		add_runtime(get_or_create_json_object(dst, name),
+			    json_object_get_double(end));
+	}
+}
+
+static void merge_time_elapsed(struct json_object *dst, struct json_object *src)
+{
+	struct json_object *srctime, *dsttime;
+
+	if (!json_object_object_get_ex(src, "start", &srctime))
+		return;
+
+	if (!json_object_object_get_ex(dst, "start", &dsttime) ||
+	    json_object_get_double(srctime) < json_object_get_double(dsttime))
+		json_object_object_add(dst, "start",
+				       json_object_new_double(json_object_get_double(srctime)));
+
+	if (!json_object_object_get_ex(src, "end", &srctime))
+		return;
+
+	if (!json_object_object_get_ex(dst, "end", &dsttime) ||
+	    json_object_get_double(srctime) > json_object_get_double(dsttime))
+		json_object_object_add(dst, "end",
+				       json_object_new_double(json_object_get_double(srctime)));
+}
+
+/**
+ * merge_results_json:
+ * @results: results of the individual shards
+ * @count: number of elements in @results
+ *
+ * Combines the results of a run that was split with --shard. Tests
+ * and runtimes are united, totals are summed, and the elapsed time
+ * spans from the earliest start to the latest end. The name, uname
+ * and command line are taken from the first shard.
+ *
+ * Returns: the combined results, which the caller owns.
+ */
+struct json_object *merge_results_json(struct json_object **results, size_t count)
+{
+	struct json_object *obj, *elapsed, *field;
+	struct results merged;
+	static const char * const copied[] = { "name", "uname", "cmdline", NULL };
+	size_t i, k;
+
+	obj = json_object_new_object();
+	json_object_object_add(obj, "__type__", json_object_new_string("TestrunResult"));
+	json_object_object_add(obj, "results_version", json_object_new_int(10));
+
+	for (k = 0; count && copied[k]; k++)
+		if (json_object_object_get_ex(results[0], copied[k], &field))
+			json_object_object_add(obj, copied[k], json_object_get(field));
+
+	elapsed = json_object_new_object();
+	json_object_object_add(elapsed, "__type__", json_object_new_string("TimeAttribute"));
+	json_object_object_add(obj, "time_elapsed", elapsed);
+
+	create_result_root_nodes(obj, &merged);
+
+	for (i = 0; i < count; i++) {
+		if (json_object_object_get_ex(results[i], "time_elapsed", &field))
+			merge_time_elapsed(elapsed, field);
+		if (json_object_object_get_ex(results[i], "tests", &field))
+			merge_tests(merged.tests, field);
+		if (json_object_object_get_ex(results[i], "totals", &field))
+			merge_totals(merged.totals, field);
+		if (json_object_object_get_ex(results[i], "runtimes", &field))
+			merge_runtimes(merged.runtimes, field);
+	}
+
+	return obj;
+}
+
+/**
+ * merge_results_paths:
+ * @output_path: directory to write the combined results.json to
+ * @results_paths: results directories of the shards
+ * @count: number of elements in @results_paths
+ *
+ * Generates the results of each shard from its results directory and
+ * writes their combination, see merge_results_json(), to
+ * @output_path/results.json. The output directory is created if it
+ * doesn't exist.
+ *
+ * Returns: Whether merging succeeded.
+ */
+bool merge_results_paths(const char *output_path, char **results_paths, size_t count)
+{
+	struct json_object **results, *merged;
+	bool ret = false;
+	size_t i, generated;
+	int dirfd;
+
+	results = calloc(count, sizeof(*results));
+	for (generated = 0; generated < count; generated++) {
+		dirfd = open(results_paths[generated], O_DIRECTORY | O_RDONLY);
+		if (dirfd < 0) {
+			fprintf(stderr, "merge: Cannot open %s\n", results_paths[generated]);
+			goto out;
+		}
+
+		results[generated] = generate_results_json(dirfd);
+		close(dirfd);
+		if (!results[generated]) {
+			fprintf(stderr, "merge: Cannot generate results for %s\n",
+				results_paths[generated]);
+			goto out;
+		}
+	}
+
+	mkdir(output_path, 0777);
+	dirfd = open(output_path, O_DIRECTORY | O_RDONLY);
+	if (dirfd < 0) {
+		fprintf(stderr, "merge: Cannot open output directory %s\n", output_path);
+		goto out;
+	}
+
+	merged = merge_results_json(results, count);
+	ret = write_results_json(dirfd, merged);
+	json_object_put(merged);
+	close(dirfd);
+
+out:
+	for (i = 0; i < generated; i++)
+		json_object_put(results[i]);
+	free(results);
+
+	return ret;
+}
+
+struct stream_slot {
+	char **names;
+	char **tests;
+	size_t count;
+	struct json_object *totals;
+	struct json_object *runtimes;
+	bool done;
+};
+
+struct stream_state {
+	int dirfd;
+	struct settings *settings;
+	struct job_list *job_list;
+
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct stream_slot *slots;
+	size_t next_entry;
+	size_t next_write;
+	size_t window;
+};
+
+/*
+ * Serializes the members of the "tests" object one by one, so that
+ * the tests of all job list entries can be written into one object,
+ * and keeps the (small) totals and runtimes for merging.
+ */
+static void fill_stream_slot(struct stream_slot *slot, struct results *results)
+{
+	struct json_object *tests = results->tests;
+	size_t i = 0;
+
+	slot->totals = json_object_get(results->totals);
+	slot->runtimes = json_object_get(results->runtimes);
+	slot->count = json_object_object_length(tests);
+	slot->names = calloc(slot->count, sizeof(*slot->names));
+	slot->tests = calloc(slot->count, sizeof(*slot->tests));
+
+	json_object_object_foreach(tests, name, test) {
+		slot->names[i] = strdup(name);
+		slot->tests[i] = strdup(json_object_to_json_string_ext(test, JSON_C_TO_STRING_PRETTY));
+		i++;
+	}
+}
+
+static void write_stream_slot(FILE *f, struct stream_slot *slot,
+			      struct results *results,
+			      GHashTable *seen, bool *first)
+{
+	size_t i;
+
+	for (i = 0; i < slot->count; i++) {
+		struct json_object *key;
+
+		if (g_hash_table_contains(seen, slot->names[i])) {
+			fprintf(stderr, "resultgen: Warning: %s appears more than once, keeping the first\n",
+				slot->names[i]);
+			free(slot->names[i]);
+		} else {
+			key = json_object_new_string(slot->names[i]);
+			fprintf(f, "%s\n    %s:%s", *first ? "" : ",",
+				json_object_to_json_string_ext(key, JSON_C_TO_STRING_PLAIN),
+				slot->tests[i]);
+			json_object_put(key);
+			*first = false;
+
+			g_hash_table_add(seen, slot->names[i]);
+		}
+		free(slot->tests[i]);
+	}
+	free(slot->names);
+	free(slot->tests);
+
+	merge_totals(results->totals, slot->totals);
+	merge_runtimes(results->runtimes, slot->runtimes);
+	json_object_put(slot->totals);
+	json_object_put(slot->runtimes);
+}
+
+static void *stream_worker(void *data)
+{
+	struct stream_state *state = data;
+
+	pthread_mutex_lock(&state->lock);
+	for (;;) {
+		struct stream_slot *slot;
+		struct results results;
+		struct json_object *root;
+		size_t i;
+
+		/* Don't run too far ahead of the writer */
+		while (state->next_entry < state->job_list->size &&
+		       state->next_entry >= state->next_write + state->window)
+			pthread_cond_wait(&state->cond, &state->lock);
+
+		if (state->next_entry >= state->job_list->size)
+			break;
+
+		i = state->next_entry++;
+		slot = &state->slots[i];
+		pthread_mutex_unlock(&state->lock);
+
+		root = json_object_new_object();
+		create_result_root_nodes(root, &results);
+		parse_job_list_entry(state->dirfd, i, &state->job_list->entries[i],
+				     state->settings, &results);
+
+		fill_stream_slot(slot, &results);
+		json_object_put(root);
+
+		pthread_mutex_lock(&state->lock);
+		slot->done = true;
+		pthread_cond_broadcast(&state->cond);
+	}
+	pthread_mutex_unlock(&state->lock);
+
+	return NULL;
+}
+
+/**
+ * stream_results_json:
+ * @dirfd: results directory
+ * @outfd: file descriptor to write the results to
+ * @jobs: number of threads parsing test output, or 0 for one per CPU
+ *
+ * Generates the same results as generate_results_json(), but without
+ * building the whole result tree in memory. The output directories of
+ * the job list entries are parsed in parallel, and the tests of each
+ * entry are written to @outfd as soon as all earlier entries are
+ * written, so the output doesn't depend on @jobs. Only the totals and
+ * runtimes are kept until the end. Peak memory is bounded by the few
+ * largest entries in flight instead of the whole run.
+ *
+ * @outfd is closed.
+ *
+ * Returns: Whether results generation succeeded.
+ */
+bool stream_results_json(int dirfd, int outfd, int jobs)
+{
+	struct settings settings;
+	struct job_list job_list;
+	struct stream_state state = {};
+	struct stream_slot aborted = {};
+	struct json_object *header, *root, *abortroot;
+	struct results results, abortresults;
+	pthread_t *threads;
+	GHashTable *seen;
+	const char *header_string;
+	bool first = true, ret;
+	size_t i, header_len;
+	int t;
+	FILE *f;
+
+	if (!read_results_inputs(dirfd, &settings, &job_list)) {
+		close(outfd);
+		return false;
+	}
+
+	if ((f = fdopen(outfd, "w")) == NULL) {
+		close(outfd);
+		clear_settings(&settings);
+		free_job_list(&job_list);
+		return false;
+	}
+
+	if (jobs <= 0)
+		jobs = max_t(long, sysconf(_SC_NPROCESSORS_ONLN), 1);
+
+	/* The header fields, without the closing brace of the object */
+	header = create_results_header(dirfd, &settings);
+	header_string = json_object_to_json_string_ext(header, JSON_C_TO_STRING_PRETTY);
+	header_len = strrchr(header_string, '}') - header_string;
+	while (header_len && isspace(header_string[header_len - 1]))
+		header_len--;
+	fprintf(f, "%.*s,\n  \"tests\":{", (int)header_len, header_string);
+	json_object_put(header);
+
+	root = json_object_new_object();
+	create_result_root_nodes(root, &results);
+	seen = g_hash_table_new_full(g_str_hash, g_str_equal, free, NULL);
+
+	state.dirfd = dirfd;
+	state.settings = &settings;
+	state.job_list = &job_list;
+	state.window = 2 * jobs;
+	state.slots = calloc(job_list.size, sizeof(*state.slots));
+	pthread_mutex_init(&state.lock, NULL);
+	pthread_cond_init(&state.cond, NULL);
+
+	threads = calloc(jobs, sizeof(*threads));
+	for (t = 0; t < jobs; t++)
+		igt_assert(pthread_create(&threads[t], NULL, stream_worker, &state) == 0);
+
+	for (i = 0; i < job_list.size; i++) {
+		pthread_mutex_lock(&state.lock);
+		while (!state.slots[i].done)
+			pthread_cond_wait(&state.cond, &state.lock);
+		pthread_mutex_unlock(&state.lock);
+
+		write_stream_slot(f, &state.slots[i], &results, seen, &first);
+
+		pthread_mutex_lock(&state.lock);
+		state.next_write = i + 1;
+		pthread_cond_broadcast(&state.cond);
+		pthread_mutex_unlock(&state.lock);
+	}
+
+	for (t = 0; t < jobs; t++)
+		pthread_join(threads[t], NULL);
+	free(threads);
+
+	abortroot = json_object_new_object();
+	create_result_root_nodes(abortroot, &abortresults);
+	add_aborted_result(dirfd, &abortresults);
+	fill_stream_slot(&aborted, &abortresults);
+	json_object_put(abortroot);
+	write_stream_slot(f, &aborted, &results, seen, &first);
+
+	fprintf(f, "\n  },\n  \"totals\":%s",
+		json_object_to_json_string_ext(results.totals, JSON_C_TO_STRING_PRETTY));
+	fprintf(f, ",\n  \"runtimes\":%s\n}",
+		json_object_to_json_string_ext(results.runtimes, JSON_C_TO_STRING_PRETTY));
+
+	ret = !ferror(f);
+	if (fclose(f))
+		ret = false;
+	if (!ret)
+		fprintf(stderr, "resultgen: Writing the results file failed\n");
+
+	pthread_cond_destroy(&state.cond);
+	pthread_mutex_destroy(&state.lock);
+	free(state.slots);
+	g_hash_table_destroy(seen);
+	json_object_put(root);
+	clear_settings(&settings);
+	free_job_list(&job_list);
+
+	return ret;
+}
+
+/**
+ * generate_results_streaming:
+ * @dirfd: results directory
+ * @jobs: number of threads parsing test output, or 0 for one per CPU
+ *
+ * Like generate_results(), but uses stream_results_json() to keep
+ * memory use bounded on large runs.
+ *
+ * Returns: Whether results generation succeeded.
+ */
+bool generate_results_streaming(int dirfd, int jobs)
+{
+	int resultsfd;
+
+	/* TODO: settings.overwrite */
+	if ((resultsfd = openat(dirfd, "results.json", O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0) {
+		fprintf(stderr, "resultgen: Cannot create results file\n");
+		return false;
+	}
+
+	return stream_results_json(dirfd, resultsfd, jobs);
+}
@@ -2,10 +2,26 @@
 #define RUNNER_RESULTGEN_H
 
 #include <stdbool.h>
+#include <stddef.h>
+
+struct json_object;
+struct resource_usage;
 
 bool generate_results(int dirfd);
 bool generate_results_path(char *resultspath);
+bool generate_results_streaming(int dirfd, int jobs);
 
 struct json_object *generate_results_json(int dirfd);
+bool stream_results_json(int dirfd, int outfd, int jobs);
+
+struct json_object *merge_results_json(struct json_object **results, size_t count);
+bool merge_results_paths(const char *output_path, char **results_paths, size_t count);
+
+const char *result_from_exitcode(int exitcode);
+const char *result_from_output_string(const char *resultstring);
+void add_resource_usage(struct json_object *obj,
+			const struct resource_usage *usage);
+
+bool dmesg_regex_prefilter(const char *regex, const char *msg);
 
 #endif
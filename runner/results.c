@@ -1,4 +1,5 @@
 #include <fcntl.h>
+#include <getopt.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/stat.h>
@@ -6,18 +7,52 @@
 
 #include "resultgen.h"
 
+static void usage(const char *binary)
+{
+	fprintf(stderr,
+		"Usage: %s [options] results-path\n\n"
+		"Options:\n"
+		"  -j, --jobs <n>   Parse test outputs with <n> threads and write\n"
+		"                   results.json incrementally, keeping memory use\n"
+		"                   bounded. 0 uses one thread per CPU.\n",
+		binary);
+}
+
 int main(int argc, char **argv)
 {
-	int dirfd;
+	static const struct option long_options[] = {
+		{"jobs", required_argument, NULL, 'j'},
+		{ 0, 0, 0, 0},
+	};
+	int dirfd, c, jobs = -1;
+	bool ret;
 
-	if (argc < 2)
+	while ((c = getopt_long(argc, argv, "j:", long_options, NULL)) != -1) {
+		switch (c) {
+		case 'j':
+			jobs = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+			exit(1);
+		}
+	}
+
+	if (argc - optind != 1) {
+		usage(argv[0]);
 		exit(1);
+	}
 
-	dirfd = open(argv[1], O_DIRECTORY | O_RDONLY);
+	dirfd = open(argv[optind], O_DIRECTORY | O_RDONLY);
 	if (dirfd < 0)
 		exit(1);
 
-	if (generate_results(dirfd)) {
+	if (jobs >= 0)
+		ret = generate_results_streaming(dirfd, jobs);
+	else
+		ret = generate_results(dirfd);
+
+	if (ret) {
 		printf("Results generated\n");
 		exit(0);
 	}
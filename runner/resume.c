@@ -9,6 +9,7 @@
 #include "job_list.h"
 #include "executor.h"
 #include "resultgen.h"
+#include "runtime_db.h"
 
 int main(int argc, char **argv)
 {
@@ -55,6 +56,12 @@ int main(int argc, char **argv)
 		exitcode = 3;
 	}
 
+	if (settings.runtime_db &&
+	    !runtime_db_update_from_results(settings.runtime_db,
+					    settings.results_path))
+		fprintf(stderr, "Failed to update runtime database %s\n",
+			settings.runtime_db);
+
 	clear_settings(&settings);
 
 	printf("Done.\n");
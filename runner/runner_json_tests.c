@@ -147,6 +147,40 @@ static void run_results_and_compare(int dirfd, const char *dirname)
 	igt_assert_eq(json_object_put(referenceobj), 1);
 }
 
+static void stream_results_and_compare(int dirfd, const char *dirname, int jobs)
+{
+	int testdirfd = openat(dirfd, dirname, O_RDONLY | O_DIRECTORY);
+	int reference, streamed;
+	struct json_object *resultsobj, *referenceobj;
+	FILE *f = tmpfile();
+
+	igt_assert_fd(testdirfd);
+	igt_assert(f);
+
+	/* stream_results_json() closes the fd it's given */
+	streamed = dup(fileno(f));
+	igt_assert_fd(streamed);
+	igt_assert(stream_results_json(testdirfd, streamed, jobs));
+
+	rewind(f);
+	resultsobj = read_json(fileno(f));
+	fclose(f);
+	igt_assert(resultsobj != NULL);
+
+	reference = openat(testdirfd, "reference.json", O_RDONLY);
+	close(testdirfd);
+
+	igt_assert_fd(reference);
+	referenceobj = read_json(reference);
+	close(reference);
+	igt_assert(referenceobj != NULL);
+
+	igt_debug("Root object\n");
+	compare(resultsobj, referenceobj);
+	igt_assert_eq(json_object_put(resultsobj), 1);
+	igt_assert_eq(json_object_put(referenceobj), 1);
+}
+
 static const char *dirnames[] = {
 	"normal-run",
 	"warnings",
@@ -183,5 +217,10 @@ igt_main
 		igt_subtest(dirnames[i]) {
 			run_results_and_compare(dirfd, dirnames[i]);
 		}
+
+		igt_subtest_f("streamed-%s", dirnames[i]) {
+			stream_results_and_compare(dirfd, dirnames[i], 1);
+			stream_results_and_compare(dirfd, dirnames[i], 4);
+		}
 	}
 }
@@ -258,6 +258,19 @@ igt_main
 			igt_assert(runner_kmemleak("test_name_3", resdirfd,
 						   true, false));
 		}
+
+		igt_subtest("test_runner_kmemleak_background") {
+			igt_assert(runner_kmemleak_background(NULL, "test_name_1",
+							      resdirfd, false));
+			igt_assert(runner_kmemleak_background("test_name_1", "test_name_2",
+							      resdirfd, false));
+			igt_assert(runner_kmemleak_background("test_name_2", "test_name_3",
+							      resdirfd, true));
+			igt_assert(runner_kmemleak_wait());
+
+			/* Nothing left to wait for */
+			igt_assert(runner_kmemleak_wait());
+		}
 		igt_fixture {
 			close(resdirfd);
 		}
@@ -1,5 +1,6 @@
 #include <dirent.h>
 #include <fcntl.h>
+#include <math.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -12,7 +13,10 @@
 #include "settings.h"
 #include "job_list.h"
 #include "executor.h"
+#include "live_results.h"
 #include "resultgen.h"
+#include "resources.h"
+#include "runtime_db.h"
 
 /*
  * NOTE: this test is using a lot of variables that are changed in igt_fixture,
@@ -192,10 +196,22 @@ static void assert_settings_equal(struct settings *one, struct settings *two)
 	igt_assert_eq(one->allow_non_root, two->allow_non_root);
 	igt_assert_eq(one->facts, two->facts);
 	igt_assert_eq(one->kmemleak, two->kmemleak);
+	igt_assert_eq(one->kmemleak_each, two->kmemleak_each);
+	igt_assert_eq(one->kmemleak_background, two->kmemleak_background);
 	igt_assert_eq(one->sync, two->sync);
+	igt_assert_eq(one->sync_journal, two->sync_journal);
 	igt_assert_eq(one->log_level, two->log_level);
 	igt_assert_eq(one->overwrite, two->overwrite);
 	igt_assert_eq(one->multiple_mode, two->multiple_mode);
+	igt_assert_eq(one->fork_subtests, two->fork_subtests);
+	igt_assert_eq(one->comms_ring, two->comms_ring);
+	igt_assert_eq(one->compress_output, two->compress_output);
+	igt_assert_eq(one->collect_resources, two->collect_resources);
+	igt_assert_eq_u64(one->memory_budget, two->memory_budget);
+	igt_assert_eq(one->device_scan_cache, two->device_scan_cache);
+	igt_assert_eqstr(one->list_cache, two->list_cache);
+	igt_assert_eq(one->live_results, two->live_results);
+	igt_assert_eqstr(one->live_results_socket, two->live_results_socket);
 	igt_assert_eq(one->inactivity_timeout, two->inactivity_timeout);
 	igt_assert_eq(one->per_test_timeout, two->per_test_timeout);
 	igt_assert_eq(one->use_watchdog, two->use_watchdog);
@@ -205,6 +221,12 @@ static void assert_settings_equal(struct settings *one, struct settings *two)
 	igt_assert_eq(one->piglit_style_dmesg, two->piglit_style_dmesg);
 	igt_assert_eq(one->dmesg_warn_level, two->dmesg_warn_level);
 	igt_assert_eq(one->prune_mode, two->prune_mode);
+	igt_assert_eqstr(one->parallel_devices, two->parallel_devices);
+	igt_assert_eqstr(one->runtime_db, two->runtime_db);
+	igt_assert_eq(one->longest_first, two->longest_first);
+	igt_assert_eq(one->adaptive_timeout, two->adaptive_timeout);
+	igt_assert_eq(one->shard_index, two->shard_index);
+	igt_assert_eq(one->shard_count, two->shard_count);
 
 	igt_assert_eq(igt_vec_length(&one->hook_strs), igt_vec_length(&two->hook_strs));
 	for (size_t i = 0; i < igt_vec_length(&one->hook_strs); i++) {
@@ -227,6 +249,7 @@ static void assert_job_list_equal(struct job_list *one, struct job_list *two)
 
 		igt_assert_eqstr(eone->binary, etwo->binary);
 		igt_assert_eq(eone->subtest_count, etwo->subtest_count);
+		igt_assert_eq(eone->exclusive, etwo->exclusive);
 
 		for (k = 0; k < eone->subtest_count; k++) {
 			igt_assert_eqstr(eone->subtests[k], etwo->subtests[k]);
@@ -303,14 +326,31 @@ igt_main
 		igt_assert(!settings->dry_run);
 		igt_assert_eq(settings->include_regexes.size, 0);
 		igt_assert_eq(settings->exclude_regexes.size, 0);
+		igt_assert_eq(settings->exclusive_regexes.size, 0);
+		igt_assert(!settings->parallel_devices);
+		igt_assert(!settings->runtime_db);
+		igt_assert(!settings->longest_first);
+		igt_assert_eq(settings->adaptive_timeout, 0);
+		igt_assert_eq(settings->shard_count, 0);
 		igt_assert(igt_list_empty(&settings->env_vars));
 		igt_assert(!igt_vec_length(&settings->hook_strs));
 		igt_assert(!settings->facts);
 		igt_assert(!settings->kmemleak);
+		igt_assert(!settings->kmemleak_background);
 		igt_assert(!settings->sync);
+		igt_assert(!settings->sync_journal);
 		igt_assert_eq(settings->log_level, LOG_LEVEL_NORMAL);
 		igt_assert(!settings->overwrite);
 		igt_assert(!settings->multiple_mode);
+		igt_assert(!settings->fork_subtests);
+		igt_assert(!settings->comms_ring);
+		igt_assert(!settings->compress_output);
+		igt_assert(!settings->collect_resources);
+		igt_assert_eq_u64(settings->memory_budget, 0UL);
+		igt_assert(!settings->device_scan_cache);
+		igt_assert(!settings->list_cache);
+		igt_assert(!settings->live_results);
+		igt_assert(!settings->live_results_socket);
 		igt_assert_eq(settings->inactivity_timeout, 0);
 		igt_assert_eq(settings->per_test_timeout, 0);
 		igt_assert_eq(settings->overall_timeout, 0);
@@ -485,6 +525,19 @@ igt_main
 				       "--hook", "echo hello",
 				       "--hook", "echo world",
 				       "--prune-mode=keep-subtests",
+				       "--parallel-devices", "pci:vendor=8086,card=all",
+				       "--exclusive-tests", "epattern",
+				       "--runtime-db", "runtimes.db",
+				       "--longest-first",
+				       "--adaptive-timeout", "3",
+				       "--shard", "2/3",
+				       "--comms-ring",
+				       "--compress-output",
+				       "--collect-resources",
+				       "--memory-budget", "2G",
+				       "--device-scan-cache",
+				       "--list-cache", "listcache",
+				       "--live-results-socket", "live.sock",
 				       "test-root-dir",
 				       "path-to-results",
 		};
@@ -513,6 +566,15 @@ igt_main
 		igt_assert_eqstr(settings->exclude_regexes.regex_strings[2], "xpattern3"); /* From blacklist */
 		igt_assert_eqstr(settings->exclude_regexes.regex_strings[3], "xpattern4"); /* From blacklist2 */
 
+		igt_assert_eq(settings->exclusive_regexes.size, 1);
+		igt_assert_eqstr(settings->exclusive_regexes.regex_strings[0], "epattern");
+		igt_assert_eqstr(settings->parallel_devices, "pci:vendor=8086,card=all");
+		igt_assert(strstr(settings->runtime_db, "runtimes.db") != NULL);
+		igt_assert(settings->longest_first);
+		igt_assert_eq(settings->adaptive_timeout, 3);
+		igt_assert_eq(settings->shard_index, 2);
+		igt_assert_eq(settings->shard_count, 3);
+
 		igt_assert(!igt_list_empty(&settings->env_vars));
 
 		env_var = igt_list_first_entry(&settings->env_vars, env_var, link);
@@ -543,6 +605,14 @@ igt_main
 
 		igt_assert(settings->piglit_style_dmesg);
 		igt_assert_eq(settings->dmesg_warn_level, 3);
+		igt_assert(settings->comms_ring);
+		igt_assert(settings->compress_output);
+		igt_assert(settings->collect_resources);
+		igt_assert_eq_u64(settings->memory_budget, 2048UL * 1024UL * 1024UL);
+		igt_assert(settings->device_scan_cache);
+		igt_assert(strstr(settings->list_cache, "listcache") != NULL);
+		igt_assert(settings->live_results);
+		igt_assert(strstr(settings->live_results_socket, "live.sock") != NULL);
 	}
 	igt_subtest("parse-list-all") {
 		const char *argv[] = { "runner",
@@ -694,6 +764,24 @@ igt_main
 		igt_assert_eq_u64(settings->disk_usage_limit, 1024UL * 1024UL * 1024UL);
 	}
 
+	igt_subtest("memory-budget") {
+		const char *argv[] = { "runner",
+				       "--memory-budget=512M",
+				       "test-root-dir",
+				       "results-path",
+		};
+
+		igt_assert(parse_options(ARRAY_SIZE(argv), (char**)argv, settings));
+		igt_assert_eq_u64(settings->memory_budget, 512UL * 1024UL * 1024UL);
+		igt_assert(settings->collect_resources);
+
+		argv[1] = "--memory-budget=0";
+		igt_assert(!parse_options(ARRAY_SIZE(argv), (char**)argv, settings));
+
+		argv[1] = "--memory-budget=1T";
+		igt_assert(!parse_options(ARRAY_SIZE(argv), (char**)argv, settings));
+	}
+
 	igt_subtest("prune-modes") {
 		const char *argv[] = { "runner",
 			               "--prune-mode=keep-dynamic-subtests",
@@ -721,6 +809,61 @@ igt_main
 		igt_assert_eq(settings->prune_mode, PRUNE_KEEP_REQUESTED);
 	}
 
+	igt_subtest("durability-levels") {
+		const char *argv[] = { "runner",
+				       "--durability=journal",
+				       "test-root-dir",
+				       "results-path",
+		};
+
+		igt_assert(parse_options(ARRAY_SIZE(argv), (char**)argv, settings));
+		igt_assert(!settings->sync);
+		igt_assert(settings->sync_journal);
+
+		argv[1] = "--durability=full";
+		igt_assert(parse_options(ARRAY_SIZE(argv), (char**)argv, settings));
+		igt_assert(settings->sync);
+		igt_assert(!settings->sync_journal);
+
+		argv[1] = "--durability=none";
+		igt_assert(parse_options(ARRAY_SIZE(argv), (char**)argv, settings));
+		igt_assert(!settings->sync);
+		igt_assert(!settings->sync_journal);
+
+		argv[1] = "--durability=sometimes";
+		igt_assert(!parse_options(ARRAY_SIZE(argv), (char**)argv, settings));
+	}
+
+	igt_subtest("kmemleak-background") {
+		const char *argv[] = { "runner",
+				       "--kmemleak=background",
+				       "test-root-dir",
+				       "results-path",
+		};
+
+		igt_assert(parse_options(ARRAY_SIZE(argv), (char**)argv, settings));
+		igt_assert(settings->kmemleak);
+		igt_assert(settings->kmemleak_each);
+		igt_assert(settings->kmemleak_background);
+
+		argv[1] = "--kmemleak=each";
+		igt_assert(parse_options(ARRAY_SIZE(argv), (char**)argv, settings));
+		igt_assert(settings->kmemleak_each);
+		igt_assert(!settings->kmemleak_background);
+	}
+
+	igt_subtest("fork-subtests-implies-multiple-mode") {
+		const char *argv[] = { "runner",
+				       "--fork-subtests",
+				       "test-root-dir",
+				       "results-path",
+		};
+
+		igt_assert(parse_options(ARRAY_SIZE(argv), (char**)argv, settings));
+		igt_assert(settings->fork_subtests);
+		igt_assert(settings->multiple_mode);
+	}
+
 	igt_subtest("parse-clears-old-data") {
 		const char *argv[] = { "runner",
 				       "-n", "foo",
@@ -833,6 +976,79 @@ igt_main
 	job_list_filter_test("piglit-names", "-t", "igt@successtest", 2, 1);
 	job_list_filter_test("piglit-names-subtest", "-t", "igt@successtest@first", 1, 1);
 
+	igt_subtest_group {
+		char dirname[] = "tmpdirXXXXXX";
+		char binary[PATH_MAX], cachefile[PATH_MAX];
+		struct job_list *list = malloc(sizeof(*list));
+		struct timespec times[2];
+
+		igt_fixture {
+			struct stat st;
+
+			igt_require(mkdtemp(dirname) != NULL);
+			snprintf(binary, sizeof(binary), "%s/successtest", testdatadir);
+			snprintf(cachefile, sizeof(cachefile), "%s/successtest.subtests", dirname);
+			igt_require(stat(binary, &st) == 0);
+			times[0] = st.st_atim;
+			times[1] = st.st_mtim;
+			init_job_list(list);
+		}
+
+		igt_subtest("job-list-cache") {
+			const char *argv[] = { "runner",
+					       "--list-cache", dirname,
+					       "-t", "successtest",
+					       testdatadir,
+					       "path-to-results",
+			};
+			const char fake[] = "cached-only-subtest";
+			struct timespec touched[2] = {
+				{ .tv_nsec = UTIME_OMIT },
+				{ .tv_sec = times[1].tv_sec + 1, .tv_nsec = times[1].tv_nsec },
+			};
+			char buf[4096];
+			ssize_t len;
+			int fd;
+
+			igt_assert(parse_options(ARRAY_SIZE(argv), (char**)argv, settings));
+
+			igt_assert(create_job_list(list, settings));
+			igt_assert_eq(list->size, 2);
+
+			/* A subtest only the cache knows about tells it was used */
+			igt_assert((fd = open(cachefile, O_WRONLY | O_APPEND)) >= 0);
+			igt_assert(dprintf(fd, "%s\n", fake) > 0);
+			close(fd);
+
+			free_job_list(list);
+			igt_assert(create_job_list(list, settings));
+			igt_assert_eq(list->size, 3);
+			igt_assert_eqstr(list->entries[2].subtests[0], fake);
+
+			/* A changed binary is listed again and the cache refreshed */
+			igt_assert(utimensat(AT_FDCWD, binary, touched, 0) == 0);
+
+			free_job_list(list);
+			igt_assert(create_job_list(list, settings));
+			igt_assert_eq(list->size, 2);
+
+			igt_assert((fd = open(cachefile, O_RDONLY)) >= 0);
+			len = read(fd, buf, sizeof(buf) - 1);
+			close(fd);
+			igt_assert_lt(0, len);
+			buf[len] = '\0';
+			igt_assert(strstr(buf, "first-subtest") != NULL);
+			igt_assert(strstr(buf, fake) == NULL);
+		}
+
+		igt_fixture {
+			utimensat(AT_FDCWD, binary, times, 0);
+			clear_directory(dirname);
+			free_job_list(list);
+			free(list);
+		}
+	}
+
 	igt_subtest_group {
 		char filename[] = "tmplistXXXXXX";
 		const char testlisttext[] = "igt@successtest@first-subtest\n"
@@ -1080,6 +1296,93 @@ igt_main
 			}
 		}
 
+		igt_subtest("job-list-serialize-exclusive") {
+			const char *argv[] = { "runner",
+					       "--exclusive-tests", "^igt@successtest@first",
+					       testdatadir,
+					       dirname,
+			};
+			size_t i, exclusive = 0;
+
+			igt_assert(parse_options(ARRAY_SIZE(argv), (char**)argv, settings));
+			igt_assert(create_job_list(list, settings));
+
+			for (i = 0; i < list->size; i++) {
+				struct job_list_entry *entry = &list->entries[i];
+
+				if (!entry->exclusive)
+					continue;
+
+				igt_assert_eqstr(entry->binary, "successtest");
+				igt_assert_eq(entry->subtest_count, 1);
+				igt_assert_eqstr(entry->subtests[0], "first-subtest");
+				exclusive++;
+			}
+			igt_assert_eq(exclusive, 1);
+
+			igt_assert(serialize_settings(settings));
+			igt_assert(serialize_job_list(list, settings));
+
+			dirfd = open(dirname, O_DIRECTORY, O_RDONLY);
+			igt_assert_f(dirfd >= 0, "Serialization did not create the results directory\n");
+
+			igt_assert_f(read_job_list(cmp_list, dirfd), "Reading job list failed\n");
+			assert_job_list_equal(list, cmp_list);
+		}
+
+		igt_fixture {
+			close(dirfd);
+			clear_directory(dirname);
+			free_job_list(cmp_list);
+			free_job_list(list);
+		}
+
+		igt_subtest("job-list-shard") {
+			char shardarg[16];
+			const char *argv[] = { "runner",
+					       "--shard", shardarg,
+					       testdatadir,
+					       dirname,
+			};
+			const char *full_argv[] = { "runner", testdatadir, dirname };
+			size_t i, k, total = 0;
+			int shard;
+
+			igt_assert(parse_options(ARRAY_SIZE(full_argv), (char**)full_argv, settings));
+			igt_assert(create_job_list(cmp_list, settings));
+			igt_assert_lt(3, cmp_list->size);
+
+			/* Every entry ends up in exactly one shard, keeping the order */
+			for (shard = 1; shard <= 3; shard++) {
+				snprintf(shardarg, sizeof(shardarg), "%d/3", shard);
+				igt_assert(parse_options(ARRAY_SIZE(argv), (char**)argv, settings));
+				igt_assert(create_job_list(list, settings));
+				igt_assert_lt(0, list->size);
+
+				for (i = 0, k = 0; i < list->size; i++, k++) {
+					while (k < cmp_list->size &&
+					       (strcmp(list->entries[i].binary, cmp_list->entries[k].binary) ||
+						list->entries[i].subtest_count != cmp_list->entries[k].subtest_count ||
+						(list->entries[i].subtest_count &&
+						 strcmp(list->entries[i].subtests[0], cmp_list->entries[k].subtests[0]))))
+						k++;
+					igt_assert_lt(k, cmp_list->size);
+				}
+
+				total += list->size;
+				free_job_list(list);
+			}
+			igt_assert_eq(total, cmp_list->size);
+
+			snprintf(shardarg, sizeof(shardarg), "4/3");
+			igt_assert(!parse_options(ARRAY_SIZE(argv), (char**)argv, settings));
+		}
+
+		igt_fixture {
+			free_job_list(cmp_list);
+			free_job_list(list);
+		}
+
 		igt_fixture {
 			free(cmp_list);
 			free(list);
@@ -1990,6 +2293,268 @@ igt_main
 		}
 	}
 
+	igt_subtest_group {
+		struct job_list *list = malloc(sizeof(*list));
+		volatile int dirfd = -1, subdirfd = -1;
+		char dirname[] = "tmpdirXXXXXX";
+
+		igt_fixture {
+			igt_require(mkdtemp(dirname) != NULL);
+			rmdir(dirname);
+
+			init_job_list(list);
+		}
+
+		igt_subtest("compressed-output") {
+			struct execute_state state;
+			struct json_object *results, *tests;
+			const char *argv[] = { "runner",
+					       "--allow-non-root",
+					       "--compress-output",
+					       "-t", "^dynamic$",
+					       testdatadir,
+					       dirname,
+			};
+
+			igt_assert(parse_options(ARRAY_SIZE(argv), (char**)argv, settings));
+			igt_assert(create_job_list(list, settings));
+			igt_assert(initialize_execute_state(&state, settings, list));
+			igt_assert(execute(&state, settings, list));
+
+			igt_assert_f((dirfd = open(dirname, O_DIRECTORY | O_RDONLY)) >= 0,
+				     "Execute didn't create the results directory\n");
+			igt_assert_f((subdirfd = openat(dirfd, "0", O_DIRECTORY | O_RDONLY)) >= 0,
+				     "Execute didn't create the results subdirectory\n");
+			assert_execution_created(subdirfd, "journal.txt");
+			assert_execution_created(subdirfd, "out.txt.gz");
+			assert_execution_created(subdirfd, "err.txt.gz");
+			assert_execution_created(subdirfd, "dmesg.txt.gz");
+			igt_assert(faccessat(subdirfd, "out.txt", F_OK, 0) != 0);
+
+			igt_assert_f((results = generate_results_json(dirfd)) != NULL,
+				     "Results parsing failed\n");
+
+			igt_assert(json_object_object_get_ex(results, "tests", &tests));
+
+			igt_assert_eqstr(igt_get_result(tests, "igt@dynamic@dynamic-subtest@passing"), "pass");
+
+			igt_assert_eq(json_object_put(results), 1);
+		}
+
+		igt_subtest("compressed-output-overwrite") {
+			struct execute_state state;
+			const char *compressed[] = { "runner",
+						     "--allow-non-root",
+						     "--overwrite",
+						     "--compress-output",
+						     "-t", "^dynamic$",
+						     testdatadir,
+						     dirname,
+			};
+			const char *plain[] = { "runner",
+						"--allow-non-root",
+						"--overwrite",
+						"-t", "^dynamic$",
+						testdatadir,
+						dirname,
+			};
+
+			igt_assert(parse_options(ARRAY_SIZE(compressed), (char**)compressed, settings));
+			igt_assert(create_job_list(list, settings));
+			igt_assert(initialize_execute_state(&state, settings, list));
+			igt_assert(execute(&state, settings, list));
+			free_job_list(list);
+
+			/* Overwriting must not leave the old .gz outputs behind */
+			igt_assert(parse_options(ARRAY_SIZE(plain), (char**)plain, settings));
+			igt_assert(create_job_list(list, settings));
+			igt_assert(initialize_execute_state(&state, settings, list));
+			igt_assert(execute(&state, settings, list));
+
+			close(subdirfd);
+			close(dirfd);
+			igt_assert_f((dirfd = open(dirname, O_DIRECTORY | O_RDONLY)) >= 0,
+				     "Execute didn't create the results directory\n");
+			igt_assert_f((subdirfd = openat(dirfd, "0", O_DIRECTORY | O_RDONLY)) >= 0,
+				     "Execute didn't create the results subdirectory\n");
+			assert_execution_created(subdirfd, "out.txt");
+			igt_assert(faccessat(subdirfd, "out.txt.gz", F_OK, 0) != 0);
+			igt_assert(faccessat(subdirfd, "err.txt.gz", F_OK, 0) != 0);
+			igt_assert(faccessat(subdirfd, "dmesg.txt.gz", F_OK, 0) != 0);
+		}
+
+		igt_fixture {
+			close(subdirfd);
+			close(dirfd);
+			clear_directory(dirname);
+			free_job_list(list);
+		}
+	}
+
+	igt_subtest_group {
+		struct job_list *list = malloc(sizeof(*list));
+		volatile int dirfd = -1, subdirfd = -1;
+		char dirname[] = "tmpdirXXXXXX";
+
+		igt_fixture {
+			igt_require(mkdtemp(dirname) != NULL);
+			rmdir(dirname);
+
+			init_job_list(list);
+		}
+
+		igt_subtest("collect-resources") {
+			struct execute_state state;
+			struct json_object *results, *tests, *test, *resources, *value;
+			const char *argv[] = { "runner",
+					       "--allow-non-root",
+					       "--collect-resources",
+					       "-t", "^dynamic$",
+					       testdatadir,
+					       dirname,
+			};
+
+			igt_assert(parse_options(ARRAY_SIZE(argv), (char**)argv, settings));
+			igt_assert(create_job_list(list, settings));
+			igt_assert(initialize_execute_state(&state, settings, list));
+			igt_assert(execute(&state, settings, list));
+
+			igt_assert_f((dirfd = open(dirname, O_DIRECTORY | O_RDONLY)) >= 0,
+				     "Execute didn't create the results directory\n");
+			igt_assert_f((subdirfd = openat(dirfd, "0", O_DIRECTORY | O_RDONLY)) >= 0,
+				     "Execute didn't create the results subdirectory\n");
+			assert_execution_created(subdirfd, RESOURCES_FILENAME);
+
+			igt_assert_f((results = generate_results_json(dirfd)) != NULL,
+				     "Results parsing failed\n");
+
+			igt_assert(json_object_object_get_ex(results, "tests", &tests));
+			igt_assert(json_object_object_get_ex(tests, "igt@dynamic@dynamic-subtest", &test));
+			igt_assert(json_object_object_get_ex(test, "resources", &resources));
+			igt_assert(json_object_object_get_ex(resources, "dmesg-bytes", &value));
+			igt_assert(json_object_get_int(value) >= 0);
+
+			igt_assert(json_object_object_get_ex(results, "runtimes", &tests));
+			igt_assert(json_object_object_get_ex(tests, "igt@dynamic", &test));
+			igt_assert(json_object_object_get_ex(test, "resources", &resources));
+			igt_assert(json_object_object_get_ex(resources, "cpu-user", &value));
+			igt_assert(json_object_get_double(value) >= 0.0);
+			igt_assert(json_object_object_get_ex(resources, "max-rss", &value));
+			igt_assert(json_object_get_int(value) > 0);
+
+			igt_assert_eq(json_object_put(results), 1);
+		}
+
+		igt_subtest("resources-line-parsing") {
+			struct resource_usage usage = {
+				.cpu_user = 1.5, .cpu_sys = 0.25,
+				.max_rss = 2048, .gpu_busy = -1.0,
+				.energy = 12.5, .energy_gpu = 2.25,
+				.energy_card = -1.0, .wall = 0.5,
+				.mem_stall_some = 0.125, .mem_stall_full = 0.0625,
+				.dmesg_bytes = 100,
+			};
+			struct resource_usage parsed;
+			char line[256], *name;
+
+			strcpy(line, "subtest basic ");
+			format_resource_usage(line + strlen(line),
+					      sizeof(line) - strlen(line), &usage);
+			igt_assert(parse_resources_line(line, &name, &parsed));
+			igt_assert_eqstr(name, "basic");
+			igt_assert(parsed.cpu_user == usage.cpu_user);
+			igt_assert(parsed.cpu_sys == usage.cpu_sys);
+			igt_assert_eq(parsed.max_rss, usage.max_rss);
+			igt_assert(parsed.gpu_busy < 0);
+			igt_assert(parsed.energy == usage.energy);
+			igt_assert(parsed.energy_gpu == usage.energy_gpu);
+			igt_assert(parsed.energy_card < 0);
+			igt_assert(parsed.wall == usage.wall);
+			igt_assert(parsed.mem_stall_some == usage.mem_stall_some);
+			igt_assert(parsed.mem_stall_full == usage.mem_stall_full);
+			igt_assert_eq(parsed.dmesg_bytes, usage.dmesg_bytes);
+			free(name);
+
+			igt_assert(parse_resources_line("exec cpu-user=0.100\n", &name, &parsed));
+			igt_assert(name == NULL);
+			igt_assert(parsed.cpu_user == 0.1);
+			igt_assert(parsed.max_rss < 0);
+			igt_assert(parsed.wall < 0);
+			igt_assert(parsed.mem_stall_some < 0);
+
+			igt_assert(!parse_resources_line("bogus cpu-user=1\n", &name, &parsed));
+		}
+
+		igt_subtest("live-results") {
+			struct execute_state state;
+			struct json_object *record, *value;
+			const char *argv[] = { "runner",
+					       "--allow-non-root",
+					       "--overwrite",
+					       "--live-results",
+					       "--collect-resources",
+					       "-t", "^dynamic$",
+					       testdatadir,
+					       dirname,
+			};
+			const struct {
+				const char *test;
+				const char *result;
+			} expected[] = {
+				{ "igt@dynamic@dynamic-subtest@failing", "fail" },
+				{ "igt@dynamic@dynamic-subtest@passing", "pass" },
+				{ "igt@dynamic@dynamic-subtest", "fail" },
+			};
+			char *line = NULL;
+			size_t linelen = 0;
+			int fd, n = 0;
+			FILE *f;
+
+			igt_assert(parse_options(ARRAY_SIZE(argv), (char**)argv, settings));
+			igt_assert(create_job_list(list, settings));
+			igt_assert(initialize_execute_state(&state, settings, list));
+			igt_assert(execute(&state, settings, list));
+
+			igt_assert_f((dirfd = open(dirname, O_DIRECTORY | O_RDONLY)) >= 0,
+				     "Execute didn't create the results directory\n");
+			igt_assert_f((fd = openat(dirfd, LIVE_RESULTS_FILENAME, O_RDONLY)) >= 0,
+				     "Execute didn't create %s\n", LIVE_RESULTS_FILENAME);
+			igt_assert((f = fdopen(fd, "r")) != NULL);
+
+			/* Records come in the order the subtests complete */
+			while (getline(&line, &linelen, f) > 0) {
+				igt_assert_lt(n, ARRAY_SIZE(expected));
+				igt_assert((record = json_tokener_parse(line)) != NULL);
+
+				igt_assert(json_object_object_get_ex(record, "test", &value));
+				igt_assert_eqstr(json_object_get_string(value), expected[n].test);
+				igt_assert(json_object_object_get_ex(record, "result", &value));
+				igt_assert_eqstr(json_object_get_string(value), expected[n].result);
+				igt_assert(json_object_object_get_ex(record, "time", &value));
+				igt_assert(json_object_get_double(value) >= 0.0);
+				igt_assert(json_object_object_get_ex(record, "dmesg-warnings", &value));
+				igt_assert(json_object_get_int(value) >= 0);
+				/* Only whole subtests are tracked */
+				igt_assert_eq(json_object_object_get_ex(record, "resources", &value),
+					      n == 2);
+
+				igt_assert_eq(json_object_put(record), 1);
+				n++;
+			}
+			igt_assert_eq(n, ARRAY_SIZE(expected));
+
+			free(line);
+			fclose(f);
+		}
+
+		igt_fixture {
+			close(subdirfd);
+			close(dirfd);
+			clear_directory(dirname);
+			free_job_list(list);
+		}
+	}
+
 	igt_subtest_group {
 		struct job_list *list = malloc(sizeof(*list));
 		volatile int dirfd = -1;
@@ -2273,6 +2838,281 @@ igt_main
 		}
 	}
 
+	igt_subtest("runtime-db") {
+		char dbname[] = "tmpdbXXXXXX";
+		char *subtests[] = { strdup("second-subtest") };
+		struct job_list_entry entries[] = {
+			{ .binary = strdup("successtest") },
+			{ .binary = strdup("notrun") },
+			{ .binary = strdup("successtest"), .subtests = subtests, .subtest_count = 1 },
+		};
+		struct job_list list = {
+			.entries = malloc(sizeof(entries)),
+			.size = ARRAY_SIZE(entries),
+		};
+		const struct runtime_stats *stats;
+		struct runtime_db *db;
+		int fd;
+
+		igt_require((fd = mkstemp(dbname)) >= 0);
+		close(fd);
+		memcpy(list.entries, entries, sizeof(entries));
+
+		db = runtime_db_load(dbname);
+		for (int i = 0; i < 4; i++) {
+			runtime_db_add_sample(db, "igt@successtest@first-subtest", 1.0 + (i & 1));
+			runtime_db_add_sample(db, "igt@successtest@second-subtest", 0.5);
+			runtime_db_add_sample(db, "igt@successtest", 2.0);
+		}
+		igt_assert(runtime_db_save(db, dbname));
+		runtime_db_free(db);
+
+		db = runtime_db_load(dbname);
+		stats = runtime_db_lookup(db, "igt@successtest@first-subtest");
+		igt_assert(stats);
+		igt_assert_eq(stats->samples, 4);
+		igt_assert(fabs(stats->mean - 1.5) < 0.001);
+		igt_assert(fabs(stats->variance - 0.25) < 0.001);
+		igt_assert_eq(stats->recent_count, 4);
+		igt_assert(fabs(runtime_stats_p99(stats) - 2.0) < 0.001);
+		igt_assert(!runtime_db_lookup(db, "igt@notrun"));
+
+		igt_assert(fabs(runtime_db_entry_estimate(db, &entries[0]) - 2.0) < 0.001);
+		igt_assert(runtime_db_entry_estimate(db, &entries[1]) < 0.0);
+		igt_assert(fabs(runtime_db_entry_estimate(db, &entries[2]) - 0.5) < 0.001);
+		igt_assert(fabs(runtime_db_entry_p99(db, &entries[0]) - 2.0) < 0.001);
+
+		/* Unknown first, then by decreasing runtime */
+		runtime_db_sort_longest_first(db, &list);
+		igt_assert_eqstr(list.entries[0].binary, "notrun");
+		igt_assert_eq(list.entries[1].subtest_count, 0);
+		igt_assert_eq(list.entries[2].subtest_count, 1);
+
+		runtime_db_free(db);
+		free_job_list(&list);
+		unlink(dbname);
+	}
+
+	igt_subtest("runtime-db-p99") {
+		struct runtime_stats v1 = {
+			.samples = 32, .mean = 1.0, .variance = 0.25, .max = 1.5,
+		};
+		const struct runtime_stats *stats;
+		struct runtime_db *db;
+		int i;
+
+		/* Without the recent runtimes, estimate from the moments */
+		igt_assert(fabs(runtime_stats_p99(&v1) - 2.163) < 0.001);
+
+		db = runtime_db_load("/nonexistent");
+		for (i = 0; i < 100; i++)
+			runtime_db_add_sample(db, "igt@successtest@first-subtest",
+					      i == 50 ? 100.0 : 1.0 + i % 10);
+
+		/* The outlier has left the window */
+		stats = runtime_db_lookup(db, "igt@successtest@first-subtest");
+		igt_assert_eq(stats->recent_count, RUNTIME_DB_WINDOW);
+		igt_assert(fabs(stats->max - 100.0) < 0.001);
+		igt_assert(fabs(runtime_stats_p99(stats) - 10.0) < 0.001);
+
+		runtime_db_add_sample(db, "igt@successtest@first-subtest", 50.0);
+		igt_assert(fabs(runtime_stats_p99(stats) - 50.0) < 0.001);
+
+		runtime_db_free(db);
+	}
+
+	igt_subtest("runtime-db-resume") {
+		char dirname[] = "tmpdirXXXXXX";
+		char dbname[PATH_MAX], file[PATH_MAX];
+		const struct runtime_stats *stats;
+		struct json_object *results;
+		struct runtime_db *db;
+
+		igt_require(mkdtemp(dirname) != NULL);
+		snprintf(dbname, sizeof(dbname), "%s/runtimes.db", dirname);
+		snprintf(file, sizeof(file), "%s/results.json", dirname);
+
+		results = json_tokener_parse("{ \"tests\": {"
+					     " \"igt@successtest@first-subtest\":"
+					     " { \"result\": \"pass\","
+					     " \"time\": { \"start\": 0.0, \"end\": 1.0 } } } }");
+		igt_assert(results);
+		igt_assert_eq(json_object_to_file(file, results), 0);
+		json_object_put(results);
+		igt_assert(runtime_db_update_from_results(dbname, dirname));
+
+		/* igt_resume adds a subtest and generates the results again */
+		results = json_tokener_parse("{ \"tests\": {"
+					     " \"igt@successtest@first-subtest\":"
+					     " { \"result\": \"pass\","
+					     " \"time\": { \"start\": 0.0, \"end\": 1.0 } },"
+					     " \"igt@successtest@second-subtest\":"
+					     " { \"result\": \"pass\","
+					     " \"time\": { \"start\": 1.0, \"end\": 3.0 } } } }");
+		igt_assert(results);
+		igt_assert_eq(json_object_to_file(file, results), 0);
+		json_object_put(results);
+		igt_assert(runtime_db_update_from_results(dbname, dirname));
+
+		db = runtime_db_load(dbname);
+		stats = runtime_db_lookup(db, "igt@successtest@first-subtest");
+		igt_assert(stats);
+		igt_assert_eq(stats->samples, 1);
+		stats = runtime_db_lookup(db, "igt@successtest@second-subtest");
+		igt_assert(stats);
+		igt_assert_eq(stats->samples, 1);
+		igt_assert(fabs(stats->mean - 2.0) < 0.001);
+
+		/* The binary only has the complete sum from the first pass */
+		stats = runtime_db_lookup(db, "igt@successtest");
+		igt_assert(stats);
+		igt_assert_eq(stats->samples, 1);
+		igt_assert(fabs(stats->mean - 1.0) < 0.001);
+		runtime_db_free(db);
+
+		clear_directory(dirname);
+	}
+
+	igt_subtest("dmesg-regex-prefilter") {
+		static const struct {
+			const char *regex;
+			const char *line;
+			bool match;
+		} cases[] = {
+			/* alternation */
+			{ "foo bar|baz qux", "a baz qux b", true },
+			{ "foo bar|baz qux", "foo qux", false },
+			{ "(\\[drm:|drm_|intel_|i915_|\\[drm\\])", "i915_gem_init", true },
+			{ "(\\[drm:|drm_|intel_|i915_|\\[drm\\])", "[drm] ok", true },
+			{ "(\\[drm:|drm_|intel_|i915_|\\[drm\\])", "usb 1-1: new", false },
+			{ "atkbd serio[0-9]+: Failed to (deactivate|enable) keyboard",
+			  "atkbd serio0: Failed to enable keyboard on isa0060", true },
+			{ "atkbd serio[0-9]+: Failed to (deactivate|enable) keyboard",
+			  "atkbd serio0: Failed to reset keyboard", false },
+			/* character classes */
+			{ "IRQ [0-9]+: no longer affine to CPU[0-9]+",
+			  "IRQ 12: no longer affine to CPU3", true },
+			{ "IRQ [0-9]+: no longer affine to CPU[0-9]+",
+			  "IRQ 12: still affine to CPU3", false },
+			{ "[]x]abc", "]abc", true },
+			{ "[^a]bc", "xbc", true },
+			{ "x[[:digit:]]y", "x7y", true },
+			/* escapes */
+			{ "Suspending console\\(s\\)", "Suspending console(s) (use no_console_suspend)", true },
+			{ "a\\.b", "xa.by", true },
+			{ "a\\.b", "xy", false },
+			{ "\\x41BC", "ABC", true },
+			{ "\\d+ bytes", "12 bytes", true },
+			{ "path\\\\to", "path\\to", true },
+			{ "\\Qa.b\\E", "a.b", true },
+			/* optional groups and quantifiers */
+			{ "foo(bar)?baz", "foobaz", true },
+			{ "foo(bar)?baz", "foobarbaz", true },
+			{ "colou?r", "color", true },
+			{ "ab(cd|ef)*gh", "abgh", true },
+			{ "(x|y)?zz", "zz", true },
+			{ "error(: -[0-9]+)? found", "error found", true },
+			{ "error(: -[0-9]+)? found", "warning", false },
+			{ "ab{0}c", "ac", true },
+			/* inline options */
+			{ "(?i)warning", "WARNING", true },
+		};
+		int rejected = 0;
+
+		for (int i = 0; i < ARRAY_SIZE(cases); i++) {
+			GRegex *re = g_regex_new(cases[i].regex, 0, 0, NULL);
+			bool match, pass;
+
+			igt_assert(re);
+			match = g_regex_match(re, cases[i].line, 0, NULL);
+			g_regex_unref(re);
+			igt_assert_eq(match, cases[i].match);
+
+			pass = dmesg_regex_prefilter(cases[i].regex, cases[i].line);
+			igt_assert_f(pass || !match,
+				     "prefilter rejected \"%s\" for /%s/\n",
+				     cases[i].line, cases[i].regex);
+			if (!pass)
+				rejected++;
+		}
+
+		/* The prefilter must still be doing its job. */
+		igt_assert(rejected > 0);
+	}
+
+	igt_subtest("merge-results") {
+		struct json_object *shards[2], *merged, *tests, *obj;
+		const char *names[] = { "igt@successtest@first-subtest",
+					"igt@successtest@second-subtest" };
+		int i;
+
+		for (i = 0; i < 2; i++) {
+			struct json_object *test, *totals, *total, *runtimes, *runtime,
+				*time, *elapsed;
+
+			shards[i] = json_object_new_object();
+			json_object_object_add(shards[i], "name", json_object_new_string("sharded"));
+
+			elapsed = json_object_new_object();
+			json_object_object_add(elapsed, "start", json_object_new_double(10.0 * (2 - i)));
+			json_object_object_add(elapsed, "end", json_object_new_double(10.0 * (2 - i) + 5.0));
+			json_object_object_add(shards[i], "time_elapsed", elapsed);
+
+			tests = json_object_new_object();
+			test = json_object_new_object();
+			json_object_object_add(test, "result", json_object_new_string("pass"));
+			json_object_object_add(tests, names[i], test);
+			test = json_object_new_object();
+			json_object_object_add(test, "result", json_object_new_string("notrun"));
+			json_object_object_add(tests, names[!i], test);
+			json_object_object_add(shards[i], "tests", tests);
+
+			totals = json_object_new_object();
+			total = json_object_new_object();
+			json_object_object_add(total, "pass", json_object_new_int(1));
+			json_object_object_add(totals, "root", total);
+			json_object_object_add(shards[i], "totals", totals);
+
+			runtimes = json_object_new_object();
+			runtime = json_object_new_object();
+			time = json_object_new_object();
+			json_object_object_add(time, "end", json_object_new_double(1.5));
+			json_object_object_add(runtime, "time", time);
+			json_object_object_add(runtimes, "igt@successtest", runtime);
+			json_object_object_add(shards[i], "runtimes", runtimes);
+		}
+
+		merged = merge_results_json(shards, 2);
+
+		igt_assert(json_object_object_get_ex(merged, "name", &obj));
+		igt_assert_eqstr(json_object_get_string(obj), "sharded");
+
+		igt_assert(json_object_object_get_ex(merged, "tests", &tests));
+		igt_assert_eqstr(igt_get_result(tests, names[0]), "pass");
+		igt_assert_eqstr(igt_get_result(tests, names[1]), "pass");
+
+		igt_assert(json_object_object_get_ex(merged, "totals", &obj));
+		igt_assert(json_object_object_get_ex(obj, "root", &obj));
+		igt_assert(json_object_object_get_ex(obj, "pass", &obj));
+		igt_assert_eq(json_object_get_int(obj), 2);
+
+		igt_assert(json_object_object_get_ex(merged, "runtimes", &obj));
+		igt_assert(json_object_object_get_ex(obj, "igt@successtest", &obj));
+		igt_assert(json_object_object_get_ex(obj, "time", &obj));
+		igt_assert(json_object_object_get_ex(obj, "end", &obj));
+		igt_assert(fabs(json_object_get_double(obj) - 3.0) < 0.001);
+
+		igt_assert(json_object_object_get_ex(merged, "time_elapsed", &obj));
+		igt_assert(json_object_object_get_ex(obj, "start", &tests));
+		igt_assert(fabs(json_object_get_double(tests) - 10.0) < 0.001);
+		igt_assert(json_object_object_get_ex(obj, "end", &tests));
+		igt_assert(fabs(json_object_get_double(tests) - 25.0) < 0.001);
+
+		json_object_put(merged);
+		json_object_put(shards[0]);
+		json_object_put(shards[1]);
+	}
+
 	igt_subtest("file-descriptor-leakage") {
 		int i;
 
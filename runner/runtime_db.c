@@ -0,0 +1,598 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2025 Intel Corporation
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef ANDROID
+#include "android/glib.h"
+#else
+#include <glib.h>
+#endif
+#include <json.h>
+
+#include "runtime_db.h"
+
+/*
+ * The database is a text file with one line per test:
+ *
+ *   <piglit name> <samples> <mean> <variance> <max> [<runtime>...]
+ *
+ * Samples are folded in with exponentially decaying weights once there
+ * are RUNTIME_DB_WINDOW of them, so the statistics follow tests getting
+ * faster or slower over time. The trailing runtimes are the last
+ * RUNTIME_DB_WINDOW samples, oldest first; v1 databases don't have them.
+ */
+#define RUNTIME_DB_HEADER "# igt_runner runtime database v2"
+
+struct runtime_entry {
+	struct runtime_stats stats;
+	/* For whole binaries, highest p99 of any of the subtests */
+	double max_subtest_p99;
+};
+
+struct runtime_db {
+	GHashTable *entries;
+};
+
+static struct runtime_db *runtime_db_create(void)
+{
+	struct runtime_db *db = malloc(sizeof(*db));
+
+	db->entries = g_hash_table_new_full(g_str_hash, g_str_equal,
+					    free, free);
+
+	return db;
+}
+
+void runtime_db_free(struct runtime_db *db)
+{
+	if (!db)
+		return;
+
+	g_hash_table_destroy(db->entries);
+	free(db);
+}
+
+static struct runtime_entry *get_entry(struct runtime_db *db, const char *name)
+{
+	struct runtime_entry *entry = g_hash_table_lookup(db->entries, name);
+
+	if (!entry) {
+		entry = calloc(1, sizeof(*entry));
+		g_hash_table_insert(db->entries, strdup(name), entry);
+	}
+
+	return entry;
+}
+
+/* "igt@binary@subtest" -> "igt@binary", NULL for anything else */
+static char *binary_name(const char *name)
+{
+	const char *first, *second;
+
+	if (!(first = strchr(name, '@')) || !(second = strchr(first + 1, '@')))
+		return NULL;
+
+	/* Dynamic subtests aren't accounted to the binary */
+	if (strchr(second + 1, '@'))
+		return NULL;
+
+	return strndup(name, second - name);
+}
+
+static void update_binary(struct runtime_db *db, const char *name,
+			  const struct runtime_stats *stats)
+{
+	struct runtime_entry *entry;
+	char *binary;
+
+	binary = binary_name(name);
+	if (!binary)
+		return;
+
+	entry = get_entry(db, binary);
+	entry->max_subtest_p99 = fmax(entry->max_subtest_p99,
+				      runtime_stats_p99(stats));
+	free(binary);
+}
+
+static bool parse_line(const char *line, char *name,
+		       struct runtime_stats *stats)
+{
+	char *end;
+	int pos;
+
+	memset(stats, 0, sizeof(*stats));
+	if (sscanf(line, "%511s %u %lf %lf %lf%n",
+		   name, &stats->samples,
+		   &stats->mean, &stats->variance, &stats->max, &pos) != 5)
+		return false;
+
+	line += pos;
+	while (stats->recent_count < RUNTIME_DB_WINDOW) {
+		double time = strtod(line, &end);
+
+		if (end == line)
+			break;
+
+		stats->recent[stats->recent_count++] = time;
+		line = end;
+	}
+
+	return true;
+}
+
+struct runtime_db *runtime_db_load(const char *path)
+{
+	struct runtime_db *db = runtime_db_create();
+	char name[512];
+	size_t len = 0;
+	char *line = NULL;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (!f)
+		return db; /* start from scratch */
+
+	while (getline(&line, &len, f) > 0) {
+		struct runtime_stats stats;
+		struct runtime_entry *entry;
+
+		/* Skip comments and broken lines */
+		if (line[0] == '#' || !parse_line(line, name, &stats))
+			continue;
+
+		entry = get_entry(db, name);
+		entry->stats = stats;
+		update_binary(db, name, &stats);
+	}
+
+	free(line);
+	fclose(f);
+
+	return db;
+}
+
+bool runtime_db_save(struct runtime_db *db, const char *path)
+{
+	struct runtime_entry *entry;
+	GHashTableIter iter;
+	char *tmp, *name;
+	FILE *f;
+
+	if (asprintf(&tmp, "%s.tmp", path) < 0)
+		return false;
+
+	f = fopen(tmp, "w");
+	if (!f) {
+		fprintf(stderr, "Cannot write runtime database %s: %s\n",
+			tmp, strerror(errno));
+		free(tmp);
+		return false;
+	}
+
+	fprintf(f, "%s\n", RUNTIME_DB_HEADER);
+
+	g_hash_table_iter_init(&iter, db->entries);
+	while (g_hash_table_iter_next(&iter, (void **)&name, (void **)&entry)) {
+		const struct runtime_stats *s = &entry->stats;
+
+		if (!s->samples)
+			continue;
+
+		fprintf(f, "%s %u %.6f %.6f %.6f",
+			name, s->samples, s->mean, s->variance, s->max);
+		for (unsigned int i = 0; i < s->recent_count; i++)
+			fprintf(f, " %.6f", s->recent[i]);
+		fputc('\n', f);
+	}
+
+	if (fclose(f) || rename(tmp, path)) {
+		fprintf(stderr, "Cannot write runtime database %s: %s\n",
+			path, strerror(errno));
+		unlink(tmp);
+		free(tmp);
+		return false;
+	}
+
+	free(tmp);
+	return true;
+}
+
+void runtime_db_add_sample(struct runtime_db *db, const char *name, double time)
+{
+	struct runtime_stats *s = &get_entry(db, name)->stats;
+	double alpha, delta;
+
+	if (s->samples < RUNTIME_DB_WINDOW)
+		s->samples++;
+
+	/* Welford's update, turning into an EWMA when the window is full */
+	alpha = 1.0 / s->samples;
+	delta = time - s->mean;
+	s->mean += alpha * delta;
+	s->variance = (1.0 - alpha) * (s->variance + alpha * delta * delta);
+	s->max = fmax(s->max, time);
+
+	if (s->recent_count == RUNTIME_DB_WINDOW)
+		memmove(s->recent, s->recent + 1,
+			--s->recent_count * sizeof(s->recent[0]));
+	s->recent[s->recent_count++] = time;
+
+	update_binary(db, name, s);
+}
+
+static bool result_has_runtime(const char *result)
+{
+	static const char * const ignored[] = {
+		"notrun", "incomplete", "abort", "timeout",
+	};
+
+	for (int i = 0; i < sizeof(ignored) / sizeof(ignored[0]); i++)
+		if (!strcmp(result, ignored[i]))
+			return false;
+
+	return true;
+}
+
+struct binary_sum {
+	double runtime;
+	/* Some subtests were recorded before, the sum would be short */
+	bool partial;
+};
+
+/*
+ * Adds the runtimes of the tests in @results that are not in @recorded,
+ * and adds them to @recorded if it's non-NULL.
+ */
+static bool add_results(struct runtime_db *db, struct json_object *results,
+			GHashTable *recorded)
+{
+	struct json_object *tests;
+	struct binary_sum *sum;
+	GHashTable *binaries;
+	GHashTableIter iter;
+	char *name;
+
+	if (!json_object_object_get_ex(results, "tests", &tests))
+		return false;
+
+	/* Subtests of a binary get summed up into a sample for the binary */
+	binaries = g_hash_table_new_full(g_str_hash, g_str_equal, free, free);
+
+	json_object_object_foreach(tests, key, test) {
+		struct json_object *obj, *time, *start, *end;
+		bool seen = false;
+		double runtime;
+		char *binary;
+
+		if (!json_object_object_get_ex(test, "result", &obj) ||
+		    !result_has_runtime(json_object_get_string(obj)))
+			continue;
+
+		if (!json_object_object_get_ex(test, "time", &time) ||
+		    !json_object_object_get_ex(time, "start", &start) ||
+		    !json_object_object_get_ex(time, "end", &end))
+			continue;
+
+		runtime = json_object_get_double(end) - json_object_get_double(start);
+		if (runtime < 0.0)
+			continue;
+
+		if (recorded && g_hash_table_contains(recorded, key)) {
+			seen = true;
+		} else {
+			runtime_db_add_sample(db, key, runtime);
+			if (recorded)
+				g_hash_table_add(recorded, strdup(key));
+		}
+
+		binary = binary_name(key);
+		if (!binary)
+			continue;
+
+		sum = g_hash_table_lookup(binaries, binary);
+		if (!sum) {
+			sum = calloc(1, sizeof(*sum));
+			g_hash_table_insert(binaries, binary, sum);
+		} else {
+			free(binary);
+		}
+		sum->runtime += runtime;
+		sum->partial |= seen;
+	}
+
+	g_hash_table_iter_init(&iter, binaries);
+	while (g_hash_table_iter_next(&iter, (void **)&name, (void **)&sum))
+		if (!sum->partial)
+			runtime_db_add_sample(db, name, sum->runtime);
+
+	g_hash_table_destroy(binaries);
+
+	return true;
+}
+
+bool runtime_db_add_results(struct runtime_db *db, struct json_object *results)
+{
+	return add_results(db, results, NULL);
+}
+
+static GHashTable *load_recorded(const char *results_path)
+{
+	GHashTable *recorded;
+	size_t len = 0;
+	char *line = NULL;
+	char *file;
+	ssize_t s;
+	FILE *f;
+
+	recorded = g_hash_table_new_full(g_str_hash, g_str_equal, free, NULL);
+
+	if (asprintf(&file, "%s/%s", results_path,
+		     RUNTIME_DB_RECORDED_FILENAME) < 0)
+		return recorded;
+
+	f = fopen(file, "r");
+	free(file);
+	if (!f)
+		return recorded;
+
+	while ((s = getline(&line, &len, f)) > 0) {
+		if (line[s - 1] == '\n')
+			line[s - 1] = '\0';
+		if (line[0])
+			g_hash_table_add(recorded, strdup(line));
+	}
+
+	free(line);
+	fclose(f);
+
+	return recorded;
+}
+
+static bool save_recorded(const char *results_path, GHashTable *recorded)
+{
+	GHashTableIter iter;
+	char *file, *name;
+	FILE *f;
+
+	if (asprintf(&file, "%s/%s", results_path,
+		     RUNTIME_DB_RECORDED_FILENAME) < 0)
+		return false;
+
+	f = fopen(file, "w");
+	free(file);
+	if (!f)
+		return false;
+
+	g_hash_table_iter_init(&iter, recorded);
+	while (g_hash_table_iter_next(&iter, (void **)&name, NULL))
+		fprintf(f, "%s\n", name);
+
+	return fclose(f) == 0;
+}
+
+/**
+ * runtime_db_update_from_results:
+ * @path: runtime database file
+ * @results_path: results directory with a generated results.json
+ *
+ * Records the runtimes of all tests in the results into the database
+ * at @path, creating it if needed. Tests recorded from @results_path
+ * before, like when igt_resume finishes an interrupted run, are not
+ * recorded again.
+ */
+bool runtime_db_update_from_results(const char *path, const char *results_path)
+{
+	struct json_object *results;
+	struct runtime_db *db;
+	GHashTable *recorded;
+	char *file;
+	bool ret;
+
+	if (asprintf(&file, "%s/results.json", results_path) < 0)
+		return false;
+
+	results = json_object_from_file(file);
+	free(file);
+	if (!results)
+		return false;
+
+	recorded = load_recorded(results_path);
+	db = runtime_db_load(path);
+	ret = add_results(db, results, recorded) &&
+		runtime_db_save(db, path) &&
+		save_recorded(results_path, recorded);
+	runtime_db_free(db);
+	g_hash_table_destroy(recorded);
+	json_object_put(results);
+
+	return ret;
+}
+
+const struct runtime_stats *runtime_db_lookup(struct runtime_db *db, const char *name)
+{
+	struct runtime_entry *entry = g_hash_table_lookup(db->entries, name);
+
+	if (!entry || !entry->stats.samples)
+		return NULL;
+
+	return &entry->stats;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+/*
+ * Nearest-rank 99th percentile of the recent runtimes. Entries from a v1
+ * database only have the moments, so assume a normal distribution for
+ * them, but never go below the highest runtime seen.
+ */
+double runtime_stats_p99(const struct runtime_stats *stats)
+{
+	double sorted[RUNTIME_DB_WINDOW];
+	unsigned int n = stats->recent_count;
+
+	if (!n)
+		return fmax(stats->mean + 2.326 * sqrt(stats->variance),
+			    stats->max);
+
+	memcpy(sorted, stats->recent, n * sizeof(sorted[0]));
+	qsort(sorted, n, sizeof(sorted[0]), cmp_double);
+
+	return sorted[(99 * n + 99) / 100 - 1];
+}
+
+static bool subtest_name_usable(const char *subtest)
+{
+	/* Pruned lists and wildcards don't tell what will be executed */
+	return !strpbrk(subtest, "!*?,");
+}
+
+/**
+ * runtime_db_entry_estimate:
+ * @db: runtime database
+ * @entry: job list entry
+ *
+ * Returns: expected runtime of @entry in seconds, or a negative value
+ * if there's no history for (some of) it.
+ */
+double runtime_db_entry_estimate(struct runtime_db *db,
+				 const struct job_list_entry *entry)
+{
+	const struct runtime_stats *stats;
+	char piglitname[256];
+	double total = 0.0;
+
+	if (!entry->subtest_count) {
+		generate_piglit_name(entry->binary, NULL, piglitname, sizeof(piglitname));
+		stats = runtime_db_lookup(db, piglitname);
+
+		return stats ? stats->mean : -1.0;
+	}
+
+	for (size_t i = 0; i < entry->subtest_count; i++) {
+		if (!subtest_name_usable(entry->subtests[i]))
+			return -1.0;
+
+		generate_piglit_name(entry->binary, entry->subtests[i],
+				     piglitname, sizeof(piglitname));
+		stats = runtime_db_lookup(db, piglitname);
+		if (!stats)
+			return -1.0;
+
+		total += stats->mean;
+	}
+
+	return total;
+}
+
+/**
+ * runtime_db_entry_p99:
+ * @db: runtime database
+ * @entry: job list entry
+ *
+ * Returns: the highest 99th percentile runtime of any single subtest
+ * in @entry, or a negative value if there's no history for (some of)
+ * it.
+ */
+double runtime_db_entry_p99(struct runtime_db *db,
+			    const struct job_list_entry *entry)
+{
+	const struct runtime_stats *stats;
+	struct runtime_entry *binary;
+	char piglitname[256];
+	double p99 = 0.0;
+
+	if (!entry->subtest_count) {
+		generate_piglit_name(entry->binary, NULL, piglitname, sizeof(piglitname));
+		binary = g_hash_table_lookup(db->entries, piglitname);
+		if (!binary)
+			return -1.0;
+
+		/* Binaries without subtests only have their own runtime */
+		if (binary->max_subtest_p99 > 0.0)
+			return binary->max_subtest_p99;
+
+		return binary->stats.samples ? runtime_stats_p99(&binary->stats) : -1.0;
+	}
+
+	for (size_t i = 0; i < entry->subtest_count; i++) {
+		if (!subtest_name_usable(entry->subtests[i]))
+			return -1.0;
+
+		generate_piglit_name(entry->binary, entry->subtests[i],
+				     piglitname, sizeof(piglitname));
+		stats = runtime_db_lookup(db, piglitname);
+		if (!stats)
+			return -1.0;
+
+		p99 = fmax(p99, runtime_stats_p99(stats));
+	}
+
+	return p99;
+}
+
+struct sort_key {
+	double estimate;
+	size_t idx;
+};
+
+static int cmp_longest_first(const void *a, const void *b)
+{
+	const struct sort_key *ka = a, *kb = b;
+	/* Unknown runtimes go first, could be anything */
+	double ea = ka->estimate < 0.0 ? INFINITY : ka->estimate;
+	double eb = kb->estimate < 0.0 ? INFINITY : kb->estimate;
+
+	if (ea != eb)
+		return ea > eb ? -1 : 1;
+
+	return ka->idx < kb->idx ? -1 : ka->idx > kb->idx;
+}
+
+/**
+ * runtime_db_sort_longest_first:
+ * @db: runtime database
+ * @job_list: job list to reorder
+ *
+ * Orders the job list by decreasing expected runtime, keeping the
+ * original relative order of entries with equal (or unknown) runtime.
+ */
+void runtime_db_sort_longest_first(struct runtime_db *db,
+				   struct job_list *job_list)
+{
+	struct job_list_entry *entries;
+	struct sort_key *keys;
+	size_t i;
+
+	if (job_list->size < 2)
+		return;
+
+	keys = calloc(job_list->size, sizeof(*keys));
+	for (i = 0; i < job_list->size; i++) {
+		keys[i].estimate = runtime_db_entry_estimate(db, &job_list->entries[i]);
+		keys[i].idx = i;
+	}
+
+	qsort(keys, job_list->size, sizeof(*keys), cmp_longest_first);
+
+	entries = calloc(job_list->size, sizeof(*entries));
+	for (i = 0; i < job_list->size; i++)
+		entries[i] = job_list->entries[keys[i].idx];
+
+	free(job_list->entries);
+	job_list->entries = entries;
+	free(keys);
+}
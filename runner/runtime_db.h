@@ -0,0 +1,54 @@
+/* SPDX-License-Identifier: MIT
+ * Copyright © 2025 Intel Corporation
+ */
+
+#ifndef RUNNER_RUNTIME_DB_H
+#define RUNNER_RUNTIME_DB_H
+
+#include <stdbool.h>
+
+#include "job_list.h"
+
+struct json_object;
+
+/*
+ * Runtimes of tests from earlier runs, keyed by piglit name. Whole
+ * binaries are tracked as well, as the sum of their subtests.
+ */
+struct runtime_db;
+
+#define RUNTIME_DB_WINDOW 32
+
+/* Tests already recorded from a results directory, one per line */
+#define RUNTIME_DB_RECORDED_FILENAME "runtimes-recorded.txt"
+
+struct runtime_stats {
+	unsigned int samples;
+	double mean;
+	double variance;
+	double max;
+	/* The last runtimes, oldest first, for the percentiles */
+	unsigned int recent_count;
+	double recent[RUNTIME_DB_WINDOW];
+};
+
+struct runtime_db *runtime_db_load(const char *path);
+bool runtime_db_save(struct runtime_db *db, const char *path);
+void runtime_db_free(struct runtime_db *db);
+
+void runtime_db_add_sample(struct runtime_db *db, const char *name, double time);
+bool runtime_db_add_results(struct runtime_db *db, struct json_object *results);
+bool runtime_db_update_from_results(const char *path, const char *results_path);
+
+const struct runtime_stats *runtime_db_lookup(struct runtime_db *db, const char *name);
+double runtime_stats_p99(const struct runtime_stats *stats);
+
+double runtime_db_entry_estimate(struct runtime_db *db,
+				 const struct job_list_entry *entry);
+double runtime_db_entry_p99(struct runtime_db *db,
+			    const struct job_list_entry *entry);
+
+void runtime_db_sort_longest_first(struct runtime_db *db,
+				   struct job_list *job_list);
+
+#endif /* RUNNER_RUNTIME_DB_H */
@@ -35,6 +35,22 @@ enum {
 	OPT_HELP_HOOK,
 	OPT_VERSION,
 	OPT_PRUNE_MODE,
+	OPT_PARALLEL_DEVICES,
+	OPT_EXCLUSIVE,
+	OPT_RUNTIME_DB,
+	OPT_LONGEST_FIRST,
+	OPT_ADAPTIVE_TIMEOUT,
+	OPT_SHARD,
+	OPT_DURABILITY,
+	OPT_FORK_SUBTESTS,
+	OPT_COMMS_RING,
+	OPT_COMPRESS_OUTPUT,
+	OPT_COLLECT_RESOURCES,
+	OPT_DEVICE_SCAN_CACHE,
+	OPT_LIST_CACHE,
+	OPT_LIVE_RESULTS,
+	OPT_LIVE_RESULTS_SOCKET,
+	OPT_MEMORY_BUDGET,
 	OPT_HELP = 'h',
 	OPT_NAME = 'n',
 	OPT_DRY_RUN = 'd',
@@ -142,6 +158,41 @@ static bool set_prune_mode(struct settings* settings, const char *mode)
 	return false;
 }
 
+static bool set_durability(struct settings *settings, const char *level)
+{
+	if (!strcmp(level, "none")) {
+		settings->sync = false;
+		settings->sync_journal = false;
+	} else if (!strcmp(level, "journal")) {
+		settings->sync = false;
+		settings->sync_journal = true;
+	} else if (!strcmp(level, "full")) {
+		settings->sync = true;
+		settings->sync_journal = false;
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+static bool parse_shard(struct settings *settings, const char *arg)
+{
+	int index, count, len = 0;
+
+	if (sscanf(arg, "%d/%d%n", &index, &count, &len) != 2 ||
+	    arg[len] != '\0')
+		return false;
+
+	if (count < 1 || index < 1 || index > count)
+		return false;
+
+	settings->shard_index = index;
+	settings->shard_count = count;
+
+	return true;
+}
+
 static bool parse_abort_conditions(struct settings *settings, const char *optarg)
 {
 	char *dup, *origdup, *p;
@@ -185,7 +236,7 @@ static size_t char_to_multiplier(char c)
 	return 0;
 }
 
-static bool parse_usage_limit(struct settings *settings, const char *optarg)
+static bool parse_size(const char *optarg, size_t *size)
 {
 	size_t value;
 	char *endptr = NULL;
@@ -204,7 +255,7 @@ static bool parse_usage_limit(struct settings *settings, const char *optarg)
 		value *= multiplier;
 	}
 
-	settings->disk_usage_limit = value;
+	*size = value;
 	return true;
 }
 
@@ -244,7 +295,20 @@ static const char *usage_str =
 	"                         once - The default is to run one kmemleak\n"
 	"                                scan after the last test\n"
 	"                         each - Run one kmemleak scan after each test\n"
+	"                         background - Like each, but scan in the\n"
+	"                                background while the next test\n"
+	"                                starts\n"
 	"  -s, --sync            Sync results to disk after every test\n"
+	"                        (same as --durability=full)\n"
+	"  --durability <level>  How much of the test output survives a crash of\n"
+	"                        the machine:\n"
+	"                         none    - Leave writeback to the kernel (default)\n"
+	"                         journal - Sync the test journal and comms at every\n"
+	"                                   subtest start and result in the background,\n"
+	"                                   enough for resuming after a crash. Bulk\n"
+	"                                   output is written back lazily\n"
+	"                         full    - Sync all output synchronously, same as\n"
+	"                                   --sync\n"
 	"  -l {quiet,verbose,dummy}, --log-level {quiet,verbose,dummy}\n"
 	"                        Set the logger verbosity level\n"
 	"  --test-list TEST_LIST\n"
@@ -260,6 +324,11 @@ static const char *usage_str =
 	"                        binary. Note that in that case relative ordering of the\n"
 	"                        subtest execution is dictated by the test binary, not\n"
 	"                        the testlist\n"
+	"  --fork-subtests       Like --multiple-mode, but the test binary runs its\n"
+	"                        global setup once and forks a fresh process for\n"
+	"                        every subtest, so a crash or leaked state in one\n"
+	"                        subtest cannot affect the next. Implies\n"
+	"                        --multiple-mode\n"
 	"  --inactivity-timeout <seconds>\n"
 	"                        Kill the running test after <seconds> of inactivity in\n"
 	"                        the test's stdout, stderr, or dmesg\n"
@@ -274,6 +343,14 @@ static const char *usage_str =
 	"                        kernel logs, exceed the given limit in bytes. The limit\n"
 	"                        parameter can use suffixes k, M and G for kilo/mega/gigabytes,\n"
 	"                        respectively. Limit of 0 (default) disables the limit.\n"
+	"  --memory-budget <limit>\n"
+	"                        Run each test in its own cgroup v2 child, throttled\n"
+	"                        and reclaimed from beyond <limit> bytes of memory and\n"
+	"                        OOM-killed beyond 5/4 of it. The limit can use the\n"
+	"                        suffixes k, M and G. Tests size their working sets to\n"
+	"                        the budget through igt_get_avail_ram_mb(). Implies\n"
+	"                        --collect-resources, which records the time each test\n"
+	"                        and subtest stalled on memory\n"
 	"  --use-watchdog        Use hardware watchdog for lethal enforcement of the\n"
 	"                        above timeout. Killing the test process is still\n"
 	"                        attempted at timeout trigger.\n"
@@ -282,6 +359,32 @@ static const char *usage_str =
 	"                        to the given one will override the test result to\n"
 	"                        dmesg-warn/dmesg-fail, assuming they go through filtering.\n"
 	"                        Defaults to 4 (KERN_WARNING).\n"
+	"  --compress-output     Write out.txt, err.txt and dmesg.txt gzip compressed,\n"
+	"                        as out.txt.gz etc. The disk usage limit applies\n"
+	"                        to the compressed size\n"
+	"  --comms-ring          Pass structured test output through a shared memory\n"
+	"                        ring instead of a socket write per message. The\n"
+	"                        written comms file is the same either way\n"
+	"  --collect-resources   Record CPU time, peak memory, time stalled on memory,\n"
+	"                        i915 and xe GPU engine busyness, package, GPU and\n"
+	"                        card energy with the average power, and the amount\n"
+	"                        of kernel log of each test and subtest in the results\n"
+	"  --device-scan-cache   Scan the devices once and have the tests load the\n"
+	"                        device list from a cache file instead of scanning\n"
+	"                        udev again. The cache is dropped as soon as udev\n"
+	"                        reports a drm or pci device change\n"
+	"  --list-cache DIRECTORY\n"
+	"                        Keep the subtest lists of the test binaries in\n"
+	"                        DIRECTORY, so that building the job list only runs\n"
+	"                        --list-subtests for binaries which changed\n"
+	"  --live-results        Append a JSON record for every subtest and dynamic\n"
+	"                        subtest to results.ndjson in the results directory\n"
+	"                        as soon as it completes, with its result, runtime,\n"
+	"                        the number of unfiltered kernel log warnings and,\n"
+	"                        with --collect-resources, its resource usage\n"
+	"  --live-results-socket PATH\n"
+	"                        Also send every live result record as a datagram\n"
+	"                        to the unix socket PATH. Implies --live-results\n"
 	"  --piglit-style-dmesg  Filter dmesg like piglit does. Piglit considers matches\n"
 	"                        against a short filter list to mean the test result\n"
 	"                        should be changed to dmesg-warn/dmesg-fail. Without\n"
@@ -302,6 +405,37 @@ static const char *usage_str =
 	"                                                  not in the requested test set.\n"
 	"                                                  Useful when you have a hand-written\n"
 	"                                                  testlist.\n"
+	"  --parallel-devices <filter>\n"
+	"                        Run tests concurrently, one at a time on each device\n"
+	"                        matching the given device filter, for example\n"
+	"                        pci:vendor=8086,card=all. Each test gets IGT_DEVICE\n"
+	"                        set to the device it runs on. Incompatible with\n"
+	"                        --facts, --kmemleak=each and --coverage-per-test.\n"
+	"  --exclusive-tests <regex>\n"
+	"                        With --parallel-devices, run tests matching the regex\n"
+	"                        alone, with no other tests executing concurrently and\n"
+	"                        with access to all devices (can be used more than once)\n"
+	"  --runtime-db FILENAME\n"
+	"                        Keep a database of test runtimes in FILENAME. The\n"
+	"                        runtimes of this run are added to it when the results\n"
+	"                        are generated. With --overall-timeout, a test that is\n"
+	"                        predicted not to finish in the remaining time is not\n"
+	"                        started.\n"
+	"  --longest-first       Execute tests in order of decreasing expected runtime\n"
+	"                        according to --runtime-db. Tests without history are\n"
+	"                        executed first.\n"
+	"  --adaptive-timeout <factor>\n"
+	"                        Set the per-test timeout of each test to <factor> times\n"
+	"                        its 99th percentile runtime according to --runtime-db,\n"
+	"                        but at least 30 seconds. --per-test-timeout, if given,\n"
+	"                        is used as the upper limit and for tests without history.\n"
+	"  --shard <i>/<n>       Split the job list into <n> shards of roughly equal\n"
+	"                        expected runtime and only execute shard <i>, counting\n"
+	"                        from 1. Runtimes come from --runtime-db, falling back\n"
+	"                        to the number of subtests. Every machine running a\n"
+	"                        shard must use the same test list and runtime\n"
+	"                        database to get a consistent partition. Use\n"
+	"                        igt_merge_results to combine the results.\n"
 	"  -b, --blacklist FILENAME\n"
 	"                        Exclude all test matching to regexes from FILENAME\n"
 	"                        (can be used more than once)\n"
@@ -664,9 +798,14 @@ void clear_settings(struct settings *settings)
 	free(settings->test_root);
 	free(settings->results_path);
 	free(settings->code_coverage_script);
+	free(settings->parallel_devices);
+	free(settings->runtime_db);
+	free(settings->list_cache);
+	free(settings->live_results_socket);
 
 	free_regexes(&settings->include_regexes);
 	free_regexes(&settings->exclude_regexes);
+	free_regexes(&settings->exclusive_regexes);
 	free_env_vars(&settings->env_vars);
 	free_hook_strs(&settings->hook_strs);
 	free_array_deep((void **)settings->cmdline.argv, settings->cmdline.argc);
@@ -692,6 +831,7 @@ bool parse_options(int argc, char **argv,
 		{"environment", required_argument, NULL, OPT_ENVIRONMENT},
 		{"abort-on-monitored-error", optional_argument, NULL, OPT_ABORT_ON_ERROR},
 		{"disk-usage-limit", required_argument, NULL, OPT_DISK_USAGE_LIMIT},
+		{"memory-budget", required_argument, NULL, OPT_MEMORY_BUDGET},
 		{"facts", no_argument, NULL, OPT_FACTS},
 		{"kmemleak", optional_argument, NULL, OPT_KMEMLEAK},
 		{"sync", no_argument, NULL, OPT_SYNC},
@@ -714,6 +854,21 @@ bool parse_options(int argc, char **argv,
 		{"prune-mode", required_argument, NULL, OPT_PRUNE_MODE},
 		{"blacklist", required_argument, NULL, OPT_BLACKLIST},
 		{"list-all", no_argument, NULL, OPT_LIST_ALL},
+		{"parallel-devices", required_argument, NULL, OPT_PARALLEL_DEVICES},
+		{"exclusive-tests", required_argument, NULL, OPT_EXCLUSIVE},
+		{"runtime-db", required_argument, NULL, OPT_RUNTIME_DB},
+		{"longest-first", no_argument, NULL, OPT_LONGEST_FIRST},
+		{"adaptive-timeout", required_argument, NULL, OPT_ADAPTIVE_TIMEOUT},
+		{"shard", required_argument, NULL, OPT_SHARD},
+		{"durability", required_argument, NULL, OPT_DURABILITY},
+		{"fork-subtests", no_argument, NULL, OPT_FORK_SUBTESTS},
+		{"comms-ring", no_argument, NULL, OPT_COMMS_RING},
+		{"compress-output", no_argument, NULL, OPT_COMPRESS_OUTPUT},
+		{"collect-resources", no_argument, NULL, OPT_COLLECT_RESOURCES},
+		{"device-scan-cache", no_argument, NULL, OPT_DEVICE_SCAN_CACHE},
+		{"list-cache", required_argument, NULL, OPT_LIST_CACHE},
+		{"live-results", no_argument, NULL, OPT_LIVE_RESULTS},
+		{"live-results-socket", required_argument, NULL, OPT_LIVE_RESULTS_SOCKET},
 		{ 0, 0, 0, 0},
 	};
 
@@ -760,11 +915,19 @@ bool parse_options(int argc, char **argv,
 				goto error;
 			break;
 		case OPT_DISK_USAGE_LIMIT:
-			if (!parse_usage_limit(settings, optarg)) {
+			if (!parse_size(optarg, &settings->disk_usage_limit)) {
 				usage(stderr, "Cannot parse disk usage limit");
 				goto error;
 			}
 			break;
+		case OPT_MEMORY_BUDGET:
+			if (!parse_size(optarg, &settings->memory_budget) ||
+			    !settings->memory_budget) {
+				usage(stderr, "Cannot parse memory budget");
+				goto error;
+			}
+			settings->collect_resources = true;
+			break;
 		case OPT_FACTS:
 			settings->facts = true;
 			break;
@@ -772,9 +935,13 @@ bool parse_options(int argc, char **argv,
 			/* The default is once */
 			settings->kmemleak = true;
 			settings->kmemleak_each = false;
+			settings->kmemleak_background = false;
 			if (optarg) {
 				if (strcmp(optarg, "each") == 0) {
 					settings->kmemleak_each = true;
+				} else if (strcmp(optarg, "background") == 0) {
+					settings->kmemleak_each = true;
+					settings->kmemleak_background = true;
 				/* "once" is the default. No action needed */
 				} else if (strcmp(optarg, "once") != 0) {
 					usage(stderr, "Invalid kmemleak option");
@@ -818,6 +985,10 @@ bool parse_options(int argc, char **argv,
 		case OPT_MULTIPLE:
 			settings->multiple_mode = true;
 			break;
+		case OPT_FORK_SUBTESTS:
+			settings->fork_subtests = true;
+			settings->multiple_mode = true;
+			break;
 		case OPT_TIMEOUT:
 			settings->inactivity_timeout = atoi(optarg);
 			break;
@@ -830,6 +1001,30 @@ bool parse_options(int argc, char **argv,
 		case OPT_WATCHDOG:
 			settings->use_watchdog = true;
 			break;
+		case OPT_COMMS_RING:
+			settings->comms_ring = true;
+			break;
+		case OPT_COMPRESS_OUTPUT:
+			settings->compress_output = true;
+			break;
+		case OPT_COLLECT_RESOURCES:
+			settings->collect_resources = true;
+			break;
+		case OPT_DEVICE_SCAN_CACHE:
+			settings->device_scan_cache = true;
+			break;
+		case OPT_LIST_CACHE:
+			free(settings->list_cache);
+			settings->list_cache = absolute_path(optarg);
+			break;
+		case OPT_LIVE_RESULTS:
+			settings->live_results = true;
+			break;
+		case OPT_LIVE_RESULTS_SOCKET:
+			free(settings->live_results_socket);
+			settings->live_results_socket = absolute_path(optarg);
+			settings->live_results = true;
+			break;
 		case OPT_PIGLIT_DMESG:
 			settings->piglit_style_dmesg = true;
 			if (settings->dmesg_warn_level < 0)
@@ -852,6 +1047,36 @@ bool parse_options(int argc, char **argv,
 		case OPT_LIST_ALL:
 			settings->list_all = true;
 			break;
+		case OPT_PARALLEL_DEVICES:
+			free(settings->parallel_devices);
+			settings->parallel_devices = strdup(optarg);
+			break;
+		case OPT_EXCLUSIVE:
+			if (!add_regex(&settings->exclusive_regexes, strdup(optarg)))
+				goto error;
+			break;
+		case OPT_RUNTIME_DB:
+			free(settings->runtime_db);
+			settings->runtime_db = absolute_path(optarg);
+			break;
+		case OPT_LONGEST_FIRST:
+			settings->longest_first = true;
+			break;
+		case OPT_ADAPTIVE_TIMEOUT:
+			settings->adaptive_timeout = atoi(optarg);
+			break;
+		case OPT_DURABILITY:
+			if (!set_durability(settings, optarg)) {
+				usage(stderr, "Cannot parse durability level");
+				goto error;
+			}
+			break;
+		case OPT_SHARD:
+			if (!parse_shard(settings, optarg)) {
+				usage(stderr, "Cannot parse shard, expected <i>/<n>");
+				goto error;
+			}
+			break;
 		case '?':
 			usage(stderr, NULL);
 			goto error;
@@ -966,6 +1191,19 @@ bool validate_settings(struct settings *settings)
 	close(fd);
 	close(dirfd);
 
+	if (settings->parallel_devices &&
+	    (settings->facts || settings->kmemleak_each ||
+	     settings->cov_results_per_test)) {
+		usage(stderr, "--parallel-devices cannot be combined with per-test facts, kmemleak or code coverage");
+		return false;
+	}
+
+	if ((settings->longest_first || settings->adaptive_timeout) &&
+	    !settings->runtime_db) {
+		usage(stderr, "--longest-first and --adaptive-timeout require --runtime-db");
+		return false;
+	}
+
 	/* enables code coverage when --coverage-per-test is used */
 	if (settings->cov_results_per_test)
 		settings->enable_code_coverage = true;
@@ -1228,6 +1466,7 @@ bool serialize_settings(struct settings *settings)
 
 	SERIALIZE_INT(f, settings, abort_mask);
 	SERIALIZE_UL(f, settings, disk_usage_limit);
+	SERIALIZE_UL(f, settings, memory_budget);
 	if (settings->test_list)
 		SERIALIZE_STR(f, settings, test_list);
 	if (settings->name)
@@ -1237,15 +1476,25 @@ bool serialize_settings(struct settings *settings)
 	SERIALIZE_INT(f, settings, facts);
 	SERIALIZE_INT(f, settings, kmemleak);
 	SERIALIZE_INT(f, settings, kmemleak_each);
+	SERIALIZE_INT(f, settings, kmemleak_background);
 	SERIALIZE_INT(f, settings, sync);
+	SERIALIZE_INT(f, settings, sync_journal);
 	SERIALIZE_INT(f, settings, log_level);
 	SERIALIZE_INT(f, settings, overwrite);
 	SERIALIZE_INT(f, settings, multiple_mode);
+	SERIALIZE_INT(f, settings, fork_subtests);
 	SERIALIZE_INT(f, settings, inactivity_timeout);
 	SERIALIZE_INT(f, settings, per_test_timeout);
 	SERIALIZE_INT(f, settings, overall_timeout);
 	SERIALIZE_INT(f, settings, use_watchdog);
 	SERIALIZE_INT(f, settings, piglit_style_dmesg);
+	SERIALIZE_INT(f, settings, comms_ring);
+	SERIALIZE_INT(f, settings, compress_output);
+	SERIALIZE_INT(f, settings, collect_resources);
+	SERIALIZE_INT(f, settings, device_scan_cache);
+	SERIALIZE_STR(f, settings, list_cache);
+	SERIALIZE_INT(f, settings, live_results);
+	SERIALIZE_STR(f, settings, live_results_socket);
 	SERIALIZE_INT(f, settings, dmesg_warn_level);
 	SERIALIZE_INT(f, settings, prune_mode);
 	SERIALIZE_STR(f, settings, test_root);
@@ -1253,6 +1502,12 @@ bool serialize_settings(struct settings *settings)
 	SERIALIZE_INT(f, settings, enable_code_coverage);
 	SERIALIZE_INT(f, settings, cov_results_per_test);
 	SERIALIZE_STR(f, settings, code_coverage_script);
+	SERIALIZE_STR(f, settings, parallel_devices);
+	SERIALIZE_STR(f, settings, runtime_db);
+	SERIALIZE_INT(f, settings, longest_first);
+	SERIALIZE_INT(f, settings, adaptive_timeout);
+	SERIALIZE_INT(f, settings, shard_index);
+	SERIALIZE_INT(f, settings, shard_count);
 	SERIALIZE_STR_ARRAY(f, settings, cmdline.argv, cmdline.argc);
 
 	if (settings->sync) {
@@ -1348,6 +1603,7 @@ bool read_settings_from_file(struct settings *settings, FILE *f)
 	while (fscanf(f, "%ms : %m[^\n]", &name, &val) == 2) {
 		PARSE_INT(settings, name, val, abort_mask);
 		PARSE_UL(settings, name, val, disk_usage_limit);
+		PARSE_UL(settings, name, val, memory_budget);
 		PARSE_STR(settings, name, val, test_list);
 		PARSE_STR(settings, name, val, name);
 		PARSE_INT(settings, name, val, dry_run);
@@ -1355,15 +1611,25 @@ bool read_settings_from_file(struct settings *settings, FILE *f)
 		PARSE_INT(settings, name, val, facts);
 		PARSE_INT(settings, name, val, kmemleak);
 		PARSE_INT(settings, name, val, kmemleak_each);
+		PARSE_INT(settings, name, val, kmemleak_background);
 		PARSE_INT(settings, name, val, sync);
+		PARSE_INT(settings, name, val, sync_journal);
 		PARSE_INT(settings, name, val, log_level);
 		PARSE_INT(settings, name, val, overwrite);
 		PARSE_INT(settings, name, val, multiple_mode);
+		PARSE_INT(settings, name, val, fork_subtests);
 		PARSE_INT(settings, name, val, inactivity_timeout);
 		PARSE_INT(settings, name, val, per_test_timeout);
 		PARSE_INT(settings, name, val, overall_timeout);
 		PARSE_INT(settings, name, val, use_watchdog);
 		PARSE_INT(settings, name, val, piglit_style_dmesg);
+		PARSE_INT(settings, name, val, comms_ring);
+		PARSE_INT(settings, name, val, compress_output);
+		PARSE_INT(settings, name, val, collect_resources);
+		PARSE_INT(settings, name, val, device_scan_cache);
+		PARSE_STR(settings, name, val, list_cache);
+		PARSE_INT(settings, name, val, live_results);
+		PARSE_STR(settings, name, val, live_results_socket);
 		PARSE_INT(settings, name, val, dmesg_warn_level);
 		PARSE_INT(settings, name, val, prune_mode);
 		PARSE_STR(settings, name, val, test_root);
@@ -1371,6 +1637,12 @@ bool read_settings_from_file(struct settings *settings, FILE *f)
 		PARSE_INT(settings, name, val, enable_code_coverage);
 		PARSE_INT(settings, name, val, cov_results_per_test);
 		PARSE_STR(settings, name, val, code_coverage_script);
+		PARSE_STR(settings, name, val, parallel_devices);
+		PARSE_STR(settings, name, val, runtime_db);
+		PARSE_INT(settings, name, val, longest_first);
+		PARSE_INT(settings, name, val, adaptive_timeout);
+		PARSE_INT(settings, name, val, shard_index);
+		PARSE_INT(settings, name, val, shard_count);
 		PARSE_STR_ARRAY(settings, name, val, cmdline.argv, cmdline.argc);
 
 		printf("Warning: Unknown field in settings file: %s = %s\n",
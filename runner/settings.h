@@ -53,21 +53,26 @@ struct environment_variable {
 struct settings {
 	int abort_mask;
 	size_t disk_usage_limit;
+	size_t memory_budget;
 	char *test_list;
 	char *name;
 	bool dry_run;
 	bool allow_non_root;
 	struct regex_list include_regexes;
 	struct regex_list exclude_regexes;
+	struct regex_list exclusive_regexes;
 	struct igt_list_head env_vars;
 	struct igt_vec hook_strs;
 	bool facts;
 	bool kmemleak;
 	bool kmemleak_each;
+	bool kmemleak_background;
 	bool sync;
+	bool sync_journal;
 	int log_level;
 	bool overwrite;
 	bool multiple_mode;
+	bool fork_subtests;
 	int inactivity_timeout;
 	int per_test_timeout;
 	int overall_timeout;
@@ -75,12 +80,25 @@ struct settings {
 	char *test_root;
 	char *results_path;
 	bool piglit_style_dmesg;
+	bool comms_ring;
+	bool compress_output;
+	bool collect_resources;
+	bool device_scan_cache;
+	char *list_cache;
+	bool live_results;
+	char *live_results_socket;
 	int dmesg_warn_level;
 	int prune_mode;
 	bool list_all;
 	char *code_coverage_script;
 	bool enable_code_coverage;
 	bool cov_results_per_test;
+	char *parallel_devices;
+	char *runtime_db;
+	bool longest_first;
+	int adaptive_timeout;
+	int shard_index;
+	int shard_count;
 	struct {
 		int argc;
 		char **argv;
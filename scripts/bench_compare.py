@@ -0,0 +1,248 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: MIT
+#
+# Copyright © 2024 Intel Corporation
+
+"""Compare benchmark results written with the igt_bench --json option.
+
+The first file is the baseline, every further file is compared against it.
+Results are matched by benchmark and result name, and the repetitions of
+each are compared with a two-sided Mann-Whitney U test, which makes no
+assumption about the distribution of the samples. The effect size is given
+as the relative change of the median, with a bootstrap confidence interval,
+and as Cliff's delta.
+
+Exits with 1 if any significant regression was found, so the script can
+gate a kernel update directly, e.g.:
+
+  gem_create -s 4096 --json=before.json
+  <update kernel>
+  gem_create -s 4096 --json=after.json
+  bench_compare.py before.json after.json
+"""
+
+import argparse
+import json
+import math
+import random
+import sys
+
+LOWER_IS_BETTER_UNITS = ('s', 'ms', 'us', 'ns')
+
+
+def load(path):
+    """Returns {(benchmark, name): result} and the environment of a run."""
+    with open(path) as f:
+        data = json.load(f)
+
+    results = {}
+    for result in data.get('results', []):
+        results[(data['benchmark'], result['name'])] = result
+
+    return results, data.get('environment', {})
+
+
+def median(values):
+    values = sorted(values)
+    n = len(values)
+    if n % 2:
+        return values[n // 2]
+    return (values[n // 2 - 1] + values[n // 2]) / 2
+
+
+def mann_whitney(a, b):
+    """Returns U of a and the two-sided p-value of the Mann-Whitney U test."""
+    n1, n2 = len(a), len(b)
+    pooled = sorted([(v, 0) for v in a] + [(v, 1) for v in b])
+
+    # Average ranks across ties
+    ranks = [0.0] * len(pooled)
+    ties = []
+    i = 0
+    while i < len(pooled):
+        j = i
+        while j + 1 < len(pooled) and pooled[j + 1][0] == pooled[i][0]:
+            j += 1
+        for k in range(i, j + 1):
+            ranks[k] = (i + j) / 2 + 1
+        if j > i:
+            ties.append(j - i + 1)
+        i = j + 1
+
+    r1 = sum(r for r, (_, side) in zip(ranks, pooled) if side == 0)
+    u1 = r1 - n1 * (n1 + 1) / 2
+    u = min(u1, n1 * n2 - u1)
+
+    if not ties and n1 + n2 <= 50:
+        # Exact distribution: counts[k] is the number of orderings with U == k
+        counts = exact_u_counts(n1, n2)
+        total = sum(counts)
+        p = 2 * sum(counts[:int(u) + 1]) / total
+        return u1, min(p, 1.0)
+
+    n = n1 + n2
+    mu = n1 * n2 / 2
+    tie_term = sum(t ** 3 - t for t in ties) / (n * (n - 1))
+    sigma = math.sqrt(n1 * n2 / 12 * ((n + 1) - tie_term))
+    if sigma == 0:
+        return u1, 1.0
+
+    z = (abs(u1 - mu) - 0.5) / sigma
+    p = math.erfc(max(z, 0) / math.sqrt(2))
+    return u1, min(p, 1.0)
+
+
+def exact_u_counts(n1, n2):
+    """Number of rank orderings of n1 and n2 samples giving each U."""
+    # f[i][j] is the list of counts for i samples from a and j from b
+    f = [[None] * (n2 + 1) for _ in range(n1 + 1)]
+    for i in range(n1 + 1):
+        for j in range(n2 + 1):
+            if i == 0 or j == 0:
+                f[i][j] = [1]
+                continue
+            # The largest value is either from a, beating all j of b,
+            # or from b, beating none of a
+            with_a = [0] * j + f[i - 1][j]
+            with_b = f[i][j - 1]
+            size = max(len(with_a), len(with_b))
+            f[i][j] = [(with_a[k] if k < len(with_a) else 0) +
+                       (with_b[k] if k < len(with_b) else 0)
+                       for k in range(size)]
+    return f[n1][n2]
+
+
+def bootstrap_ci(a, b, iterations, rng):
+    """95% confidence interval of the relative change of the median."""
+    changes = []
+    for _ in range(iterations):
+        ma = median(rng.choices(a, k=len(a)))
+        mb = median(rng.choices(b, k=len(b)))
+        if ma:
+            changes.append((mb - ma) / ma)
+    if not changes:
+        return float('nan'), float('nan')
+
+    changes.sort()
+    lo = changes[int(0.025 * (len(changes) - 1))]
+    hi = changes[int(0.975 * (len(changes) - 1))]
+    return lo, hi
+
+
+def compare(base, cand, args, rng):
+    a = base['samples']
+    b = cand['samples']
+
+    if len(a) < 2 or len(b) < 2:
+        return None
+
+    u1, p = mann_whitney(a, b)
+    ma, mb = median(a), median(b)
+    change = (mb - ma) / ma if ma else float('nan')
+    lo, hi = bootstrap_ci(a, b, args.bootstrap, rng)
+    # Cliff's delta, positive when the candidate tends to be larger
+    delta = 1 - 2 * u1 / (len(a) * len(b))
+
+    better = change
+    if base.get('unit') in LOWER_IS_BETTER_UNITS:
+        better = -change
+
+    if p < args.alpha and abs(change) * 100 >= args.threshold:
+        verdict = 'regression' if better < 0 else 'improvement'
+    else:
+        verdict = 'unchanged'
+
+    return {
+        'baseline_median': ma,
+        'candidate_median': mb,
+        'unit': base.get('unit', ''),
+        'change': change,
+        'change_ci95': [lo, hi],
+        'cliffs_delta': delta,
+        'p_value': p,
+        'verdict': verdict,
+    }
+
+
+def check_environment(base_env, env, path):
+    """Warns about differences that make results incomparable."""
+    for key in ('devid', 'gpu_max_freq_mhz', 'cpu_governor', 'cpus'):
+        if key in base_env and key in env and base_env[key] != env[key]:
+            print('%s: %s differs from the baseline (%s vs %s)' %
+                  (path, key, env[key], base_env[key]), file=sys.stderr)
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description=__doc__,
+        formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('baseline', help='JSON results of the baseline run')
+    parser.add_argument('candidates', nargs='+',
+                        help='JSON results of the runs to compare')
+    parser.add_argument('-a', '--alpha', type=float, default=0.05,
+                        help='significance level (default: %(default)s)')
+    parser.add_argument('-t', '--threshold', type=float, default=0,
+                        help='ignore significant changes of the median '
+                             'smaller than this many percent '
+                             '(default: %(default)s)')
+    parser.add_argument('-b', '--bootstrap', type=int, default=2000,
+                        help='bootstrap resamples for the confidence '
+                             'interval (default: %(default)s)')
+    parser.add_argument('-s', '--seed', type=int, default=0,
+                        help='seed of the bootstrap (default: %(default)s)')
+    parser.add_argument('-j', '--json', metavar='FILE',
+                        help='also write the report as JSON')
+    args = parser.parse_args()
+
+    rng = random.Random(args.seed)
+    base, base_env = load(args.baseline)
+    report = []
+    regressions = 0
+
+    for path in args.candidates:
+        cand, env = load(path)
+        check_environment(base_env, env, path)
+
+        print('%s vs %s' % (path, args.baseline))
+        print('  %-40s %14s %14s %8s %18s %6s %8s  %s' %
+              ('metric', 'baseline', 'candidate', 'change', '95% ci',
+               'delta', 'p', 'verdict'))
+
+        for key in sorted(set(base) | set(cand)):
+            name = '%s/%s' % key
+            if key not in base or key not in cand:
+                print('  %-40s missing from %s' %
+                      (name, args.baseline if key not in base else path))
+                continue
+
+            r = compare(base[key], cand[key], args, rng)
+            if r is None:
+                print('  %-40s too few samples' % name)
+                continue
+
+            if r['verdict'] == 'regression':
+                regressions += 1
+
+            print('  %-40s %14.3f %14.3f %+7.2f%% [%+6.2f%%, %+6.2f%%] '
+                  '%+6.2f %8.4f  %s' %
+                  (name, r['baseline_median'], r['candidate_median'],
+                   r['change'] * 100, r['change_ci95'][0] * 100,
+                   r['change_ci95'][1] * 100, r['cliffs_delta'],
+                   r['p_value'], r['verdict']))
+
+            r.update({'candidate': path, 'benchmark': key[0],
+                      'name': key[1]})
+            report.append(r)
+
+    if args.json:
+        with open(args.json, 'w') as f:
+            json.dump({'baseline': args.baseline, 'alpha': args.alpha,
+                       'threshold': args.threshold, 'results': report},
+                      f, indent=2)
+            f.write('\n')
+
+    return 1 if regressions else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -745,6 +745,28 @@ igt_main
 		}
 	}
 
+	igt_describe("Check-pipelined-multi-IB-submissions-on-every-ring-and-report-their-throughput");
+	igt_subtest_with_dynamic("cs-pipelined") {
+		if (arr_cap[AMD_IP_GFX]) {
+			igt_dynamic_f("cs-gfx")
+			amdgpu_command_submission_pipelined_helper(device,
+								   get_ip_block(device, AMDGPU_HW_IP_GFX),
+								   4, 8, 1024);
+		}
+		if (arr_cap[AMD_IP_COMPUTE]) {
+			igt_dynamic_f("cs-compute")
+			amdgpu_command_submission_pipelined_helper(device,
+								   get_ip_block(device, AMDGPU_HW_IP_COMPUTE),
+								   4, 8, 1024);
+		}
+		if (arr_cap[AMD_IP_DMA]) {
+			igt_dynamic_f("cs-sdma")
+			amdgpu_command_submission_pipelined_helper(device,
+								   get_ip_block(device, AMDGPU_HW_IP_DMA),
+								   4, 8, 1024);
+		}
+	}
+
 	igt_describe("Check-signal-semaphore-on-DMA-wait-on-GFX");
 	igt_subtest_with_dynamic("semaphore-with-IP-GFX-and-IP-DMA") {
 		if (arr_cap[AMD_IP_GFX] && arr_cap[AMD_IP_DMA]) {
@@ -175,6 +175,18 @@ igt_main
 		}
 	}
 
+	igt_describe("Run memset and memcpy dispatches on all compute rings at once and report the bandwidth");
+	igt_subtest_with_dynamic("amdgpu-dispatch-concurrent-with-IP-COMPUTE") {
+		if (arr_cap[AMD_IP_COMPUTE]) {
+			igt_dynamic_f("memset")
+			amdgpu_dispatch_concurrent_test(device, AMDGPU_HW_IP_COMPUTE,
+							false, 1024 * 1024, 256, false);
+			igt_dynamic_f("memcpy")
+			amdgpu_dispatch_concurrent_test(device, AMDGPU_HW_IP_COMPUTE,
+							true, 1024 * 1024, 256, false);
+		}
+	}
+
 	igt_describe("Test GPU reset using amdgpu debugfs to hang the job on gfx ring");
 	igt_subtest_with_dynamic("amdgpu-reset-test-gfx-with-IP-GFX-and-COMPUTE") {
 		if (arr_cap[AMD_IP_GFX] && arr_cap[AMD_IP_COMPUTE]) {
@@ -215,6 +227,18 @@ igt_main
 		}
 	}
 
+	igt_describe("Run memset and memcpy dispatches on all compute user queues at once and report the bandwidth");
+	igt_subtest_with_dynamic("amdgpu-dispatch-concurrent-with-IP-COMPUTE-UMQ") {
+		if (enable_test && userq_arr_cap[AMD_IP_COMPUTE]) {
+			igt_dynamic_f("memset-umq")
+			amdgpu_dispatch_concurrent_test(device, AMDGPU_HW_IP_COMPUTE,
+							false, 1024 * 1024, 256, true);
+			igt_dynamic_f("memcpy-umq")
+			amdgpu_dispatch_concurrent_test(device, AMDGPU_HW_IP_COMPUTE,
+							true, 1024 * 1024, 256, true);
+		}
+	}
+
 	igt_fixture {
 		amdgpu_device_deinitialize(device);
 		drm_close_driver(fd);
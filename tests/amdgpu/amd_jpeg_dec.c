@@ -217,6 +217,87 @@ amdgpu_cs_jpeg_decode(amdgpu_device_handle device_handle,
 	mmd_context_clean(device_handle, context);
 }
 
+static void
+jpeg_session_prepare(amdgpu_device_handle device_handle,
+		struct mmd_session *session)
+{
+	struct mmd_shared_context *shared_context = session->data;
+	struct mmd_context *context = &session->context;
+	struct amdgpu_mmd_bo *dec_buf;
+	int size = 32 * 1024; /* 8K bitstream + 24K output */
+	uint32_t idx = 0;
+	int r;
+
+	dec_buf = calloc(1, sizeof(*dec_buf));
+	igt_assert(dec_buf);
+	session->priv = dec_buf;
+
+	context->num_resources = 0;
+	alloc_resource(device_handle, dec_buf, size, AMDGPU_GEM_DOMAIN_VRAM);
+	context->resources[context->num_resources++] = dec_buf->handle;
+	context->resources[context->num_resources++] = context->ib_handle;
+	r = amdgpu_bo_cpu_map(dec_buf->handle, (void **)&dec_buf->ptr);
+	igt_assert_eq(r, 0);
+	memcpy(dec_buf->ptr, jpeg_bitstream, sizeof(jpeg_bitstream));
+	amdgpu_bo_cpu_unmap(dec_buf->handle);
+
+	if (shared_context->jpeg_direct_reg == true) {
+		send_cmd_bitstream_direct(context, dec_buf->addr, &idx);
+		send_cmd_target_direct(context, dec_buf->addr + (size / 4), &idx);
+	} else {
+		send_cmd_bitstream(context, dec_buf->addr, &idx);
+		send_cmd_target(context, dec_buf->addr + (size / 4), &idx);
+	}
+	session->ndw = idx;
+}
+
+static void
+jpeg_session_cleanup(amdgpu_device_handle device_handle,
+		struct mmd_session *session)
+{
+	struct amdgpu_mmd_bo *dec_buf = session->priv;
+	int size = 32 * 1024;
+	int sum = 0, i, j, r;
+	uint8_t *dec;
+
+	r = amdgpu_bo_cpu_map(dec_buf->handle, (void **)&dec_buf->ptr);
+	igt_assert_eq(r, 0);
+
+	dec = dec_buf->ptr + (size / 4);
+	for (i = 0; i < WIDTH; i++)
+		for (j = 0; j < WIDTH; j++)
+			sum += *((dec + JPEG_DEC_LUMA_OFFSET + i * JPEG_DEC_DT_PITCH) + j);
+	for (i = 0; i < (WIDTH/2); i++)
+		for (j = 0; j < WIDTH; j++)
+			sum += *((dec + JPEG_DEC_CHROMA_OFFSET + i * JPEG_DEC_DT_PITCH) + j);
+
+	amdgpu_bo_cpu_unmap(dec_buf->handle);
+	igt_assert_eq(sum, JPEG_DEC_SUM);
+
+	free_resource(dec_buf);
+	free(dec_buf);
+}
+
+/* Scales the number of concurrent decode sessions up to 4 per instance */
+static void
+amdgpu_cs_jpeg_decode_throughput(amdgpu_device_handle device_handle,
+		struct mmd_shared_context *shared_context)
+{
+	struct drm_amdgpu_info_hw_ip info;
+	unsigned int num_sessions, max_sessions;
+	int r;
+
+	r = amdgpu_query_hw_ip_info(device_handle, AMDGPU_HW_IP_VCN_JPEG, 0, &info);
+	igt_assert_eq(r, 0);
+	max_sessions = 4 * __builtin_popcount(info.available_rings);
+
+	for (num_sessions = 1; num_sessions <= max_sessions; num_sessions *= 2)
+		mmd_sessions_throughput(device_handle, AMDGPU_HW_IP_VCN_JPEG,
+					num_sessions, 500,
+					jpeg_session_prepare, jpeg_session_cleanup,
+					shared_context);
+}
+
 igt_main
 {
 	amdgpu_device_handle device;
@@ -240,6 +321,10 @@ igt_main
 	igt_subtest("amdgpu_cs_jpeg_decode")
 	amdgpu_cs_jpeg_decode(device, &shared_context);
 
+	igt_describe("Measure the jpeg decode throughput of concurrent sessions");
+	igt_subtest("amdgpu_cs_jpeg_decode_throughput")
+	amdgpu_cs_jpeg_decode_throughput(device, &shared_context);
+
 	igt_fixture {
 		amdgpu_device_deinitialize(device);
 		drm_close_driver(fd);
@@ -388,13 +388,12 @@ static int audio_output_frequencies_callback(void *data, void *buffer,
 
 static bool test_audio_frequencies(struct audio_state *state)
 {
+	struct audio_signal_detector *det;
 	int freq, step;
-	int32_t *recv, *buf;
-	double *channel;
-	size_t i, j, streak;
-	size_t recv_len, buf_len, buf_cap, channel_len;
+	int32_t *recv;
+	size_t i, j;
+	size_t recv_len;
 	bool success;
-	int capture_chan;
 
 	state->signal = audio_signal_init(state->playback.channels,
 					  state->playback.rate);
@@ -430,70 +429,37 @@ static bool test_audio_frequencies(struct audio_state *state)
 		     "Capture rate (%dHz) doesn't match playback rate (%dHz)\n",
 		     state->capture.rate, state->playback.rate);
 
-	/* Needs to be a multiple of 128, because that's the number of samples
-	 * we get per channel each time we receive an audio page from the
-	 * Chamelium device.
+	/* The detection window needs to be high enough to guarantee we
+	 * capture a full period of each sine we generate. With 2048 samples
+	 * at a 192KHz sampling rate, we get a full period for a >94Hz sines.
+	 * For lower sampling rates, the window duration will be longer.
 	 *
-	 * Additionally, this value needs to be high enough to guarantee we
-	 * capture a full period of each sine we generate. If we capture 2048
-	 * samples at a 192KHz sampling rate, we get a full period for a >94Hz
-	 * sines. For lower sampling rates, the capture duration will be
-	 * longer.
+	 * The windows overlap by half, so that a signal getting good in the
+	 * middle of a window doesn't have to wait for the next one to start
+	 * counting. The streak covers as many samples as MIN_STREAK disjoint
+	 * windows would.
 	 */
-	channel_len = CAPTURE_SAMPLES;
-	channel = malloc(sizeof(double) * channel_len);
-
-	buf_cap = state->capture.channels * channel_len;
-	buf = malloc(sizeof(int32_t) * buf_cap);
-	buf_len = 0;
+	det = audio_signal_detector_init(state->signal, state->capture.rate,
+					 state->capture.channels,
+					 state->channel_mapping,
+					 CAPTURE_SAMPLES, CAPTURE_SAMPLES / 2,
+					 2 * MIN_STREAK - 1);
 
 	recv = NULL;
 	recv_len = 0;
 
 	success = false;
-	streak = 0;
 	while (!success && state->msec < AUDIO_TIMEOUT) {
 		audio_state_receive(state, &recv, &recv_len);
 
-		memcpy(&buf[buf_len], recv, recv_len * sizeof(int32_t));
-		buf_len += recv_len;
-
-		if (buf_len < buf_cap)
-			continue;
-		igt_assert(buf_len == buf_cap);
-
-		igt_debug("Detecting audio signal, t=%d msec\n", state->msec);
-
-		for (j = 0; j < state->playback.channels; j++) {
-			capture_chan = state->channel_mapping[j];
-			igt_assert(capture_chan >= 0);
-			igt_debug("Processing channel %zu (captured as "
-				  "channel %d)\n",
-				  j, capture_chan);
-
-			audio_extract_channel_s32_le(channel, channel_len, buf,
-						     buf_len,
-						     state->capture.channels,
-						     capture_chan);
-
-			if (audio_signal_detect(state->signal,
-						state->capture.rate, j, channel,
-						channel_len))
-				streak++;
-			else
-				streak = 0;
-		}
-
-		buf_len = 0;
-
-		success = streak == MIN_STREAK * state->playback.channels;
+		success = audio_signal_detector_push_s32_le(det, recv,
+							    recv_len);
 	}
 
 	audio_state_stop(state, success);
 
+	audio_signal_detector_fini(det);
 	free(recv);
-	free(buf);
-	free(channel);
 	audio_signal_fini(state->signal);
 
 	check_audio_infoframe(state);
@@ -713,6 +713,7 @@ static void test_display_frame_dump(chamelium_data_t *data,
 		igt_output_t *output;
 		igt_plane_t *primary;
 		struct igt_fb fb;
+		struct chamelium_rpc_async_data *reads[5];
 		struct chamelium_frame_dump *frame;
 		drmModeModeInfo *mode;
 		drmModeConnector *connector;
@@ -754,10 +755,15 @@ static void test_display_frame_dump(chamelium_data_t *data,
 		chamelium_enable_output(data, port, output, mode, &fb);
 
 		igt_debug("Reading frame dumps from Chamelium...\n");
-		chamelium_capture(data->chamelium, port, 0, 0, 0, 0, 5);
-		for (j = 0; j < 5; j++) {
-			frame = chamelium_read_captured_frame(data->chamelium,
-							      j);
+		chamelium_capture(data->chamelium, port, 0, 0, 0, 0,
+				  ARRAY_SIZE(reads));
+
+		/* Compare each frame while the next ones are downloaded */
+		for (j = 0; j < ARRAY_SIZE(reads); j++)
+			reads[j] = chamelium_read_captured_frame_async_start(data->chamelium,
+									     j);
+		for (j = 0; j < ARRAY_SIZE(reads); j++) {
+			frame = chamelium_frame_dump_async_finish(reads[j]);
 			chamelium_assert_frame_eq(data->chamelium, frame, &fb);
 			chamelium_destroy_frame_dump(frame);
 		}
@@ -23,6 +23,10 @@
  * Test category: GEM_Legacy
  * Feature: igt_core
  *
+ * SUBTEST: alloc-scaling
+ * Description: Measure how alloc and free cost scales with the number of
+ *		objects for the simple and tree allocators
+ *
  * SUBTEST: alloc-simple
  *
  * SUBTEST: default-alignment
@@ -32,6 +36,11 @@
  *
  * SUBTEST: execbuf-with-allocator
  *
+ * SUBTEST: fork-batch
+ * Description: Check batched alloc/free from several children, with and
+ *		without per-process allocator cache, give non overlapping
+ *		addresses
+ *
  * SUBTEST: fork-simple-once
  *
  * SUBTEST: fork-simple-stress
@@ -58,6 +67,8 @@
  *
  * SUBTEST: two-level-inception
  *
+ * SUBTEST: tree-allocator
+ *
  * SUBTEST: two-level-inception-interruptible
  */
 
@@ -173,6 +184,54 @@ static void reserve(int fd, uint8_t type)
 	igt_assert_eq(intel_allocator_close(ahnd), true);
 }
 
+#define STATS_OBJS 16
+static void stats(int fd, uint8_t type)
+{
+	struct intel_allocator_stats st;
+	struct test_obj obj[STATS_OBJS];
+	uint64_t ahnd, allocs = 0, frees = 0;
+	int i;
+
+	ahnd = intel_allocator_open(fd, 0, type);
+
+	for (i = 0; i < STATS_OBJS; i++) {
+		obj[i].handle = gem_handle_gen();
+		obj[i].size = OBJ_SIZE;
+		obj[i].offset = intel_allocator_alloc(ahnd, obj[i].handle,
+						      obj[i].size, 0);
+	}
+
+	/* Freeing every other object leaves holes behind */
+	for (i = 0; i < STATS_OBJS; i += 2)
+		intel_allocator_free(ahnd, obj[i].handle);
+
+	igt_assert(intel_allocator_get_stats(ahnd, &st));
+	igt_assert_eq_u64(st.allocs, STATS_OBJS);
+	igt_assert_eq_u64(st.frees, STATS_OBJS / 2);
+	igt_assert_eq_u64(st.live_objects, STATS_OBJS / 2);
+	igt_assert_eq_u64(st.live_bytes, STATS_OBJS / 2 * OBJ_SIZE);
+	igt_assert(st.holes > 1);
+	igt_assert(st.largest_hole < st.free_bytes);
+	igt_assert(st.fragmentation > 0 && st.fragmentation < 1);
+
+	for (i = 0; i < INTEL_ALLOCATOR_LATENCY_BUCKETS; i++) {
+		allocs += st.latency[INTEL_ALLOCATOR_OP_ALLOC][i];
+		frees += st.latency[INTEL_ALLOCATOR_OP_FREE][i];
+	}
+	igt_assert_eq_u64(allocs, STATS_OBJS);
+	igt_assert_eq_u64(frees, STATS_OBJS / 2);
+
+	for (i = 1; i < STATS_OBJS; i += 2)
+		intel_allocator_free(ahnd, obj[i].handle);
+
+	igt_assert(intel_allocator_get_stats(ahnd, &st));
+	igt_assert_eq_u64(st.live_objects, 0);
+	igt_assert_eq_u64(st.holes, 1);
+	igt_assert(st.fragmentation == 0);
+
+	igt_assert_eq(intel_allocator_close(ahnd), true);
+}
+
 static void default_alignment(int fd)
 {
 	struct test_obj obj[3];
@@ -469,6 +528,96 @@ static void fork_simple_once(int fd)
 	intel_allocator_multiprocess_stop();
 }
 
+#define BATCH_CHILDREN 4
+#define BATCH_OBJS 64
+struct batch_range {
+	uint64_t offset;
+	uint64_t size;
+};
+
+struct batch_shared {
+	_Atomic(int) ready;
+	struct batch_range objs[BATCH_CHILDREN * BATCH_OBJS];
+};
+
+static void fork_batch(int fd, uint8_t type, bool cache)
+{
+	struct batch_shared *shared;
+	uint64_t ahnd;
+	int i, j;
+
+	shared = mmap(0, sizeof(*shared), PROT_READ | PROT_WRITE,
+		      MAP_SHARED | MAP_ANON, -1, 0);
+	igt_assert(shared != MAP_FAILED);
+	atomic_init(&shared->ready, 0);
+
+	intel_allocator_multiprocess_start();
+
+	/* Keep allocator alive to check it is empty when children are done */
+	ahnd = intel_allocator_open(fd, 0, type);
+
+	igt_fork(child, BATCH_CHILDREN) {
+		struct intel_allocator_batch_obj objs[BATCH_OBJS];
+		uint32_t handles[BATCH_OBJS];
+
+		srandom(child);
+		ahnd = intel_allocator_open(fd, 0, type);
+		igt_assert_eq(intel_allocator_enable_cache(ahnd), cache);
+
+		/* Children share the allocator, so handles must not clash */
+		for (i = 0; i < BATCH_OBJS; i++) {
+			objs[i].handle = child * BATCH_OBJS + i + 1;
+			objs[i].size = (random() % 16 + 1) * 0x1000;
+			objs[i].alignment = 1ull << (12 + random() % 5);
+			handles[i] = objs[i].handle;
+		}
+		intel_allocator_alloc_batch(ahnd, objs, BATCH_OBJS);
+
+		for (i = 0; i < BATCH_OBJS; i++) {
+			igt_assert(!(objs[i].offset & (objs[i].alignment - 1)));
+			igt_assert(intel_allocator_is_allocated(ahnd,
+								objs[i].handle,
+								objs[i].size,
+								objs[i].offset));
+			shared->objs[child * BATCH_OBJS + i].offset = objs[i].offset;
+			shared->objs[child * BATCH_OBJS + i].size = objs[i].size;
+		}
+
+		/* Keep objects alive until all children have allocated */
+		atomic_fetch_add(&shared->ready, 1);
+		while (atomic_load(&shared->ready) < BATCH_CHILDREN)
+			usleep(1000);
+
+		igt_assert_eq(intel_allocator_free_batch(ahnd, handles,
+							 BATCH_OBJS),
+			      BATCH_OBJS);
+		intel_allocator_close(ahnd);
+	}
+	igt_waitchildren();
+
+	/* Cache chunks have to be returned on close as well */
+	igt_assert_eq(intel_allocator_close(ahnd), true);
+
+	intel_allocator_multiprocess_stop();
+
+	for (i = 0; i < BATCH_CHILDREN * BATCH_OBJS; i++) {
+		for (j = i + 1; j < BATCH_CHILDREN * BATCH_OBJS; j++) {
+			struct batch_range *a = &shared->objs[i];
+			struct batch_range *b = &shared->objs[j];
+
+			igt_assert_f(a->offset + a->size <= b->offset ||
+				     b->offset + b->size <= a->offset,
+				     "Overlap: [%llx, %llx) and [%llx, %llx)\n",
+				     (long long)a->offset,
+				     (long long)(a->offset + a->size),
+				     (long long)b->offset,
+				     (long long)(b->offset + b->size));
+		}
+	}
+
+	munmap(shared, sizeof(*shared));
+}
+
 #define SIMPLE_TIMEOUT 5
 static void *__fork_simple_thread(void *data)
 {
@@ -800,11 +949,48 @@ static void gem_pool(int i915)
 	gem_pool_dump();
 }
 
+static void alloc_scaling(int fd, uint8_t type, int max_objs)
+{
+	uint64_t ahnd, offset;
+	struct timespec tv;
+	double elapsed;
+	int cnt, i;
+
+	for (cnt = 1 << 11; cnt <= max_objs; cnt <<= 2) {
+		ahnd = intel_allocator_open_full(fd, 0, 0, 0, type,
+						 ALLOC_STRATEGY_HIGH_TO_LOW, 0);
+
+		memset(&tv, 0, sizeof(tv));
+		igt_nsec_elapsed(&tv);
+		for (i = 1; i <= cnt; i++) {
+			offset = intel_allocator_alloc(ahnd, i, 4096 * (1 + i % 3),
+						       4096);
+			igt_assert(offset != ALLOC_INVALID_ADDRESS);
+		}
+
+		/* Fragment the address space and fill the holes again */
+		for (i = 1; i <= cnt; i += 2)
+			igt_assert(intel_allocator_free(ahnd, i));
+		for (i = 1; i <= cnt; i += 2) {
+			offset = intel_allocator_alloc(ahnd, i, 4096, 4096);
+			igt_assert(offset != ALLOC_INVALID_ADDRESS);
+		}
+
+		for (i = 1; i <= cnt; i++)
+			igt_assert(intel_allocator_free(ahnd, i));
+		elapsed = igt_nsec_elapsed(&tv) * 1e-3;
+
+		igt_info("%7d objects: %.3f us/op\n", cnt, elapsed / (cnt * 3));
+		igt_assert_eq(intel_allocator_close(ahnd), true);
+	}
+}
+
 struct allocators {
 	const char *name;
 	uint8_t type;
 } als[] = {
 	{"simple", INTEL_ALLOCATOR_SIMPLE},
+	{"tree",   INTEL_ALLOCATOR_TREE},
 	{"reloc",  INTEL_ALLOCATOR_RELOC},
 	{NULL, 0},
 };
@@ -845,9 +1031,13 @@ igt_main
 			igt_dynamic("reuse")
 				reuse(fd, a->type);
 
-			if (a->type == INTEL_ALLOCATOR_SIMPLE) {
+			if (a->type == INTEL_ALLOCATOR_SIMPLE ||
+			    a->type == INTEL_ALLOCATOR_TREE) {
 				igt_dynamic("reserve")
 					reserve(fd, a->type);
+
+				igt_dynamic("stats")
+					stats(fd, a->type);
 			}
 
 			igt_dynamic("fork-reopen-allocator")
@@ -855,12 +1045,38 @@ igt_main
 		}
 	}
 
+	igt_describe("Measure how alloc and free cost scales with the number "
+		     "of objects for the simple and tree allocators");
+	igt_subtest_with_dynamic_f("alloc-scaling") {
+		/* List heap is linear, keep its runtime reasonable */
+		igt_dynamic("simple")
+			alloc_scaling(fd, INTEL_ALLOCATOR_SIMPLE, 1 << 15);
+
+		igt_dynamic("tree")
+			alloc_scaling(fd, INTEL_ALLOCATOR_TREE, 1 << 17);
+	}
+
 	igt_subtest_f("standalone")
 		standalone(fd);
 
 	igt_subtest_f("fork-simple-once")
 		fork_simple_once(fd);
 
+	igt_describe("Check batched alloc/free from several children, with "
+		     "and without per-process allocator cache");
+	igt_subtest_with_dynamic_f("fork-batch") {
+		for (a = als; a->name; a++) {
+			if (a->type == INTEL_ALLOCATOR_RELOC)
+				continue;
+
+			igt_dynamic_f("%s", a->name)
+				fork_batch(fd, a->type, false);
+
+			igt_dynamic_f("%s-cache", a->name)
+				fork_batch(fd, a->type, true);
+		}
+	}
+
 	igt_subtest_f("fork-simple-stress")
 		fork_simple_stress(fd, false);
 
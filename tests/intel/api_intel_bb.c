@@ -104,6 +104,10 @@
  *
  * SUBTEST: render-ccs
  *
+ * SUBTEST: render-ccs-aux-pgtable-cache
+ * Description: Check render copies of compressed surfaces with the aux table
+ *		kept in the bb between copies
+ *
  * SUBTEST: reset-bb
  * Description: Ensure reset is possible on fresh bb checking dummy buffer
  *		creation & submission
@@ -1418,7 +1422,7 @@ static uint32_t count_compressed(int gen, struct intel_buf *buf)
 
 #define IMGSIZE (512 * 512 * 4)
 #define CCSIMGSIZE (IMGSIZE + 4096)
-static void render_ccs(struct buf_ops *bops)
+static void render_ccs(struct buf_ops *bops, bool aux_pgtable_cache)
 {
 	struct intel_bb *ibb;
 	const int width = 1024;
@@ -1434,6 +1438,7 @@ static void render_ccs(struct buf_ops *bops)
 	ibb = intel_bb_create(i915, PAGE_SIZE);
 	if (debug_bb)
 		intel_bb_set_debug(ibb, true);
+	intel_bb_set_aux_pgtable_cache(ibb, aux_pgtable_cache);
 
 	scratch_buf_init(bops, &src, width, height, I915_TILING_NONE,
 			 I915_COMPRESSION_NONE);
@@ -1699,7 +1704,10 @@ igt_main_args("dpibc:", NULL, help_str, opt_handler, NULL)
 	}
 
 	igt_subtest("render-ccs")
-		render_ccs(bops);
+		render_ccs(bops, false);
+
+	igt_subtest("render-ccs-aux-pgtable-cache")
+		render_ccs(bops, true);
 
 	igt_describe("Compare cpu and gpu crc32 sums on input object");
 	igt_subtest_with_dynamic_f("crc32") {
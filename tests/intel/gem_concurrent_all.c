@@ -1055,6 +1055,47 @@ static void wc_copy_bo(struct buffers *b, struct intel_buf *dst,
 	munmap(s, size);
 }
 
+/*
+ * As above, but through the mappings cached by gem_mmap_get(), so only
+ * the first copy between two buffers creates and faults in the mappings.
+ */
+static void cached_copy_bo(struct buffers *b, struct intel_buf *dst,
+			   struct intel_buf *src, uint32_t domain,
+			   unsigned int type)
+{
+	const int size = b->page_size;
+	void *d, *s;
+
+	gem_set_domain(fd, src->handle, domain, 0);
+	gem_set_domain(fd, dst->handle, domain, domain);
+
+	s = gem_mmap_get(fd, src->handle, size, type);
+	d = gem_mmap_get(fd, dst->handle, size, type);
+
+	memcpy(d, s, size);
+
+	gem_mmap_put(d);
+	gem_mmap_put(s);
+}
+
+static void cpu_cached_copy_bo(struct buffers *b, struct intel_buf *dst,
+			       struct intel_buf *src)
+{
+	cached_copy_bo(b, dst, src, I915_GEM_DOMAIN_CPU, I915_MMAP_OFFSET_WB);
+}
+
+static void gtt_cached_copy_bo(struct buffers *b, struct intel_buf *dst,
+			       struct intel_buf *src)
+{
+	cached_copy_bo(b, dst, src, I915_GEM_DOMAIN_GTT, I915_MMAP_OFFSET_GTT);
+}
+
+static void wc_cached_copy_bo(struct buffers *b, struct intel_buf *dst,
+			      struct intel_buf *src)
+{
+	cached_copy_bo(b, dst, src, I915_GEM_DOMAIN_WC, I915_MMAP_OFFSET_WC);
+}
+
 static igt_hang_t no_hang(void)
 {
 	return (igt_hang_t){0, 0};
@@ -1549,10 +1590,13 @@ run_mode(const char *prefix,
 		{ "cpu", cpu_copy_bo, cpu_require },
 		{ "gtt", gtt_copy_bo, gtt_require },
 		{ "wc", wc_copy_bo, wc_require },
+		{ "cpu-cached", cpu_cached_copy_bo, cpu_require },
+		{ "gtt-cached", gtt_cached_copy_bo, gtt_require },
+		{ "wc-cached", wc_cached_copy_bo, wc_require },
 		{ "blt", blt_copy_bo, bcs_require },
 		{ "render", render_copy_bo, rcs_require },
 		{ NULL, NULL }
-	}, *pskip = pipelines + 3, *p;
+	}, *pskip = pipelines + 6, *p;
 	const struct {
 		const char *suffix;
 		do_hang hang;
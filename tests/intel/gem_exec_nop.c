@@ -46,6 +46,7 @@
 #include "igt_device.h"
 #include "igt_rand.h"
 #include "igt_sysfs.h"
+#include "igt_telemetry.h"
 #include "intel_ctx.h"
 
 /**
@@ -1022,6 +1023,9 @@ igt_main
 		gem_write(device, handle, 0, &bbe, sizeof(bbe));
 
 		igt_fork_hang_detector(device);
+
+		/* Tell a throttled GT apart from a slow submission path */
+		igt_telemetry_auto(device, 0, 0);
 	}
 
 	igt_subtest("basic-series")
@@ -62,6 +62,10 @@
  *
  * SUBTEST: offset-16x16
  * Description: run gpgpu fill with <x,y> start position == <16,16>
+ *
+ * SUBTEST: rects
+ * Description: run gpgpu fill of many rectangles in one batch and report
+ *		the fill bandwidth
  */
 
 #define WIDTH 64
@@ -70,6 +74,10 @@
 #define SIZE (HEIGHT*STRIDE)
 #define COLOR_88	0x88
 #define COLOR_4C	0x4c
+#define COLOR_C4	0xc4
+
+#define RECTS_SURFACE	1024
+#define RECTS_TILE	64
 
 static bool dump_surface;
 static uint32_t surfwidth = WIDTH;
@@ -163,6 +171,55 @@ static void gpgpu_fill(data_t *data, igt_fillfunc_t fill, uint32_t region,
 	munmap(ptr, buf->surface[0].size);
 }
 
+static void gpgpu_fill_rects(data_t *data, igt_fillfunc_rects_t fill,
+			     uint32_t region)
+{
+	const unsigned int tiles = RECTS_SURFACE / RECTS_TILE;
+	const unsigned int count = tiles * tiles;
+	struct timespec start = {};
+	struct igt_fill_rect *rects;
+	struct intel_buf *buf;
+	uint64_t elapsed;
+	uint8_t *ptr;
+	int i, x, y;
+
+	rects = calloc(count, sizeof(*rects));
+	igt_assert(rects);
+
+	for (i = 0; i < count; i++) {
+		rects[i].x = i % tiles * RECTS_TILE;
+		rects[i].y = i / tiles * RECTS_TILE;
+		rects[i].width = RECTS_TILE;
+		rects[i].height = RECTS_TILE;
+		/* Runs of one color, both sharing and reloading the curbe */
+		rects[i].color = (i / 4) & 1 ? COLOR_C4 : COLOR_4C;
+	}
+
+	buf = create_buf(data, RECTS_SURFACE, RECTS_SURFACE, COLOR_88, region);
+	ptr = gem_mmap__device_coherent(data->drm_fd, buf->handle, 0,
+					buf->surface[0].size, PROT_READ);
+
+	igt_nsec_elapsed(&start);
+	fill(data->drm_fd, buf, rects, count);
+	elapsed = igt_nsec_elapsed(&start);
+
+	for (i = 0; i < count; i++)
+		for (y = rects[i].y; y < rects[i].y + rects[i].height; y++)
+			for (x = rects[i].x; x < rects[i].x + rects[i].width; x++)
+				buf_check(ptr, RECTS_SURFACE, x, y,
+					  rects[i].color);
+
+	igt_info("Filled %u rectangles of %u KiB in %.3f ms: %.1f MiB/s\n",
+		 count, RECTS_SURFACE * RECTS_SURFACE / 1024, elapsed / 1e6,
+		 RECTS_SURFACE * RECTS_SURFACE / (1024.0 * 1024) /
+		 (elapsed / 1e9));
+
+	munmap(ptr, buf->surface[0].size);
+	intel_buf_close(data->bops, buf);
+	free(buf);
+	free(rects);
+}
+
 static int opt_handler(int opt, int opt_index, void *data)
 {
 	switch (opt) {
@@ -202,6 +259,7 @@ igt_main_args("dW:H:X:Y:", NULL, help_str, opt_handler, NULL)
 {
 	data_t data = {0, };
 	igt_fillfunc_t fill_fn = NULL;
+	igt_fillfunc_rects_t fill_rects_fn = NULL;
 	struct drm_i915_query_memory_regions *region_info;
 	struct igt_collection *region_set;
 
@@ -214,6 +272,7 @@ igt_main_args("dW:H:X:Y:", NULL, help_str, opt_handler, NULL)
 		fill_fn = igt_get_gpgpu_fillfunc(data.devid);
 
 		igt_require_f(fill_fn, "no gpgpu-fill function\n");
+		fill_rects_fn = igt_get_gpgpu_fillfunc_rects(data.devid);
 
 		region_info = gem_get_query_memory_regions(data.drm_fd);
 		igt_assert(region_info);
@@ -251,6 +310,22 @@ igt_main_args("dW:H:X:Y:", NULL, help_str, opt_handler, NULL)
 			   surfheight / 2);
 	}
 
+	igt_subtest_with_dynamic("rects") {
+		struct igt_collection *region;
+
+		igt_require(fill_rects_fn);
+
+		for_each_combination(region, 1, region_set) {
+			char *name = memregion_dynamic_subtest_name(region);
+			uint32_t id = igt_collection_get_value(region, 0);
+
+			igt_dynamic(name)
+				gpgpu_fill_rects(&data, fill_rects_fn, id);
+
+			free(name);
+		}
+	}
+
 	igt_fixture {
 		igt_collection_destroy(region_set);
 		free(region_info);
@@ -55,6 +55,10 @@
  * Feature: media
  *
  * SUBTEST: media-fill
+ *
+ * SUBTEST: media-fill-rects
+ * Description: fill many rectangles in one batch and report the fill
+ *		bandwidth
  */
 
 IGT_TEST_DESCRIPTION("Basic test for the media_fill() function, a very simple"
@@ -67,6 +71,10 @@ IGT_TEST_DESCRIPTION("Basic test for the media_fill() function, a very simple"
 
 #define COLOR_C4	0xc4
 #define COLOR_4C	0x4c
+#define COLOR_88	0x88
+
+#define RECTS_SURFACE	1024
+#define RECTS_TILE	64
 
 typedef struct {
 	int drm_fd;
@@ -140,10 +148,65 @@ static void media_fill(data_t *data, igt_fillfunc_t fill,
 	munmap(ptr, buf->surface[0].size);
 }
 
+static void media_fill_rects(data_t *data, igt_fillfunc_rects_t fill,
+			     struct igt_collection *memregion_set)
+{
+	const unsigned int tiles = RECTS_SURFACE / RECTS_TILE;
+	const unsigned int count = tiles * tiles;
+	struct timespec start = {};
+	struct igt_fill_rect *rects;
+	struct intel_buf *buf;
+	uint64_t elapsed;
+	uint32_t region;
+	uint8_t *ptr, val;
+	int i, x, y;
+
+	rects = calloc(count, sizeof(*rects));
+	igt_assert(rects);
+
+	for (i = 0; i < count; i++) {
+		rects[i].x = i % tiles * RECTS_TILE;
+		rects[i].y = i / tiles * RECTS_TILE;
+		rects[i].width = RECTS_TILE;
+		rects[i].height = RECTS_TILE;
+		/* Runs of one color, both sharing and reloading the curbe */
+		rects[i].color = (i / 4) & 1 ? COLOR_88 : COLOR_4C;
+	}
+
+	region = igt_collection_get_value(memregion_set, 0);
+	buf = create_buf(data, RECTS_SURFACE, RECTS_SURFACE, COLOR_C4, region);
+	ptr = gem_mmap__device_coherent(data->drm_fd, buf->handle,
+					0, buf->surface[0].size, PROT_READ);
+
+	igt_nsec_elapsed(&start);
+	fill(data->drm_fd, buf, rects, count);
+	elapsed = igt_nsec_elapsed(&start);
+
+	for (i = 0; i < count; i++)
+		for (y = rects[i].y; y < rects[i].y + rects[i].height; y++)
+			for (x = rects[i].x; x < rects[i].x + rects[i].width; x++) {
+				val = ptr[y * RECTS_SURFACE + x];
+				igt_assert_f(val == rects[i].color,
+					     "Expected 0x%02x, found 0x%02x at (%d,%d)\n",
+					     rects[i].color, val, x, y);
+			}
+
+	igt_info("Filled %u rectangles of %u KiB in %.3f ms: %.1f MiB/s\n",
+		 count, RECTS_SURFACE * RECTS_SURFACE / 1024, elapsed / 1e6,
+		 RECTS_SURFACE * RECTS_SURFACE / (1024.0 * 1024) /
+		 (elapsed / 1e9));
+
+	munmap(ptr, buf->surface[0].size);
+	intel_buf_close(data->bops, buf);
+	free(buf);
+	free(rects);
+}
+
 igt_main
 {
 	data_t data = {0, };
 	igt_fillfunc_t fill_fn = NULL;
+	igt_fillfunc_rects_t fill_rects_fn = NULL;
 	struct drm_i915_query_memory_regions *query_info;
 	struct igt_collection *set, *region_set;
 
@@ -157,6 +220,7 @@ igt_main
 		fill_fn = igt_get_media_fillfunc(data.devid);
 
 		igt_require_f(fill_fn, "no media-fill function\n");
+		fill_rects_fn = igt_get_media_fillfunc_rects(data.devid);
 
 		query_info = gem_get_query_memory_regions(data.drm_fd);
 		igt_assert(query_info);
@@ -178,6 +242,19 @@ igt_main
 			free(sub_name);
 	}
 
+	igt_subtest_with_dynamic("media-fill-rects") {
+		igt_require(fill_rects_fn);
+
+		for_each_combination(region_set, 1, set) {
+			char *sub_name = memregion_dynamic_subtest_name(region_set);
+
+			igt_dynamic_f("%s", sub_name)
+				media_fill_rects(&data, fill_rects_fn, region_set);
+
+			free(sub_name);
+		}
+	}
+
 	igt_fixture {
 		igt_collection_destroy(set);
 		igt_stop_hang_detector();
@@ -46,6 +46,7 @@
 
 #include "i915/gem.h"
 #include "igt.h"
+#include "igt_bufcmp.h"
 #include "igt_x86.h"
 #include "intel_bufops.h"
 /**
@@ -334,6 +335,7 @@ scratch_buf_check_all(data_t *data,
 	int width = intel_buf_width(buf);
 	int height = intel_buf_height(buf);
 	uint32_t *linear_buf, *linear_ref;
+	struct igt_bufcmp cmp;
 
 	igt_assert_eq(intel_buf_width(buf), intel_buf_width(ref));
 	igt_assert_eq(intel_buf_height(buf), intel_buf_height(ref));
@@ -344,19 +346,20 @@ scratch_buf_check_all(data_t *data,
 	intel_buf_to_linear(data->bops, buf, linear_buf);
 	intel_buf_to_linear(data->bops, ref, linear_ref);
 
-	for (int y = 0; y < height; y++) {
-		for (int x = 0; x < width; x++) {
-			uint32_t buf_val = linear_buf[y * width + x];
-			uint32_t ref_val = linear_ref[y * width + x];
+	igt_bufcmp(&cmp, linear_buf, linear_ref,
+		   (size_t)width * height * sizeof(*linear_buf), 0);
+	for (int i = 0; i < cmp.num_reported; i++) {
+		int pixel = cmp.reported[i].offset / sizeof(*linear_buf);
 
-			igt_assert_f(buf_val == ref_val,
-				     "Expected 0x%08x, found 0x%08x at (%d,%d)\n",
-				     ref_val, buf_val, x, y);
-		}
+		igt_warn("Expected 0x%08x, found 0x%08x at (%d,%d)\n",
+			 cmp.reported[i].expected, cmp.reported[i].found,
+			 pixel % width, pixel / width);
 	}
 
 	free(linear_ref);
 	free(linear_buf);
+
+	igt_assert_f(!cmp.count, "%"PRIu64" pixels differ\n", cmp.count);
 }
 
 static void scratch_buf_ccs_check(data_t *data,
@@ -102,6 +102,8 @@ static void run_test (int fd, int count)
 
 	bops = buf_ops_create(fd);
 	ibb = intel_bb_create(fd, 4096);
+	/* Thousands of copies through one bb, keep the static state */
+	intel_bb_set_render_state_cache(ibb, true);
 
 	bufs = malloc(sizeof(*bufs)*count);
 	start_val = malloc(sizeof(*start_val)*count);
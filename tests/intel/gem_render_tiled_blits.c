@@ -141,6 +141,8 @@ static void run_test (int fd, int count)
 
 	bops = buf_ops_create(fd);
 	ibb = intel_bb_create(fd, 4096);
+	/* Thousands of copies through one bb, keep the static state */
+	intel_bb_set_render_state_cache(ibb, true);
 
 	intel_buf_init(bops, &linear, WIDTH, HEIGHT, 32, 0,
 		       I915_TILING_NONE, I915_COMPRESSION_NONE);
@@ -25,6 +25,7 @@
 #include "i915/gem.h"
 #include "i915/gem_ring.h"
 #include "igt.h"
+#include "sw_sync.h"
 /**
  * TEST: gem spin batch
  * Category: Core
@@ -38,6 +39,7 @@
  * SUBTEST: legacy
  * SUBTEST: legacy-resubmit
  * SUBTEST: legacy-resubmit-new
+ * SUBTEST: pool
  * SUBTEST: resubmit
  * SUBTEST: resubmit-all
  * SUBTEST: resubmit-new
@@ -45,6 +47,7 @@
  * SUBTEST: spin-all
  * SUBTEST: spin-all-new
  * SUBTEST: spin-each
+ * SUBTEST: timed
  * SUBTEST: user-each
  *
  */
@@ -133,6 +136,61 @@ static void spin_resubmit(int fd, const intel_ctx_t *ctx,
 	put_ahnd(ahnd);
 }
 
+#define POOL_LOOPS 128
+
+static void spin_pool(int fd, const intel_ctx_t *ctx, unsigned int engine)
+{
+	uint64_t ahnd = get_reloc_ahnd(fd, ctx->id);
+	igt_spin_t *spin;
+	uint32_t handle;
+	int i;
+
+	spin = igt_spin_new(fd, .ahnd = ahnd, .ctx = ctx, .engine = engine,
+			    .flags = IGT_SPIN_POOL | IGT_SPIN_FENCE_OUT);
+	handle = spin->handle;
+	igt_spin_free(fd, spin);
+
+	for (i = 0; i < POOL_LOOPS; i++) {
+		spin = igt_spin_new(fd, .ahnd = ahnd, .ctx = ctx,
+				    .engine = engine,
+				    .flags = IGT_SPIN_POOL | IGT_SPIN_FENCE_OUT);
+
+		/* Recycled spinner has to be running again */
+		igt_assert_eq(spin->handle, handle);
+		igt_assert(gem_bo_busy(fd, spin->handle));
+		igt_assert_eq(sync_fence_status(spin->out_fence), 0);
+
+		igt_spin_free(fd, spin);
+	}
+
+	igt_spin_pool_drain(fd);
+	put_ahnd(ahnd);
+}
+
+static void spin_timed(int fd, const intel_ctx_t *ctx, unsigned int engine)
+{
+	const uint64_t timeout_100ms = 100000000LL;
+	uint64_t ahnd = get_reloc_ahnd(fd, ctx->id);
+	struct timespec tv = { };
+	igt_spin_t *spin;
+	uint64_t elapsed;
+
+	igt_nsec_elapsed(&tv);
+	spin = igt_spin_new(fd, .ahnd = ahnd, .ctx = ctx, .engine = engine,
+			    .timeout_ns = timeout_100ms);
+
+	/* Spinner has to end itself, without any help from the cpu side */
+	gem_sync(fd, spin->handle);
+	elapsed = igt_nsec_elapsed(&tv);
+	igt_debug("timed spinner ended after %fms (target 100ms)\n",
+		  elapsed * 1e-6);
+
+	igt_spin_free(fd, spin);
+	put_ahnd(ahnd);
+
+	assert_within_epsilon(timeout_100ms, elapsed, MAX_ERROR);
+}
+
 static void spin_exit_handler(int sig)
 {
 	igt_terminate_spins();
@@ -295,6 +353,12 @@ igt_main
 		spin_resubmit(fd, ctx, e2->flags,
 			      RESUBMIT_ALL_ENGINES);
 
+	test_each_engine("timed")
+		spin_timed(fd, ctx, e2->flags);
+
+	test_each_engine("pool")
+		spin_pool(fd, ctx, e2->flags);
+
 	test_each_engine("resubmit-new-all")
 		spin_resubmit(fd, ctx, e2->flags,
 			      RESUBMIT_NEW_CTX |
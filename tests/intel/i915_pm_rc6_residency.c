@@ -198,23 +198,32 @@ static void measure_residencies(int devid, int dirfd, unsigned int mask,
 
 static bool wait_for_rc6(int dirfd)
 {
+	struct igt_sysfs_attr *residency;
 	struct timespec tv = {};
-	unsigned long start, now;
+	uint64_t start, now;
+	bool ret = false;
+
+	residency = igt_sysfs_rps_attr_open(dirfd, RC6_RESIDENCY_MS);
+	igt_assert(residency);
 
 	/* First wait for roughly an RC6 Evaluation Interval */
 	usleep(160 * 1000);
 
 	/* Then poll for RC6 to start ticking */
-	now = read_rc6_residency(dirfd, RC6_RESIDENCY_MS);
+	now = igt_sysfs_attr_get_u64(residency);
 	do {
 		start = now;
 		usleep(5000);
-		now = read_rc6_residency(dirfd, RC6_RESIDENCY_MS);
-		if (now - start > 1)
-			return true;
+		now = igt_sysfs_attr_get_u64(residency);
+		if (now - start > 1) {
+			ret = true;
+			break;
+		}
 	} while (!igt_seconds_elapsed(&tv));
 
-	return false;
+	igt_sysfs_attr_close(residency);
+
+	return ret;
 }
 
 static uint64_t __pmu_read_single(int fd, uint64_t *ts)
@@ -95,29 +95,29 @@ enum {
 
 static int origfreqs[NUMFREQ];
 
+/* Polled while waiting for the frequency to settle, so kept open */
 struct sysfs_file {
 	const char *name;
-	const char *mode;
-	FILE *filp;
+	bool writable;
+	struct igt_sysfs_attr *attr;
 } sysfs_files[] = {
-	{ "act", "r", NULL },
-	{ "cur", "r", NULL },
-	{ "min", "rb+", NULL },
-	{ "max", "rb+", NULL },
-	{ "RP0", "r", NULL },
-	{ "RP1", "r", NULL },
-	{ "RPn", "r", NULL },
-	{ "boost", "rb+", NULL },
-	{ NULL, NULL, NULL }
+	{ "act", false, NULL },
+	{ "cur", false, NULL },
+	{ "min", true, NULL },
+	{ "max", true, NULL },
+	{ "RP0", false, NULL },
+	{ "RP1", false, NULL },
+	{ "RPn", false, NULL },
+	{ "boost", true, NULL },
+	{ NULL, false, NULL }
 };
 
-static int readval(FILE *filp)
+static int readval(struct igt_sysfs_attr *attr)
 {
 	int val;
 	int scanned;
 
-	rewind(filp);
-	scanned = fscanf(filp, "%d", &val);
+	scanned = igt_sysfs_attr_scanf(attr, "%d", &val);
 	igt_assert_eq(scanned, 1);
 
 	return val;
@@ -128,7 +128,7 @@ static void read_freqs(int *freqs)
 	int i;
 
 	for (i = 0; i < NUMFREQ; i++)
-		freqs[i] = readval(sysfs_files[i].filp);
+		freqs[i] = readval(sysfs_files[i].attr);
 }
 
 static void nsleep(unsigned long ns)
@@ -163,32 +163,32 @@ static void wait_freq_settle(void)
 	}
 }
 
-static int do_writeval(FILE *filp, int val, int lerrno, bool readback_check)
+static int do_writeval(struct igt_sysfs_attr *attr, int val, int lerrno,
+		       bool readback_check)
 {
 	int ret, orig;
 
-	orig = readval(filp);
-	rewind(filp);
-	ret = fprintf(filp, "%d", val);
+	orig = readval(attr);
+	ret = igt_sysfs_attr_printf(attr, "%d", val);
 
 	if (lerrno) {
 		/* Expecting specific error */
-		igt_assert(ret == EOF && errno == lerrno);
+		igt_assert_eq(ret, -lerrno);
 		if (readback_check)
-			igt_assert_eq(readval(filp), orig);
+			igt_assert_eq(readval(attr), orig);
 	} else {
 		/* Expecting no error */
 		igt_assert_lt(0, ret);
 		wait_freq_settle();
 		if (readback_check)
-			igt_assert_eq(readval(filp), val);
+			igt_assert_eq(readval(attr), val);
 	}
 
 	return ret;
 }
-#define writeval(filp, val) do_writeval(filp, val, 0, true)
-#define writeval_inval(filp, val) do_writeval(filp, val, EINVAL, true)
-#define writeval_nocheck(filp, val) do_writeval(filp, val, 0, false)
+#define writeval(attr, val) do_writeval(attr, val, 0, true)
+#define writeval_inval(attr, val) do_writeval(attr, val, EINVAL, true)
+#define writeval_nocheck(attr, val) do_writeval(attr, val, 0, false)
 
 static void check_freq_constraints(const int *freqs)
 {
@@ -390,10 +390,10 @@ static int get_hw_rounded_freq(int target)
 		idx = MAX;
 
 	old_freq = freqs[idx];
-	writeval_nocheck(sysfs_files[idx].filp, target);
+	writeval_nocheck(sysfs_files[idx].attr, target);
 	read_freqs(freqs);
 	ret = freqs[idx];
-	writeval_nocheck(sysfs_files[idx].filp, old_freq);
+	writeval_nocheck(sysfs_files[idx].attr, old_freq);
 
 	return ret;
 }
@@ -418,82 +418,82 @@ static void min_max_config(void (*check)(void), bool load_gpu)
 	check();
 
 	igt_debug("\nSet min=RPn and max=RP0...\n");
-	writeval(sysfs_files[MIN].filp, origfreqs[RPn]);
-	writeval(sysfs_files[MAX].filp, origfreqs[RP0]);
+	writeval(sysfs_files[MIN].attr, origfreqs[RPn]);
+	writeval(sysfs_files[MAX].attr, origfreqs[RP0]);
 	if (load_gpu)
 		do_load_gpu();
 	check();
 
 	igt_debug("\nIncrease min to midpoint...\n");
-	writeval(sysfs_files[MIN].filp, fmid);
+	writeval(sysfs_files[MIN].attr, fmid);
 	if (load_gpu)
 		do_load_gpu();
 	check();
 
 	igt_debug("\nIncrease min to RP0...\n");
-	writeval(sysfs_files[MIN].filp, origfreqs[RP0]);
+	writeval(sysfs_files[MIN].attr, origfreqs[RP0]);
 	if (load_gpu)
 		do_load_gpu();
 	check();
 
 	igt_debug("\nIncrease min above RP0 (invalid)...\n");
-	writeval_inval(sysfs_files[MIN].filp, origfreqs[RP0] + 1000);
+	writeval_inval(sysfs_files[MIN].attr, origfreqs[RP0] + 1000);
 	check();
 
 	if (origfreqs[RPn] < origfreqs[RP0]) {
 		igt_debug("\nDecrease max to RPn (invalid)...\n");
-		writeval_inval(sysfs_files[MAX].filp, origfreqs[RPn]);
+		writeval_inval(sysfs_files[MAX].attr, origfreqs[RPn]);
 		check();
 	}
 
 	igt_debug("\nDecrease min to midpoint...\n");
-	writeval(sysfs_files[MIN].filp, fmid);
+	writeval(sysfs_files[MIN].attr, fmid);
 	if (load_gpu)
 		do_load_gpu();
 	check();
 
 	igt_debug("\nDecrease min to RPn...\n");
-	writeval(sysfs_files[MIN].filp, origfreqs[RPn]);
+	writeval(sysfs_files[MIN].attr, origfreqs[RPn]);
 	if (load_gpu)
 		do_load_gpu();
 	check();
 
 	igt_debug("\nDecrease min below RPn (invalid)...\n");
-	writeval_inval(sysfs_files[MIN].filp, 0);
+	writeval_inval(sysfs_files[MIN].attr, 0);
 	check();
 
 	igt_debug("\nDecrease max to midpoint...\n");
-	writeval(sysfs_files[MAX].filp, fmid);
+	writeval(sysfs_files[MAX].attr, fmid);
 	check();
 
 	igt_debug("\nDecrease max to RPn...\n");
-	writeval(sysfs_files[MAX].filp, origfreqs[RPn]);
+	writeval(sysfs_files[MAX].attr, origfreqs[RPn]);
 	check();
 
 	igt_debug("\nDecrease max below RPn (invalid)...\n");
-	writeval_inval(sysfs_files[MAX].filp, 0);
+	writeval_inval(sysfs_files[MAX].attr, 0);
 	check();
 
 	if (origfreqs[RP0] > origfreqs[RPn]) {
 		igt_debug("\nIncrease min to RP0 (invalid)...\n");
-		writeval_inval(sysfs_files[MIN].filp, origfreqs[RP0]);
+		writeval_inval(sysfs_files[MIN].attr, origfreqs[RP0]);
 		check();
 	}
 
 	igt_debug("\nIncrease max to midpoint...\n");
-	writeval(sysfs_files[MAX].filp, fmid);
+	writeval(sysfs_files[MAX].attr, fmid);
 	check();
 
 	igt_debug("\nIncrease max to RP0...\n");
-	writeval(sysfs_files[MAX].filp, origfreqs[RP0]);
+	writeval(sysfs_files[MAX].attr, origfreqs[RP0]);
 	check();
 
 	igt_debug("\nIncrease max above RP0 (invalid)...\n");
-	writeval_inval(sysfs_files[MAX].filp, origfreqs[RP0] + 1000);
+	writeval_inval(sysfs_files[MAX].attr, origfreqs[RP0] + 1000);
 	check();
 
-	writeval(sysfs_files[MIN].filp, origfreqs[MIN]);
-	writeval(sysfs_files[MAX].filp, origfreqs[MAX]);
+	writeval(sysfs_files[MIN].attr, origfreqs[MIN]);
+	writeval(sysfs_files[MAX].attr, origfreqs[MAX]);
 }
 
 static void basic_check(void)
@@ -629,7 +629,7 @@ static void waitboost(int fd, bool reset)
 	}
 
 	/* Set max freq to less than boost freq */
-	writeval(sysfs_files[MAX].filp, fmid);
+	writeval(sysfs_files[MAX].attr, fmid);
 
 	/* When we wait upon the GPU, we want to temporarily boost it
 	 * to maximum.
@@ -637,7 +637,7 @@ static void waitboost(int fd, bool reset)
 	boost_freq(fd, boost_freqs);
 
 	/* Set max freq to original softmax */
-	writeval(sysfs_files[MAX].filp, origfreqs[MAX]);
+	writeval(sysfs_files[MAX].attr, origfreqs[MAX]);
 
 	igt_debug("Apply low load again...\n");
 	sleep(1);
@@ -899,13 +899,13 @@ static void engine_order(int i915)
 
 static void pm_rps_exit_handler(int sig)
 {
-	if (sysfs_files[MAX].filp) {
-		if (origfreqs[MIN] > readval(sysfs_files[MAX].filp)) {
-			writeval(sysfs_files[MAX].filp, origfreqs[MAX]);
-			writeval(sysfs_files[MIN].filp, origfreqs[MIN]);
+	if (sysfs_files[MAX].attr) {
+		if (origfreqs[MIN] > readval(sysfs_files[MAX].attr)) {
+			writeval(sysfs_files[MAX].attr, origfreqs[MAX]);
+			writeval(sysfs_files[MIN].attr, origfreqs[MIN]);
 		} else {
-			writeval(sysfs_files[MIN].filp, origfreqs[MIN]);
-			writeval(sysfs_files[MAX].filp, origfreqs[MAX]);
+			writeval(sysfs_files[MIN].attr, origfreqs[MIN]);
+			writeval(sysfs_files[MAX].attr, origfreqs[MAX]);
 		}
 	}
 
@@ -1084,31 +1084,32 @@ igt_main
 {
 	igt_fixture {
 		struct sysfs_file *sysfs_file = sysfs_files;
-		char sysfs_path[80];
-		int ret;
+		int sysfs;
 
 		/* Use drm_open_driver to verify device existence */
 		drm_fd = drm_open_driver(DRIVER_INTEL);
 		igt_require_gem(drm_fd);
 		igt_require(gem_can_store_dword(drm_fd, 0));
-		igt_assert(igt_sysfs_path(drm_fd, sysfs_path,
-					  sizeof(sysfs_path)));
+		sysfs = igt_sysfs_open(drm_fd);
+		igt_assert(sysfs >= 0);
 
 		do {
 			int val = -1;
-			char *path;
+			char name[32];
 
-			ret = asprintf(&path, "%s/gt_%s_freq_mhz",
-				       sysfs_path, sysfs_file->name);
-			igt_assert(ret != -1);
-			sysfs_file->filp = fopen(path, sysfs_file->mode);
-			igt_require(sysfs_file->filp);
-			setbuf(sysfs_file->filp, NULL);
+			snprintf(name, sizeof(name), "gt_%s_freq_mhz",
+				 sysfs_file->name);
+			if (sysfs_file->writable)
+				sysfs_file->attr = igt_sysfs_attr_open_rw(sysfs, name);
+			else
+				sysfs_file->attr = igt_sysfs_attr_open(sysfs, name);
+			igt_require(sysfs_file->attr);
 
-			val = readval(sysfs_file->filp);
+			val = readval(sysfs_file->attr);
 			igt_assert(val >= 0);
 			sysfs_file++;
 		} while (sysfs_file->name != NULL);
+		close(sysfs);
 
 		read_freqs(origfreqs);
 
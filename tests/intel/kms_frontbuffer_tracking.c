@@ -928,6 +928,8 @@ struct {
 	bool supports_last_action;
 
 	struct timespec last_action;
+
+	igt_stats_t enable_latency;
 } fbc = {
 	.can_test = false,
 	.supports_last_action = false,
@@ -935,6 +937,9 @@ struct {
 
 struct {
 	bool can_test;
+
+	igt_stats_t entry_latency;
+	igt_stats_t exit_latency;
 } psr = {
 	.can_test = false,
 };
@@ -2109,6 +2114,8 @@ static void teardown_crcs(void)
 
 static void setup_fbc(void)
 {
+	igt_stats_init(&fbc.enable_latency);
+
 	if (!intel_fbc_supported_on_chipset(drm.fd, prim_mode_params.pipe)) {
 		igt_info("Can't test FBC: not supported on this chipset\n");
 		return;
@@ -2119,12 +2126,29 @@ static void setup_fbc(void)
 	fbc_setup_last_action();
 }
 
+static void report_latency(const char *name, igt_stats_t *stats)
+{
+	if (!stats->n_values)
+		return;
+
+	igt_info("%s latency: n=%u min=%.3fms median=%.3fms max=%.3fms\n",
+		 name, stats->n_values,
+		 igt_stats_get_min(stats) * 1e-6,
+		 igt_stats_get_median(stats) * 1e-6,
+		 igt_stats_get_max(stats) * 1e-6);
+}
+
 static void teardown_fbc(void)
 {
+	report_latency("FBC enable", &fbc.enable_latency);
+	igt_stats_fini(&fbc.enable_latency);
 }
 
 static void setup_psr(void)
 {
+	igt_stats_init(&psr.entry_latency);
+	igt_stats_init(&psr.exit_latency);
+
 	if (prim_mode_params.output->config.connector->connector_type !=
 	    DRM_MODE_CONNECTOR_eDP) {
 		igt_info("Can't test PSR: no usable eDP screen.\n");
@@ -2140,6 +2164,10 @@ static void setup_psr(void)
 
 static void teardown_psr(void)
 {
+	report_latency("PSR entry", &psr.entry_latency);
+	report_latency("PSR exit", &psr.exit_latency);
+	igt_stats_fini(&psr.entry_latency);
+	igt_stats_fini(&psr.exit_latency);
 }
 
 static void setup_drrs(void)
@@ -2317,12 +2345,14 @@ static void do_status_assertions(int flags)
 		igt_require(!fbc_stride_not_supported());
 		igt_require(!fbc_mode_too_large());
 		igt_require(!fbc_psr_not_possible());
-		if (!intel_fbc_wait_until_enabled(drm.fd, prim_mode_params.pipe)) {
+		if (intel_fbc_wait_until_enabled(drm.fd, prim_mode_params.pipe))
+			igt_stats_push(&fbc.enable_latency,
+				       intel_fbc_last_enable_latency_ns());
+		else
 			igt_assert_f(intel_fbc_is_enabled(drm.fd,
 						    prim_mode_params.pipe,
 						    IGT_LOG_WARN),
 				     "FBC disabled\n");
-		}
 
 		if (opt.fbc_check_compression)
 			igt_assert(fbc_wait_for_compression());
@@ -2334,10 +2364,13 @@ static void do_status_assertions(int flags)
 	if (flags & ASSERT_PSR_ENABLED) {
 		igt_assert_f(psr_wait_entry(drm.debugfs, PSR_MODE_1, NULL),
 			     "PSR still disabled\n");
+		igt_stats_push(&psr.entry_latency, psr_last_entry_latency_ns());
 		psr_sink_error_check(drm.debugfs, PSR_MODE_1, prim_mode_params.output);
-	} else if (flags & ASSERT_PSR_DISABLED)
+	} else if (flags & ASSERT_PSR_DISABLED) {
 		igt_assert_f(psr_wait_update(drm.debugfs, PSR_MODE_1, NULL),
 			     "PSR still enabled\n");
+		igt_stats_push(&psr.exit_latency, psr_last_exit_latency_ns());
+	}
 }
 
 static void __do_assertions(const struct test_mode *t, int flags,
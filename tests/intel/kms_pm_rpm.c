@@ -174,6 +174,7 @@ int drm_fd, msr_fd, pc8_status_fd;
 int debugfs;
 bool has_runtime_pm, has_pc8;
 struct mode_set_data ms_data;
+igt_stats_t suspend_latency, resume_latency;
 
 /* Stuff used when creating FBs and mode setting. */
 struct mode_set_data {
@@ -287,9 +288,13 @@ static bool wait_for_suspended(void)
 	if (has_pc8 && !has_runtime_pm) {
 		return wait_for_pc8_status(PC8_ENABLED);
 	} else {
-		bool suspended = igt_wait_for_pm_status(IGT_RUNTIME_PM_STATUS_SUSPENDED);
+		uint64_t elapsed;
+		bool suspended = __igt_wait_for_pm_status(IGT_RUNTIME_PM_STATUS_SUSPENDED,
+							  10000, &elapsed);
 
-		if (!suspended) {
+		if (suspended) {
+			igt_stats_push(&suspend_latency, elapsed);
+		} else {
 			/* Dump runtime pm status even if test skips */
 			__igt_debugfs_dump(drm_fd, "i915_runtime_pm_status", IGT_LOG_INFO);
 		}
@@ -300,10 +305,29 @@ static bool wait_for_suspended(void)
 
 static bool wait_for_active(void)
 {
+	uint64_t elapsed;
+
 	if (has_pc8 && !has_runtime_pm)
 		return wait_for_pc8_status(PC8_DISABLED);
-	else
-		return igt_wait_for_pm_status(IGT_RUNTIME_PM_STATUS_ACTIVE);
+
+	if (!__igt_wait_for_pm_status(IGT_RUNTIME_PM_STATUS_ACTIVE,
+				      10000, &elapsed))
+		return false;
+
+	igt_stats_push(&resume_latency, elapsed);
+
+	return true;
+}
+
+static void report_latency(const char *name, igt_stats_t *stats)
+{
+	if (!stats->n_values)
+		return;
+
+	igt_info("%s latency: %u samples, median %.3fms, max %.3fms\n",
+		 name, stats->n_values,
+		 igt_stats_get_median(stats) * 1e-6,
+		 igt_stats_get_max(stats) * 1e-6);
 }
 
 static void disable_all_screens_dpms(struct mode_set_data *data)
@@ -1606,6 +1630,9 @@ static struct option long_options[] = {
 
 igt_main_args("", long_options, help_str, opt_handler, NULL)
 {
+	igt_stats_init(&suspend_latency);
+	igt_stats_init(&resume_latency);
+
 	igt_subtest("basic-rte") {
 		igt_assert(setup_environment());
 		basic_subtest();
@@ -1707,5 +1734,10 @@ igt_main_args("", long_options, help_str, opt_handler, NULL)
 	igt_fixture {
 		teardown_environment();
 		forcewake_put(&ms_data);
+
+		report_latency("Runtime suspend entry", &suspend_latency);
+		report_latency("Runtime suspend exit", &resume_latency);
+		igt_stats_fini(&suspend_latency);
+		igt_stats_fini(&resume_latency);
 	}
 }
@@ -318,6 +318,7 @@ typedef struct {
 	drmModeModeInfo *mode;
 	igt_output_t *output;
 	bool fbc_flag;
+	igt_stats_t entry_latency, exit_latency, fbc_latency;
 } data_t;
 
 static void create_cursor_fb(data_t *data)
@@ -470,7 +471,11 @@ static bool psr_wait_entry_if_enabled(data_t *data)
 		      "enable_psr modparam doesn't allow psr mode %d\n",
 		      data->op_psr_mode);
 
-	return psr_wait_entry(data->debugfs_fd, data->op_psr_mode, data->output);
+	if (!psr_wait_entry(data->debugfs_fd, data->op_psr_mode, data->output))
+		return false;
+
+	igt_stats_push(&data->entry_latency, psr_last_entry_latency_ns());
+	return true;
 }
 
 static bool psr_wait_update_if_enabled(data_t *data)
@@ -479,7 +484,25 @@ static bool psr_wait_update_if_enabled(data_t *data)
 		      "enable_psr modparam doesn't allow psr mode %d\n",
 		      data->op_psr_mode);
 
-	return psr_wait_update(data->debugfs_fd, data->op_psr_mode, data->output);
+	if (!psr_wait_update(data->debugfs_fd, data->op_psr_mode, data->output))
+		return false;
+
+	/* Not measured for Panel Replay on DisplayPort */
+	if (psr_last_exit_latency_ns() >= 0)
+		igt_stats_push(&data->exit_latency, psr_last_exit_latency_ns());
+	return true;
+}
+
+static void report_latency(const char *name, igt_stats_t *stats)
+{
+	if (!stats->n_values)
+		return;
+
+	igt_info("%s latency: n=%u min=%.3fms median=%.3fms max=%.3fms\n",
+		 name, stats->n_values,
+		 igt_stats_get_min(stats) * 1e-6,
+		 igt_stats_get_median(stats) * 1e-6,
+		 igt_stats_get_max(stats) * 1e-6);
 }
 
 static bool psr_enable_if_enabled(data_t *data)
@@ -748,10 +771,13 @@ static void test_setup(data_t *data)
 		psr_enable_if_enabled(data);
 		setup_test_plane(data, data->test_plane_id);
 		if (psr_wait_entry_if_enabled(data)) {
-			if (data->fbc_flag == true && data->op_fbc_mode == FBC_ENABLED)
+			if (data->fbc_flag == true && data->op_fbc_mode == FBC_ENABLED) {
 				igt_assert_f(intel_fbc_wait_until_enabled(data->drm_fd,
 									  pipe),
 									  "FBC still disabled\n");
+				igt_stats_push(&data->fbc_latency,
+					       intel_fbc_last_enable_latency_ns());
+			}
 			psr_entered = true;
 			break;
 		}
@@ -796,6 +822,9 @@ igt_main
 		kmstest_set_vt_graphics_mode();
 		data.devid = intel_get_drm_devid(data.drm_fd);
 		data.bops = buf_ops_create(data.drm_fd);
+		igt_stats_init(&data.entry_latency);
+		igt_stats_init(&data.exit_latency);
+		igt_stats_init(&data.fbc_latency);
 		igt_display_require(&data.display, data.drm_fd);
 		igt_require_f(output_supports_psr(&data), "Sink does not support PSR/PSR2/PR\n");
 		disp_ver = intel_display_ver(data.devid);
@@ -965,6 +994,12 @@ igt_main
 	}
 
 	igt_fixture {
+		report_latency("PSR entry", &data.entry_latency);
+		report_latency("PSR exit", &data.exit_latency);
+		report_latency("FBC enable", &data.fbc_latency);
+		igt_stats_fini(&data.entry_latency);
+		igt_stats_fini(&data.exit_latency);
+		igt_stats_fini(&data.fbc_latency);
 
 		close(data.debugfs_fd);
 		buf_ops_destroy(data.bops);
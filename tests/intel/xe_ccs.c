@@ -43,6 +43,12 @@
  * SUBTEST: block-copy-uncompressed-inc-dimension
  * Description: Check block-copy uncompressed blit for different sizes
  *
+ * SUBTEST: block-copy-striped-compressed
+ * Description: Check block-copy compressed blit split across copy engines
+ *
+ * SUBTEST: block-copy-striped-uncompressed
+ * Description: Check block-copy uncompressed blit split across copy engines
+ *
  * SUBTEST: block-multicopy-compressed
  * Description: Check block-multicopy flatccs compressed blit
  *
@@ -90,6 +96,7 @@ struct test_config {
 	bool surfcopy;
 	bool new_ctx;
 	bool suspend_resume;
+	bool striped;
 	int width_increment;
 	int width_steps;
 	int overwrite_width;
@@ -125,6 +132,7 @@ static void surf_copy(int xe,
 	uint8_t comp_pat_index = DEFAULT_PAT_INDEX;
 	uint16_t cpu_caching = __xe_default_cpu_caching(xe, sysmem, 0);
 	uint32_t devid = intel_get_drm_devid(xe);
+	struct igt_bufcmp cmp;
 	int result;
 
 	igt_assert(mid->compression);
@@ -219,7 +227,7 @@ static void surf_copy(int xe,
 	blt_block_copy(xe, ctx, NULL, ahnd, &blt, &ext);
 	intel_ctx_xe_sync(ctx, true);
 	WRITE_PNG(xe, run_id, "corrupted", &blt.dst, dst->x2, dst->y2, bpp);
-	result = memcmp(src->ptr, dst->ptr, src->size);
+	result = igt_bufcmp(NULL, dst->ptr, src->ptr, src->size, 0) != 0;
 	if (blt_platform_has_flat_ccs_enabled(xe))
 		igt_assert_neq(result, 0);
 
@@ -237,9 +245,11 @@ static void surf_copy(int xe,
 	blt_block_copy(xe, ctx, NULL, ahnd, &blt, &ext);
 	intel_ctx_xe_sync(ctx, true);
 	WRITE_PNG(xe, run_id, "corrected", &blt.dst, dst->x2, dst->y2, bpp);
-	result = memcmp(src->ptr, dst->ptr, src->size);
-	if (result)
+	result = igt_bufcmp(&cmp, dst->ptr, src->ptr, src->size, 0) != 0;
+	if (result) {
+		blt_print_mismatches(xe, dst, bpp, &cmp);
 		blt_dump_corruption_info_32b(src, dst);
+	}
 
 	munmap(ccsmap, ccssize);
 	gem_close(xe, ccs);
@@ -360,6 +370,7 @@ static void block_copy(int xe,
 	int mid_compression_format = param.compression_format;
 	enum blt_compression_type comp_type = COMPRESSION_TYPE_3D;
 	uint8_t uc_mocs = intel_get_uc_mocs_index(xe);
+	struct igt_bufcmp cmp;
 	int result;
 
 	bb = xe_bo_create(xe, 0, bb_size, region1, DRM_XE_GEM_CREATE_FLAG_NEEDS_VISIBLE_VRAM);
@@ -390,8 +401,13 @@ static void block_copy(int xe,
 	blt_set_object_ext(&ext.src, 0, width, height, SURFACE_TYPE_2D);
 	blt_set_object_ext(&ext.dst, mid_compression_format, width, height, SURFACE_TYPE_2D);
 	blt_set_batch(&blt.bb, bb, bb_size, region1);
-	blt_block_copy(xe, ctx, NULL, ahnd, &blt, pext);
-	intel_ctx_xe_sync(ctx, true);
+	if (config->striped) {
+		igt_assert_eq(blt_copy_striped(xe, ctx, ahnd, XY_BLOCK_COPY,
+					       &blt, pext, 0), 0);
+	} else {
+		blt_block_copy(xe, ctx, NULL, ahnd, &blt, pext);
+		intel_ctx_xe_sync(ctx, true);
+	}
 
 	/*
 	 * If there's a compression we expect ctrl surface is not fully zeroed.
@@ -451,12 +467,18 @@ static void block_copy(int xe,
 	}
 
 	blt_set_batch(&blt.bb, bb, bb_size, region1);
-	blt_block_copy(xe, ctx, NULL, ahnd, &blt, pext);
-	intel_ctx_xe_sync(ctx, true);
+	if (config->striped) {
+		igt_assert_eq(blt_copy_striped(xe, ctx, ahnd, XY_BLOCK_COPY,
+					       &blt, pext, 0), 0);
+	} else {
+		blt_block_copy(xe, ctx, NULL, ahnd, &blt, pext);
+		intel_ctx_xe_sync(ctx, true);
+	}
 
 	WRITE_PNG(xe, run_id, "dst", &blt.dst, width, height, bpp);
 
-	result = memcmp(src->ptr, blt.dst.ptr, src->size);
+	result = igt_bufcmp(&cmp, blt.dst.ptr, src->ptr, src->size, 0) != 0;
+	blt_print_mismatches(xe, &blt.dst, bpp, &cmp);
 
 	/* Politely clean vm */
 	put_offset(ahnd, src->handle);
@@ -495,6 +517,7 @@ static void block_multicopy(int xe,
 	int mid_compression_format = param.compression_format;
 	enum blt_compression_type comp_type = COMPRESSION_TYPE_3D;
 	uint8_t uc_mocs = intel_get_uc_mocs_index(xe);
+	struct igt_bufcmp cmp;
 	int result;
 
 	bb = xe_bo_create(xe, 0, bb_size, region1, DRM_XE_GEM_CREATE_FLAG_NEEDS_VISIBLE_VRAM);
@@ -554,7 +577,8 @@ static void block_multicopy(int xe,
 	WRITE_PNG(xe, run_id, "dst", &blt3.dst, width, height, bpp);
 	WRITE_PNG(xe, run_id, "final", &blt3.final, width, height, bpp);
 
-	result = memcmp(src->ptr, blt3.final.ptr, src->size);
+	result = igt_bufcmp(&cmp, blt3.final.ptr, src->ptr, src->size, 0) != 0;
+	blt_print_mismatches(xe, &blt3.final, bpp, &cmp);
 
 	put_offset(ahnd, src->handle);
 	put_offset(ahnd, mid->handle);
@@ -908,6 +932,21 @@ igt_main_args("bf:pst:W:H:", NULL, help_str, opt_handler, NULL)
 		block_copy_test(xe, &config, set, BLOCK_COPY);
 	}
 
+	igt_describe("Check block-copy uncompressed blit split across copy engines");
+	igt_subtest_with_dynamic("block-copy-striped-uncompressed") {
+		struct test_config config = { .striped = true };
+
+		block_copy_test(xe, &config, set, BLOCK_COPY);
+	}
+
+	igt_describe("Check block-copy compressed blit split across copy engines");
+	igt_subtest_with_dynamic("block-copy-striped-compressed") {
+		struct test_config config = { .compression = true,
+					      .striped = true };
+
+		block_copy_test(xe, &config, set, BLOCK_COPY);
+	}
+
 	igt_describe("Check block-multicopy flatccs compressed blit");
 	igt_subtest_with_dynamic("block-multicopy-compressed") {
 		struct test_config config = { .compression = true };
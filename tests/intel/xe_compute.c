@@ -203,6 +203,51 @@ test_compute_square(int fd)
 		      "GPU not supported\n");
 }
 
+/**
+ * SUBTEST: compute-square-persistent
+ * GPU requirement: PVC, LNL, PTL
+ * Description:
+ *	Dispatch the square kernel repeatedly through a persistent execution
+ *	environment, with several dispatches in flight and varying work sizes,
+ *	and check the output of each.
+ */
+static void
+test_compute_square_persistent(int fd)
+{
+	struct user_execenv user = { .array_size = 4096 };
+	const unsigned int num_slots = 4;
+	struct intel_compute_env *env;
+
+	env = intel_compute_env_create(fd, NULL, &user, EXECENV_PREF_SYSTEM,
+				       num_slots);
+	igt_require_f(env, "GPU not supported\n");
+
+	for (int pass = 0; pass < 8; pass++) {
+		uint32_t work_size = pass & 1 ? user.array_size : 1024;
+
+		for (unsigned int slot = 0; slot < num_slots; slot++) {
+			float *input = intel_compute_env_input(env, slot);
+
+			intel_compute_env_wait(env, slot);
+			for (int i = 0; i < work_size; i++)
+				input[i] = pass * num_slots + slot + i / 1024.0f;
+			intel_compute_env_dispatch(env, slot, work_size);
+		}
+
+		for (unsigned int slot = 0; slot < num_slots; slot++) {
+			float *input = intel_compute_env_input(env, slot);
+			float *output = intel_compute_env_output(env, slot);
+
+			intel_compute_env_wait(env, slot);
+			for (int i = 0; i < work_size; i++)
+				igt_assert_eq_double(output[i],
+						     input[i] * input[i]);
+		}
+	}
+
+	intel_compute_env_destroy(env);
+}
+
 igt_main
 {
 	int xe;
@@ -214,6 +259,9 @@ igt_main
 	igt_subtest("compute-square")
 		test_compute_square(xe);
 
+	igt_subtest("compute-square-persistent")
+		test_compute_square_persistent(xe);
+
 	igt_fixture
 		drm_close_driver(xe);
 
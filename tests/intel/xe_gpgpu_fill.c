@@ -38,6 +38,10 @@
 #define SIZE (HEIGHT*STRIDE)
 #define COLOR_88	0x88
 #define COLOR_4C	0x4c
+#define COLOR_C4	0xc4
+
+#define RECTS_SURFACE	1024
+#define RECTS_TILE	64
 
 static bool dump_surface;
 static uint32_t surfwidth = WIDTH;
@@ -91,6 +95,10 @@ static void buf_check(uint8_t *ptr, int width, int x, int y, uint8_t color)
  * SUBTEST: offset-16x16
  * Description: run gpgpu fill with <x,y> start position == <16,16>
  *
+ * SUBTEST: rects
+ * Description: run gpgpu fill of many rectangles in one batch and report
+ *		the fill bandwidth
+ *
  */
 
 static void gpgpu_fill(data_t *data, igt_fillfunc_t fill, uint32_t region,
@@ -134,6 +142,52 @@ static void gpgpu_fill(data_t *data, igt_fillfunc_t fill, uint32_t region,
 	munmap(ptr, buf->surface[0].size);
 }
 
+static void gpgpu_fill_rects(data_t *data, igt_fillfunc_rects_t fill)
+{
+	const unsigned int tiles = RECTS_SURFACE / RECTS_TILE;
+	const unsigned int count = tiles * tiles;
+	struct timespec start = {};
+	struct igt_fill_rect *rects;
+	struct intel_buf *buf;
+	uint64_t elapsed;
+	uint8_t *ptr;
+	int i, x, y;
+
+	rects = calloc(count, sizeof(*rects));
+	igt_assert(rects);
+
+	for (i = 0; i < count; i++) {
+		rects[i].x = i % tiles * RECTS_TILE;
+		rects[i].y = i / tiles * RECTS_TILE;
+		rects[i].width = RECTS_TILE;
+		rects[i].height = RECTS_TILE;
+		/* Runs of one color, reloading it between walkers */
+		rects[i].color = (i / 4) & 1 ? COLOR_C4 : COLOR_4C;
+	}
+
+	buf = create_buf(data, RECTS_SURFACE, RECTS_SURFACE, COLOR_88, 0);
+	ptr = xe_bo_map(data->drm_fd, buf->handle, buf->surface[0].size);
+
+	igt_nsec_elapsed(&start);
+	fill(data->drm_fd, buf, rects, count);
+	elapsed = igt_nsec_elapsed(&start);
+
+	for (i = 0; i < count; i++)
+		for (y = rects[i].y; y < rects[i].y + rects[i].height; y++)
+			for (x = rects[i].x; x < rects[i].x + rects[i].width; x++)
+				buf_check(ptr, RECTS_SURFACE, x, y,
+					  rects[i].color);
+
+	igt_info("Filled %u rectangles of %u KiB in %.3f ms: %.1f MiB/s\n",
+		 count, RECTS_SURFACE * RECTS_SURFACE / 1024, elapsed / 1e6,
+		 RECTS_SURFACE * RECTS_SURFACE / (1024.0 * 1024) /
+		 (elapsed / 1e9));
+
+	munmap(ptr, buf->surface[0].size);
+	intel_buf_destroy(buf);
+	free(rects);
+}
+
 static int opt_handler(int opt, int opt_index, void *data)
 {
 	switch (opt) {
@@ -173,6 +227,7 @@ igt_main_args("dW:H:X:Y:", NULL, help_str, opt_handler, NULL)
 {
 	data_t data = {0, };
 	igt_fillfunc_t fill_fn = NULL;
+	igt_fillfunc_rects_t fill_rects_fn = NULL;
 
 	igt_fixture {
 		data.drm_fd = drm_open_driver_render(DRIVER_XE);
@@ -181,6 +236,7 @@ igt_main_args("dW:H:X:Y:", NULL, help_str, opt_handler, NULL)
 
 		fill_fn = igt_get_gpgpu_fillfunc(data.devid);
 		igt_require_f(fill_fn, "no gpgpu-fill function\n");
+		fill_rects_fn = igt_get_gpgpu_fillfunc_rects(data.devid);
 
 		start_x = ALIGN(start_x, 4);
 	}
@@ -201,6 +257,11 @@ igt_main_args("dW:H:X:Y:", NULL, help_str, opt_handler, NULL)
 			   surfheight / 2);
 	}
 
+	igt_subtest("rects") {
+		igt_require(fill_rects_fn);
+		gpgpu_fill_rects(&data, fill_rects_fn);
+	}
+
 	igt_fixture {
 		buf_ops_destroy(data.bops);
 		drm_close_driver(data.drm_fd);
@@ -500,6 +500,120 @@ static void blit(struct buf_ops *bops, uint8_t allocator_type)
 	intel_bb_destroy(ibb);
 }
 
+/**
+ * SUBTEST: blit-persistent
+ * Description: Run blits in a loop keeping objects bound between execs
+ */
+#define PERSISTENT_LOOPS 16
+static void blit_persistent(struct buf_ops *bops)
+{
+	int xe = buf_ops_get_fd(bops);
+	struct intel_bb *ibb;
+	struct intel_buf *src, *dst;
+	uint8_t color = COLOR_00;
+	int i;
+
+	ibb = intel_bb_create_with_allocator(xe, 0, 0, NULL, PAGE_SIZE,
+					     INTEL_ALLOCATOR_SIMPLE);
+	intel_bb_set_persistent_binds(ibb, true);
+
+	if (debug_bb)
+		intel_bb_set_debug(ibb, true);
+
+	src = create_buf(bops, WIDTH, HEIGHT, COLOR_CC);
+	dst = create_buf(bops, WIDTH, HEIGHT, COLOR_00);
+
+	for (i = 0; i < PERSISTENT_LOOPS; i++) {
+		color = i & 1 ? COLOR_77 : COLOR_CC;
+		fill_buf(src, color);
+		fill_buf(dst, COLOR_00);
+
+		__emit_blit(ibb, src, dst);
+		intel_bb_emit_bbe(ibb);
+		intel_bb_exec(ibb, intel_bb_offset(ibb),
+			      I915_EXEC_DEFAULT | I915_EXEC_NO_RELOC, true);
+		intel_bb_reset(ibb, false);
+		check_buf(dst, color);
+	}
+
+	/* Removed dst gets unbound with the next exec, new one gets bound */
+	intel_buf_destroy(dst);
+	dst = create_buf(bops, WIDTH, HEIGHT, COLOR_00);
+
+	__emit_blit(ibb, src, dst);
+	intel_bb_emit_bbe(ibb);
+	intel_bb_exec(ibb, intel_bb_offset(ibb),
+		      I915_EXEC_DEFAULT | I915_EXEC_NO_RELOC, true);
+	intel_bb_reset(ibb, false);
+	check_buf(dst, color);
+
+	intel_buf_destroy(src);
+	intel_buf_destroy(dst);
+	intel_bb_destroy(ibb);
+}
+
+/**
+ * SUBTEST: blit-replay
+ * Description: Freeze a blit batch and replay it many times
+ *
+ * SUBTEST: blit-replay-persistent
+ * Description: Freeze a blit batch with objects already bound by an
+ *		earlier exec in persistent binds mode and replay it
+ */
+#define REPLAY_LOOPS 64
+static void blit_replay(struct buf_ops *bops, bool persistent)
+{
+	int xe = buf_ops_get_fd(bops);
+	struct intel_bb *ibb;
+	struct intel_bb_frozen *frozen;
+	struct intel_buf *src, *dst;
+
+	ibb = intel_bb_create_with_allocator(xe, 0, 0, NULL, PAGE_SIZE,
+					     INTEL_ALLOCATOR_SIMPLE);
+	if (persistent)
+		intel_bb_set_persistent_binds(ibb, true);
+	if (debug_bb)
+		intel_bb_set_debug(ibb, true);
+
+	src = create_buf(bops, WIDTH, HEIGHT, COLOR_CC);
+	dst = create_buf(bops, WIDTH, HEIGHT, COLOR_00);
+
+	/* Bind everything up front, freeze then has no binds to submit */
+	if (persistent) {
+		__emit_blit(ibb, src, dst);
+		intel_bb_emit_bbe(ibb);
+		intel_bb_exec(ibb, intel_bb_offset(ibb),
+			      I915_EXEC_DEFAULT | I915_EXEC_NO_RELOC, true);
+		intel_bb_reset(ibb, false);
+		check_buf(dst, COLOR_CC);
+		fill_buf(dst, COLOR_00);
+	}
+
+	__emit_blit(ibb, src, dst);
+	intel_bb_emit_bbe(ibb);
+	frozen = intel_bb_freeze(ibb, intel_bb_offset(ibb),
+				 I915_EXEC_DEFAULT | I915_EXEC_NO_RELOC);
+
+	/* Frozen bb is referenced, reset must not touch it */
+	intel_bb_reset(ibb, false);
+
+	intel_bb_replay(frozen, REPLAY_LOOPS, false);
+	igt_assert_eq(intel_bb_frozen_sync(frozen), 0);
+	check_buf(dst, COLOR_CC);
+
+	fill_buf(src, COLOR_77);
+	intel_bb_replay(frozen, REPLAY_LOOPS, true);
+	igt_assert_eq(intel_bb_frozen_sync(frozen), 0);
+	check_buf(dst, COLOR_77);
+
+	intel_bb_frozen_destroy(frozen);
+	intel_bb_reset(ibb, false);
+
+	intel_buf_destroy(src);
+	intel_buf_destroy(dst);
+	intel_bb_destroy(ibb);
+}
+
 static void scratch_buf_init(struct buf_ops *bops,
 			     struct intel_buf *buf,
 			     int width, int height,
@@ -1034,6 +1148,15 @@ igt_main_args("dpib", NULL, help_str, opt_handler, NULL)
 	igt_subtest("blit-reloc")
 		blit(bops, INTEL_ALLOCATOR_RELOC);
 
+	igt_subtest("blit-persistent")
+		blit_persistent(bops);
+
+	igt_subtest("blit-replay")
+		blit_replay(bops, false);
+
+	igt_subtest("blit-replay-persistent")
+		blit_replay(bops, true);
+
 	igt_subtest("intel-bb-blit-none")
 		do_intel_bb_blit(bops, 3, I915_TILING_NONE);
 
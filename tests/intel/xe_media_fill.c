@@ -38,6 +38,10 @@
  * SUBTEST: media-fill
  * Description: Basic test for the media_fill() function,
  *              a very simple workload for the Media pipeline.
+ *
+ * SUBTEST: media-fill-rects
+ * Description: Fill many rectangles in one batch and report the fill
+ *              bandwidth.
  */
 
 IGT_TEST_DESCRIPTION("Basic test for the media_fill() function, a very simple"
@@ -50,6 +54,10 @@ IGT_TEST_DESCRIPTION("Basic test for the media_fill() function, a very simple"
 
 #define COLOR_C4	0xc4
 #define COLOR_4C	0x4c
+#define COLOR_88	0x88
+
+#define RECTS_SURFACE	1024
+#define RECTS_TILE	64
 
 struct data_t {
 	int drm_fd;
@@ -115,10 +123,60 @@ static void media_fill(struct data_t *data, igt_fillfunc_t fill)
 	munmap(ptr, buf->surface[0].size);
 }
 
+static void media_fill_rects(struct data_t *data, igt_fillfunc_rects_t fill)
+{
+	const unsigned int tiles = RECTS_SURFACE / RECTS_TILE;
+	const unsigned int count = tiles * tiles;
+	struct timespec start = {};
+	struct igt_fill_rect *rects;
+	struct intel_buf *buf;
+	uint64_t elapsed;
+	uint8_t *ptr, val;
+	int i, x, y;
+
+	rects = calloc(count, sizeof(*rects));
+	igt_assert(rects);
+
+	for (i = 0; i < count; i++) {
+		rects[i].x = i % tiles * RECTS_TILE;
+		rects[i].y = i / tiles * RECTS_TILE;
+		rects[i].width = RECTS_TILE;
+		rects[i].height = RECTS_TILE;
+		/* Runs of one color, both sharing and reloading the curbe */
+		rects[i].color = (i / 4) & 1 ? COLOR_88 : COLOR_4C;
+	}
+
+	buf = create_buf(data, RECTS_SURFACE, RECTS_SURFACE, COLOR_C4);
+	ptr = xe_bo_map(data->drm_fd, buf->handle, buf->surface[0].size);
+
+	igt_nsec_elapsed(&start);
+	fill(data->drm_fd, buf, rects, count);
+	elapsed = igt_nsec_elapsed(&start);
+
+	for (i = 0; i < count; i++)
+		for (y = rects[i].y; y < rects[i].y + rects[i].height; y++)
+			for (x = rects[i].x; x < rects[i].x + rects[i].width; x++) {
+				val = ptr[y * RECTS_SURFACE + x];
+				igt_assert_f(val == rects[i].color,
+					     "Expected 0x%02x, found 0x%02x at (%d,%d)\n",
+					     rects[i].color, val, x, y);
+			}
+
+	igt_info("Filled %u rectangles of %u KiB in %.3f ms: %.1f MiB/s\n",
+		 count, RECTS_SURFACE * RECTS_SURFACE / 1024, elapsed / 1e6,
+		 RECTS_SURFACE * RECTS_SURFACE / (1024.0 * 1024) /
+		 (elapsed / 1e9));
+
+	munmap(ptr, buf->surface[0].size);
+	intel_buf_destroy(buf);
+	free(rects);
+}
+
 igt_main
 {
 	struct data_t data = {0, };
 	igt_fillfunc_t fill_fn = NULL;
+	igt_fillfunc_rects_t fill_rects_fn = NULL;
 
 	igt_fixture {
 		data.drm_fd = drm_open_driver_render(DRIVER_XE);
@@ -128,11 +186,17 @@ igt_main
 		fill_fn = igt_get_media_fillfunc(data.devid);
 
 		igt_require_f(fill_fn, "no media-fill function\n");
+		fill_rects_fn = igt_get_media_fillfunc_rects(data.devid);
 	}
 
 	igt_subtest("media-fill")
 		media_fill(&data, fill_fn);
 
+	igt_subtest("media-fill-rects") {
+		igt_require(fill_rects_fn);
+		media_fill_rects(&data, fill_rects_fn);
+	}
+
 	igt_fixture {
 		buf_ops_destroy(data.bops);
 		drm_close_driver(data.drm_fd);
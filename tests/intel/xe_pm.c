@@ -194,12 +194,16 @@ static void cleanup_d3(device_t device)
 
 static bool in_d3(device_t device, enum igt_acpi_d_state state)
 {
+	uint64_t elapsed;
 	uint16_t val;
 
 	/* We need to wait for the autosuspend to kick in before we can check */
-	if (!igt_wait_for_pm_status(IGT_RUNTIME_PM_STATUS_SUSPENDED))
+	if (!__igt_wait_for_pm_status(IGT_RUNTIME_PM_STATUS_SUSPENDED,
+				      10000, &elapsed))
 		return false;
 
+	igt_info("Runtime suspend entry took %.3fms\n", elapsed * 1e-6);
+
 	if (runtime_usage_available(device.pci_xe) &&
 	    igt_pm_get_runtime_usage(device.pci_xe) != 0)
 		return false;
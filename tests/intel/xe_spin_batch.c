@@ -130,6 +130,61 @@ static void spin_all(int fd, int gt, int class)
 	xe_vm_destroy(fd, vm);
 }
 
+/**
+ * SUBTEST: spin-array
+ * Description: Run an array of spinners sharing a single bo on exec queues
+ *		of the same engine, all of them have to get timesliced in, and
+ *		check their CS timestamps.
+ */
+
+#define SPIN_ARRAY_COUNT 8
+
+static void spin_array(int fd, struct drm_xe_engine_class_instance *hwe)
+{
+	uint32_t exec_queues[SPIN_ARRAY_COUNT], vm;
+	struct xe_spin_array *arr;
+	struct xe_spin *first;
+	uint64_t ahnd;
+	int i;
+
+	vm = xe_vm_create(fd, 0, 0);
+	ahnd = intel_allocator_open(fd, vm, INTEL_ALLOCATOR_RELOC);
+	arr = xe_spin_array_create_opts(fd, vm, SPIN_ARRAY_COUNT, ahnd,
+					.preempt = true, .cs_timestamps = true);
+
+	for (i = 0; i < SPIN_ARRAY_COUNT; i++) {
+		exec_queues[i] = xe_exec_queue_create(fd, vm, hwe, 0);
+		xe_spin_array_submit(arr, i, exec_queues[i]);
+	}
+
+	for (i = 0; i < SPIN_ARRAY_COUNT; i++)
+		xe_spin_wait_started(xe_spin_array_get(arr, i));
+
+	xe_spin_array_sync_end(arr);
+
+	first = xe_spin_array_get(arr, 0);
+	for (i = 0; i < SPIN_ARRAY_COUNT; i++) {
+		struct xe_spin *spin = xe_spin_array_get(arr, i);
+
+		igt_assert(spin->start_timestamp);
+		igt_assert_lt_u32(0, spin->end_timestamp - spin->start_timestamp);
+		igt_debug("spinner %d: started after %"PRIu64"ns, ran for %"PRIu64"ns\n",
+			  i, xe_ticks_to_nsec(fd, hwe->gt_id,
+					      spin->start_timestamp -
+					      first->start_timestamp),
+			  xe_ticks_to_nsec(fd, hwe->gt_id,
+					   spin->end_timestamp -
+					   spin->start_timestamp));
+	}
+
+	xe_spin_array_destroy(arr);
+	for (i = 0; i < SPIN_ARRAY_COUNT; i++)
+		xe_exec_queue_destroy(fd, exec_queues[i]);
+
+	put_ahnd(ahnd);
+	xe_vm_destroy(fd, vm);
+}
+
 struct data {
 	uint32_t batch[16];
 	uint64_t pad;
@@ -555,6 +610,10 @@ igt_main
 				spin_all(fd, gt, class);
 	}
 
+	igt_subtest("spin-array")
+		xe_for_each_engine(fd, hwe)
+			spin_array(fd, hwe);
+
 	igt_subtest("spin-fixed-duration")
 		xe_spin_fixed_duration(fd, 0, DRM_XE_ENGINE_CLASS_COPY, SPIN_FIX_DURATION_NORMAL);
 
@@ -384,6 +384,25 @@ static void set_vfs_scheduling_params(int pf_fd, int num_vfs,
 	}
 }
 
+/* Enables and probes the VFs, with the same scheduling params as the PF */
+static void enable_vfs_with_scheduling_params(int pf_fd, int num_vfs,
+					      const struct vf_sched_params *p)
+{
+	struct xe_sriov_config *cfg = xe_sriov_config_create(pf_fd, num_vfs);
+	unsigned int gt;
+
+	xe_for_each_gt(pf_fd, gt) {
+		xe_sriov_config_set_exec_quantum_ms(cfg, XE_SRIOV_CONFIG_ALL, gt,
+						    p->exec_quantum_ms);
+		xe_sriov_config_set_preempt_timeout_us(cfg, XE_SRIOV_CONFIG_ALL, gt,
+						       p->preempt_timeout_us);
+	}
+
+	cfg->probe = true;
+	xe_sriov_config_apply(pf_fd, cfg);
+	xe_sriov_config_destroy(cfg);
+}
+
 static bool check_within_epsilon(const double x, const double ref, const double tol)
 {
 	return x <= (1.0 + tol) * ref && x >= (1.0 - tol) * ref;
@@ -663,15 +682,8 @@ static void throughput_ratio(int pf_fd, int num_vfs, const struct subm_opts *opt
 		    &(struct init_vf_ids_opts){ .shuffle = true,
 						.shuffle_pf = true });
 	xe_sriov_require_default_scheduling_attributes(pf_fd);
-	/* enable VFs */
-	igt_sriov_disable_driver_autoprobe(pf_fd);
-	igt_sriov_enable_vfs(pf_fd, num_vfs);
-	/* set scheduling params (PF and VFs) */
-	set_vfs_scheduling_params(pf_fd, num_vfs, &job_sched_params.sched_params);
-	/* probe VFs */
-	igt_sriov_enable_driver_autoprobe(pf_fd);
-	for (int vf = 1; vf <= num_vfs; ++vf)
-		igt_sriov_bind_vf_drm_driver(pf_fd, vf);
+	/* enable VFs, set scheduling params (PF and VFs) and probe VFs */
+	enable_vfs_with_scheduling_params(pf_fd, num_vfs, &job_sched_params.sched_params);
 
 	/* init subm_set */
 	subm_set_alloc_data(set, num_vfs + 1 /*PF*/);
@@ -761,15 +773,8 @@ static void nonpreempt_engine_resets(int pf_fd, int num_vfs,
 		    &(struct init_vf_ids_opts){ .shuffle = true,
 						.shuffle_pf = true });
 	xe_sriov_require_default_scheduling_attributes(pf_fd);
-	/* enable VFs */
-	igt_sriov_disable_driver_autoprobe(pf_fd);
-	igt_sriov_enable_vfs(pf_fd, num_vfs);
-	/* set scheduling params (PF and VFs) */
-	set_vfs_scheduling_params(pf_fd, num_vfs, &vf_sched_params);
-	/* probe VFs */
-	igt_sriov_enable_driver_autoprobe(pf_fd);
-	for (int vf = 1; vf <= num_vfs; ++vf)
-		igt_sriov_bind_vf_drm_driver(pf_fd, vf);
+	/* enable VFs, set scheduling params (PF and VFs) and probe VFs */
+	enable_vfs_with_scheduling_params(pf_fd, num_vfs, &vf_sched_params);
 
 	/* init subm_set */
 	subm_set_alloc_data(set, num_vfs + 1 /*PF*/);
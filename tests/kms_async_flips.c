@@ -146,6 +146,7 @@ typedef struct {
 	bool hang;
 	bool dpms;
 	struct buf_ops *bops;
+	struct igt_atomic_template *flip;
 	bool atomic_path;
 	bool overlay_path;
 	bool linear_modifier;
@@ -294,6 +295,10 @@ static void test_init(data_t *data)
 {
 	drmModeModeInfo *mode;
 
+	/* Left behind by a subtest failing mid-loop */
+	igt_atomic_template_free(data->flip);
+	data->flip = NULL;
+
 	igt_display_reset(&data->display);
 	igt_display_commit(&data->display);
 
@@ -399,6 +404,9 @@ static int perform_flip(data_t *data, int frame, int flags)
 	if (!data->atomic_path) {
 		ret = drmModePageFlip(data->drm_fd, data->crtc_id,
 				     bufs[frame % NUM_FBS].fb_id, flags, data);
+	} else if (data->flip) {
+		igt_atomic_template_set_fb(data->flip, plane, &bufs[frame % NUM_FBS]);
+		ret = igt_atomic_template_try_commit(data->flip, flags, data);
 	} else {
 		igt_plane_set_fb(plane, &bufs[frame % NUM_FBS]);
 		ret = igt_display_try_commit_atomic(&data->display, flags, data);
@@ -441,6 +449,10 @@ static void test_async_flip(data_t *data)
 	if (data->overlay_path)
 		require_overlay_flip_support(data);
 
+	/* Keep building the atomic request out of the measured loop */
+	if (data->atomic_path)
+		data->flip = igt_atomic_template_capture(&data->display);
+
 	gettimeofday(&start, NULL);
 	frame = 1;
 	do {
@@ -535,6 +547,9 @@ static void test_async_flip(data_t *data)
 		frame++;
 	} while (diff.tv_sec < RUN_TIME);
 
+	igt_atomic_template_free(data->flip);
+	data->flip = NULL;
+
 	if (data->suspend_resume || data->dpms)
 		run_time = RUN_TIME - (1.0 / data->refresh_rate);
 	else
@@ -122,7 +122,6 @@ typedef struct {
 	struct igt_fb fbs[2], argb_fb, sprite_fb;
 	igt_display_t display;
 	bool extended;
-	igt_pipe_crc_t *pipe_crcs[IGT_MAX_PIPES];
 } data_t;
 
 /* globals for fence support */
@@ -878,19 +877,36 @@ static void refresh_primaries(data_t  *data, int mask)
 	}
 }
 
-static void collect_crcs_mask(igt_pipe_crc_t **pipe_crcs, unsigned mask, igt_crc_t *crcs)
+static void collect_crcs_mask(data_t *data, unsigned mask, igt_crc_t *crcs)
 {
-	int i;
-
-	for (i = 0; i < IGT_MAX_PIPES; i++) {
-		if (!((1 << i) & mask))
-			continue;
+	enum pipe pipes[IGT_MAX_PIPES];
+	igt_crc_t group_crcs[IGT_MAX_PIPES];
+	igt_pipe_crc_group_t *group;
+	int i, n = 0;
 
-		if (!pipe_crcs[i])
-			continue;
+	if (!is_intel_device(data->drm_fd))
+		return;
 
-		igt_pipe_crc_collect_crc(pipe_crcs[i], &crcs[i]);
+	for_each_pipe(&data->display, i) {
+		if ((1 << i) & mask)
+			pipes[n++] = i;
 	}
+
+	if (!n)
+		return;
+
+	/* Capture all the pipes in the same frames */
+	group = igt_pipe_crc_group_new(data->drm_fd, pipes, n,
+				       IGT_PIPE_CRC_SOURCE_AUTO);
+
+	igt_debug_wait_for_keypress("crc");
+
+	igt_pipe_crc_group_start(group);
+	igt_pipe_crc_group_get_crcs(group, 1, group_crcs);
+	igt_pipe_crc_group_free(group);
+
+	for (i = 0; i < n; i++)
+		crcs[pipes[i]] = group_crcs[i];
 }
 
 static void run_modeset_tests(data_t *data, int howmany, bool nonblocking, bool fencing)
@@ -924,10 +940,6 @@ retry:
 		/* count enable pipes to set max iteration */
 		j += 1;
 
-		if (is_intel_device(data->drm_fd))
-			data->pipe_crcs[i] = igt_pipe_crc_new(data->drm_fd, i,
-							      IGT_PIPE_CRC_SOURCE_AUTO);
-
 		for_each_valid_output_on_pipe(&data->display, i, output) {
 			if (output->pending_pipe != PIPE_NONE)
 				continue;
@@ -987,7 +999,7 @@ retry:
 
 		commit_display(data, event_mask, nonblocking);
 
-		collect_crcs_mask(data->pipe_crcs, i, crcs[0]);
+		collect_crcs_mask(data, i, crcs[0]);
 
 		for (j = iter_max - 1; j > i + 1; j--) {
 			if (igt_hweight(j) > howmany)
@@ -1002,22 +1014,22 @@ retry:
 
 			commit_display(data, event_mask, nonblocking);
 
-			collect_crcs_mask(data->pipe_crcs, j, crcs[1]);
+			collect_crcs_mask(data, j, crcs[1]);
 
 			refresh_primaries(data, j);
 			commit_display(data, j, nonblocking);
-			collect_crcs_mask(data->pipe_crcs, j, crcs[2]);
+			collect_crcs_mask(data, j, crcs[2]);
 
 			event_mask = set_combinations(data, i, &data->fbs[0]);
 			if (!event_mask)
 				continue;
 
 			commit_display(data, event_mask, nonblocking);
-			collect_crcs_mask(data->pipe_crcs, i, crcs[3]);
+			collect_crcs_mask(data, i, crcs[3]);
 
 			refresh_primaries(data, i);
 			commit_display(data, i, nonblocking);
-			collect_crcs_mask(data->pipe_crcs, i, crcs[4]);
+			collect_crcs_mask(data, i, crcs[4]);
 
 			if (!is_intel_device(data->drm_fd))
 				continue;
@@ -1072,11 +1084,6 @@ static void run_modeset_transition(data_t *data, int requested_outputs, bool non
 	unset_output_pipe(&data->display);
 	igt_display_commit2(&data->display, COMMIT_ATOMIC);
 
-	if (is_intel_device(data->drm_fd)) {
-		for_each_pipe(&data->display, pipe)
-			igt_pipe_crc_free(data->pipe_crcs[pipe]);
-	}
-
 	igt_remove_fb(data->drm_fd, &data->fbs[0]);
 	igt_remove_fb(data->drm_fd, &data->fbs[1]);
 }
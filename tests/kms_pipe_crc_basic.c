@@ -270,7 +270,7 @@ static void test_compare_crc(data_t *data, enum pipe pipe, igt_output_t *output,
 
 	pipe_crc = igt_pipe_crc_new(data->drm_fd, pipe,
 				    IGT_PIPE_CRC_SOURCE_AUTO);
-	igt_pipe_crc_collect_crc(pipe_crc, &ref_crc);
+	igt_pipe_crc_collect_reference(pipe_crc, display, &ref_crc);
 
 	/* Flip FB1 with the primary plane & compare the CRC with ref CRC. */
 	igt_plane_set_fb(primary, &fb1);
@@ -333,7 +333,7 @@ static void argb_opaque(data_t *data, enum pipe pipe, igt_plane_t *plane)
 	/* alpha = 1.0, plane should be fully opaque, test with an opaque fb */
 	igt_plane_set_fb(plane, &data->xrgb_fb);
 	igt_display_commit2(display, COMMIT_ATOMIC);
-	igt_pipe_crc_collect_crc(data->pipe_crc, &ref_crc);
+	igt_pipe_crc_collect_reference(data->pipe_crc, display, &ref_crc);
 
 	igt_plane_set_fb(plane, &data->argb_fb_100);
 	igt_display_commit2(display, COMMIT_ATOMIC);
@@ -350,7 +350,7 @@ static void argb_transparent(data_t *data, enum pipe pipe, igt_plane_t *plane)
 	/* alpha = 1.0, plane should be fully opaque, test with a transparent fb */
 	igt_plane_set_fb(plane, NULL);
 	igt_display_commit2(display, COMMIT_ATOMIC);
-	igt_pipe_crc_collect_crc(data->pipe_crc, &ref_crc);
+	igt_pipe_crc_collect_reference(data->pipe_crc, display, &ref_crc);
 
 	igt_plane_set_fb(plane, &data->argb_fb_0);
 	igt_display_commit2(display, COMMIT_ATOMIC);
@@ -366,7 +366,7 @@ static void constant_alpha_min(data_t *data, enum pipe pipe, igt_plane_t *plane)
 
 	igt_plane_set_fb(plane, NULL);
 	igt_display_commit2(display, COMMIT_ATOMIC);
-	igt_pipe_crc_collect_crc(data->pipe_crc, &ref_crc);
+	igt_pipe_crc_collect_reference(data->pipe_crc, display, &ref_crc);
 
 	igt_plane_set_prop_enum(plane, IGT_PLANE_PIXEL_BLEND_MODE, "None");
 	igt_plane_set_prop_value(plane, IGT_PLANE_ALPHA, 0);
@@ -393,7 +393,7 @@ static void constant_alpha_mid(data_t *data, enum pipe pipe, igt_plane_t *plane)
 	igt_plane_set_prop_value(plane, IGT_PLANE_ALPHA, 0x7fff);
 	igt_plane_set_fb(plane, &data->xrgb_fb);
 	igt_display_commit2(display, COMMIT_ATOMIC);
-	igt_pipe_crc_collect_crc(data->pipe_crc, &ref_crc);
+	igt_pipe_crc_collect_reference(data->pipe_crc, display, &ref_crc);
 
 	igt_plane_set_fb(plane, &data->argb_fb_cov_0);
 	igt_display_commit2(display, COMMIT_ATOMIC);
@@ -416,7 +416,7 @@ static void constant_alpha_max(data_t *data, enum pipe pipe, igt_plane_t *plane)
 
 	igt_plane_set_fb(plane, &data->argb_fb_100);
 	igt_display_commit2(display, COMMIT_ATOMIC);
-	igt_pipe_crc_collect_crc(data->pipe_crc, &ref_crc);
+	igt_pipe_crc_collect_reference(data->pipe_crc, display, &ref_crc);
 
 	igt_plane_set_prop_enum(plane, IGT_PLANE_PIXEL_BLEND_MODE, "None");
 	igt_display_commit2(display, COMMIT_ATOMIC);
@@ -219,12 +219,14 @@ test_planes_on_pipe_with_output(data_t *data, igt_plane_t *plane, uint64_t modif
 	igt_output_override_mode(data->output, &mode_lowres);
 	igt_plane_set_fb(primary, &data->ref_lowres.fb);
 	igt_display_commit2(&data->display, COMMIT_ATOMIC);
-	igt_pipe_crc_collect_crc(data->pipe_crc, &data->ref_lowres.crc);
+	igt_pipe_crc_collect_reference(data->pipe_crc, &data->display,
+				       &data->ref_lowres.crc);
 
 	igt_output_override_mode(data->output, NULL);
 	igt_plane_set_fb(primary, &data->ref_hires.fb);
 	igt_display_commit2(&data->display, COMMIT_ATOMIC);
-	igt_pipe_crc_collect_crc(data->pipe_crc, &data->ref_hires.crc);
+	igt_pipe_crc_collect_reference(data->pipe_crc, &data->display,
+				       &data->ref_hires.crc);
 
 	igt_plane_set_fb(primary, &data->fb_primary);
 	igt_display_commit2(&data->display, COMMIT_ATOMIC);
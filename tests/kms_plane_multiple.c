@@ -161,7 +161,7 @@ get_reference_crc(data_t *data, igt_output_t *output, enum pipe pipe, igt_pipe_c
 	ret = igt_display_try_commit2(&data->display, COMMIT_ATOMIC);
 	igt_skip_on(ret != 0);
 
-	igt_pipe_crc_collect_crc(pipe_crc, ref_crc);
+	igt_pipe_crc_collect_reference(pipe_crc, &data->display, ref_crc);
 }
 
 static void
@@ -196,6 +196,20 @@ igt_main
                 igt_panfrost_free_job(fd, submit);
         }
 
+        igt_subtest("pan-submit-pipelined") {
+                struct panfrost_job_ring *ring;
+
+                /* Each job is checked before its slot is reused */
+                ring = igt_panfrost_job_ring_new(fd, 8, true);
+                for (int i = 0; i < 64; i++)
+                        igt_panfrost_job_ring_submit(ring);
+
+                igt_panfrost_job_ring_wait(ring);
+                for (int i = 0; i < ring->depth; i++)
+                        igt_panfrost_job_ring_check(ring, i);
+                igt_panfrost_job_ring_free(ring);
+        }
+
         igt_fixture {
                 drm_close_driver(fd);
         }
@@ -14,6 +14,7 @@
 #include <math.h>
 #include <poll.h>
 #include <signal.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -29,6 +30,7 @@
 #include "igt_core.h"
 #include "igt_drm_clients.h"
 #include "igt_drm_fdinfo.h"
+#include "igt_openmetrics.h"
 #include "igt_profiling.h"
 #include "drmtest.h"
 
@@ -151,16 +153,16 @@ engines_identical(const struct igt_drm_client *c,
 }
 
 static bool
-newheader(const struct igt_drm_client *c, const struct igt_drm_client *pc)
+same_device(const struct igt_drm_client *c, const struct igt_drm_client *pc)
 {
-	return !pc || c->drm_minor != pc->drm_minor ||
+	return c->drm_minor == pc->drm_minor &&
 	       /*
 		* Below is a a hack for drivers like amdgpu which omit listing
 		* unused engines. Simply treat them as separate minors which
 		* will ensure the per-engine columns are correctly sized in all
 		* cases.
 		*/
-	       !engines_identical(c, pc);
+	       engines_identical(c, pc);
 }
 
 static int
@@ -178,48 +180,76 @@ print_size(uint64_t sz)
 	return printf("%7"PRIu64"%c ", sz, units[u]);
 }
 
+static bool
+client_utilization_type(const struct igt_drm_client *c,
+			enum utilization_type *utilization_type)
+{
+	if (c->utilization_mask & IGT_DRM_CLIENT_UTILIZATION_TOTAL_CYCLES &&
+	    c->utilization_mask & IGT_DRM_CLIENT_UTILIZATION_CYCLES)
+		*utilization_type = UTILIZATION_TYPE_TOTAL_CYCLES;
+	else if (c->utilization_mask & IGT_DRM_CLIENT_UTILIZATION_ENGINE_TIME)
+		*utilization_type = UTILIZATION_TYPE_ENGINE_TIME;
+	else
+		return false;
+
+	return true;
+}
+
+static double
+client_engine_busy(const struct igt_drm_client *c,
+		   enum utilization_type utilization_type, unsigned int i,
+		   unsigned int period_us)
+{
+	double pct = 0.0;
+
+	switch (utilization_type) {
+	case UTILIZATION_TYPE_ENGINE_TIME:
+		pct = (double)c->utilization[i].delta_engine_time / period_us / 1e3 * 100 /
+			c->engines->capacity[i];
+		break;
+	case UTILIZATION_TYPE_TOTAL_CYCLES:
+		pct = (double)c->utilization[i].delta_cycles / c->utilization[i].delta_total_cycles * 100 /
+			c->engines->capacity[i];
+		break;
+	}
+
+	/*
+	 * Guard against fluctuations between our scanning period and
+	 * GPU times as exported by the kernel in fdinfo.
+	 */
+	if (pct > 100.0)
+		pct = 100.0;
+
+	return pct;
+}
+
 static int
-print_client(struct igt_drm_client *c, struct igt_drm_client **prevc,
-	     double t, int lines, int con_w, int con_h,
-	     unsigned int period_us, int *engine_w)
+print_client(struct igt_drm_client *c, double t, int lines, int con_w,
+	     int con_h, unsigned int period_us, int *engine_w)
 {
 	enum utilization_type utilization_type;
 	unsigned int i;
 	uint64_t sz;
 	int len;
 
-	if (c->utilization_mask & IGT_DRM_CLIENT_UTILIZATION_TOTAL_CYCLES &&
-	    c->utilization_mask & IGT_DRM_CLIENT_UTILIZATION_CYCLES)
-		utilization_type = UTILIZATION_TYPE_TOTAL_CYCLES;
-	else if (c->utilization_mask & IGT_DRM_CLIENT_UTILIZATION_ENGINE_TIME)
-		utilization_type = UTILIZATION_TYPE_ENGINE_TIME;
-	else
-		return 0;
+	if (!client_utilization_type(c, &utilization_type))
+		return lines;
 
 	if (c->samples < 2)
-		return 0;
+		return lines;
 
 	/* Filter out idle clients. */
 	switch (utilization_type) {
 	case UTILIZATION_TYPE_ENGINE_TIME:
 	       if (!c->total_engine_time)
-		       return 0;
+		       return lines;
 	       break;
 	case UTILIZATION_TYPE_TOTAL_CYCLES:
 	       if (!c->total_total_cycles)
-		       return 0;
+		       return lines;
 	       break;
 	}
 
-	/* Print header when moving to a different DRM card. */
-	if (newheader(c, *prevc)) {
-		lines = print_client_header(c, lines, con_w, con_h, engine_w);
-		if (lines >= con_h)
-			return lines;
-	}
-
-	*prevc = c;
-
 	len = printf("%*s ", c->clients->max_pid_len, c->pid_str);
 
 	if (c->regions->num_regions) {
@@ -235,38 +265,288 @@ print_client(struct igt_drm_client *c, struct igt_drm_client **prevc,
 	lines++;
 
 	for (i = 0; c->samples > 1 && i <= c->engines->max_engine_id; i++) {
-		double pct;
-
 		if (!c->engines->capacity[i])
 			continue;
 
-		switch (utilization_type) {
-		case UTILIZATION_TYPE_ENGINE_TIME:
-			pct = (double)c->utilization[i].delta_engine_time / period_us / 1e3 * 100 /
-				c->engines->capacity[i];
-			break;
-		case UTILIZATION_TYPE_TOTAL_CYCLES:
-			pct = (double)c->utilization[i].delta_cycles / c->utilization[i].delta_total_cycles * 100 /
-				c->engines->capacity[i];
-			break;
+		print_percentage_bar(client_engine_busy(c, utilization_type,
+							i, period_us),
+				     *engine_w);
+		len += *engine_w;
+	}
+
+	printf(" %-*s\n", con_w - len - 1, c->print_name);
+
+	return lines;
+}
+
+/*
+ * Clients of one device, as split by same_device(), or of one cgroup on a
+ * device, aggregated from the single scan of all clients.
+ */
+struct device_summary {
+	struct igt_drm_client *first; /* Client defining minor and engines. */
+	const char *cgroup; /* Set when split by cgroup. */
+	unsigned int num_clients;
+	uint64_t total;
+	uint64_t resident;
+	double *busy; /* Per engine busyness of all clients, in percent. */
+};
+
+static unsigned int
+summarize_devices(struct igt_drm_clients *clients, unsigned int period_us,
+		  const struct igt_drm_client *device,
+		  struct device_summary **devices)
+{
+	struct device_summary *devs = NULL, *d;
+	unsigned int num_devs = 0, i, j;
+	struct igt_drm_client *c;
+	int tmp;
+
+	igt_for_each_drm_client(clients, c, tmp) {
+		enum utilization_type utilization_type;
+
+		if (c->status != IGT_DRM_CLIENT_ALIVE)
+			break; /* Active clients are first in the array. */
+
+		if (device && !same_device(c, device))
+			continue;
+
+		for (j = 0; j < num_devs; j++) {
+			if (same_device(c, devs[j].first) &&
+			    (!device || !strcmp(c->cgroup, devs[j].cgroup)))
+				break;
+		}
+
+		if (j == num_devs) {
+			devs = realloc(devs, ++num_devs * sizeof(*devs));
+			assert(devs);
+
+			d = &devs[j];
+			memset(d, 0, sizeof(*d));
+			d->first = c;
+			d->cgroup = device ? c->cgroup : NULL;
+			d->busy = calloc(c->engines->max_engine_id + 1,
+					 sizeof(*d->busy));
+			assert(d->busy);
 		}
 
-		/*
-		 * Guard against fluctuations between our scanning period and
-		 * GPU times as exported by the kernel in fdinfo.
-		 */
-		if (pct > 100.0)
-			pct = 100.0;
+		d = &devs[j];
+		d->num_clients++;
 
-		print_percentage_bar(pct, *engine_w);
-		len += *engine_w;
+		for (i = 0; c->regions->num_regions &&
+			    i <= c->regions->max_region_id; i++) {
+			d->total += c->memory[i].total;
+			d->resident += c->memory[i].resident;
+		}
+
+		if (c->samples < 2 ||
+		    !client_utilization_type(c, &utilization_type))
+			continue;
+
+		for (i = 0; i <= c->engines->max_engine_id; i++) {
+			double pct;
+
+			if (!c->engines->capacity[i])
+				continue;
+
+			pct = client_engine_busy(c, utilization_type, i,
+						 period_us);
+			if (isfinite(pct))
+				d->busy[i] += pct;
+		}
 	}
 
-	printf(" %-*s\n", con_w - len - 1, c->print_name);
+	*devices = devs;
+
+	return num_devs;
+}
+
+static void free_device_summaries(struct device_summary *devs,
+				  unsigned int num_devs)
+{
+	unsigned int i;
+
+	for (i = 0; i < num_devs; i++)
+		free(devs[i].busy);
+	free(devs);
+}
+
+static int
+print_cluster_header(struct device_summary *devs, unsigned int num_devs,
+		     int lines, int con_w, int con_h)
+{
+	unsigned int i, num_clients = 0;
+	uint64_t total = 0, resident = 0;
+	int len;
+
+	if (lines++ >= con_h)
+		return lines;
+
+	for (i = 0; i < num_devs; i++) {
+		num_clients += devs[i].num_clients;
+		total += devs[i].total;
+		resident += devs[i].resident;
+	}
+
+	printf(ANSI_HEADER);
+	len = printf("%u device%s, %u client%s, MEM ",
+		     num_devs, num_devs == 1 ? "" : "s",
+		     num_clients, num_clients == 1 ? "" : "s");
+	len += print_size(total);
+	len += printf("RSS ");
+	len += print_size(resident);
+	printf("%*s" ANSI_RESET "\n", con_w > len ? con_w - len : 0, "");
 
 	return lines;
 }
 
+static int
+print_device_summary(struct device_summary *d, int lines, int con_w,
+		     int con_h, int engine_w)
+{
+	struct igt_drm_client *c = d->first;
+	unsigned int i;
+
+	if (lines++ >= con_h)
+		return lines;
+
+	printf("%*s ", c->clients->max_pid_len, d->cgroup ? "-" : "ALL");
+
+	if (c->regions->num_regions) {
+		print_size(d->total);
+		print_size(d->resident);
+	}
+
+	for (i = 0; i <= c->engines->max_engine_id; i++) {
+		if (!c->engines->capacity[i])
+			continue;
+
+		/* Clients share the engine capacity. */
+		print_percentage_bar(d->busy[i] > 100.0 ? 100.0 : d->busy[i],
+				     engine_w);
+	}
+
+	if (d->cgroup)
+		printf(" %s (%u client%s)\n", d->cgroup, d->num_clients,
+		       d->num_clients == 1 ? "" : "s");
+	else
+		printf(" %u client%s\n", d->num_clients,
+		       d->num_clients == 1 ? "" : "s");
+
+	return lines;
+}
+
+static void client_labels(const struct igt_drm_client *c, char *minor,
+			  char *id, char *pid, size_t len)
+{
+	snprintf(minor, len, "%u", c->drm_minor);
+	snprintf(id, len, "%lu", c->id);
+	snprintf(pid, len, "%u", c->pid);
+}
+
+/*
+ * Render the last scan into a new snapshot. Scrapes are answered from it
+ * until the next scan, so they never rescan the clients.
+ */
+static void
+openmetrics_update(struct igt_openmetrics *om, struct igt_drm_clients *clients,
+		   unsigned int period_us)
+{
+	static const struct {
+		const char *name;
+		const char *help;
+		size_t offset;
+	} fams[] = {
+		{ "drm_client_memory_total_bytes",
+		  "Memory allocated by the client",
+		  offsetof(struct drm_client_meminfo, total) },
+		{ "drm_client_memory_shared_bytes",
+		  "Memory shared by the client with others",
+		  offsetof(struct drm_client_meminfo, shared) },
+		{ "drm_client_memory_resident_bytes",
+		  "Client memory resident in the region",
+		  offsetof(struct drm_client_meminfo, resident) },
+		{ "drm_client_memory_purgeable_bytes",
+		  "Client memory the kernel may reclaim",
+		  offsetof(struct drm_client_meminfo, purgeable) },
+		{ "drm_client_memory_active_bytes",
+		  "Client memory in use by the GPU",
+		  offsetof(struct drm_client_meminfo, active) },
+	};
+	struct igt_drm_client *c;
+	char minor[16], id[16], pid[16];
+	unsigned int i, j;
+	int tmp;
+
+	igt_openmetrics_begin(om);
+
+	igt_openmetrics_family(om, "drm_client_engine_busy_ratio", "gauge",
+			       "Client busyness of the engine capacity");
+
+	igt_for_each_drm_client(clients, c, tmp) {
+		enum utilization_type utilization_type;
+
+		if (c->status != IGT_DRM_CLIENT_ALIVE)
+			break; /* Active clients are first in the array. */
+
+		if (c->samples < 2 ||
+		    !client_utilization_type(c, &utilization_type))
+			continue;
+
+		client_labels(c, minor, id, pid, sizeof(minor));
+
+		for (i = 0; i <= c->engines->max_engine_id; i++) {
+			double pct;
+
+			if (!c->engines->capacity[i])
+				continue;
+
+			pct = client_engine_busy(c, utilization_type, i,
+						 period_us);
+			if (!isfinite(pct))
+				continue;
+
+			igt_openmetrics_sample(om, "drm_client_engine_busy_ratio",
+					       pct / 100,
+					       "minor", minor, "id", id,
+					       "pid", pid, "name", c->print_name,
+					       "cgroup", c->cgroup,
+					       "engine", c->engines->names[i],
+					       NULL);
+		}
+	}
+
+	for (j = 0; j < ARRAY_SIZE(fams); j++) {
+		igt_openmetrics_family(om, fams[j].name, "gauge", fams[j].help);
+
+		igt_for_each_drm_client(clients, c, tmp) {
+			if (c->status != IGT_DRM_CLIENT_ALIVE)
+				break;
+
+			client_labels(c, minor, id, pid, sizeof(minor));
+
+			for (i = 0; i < c->regions->num_regions &&
+				    i <= c->regions->max_region_id; i++) {
+				const uint64_t *sz = (void *)&c->memory[i] +
+						     fams[j].offset;
+
+				if (!c->regions->names[i])
+					continue;
+
+				igt_openmetrics_sample(om, fams[j].name, *sz,
+						       "minor", minor, "id", id,
+						       "pid", pid,
+						       "name", c->print_name,
+						       "cgroup", c->cgroup,
+						       "region", c->regions->names[i],
+						       NULL);
+			}
+		}
+	}
+
+	igt_openmetrics_commit(om);
+}
+
 static int
 __client_id_cmp(const struct igt_drm_client *a,
 		const struct igt_drm_client *b)
@@ -333,6 +613,9 @@ static void clrscr(void)
 struct gputop_args {
 	long n_iter;
 	unsigned long delay_usec;
+	const char *metrics_address;
+	bool aggregate;
+	bool cgroups;
 };
 
 static void help(char *full_path)
@@ -350,16 +633,22 @@ static void help(char *full_path)
 	       "\t-h, --help                show this help\n"
 	       "\t-d, --delay =SEC[.TENTHS] iterative delay as SECS [.TENTHS]\n"
 	       "\t-n, --iterations =NUMBER  number of executions\n"
+	       "\t-m, --metrics =[HOST:]PORT serve OpenMetrics over HTTP instead of printing\n"
+	       "\t-a, --aggregate           only show the per device totals\n"
+	       "\t-g, --cgroup              aggregate clients by cgroup\n"
 	       , short_program_name);
 }
 
 static int parse_args(int argc, char * const argv[], struct gputop_args *args)
 {
-	static const char cmdopts_s[] = "hn:d:";
+	static const char cmdopts_s[] = "hn:d:m:ag";
 	static const struct option cmdopts[] = {
 	       {"help", no_argument, 0, 'h'},
 	       {"delay", required_argument, 0, 'd'},
 	       {"iterations", required_argument, 0, 'n'},
+	       {"metrics", required_argument, 0, 'm'},
+	       {"aggregate", no_argument, 0, 'a'},
+	       {"cgroup", no_argument, 0, 'g'},
 	       { }
 	};
 
@@ -390,6 +679,15 @@ static int parse_args(int argc, char * const argv[], struct gputop_args *args)
 				return -1;
 			}
 			break;
+		case 'm':
+			args->metrics_address = optarg;
+			break;
+		case 'a':
+			args->aggregate = true;
+			break;
+		case 'g':
+			args->cgroups = true;
+			break;
 		case 'h':
 			help(argv[0]);
 			return 0;
@@ -416,6 +714,7 @@ int main(int argc, char **argv)
 	unsigned int period_us;
 	struct igt_profiled_device *profiled_devices = NULL;
 	struct igt_drm_clients *clients = NULL;
+	struct igt_openmetrics *om = NULL;
 	int con_w = -1, con_h = -1;
 	int ret;
 	long n;
@@ -429,6 +728,15 @@ int main(int argc, char **argv)
 	n = args.n_iter;
 	period_us = args.delay_usec;
 
+	if (args.metrics_address) {
+		om = igt_openmetrics_listen(args.metrics_address);
+		if (!om) {
+			fprintf(stderr, "Failed to listen on %s! (%s)\n",
+				args.metrics_address, strerror(errno));
+			return EXIT_FAILURE;
+		}
+	}
+
 	clients = igt_drm_clients_init(NULL);
 	if (!clients)
 		exit(1);
@@ -448,12 +756,20 @@ int main(int argc, char **argv)
 	igt_drm_clients_scan(clients, NULL, NULL, 0, NULL, 0);
 
 	while ((n != 0) && !stop_top) {
-		struct igt_drm_client *c, *prevc = NULL;
+		struct device_summary *devs;
+		unsigned int num_devs, d;
+		struct igt_drm_client *c;
 		int i, engine_w = 0, lines = 0;
 
 		igt_drm_clients_scan(clients, NULL, NULL, 0, NULL, 0);
 		igt_drm_clients_sort(clients, client_cmp);
 
+		if (om) {
+			openmetrics_update(om, clients, period_us);
+			igt_openmetrics_serve(om, period_us);
+			goto next;
+		}
+
 		update_console_size(&con_w, &con_h);
 		clrscr();
 
@@ -464,22 +780,59 @@ int main(int argc, char **argv)
 			       (int)(con_w - strlen(msg) - 1), msg);
 		}
 
-		igt_for_each_drm_client(clients, c, i) {
-			assert(c->status != IGT_DRM_CLIENT_PROBE);
-			if (c->status != IGT_DRM_CLIENT_ALIVE)
-				break; /* Active clients are first in the array. */
+		num_devs = summarize_devices(clients, period_us, NULL, &devs);
+		if (num_devs)
+			lines = print_cluster_header(devs, num_devs, lines,
+						     con_w, con_h);
+
+		for (d = 0; d < num_devs && lines < con_h; d++) {
+			lines = print_client_header(devs[d].first, lines,
+						    con_w, con_h, &engine_w);
+			lines = print_device_summary(&devs[d], lines, con_w,
+						     con_h, engine_w);
+			if (args.aggregate)
+				continue;
 
-			lines = print_client(c, &prevc, (double)period_us / 1e6,
-					     lines, con_w, con_h, period_us,
-					     &engine_w);
-			if (lines >= con_h)
-				break;
+			if (args.cgroups) {
+				struct device_summary *cgs;
+				unsigned int num_cgs, cg;
+
+				num_cgs = summarize_devices(clients, period_us,
+							    devs[d].first, &cgs);
+				for (cg = 0; cg < num_cgs; cg++)
+					lines = print_device_summary(&cgs[cg],
+								     lines,
+								     con_w,
+								     con_h,
+								     engine_w);
+				free_device_summaries(cgs, num_cgs);
+				continue;
+			}
+
+			igt_for_each_drm_client(clients, c, i) {
+				assert(c->status != IGT_DRM_CLIENT_PROBE);
+				if (c->status != IGT_DRM_CLIENT_ALIVE)
+					break; /* Active clients are first in the array. */
+
+				if (lines >= con_h)
+					break;
+
+				if (!same_device(c, devs[d].first))
+					continue;
+
+				lines = print_client(c, (double)period_us / 1e6,
+						     lines, con_w, con_h,
+						     period_us, &engine_w);
+			}
 		}
 
+		free_device_summaries(devs, num_devs);
+
 		if (lines++ < con_h)
 			printf("\n");
 
 		usleep(period_us);
+next:
 		if (n > 0)
 			n--;
 
@@ -488,6 +841,7 @@ int main(int argc, char **argv)
 	}
 
 	igt_drm_clients_free(clients);
+	igt_openmetrics_close(om);
 
 	if (profiled_devices != NULL) {
 		igt_devices_configure_profiling(profiled_devices, false);
@@ -26,6 +26,7 @@
 #include <getopt.h>
 #include <inttypes.h>
 #include <stdbool.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -54,7 +55,16 @@ usage(void)
 	       "     --counters, -c c1,c2,...  List of counters to display values for.\n"
 	       "                               Use 'all' to display all counters.\n"
 	       "                               Use 'list' to list available counters.\n"
-	       "     --reports, -r             Print out data per report.\n");
+	       "     --reports, -r             Print out data per report.\n"
+	       "     --window, -w start[,end]  Only decode the reports between start and end,\n"
+	       "                               in milliseconds from the beginning of the\n"
+	       "                               recording.\n"
+	       "     --csv, -C file            Write the counter values of each report to\n"
+	       "                               file as CSV.\n"
+	       "     --columnar, -b file       Write the counter values of each report to\n"
+	       "                               file in a columnar binary format.\n"
+	       "     --jobs, -j n              Number of threads evaluating per report\n"
+	       "                               counter values (default = online CPUs).\n");
 }
 
 static struct intel_perf_logical_counter *
@@ -166,12 +176,25 @@ get_logical_counters(struct intel_perf_metric_set *metric_set,
 	return counters;
 }
 
+union counter_value {
+	uint64_t u64;
+	double f;
+};
+
+static bool
+counter_is_float(const struct intel_perf_logical_counter *counter)
+{
+	return counter->storage == INTEL_PERF_LOGICAL_COUNTER_STORAGE_DOUBLE ||
+	       counter->storage == INTEL_PERF_LOGICAL_COUNTER_STORAGE_FLOAT;
+}
+
 static void
-print_report_deltas(const struct intel_perf_data_reader *reader,
-		    const struct drm_i915_perf_record_header *i915_report0,
-		    const struct drm_i915_perf_record_header *i915_report1,
-		    struct intel_perf_logical_counter **counters,
-		    uint32_t n_counters)
+evaluate_report_deltas(const struct intel_perf_data_reader *reader,
+		       const struct drm_i915_perf_record_header *i915_report0,
+		       const struct drm_i915_perf_record_header *i915_report1,
+		       struct intel_perf_logical_counter **counters,
+		       uint32_t n_counters,
+		       union counter_value *values)
 {
 	struct intel_perf_accumulator accu;
 
@@ -182,24 +205,384 @@ print_report_deltas(const struct intel_perf_data_reader *reader,
 	for (uint32_t c = 0; c < n_counters; c++) {
 		struct intel_perf_logical_counter *counter = counters[c];
 
-		switch (counter->storage) {
-		case INTEL_PERF_LOGICAL_COUNTER_STORAGE_UINT64:
-		case INTEL_PERF_LOGICAL_COUNTER_STORAGE_UINT32:
-		case INTEL_PERF_LOGICAL_COUNTER_STORAGE_BOOL32:
-			fprintf(stdout, "   %s: %" PRIu64 "\n",
-				counter->symbol_name, counter->read_uint64(reader->perf,
-									   reader->metric_set,
-									   accu.deltas));
-			break;
-		case INTEL_PERF_LOGICAL_COUNTER_STORAGE_DOUBLE:
-		case INTEL_PERF_LOGICAL_COUNTER_STORAGE_FLOAT:
+		if (counter_is_float(counter))
+			values[c].f = counter->read_float(reader->perf,
+							  reader->metric_set,
+							  accu.deltas);
+		else
+			values[c].u64 = counter->read_uint64(reader->perf,
+							     reader->metric_set,
+							     accu.deltas);
+	}
+}
+
+static void
+print_counter_values(struct intel_perf_logical_counter **counters,
+		     uint32_t n_counters,
+		     const union counter_value *values)
+{
+	for (uint32_t c = 0; c < n_counters; c++) {
+		struct intel_perf_logical_counter *counter = counters[c];
+
+		if (counter_is_float(counter))
 			fprintf(stdout, "   %s: %f\n",
-				counter->symbol_name, counter->read_float(reader->perf,
-									  reader->metric_set,
-									  accu.deltas));
+				counter->symbol_name, values[c].f);
+		else
+			fprintf(stdout, "   %s: %" PRIu64 "\n",
+				counter->symbol_name, values[c].u64);
+	}
+}
+
+/*
+ * The deltas between consecutive reports are evaluated by a pool of workers,
+ * in chunks of EVAL_CHUNK_RECORDS reports. Chunks are handed out in order and
+ * the workers never run more than max_ahead chunks ahead of the chunk being
+ * emitted, so memory use stays bounded however long the recording is.
+ */
+#define EVAL_CHUNK_RECORDS 4096
+
+struct eval_chunk {
+	union counter_value *values;
+	bool done;
+};
+
+struct report_evaluator {
+	const struct intel_perf_data_reader *reader;
+	struct intel_perf_logical_counter **counters;
+	uint32_t n_counters;
+
+	struct eval_chunk *chunks;
+	uint32_t n_chunks;
+	uint32_t next;		/* Next chunk to evaluate */
+	uint32_t current;	/* Chunk being emitted, earlier ones are freed */
+	uint32_t max_ahead;
+	bool stop;
+
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+
+	pthread_t *workers;
+	uint32_t n_workers;
+};
+
+static void
+evaluate_chunk(struct report_evaluator *ev, uint32_t idx)
+{
+	const struct intel_perf_data_reader *reader = ev->reader;
+	uint32_t first = idx * EVAL_CHUNK_RECORDS;
+	uint32_t last = MIN(first + EVAL_CHUNK_RECORDS, reader->n_records - 1);
+	union counter_value *values;
+
+	values = calloc((last - first) * ev->n_counters + 1, sizeof(*values));
+	assert(values);
+
+	for (uint32_t r = first; r < last; r++)
+		evaluate_report_deltas(reader,
+				       reader->records[r], reader->records[r + 1],
+				       ev->counters, ev->n_counters,
+				       values + (r - first) * ev->n_counters);
+
+	pthread_mutex_lock(&ev->lock);
+	ev->chunks[idx].values = values;
+	ev->chunks[idx].done = true;
+	pthread_cond_broadcast(&ev->cond);
+	pthread_mutex_unlock(&ev->lock);
+}
+
+static void *
+evaluator_worker(void *data)
+{
+	struct report_evaluator *ev = data;
+
+	pthread_mutex_lock(&ev->lock);
+	for (;;) {
+		uint32_t idx;
+
+		while (!ev->stop && ev->next < ev->n_chunks &&
+		       ev->next >= ev->current + ev->max_ahead)
+			pthread_cond_wait(&ev->cond, &ev->lock);
+
+		if (ev->stop || ev->next >= ev->n_chunks)
 			break;
+
+		idx = ev->next++;
+		pthread_mutex_unlock(&ev->lock);
+
+		evaluate_chunk(ev, idx);
+
+		pthread_mutex_lock(&ev->lock);
+	}
+	pthread_mutex_unlock(&ev->lock);
+
+	return NULL;
+}
+
+static void
+report_evaluator_fini(struct report_evaluator *ev)
+{
+	pthread_mutex_lock(&ev->lock);
+	ev->stop = true;
+	pthread_cond_broadcast(&ev->cond);
+	pthread_mutex_unlock(&ev->lock);
+
+	for (uint32_t i = 0; i < ev->n_workers; i++)
+		pthread_join(ev->workers[i], NULL);
+	free(ev->workers);
+
+	for (uint32_t i = 0; i < ev->n_chunks; i++)
+		free(ev->chunks[i].values);
+	free(ev->chunks);
+
+	pthread_cond_destroy(&ev->cond);
+	pthread_mutex_destroy(&ev->lock);
+}
+
+static bool
+report_evaluator_init(struct report_evaluator *ev,
+		      const struct intel_perf_data_reader *reader,
+		      struct intel_perf_logical_counter **counters,
+		      uint32_t n_counters,
+		      uint32_t n_workers)
+{
+	memset(ev, 0, sizeof(*ev));
+	ev->reader = reader;
+	ev->counters = counters;
+	ev->n_counters = n_counters;
+	ev->n_chunks = reader->n_records > 1 ?
+		(reader->n_records - 2) / EVAL_CHUNK_RECORDS + 1 : 0;
+	ev->max_ahead = 2 * n_workers;
+	pthread_mutex_init(&ev->lock, NULL);
+	pthread_cond_init(&ev->cond, NULL);
+
+	ev->chunks = calloc(ev->n_chunks + 1, sizeof(*ev->chunks));
+	ev->workers = calloc(n_workers, sizeof(*ev->workers));
+	if (!ev->chunks || !ev->workers) {
+		report_evaluator_fini(ev);
+		return false;
+	}
+
+	for (; ev->n_workers < n_workers; ev->n_workers++) {
+		int err = pthread_create(&ev->workers[ev->n_workers], NULL,
+					 evaluator_worker, ev);
+
+		if (err) {
+			errno = err;
+			report_evaluator_fini(ev);
+			return false;
 		}
 	}
+
+	return true;
+}
+
+/*
+ * Returns the counter values of the delta between reports @record and
+ * @record + 1. Records must be requested in increasing order.
+ */
+static const union counter_value *
+report_evaluator_get(struct report_evaluator *ev, uint32_t record)
+{
+	uint32_t idx = record / EVAL_CHUNK_RECORDS;
+	struct eval_chunk *chunk = &ev->chunks[idx];
+
+	pthread_mutex_lock(&ev->lock);
+	if (ev->current < idx) {
+		for (; ev->current < idx; ev->current++) {
+			free(ev->chunks[ev->current].values);
+			ev->chunks[ev->current].values = NULL;
+		}
+		pthread_cond_broadcast(&ev->cond);
+	}
+
+	while (!chunk->done)
+		pthread_cond_wait(&ev->cond, &ev->lock);
+	pthread_mutex_unlock(&ev->lock);
+
+	return chunk->values + (record % EVAL_CHUNK_RECORDS) * ev->n_counters;
+}
+
+/*
+ * Per report counter values can also be written as CSV or in a columnar
+ * binary format, which can be loaded without any text parsing. The binary
+ * file starts with a header:
+ *
+ *   char     magic[8]   "IGTPCOLS"
+ *   uint32_t version    1
+ *   uint32_t n_columns
+ *
+ * followed by, for each column, a uint32_t type (0 for uint64_t, 1 for
+ * double), a uint32_t name length including the terminating NUL and the
+ * name itself, padded to a multiple of 8 bytes. The data follows in blocks
+ * of a uint32_t row count, 4 bytes of padding and, for each column in turn,
+ * the 8 byte values of all the rows in the block. Everything is in host byte
+ * order.
+ *
+ * The first columns are the report index, its timestamp and the hw_id of its
+ * context, followed by the selected counters.
+ */
+#define OUTPUT_FIXED_COLUMNS 3
+
+struct report_output {
+	FILE *csv;
+	FILE *columnar;
+
+	struct intel_perf_logical_counter **counters;
+	uint32_t n_counters;
+
+	uint64_t *block;
+	uint32_t n_rows;
+};
+
+static bool
+write_column_header(FILE *file, uint32_t type, const char *name)
+{
+	static const char padding[8];
+	uint32_t len = strlen(name) + 1;
+
+	return fwrite(&type, sizeof(type), 1, file) == 1 &&
+	       fwrite(&len, sizeof(len), 1, file) == 1 &&
+	       fwrite(name, len, 1, file) == 1 &&
+	       fwrite(padding, 1, -len & 7, file) == (-len & 7);
+}
+
+static bool
+write_columnar_header(struct report_output *out)
+{
+	static const char * const fixed[OUTPUT_FIXED_COLUMNS] = {
+		"report", "timestamp", "hw_id",
+	};
+	uint32_t header[2] = { 1, OUTPUT_FIXED_COLUMNS + out->n_counters };
+
+	if (fwrite("IGTPCOLS", 8, 1, out->columnar) != 1 ||
+	    fwrite(header, sizeof(header), 1, out->columnar) != 1)
+		return false;
+
+	for (uint32_t i = 0; i < OUTPUT_FIXED_COLUMNS; i++) {
+		if (!write_column_header(out->columnar, 0, fixed[i]))
+			return false;
+	}
+
+	for (uint32_t c = 0; c < out->n_counters; c++) {
+		if (!write_column_header(out->columnar,
+					 counter_is_float(out->counters[c]),
+					 out->counters[c]->symbol_name))
+			return false;
+	}
+
+	return true;
+}
+
+static bool
+flush_columnar_block(struct report_output *out)
+{
+	uint32_t header[2] = { out->n_rows, 0 };
+	bool ok;
+
+	if (!out->n_rows)
+		return true;
+
+	ok = fwrite(header, sizeof(header), 1, out->columnar) == 1;
+	for (uint32_t i = 0; ok && i < OUTPUT_FIXED_COLUMNS + out->n_counters; i++)
+		ok = fwrite(out->block + i * EVAL_CHUNK_RECORDS,
+			    sizeof(*out->block), out->n_rows,
+			    out->columnar) == out->n_rows;
+
+	out->n_rows = 0;
+
+	return ok;
+}
+
+static bool
+report_output_close(struct report_output *out)
+{
+	bool ok = true;
+
+	if (out->columnar) {
+		ok &= flush_columnar_block(out);
+		ok &= fclose(out->columnar) == 0;
+	}
+	if (out->csv)
+		ok &= fclose(out->csv) == 0;
+	free(out->block);
+
+	return ok;
+}
+
+static bool
+report_output_open(struct report_output *out,
+		   const char *csv, const char *columnar,
+		   struct intel_perf_logical_counter **counters,
+		   uint32_t n_counters)
+{
+	memset(out, 0, sizeof(*out));
+	out->counters = counters;
+	out->n_counters = n_counters;
+
+	if (csv) {
+		out->csv = fopen(csv, "w");
+		if (!out->csv) {
+			fprintf(stderr, "Unable to open '%s': %s.\n",
+				csv, strerror(errno));
+			goto err;
+		}
+
+		fprintf(out->csv, "report,timestamp,hw_id");
+		for (uint32_t c = 0; c < n_counters; c++)
+			fprintf(out->csv, ",%s", counters[c]->symbol_name);
+		fprintf(out->csv, "\n");
+	}
+
+	if (columnar) {
+		out->columnar = fopen(columnar, "w");
+		out->block = calloc((OUTPUT_FIXED_COLUMNS + n_counters) * EVAL_CHUNK_RECORDS,
+				    sizeof(*out->block));
+		if (!out->columnar || !out->block ||
+		    !write_columnar_header(out)) {
+			fprintf(stderr, "Unable to write '%s': %s.\n",
+				columnar, strerror(errno));
+			goto err;
+		}
+	}
+
+	return true;
+
+err:
+	report_output_close(out);
+	return false;
+}
+
+static bool
+report_output_write(struct report_output *out,
+		    uint64_t report, uint64_t timestamp, uint32_t hw_id,
+		    const union counter_value *values)
+{
+	if (out->csv) {
+		fprintf(out->csv, "%" PRIu64 ",%" PRIu64 ",%u",
+			report, timestamp, hw_id);
+		for (uint32_t c = 0; c < out->n_counters; c++) {
+			if (counter_is_float(out->counters[c]))
+				fprintf(out->csv, ",%f", values[c].f);
+			else
+				fprintf(out->csv, ",%" PRIu64, values[c].u64);
+		}
+		fprintf(out->csv, "\n");
+	}
+
+	if (out->columnar) {
+		uint64_t *row = out->block + out->n_rows;
+
+		row[0 * EVAL_CHUNK_RECORDS] = report;
+		row[1 * EVAL_CHUNK_RECORDS] = timestamp;
+		row[2 * EVAL_CHUNK_RECORDS] = hw_id;
+		for (uint32_t c = 0; c < out->n_counters; c++)
+			memcpy(&row[(OUTPUT_FIXED_COLUMNS + c) * EVAL_CHUNK_RECORDS],
+			       &values[c], sizeof(*row));
+
+		if (++out->n_rows == EVAL_CHUNK_RECORDS)
+			return flush_columnar_block(out);
+	}
+
+	return true;
 }
 
 int
@@ -209,17 +592,26 @@ main(int argc, char *argv[])
 		{"help",             no_argument, 0, 'h'},
 		{"counters",   required_argument, 0, 'c'},
 		{"reports",          no_argument, 0, 'r'},
+		{"window",     required_argument, 0, 'w'},
+		{"csv",        required_argument, 0, 'C'},
+		{"columnar",   required_argument, 0, 'b'},
+		{"jobs",       required_argument, 0, 'j'},
 		{0, 0, 0, 0}
 	};
 	struct intel_perf_data_reader reader;
 	struct intel_perf_logical_counter **counters;
+	union counter_value *values = NULL;
 	const struct intel_device_info *devinfo;
-	const char *counter_names = NULL;
+	struct report_evaluator evaluator;
+	struct report_output output = {};
+	const char *counter_names = NULL, *csv_file = NULL, *columnar_file = NULL;
 	int32_t n_counters;
-	int fd, opt;
-	bool print_reports = false;
+	double window_start = 0, window_end = -1;
+	bool print_reports = false, window = false, per_report;
+	long n_jobs = sysconf(_SC_NPROCESSORS_ONLN);
+	int fd, opt, ret = EXIT_SUCCESS;
 
-	while ((opt = getopt_long(argc, argv, "hc:r", long_options, NULL)) != -1) {
+	while ((opt = getopt_long(argc, argv, "hc:rw:C:b:j:", long_options, NULL)) != -1) {
 		switch (opt) {
 		case 'h':
 			usage();
@@ -230,6 +622,29 @@ main(int argc, char *argv[])
 		case 'r':
 			print_reports = true;
 			break;
+		case 'w': {
+			char *end;
+
+			window = true;
+			window_start = strtod(optarg, &end);
+			if (*end == ',')
+				window_end = strtod(end + 1, &end);
+			if (*end || window_start < 0) {
+				fprintf(stderr, "Invalid window '%s'.\n", optarg);
+				usage();
+				return EXIT_FAILURE;
+			}
+			break;
+		}
+		case 'C':
+			csv_file = optarg;
+			break;
+		case 'b':
+			columnar_file = optarg;
+			break;
+		case 'j':
+			n_jobs = atol(optarg);
+			break;
 		default:
 			fprintf(stderr, "Internal error: "
 				"unexpected getopt value: %d\n", opt);
@@ -250,16 +665,37 @@ main(int argc, char *argv[])
 		return EXIT_FAILURE;
 	}
 
-	if (!intel_perf_data_reader_init(&reader, fd)) {
+	/*
+	 * For a window only the record headers are indexed up front and the
+	 * reports in the window decoded afterwards, which keeps opening huge
+	 * recordings cheap.
+	 */
+	if (!(window ? intel_perf_data_reader_open(&reader, fd) :
+	      intel_perf_data_reader_init(&reader, fd))) {
 		fprintf(stderr, "Unable to parse '%s': %s.\n",
 			argv[optind], reader.error_msg);
 		return EXIT_FAILURE;
 	}
 
+	if (window) {
+		uint64_t begin = reader.correlations[0]->cpu_timestamp;
+
+		if (!intel_perf_data_reader_load(&reader,
+						 begin + window_start * 1e6,
+						 window_end < 0 ? UINT64_MAX :
+						 begin + window_end * 1e6)) {
+			fprintf(stderr, "Unable to load window of '%s': %s.\n",
+				argv[optind], reader.error_msg);
+			return EXIT_FAILURE;
+		}
+	}
+
 	counters = get_logical_counters(reader.metric_set, counter_names, &n_counters);
 	if (n_counters < 0)
 		goto exit;
 
+	values = calloc(n_counters + 1, sizeof(*values));
+
 	devinfo = intel_get_device_info(reader.devinfo.devid);
 
 	fprintf(stdout, "Recorded on device=0x%x(%s) graphics_ver=%i\n",
@@ -268,7 +704,10 @@ main(int argc, char *argv[])
 	fprintf(stdout, "Metric used : %s (%s) uuid=%s\n",
 		reader.metric_set->symbol_name, reader.metric_set->name,
 		reader.metric_set->hw_config_guid);
-	fprintf(stdout, "Reports: %u\n", reader.n_records);
+	fprintf(stdout, "Reports: %u\n", reader.n_total_records);
+	if (window)
+		fprintf(stdout, "Reports in window: %u (from report %u)\n",
+			reader.n_records, reader.first_record);
 	fprintf(stdout, "Context switches: %u\n", reader.n_timelines);
 	fprintf(stdout, "Timestamp correlation points: %u\n", reader.n_correlations);
 
@@ -277,6 +716,11 @@ main(int argc, char *argv[])
 		return EXIT_FAILURE;
 	}
 
+	if (!reader.n_records) {
+		fprintf(stderr, "No reports to decode.\n");
+		goto exit;
+	}
+
 	fprintf(stdout, "Timestamp correlation CPU range:       0x%016"PRIx64"-0x%016"PRIx64"\n",
 		reader.correlations[0]->cpu_timestamp,
 		reader.correlations[reader.n_correlations - 1]->cpu_timestamp);
@@ -308,6 +752,22 @@ main(int argc, char *argv[])
 			"WARNING: This could lead to inconsistent counter values.\n");
 	}
 
+	if (!report_output_open(&output, csv_file, columnar_file,
+				counters, n_counters)) {
+		ret = EXIT_FAILURE;
+		goto exit;
+	}
+
+	per_report = print_reports || csv_file || columnar_file;
+	if (per_report &&
+	    !report_evaluator_init(&evaluator, &reader, counters, n_counters,
+				   MAX(1, n_jobs))) {
+		fprintf(stderr, "Unable to start evaluation threads: %s.\n",
+			strerror(errno));
+		ret = EXIT_FAILURE;
+		goto exit_output;
+	}
+
 	for (uint32_t i = 0; i < reader.n_timelines; i++) {
 		const struct intel_perf_timeline_item *item = &reader.timelines[i];
 
@@ -318,27 +778,53 @@ main(int argc, char *argv[])
 		fprintf(stdout, "hw_id=0x%x %s\n",
 			item->hw_id, item->hw_id == 0xffffffff ? "(idle)" : "");
 
-		print_report_deltas(&reader,
-				    reader.records[item->record_start],
-				    reader.records[item->record_end],
-				    counters, n_counters);
+		evaluate_report_deltas(&reader,
+				       reader.records[item->record_start],
+				       reader.records[item->record_end],
+				       counters, n_counters, values);
+		print_counter_values(counters, n_counters, values);
+
+		if (!per_report)
+			continue;
 
-		if (print_reports) {
-			for (uint32_t r = item->record_start; r < item->record_end; r++) {
+		for (uint32_t r = item->record_start; r < item->record_end; r++) {
+			const union counter_value *report_values =
+				report_evaluator_get(&evaluator, r);
+
+			if (print_reports) {
 				fprintf(stdout, " report%i = %s\n",
 					r - item->record_start,
 					intel_perf_read_report_reason(reader.perf, reader.records[r]));
-				print_report_deltas(&reader,
-						    reader.records[r],
-						    reader.records[r + 1],
-						    counters, n_counters);
+				print_counter_values(counters, n_counters, report_values);
+			}
+
+			if (!report_output_write(&output, reader.first_record + r,
+						 intel_perf_read_record_timestamp(reader.perf,
+										  reader.metric_set,
+										  reader.records[r]),
+						 item->hw_id, report_values)) {
+				fprintf(stderr, "Failed to write report values: %s.\n",
+					strerror(errno));
+				ret = EXIT_FAILURE;
+				goto exit_evaluator;
 			}
 		}
 	}
 
+ exit_evaluator:
+	if (per_report)
+		report_evaluator_fini(&evaluator);
+ exit_output:
+	if (!report_output_close(&output)) {
+		fprintf(stderr, "Failed to write report values: %s.\n",
+			strerror(errno));
+		ret = EXIT_FAILURE;
+	}
  exit:
+	free(values);
+	free(counters);
 	intel_perf_data_reader_fini(&reader);
 	close(fd);
 
-	return EXIT_SUCCESS;
+	return ret;
 }
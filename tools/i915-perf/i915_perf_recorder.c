@@ -28,6 +28,8 @@
 #include <inttypes.h>
 #include <limits.h>
 #include <poll.h>
+#include <pthread.h>
+#include <sched.h>
 #include <signal.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -35,6 +37,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/sysmacros.h>
 #include <sys/time.h>
@@ -203,6 +206,139 @@ cookie_io_functions_t circular_buffer_functions = {
 	.close = circular_buffer_close,
 };
 
+/*
+ * Continuous recordings go through a single producer, single consumer ring
+ * between the capture thread, which reads the i915-perf stream straight into
+ * it, and the main thread, which writes it out to the output file in large
+ * batches. The ring is mapped twice back to back so that any span of it is
+ * contiguous and neither side ever has to split, copy or move data around.
+ */
+#define CAPTURE_RING_SIZE	(64u << 20)
+#define CAPTURE_MIN_READ	(64u << 10)
+#define CAPTURE_WRITE_BATCH	(1u << 20)
+#define CAPTURE_WRITE_PERIOD_NS	1000000000ull
+#define CAPTURE_ALIGN		4096u
+
+struct capture_ring {
+	uint8_t *data;
+	size_t   size;
+
+	/* Free running, only advanced by the producer resp. the consumer. */
+	uint64_t head;
+	uint64_t tail;
+};
+
+static bool
+capture_ring_init(struct capture_ring *ring, size_t size)
+{
+	uint8_t *addr;
+	int fd;
+
+	assert(!(size & (size - 1)));
+
+	fd = memfd_create("i915-perf-capture", MFD_CLOEXEC);
+	if (fd < 0)
+		return false;
+
+	if (ftruncate(fd, size))
+		goto err_fd;
+
+	addr = mmap(NULL, 2 * size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (addr == MAP_FAILED)
+		goto err_fd;
+
+	if (mmap(addr, size, PROT_READ | PROT_WRITE,
+		 MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+	    mmap(addr + size, size, PROT_READ | PROT_WRITE,
+		 MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED)
+		goto err_map;
+
+	close(fd);
+
+	ring->data = addr;
+	ring->size = size;
+	ring->head = ring->tail = 0;
+
+	return true;
+
+err_map:
+	munmap(addr, 2 * size);
+err_fd:
+	close(fd);
+	return false;
+}
+
+static void
+capture_ring_fini(struct capture_ring *ring)
+{
+	if (ring->data)
+		munmap(ring->data, 2 * ring->size);
+	ring->data = NULL;
+}
+
+/* Producer side */
+static size_t
+capture_ring_space(const struct capture_ring *ring)
+{
+	return ring->size - (ring->head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE));
+}
+
+static uint8_t *
+capture_ring_head(const struct capture_ring *ring)
+{
+	return ring->data + (ring->head & (ring->size - 1));
+}
+
+static void
+capture_ring_produce(struct capture_ring *ring, size_t len)
+{
+	__atomic_store_n(&ring->head, ring->head + len, __ATOMIC_RELEASE);
+}
+
+/* Consumer side */
+static size_t
+capture_ring_count(const struct capture_ring *ring)
+{
+	return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) - ring->tail;
+}
+
+static const uint8_t *
+capture_ring_tail(const struct capture_ring *ring)
+{
+	return ring->data + (ring->tail & (ring->size - 1));
+}
+
+static void
+capture_ring_consume(struct capture_ring *ring, size_t len)
+{
+	__atomic_store_n(&ring->tail, ring->tail + len, __ATOMIC_RELEASE);
+}
+
+/*
+ * Stream used by the producer for the records it generates itself (headers
+ * and correlation timestamps), so that the existing writers can be reused.
+ */
+static ssize_t
+capture_ring_write(void *c, const char *buf, size_t size)
+{
+	struct capture_ring *ring = c;
+
+	if (size > ring->size)
+		return -1;
+
+	while (capture_ring_space(ring) < size)
+		usleep(1000);
+
+	memcpy(capture_ring_head(ring), buf, size);
+	capture_ring_produce(ring, size);
+
+	return size;
+}
+
+cookie_io_functions_t capture_ring_functions = {
+	.write = capture_ring_write,
+};
+
 
 static bool
 read_file_uint64(const char *file, uint64_t *value)
@@ -405,6 +541,15 @@ struct recording_context {
 	struct circular_buffer circular_buffer;
 	FILE *output_stream;
 
+	struct capture_ring capture_ring;
+	FILE *capture_stream;
+	pthread_t capture_thread;
+	uint64_t capture_period_ns;
+	bool capture_done;
+	int capture_error;
+	int output_fd;
+	bool output_direct;
+
 	const char *command_fifo;
 	int command_fifo_fd;
 
@@ -742,21 +887,299 @@ read_command_file(struct recording_context *ctx)
 	}
 }
 
+/*
+ * Restrict the calling thread to the CPUs local to the device, so that the
+ * copies out of the OA buffer stay on the device's node.
+ */
+static void
+pin_to_device_cpus(int drm_fd)
+{
+	char path[PATH_MAX], buf[4096], *s;
+	struct stat st;
+	cpu_set_t set;
+	ssize_t len;
+	int fd;
+
+	if (fstat(drm_fd, &st) || !S_ISCHR(st.st_mode))
+		return;
+
+	snprintf(path, sizeof(path), "/sys/dev/char/%d:%d/device/local_cpulist",
+		 major(st.st_rdev), minor(st.st_rdev));
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return;
+	len = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if (len <= 0)
+		return;
+	buf[len] = '\0';
+
+	CPU_ZERO(&set);
+	for (s = buf; *s && *s != '\n'; ) {
+		unsigned long first, last;
+
+		first = last = strtoul(s, &s, 10);
+		if (*s == '-')
+			last = strtoul(s + 1, &s, 10);
+		for (; first <= last && first < CPU_SETSIZE; first++)
+			CPU_SET(first, &set);
+		if (*s != ',')
+			break;
+		s++;
+	}
+
+	if (CPU_COUNT(&set))
+		pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+/*
+ * Read everything available from the stream directly into the free space of
+ * the ring. Returns false when the ring is too full to make progress.
+ */
+static bool
+capture_i915_perf_data(struct recording_context *ctx)
+{
+	struct capture_ring *ring = &ctx->capture_ring;
+	ssize_t ret;
+
+	for (;;) {
+		size_t space = capture_ring_space(ring);
+
+		if (space < CAPTURE_MIN_READ)
+			return false;
+
+		ret = read(ctx->perf_fd, capture_ring_head(ring), space);
+		if (ret > 0)
+			capture_ring_produce(ring, ret);
+		else if (ret < 0 && errno == EINTR)
+			continue;
+		else
+			return true;
+	}
+}
+
+static void *
+capture_thread(void *data)
+{
+	struct recording_context *ctx = data;
+	uint64_t poll_time_ns = ctx->capture_period_ns;
+	struct timespec now;
+
+	pin_to_device_cpus(ctx->drm_fd);
+
+	while (!__atomic_load_n(&quit, __ATOMIC_RELAXED)) {
+		struct pollfd pollfd = { ctx->perf_fd, POLLIN, 0 };
+		uint64_t elapsed_ns;
+		int ret;
+
+		igt_gettime(&now);
+		/* Bounded so that quit is noticed in a timely manner. */
+		ret = poll(&pollfd, 1, MIN(poll_time_ns / 1000000, 100));
+		if (ret < 0 && errno != EINTR) {
+			ctx->capture_error = errno;
+			fprintf(stderr, "Failed to poll i915-perf stream: %s\n",
+				strerror(errno));
+			break;
+		}
+
+		if (ret > 0 && (pollfd.revents & POLLIN) &&
+		    !capture_i915_perf_data(ctx)) {
+			/* Writer is behind, give it a chance to catch up. */
+			usleep(1000);
+		}
+
+		elapsed_ns = igt_nsec_elapsed(&now);
+		if (elapsed_ns > poll_time_ns) {
+			poll_time_ns = ctx->capture_period_ns;
+			if (!write_correlation_timestamps(ctx->capture_stream, ctx->drm_fd)) {
+				ctx->capture_error = errno;
+				fprintf(stderr,
+					"Failed to write i915 timestamp correlation data: %s\n",
+					strerror(errno));
+				break;
+			}
+		} else {
+			poll_time_ns -= elapsed_ns;
+		}
+	}
+
+	while (!capture_i915_perf_data(ctx))
+		usleep(1000);
+
+	if (!write_correlation_timestamps(ctx->capture_stream, ctx->drm_fd)) {
+		fprintf(stderr,
+			"Failed to write final i915 timestamp correlation data: %s\n",
+			strerror(errno));
+	}
+
+	__atomic_store_n(&ctx->capture_done, true, __ATOMIC_RELEASE);
+
+	return NULL;
+}
+
+/*
+ * Write out the content of the ring. While O_DIRECT is in use only whole
+ * blocks are written, the remainder goes out with the final flush.
+ */
+static bool
+flush_capture_ring(struct recording_context *ctx, bool final)
+{
+	struct capture_ring *ring = &ctx->capture_ring;
+	size_t count = capture_ring_count(ring);
+
+	if (final) {
+		if (ctx->output_direct && (count & (CAPTURE_ALIGN - 1))) {
+			int flags = fcntl(ctx->output_fd, F_GETFL);
+
+			fcntl(ctx->output_fd, F_SETFL, flags & ~O_DIRECT);
+			ctx->output_direct = false;
+		}
+	} else {
+		count &= ~(size_t)(CAPTURE_ALIGN - 1);
+	}
+
+	while (count) {
+		ssize_t ret = write(ctx->output_fd, capture_ring_tail(ring), count);
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+
+		capture_ring_consume(ring, ret);
+		count -= ret;
+	}
+
+	return true;
+}
+
+static bool
+record_continuous(struct recording_context *ctx)
+{
+	struct timespec last_write;
+	bool ok = true;
+	int ret;
+
+	ret = pthread_create(&ctx->capture_thread, NULL, capture_thread, ctx);
+	if (ret) {
+		fprintf(stderr, "Unable to start capture thread: %s\n",
+			strerror(ret));
+		return false;
+	}
+
+	igt_gettime(&last_write);
+	while (!__atomic_load_n(&ctx->capture_done, __ATOMIC_ACQUIRE)) {
+		struct pollfd pollfd = { ctx->command_fifo_fd, POLLIN, 0 };
+
+		if (poll(&pollfd, ctx->command_fifo_fd != -1 ? 1 : 0, 10) > 0 &&
+		    (pollfd.revents & POLLIN))
+			read_command_file(ctx);
+
+		if (capture_ring_count(&ctx->capture_ring) < CAPTURE_WRITE_BATCH &&
+		    igt_nsec_elapsed(&last_write) < CAPTURE_WRITE_PERIOD_NS)
+			continue;
+
+		if (!flush_capture_ring(ctx, false)) {
+			fprintf(stderr, "Failed to write i915-perf data: %s\n",
+				strerror(errno));
+			quit = true;
+			ok = false;
+			break;
+		}
+		igt_gettime(&last_write);
+	}
+
+	pthread_join(ctx->capture_thread, NULL);
+
+	if (ok && !flush_capture_ring(ctx, true)) {
+		fprintf(stderr, "Failed to write i915-perf data: %s\n",
+			strerror(errno));
+		ok = false;
+	}
+
+	return ok && !ctx->capture_error;
+}
+
+static void
+record_circular(struct recording_context *ctx, uint64_t corr_period_ns)
+{
+	uint64_t poll_time_ns = corr_period_ns;
+	struct timespec now;
+
+	while (!quit) {
+		struct pollfd pollfd[2] = {
+			{         ctx->perf_fd, POLLIN, 0 },
+			{ ctx->command_fifo_fd, POLLIN, 0 },
+		};
+		uint64_t elapsed_ns;
+		int ret;
+
+		igt_gettime(&now);
+		ret = poll(pollfd, ctx->command_fifo_fd != -1 ? 2 : 1, poll_time_ns / 1000000);
+		if (ret < 0 && errno != EINTR) {
+			fprintf(stderr, "Failed to poll i915-perf stream: %s\n",
+				strerror(errno));
+			break;
+		}
+
+		if (ret > 0) {
+			if (pollfd[0].revents & POLLIN) {
+				if (!write_i915_perf_data(ctx->output_stream, ctx->perf_fd)) {
+					fprintf(stderr, "Failed to write i915-perf data: %s\n",
+						strerror(errno));
+					break;
+				}
+			}
+
+			if (pollfd[1].revents & POLLIN) {
+				read_command_file(ctx);
+			}
+		}
+
+		elapsed_ns = igt_nsec_elapsed(&now);
+		if (elapsed_ns > poll_time_ns) {
+			poll_time_ns = corr_period_ns;
+			if (!write_correlation_timestamps(ctx->output_stream, ctx->drm_fd)) {
+				fprintf(stderr,
+					"Failed to write i915 timestamp correlation data: %s\n",
+					strerror(errno));
+				break;
+			}
+		} else {
+			poll_time_ns -= elapsed_ns;
+		}
+	}
+
+	if (!write_i915_perf_data(ctx->output_stream, ctx->perf_fd)) {
+		fprintf(stderr, "Failed to write i915-perf data: %s\n",
+			strerror(errno));
+	}
+
+	if (!write_correlation_timestamps(ctx->output_stream, ctx->drm_fd)) {
+		fprintf(stderr,
+			"Failed to write final i915 timestamp correlation data: %s\n",
+			strerror(errno));
+	}
+}
+
 static void
 print_metric_sets(const struct intel_perf *perf)
 {
-	struct intel_perf_metric_set *metric_set;
 	uint32_t longest_name = 0;
 
-	igt_list_for_each_entry(metric_set, &perf->metric_sets, link) {
-		longest_name = MAX(longest_name, strlen(metric_set->symbol_name));
+	for (uint32_t i = 0; i < perf->n_metric_set_descs; i++) {
+		longest_name = MAX(longest_name,
+				   strlen(perf->metric_set_descs[i].symbol_name));
 	}
 
-	igt_list_for_each_entry(metric_set, &perf->metric_sets, link) {
+	for (uint32_t i = 0; i < perf->n_metric_set_descs; i++) {
+		const struct intel_perf_metric_set_desc *desc = &perf->metric_set_descs[i];
+
 		fprintf(stdout, "%s:%*s%s\n",
-			metric_set->symbol_name,
-			(int) (longest_name - strlen(metric_set->symbol_name) + 1), " ",
-			metric_set->name);
+			desc->symbol_name,
+			(int) (longest_name - strlen(desc->symbol_name) + 1), " ",
+			desc->name);
 	}
 }
 
@@ -839,6 +1262,12 @@ teardown_recording_context(struct recording_context *ctx)
 	if (ctx->output_stream)
 		fclose(ctx->output_stream);
 
+	if (ctx->capture_stream)
+		fclose(ctx->capture_stream);
+	capture_ring_fini(&ctx->capture_ring);
+	if (ctx->output_fd != -1)
+		close(ctx->output_fd);
+
 	free(ctx->circular_buffer.data);
 
 	if (ctx->perf_fd != -1)
@@ -903,17 +1332,15 @@ main(int argc, char *argv[])
 	};
 	double corr_period = 1.0, perf_period = 0.001;
 	const char *metric_name = NULL, *output_file = "i915_perf.record";
-	struct intel_perf_metric_set *metric_set;
 	struct intel_perf_record_timestamp_correlation initial_correlation;
-	struct timespec now;
-	uint64_t corr_period_ns, poll_time_ns;
+	uint64_t corr_period_ns;
 	uint32_t circular_size = 0;
 	int opt, dev_node_id = -1;
 	bool list_counters = false;
-	FILE *output = NULL;
 	struct recording_context ctx = {
 		.drm_fd = -1,
 		.perf_fd = -1,
+		.output_fd = -1,
 
 		.command_fifo = I915_PERF_RECORD_FIFO_PATH,
 		.command_fifo_fd = -1,
@@ -1027,32 +1454,26 @@ main(int argc, char *argv[])
 		goto fail;
 	}
 
-	ctx.perf = intel_perf_for_fd(ctx.drm_fd, ctx.gt);
+	ctx.perf = intel_perf_for_fd_lazy(ctx.drm_fd, ctx.gt);
 	if (!ctx.perf) {
 		fprintf(stderr, "No perf data found.\n");
 		goto fail;
 	}
 
-	intel_perf_load_perf_configs(ctx.perf, ctx.drm_fd);
-
 	if (metric_name) {
 		if (!strcmp(metric_name, "list")) {
 			print_metric_sets(ctx.perf);
 			return EXIT_SUCCESS;
 		}
 
-		igt_list_for_each_entry(metric_set, &ctx.perf->metric_sets, link) {
-			if (!strcasecmp(metric_set->symbol_name, metric_name)) {
-				ctx.metric_set = metric_set;
-				break;
-			}
-		}
+		ctx.metric_set = intel_perf_find_metric_set(ctx.perf, metric_name);
 	}
 
 	if (list_counters) {
-		if (!ctx.metric_set)
+		if (!ctx.metric_set) {
+			intel_perf_load_metric_sets(ctx.perf);
 			print_metric_sets_counters(ctx.perf);
-		else
+		} else
 			print_metric_set_counters(ctx.metric_set);
 		teardown_recording_context(&ctx);
 		return EXIT_SUCCESS;
@@ -1115,23 +1536,39 @@ main(int argc, char *argv[])
 			"Recoding in internal circular buffer.\n"
 			"Use i915-perf-control to snapshot into file.\n");
 	} else {
-		output = fopen(output_file, "w+");
-		if (!output) {
+		ctx.output_fd = open(output_file, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+		if (ctx.output_fd >= 0)
+			ctx.output_direct = true;
+		else if (errno == EINVAL)
+			ctx.output_fd = open(output_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (ctx.output_fd < 0) {
 			fprintf(stderr, "Unable to open output file '%s'\n",
 				output_file);
 			goto fail;
 		}
 
-		if (!write_version(output, &ctx) ||
-		    !write_header(output, &ctx) ||
-		    !write_topology(output, &ctx) ||
-		    !write_correlation_timestamps(output, ctx.drm_fd)) {
+		if (!capture_ring_init(&ctx.capture_ring, CAPTURE_RING_SIZE)) {
+			fprintf(stderr, "Unable to allocate capture buffer\n");
+			goto fail;
+		}
+
+		ctx.capture_stream = fopencookie(&ctx.capture_ring, "w",
+						 capture_ring_functions);
+		if (!ctx.capture_stream) {
+			fprintf(stderr, "Unable to create capture buffer\n");
+			goto fail;
+		}
+		setvbuf(ctx.capture_stream, NULL, _IONBF, 0);
+
+		if (!write_version(ctx.capture_stream, &ctx) ||
+		    !write_header(ctx.capture_stream, &ctx) ||
+		    !write_topology(ctx.capture_stream, &ctx) ||
+		    !write_correlation_timestamps(ctx.capture_stream, ctx.drm_fd)) {
 			fprintf(stderr, "Unable to write header in file '%s'\n",
 				output_file);
 			goto fail;
 		}
 
-		ctx.output_stream = output;
 		fprintf(stdout, "Writing recoding to %s\n", output_file);
 	}
 
@@ -1158,65 +1595,17 @@ main(int argc, char *argv[])
 	}
 
 	corr_period_ns = corr_period * 1000000000ul;
-	poll_time_ns = corr_period_ns;
-
-	while (!quit) {
-		struct pollfd pollfd[2] = {
-			{         ctx.perf_fd, POLLIN, 0 },
-			{ ctx.command_fifo_fd, POLLIN, 0 },
-		};
-		uint64_t elapsed_ns;
-		int ret;
-
-		igt_gettime(&now);
-		ret = poll(pollfd, ctx.command_fifo_fd != -1 ? 2 : 1, poll_time_ns / 1000000);
-		if (ret < 0 && errno != EINTR) {
-			fprintf(stderr, "Failed to poll i915-perf stream: %s\n",
-				strerror(errno));
-			break;
-		}
-
-		if (ret > 0) {
-			if (pollfd[0].revents & POLLIN) {
-				if (!write_i915_perf_data(ctx.output_stream, ctx.perf_fd)) {
-					fprintf(stderr, "Failed to write i915-perf data: %s\n",
-						strerror(errno));
-					break;
-				}
-			}
 
-			if (pollfd[1].revents & POLLIN) {
-				read_command_file(&ctx);
-			}
-		}
-
-		elapsed_ns = igt_nsec_elapsed(&now);
-		if (elapsed_ns > poll_time_ns) {
-			poll_time_ns = corr_period_ns;
-			if (!write_correlation_timestamps(ctx.output_stream, ctx.drm_fd)) {
-				fprintf(stderr,
-					"Failed to write i915 timestamp correlation data: %s\n",
-					strerror(errno));
-				break;
-			}
-		} else {
-			poll_time_ns -= elapsed_ns;
-		}
+	if (circular_size) {
+		record_circular(&ctx, corr_period_ns);
+	} else {
+		ctx.capture_period_ns = corr_period_ns;
+		if (!record_continuous(&ctx))
+			goto fail;
 	}
 
 	fprintf(stdout, "Exiting...\n");
 
-	if (!write_i915_perf_data(ctx.output_stream, ctx.perf_fd)) {
-		fprintf(stderr, "Failed to write i915-perf data: %s\n",
-			strerror(errno));
-	}
-
-	if (!write_correlation_timestamps(ctx.output_stream, ctx.drm_fd)) {
-		fprintf(stderr,
-			"Failed to write final i915 timestamp correlation data: %s\n",
-			strerror(errno));
-	}
-
 	teardown_recording_context(&ctx);
 
 	return EXIT_SUCCESS;
@@ -0,0 +1,96 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright © 2025 Intel Corporation
+ */
+
+/*
+ * Converts raw frame dumps, as written with IGT_FRAME_DUMP_FORMAT=raw or by
+ * intel_framebuffer_dump -r, to PNG files next to them.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "igt_frame_dump.h"
+
+static int convert(const char *path, const char *out)
+{
+	struct igt_frame_raw_header header;
+	cairo_surface_t *surface;
+	cairo_status_t status;
+	char png[4096];
+	const char *ext;
+	struct tm tm;
+	time_t secs;
+	char date[32];
+
+	surface = igt_frame_raw_read(path, &header);
+	if (!surface) {
+		fprintf(stderr, "%s: %s\n", path, strerror(errno));
+		return 1;
+	}
+
+	if (!out) {
+		ext = strrchr(path, '.');
+		snprintf(png, sizeof(png), "%.*s.png",
+			 (int)(ext ? ext - path : strlen(path)), path);
+		out = png;
+	}
+
+	status = cairo_surface_write_to_png(surface, out);
+	cairo_surface_destroy(surface);
+	if (status != CAIRO_STATUS_SUCCESS) {
+		fprintf(stderr, "%s: %s\n", out, cairo_status_to_string(status));
+		return 1;
+	}
+
+	secs = header.realtime_ns / 1000000000ull;
+	localtime_r(&secs, &tm);
+	strftime(date, sizeof(date), "%F %T", &tm);
+	printf("%s: %ux%u, captured at %s.%09llu (monotonic %llu.%09llu)\n",
+	       out, header.width, header.height, date,
+	       (unsigned long long)(header.realtime_ns % 1000000000ull),
+	       (unsigned long long)(header.timestamp_ns / 1000000000ull),
+	       (unsigned long long)(header.timestamp_ns % 1000000000ull));
+
+	return 0;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"Usage: %s [-o <png>] <raw frame>...\n"
+		"  -o <png>  Output file, only with a single input; by default\n"
+		"            each input's extension is replaced by .png\n",
+		name);
+}
+
+int main(int argc, char **argv)
+{
+	const char *out = NULL;
+	int c, ret = 0;
+
+	while ((c = getopt(argc, argv, "o:h")) != -1) {
+		switch (c) {
+		case 'o':
+			out = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return c == 'h' ? 0 : 1;
+		}
+	}
+
+	if (optind == argc || (out && argc - optind > 1)) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	for (; optind < argc; optind++)
+		ret |= convert(argv[optind], out);
+
+	return ret;
+}
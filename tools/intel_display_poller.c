@@ -25,6 +25,8 @@
 #include <assert.h>
 #include <fcntl.h>
 #include <getopt.h>
+#include <inttypes.h>
+#include <sched.h>
 #include <unistd.h>
 #include <signal.h>
 #include <stdbool.h>
@@ -32,12 +34,14 @@
 #include <stdio.h>
 #include <err.h>
 #include <string.h>
+#include <time.h>
 #include "intel_chipset.h"
 #include "intel_io.h"
 #include "intel_reg.h"
 #include "igt_debugfs.h"
 #include "drmtest.h"
 #include "igt_aux.h"
+#include "igt_stats.h"
 
 enum test {
 	TEST_INVALID,
@@ -1021,19 +1025,10 @@ static void poll_dsl_flipdone_pipestat(uint32_t devid, int pipe, int target_scan
 	write_reg(pipestat, pipestat_save);
 }
 
-static void poll_dsl_flipdone_deiir(uint32_t devid, int pipe, int target_scanline, int target_fuzz,
-				    uint32_t *min, uint32_t *max, const int count, bool async,
-				    int vrr_push_scanline)
+static uint32_t flipdone_deiir_regs(uint32_t devid, int pipe,
+				    uint32_t *iir, uint32_t *ier, uint32_t *imr)
 {
-	uint32_t dsl, dsl1 = 0, dsl2 = 0;
-	uint32_t iir, iir2, ier, imr;
-	uint32_t ier_save, imr_save;
-	bool field1 = false, field2 = false;
-	uint32_t saved, next, surf = 0, bit;
-	int i[2] = {};
-
-	dsl = PIPE_REG(pipe, PIPEA_DSL);
-	surf = dspsurf_reg(devid, pipe, async);
+	int bit;
 
 	if (intel_display_ver(devid) >= 9)
 		bit = 3;
@@ -1045,18 +1040,36 @@ static void poll_dsl_flipdone_deiir(uint32_t devid, int pipe, int target_scanlin
 		bit = 26 + pipe;
 	else
 		abort();
-	bit = 1 << bit;
 
 	if (intel_display_ver(devid) >= 8) {
-		iir = GEN8_DE_PIPE_IIR(pipe);
-		ier = GEN8_DE_PIPE_IER(pipe);
-		imr = GEN8_DE_PIPE_IMR(pipe);
+		*iir = GEN8_DE_PIPE_IIR(pipe);
+		*ier = GEN8_DE_PIPE_IER(pipe);
+		*imr = GEN8_DE_PIPE_IMR(pipe);
 	} else {
-		iir = DEIIR;
-		ier = DEIER;
-		imr = DEIMR;
+		*iir = DEIIR;
+		*ier = DEIER;
+		*imr = DEIMR;
 	}
 
+	return 1 << bit;
+}
+
+static void poll_dsl_flipdone_deiir(uint32_t devid, int pipe, int target_scanline, int target_fuzz,
+				    uint32_t *min, uint32_t *max, const int count, bool async,
+				    int vrr_push_scanline)
+{
+	uint32_t dsl, dsl1 = 0, dsl2 = 0;
+	uint32_t iir, iir2, ier, imr;
+	uint32_t ier_save, imr_save;
+	bool field1 = false, field2 = false;
+	uint32_t saved, next, surf = 0, bit;
+	int i[2] = {};
+
+	dsl = PIPE_REG(pipe, PIPEA_DSL);
+	surf = dspsurf_reg(devid, pipe, async);
+
+	bit = flipdone_deiir_regs(devid, pipe, &iir, &ier, &imr);
+
 	saved = read_reg(surf);
 	next = saved;
 
@@ -1104,6 +1117,276 @@ static void poll_dsl_flipdone_deiir(uint32_t devid, int pipe, int target_scanlin
 	write_reg(ier, ier_save);
 }
 
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/*
+ * Several pipes are polled round robin, so the exact scanline
+ * may be missed. Also catch the target when the scanline skipped
+ * over it, including across the wraparound.
+ */
+static bool scanline_crossed(uint32_t prev, uint32_t dsl, uint32_t target)
+{
+	if (dsl < prev)
+		return prev < target || dsl >= target;
+
+	return prev < target && dsl >= target;
+}
+
+static int vblank_start(uint32_t devid, int pipe)
+{
+	int trans = pipe_to_transcoder(devid, pipe);
+	uint32_t reg;
+
+	if (trans == 0xf)
+		reg = VBLANK_A + 0xf000;
+	else
+		reg = PIPE_REG(trans, VBLANK_A);
+
+	return (read_reg(reg) & 0x1fff) + 1;
+}
+
+struct flipdone_pipe {
+	int pipe;
+	uint32_t dsl, surf, push;
+	uint32_t iir, ier, imr, bit;
+	uint32_t ier_save, imr_save;
+	uint32_t saved, next;
+	uint32_t vblank_start;
+	uint32_t last_dsl;
+	enum {
+		FLIPDONE_WAIT_LINE,
+		FLIPDONE_WAIT_DONE,
+		FLIPDONE_FINISHED,
+	} state;
+	bool pushed;
+	uint64_t flip_ns, vblank_ns;
+	igt_stats_t flip_to_done;
+	igt_stats_t vblank_to_done;
+};
+
+/*
+ * Flips all the pipes from a single thread, each pipe advancing its
+ * own state machine on every pass, and records the time from the
+ * surface write to flip done and from the start of vblank to flip
+ * done. The latter is only recorded when the scanline was seen
+ * entering vblank before the flip completed, ie. not for async
+ * flips latched mid frame.
+ */
+static void poll_multi_flipdone_deiir(uint32_t devid, struct flipdone_pipe *pipes,
+				      int num_pipes, int target_scanline,
+				      const int count, bool async,
+				      int vrr_push_scanline)
+{
+	int remaining = num_pipes;
+	bool field;
+	int i;
+
+	for (i = 0; i < num_pipes; i++) {
+		struct flipdone_pipe *p = &pipes[i];
+
+		p->dsl = PIPE_REG(p->pipe, PIPEA_DSL);
+		p->surf = dspsurf_reg(devid, p->pipe, async);
+		p->bit = flipdone_deiir_regs(devid, p->pipe,
+					     &p->iir, &p->ier, &p->imr);
+		if (vrr_push_scanline >= 0)
+			p->push = trans_reg(devid, p->pipe, TRANS_PUSH_A);
+		p->vblank_start = vblank_start(devid, p->pipe);
+
+		p->saved = read_reg(p->surf);
+		p->next = p->saved;
+
+		/* DEIER/DEIMR are shared before gen8, restored in reverse order */
+		p->imr_save = read_reg(p->imr);
+		p->ier_save = read_reg(p->ier);
+		write_reg(p->ier, p->ier_save & ~p->bit);
+		write_reg(p->imr, p->imr_save & ~p->bit);
+
+		enable_async_flip(devid, p->pipe, async);
+
+		igt_stats_init_with_size(&p->flip_to_done, count);
+		igt_stats_init_with_size(&p->vblank_to_done, count);
+
+		p->state = FLIPDONE_WAIT_LINE;
+		p->last_dsl = read_scanline(p->dsl, &field);
+	}
+
+	while (!quit && remaining) {
+		for (i = 0; i < num_pipes; i++) {
+			struct flipdone_pipe *p = &pipes[i];
+			uint32_t dsl = read_scanline(p->dsl, &field);
+			uint64_t now;
+
+			switch (p->state) {
+			case FLIPDONE_WAIT_LINE:
+				if (!scanline_crossed(p->last_dsl, dsl, target_scanline))
+					break;
+
+				write_reg(p->iir, p->bit);
+				if (p->next == p->saved)
+					p->next = p->saved+256*1024;
+				else
+					p->next = p->saved;
+				write_reg(p->surf, p->next);
+
+				p->flip_ns = now_ns();
+				p->vblank_ns = 0;
+				p->pushed = vrr_push_scanline < 0 ||
+					read_reg(p->push) & 0x40000000;
+				p->state = FLIPDONE_WAIT_DONE;
+				break;
+			case FLIPDONE_WAIT_DONE:
+				if (!p->pushed &&
+				    scanline_crossed(p->last_dsl, dsl, vrr_push_scanline)) {
+					write_reg(p->push, 0xc0000000);
+					p->pushed = true;
+				}
+
+				if (!p->vblank_ns &&
+				    scanline_crossed(p->last_dsl, dsl, p->vblank_start))
+					p->vblank_ns = now_ns();
+
+				if (!(read_reg(p->iir) & p->bit))
+					break;
+
+				now = now_ns();
+				write_reg(p->iir, p->bit);
+
+				igt_stats_push(&p->flip_to_done, now - p->flip_ns);
+				if (p->vblank_ns)
+					igt_stats_push(&p->vblank_to_done, now - p->vblank_ns);
+
+				if (p->flip_to_done.n_values < count) {
+					p->state = FLIPDONE_WAIT_LINE;
+				} else {
+					p->state = FLIPDONE_FINISHED;
+					remaining--;
+				}
+				break;
+			case FLIPDONE_FINISHED:
+				break;
+			}
+
+			p->last_dsl = dsl;
+		}
+	}
+
+	for (i = num_pipes - 1; i >= 0; i--) {
+		struct flipdone_pipe *p = &pipes[i];
+
+		enable_async_flip(devid, p->pipe, false);
+		write_reg(p->surf, p->saved);
+		write_reg(p->imr, p->imr_save);
+		write_reg(p->ier, p->ier_save);
+	}
+}
+
+static void print_histogram(const char *name, igt_stats_t *stats)
+{
+	unsigned int buckets[32] = {};
+	int i, last = 0;
+
+	if (!stats->n_values) {
+		printf("  %s: no samples\n", name);
+		return;
+	}
+
+	printf("  %s (us): n=%u min=%.1f p50=%.1f p90=%.1f p99=%.1f p99.9=%.1f max=%.1f mean=%.1f\n",
+	       name, stats->n_values,
+	       igt_stats_get_min(stats) / 1000.0,
+	       igt_stats_get_median(stats) / 1000.0,
+	       igt_stats_get_percentile(stats, 90) / 1000.0,
+	       igt_stats_get_percentile(stats, 99) / 1000.0,
+	       igt_stats_get_percentile(stats, 99.9) / 1000.0,
+	       igt_stats_get_max(stats) / 1000.0,
+	       igt_stats_get_mean(stats) / 1000.0);
+
+	/* power of two buckets in us */
+	for (i = 0; i < stats->n_values; i++) {
+		uint64_t us = stats->values_u64[i] / 1000;
+		int b = 0;
+
+		while (us && b < ARRAY_SIZE(buckets) - 1) {
+			us >>= 1;
+			b++;
+		}
+
+		buckets[b]++;
+		last = max(last, b);
+	}
+
+	for (i = 0; i <= last; i++)
+		printf("    %8u - %8u us: %u\n",
+		       i ? 1u << (i - 1) : 0, 1u << i, buckets[i]);
+}
+
+static void print_json_stats(const char *name, igt_stats_t *stats, bool last)
+{
+	int i;
+
+	printf("\t\t\t\"%s\": {\n", name);
+	printf("\t\t\t\t\"count\": %u,\n", stats->n_values);
+	if (stats->n_values) {
+		printf("\t\t\t\t\"min\": %"PRIu64",\n", igt_stats_get_min(stats));
+		printf("\t\t\t\t\"max\": %"PRIu64",\n", igt_stats_get_max(stats));
+		printf("\t\t\t\t\"mean\": %.1f,\n", igt_stats_get_mean(stats));
+		printf("\t\t\t\t\"p50\": %.1f,\n", igt_stats_get_median(stats));
+		printf("\t\t\t\t\"p90\": %.1f,\n", igt_stats_get_percentile(stats, 90));
+		printf("\t\t\t\t\"p99\": %.1f,\n", igt_stats_get_percentile(stats, 99));
+		printf("\t\t\t\t\"p99.9\": %.1f,\n", igt_stats_get_percentile(stats, 99.9));
+	}
+	printf("\t\t\t\t\"samples\": [");
+	for (i = 0; i < stats->n_values; i++)
+		printf("%s%"PRIu64, i ? ", " : "", stats->values_u64[i]);
+	printf("]\n");
+	printf("\t\t\t}%s\n", last ? "" : ",");
+}
+
+static void print_flipdone_pipes(struct flipdone_pipe *pipes, int num_pipes,
+				 int target_scanline, bool async,
+				 int vrr_push_scanline, bool json)
+{
+	int i;
+
+	if (!json) {
+		for (i = 0; i < num_pipes; i++) {
+			struct flipdone_pipe *p = &pipes[i];
+
+			printf("pipe %c: vblank start %u\n",
+			       pipe_name(p->pipe), p->vblank_start);
+			print_histogram("flip -> flip done", &p->flip_to_done);
+			print_histogram("vblank -> flip done", &p->vblank_to_done);
+		}
+		return;
+	}
+
+	printf("{\n");
+	printf("\t\"test\": \"flipdone\",\n");
+	printf("\t\"line\": %d,\n", target_scanline);
+	printf("\t\"async\": %s,\n", async ? "true" : "false");
+	printf("\t\"vrr_push\": %d,\n", vrr_push_scanline);
+	printf("\t\"units\": \"ns\",\n");
+	printf("\t\"pipes\": [\n");
+	for (i = 0; i < num_pipes; i++) {
+		struct flipdone_pipe *p = &pipes[i];
+
+		printf("\t\t{\n");
+		printf("\t\t\t\"pipe\": \"%c\",\n", pipe_name(p->pipe));
+		printf("\t\t\t\"vblank_start\": %u,\n", p->vblank_start);
+		print_json_stats("flip_to_done", &p->flip_to_done, false);
+		print_json_stats("vblank_to_done", &p->vblank_to_done, true);
+		printf("\t\t}%s\n", i == num_pipes - 1 ? "" : ",");
+	}
+	printf("\t]\n");
+	printf("}\n");
+}
+
 static void poll_dsl_surflive(uint32_t devid, int pipe,
 			      uint32_t *min, uint32_t *max, const int count, bool async,
 			      int vrr_push_scanline)
@@ -1377,7 +1660,10 @@ static void __attribute__((noreturn)) usage(const char *name)
 		" -a,--async\n"
 		" -v,--vrr-push <push scanline>\n"
 		" -o,--scanline-offset <offset>\n"
-		" -O,--auto-scanline-offset\n",
+		" -O,--auto-scanline-offset\n"
+		" -P,--pipes <pipes> (flipdone, eg. ABC)\n"
+		" -n,--count <flips per pipe> (flipdone, with -P/-j)\n"
+		" -j,--json (flipdone)\n",
 		name);
 	exit(1);
 }
@@ -1398,6 +1684,10 @@ int main(int argc, char *argv[])
 	enum test test = TEST_INVALID;
 	const int count = ARRAY_SIZE(min)/2;
 	bool auto_scanline_offset = false;
+	struct flipdone_pipe pipes[4] = {};
+	unsigned int pipe_mask = 0;
+	int num_pipes = 0, flips = 1000;
+	bool histogram = false, json = false;
 
 	for (;;) {
 		static const struct option long_options[] = {
@@ -1412,10 +1702,13 @@ int main(int argc, char *argv[])
 			{ .name = "vrr-push", .has_arg = required_argument, .val = 'v', },
 			{ .name = "scanline-offset", .has_arg = required_argument, .val = 'o', },
 			{ .name = "auto-scanline-offset", .has_arg = no_argument, .val = 'O', },
+			{ .name = "pipes", .has_arg = required_argument, .val = 'P', },
+			{ .name = "count", .has_arg = required_argument, .val = 'n', },
+			{ .name = "json", .has_arg = no_argument, .val = 'j', },
 			{ },
 		};
 
-		int opt = getopt_long(argc, argv, "t:p:d:b:l:f:xav:o:O", long_options, NULL);
+		int opt = getopt_long(argc, argv, "t:p:d:b:l:f:xav:o:OP:n:j", long_options, NULL);
 		if (opt == -1)
 			break;
 
@@ -1505,9 +1798,47 @@ int main(int argc, char *argv[])
 		case 'O':
 			auto_scanline_offset = true;
 			break;
+		case 'P':
+			for (i = 0; optarg[i]; i++) {
+				int p = optarg[i];
+
+				if (p >= 'a')
+					p -= 'a';
+				else if (p >= 'A')
+					p -= 'A';
+				else if (p >= '0')
+					p -= '0';
+				else
+					usage(argv[0]);
+				if (p < 0 || p > 3)
+					usage(argv[0]);
+				pipe_mask |= 1 << p;
+			}
+			if (!pipe_mask)
+				usage(argv[0]);
+			/* validate the highest pipe below */
+			pipe = igt_fls(pipe_mask) - 1;
+			histogram = true;
+			break;
+		case 'n':
+			flips = atoi(optarg);
+			if (flips <= 0)
+				usage(argv[0]);
+			histogram = true;
+			break;
+		case 'j':
+			json = true;
+			histogram = true;
+			break;
 		}
 	}
 
+	if (histogram && !pipe_mask)
+		pipe_mask = 1 << pipe;
+	/* the offset depends on the output, there's only one */
+	if (auto_scanline_offset && pipe_mask & (pipe_mask - 1))
+		usage(argv[0]);
+
 	devid = intel_get_pci_device()->device_id;
 
 	/*
@@ -1677,17 +2008,55 @@ int main(int argc, char *argv[])
 		break;
 	}
 
+	if (histogram && test != TEST_FLIPDONE_DEIIR)
+		usage(argv[0]);
+
 	intel_register_access_init(&mmio_data, intel_get_pci_device(), 0);
 
 	if (auto_scanline_offset)
 		scanline_offset = default_scanline_offset(devid, pipe);
 
-	printf("%s?\n", test_name(test, pipe, dsb_id, bit, test_pixelcount));
-
 	signal(SIGHUP, sighandler);
 	signal(SIGINT, sighandler);
 	signal(SIGTERM, sighandler);
 
+	if (histogram) {
+		struct sched_param param = { .sched_priority = 99 };
+
+		for (i = 0; i < ARRAY_SIZE(pipes); i++)
+			if (pipe_mask & (1 << i))
+				pipes[num_pipes++].pipe = i;
+
+		if (!json) {
+			printf("dsl / pipes ");
+			for (i = 0; i < num_pipes; i++)
+				printf("%c", pipe_name(pipes[i].pipe));
+			printf(" / Flip done (pch) / %d flips?\n", flips);
+		}
+
+		/* all pipes are polled from here, don't get preempted */
+		if (sched_setscheduler(0, SCHED_FIFO, &param))
+			fprintf(stderr, "Failed to set SCHED_FIFO (%m), expect outliers\n");
+
+		poll_multi_flipdone_deiir(devid, pipes, num_pipes, target_scanline,
+					  flips, test_async_flip, vrr_push_scanline);
+
+		intel_register_access_fini(&mmio_data);
+
+		/* what was collected before an interrupt is still valid */
+		print_flipdone_pipes(pipes, num_pipes, target_scanline,
+				     test_async_flip, vrr_push_scanline, json);
+
+		for (i = 0; i < num_pipes; i++) {
+			igt_stats_fini(&pipes[i].flip_to_done);
+			igt_stats_fini(&pipes[i].vblank_to_done);
+		}
+
+		return 0;
+	}
+
+	printf("%s?\n", test_name(test, pipe, dsb_id, bit, test_pixelcount));
+
 	switch (test) {
 	case TEST_PIPESTAT:
 		if (test_pixelcount)
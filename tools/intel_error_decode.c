@@ -46,6 +46,9 @@
 #include <unistd.h>
 #include <inttypes.h>
 #include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <err.h>
 #include <assert.h>
@@ -59,10 +62,13 @@
 #include "drmtest.h"
 #include "i915/intel_decode.h"
 
+/* Output of the text sections, see begin_text() */
+static FILE *out;
+
 static uint32_t
 print_head(unsigned int reg)
 {
-	printf("    head = 0x%08x, wraps = %d\n", reg & (0x7ffff<<2), reg >> 21);
+	fprintf(out, "    head = 0x%08x, wraps = %d\n", reg & (0x7ffff<<2), reg >> 21);
 	return reg & (0x7ffff<<2);
 }
 
@@ -73,10 +79,10 @@ print_ctl(unsigned int reg)
 
 #define BIT_STR(reg, x, on, off) ((1 << (x)) & reg) ? on : off
 
-	printf("    len=%d%s%s%s\n", ring_length,
-	       BIT_STR(reg, 0, ", enabled", ", disabled"),
-	       BIT_STR(reg, 10, ", semaphore wait ", ""),
-	       BIT_STR(reg, 11, ", rb wait ", "")
+	fprintf(out, "    len=%d%s%s%s\n", ring_length,
+		     BIT_STR(reg, 0, ", enabled", ", disabled"),
+		     BIT_STR(reg, 10, ", semaphore wait ", ""),
+		     BIT_STR(reg, 11, ", rb wait ", "")
 		);
 #undef BIT_STR
 	return ring_length;
@@ -86,9 +92,9 @@ static void
 print_acthd(unsigned int reg, unsigned int ring_length)
 {
 	if ((reg & (0x7ffff << 2)) < ring_length)
-		printf("    at ring: 0x%08x\n", reg & (0x7ffff << 2));
+		fprintf(out, "    at ring: 0x%08x\n", reg & (0x7ffff << 2));
 	else
-		printf("    at batch: 0x%08x\n", reg);
+		fprintf(out, "    at batch: 0x%08x\n", reg);
 }
 
 static void
@@ -115,7 +121,7 @@ print_instdone(uint32_t devid, unsigned int instdone, unsigned int instdone1)
 		}
 
 		if (busy)
-			printf("    busy: %s\n", instdone_bits[i].name);
+			fprintf(out, "    busy: %s\n", instdone_bits[i].name);
 	}
 }
 
@@ -141,7 +147,7 @@ print_i830_pgtbl_err(unsigned int reg)
 	}
 
 	if (str)
-		printf("    source = %s\n", str);
+		fprintf(out, "    source = %s\n", str);
 
 	switch(reg & 0x7) {
 	case 0x0: str  = "Invalid GTT"; break;
@@ -153,85 +159,85 @@ print_i830_pgtbl_err(unsigned int reg)
 	case 0x6: str = "Invalid Tiling"; break;
 	case 0x7: str = "Host to CAM"; break;
 	}
-	printf("    error = %s\n", str);
+	fprintf(out, "    error = %s\n", str);
 }
 
 static void
 print_i915_pgtbl_err(unsigned int reg)
 {
 	if (reg & (1 << 29))
-		printf("    Cursor A: Invalid GTT PTE\n");
+		fprintf(out, "    Cursor A: Invalid GTT PTE\n");
 	if (reg & (1 << 28))
-		printf("    Cursor B: Invalid GTT PTE\n");
+		fprintf(out, "    Cursor B: Invalid GTT PTE\n");
 	if (reg & (1 << 27))
-		printf("    MT: Invalid tiling\n");
+		fprintf(out, "    MT: Invalid tiling\n");
 	if (reg & (1 << 26))
-		printf("    MT: Invalid GTT PTE\n");
+		fprintf(out, "    MT: Invalid GTT PTE\n");
 	if (reg & (1 << 25))
-		printf("    LC: Invalid tiling\n");
+		fprintf(out, "    LC: Invalid tiling\n");
 	if (reg & (1 << 24))
-		printf("    LC: Invalid GTT PTE\n");
+		fprintf(out, "    LC: Invalid GTT PTE\n");
 	if (reg & (1 << 23))
-		printf("    BIN VertexData: Invalid GTT PTE\n");
+		fprintf(out, "    BIN VertexData: Invalid GTT PTE\n");
 	if (reg & (1 << 22))
-		printf("    BIN Instruction: Invalid GTT PTE\n");
+		fprintf(out, "    BIN Instruction: Invalid GTT PTE\n");
 	if (reg & (1 << 21))
-		printf("    CS VertexData: Invalid GTT PTE\n");
+		fprintf(out, "    CS VertexData: Invalid GTT PTE\n");
 	if (reg & (1 << 20))
-		printf("    CS Instruction: Invalid GTT PTE\n");
+		fprintf(out, "    CS Instruction: Invalid GTT PTE\n");
 	if (reg & (1 << 19))
-		printf("    CS: Invalid GTT\n");
+		fprintf(out, "    CS: Invalid GTT\n");
 	if (reg & (1 << 18))
-		printf("    Overlay: Invalid tiling\n");
+		fprintf(out, "    Overlay: Invalid tiling\n");
 	if (reg & (1 << 16))
-		printf("    Overlay: Invalid GTT PTE\n");
+		fprintf(out, "    Overlay: Invalid GTT PTE\n");
 	if (reg & (1 << 14))
-		printf("    Display C: Invalid tiling\n");
+		fprintf(out, "    Display C: Invalid tiling\n");
 	if (reg & (1 << 12))
-		printf("    Display C: Invalid GTT PTE\n");
+		fprintf(out, "    Display C: Invalid GTT PTE\n");
 	if (reg & (1 << 10))
-		printf("    Display B: Invalid tiling\n");
+		fprintf(out, "    Display B: Invalid tiling\n");
 	if (reg & (1 << 8))
-		printf("    Display B: Invalid GTT PTE\n");
+		fprintf(out, "    Display B: Invalid GTT PTE\n");
 	if (reg & (1 << 6))
-		printf("    Display A: Invalid tiling\n");
+		fprintf(out, "    Display A: Invalid tiling\n");
 	if (reg & (1 << 4))
-		printf("    Display A: Invalid GTT PTE\n");
+		fprintf(out, "    Display A: Invalid GTT PTE\n");
 	if (reg & (1 << 1))
-		printf("    Host Invalid PTE data\n");
+		fprintf(out, "    Host Invalid PTE data\n");
 	if (reg & (1 << 0))
-		printf("    Host Invalid GTT PTE\n");
+		fprintf(out, "    Host Invalid GTT PTE\n");
 }
 
 static void
 print_i965_pgtbl_err(unsigned int reg)
 {
 	if (reg & (1 << 26))
-		printf("    Invalid Sampler Cache GTT entry\n");
+		fprintf(out, "    Invalid Sampler Cache GTT entry\n");
 	if (reg & (1 << 24))
-		printf("    Invalid Render Cache GTT entry\n");
+		fprintf(out, "    Invalid Render Cache GTT entry\n");
 	if (reg & (1 << 23))
-		printf("    Invalid Instruction/State Cache GTT entry\n");
+		fprintf(out, "    Invalid Instruction/State Cache GTT entry\n");
 	if (reg & (1 << 22))
-		printf("    There is no ROC, this cannot occur!\n");
+		fprintf(out, "    There is no ROC, this cannot occur!\n");
 	if (reg & (1 << 21))
-		printf("    Invalid GTT entry during Vertex Fetch\n");
+		fprintf(out, "    Invalid GTT entry during Vertex Fetch\n");
 	if (reg & (1 << 20))
-		printf("    Invalid GTT entry during Command Fetch\n");
+		fprintf(out, "    Invalid GTT entry during Command Fetch\n");
 	if (reg & (1 << 19))
-		printf("    Invalid GTT entry during CS\n");
+		fprintf(out, "    Invalid GTT entry during CS\n");
 	if (reg & (1 << 18))
-		printf("    Invalid GTT entry during Cursor Fetch\n");
+		fprintf(out, "    Invalid GTT entry during Cursor Fetch\n");
 	if (reg & (1 << 17))
-		printf("    Invalid GTT entry during Overlay Fetch\n");
+		fprintf(out, "    Invalid GTT entry during Overlay Fetch\n");
 	if (reg & (1 << 8))
-		printf("    Invalid GTT entry during Display B Fetch\n");
+		fprintf(out, "    Invalid GTT entry during Display B Fetch\n");
 	if (reg & (1 << 4))
-		printf("    Invalid GTT entry during Display A Fetch\n");
+		fprintf(out, "    Invalid GTT entry during Display A Fetch\n");
 	if (reg & (1 << 1))
-		printf("    Valid PTE references illegal memory\n");
+		fprintf(out, "    Valid PTE references illegal memory\n");
 	if (reg & (1 << 0))
-		printf("    Invalid GTT entry during fetch for host\n");
+		fprintf(out, "    Invalid GTT entry during fetch for host\n");
 }
 
 static void
@@ -249,45 +255,45 @@ print_pgtbl_err(unsigned int reg, unsigned int devid)
 static void print_ivb_error(unsigned int reg, unsigned int devid)
 {
 	if (reg & (1 << 0))
-		printf("    TLB page fault error (GTT entry not valid)\n");
+		fprintf(out, "    TLB page fault error (GTT entry not valid)\n");
 	if (reg & (1 << 1))
-		printf("    Invalid physical address in RSTRM interface (PAVP)\n");
+		fprintf(out, "    Invalid physical address in RSTRM interface (PAVP)\n");
 	if (reg & (1 << 2))
-		printf("    Invalid page directory entry error\n");
+		fprintf(out, "    Invalid page directory entry error\n");
 	if (reg & (1 << 3))
-		printf("    Invalid physical address in ROSTRM interface (PAVP)\n");
+		fprintf(out, "    Invalid physical address in ROSTRM interface (PAVP)\n");
 	if (reg & (1 << 4))
-		printf("    TLB page VTD translation generated an error\n");
+		fprintf(out, "    TLB page VTD translation generated an error\n");
 	if (reg & (1 << 5))
-		printf("    Invalid physical address in WRITE interface (PAVP)\n");
+		fprintf(out, "    Invalid physical address in WRITE interface (PAVP)\n");
 	if (reg & (1 << 6))
-		printf("    Page directory VTD translation generated error\n");
+		fprintf(out, "    Page directory VTD translation generated error\n");
 	if (reg & (1 << 8))
-		printf("    Cacheline containing a PD was marked as invalid\n");
+		fprintf(out, "    Cacheline containing a PD was marked as invalid\n");
 	if (IS_HASWELL(devid) && (reg >> 10) & 0x1f)
-		printf("    %d pending page faults\n", (reg >> 10) & 0x1f);
+		fprintf(out, "    %d pending page faults\n", (reg >> 10) & 0x1f);
 }
 
 static void print_snb_error(unsigned int reg)
 {
 	if (reg & (1 << 0))
-		printf("    TLB page fault error (GTT entry not valid)\n");
+		fprintf(out, "    TLB page fault error (GTT entry not valid)\n");
 	if (reg & (1 << 1))
-		printf("    Context page GTT translation generated a fault (GTT entry not valid)\n");
+		fprintf(out, "    Context page GTT translation generated a fault (GTT entry not valid)\n");
 	if (reg & (1 << 2))
-		printf("    Invalid page directory entry error\n");
+		fprintf(out, "    Invalid page directory entry error\n");
 	if (reg & (1 << 3))
-		printf("    HWS page GTT translation generated a page fault (GTT entry not valid)\n");
+		fprintf(out, "    HWS page GTT translation generated a page fault (GTT entry not valid)\n");
 	if (reg & (1 << 4))
-		printf("    TLB page VTD translation generated an error\n");
+		fprintf(out, "    TLB page VTD translation generated an error\n");
 	if (reg & (1 << 5))
-		printf("    Context page VTD translation generated an error\n");
+		fprintf(out, "    Context page VTD translation generated an error\n");
 	if (reg & (1 << 6))
-		printf("    Page directory VTD translation generated error\n");
+		fprintf(out, "    Page directory VTD translation generated error\n");
 	if (reg & (1 << 7))
-		printf("    HWS page VTD translation generated an error\n");
+		fprintf(out, "    HWS page VTD translation generated an error\n");
 	if (reg & (1 << 8))
-		printf("    Cacheline containing a PD was marked as invalid\n");
+		fprintf(out, "    Cacheline containing a PD was marked as invalid\n");
 }
 
 static void print_bdw_error(unsigned int reg, unsigned int devid)
@@ -295,17 +301,17 @@ static void print_bdw_error(unsigned int reg, unsigned int devid)
 	print_ivb_error(reg, devid);
 
 	if (reg & (1 << 10))
-		printf("    Non WB memory type for Advanced Context\n");
+		fprintf(out, "    Non WB memory type for Advanced Context\n");
 	if (reg & (1 << 11))
-		printf("    PASID not enabled\n");
+		fprintf(out, "    PASID not enabled\n");
 	if (reg & (1 << 12))
-		printf("    PASID boundary violation\n");
+		fprintf(out, "    PASID boundary violation\n");
 	if (reg & (1 << 13))
-		printf("    PASID not valid\n");
+		fprintf(out, "    PASID not valid\n");
 	if (reg & (1 << 14))
-		printf("    PASID was zero for untranslated request\n");
+		fprintf(out, "    PASID was zero for untranslated request\n");
 	if (reg & (1 << 15))
-		printf("    Context was not marked as present when doing DMA\n");
+		fprintf(out, "    Context was not marked as present when doing DMA\n");
 }
 
 static void
@@ -321,7 +327,7 @@ print_error(unsigned int reg, unsigned int devid)
 static void
 print_snb_fence(unsigned int devid, uint64_t fence)
 {
-	printf("    %svalid, %c-tiled, pitch: %i, start: 0x%08x, size: %u\n",
+	fprintf(out, "    %svalid, %c-tiled, pitch: %i, start: 0x%08x, size: %u\n",
 			fence & 1 ? "" : "in",
 			fence & (1<<1) ? 'y' : 'x',
 			(int)(((fence>>32)&0xfff)+1)*128,
@@ -332,7 +338,7 @@ print_snb_fence(unsigned int devid, uint64_t fence)
 static void
 print_i965_fence(unsigned int devid, uint64_t fence)
 {
-	printf("    %svalid, %c-tiled, pitch: %i, start: 0x%08x, size: %u\n",
+	fprintf(out, "    %svalid, %c-tiled, pitch: %i, start: 0x%08x, size: %u\n",
 			fence & 1 ? "" : "in",
 			fence & (1<<1) ? 'y' : 'x',
 			(int)(((fence>>2)&0x1ff)+1)*128,
@@ -349,7 +355,7 @@ print_i915_fence(unsigned int devid, uint64_t fence)
 	else
 		tile_width = 512;
 
-	printf("    %svalid, %c-tiled, pitch: %i, start: 0x%08x, size: %i\n",
+	fprintf(out, "    %svalid, %c-tiled, pitch: %i, start: 0x%08x, size: %i\n",
 			fence & 1 ? "" : "in",
 			fence & (1<<12) ? 'y' : 'x',
 			(1<<((fence>>4)&0xf))*tile_width,
@@ -360,7 +366,7 @@ print_i915_fence(unsigned int devid, uint64_t fence)
 static void
 print_i830_fence(unsigned int devid, uint64_t fence)
 {
-	printf("    %svalid, %c-tiled, pitch: %i, start: 0x%08x, size: %i\n",
+	fprintf(out, "    %svalid, %c-tiled, pitch: %i, start: 0x%08x, size: %i\n",
 			fence & 1 ? "" : "in",
 			fence & (1<<12) ? 'y' : 'x',
 			(1<<((fence>>4)&0xf))*128,
@@ -402,22 +408,22 @@ print_fault_reg(unsigned devid, uint32_t reg)
 		return;
 
 	if (reg & (1 << 0))
-		printf("    Valid\n");
+		fprintf(out, "    Valid\n");
 	else
 		return;
 
 	if (intel_gen(devid) < 8)
-		printf("    %s Fault (%s)\n", gen7_types[reg >> 1 & 0x3],
-		       reg & (1 << 11) ? "GGTT" : "PPGTT");
+		fprintf(out, "    %s Fault (%s)\n", gen7_types[reg >> 1 & 0x3],
+			     reg & (1 << 11) ? "GGTT" : "PPGTT");
 	else
-		printf("    Invalid %s Fault\n", gen8_types[reg >> 1 & 0x3]);
+		fprintf(out, "    Invalid %s Fault\n", gen8_types[reg >> 1 & 0x3]);
 
 	if (intel_gen(devid) < 8)
-		printf("    Address 0x%08x\n", reg & ~((1 << 12)-1));
+		fprintf(out, "    Address 0x%08x\n", reg & ~((1 << 12)-1));
 	else
-		printf("    Engine %s\n", engine[reg >> 12 & 0x7]);
+		fprintf(out, "    Engine %s\n", engine[reg >> 12 & 0x7]);
 
-	printf("    Source ID %d\n", reg >> 3 & 0xff);
+	fprintf(out, "    Source ID %d\n", reg >> 3 & 0xff);
 }
 
 static void
@@ -429,11 +435,64 @@ print_fault_data(unsigned devid, uint32_t data1, uint32_t data0)
 		return;
 
 	address = ((uint64_t)(data0) << 12) | ((uint64_t)data1 & 0xf) << 44;
-	printf("    Address 0x%016" PRIx64 " %s\n", address,
-	       data1 & (1 << 4) ? "GGTT" : "PPGTT");
+	fprintf(out, "    Address 0x%016" PRIx64 " %s\n", address,
+		     data1 & (1 << 4) ? "GGTT" : "PPGTT");
 }
 
 #define MAX_RINGS 10 /* I really hope this never... */
+#define MAX_ENGINES 64
+
+/*
+ * The error state is split into sections, printed in order: the text
+ * of the register dumps, formatted while parsing, and the buffers,
+ * decompressed and decoded by the workers in parallel.
+ */
+struct section {
+	char *text;
+	size_t len;
+	bool is_buffer;
+	bool done;
+
+	/* ascii85 encoded contents, within the input */
+	const char *in;
+	size_t in_len;
+	bool inflate;
+
+	/* or the dwords of a hexdump */
+	uint32_t *data;
+	int count;
+
+	/* decode state when the buffer was found, devid 0 if unknown */
+	uint32_t devid;
+	uint32_t head, tail;
+	const char *buffer_name;
+	char *ring_name;
+	uint64_t gtt_offset;
+	uint32_t head_offset;
+	int do_decode;
+};
+
+static struct {
+	pthread_mutex_t mutex;
+	pthread_cond_t queued;
+	pthread_cond_t done;
+	struct section **sections;
+	unsigned int count, size;
+	unsigned int next;	/* next section for the workers */
+	unsigned int written;	/* next section to write out */
+	bool finished;
+} queue = {
+	.mutex = PTHREAD_MUTEX_INITIALIZER,
+	.queued = PTHREAD_COND_INITIALIZER,
+	.done = PTHREAD_COND_INITIALIZER,
+};
+
+static struct section *text;
+
+static const char *engine_filter;
+static bool hung_only;
+static char *hung_engines[MAX_ENGINES];
+static int num_hung_engines;
 
 static bool maybe_ascii(const void *data, int check)
 {
@@ -445,38 +504,36 @@ static bool maybe_ascii(const void *data, int check)
 	return true;
 }
 
-static void decode(struct intel_decode *ctx,
+static void decode(FILE *file, struct intel_decode *ctx,
 		   const char *buffer_name,
 		   const char *ring_name,
 		   uint64_t gtt_offset,
 		   uint32_t head_offset,
-		   uint32_t *data, int *count,
-		   int decode)
+		   uint32_t *data, int count)
 {
-	if (!*count)
+	if (!count)
 		return;
 
-	printf("%s (%s) at 0x%08x_%08x", buffer_name, ring_name,
-	       (unsigned)(gtt_offset >> 32),
-	       (unsigned)(gtt_offset & 0xffffffff));
+	fprintf(file, "%s (%s) at 0x%08x_%08x", buffer_name, ring_name,
+		(unsigned)(gtt_offset >> 32),
+		(unsigned)(gtt_offset & 0xffffffff));
 	if (head_offset != -1)
-		printf("; HEAD points to: 0x%08x_%08x",
-		       (unsigned)((head_offset + gtt_offset) >> 32),
-		       (unsigned)((head_offset + gtt_offset) & 0xffffffff));
-	printf("\n");
+		fprintf(file, "; HEAD points to: 0x%08x_%08x",
+			(unsigned)((head_offset + gtt_offset) >> 32),
+			(unsigned)((head_offset + gtt_offset) & 0xffffffff));
+	fprintf(file, "\n");
 
-	if (decode && ctx) {
+	if (ctx) {
 		intel_decode_set_batch_pointer(ctx, data, gtt_offset,
-						   *count);
+						   count);
 		intel_decode(ctx);
 	} else if (maybe_ascii(data, 16)) {
-		printf("%*s\n", 4 * *count, (char *)data);
+		fprintf(file, "%*s\n", 4 * count, (char *)data);
 	} else {
-		for (int i = 0; i + 4 <= *count; i += 4)
-			printf("[%04x] %08x %08x %08x %08x\n",
-			       4*i, data[i], data[i+1], data[i+2], data[i+3]);
+		for (int i = 0; i + 4 <= count; i += 4)
+			fprintf(file, "[%04x] %08x %08x %08x %08x\n",
+				4*i, data[i], data[i+1], data[i+2], data[i+3]);
 	}
-	*count = 0;
 }
 
 static int zlib_inflate(uint32_t **ptr, int len)
@@ -526,7 +583,8 @@ end:
 	return zstream.total_out / 4;
 }
 
-static int ascii85_decode(const char *in, uint32_t **out, bool inflate)
+static int ascii85_decode(const char *in, const char *end,
+			  uint32_t **out, bool inflate)
 {
 	int len = 0, size = 1024;
 
@@ -534,7 +592,7 @@ static int ascii85_decode(const char *in, uint32_t **out, bool inflate)
 	if (*out == NULL)
 		return 0;
 
-	while (*in >= '!' && *in <= 'z') {
+	while (in < end && *in >= '!' && *in <= 'z') {
 		uint32_t v = 0;
 
 		if (len == size) {
@@ -547,6 +605,9 @@ static int ascii85_decode(const char *in, uint32_t **out, bool inflate)
 		if (*in == 'z') {
 			in++;
 		} else {
+			if (end - in < 5)
+				break;
+
 			v += in[0] - 33; v *= 85;
 			v += in[1] - 33; v *= 85;
 			v += in[2] - 33; v *= 85;
@@ -563,10 +624,228 @@ static int ascii85_decode(const char *in, uint32_t **out, bool inflate)
 	return zlib_inflate(out, len);
 }
 
+static void decode_section(struct section *s)
+{
+	struct intel_decode *ctx = NULL;
+	FILE *file;
+
+	if (s->in) {
+		s->count = ascii85_decode(s->in, s->in + s->in_len,
+					  &s->data, s->inflate);
+		if (s->count == 0)
+			fprintf(stderr, "ASCII85 decode failed (%s - %s).\n",
+				s->ring_name, s->buffer_name);
+	}
+
+	file = open_memstream(&s->text, &s->len);
+	if (!file)
+		return;
+
+	if (s->devid && s->do_decode) {
+		ctx = intel_decode_context_alloc(s->devid);
+		intel_decode_set_output_file(ctx, file);
+		intel_decode_set_head_tail(ctx, s->head, s->tail);
+	}
+
+	decode(file, ctx, s->buffer_name, s->ring_name,
+	       s->gtt_offset, s->head_offset, s->data, s->count);
+
+	intel_decode_context_free(ctx);
+	fclose(file);
+
+	free(s->data);
+	s->data = NULL;
+}
+
+static void *worker(void *arg)
+{
+	pthread_mutex_lock(&queue.mutex);
+	for (;;) {
+		struct section *s;
+
+		while (queue.next < queue.count &&
+		       (!queue.sections[queue.next] ||
+			!queue.sections[queue.next]->is_buffer))
+			queue.next++;
+
+		if (queue.next == queue.count) {
+			if (queue.finished)
+				break;
+
+			pthread_cond_wait(&queue.queued, &queue.mutex);
+			continue;
+		}
+
+		s = queue.sections[queue.next++];
+		pthread_mutex_unlock(&queue.mutex);
+
+		decode_section(s);
+
+		pthread_mutex_lock(&queue.mutex);
+		s->done = true;
+		pthread_cond_broadcast(&queue.done);
+	}
+	pthread_mutex_unlock(&queue.mutex);
+
+	return NULL;
+}
+
+static void queue_section(struct section *s)
+{
+	pthread_mutex_lock(&queue.mutex);
+	if (queue.count == queue.size) {
+		queue.size = queue.size ? 2 * queue.size : 256;
+		queue.sections = realloc(queue.sections,
+					 queue.size * sizeof(*queue.sections));
+		if (queue.sections == NULL) {
+			fprintf(stderr, "Out of memory.\n");
+			exit(1);
+		}
+	}
+	queue.sections[queue.count++] = s;
+	pthread_cond_signal(&queue.queued);
+	pthread_mutex_unlock(&queue.mutex);
+}
+
+/* Writes out the sections in order, as far as they are complete */
+static void write_sections(bool wait)
+{
+	pthread_mutex_lock(&queue.mutex);
+	while (queue.written < queue.count) {
+		struct section *s = queue.sections[queue.written];
+
+		if (!s->done) {
+			if (!wait)
+				break;
+
+			pthread_cond_wait(&queue.done, &queue.mutex);
+			continue;
+		}
+
+		queue.sections[queue.written++] = NULL;
+		pthread_mutex_unlock(&queue.mutex);
+
+		fwrite(s->text, 1, s->len, stdout);
+		free(s->ring_name);
+		free(s->text);
+		free(s);
+
+		pthread_mutex_lock(&queue.mutex);
+	}
+	pthread_mutex_unlock(&queue.mutex);
+}
+
+static void begin_text(void)
+{
+	if (text)
+		return;
+
+	text = calloc(1, sizeof(*text));
+	if (text)
+		out = open_memstream(&text->text, &text->len);
+	if (!out) {
+		fprintf(stderr, "Out of memory.\n");
+		exit(1);
+	}
+
+	queue_section(text);
+}
+
+static void end_text(void)
+{
+	if (!text)
+		return;
+
+	fclose(out);
+	out = NULL;
+
+	pthread_mutex_lock(&queue.mutex);
+	text->done = true;
+	pthread_mutex_unlock(&queue.mutex);
+	text = NULL;
+
+	write_sections(false);
+}
+
+static bool engine_selected(const char *ring_name)
+{
+	if (!engine_filter && !hung_only)
+		return true;
+
+	if (!ring_name)
+		return false;
+
+	if (engine_filter && !strcasecmp(ring_name, engine_filter))
+		return true;
+
+	for (int i = 0; hung_only && i < num_hung_engines; i++)
+		if (!strcasecmp(ring_name, hung_engines[i]))
+			return true;
+
+	return false;
+}
+
+/*
+ * Queues a copy of the current buffer state, with either the ascii85
+ * encoded contents or the dwords of a hexdump, which it takes over.
+ */
+static void queue_buffer(const struct section *state,
+			 const char *in, size_t in_len, bool inflate,
+			 uint32_t *data, int count)
+{
+	struct section *s;
+
+	if (!engine_selected(state->ring_name)) {
+		free(data);
+		return;
+	}
+
+	s = malloc(sizeof(*s));
+	if (s == NULL) {
+		fprintf(stderr, "Out of memory.\n");
+		exit(1);
+	}
+
+	*s = *state;
+	s->text = NULL;
+	s->len = 0;
+	s->is_buffer = true;
+	s->done = false;
+	s->in = in;
+	s->in_len = in_len;
+	s->inflate = inflate;
+	s->data = data;
+	s->count = count;
+	s->ring_name = state->ring_name ? strdup(state->ring_name) : NULL;
+
+	end_text();
+	queue_section(s);
+}
+
+/* "rcs0 command stream:", also with a "GuC Error Capture on" prefix */
+static void parse_engine(const char *line, char *engine, size_t size)
+{
+	const char *end = strstr(line, " command stream:");
+	const char *start;
+
+	if (!end)
+		return;
+
+	for (start = end; start > line && start[-1] != ' '; start--)
+		;
+
+	snprintf(engine, size, "%.*s", (int)(end - start), start);
+}
+
 static void
-read_data_file(FILE *file)
+read_data(const char *buf, size_t buf_len)
 {
-	struct intel_decode *decode_ctx = NULL;
+	struct section state = {
+		.head_offset = -1,
+		.buffer_name = "batch buffer",
+		.do_decode = 1,
+	};
+	const char *ptr = buf, *end = buf + buf_len;
 	uint32_t devid = PCI_CHIP_I855_GM;
 	uint32_t *data = NULL;
 	uint32_t head[MAX_RINGS];
@@ -575,29 +854,37 @@ read_data_file(FILE *file)
 	long long unsigned fence;
 	int data_size = 0, count = 0, matched;
 	char *line = NULL;
-	size_t line_size;
+	size_t line_size = 0;
 	uint32_t offset, value, ring_length = 0;
-	uint64_t gtt_offset = 0;
-	uint32_t head_offset = -1;
-	const char *buffer_name = "batch buffer";
-	char *ring_name = NULL;
-	int do_decode = 1;
+	char engine[64] = "";
 
-	while (getline(&line, &line_size, file) > 0) {
+	while (ptr < end) {
+		const char *eol = memchr(ptr, '\n', end - ptr);
+		const char *next = eol ? eol + 1 : end;
 		char *dashes;
 
-		if (line[0] == ':' || line[0] == '~') {
-			count = ascii85_decode(line+1, &data, line[0] == ':');
-			if (count == 0)
-				fprintf(stderr, "ASCII85 decode failed (%s - %s).\n",
-					ring_name, buffer_name);
-			decode(decode_ctx,
-			       buffer_name, ring_name,
-			       gtt_offset, head_offset,
-			       data, &count, do_decode);
+		if (*ptr == ':' || *ptr == '~') {
+			queue_buffer(&state, ptr + 1, next - ptr - 1, *ptr == ':',
+				     NULL, 0);
+			ptr = next;
 			continue;
 		}
 
+		/* Everything else is short, work on a terminated copy */
+		if (next - ptr + 1 > line_size) {
+			line_size = next - ptr + 1;
+			line = realloc(line, line_size);
+			if (line == NULL) {
+				fprintf(stderr, "Out of memory.\n");
+				exit(1);
+			}
+		}
+		memcpy(line, ptr, next - ptr);
+		line[next - ptr] = '\0';
+		ptr = next;
+
+		parse_engine(line, engine, sizeof(engine));
+
 		dashes = strstr(line, "---");
 		if (dashes) {
 			const struct {
@@ -626,15 +913,14 @@ read_data_file(FILE *file)
 			strncpy(new_ring_name, line, dashes - line);
 			new_ring_name[dashes - line - 1] = '\0';
 
-			decode(decode_ctx,
-			       buffer_name, ring_name,
-			       gtt_offset, head_offset,
-			       data, &count, do_decode);
-			gtt_offset = 0;
-			head_offset = -1;
+			queue_buffer(&state, NULL, 0, false, data, count);
+			data = NULL;
+			data_size = count = 0;
+			state.gtt_offset = 0;
+			state.head_offset = -1;
 
-			free(ring_name);
-			ring_name = new_ring_name;
+			free(state.ring_name);
+			state.ring_name = new_ring_name;
 
 			dashes += 4;
 			for (b = buffers; b->match; b++) {
@@ -651,17 +937,17 @@ read_data_file(FILE *file)
 				matched = sscanf(dashes, "= 0x%08x %08x\n",
 						 &hi, &lo);
 				if (matched > 0) {
-					gtt_offset = hi;
+					state.gtt_offset = hi;
 					if (matched == 2) {
-						gtt_offset <<= 32;
-						gtt_offset |= lo;
+						state.gtt_offset <<= 32;
+						state.gtt_offset |= lo;
 					}
 				}
 
-				do_decode = b->do_decode;
-				buffer_name = b->name;
+				state.do_decode = b->do_decode;
+				state.buffer_name = b->name;
 				if (b == buffers)
-					head_offset = head[head_idx++];
+					state.head_offset = head[head_idx++];
 				break;
 			}
 
@@ -673,12 +959,12 @@ read_data_file(FILE *file)
 			unsigned int reg, reg2;
 
 			/* display reg section is after the ringbuffers, don't mix them */
-			decode(decode_ctx,
-			       buffer_name, ring_name,
-			       gtt_offset, head_offset,
-			       data, &count, do_decode);
+			queue_buffer(&state, NULL, 0, false, data, count);
+			data = NULL;
+			data_size = count = 0;
 
-			printf("%s", line);
+			begin_text();
+			fprintf(out, "%s", line);
 
 			matched = sscanf(line, "PCI ID: 0x%04x\n", &reg);
 			if (matched == 0)
@@ -690,10 +976,12 @@ read_data_file(FILE *file)
 			}
 			if (matched == 1) {
 				devid = reg;
-				printf("Detected GEN%i chipset\n",
-						intel_gen(devid));
+				fprintf(out, "Detected GEN%i chipset\n",
+					intel_gen(devid));
 
-				decode_ctx = intel_decode_context_alloc(devid);
+				state.devid = devid;
+				state.head = 0;
+				state.tail = 0;
 			}
 
 			matched = sscanf(line, "  CTL: 0x%08x\n", &reg);
@@ -708,12 +996,17 @@ read_data_file(FILE *file)
 			matched = sscanf(line, "  ACTHD: 0x%08x\n", &reg);
 			if (matched == 1) {
 				print_acthd(reg, ring_length);
-				if (decode_ctx)
-					intel_decode_set_head_tail(decode_ctx,
-								       reg,
-								       0xffffffff);
+				if (state.devid) {
+					state.head = reg;
+					state.tail = 0xffffffff;
+				}
 			}
 
+			matched = sscanf(line, "  hung: %u\n", &reg);
+			if (matched == 1 && reg && *engine &&
+			    num_hung_engines < MAX_ENGINES)
+				hung_engines[num_hung_engines++] = strdup(engine);
+
 			matched = sscanf(line, "  PGTBL_ER: 0x%08x\n", &reg);
 			if (matched == 1 && reg)
 				print_pgtbl_err(reg, devid);
@@ -759,14 +1052,79 @@ read_data_file(FILE *file)
 		data[count-1] = value;
 	}
 
-	decode(decode_ctx,
-	       buffer_name, ring_name,
-	       gtt_offset, head_offset,
-	       data, &count, do_decode);
+	queue_buffer(&state, NULL, 0, false, data, count);
+	end_text();
 
-	free(data);
 	free(line);
-	free(ring_name);
+	free(state.ring_name);
+}
+
+static void
+read_data_file(FILE *file, int jobs)
+{
+	pthread_t *threads;
+	struct stat st;
+	size_t len = 0;
+	char *buf = NULL;
+	bool mapped = false;
+
+	/* sysfs and pipes don't know their size, read those */
+	if (fstat(fileno(file), &st) == 0 && S_ISREG(st.st_mode) &&
+	    st.st_size > 0) {
+		buf = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE,
+			   fileno(file), 0);
+		if (buf != MAP_FAILED) {
+			len = st.st_size;
+			mapped = true;
+		} else {
+			buf = NULL;
+		}
+	}
+
+	if (!mapped) {
+		size_t size = 0;
+		size_t ret;
+
+		do {
+			if (len == size) {
+				size = size ? 2 * size : 1 << 20;
+				buf = realloc(buf, size);
+				if (buf == NULL) {
+					fprintf(stderr, "Out of memory.\n");
+					exit(1);
+				}
+			}
+
+			ret = fread(buf + len, 1, size - len, file);
+			len += ret;
+		} while (ret);
+	}
+
+	threads = calloc(jobs, sizeof(*threads));
+	for (int i = 0; i < jobs; i++)
+		pthread_create(&threads[i], NULL, worker, NULL);
+
+	read_data(buf, len);
+
+	pthread_mutex_lock(&queue.mutex);
+	queue.finished = true;
+	pthread_cond_broadcast(&queue.queued);
+	pthread_mutex_unlock(&queue.mutex);
+
+	write_sections(true);
+
+	for (int i = 0; i < jobs; i++)
+		pthread_join(threads[i], NULL);
+	free(threads);
+
+	free(queue.sections);
+	for (int i = 0; i < num_hung_engines; i++)
+		free(hung_engines[i]);
+
+	if (mapped)
+		munmap(buf, len);
+	else
+		free(buf);
 }
 
 static void setup_pager(void)
@@ -793,35 +1151,73 @@ static void setup_pager(void)
 	}
 }
 
+static void __attribute__((noreturn)) usage(const char *name)
+{
+	fprintf(stderr,
+			"intel_gpu_decode: Parse an Intel GPU i915_error_state\n"
+			"Usage:\n"
+			"\t%s [options] [<file>]\n"
+			"\n"
+			"Options:\n"
+			"\t-e, --engine=NAME\tOnly decode the buffers of engine NAME\n"
+			"\t-H, --hung\t\tOnly decode the buffers of the hung engines\n"
+			"\t-j, --jobs=N\t\tDecode buffers with N threads (default: online CPUs)\n"
+			"\n"
+			"With no arguments, debugfs-dri-directory is probed for in "
+			"/debug and \n"
+			"/sys/kernel/debug.  Otherwise, it may be "
+			"specified.  If a file is given,\n"
+			"it is parsed as an GPU dump in the format of "
+			"/debug/dri/0/i915_error_state.\n",
+			name);
+	exit(1);
+}
+
 int
 main(int argc, char *argv[])
 {
+	static const struct option long_options[] = {
+		{ "engine", required_argument, NULL, 'e' },
+		{ "hung", no_argument, NULL, 'H' },
+		{ "jobs", required_argument, NULL, 'j' },
+		{ "help", no_argument, NULL, 'h' },
+		{ }
+	};
 	FILE *file;
 	const char *path;
 	char *filename = NULL;
 	struct stat st;
-	int error;
-
-	if (argc > 2) {
-		fprintf(stderr,
-				"intel_gpu_decode: Parse an Intel GPU i915_error_state\n"
-				"Usage:\n"
-				"\t%s [<file>]\n"
-				"\n"
-				"With no arguments, debugfs-dri-directory is probed for in "
-				"/debug and \n"
-				"/sys/kernel/debug.  Otherwise, it may be "
-				"specified.  If a file is given,\n"
-				"it is parsed as an GPU dump in the format of "
-				"/debug/dri/0/i915_error_state.\n",
-				argv[0]);
-		return 1;
+	int jobs = sysconf(_SC_NPROCESSORS_ONLN);
+	int error, opt;
+
+	while ((opt = getopt_long(argc, argv, "e:Hj:h", long_options, NULL)) != -1) {
+		switch (opt) {
+		case 'e':
+			engine_filter = optarg;
+			break;
+		case 'H':
+			hung_only = true;
+			break;
+		case 'j':
+			jobs = atoi(optarg);
+			if (jobs <= 0)
+				usage(argv[0]);
+			break;
+		default:
+			usage(argv[0]);
+		}
 	}
 
+	if (argc - optind > 1)
+		usage(argv[0]);
+
+	if (jobs <= 0)
+		jobs = 1;
+
 	if (isatty(1))
 		setup_pager();
 
-	if (argc == 1) {
+	if (optind == argc) {
 		if (isatty(0)) {
 			path = "/sys/class/drm/card0/error";
 			error = stat(path, &st);
@@ -840,11 +1236,11 @@ main(int argc, char *argv[])
 				     "\tsudo mount -t debugfs debugfs /sys/kernel/debug\n");
 			}
 		} else {
-			read_data_file(stdin);
+			read_data_file(stdin, jobs);
 			exit(0);
 		}
 	} else {
-		path = argv[1];
+		path = argv[optind];
 		error = stat(path, &st);
 		if (error != 0) {
 			fprintf(stderr, "Error opening %s: %s\n",
@@ -885,7 +1281,7 @@ main(int argc, char *argv[])
 		}
 	}
 
-	read_data_file(file);
+	read_data_file(file, jobs);
 	fclose(file);
 
 	if (filename != path)
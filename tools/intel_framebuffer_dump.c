@@ -23,10 +23,15 @@
  */
 
 /*
- * Read back all the KMS framebuffers attached to the CRTC and record as PNG.
+ * Read back all the KMS framebuffers attached to the CRTC and record as PNG,
+ * or with -r as raw frame dumps, much faster to write, to convert to PNG later
+ * with igt_frame_convert.
  */
 
 #include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
 #include <sys/types.h>
 #include <sys/mman.h>
 #include <errno.h>
@@ -36,11 +41,35 @@
 
 #include "intel_io.h"
 #include "drmtest.h"
+#include "igt_frame_dump.h"
+
+static uint64_t clock_ns(clockid_t clock)
+{
+	struct timespec ts;
+
+	clock_gettime(clock, &ts);
+
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
 
 int main(int argc, char **argv)
 {
+	bool raw = false;
 	drmModeResPtr res;
-	int fd, n;
+	int fd, n, c;
+
+	while ((c = getopt(argc, argv, "rh")) != -1) {
+		switch (c) {
+		case 'r':
+			raw = true;
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-r]\n"
+				"  -r  Write raw frame dumps instead of PNGs\n",
+				argv[0]);
+			return c == 'h' ? 0 : EINVAL;
+		}
+	}
 
 	fd = drmOpen("i915", NULL);
 	if (fd < 0)
@@ -79,11 +108,14 @@ int main(int argc, char **argv)
 						mmap_arg.handle = open_arg.handle;
 			if (drmIoctl(fd, DRM_IOCTL_I915_GEM_MMAP_GTT, &mmap_arg) == 0 &&
 			    (ptr = mmap(0, open_arg.size, PROT_READ, MAP_SHARED, fd, mmap_arg.offset)) != (void *)-1) {
+				uint64_t timestamp_ns = clock_ns(CLOCK_MONOTONIC);
+				uint64_t realtime_ns = clock_ns(CLOCK_REALTIME);
 				cairo_surface_t *surface;
 				cairo_format_t format;
 				char name[80];
 
-				snprintf(name, sizeof(name), "fb-%d.png",  fb->fb_id);
+				snprintf(name, sizeof(name), "fb-%d.%s",  fb->fb_id,
+					 raw ? "igtraw" : "png");
 
 				switch (fb->depth) {
 				case 16: format = CAIRO_FORMAT_RGB16_565; break;
@@ -95,7 +127,11 @@ int main(int argc, char **argv)
 
 				surface = cairo_image_surface_create_for_data(ptr, format,
 									      fb->width, fb->height, fb->pitch);
-				cairo_surface_write_to_png(surface, name);
+				if (raw)
+					igt_frame_raw_write(surface, name,
+							    timestamp_ns, realtime_ns);
+				else
+					cairo_surface_write_to_png(surface, name);
 				cairo_surface_destroy(surface);
 
 				munmap(ptr, open_arg.size);
@@ -26,21 +26,73 @@
  *
  */
 
-#include <unistd.h>
+/*
+ * Runs a command and reports, next to its CPU times, the GPU time it used.
+ *
+ * The DRM fds opened by the command and all its descendants are followed
+ * through their fdinfo, so other processes using the GPU at the same time
+ * don't count, and any driver exposing the DRM usage stats is supported.
+ * Reported are the busy time of each engine class, the cycles on drivers
+ * exposing drm-cycles, and the peak resident memory of each region.
+ *
+ * The fdinfo is sampled at a fixed interval, re-reading only the fds already
+ * known in between the periodic scans for new ones. Whatever a process uses
+ * in the last interval before closing its fd or exiting is not seen.
+ */
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
 #include <signal.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <sys/time.h>
+#include <string.h>
+#include <sys/prctl.h>
 #include <sys/resource.h>
+#include <sys/time.h>
 #include <sys/wait.h>
+#include <unistd.h>
+
+#include "igt_drm_clients.h"
+#include "igt_drm_fdinfo.h"
+
+#define MAX_ENGINES	64
+#define MAX_REGIONS	64
+#define MAX_PIDS	1024
+
+#define DEFAULT_INTERVAL_MS	20
+#define FULL_SCAN_INTERVAL_MS	250
+
+struct engine_usage {
+	unsigned int minor;
+	char name[64];
+	unsigned int capacity;
+	uint64_t time_ns;
+	uint64_t cycles;
+	uint64_t total_cycles;
+	bool has_cycles;
+	bool has_total_cycles;
+};
 
-#include "intel_io.h"
-#include "intel_chipset.h"
-#include "intel_reg.h"
+struct region_usage {
+	unsigned int minor;
+	char name[64];
+	uint64_t resident;
+	uint64_t peak;
+};
 
-#define SAMPLES_PER_SEC             10000
+static struct engine_usage engines[MAX_ENGINES];
+static unsigned int num_engines;
+static struct region_usage regions[MAX_REGIONS];
+static unsigned int num_regions;
 
-static volatile int goddo;
+/* Processes known to be, or not to be, descendants of the command */
+static struct {
+	unsigned int pid;
+	bool ours;
+} pids[MAX_PIDS];
+static unsigned int num_pids;
 
 static pid_t spawn(char **argv)
 {
@@ -51,63 +103,313 @@ static pid_t spawn(char **argv)
 		return pid;
 
 	execvp(argv[0], argv);
-	exit(1);
+	exit(127);
 }
 
+/* Only there to interrupt the sleep in between samples */
 static void sighandler(int sig)
 {
-	goddo = sig;
+}
+
+/* Reaps the processes reparented to us, returns whether @child exited */
+static bool reap(pid_t child, int *status)
+{
+	bool exited = false;
+	pid_t pid;
+	int st;
+
+	while ((pid = waitpid(-1, &st, WNOHANG)) > 0) {
+		if (pid == child) {
+			*status = st;
+			exited = true;
+		}
+	}
+
+	return exited;
+}
+
+static unsigned int parent_pid(unsigned int pid)
+{
+	char path[64], buf[512], *p;
+	unsigned int ppid = 0;
+	ssize_t len;
+	int fd;
+
+	snprintf(path, sizeof(path), "/proc/%u/stat", pid);
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return 0;
+
+	len = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if (len <= 0)
+		return 0;
+	buf[len] = '\0';
+
+	/* The command name may contain anything, skip past its closing ')' */
+	p = strrchr(buf, ')');
+	if (p)
+		sscanf(p + 1, " %*c %u", &ppid);
+
+	return ppid;
+}
+
+/*
+ * We are the subreaper of the command, so everything it started is either
+ * still below it or was reparented to us.
+ */
+static bool is_descendant(unsigned int pid)
+{
+	unsigned int self = getpid();
+	unsigned int p = pid;
+	unsigned int i;
+	bool ours;
+
+	if (pid == self)
+		return false;
+
+	for (i = 0; i < num_pids; i++)
+		if (pids[i].pid == pid)
+			return pids[i].ours;
+
+	while (p > 1 && p != self)
+		p = parent_pid(p);
+	ours = p == self;
+
+	/* Pids get reused, but hardly within the run of a command */
+	if (num_pids < MAX_PIDS) {
+		pids[num_pids].pid = pid;
+		pids[num_pids].ours = ours;
+		num_pids++;
+	}
+
+	return ours;
+}
+
+static struct engine_usage *find_engine(unsigned int minor, const char *name)
+{
+	struct engine_usage *e;
+	unsigned int i;
+
+	for (i = 0; i < num_engines; i++)
+		if (engines[i].minor == minor && !strcmp(engines[i].name, name))
+			return &engines[i];
+
+	if (num_engines == MAX_ENGINES)
+		return NULL;
+
+	e = &engines[num_engines++];
+	e->minor = minor;
+	snprintf(e->name, sizeof(e->name), "%s", name);
+
+	return e;
+}
+
+static struct region_usage *find_region(unsigned int minor, const char *name)
+{
+	struct region_usage *r;
+	unsigned int i;
+
+	for (i = 0; i < num_regions; i++)
+		if (regions[i].minor == minor && !strcmp(regions[i].name, name))
+			return &regions[i];
+
+	if (num_regions == MAX_REGIONS)
+		return NULL;
+
+	r = &regions[num_regions++];
+	r->minor = minor;
+	snprintf(r->name, sizeof(r->name), "%s", name);
+
+	return r;
+}
+
+static void account_client(const struct igt_drm_client *c)
+{
+	unsigned int i;
+
+	for (i = 0; i <= c->engines->max_engine_id; i++) {
+		const struct igt_drm_client_utilization *u = &c->utilization[i];
+		struct engine_usage *e;
+
+		if (!c->engines->capacity[i])
+			continue;
+
+		e = find_engine(c->drm_minor, c->engines->names[i]);
+		if (!e)
+			continue;
+
+		if (c->engines->capacity[i] > e->capacity)
+			e->capacity = c->engines->capacity[i];
+
+		e->time_ns += u->delta_engine_time;
+		if (c->utilization_mask & IGT_DRM_CLIENT_UTILIZATION_CYCLES) {
+			e->cycles += u->delta_cycles;
+			e->has_cycles = true;
+		}
+		if (c->utilization_mask & IGT_DRM_CLIENT_UTILIZATION_TOTAL_CYCLES) {
+			e->total_cycles += u->delta_total_cycles;
+			e->has_total_cycles = true;
+		}
+	}
+
+	for (i = 0; i <= c->regions->max_region_id; i++) {
+		struct region_usage *r;
+
+		if (!c->regions->names[i])
+			continue;
+
+		r = find_region(c->drm_minor, c->regions->names[i]);
+		if (r)
+			r->resident += c->memory[i].resident;
+	}
+}
+
+static void sample(struct igt_drm_clients *clients)
+{
+	struct igt_drm_client *c;
+	unsigned int i;
+	int tmp;
+
+	igt_drm_clients_scan(clients, NULL, NULL, 0, NULL, 0);
+
+	for (i = 0; i < num_regions; i++)
+		regions[i].resident = 0;
+
+	igt_for_each_drm_client(clients, c, tmp) {
+		if (c->status != IGT_DRM_CLIENT_ALIVE)
+			break;
+
+		if (is_descendant(c->pid))
+			account_client(c);
+	}
+
+	for (i = 0; i < num_regions; i++)
+		if (regions[i].resident > regions[i].peak)
+			regions[i].peak = regions[i].resident;
+}
+
+static void print_size(uint64_t bytes)
+{
+	static const char * const units[] = { "B", "KiB", "MiB", "GiB", "TiB" };
+	double size = bytes;
+	unsigned int i = 0;
+
+	while (size >= 1024 && i < sizeof(units) / sizeof(units[0]) - 1) {
+		size /= 1024;
+		i++;
+	}
+
+	printf("%.1f %s", size, units[i]);
+}
+
+static void report_gpu(double elapsed)
+{
+	unsigned int i;
+
+	if (!num_engines && !num_regions) {
+		printf("GPU: no DRM usage stats seen\n");
+		return;
+	}
+
+	for (i = 0; i < num_engines; i++) {
+		const struct engine_usage *e = &engines[i];
+
+		printf("GPU %u %s: %" PRIu64 ".%06" PRIu64 "s, %.1f%%",
+		       e->minor, e->name, e->time_ns / 1000000000,
+		       e->time_ns % 1000000000 / 1000,
+		       elapsed ? e->time_ns / 1e7 / elapsed / e->capacity : 0);
+		if (e->has_cycles)
+			printf(", cycles: %" PRIu64, e->cycles);
+		if (e->has_cycles && e->has_total_cycles && e->total_cycles)
+			printf(" of %" PRIu64 " (%.1f%%)", e->total_cycles,
+			       e->cycles * 100. / e->total_cycles);
+		printf("\n");
+	}
+
+	for (i = 0; i < num_regions; i++) {
+		printf("GPU %u %s: peak resident ", regions[i].minor,
+		       regions[i].name);
+		print_size(regions[i].peak);
+		printf("\n");
+	}
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"usage: %s [-i ms] cmd [args...]\n"
+		"\n"
+		"  -i ms  fdinfo sampling interval (default %u)\n",
+		name, DEFAULT_INTERVAL_MS);
 }
 
 int main(int argc, char **argv)
 {
-	pid_t child;
-	uint64_t ring_idle = 0, ring_time = 0;
+	unsigned int interval_ms = DEFAULT_INTERVAL_MS;
+	struct igt_drm_clients *clients;
 	struct timeval start, end;
 	static struct rusage rusage;
-	struct intel_mmio_data mmio_data;
-	int status;
+	double elapsed;
+	pid_t child;
+	int status, c;
+
+	while ((c = getopt(argc, argv, "+i:h")) != -1) {
+		switch (c) {
+		case 'i':
+			interval_ms = strtoul(optarg, NULL, 0);
+			if (!interval_ms) {
+				usage(argv[0]);
+				return 1;
+			}
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
 
-	intel_mmio_use_pci_bar(&mmio_data, intel_get_pci_device());
+	if (optind == argc) {
+		usage(argv[0]);
+		return 1;
+	}
 
-	if (argc == 1) {
-		fprintf(stderr, "usage: %s cmd [args...]\n", argv[0]);
+	clients = igt_drm_clients_init(NULL);
+	if (!clients) {
+		fprintf(stderr, "Failed to initialise the DRM client tracking\n");
 		return 1;
 	}
+	igt_drm_clients_set_full_scan_interval(clients, FULL_SCAN_INTERVAL_MS);
 
+	prctl(PR_SET_CHILD_SUBREAPER, 1);
 	signal(SIGCHLD, sighandler);
 	signal(SIGINT, SIG_IGN);
 	signal(SIGQUIT, SIG_IGN);
 
 	gettimeofday(&start, NULL);
-	child = spawn(argv+1);
+	child = spawn(argv + optind);
 	if (child < 0)
 		return 127;
 
-	while (!goddo) {
-		uint32_t ring_head, ring_tail;
-
-		ring_head = INREG(LP_RING + RING_HEAD) & HEAD_ADDR;
-		ring_tail = INREG(LP_RING + RING_TAIL) & TAIL_ADDR;
-
-		if (ring_tail == ring_head)
-			ring_idle++;
-		ring_time++;
-
-		usleep(1000000 / SAMPLES_PER_SEC);
+	while (!reap(child, &status)) {
+		sample(clients);
+		usleep(interval_ms * 1000);
 	}
 	gettimeofday(&end, NULL);
 	timersub(&end, &start, &end);
 
-	waitpid(child, &status, 0);
+	/* Catch what the processes left behind did until now */
+	sample(clients);
+	igt_drm_clients_free(clients);
 
+	elapsed = end.tv_sec + 1e-6 * end.tv_usec;
 	getrusage(RUSAGE_CHILDREN, &rusage);
-	printf("user: %ld.%06lds, sys: %ld.%06lds, elapsed: %ld.%06lds, CPU: %.1f%%, GPU: %.1f%%\n",
+	printf("user: %ld.%06lds, sys: %ld.%06lds, elapsed: %ld.%06lds, CPU: %.1f%%\n",
 	       rusage.ru_utime.tv_sec, rusage.ru_utime.tv_usec,
 	       rusage.ru_stime.tv_sec, rusage.ru_stime.tv_usec,
 	       end.tv_sec, end.tv_usec,
-	       100*(rusage.ru_utime.tv_sec + 1e-6*rusage.ru_utime.tv_usec + rusage.ru_stime.tv_sec + 1e-6*rusage.ru_stime.tv_usec) / (end.tv_sec + 1e-6*end.tv_usec),
-	       100 - ring_idle * 100. / ring_time);
+	       100*(rusage.ru_utime.tv_sec + 1e-6*rusage.ru_utime.tv_usec + rusage.ru_stime.tv_sec + 1e-6*rusage.ru_stime.tv_usec) / elapsed);
+	report_gpu(elapsed);
 
 	return WEXITSTATUS(status);
 }
@@ -33,7 +33,10 @@
 #include <locale.h>
 #include <math.h>
 #include <poll.h>
+#include <pthread.h>
+#include <sched.h>
 #include <signal.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -49,6 +52,7 @@
 #include "igt_perf.h"
 #include "igt_drm_clients.h"
 #include "igt_drm_fdinfo.h"
+#include "igt_openmetrics.h"
 
 #define ARRAY_SIZE(arr) (sizeof(arr)/sizeof(arr[0]))
 
@@ -65,6 +69,13 @@ struct pmu_counter {
 	double scale;
 	const char *units;
 	bool present;
+
+	/* High rate sampling: value at the window start and peak rate per second */
+	uint64_t start;
+	double peak;
+	uint64_t peak_span; /* Shortest interval to compute a rate over, in ns */
+	uint64_t peak_ts;
+	uint64_t peak_val;
 };
 
 struct engine_class {
@@ -120,6 +131,8 @@ struct engines {
 
 	int num_gts;
 
+	uint64_t *sample; /* Last raw sample, for recording */
+
 	/* Do not edit below this line.
 	 * This structure is reallocated every time a new engine is
 	 * found and size is increased by sizeof (engine).
@@ -500,9 +513,11 @@ static void free_engines(struct engines *engines)
 		free((char *)engine->display_name);
 	}
 
-	closedir(engines->root);
+	if (engines->root)
+		closedir(engines->root);
 
 	free(engines->class);
+	free(engines->sample);
 	free(engines);
 }
 
@@ -696,6 +711,20 @@ static double pmu_calc(struct pmu_pair *p, double d, double t, double s)
 	return v;
 }
 
+static double pmu_calc_peak(struct pmu_counter *pmu, double d, double s)
+{
+	double v;
+
+	v = pmu->peak;
+	v /= d;
+	v *= s;
+
+	if (s == 100.0 && v > 100.0)
+		v = 100.0;
+
+	return v;
+}
+
 static void fill_str(char *buf, unsigned int bufsz, char c, unsigned int num)
 {
 	unsigned int i;
@@ -712,20 +741,44 @@ static void __update_sample(struct pmu_counter *counter, uint64_t val)
 	counter->val.cur = val;
 }
 
-static void update_sample(struct pmu_counter *counter, uint64_t *val)
+static void update_sample(struct pmu_counter *counter, const uint64_t *val)
 {
 	if (counter->present)
 		__update_sample(counter, val[counter->idx]);
 }
 
-static void pmu_sample(struct engines *engines)
+/* Timestamp followed by the group, RAPL and IMC counter values. */
+static unsigned int sample_words(const struct engines *engines)
+{
+	return 1 + engines->num_counters + engines->num_rapl + engines->num_imc;
+}
+
+static void pmu_read_sample(struct engines *engines, uint64_t *sample)
+{
+	uint64_t *val = sample + 1;
+
+	sample[0] = pmu_read_multi(engines->fd, engines->num_counters, val);
+	val += engines->num_counters;
+
+	if (engines->num_rapl)
+		pmu_read_multi(engines->rapl_fd, engines->num_rapl, val);
+	val += engines->num_rapl;
+
+	if (engines->num_imc)
+		pmu_read_multi(engines->imc_fd, engines->num_imc, val);
+}
+
+static void pmu_update(struct engines *engines, const uint64_t *sample)
 {
-	const int num_val = engines->num_counters;
-	uint64_t val[2 + num_val];
+	const uint64_t *val = sample + 1;
 	unsigned int i;
 
+	if (engines->sample)
+		memcpy(engines->sample, sample,
+		       sample_words(engines) * sizeof(*sample));
+
 	engines->ts.prev = engines->ts.cur;
-	engines->ts.cur = pmu_read_multi(engines->fd, num_val, val);
+	engines->ts.cur = sample[0];
 
 	engines->freq_req.val.cur = engines->freq_req.val.prev = 0;
 	engines->freq_act.val.cur = engines->freq_act.val.prev = 0;
@@ -764,19 +817,560 @@ static void pmu_sample(struct engines *engines)
 		update_sample(&engine->wait, val);
 	}
 
+	val += engines->num_counters;
 	if (engines->num_rapl) {
-		pmu_read_multi(engines->rapl_fd, engines->num_rapl, val);
 		update_sample(&engines->r_gpu, val);
 		update_sample(&engines->r_pkg, val);
 	}
 
+	val += engines->num_rapl;
 	if (engines->num_imc) {
-		pmu_read_multi(engines->imc_fd, engines->num_imc, val);
 		update_sample(&engines->imc_reads, val);
 		update_sample(&engines->imc_writes, val);
 	}
 }
 
+static void pmu_sample(struct engines *engines)
+{
+	uint64_t sample[sample_words(engines)];
+
+	pmu_read_sample(engines, sample);
+	pmu_update(engines, sample);
+}
+
+static void
+for_each_pmu_counter(struct engines *engines,
+		     void (*fn)(struct pmu_counter *pmu, void *data),
+		     void *data)
+{
+	struct pmu_counter *counters[] = {
+		&engines->freq_req,
+		&engines->freq_act,
+		&engines->irq,
+		&engines->rc6,
+		&engines->r_gpu,
+		&engines->r_pkg,
+		&engines->imc_reads,
+		&engines->imc_writes,
+	};
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(counters); i++)
+		fn(counters[i], data);
+
+	for (i = 0; i < engines->num_gts; i++) {
+		fn(&engines->freq_req_gt[i], data);
+		fn(&engines->freq_act_gt[i], data);
+		fn(&engines->rc6_gt[i], data);
+	}
+
+	for (i = 0; i < engines->num_engines; i++) {
+		struct engine *engine = engine_ptr(engines, i);
+
+		fn(&engine->busy, data);
+		fn(&engine->sema, data);
+		fn(&engine->wait, data);
+	}
+}
+
+/*
+ * High rate sampling
+ *
+ * A pinned thread reads all the counter groups at the requested rate into a
+ * single producer, single consumer ring. Every refresh the display loop drains
+ * the ring, keeping the peak rate between consecutive samples, and reports the
+ * averages over the whole window as before.
+ */
+struct sampler {
+	struct engines *engines;
+	unsigned int rate_hz;
+	unsigned int words; /* Per sample */
+	unsigned int size; /* Samples, a power of two */
+	uint64_t *ring;
+	unsigned int head; /* Written by the sampling thread */
+	unsigned int tail; /* Written by the display loop */
+	bool stop;
+	pthread_t thread;
+};
+
+static unsigned int sample_hz;
+
+static void sampler_pin_self(void)
+{
+	cpu_set_t cpus;
+	int cpu;
+
+	if (sched_getaffinity(0, sizeof(cpus), &cpus))
+		return;
+
+	/* Keep off the first CPUs where most of the system runs */
+	for (cpu = CPU_SETSIZE - 1; cpu >= 0; cpu--) {
+		if (!CPU_ISSET(cpu, &cpus))
+			continue;
+
+		CPU_ZERO(&cpus);
+		CPU_SET(cpu, &cpus);
+		pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+		break;
+	}
+}
+
+static void *sampler_thread(void *data)
+{
+	struct sampler *s = data;
+	const long period_ns = NSEC_PER_SEC / s->rate_hz;
+	struct timespec next;
+
+	sampler_pin_self();
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	while (!__atomic_load_n(&s->stop, __ATOMIC_ACQUIRE)) {
+		unsigned int head = s->head;
+
+		/*
+		 * Counters are cumulative so when the display loop falls
+		 * behind, dropping samples only loses peak resolution.
+		 */
+		if (head - __atomic_load_n(&s->tail, __ATOMIC_ACQUIRE) < s->size) {
+			pmu_read_sample(s->engines,
+					&s->ring[(head & (s->size - 1)) * s->words]);
+			__atomic_store_n(&s->head, head + 1, __ATOMIC_RELEASE);
+		}
+
+		next.tv_nsec += period_ns;
+		while (next.tv_nsec >= NSEC_PER_SEC) {
+			next.tv_nsec -= NSEC_PER_SEC;
+			next.tv_sec++;
+		}
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+	}
+
+	return NULL;
+}
+
+static struct sampler *
+sampler_start(struct engines *engines, unsigned int rate_hz,
+	      unsigned int period_us)
+{
+	uint64_t samples = 2 * (uint64_t)rate_hz * period_us / USEC_PER_SEC + 2;
+	struct sampler *s;
+	int i;
+
+	/*
+	 * i915 samples frequency and RC6 from a 200Hz timer and RAPL energy
+	 * is updated about every millisecond, so only compute their rates
+	 * over intervals those counters can resolve.
+	 */
+	engines->freq_req.peak_span = 5000000;
+	engines->freq_act.peak_span = 5000000;
+	engines->rc6.peak_span = 5000000;
+	for (i = 0; i < engines->num_gts; i++) {
+		engines->freq_req_gt[i].peak_span = 5000000;
+		engines->freq_act_gt[i].peak_span = 5000000;
+		engines->rc6_gt[i].peak_span = 5000000;
+	}
+	engines->r_gpu.peak_span = 1000000;
+	engines->r_pkg.peak_span = 1000000;
+
+	s = calloc(1, sizeof(*s));
+	assert(s);
+
+	s->engines = engines;
+	s->rate_hz = rate_hz;
+	s->words = sample_words(engines);
+	for (s->size = 2; s->size < samples; s->size <<= 1)
+		;
+	s->ring = calloc(s->size, s->words * sizeof(*s->ring));
+	assert(s->ring);
+
+	if (pthread_create(&s->thread, NULL, sampler_thread, s)) {
+		free(s->ring);
+		free(s);
+		return NULL;
+	}
+
+	return s;
+}
+
+static void sampler_stop(struct sampler *s)
+{
+	if (!s)
+		return;
+
+	__atomic_store_n(&s->stop, true, __ATOMIC_RELEASE);
+	pthread_join(s->thread, NULL);
+
+	free(s->ring);
+	free(s);
+}
+
+static void window_begin(struct pmu_counter *pmu, void *data)
+{
+	pmu->start = pmu->val.cur;
+	pmu->peak = 0;
+	pmu->peak_ts = *(uint64_t *)data;
+	pmu->peak_val = pmu->val.cur;
+}
+
+static void window_peak(struct pmu_counter *pmu, void *data)
+{
+	uint64_t ts = *(uint64_t *)data;
+	double rate;
+
+	if (!pmu->present || ts - pmu->peak_ts < pmu->peak_span)
+		return;
+
+	if (pmu->val.cur > pmu->peak_val) {
+		rate = (double)(pmu->val.cur - pmu->peak_val) * 1e9 /
+		       (ts - pmu->peak_ts);
+		if (rate > pmu->peak)
+			pmu->peak = rate;
+	}
+
+	pmu->peak_ts = ts;
+	pmu->peak_val = pmu->val.cur;
+}
+
+static void window_end(struct pmu_counter *pmu, void *data)
+{
+	pmu->val.prev = pmu->start;
+}
+
+/*
+ * Consumes the samples taken since the last refresh, leaving the counters
+ * spanning the whole window, with their peak rate in between.
+ */
+static void sampler_consume(struct sampler *s)
+{
+	struct engines *engines = s->engines;
+	unsigned int head = __atomic_load_n(&s->head, __ATOMIC_ACQUIRE);
+	unsigned int tail = s->tail;
+	uint64_t ts_start = engines->ts.cur;
+
+	if (head == tail)
+		return; /* Keep showing the previous window */
+
+	for_each_pmu_counter(engines, window_begin, &ts_start);
+
+	for (; tail != head; tail++) {
+		pmu_update(engines, &s->ring[(tail & (s->size - 1)) * s->words]);
+		if (engines->ts.cur > engines->ts.prev)
+			for_each_pmu_counter(engines, window_peak,
+					     &engines->ts.cur);
+	}
+
+	__atomic_store_n(&s->tail, tail, __ATOMIC_RELEASE);
+
+	for_each_pmu_counter(engines, window_end, NULL);
+	engines->ts.prev = ts_start;
+}
+
+/*
+ * Binary recording
+ *
+ * A recording starts with the counter schema: the engines and, for every
+ * counter, whether it is present, its index in the sample and its scale and
+ * units. It is followed by one record per refresh holding the raw counter
+ * values in the pmu_read_sample() layout. Deltas from the previous sample are
+ * stored as 32-bit words, with a keyframe of absolute 64-bit values at the
+ * start, every RECORDING_KEYFRAME records and whenever a delta does not fit.
+ * Everything is in host byte order.
+ *
+ * Replay feeds the samples back through pmu_update() so all outputs work as
+ * when running live.
+ */
+#define RECORDING_MAGIC "IGTTOP01"
+#define RECORDING_KEYFRAME (600)
+
+enum {
+	RECORD_DELTA = 0,
+	RECORD_KEYFRAME = 1,
+};
+
+struct recording {
+	FILE *file;
+	unsigned int words;
+	unsigned int count;
+	uint64_t *prev; /* Last sample written or replayed */
+};
+
+static void write_u32(FILE *f, uint32_t val)
+{
+	fwrite(&val, sizeof(val), 1, f);
+}
+
+static void write_str(FILE *f, const char *str)
+{
+	uint32_t len = str ? strlen(str) : 0;
+
+	write_u32(f, len);
+	if (len)
+		fwrite(str, 1, len, f);
+}
+
+static bool read_u32(FILE *f, uint32_t *val)
+{
+	return fread(val, sizeof(*val), 1, f) == 1;
+}
+
+static char *read_str(FILE *f)
+{
+	uint32_t len;
+	char *str;
+
+	if (!read_u32(f, &len) || len > PATH_MAX)
+		return NULL;
+
+	str = calloc(1, len + 1);
+	if (str && fread(str, 1, len, f) != len) {
+		free(str);
+		return NULL;
+	}
+
+	return str;
+}
+
+static void write_counter(struct pmu_counter *pmu, void *data)
+{
+	FILE *f = data;
+
+	write_u32(f, pmu->present);
+	write_u32(f, pmu->idx);
+	fwrite(&pmu->scale, sizeof(pmu->scale), 1, f);
+	write_str(f, pmu->present ? pmu->units : NULL);
+}
+
+static void read_counter(struct pmu_counter *pmu, void *data)
+{
+	FILE *f = data;
+	uint32_t present = 0, idx = 0;
+
+	read_u32(f, &present);
+	read_u32(f, &idx);
+	if (fread(&pmu->scale, sizeof(pmu->scale), 1, f) != 1)
+		pmu->scale = 0;
+
+	pmu->present = present;
+	pmu->idx = idx;
+	pmu->units = read_str(f);
+	if (!pmu->units || !*pmu->units) {
+		free((char *)pmu->units);
+		pmu->units = NULL;
+	}
+}
+
+static struct recording *
+recording_create(const char *path, struct engines *engines,
+		 const char *card, const char *codename,
+		 unsigned int period_us)
+{
+	struct recording *rec;
+	unsigned int i;
+
+	rec = calloc(1, sizeof(*rec));
+	assert(rec);
+
+	rec->file = fopen(path, "w");
+	if (!rec->file) {
+		free(rec);
+		return NULL;
+	}
+
+	rec->words = sample_words(engines);
+	rec->prev = calloc(rec->words, sizeof(*rec->prev));
+	engines->sample = calloc(rec->words, sizeof(*engines->sample));
+	assert(rec->prev && engines->sample);
+
+	fwrite(RECORDING_MAGIC, 1, strlen(RECORDING_MAGIC), rec->file);
+	write_u32(rec->file, period_us);
+	write_u32(rec->file, engines->num_counters);
+	write_u32(rec->file, engines->num_rapl);
+	write_u32(rec->file, engines->num_imc);
+	write_u32(rec->file, engines->num_gts);
+	write_u32(rec->file, engines->discrete);
+	write_str(rec->file, card);
+	write_str(rec->file, codename);
+
+	write_u32(rec->file, engines->num_engines);
+	for (i = 0; i < engines->num_engines; i++) {
+		struct engine *engine = engine_ptr(engines, i);
+
+		write_str(rec->file, engine->name);
+		write_u32(rec->file, engine->class);
+		write_u32(rec->file, engine->instance);
+		write_u32(rec->file, engine->num_counters);
+	}
+
+	for_each_pmu_counter(engines, write_counter, rec->file);
+
+	return rec;
+}
+
+static void recording_write(struct recording *rec, struct engines *engines)
+{
+	bool keyframe = !(rec->count++ % RECORDING_KEYFRAME);
+	uint32_t delta[rec->words];
+	unsigned int i;
+
+	for (i = 0; i < rec->words && !keyframe; i++) {
+		uint64_t d = engines->sample[i] - rec->prev[i];
+
+		if (engines->sample[i] < rec->prev[i] || d > UINT32_MAX)
+			keyframe = true;
+		else
+			delta[i] = d;
+	}
+
+	if (keyframe) {
+		write_u32(rec->file, RECORD_KEYFRAME);
+		fwrite(engines->sample, sizeof(*engines->sample), rec->words,
+		       rec->file);
+	} else {
+		write_u32(rec->file, RECORD_DELTA);
+		fwrite(delta, sizeof(*delta), rec->words, rec->file);
+	}
+
+	memcpy(rec->prev, engines->sample, rec->words * sizeof(*rec->prev));
+}
+
+static void recording_close(struct recording *rec)
+{
+	if (!rec)
+		return;
+
+	fclose(rec->file);
+	free(rec->prev);
+	free(rec);
+}
+
+static struct engines *
+replay_open(const char *path, struct recording **replay,
+	    char *card, size_t card_size, char **codename,
+	    unsigned int *period_us)
+{
+	uint32_t num_engines, val[6];
+	char magic[sizeof(RECORDING_MAGIC) - 1];
+	struct engines *engines = NULL;
+	struct recording *rec;
+	char *str;
+	unsigned int i;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (!f)
+		return NULL;
+
+	if (fread(magic, 1, sizeof(magic), f) != sizeof(magic) ||
+	    memcmp(magic, RECORDING_MAGIC, sizeof(magic)))
+		goto err;
+
+	for (i = 0; i < ARRAY_SIZE(val); i++)
+		if (!read_u32(f, &val[i]))
+			goto err;
+
+	if (val[4] > MAX_GTS)
+		goto err;
+
+	str = read_str(f);
+	if (!str)
+		goto err;
+	snprintf(card, card_size, "%s", str);
+	free(str);
+
+	*codename = read_str(f);
+	if (!*codename || !read_u32(f, &num_engines) || num_engines > 256)
+		goto err;
+
+	engines = calloc(1, sizeof(*engines) +
+			    num_engines * sizeof(struct engine));
+	assert(engines);
+
+	*period_us = val[0];
+	engines->num_counters = val[1];
+	engines->num_rapl = val[2];
+	engines->num_imc = val[3];
+	engines->num_gts = val[4];
+	engines->discrete = val[5];
+	engines->fd = engines->rapl_fd = engines->imc_fd = -1;
+
+	for (i = 0; i < num_engines; i++) {
+		struct engine *engine = engine_ptr(engines, i);
+		uint32_t class, instance, num_counters;
+
+		engine->name = read_str(f);
+		if (!engine->name ||
+		    !read_u32(f, &class) || !read_u32(f, &instance) ||
+		    !read_u32(f, &num_counters) || class > UINT8_MAX)
+			goto err;
+
+		engine->class = class;
+		engine->instance = instance;
+		engine->num_counters = num_counters;
+
+		if (asprintf(&engine->display_name, "%s/%u",
+			     class_display_name(class), instance) <= 0 ||
+		    asprintf(&engine->short_name, "%s/%u",
+			     class_short_name(class), instance) <= 0)
+			goto err;
+
+		engines->num_engines++;
+	}
+
+	for_each_pmu_counter(engines, read_counter, f);
+	if (feof(f) || ferror(f))
+		goto err;
+
+	rec = calloc(1, sizeof(*rec));
+	assert(rec);
+	rec->file = f;
+	rec->words = sample_words(engines);
+	rec->prev = calloc(rec->words, sizeof(*rec->prev));
+	assert(rec->prev);
+	*replay = rec;
+
+	return engines;
+
+err:
+	if (engines)
+		free_engines(engines);
+	fclose(f);
+	errno = EINVAL;
+
+	return NULL;
+}
+
+/* Feeds the next recorded sample to the counters, false at the end. */
+static bool replay_next(struct recording *rec, struct engines *engines)
+{
+	uint64_t sample[rec->words];
+	uint32_t delta[rec->words];
+	unsigned int i;
+	uint32_t type;
+
+	if (!read_u32(rec->file, &type))
+		return false;
+
+	if (type == RECORD_KEYFRAME) {
+		if (fread(sample, sizeof(*sample), rec->words,
+			  rec->file) != rec->words)
+			return false;
+	} else if (type == RECORD_DELTA) {
+		if (fread(delta, sizeof(*delta), rec->words,
+			  rec->file) != rec->words)
+			return false;
+
+		for (i = 0; i < rec->words; i++)
+			sample[i] = rec->prev[i] + delta[i];
+	} else {
+		return false;
+	}
+
+	memcpy(rec->prev, sample, sizeof(sample));
+	pmu_update(engines, sample);
+
+	return true;
+}
+
 static int
 __client_id_cmp(const struct igt_drm_client *a,
 		const struct igt_drm_client *b)
@@ -844,9 +1438,27 @@ static int client_pid_cmp(const void *_a, const void *_b, void *unused)
 		return 1;
 }
 
+static int client_cgroup_cmp(const void *_a, const void *_b, void *unused)
+{
+	const struct igt_drm_client *a = _a;
+	const struct igt_drm_client *b = _b;
+	int cmp = strcmp(a->cgroup, b->cgroup);
+
+	if (cmp)
+		return cmp;
+	else
+		return __client_id_cmp(a, b);
+}
+
 static int (*client_cmp)(const void *, const void *, void *) = client_last_cmp;
 
 static bool aggregate_pids = true;
+static bool aggregate_cgroups;
+
+static const char *client_name(const struct igt_drm_client *c)
+{
+	return aggregate_cgroups ? c->cgroup : c->print_name;
+}
 
 static struct igt_drm_clients *display_clients(struct igt_drm_clients *clients)
 {
@@ -857,11 +1469,16 @@ static struct igt_drm_clients *display_clients(struct igt_drm_clients *clients)
 	if (!clients)
 		return NULL;
 
-	if (!aggregate_pids)
+	if (!aggregate_pids && !aggregate_cgroups)
 		goto out;
 
-	/* Sort by pid first to make it easy to aggregate while walking. */
-	igt_drm_clients_sort(clients, client_pid_cmp);
+	/*
+	 * Sort by pid or cgroup first to make it easy to aggregate while
+	 * walking. Only the deltas already collected by the last scan are
+	 * summed up, nothing is read again.
+	 */
+	igt_drm_clients_sort(clients, aggregate_cgroups ?
+				      client_cgroup_cmp : client_pid_cmp);
 
 	aggregated = calloc(1, sizeof(*clients));
 	assert(aggregated);
@@ -881,17 +1498,22 @@ static struct igt_drm_clients *display_clients(struct igt_drm_clients *clients)
 
 		assert(c->status == IGT_DRM_CLIENT_ALIVE);
 
-		if (!cp || c->pid != cp->pid) {
+		if (!cp || (aggregate_cgroups ? strcmp(c->cgroup, cp->cgroup) :
+						c->pid != cp->pid)) {
 			ac = &aggregated->client[num++];
 
-			/* New pid. */
+			/* New pid or cgroup. */
 			ac->clients = aggregated;
 			ac->status = IGT_DRM_CLIENT_ALIVE;
-			ac->id = -c->pid;
+			ac->id = aggregate_cgroups ? -num : -c->pid;
 			ac->pid = c->pid;
 			strcpy(ac->name, c->name);
-			strcpy(ac->pid_str, c->pid_str);
+			if (aggregate_cgroups)
+				strcpy(ac->pid_str, "-");
+			else
+				strcpy(ac->pid_str, c->pid_str);
 			strcpy(ac->print_name, c->print_name);
+			ac->cgroup = c->cgroup;
 			ac->engines = c->engines;
 			ac->utilization = calloc(c->engines->max_engine_id + 1,
 						 sizeof(*ac->utilization));
@@ -929,6 +1551,16 @@ static struct igt_drm_clients *display_clients(struct igt_drm_clients *clients)
 	aggregated->max_pid_len = clients->max_pid_len;
 	aggregated->max_name_len = clients->max_name_len;
 
+	if (aggregate_cgroups) {
+		aggregated->max_name_len = 0;
+		igt_for_each_drm_client(aggregated, ac, tmp) {
+			int len = strlen(ac->cgroup);
+
+			if (len > aggregated->max_name_len)
+				aggregated->max_name_len = len;
+		}
+	}
+
 	clients = aggregated;
 
 out:
@@ -1032,6 +1664,7 @@ print_percentage_bar(double percent, double max, int max_len, bool numeric)
 }
 
 #define DEFAULT_PERIOD_MS (1000)
+#define MAX_SAMPLE_HZ (10000)
 
 static void
 usage(const char *appname)
@@ -1047,12 +1680,18 @@ usage(const char *appname)
 		"\t[-l]            List plain text data.\n"
 		"\t[-o <file|->]   Output to specified file or '-' for standard out.\n"
 		"\t[-s <ms>]       Refresh period in milliseconds (default %ums).\n"
+		"\t[-S <Hz>]       Sample counters at 1-%u Hz and report peaks.\n"
+		"\t[-w <file>]     Record counters to a binary file.\n"
+		"\t[-r <file>]     Replay a recording instead of sampling the GPU.\n"
+		"\t[-R <n>[-<m>]]  Only replay intervals n to m.\n"
+		"\t[-M <addr>]     Serve OpenMetrics over HTTP at [host:]port.\n"
 		"\t[-L]            List all cards.\n"
 		"\t[-d <device>]   Device filter, please check manual page for more details.\n"
 		"\t[-p]            Default to showing physical engines instead of classes.\n"
 		"\t[-m]            Default to showing all memory regions.\n"
+		"\t[-g]            Default to aggregating clients by cgroup.\n"
 		"\n",
-		appname, DEFAULT_PERIOD_MS);
+		appname, DEFAULT_PERIOD_MS, MAX_SAMPLE_HZ);
 	igt_device_print_filter_types();
 }
 
@@ -1060,7 +1699,8 @@ static enum {
 	INTERACTIVE,
 	TEXT,
 	CSV,
-	JSON
+	JSON,
+	OPENMETRICS
 } output_mode;
 
 struct cnt_item {
@@ -1072,11 +1712,25 @@ struct cnt_item {
 	double s;
 	const char *name;
 	const char *unit;
+	bool peak; /* Peak rate from high rate sampling instead of the average */
 
 	/* Internal fields. */
 	char buf[16];
 };
 
+static double item_value(struct cnt_item *item)
+{
+	if (item->peak)
+		return pmu_calc_peak(item->pmu, item->d, item->s);
+
+	return pmu_calc(&item->pmu->val, item->d, item->t, item->s);
+}
+
+static bool item_skipped(const struct cnt_item *item)
+{
+	return item->peak && !sample_hz;
+}
+
 struct cnt_group {
 	const char *name;
 	const char *display_name;
@@ -1136,9 +1790,17 @@ __json_add_member(const char *key, const char *val)
 {
 	assert(json_indent_level < ARRAY_SIZE(json_indent));
 
-	fprintf(out, "%s%s\"%s\": \"%s\"",
+	fprintf(out, "%s%s\"%s\": \"",
 		json_struct_members ? ",\n" : "",
-		json_indent[json_indent_level], key, val);
+		json_indent[json_indent_level], key);
+
+	/* Process names and cgroup paths can contain either. */
+	for (; *val; val++) {
+		if (*val == '"' || *val == '\\')
+			fputc('\\', out);
+		fputc(*val, out);
+	}
+	fputc('"', out);
 
 	json_struct_members++;
 }
@@ -1158,8 +1820,7 @@ json_add_member(const struct cnt_group *parent, struct cnt_item *item,
 	if (!strcmp(item->name, "unit"))
 		fprintf(out, "\"%s\"", item->unit);
 	else
-		fprintf(out, "%f",
-			pmu_calc(&item->pmu->val, item->d, item->t, item->s));
+		fprintf(out, "%f", item_value(item));
 
 	return 1;
 }
@@ -1208,7 +1869,7 @@ text_add_member(const struct cnt_group *parent, struct cnt_item *item,
 			return 0;
 
 		for (it = parent->items; it->pmu; it++) {
-			if (!it->pmu->present)
+			if (!it->pmu->present || item_skipped(it))
 				continue;
 
 			grp_tot += 1 + it->fmt_width +
@@ -1222,7 +1883,7 @@ text_add_member(const struct cnt_group *parent, struct cnt_item *item,
 		return 0;
 	}
 
-	val = pmu_calc(&item->pmu->val, item->d, item->t, item->s);
+	val = item_value(item);
 
 	len = snprintf(buf, sizeof(buf), "%*.*f",
 		       fmt_tot, item->fmt_precision, val);
@@ -1243,9 +1904,7 @@ csv_add_member(const struct cnt_group *parent, struct cnt_item *item,
 	if (headers)
 		fprintf(out, "%s %s", parent->display_name, item->unit);
 	else
-		len = fprintf(out, "%f",
-			      pmu_calc(&item->pmu->val, item->d, item->t,
-				       item->s));
+		len = fprintf(out, "%f", item_value(item));
 
 	return len > 0 ? len : 0;
 }
@@ -1278,7 +1937,7 @@ term_add_member(const struct cnt_group *parent, struct cnt_item *item,
 		return 1;
 	}
 
-	val = pmu_calc(&item->pmu->val, item->d, item->t, item->s);
+	val = item_value(item);
 	len = snprintf(item->buf, sizeof(item->buf),
 		       "%*.*f",
 		       fmt_tot, item->fmt_precision, val);
@@ -1325,8 +1984,10 @@ print_group(struct cnt_group *grp, unsigned int headers)
 
 	pops->open_struct(grp->name);
 
-	for (item = grp->items; item->name; item++)
-		consumed += pops->add_member(grp, item, headers);
+	for (item = grp->items; item->name; item++) {
+		if (!item_skipped(item))
+			consumed += pops->add_member(grp, item, headers);
+	}
 
 	pops->close_struct();
 
@@ -1358,7 +2019,7 @@ csv_print_group(struct cnt_group *grp, unsigned int headers)
 	text_open_struct(grp->name);
 
 	for (item = grp->items; item->name; item++) {
-		if (!item->pmu || !item->pmu->present)
+		if (!item->pmu || !item->pmu->present || item_skipped(item))
 			continue;
 
 		if (csv_count != prev_csv_count)
@@ -1381,8 +2042,10 @@ term_print_group(struct cnt_group *grp, unsigned int headers)
 
 	pops->open_struct(grp->name);
 
-	for (item = grp->items; item->name; item++)
-		consumed += pops->add_member(grp, item, headers);
+	for (item = grp->items; item->name; item++) {
+		if (!item_skipped(item))
+			consumed += pops->add_member(grp, item, headers);
+	}
 
 	pops->close_struct();
 
@@ -1499,6 +2162,7 @@ print_header(const struct igt_device_card *card,
 	struct cnt_item freq_items[] = {
 		{ &engines->freq_req, 4, 0, 1.0, t, 1, "requested", "req" },
 		{ &engines->freq_act, 4, 0, 1.0, t, 1, "actual", "act" },
+		{ &engines->freq_act, 4, 0, 1.0, t, 1, "actual-peak", "pk", true },
 		{ NULL, 0, 0, 0.0, 0.0, 0.0, "unit", "MHz" },
 		{ },
 	};
@@ -1574,6 +2238,8 @@ print_header(const struct igt_device_card *card,
 	struct cnt_item power_items[] = {
 		{ &engines->r_gpu, 4, 2, 1.0, t, engines->r_gpu.scale, "GPU", "gpu" },
 		{ &engines->r_pkg, 4, 2, 1.0, t, engines->r_pkg.scale, "Package", "pkg" },
+		{ &engines->r_gpu, 4, 2, 1.0, t, engines->r_gpu.scale, "GPU-peak", "gpk", true },
+		{ &engines->r_pkg, 4, 2, 1.0, t, engines->r_pkg.scale, "Package-peak", "ppk", true },
 		{ NULL, 0, 0, 0.0, 0.0, 0.0, "unit", "W" },
 		{ },
 	};
@@ -1701,6 +2367,10 @@ print_imc(struct engines *engines, double t, int lines, int con_w, int con_h)
 		  "reads", "rd" },
 		{ &engines->imc_writes, 6, 0, 1.0, t, engines->imc_writes.scale,
 		  "writes", "wr" },
+		{ &engines->imc_reads, 6, 0, 1.0, t, engines->imc_reads.scale,
+		  "reads-peak", "rpk", true },
+		{ &engines->imc_writes, 6, 0, 1.0, t, engines->imc_writes.scale,
+		  "writes-peak", "wpk", true },
 		{ NULL, 0, 0, 0.0, 0.0, 0.0, "unit" },
 		{ },
 	};
@@ -1721,14 +2391,14 @@ print_imc(struct engines *engines, double t, int lines, int con_w, int con_h)
 			engines->imc_reads.units);
 	assert(ret >= 0);
 
-	ret = asprintf((char **)&imc_items[2].unit, "%s/s",
+	ret = asprintf((char **)&imc_items[4].unit, "%s/s",
 			engines->imc_reads.units);
 	assert(ret >= 0);
 
 	print_groups(groups);
 
 	free((void *)imc_group.display_name);
-	free((void *)imc_items[2].unit);
+	free((void *)imc_items[4].unit);
 
 	if (output_mode == INTERACTIVE) {
 		if (lines++ < con_h)
@@ -1790,6 +2460,7 @@ print_engine(struct engines *engines, unsigned int i, double t,
 		{ &engine->busy, 6, 2, 1e9, t, 100, "busy", "%" },
 		{ &engine->sema, 3, 0, 1e9, t, 100, "sema", "se" },
 		{ &engine->wait, 3, 0, 1e9, t, 100, "wait", "wa" },
+		{ &engine->busy, 6, 2, 1e9, t, 100, "busy-peak", "pk", true },
 		{ NULL, 0, 0, 0.0, 0.0, 0.0, "unit", "%" },
 		{ },
 	};
@@ -1984,6 +2655,7 @@ static struct engines *update_class_engines(struct engines *engines)
 		memset(&engine->busy.val, 0, sizeof(engine->busy.val));
 		memset(&engine->sema.val, 0, sizeof(engine->sema.val));
 		memset(&engine->wait.val, 0, sizeof(engine->wait.val));
+		engine->busy.peak = 0;
 
 		for (j = 0; j < engines->num_engines; j++) {
 			struct engine *e = engine_ptr(engines, j);
@@ -1992,12 +2664,15 @@ static struct engines *update_class_engines(struct engines *engines)
 				__pmu_sum(&engine->busy.val, &e->busy.val);
 				__pmu_sum(&engine->sema.val, &e->sema.val);
 				__pmu_sum(&engine->wait.val, &e->wait.val);
+				engine->busy.peak += e->busy.peak;
 			}
 		}
 
 		__pmu_normalize(&engine->busy.val, num_engines);
 		__pmu_normalize(&engine->sema.val, num_engines);
 		__pmu_normalize(&engine->wait.val, num_engines);
+		/* Upper bound, the engines need not peak at the same time */
+		engine->busy.peak /= num_engines;
 	}
 
 	return classes;
@@ -2177,7 +2852,7 @@ print_client(struct igt_drm_client *c, struct engines *engines, double t, int li
 			len += *class_w;
 		}
 
-		printf(" %-*s\n", con_w - len - 1, c->print_name);
+		printf(" %-*s\n", con_w - len - 1, client_name(c));
 	} else if (output_mode == JSON) {
 		char buf[64];
 
@@ -2189,6 +2864,8 @@ print_client(struct igt_drm_client *c, struct engines *engines, double t, int li
 		snprintf(buf, sizeof(buf), "%u", c->pid);
 		__json_add_member("pid", buf);
 
+		__json_add_member("cgroup", c->cgroup);
+
 		if (iclients->regions) {
 			pops->open_struct("memory");
 
@@ -2270,6 +2947,255 @@ print_clients_footer(struct igt_drm_clients *clients, double t,
 	return lines;
 }
 
+static void
+openmetrics_engines(struct igt_openmetrics *om, struct engines *engines,
+		    double t)
+{
+	static const struct {
+		const char *name;
+		const char *help;
+		size_t offset;
+	} fams[] = {
+		{ "intel_gpu_engine_busy_ratio", "Engine busyness",
+		  offsetof(struct engine, busy) },
+		{ "intel_gpu_engine_wait_ratio", "Engine time spent waiting on MI_WAIT",
+		  offsetof(struct engine, wait) },
+		{ "intel_gpu_engine_sema_ratio", "Engine time spent waiting on MI_SEMAPHORE",
+		  offsetof(struct engine, sema) },
+	};
+	unsigned int i, j;
+
+	for (j = 0; j < ARRAY_SIZE(fams); j++) {
+		igt_openmetrics_family(om, fams[j].name, "gauge", fams[j].help);
+
+		for (i = 0; i < engines->num_engines; i++) {
+			struct engine *engine = engine_ptr(engines, i);
+			struct pmu_counter *pmu =
+				(void *)engine + fams[j].offset;
+			char instance[16];
+
+			if (!pmu->present)
+				continue;
+
+			snprintf(instance, sizeof(instance), "%u",
+				 engine->instance);
+			igt_openmetrics_sample(om, fams[j].name,
+					       pmu_calc(&pmu->val, 1e9, t, 100) / 100,
+					       "engine", engine->name,
+					       "class", class_display_name(engine->class),
+					       "instance", instance,
+					       NULL);
+		}
+	}
+}
+
+static void
+openmetrics_gt(struct igt_openmetrics *om, const char *name, const char *type,
+	       const char *help, struct pmu_counter *pmu, int num_gts,
+	       double d, double t, double s, double m)
+{
+	int i;
+
+	igt_openmetrics_family(om, name, type, help);
+
+	for (i = 0; i < num_gts; i++) {
+		char gt[16];
+
+		if (!pmu[i].present)
+			continue;
+
+		snprintf(gt, sizeof(gt), "%d", i);
+		igt_openmetrics_sample(om, name,
+				       pmu_calc(&pmu[i].val, d, t, s) * m,
+				       "gt", gt, NULL);
+	}
+}
+
+static double imc_bytes(const char *units)
+{
+	if (!strcmp(units, "B"))
+		return 1.0;
+	else if (!strcmp(units, "KiB"))
+		return 1024.0;
+	else if (!strcmp(units, "MiB"))
+		return 1024.0 * 1024.0;
+	else if (!strcmp(units, "GiB"))
+		return 1024.0 * 1024.0 * 1024.0;
+	else
+		return 0.0;
+}
+
+static void
+openmetrics_clients(struct igt_openmetrics *om, struct intel_clients *iclients,
+		    unsigned int period_us)
+{
+	static const struct {
+		const char *name;
+		const char *help;
+		size_t offset;
+	} fams[] = {
+		{ "intel_gpu_client_memory_total_bytes",
+		  "Memory allocated by the client",
+		  offsetof(struct drm_client_meminfo, total) },
+		{ "intel_gpu_client_memory_shared_bytes",
+		  "Memory shared by the client with others",
+		  offsetof(struct drm_client_meminfo, shared) },
+		{ "intel_gpu_client_memory_resident_bytes",
+		  "Client memory resident in the region",
+		  offsetof(struct drm_client_meminfo, resident) },
+		{ "intel_gpu_client_memory_purgeable_bytes",
+		  "Client memory the kernel may reclaim",
+		  offsetof(struct drm_client_meminfo, purgeable) },
+		{ "intel_gpu_client_memory_active_bytes",
+		  "Client memory in use by the GPU",
+		  offsetof(struct drm_client_meminfo, active) },
+	};
+	struct igt_drm_clients *clients = iclients->clients;
+	struct igt_drm_client *c;
+	unsigned int i, j;
+	int tmp;
+
+	igt_openmetrics_family(om, "intel_gpu_client_engine_busy_ratio", "gauge",
+			       "Client busyness of the engine class capacity");
+
+	igt_for_each_drm_client(clients, c, tmp) {
+		char id[24], pid[16];
+
+		if (c->status != IGT_DRM_CLIENT_ALIVE)
+			break; /* Active clients are first in the array. */
+
+		if (c->samples < 2)
+			continue;
+
+		snprintf(id, sizeof(id), "%lu", c->id);
+		snprintf(pid, sizeof(pid), "%u", c->pid);
+
+		for (i = 0; i <= iclients->classes.max_engine_id; i++) {
+			double v;
+
+			if (!iclients->classes.capacity[i])
+				continue;
+
+			/* Same time-drift guard as the interactive view. */
+			v = (double)c->utilization[i].delta_engine_time /
+			    period_us / 1e3 / iclients->classes.capacity[i];
+			if (v > 1.0)
+				v = 1.0;
+
+			igt_openmetrics_sample(om,
+					       "intel_gpu_client_engine_busy_ratio",
+					       v,
+					       "id", id, "pid", pid,
+					       "name", c->print_name,
+					       "cgroup", c->cgroup,
+					       "class", iclients->classes.names[i],
+					       NULL);
+		}
+	}
+
+	if (!iclients->regions)
+		return;
+
+	for (j = 0; j < ARRAY_SIZE(fams); j++) {
+		igt_openmetrics_family(om, fams[j].name, "gauge", fams[j].help);
+
+		igt_for_each_drm_client(clients, c, tmp) {
+			char id[24], pid[16];
+
+			if (c->status != IGT_DRM_CLIENT_ALIVE)
+				break;
+
+			snprintf(id, sizeof(id), "%lu", c->id);
+			snprintf(pid, sizeof(pid), "%u", c->pid);
+
+			for (i = 0; i <= c->regions->max_region_id; i++) {
+				const uint64_t *sz = (void *)&c->memory[i] +
+						     fams[j].offset;
+
+				if (!c->regions->names[i])
+					continue;
+
+				igt_openmetrics_sample(om, fams[j].name, *sz,
+						       "id", id, "pid", pid,
+						       "name", c->print_name,
+						       "cgroup", c->cgroup,
+						       "region", c->regions->names[i],
+						       NULL);
+			}
+		}
+	}
+}
+
+/*
+ * Render all counters from the last period into a new snapshot. Scrapes are
+ * answered from it until the next period, so they never touch the PMU or
+ * rescan the clients.
+ */
+static void
+openmetrics_update(struct igt_openmetrics *om, struct engines *engines,
+		   struct intel_clients *iclients, double t,
+		   unsigned int scan_us)
+{
+	igt_openmetrics_begin(om);
+
+	openmetrics_engines(om, engines, t);
+
+	openmetrics_gt(om, "intel_gpu_frequency_requested_hertz", "gauge",
+		       "Requested GPU frequency", engines->freq_req_gt,
+		       engines->num_gts, 1.0, t, 1, 1e6);
+	openmetrics_gt(om, "intel_gpu_frequency_actual_hertz", "gauge",
+		       "Actual GPU frequency", engines->freq_act_gt,
+		       engines->num_gts, 1.0, t, 1, 1e6);
+	openmetrics_gt(om, "intel_gpu_rc6_ratio", "gauge",
+		       "Time spent in RC6", engines->rc6_gt,
+		       engines->num_gts, 1e9, t, 100, 1e-2);
+
+	if (engines->irq.present) {
+		igt_openmetrics_family(om, "intel_gpu_interrupts_per_second",
+				       "gauge", "GPU interrupt rate");
+		igt_openmetrics_sample(om, "intel_gpu_interrupts_per_second",
+				       pmu_calc(&engines->irq.val, 1.0, t, 1),
+				       NULL);
+	}
+
+	if (engines->r_gpu.present || engines->r_pkg.present) {
+		igt_openmetrics_family(om, "intel_gpu_power_watts", "gauge",
+				       "Power consumption");
+		if (engines->r_gpu.present)
+			igt_openmetrics_sample(om, "intel_gpu_power_watts",
+					       pmu_calc(&engines->r_gpu.val, 1.0, t,
+							engines->r_gpu.scale),
+					       "domain", "gpu", NULL);
+		if (engines->r_pkg.present)
+			igt_openmetrics_sample(om, "intel_gpu_power_watts",
+					       pmu_calc(&engines->r_pkg.val, 1.0, t,
+							engines->r_pkg.scale),
+					       "domain", "package", NULL);
+	}
+
+	if (engines->num_imc && imc_bytes(engines->imc_reads.units)) {
+		double b = imc_bytes(engines->imc_reads.units);
+
+		igt_openmetrics_family(om, "intel_gpu_imc_bytes_per_second",
+				       "gauge", "Memory controller bandwidth");
+		if (engines->imc_reads.present)
+			igt_openmetrics_sample(om, "intel_gpu_imc_bytes_per_second",
+					       pmu_calc(&engines->imc_reads.val, 1.0, t,
+							engines->imc_reads.scale) * b,
+					       "direction", "reads", NULL);
+		if (engines->imc_writes.present)
+			igt_openmetrics_sample(om, "intel_gpu_imc_bytes_per_second",
+					       pmu_calc(&engines->imc_writes.val, 1.0, t,
+							engines->imc_writes.scale) * b,
+					       "direction", "writes", NULL);
+	}
+
+	if (iclients->clients)
+		openmetrics_clients(om, iclients, scan_us);
+
+	igt_openmetrics_commit(om);
+}
+
 static void restore_term(void)
 {
 	tcsetattr(STDIN_FILENO, TCSANOW, &termios_orig);
@@ -2354,8 +3280,9 @@ bump:
 	client_cmp = cmp[client_sort].cmp;
 	header_msg = cmp[client_sort].msg;
 
-	/* Sort by client id makes no sense with pid aggregation. */
-	if (aggregate_pids && client_cmp == client_id_cmp)
+	/* Sort by client id makes no sense with pid or cgroup aggregation. */
+	if ((aggregate_pids || aggregate_cgroups) &&
+	    client_cmp == client_id_cmp)
 		goto bump;
 }
 
@@ -2424,6 +3351,15 @@ static void process_normal_stdin(void)
 			else
 				header_msg = "Showing individual clients.";
 			break;
+		case 'G':
+			aggregate_cgroups ^= true;
+			if (aggregate_cgroups)
+				header_msg = "Aggregating clients by cgroup.";
+			else if (aggregate_pids)
+				header_msg = "Aggregating clients.";
+			else
+				header_msg = "Showing individual clients.";
+			break;
 		case 'm':
 			aggregate_regions ^= true;
 			if (aggregate_regions)
@@ -2479,6 +3415,7 @@ static void show_help_screen(void)
 "    's'    Toggle between sort modes (runtime, total runtime, pid, client id).\n"
 "    'i'    Toggle display of clients which used no GPU time.\n"
 "    'H'    Toggle between per PID aggregation and individual clients.\n"
+"    'G'    Toggle aggregation of clients by cgroup.\n"
 "    'm'    Toggle between aggregated memory regions and full breakdown.\n"
 "\n"
 "    'h' or 'q'    Exit interactive help.\n"
@@ -2608,19 +3545,25 @@ int main(int argc, char **argv)
 	unsigned int period_us = DEFAULT_PERIOD_MS * 1000;
 	bool physical_engines = false;
 	bool separate_regions = false;
-	struct intel_clients iclients;
+	struct recording *recording = NULL, *replay = NULL;
+	char *record_path = NULL, *replay_path = NULL;
+	unsigned long first = 0, last = ULONG_MAX, n;
+	struct intel_clients iclients = { };
+	struct sampler *sampler = NULL;
+	struct igt_openmetrics *om = NULL;
+	char *metrics_address = NULL;
 	int con_w = -1, con_h = -1;
 	char *output_path = NULL;
 	struct engines *engines;
 	int ret = 0, ch;
 	bool list_device = false;
 	char *pmu_device, *opt_device = NULL;
-	struct igt_device_card card;
+	struct igt_device_card card = { };
 	char *codename = NULL;
 	struct timespec ts;
 
 	/* Parse options */
-	while ((ch = getopt(argc, argv, "o:s:d:mpcJLlh")) != -1) {
+	while ((ch = getopt(argc, argv, "o:s:S:w:r:R:M:d:mpgcJLlh")) != -1) {
 		switch (ch) {
 		case 'o':
 			output_path = optarg;
@@ -2628,6 +3571,34 @@ int main(int argc, char **argv)
 		case 's':
 			period_us = atoi(optarg) * 1000;
 			break;
+		case 'S':
+			sample_hz = atoi(optarg);
+			if (!sample_hz || sample_hz > MAX_SAMPLE_HZ) {
+				fprintf(stderr, "Invalid sampling rate %s!\n",
+					optarg);
+				usage(argv[0]);
+				exit(1);
+			}
+			break;
+		case 'w':
+			record_path = optarg;
+			break;
+		case 'r':
+			replay_path = optarg;
+			break;
+		case 'R':
+			if (sscanf(optarg, "%lu-%lu", &first, &last) < 1 ||
+			    last < first) {
+				fprintf(stderr, "Invalid interval range %s!\n",
+					optarg);
+				usage(argv[0]);
+				exit(1);
+			}
+			break;
+		case 'M':
+			output_mode = OPENMETRICS;
+			metrics_address = optarg;
+			break;
 		case 'd':
 			opt_device = strdup(optarg);
 			break;
@@ -2637,6 +3608,9 @@ int main(int argc, char **argv)
 		case 'm':
 			separate_regions = true;
 			break;
+		case 'g':
+			aggregate_cgroups = true;
+			break;
 		case 'c':
 			output_mode = CSV;
 			break;
@@ -2676,6 +3650,15 @@ int main(int argc, char **argv)
 
 	text_header_repeat = output_mode == TEXT && isatty(fileno(out));
 
+	if (output_mode == OPENMETRICS) {
+		om = igt_openmetrics_listen(metrics_address);
+		if (!om) {
+			fprintf(stderr, "Failed to listen on %s! (%s)\n",
+				metrics_address, strerror(errno));
+			exit(1);
+		}
+	}
+
 	if (signal(SIGINT, sigint_handler) == SIG_ERR)
 		fprintf(stderr, "Failed to install signal handler!\n");
 
@@ -2696,11 +3679,29 @@ int main(int argc, char **argv)
 	case JSON:
 		pops = &json_pops;
 		break;
+	case OPENMETRICS:
+		break; /* Nothing is printed, see openmetrics_update(). */
 	default:
 		assert(0);
 		break;
 	};
 
+	if (replay_path) {
+		engines = replay_open(replay_path, &replay,
+				      card.card, sizeof(card.card),
+				      &codename, &period_us);
+		if (!engines) {
+			fprintf(stderr, "Failed to open recording %s! (%s)\n",
+				replay_path, strerror(errno));
+			ret = EXIT_FAILURE;
+			goto exit;
+		}
+
+		pmu_device = NULL;
+		sample_hz = 0;
+		goto start;
+	}
+
 	igt_devices_scan();
 
 	if (list_device) {
@@ -2764,17 +3765,47 @@ int main(int argc, char **argv)
 		goto err_pmu;
 	}
 
+start:
 	ret = EXIT_SUCCESS;
 
 	init_engine_classes(engines);
 
-	if (has_drm_fdinfo(&card))
+	if (!replay && has_drm_fdinfo(&card))
 		intel_init_clients(&iclients, &card, engines);
 
-	pmu_sample(engines);
+	if (replay) {
+		/* The first record is the baseline for interval 0 */
+		for (n = 0; n <= first; n++) {
+			if (!replay_next(replay, engines)) {
+				stop_top = true;
+				break;
+			}
+		}
+		n = first;
+	} else {
+		pmu_sample(engines);
+	}
 	intel_scan_clients(&iclients);
 	gettime(&ts);
 
+	if (record_path && !replay) {
+		recording = recording_create(record_path, engines, card.card,
+					     codename, period_us);
+		if (!recording)
+			fprintf(stderr, "Failed to open recording %s! (%s)\n",
+				record_path, strerror(errno));
+		else
+			recording_write(recording, engines);
+	}
+
+	if (sample_hz) {
+		sampler = sampler_start(engines, sample_hz, period_us);
+		if (!sampler) {
+			fprintf(stderr, "Failed to start the sampling thread!\n");
+			sample_hz = 0;
+		}
+	}
+
 	if (output_mode == JSON)
 		printf("[\n");
 
@@ -2800,9 +3831,19 @@ int main(int argc, char **argv)
 			}
 		}
 
-		pmu_sample(engines);
+		if (replay) {
+			if (n++ > last || !replay_next(replay, engines))
+				break;
+		} else if (sampler) {
+			sampler_consume(sampler);
+		} else {
+			pmu_sample(engines);
+		}
 		t = (double)(engines->ts.cur - engines->ts.prev) / 1e9;
 
+		if (recording)
+			recording_write(recording, engines);
+
 		intel_scan_clients(&iclients);
 		disp_clients = display_clients(iclients.clients);
 		scan_us = elapsed_us(&ts, period_us);
@@ -2810,6 +3851,11 @@ int main(int argc, char **argv)
 		if (stop_top)
 			break;
 
+		if (om) {
+			openmetrics_update(om, engines, &iclients, t, scan_us);
+			consumed = true;
+		}
+
 		while (!consumed) {
 			pops->open_struct(NULL);
 
@@ -2863,13 +3909,18 @@ int main(int argc, char **argv)
 
 		if (output_mode == INTERACTIVE)
 			process_stdin(period_us);
-		else
+		else if (om)
+			igt_openmetrics_serve(om, period_us);
+		else if (!replay)
 			usleep(period_us);
 	}
 
 	if (output_mode == JSON)
 		printf("]\n");
 
+	sampler_stop(sampler);
+	recording_close(recording);
+	recording_close(replay);
 	intel_free_clients(&iclients);
 
 	free(codename);
@@ -2878,6 +3929,8 @@ err_pmu:
 err_engines:
 	free(pmu_device);
 exit:
-	igt_devices_free();
+	igt_openmetrics_close(om);
+	if (!replay_path)
+		igt_devices_free(); /* Devices are not scanned for replay */
 	return ret;
 }
@@ -39,6 +39,7 @@
 #include <sys/mman.h>
 #include <assert.h>
 #include <pthread.h>
+#include <zlib.h>
 
 #include "igt.h"
 
@@ -59,6 +60,8 @@
 #define RELAY_FILE_NAME  "guc_log"
 #define DEFAULT_OUTPUT_FILE_NAME  "guc_log_dump.dat"
 #define CONTROL_FILE_NAME "i915_guc_log_control"
+/* Output buffer of the compression, flushed to the file whenever full */
+#define ZBUF_SIZE (256 * 1024)
 
 char *read_buffer;
 char *out_filename;
@@ -67,12 +70,24 @@ pthread_mutex_t mutex;
 pthread_t flush_thread;
 int verbosity_level = 3; /* by default capture logs at max verbosity */
 uint32_t produced, consumed;
-uint64_t total_bytes_written;
+uint64_t total_bytes_written, total_bytes_captured;
 int num_buffers = NUM_SUBBUFS;
 int relay_fd, outfile_fd = -1;
 uint32_t test_duration, max_filesize;
 pthread_cond_t underflow_cond, overflow_cond;
 bool stop_logging, discard_oldlogs, capturing_stopped;
+bool use_splice, compress_logs;
+int pipe_fds[2] = { -1, -1 };
+uint32_t overflows, empty_reads;
+z_stream zstream;
+char *zbuf;
+
+/* Sub-buffers i915 couldn't pass to relay and GuC log buffer overflows */
+struct guc_log_stats {
+	bool valid;
+	unsigned long relay_full;
+	unsigned long guc_overflows;
+};
 
 static void guc_log_control(bool enable, uint32_t log_level)
 {
@@ -105,6 +120,122 @@ static void guc_log_control(bool enable, uint32_t log_level)
 	close(control_fd);
 }
 
+/*
+ * Reads the GuC log statistics of i915, which counts the logs lost when
+ * the logger doesn't keep up: the relay sub-buffers found full and the
+ * overflows of the GuC log buffer.
+ */
+static void read_guc_log_stats(struct guc_log_stats *stats)
+{
+	static const char * const files[] = {
+		"gt/uc/guc_info", "gt0/uc/guc_info", "i915_guc_info",
+	};
+	static char buf[64 * 1024];
+	const char *full = "Relay full count:";
+	const char *overflow = "overflow count";
+	char *str;
+	int dir;
+
+	stats->valid = false;
+
+	dir = igt_debugfs_dir(-1);
+	if (dir < 0)
+		return;
+
+	for (int i = 0; i < ARRAY_SIZE(files); i++) {
+		if (igt_debugfs_simple_read(dir, files[i], buf, sizeof(buf)) <= 0)
+			continue;
+
+		str = strstr(buf, full);
+		if (!str)
+			continue;
+
+		stats->relay_full = strtoul(str + strlen(full), NULL, 10);
+		stats->guc_overflows = 0;
+		for (str = buf; (str = strstr(str, overflow)); )
+			stats->guc_overflows += strtoul(str + strlen(overflow),
+							&str, 10);
+		stats->valid = true;
+		break;
+	}
+
+	close(dir);
+}
+
+/* Accounts for the bytes written to the output file */
+static void output_written(size_t len)
+{
+	total_bytes_written += len;
+	if (max_filesize && (total_bytes_written > MB(max_filesize))) {
+		igt_debug("reached the target of %" PRIu64 " bytes\n", MB(max_filesize));
+		stop_logging = true;
+	}
+}
+
+static void write_out(const void *data, size_t len)
+{
+	ssize_t ret;
+
+	ret = write(outfile_fd, data, len);
+	igt_assert_f(ret == len, "couldn't dump the logs in a file\n");
+
+	output_written(len);
+}
+
+static void deflate_out(int flush)
+{
+	int ret;
+
+	do {
+		zstream.next_out = (Bytef *)zbuf;
+		zstream.avail_out = ZBUF_SIZE;
+
+		ret = deflate(&zstream, flush);
+		igt_assert_f(ret != Z_STREAM_ERROR, "failed to compress the logs\n");
+
+		if (zstream.avail_out != ZBUF_SIZE)
+			write_out(zbuf, ZBUF_SIZE - zstream.avail_out);
+	} while (!zstream.avail_out);
+}
+
+/* Writes the logs out, compressing them first with -z */
+static void write_logs(const void *data, size_t len)
+{
+	total_bytes_captured += len;
+
+	if (!compress_logs) {
+		write_out(data, len);
+		return;
+	}
+
+	zstream.next_in = (Bytef *)data;
+	zstream.avail_in = len;
+	deflate_out(Z_NO_FLUSH);
+}
+
+static void init_compression(void)
+{
+	int ret;
+
+	zbuf = malloc(ZBUF_SIZE);
+	igt_assert_f(zbuf, "couldn't allocate the compression buffer\n");
+
+	/* gzip wrapped at the fastest level, so the flusher keeps up */
+	ret = deflateInit2(&zstream, Z_BEST_SPEED, Z_DEFLATED, 15 + 16, 8,
+			   Z_DEFAULT_STRATEGY);
+	igt_assert_f(ret == Z_OK, "couldn't initialize the compression\n");
+}
+
+static void finish_compression(void)
+{
+	zstream.next_in = NULL;
+	zstream.avail_in = 0;
+	deflate_out(Z_FINISH);
+
+	deflateEnd(&zstream);
+	free(zbuf);
+}
+
 static void int_sig_handler(int sig)
 {
 	igt_info("received signal %d\n", sig);
@@ -128,11 +259,8 @@ static void pull_leftover_data(void)
 
 		bytes_read += ret;
 
-		if (outfile_fd >= 0) {
-			ret = write(outfile_fd, read_buffer, SUBBUF_SIZE);
-			igt_assert_f(ret == SUBBUF_SIZE, "couldn't dump the logs in a file\n");
-			total_bytes_written += ret;
-		}
+		if (outfile_fd >= 0)
+			write_logs(read_buffer, SUBBUF_SIZE);
 	} while(1);
 
 	igt_debug("%u bytes flushed\n", bytes_read);
@@ -149,6 +277,8 @@ static void pull_data(void)
 	int ret;
 
 	pthread_mutex_lock(&mutex);
+	if (num_filled_bufs() >= num_buffers)
+		overflows++;
 	while (num_filled_bufs() >= num_buffers) {
 		igt_debug("overflow, will wait, produced %u, consumed %u\n", produced, consumed);
 		/* Stall the main thread in case of overflow, as there are no
@@ -177,13 +307,42 @@ static void pull_data(void)
 		 * availability of data.
 		 */
 		igt_debug("no data read from the relay file\n");
+		empty_reads++;
+	}
+}
+
+/*
+ * With -S the sub-buffers are spliced from the relay file into a pipe, which
+ * takes the place of the local buffers, and from the pipe into the output
+ * file, so the logs are never copied through userspace. Only compressing
+ * them reads them back from the pipe.
+ */
+static void splice_data(void)
+{
+	ssize_t ret;
+
+	ret = splice(relay_fd, NULL, pipe_fds[1], NULL, SUBBUF_SIZE,
+		     SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+	if (ret < 0 && errno == EAGAIN) {
+		/* The pipe is full, stall as with the local buffers */
+		igt_debug("overflow, will wait for the flusher\n");
+		overflows++;
+		ret = splice(relay_fd, NULL, pipe_fds[1], NULL, SUBBUF_SIZE,
+			     SPLICE_F_MOVE);
+	}
+	if (ret < 0 && errno == EINTR)
+		return;
+	igt_assert_f(ret >= 0, "failed to splice from the guc log file\n");
+
+	if (!ret) {
+		igt_debug("no data spliced from the relay file\n");
+		empty_reads++;
 	}
 }
 
 static void *flusher(void *arg)
 {
 	char *ptr;
-	int ret;
 
 	igt_debug("execution started of flusher thread\n");
 
@@ -206,14 +365,7 @@ static void *flusher(void *arg)
 
 		ptr = read_buffer + (consumed % num_buffers) * SUBBUF_SIZE;
 
-		ret = write(outfile_fd, ptr, SUBBUF_SIZE);
-		igt_assert_f(ret == SUBBUF_SIZE, "couldn't dump the logs in a file\n");
-
-		total_bytes_written += ret;
-		if (max_filesize && (total_bytes_written > MB(max_filesize))) {
-			igt_debug("reached the target of %" PRIu64 " bytes\n", MB(max_filesize));
-			stop_logging = true;
-		}
+		write_logs(ptr, SUBBUF_SIZE);
 
 		pthread_mutex_lock(&mutex);
 		consumed++;
@@ -224,6 +376,35 @@ static void *flusher(void *arg)
 	return NULL;
 }
 
+/* Drains the pipe until the main thread closes it */
+static void *splice_flusher(void *arg)
+{
+	ssize_t ret;
+
+	igt_debug("execution started of splice flusher thread\n");
+
+	do {
+		if (compress_logs) {
+			ret = read(pipe_fds[0], read_buffer, SUBBUF_SIZE);
+			if (ret > 0)
+				write_logs(read_buffer, ret);
+		} else {
+			ret = splice(pipe_fds[0], NULL, outfile_fd, NULL,
+				     SUBBUF_SIZE, SPLICE_F_MOVE);
+			if (ret > 0) {
+				total_bytes_captured += ret;
+				output_written(ret);
+			}
+		}
+		igt_assert_f(ret >= 0 || errno == EINTR,
+			     "couldn't dump the logs in a file\n");
+	} while (ret);
+
+	igt_debug("splice flusher to exit now\n");
+
+	return NULL;
+}
+
 static void init_flusher_thread(void)
 {
 	struct sched_param	thread_sched;
@@ -251,7 +432,8 @@ static void init_flusher_thread(void)
 	ret = pthread_attr_setschedparam(&p_attr, &thread_sched);
 	igt_assert_f(ret == 0, "couldn't set thread priority\n");
 
-	ret = pthread_create(&flush_thread, &p_attr, flusher, NULL);
+	ret = pthread_create(&flush_thread, &p_attr,
+			     use_splice ? splice_flusher : flusher, NULL);
 	igt_assert_f(ret == 0, "thread creation failed\n");
 
 	ret = pthread_attr_destroy(&p_attr);
@@ -274,25 +456,54 @@ static void open_relay_file(void)
 		pull_leftover_data();
 }
 
+static void open_pipe(void)
+{
+	int ret;
+
+	ret = pipe(pipe_fds);
+	igt_assert_f(ret == 0, "couldn't create the pipe\n");
+
+	/* Size the pipe as the local buffers would have been */
+	ret = fcntl(pipe_fds[1], F_SETPIPE_SZ, num_buffers * SUBBUF_SIZE);
+	if (ret < 0)
+		ret = fcntl(pipe_fds[1], F_GETPIPE_SZ);
+	igt_assert_f(ret > 0, "couldn't size the pipe\n");
+
+	if (ret < num_buffers * SUBBUF_SIZE)
+		igt_info("pipe limited to %d buffers\n", ret / SUBBUF_SIZE);
+	num_buffers = ret / SUBBUF_SIZE;
+}
+
 static void open_output_file(void)
 {
+	int flags = O_CREAT | O_WRONLY | O_TRUNC;
+
 	/* Use Direct IO mode for the output file, as the data written is not
 	 * supposed to be accessed again, this saves a copy of data from App's
 	 * buffer to kernel buffer (Page cache). Due to no buffering on kernel
 	 * side, data is flushed out to disk faster and more buffering can be
 	 * done on the logger side to hide the disk IO latency.
+	 * The compressed data isn't written in aligned blocks and the spliced
+	 * pages already bypass the App's buffers, so both go through the page
+	 * cache.
 	 */
-	outfile_fd = open(out_filename ? : DEFAULT_OUTPUT_FILE_NAME,
-			  O_CREAT | O_WRONLY | O_TRUNC | O_DIRECT,
+	if (!use_splice && !compress_logs)
+		flags |= O_DIRECT;
+
+	outfile_fd = open(out_filename ? : DEFAULT_OUTPUT_FILE_NAME, flags,
 			  0440);
 	igt_assert_f(outfile_fd >= 0, "couldn't open the output file\n");
 
 	free(out_filename);
+
+	if (compress_logs)
+		init_compression();
 }
 
 static void init_main_thread(void)
 {
 	struct sched_param	thread_sched;
+	size_t bufsize;
 	int ret;
 
 	/* Run the main thread at highest priority to ensure that it always
@@ -310,12 +521,17 @@ static void init_main_thread(void)
 	if (signal(SIGALRM, int_sig_handler) == SIG_ERR)
 		igt_assert_f(0, "SIGALRM handler registration failed\n");
 
+	/* The pipe holds the logs when splicing, only read through one buffer */
+	if (use_splice)
+		open_pipe();
+	bufsize = (use_splice ? 1 : num_buffers) * SUBBUF_SIZE;
+
 	/* Need an aligned pointer for direct IO */
-	ret = posix_memalign((void **)&read_buffer, PAGE_SIZE, num_buffers * SUBBUF_SIZE);
+	ret = posix_memalign((void **)&read_buffer, PAGE_SIZE, bufsize);
 	igt_assert_f(ret == 0, "couldn't allocate the read buffer\n");
 
 	/* Keep the pages locked in RAM, avoid page fault overhead */
-	ret = mlock(read_buffer, num_buffers * SUBBUF_SIZE);
+	ret = mlock(read_buffer, bufsize);
 	igt_assert_f(ret == 0, "failed to lock memory\n");
 
 	/* Enable the logging, it may not have been enabled from boot and so
@@ -367,6 +583,14 @@ static int parse_options(int opt, int opt_index, void *data)
 		discard_oldlogs = true;
 		igt_debug("old/boot-time logs will be discarded\n");
 		break;
+	case 'S':
+		use_splice = true;
+		igt_debug("logs to be spliced to the output file\n");
+		break;
+	case 'z':
+		compress_logs = true;
+		igt_debug("logs to be compressed with gzip\n");
+		break;
 	}
 
 	return 0;
@@ -382,6 +606,8 @@ static void process_command_line(int argc, char **argv)
 		{"polltimeout", required_argument, 0, 'p'},
 		{"size", required_argument, 0, 's'},
 		{"discard", no_argument, 0, 'd'},
+		{"splice", no_argument, 0, 'S'},
+		{"compress", no_argument, 0, 'z'},
 		{ 0, 0, 0, 0 }
 	};
 
@@ -392,14 +618,17 @@ static void process_command_line(int argc, char **argv)
 		"  -t --testduration=sec  max duration in seconds for which the logger should run\n"
 		"  -p --polltimeout=ms    polling timeout in ms, -1 == indefinite wait for the new data\n"
 		"  -s --size=MB           max size of output file in MBs after which logging will be stopped\n"
-		"  -d --discard           discard the old/boot-time logs before entering into the capture loop\n";
+		"  -d --discard           discard the old/boot-time logs before entering into the capture loop\n"
+		"  -S --splice            splice the logs from the relay file to the output file without copying them\n"
+		"  -z --compress          compress the output file with gzip\n";
 
-	igt_simple_init_parse_opts(&argc, argv, "v:o:b:t:p:s:d", long_options,
+	igt_simple_init_parse_opts(&argc, argv, "v:o:b:t:p:s:dSz", long_options,
 				   help, parse_options, NULL);
 }
 
 int main(int argc, char **argv)
 {
+	struct guc_log_stats start, end;
 	struct pollfd relay_poll_fd;
 	int nfds;
 	int ret;
@@ -407,6 +636,7 @@ int main(int argc, char **argv)
 	process_command_line(argc, argv);
 
 	init_main_thread();
+	read_guc_log_stats(&start);
 
 	/* Use a separate thread for flushing the logs to a file on disk.
 	 * Main thread will buffer the data from relay file in its pool of
@@ -449,21 +679,44 @@ int main(int argc, char **argv)
 		if (!relay_poll_fd.revents)
 			continue;
 
-		pull_data();
+		if (use_splice)
+			splice_data();
+		else
+			pull_data();
 	} while (!stop_logging);
 
 	/* Pause logging on the GuC side */
 	guc_log_control(false, 0);
 
 	/* Signal flusher thread to make an exit */
-	capturing_stopped = 1;
-	pthread_cond_signal(&underflow_cond);
+	if (use_splice) {
+		close(pipe_fds[1]);
+	} else {
+		capturing_stopped = 1;
+		pthread_cond_signal(&underflow_cond);
+	}
 	pthread_join(flush_thread, NULL);
 
 	pull_leftover_data();
+	if (compress_logs)
+		finish_compression();
+
 	igt_info("total bytes written %" PRIu64 "\n", total_bytes_written);
+	if (compress_logs)
+		igt_info("compressed from %" PRIu64 " bytes of logs\n",
+			 total_bytes_captured);
+	igt_info("%u overflows of the logger buffers, %u empty reads\n",
+		 overflows, empty_reads);
+
+	read_guc_log_stats(&end);
+	if (start.valid && end.valid)
+		igt_info("%lu relay sub-buffers found full, %lu GuC log buffer overflows\n",
+			 end.relay_full - start.relay_full,
+			 end.guc_overflows - start.guc_overflows);
 
 	free(read_buffer);
+	if (use_splice)
+		close(pipe_fds[0]);
 	close(relay_fd);
 	close(outfile_fd);
 	igt_exit();
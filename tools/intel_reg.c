@@ -23,14 +23,23 @@
 
 #include <errno.h>
 #include <getopt.h>
+#include <inttypes.h>
 #include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <time.h>
 #include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
 
 #include "i915/gem_create.h"
 #include "igt.h"
@@ -84,6 +93,14 @@ struct config {
 	/* fd for engine access avoiding reopens */
 	int fd;
 
+	/* sample: period, run time (0 until interrupted), cpu and output */
+	uint64_t sample_period_us;
+	uint64_t sample_duration_s;
+	int sample_cpu;
+	bool sample_on_change;
+	bool sample_raw;
+	char *sample_output;
+
 	struct reg *regs;
 	ssize_t regcount;
 
@@ -842,6 +859,341 @@ static int intel_reg_read(struct config *config, int argc, char *argv[])
 	return EXIT_SUCCESS;
 }
 
+/*
+ * sample: the registers are read on a SCHED_FIFO thread pinned to a CPU,
+ * which pushes fixed size records to a ring drained and formatted by the
+ * main thread, so that slow output never delays a sample. Forcewake is
+ * taken once by intel_register_access_init() for the whole run.
+ */
+#define SAMPLE_RING_SIZE	(1 << 16)	/* records, power of two */
+#define SAMPLE_MAGIC		0x47455249	/* "IREG" */
+
+struct sample_reg {
+	uint32_t offset;
+	int width;
+	char *name;
+};
+
+struct sample_header {
+	uint32_t magic;
+	uint32_t nregs;
+	uint64_t period_ns;
+	uint64_t tsc_hz;
+	/* followed by nregs register offsets, then the records */
+};
+
+struct sampler {
+	struct sample_reg *regs;
+	unsigned int nregs;
+	size_t record_size;	/* tsc then the values, in 32b words */
+	uint64_t period_ns;
+	uint64_t duration_ns;
+	bool on_change;
+
+	uint32_t *ring;
+	_Atomic(uint64_t) head;
+	_Atomic(uint64_t) tail;
+	_Atomic(bool) done;
+	uint64_t samples;
+	uint64_t dropped;
+	uint64_t missed;
+};
+
+static volatile sig_atomic_t sample_stop;
+
+static void sample_sighandler(int sig)
+{
+	sample_stop = 1;
+}
+
+static uint64_t sample_tsc(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+	return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+#endif
+}
+
+static uint64_t sample_tsc_hz(void)
+{
+	struct timespec start, end;
+	uint64_t tsc, ns;
+
+	clock_gettime(CLOCK_MONOTONIC_RAW, &start);
+	tsc = sample_tsc();
+	usleep(10000);
+	clock_gettime(CLOCK_MONOTONIC_RAW, &end);
+	tsc = sample_tsc() - tsc;
+
+	ns = (end.tv_sec - start.tv_sec) * NSEC_PER_SEC +
+	     end.tv_nsec - start.tv_nsec;
+
+	return tsc * NSEC_PER_SEC / ns;
+}
+
+static uint32_t sample_read(const struct sample_reg *reg)
+{
+	switch (reg->width) {
+	case 8:
+		return INREG8(reg->offset);
+	case 16:
+		return INREG16(reg->offset);
+	default:
+		return INREG(reg->offset);
+	}
+}
+
+static void timespec_add_ns(struct timespec *ts, uint64_t ns)
+{
+	ns += ts->tv_nsec;
+	ts->tv_sec += ns / NSEC_PER_SEC;
+	ts->tv_nsec = ns % NSEC_PER_SEC;
+}
+
+static void *sample_thread(void *arg)
+{
+	struct sampler *s = arg;
+	uint32_t *prev = calloc(s->nregs, sizeof(*prev));
+	struct timespec next, now, end;
+	bool first = true;
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	end = next;
+	timespec_add_ns(&end, s->duration_ns);
+
+	while (!sample_stop) {
+		uint64_t head = atomic_load_explicit(&s->head, memory_order_relaxed);
+		uint64_t tail = atomic_load_explicit(&s->tail, memory_order_acquire);
+		uint32_t *rec = s->ring + (head & (SAMPLE_RING_SIZE - 1)) * s->record_size;
+		uint64_t tsc = sample_tsc();
+		bool changed = first;
+
+		for (unsigned int n = 0; n < s->nregs; n++) {
+			uint32_t val = sample_read(&s->regs[n]);
+
+			changed |= val != prev[n];
+			prev[n] = val;
+		}
+		first = false;
+		s->samples++;
+
+		if (changed || !s->on_change) {
+			if (head - tail == SAMPLE_RING_SIZE) {
+				s->dropped++;
+			} else {
+				memcpy(rec, &tsc, sizeof(tsc));
+				memcpy(rec + 2, prev, s->nregs * sizeof(*prev));
+				atomic_store_explicit(&s->head, head + 1,
+						      memory_order_release);
+			}
+		}
+
+		timespec_add_ns(&next, s->period_ns);
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		if (s->duration_ns && igt_time_elapsed(&end, &now) >= 0)
+			break;
+
+		/* Running late, skip the periods we missed rather than bursting */
+		while (igt_time_elapsed(&next, &now) > 0) {
+			timespec_add_ns(&next, s->period_ns);
+			s->missed++;
+		}
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+	}
+
+	free(prev);
+	atomic_store_explicit(&s->done, true, memory_order_release);
+	return NULL;
+}
+
+static void sample_write(struct sampler *s, FILE *out, const uint32_t *rec,
+			 bool csv)
+{
+	uint64_t tsc;
+
+	if (!csv) {
+		fwrite(rec, sizeof(*rec), s->record_size, out);
+		return;
+	}
+
+	memcpy(&tsc, rec, sizeof(tsc));
+	fprintf(out, "%"PRIu64, tsc);
+	for (unsigned int n = 0; n < s->nregs; n++)
+		fprintf(out, ",0x%08x", rec[2 + n]);
+	fputc('\n', out);
+}
+
+static int intel_reg_sample(struct config *config, int argc, char *argv[])
+{
+	bool csv = !config->sample_raw;
+	struct sampler s = {
+		.period_ns = config->sample_period_us * NSEC_PER_USEC,
+		.duration_ns = config->sample_duration_s * NSEC_PER_SEC,
+		.on_change = config->sample_on_change,
+	};
+	struct sched_param param = { .sched_priority = 99 };
+	struct sigaction sa = { .sa_handler = sample_sighandler };
+	uint64_t tsc_hz;
+	pthread_attr_t attr;
+	pthread_t thread;
+	cpu_set_t mask;
+	FILE *out;
+	int i, err;
+
+	if (argc == 1) {
+		fprintf(stderr, "sample: no registers specified\n");
+		return EXIT_FAILURE;
+	}
+
+	if (config->mmiofile) {
+		fprintf(stderr, "sample: --mmio=FILE is not supported\n");
+		return EXIT_FAILURE;
+	}
+
+	if (!s.period_ns) {
+		fprintf(stderr, "sample: invalid period\n");
+		return EXIT_FAILURE;
+	}
+
+	s.regs = calloc(argc - 1, sizeof(*s.regs));
+	for (i = 1; i < argc; i++) {
+		struct sample_reg *sr = &s.regs[s.nregs];
+		struct reg reg = {};
+
+		if (parse_reg(config, &reg, argv[i]))
+			continue;
+
+		if (!port_is_mmio(reg.port_desc.port) || reg.engine) {
+			fprintf(stderr, "sample: only cpu MMIO registers are supported, skipping '%s'\n",
+				argv[i]);
+			continue;
+		}
+
+		sr->offset = reg.mmio_offset + reg.addr;
+		switch (reg.port_desc.port) {
+		case PORT_MMIO_8:
+		case PORT_MCHBAR_8:
+			sr->width = 8;
+			break;
+		case PORT_MMIO_16:
+		case PORT_MCHBAR_16:
+			sr->width = 16;
+			break;
+		default:
+			sr->width = 32;
+			break;
+		}
+		sr->name = reg.name;
+		s.nregs++;
+	}
+
+	if (!s.nregs) {
+		free(s.regs);
+		return EXIT_FAILURE;
+	}
+
+	out = stdout;
+	if (config->sample_output) {
+		out = fopen(config->sample_output, csv ? "w" : "wb");
+		if (!out) {
+			fprintf(stderr, "sample: cannot open '%s': %s\n",
+				config->sample_output, strerror(errno));
+			return EXIT_FAILURE;
+		}
+	}
+
+	s.record_size = 2 + s.nregs;
+	s.ring = calloc(SAMPLE_RING_SIZE, s.record_size * sizeof(*s.ring));
+	igt_assert(s.ring);
+
+	tsc_hz = sample_tsc_hz();
+	if (csv) {
+		fprintf(out, "# tsc_hz=%"PRIu64" period_ns=%"PRIu64"\ntsc", tsc_hz,
+			s.period_ns);
+		for (i = 0; i < s.nregs; i++) {
+			if (s.regs[i].name)
+				fprintf(out, ",%s", s.regs[i].name);
+			else
+				fprintf(out, ",0x%x", s.regs[i].offset);
+		}
+		fputc('\n', out);
+	} else {
+		struct sample_header hdr = {
+			.magic = SAMPLE_MAGIC,
+			.nregs = s.nregs,
+			.period_ns = s.period_ns,
+			.tsc_hz = tsc_hz,
+		};
+
+		fwrite(&hdr, sizeof(hdr), 1, out);
+		for (i = 0; i < s.nregs; i++)
+			fwrite(&s.regs[i].offset, sizeof(uint32_t), 1, out);
+	}
+
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	intel_register_access_init(&config->mmio_data, config->pci_dev, 0);
+
+	CPU_ZERO(&mask);
+	CPU_SET(config->sample_cpu >= 0 ? config->sample_cpu : sched_getcpu(),
+		&mask);
+
+	pthread_attr_init(&attr);
+	pthread_attr_setaffinity_np(&attr, sizeof(mask), &mask);
+	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+	pthread_attr_setschedparam(&attr, &param);
+
+	err = pthread_create(&thread, &attr, sample_thread, &s);
+	if (err) {
+		fprintf(stderr, "sample: cannot create a SCHED_FIFO thread (%s), sampling without\n",
+			strerror(err));
+		pthread_attr_setinheritsched(&attr, PTHREAD_INHERIT_SCHED);
+		err = pthread_create(&thread, &attr, sample_thread, &s);
+	}
+	pthread_attr_destroy(&attr);
+	igt_assert_eq(err, 0);
+
+	for (;;) {
+		bool done = atomic_load_explicit(&s.done, memory_order_acquire);
+		uint64_t head = atomic_load_explicit(&s.head, memory_order_acquire);
+		uint64_t tail = atomic_load_explicit(&s.tail, memory_order_relaxed);
+
+		for (; tail != head; tail++)
+			sample_write(&s, out,
+				     s.ring + (tail & (SAMPLE_RING_SIZE - 1)) * s.record_size,
+				     csv);
+		atomic_store_explicit(&s.tail, tail, memory_order_release);
+
+		if (done)
+			break;
+
+		fflush(out);
+		usleep(10000);
+	}
+
+	pthread_join(thread, NULL);
+	intel_register_access_fini(&config->mmio_data);
+
+	if (config->verbosity > 0 || s.dropped || s.missed)
+		fprintf(stderr, "sample: %"PRIu64" samples, %"PRIu64" dropped, %"PRIu64" periods missed\n",
+			s.samples, s.dropped, s.missed);
+
+	if (out != stdout)
+		fclose(out);
+	for (i = 0; i < s.nregs; i++)
+		free(s.regs[i].name);
+	free(s.regs);
+	free(s.ring);
+
+	return EXIT_SUCCESS;
+}
+
 static int intel_reg_write(struct config *config, int argc, char *argv[])
 {
 	int i;
@@ -997,6 +1349,12 @@ static const struct command commands[] = {
 		.synopsis = "[--count=N] REGISTER [...]",
 		.description = "read and decode specified register(s)",
 	},
+	{
+		.name = "sample",
+		.function = intel_reg_sample,
+		.synopsis = "[--period=US] [--duration=S] [--on-change] [--raw] [--output=FILE] [--cpu=N] REGISTER [...]",
+		.description = "sample MMIO register(s) periodically as CSV or raw records",
+	},
 	{
 		.name = "write",
 		.function = intel_reg_write,
@@ -1246,6 +1604,12 @@ enum opt {
 	OPT_VERBOSE,
 	OPT_QUIET,
 	OPT_HELP,
+	OPT_PERIOD,
+	OPT_DURATION,
+	OPT_ON_CHANGE,
+	OPT_RAW,
+	OPT_OUTPUT,
+	OPT_CPU,
 };
 
 int main(int argc, char *argv[])
@@ -1258,6 +1622,8 @@ int main(int argc, char *argv[])
 	struct config config = {
 		.count = 1,
 		.fd = -1,
+		.sample_period_us = 1000,
+		.sample_cpu = -1,
 	};
 	bool help = false;
 
@@ -1279,6 +1645,13 @@ int main(int argc, char *argv[])
 		{ "all",	no_argument,		NULL,	OPT_ALL },
 		{ "pci-slot",	required_argument,	NULL,	OPT_SLOT },
 		{ "binary",	no_argument,		NULL,	OPT_BINARY },
+		/* options specific to sample */
+		{ "period",	required_argument,	NULL,	OPT_PERIOD },
+		{ "duration",	required_argument,	NULL,	OPT_DURATION },
+		{ "on-change",	no_argument,		NULL,	OPT_ON_CHANGE },
+		{ "raw",	no_argument,		NULL,	OPT_RAW },
+		{ "output",	required_argument,	NULL,	OPT_OUTPUT },
+		{ "cpu",	required_argument,	NULL,	OPT_CPU },
 		{ 0 }
 	};
 
@@ -1311,6 +1684,41 @@ int main(int argc, char *argv[])
 		case OPT_POST:
 			config.post = true;
 			break;
+		case OPT_PERIOD:
+			config.sample_period_us = strtoull(optarg, &endp, 10);
+			if (*endp || !config.sample_period_us) {
+				fprintf(stderr, "invalid period '%s'\n", optarg);
+				return EXIT_FAILURE;
+			}
+			break;
+		case OPT_DURATION:
+			config.sample_duration_s = strtoull(optarg, &endp, 10);
+			if (*endp) {
+				fprintf(stderr, "invalid duration '%s'\n", optarg);
+				return EXIT_FAILURE;
+			}
+			break;
+		case OPT_ON_CHANGE:
+			config.sample_on_change = true;
+			break;
+		case OPT_RAW:
+			config.sample_raw = true;
+			break;
+		case OPT_OUTPUT:
+			config.sample_output = strdup(optarg);
+			if (!config.sample_output) {
+				fprintf(stderr, "strdup: %s\n",
+					strerror(errno));
+				return EXIT_FAILURE;
+			}
+			break;
+		case OPT_CPU:
+			config.sample_cpu = strtol(optarg, &endp, 10);
+			if (*endp || config.sample_cpu < 0) {
+				fprintf(stderr, "invalid cpu '%s'\n", optarg);
+				return EXIT_FAILURE;
+			}
+			break;
 		case OPT_SPEC:
 			config.decode = true;
 			config.specfile = strdup(optarg);
@@ -1408,6 +1816,7 @@ int main(int argc, char *argv[])
 	ret = command->function(&config, argc, argv);
 
 	free(config.mmiofile);
+	free(config.sample_output);
 
 	if (config.fd >= 0)
 		close(config.fd);
@@ -34,6 +34,7 @@
 #include <time.h>
 #include <getopt.h>
 #include "igt.h"
+#include "igt_perf.h"
 
 #define IA32_TIME_STAMP_COUNTER		0x10
 
@@ -103,6 +104,9 @@ struct {
 	int res_calc_time;
 	int loop_inc;
 	char *test_name;
+	int sample_us;
+	int sample_time;
+	int report_ms;
 } opts = {
 	.draw_size = 0,
 	.do_page_flip = true,
@@ -112,6 +116,9 @@ struct {
 	.res_calc_time = 4,
 	.loop_inc = 2,
 	.test_name = NULL,
+	.sample_us = 0,
+	.sample_time = 10,
+	.report_ms = 1000,
 };
 
 static uint64_t msr_read(uint32_t addr)
@@ -609,10 +616,383 @@ static void draw_and_flip_test(void)
 	}
 }
 
+/*
+ * The sampler mode doesn't drive the display, it samples the GPU RC6 and
+ * package C-state residency counters at a high rate while the machine does
+ * whatever it is doing, to find out how often, and why, it leaves them.
+ *
+ * A sample period at least half resident counts as idle, so an entry is an
+ * active sample followed by an idle one and an exit is the opposite. Each
+ * exit is attributed to the engines busy during its sample or, when none
+ * were, to the GPU interrupts of the sample.
+ */
+
+#define MAX_SAMPLER_ENGINES	32
+#define MAX_SAMPLER_COUNTERS	(MAX_SAMPLER_ENGINES + 2)
+#define HIST_BUCKETS		24
+#define WAKE_IRQ		MAX_SAMPLER_ENGINES
+#define WAKE_OTHER		(MAX_SAMPLER_ENGINES + 1)
+
+/* RC6_RESIDENCY_TIME counts in 1.28us units, except on VLV/CHV */
+#define RC6_MMIO_UNIT_NS	1280
+
+struct residency {
+	const char *name;
+	bool idle;
+	uint64_t idle_ns;
+	uint64_t resident_ns;
+	unsigned int entries, exits;
+	unsigned long hist[HIST_BUCKETS];
+};
+
+struct sample {
+	uint64_t time;
+	uint64_t pmu[MAX_SAMPLER_COUNTERS];
+	uint32_t rc6_mmio;
+	uint64_t tsc, pc;
+};
+
+struct {
+	int pmu_group;
+	int num_pmu;
+	int rc6_idx, irq_idx;
+	int engine_idx[MAX_SAMPLER_ENGINES];
+	char engine_names[MAX_SAMPLER_ENGINES][8];
+	int num_engines;
+
+	struct intel_mmio_data mmio;
+	bool use_mmio;
+
+	uint32_t pc_addrs[NUM_PC_STATES];
+	int num_pc;
+
+	struct residency rc6, pc;
+	uint64_t busy_ns[MAX_SAMPLER_ENGINES];
+	unsigned long wakes[MAX_SAMPLER_ENGINES + 2];
+	unsigned long total_wakes[MAX_SAMPLER_ENGINES + 2];
+} sampler = {
+	.pmu_group = -1,
+	.rc6_idx = -1,
+	.irq_idx = -1,
+	.rc6 = { .name = "RC6" },
+	.pc = { .name = "PC" },
+};
+
+static int sampler_add_pmu(uint64_t config)
+{
+	int fd;
+
+	if (sampler.num_pmu == MAX_SAMPLER_COUNTERS)
+		return -1;
+
+	fd = perf_i915_open_group(drm.fd, config, sampler.pmu_group);
+	if (fd < 0)
+		return -1;
+
+	if (sampler.pmu_group < 0)
+		sampler.pmu_group = fd;
+
+	return sampler.num_pmu++;
+}
+
+static void sampler_setup_counters(void)
+{
+	static const char * const class_names[] = {
+		"rcs", "bcs", "vcs", "vecs", "ccs"
+	};
+	int class, instance, idx, pc_i;
+	uint64_t val;
+
+	sampler.rc6_idx = sampler_add_pmu(I915_PMU_RC6_RESIDENCY);
+	sampler.irq_idx = sampler_add_pmu(I915_PMU_INTERRUPTS);
+
+	for (class = 0; class < ARRAY_SIZE(class_names); class++) {
+		for (instance = 0; instance < 8; instance++) {
+			if (sampler.num_engines == MAX_SAMPLER_ENGINES)
+				break;
+
+			idx = sampler_add_pmu(I915_PMU_ENGINE_BUSY(class,
+								   instance));
+			if (idx < 0)
+				continue;
+
+			sampler.engine_idx[sampler.num_engines] = idx;
+			snprintf(sampler.engine_names[sampler.num_engines],
+				 sizeof(sampler.engine_names[0]), "%s%d",
+				 class_names[class], instance);
+			sampler.num_engines++;
+		}
+	}
+
+	/* Without the i915 PMU, read the RC6 counter directly */
+	if (sampler.rc6_idx < 0)
+		sampler.use_mmio = intel_register_access_init(&sampler.mmio,
+							      intel_get_pci_device(),
+							      0) == 0;
+
+	if (system("modprobe -q msr > /dev/null 2>&1") == -1 ||
+	    (msr_fd = open("/dev/cpu/0/msr", O_RDONLY)) < 0 ||
+	    pread(msr_fd, &val, sizeof(val), IA32_TIME_STAMP_COUNTER) != sizeof(val))
+		return;
+
+	/* Not every CPU has every package C-state counter */
+	for (pc_i = 0; pc_i < NUM_PC_STATES; pc_i++)
+		if (pread(msr_fd, &val, sizeof(val),
+			  res_msr_addrs[pc_i]) == sizeof(val))
+			sampler.pc_addrs[sampler.num_pc++] = res_msr_addrs[pc_i];
+}
+
+static void sampler_read(struct sample *s)
+{
+	uint64_t buf[2 + MAX_SAMPLER_COUNTERS];
+	size_t size = (2 + sampler.num_pmu) * sizeof(buf[0]);
+	struct timespec ts;
+	int pc_i;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	s->time = ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+
+	/* nr, time enabled, then the counters in the order opened */
+	if (sampler.pmu_group >= 0 &&
+	    read(sampler.pmu_group, buf, size) == size)
+		memcpy(s->pmu, buf + 2, sampler.num_pmu * sizeof(buf[0]));
+
+	if (sampler.use_mmio)
+		s->rc6_mmio = intel_register_read(&sampler.mmio,
+						  RC6_RESIDENCY_TIME);
+
+	if (sampler.num_pc) {
+		s->tsc = msr_read(IA32_TIME_STAMP_COUNTER);
+		s->pc = 0;
+		for (pc_i = 0; pc_i < sampler.num_pc; pc_i++)
+			s->pc += msr_read(sampler.pc_addrs[pc_i]);
+	}
+}
+
+static int residency_bucket(uint64_t ns)
+{
+	return min(igt_fls(ns / 1000), HIST_BUCKETS - 1);
+}
+
+/* Returns whether the sample left the residency */
+static bool residency_update(struct residency *r, uint64_t resident,
+			     uint64_t period)
+{
+	bool idle = resident * 2 >= period;
+	bool woke = false;
+
+	resident = min(resident, period);
+	r->resident_ns += resident;
+
+	if (idle) {
+		if (!r->idle)
+			r->entries++;
+		r->idle_ns += resident;
+	} else if (r->idle) {
+		r->exits++;
+		r->hist[residency_bucket(r->idle_ns + resident)]++;
+		r->idle_ns = 0;
+		woke = true;
+	}
+	r->idle = idle;
+
+	return woke;
+}
+
+static void sampler_attribute_wake(const struct sample *prev,
+				   const struct sample *cur)
+{
+	bool busy = false;
+	int i;
+
+	for (i = 0; i < sampler.num_engines; i++) {
+		int idx = sampler.engine_idx[i];
+
+		if (cur->pmu[idx] != prev->pmu[idx]) {
+			sampler.wakes[i]++;
+			busy = true;
+		}
+	}
+
+	if (busy)
+		return;
+
+	if (sampler.irq_idx >= 0 &&
+	    cur->pmu[sampler.irq_idx] != prev->pmu[sampler.irq_idx])
+		sampler.wakes[WAKE_IRQ]++;
+	else
+		sampler.wakes[WAKE_OTHER]++;
+}
+
+static void sampler_account(const struct sample *prev, const struct sample *cur)
+{
+	uint64_t period = cur->time - prev->time;
+	bool woke = false;
+	int i;
+
+	if (sampler.rc6_idx >= 0)
+		woke |= residency_update(&sampler.rc6,
+					 cur->pmu[sampler.rc6_idx] -
+					 prev->pmu[sampler.rc6_idx], period);
+	else if (sampler.use_mmio)
+		woke |= residency_update(&sampler.rc6,
+					 (uint64_t)(uint32_t)(cur->rc6_mmio -
+							      prev->rc6_mmio) *
+					 RC6_MMIO_UNIT_NS, period);
+
+	/* Scale the package residency to the sample period through the TSC */
+	if (sampler.num_pc && cur->tsc != prev->tsc)
+		woke |= residency_update(&sampler.pc,
+					 (cur->pc - prev->pc) * period /
+					 (cur->tsc - prev->tsc), period);
+
+	for (i = 0; i < sampler.num_engines; i++) {
+		int idx = sampler.engine_idx[i];
+
+		sampler.busy_ns[i] += cur->pmu[idx] - prev->pmu[idx];
+	}
+
+	if (woke)
+		sampler_attribute_wake(prev, cur);
+}
+
+static void print_residency(const struct residency *r, uint64_t interval,
+			    bool available)
+{
+	if (!available) {
+		printf("  %s %6s %9s", r->name, "-", "-");
+		return;
+	}
+
+	printf("  %s %5.1f%% %4u/%-4u", r->name,
+	       r->resident_ns * 100.0 / interval, r->entries, r->exits);
+}
+
+static void sampler_report(uint64_t elapsed, uint64_t interval)
+{
+	bool have_rc6 = sampler.rc6_idx >= 0 || sampler.use_mmio;
+	int i;
+
+	printf("%8.3f", elapsed * 1e-9);
+	print_residency(&sampler.rc6, interval, have_rc6);
+	print_residency(&sampler.pc, interval, sampler.num_pc);
+
+	for (i = 0; i < sampler.num_engines; i++)
+		printf("  %s %5.1f%%", sampler.engine_names[i],
+		       sampler.busy_ns[i] * 100.0 / interval);
+
+	printf("  wakes");
+	for (i = 0; i < sampler.num_engines; i++)
+		if (sampler.wakes[i])
+			printf(" %s:%lu", sampler.engine_names[i],
+			       sampler.wakes[i]);
+	if (sampler.wakes[WAKE_IRQ])
+		printf(" irq:%lu", sampler.wakes[WAKE_IRQ]);
+	if (sampler.wakes[WAKE_OTHER])
+		printf(" other:%lu", sampler.wakes[WAKE_OTHER]);
+	printf("\n");
+	fflush(stdout);
+
+	for (i = 0; i < ARRAY_SIZE(sampler.wakes); i++) {
+		sampler.total_wakes[i] += sampler.wakes[i];
+		sampler.wakes[i] = 0;
+	}
+	memset(sampler.busy_ns, 0, sizeof(sampler.busy_ns));
+	sampler.rc6.resident_ns = sampler.pc.resident_ns = 0;
+	sampler.rc6.entries = sampler.rc6.exits = 0;
+	sampler.pc.entries = sampler.pc.exits = 0;
+}
+
+static void print_histogram(const struct residency *r)
+{
+	unsigned long total = 0;
+	int i;
+
+	for (i = 0; i < HIST_BUCKETS; i++)
+		total += r->hist[i];
+	if (!total)
+		return;
+
+	printf("\n%s residency periods:\n", r->name);
+	for (i = 0; i < HIST_BUCKETS; i++) {
+		if (!r->hist[i])
+			continue;
+
+		if (i == 0)
+			printf("  %21s", "<1us");
+		else if (i == HIST_BUCKETS - 1)
+			printf("  %10s %8lluus", ">=", 1ull << (i - 1));
+		else
+			printf("  %8lluus - %6lluus", 1ull << (i - 1), 1ull << i);
+		printf(" %8lu %5.1f%%\n", r->hist[i], r->hist[i] * 100.0 / total);
+	}
+}
+
+static void sampler_run(void)
+{
+	uint64_t period = opts.sample_us * 1000ull;
+	uint64_t report = opts.report_ms * 1000000ull;
+	struct sample prev, cur;
+	struct timespec next;
+	uint64_t start, last_report;
+	int i;
+
+	sampler_setup_counters();
+	igt_require_f(sampler.rc6_idx >= 0 || sampler.use_mmio || sampler.num_pc,
+		      "No RC6 or package C-state residency counters\n");
+
+	printf("Sampling every %dus for %ds, reporting every %dms\n",
+	       opts.sample_us, opts.sample_time, opts.report_ms);
+	printf("Residency %% entries/exits, engine busy %%, wake-up sources\n");
+
+	set_alarm(opts.sample_time, 0);
+
+	memset(&prev, 0, sizeof(prev));
+	memset(&cur, 0, sizeof(cur));
+	sampler_read(&prev);
+	start = last_report = prev.time;
+	next.tv_sec = prev.time / NSEC_PER_SEC;
+	next.tv_nsec = prev.time % NSEC_PER_SEC;
+
+	while (!alarm_received) {
+		next.tv_nsec += period;
+		while (next.tv_nsec >= NSEC_PER_SEC) {
+			next.tv_nsec -= NSEC_PER_SEC;
+			next.tv_sec++;
+		}
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+
+		sampler_read(&cur);
+		sampler_account(&prev, &cur);
+		prev = cur;
+
+		if (cur.time - last_report >= report) {
+			sampler_report(cur.time - start, cur.time - last_report);
+			last_report = cur.time;
+		}
+	}
+
+	print_histogram(&sampler.rc6);
+	print_histogram(&sampler.pc);
+
+	printf("\nWake-up sources:\n");
+	for (i = 0; i < sampler.num_engines; i++)
+		if (sampler.total_wakes[i])
+			printf("  %-8s %8lu\n", sampler.engine_names[i],
+			       sampler.total_wakes[i]);
+	printf("  %-8s %8lu\n", "irq", sampler.total_wakes[WAKE_IRQ]);
+	printf("  %-8s %8lu\n", "other", sampler.total_wakes[WAKE_OTHER]);
+
+	if (sampler.use_mmio)
+		intel_register_access_fini(&sampler.mmio);
+	if (msr_fd >= 0)
+		close(msr_fd);
+}
+
 static void parse_opts(int argc, char *argv[])
 {
 	int opt;
-	char short_opts[] = "d:lrbw:c:i:fsn:";
+	char short_opts[] = "d:lrbw:c:i:fsn:S:t:R:";
 	struct option long_opts[] = {
 		{ "draw-size",        required_argument, NULL, 'd'},
 		{ "no-flip",          no_argument,       NULL, 'l'},
@@ -624,6 +1004,9 @@ static void parse_opts(int argc, char *argv[])
 		{ "fast",             no_argument,       NULL, 'f'},
 		{ "slow",             no_argument,       NULL, 's'},
 		{ "name",             required_argument, NULL, 'n'},
+		{ "sample",           required_argument, NULL, 'S'},
+		{ "sample-time",      required_argument, NULL, 't'},
+		{ "report-interval",  required_argument, NULL, 'R'},
 		{ 0 },
 	};
 
@@ -672,6 +1055,18 @@ static void parse_opts(int argc, char *argv[])
 		case 'n':
 			opts.test_name = optarg;
 			break;
+		case 'S':
+			opts.sample_us = atoi(optarg);
+			igt_assert(opts.sample_us > 0);
+			break;
+		case 't':
+			opts.sample_time = atoi(optarg);
+			igt_assert(opts.sample_time > 0);
+			break;
+		case 'R':
+			opts.report_ms = atoi(optarg);
+			igt_assert(opts.report_ms > 0);
+			break;
 		case -1:
 			return;
 		default:
@@ -684,6 +1079,16 @@ int main(int argc, char *argv[])
 {
 	parse_opts(argc, argv);
 
+	if (opts.sample_us) {
+		/* Leave the display alone, measure what's already running */
+		drm.fd = drm_open_driver(DRIVER_INTEL);
+		msr_fd = -1;
+		setup_alarm();
+		sampler_run();
+		drm_close_driver(drm.fd);
+		return 0;
+	}
+
 	setup_msr();
 	setup_drm();
 	setup_modeset();
@@ -11,6 +11,7 @@
 #include <inttypes.h>
 #include <limits.h>
 #include <poll.h>
+#include <pthread.h>
 #include <signal.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -327,9 +328,13 @@ get_device_oa_timestamp_frequency(int drm_fd)
 	return oau->oa_timestamp_freq;
 }
 
+struct capture_stream;
+
 struct recording_context {
 	int drm_fd;
 	int perf_fd;
+	/* OA buffer mapping, NULL when reading the stream with read() */
+	struct intel_xe_oa_mmap *oa_mmap;
 
 	uint32_t devid;
 	uint64_t oa_timestamp_frequency;
@@ -354,6 +359,10 @@ struct recording_context {
 	int oa_unit_id;
 	struct drm_xe_oa_unit *oa_unit;
 	struct drm_xe_engine_class_instance *hwe;
+
+	/* Streams of a multi stream recording, NULL otherwise. */
+	struct capture_stream *streams;
+	uint32_t n_streams;
 };
 
 static void set_fd_flags(int fd, int flags)
@@ -465,7 +474,8 @@ static bool
 write_version(FILE *output, struct recording_context *ctx)
 {
 	struct intel_xe_perf_record_version version = {
-		.version = INTEL_XE_PERF_RECORD_VERSION,
+		.version = ctx->streams ? INTEL_XE_PERF_RECORD_VERSION_MULTI_STREAM :
+					  INTEL_XE_PERF_RECORD_VERSION,
 	};
 	struct intel_xe_perf_record_header header = {
 		.type = INTEL_XE_PERF_RECORD_TYPE_VERSION,
@@ -548,29 +558,32 @@ static int get_stream_status(int perf_fd, u32 *oa_status)
 	return 0;
 }
 
-static bool write_stream_status(struct recording_context *ctx, FILE *output)
+static bool write_oa_status(u32 oa_status, FILE *output)
 {
-	u32 oa_status;
+	struct intel_xe_perf_record_header header = { .size = sizeof(header) };
 
-	if (!get_stream_status(ctx->perf_fd, &oa_status)) {
-		struct intel_xe_perf_record_header header = { .size = sizeof(header) };
+	if (oa_status & DRM_XE_OASTATUS_REPORT_LOST)
+		header.type = INTEL_XE_PERF_RECORD_OA_TYPE_REPORT_LOST;
+	else if (oa_status & DRM_XE_OASTATUS_BUFFER_OVERFLOW)
+		header.type = INTEL_XE_PERF_RECORD_OA_TYPE_BUFFER_LOST;
+	else
+		return true;
 
-		if (oa_status & DRM_XE_OASTATUS_REPORT_LOST)
-			header.type = INTEL_XE_PERF_RECORD_OA_TYPE_REPORT_LOST;
-		else if (oa_status & DRM_XE_OASTATUS_BUFFER_OVERFLOW)
-			header.type = INTEL_XE_PERF_RECORD_OA_TYPE_BUFFER_LOST;
-		else
-			return true;
+	return fwrite(&header, sizeof(header), 1, output) == 1;
+}
 
-		if (fwrite(&header, sizeof(header), 1, output) != 1)
-			return false;
-	}
+static bool write_stream_status(struct recording_context *ctx, FILE *output)
+{
+	u32 oa_status;
 
-	return true;
+	if (get_stream_status(ctx->perf_fd, &oa_status))
+		return true;
+
+	return write_oa_status(oa_status, output);
 }
 
 static bool write_stream_data(struct recording_context *ctx,
-			      char *data, ssize_t size, FILE *output)
+			      const char *data, ssize_t size, FILE *output)
 {
 	ssize_t format_size = oa_formats[ctx->metric_set->perf_oa_format].size;
 
@@ -587,17 +600,59 @@ static bool write_stream_data(struct recording_context *ctx,
 
 		if (fwrite(data, format_size, 1, output) != 1)
 			return false;
+		data += format_size;
 	}
 
 	return true;
 }
 
+/*
+ * Maps the OA buffer so that reports are written out from where the OA unit
+ * put them, leaving read() to the older kernels which can't map it.
+ */
+static void perf_mmap(struct recording_context *ctx)
+{
+	const struct xe_oa_format *format =
+		&oa_formats[ctx->metric_set->perf_oa_format];
+
+	ctx->oa_mmap = intel_xe_oa_mmap_open(ctx->perf_fd, format->size,
+					     format->header == HDR_64_BIT);
+	if (!ctx->oa_mmap)
+		fprintf(stderr, "Unable to map the OA buffer, using read(): %s\n",
+			strerror(errno));
+}
+
+static bool write_perf_data_mmap(FILE *output, struct recording_context *ctx)
+{
+	ssize_t format_size = oa_formats[ctx->metric_set->perf_oa_format].size;
+	const void *report;
+	u32 oa_status;
+	int n;
+
+	do {
+		for (n = 0; (report = intel_xe_oa_mmap_next(ctx->oa_mmap)); n++) {
+			if (!write_stream_data(ctx, report, format_size, output))
+				return false;
+		}
+
+		if (intel_xe_oa_mmap_release(ctx->oa_mmap, &oa_status))
+			return false;
+		if (!write_oa_status(oa_status, output))
+			return false;
+	} while (n);
+
+	return true;
+}
+
 static bool write_perf_data(FILE *output, struct recording_context *ctx)
 {
 	char data[4096];
 	ssize_t len;
 	bool ret;
 
+	if (ctx->oa_mmap)
+		return write_perf_data_mmap(output, ctx);
+
 	while (1) {
 		len = read(ctx->perf_fd, data, sizeof(data));
 
@@ -759,18 +814,20 @@ read_command_file(struct recording_context *ctx)
 static void
 print_metric_sets(const struct intel_xe_perf *perf)
 {
-	struct intel_xe_perf_metric_set *metric_set;
 	uint32_t longest_name = 0;
 
-	igt_list_for_each_entry(metric_set, &perf->metric_sets, link) {
-		longest_name = MAX(longest_name, strlen(metric_set->symbol_name));
+	for (uint32_t i = 0; i < perf->n_metric_set_descs; i++) {
+		longest_name = MAX(longest_name,
+				   strlen(perf->metric_set_descs[i].symbol_name));
 	}
 
-	igt_list_for_each_entry(metric_set, &perf->metric_sets, link) {
+	for (uint32_t i = 0; i < perf->n_metric_set_descs; i++) {
+		const struct intel_xe_perf_metric_set_desc *desc = &perf->metric_set_descs[i];
+
 		fprintf(stdout, "%s:%*s%s\n",
-			metric_set->symbol_name,
-			(int) (longest_name - strlen(metric_set->symbol_name) + 1), " ",
-			metric_set->name);
+			desc->symbol_name,
+			(int) (longest_name - strlen(desc->symbol_name) + 1), " ",
+			desc->name);
 	}
 }
 
@@ -803,6 +860,515 @@ print_metric_sets_counters(struct intel_xe_perf *perf)
 		print_metric_set_counters(metric_set);
 }
 
+/*
+ * Multi stream recordings read each OA stream from its own thread. The
+ * records of a stream are queued along with an estimate of their CPU
+ * timestamp, and the main thread merges all the queues into the output in
+ * timestamp order.
+ */
+#define MAX_STREAMS 16
+#define MERGE_PERIOD_MS 100
+
+struct record_queue {
+	uint8_t *data;
+	size_t len;
+	size_t allocated;
+
+	struct {
+		uint64_t cpu_ts;
+		size_t offset;
+	} *items;
+	uint32_t head;
+	uint32_t n_items;
+	uint32_t n_allocated_items;
+};
+
+struct capture_stream {
+	/* Copy of the main context, with the OA unit, metric set and OA
+	 * stream of this stream.
+	 */
+	struct recording_context ctx;
+	uint16_t id;
+
+	pthread_t thread;
+	uint64_t corr_period_ns;
+
+	/* Last two timestamp correlations, to estimate the CPU timestamp of
+	 * the samples.
+	 */
+	struct intel_xe_perf_record_timestamp_correlation corr[2];
+	uint32_t n_corr;
+	uint64_t last_cpu_ts;
+
+	/* Records read by the thread and not handed over yet. */
+	struct record_queue local;
+
+	pthread_mutex_t lock;
+	struct record_queue pending;
+	uint64_t pending_cpu_ts;
+	bool done;
+	bool error;
+
+	/* Records handed over to the main thread, not merged yet. */
+	struct record_queue merge;
+};
+
+static void
+record_queue_reserve(struct record_queue *queue, size_t len, uint32_t n_items)
+{
+	if (queue->len + len > queue->allocated) {
+		queue->allocated = MAX(MAX(64 * 1024, 2 * queue->allocated),
+				       queue->len + len);
+		queue->data = realloc(queue->data, queue->allocated);
+		assert(queue->data);
+	}
+
+	if (queue->n_items + n_items > queue->n_allocated_items) {
+		queue->n_allocated_items = MAX(MAX(1024, 2 * queue->n_allocated_items),
+					       queue->n_items + n_items);
+		queue->items = realloc(queue->items,
+				       queue->n_allocated_items * sizeof(*queue->items));
+		assert(queue->items);
+	}
+}
+
+static void
+record_queue_push(struct record_queue *queue, uint64_t cpu_ts,
+		  const struct intel_xe_perf_record_header *header,
+		  const void *payload)
+{
+	record_queue_reserve(queue, header->size, 1);
+
+	queue->items[queue->n_items].cpu_ts = cpu_ts;
+	queue->items[queue->n_items].offset = queue->len;
+	queue->n_items++;
+
+	memcpy(queue->data + queue->len, header, sizeof(*header));
+	memcpy(queue->data + queue->len + sizeof(*header), payload,
+	       header->size - sizeof(*header));
+	queue->len += header->size;
+}
+
+/* Appends the records of @src not consumed yet to @dst and empties @src. */
+static void
+record_queue_move(struct record_queue *dst, struct record_queue *src)
+{
+	uint32_t n_items = src->n_items - src->head;
+	size_t base, len;
+
+	if (n_items) {
+		base = src->items[src->head].offset;
+		len = src->len - base;
+
+		record_queue_reserve(dst, len, n_items);
+		memcpy(dst->data + dst->len, src->data + base, len);
+		for (uint32_t i = 0; i < n_items; i++) {
+			dst->items[dst->n_items + i].cpu_ts = src->items[src->head + i].cpu_ts;
+			dst->items[dst->n_items + i].offset =
+				src->items[src->head + i].offset - base + dst->len;
+		}
+		dst->n_items += n_items;
+		dst->len += len;
+	}
+
+	src->len = 0;
+	src->head = 0;
+	src->n_items = 0;
+}
+
+/* Drops the records consumed from the head of @queue. */
+static void
+record_queue_compact(struct record_queue *queue)
+{
+	size_t base;
+
+	if (!queue->head)
+		return;
+
+	base = queue->head < queue->n_items ?
+		queue->items[queue->head].offset : queue->len;
+
+	memmove(queue->data, queue->data + base, queue->len - base);
+	memmove(queue->items, queue->items + queue->head,
+		(queue->n_items - queue->head) * sizeof(*queue->items));
+	queue->n_items -= queue->head;
+	queue->len -= base;
+	queue->head = 0;
+
+	for (uint32_t i = 0; i < queue->n_items; i++)
+		queue->items[i].offset -= base;
+}
+
+static void
+record_queue_fini(struct record_queue *queue)
+{
+	free(queue->data);
+	free(queue->items);
+}
+
+/*
+ * Samples read after a correlation point can predate it, so the masked
+ * timestamp delta is treated as signed.
+ */
+static uint64_t
+estimate_cpu_timestamp(const struct capture_stream *stream, uint64_t gpu_ts)
+{
+	const struct intel_xe_perf_record_timestamp_correlation *corr = stream->corr;
+	uint64_t mask = stream->ctx.perf->devinfo.oa_timestamp_mask;
+	uint64_t delta = (gpu_ts - corr[1].gpu_timestamp) & mask;
+	uint64_t cpu_period = 1000000000ull;
+	uint64_t gpu_period = stream->ctx.cs_timestamp_frequency;
+
+	if (stream->n_corr > 1 && corr[1].gpu_timestamp > corr[0].gpu_timestamp) {
+		cpu_period = corr[1].cpu_timestamp - corr[0].cpu_timestamp;
+		gpu_period = corr[1].gpu_timestamp - corr[0].gpu_timestamp;
+	}
+
+	if (delta > mask / 2)
+		return corr[1].cpu_timestamp - (mask + 1 - delta) * cpu_period / gpu_period;
+
+	return corr[1].cpu_timestamp + delta * cpu_period / gpu_period;
+}
+
+static void
+stream_push(struct capture_stream *stream, uint64_t cpu_ts, uint32_t type,
+	    const void *payload, uint16_t payload_size)
+{
+	struct intel_xe_perf_record_header header = {
+		.type = type,
+		.stream_id = stream->id,
+		.size = sizeof(header) + payload_size,
+	};
+
+	/* Keep the records of a stream ordered for the merge. */
+	stream->last_cpu_ts = MAX(stream->last_cpu_ts, cpu_ts);
+	record_queue_push(&stream->local, stream->last_cpu_ts, &header, payload);
+}
+
+static bool
+stream_correlate(struct capture_stream *stream)
+{
+	struct intel_xe_perf_record_timestamp_correlation corr;
+
+	if (!get_correlation_timestamps(&stream->ctx, &corr))
+		return false;
+
+	stream->corr[0] = stream->corr[1];
+	stream->corr[1] = corr;
+	stream->n_corr++;
+
+	stream_push(stream, corr.cpu_timestamp,
+		    INTEL_XE_PERF_RECORD_TYPE_TIMESTAMP_CORRELATION,
+		    &corr, sizeof(corr));
+
+	return true;
+}
+
+static void
+stream_push_status(struct capture_stream *stream, uint32_t oa_status)
+{
+	if (oa_status & DRM_XE_OASTATUS_REPORT_LOST)
+		stream_push(stream, stream->last_cpu_ts,
+			    INTEL_XE_PERF_RECORD_OA_TYPE_REPORT_LOST,
+			    NULL, 0);
+	else if (oa_status & DRM_XE_OASTATUS_BUFFER_OVERFLOW)
+		stream_push(stream, stream->last_cpu_ts,
+			    INTEL_XE_PERF_RECORD_OA_TYPE_BUFFER_LOST,
+			    NULL, 0);
+}
+
+static void
+stream_push_sample(struct capture_stream *stream, const void *report)
+{
+	const struct intel_xe_perf_metric_set *metric_set = stream->ctx.metric_set;
+	uint64_t gpu_ts;
+
+	gpu_ts = intel_xe_perf_read_report_timestamp(stream->ctx.perf,
+						     metric_set, report);
+
+	stream_push(stream, estimate_cpu_timestamp(stream, gpu_ts),
+		    INTEL_XE_PERF_RECORD_TYPE_SAMPLE,
+		    report, oa_formats[metric_set->perf_oa_format].size);
+}
+
+static bool
+stream_read_mmap(struct capture_stream *stream)
+{
+	const void *report;
+	uint32_t oa_status;
+	int n;
+
+	do {
+		for (n = 0; (report = intel_xe_oa_mmap_next(stream->ctx.oa_mmap)); n++)
+			stream_push_sample(stream, report);
+
+		if (intel_xe_oa_mmap_release(stream->ctx.oa_mmap, &oa_status))
+			return false;
+		stream_push_status(stream, oa_status);
+	} while (n);
+
+	return true;
+}
+
+static bool
+stream_read(struct capture_stream *stream)
+{
+	const struct intel_xe_perf_metric_set *metric_set = stream->ctx.metric_set;
+	ssize_t format_size = oa_formats[metric_set->perf_oa_format].size;
+	uint8_t data[4096];
+	ssize_t len;
+
+	if (stream->ctx.oa_mmap)
+		return stream_read_mmap(stream);
+
+	while (1) {
+		len = read(stream->ctx.perf_fd, data, sizeof(data));
+
+		if (len < 0) {
+			uint32_t oa_status;
+
+			switch (errno) {
+			case EIO:
+				if (!get_stream_status(stream->ctx.perf_fd, &oa_status))
+					stream_push_status(stream, oa_status);
+				break;
+			case EAGAIN:
+			case EINTR:
+				return true;
+			default:
+				return false;
+			}
+			continue;
+		}
+
+		assert(!(len % format_size));
+
+		for (ssize_t offset = 0; offset < len; offset += format_size)
+			stream_push_sample(stream, data + offset);
+	}
+}
+
+/* Hands the records read so far over to the main thread. */
+static void
+stream_publish(struct capture_stream *stream, bool done, bool error)
+{
+	pthread_mutex_lock(&stream->lock);
+	record_queue_move(&stream->pending, &stream->local);
+	stream->pending_cpu_ts = stream->last_cpu_ts;
+	stream->done = done;
+	stream->error = error;
+	pthread_mutex_unlock(&stream->lock);
+}
+
+static void *
+stream_thread(void *data)
+{
+	struct capture_stream *stream = data;
+	uint64_t poll_time_ns = stream->corr_period_ns;
+	bool ok = stream_correlate(stream);
+
+	while (ok && !__atomic_load_n(&quit, __ATOMIC_RELAXED)) {
+		struct pollfd pollfd = { stream->ctx.perf_fd, POLLIN, 0 };
+		struct timespec now;
+		uint64_t elapsed_ns;
+
+		igt_gettime(&now);
+		if (poll(&pollfd, 1, poll_time_ns / 1000000) < 0 && errno != EINTR) {
+			ok = false;
+			break;
+		}
+
+		if (pollfd.revents & POLLIN)
+			ok = stream_read(stream);
+
+		elapsed_ns = igt_nsec_elapsed(&now);
+		if (elapsed_ns > poll_time_ns) {
+			poll_time_ns = stream->corr_period_ns;
+			ok = ok && stream_correlate(stream);
+		} else {
+			poll_time_ns -= elapsed_ns;
+		}
+
+		stream_publish(stream, false, false);
+	}
+
+	ok = ok && stream_read(stream) && stream_correlate(stream);
+	stream_publish(stream, true, !ok);
+
+	return NULL;
+}
+
+/*
+ * Writes the queued records of all streams up to the point where every
+ * stream still running has been read, in CPU timestamp order.
+ */
+static bool
+merge_streams(struct recording_context *ctx, bool *all_done)
+{
+	uint64_t watermark = UINT64_MAX;
+
+	*all_done = true;
+	for (uint32_t i = 0; i < ctx->n_streams; i++) {
+		struct capture_stream *stream = &ctx->streams[i];
+
+		pthread_mutex_lock(&stream->lock);
+		record_queue_move(&stream->merge, &stream->pending);
+		if (!stream->done) {
+			watermark = MIN(watermark, stream->pending_cpu_ts);
+			*all_done = false;
+		}
+		pthread_mutex_unlock(&stream->lock);
+	}
+
+	while (1) {
+		struct record_queue *next = NULL;
+		const struct intel_xe_perf_record_header *header;
+
+		for (uint32_t i = 0; i < ctx->n_streams; i++) {
+			struct record_queue *queue = &ctx->streams[i].merge;
+
+			if (queue->head == queue->n_items ||
+			    queue->items[queue->head].cpu_ts > watermark)
+				continue;
+
+			if (!next ||
+			    queue->items[queue->head].cpu_ts < next->items[next->head].cpu_ts)
+				next = queue;
+		}
+
+		if (!next)
+			break;
+
+		header = (const struct intel_xe_perf_record_header *)
+			(next->data + next->items[next->head++].offset);
+		if (fwrite(header, header->size, 1, ctx->output_stream) != 1)
+			return false;
+	}
+
+	for (uint32_t i = 0; i < ctx->n_streams; i++)
+		record_queue_compact(&ctx->streams[i].merge);
+
+	return true;
+}
+
+static bool
+open_streams(struct recording_context *ctx, double perf_period)
+{
+	for (uint32_t i = 0; i < ctx->n_streams; i++) {
+		struct capture_stream *stream = &ctx->streams[i];
+
+		if (stream->ctx.metric_set->perf_oa_metrics_set == 0) {
+			fprintf(stderr,
+				"Unable to load performance configuration, consider running:\n"
+				"   sysctl dev.xe.observation_paranoid=0\n");
+			return false;
+		}
+
+		stream->ctx.oa_exponent =
+			oa_exponent_for_period(stream->ctx.oa_unit->oa_timestamp_freq,
+					       perf_period);
+		fprintf(stdout, "Opening stream %u on oa_unit=%i gt=%i with metric=%s oa_exponent=%u\n",
+			stream->id, stream->ctx.oa_unit->oa_unit_id,
+			stream->ctx.hwe->gt_id, stream->ctx.metric_set->symbol_name,
+			stream->ctx.oa_exponent);
+
+		stream->ctx.perf_fd = perf_open(&stream->ctx);
+		if (stream->ctx.perf_fd < 0) {
+			fprintf(stderr, "Unable to open xe oa stream on unit %i: %s\n",
+				stream->ctx.oa_unit->oa_unit_id, strerror(errno));
+			return false;
+		}
+		perf_mmap(&stream->ctx);
+	}
+
+	return true;
+}
+
+static bool
+write_stream_infos(FILE *output, struct recording_context *ctx)
+{
+	for (uint32_t i = 0; i < ctx->n_streams; i++) {
+		const struct capture_stream *stream = &ctx->streams[i];
+		struct intel_xe_perf_record_stream_info info = {
+			.stream_id = stream->id,
+			.oa_unit_id = stream->ctx.oa_unit->oa_unit_id,
+			.oa_unit_type = stream->ctx.oa_unit->oa_unit_type,
+			.gt_id = stream->ctx.hwe->gt_id,
+			.engine_class = stream->ctx.hwe->engine_class,
+			.engine_instance = stream->ctx.hwe->engine_instance,
+			.oa_format = stream->ctx.metric_set->perf_oa_format,
+			.timestamp_frequency = stream->ctx.oa_unit->oa_timestamp_freq,
+		};
+		struct intel_xe_perf_record_header header = {
+			.type = INTEL_XE_PERF_RECORD_TYPE_STREAM_INFO,
+			.size = sizeof(header) + sizeof(info),
+		};
+
+		snprintf(info.metric_set_name, sizeof(info.metric_set_name),
+			 "%s", stream->ctx.metric_set->symbol_name);
+		snprintf(info.metric_set_uuid, sizeof(info.metric_set_uuid),
+			 "%s", stream->ctx.metric_set->hw_config_guid);
+
+		if (fwrite(&header, sizeof(header), 1, output) != 1)
+			return false;
+
+		if (fwrite(&info, sizeof(info), 1, output) != 1)
+			return false;
+	}
+
+	return true;
+}
+
+static bool
+record_streams(struct recording_context *ctx, uint64_t corr_period_ns)
+{
+	bool all_done = false, ok = true;
+	uint32_t n_started;
+
+	for (n_started = 0; n_started < ctx->n_streams; n_started++) {
+		struct capture_stream *stream = &ctx->streams[n_started];
+
+		stream->corr_period_ns = corr_period_ns;
+		if (pthread_create(&stream->thread, NULL, stream_thread, stream)) {
+			fprintf(stderr, "Unable to start stream thread\n");
+			ok = false;
+			break;
+		}
+	}
+
+	while (ok && !quit && !all_done) {
+		struct pollfd pollfd = { ctx->command_fifo_fd, POLLIN, 0 };
+
+		if (poll(&pollfd, ctx->command_fifo_fd != -1 ? 1 : 0, MERGE_PERIOD_MS) > 0 &&
+		    (pollfd.revents & POLLIN))
+			read_command_file(ctx);
+
+		ok = merge_streams(ctx, &all_done);
+		if (!ok)
+			fprintf(stderr, "Failed to write xe-oa data: %s\n",
+				strerror(errno));
+	}
+
+	__atomic_store_n(&quit, true, __ATOMIC_RELAXED);
+	for (uint32_t i = 0; i < n_started; i++)
+		pthread_join(ctx->streams[i].thread, NULL);
+
+	if (ok && !merge_streams(ctx, &all_done)) {
+		fprintf(stderr, "Failed to write xe-oa data: %s\n",
+			strerror(errno));
+		ok = false;
+	}
+
+	for (uint32_t i = 0; i < n_started; i++) {
+		if (ctx->streams[i].error) {
+			fprintf(stderr, "Failed to read xe-oa stream %u\n", i);
+			ok = false;
+		}
+	}
+
+	return ok;
+}
+
 static void
 usage(const char *name)
 {
@@ -828,7 +1394,10 @@ usage(const char *name)
 		"     --output,             -o <path>   Output file (default = xe_perf.record)\n"
 		"     --cpu-clock,          -k <path>   Cpu clock to use for correlations\n"
 		"                                       Values: boot, mono, mono_raw (default = mono)\n"
-		"     --oa-unit-id          -u <value>  OA unit id for the capture.\n",
+		"     --oa-unit-id          -u <value>  OA unit id for the capture.\n"
+		"     --stream,             -S <u>:<m>  Capture OA unit <u> with metric <m>, can be\n"
+		"                                       repeated to record several OA units at once\n"
+		"                                       (replaces --oa-unit-id and --metric).\n",
 		name);
 }
 
@@ -851,6 +1420,20 @@ teardown_recording_context(struct recording_context *ctx)
 
 	free(ctx->circular_buffer.data);
 
+	for (uint32_t i = 0; i < ctx->n_streams; i++) {
+		struct capture_stream *stream = &ctx->streams[i];
+
+		intel_xe_oa_mmap_close(stream->ctx.oa_mmap);
+		if (stream->ctx.perf_fd != -1)
+			close(stream->ctx.perf_fd);
+		pthread_mutex_destroy(&stream->lock);
+		record_queue_fini(&stream->local);
+		record_queue_fini(&stream->pending);
+		record_queue_fini(&stream->merge);
+	}
+	free(ctx->streams);
+
+	intel_xe_oa_mmap_close(ctx->oa_mmap);
 	if (ctx->perf_fd != -1)
 		close(ctx->perf_fd);
 	if (ctx->drm_fd != -1)
@@ -912,6 +1495,42 @@ static int assign_oa_unit(int fd, struct recording_context *ctx)
 	return -1;
 }
 
+static bool
+setup_streams(struct recording_context *ctx,
+	      const int *oa_unit_ids, const char * const *metric_names,
+	      uint32_t n_streams)
+{
+	ctx->streams = calloc(n_streams, sizeof(*ctx->streams));
+	if (!ctx->streams)
+		return false;
+
+	for (uint32_t i = 0; i < n_streams; i++) {
+		struct capture_stream *stream = &ctx->streams[i];
+
+		stream->ctx = *ctx;
+		stream->ctx.streams = NULL;
+		stream->ctx.n_streams = 0;
+		stream->ctx.oa_unit_id = oa_unit_ids[i];
+		stream->id = i;
+		pthread_mutex_init(&stream->lock, NULL);
+		ctx->n_streams++;
+
+		if (assign_oa_unit(ctx->drm_fd, &stream->ctx) < 0) {
+			fprintf(stderr, "Unknown OA unit %i\n", oa_unit_ids[i]);
+			return false;
+		}
+
+		stream->ctx.metric_set = intel_xe_perf_find_metric_set(ctx->perf,
+								       metric_names[i]);
+		if (!stream->ctx.metric_set) {
+			fprintf(stderr, "Unknown metric set '%s'.\n", metric_names[i]);
+			return false;
+		}
+	}
+
+	return true;
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -927,6 +1546,7 @@ main(int argc, char *argv[])
 		{"command-fifo",	required_argument, 0, 'f'},
 		{"cpu-clock",		required_argument, 0, 'k'},
 		{"oa-unit-id",		required_argument, 0, 'u'},
+		{"stream",		required_argument, 0, 'S'},
 		{0, 0, 0, 0}
 	};
 	const struct {
@@ -939,13 +1559,15 @@ main(int argc, char *argv[])
 	};
 	double corr_period = 1.0, perf_period = 0.001;
 	const char *metric_name = NULL, *output_file = "xe_perf.record";
-	struct intel_xe_perf_metric_set *metric_set;
 	struct intel_xe_perf_record_timestamp_correlation initial_correlation;
 	struct timespec now;
 	uint64_t corr_period_ns, poll_time_ns;
 	uint32_t circular_size = 0;
 	int opt, dev_node_id = -1;
 	bool list_counters = false;
+	int stream_oa_unit_ids[MAX_STREAMS];
+	const char *stream_metric_names[MAX_STREAMS];
+	uint32_t n_streams = 0;
 	FILE *output = NULL;
 	struct recording_context ctx = {
 		.drm_fd = -1,
@@ -957,7 +1579,7 @@ main(int argc, char *argv[])
 		.oa_unit_id = 0,
 	};
 
-	while ((opt = getopt_long(argc, argv, "hc:d:p:m:Co:s:f:k:P:u:", long_options, NULL)) != -1) {
+	while ((opt = getopt_long(argc, argv, "hc:d:p:m:Co:s:f:k:P:u:S:", long_options, NULL)) != -1) {
 		switch (opt) {
 		case 'h':
 			usage(argv[0]);
@@ -1008,6 +1630,23 @@ main(int argc, char *argv[])
 		case 'u':
 			ctx.oa_unit_id = atoi(optarg);
 			break;
+		case 'S': {
+			char *end;
+
+			if (n_streams >= MAX_STREAMS) {
+				fprintf(stderr, "Too many streams (max %u)\n", MAX_STREAMS);
+				return EXIT_FAILURE;
+			}
+
+			stream_oa_unit_ids[n_streams] = strtol(optarg, &end, 0);
+			if (end == optarg || *end != ':' || !end[1]) {
+				fprintf(stderr, "Invalid stream '%s', expected <oa-unit-id>:<metric>\n",
+					optarg);
+				return EXIT_FAILURE;
+			}
+			stream_metric_names[n_streams++] = end + 1;
+			break;
+		}
 		default:
 			fprintf(stderr, "Internal error: "
 				"unexpected getopt value: %d\n", opt);
@@ -1021,6 +1660,17 @@ main(int argc, char *argv[])
 		return EXIT_SUCCESS;
 	}
 
+	if (n_streams) {
+		if (circular_size) {
+			fprintf(stderr, "Circular buffer not supported with --stream\n");
+			return EXIT_FAILURE;
+		}
+
+		/* The first stream also provides the device info record. */
+		ctx.oa_unit_id = stream_oa_unit_ids[0];
+		metric_name = stream_metric_names[0];
+	}
+
 	ctx.drm_fd = open_render_node(&ctx.devid, dev_node_id);
 	if (ctx.drm_fd < 0) {
 		fprintf(stderr, "Unable to open device.\n");
@@ -1050,32 +1700,26 @@ main(int argc, char *argv[])
 		goto fail;
 	}
 
-	ctx.perf = intel_xe_perf_for_fd(ctx.drm_fd, ctx.hwe->gt_id);
+	ctx.perf = intel_xe_perf_for_fd_lazy(ctx.drm_fd, ctx.hwe->gt_id);
 	if (!ctx.perf) {
 		fprintf(stderr, "No perf data found.\n");
 		goto fail;
 	}
 
-	intel_xe_perf_load_perf_configs(ctx.perf, ctx.drm_fd);
-
 	if (metric_name) {
 		if (!strcmp(metric_name, "list")) {
 			print_metric_sets(ctx.perf);
 			return EXIT_SUCCESS;
 		}
 
-		igt_list_for_each_entry(metric_set, &ctx.perf->metric_sets, link) {
-			if (!strcasecmp(metric_set->symbol_name, metric_name)) {
-				ctx.metric_set = metric_set;
-				break;
-			}
-		}
+		ctx.metric_set = intel_xe_perf_find_metric_set(ctx.perf, metric_name);
 	}
 
 	if (list_counters) {
-		if (!ctx.metric_set)
+		if (!ctx.metric_set) {
+			intel_xe_perf_load_metric_sets(ctx.perf);
 			print_metric_sets_counters(ctx.perf);
-		else
+		} else
 			print_metric_set_counters(ctx.metric_set);
 		teardown_recording_context(&ctx);
 		return EXIT_SUCCESS;
@@ -1090,11 +1734,15 @@ main(int argc, char *argv[])
 		goto fail;
 	}
 
-	intel_xe_perf_load_perf_configs(ctx.perf, ctx.drm_fd);
-
 	ctx.oa_timestamp_frequency = get_device_oa_timestamp_frequency(ctx.drm_fd);
 	ctx.cs_timestamp_frequency = get_device_cs_timestamp_frequency(ctx.drm_fd);
 
+	if (n_streams &&
+	    !setup_streams(&ctx, stream_oa_unit_ids, stream_metric_names, n_streams))
+		goto fail;
+
+	intel_xe_perf_load_perf_configs(ctx.perf, ctx.drm_fd);
+
 	signal(SIGINT, sigint_handler);
 
 	if (ctx.command_fifo) {
@@ -1148,7 +1796,8 @@ main(int argc, char *argv[])
 		if (!write_version(output, &ctx) ||
 		    !write_header(output, &ctx) ||
 		    !write_topology(output, &ctx) ||
-		    !write_correlation_timestamps(&ctx, output)) {
+		    !write_stream_infos(output, &ctx) ||
+		    (!ctx.streams && !write_correlation_timestamps(&ctx, output))) {
 			fprintf(stderr, "Unable to write header in file '%s'\n",
 				output_file);
 			goto fail;
@@ -1168,6 +1817,17 @@ main(int argc, char *argv[])
 	fprintf(stdout, "Using correlation clock: %s\n",
 		get_correlation_clock_name(correlation_clock_id));
 
+	if (ctx.streams) {
+		if (!open_streams(&ctx, perf_period) ||
+		    !record_streams(&ctx, corr_period * 1000000000ul))
+			goto fail;
+
+		fprintf(stdout, "Exiting...\n");
+		teardown_recording_context(&ctx);
+
+		return EXIT_SUCCESS;
+	}
+
 	ctx.oa_exponent = oa_exponent_for_period(ctx.oa_timestamp_frequency, perf_period);
 	fprintf(stdout, "Opening perf stream with metric_id=%"PRIu64" oa_exponent=%u oa_format=%u\n",
 		ctx.metric_set->perf_oa_metrics_set, ctx.oa_exponent,
@@ -1179,6 +1839,7 @@ main(int argc, char *argv[])
 			strerror(errno));
 		goto fail;
 	}
+	perf_mmap(&ctx);
 
 	corr_period_ns = corr_period * 1000000000ul;
 	poll_time_ns = corr_period_ns;